@@ -0,0 +1,22 @@
+#pragma once
+#include <switch.h>
+
+/// Records a result, written to the JSON report.
+void benchReport(const char* group, const char* name, const char* unit, double value, u64 iterations);
+
+/// Returns the elapsed time since start, in nanoseconds.
+static inline double benchElapsedNs(u64 start_tick)
+{
+    return (double)armTicksToNs(armGetSystemTick() - start_tick);
+}
+
+/// Runs fn repeatedly for about target_ns and reports the average duration of a call.
+void benchLoop(const char* group, const char* name, void (*fn)(void* arg), void* arg, u64 target_ns);
+
+void benchIpc(void);
+void benchSync(void);
+void benchFs(void);
+void benchRomfs(void);
+void benchNet(void);
+void benchCrypto(void);
+void benchGfx(void);
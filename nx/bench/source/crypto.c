@@ -0,0 +1,28 @@
+// Crypto primitives, through the library's own throughput benchmark.
+#include <malloc.h>
+#include <stdio.h>
+#include "bench.h"
+
+#define BUFFER_SIZE 0x10000
+#define CPU_HZ 1020000000     // Default application clock: cycles/byte is only accurate at this clock.
+
+void benchCrypto(void)
+{
+    CryptoBenchmarkResult r;
+    char name[64];
+
+    void* buf = memalign(0x40, BUFFER_SIZE);
+    if (!buf)
+        return;
+
+    for (u32 i = 0; i < CryptoBenchmarkAlgorithm_Count; i++) {
+        if (R_FAILED(cryptoBenchmarkRun((CryptoBenchmarkAlgorithm)i, buf, BUFFER_SIZE, armNsToTicks(50000000), &r)))
+            continue;
+
+        snprintf(name, sizeof(name), "%s, 64KiB", cryptoBenchmarkGetAlgorithmName((CryptoBenchmarkAlgorithm)i));
+        benchReport("crypto", name, "cycles/byte", cryptoBenchmarkGetCyclesPerByte(&r, CPU_HZ), r.iterations);
+        benchReport("crypto", name, "MiB/s", cryptoBenchmarkGetMibPerSecond(&r), r.iterations);
+    }
+
+    free(buf);
+}
@@ -0,0 +1,64 @@
+// fsdev_read throughput on the SD card, through the POSIX layer, for a range of read sizes.
+#include <fcntl.h>
+#include <malloc.h>
+#include <stdio.h>
+#include <unistd.h>
+#include "bench.h"
+
+#define FILE_PATH "sdmc:/switch/libnx-bench.tmp"
+#define FILE_SIZE 0x1000000
+#define MAX_READ_SIZE 0x400000
+
+void benchFs(void)
+{
+    static const size_t sizes[] = { 0x200, 0x1000, 0x10000, 0x100000, MAX_READ_SIZE };
+    char name[64];
+
+    u8* buf = (u8*)memalign(0x1000, MAX_READ_SIZE);
+    if (!buf)
+        return;
+
+    for (size_t i = 0; i < MAX_READ_SIZE; i++)
+        buf[i] = i * 7;
+
+    int fd = open(FILE_PATH, O_WRONLY | O_CREAT | O_TRUNC);
+    if (fd < 0) {
+        free(buf);
+        return;
+    }
+
+    u64 start = armGetSystemTick();
+    bool ok = true;
+    for (size_t offset = 0; offset < FILE_SIZE && ok; offset += MAX_READ_SIZE)
+        ok = write(fd, buf, MAX_READ_SIZE) == MAX_READ_SIZE;
+    close(fd);
+    if (ok)
+        benchReport("fs", "write 4MiB chunks", "MiB/s", FILE_SIZE / 1048576.0 / (benchElapsedNs(start) / 1e9), FILE_SIZE / MAX_READ_SIZE);
+
+    for (u32 i = 0; ok && i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        fd = open(FILE_PATH, O_RDONLY);
+        if (fd < 0)
+            break;
+
+        // Small reads don't get through the whole file in a reasonable time.
+        size_t total = sizes[i] < 0x10000 ? FILE_SIZE / 16 : FILE_SIZE;
+        u64 reads = 0;
+        start = armGetSystemTick();
+        for (size_t offset = 0; offset < total; offset += sizes[i], reads++) {
+            if (read(fd, buf, sizes[i]) != (ssize_t)sizes[i]) {
+                ok = false;
+                break;
+            }
+        }
+        double elapsed = benchElapsedNs(start);
+        close(fd);
+
+        if (ok) {
+            snprintf(name, sizeof(name), "read 0x%zx", sizes[i]);
+            benchReport("fs", name, "MiB/s", total / 1048576.0 / (elapsed / 1e9), reads);
+        }
+    }
+
+    unlink(FILE_PATH);
+    free(buf);
+}
@@ -0,0 +1,29 @@
+// Framebuffer linear to block linear conversion, as done by framebufferEnd for linear framebuffers.
+#include <string.h>
+#include "bench.h"
+
+#define FRAMES 120
+
+void benchGfx(void)
+{
+    Framebuffer fb;
+    u32 stride;
+
+    if (R_FAILED(framebufferCreate(&fb, nwindowGetDefault(), 1280, 720, PIXEL_FORMAT_RGBA_8888, 2)))
+        return;
+
+    if (R_SUCCEEDED(framebufferMakeLinear(&fb))) {
+        u64 end_ticks = 0;
+        for (u32 i = 0; i < FRAMES; i++) {
+            u8* pixels = (u8*)framebufferBegin(&fb, &stride);
+            memset(pixels, i, stride * 720);
+
+            u64 start = armGetSystemTick();
+            framebufferEnd(&fb);
+            end_ticks += armGetSystemTick() - start;
+        }
+        benchReport("gfx", "framebufferEnd, linear 1280x720 RGBA8", "ns", (double)armTicksToNs(end_ticks) / FRAMES, FRAMES);
+    }
+
+    framebufferClose(&fb);
+}
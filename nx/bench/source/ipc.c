@@ -0,0 +1,46 @@
+// IPC round-trip latency, with commands which do next to no work in the service.
+#include "bench.h"
+
+static void setsysFirmwareVersion(void* arg)
+{
+    SetSysFirmwareVersion ver;
+    setsysGetFirmwareVersion(&ver);
+}
+
+static void setRegionCode(void* arg)
+{
+    SetRegion region;
+    setGetRegionCode(&region);
+}
+
+static void timeCurrentTime(void* arg)
+{
+    u64 timestamp;
+    timeGetCurrentTime(TimeType_UserSystemClock, &timestamp);
+}
+
+static void psmChargePercentage(void* arg)
+{
+    u32 percentage;
+    psmGetBatteryChargePercentage(&percentage);
+}
+
+void benchIpc(void)
+{
+    if (R_SUCCEEDED(setsysInitialize())) {
+        benchLoop("ipc", "set:sys GetFirmwareVersion", setsysFirmwareVersion, NULL, 200000000);
+        setsysExit();
+    }
+
+    if (R_SUCCEEDED(setInitialize())) {
+        benchLoop("ipc", "set GetRegionCode", setRegionCode, NULL, 200000000);
+        setExit();
+    }
+
+    benchLoop("ipc", "time GetCurrentTime (user clock)", timeCurrentTime, NULL, 200000000);
+
+    if (R_SUCCEEDED(psmInitialize())) {
+        benchLoop("ipc", "psm GetBatteryChargePercentage", psmChargePercentage, NULL, 200000000);
+        psmExit();
+    }
+}
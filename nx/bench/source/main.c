@@ -0,0 +1,133 @@
+// libnx benchmark suite: runs every benchmark once and writes the results as JSON,
+// to stdout (the console, or the nxlink host) and to sdmc:/switch/libnx-bench.json.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "bench.h"
+
+#define MAX_RESULTS 256
+#define REPORT_PATH "sdmc:/switch/libnx-bench.json"
+
+typedef struct {
+    const char* group;
+    const char* name;
+    const char* unit;
+    double value;
+    u64 iterations;
+} BenchResult;
+
+static BenchResult g_results[MAX_RESULTS];
+static u32 g_numResults;
+static bool g_consoleReady;
+
+void benchReport(const char* group, const char* name, const char* unit, double value, u64 iterations)
+{
+    if (g_numResults < MAX_RESULTS)
+        g_results[g_numResults++] = (BenchResult){ group, strdup(name), unit, value, iterations };
+
+    printf("%-8s %-48s %12.2f %s\n", group, name, value, unit);
+    if (g_consoleReady)
+        consoleUpdate(NULL);
+}
+
+void benchLoop(const char* group, const char* name, void (*fn)(void* arg), void* arg, u64 target_ns)
+{
+    // Warm up, then double the iterations until one batch takes long enough to be measured reliably.
+    for (u32 i = 0; i < 16; i++)
+        fn(arg);
+
+    u64 iterations = 16;
+    double elapsed = 0;
+    for (;;) {
+        u64 start = armGetSystemTick();
+        for (u64 i = 0; i < iterations; i++)
+            fn(arg);
+        elapsed = benchElapsedNs(start);
+        if (elapsed >= target_ns || iterations >= (1ULL << 30))
+            break;
+        iterations *= 2;
+    }
+
+    benchReport(group, name, "ns", elapsed / iterations, iterations);
+}
+
+static void writeJsonString(FILE* f, const char* s)
+{
+    fputc('"', f);
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\')
+            fputc('\\', f);
+        fputc(*s, f);
+    }
+    fputc('"', f);
+}
+
+static void writeReport(FILE* f)
+{
+    u32 ver = hosversionGet();
+
+    fprintf(f, "{\n  \"libnx\": \"%s\",\n", BENCH_LIBNX_VERSION);
+    fprintf(f, "  \"firmware\": \"%u.%u.%u\",\n", HOSVER_MAJOR(ver), HOSVER_MINOR(ver), HOSVER_MICRO(ver));
+    fprintf(f, "  \"results\": [\n");
+    for (u32 i = 0; i < g_numResults; i++) {
+        BenchResult* r = &g_results[i];
+        fprintf(f, "    {\"group\": ");
+        writeJsonString(f, r->group);
+        fprintf(f, ", \"name\": ");
+        writeJsonString(f, r->name);
+        fprintf(f, ", \"unit\": ");
+        writeJsonString(f, r->unit);
+        fprintf(f, ", \"value\": %.3f, \"iterations\": %llu}%s\n", r->value, (unsigned long long)r->iterations, i + 1 < g_numResults ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+}
+
+int main(int argc, char* argv[])
+{
+    // The framebuffer benchmark needs the default window, which the console takes over afterwards.
+    benchGfx();
+
+    consoleInit(NULL);
+    g_consoleReady = true;
+    socketInitializeDefault();
+    int nxlink_sock = nxlinkStdio();
+
+    printf("libnx %s benchmarks\n\n", BENCH_LIBNX_VERSION);
+    for (u32 i = 0; i < g_numResults; i++)
+        printf("%-8s %-48s %12.2f %s\n", g_results[i].group, g_results[i].name, g_results[i].value, g_results[i].unit);
+    consoleUpdate(NULL);
+
+    benchIpc();
+    benchSync();
+    benchFs();
+    benchRomfs();
+    benchNet();
+    benchCrypto();
+
+    printf("\n");
+    writeReport(stdout);
+
+    FILE* f = fopen(REPORT_PATH, "w");
+    if (f) {
+        writeReport(f);
+        fclose(f);
+        printf("\nWritten to %s\n", REPORT_PATH);
+    }
+    else
+        printf("\nFailed to write %s\n", REPORT_PATH);
+
+    printf("Press + to exit.\n");
+    while (appletMainLoop()) {
+        hidScanInput();
+        if (hidKeysDown(CONTROLLER_P1_AUTO) & KEY_PLUS)
+            break;
+        consoleUpdate(NULL);
+    }
+
+    if (nxlink_sock >= 0)
+        close(nxlink_sock);
+    socketExit();
+    consoleExit(NULL);
+    return 0;
+}
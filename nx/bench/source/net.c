@@ -0,0 +1,53 @@
+// bsdSend latency, with UDP datagrams sent to a socket bound on the loopback interface.
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "bench.h"
+
+#define ITERATIONS 2000
+
+void benchNet(void)
+{
+    static const size_t sizes[] = { 64, 1024 };
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    socklen_t addr_len = sizeof(addr);
+    char buf[1024] = {0};
+    char name[64];
+
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0)
+        return;
+
+    // Connected to itself, so that each datagram can be read back right away and the socket buffer never fills up.
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 ||
+        getsockname(fd, (struct sockaddr*)&addr, &addr_len) != 0 ||
+        connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return;
+    }
+
+    for (u32 i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        u64 send_ticks = 0;
+        u64 start = armGetSystemTick();
+        u32 done = 0;
+        for (; done < ITERATIONS; done++) {
+            u64 send_start = armGetSystemTick();
+            if (send(fd, buf, sizes[i], 0) != (ssize_t)sizes[i])
+                break;
+            send_ticks += armGetSystemTick() - send_start;
+            if (recv(fd, buf, sizeof(buf), 0) < 0)
+                break;
+        }
+        double elapsed = benchElapsedNs(start);
+
+        if (done == ITERATIONS) {
+            snprintf(name, sizeof(name), "send, UDP loopback %zuB", sizes[i]);
+            benchReport("net", name, "ns", (double)armTicksToNs(send_ticks) / ITERATIONS, ITERATIONS);
+            snprintf(name, sizeof(name), "send+recv, UDP loopback %zuB", sizes[i]);
+            benchReport("net", name, "ns", elapsed / ITERATIONS, ITERATIONS);
+        }
+    }
+
+    close(fd);
+}
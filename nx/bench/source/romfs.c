@@ -0,0 +1,53 @@
+// RomFS path lookups, on the small tree in the romfs directory of the benchmark.
+#include <dirent.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include "bench.h"
+
+static void statShallow(void* arg)
+{
+    struct stat st;
+    stat("romfs:/small.txt", &st);
+}
+
+static void statDeep(void* arg)
+{
+    struct stat st;
+    stat("romfs:/a/b/c/deep.txt", &st);
+}
+
+static void statMissing(void* arg)
+{
+    struct stat st;
+    stat("romfs:/a/b/c/missing.txt", &st);
+}
+
+static void openClose(void* arg)
+{
+    FILE* f = fopen("romfs:/a/b/c/deep.txt", "r");
+    if (f)
+        fclose(f);
+}
+
+static void listRoot(void* arg)
+{
+    DIR* dir = opendir("romfs:/");
+    if (dir) {
+        while (readdir(dir));
+        closedir(dir);
+    }
+}
+
+void benchRomfs(void)
+{
+    if (R_FAILED(romfsInit()))
+        return;
+
+    benchLoop("romfs", "stat, depth 1", statShallow, NULL, 100000000);
+    benchLoop("romfs", "stat, depth 4", statDeep, NULL, 100000000);
+    benchLoop("romfs", "stat, missing file", statMissing, NULL, 100000000);
+    benchLoop("romfs", "fopen+fclose, depth 4", openClose, NULL, 100000000);
+    benchLoop("romfs", "opendir+readdir+closedir of /", listRoot, NULL, 100000000);
+
+    romfsExit();
+}
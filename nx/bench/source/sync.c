@@ -0,0 +1,59 @@
+// Mutex lock/unlock cost, uncontended and with threads hammering the same mutex from other cores.
+#include "bench.h"
+
+#define CONTENDED_ITERATIONS 200000
+
+static Mutex g_mutex;
+static u64 g_counter;
+
+static void mutexUncontended(void* arg)
+{
+    mutexLock(&g_mutex);
+    g_counter++;
+    mutexUnlock(&g_mutex);
+}
+
+static void contendedThread(void* arg)
+{
+    for (u32 i = 0; i < CONTENDED_ITERATIONS; i++) {
+        mutexLock(&g_mutex);
+        g_counter++;
+        mutexUnlock(&g_mutex);
+    }
+}
+
+static void benchContended(u32 num_threads)
+{
+    Thread threads[3];
+    char name[64];
+    u32 started = 0;
+
+    u64 start = armGetSystemTick();
+    for (u32 i = 0; i < num_threads; i++) {
+        if (R_FAILED(threadCreate(&threads[i], contendedThread, NULL, NULL, 0x4000, 0x2C, i)))
+            break;
+        if (R_FAILED(threadStart(&threads[i]))) {
+            threadClose(&threads[i]);
+            break;
+        }
+        started++;
+    }
+    for (u32 i = 0; i < started; i++) {
+        threadWaitForExit(&threads[i]);
+        threadClose(&threads[i]);
+    }
+    double elapsed = benchElapsedNs(start);
+
+    if (started == num_threads) {
+        snprintf(name, sizeof(name), "mutexLock+mutexUnlock, %u threads contended", (unsigned)num_threads);
+        benchReport("sync", name, "ns", elapsed / (CONTENDED_ITERATIONS * num_threads), CONTENDED_ITERATIONS * num_threads);
+    }
+}
+
+void benchSync(void)
+{
+    mutexInit(&g_mutex);
+    benchLoop("sync", "mutexLock+mutexUnlock, uncontended", mutexUncontended, NULL, 100000000);
+    benchContended(2);
+    benchContended(3);
+}
@@ -24,6 +24,7 @@ extern "C" {
 #include "switch/kernel/wait.h"
 #include "switch/kernel/tmem.h"
 #include "switch/kernel/shmem.h"
+#include "switch/kernel/ring_channel.h"
 #include "switch/kernel/mutex.h"
 #include "switch/kernel/event.h"
 #include "switch/kernel/uevent.h"
@@ -32,16 +33,28 @@ extern "C" {
 #include "switch/kernel/condvar.h"
 #include "switch/kernel/thread.h"
 #include "switch/kernel/semaphore.h"
+#include "switch/kernel/latch.h"
 #include "switch/kernel/virtmem.h"
 #include "switch/kernel/detect.h"
 #include "switch/kernel/random.h"
 #include "switch/kernel/jit.h"
+#include "switch/kernel/jit_cache.h"
+#include "switch/kernel/futex.h"
 #include "switch/kernel/barrier.h"
+#include "switch/kernel/task_scheduler.h"
+#include "switch/kernel/queue.h"
+#include "switch/kernel/timer_wheel.h"
+#include "switch/kernel/wait_set.h"
+#include "switch/kernel/fiber.h"
 
 #include "switch/sf/hipc.h"
 #include "switch/sf/cmif.h"
 #include "switch/sf/service.h"
 #include "switch/sf/sessionmgr.h"
+#include "switch/sf/batch.h"
+#include "switch/sf/async_dispatch.h"
+#include "switch/sf/trace.h"
+#include "switch/sf/server.h"
 
 #include "switch/services/sm.h"
 #include "switch/services/smm.h"
@@ -49,6 +62,7 @@ extern "C" {
 #include "switch/services/fsldr.h"
 #include "switch/services/fspr.h"
 #include "switch/services/acc.h"
+#include "switch/services/acc_cache.h"
 #include "switch/services/apm.h"
 #include "switch/services/applet.h"
 #include "switch/services/async.h"
@@ -58,49 +72,72 @@ extern "C" {
 #include "switch/services/auddev.h"
 #include "switch/services/hwopus.h"
 #include "switch/services/csrng.h"
+#include "switch/services/csrng_pool.h"
 #include "switch/services/lbl.h"
 #include "switch/services/i2c.h"
+#include "switch/services/i2c_poller.h"
 #include "switch/services/gpio.h"
 #include "switch/services/bpc.h"
 #include "switch/services/pcv.h"
 #include "switch/services/clkrst.h"
+#include "switch/services/clk_governor.h"
 #include "switch/services/psm.h"
 #include "switch/services/spsm.h"
 //#include "switch/services/bsd.h" Use <sys/socket.h> instead
 //#include "switch/services/sfdnsres.h" Use <netdb.h> instead
 #include "switch/services/fatal.h"
 #include "switch/services/time.h"
+#include "switch/services/time_zone.h"
 #include "switch/services/usb.h"
 #include "switch/services/usbds.h"
 #include "switch/services/usbhs.h"
+#include "switch/services/usbhs_stream.h"
 #include "switch/services/hid.h"
+#include "switch/services/hid_sampler.h"
+#include "switch/services/hid_watcher.h"
+#include "switch/services/hid_vibration.h"
 #include "switch/services/hiddbg.h"
+#include "switch/services/hiddbg_injector.h"
 #include "switch/services/hidsys.h"
 #include "switch/services/irs.h"
+#include "switch/services/irs_stream.h"
 #include "switch/services/pl.h"
+#include "switch/services/pl_glyph_cache.h"
 #include "switch/services/vi.h"
 #include "switch/services/nv.h"
 #include "switch/services/nifm.h"
+#include "switch/services/nifm_monitor.h"
 #include "switch/services/ns.h"
+#include "switch/services/ns_metadata.h"
 #include "switch/services/ldr.h"
 #include "switch/services/ro.h"
+#include "switch/services/ro_plugin.h"
 #include "switch/services/ts.h"
 #include "switch/services/pm.h"
 #include "switch/services/set.h"
+#include "switch/services/set_cache.h"
 #include "switch/services/lr.h"
+#include "switch/services/lr_cache.h"
 #include "switch/services/spl.h"
 #include "switch/services/ncm.h"
+#include "switch/services/ncm_install.h"
+#include "switch/services/ncm_meta_list.h"
 #include "switch/services/psc.h"
 #include "switch/services/caps.h"
 #include "switch/services/capsa.h"
 #include "switch/services/capsu.h"
+#include "switch/services/capsu_gallery.h"
 #include "switch/services/capssc.h"
+#include "switch/services/capssc_capture.h"
 #include "switch/services/capssu.h"
 #include "switch/services/nfc.h"
+#include "switch/services/nfp_detector.h"
 #include "switch/services/wlaninf.h"
 #include "switch/services/pctl.h"
 #include "switch/services/pdm.h"
+#include "switch/services/pdm_index.h"
 #include "switch/services/grc.h"
+#include "switch/services/grc_capture.h"
 #include "switch/services/friends.h"
 #include "switch/services/notif.h"
 
@@ -109,17 +146,28 @@ extern "C" {
 #include "switch/display/buffer_producer.h"
 #include "switch/display/native_window.h"
 #include "switch/display/framebuffer.h"
+#include "switch/display/framebuffer_2d.h"
 
 #include "switch/nvidia/ioctl.h"
 #include "switch/nvidia/graphic_buffer.h"
 #include "switch/nvidia/fence.h"
 #include "switch/nvidia/map.h"
 #include "switch/nvidia/address_space.h"
+#include "switch/nvidia/heap.h"
 #include "switch/nvidia/channel.h"
 #include "switch/nvidia/gpu.h"
+#include "switch/nvidia/render_target.h"
 #include "switch/nvidia/gpu_channel.h"
+#include "switch/nvidia/cmd_ring.h"
 
 #include "switch/audio/driver.h"
+#include "switch/audio/stream.h"
+#include "switch/audio/mixer.h"
+#include "switch/audio/audout_queue.h"
+#include "switch/audio/opus_stream.h"
+#include "switch/audio/audin_ring.h"
+#include "switch/audio/sample_bank.h"
+#include "switch/audio/dsp.h"
 
 #include "switch/applets/libapplet.h"
 #include "switch/applets/album_la.h"
@@ -133,14 +181,31 @@ extern "C" {
 
 #include "switch/runtime/env.h"
 #include "switch/runtime/hosversion.h"
+#include "switch/runtime/init.h"
+#include "switch/runtime/mt_heap.h"
+#include "switch/runtime/arena.h"
+#include "switch/runtime/object_pool.h"
+#include "switch/runtime/large_buffer.h"
+#include "switch/runtime/mem_pressure.h"
+#include "switch/runtime/heap_profile.h"
+#include "switch/runtime/cpu_profile.h"
+#include "switch/runtime/trace.h"
+#include "switch/runtime/flight_recorder.h"
 #include "switch/runtime/nxlink.h"
+#include "switch/runtime/async_log.h"
 #include "switch/runtime/resolver.h"
+#include "switch/runtime/http.h"
+#include "switch/runtime/fs_async.h"
+#include "switch/runtime/crypto_storage.h"
+#include "switch/runtime/integrity_storage.h"
 
 #include "switch/runtime/util/utf.h"
 
 #include "switch/runtime/devices/console.h"
 #include "switch/runtime/devices/usb_comms.h"
+#include "switch/runtime/devices/usb_msd.h"
 #include "switch/runtime/devices/fs_dev.h"
+#include "switch/runtime/devices/fs_log.h"
 #include "switch/runtime/devices/romfs_dev.h"
 #include "switch/runtime/devices/socket.h"
 
@@ -148,13 +213,18 @@ extern "C" {
 #include "switch/crypto/aes_cbc.h"
 #include "switch/crypto/aes_ctr.h"
 #include "switch/crypto/aes_xts.h"
+#include "switch/crypto/aes_gcm.h"
 #include "switch/crypto/cmac.h"
+#include "switch/crypto/chacha20.h"
 
 #include "switch/crypto/sha256.h"
+#include "switch/crypto/sha512.h"
 #include "switch/crypto/sha1.h"
+#include "switch/crypto/rsa.h"
 #include "switch/crypto/hmac.h"
 
 #include "switch/crypto/crc.h"
+#include "switch/crypto/benchmark.h"
 
 #ifdef __cplusplus
 }
@@ -7,6 +7,7 @@
 #pragma once
 #include "../types.h"
 #include "../services/applet.h"
+#include "../kernel/thread.h"
 
 /// CommonArguments
 typedef struct {
@@ -20,6 +21,37 @@ typedef struct {
     u64 tick;                ///< System tick. Set to the output from \ref armGetSystemTick during \ref libappletArgsPush.
 } LibAppletArgs;
 
+/// Payloads of at least this size are sent with TransferMemory storages by \ref libappletStorageWriterCreate.
+#define LIBAPPLET_TMEM_STORAGE_THRESHOLD 0x4000
+
+/// Writer building a storage directly in memory, see \ref libappletStorageWriterCreate.
+typedef struct {
+    u8* data;                ///< Memory to write the payload to.
+    size_t size;             ///< Size of the memory, rounded up to 0x1000-bytes for TransferMemory storages.
+    bool tmem;               ///< Whether a TransferMemory storage is used.
+    bool writable;           ///< Whether the TransferMemory storage is writable by the other side.
+} LibAppletStorageWriter;
+
+/// LibraryApplet created ahead of time, see \ref libappletPrepare.
+typedef struct {
+    AppletHolder holder;     ///< AppletHolder, with the input storages already pushed.
+    AppletId id;             ///< \ref AppletId
+    LibAppletArgs commonargs; ///< Copy of the \ref LibAppletArgs.
+    void* arg;               ///< Copy of the input storage data, used by \ref libappletPrepareAsync.
+    size_t arg_size;         ///< Size of the input storage data.
+    Thread thread;           ///< Thread used by \ref libappletPrepareAsync.
+    bool async;              ///< Whether thread is running.
+    Result rc;               ///< Result of the preparation.
+} LibAppletPrepared;
+
+/// Reader accessing a storage directly in memory, see \ref libappletStorageReaderOpen.
+typedef struct {
+    AppletStorage s;         ///< Storage.
+    u8* data;                ///< Payload.
+    size_t size;             ///< Size of the payload.
+    bool mapped;             ///< Whether the payload is the mapped TransferMemory of the storage, rather than a copy.
+} LibAppletStorageReader;
+
 /**
  * @brief Creates a LibAppletArgs struct.
  * @param a LibAppletArgs struct.
@@ -51,6 +83,36 @@ Result libappletCreateWriteStorage(AppletStorage* s, const void* buffer, size_t
  */
 Result libappletReadStorage(AppletStorage* s, void* buffer, size_t size, size_t *transfer_size);
 
+/**
+ * @brief Allocates the memory for building a storage in place, to avoid copying large payloads through IPC buffers.
+ * @param[out] w Writer object. The payload is then written to w->data.
+ * @param size Size of the payload.
+ * @param writable Whether the other side can write to the storage, when a TransferMemory storage is used.
+ * @note Payloads of at least \ref LIBAPPLET_TMEM_STORAGE_THRESHOLD bytes use \ref appletCreateTransferMemoryStorage on page-aligned memory, which extends the payload with zeroes to a multiple of 0x1000-bytes. Smaller ones use \ref appletCreateStorage with a single \ref appletStorageWrite.
+ * @note TransferMemory storages are only accepted by LibraryApplets where they expect one (or by ones reading them with \ref libappletStorageReaderOpen).
+ */
+Result libappletStorageWriterCreate(LibAppletStorageWriter* w, size_t size, bool writable);
+
+/**
+ * @brief Creates the storage from the payload written to a writer. The writer can't be used afterwards.
+ * @param w Writer object.
+ * @param[out] s Storage object. For TransferMemory storages, the payload memory can only be accessed again after \ref appletStorageCloseTmem, which frees it and must be used once the other side is done with the storage.
+ */
+Result libappletStorageWriterFinish(LibAppletStorageWriter* w, AppletStorage* s);
+
+/// Frees the memory of a writer without creating the storage.
+void libappletStorageWriterCancel(LibAppletStorageWriter* w);
+
+/**
+ * @brief Opens a storage for reading it in place. TransferMemory storages are mapped with \ref appletStorageMap, others are read into a buffer with a single \ref appletStorageRead.
+ * @param[out] r Reader object. The payload is then available from r->data and r->size.
+ * @param s Storage, which is owned by the reader afterwards (even on failure).
+ */
+Result libappletStorageReaderOpen(LibAppletStorageReader* r, AppletStorage* s);
+
+/// Closes a reader and its storage.
+void libappletStorageReaderClose(LibAppletStorageReader* r);
+
 /**
  * @brief Sets the tick field in LibAppletArgs, then creates a storage with it which is pushed to the AppletHolder via \ref appletHolderPushInData.
  * @param a LibAppletArgs struct.
@@ -106,6 +168,44 @@ Result libappletStart(AppletHolder *h);
  */
 Result libappletLaunch(AppletId id, LibAppletArgs *commonargs, const void* arg, size_t arg_size, void* reply, size_t reply_size, size_t *out_reply_size);
 
+/**
+ * @brief Does the first half of \ref libappletLaunch ahead of time: creates the LibraryApplet and pushes its input storages, without starting it. \ref libappletShow then only has to start it.
+ * @param[out] p LibAppletPrepared object.
+ * @param id \ref AppletId
+ * @param commonargs \ref LibAppletArgs struct. Its tick field is set at this point, rather than when the applet is shown.
+ * @param arg Input storage data buffer. Optional, can be NULL.
+ * @param arg_size Size of the arg buffer.
+ */
+Result libappletPrepare(LibAppletPrepared* p, AppletId id, LibAppletArgs *commonargs, const void* arg, size_t arg_size);
+
+/**
+ * @brief Same as \ref libappletPrepare, but done by a background thread, for example while the user is hovering a text field. The input data is copied, so the buffers don't need to be kept around.
+ * @param[out] p LibAppletPrepared object.
+ * @param id \ref AppletId
+ * @param commonargs \ref LibAppletArgs struct.
+ * @param arg Input storage data buffer. Optional, can be NULL.
+ * @param arg_size Size of the arg buffer.
+ * @param prio Priority of the thread.
+ * @param cpuid Core of the thread, or -2 for the default core.
+ * @return Result code of the thread creation. The result of the preparation itself is returned by \ref libappletShow or \ref libappletPreparedWait.
+ */
+Result libappletPrepareAsync(LibAppletPrepared* p, AppletId id, LibAppletArgs *commonargs, const void* arg, size_t arg_size, int prio, int cpuid);
+
+/// Waits for \ref libappletPrepareAsync to finish, and returns the result of the preparation.
+Result libappletPreparedWait(LibAppletPrepared* p);
+
+/**
+ * @brief Shows a LibraryApplet prepared with \ref libappletPrepare or \ref libappletPrepareAsync: uses \ref libappletStart, reads the output storage reply data via \ref libappletPopOutData, then closes it.
+ * @param p LibAppletPrepared object, which is closed afterwards (even on failure).
+ * @param reply Output storage data buffer. Optional, can be NULL.
+ * @param reply_size Size to read for the reply buffer.
+ * @param out_reply_size Actual read reply data size, see \ref libappletPopOutData.
+ */
+Result libappletShow(LibAppletPrepared* p, void* reply, size_t reply_size, size_t *out_reply_size);
+
+/// Closes a prepared LibraryApplet without showing it.
+void libappletPreparedClose(LibAppletPrepared* p);
+
 /// Wrapper for \ref appletPushToGeneralChannel, see appletPushToGeneralChannel regarding the requirements for using this.
 /// Returns to the main Home Menu, equivalent to pressing the HOME button.
 Result libappletRequestHomeMenu(void);
@@ -7,12 +7,19 @@
 #pragma once
 #include "../types.h"
 
+/// Buffer for \ref armDCacheFlushRanges and \ref armDCacheCleanRanges.
+typedef struct {
+    void* addr;     ///< Address of the buffer.
+    size_t size;    ///< Size of the buffer, in bytes.
+} ArmCacheRange;
+
 /**
  * @brief Performs a data cache flush on the specified buffer.
  * @param addr Address of the buffer.
  * @param size Size of the buffer, in bytes.
  * @remarks Cache flush is defined as Clean + Invalidate.
  * @note The start and end addresses of the buffer are forcibly rounded to cache line boundaries (read from CTR_EL0 system register).
+ * @note Buffers of at least __nx_dcache_entire_flush_threshold bytes (weak symbol, 2MiB by default, 0 to disable) flush the entire data cache with \ref svcFlushEntireDataCache when it's available.
  */
 void armDCacheFlush(void* addr, size_t size);
 
@@ -21,9 +28,26 @@ void armDCacheFlush(void* addr, size_t size);
  * @param addr Address of the buffer.
  * @param size Size of the buffer, in bytes.
  * @note The start and end addresses of the buffer are forcibly rounded to cache line boundaries (read from CTR_EL0 system register).
+ * @note Like \ref armDCacheFlush, large buffers flush the entire data cache when possible.
  */
 void armDCacheClean(void* addr, size_t size);
 
+/**
+ * @brief Performs a data cache flush on several buffers, with a single barrier at the end.
+ * @param ranges Buffers.
+ * @param count Number of buffers.
+ * @note The total size is what's compared against the threshold of \ref armDCacheFlush.
+ */
+void armDCacheFlushRanges(const ArmCacheRange* ranges, size_t count);
+
+/**
+ * @brief Performs a data cache clean on several buffers, with a single barrier at the end.
+ * @param ranges Buffers.
+ * @param count Number of buffers.
+ * @note The total size is what's compared against the threshold of \ref armDCacheFlush.
+ */
+void armDCacheCleanRanges(const ArmCacheRange* ranges, size_t count);
+
 /**
  * @brief Performs an instruction cache invalidation clean on the specified buffer.
  * @param addr Address of the buffer.
@@ -42,5 +42,6 @@ static inline u64 armNsToTicks(u64 ns) {
  * @return Time in nanoseconds.
  */
 static inline u64 armTicksToNs(u64 tick) {
-    return (tick * 625) / 12;
+    // 625/12 = 52 + 1/12, the fraction being a 0.64 fixed-point multiply. Exact, and doesn't overflow before ~580 years of ticks, unlike tick * 625.
+    return tick * 52 + (u64)(((unsigned __int128)tick * 0x1555555555555556ULL) >> 64);
 }
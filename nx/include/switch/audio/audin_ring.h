@@ -0,0 +1,44 @@
+/**
+ * @file audin_ring.h
+ * @brief Continuous audin capture into a ring of pre-queued buffers, read in place.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "../types.h"
+#include "../services/audin.h"
+
+/// Maximum number of buffers of an \ref AudioInRing.
+#define AUDIN_RING_MAX_BUFFERS 8
+
+/// Audin capture ring.
+typedef struct {
+    AudioInBuffer buffers[AUDIN_RING_MAX_BUFFERS];
+    void* mem;
+    u32 num_buffers;
+    AudioInBuffer* cur;         ///< Captured buffer being read, NULL if none.
+    u64 cur_offset;             ///< Offset of the unread data in cur.
+} AudioInRing;
+
+/**
+ * @brief Creates a capture ring, queues all of its buffers and starts audin.
+ * @param[out] r AudioInRing object.
+ * @param[in] buffer_frames Frames per buffer.
+ * @param[in] num_buffers Number of buffers, between 2 and \ref AUDIN_RING_MAX_BUFFERS. Capture is continuous as long as one of them is always queued.
+ * @return Result code.
+ * @note audin must be initialized.
+ */
+Result audinRingCreate(AudioInRing* r, u32 buffer_frames, u32 num_buffers);
+
+/// Stops audin and frees the buffers.
+void audinRingClose(AudioInRing* r);
+
+/**
+ * @brief Gets the next captured data, in place.
+ * @param[out] out_ptr Start of the data, interleaved samples in the audin format.
+ * @param[in] timeout Time to wait for a buffer to be captured, in nanoseconds, UINT64_MAX to wait indefinitely.
+ * @return Size of the data in bytes, 0 on timeout. The data stays valid until \ref audinRingCommitRead.
+ */
+size_t audinRingGetReadSpan(AudioInRing* r, const void** out_ptr, u64 timeout);
+
+/// Releases size bytes of the span returned by \ref audinRingGetReadSpan. Fully read buffers are queued for capture again right away.
+Result audinRingCommitRead(AudioInRing* r, size_t size);
@@ -0,0 +1,72 @@
+/**
+ * @file audout_queue.h
+ * @brief Managed ring of audout buffers, keeping as few of them queued as possible without underruns.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "../types.h"
+#include "../services/audout.h"
+
+/// Maximum number of buffers of an \ref AudioOutQueue.
+#define AUDOUT_QUEUE_MAX_BUFFERS 8
+
+/// Number of buffers released in a row without underrun or late release before the queue depth is lowered.
+#define AUDOUT_QUEUE_SHRINK_PERIOD 500
+
+/// Audout buffer queue.
+typedef struct {
+    AudioOutBuffer buffers[AUDOUT_QUEUE_MAX_BUFFERS];
+    AudioOutBuffer* free_buffers[AUDOUT_QUEUE_MAX_BUFFERS];
+    void* mem;
+    u32 num_free;
+    u32 num_queued;
+    u32 buffer_frames;
+    u32 min_depth;
+    u32 max_depth;
+    u32 depth;                  ///< Current target number of queued buffers.
+    u32 stable_count;           ///< Buffers released on time since the depth last changed.
+    u32 underrun_count;
+    u32 late_count;             ///< Releases more than 1.5 buffer durations apart, without running dry.
+    u64 buffer_ticks;           ///< Duration of a buffer, in system ticks.
+    u64 last_release_tick;
+} AudioOutQueue;
+
+/**
+ * @brief Creates an audout buffer queue, and starts audout.
+ * @param[out] q AudioOutQueue object.
+ * @param[in] buffer_frames Frames per buffer.
+ * @param[in] min_depth Minimum number of queued buffers, at least 2.
+ * @param[in] max_depth Maximum number of queued buffers, up to \ref AUDOUT_QUEUE_MAX_BUFFERS.
+ * @return Result code.
+ * @note audout must be initialized. The depth starts at min_depth, goes up on each underrun or late release, and back down after \ref AUDOUT_QUEUE_SHRINK_PERIOD releases on time.
+ */
+Result audoutQueueCreate(AudioOutQueue* q, u32 buffer_frames, u32 min_depth, u32 max_depth);
+
+/// Stops audout and frees the buffers.
+void audoutQueueClose(AudioOutQueue* q);
+
+/**
+ * @brief Gets a buffer to fill, once less than the target depth of buffers are queued.
+ * @param[in] timeout Timeout in nanoseconds, UINT64_MAX to wait indefinitely.
+ * @return The buffer, with room for buffer_frames frames, or NULL on timeout.
+ */
+AudioOutBuffer* audoutQueueAcquire(AudioOutQueue* q, u64 timeout);
+
+/**
+ * @brief Queues a buffer returned by \ref audoutQueueAcquire.
+ * @param[in] data_size Size of the data written to the buffer.
+ * @return Result code.
+ */
+Result audoutQueueSubmit(AudioOutQueue* q, AudioOutBuffer* buf, u64 data_size);
+
+/// Gets the number of underruns seen so far.
+static inline u32 audoutQueueGetUnderrunCount(AudioOutQueue* q)
+{
+    return q->underrun_count;
+}
+
+/// Gets the current target latency, in frames.
+static inline u32 audoutQueueGetLatencyFrames(AudioOutQueue* q)
+{
+    return q->depth * q->buffer_frames;
+}
@@ -6,6 +6,8 @@
  */
 #pragma once
 #include "../services/audren.h"
+#include "../kernel/thread.h"
+#include "../kernel/queue.h"
 
 typedef struct AudioDriverEtc AudioDriverEtc;
 
@@ -23,6 +25,30 @@ Result audrvCreate(AudioDriver* d, const AudioRendererConfig* config, int num_fi
 Result audrvUpdate(AudioDriver* d);
 void audrvClose(AudioDriver* d);
 
+//-----------------------------------------------------------------------------
+// Performance metrics, available when the renderer was initialized with num_perf_frames set.
+
+typedef struct {
+    u32 num_frames;                 ///< Number of frames rendered since the previous update.
+    u32 total_processing_time;      ///< Processing time of the last frame, in microseconds.
+    u32 voice_processing_time;      ///< Processing time of the voices in the last frame, in microseconds.
+    u32 mix_processing_time;        ///< Processing time of the submixes and final mix in the last frame, in microseconds.
+    u32 sink_processing_time;       ///< Processing time of the sinks in the last frame, in microseconds.
+    u32 voice_drop_count;           ///< Voices dropped over all the frames since the previous update, for lack of time.
+} AudioDriverPerformanceInfo;
+
+/// Gets the performance summary from the last \ref audrvUpdate, returns false if there is none.
+bool audrvGetPerformanceInfo(AudioDriver* d, AudioDriverPerformanceInfo* out);
+
+/// Gets the processing time of a node (voice, mix or sink) in the last frame, in microseconds.
+u32 audrvGetNodeProcessingTime(AudioDriver* d, u32 node_id);
+
+/// Sets the node for which the renderer reports a breakdown of its processing, see \ref audrvGetPerformanceDetails.
+void audrvSetPerformanceDetailTarget(AudioDriver* d, u32 node_id);
+
+/// Gets the processing breakdown of the detail target in the last frame.
+const AudioRendererPerformanceDetail* audrvGetPerformanceDetails(AudioDriver* d, u32* out_count);
+
 //-----------------------------------------------------------------------------
 
 int audrvMemPoolAdd(AudioDriver* d, void* buffer, size_t size);
@@ -69,6 +95,12 @@ u32 audrvVoiceGetPlayedSampleCount(AudioDriver* d, int id);
 u32 audrvVoiceGetVoiceDropsCount(AudioDriver* d, int id);
 void audrvVoiceSetBiquadFilter(AudioDriver* d, int id, int biquad_id, float a0, float a1, float a2, float b0, float b1, float b2);
 
+/// Gets the processing time of a voice in the last frame, in microseconds.
+static inline u32 audrvVoiceGetProcessingTime(AudioDriver* d, int id)
+{
+    return audrvGetNodeProcessingTime(d, d->in_voices[id].node_id);
+}
+
 static inline void audrvVoiceSetExtraParams(AudioDriver* d, int id, const void* params, size_t params_size)
 {
     d->in_voices[id].extra_params_ptr = params;
@@ -138,7 +170,127 @@ static inline void audrvMixSetVolume(AudioDriver* d, int id, float volume)
     d->in_mixes[id].volume = volume;
 }
 
+/// Gets the processing time of a mix in the last frame, in microseconds.
+static inline u32 audrvMixGetProcessingTime(AudioDriver* d, int id)
+{
+    return audrvGetNodeProcessingTime(d, d->in_mixes[id].node_id);
+}
+
 //-----------------------------------------------------------------------------
 
 int audrvDeviceSinkAdd(AudioDriver* d, const char* device_name, int num_channels, const u8* channel_ids);
 void audrvSinkRemove(AudioDriver* d, int id);
+
+//-----------------------------------------------------------------------------
+// Managed mode: the driver is owned by a dedicated thread running the audrvUpdate/audrenWaitFrame loop,
+// and other threads send it voice operations through a lock-free queue instead of sharing a mutex.
+
+typedef enum {
+    AudioDriverCmdType_VoiceAddWaveBuf,
+    AudioDriverCmdType_VoiceSetVolume,
+    AudioDriverCmdType_VoiceSetPitch,
+    AudioDriverCmdType_VoiceSetPaused,
+    AudioDriverCmdType_VoiceStop,
+    AudioDriverCmdType_VoiceSetMixFactor,
+    AudioDriverCmdType_Call,                ///< Runs a function on the audio thread, for anything else.
+} AudioDriverCmdType;
+
+typedef struct {
+    AudioDriverCmdType type;
+    int voice_id;
+    union {
+        AudioDriverWaveBuf* wavebuf;
+        float value;
+        bool paused;
+        struct {
+            float factor;
+            int src_channel_id;
+            int dest_channel_id;
+        } mix_factor;
+        struct {
+            void (*func)(AudioDriver* d, void* arg);
+            void* arg;
+        } call;
+    };
+} AudioDriverCmd;
+
+typedef struct {
+    AudioDriver* driver;
+    Thread thread;
+    MpmcQueue queue;
+    void (*frame_cb)(AudioDriver* d, void* arg);
+    void* frame_arg;
+    Result last_result;                     ///< Result of the last \ref audrvUpdate.
+    bool exit;
+} AudioDriverThread;
+
+/**
+ * @brief Starts running an \ref AudioDriver on a dedicated thread.
+ * @param[out] t AudioDriverThread object.
+ * @param[in] d Audio driver, set up (voices, mixes, sinks, mempools) beforehand. From then on, it must only be accessed from the audio thread, i.e. with commands or from frame_cb.
+ * @param[in] queue_capacity Maximum number of pending commands, a power of two.
+ * @param[in] prio Thread priority, a high one (low value) such as 0x1C to avoid underruns.
+ * @param[in] cpuid Core the thread is pinned to.
+ * @param[in] frame_cb Optional function called on the audio thread every frame, after the commands and before \ref audrvUpdate (e.g. to refill streaming voices).
+ * @param[in] frame_arg Argument passed to frame_cb.
+ * @return Result code.
+ * @note The state of wavebufs added through commands is updated on the audio thread, read it with __atomic_load_n or use a \ref AudioDriverCmdType_Call command.
+ */
+Result audrvThreadCreate(AudioDriverThread* t, AudioDriver* d, u32 queue_capacity, int prio, int cpuid, void (*frame_cb)(AudioDriver* d, void* arg), void* frame_arg);
+
+/// Stops the audio thread, dropping the commands not run yet. The driver can then be used (or closed) from the calling thread again.
+void audrvThreadClose(AudioDriverThread* t);
+
+/**
+ * @brief Sends a command to the audio thread, which runs it before its next update. Thread-safe and lock-free.
+ * @param[in] timeout Time to wait for room in the queue if it's full, in nanoseconds (0 to fail right away).
+ * @return Result code. KERNELRESULT(TimedOut) if the queue stayed full.
+ */
+static inline Result audrvThreadPush(AudioDriverThread* t, const AudioDriverCmd* cmd, u64 timeout)
+{
+    if (mpmcQueueTryPush(&t->queue, cmd))
+        return 0;
+    return timeout ? mpmcQueuePush(&t->queue, cmd, timeout) : KERNELRESULT(TimedOut);
+}
+
+static inline Result audrvThreadVoiceAddWaveBuf(AudioDriverThread* t, int id, AudioDriverWaveBuf* wavebuf, u64 timeout)
+{
+    AudioDriverCmd cmd = { .type = AudioDriverCmdType_VoiceAddWaveBuf, .voice_id = id, .wavebuf = wavebuf };
+    return audrvThreadPush(t, &cmd, timeout);
+}
+
+static inline Result audrvThreadVoiceSetVolume(AudioDriverThread* t, int id, float volume, u64 timeout)
+{
+    AudioDriverCmd cmd = { .type = AudioDriverCmdType_VoiceSetVolume, .voice_id = id, .value = volume };
+    return audrvThreadPush(t, &cmd, timeout);
+}
+
+static inline Result audrvThreadVoiceSetPitch(AudioDriverThread* t, int id, float pitch, u64 timeout)
+{
+    AudioDriverCmd cmd = { .type = AudioDriverCmdType_VoiceSetPitch, .voice_id = id, .value = pitch };
+    return audrvThreadPush(t, &cmd, timeout);
+}
+
+static inline Result audrvThreadVoiceSetPaused(AudioDriverThread* t, int id, bool paused, u64 timeout)
+{
+    AudioDriverCmd cmd = { .type = AudioDriverCmdType_VoiceSetPaused, .voice_id = id, .paused = paused };
+    return audrvThreadPush(t, &cmd, timeout);
+}
+
+static inline Result audrvThreadVoiceStop(AudioDriverThread* t, int id, u64 timeout)
+{
+    AudioDriverCmd cmd = { .type = AudioDriverCmdType_VoiceStop, .voice_id = id };
+    return audrvThreadPush(t, &cmd, timeout);
+}
+
+static inline Result audrvThreadVoiceSetMixFactor(AudioDriverThread* t, int id, float factor, int src_channel_id, int dest_channel_id, u64 timeout)
+{
+    AudioDriverCmd cmd = { .type = AudioDriverCmdType_VoiceSetMixFactor, .voice_id = id, .mix_factor = { factor, src_channel_id, dest_channel_id } };
+    return audrvThreadPush(t, &cmd, timeout);
+}
+
+static inline Result audrvThreadCall(AudioDriverThread* t, void (*func)(AudioDriver* d, void* arg), void* arg, u64 timeout)
+{
+    AudioDriverCmd cmd = { .type = AudioDriverCmdType_Call, .call = { func, arg } };
+    return audrvThreadPush(t, &cmd, timeout);
+}
@@ -0,0 +1,119 @@
+/**
+ * @file dsp.h
+ * @brief CPU-side audio processing: biquad filter chains, resampling and DSP-ADPCM encoding.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "../types.h"
+#include "../services/audren.h"
+
+#define AUDIO_DSP_MAX_CHANNELS     4 ///< Maximum number of interleaved channels processed by the filters and the resampler.
+#define AUDIO_BIQUAD_MAX_STAGES    8 ///< Maximum number of stages of an \ref AudioBiquadChain.
+#define AUDIO_ADPCM_FRAME_SAMPLES 14 ///< Samples per DSP-ADPCM frame.
+#define AUDIO_ADPCM_FRAME_SIZE     8 ///< Size of a DSP-ADPCM frame.
+
+/// Biquad filter types, from the Audio EQ Cookbook.
+typedef enum {
+    AudioBiquadType_LowPass,
+    AudioBiquadType_HighPass,
+    AudioBiquadType_BandPass,
+    AudioBiquadType_Notch,
+    AudioBiquadType_Peaking,
+    AudioBiquadType_LowShelf,
+    AudioBiquadType_HighShelf,
+} AudioBiquadType;
+
+/// Biquad coefficients, normalized so that a0 is 1.
+typedef struct {
+    float b0, b1, b2;
+    float a1, a2;
+} AudioBiquadCoefs;
+
+/// Chain of biquad filters, with their state for each channel.
+typedef struct {
+    u32 num_channels;
+    u32 num_stages;
+    AudioBiquadCoefs coefs[AUDIO_BIQUAD_MAX_STAGES];
+    float z1[AUDIO_BIQUAD_MAX_STAGES][AUDIO_DSP_MAX_CHANNELS];
+    float z2[AUDIO_BIQUAD_MAX_STAGES][AUDIO_DSP_MAX_CHANNELS];
+} AudioBiquadChain;
+
+/**
+ * @brief Computes biquad coefficients.
+ * @param[out] out Coefficients.
+ * @param[in] type Filter type.
+ * @param[in] freq Cutoff or center frequency, in Hz.
+ * @param[in] sample_rate Sample rate, in Hz.
+ * @param[in] q Quality factor (0.7071 for a Butterworth low/high pass).
+ * @param[in] gain_db Gain in dB, for the peaking and shelf types.
+ */
+void audioBiquadDesign(AudioBiquadCoefs* out, AudioBiquadType type, float freq, float sample_rate, float q, float gain_db);
+
+/// Sets coefficients from their raw, unnormalized values, as taken by \ref audrvVoiceSetBiquadFilter.
+void audioBiquadSetRaw(AudioBiquadCoefs* out, float a0, float a1, float a2, float b0, float b1, float b2);
+
+/// Initializes an empty biquad chain.
+void audioBiquadChainInit(AudioBiquadChain* c, u32 num_channels);
+
+/// Appends a stage to a biquad chain, returns false if it's full.
+bool audioBiquadChainAddStage(AudioBiquadChain* c, const AudioBiquadCoefs* coefs);
+
+/// Clears the filter state of a biquad chain, e.g. when seeking.
+void audioBiquadChainReset(AudioBiquadChain* c);
+
+/// Filters interleaved PCM16 frames in place, with saturation.
+void audioBiquadChainProcessS16(AudioBiquadChain* c, s16* data, u32 num_frames);
+
+/// Filters interleaved float frames in place.
+void audioBiquadChainProcessFloat(AudioBiquadChain* c, float* data, u32 num_frames);
+
+/// Streaming resampler (cubic Hermite interpolation), e.g. for 44.1kHz to 48kHz.
+typedef struct {
+    u32 num_channels;
+    u64 step;                                 ///< Input frames per output frame, 32.32 fixed point.
+    u64 pos;                                  ///< Position in the history followed by the input, 32.32 fixed point.
+    float history[3][AUDIO_DSP_MAX_CHANNELS]; ///< Last input frames of the previous call.
+} AudioResampler;
+
+/// Initializes a resampler.
+void audioResamplerInit(AudioResampler* r, u32 num_channels, u32 in_rate, u32 out_rate);
+
+/**
+ * @brief Resamples interleaved PCM16 frames.
+ * @param[in] in Input frames.
+ * @param[in] in_frames Number of input frames.
+ * @param[out] out Output frames.
+ * @param[in] out_frames Room in the output, in frames.
+ * @param[out] in_consumed Number of input frames consumed. All of them unless the output is full, the rest must be passed again.
+ * @return Number of output frames written.
+ * @note The output is delayed by two input frames.
+ */
+u32 audioResamplerProcessS16(AudioResampler* r, const s16* in, u32 in_frames, s16* out, u32 out_frames, u32* in_consumed);
+
+/// DSP-ADPCM encoder state, for a single channel.
+typedef struct {
+    AudioRendererAdpcmParameters params;      ///< Predictor coefficients, to pass along with the encoded data to the renderer.
+    s16 history[2];                           ///< Last two decoded samples, most recent first.
+} AudioAdpcmEncoder;
+
+/// Size of the DSP-ADPCM encoding of num_samples samples.
+NX_CONSTEXPR size_t audioAdpcmGetEncodedSize(u32 num_samples)
+{
+    return (size_t)((num_samples + AUDIO_ADPCM_FRAME_SAMPLES-1) / AUDIO_ADPCM_FRAME_SAMPLES) * AUDIO_ADPCM_FRAME_SIZE;
+}
+
+/**
+ * @brief Initializes a DSP-ADPCM encoder, computing predictor coefficients suited to the given data.
+ * @param[out] e AudioAdpcmEncoder object.
+ * @param[in] pcm Mono PCM16 samples, representative of what will be encoded (usually the whole sound).
+ * @param[in] num_samples Number of samples.
+ * @return Result code.
+ */
+Result audioAdpcmEncoderInit(AudioAdpcmEncoder* e, const s16* pcm, u32 num_samples);
+
+/**
+ * @brief Encodes mono PCM16 samples. Consecutive calls continue the same stream.
+ * @param[out] out Output, \ref audioAdpcmGetEncodedSize bytes. The last frame is padded with silence.
+ * @param[out] out_ctx Optional context to start decoding the output from, for the wavebuf context.
+ */
+void audioAdpcmEncode(AudioAdpcmEncoder* e, const s16* pcm, u32 num_samples, u8* out, AudioRendererAdpcmContext* out_ctx);
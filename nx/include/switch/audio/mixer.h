@@ -0,0 +1,106 @@
+/**
+ * @file mixer.h
+ * @brief Software mixer for audout: mixes PCM sources into stereo PCM16, with an optional thread feeding audout.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "../types.h"
+#include "../kernel/mutex.h"
+#include "../kernel/thread.h"
+#include "../services/audout.h"
+
+/// Mixer source.
+typedef struct {
+    const void* data;           ///< Interleaved PCM16 or float samples.
+    u32 num_frames;
+    u32 num_channels;           ///< 1 or 2.
+    bool is_float;              ///< Whether the samples are floats in [-1, 1] instead of PCM16.
+    bool loop;
+    bool active;
+    float gain;
+    float pan;                  ///< -1 (left) to 1 (right).
+    u64 step;                   ///< Source frames per output frame, 32.32 fixed point.
+    u64 pos;                    ///< Position in the source, 32.32 fixed point.
+} AudioMixerSource;
+
+/// Mixer object.
+typedef struct {
+    Mutex mutex;
+    u32 output_rate;
+    u32 max_frames;
+    u32 num_sources;
+    AudioMixerSource* sources;
+    float* accum;               ///< Stereo float accumulator, max_frames long.
+} AudioMixer;
+
+/**
+ * @brief Creates a mixer.
+ * @param[out] m AudioMixer object.
+ * @param[in] num_sources Number of sources.
+ * @param[in] output_rate Output sample rate, e.g. \ref audoutGetSampleRate.
+ * @param[in] max_frames Maximum number of frames mixed by a single \ref audmixMix call.
+ * @return Result code.
+ */
+Result audmixCreate(AudioMixer* m, u32 num_sources, u32 output_rate, u32 max_frames);
+
+/// Closes a mixer.
+void audmixClose(AudioMixer* m);
+
+/**
+ * @brief Starts playing samples on a source, replacing whatever it was playing.
+ * @param[in] id Source index.
+ * @param[in] data Interleaved samples, which must stay valid while the source plays.
+ * @param[in] num_frames Number of frames (samples per channel).
+ * @param[in] num_channels 1 or 2.
+ * @param[in] is_float Whether the samples are floats instead of PCM16.
+ * @param[in] sample_rate Sample rate of the data, converted to the output rate with linear interpolation.
+ * @param[in] loop Whether to loop back to the start at the end of the data.
+ * @return Result code.
+ * @note Gain and pan are kept from the previous use of the source (1 and 0 initially).
+ */
+Result audmixSourcePlay(AudioMixer* m, u32 id, const void* data, u32 num_frames, u32 num_channels, bool is_float, u32 sample_rate, bool loop);
+
+/// Stops a source. Out of range ids are ignored.
+void audmixSourceStop(AudioMixer* m, u32 id);
+
+/// Returns whether a source is still playing, false for out of range ids.
+bool audmixSourceIsPlaying(AudioMixer* m, u32 id);
+
+/**
+ * @brief Sets the gain and pan of a source.
+ * @param[in] gain Linear gain.
+ * @param[in] pan Balance, from -1 (left only) to 1 (right only). The side panned towards keeps the full gain.
+ */
+void audmixSourceSetGainPan(AudioMixer* m, u32 id, float gain, float pan);
+
+/**
+ * @brief Mixes the playing sources.
+ * @param[out] out Interleaved stereo PCM16 output, saturated.
+ * @param[in] num_frames Number of frames to mix, up to max_frames.
+ */
+void audmixMix(AudioMixer* m, s16* out, u32 num_frames);
+
+/// Thread mixing into a pair of audout buffers, queuing each one back as soon as audout releases it.
+typedef struct {
+    AudioMixer* mixer;
+    Thread thread;
+    AudioOutBuffer buffers[2];
+    void* mem;
+    u32 buffer_frames;
+    bool exit;
+} AudioMixerFeeder;
+
+/**
+ * @brief Starts audout, and a thread feeding it from a mixer.
+ * @param[out] f AudioMixerFeeder object.
+ * @param[in] m Mixer, with its output rate set to \ref audoutGetSampleRate.
+ * @param[in] buffer_frames Frames per buffer, up to the max_frames of the mixer. The latency is about twice that.
+ * @param[in] prio Thread priority.
+ * @param[in] cpuid Core the thread is pinned to.
+ * @return Result code.
+ * @note audout must be initialized and its output stereo PCM16.
+ */
+Result audmixFeederCreate(AudioMixerFeeder* f, AudioMixer* m, u32 buffer_frames, int prio, int cpuid);
+
+/// Stops the feeder thread and audout.
+void audmixFeederClose(AudioMixerFeeder* f);
@@ -0,0 +1,59 @@
+/**
+ * @file opus_stream.h
+ * @brief Decode-ahead worker feeding a streaming voice with hwopus-decoded data.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "../services/hwopus.h"
+#include "stream.h"
+
+/**
+ * @brief Function reading the Opus input.
+ * @param[in] arg Argument passed to \ref audrvOpusStreamCreate.
+ * @param[out] buf Buffer to read into: packets each starting with a \ref HwopusHeader. Packets may be split across reads.
+ * @param[in] size Size of the buffer.
+ * @return Number of bytes read, 0 at the end of the input.
+ */
+typedef size_t (*AudioOpusStreamReadFn)(void* arg, void* buf, size_t size);
+
+/// Opus decode-ahead worker.
+typedef struct {
+    HwopusDecoder* decoder;
+    AudioDriverStream* stream;
+    AudioOpusStreamReadFn read_cb;
+    void* read_arg;
+    Thread thread;
+    u8* in_buf;
+    size_t in_size;
+    size_t in_len;
+    s16* pcm_buf;
+    size_t pcm_size;
+    u32 pcm_frames;             ///< Decoded frames not written to the stream yet.
+    u32 pcm_offset;
+    bool exit;
+    bool finished;              ///< The input ended, or decoding failed.
+    Result last_result;
+} AudioOpusStream;
+
+/**
+ * @brief Starts a thread decoding Opus packets ahead of playback into the built-in ring buffer of a streaming voice.
+ * @param[out] s AudioOpusStream object.
+ * @param[in] decoder Decoder, used by this thread only until \ref audrvOpusStreamClose.
+ * @param[in] stream Streaming voice created without fill callback, with the decoder's channel count and sample rate. This is its writer thread.
+ * @param[in] read_cb Function reading the input.
+ * @param[in] read_arg Argument passed to read_cb.
+ * @param[in] prio Thread priority.
+ * @param[in] cpuid Core the thread is pinned to.
+ * @return Result code.
+ * @note Several packets are decoded per wakeup with \ref hwopusDecodeInterleavedBatch. Use one decoder (session) per stream for several streams to be decoded in parallel.
+ */
+Result audrvOpusStreamCreate(AudioOpusStream* s, HwopusDecoder* decoder, AudioDriverStream* stream, AudioOpusStreamReadFn read_cb, void* read_arg, int prio, int cpuid);
+
+/// Stops the decode thread.
+void audrvOpusStreamClose(AudioOpusStream* s);
+
+/// Returns whether the whole input was decoded and written to the stream (or decoding failed, see last_result).
+static inline bool audrvOpusStreamIsFinished(AudioOpusStream* s)
+{
+    return __atomic_load_n(&s->finished, __ATOMIC_ACQUIRE);
+}
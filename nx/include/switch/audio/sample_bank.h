@@ -0,0 +1,82 @@
+/**
+ * @file sample_bank.h
+ * @brief Sample bank: packs many samples into a few large attached mempools.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "driver.h"
+
+/// Maximum number of mempools of a sample bank.
+#define AUDRV_SAMPLE_BANK_MAX_POOLS 16
+
+typedef struct {
+    u8* mem;
+    int mempool_id;
+    u32 used;                   ///< End of the last sample in the pool.
+    u32 live;                   ///< Bytes used by the referenced samples.
+    u32 dirty_start;            ///< Range written and not flushed to memory yet.
+    u32 dirty_end;
+} AudioSampleBankPool;
+
+typedef struct {
+    u32 pool;
+    u32 offset;
+    u32 size;
+    u32 refcount;               ///< 0 if the entry is free.
+} AudioSampleBankEntry;
+
+/// Sample bank object.
+typedef struct {
+    AudioDriver* driver;
+    u32 pool_size;
+    u32 max_pools;
+    u32 num_pools;
+    AudioSampleBankPool pools[AUDRV_SAMPLE_BANK_MAX_POOLS];
+    AudioSampleBankEntry* entries;
+    u32 num_entries;
+} AudioSampleBank;
+
+/**
+ * @brief Creates a sample bank.
+ * @param[out] b AudioSampleBank object.
+ * @param[in] d Audio driver.
+ * @param[in] pool_size Size of each mempool, the maximum size of a sample.
+ * @param[in] max_pools Maximum number of mempools, up to \ref AUDRV_SAMPLE_BANK_MAX_POOLS. They are added as needed.
+ * @return Result code.
+ */
+Result audrvSampleBankCreate(AudioSampleBank* b, AudioDriver* d, size_t pool_size, u32 max_pools);
+
+/**
+ * @brief Closes a sample bank.
+ * @note This calls \ref audrvUpdate once to detach the mempools before freeing them. No sample may be queued on a voice anymore.
+ */
+void audrvSampleBankClose(AudioSampleBank* b);
+
+/**
+ * @brief Copies a sample into the bank.
+ * @param[in] data Sample data (PCM16 or ADPCM).
+ * @param[in] size Size of the data.
+ * @return Id of the sample, with a reference count of 1, or -1 if there isn't enough room (see \ref audrvSampleBankCompact).
+ * @note The data is written back from the CPU cache once per mempool, when a sample is first fetched with \ref audrvSampleBankGetWaveBuf.
+ *       Newly added mempools are attached on the next \ref audrvUpdate, like with \ref audrvMemPoolAttach.
+ */
+int audrvSampleBankAdd(AudioSampleBank* b, const void* data, size_t size);
+
+/// Adds a reference to a sample.
+void audrvSampleBankRetain(AudioSampleBank* b, int id);
+
+/// Removes a reference to a sample, which is freed once there are none left. Its space is reused after \ref audrvSampleBankCompact.
+void audrvSampleBankRelease(AudioSampleBank* b, int id);
+
+/**
+ * @brief Points a wavebuf at a sample.
+ * @param[out] wavebuf Wavebuf, of which data_raw and size (and nothing else) are set.
+ * @return false if the id isn't valid.
+ */
+bool audrvSampleBankGetWaveBuf(AudioSampleBank* b, int id, AudioDriverWaveBuf* wavebuf);
+
+/**
+ * @brief Moves the samples of each mempool together, making the space of the released ones reusable.
+ * @note Samples move, so none may be queued on a voice during this call: fetch wavebufs again with \ref audrvSampleBankGetWaveBuf afterwards.
+ */
+void audrvSampleBankCompact(AudioSampleBank* b);
@@ -0,0 +1,93 @@
+/**
+ * @file stream.h
+ * @brief Streaming voice: keeps an \ref AudioDriver voice fed with PCM16 data from a callback or a ring buffer.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "driver.h"
+
+/// Maximum number of chunks of a stream, which is the number of wavebufs the renderer holds per voice.
+#define AUDRV_STREAM_MAX_CHUNKS 4
+
+/**
+ * @brief Function filling a chunk of a stream.
+ * @param[in] arg Argument passed to \ref audrvStreamCreate.
+ * @param[out] out Interleaved PCM16 samples to write.
+ * @param[in] num_frames Maximum number of frames (samples per channel) to write.
+ * @return Number of frames written, 0 if no data is available right now.
+ */
+typedef u32 (*AudioDriverStreamFillFn)(void* arg, s16* out, u32 num_frames);
+
+/// Streaming voice object.
+typedef struct {
+    AudioDriver* driver;
+    int voice_id;
+    int mempool_id;
+    u32 num_channels;
+    u32 chunk_frames;
+    u32 chunk_stride;                       ///< Distance between chunks in the mempool, in bytes.
+    u32 num_chunks;
+    u32 next_chunk;                         ///< Next chunk to be filled, in submission order.
+    u32 low_water_frames;
+    u64 submitted_frames;                   ///< Frames submitted since the voice started, compared against its played sample count.
+    u8* mem;
+    size_t mem_size;
+    AudioDriverWaveBuf wavebufs[AUDRV_STREAM_MAX_CHUNKS];
+
+    AudioDriverStreamFillFn fill_cb;
+    void* fill_arg;
+
+    // Built-in ring buffer, used when there is no fill callback.
+    s16* ring;
+    u32 ring_frames;
+    u64 ring_write_pos;                     ///< Written by the producer thread.
+    u64 ring_read_pos;                      ///< Written by the audio thread.
+} AudioDriverStream;
+
+/**
+ * @brief Creates a streaming voice.
+ * @param[out] s AudioDriverStream object.
+ * @param[in] d Audio driver.
+ * @param[in] voice_id Voice to use, which is (re)initialized as a PCM16 voice. Set its mix and volume afterwards as with any other voice.
+ * @param[in] num_channels Number of channels.
+ * @param[in] sample_rate Sample rate.
+ * @param[in] chunk_frames Size of each chunk, in frames.
+ * @param[in] num_chunks Number of chunks, between 2 and \ref AUDRV_STREAM_MAX_CHUNKS.
+ * @param[in] fill_cb Function filling chunks, or NULL to use the built-in ring buffer filled with \ref audrvStreamWrite.
+ * @param[in] fill_arg Argument passed to fill_cb.
+ * @param[in] ring_frames Size of the built-in ring buffer in frames, when fill_cb is NULL.
+ * @return Result code.
+ * @note The chunk memory is a single mempool, allocated and attached here once. Chunks are recycled as soon as the renderer is done with them.
+ */
+Result audrvStreamCreate(AudioDriverStream* s, AudioDriver* d, int voice_id, u32 num_channels, u32 sample_rate, u32 chunk_frames, u32 num_chunks, AudioDriverStreamFillFn fill_cb, void* fill_arg, u32 ring_frames);
+
+/**
+ * @brief Closes a streaming voice, dropping its voice.
+ * @note This calls \ref audrvUpdate once to detach the mempool before freeing it.
+ */
+void audrvStreamClose(AudioDriverStream* s);
+
+/**
+ * @brief Sets how far ahead the stream is filled.
+ * @param[in] frames Chunks are only filled once less than this many frames are left to play. 0 (the default) fills every chunk as soon as it's recycled, which minimizes the risk of underrun at the cost of latency.
+ */
+static inline void audrvStreamSetLowWater(AudioDriverStream* s, u32 frames)
+{
+    s->low_water_frames = frames;
+}
+
+/**
+ * @brief Refills the recycled chunks of the stream and queues them on the voice, and starts it.
+ * @note Call this every audio frame before \ref audrvUpdate, from the thread using the driver (e.g. the frame callback of \ref audrvThreadCreate).
+ */
+void audrvStreamUpdate(AudioDriverStream* s);
+
+/// Gets the number of frames queued on the voice and not played yet, as of the last \ref audrvUpdate.
+u32 audrvStreamGetQueuedFrames(AudioDriverStream* s);
+
+/**
+ * @brief Writes interleaved PCM16 frames to the built-in ring buffer of a stream created without fill callback.
+ * @return Number of frames written, less than num_frames if the ring buffer is full.
+ * @note This can be called from another thread than \ref audrvStreamUpdate, as long as there is only one writer.
+ */
+u32 audrvStreamWrite(AudioDriverStream* s, const s16* data, u32 num_frames);
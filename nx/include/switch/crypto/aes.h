@@ -36,6 +36,15 @@
 #ifndef AES_256_NUM_ROUNDS
 #define AES_256_NUM_ROUNDS 14
 #endif
+#ifndef AES_CONTEXT_CACHE_SIZE
+#define AES_CONTEXT_CACHE_SIZE 8
+#endif
+
+/// Flags of \ref Aes128ContextCache entries.
+enum {
+    AES_CONTEXT_CACHE_FLAG_VALID     = BIT(0),
+    AES_CONTEXT_CACHE_FLAG_ENCRYPTOR = BIT(1),
+};
 
 /// Context for AES-128 operations.
 typedef struct {
@@ -52,12 +61,43 @@ typedef struct {
     u8 round_keys[AES_256_NUM_ROUNDS+1][AES_BLOCK_SIZE];
 } Aes256Context;
 
+/// Cache of expanded AES-128 contexts, keyed by key and direction. Zero-initialize before use.
+typedef struct {
+    u8 keys[AES_CONTEXT_CACHE_SIZE][AES_128_KEY_SIZE];
+    Aes128Context ctxs[AES_CONTEXT_CACHE_SIZE];
+    u32 last_used[AES_CONTEXT_CACHE_SIZE];
+    u8 flags[AES_CONTEXT_CACHE_SIZE];
+    u32 tick;
+} Aes128ContextCache;
+
+/// Cache of expanded AES-192 contexts, keyed by key and direction. Zero-initialize before use.
+typedef struct {
+    u8 keys[AES_CONTEXT_CACHE_SIZE][AES_192_KEY_SIZE];
+    Aes192Context ctxs[AES_CONTEXT_CACHE_SIZE];
+    u32 last_used[AES_CONTEXT_CACHE_SIZE];
+    u8 flags[AES_CONTEXT_CACHE_SIZE];
+    u32 tick;
+} Aes192ContextCache;
+
+/// Cache of expanded AES-256 contexts, keyed by key and direction. Zero-initialize before use.
+typedef struct {
+    u8 keys[AES_CONTEXT_CACHE_SIZE][AES_256_KEY_SIZE];
+    Aes256Context ctxs[AES_CONTEXT_CACHE_SIZE];
+    u32 last_used[AES_CONTEXT_CACHE_SIZE];
+    u8 flags[AES_CONTEXT_CACHE_SIZE];
+    u32 tick;
+} Aes256ContextCache;
+
 /// Initialize a 128-bit AES context.
 void aes128ContextCreate(Aes128Context *out, const void *key, bool is_encryptor);
 /// Encrypt using an AES context (Requires is_encryptor when initializing)
 void aes128EncryptBlock(const Aes128Context *ctx, void *dst, const void *src);
 /// Decrypt using an AES context (Requires !is_encryptor when initializing)
 void aes128DecryptBlock(const Aes128Context *ctx, void *dst, const void *src);
+/// Initialize a 128-bit AES context from a cache, only expanding the key on a miss (evicting the least recently used entry).
+void aes128ContextCacheGet(Aes128ContextCache *cache, Aes128Context *out, const void *key, bool is_encryptor);
+/// Erases all keys and contexts in a cache.
+void aes128ContextCacheClear(Aes128ContextCache *cache);
 
 /// Initialize a 192-bit AES context.
 void aes192ContextCreate(Aes192Context *out, const void *key, bool is_encryptor);
@@ -65,6 +105,10 @@ void aes192ContextCreate(Aes192Context *out, const void *key, bool is_encryptor)
 void aes192EncryptBlock(const Aes192Context *ctx, void *dst, const void *src);
 /// Decrypt using an AES context (Requires !is_encryptor when initializing)
 void aes192DecryptBlock(const Aes192Context *ctx, void *dst, const void *src);
+/// Initialize a 192-bit AES context from a cache, only expanding the key on a miss (evicting the least recently used entry).
+void aes192ContextCacheGet(Aes192ContextCache *cache, Aes192Context *out, const void *key, bool is_encryptor);
+/// Erases all keys and contexts in a cache.
+void aes192ContextCacheClear(Aes192ContextCache *cache);
 
 /// Initialize a 256-bit AES context.
 void aes256ContextCreate(Aes256Context *out, const void *key, bool is_encryptor);
@@ -72,3 +116,7 @@ void aes256ContextCreate(Aes256Context *out, const void *key, bool is_encryptor)
 void aes256EncryptBlock(const Aes256Context *ctx, void *dst, const void *src);
 /// Decrypt using an AES context (Requires !is_encryptor when initializing)
 void aes256DecryptBlock(const Aes256Context *ctx, void *dst, const void *src);
+/// Initialize a 256-bit AES context from a cache, only expanding the key on a miss (evicting the least recently used entry).
+void aes256ContextCacheGet(Aes256ContextCache *cache, Aes256Context *out, const void *key, bool is_encryptor);
+/// Erases all keys and contexts in a cache.
+void aes256ContextCacheClear(Aes256ContextCache *cache);
@@ -0,0 +1,74 @@
+/**
+ * @file aes_gcm.h
+ * @brief Hardware accelerated AES-GCM implementation.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "aes.h"
+
+#ifndef AES_GCM_MAC_SIZE
+#define AES_GCM_MAC_SIZE 0x10
+#endif
+#ifndef AES_GCM_IV_SIZE
+#define AES_GCM_IV_SIZE 0xC
+#endif
+
+/// Context for AES-128 GCM.
+typedef struct {
+    Aes128Context aes_ctx;
+    u8 h[4][AES_BLOCK_SIZE];                    ///< Powers H^1 to H^4 of the hash key, in GHASH representation.
+    u8 j0[AES_BLOCK_SIZE];
+    u8 ctr[AES_BLOCK_SIZE];
+    u8 ghash[AES_BLOCK_SIZE];
+    u8 buffer[AES_BLOCK_SIZE];
+    u8 enc_ctr_buffer[AES_BLOCK_SIZE];
+    u8 mac[AES_GCM_MAC_SIZE];
+    size_t num_buffered;
+    u64 aad_size;
+    u64 msg_size;
+    bool aad_finalized;
+    bool finalized;
+} Aes128GcmContext;
+
+/// Context for AES-256 GCM.
+typedef struct {
+    Aes256Context aes_ctx;
+    u8 h[4][AES_BLOCK_SIZE];                    ///< Powers H^1 to H^4 of the hash key, in GHASH representation.
+    u8 j0[AES_BLOCK_SIZE];
+    u8 ctr[AES_BLOCK_SIZE];
+    u8 ghash[AES_BLOCK_SIZE];
+    u8 buffer[AES_BLOCK_SIZE];
+    u8 enc_ctr_buffer[AES_BLOCK_SIZE];
+    u8 mac[AES_GCM_MAC_SIZE];
+    size_t num_buffered;
+    u64 aad_size;
+    u64 msg_size;
+    bool aad_finalized;
+    bool finalized;
+} Aes256GcmContext;
+
+/// Initialize an AES-128-GCM context. The IV is typically \ref AES_GCM_IV_SIZE bytes, other sizes are hashed as per the specification.
+void aes128GcmContextCreate(Aes128GcmContext *out, const void *key, const void *iv, size_t iv_size);
+/// Adds additional authenticated data. Must be called before any data is encrypted or decrypted.
+void aes128GcmUpdateAad(Aes128GcmContext *ctx, const void *src, size_t size);
+/// Encrypts data, and authenticates the resulting ciphertext.
+void aes128GcmEncrypt(Aes128GcmContext *ctx, void *dst, const void *src, size_t size);
+/// Authenticates ciphertext, and decrypts it. The plaintext must not be used before \ref aes128GcmVerifyMac succeeds.
+void aes128GcmDecrypt(Aes128GcmContext *ctx, void *dst, const void *src, size_t size);
+/// Gets the context's output mac (\ref AES_GCM_MAC_SIZE bytes), finalizes the context.
+void aes128GcmGetMac(Aes128GcmContext *ctx, void *dst);
+/// Finalizes the context and compares its mac with the first mac_size bytes of the provided one, in constant time.
+bool aes128GcmVerifyMac(Aes128GcmContext *ctx, const void *mac, size_t mac_size);
+
+/// Initialize an AES-256-GCM context. The IV is typically \ref AES_GCM_IV_SIZE bytes, other sizes are hashed as per the specification.
+void aes256GcmContextCreate(Aes256GcmContext *out, const void *key, const void *iv, size_t iv_size);
+/// Adds additional authenticated data. Must be called before any data is encrypted or decrypted.
+void aes256GcmUpdateAad(Aes256GcmContext *ctx, const void *src, size_t size);
+/// Encrypts data, and authenticates the resulting ciphertext.
+void aes256GcmEncrypt(Aes256GcmContext *ctx, void *dst, const void *src, size_t size);
+/// Authenticates ciphertext, and decrypts it. The plaintext must not be used before \ref aes256GcmVerifyMac succeeds.
+void aes256GcmDecrypt(Aes256GcmContext *ctx, void *dst, const void *src, size_t size);
+/// Gets the context's output mac (\ref AES_GCM_MAC_SIZE bytes), finalizes the context.
+void aes256GcmGetMac(Aes256GcmContext *ctx, void *dst);
+/// Finalizes the context and compares its mac with the first mac_size bytes of the provided one, in constant time.
+bool aes256GcmVerifyMac(Aes256GcmContext *ctx, const void *mac, size_t mac_size);
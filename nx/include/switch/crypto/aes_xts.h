@@ -53,3 +53,12 @@ void aes256XtsContextResetTweak(Aes256XtsContext *ctx, const void *tweak);
 void aes256XtsContextResetSector(Aes256XtsContext *ctx, uint64_t sector, bool is_nintendo);
 size_t aes256XtsEncrypt(Aes256XtsContext *ctx, void *dst, const void *src, size_t size);
 size_t aes256XtsDecrypt(Aes256XtsContext *ctx, void *dst, const void *src, size_t size);
+
+/// Parallel sector API: processes size bytes of consecutive sectors starting at first_sector, split into one contiguous run per core (0 to 2), each handled by a worker thread with its own copy of the context.
+/// size must be a multiple of sector_size, which must be a multiple of \ref AES_BLOCK_SIZE. The context itself is left untouched.
+Result aes128XtsEncryptSectorsParallel(const Aes128XtsContext *ctx, void *dst, const void *src, size_t size, size_t sector_size, uint64_t first_sector, bool is_nintendo);
+Result aes128XtsDecryptSectorsParallel(const Aes128XtsContext *ctx, void *dst, const void *src, size_t size, size_t sector_size, uint64_t first_sector, bool is_nintendo);
+Result aes192XtsEncryptSectorsParallel(const Aes192XtsContext *ctx, void *dst, const void *src, size_t size, size_t sector_size, uint64_t first_sector, bool is_nintendo);
+Result aes192XtsDecryptSectorsParallel(const Aes192XtsContext *ctx, void *dst, const void *src, size_t size, size_t sector_size, uint64_t first_sector, bool is_nintendo);
+Result aes256XtsEncryptSectorsParallel(const Aes256XtsContext *ctx, void *dst, const void *src, size_t size, size_t sector_size, uint64_t first_sector, bool is_nintendo);
+Result aes256XtsDecryptSectorsParallel(const Aes256XtsContext *ctx, void *dst, const void *src, size_t size, size_t sector_size, uint64_t first_sector, bool is_nintendo);
@@ -0,0 +1,73 @@
+/**
+ * @file benchmark.h
+ * @brief Throughput benchmark for the crypto primitives.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "../types.h"
+
+/// Benchmarked primitive.
+typedef enum {
+    CryptoBenchmarkAlgorithm_Aes128Ecb = 0,
+    CryptoBenchmarkAlgorithm_Aes256Ecb,
+    CryptoBenchmarkAlgorithm_Aes128CbcEncrypt,
+    CryptoBenchmarkAlgorithm_Aes128CbcDecrypt,
+    CryptoBenchmarkAlgorithm_Aes256CbcDecrypt,
+    CryptoBenchmarkAlgorithm_Aes128Ctr,
+    CryptoBenchmarkAlgorithm_Aes192Ctr,
+    CryptoBenchmarkAlgorithm_Aes256Ctr,
+    CryptoBenchmarkAlgorithm_Aes128XtsDecrypt,
+    CryptoBenchmarkAlgorithm_Aes256XtsDecrypt,
+    CryptoBenchmarkAlgorithm_Aes128Gcm,
+    CryptoBenchmarkAlgorithm_Aes128Cmac,
+    CryptoBenchmarkAlgorithm_Aes256Cmac,
+    CryptoBenchmarkAlgorithm_Sha1,
+    CryptoBenchmarkAlgorithm_Sha256,
+    CryptoBenchmarkAlgorithm_HmacSha256,
+    CryptoBenchmarkAlgorithm_Chacha20,
+    CryptoBenchmarkAlgorithm_Chacha20Poly1305,
+    CryptoBenchmarkAlgorithm_Crc32,
+    CryptoBenchmarkAlgorithm_Crc32c,
+
+    CryptoBenchmarkAlgorithm_Count,     ///< Number of algorithms.
+} CryptoBenchmarkAlgorithm;
+
+/// Benchmark result.
+typedef struct {
+    CryptoBenchmarkAlgorithm algorithm;     ///< \ref CryptoBenchmarkAlgorithm
+    size_t size;                            ///< Buffer size processed per iteration.
+    size_t misalign;                        ///< Offset of the buffer from a 0x40-byte boundary.
+    u64 iterations;                         ///< Number of iterations run.
+    u64 ticks;                              ///< System ticks taken by all iterations.
+} CryptoBenchmarkResult;
+
+/// Gets the name of a \ref CryptoBenchmarkAlgorithm.
+const char *cryptoBenchmarkGetAlgorithmName(CryptoBenchmarkAlgorithm algorithm);
+
+/**
+ * @brief Runs a primitive in place over a buffer, until at least min_ticks have elapsed.
+ * @param[in] algorithm \ref CryptoBenchmarkAlgorithm
+ * @param[in] buf Buffer, its contents are overwritten.
+ * @param[in] size Buffer size, a non-zero multiple of 0x10.
+ * @param[in] min_ticks Minimum duration of the benchmark, in system ticks.
+ * @param[out] out Result.
+ * @return Result code.
+ */
+Result cryptoBenchmarkRun(CryptoBenchmarkAlgorithm algorithm, void *buf, size_t size, u64 min_ticks, CryptoBenchmarkResult *out);
+
+/**
+ * @brief Converts a benchmark result to CPU cycles per byte.
+ * @param[in] r Result.
+ * @param[in] cpu_hz CPU clock frequency during the benchmark, for example 1020000000.
+ */
+double cryptoBenchmarkGetCyclesPerByte(const CryptoBenchmarkResult *r, u64 cpu_hz);
+
+/// Converts a benchmark result to MiB per second.
+double cryptoBenchmarkGetMibPerSecond(const CryptoBenchmarkResult *r);
+
+/**
+ * @brief Benchmarks every algorithm with buffer sizes from 16 bytes to 16 MiB, aligned and misaligned, and prints a table to stdout.
+ * @param[in] cpu_hz CPU clock frequency during the benchmark, used for the cycles/byte column.
+ * @return Result code.
+ */
+Result cryptoBenchmarkPrintTable(u64 cpu_hz);
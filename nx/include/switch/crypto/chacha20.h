@@ -0,0 +1,75 @@
+/**
+ * @file chacha20.h
+ * @brief NEON accelerated ChaCha20, Poly1305 and ChaCha20-Poly1305 (RFC 8439) implementation.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "../types.h"
+
+#ifndef CHACHA20_KEY_SIZE
+#define CHACHA20_KEY_SIZE 0x20
+#endif
+#ifndef CHACHA20_NONCE_SIZE
+#define CHACHA20_NONCE_SIZE 0xC
+#endif
+#ifndef CHACHA20_BLOCK_SIZE
+#define CHACHA20_BLOCK_SIZE 0x40
+#endif
+#ifndef POLY1305_KEY_SIZE
+#define POLY1305_KEY_SIZE 0x20
+#endif
+#ifndef POLY1305_MAC_SIZE
+#define POLY1305_MAC_SIZE 0x10
+#endif
+
+/// Context for ChaCha20.
+typedef struct {
+    u32 state[16];
+    u8 enc_ctr_buffer[CHACHA20_BLOCK_SIZE];
+    size_t buffer_offset;
+} Chacha20Context;
+
+/// Context for Poly1305.
+typedef struct {
+    u64 r[3];
+    u64 h[3];
+    u64 pad[2];
+    u8 buffer[0x10];
+    size_t num_buffered;
+    u8 mac[POLY1305_MAC_SIZE];
+    bool finalized;
+} Poly1305Context;
+
+/// Context for ChaCha20-Poly1305.
+typedef struct {
+    Chacha20Context chacha_ctx;
+    Poly1305Context poly_ctx;
+    u64 aad_size;
+    u64 msg_size;
+    bool aad_finalized;
+} Chacha20Poly1305Context;
+
+/// Initialize a ChaCha20 context, with a 32-bit initial block counter.
+void chacha20ContextCreate(Chacha20Context *out, const void *key, const void *nonce, u32 counter);
+/// Encrypts or decrypts data. Four blocks are processed in parallel when possible.
+void chacha20Crypt(Chacha20Context *ctx, void *dst, const void *src, size_t size);
+
+/// Initialize a Poly1305 context with a one-time key.
+void poly1305ContextCreate(Poly1305Context *out, const void *key);
+/// Updates Poly1305 context with data to authenticate.
+void poly1305ContextUpdate(Poly1305Context *ctx, const void *src, size_t size);
+/// Gets the context's output mac, finalizes the context.
+void poly1305ContextGetMac(Poly1305Context *ctx, void *dst);
+
+/// Initialize a ChaCha20-Poly1305 context.
+void chacha20Poly1305ContextCreate(Chacha20Poly1305Context *out, const void *key, const void *nonce);
+/// Adds additional authenticated data. Must be called before any data is encrypted or decrypted.
+void chacha20Poly1305UpdateAad(Chacha20Poly1305Context *ctx, const void *src, size_t size);
+/// Encrypts data, and authenticates the resulting ciphertext.
+void chacha20Poly1305Encrypt(Chacha20Poly1305Context *ctx, void *dst, const void *src, size_t size);
+/// Authenticates ciphertext, and decrypts it. The plaintext must not be used before \ref chacha20Poly1305VerifyMac succeeds.
+void chacha20Poly1305Decrypt(Chacha20Poly1305Context *ctx, void *dst, const void *src, size_t size);
+/// Gets the context's output mac (\ref POLY1305_MAC_SIZE bytes), finalizes the context.
+void chacha20Poly1305GetMac(Chacha20Poly1305Context *ctx, void *dst);
+/// Finalizes the context and compares its mac with the provided one (\ref POLY1305_MAC_SIZE bytes), in constant time.
+bool chacha20Poly1305VerifyMac(Chacha20Poly1305Context *ctx, const void *mac);
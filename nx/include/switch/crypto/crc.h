@@ -7,6 +7,25 @@
 #include <arm_acle.h>
 #include "../types.h"
 
+/// Buffers at least this large are checksummed as three interleaved streams, see \ref crc32CalculateLarge.
+#define CRC_INTERLEAVE_MIN_SIZE 0x600
+
+/// Calculate a CRC32 over data, as three interleaved streams combined with pmull. Used by \ref crc32Calculate for large buffers.
+u32 crc32CalculateLarge(const void *src, size_t size);
+/// Calculate a CRC32C over data, as three interleaved streams combined with pmull. Used by \ref crc32cCalculate for large buffers.
+u32 crc32cCalculateLarge(const void *src, size_t size);
+
+/**
+ * @brief Combines the CRC32s of two consecutive buffers, such as chunks checksummed by separate threads.
+ * @param[in] crc_a CRC32 of the first buffer.
+ * @param[in] crc_b CRC32 of the second buffer.
+ * @param[in] size_b Size of the second buffer.
+ * @return CRC32 of the concatenation of both buffers.
+ */
+u32 crc32Combine(u32 crc_a, u32 crc_b, size_t size_b);
+/// Combines the CRC32Cs of two consecutive buffers, see \ref crc32Combine.
+u32 crc32cCombine(u32 crc_a, u32 crc_b, size_t size_b);
+
 #define _CRC_ALIGN(sz, insn) \
 do { \
     if (((uintptr_t)src_u8 & sizeof(sz)) && (u64)len >= sizeof(sz)) { \
@@ -26,6 +45,9 @@ do { \
 
 /// Calculate a CRC32 over data.
 static inline u32 crc32Calculate(const void *src, size_t size) {
+    if (size >= CRC_INTERLEAVE_MIN_SIZE)
+        return crc32CalculateLarge(src, size);
+
     const u8 *src_u8 = (const u8 *)src;
 
     u32 crc = 0xFFFFFFFF;
@@ -49,6 +71,9 @@ static inline u32 crc32Calculate(const void *src, size_t size) {
 
 /// Calculate a CRC32C over data.
 static inline u32 crc32cCalculate(const void *src, size_t size) {
+    if (size >= CRC_INTERLEAVE_MIN_SIZE)
+        return crc32cCalculateLarge(src, size);
+
     const u8 *src_u8 = (const u8 *)src;
 
     u32 crc = 0xFFFFFFFF;
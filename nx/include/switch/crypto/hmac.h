@@ -23,6 +23,18 @@ typedef struct {
     bool finalized;
 } HmacSha256Context;
 
+/// Precomputed HMAC-SHA1 key: hash states after absorbing (key ^ ipad) and (key ^ opad). Read-only once created, so it can be shared between threads.
+typedef struct {
+    Sha1Context inner_ctx;
+    Sha1Context outer_ctx;
+} HmacSha1Key;
+
+/// Precomputed HMAC-SHA256 key: hash states after absorbing (key ^ ipad) and (key ^ opad). Read-only once created, so it can be shared between threads.
+typedef struct {
+    Sha256Context inner_ctx;
+    Sha256Context outer_ctx;
+} HmacSha256Key;
+
 #ifndef HMAC_SHA1_KEY_MAX
 #define HMAC_SHA1_KEY_MAX   (sizeof(((HmacSha1Context *)NULL)->key))
 #endif
@@ -40,6 +52,13 @@ void hmacSha256ContextGetMac(HmacSha256Context *ctx, void *dst);
 /// Simple all-in-one HMAC-SHA256 calculator.
 void hmacSha256CalculateMac(void *dst, const void *key, size_t key_size, const void *src, size_t size);
 
+/// Precomputes a HMAC-SHA256 key, for use with many messages.
+void hmacSha256KeyCreate(HmacSha256Key *out, const void *key, size_t key_size);
+/// Calculates a HMAC-SHA256 using a precomputed key, without re-keying.
+void hmacSha256KeyCalculateMac(const HmacSha256Key *key, void *dst, const void *src, size_t size);
+/// Calculates the HMAC-SHA256 of several messages using a precomputed key. Messages are processed in pairs, see \ref sha256ContextUpdateX2.
+void hmacSha256KeyCalculateMacsBatch(const HmacSha256Key *key, void *const *dsts, const void *const *srcs, const size_t *sizes, size_t count);
+
 /// Initialize a HMAC-SHA1 context.
 void hmacSha1ContextCreate(HmacSha1Context *out, const void *key, size_t key_size);
 /// Updates HMAC-SHA1 context with data to hash
@@ -49,3 +68,10 @@ void hmacSha1ContextGetMac(HmacSha1Context *ctx, void *dst);
 
 /// Simple all-in-one HMAC-SHA1 calculator.
 void hmacSha1CalculateMac(void *dst, const void *key, size_t key_size, const void *src, size_t size);
+
+/// Precomputes a HMAC-SHA1 key, for use with many messages.
+void hmacSha1KeyCreate(HmacSha1Key *out, const void *key, size_t key_size);
+/// Calculates a HMAC-SHA1 using a precomputed key, without re-keying.
+void hmacSha1KeyCalculateMac(const HmacSha1Key *key, void *dst, const void *src, size_t size);
+/// Calculates the HMAC-SHA1 of several messages using a precomputed key.
+void hmacSha1KeyCalculateMacsBatch(const HmacSha1Key *key, void *const *dsts, const void *const *srcs, const size_t *sizes, size_t count);
@@ -0,0 +1,26 @@
+/**
+ * @file rsa.h
+ * @brief RSA-2048 public key operations and RSA-PSS signature verification.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "../types.h"
+
+#ifndef RSA_2048_BYTES
+#define RSA_2048_BYTES 0x100
+#endif
+
+/**
+ * @brief Computes signature^65537 mod modulus locally, which is much cheaper than a round trip to spl for public key operations.
+ * @param[out] dst Output, \ref RSA_2048_BYTES big-endian bytes.
+ * @param[in] signature Input, \ref RSA_2048_BYTES big-endian bytes.
+ * @param[in] modulus Modulus, \ref RSA_2048_BYTES big-endian bytes.
+ * @return false if the modulus is even, or the input isn't smaller than it.
+ */
+bool rsa2048PublicExpMod(void *dst, const void *signature, const void *modulus);
+
+/// Checks an EMSA-PSS encoded message (\ref RSA_2048_BYTES bytes, SHA256, MGF1-SHA256, 0x20-byte salt) against a SHA256 message hash.
+bool rsa2048PssSha256VerifyEncoded(const void *encoded, const void *msg_hash);
+
+/// Verifies an RSA-2048-PSS-SHA256 signature with public exponent 65537 locally.
+bool rsa2048PssSha256Verify(const void *signature, const void *modulus, const void *msg_hash);
@@ -33,3 +33,16 @@ void sha256ContextGetHash(Sha256Context *ctx, void *dst);
 
 /// Simple all-in-one SHA256 calculator.
 void sha256CalculateHash(void *dst, const void *src, size_t size);
+
+/// Updates two independent SHA256 contexts, interleaving the processing of their complete blocks when neither has buffered data.
+void sha256ContextUpdateX2(Sha256Context *ctx_a, const void *src_a, size_t size_a, Sha256Context *ctx_b, const void *src_b, size_t size_b);
+
+/**
+ * @brief Calculates the SHA256 hashes of several independent messages.
+ * @param[out] dsts Output hashes, \ref SHA256_HASH_SIZE bytes each.
+ * @param[in] srcs Messages.
+ * @param[in] sizes Message sizes.
+ * @param[in] count Number of messages.
+ * @note Messages are hashed in pairs with interleaved compression rounds, which is significantly faster than hashing them one by one when there are many small messages of similar size (such as hash table blocks).
+ */
+void sha256CalculateHashesBatch(void *const *dsts, const void *const *srcs, const size_t *sizes, size_t count);
@@ -0,0 +1,51 @@
+/**
+ * @file sha512.h
+ * @brief SHA512 and SHA384 implementation (NEON message schedule, scalar rounds).
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "../types.h"
+
+#ifndef SHA512_HASH_SIZE
+#define SHA512_HASH_SIZE 0x40
+#endif
+
+#ifndef SHA384_HASH_SIZE
+#define SHA384_HASH_SIZE 0x30
+#endif
+
+#ifndef SHA512_BLOCK_SIZE
+#define SHA512_BLOCK_SIZE 0x80
+#endif
+
+/// Context for SHA512 operations.
+typedef struct {
+    u64 intermediate_hash[SHA512_HASH_SIZE / sizeof(u64)];
+    u8  buffer[SHA512_BLOCK_SIZE];
+    u64 bits_consumed;
+    size_t num_buffered;
+    bool finalized;
+} Sha512Context;
+
+/// Context for SHA384 operations, which are SHA512 with a different initial hash and truncated output.
+typedef Sha512Context Sha384Context;
+
+/// Initialize a SHA512 context.
+void sha512ContextCreate(Sha512Context *out);
+/// Updates SHA512 context with data to hash
+void sha512ContextUpdate(Sha512Context *ctx, const void *src, size_t size);
+/// Gets the context's output hash, finalizes the context.
+void sha512ContextGetHash(Sha512Context *ctx, void *dst);
+
+/// Simple all-in-one SHA512 calculator.
+void sha512CalculateHash(void *dst, const void *src, size_t size);
+
+/// Initialize a SHA384 context.
+void sha384ContextCreate(Sha384Context *out);
+/// Updates SHA384 context with data to hash
+void sha384ContextUpdate(Sha384Context *ctx, const void *src, size_t size);
+/// Gets the context's output hash (\ref SHA384_HASH_SIZE bytes), finalizes the context.
+void sha384ContextGetHash(Sha384Context *ctx, void *dst);
+
+/// Simple all-in-one SHA384 calculator.
+void sha384CalculateHash(void *dst, const void *src, size_t size);
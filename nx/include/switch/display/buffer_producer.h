@@ -17,7 +17,7 @@ typedef struct {
     s32 scalingMode;
     u32 transform; // See the NATIVE_WINDOW_TRANSFORM_* enums.
     u32 stickyTransform;
-    u32 unk;
+    u32 async; // Android async mode: the buffer replaces the queued one if it wasn't acquired yet.
     u32 swapInterval;
     NvMultiFence fence;
 } BqBufferInput;
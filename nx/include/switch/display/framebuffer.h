@@ -6,6 +6,7 @@
  */
 #pragma once
 #include "../nvidia/map.h"
+#include "../kernel/task_scheduler.h"
 #include "native_window.h"
 
 /// Converts red/green/blue/alpha components to packed RGBA8 (i.e. \ref PIXEL_FORMAT_RGBA_8888).
@@ -41,6 +42,12 @@
 /// Same as \ref RGBA4_MAXALPHA except with alpha=0xff.
 #define RGBA4_FROM_RGBA8_MAXALPHA(r,g,b) RGBA4_MAXALPHA((r)>>4,(g)>>4,(b)>>4)
 
+/// Presentation policy of a \ref Framebuffer.
+typedef enum {
+    FramebufferPresentMode_Fifo = 0,    ///< Every frame is presented, \ref framebufferBegin waits for a free buffer (default).
+    FramebufferPresentMode_Mailbox,     ///< \ref framebufferBegin never waits and \ref framebufferEnd presents only if a buffer is free, otherwise the frame is replaced by the next one. Linear framebuffers only.
+} FramebufferPresentMode;
+
 /// Framebuffer structure.
 typedef struct Framebuffer {
     NWindow *win;
@@ -51,8 +58,16 @@ typedef struct Framebuffer {
     u32 width_aligned;
     u32 height_aligned;
     u32 num_fbs;
+    u32 format;
     u32 fb_size;
     bool has_init;
+    TaskScheduler* ts;      ///< Optional scheduler the linear to block linear conversion is split across.
+    u64* dirty;             ///< With dirty tracking, a bitmap per buffer of the GOBs (64 bytes x 8 rows) to convert.
+    u32 dirty_words;        ///< Size of each bitmap in u64 words.
+    u32 gobs_per_row;
+    FramebufferPresentMode present_mode;
+    u32 frames_dropped;     ///< Frames not presented with \ref FramebufferPresentMode_Mailbox.
+    u32 row_offset;         ///< Row of the linear shadow buffer presented at the top, see \ref framebufferSetRowOffset.
 } Framebuffer;
 
 /**
@@ -77,6 +92,52 @@ Result framebufferCreate(Framebuffer* fb, NWindow *win, u32 width, u32 height, u
 /// Enables linear framebuffer mode in a \ref Framebuffer, allocating a shadow buffer in the process.
 Result framebufferMakeLinear(Framebuffer* fb);
 
+/**
+ * @brief Sets a \ref TaskScheduler used by \ref framebufferEnd to split the linear to block linear conversion (and cache flush) by rows of blocks.
+ * @param[in] fb Pointer to \ref Framebuffer structure.
+ * @param[in] ts Task scheduler, which must outlive its use by the \ref Framebuffer, or NULL to convert on the calling thread.
+ */
+static inline void framebufferSetTaskScheduler(Framebuffer* fb, TaskScheduler* ts)
+{
+    fb->ts = ts;
+}
+
+/**
+ * @brief Enables dirty tracking in a linear \ref Framebuffer: \ref framebufferEnd then only converts and flushes the parts of the image marked with \ref framebufferMarkDirty.
+ * @param[in] fb Pointer to \ref Framebuffer structure.
+ * @return Result code.
+ * @note The shadow buffer keeps its contents between frames, only the changes need to be drawn and marked. Each buffer of the \ref Framebuffer is brought up to date with the changes made since it was last presented.
+ */
+Result framebufferEnableDirtyTracking(Framebuffer* fb);
+
+/**
+ * @brief Marks a rectangle of a linear \ref Framebuffer as modified. Does nothing if dirty tracking isn't enabled.
+ * @param[in] fb Pointer to \ref Framebuffer structure.
+ * @param[in] x Left edge, in pixels.
+ * @param[in] y Top edge, in pixels.
+ * @param[in] width Width, in pixels.
+ * @param[in] height Height, in pixels.
+ */
+void framebufferMarkDirty(Framebuffer* fb, u32 x, u32 y, u32 width, u32 height);
+
+/**
+ * @brief Treats the shadow buffer of a linear \ref Framebuffer as a ring of rows, presenting it starting at the specified row.
+ * @param[in] fb Pointer to \ref Framebuffer structure.
+ * @param[in] row_offset Row of the shadow buffer presented at the top of the image, multiple of 8. The rows above it are presented after the last one.
+ * @return Result code.
+ * @note This lets scrolling content advance the offset and draw the new rows only, instead of moving the whole image. The next \ref framebufferEnd converts the whole image, in two parts.
+ */
+Result framebufferSetRowOffset(Framebuffer* fb, u32 row_offset);
+
+/**
+ * @brief Sets the presentation policy of a \ref Framebuffer.
+ * @param[in] fb Pointer to \ref Framebuffer structure.
+ * @param[in] mode Presentation mode. \ref FramebufferPresentMode_Mailbox requires \ref framebufferMakeLinear to have been called.
+ * @return Result code.
+ * @note This must not be called between \ref framebufferBegin and \ref framebufferEnd. With \ref FramebufferPresentMode_Fifo, the latency is controlled by the number of buffers and \ref nwindowSetSwapInterval.
+ */
+Result framebufferSetPresentMode(Framebuffer* fb, FramebufferPresentMode mode);
+
 /// Closes a \ref Framebuffer object, freeing all resources associated with it.
 void framebufferClose(Framebuffer* fb);
 
@@ -93,6 +154,16 @@ void framebufferClose(Framebuffer* fb);
  */
 void* framebufferBegin(Framebuffer* fb, u32* out_stride);
 
+/**
+ * @brief Begins rendering a frame in a \ref Framebuffer if a buffer is free, without waiting for one.
+ * @param[in] fb Pointer to \ref Framebuffer structure.
+ * @param[out] out_buf Output variable containing the pointer to the buffer to which new graphics data should be written to.
+ * @param[out] out_stride Output variable containing the distance in bytes between rows of pixels in memory.
+ * @return Result code. MAKERESULT(Module_LibnxBinder, LibnxBinderError_WouldBlock) if no buffer is free, or if the free buffer's fence hasn't been signalled yet (the application can do other work and retry).
+ * @note Other than not waiting, it behaves like \ref framebufferBegin, and must be paired with \ref framebufferEnd when it succeeds.
+ */
+Result framebufferTryBegin(Framebuffer* fb, void** out_buf, u32* out_stride);
+
 /**
  * @brief Finishes rendering a frame in a \ref Framebuffer.
  * @param[in] fb Pointer to \ref Framebuffer structure.
@@ -0,0 +1,69 @@
+/**
+ * @file framebuffer_2d.h
+ * @brief GPU 2D engine acceleration (fill, copy and format conversion) for \ref Framebuffer.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "../nvidia/address_space.h"
+#include "../nvidia/gpu_channel.h"
+#include "../nvidia/cmd_ring.h"
+#include "framebuffer.h"
+
+/// Linear image used as a source by \ref framebuffer2dBlit, e.g. sub-allocated with \ref nvHeapAlloc.
+typedef struct {
+    iova_t iova;    ///< GPU address, in the address space of the \ref Framebuffer2D.
+    u32 width;      ///< Width in pixels.
+    u32 height;     ///< Height in pixels.
+    u32 pitch;      ///< Distance in bytes between rows, a multiple of 32.
+    u32 format;     ///< Pixel format (see PIXEL_FORMAT_* enum), converted to the one of the framebuffer.
+} Framebuffer2DImage;
+
+/// 2D acceleration context of a \ref Framebuffer.
+typedef struct {
+    Framebuffer* fb;
+    NvGpuChannel* channel;
+    NvAddressSpace* as;
+    NvCmdRing ring;
+    iova_t fb_iova;         ///< Buffers of the framebuffer, mapped in the address space.
+    u32 fb_format;          ///< 2D engine format of the framebuffer.
+    iova_t dst_iova;        ///< Destination last set on the engine, 0 if none.
+    iova_t src_iova;        ///< Source last set on the engine, 0 if none.
+    u32 src_format;         ///< 2D engine format of the source last set on the engine.
+    u32 src_layout;         ///< Layout of the source last set on the engine.
+    u32 src_pitch;          ///< Pitch of the source last set on the engine.
+    u32 src_width;          ///< Width of the source last set on the engine.
+    u32 src_height;         ///< Height of the source last set on the engine.
+} Framebuffer2D;
+
+/**
+ * @brief Creates a 2D acceleration context for a \ref Framebuffer.
+ * @param[out] g Output \ref Framebuffer2D structure.
+ * @param[in] fb Framebuffer, which must be block linear (\ref framebufferMakeLinear not used), in \ref PIXEL_FORMAT_RGBA_8888, \ref PIXEL_FORMAT_RGBX_8888, \ref PIXEL_FORMAT_BGRA_8888 or \ref PIXEL_FORMAT_RGB_565.
+ * @param[in] c GPU channel the commands are submitted to, created in the address space \p as.
+ * @param[in] as GPU address space the framebuffer is mapped in.
+ * @return Result code.
+ * @note Usage: \ref framebufferBegin, then any number of 2D operations (and CPU drawing), then \ref framebuffer2dEnd instead of \ref framebufferEnd.
+ *       The image is drawn directly in the block linear layout, without any conversion or cache flush on the CPU.
+ */
+Result framebuffer2dCreate(Framebuffer2D* g, Framebuffer* fb, NvGpuChannel* c, NvAddressSpace* as);
+
+/// Closes a \ref Framebuffer2D, waiting for the GPU to be done with it.
+void framebuffer2dClose(Framebuffer2D* g);
+
+/**
+ * @brief Fills a rectangle of the current buffer with a color.
+ * @param[in] color Packed color, in the pixel format of the framebuffer (see \ref RGBA8 and the like).
+ */
+Result framebuffer2dFill(Framebuffer2D* g, u32 x, u32 y, u32 width, u32 height, u32 color);
+
+/// Copies a rectangle of the current buffer to another place of it. The rectangles must not overlap.
+Result framebuffer2dCopy(Framebuffer2D* g, u32 dst_x, u32 dst_y, u32 src_x, u32 src_y, u32 width, u32 height);
+
+/// Copies a rectangle of a linear image to the current buffer, converting its pixel format.
+Result framebuffer2dBlit(Framebuffer2D* g, u32 dst_x, u32 dst_y, const Framebuffer2DImage* src, u32 src_x, u32 src_y, u32 width, u32 height);
+
+/**
+ * @brief Submits the 2D operations of the frame and queues the buffer, which is presented once the GPU is done with it.
+ * @note CPU drawing to the buffer in the same frame must be flushed with \ref armDCacheFlush before the 2D operations touching it.
+ */
+void framebuffer2dEnd(Framebuffer2D* g);
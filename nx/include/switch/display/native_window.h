@@ -13,6 +13,28 @@
 #include "binder.h"
 #include "buffer_producer.h"
 
+/// Number of frames kept in the rolling history of \ref NWindowFrameStats.
+#define NWINDOW_FRAME_HISTORY 128
+
+/// Frame timing statistics of a \ref NWindow, see \ref nwindowEnableFrameStats.
+typedef struct {
+    u64 num_frames;                         ///< Number of buffers queued.
+    u64 missed_vsyncs;                      ///< Refreshes missed: queue to queue intervals longer than the swap interval allows, at 60 Hz.
+    u64 total_dequeue_wait;                 ///< Total system ticks spent waiting for a free buffer in \ref nwindowDequeueBuffer.
+    u64 max_dequeue_wait;                   ///< Longest of these waits.
+    u64 last_queue_tick;                    ///< System tick of the last queue.
+    u32 max_pending;                        ///< Highest number of buffers pending in the compositor after a queue.
+    u32 history_pos;                        ///< Index of the next history entry to write.
+    u32 frame_us[NWINDOW_FRAME_HISTORY];    ///< Rolling queue to queue intervals, in microseconds (0 for entries not written yet).
+    u8 pending[NWINDOW_FRAME_HISTORY];      ///< Buffers pending in the compositor after each of these queues, each one adding a refresh to the queue to scanout latency.
+} NWindowFrameStats;
+
+/// Presentation mode of a \ref NWindow, see \ref nwindowSetPresentMode.
+typedef enum {
+    NWindowPresentMode_Fifo = 0,    ///< Every queued buffer is presented in order (default). With N buffers, up to N-1 frames can be waiting for the display, and dequeuing waits for one to be released.
+    NWindowPresentMode_Mailbox,     ///< A queued buffer replaces the one waiting in the compositor if it wasn't presented yet, which is released right away. The application is never throttled by the display when using three buffers, and the latency stays at most one refresh.
+} NWindowPresentMode;
+
 /// Native window structure.
 typedef struct NWindow {
     u32 magic;
@@ -33,9 +55,11 @@ typedef struct NWindow {
     u32 default_width;
     u32 default_height;
     u32 swap_interval;
+    NWindowPresentMode present_mode;
     bool is_connected;
     bool producer_controlled_by_app;
     bool consumer_running_behind;
+    NWindowFrameStats* stats;
 } NWindow;
 
 ///@name Basic functions
@@ -131,6 +155,22 @@ Result nwindowSetTransform(NWindow* nw, u32 transform);
  */
 Result nwindowSetSwapInterval(NWindow* nw, u32 swap_interval);
 
+/**
+ * @brief Configures the presentation mode of a \ref NWindow, trading latency for throughput.
+ * @param[in] nw Pointer to \ref NWindow structure.
+ * @param[in] mode Presentation mode.
+ * @note The default mode is \ref NWindowPresentMode_Fifo. For the default window, the mode and swap interval applied at startup can be set with the weak symbols __nx_win_present_mode and __nx_win_swap_interval.
+ * @note Unlike \ref FramebufferPresentMode_Mailbox, which skips frames on the application side, this mode has the compositor drop them, and works with any producer.
+ */
+Result nwindowSetPresentMode(NWindow* nw, NWindowPresentMode mode);
+
+/**
+ * @brief Gets the number of buffers the compositor keeps for itself, i.e. the number of buffers that can be dequeued at once is the number configured minus this.
+ * @param[in] nw Pointer to \ref NWindow structure.
+ * @param[out] out Output value.
+ */
+Result nwindowGetMinUndequeuedBuffers(NWindow* nw, u32* out);
+
 /// Checks whether the consumer of a \ref NWindow is running behind.
 static inline bool nwindowIsConsumerRunningBehind(NWindow* nw)
 {
@@ -166,6 +206,16 @@ Result nwindowConfigureBuffer(NWindow* nw, s32 slot, NvGraphicBuffer* buf);
  */
 Result nwindowDequeueBuffer(NWindow* nw, s32* out_slot, NvMultiFence* out_fence);
 
+/**
+ * @brief Dequeues a buffer from a \ref NWindow if one is free, without waiting.
+ * @param[in] nw Pointer to \ref NWindow structure.
+ * @param[out] out_slot Output variable containing the ID of the slot that has been dequeued.
+ * @param[out] out_fence Output variable containing the \ref NvMultiFence to wait on before writing to the buffer (mandatory).
+ * @return Result code. MAKERESULT(Module_LibnxBinder, LibnxBinderError_WouldBlock) if no buffer is free.
+ * @note This only avoids waiting with windows which have a buffer release event (the default window does), otherwise it behaves like \ref nwindowDequeueBuffer.
+ */
+Result nwindowTryDequeueBuffer(NWindow* nw, s32* out_slot, NvMultiFence* out_fence);
+
 /**
  * @brief Cancels a buffer previously dequeued with \ref nwindowDequeueBuffer.
  * @param[in] nw Pointer to \ref NWindow structure.
@@ -187,4 +237,32 @@ Result nwindowQueueBuffer(NWindow* nw, s32 slot, const NvMultiFence* fence);
 /// Releases all buffers registered with a \ref NWindow.
 Result nwindowReleaseBuffers(NWindow* nw);
 
+/**
+ * @brief Enables recording frame timing statistics in a \ref NWindow, from the dequeue and queue calls.
+ * @param[in] nw Pointer to \ref NWindow structure.
+ * @return Result code.
+ */
+Result nwindowEnableFrameStats(NWindow* nw);
+
+/**
+ * @brief Gets the frame timing statistics of a \ref NWindow.
+ * @param[in] nw Pointer to \ref NWindow structure.
+ * @param[out] out Statistics.
+ * @return Result code.
+ */
+Result nwindowGetFrameStats(NWindow* nw, NWindowFrameStats* out);
+
+/// Resets the frame timing statistics of a \ref NWindow.
+void nwindowResetFrameStats(NWindow* nw);
+
+/**
+ * @brief Builds a histogram of the frame times in the rolling history of a \ref NWindow.
+ * @param[in] nw Pointer to \ref NWindow structure.
+ * @param[out] buckets Histogram: bucket n counts the frames which took [n*bucket_us, (n+1)*bucket_us), the last one also counts longer frames.
+ * @param[in] num_buckets Number of buckets.
+ * @param[in] bucket_us Width of a bucket, in microseconds.
+ * @return Number of frames in the histogram.
+ */
+u32 nwindowGetFrameTimeHistogram(NWindow* nw, u32* buckets, u32 num_buckets, u32 bucket_us);
+
 ///@}
@@ -86,6 +86,7 @@ enum {
     NATIVE_WINDOW_WIDTH     = 0,
     NATIVE_WINDOW_HEIGHT    = 1,
     NATIVE_WINDOW_FORMAT    = 2,
+    NATIVE_WINDOW_MIN_UNDEQUEUED_BUFFERS = 3,
 //...
 //    NATIVE_WINDOW_DEFAULT_WIDTH = 6, //These two return invalid data.
 //    NATIVE_WINDOW_DEFAULT_HEIGHT = 7,
@@ -12,6 +12,7 @@
 typedef struct Barrier {
     u64 count;  ///< Number of threads to reach the barrier.
     u64 total;  ///< Number of threads to wait on.
+    u32 generation; ///< Incremented each time the barrier releases its threads, waited on with \ref futexWait on [4.0.0+].
     Mutex mutex;
     CondVar condvar;
 } Barrier;
@@ -48,6 +48,7 @@ static inline Result condvarWait(CondVar* c, Mutex* m)
  * @param[in] c Condition variable object.
  * @param[in] num Maximum number of threads to wake up (or -1 to wake them all up).
  * @return Result code.
+ * @note The kernel morphs the wait of the signaled threads: if the mutex is owned, they're moved onto its wait list instead of being woken, and the mutex is handed over to them one at a time as it's unlocked. Waking many threads doesn't make them contend on the mutex, but each one still runs and rechecks its predicate: when N items are made available, waking N threads avoids the spurious wakeups of \ref condvarWakeAll.
  */
 static inline Result condvarWake(CondVar* c, int num)
 {
@@ -69,6 +70,7 @@ static inline Result condvarWakeOne(CondVar* c)
  * @brief Wakes up all thread waiting on a condition variable.
  * @param[in] c Condition variable object.
  * @return Result code.
+ * @note Preferably called with the mutex held, so that all the threads are requeued onto it, see \ref condvarWake.
  */
 static inline Result condvarWakeAll(CondVar* c)
 {
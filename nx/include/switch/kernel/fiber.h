@@ -0,0 +1,74 @@
+/**
+ * @file fiber.h
+ * @brief Cooperative fibers (user-mode threads) with pooled stacks.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "../types.h"
+
+/// Default stack size of a fiber.
+#define FIBER_DEFAULT_STACK_SIZE 0x4000
+
+/// Fiber entrypoint.
+typedef void (*FiberFunc)(void* arg);
+
+/// Saved fiber context: callee-saved registers, and the newlib state and thread-local segment stored in the thread vars.
+typedef struct {
+    u64 x[12];              ///< x19-x30
+    u64 sp;
+    void* reent;
+    void* tls_tp;
+    u64 padding;
+    u64 d[8];               ///< d8-d15
+} FiberContext;
+
+/// Fiber object.
+typedef struct {
+    FiberContext ctx;       ///< Context of the fiber while it isn't running.
+    FiberContext caller;    ///< Context of whoever resumed the fiber, while it runs.
+    FiberFunc entry;
+    void* arg;
+    void* mem;              ///< Stack, newlib state and thread-local segment.
+    size_t mem_sz;
+    bool running;
+    bool finished;
+} Fiber;
+
+/**
+ * @brief Creates a fiber.
+ * @param[out] f Fiber object.
+ * @param[in] entry Entrypoint.
+ * @param[in] arg Argument passed to the entrypoint.
+ * @param[in] stack_sz Stack size, 0 for \ref FIBER_DEFAULT_STACK_SIZE. Stacks of closed fibers are pooled and reused.
+ * @note Each fiber has its own errno/newlib state and thread-local (__thread) variables, which follow it if it's resumed from another thread. The thread handle and the TLS slots of \ref threadTlsGet remain those of the thread running the fiber, so a fiber must not yield while holding a \ref Mutex.
+ * @return Result code.
+ */
+Result fiberCreate(Fiber* f, FiberFunc entry, void* arg, size_t stack_sz);
+
+/**
+ * @brief Frees a fiber. It must not be running.
+ * @param f Fiber object.
+ */
+void fiberClose(Fiber* f);
+
+/**
+ * @brief Switches to a fiber, returning when it yields or its entrypoint returns.
+ * @param f Fiber object, which must be neither running nor finished. It can be resumed from any thread, or from another fiber.
+ * @note After a fiber yields, it can be resumed again once the call which resumed it has returned, e.g. by resubmitting it as a task from there.
+ */
+void fiberResume(Fiber* f);
+
+/// Switches from the current fiber back to whoever resumed it. Must be called from a fiber.
+void fiberYield(void);
+
+/// Gets the current fiber, NULL when not called from a fiber.
+Fiber* fiberGetCurrent(void);
+
+/// Returns whether the entrypoint of a fiber has returned.
+static inline bool fiberIsFinished(Fiber* f)
+{
+    return f->finished;
+}
+
+/// Frees the pooled stacks of closed fibers.
+void fiberPoolFlush(void);
@@ -0,0 +1,25 @@
+/**
+ * @file futex.h
+ * @brief Futex-style wait/wake on a 32-bit word, using the kernel's address arbiter. [4.0.0+]
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "../types.h"
+
+/**
+ * @brief Waits on an address for as long as it contains the expected value, until woken by \ref futexWake.
+ * @param addr Address of the word, must be 4-byte aligned.
+ * @param[in] expected Value the word is expected to contain.
+ * @param[in] timeout Timeout in nanoseconds, UINT64_MAX to wait indefinitely.
+ * @return Result code. KERNELRESULT(InvalidState) if the word didn't contain the expected value, KERNELRESULT(TimedOut) on timeout.
+ * @note Spurious wakeups are possible, callers should check the word again.
+ */
+Result futexWait(u32* addr, u32 expected, u64 timeout);
+
+/**
+ * @brief Wakes threads waiting on an address with \ref futexWait.
+ * @param addr Address of the word.
+ * @param[in] count Maximum number of threads to wake, or a non-positive value to wake all of them.
+ * @return Result code.
+ */
+Result futexWake(u32* addr, s32 count);
@@ -0,0 +1,96 @@
+/**
+ * @file jit_cache.h
+ * @brief JIT code cache: bump-allocated code spread over several JIT buffers, with incremental flushing.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "../types.h"
+#include "jit.h"
+
+/// Maximum number of JIT buffers in a code cache.
+#define JIT_CACHE_MAX_REGIONS 16
+
+/// Maximum number of dirty ranges tracked for each JIT buffer, closest ranges get merged beyond that.
+#define JIT_CACHE_MAX_DIRTY_RANGES 8
+
+/// Range of a JIT buffer modified since the last flush.
+typedef struct {
+    u32 start;
+    u32 end;
+} JitCacheRange;
+
+/// JIT buffer of a code cache.
+typedef struct {
+    Jit jit;
+    size_t used;                                        ///< Amount of the buffer allocated.
+    u64* exec_pages;                                    ///< For \ref JitType_CodeMemory, bitmap of the pages mapped as executable.
+    u32 num_dirty;
+    JitCacheRange dirty[JIT_CACHE_MAX_DIRTY_RANGES];    ///< Sorted, non-overlapping dirty ranges.
+} JitCacheRegion;
+
+/// JIT code cache object.
+typedef struct {
+    JitCacheRegion regions[JIT_CACHE_MAX_REGIONS];
+    u32 num_regions;
+    u32 max_regions;
+    u32 cur_region;                                     ///< Region allocations are made from.
+    size_t region_size;
+} JitCache;
+
+/**
+ * @brief Creates a code cache. JIT buffers are created as they are needed.
+ * @param c Code cache.
+ * @param region_size Size of each JIT buffer (rounded up to page alignment).
+ * @param max_regions Maximum number of JIT buffers, at most \ref JIT_CACHE_MAX_REGIONS.
+ * @return Result code.
+ */
+Result jitCacheCreate(JitCache* c, size_t region_size, u32 max_regions);
+
+/**
+ * @brief Closes a code cache, destroying its JIT buffers.
+ * @param c Code cache.
+ * @return Result code.
+ */
+Result jitCacheClose(JitCache* c);
+
+/**
+ * @brief Allocates a block of code, which is marked dirty.
+ * @param c Code cache.
+ * @param size Size of the block.
+ * @param[out] out_rw Writable address of the block.
+ * @param[out] out_rx Executable address of the block.
+ * @return Result code.
+ * @note The block isn't executable until \ref jitCacheFlush is called. With \ref JitType_CodeMemory, this makes the pages covered by the block temporarily non-executable, code sharing them must not run until the next flush.
+ */
+Result jitCacheAlloc(JitCache* c, size_t size, void** out_rw, void** out_rx);
+
+/**
+ * @brief Makes a range of already allocated code writable, and marks it dirty. Use it before patching code.
+ * @param c Code cache.
+ * @param rw Writable address of the range.
+ * @param size Size of the range.
+ * @return Result code.
+ * @note The same restriction as \ref jitCacheAlloc applies to the pages covered by the range.
+ */
+Result jitCacheMarkDirty(JitCache* c, void* rw, size_t size);
+
+/**
+ * @brief Makes the dirty ranges executable. Only the cache lines (and with \ref JitType_CodeMemory, the pages) touching them are maintained (remapped).
+ * @param c Code cache.
+ * @return Result code.
+ */
+Result jitCacheFlush(JitCache* c);
+
+/**
+ * @brief Frees all the code in a code cache. Its JIT buffers are kept for reuse.
+ * @param c Code cache.
+ */
+void jitCacheReset(JitCache* c);
+
+/**
+ * @brief Gets the executable address of code from its writable address.
+ * @param c Code cache.
+ * @param rw Writable address.
+ * @return Executable address, or NULL if the address isn't in the code cache.
+ */
+void* jitCacheGetRxAddr(JitCache* c, void* rw);
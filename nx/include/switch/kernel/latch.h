@@ -0,0 +1,52 @@
+/**
+ * @file latch.h
+ * @brief Countdown latch, for fork/join: threads wait until the counter reaches zero.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "../types.h"
+
+/// Latch structure.
+typedef struct Latch {
+    u32 count; ///< Remaining count, also the arbitration address of waiting threads.
+} Latch;
+
+/**
+ * @brief Initializes a latch.
+ * @param l Latch object.
+ * @param[in] count Number of \ref latchCountDown calls needed to release waiting threads.
+ */
+static inline void latchInit(Latch *l, u32 count) {
+    l->count = count;
+}
+
+/**
+ * @brief Decrements the counter of a latch, releasing the waiting threads if it reaches zero.
+ * @param l Latch object.
+ * @param[in] n Amount to decrement the counter by, it must not exceed the remaining count.
+ */
+void latchCountDown(Latch *l, u32 n);
+
+/**
+ * @brief Waits for the counter of a latch to reach zero.
+ * @param l Latch object.
+ * @note Waiting threads park through the address arbiter on 4.0.0+, and sleep-poll on older versions.
+ */
+void latchWait(Latch *l);
+
+/**
+ * @brief Checks whether the counter of a latch has reached zero, without waiting.
+ * @param l Latch object.
+ */
+static inline bool latchTryWait(Latch *l) {
+    return __atomic_load_n(&l->count, __ATOMIC_ACQUIRE) == 0;
+}
+
+/**
+ * @brief Decrements the counter of a latch by one, then waits for it to reach zero.
+ * @param l Latch object.
+ */
+static inline void latchArriveAndWait(Latch *l) {
+    latchCountDown(l, 1);
+    latchWait(l);
+}
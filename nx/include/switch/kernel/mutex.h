@@ -72,3 +72,60 @@ bool rmutexTryLock(RMutex* m);
  * @param m Recursive mutex object.
  */
 void rmutexUnlock(RMutex* m);
+
+/// Default maximum number of spin iterations of an \ref AdaptiveMutex.
+#define ADAPTIVE_MUTEX_DEFAULT_MAX_SPIN 100
+
+/// Contention statistics of an \ref AdaptiveMutex.
+typedef struct {
+    u64 acquisitions;   ///< Number of times the mutex was acquired.
+    u64 contended;      ///< Number of acquisitions which found the mutex locked.
+    u64 spin_acquired;  ///< Number of contended acquisitions which succeeded while spinning, without waiting in the kernel.
+    u64 kernel_waits;   ///< Number of waits in the kernel (svcArbitrateLock).
+} AdaptiveMutexStats;
+
+/// Mutex which briefly spins on contention before waiting in the kernel, for very short critical sections.
+typedef struct {
+    Mutex lock;
+    u32 max_spin;               ///< Maximum number of spin iterations, 0 to never spin.
+    u32 spin_estimate;          ///< Running average of the number of spin iterations needed to acquire the mutex.
+    AdaptiveMutexStats stats;   ///< Contention statistics, updated while the mutex is held.
+} AdaptiveMutex;
+
+/**
+ * @brief Initializes an adaptive mutex.
+ * @param m Adaptive mutex object.
+ * @param max_spin Maximum number of spin iterations, for example \ref ADAPTIVE_MUTEX_DEFAULT_MAX_SPIN. 0 to never spin.
+ */
+static inline void adaptiveMutexInit(AdaptiveMutex* m, u32 max_spin)
+{
+    *m = (AdaptiveMutex){ .max_spin = max_spin };
+}
+
+/**
+ * @brief Locks an adaptive mutex.
+ * @param m Adaptive mutex object.
+ * @note On contention, spins (up to twice the recent average number of iterations, bounded by max_spin) while no other thread waits in the kernel, then waits like \ref mutexLock.
+ */
+void adaptiveMutexLock(AdaptiveMutex* m);
+
+/**
+ * @brief Attempts to lock an adaptive mutex without waiting.
+ * @param m Adaptive mutex object.
+ * @return 1 if the mutex has been acquired successfully, and 0 on contention.
+ */
+bool adaptiveMutexTryLock(AdaptiveMutex* m);
+
+/**
+ * @brief Unlocks an adaptive mutex.
+ * @param m Adaptive mutex object.
+ */
+void adaptiveMutexUnlock(AdaptiveMutex* m);
+
+/**
+ * @brief Gets the contention statistics of an adaptive mutex.
+ * @param m Adaptive mutex object.
+ * @param[out] out Statistics.
+ * @param reset Whether to reset the statistics.
+ */
+void adaptiveMutexGetStats(AdaptiveMutex* m, AdaptiveMutexStats* out, bool reset);
@@ -0,0 +1,126 @@
+/**
+ * @file queue.h
+ * @brief Bounded lock-free queues (single-producer/single-consumer and multi-producer/multi-consumer), with blocking operations integrating with \ref waitObjects.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "../types.h"
+#include "uevent.h"
+
+/// Single-producer/single-consumer bounded queue.
+typedef struct {
+    u8* buffer;
+    u32 elem_size;
+    u32 mask;                   ///< Capacity minus 1.
+
+    alignas(0x40) u32 head;     ///< Index of the next element to pop, written by the consumer.
+    alignas(0x40) u32 tail;     ///< Index of the next element to push, written by the producer.
+
+    UEvent not_empty;           ///< Signalled when an element is pushed to an empty queue.
+    UEvent not_full;            ///< Signalled when an element is popped from a full queue.
+} SpscQueue;
+
+/// Multi-producer/multi-consumer bounded queue, each element slot has a sequence number.
+typedef struct {
+    u8* cells;
+    u32 elem_size;
+    u32 cell_size;
+    u32 mask;                       ///< Capacity minus 1.
+
+    alignas(0x40) u32 enqueue_pos;
+    alignas(0x40) u32 dequeue_pos;
+
+    UEvent not_empty;               ///< Signalled when an element is pushed to an empty queue.
+    UEvent not_full;                ///< Signalled when an element is popped from a full queue.
+} MpmcQueue;
+
+/**
+ * @brief Creates a single-producer/single-consumer queue.
+ * @param[out] q SpscQueue object.
+ * @param[in] capacity Maximum number of elements, a power of two.
+ * @param[in] elem_size Size of an element.
+ * @return Result code.
+ */
+Result spscQueueCreate(SpscQueue* q, u32 capacity, u32 elem_size);
+
+/// Frees a single-producer/single-consumer queue.
+void spscQueueClose(SpscQueue* q);
+
+/// Pushes an element without waiting, returns false if the queue is full. Producer only.
+bool spscQueueTryPush(SpscQueue* q, const void* elem);
+
+/// Pops an element without waiting, returns false if the queue is empty. Consumer only.
+bool spscQueueTryPop(SpscQueue* q, void* out);
+
+/**
+ * @brief Pushes an element, waiting for space if the queue is full. Producer only.
+ * @param[in] timeout Timeout in nanoseconds, UINT64_MAX to wait indefinitely.
+ * @return Result code. KERNELRESULT(TimedOut) on timeout.
+ */
+Result spscQueuePush(SpscQueue* q, const void* elem, u64 timeout);
+
+/**
+ * @brief Pops an element, waiting for one if the queue is empty. Consumer only.
+ * @param[in] timeout Timeout in nanoseconds, UINT64_MAX to wait indefinitely.
+ * @return Result code. KERNELRESULT(TimedOut) on timeout.
+ */
+Result spscQueuePop(SpscQueue* q, void* out, u64 timeout);
+
+/// Creates a \ref Waiter signalled when elements can be popped, pop them with \ref spscQueueTryPop until it fails before waiting again.
+static inline Waiter waiterForSpscQueueNotEmpty(SpscQueue* q)
+{
+    return waiterForUEvent(&q->not_empty);
+}
+
+/// Creates a \ref Waiter signalled when elements can be pushed.
+static inline Waiter waiterForSpscQueueNotFull(SpscQueue* q)
+{
+    return waiterForUEvent(&q->not_full);
+}
+
+/**
+ * @brief Creates a multi-producer/multi-consumer queue.
+ * @param[out] q MpmcQueue object.
+ * @param[in] capacity Maximum number of elements, a power of two.
+ * @param[in] elem_size Size of an element.
+ * @return Result code.
+ */
+Result mpmcQueueCreate(MpmcQueue* q, u32 capacity, u32 elem_size);
+
+/// Frees a multi-producer/multi-consumer queue.
+void mpmcQueueClose(MpmcQueue* q);
+
+/// Pushes an element without waiting, returns false if the queue is full.
+bool mpmcQueueTryPush(MpmcQueue* q, const void* elem);
+
+/// Pops an element without waiting, returns false if the queue is empty.
+bool mpmcQueueTryPop(MpmcQueue* q, void* out);
+
+/**
+ * @brief Pushes an element, waiting for space if the queue is full.
+ * @param[in] timeout Timeout in nanoseconds, UINT64_MAX to wait indefinitely.
+ * @return Result code. KERNELRESULT(TimedOut) on timeout.
+ */
+Result mpmcQueuePush(MpmcQueue* q, const void* elem, u64 timeout);
+
+/**
+ * @brief Pops an element, waiting for one if the queue is empty.
+ * @param[in] timeout Timeout in nanoseconds, UINT64_MAX to wait indefinitely.
+ * @return Result code. KERNELRESULT(TimedOut) on timeout.
+ */
+Result mpmcQueuePop(MpmcQueue* q, void* out, u64 timeout);
+
+/**
+ * @brief Creates a \ref Waiter signalled when elements can be popped.
+ * @note The event is only signalled on the empty to non-empty transition. With several consumers, use \ref mpmcQueuePop, which passes the signal on to the next waiter when elements remain.
+ */
+static inline Waiter waiterForMpmcQueueNotEmpty(MpmcQueue* q)
+{
+    return waiterForUEvent(&q->not_empty);
+}
+
+/// Creates a \ref Waiter signalled when elements can be pushed, see \ref waiterForMpmcQueueNotEmpty.
+static inline Waiter waiterForMpmcQueueNotFull(MpmcQueue* q)
+{
+    return waiterForUEvent(&q->not_full);
+}
@@ -1,6 +1,7 @@
 /**
  * @file random.h
  * @brief OS-seeded pseudo-random number generation support (ChaCha algorithm).
+ * @note Each thread uses its own generator, seeded from a process-wide one on first use and periodically afterwards, so concurrent callers don't contend on a lock.
  * @author plutoo
  * @copyright libnx Authors
  */
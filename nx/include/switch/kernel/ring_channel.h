@@ -0,0 +1,111 @@
+/**
+ * @file ring_channel.h
+ * @brief Single-producer/single-consumer byte stream between two processes, laid out in a \ref SharedMemory block with \ref Event doorbells.
+ * @note Setup: one side creates the shared memory and calls \ref ringChannelCreate with format set, the other side maps it and calls \ref ringChannelCreate without format.
+ *       Each side then sends the handle returned by \ref ringChannelGetEventHandle to the other (e.g. as an IPC copy handle), which passes it to \ref ringChannelSetPeerEvent.
+ *       After that, data is transferred without any IPC, the doorbells are only rung when the ring goes from empty (or full) to not.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "../types.h"
+#include "../result.h"
+#include "event.h"
+#include "shmem.h"
+
+/// Role of a side of a \ref RingChannel.
+typedef enum {
+    RingChannelRole_Producer = 0, ///< Writes to the channel.
+    RingChannelRole_Consumer = 1, ///< Reads from the channel.
+} RingChannelRole;
+
+/// Header at the start of the shared memory block of a \ref RingChannel.
+typedef struct {
+    u32 magic;
+    u32 capacity;                   ///< Size of the data area, which follows the header.
+
+    alignas(0x40) u64 write_pos;    ///< Total number of bytes written, written by the producer.
+    u32 producer_closed;
+
+    alignas(0x40) u64 read_pos;     ///< Total number of bytes read, written by the consumer.
+    u32 consumer_closed;
+} RingChannelHeader;
+
+/// Ring channel object.
+typedef struct {
+    RingChannelHeader* hdr;
+    u8* data;
+    u32 capacity;
+    RingChannelRole role;
+    Event local;                    ///< Doorbell rung by this side.
+    Event peer;                     ///< Doorbell rung by the other side.
+} RingChannel;
+
+/**
+ * @brief Creates a side of a ring channel.
+ * @param[out] c RingChannel object.
+ * @param[in] s Mapped shared memory, with read/write permission. It must stay mapped until \ref ringChannelClose.
+ * @param[in] role Role of this side.
+ * @param[in] format Whether to initialize the shared memory, which must be done by exactly one side before the other one calls this.
+ * @return Result code.
+ */
+Result ringChannelCreate(RingChannel* c, SharedMemory* s, RingChannelRole role, bool format);
+
+/// Returns the read-only handle of the doorbell of this side, to be sent to the other side.
+static inline Handle ringChannelGetEventHandle(RingChannel* c)
+{
+    return c->local.revent;
+}
+
+/// Sets the doorbell of the other side, from the handle it sent. The channel takes ownership of the handle.
+void ringChannelSetPeerEvent(RingChannel* c, Handle handle);
+
+/// Closes a side of a ring channel, waking the other side. Reads on the other side fail with KERNELRESULT(ConnectionClosed) once they have read everything written.
+void ringChannelClose(RingChannel* c);
+
+/**
+ * @brief Gets the contiguous free space which can be written to without copying. Producer only.
+ * @param[out] out_ptr Start of the free space.
+ * @return Size of the free space, 0 if the ring is full.
+ * @note Use \ref ringChannelCommitWrite once data has been written there.
+ */
+size_t ringChannelGetWriteSpan(RingChannel* c, void** out_ptr);
+
+/// Publishes size bytes written to the span returned by \ref ringChannelGetWriteSpan. Producer only.
+void ringChannelCommitWrite(RingChannel* c, size_t size);
+
+/**
+ * @brief Gets the contiguous data which can be read without copying. Consumer only.
+ * @param[out] out_ptr Start of the data.
+ * @return Size of the data, 0 if the ring is empty.
+ * @note Use \ref ringChannelCommitRead once the data has been consumed.
+ */
+size_t ringChannelGetReadSpan(RingChannel* c, const void** out_ptr);
+
+/// Releases size bytes of the span returned by \ref ringChannelGetReadSpan. Consumer only.
+void ringChannelCommitRead(RingChannel* c, size_t size);
+
+/// Writes as much of data as fits without waiting, returns the number of bytes written. Producer only.
+size_t ringChannelTryWrite(RingChannel* c, const void* data, size_t size);
+
+/// Reads up to size bytes without waiting, returns the number of bytes read. Consumer only.
+size_t ringChannelTryRead(RingChannel* c, void* buf, size_t size);
+
+/**
+ * @brief Writes data, waiting for space as needed. Producer only.
+ * @param[in] timeout Timeout in nanoseconds, UINT64_MAX to wait indefinitely.
+ * @return Result code. KERNELRESULT(TimedOut) on timeout, KERNELRESULT(ConnectionClosed) if the consumer closed the channel.
+ */
+Result ringChannelWrite(RingChannel* c, const void* data, size_t size, u64 timeout);
+
+/**
+ * @brief Reads size bytes, waiting for data as needed. Consumer only.
+ * @param[in] timeout Timeout in nanoseconds, UINT64_MAX to wait indefinitely.
+ * @return Result code. KERNELRESULT(TimedOut) on timeout, KERNELRESULT(ConnectionClosed) if the producer closed the channel before enough was written.
+ */
+Result ringChannelRead(RingChannel* c, void* buf, size_t size, u64 timeout);
+
+/// Creates a \ref Waiter signalled when the other side rang the doorbell (data or space became available, or it closed the channel).
+static inline Waiter waiterForRingChannel(RingChannel* c)
+{
+    return waiterForEvent(&c->peer);
+}
@@ -78,3 +78,62 @@ bool rwlockIsWriteLockHeldByCurrentThread(RwLock* r);
  *         while it held the write lock, and 0 if it does not.
  */
 bool rwlockIsOwnedByCurrentThread(RwLock* r);
+
+/// Number of reader counters of a \ref SRwLock.
+#define SRWLOCK_NUM_SLOTS 4
+
+/// Reader counter of a \ref SRwLock, on its own cache line.
+typedef struct {
+    alignas(0x40) u32 readers;
+} SRwLockSlot;
+
+/**
+ * @brief Scalable, writer-preferring read/write lock.
+ * @note Readers only touch the counter of their slot, and only take the slow path while a writer holds or waits for the lock. Slots are chosen by thread handle, since the current core number needs a syscall.
+ * @note It isn't recursive, and can be statically initialized by assigning {0} to it.
+ */
+typedef struct {
+    SRwLockSlot slots[SRWLOCK_NUM_SLOTS];
+    alignas(0x40) u32 writer;   ///< 0 if unlocked, 1 if a writer holds or waits for the lock, 2 if additionally readers wait for it.
+    Mutex writer_mutex;         ///< Serializes writers.
+} SRwLock;
+
+/**
+ * @brief Initializes the scalable read/write lock.
+ * @param r Scalable read/write lock object.
+ */
+static inline void srwlockInit(SRwLock* r)
+{
+    *r = (SRwLock){0};
+}
+
+/**
+ * @brief Locks the scalable read/write lock for reading.
+ * @param r Scalable read/write lock object.
+ */
+void srwlockReadLock(SRwLock* r);
+
+/**
+ * @brief Attempts to lock the scalable read/write lock for reading without waiting.
+ * @param r Scalable read/write lock object.
+ * @return 1 if the lock has been acquired successfully, and 0 if a writer holds or waits for it.
+ */
+bool srwlockTryReadLock(SRwLock* r);
+
+/**
+ * @brief Unlocks the scalable read/write lock for reading.
+ * @param r Scalable read/write lock object.
+ */
+void srwlockReadUnlock(SRwLock* r);
+
+/**
+ * @brief Locks the scalable read/write lock for writing. New readers wait from this point on, then the current ones are waited for.
+ * @param r Scalable read/write lock object.
+ */
+void srwlockWriteLock(SRwLock* r);
+
+/**
+ * @brief Unlocks the scalable read/write lock for writing.
+ * @param r Scalable read/write lock object.
+ */
+void srwlockWriteUnlock(SRwLock* r);
@@ -12,15 +12,17 @@
 /// Semaphore structure.
 typedef struct Semaphore
 {
-    CondVar condvar; ///< Condition variable object.
-    Mutex   mutex;   ///< Mutex object.
-    u64     count;   ///< Internal counter.
+    CondVar condvar;     ///< Condition variable object, only used before 4.0.0.
+    Mutex   mutex;       ///< Mutex object, only used before 4.0.0.
+    u32     count;       ///< Internal counter, also the arbitration address of waiting threads.
+    u32     num_waiters; ///< Number of threads waiting for the counter to become non-zero.
 } Semaphore;
 
 /**
  * @brief Initializes a semaphore and its internal counter.
  * @param s Semaphore object.
  * @param initial_count initial value for internal counter (typically the # of free resources).
+ * @note On 4.0.0+, signalling and waiting are atomic operations on the counter, which only enter the kernel (through the address arbiter) to wake or park threads.
  */
 void semaphoreInit(Semaphore *s, u64 initial_count);
 
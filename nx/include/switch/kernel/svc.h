@@ -197,6 +197,20 @@ typedef enum {
     InitialProcessIdRangeInfo_Maximum = 1, ///< Highest initial process ID.
 } InitialProcessIdRangeInfo;
 
+/// WaitForAddress behaviors.
+typedef enum {
+    ArbitrationType_WaitIfLessThan             = 0, ///< Wait if the 32-bit value is less than argument.
+    ArbitrationType_DecrementAndWaitIfLessThan = 1, ///< Decrement the 32-bit value and wait if it is less than argument.
+    ArbitrationType_WaitIfEqual                = 2, ///< Wait if the 32-bit value is equal to argument.
+} ArbitrationType;
+
+/// SignalToAddress behaviors.
+typedef enum {
+    SignalType_Signal                                      = 0, ///< Signals the address.
+    SignalType_SignalAndIncrementIfEqual                   = 1, ///< Signals the address and increments its value if equal to argument.
+    SignalType_SignalAndModifyBasedOnWaitingThreadCountIfEqual = 2, ///< Signals the address and updates its value if equal to argument, based on the number of waiting threads.
+} SignalType;
+
 /// GetSystemInfo PhysicalMemory Sub IDs.
 typedef enum {
     PhysicalMemoryInfo_Application  = 0, ///< Memory allocated for application usage.
@@ -597,6 +611,28 @@ Result svcGetInfo(u64* out, u32 id0, Handle handle, u64 id1);
 
 ///@}
 
+///@name Cache Management
+///@{
+
+/**
+ * @brief Flushes the entire data cache, by set/way.
+ * @note Syscall number 0x2A.
+ * @warning This is a privileged syscall. Use \ref envIsSyscallHinted to check if it is available.
+ */
+void svcFlushEntireDataCache(void);
+
+/**
+ * @brief Flushes data cache for a virtual address range.
+ * @param[in] address Address of region to flush.
+ * @param[in] size Size of region to flush.
+ * @return Result code.
+ * @note Syscall number 0x2B.
+ * @warning This is a privileged syscall. Use \ref envIsSyscallHinted to check if it is available.
+ */
+Result svcFlushDataCache(void *address, size_t size);
+
+///@}
+
 ///@name Memory management
 ///@{
 
@@ -659,6 +695,28 @@ Result svcSetThreadActivity(Handle thread, bool paused);
  */
 Result svcGetThreadContext3(ThreadContext* ctx, Handle thread);
 
+/**
+ * @brief Arbitrates an address depending on type and value. [4.0.0+]
+ * @param[in] address Address to arbitrate, must be 4-byte aligned.
+ * @param[in] arb_type \ref ArbitrationType
+ * @param[in] value Value to compare against.
+ * @param[in] timeout Maximum time in nanoseconds to wait.
+ * @return Result code. KERNELRESULT(InvalidState) if the comparison failed without waiting, KERNELRESULT(TimedOut) on timeout.
+ * @note Syscall number 0x34.
+ */
+Result svcWaitForAddress(void *address, u32 arb_type, s32 value, s64 timeout);
+
+/**
+ * @brief Signals (and updates) an address depending on type and value. [4.0.0+]
+ * @param[in] address Address to arbitrate, must be 4-byte aligned.
+ * @param[in] signal_type \ref SignalType
+ * @param[in] value Value to compare against.
+ * @param[in] count Number of waiting threads to signal, or a non-positive value to signal all of them.
+ * @return Result code.
+ * @note Syscall number 0x35.
+ */
+Result svcSignalToAddress(void *address, u32 signal_type, s32 value, s32 count);
+
 ///@}
 
 ///@name Inter-process communication (IPC)
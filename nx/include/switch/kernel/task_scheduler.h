@@ -0,0 +1,114 @@
+/**
+ * @file task_scheduler.h
+ * @brief Work-stealing task scheduler, with one worker thread per available core.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "../types.h"
+#include "mutex.h"
+#include "thread.h"
+
+/// Maximum number of worker threads of a \ref TaskScheduler.
+#define TASK_SCHEDULER_MAX_WORKERS 4
+
+/// Capacity of the per-worker deques, a power of two. Tasks submitted to a full deque go to the shared queue instead.
+#define TASK_DEQUE_SIZE 256
+
+/// Maximum number of tasks a range is split into by \ref taskSchedulerParallelFor.
+#define TASK_PARALLEL_FOR_MAX_CHUNKS 16
+
+/// Task entrypoint.
+typedef void (*TaskFunc)(void* arg);
+
+/// Range task entrypoint, see \ref taskSchedulerParallelFor.
+typedef void (*TaskRangeFunc)(void* arg, size_t begin, size_t end);
+
+/// Completion counter of a group of tasks. It can be statically initialized by assigning {0} to it.
+typedef struct {
+    u32 pending;    ///< Number of tasks of the group which haven't completed yet.
+} TaskGroup;
+
+/// Task object. It is owned by the caller, and must remain valid until the task has run.
+typedef struct Task {
+    TaskFunc func;          ///< Entrypoint.
+    void* arg;              ///< Argument passed to the entrypoint.
+    TaskGroup* group;       ///< Optional group notified when the task completes.
+    struct Task* next;      ///< Used by the shared queue.
+} Task;
+
+/// Chase-Lev deque: the owning worker pushes and pops at the bottom, other workers steal from the top.
+typedef struct {
+    alignas(0x40) s64 top;
+    alignas(0x40) s64 bottom;
+    Task* tasks[TASK_DEQUE_SIZE];
+} TaskDeque;
+
+typedef struct TaskScheduler TaskScheduler;
+
+/// Worker thread of a \ref TaskScheduler.
+typedef struct {
+    TaskDeque deque;
+    TaskScheduler* ts;
+    u32 index;
+    u32 steal_seed;
+    Thread thread;
+} TaskWorker;
+
+/// Task scheduler.
+struct TaskScheduler {
+    TaskWorker workers[TASK_SCHEDULER_MAX_WORKERS];
+    u32 num_workers;
+
+    Mutex queue_mutex;              ///< Protects the shared queue, used by threads which aren't workers.
+    Task* queue_head;
+    Task* queue_tail;
+    u32 queue_size;
+
+    alignas(0x40) u32 epoch;        ///< Incremented to wake parked workers, their arbitration address.
+    u32 num_parked;
+    bool exiting;
+};
+
+/**
+ * @brief Creates a task scheduler and starts its worker threads. [4.0.0+]
+ * @param ts TaskScheduler object.
+ * @param[in] num_workers Number of workers, or 0 for one per core in the process's core mask (up to \ref TASK_SCHEDULER_MAX_WORKERS). Each worker is pinned to a core.
+ * @param[in] prio Priority of the worker threads, see \ref threadCreate.
+ * @param[in] stack_sz Stack size of the worker threads.
+ * @note Idle workers park on an address with \ref svcWaitForAddress.
+ * @return Result code.
+ */
+Result taskSchedulerCreate(TaskScheduler* ts, u32 num_workers, int prio, size_t stack_sz);
+
+/**
+ * @brief Stops the worker threads, once all submitted tasks have run, and frees them.
+ * @param ts TaskScheduler object.
+ */
+void taskSchedulerClose(TaskScheduler* ts);
+
+/**
+ * @brief Submits a task.
+ * @param ts TaskScheduler object.
+ * @param t Task object, func, arg and group must be set. When called from a worker, the task is pushed to that worker's deque, otherwise to the shared queue.
+ * @note The group's pending count is incremented before the task is queued.
+ */
+void taskSchedulerSubmit(TaskScheduler* ts, Task* t);
+
+/**
+ * @brief Waits for all tasks of a group to complete.
+ * @param ts TaskScheduler object.
+ * @param g TaskGroup object.
+ * @note When called from a worker, it runs other tasks meanwhile instead of blocking, so tasks can wait on groups of subtasks.
+ */
+void taskGroupWait(TaskScheduler* ts, TaskGroup* g);
+
+/**
+ * @brief Splits a range into tasks, runs them and waits for them to complete.
+ * @param ts TaskScheduler object.
+ * @param[in] func Range entrypoint, called with consecutive subranges of [begin, end).
+ * @param[in] arg Argument passed to the entrypoint.
+ * @param[in] begin Start of the range.
+ * @param[in] end End of the range.
+ * @param[in] grain Minimum size of a subrange.
+ */
+void taskSchedulerParallelFor(TaskScheduler* ts, TaskRangeFunc func, void* arg, size_t begin, size_t end, size_t grain);
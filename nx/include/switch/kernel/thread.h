@@ -7,8 +7,18 @@
 #pragma once
 #include "../types.h"
 #include "../arm/thread_context.h"
+#include "../arm/tls.h"
 #include "wait.h"
 
+/// Offset of the TLS slots within the thread local storage region.
+#define THREAD_TLS_SLOTS_OFFSET 0x108
+
+/// Number of TLS slots stored in the thread local storage region. The slot after them points to an array holding the remaining slots.
+#define THREAD_TLS_INLINE_SLOTS 26
+
+/// Number of TLS slots, see \ref threadTlsAlloc.
+#define THREAD_TLS_NUM_SLOTS 64
+
 /// Thread information structure.
 typedef struct Thread {
     Handle handle;         ///< Thread handle.
@@ -19,8 +29,21 @@ typedef struct Thread {
     void** tls_array;
     struct Thread* next;
     struct Thread** prev_next;
+    s32    core_id;        ///< Core requested at creation, or -1 for the process default.
 } Thread;
 
+/// Named thread priority classes, see \ref threadGetPriorityForClass.
+typedef enum {
+    ThreadPriorityClass_Realtime   = 0, ///< Latency-critical work such as audio and input (0x1C).
+    ThreadPriorityClass_High       = 1, ///< I/O and service threads (0x28).
+    ThreadPriorityClass_Normal     = 2, ///< The usual priority of the main thread (0x2C).
+    ThreadPriorityClass_Low        = 3, ///< Compute and batch work (0x30).
+    ThreadPriorityClass_Background = 4, ///< Preemptively multitasked background work on cores 0..2 (0x3B).
+} ThreadPriorityClass;
+
+/// Lets \ref threadCreateWithPolicy pick the core of the affinity mask with the fewest threads.
+#define THREAD_CORE_LEAST_LOADED (-0x10)
+
 /// Creates a \ref Waiter for a \ref Thread.
 static inline Waiter waiterForThread(Thread* t)
 {
@@ -42,6 +65,38 @@ Result threadCreate(
     Thread* t, ThreadFunc entry, void* arg, void *stack_mem, size_t stack_sz,
     int prio, int cpuid);
 
+/**
+ * @brief Gets the thread priority of a \ref ThreadPriorityClass, the nearest one allowed by the process's priority mask.
+ * @param[in] prio_class \ref ThreadPriorityClass
+ * @return Thread priority.
+ */
+int threadGetPriorityForClass(ThreadPriorityClass prio_class);
+
+/**
+ * @brief Creates a thread with a priority class and a core affinity mask.
+ * @param t Thread information structure which will be filled in.
+ * @param entry Entrypoint of the thread.
+ * @param arg Argument to pass to the entrypoint.
+ * @param stack_mem See \ref threadCreate.
+ * @param stack_sz See \ref threadCreate.
+ * @param prio_class \ref ThreadPriorityClass
+ * @param cpuid Preferred core (0~3), -2 to use the default core for the current process, or \ref THREAD_CORE_LEAST_LOADED to use the core of the mask with the fewest live threads created on an explicit core.
+ * @param affinity_mask Cores the thread may run on, 0 for every core of the process's core mask.
+ * @return Result code.
+ */
+Result threadCreateWithPolicy(
+    Thread* t, ThreadFunc entry, void* arg, void *stack_mem, size_t stack_sz,
+    ThreadPriorityClass prio_class, int cpuid, u64 affinity_mask);
+
+/**
+ * @brief Sets the core affinity of a thread.
+ * @param t Thread information structure.
+ * @param preferred_core Preferred core (0~3), or \ref THREAD_CORE_LEAST_LOADED.
+ * @param affinity_mask Cores the thread may run on, must include the preferred core.
+ * @return Result code.
+ */
+Result threadSetAffinity(Thread* t, int preferred_core, u64 affinity_mask);
+
 /**
  * @brief Starts the execution of a thread.
  * @param t Thread information structure.
@@ -68,6 +123,12 @@ Result threadWaitForExit(Thread* t);
  */
 Result threadClose(Thread* t);
 
+/**
+ * @brief Unmaps and frees the stacks kept for reuse by \ref threadClose.
+ * @note When __nx_thread_stack_cache_size is set (it's 0 by default, which disables the cache), the stacks of closed threads which owned their stack memory are kept mapped up to that many bytes, so that the next \ref threadCreate with a NULL stack_mem and the same size only needs svcCreateThread and the reent/TLS setup.
+ */
+void threadStackCacheFlush(void);
+
 /**
  * @brief Pauses the execution of a thread.
  * @param t Thread information structure.
@@ -104,19 +165,30 @@ Handle threadGetCurHandle(void);
  */
 s32 threadTlsAlloc(void (* destructor)(void*));
 
+/// Gets a pointer to a TLS slot, given the TLS slots of a thread.
+static inline void** _threadTlsSlot(void** tls_array, s32 slot_id) {
+    if (slot_id < THREAD_TLS_INLINE_SLOTS)
+        return &tls_array[slot_id];
+    return &((void**)tls_array[THREAD_TLS_INLINE_SLOTS])[slot_id - THREAD_TLS_INLINE_SLOTS];
+}
+
 /**
  * @brief Retrieves the value stored in a TLS slot.
  * @param slot_id TLS slot ID.
  * @return Value.
  */
-void* threadTlsGet(s32 slot_id);
+static inline void* threadTlsGet(s32 slot_id) {
+    return *_threadTlsSlot((void**)((u8*)armGetTls() + THREAD_TLS_SLOTS_OFFSET), slot_id);
+}
 
 /**
  * @brief Stores the specified value into a TLS slot.
  * @param slot_id TLS slot ID.
  * @param value Value.
  */
-void threadTlsSet(s32 slot_id, void* value);
+static inline void threadTlsSet(s32 slot_id, void* value) {
+    *_threadTlsSlot((void**)((u8*)armGetTls() + THREAD_TLS_SLOTS_OFFSET), slot_id) = value;
+}
 
 /**
  * @brief Frees a TLS slot.
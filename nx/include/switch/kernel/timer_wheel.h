@@ -0,0 +1,86 @@
+/**
+ * @file timer_wheel.h
+ * @brief Hierarchical timer wheel, multiplexing many logical timers onto a single waitable object.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "wait.h"
+
+/// Number of levels of a \ref TimerWheel.
+#define TIMER_WHEEL_LEVELS 4
+
+/// log2 of the number of slots per level of a \ref TimerWheel.
+#define TIMER_WHEEL_SLOT_BITS 6
+
+/// Number of slots per level of a \ref TimerWheel.
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_SLOT_BITS)
+
+typedef struct TimerWheelEntry TimerWheelEntry;
+
+/// Timer callback, called by \ref timerWheelProcess.
+typedef void (*TimerWheelFunc)(TimerWheelEntry* e, void* arg);
+
+/// Logical timer. It is owned by the caller, and must remain valid until it has fired or been cancelled.
+struct TimerWheelEntry {
+    TimerWheelEntry* next;
+    TimerWheelEntry** pprev;    ///< Link to this entry, NULL when it isn't pending.
+    u64 expiry;                 ///< Expiry, in wheel ticks.
+    TimerWheelFunc func;
+    void* arg;
+    u8 level;
+    u8 slot;
+};
+
+/// Timer wheel object. It is signalled when timers have expired, and their callbacks can be run with \ref timerWheelProcess.
+typedef struct {
+    Waitable waitable;
+    u64 base_tick;          ///< System tick of wheel tick 0.
+    u64 resolution;         ///< System ticks per wheel tick.
+    u64 now;                ///< Next wheel tick to process.
+    u64 armed;              ///< Wheel tick a waiter is currently waiting for.
+    u64 occupied[TIMER_WHEEL_LEVELS];
+    TimerWheelEntry* slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+    TimerWheelEntry* ready; ///< Expired timers whose callbacks haven't run yet.
+} TimerWheel;
+
+/// Creates a waiter for a timer wheel.
+static inline Waiter waiterForTimerWheel(TimerWheel* w)
+{
+    Waiter wait_obj;
+    wait_obj.type = WaiterType_Waitable;
+    wait_obj.waitable = &w->waitable;
+    return wait_obj;
+}
+
+/**
+ * @brief Creates a timer wheel.
+ * @param[out] w TimerWheel object.
+ * @param[in] resolution Duration of a wheel tick, in nanoseconds. Timers fire at most this late. With 4 levels of 64 slots, timers up to 2^24 ticks away are handled without re-cascading.
+ */
+void timerWheelCreate(TimerWheel* w, u64 resolution);
+
+/**
+ * @brief Arms a timer, re-arming it if it is already pending. O(1).
+ * @param w TimerWheel object.
+ * @param e Timer entry.
+ * @param[in] timeout Timeout, in nanoseconds.
+ * @param[in] func Callback.
+ * @param[in] arg Argument passed to the callback.
+ */
+void timerWheelAdd(TimerWheel* w, TimerWheelEntry* e, u64 timeout, TimerWheelFunc func, void* arg);
+
+/**
+ * @brief Cancels a timer. O(1).
+ * @param w TimerWheel object.
+ * @param e Timer entry.
+ * @return Whether the timer was pending. Once its callback has started running, it can no longer be cancelled.
+ */
+bool timerWheelCancel(TimerWheel* w, TimerWheelEntry* e);
+
+/**
+ * @brief Advances the wheel to the current time and runs the callbacks of expired timers.
+ * @param w TimerWheel object.
+ * @note Callbacks run without the wheel locked, and may add or cancel timers.
+ * @return Number of callbacks run.
+ */
+u32 timerWheelProcess(TimerWheel* w);
@@ -16,6 +16,7 @@ typedef struct {
     Permission  perm;     ///< Permissions of the transfer memory object.
     void*       src_addr; ///< Address of the source backing memory.
     void*       map_addr; ///< Address to which the transfer memory object is mapped.
+    size_t      alloc_size; ///< Size of the backing memory allocated by \ref tmemCreate, 0 when src_addr wasn't allocated by it.
 } TransferMemory;
 
 /**
@@ -24,6 +25,7 @@ typedef struct {
  * @param size Size of the transfer memory object to create.
  * @param perm Permissions with which to protect the transfer memory in the local process.
  * @return Result code.
+ * @note The backing memory of objects closed with \ref tmemClose is kept for reuse, up to __nx_tmem_cache_size bytes (a weak symbol, 0 to disable), and taken again for sizes it fits without wasting more than a quarter of it. Services which need transfer memory each time they're opened (audio/video decoders, etc) then don't allocate it again. Memory is only reused once the service released it.
  */
 Result tmemCreate(TransferMemory* t, size_t size, Permission perm);
 
@@ -78,3 +80,6 @@ static inline void* tmemGetAddr(TransferMemory* t){
  * @return Result code.
  */
 Result tmemClose(TransferMemory* t);
+
+/// Frees the backing memory kept for reuse by \ref tmemCreate, see __nx_tmem_cache_size.
+void tmemCacheFlush(void);
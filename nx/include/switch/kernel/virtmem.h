@@ -9,13 +9,14 @@
 
 /**
  * @brief Reserves a slice of general purpose address space.
+ * @note Reservations are tracked in-process, so the kernel is only queried about address space not known to be in use.
  * @param size The size of the slice of address space that will be reserved (rounded up to page alignment).
  * @return Pointer to the slice of address space, or NULL on failure.
  */
 void* virtmemReserve(size_t size);
 
 /**
- * @brief Relinquishes a slice of address space reserved with virtmemReserve (currently no-op).
+ * @brief Relinquishes a slice of address space reserved with virtmemReserve.
  * @param addr Pointer to the slice.
  * @param size Size of the slice.
  */
@@ -29,8 +30,22 @@ void  virtmemFree(void* addr, size_t size);
 void* virtmemReserveStack(size_t size);
 
 /**
- * @brief Relinquishes a slice of address space reserved with virtmemReserveStack (currently no-op).
+ * @brief Relinquishes a slice of address space reserved with virtmemReserveStack.
  * @param addr Pointer to the slice.
  * @param size Size of the slice.
  */
 void  virtmemFreeStack(void* addr, size_t size);
+
+/**
+ * @brief Reserves a slice of address space inside the alias memory mapping region (for use with svcMapPhysicalMemory).
+ * @param size The size of the slice of address space that will be reserved (rounded up to page alignment).
+ * @return Pointer to the slice of address space, or NULL on failure.
+ */
+void* virtmemReserveAlias(size_t size);
+
+/**
+ * @brief Relinquishes a slice of address space reserved with virtmemReserveAlias.
+ * @param addr Pointer to the slice.
+ * @param size Size of the slice.
+ */
+void  virtmemFreeAlias(void* addr, size_t size);
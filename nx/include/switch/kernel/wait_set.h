@@ -0,0 +1,92 @@
+/**
+ * @file wait_set.h
+ * @brief Wait set, waiting on more generic waitable synchronization objects than \ref MAX_WAIT_OBJECTS.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "../types.h"
+#include "svc.h"
+#include "mutex.h"
+#include "condvar.h"
+#include "thread.h"
+#include "uevent.h"
+
+/// Number of objects per group of a \ref WaitSet, one slot of each kernel wait is reserved for notifications.
+#define WAITSET_GROUP_SIZE (MAX_WAIT_OBJECTS - 1)
+
+/// Stack size of the helper threads of a \ref WaitSet.
+#define WAITSET_HELPER_STACK_SIZE 0x4000
+
+typedef struct WaitSet WaitSet;
+
+/// Group of up to \ref WAITSET_GROUP_SIZE objects. The first group is waited on by the thread calling \ref waitSetWait, the others by a helper thread each.
+typedef struct {
+    WaitSet* ws;
+    Waiter objects[WAITSET_GROUP_SIZE];
+    void* userdata[WAITSET_GROUP_SIZE];
+    u32 count;
+    u32 generation;     ///< Incremented when the objects change.
+
+    Thread thread;
+    UEvent control;     ///< Signalled to make the helper thread reload the objects or exit.
+    u32 ack_generation; ///< Generation of the objects the helper thread is waiting on.
+    bool reported;      ///< An object was signalled in the helper thread.
+    void* report_userdata;
+    u32 report_generation;
+    Result report_rc;
+    bool resume;        ///< The report was returned by \ref waitSetWait, the helper thread resumes on the next call.
+} WaitSetGroup;
+
+/// Wait set object.
+struct WaitSet {
+    Mutex mutex;
+    CondVar ack_cv;
+    UEvent report;      ///< Signalled when a helper thread reports an object.
+    WaitSetGroup** groups;
+    u32 num_groups;
+    u32 num_objects;
+    u32 next_report;    ///< Helper group checked first, rotated for fairness.
+    bool exiting;
+};
+
+/**
+ * @brief Creates a wait set.
+ * @param[out] ws WaitSet object.
+ * @note A WaitSet is owned by a single thread: \ref waitSetAdd, \ref waitSetRemove and \ref waitSetWait must not be called concurrently.
+ */
+void waitSetCreate(WaitSet* ws);
+
+/**
+ * @brief Stops the helper threads of a wait set and frees it.
+ * @param ws WaitSet object.
+ */
+void waitSetClose(WaitSet* ws);
+
+/**
+ * @brief Adds an object to a wait set.
+ * @param ws WaitSet object.
+ * @param[in] w \ref Waiter for the object.
+ * @param[in] userdata Value reported by \ref waitSetWait when the object is signalled, it must be unique within the set.
+ * @note Every \ref WAITSET_GROUP_SIZE objects beyond the first ones, a helper thread is started at the priority of the calling thread. Helper threads are kept until the set is closed.
+ * @return Result code.
+ */
+Result waitSetAdd(WaitSet* ws, Waiter w, void* userdata);
+
+/**
+ * @brief Removes an object from a wait set.
+ * @param ws WaitSet object.
+ * @param[in] userdata Value the object was added with.
+ * @note Once this returns, no thread waits on the object anymore, so it can be closed.
+ * @return Whether the object was found.
+ */
+bool waitSetRemove(WaitSet* ws, void* userdata);
+
+/**
+ * @brief Waits for any of the objects of a wait set to be signalled.
+ * @param ws WaitSet object.
+ * @param[out] userdata_out Value the signalled object was added with.
+ * @param[in] timeout Timeout (in nanoseconds).
+ * @note An object reported by a helper thread isn't waited on again until the next call, so it should be handled (e.g. a session request received) before calling this again.
+ * @return Result code.
+ */
+Result waitSetWait(WaitSet* ws, void** userdata_out, u64 timeout);
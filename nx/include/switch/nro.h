@@ -11,6 +11,8 @@
 #define NROASSETHEADER_MAGIC 0x54455341
 #define NROASSETHEADER_VERSION 0
 
+#define NRRHEADER_MAGIC 0x3052524e
+
 /// Entry for each segment in the codebin.
 typedef struct {
     u32 file_off;
@@ -52,3 +54,23 @@ typedef struct {
     NroAssetSection romfs;
 } NroAssetHeader;
 
+
+/// NRR header, followed by the sorted SHA256 hashes of the NROs which may be loaded.
+typedef struct {
+    u32 magic;
+    u8  key_generation;
+    u8  reserved_x5[0xB];
+    u64 program_id_mask;        ///< The program id of the process, masked with this, must match program_id_pattern.
+    u64 program_id_pattern;
+    u8  reserved_x20[0x10];
+    u8  modulus[0x100];         ///< Certification public key.
+    u8  certification_signature[0x100];
+    u8  signature[0x100];       ///< Signature of the header from program_id, with the certification key.
+    u64 program_id;
+    u32 size;                   ///< Size of the NRR, 0x1000-aligned.
+    u8  nrr_kind;               ///< [7.0.0+] 0 for user NRRs, 1 for JIT.
+    u8  reserved_x33d[3];
+    u32 hashes_offset;
+    u32 num_hashes;
+    u8  reserved_x348[8];
+} NrrHeader;
@@ -0,0 +1,54 @@
+#pragma once
+#include "types.h"
+#include "map.h"
+#include "fence.h"
+#include "gpu_channel.h"
+
+#define NV_CMD_RING_MAX_SEGMENTS 16
+
+// Pushbuffer memory for a NvGpuChannel, split into segments used round-robin.
+// Commands are reserved and committed in the current segment, and batched into a single GPFIFO entry
+// until nvCmdRingFlush. The channel is only kicked off by nvCmdRingSubmit, or when moving on to the next segment.
+// Each segment records the channel fence of its last kickoff, which is waited on before it is written to again.
+
+typedef struct NvCmdRingSegment {
+    NvFence fence;
+    bool    in_flight;
+} NvCmdRingSegment;
+
+typedef struct NvCmdRing {
+    NvGpuChannel* channel;
+    struct NvAddressSpace* as;
+    NvMap  map;
+    u32*   cpu_addr;
+    iova_t gpu_addr;
+    u32    segment_words;
+    u32    num_segments;
+    u32    cur_segment;
+    u32    cur_word;     // Next free word in the current segment.
+    u32    entry_word;   // First word of the current segment not yet in a GPFIFO entry.
+    u32    reserved;     // Words reserved by the last nvCmdRingReserve.
+    NvCmdRingSegment segments[NV_CMD_RING_MAX_SEGMENTS];
+} NvCmdRing;
+
+Result nvCmdRingCreate(NvCmdRing* r, NvGpuChannel* c, struct NvAddressSpace* as, u32 segment_size, u32 num_segments);
+void   nvCmdRingClose(NvCmdRing* r);
+
+// Returns room for num_words commands, or NULL if num_words doesn't fit in a segment or the submission failed.
+// May kick off the channel and wait for the GPU to be done with the next segment.
+u32*   nvCmdRingReserve(NvCmdRing* r, u32 num_words);
+void   nvCmdRingCommit(NvCmdRing* r, u32 num_words);
+
+// Appends the GPFIFO entry of the commands committed since the last flush, without kicking off.
+Result nvCmdRingFlush(NvCmdRing* r);
+// Flushes and kicks off the channel. nvGpuChannelGetFence then returns the fence of the submitted commands.
+// The channel must not be kicked off directly while commands are pending, as the segment fence would be missed.
+Result nvCmdRingSubmit(NvCmdRing* r);
+
+// Waits for the GPU to be done with every segment.
+Result nvCmdRingWaitIdle(NvCmdRing* r, s32 timeout_us);
+
+static inline iova_t nvCmdRingGetGpuAddr(NvCmdRing* r, const u32* cpu_ptr)
+{
+    return r->gpu_addr + (iova_t)((const u8*)cpu_ptr - (const u8*)r->cpu_addr);
+}
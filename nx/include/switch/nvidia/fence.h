@@ -1,5 +1,6 @@
 #pragma once
 #include "ioctl.h"
+#include "../kernel/wait.h"
 
 typedef nvioctl_fence NvFence;
 
@@ -13,6 +14,21 @@ void nvFenceExit(void);
 
 Result nvFenceWait(NvFence* f, s32 timeout_us);
 
+// Pending wait on a fence, which can be used with waitObjects. 2.0.0+ only.
+typedef struct {
+    NvFence fence;
+    int event_id; // -1 if the fence was already reached when the wait was set up.
+} NvFenceEvent;
+
+Result nvFenceEventCreate(NvFenceEvent* e, const NvFence* f);
+void nvFenceEventClose(NvFenceEvent* e);
+// The waiter is signalled once the fence is reached, immediately if it already was.
+Waiter waiterForNvFenceEvent(NvFenceEvent* e);
+
+// Waits until any of the fences is reached. num_fences must not be greater than MAX_WAIT_OBJECTS,
+// and fails with LibnxNvidiaError_InsufficientMemory if fewer event slots than fences are free.
+Result nvFenceWaitAny(const NvFence* fences, s32 num_fences, s32 timeout_us, s32* idx_out);
+
 static inline void nvMultiFenceCreate(NvMultiFence* mf, const NvFence* fence) {
     mf->num_fences = 1;
     mf->fences[0] = *fence;
@@ -13,3 +13,9 @@ const u32* nvGpuGetTpcMasks(u32 *num_masks_out);
 Result nvGpuZbcGetActiveSlotMask(u32 *out_slot, u32 *out_mask);
 Result nvGpuZbcAddColor(const u32 color_l2[4], const u32 color_ds[4], u32 format);
 Result nvGpuZbcAddDepth(float depth);
+
+// Registers the clear values commonly used by the application, so that clearing compressible render targets to them
+// only writes compression tags. The values loaded by the driver (transparent/opaque black, opaque white, depths 0 and 1)
+// and the ones already registered are skipped.
+Result nvGpuZbcRegisterClearColor(u32 rgba8); // Packed like RGBA8().
+Result nvGpuZbcRegisterClearDepth(float depth);
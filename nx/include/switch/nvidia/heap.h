@@ -0,0 +1,60 @@
+#pragma once
+#include "types.h"
+#include "../kernel/mutex.h"
+#include "map.h"
+#include "address_space.h"
+
+// Sub-allocator carving GPU buffers out of 2 MiB NvMap blocks, each mapped once in an NvAddressSpace.
+// A block only holds buffers of the same kind and CPU cacheability, as these are properties of the whole NvMap.
+
+#define NV_HEAP_BLOCK_SIZE  0x200000
+#define NV_HEAP_MIN_ALIGN   0x100
+
+typedef struct NvHeapRange {
+    u32 offset;
+    u32 size;
+} NvHeapRange;
+
+typedef struct NvHeapBlock {
+    struct NvHeapBlock* next;
+    NvMap  map;
+    void*  cpu_addr;
+    iova_t iova;
+    u32    size;
+    u32    used;
+    NvKind kind;
+    bool   is_cpu_cacheable;
+    bool   is_dedicated;   // Single buffer larger than half a block.
+    u32    num_free;
+    u32    max_free;
+    NvHeapRange* free;      // Free ranges, sorted by offset.
+} NvHeapBlock;
+
+typedef struct NvHeap {
+    NvAddressSpace* as;
+    NvHeapBlock* blocks;
+    Mutex mutex;
+} NvHeap;
+
+typedef struct NvHeapAlloc {
+    NvHeapBlock* block;
+    u32    offset;
+    u32    size;
+    void*  cpu_addr;
+    iova_t iova;
+} NvHeapAlloc;
+
+void   nvHeapCreate(NvHeap* h, NvAddressSpace* as);
+void   nvHeapClose(NvHeap* h);
+
+// align must be a power of two, at most the big page size of the address space.
+Result nvHeapAlloc(NvHeap* h, u32 size, u32 align, NvKind kind, bool is_cpu_cacheable, NvHeapAlloc* out);
+void   nvHeapFree(NvHeap* h, NvHeapAlloc* a);
+
+// Releases the blocks with no buffer left in them.
+void   nvHeapTrim(NvHeap* h);
+
+static inline u32 nvHeapAllocGetHandle(NvHeapAlloc* a)
+{
+    return nvMapGetHandle(&a->block->map);
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include "types.h"
+#include "map.h"
+#include "address_space.h"
+
+// Block linear render targets in compressible memory kinds, falling back to the uncompressed kind
+// when the driver has no compression tags left. Combined with the clear values registered with
+// nvGpuZbcRegisterClearColor/Depth, clears then only touch the compression tags.
+
+typedef enum {
+    NvRenderTargetFormat_Color32 = 0, // RGBA8, BGRA8, RGB10A2, R32F...
+    NvRenderTargetFormat_Color64,     // RGBA16F, RG32F...
+    NvRenderTargetFormat_Color128,    // RGBA32F
+    NvRenderTargetFormat_Z16,
+    NvRenderTargetFormat_Z24S8,
+    NvRenderTargetFormat_ZF32,
+} NvRenderTargetFormat;
+
+typedef struct NvRenderTarget {
+    NvAddressSpace* as;
+    NvMap  map;
+    void*  mem;
+    iova_t iova;
+    u32    size;
+    u32    pitch;             // Bytes per row, GOB (64 bytes) aligned.
+    u32    height_aligned;
+    u32    block_height_log2;
+    NvKind kind;
+    bool   is_compressed;
+} NvRenderTarget;
+
+// nvGpuInit must have been called.
+Result nvRenderTargetCreate(NvRenderTarget* rt, NvAddressSpace* as, u32 width, u32 height, NvRenderTargetFormat format);
+void   nvRenderTargetClose(NvRenderTarget* rt);
@@ -125,6 +125,9 @@ enum {
     LibnxError_LibAppletBadExit,
     LibnxError_InvalidCmifOutHeader,
     LibnxError_ShouldNotHappen,
+    LibnxError_ServerUnknownCommand,
+    LibnxError_Cancelled,
+    LibnxError_HashMismatch,
 };
 
 /// libnx binder error codes
@@ -0,0 +1,102 @@
+/**
+ * @file arena.h
+ * @brief Arena (bump) allocator for short-lived allocations, such as per-frame temporaries.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "../types.h"
+
+/// Granularity at which an arena commits memory.
+#define ARENA_ALLOCATOR_COMMIT_SIZE 0x200000
+
+/// Arena allocator object. It isn't thread-safe: each thread should use its own arena.
+typedef struct {
+    u8* base;               ///< Start of the reserved address range.
+    size_t size;            ///< Size of the reserved address range.
+    size_t committed;       ///< Size of the memory backing the start of the range.
+    size_t offset;          ///< Offset of the next allocation.
+    bool on_demand;         ///< Whether memory is committed on demand with \ref svcMapPhysicalMemory, rather than taken from the heap upfront.
+} ArenaAllocator;
+
+/**
+ * @brief Creates an arena allocator.
+ * @param[out] a Arena allocator object.
+ * @param[in] size Maximum amount of memory the arena can hand out (rounded up to page alignment).
+ * @return Result code.
+ * @note The address range is reserved in the alias region and committed on demand with \ref svcMapPhysicalMemory when the process is allowed to use it [3.0.0+]. Otherwise, the whole arena is allocated from the heap.
+ */
+Result arenaAllocatorCreate(ArenaAllocator* a, size_t size);
+
+/**
+ * @brief Closes an arena allocator, freeing all of its memory.
+ * @param a Arena allocator object.
+ */
+void arenaAllocatorClose(ArenaAllocator* a);
+
+/// Commits memory up to the specified offset of the arena, used by \ref arenaAllocatorAlloc.
+bool _arenaAllocatorCommit(ArenaAllocator* a, size_t end);
+
+/**
+ * @brief Allocates memory from an arena.
+ * @param a Arena allocator object.
+ * @param[in] size Size in bytes.
+ * @param[in] alignment Alignment, a power of two.
+ * @return Pointer to memory, or NULL if the arena is exhausted.
+ */
+static inline void* arenaAllocatorAlloc(ArenaAllocator* a, size_t size, size_t alignment)
+{
+    size_t start = (((uintptr_t)a->base + a->offset + alignment - 1) & ~(uintptr_t)(alignment - 1)) - (uintptr_t)a->base;
+    if (start > a->size || size > a->size - start)
+        return NULL;
+
+    size_t end = start + size;
+    if (end > a->committed && !_arenaAllocatorCommit(a, end))
+        return NULL;
+
+    a->offset = end;
+    return a->base + start;
+}
+
+/**
+ * @brief Gets a marker of the current state of an arena, see \ref arenaAllocatorRewind.
+ * @param a Arena allocator object.
+ */
+static inline size_t arenaAllocatorGetMarker(ArenaAllocator* a)
+{
+    return a->offset;
+}
+
+/**
+ * @brief Frees all allocations made from an arena since a marker was taken.
+ * @param a Arena allocator object.
+ * @param[in] marker Marker returned by \ref arenaAllocatorGetMarker.
+ */
+static inline void arenaAllocatorRewind(ArenaAllocator* a, size_t marker)
+{
+    if (marker < a->offset)
+        a->offset = marker;
+}
+
+/**
+ * @brief Frees all allocations made from an arena. Committed memory is kept for reuse, see \ref arenaAllocatorTrim.
+ * @param a Arena allocator object.
+ */
+static inline void arenaAllocatorReset(ArenaAllocator* a)
+{
+    a->offset = 0;
+}
+
+/**
+ * @brief Gets the amount of memory currently allocated from an arena.
+ * @param a Arena allocator object.
+ */
+static inline size_t arenaAllocatorGetUsedSize(ArenaAllocator* a)
+{
+    return a->offset;
+}
+
+/**
+ * @brief Decommits the memory of an arena past its current allocations.
+ * @param a Arena allocator object.
+ */
+void arenaAllocatorTrim(ArenaAllocator* a);
@@ -0,0 +1,79 @@
+/**
+ * @file async_log.h
+ * @brief Buffered asynchronous log transport, for logging from many threads without waiting on the output.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "../types.h"
+#include "../result.h"
+#include "../kernel/mutex.h"
+#include "../kernel/thread.h"
+#include "../kernel/uevent.h"
+
+/// Size of each thread's append buffer.
+#define ASYNCLOG_THREAD_BUFFER_SIZE 0x4000
+
+/// Size of the batches passed to the sink.
+#define ASYNCLOG_BATCH_SIZE 0x4000
+
+/// Sends a batch of log data. Called from the sender thread, or from \ref asyncLogFlush.
+typedef void (*AsyncLogSinkFn)(void* userdata, const void* data, size_t size);
+
+/// Per-thread append buffer.
+typedef struct AsyncLogBuffer AsyncLogBuffer;
+
+struct AsyncLogBuffer {
+    AsyncLogBuffer* next;   ///< Next buffer of the log.
+    u32 head;               ///< Write position, only advanced by the owning thread.
+    u32 tail;               ///< Read position, only advanced by the sender.
+    bool dead;              ///< Set once the owning thread has exited.
+    u8 data[ASYNCLOG_THREAD_BUFFER_SIZE];
+};
+
+/// Asynchronous log.
+typedef struct {
+    AsyncLogSinkFn sink;        ///< Output function.
+    void* userdata;             ///< User data passed to the sink.
+    s32 tls_slot;               ///< TLS slot holding each thread's \ref AsyncLogBuffer.
+    Mutex list_mutex;           ///< Protects the buffer list.
+    Mutex drain_mutex;          ///< Serializes draining into the sink.
+    AsyncLogBuffer* buffers;    ///< Buffers of all threads that have logged.
+    u8* batch;                  ///< Batch buffer of \ref ASYNCLOG_BATCH_SIZE bytes.
+    u64 dropped;                ///< Number of bytes dropped because a buffer was full.
+    UEvent wake_event;          ///< Wakes the sender thread.
+    Thread thread;              ///< Sender thread.
+    bool should_exit;
+} AsyncLog;
+
+/**
+ * @brief Creates an asynchronous log and starts its sender thread.
+ * @param[out] log Log object.
+ * @param[in] sink Output function, see \ref AsyncLogSinkFn.
+ * @param[in] userdata User data passed to the sink.
+ * @param[in] prio Priority of the sender thread. A low priority lets more data accumulate into each batch.
+ * @param[in] cpuid Core of the sender thread, or -2 for the default core.
+ * @return Result code.
+ */
+Result asyncLogCreate(AsyncLog* log, AsyncLogSinkFn sink, void* userdata, int prio, int cpuid);
+
+/**
+ * @brief Sends everything logged so far and closes the log.
+ * @note No thread may log to it anymore.
+ */
+void asyncLogClose(AsyncLog* log);
+
+/**
+ * @brief Appends data to the log.
+ * @return Number of bytes appended. The rest was dropped and added to the dropped count, see \ref asyncLogGetDroppedCount.
+ * @note This copies into the calling thread's buffer without taking locks, and never waits for the sink: data that doesn't fit in the buffer is dropped instead. Data from one call is either appended whole or dropped whole as long as it fits in \ref ASYNCLOG_THREAD_BUFFER_SIZE. Data from different threads is interleaved in sending order.
+ */
+size_t asyncLogWrite(AsyncLog* log, const void* data, size_t len);
+
+/// Sends everything logged so far from the calling thread, waiting for the sink.
+void asyncLogFlush(AsyncLog* log);
+
+/// Returns the number of bytes dropped so far.
+static inline u64 asyncLogGetDroppedCount(AsyncLog* log)
+{
+    return __atomic_load_n(&log->dropped, __ATOMIC_RELAXED);
+}
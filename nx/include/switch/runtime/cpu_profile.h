@@ -0,0 +1,85 @@
+/**
+ * @file cpu_profile.h
+ * @brief Sampling CPU profiler: a sampler thread periodically pauses the profiled threads and records their call stacks.
+ * @note Call stacks are walked through the frame pointer chain, build the application with -fno-omit-frame-pointer for complete stacks.
+ *       Addresses are written as offsets from the start of the application image (__start__), symbolize them offline, e.g. with aarch64-none-elf-addr2line -e app.elf.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include <stdio.h>
+#include "../types.h"
+
+/// Maximum number of profiled threads.
+#define CPU_PROFILE_MAX_THREADS 16
+
+/// Maximum number of addresses recorded per call stack, including the PC.
+#define CPU_PROFILE_MAX_DEPTH 24
+
+/// Maximum number of distinct call stacks recorded. Samples of further stacks are only counted in \ref CpuProfileStats::num_dropped.
+#define CPU_PROFILE_MAX_STACKS 4096
+
+/// Profiler configuration.
+typedef struct {
+    u64 interval;               ///< Sampling interval in nanoseconds, 0 for 1ms.
+    u32 max_depth;              ///< Maximum number of addresses per call stack, 0 for \ref CPU_PROFILE_MAX_DEPTH.
+    int prio;                   ///< Priority of the sampler thread, it should be higher than the profiled threads (e.g. 0x20).
+    int cpuid;                  ///< Core of the sampler thread, preferably one the profiled threads don't use.
+} CpuProfileConfig;
+
+/// Profiler statistics.
+typedef struct {
+    u64 num_samples;            ///< Number of samples recorded.
+    u64 num_failed;             ///< Number of samples which couldn't be taken, e.g. because the thread exited.
+    u64 num_dropped;            ///< Number of samples taken but not recorded, since \ref CPU_PROFILE_MAX_STACKS was reached.
+    u32 num_stacks;             ///< Number of distinct call stacks recorded.
+} CpuProfileStats;
+
+/**
+ * @brief Starts the sampler thread.
+ * @param[in] config Configuration.
+ * @return Result code.
+ */
+Result cpuProfileStart(const CpuProfileConfig* config);
+
+/// Stops the sampler thread. The recorded samples are kept until \ref cpuProfileReset.
+void cpuProfileStop(void);
+
+/**
+ * @brief Adds a thread to profile.
+ * @param[in] handle Thread handle, e.g. \ref envGetMainThreadHandle or Thread::handle. It must stay valid until the thread is removed or the profiler stopped.
+ * @return Result code. LibnxError_OutOfMemory when \ref CPU_PROFILE_MAX_THREADS threads are profiled.
+ */
+Result cpuProfileAddThread(Handle handle);
+
+/// Removes a profiled thread.
+void cpuProfileRemoveThread(Handle handle);
+
+/**
+ * @brief Gets the profiler statistics.
+ * @param[out] out Statistics.
+ */
+void cpuProfileGetStats(CpuProfileStats* out);
+
+/// Discards the recorded samples.
+void cpuProfileReset(void);
+
+/**
+ * @brief Writes the recorded call stacks in the folded format (one "root;...;leaf count" line per stack), as used by flamegraph tools.
+ * @param f Output stream, e.g. stdout when redirected with \ref nxlinkStdio, or a file opened on a filesystem device.
+ * @note Addresses outside of the application image are written as absolute addresses, prefixed with "abs:".
+ */
+void cpuProfileDumpFolded(FILE* f);
+
+/**
+ * @brief Writes a flat profile: the addresses sampled the most as the PC, with their share of the samples.
+ * @param f Output stream.
+ * @param[in] max_entries Maximum number of addresses listed, up to 64.
+ */
+void cpuProfileDumpFlat(FILE* f, u32 max_entries);
+
+/**
+ * @brief Writes the folded call stacks like \ref cpuProfileDumpFolded to a file.
+ * @param[in] path Path of the file, e.g. "sdmc:/profile.folded".
+ * @return Result code.
+ */
+Result cpuProfileDumpToFile(const char* path);
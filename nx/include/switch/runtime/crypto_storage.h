@@ -0,0 +1,111 @@
+/**
+ * @file crypto_storage.h
+ * @brief Decrypt-on-read wrapper for AES-CTR/AES-XTS encrypted FsStorage/FsFile contents.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "../types.h"
+#include "../kernel/mutex.h"
+#include "../kernel/condvar.h"
+#include "../kernel/thread.h"
+#include "../services/fs.h"
+#include "../crypto/aes_ctr.h"
+#include "../crypto/aes_xts.h"
+
+/// Size of the chunks large reads are split into. While one chunk is decrypted, the next one is read.
+#define CRYPTO_STORAGE_CHUNK_SIZE 0x80000
+
+/// Minimum size of the internal buffer used for unaligned and small reads.
+#define CRYPTO_STORAGE_BUFFER_SIZE 0x4000
+
+/// Backing source type.
+typedef enum {
+    CryptoStorageSourceType_Storage = 0,    ///< FsStorage.
+    CryptoStorageSourceType_File    = 1,    ///< FsFile.
+} CryptoStorageSourceType;
+
+/// Cipher mode.
+typedef enum {
+    CryptoStorageMode_AesCtr = 0,           ///< AES-128-CTR.
+    CryptoStorageMode_AesXts = 1,           ///< AES-128-XTS.
+} CryptoStorageMode;
+
+/// Backing source of a \ref CryptoStorage. Ownership of the handle is transferred to the CryptoStorage.
+typedef struct {
+    CryptoStorageSourceType type;   ///< \ref CryptoStorageSourceType
+    FsStorage storage;              ///< Storage, when type is \ref CryptoStorageSourceType_Storage.
+    FsFile file;                    ///< File, when type is \ref CryptoStorageSourceType_File.
+    s64 offset;                     ///< Offset of the encrypted data within the source.
+    s64 size;                       ///< Size of the encrypted data.
+} CryptoStorageSource;
+
+/// Decrypting storage.
+typedef struct {
+    CryptoStorageSource src;
+    CryptoStorageMode mode;
+    Aes128CtrContext ctr_ctx;
+    u8 ctr[AES_BLOCK_SIZE];
+    Aes128XtsContext xts_ctx;
+    size_t sector_size;
+    bool is_nintendo;
+    size_t align;                   ///< Read granularity: AES_BLOCK_SIZE for CTR, the sector size for XTS.
+
+    Mutex mutex;                    ///< Serializes \ref cryptoStorageRead.
+    u8* buffer;                     ///< Internal buffer, holds decrypted data for [buffer_offset, buffer_offset+buffer_valid).
+    size_t buffer_size;
+    s64 buffer_offset;
+    size_t buffer_valid;
+
+    Thread reader;                  ///< Reader thread, keeps the next chunk's read in flight.
+    Mutex req_mutex;
+    CondVar req_cond;
+    void* req_buffer;
+    s64 req_offset;
+    u64 req_size;
+    Result req_result;
+    bool req_pending;
+    bool req_done;
+    bool should_exit;
+} CryptoStorage;
+
+/**
+ * @brief Creates an AES-128-CTR decrypting storage.
+ * @param[out] out CryptoStorage object.
+ * @param[in] src Backing source. On success, its handle is closed by \ref cryptoStorageClose.
+ * @param[in] key AES key.
+ * @param[in] ctr Counter for offset 0 of the encrypted data. The counter of data at offset x is ctr + x / 0x10, as a 128-bit big-endian integer.
+ * @note For NCA sections, pass the section nonce as the upper 8 bytes and the big-endian section offset >> 4 as the lower 8 bytes.
+ * @return Result code.
+ */
+Result cryptoStorageCreateAesCtr(CryptoStorage* out, const CryptoStorageSource* src, const void* key, const void* ctr);
+
+/**
+ * @brief Creates an AES-128-XTS decrypting storage.
+ * @param[out] out CryptoStorage object.
+ * @param[in] src Backing source. On success, its handle is closed by \ref cryptoStorageClose.
+ * @param[in] key0 Data key.
+ * @param[in] key1 Tweak key.
+ * @param[in] sector_size Sector size, a non-zero multiple of AES_BLOCK_SIZE. The data at offset x is in sector x / sector_size.
+ * @param[in] is_nintendo Whether to use Nintendo's non-standard tweak, see \ref aes128XtsContextResetSector.
+ * @return Result code.
+ */
+Result cryptoStorageCreateAesXts(CryptoStorage* out, const CryptoStorageSource* src, const void* key0, const void* key1, size_t sector_size, bool is_nintendo);
+
+/// Stops the reader thread, closes the backing source and frees the internal buffer.
+void cryptoStorageClose(CryptoStorage* cs);
+
+/**
+ * @brief Reads and decrypts data.
+ * @param[in] cs CryptoStorage object.
+ * @param[in] offset Offset within the encrypted data.
+ * @param[out] buffer Output buffer. Aligned parts of large reads are read directly into it and decrypted in place, so it must be memory FS can map.
+ * @param[in] size Size to read, offset+size must not exceed the size of the encrypted data.
+ * @return Result code.
+ */
+Result cryptoStorageRead(CryptoStorage* cs, s64 offset, void* buffer, u64 size);
+
+/// Gets the size of the encrypted data.
+static inline s64 cryptoStorageGetSize(CryptoStorage* cs)
+{
+    return cs->src.size;
+}
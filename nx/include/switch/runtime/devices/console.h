@@ -125,6 +125,7 @@ typedef enum {
 	debugDevice_NULL,    ///< Swallows prints to stderr
 	debugDevice_SVC,     ///< Outputs stderr debug statements using svcOutputDebugString, which can then be captured by interactive debuggers
 	debugDevice_CONSOLE, ///< Directs stderr debug statements to Switch console window
+	debugDevice_SVC_ASYNC, ///< Like debugDevice_SVC, but buffered: prints don't wait for svcOutputDebugString, which is called in batches by a background thread. Prints are dropped when the buffer is full
 	debugDevice_3DMOO = debugDevice_SVC,
 } debugDevice;
 
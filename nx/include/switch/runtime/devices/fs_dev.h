@@ -8,6 +8,8 @@
 #pragma once
 
 #include <sys/types.h>
+#include <sys/dirent.h>
+#include <sys/_iovec.h>
 #include "../../services/fs.h"
 
 #define FSDEV_DIRITER_MAGIC 0x66736476 ///< "fsdv"
@@ -21,6 +23,18 @@ typedef struct
   size_t            size;          ///< Current batch size
 } fsdev_dir_t;
 
+/// I/O statistics of a mounted device, see \ref fsdevGetDeviceStats.
+typedef struct
+{
+  u64 read_ipc_count;  ///< Number of file reads sent to FS
+  u64 write_ipc_count; ///< Number of file writes sent to FS
+  u64 bytes_read;      ///< Bytes read from files
+  u64 bytes_written;   ///< Bytes written to files
+  u64 read_ns;         ///< Time spent waiting for file reads, in nanoseconds
+  u64 write_ns;        ///< Time spent waiting for file writes, in nanoseconds
+  u64 bounce_count;    ///< Number of transfers bounced through an internal buffer because FS couldn't use the caller's memory (0xD401)
+} FsdevDeviceStats;
+
 /// Retrieves a pointer to temporary stage for reading entries
 NX_CONSTEXPR FsDirectoryEntry* fsdevDirGetEntries(fsdev_dir_t *dir)
 {
@@ -45,12 +59,94 @@ int fsdevMountDevice(const char *name, FsFileSystem fs);
 int fsdevUnmountDevice(const char *name);
 
 /// Uses fsFsCommit() with the specified device. This must be used after any savedata-write operations(not just file-write). This should be used after each file-close where file-writing was done.
-/// This is not used automatically at device unmount.
+/// This is not used automatically at device unmount, unless automatic commits are enabled with \ref fsdevSetAutoCommit.
 Result fsdevCommitDevice(const char *name);
 
+/**
+ * @brief Commits the specified device if it was modified through fs_dev since its last commit, like \ref fsdevCommitDevice otherwise.
+ * @note Use this at points where the data must be persisted (e.g. after writing a save slot), so that no redundant commit is done when nothing changed.
+ */
+Result fsdevCommitBarrier(const char *name);
+
+/**
+ * @brief Enables automatic commits of the specified device.
+ * @param[in] name Device name.
+ * @param[in] interval_ns Minimum time between commits in nanoseconds, 0 disables automatic commits after committing pending changes.
+ * @return Result code.
+ * @note A background thread commits the device once it was modified, at most once per interval, so that bursts of writes are coalesced into a single commit. The thread is started on first use, with the priority of the calling thread.
+ * @note Commits which fail (e.g. while a file is open for writing) are retried on the next interval. Pending changes are committed on unmount.
+ */
+Result fsdevSetAutoCommit(const char *name, u64 interval_ns);
+
+/**
+ * @brief Reads from an fsdev file descriptor at the specified offset, like pread().
+ * @note The file offset isn't used or updated, so multiple threads can read from the same descriptor concurrently. This bypasses the per-file cache, call fsync() first if buffered writes may be pending.
+ * @return Number of bytes read, or -1 with errno set.
+ */
+ssize_t fsdevPread(int fd, void *buf, size_t len, off_t offset);
+
+/**
+ * @brief Writes to an fsdev file descriptor at the specified offset, like pwrite().
+ * @note The file offset isn't used or updated, so multiple threads can write to the same descriptor concurrently. This bypasses the per-file cache, which must not be used for overlapping ranges at the same time.
+ * @return Number of bytes written, or -1 with errno set.
+ */
+ssize_t fsdevPwrite(int fd, const void *buf, size_t len, off_t offset);
+
+/**
+ * @brief Makes sure the specified range of an fsdev file descriptor is allocated, like posix_fallocate().
+ * @note To create files larger than 4 GiB on FAT32, create them with \ref fsdevCreateFile using FsCreateOption_BigFile instead.
+ * @return 0 on success, otherwise an errno value (errno itself isn't set).
+ */
+int fsdevFallocate(int fd, off_t offset, off_t len);
+
+/// Access pattern hints for \ref fsdevFadvise, like the POSIX_FADV_* values of posix_fadvise().
+typedef enum {
+  FsdevAdvice_Normal     = 0, ///< Default: the read-ahead window of the per-file cache grows while the file is read sequentially.
+  FsdevAdvice_Random     = 1, ///< Reads are random, the per-file cache only reads ahead the minimum.
+  FsdevAdvice_Sequential = 2, ///< Reads are sequential, the per-file cache reads ahead its full size right away.
+  FsdevAdvice_WillNeed   = 3, ///< The range will be read soon, its start is prefetched into the per-file cache.
+  FsdevAdvice_DontNeed   = 4, ///< The range won't be read again, it's dropped from the per-file cache and from the FS cache.
+} FsdevAdvice;
+
+/**
+ * @brief Gives a hint about how an fsdev file descriptor will be read, like posix_fadvise().
+ * @param[in] offset Start of the range the hint applies to.
+ * @param[in] len Length of the range, 0 for the rest of the file. FsdevAdvice_Normal/Random/Sequential apply to the whole file.
+ * @note FsdevAdvice_DontNeed uses fsFileOperateRange with FsOperationId_InvalidateCache, which not all filesystems support. Use it after large one-shot reads (e.g. video playback) so that they don't evict more useful data.
+ * @return 0 on success, otherwise an errno value (errno itself isn't set).
+ */
+int fsdevFadvise(int fd, off_t offset, off_t len, FsdevAdvice advice);
+
+/// Scatter version of \ref fsdevPread, like preadv(). Stops at the first short read.
+ssize_t fsdevPreadv(int fd, const struct iovec *iov, int iovcnt, off_t offset);
+
+/// Gather version of \ref fsdevPwrite, like pwritev().
+ssize_t fsdevPwritev(int fd, const struct iovec *iov, int iovcnt, off_t offset);
+
+/**
+ * @brief Reads up to max_entries entries from a directory opened with opendir() on an fsdev device, with one IPC.
+ * @note Entries are returned in the same order as readdir(), and the two can be mixed.
+ * @return Number of entries read (0 at the end of the directory), or -1 with errno set.
+ */
+ssize_t fsdevReadDirEntries(DIR *dirp, FsDirectoryEntry *entries, size_t max_entries);
+
+/**
+ * @brief Reads all remaining entries from a directory opened with opendir() on an fsdev device.
+ * @param[out] out_entries Set to a buffer allocated with malloc(), which must be freed by the caller.
+ * @note The buffer is sized from fsDirGetEntryCount, so usually a single fsDirRead returns the whole directory.
+ * @return Number of entries read, or -1 with errno set.
+ */
+ssize_t fsdevReadAllDirEntries(DIR *dirp, FsDirectoryEntry **out_entries);
+
 /// Returns the FsFileSystem for the specified device. Returns NULL when the specified device isn't found.
 FsFileSystem* fsdevGetDeviceFileSystem(const char *name);
 
+/// Retrieves the file I/O statistics of the specified device, counted since it was mounted or since \ref fsdevResetDeviceStats.
+Result fsdevGetDeviceStats(const char *name, FsdevDeviceStats *out);
+
+/// Resets the file I/O statistics of the specified device.
+Result fsdevResetDeviceStats(const char *name);
+
 /// Writes the FS-path to outpath (which has buffer size FS_MAX_PATH), for the input path (as used in stdio). The FsFileSystem is also written to device when not NULL.
 int fsdevTranslatePath(const char *path, FsFileSystem** device, char *outpath);
 
@@ -63,6 +159,47 @@ Result fsdevIsValidSignedSystemPartitionOnSdCard(const char *name, bool *out);
 /// This calls fsFsCreateFile on the filesystem specified by the input path (as used in stdio).
 Result fsdevCreateFile(const char* path, size_t size, u32 flags);
 
+/**
+ * @brief Maps a file on an fsdev device into memory, read-only.
+ * @param[in] path Path of the file (as used in stdio).
+ * @param[out] out_ptr Pointer to the file contents, page-aligned.
+ * @param[out] out_size Size of the file.
+ * @note The whole file is read up front in large chunks, and must fit in the heap. Writes to the mapping fault. Later changes to the file are not reflected.
+ * @note Use \ref fsdevUnmapFile to release the mapping.
+ */
+Result fsdevMapFile(const char *path, const void **out_ptr, size_t *out_size);
+
+/// Releases a mapping created by \ref fsdevMapFile or \ref romfsMapFile.
+void fsdevUnmapFile(const void *ptr, size_t size);
+
+/// Maximum number of worker threads used by \ref fsdevCopyTree.
+#define FSDEV_COPY_MAX_THREADS 8
+
+/// Progress of \ref fsdevCopyTree.
+typedef struct
+{
+  u64 total_files;  ///< Number of files found so far.
+  u64 copied_files; ///< Number of files copied.
+  u64 total_bytes;  ///< Size of the files found so far.
+  u64 copied_bytes; ///< Number of bytes copied.
+  u64 elapsed_ns;   ///< Time since the copy started, in nanoseconds.
+} FsdevCopyProgress;
+
+/// Progress callback for \ref fsdevCopyTree. Return false to cancel the copy.
+typedef bool (*FsdevCopyProgressFunc)(const FsdevCopyProgress *progress, void *userdata);
+
+/**
+ * @brief Recursively copies a directory, which may be on a different device.
+ * @param[in] src Source directory path (as used in stdio).
+ * @param[in] dst Destination directory path (as used in stdio), created if needed. Existing files are overwritten.
+ * @param[in] num_threads Number of threads copying files in parallel (1..\ref FSDEV_COPY_MAX_THREADS), with a 1 MiB buffer each.
+ * @param[in] callback Optional progress callback, called from the calling thread about every 100ms.
+ * @param[in] userdata Passed to callback.
+ * @note Parallel transfers use separate fs sessions, up to the size of the fs session pool (see __nx_fs_num_sessions).
+ * @return Result code. LibnxError_Cancelled if cancelled by the callback.
+ */
+Result fsdevCopyTree(const char *src, const char *dst, u32 num_threads, FsdevCopyProgressFunc callback, void *userdata);
+
 /// Recursively deletes the directory specified by the input path (as used in stdio).
 Result fsdevDeleteDirectoryRecursively(const char *path);
 
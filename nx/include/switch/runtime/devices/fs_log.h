@@ -0,0 +1,74 @@
+/**
+ * @file fs_log.h
+ * @brief Buffered log file sink for fsdev devices, for logging from many threads.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include <stdarg.h>
+#include "../../types.h"
+#include "../../kernel/mutex.h"
+#include "../../kernel/thread.h"
+#include "../../kernel/uevent.h"
+#include "../../services/fs.h"
+
+/// Size of each thread's append buffer.
+#define FSLOG_THREAD_BUFFER_SIZE 0x4000
+
+/// Size of the staging buffer used for writes to the file.
+#define FSLOG_WRITE_SIZE 0x10000
+
+/// Per-thread append buffer.
+typedef struct FsLogBuffer FsLogBuffer;
+
+struct FsLogBuffer {
+    FsLogBuffer* next;   ///< Next buffer of the log.
+    u32 head;            ///< Write position, only advanced by the owning thread.
+    u32 tail;            ///< Read position, only advanced by the flusher.
+    bool dead;           ///< Set once the owning thread has exited.
+    u8 data[FSLOG_THREAD_BUFFER_SIZE];
+};
+
+/// Log sink.
+typedef struct {
+    FsFile file;            ///< Log file.
+    s64 offset;             ///< Offset of the next write to the file.
+    s32 tls_slot;           ///< TLS slot holding each thread's \ref FsLogBuffer.
+    Mutex list_mutex;       ///< Protects the buffer list.
+    Mutex drain_mutex;      ///< Serializes draining into the file.
+    FsLogBuffer* buffers;   ///< Buffers of all threads that have logged.
+    u8* staging;            ///< Page-aligned staging buffer.
+    UEvent wake_event;      ///< Wakes the flusher thread.
+    Thread thread;          ///< Flusher thread.
+    bool should_exit;
+} FsLog;
+
+/**
+ * @brief Opens a log file for appending and starts its flusher thread.
+ * @param[out] log Log object.
+ * @param[in] path Path of the log file (as used in stdio), created if needed.
+ * @param[in] prio Priority of the flusher thread.
+ * @param[in] cpuid Core of the flusher thread, or -2 for the default core.
+ * @return Result code.
+ */
+Result fslogCreate(FsLog* log, const char* path, int prio, int cpuid);
+
+/**
+ * @brief Flushes everything logged so far and closes the log.
+ * @note No thread may log to it anymore.
+ */
+void fslogClose(FsLog* log);
+
+/**
+ * @brief Appends data to the log.
+ * @note This copies into the calling thread's buffer without taking locks, and only waits when that buffer is full. Data from one call is written contiguously as long as it fits in \ref FSLOG_THREAD_BUFFER_SIZE. Data from different threads is interleaved in flush order.
+ */
+void fslogWrite(FsLog* log, const void* data, size_t len);
+
+/// Formats a message like printf() and appends it to the log with \ref fslogWrite.
+void fslogPrintf(FsLog* log, const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+
+/// va_list version of \ref fslogPrintf.
+void fslogVPrintf(FsLog* log, const char* fmt, va_list args);
+
+/// Writes everything logged so far to the file, and flushes it.
+Result fslogFlush(FsLog* log);
@@ -11,6 +11,9 @@
 #include "../../types.h"
 #include "../../services/fs.h"
 #include "../../services/ncm_types.h"
+#include "../crypto_storage.h"
+#include "../integrity_storage.h"
+#include "fs_dev.h"
 
 /// RomFS header.
 typedef struct
@@ -51,6 +54,45 @@ typedef struct
     uint8_t name[];   ///< Name. (UTF-8)
 } romfs_file;
 
+/// Name of the optional compression table file in the RomFS root directory.
+#define ROMFS_CTABLE_NAME    ".romfs_ctable"
+#define ROMFS_CTABLE_MAGIC   0x54434652 ///< "RFCT"
+#define ROMFS_CTABLE_VERSION 1
+
+/// Compression codecs of \ref romfs_ctable_block.
+typedef enum {
+    RomfsCodec_None = 0, ///< Stored as is.
+    RomfsCodec_Lz4  = 1, ///< LZ4 block format.
+} RomfsCodec;
+
+/// Compression table header. It is followed by the file entries, then by the block entries.
+typedef struct
+{
+    u32 magic;     ///< \ref ROMFS_CTABLE_MAGIC.
+    u32 version;   ///< \ref ROMFS_CTABLE_VERSION.
+    u32 blockSize; ///< Uncompressed size of each block but the last of a file, a power of two between 4KiB and 1MiB.
+    u32 numFiles;  ///< Number of \ref romfs_ctable_file entries.
+    u32 numBlocks; ///< Number of \ref romfs_ctable_block entries.
+    u32 reserved;
+} romfs_ctable_header;
+
+/// Compressed file. Entries are sorted by dataOff.
+typedef struct
+{
+    u64 dataOff;    ///< dataOff of the compressed file's \ref romfs_file.
+    u64 size;       ///< Uncompressed size of the file.
+    u32 firstBlock; ///< Index of the file's first block entry.
+    u32 numBlocks;  ///< Number of blocks of the file.
+} romfs_ctable_file;
+
+/// Compressed block.
+typedef struct
+{
+    u64 offset; ///< Offset of the compressed block within the file's data.
+    u32 size;   ///< Compressed size of the block.
+    u32 codec;  ///< \ref RomfsCodec.
+} romfs_ctable_block;
+
 /**
  * @brief Mounts the Application's RomFS.
  * @param name Device mount name.
@@ -76,6 +118,22 @@ Result romfsMountFromFile(FsFile file, u64 offset, const char *name);
  */
 Result romfsMountFromStorage(FsStorage storage, u64 offset, const char *name);
 
+/**
+ * @brief Mounts RomFS from an encrypted storage, decrypted at read time.
+ * @param storage CryptoStorage of the RomFS image. It is not closed on unmount, and must remain valid until then.
+ * @param offset Offset of the RomFS within the decrypted data.
+ * @param name Device mount name.
+ */
+Result romfsMountFromCryptoStorage(CryptoStorage *storage, u64 offset, const char *name);
+
+/**
+ * @brief Mounts RomFS from a verifying storage, so that only the parts of the image actually read are verified.
+ * @param storage IntegrityStorage of the RomFS image. It is not closed on unmount, and must remain valid until then.
+ * @param offset Offset of the RomFS within the data level.
+ * @param name Device mount name.
+ */
+Result romfsMountFromIntegrityStorage(IntegrityStorage *storage, u64 offset, const char *name);
+
 /**
  * @brief Mounts RomFS using the current process host program RomFS.
  * @param name Device mount name.
@@ -98,9 +156,125 @@ Result romfsMountFromFsdev(const char *path, u64 offset, const char *name);
  */
 Result romfsMountFromDataArchive(u64 dataId, NcmStorageId storageId, const char *name);
 
+/**
+ * @brief Mounts several already mounted RomFS devices as a single overlay.
+ * @param name Device mount name.
+ * @param layers Mount names of the layers, lowest priority first (e.g. base, update, mod).
+ * @param num_layers Number of layers.
+ * @note A merged index of all layers is built at mount, so each lookup takes one probe per path component regardless of the number of layers. Files of higher layers replace entries of lower ones, and directories are merged.
+ * @note The layers must stay mounted until the overlay is unmounted, and can't be overlays themselves.
+ */
+Result romfsMountOverlay(const char *name, const char *const *layers, u32 num_layers);
+
 /// Unmounts the RomFS device.
 Result romfsUnmount(const char *name);
 
+/**
+ * @brief Maps a file from a mounted RomFS into memory, read-only.
+ * @param[in] path Path of the file, including the device name.
+ * @param[out] out_ptr Pointer to the file contents, page-aligned.
+ * @param[out] out_size Size of the file.
+ * @note The whole file is read up front in large chunks, and must fit in the heap. Writes to the mapping fault.
+ * @note Use \ref romfsUnmapFile to release the mapping.
+ */
+Result romfsMapFile(const char *path, const void **out_ptr, size_t *out_size);
+
+/**
+ * @brief Reads a file from a mounted RomFS into memory owned by the mount, so that \ref romfsGetFilePointer can return it.
+ * @param[in] path Path of the file, including the device name.
+ * @note The memory is released when the RomFS is unmounted. Reads of the file through stdio are served from it too.
+ */
+Result romfsPreloadFile(const char *path);
+
+/**
+ * @brief Retrieves a pointer to the contents of a file in a mounted RomFS, without copying them.
+ * @param[in] path Path of the file, including the device name.
+ * @param[out] out_ptr Pointer to the file contents, valid until the RomFS is unmounted.
+ * @param[out] out_size Size of the file.
+ * @return LibnxError_NotInitialized when the file isn't in memory: set __nx_romfs_load_image to load whole images at mount, or use \ref romfsPreloadFile.
+ */
+Result romfsGetFilePointer(const char *path, const void **out_ptr, size_t *out_size);
+
+/// Statistics of a RomFS hash table.
+typedef struct
+{
+    u32  num_buckets;  ///< Number of buckets.
+    u32  used_buckets; ///< Number of non-empty buckets.
+    u32  num_entries;  ///< Number of entries.
+    u32  max_chain;    ///< Length of the longest chain.
+    u64  total_probes; ///< Entries visited when looking up every entry once. Divide by num_entries for the average probe length, and divide num_entries by used_buckets for the average chain length.
+    bool rebuilt;      ///< Whether the table was rebuilt at mount (__nx_romfs_rehash) instead of being the image's.
+} RomfsHashTableStats;
+
+/// Statistics of the hash tables of a mounted RomFS, see \ref romfsGetHashStats.
+typedef struct
+{
+    RomfsHashTableStats dirs;  ///< Directory hash table.
+    RomfsHashTableStats files; ///< File hash table.
+} RomfsHashStats;
+
+/**
+ * @brief Retrieves statistics of the hash tables used for lookups in a mounted RomFS.
+ * @param[in] name Device mount name.
+ * @param[out] out Statistics.
+ * @note The chains are walked on each call, which takes time proportional to the number of entries.
+ */
+Result romfsGetHashStats(const char *name, RomfsHashStats *out);
+
+/// Directory entry returned by \ref romfsDirIterRead.
+typedef struct
+{
+    const char *name;     ///< Name (UTF-8), pointing into the mount's tables. It is not NUL-terminated.
+    u32        name_len;  ///< Length of the name.
+    bool       is_dir;    ///< Whether the entry is a directory.
+    u64        size;      ///< Size of the file contents (uncompressed). 0 for directories.
+    u64        offset;    ///< Offset of the file data within the RomFS image. 0 for directories.
+} RomfsDirEntry;
+
+/// Raw directory iterator, see \ref romfsDirIterOpen.
+typedef struct
+{
+    void *mount;
+    u32  childDir;
+    u32  childFile;
+} RomfsDirIter;
+
+/**
+ * @brief Opens a raw iterator over a directory of a mounted RomFS, which walks the in-memory tables directly without building a struct stat per entry.
+ * @param[out] iter Iterator.
+ * @param[in] path Path of the directory, including the device name.
+ * @note The iterator needs no closing, and the entries it returns stay valid until the RomFS is unmounted.
+ */
+Result romfsDirIterOpen(RomfsDirIter *iter, const char *path);
+
+/**
+ * @brief Reads the next entries of a raw directory iterator. Subdirectories are returned before files, and "." and ".." aren't returned.
+ * @param[in] iter Iterator.
+ * @param[out] entries Output entries.
+ * @param[in] max_entries Maximum number of entries to read.
+ * @return Number of entries read, 0 at the end of the directory.
+ */
+size_t romfsDirIterRead(RomfsDirIter *iter, RomfsDirEntry *entries, size_t max_entries);
+
+/// Maximum number of worker threads used by \ref romfsPrefetch.
+#define ROMFS_PREFETCH_MAX_THREADS 8
+
+/**
+ * @brief Reads files of a mounted RomFS into its block cache ahead of use, for instance while a splash screen is shown.
+ * @param[in] name Device mount name.
+ * @param[in] paths Files or directories (read recursively) to prefetch. Entries containing '*' or '?' are patterns matched against the absolute path of every file in the RomFS, which start with a slash; '*' also matches slashes, so "*.png" matches every PNG file.
+ * @param[in] num_paths Number of entries in paths.
+ * @param[in] num_threads Number of threads reading in parallel, up to \ref ROMFS_PREFETCH_MAX_THREADS. The calling thread is one of them.
+ * @note Requires the block cache (__nx_romfs_cache_size), and is a no-op when the whole image was loaded at mount. Files beyond the cache size evict earlier ones.
+ */
+Result romfsPrefetch(const char *name, const char *const *paths, size_t num_paths, u32 num_threads);
+
+/// Releases a mapping created by \ref romfsMapFile.
+static inline void romfsUnmapFile(const void *ptr, size_t size)
+{
+    fsdevUnmapFile(ptr, size);
+}
+
 /// Wrapper for \ref romfsMountSelf with the default "romfs" device name.
 static inline Result romfsInit(void)
 {
@@ -1,5 +1,13 @@
 #pragma once
+#include <stdio.h>
+#include <sys/socket.h>
 #include "../../types.h"
+#include "../../kernel/mutex.h"
+#include "../../kernel/condvar.h"
+#include "../../kernel/thread.h"
+#include "../../kernel/uevent.h"
+#include "../../kernel/wait.h"
+#include "../../services/fs.h"
 
 /// BSD service type used by the socket driver.
 typedef enum {
@@ -26,8 +34,24 @@ typedef struct  {
     BsdServiceType bsd_service_type;            ///< BSD service type (typically \ref BsdServiceType_User).
 } SocketInitConfig;
 
+/// Buffer sizing profiles for the socket driver, see \ref socketGetProfileInitConfig.
+typedef enum {
+    SocketInitProfile_Default        = 0, ///< Same as \ref socketGetDefaultInitConfig (about 0x200000 bytes of transfer memory).
+    SocketInitProfile_LowMemory      = 1, ///< Small fixed-size buffers for clients with few sockets and light traffic.
+    SocketInitProfile_HighThroughput = 2, ///< Large auto-tuned TCP buffers for bulk transfers on a few sockets.
+    SocketInitProfile_Server         = 3, ///< Small TCP buffers and more BSD sessions, for many concurrent connections.
+    SocketInitProfile_Auto           = 4, ///< Picks one of the above from the amount of memory available to the process.
+} SocketInitProfile;
+
 /// Fetch the default configuration for the socket driver.
 const SocketInitConfig *socketGetDefaultInitConfig(void);
+
+/**
+ * @brief Fetch the configuration for a buffer sizing profile.
+ * @param[in] profile \ref SocketInitProfile.
+ * @note With \ref SocketInitProfile_Auto, the largest profile whose transfer memory fits in 1/8 of the memory still available to the process (unallocated heap plus unused memory pool) is selected, falling back to \ref SocketInitProfile_LowMemory.
+ */
+const SocketInitConfig *socketGetProfileInitConfig(SocketInitProfile profile);
 /// Initalize the socket driver.
 Result socketInitialize(const SocketInitConfig *config);
 /// Fetch the last bsd:u/s Switch result code (thread-local).
@@ -39,3 +63,195 @@ void socketExit(void);
 NX_INLINE Result socketInitializeDefault(void) {
     return socketInitialize(NULL);
 }
+
+/// Initalize the socket driver using the configuration of a buffer sizing profile.
+NX_INLINE Result socketInitializeWithProfile(SocketInitProfile profile) {
+    return socketInitialize(socketGetProfileInitConfig(profile));
+}
+
+/// Socket statistics, see \ref socketGetStats.
+typedef struct {
+    u64 bytes_in;                               ///< Bytes received.
+    u64 bytes_out;                              ///< Bytes sent.
+    u64 num_recv;                               ///< Number of receive calls (recv, recvfrom, recvmmsg, read).
+    u64 num_send;                               ///< Number of send calls (send, sendto, sendmmsg, write...).
+    u64 recv_ns;                                ///< Time spent in receive calls, in nanoseconds (IPC and time blocked in the bsd server).
+    u64 send_ns;                                ///< Time spent in send calls, in nanoseconds.
+    u64 num_eagain;                             ///< Number of calls that failed with EAGAIN.
+    u64 num_errors;                             ///< Number of calls that failed with another error.
+} SocketStats;
+
+/**
+ * @brief Retrieves the statistics of a socket. Statistics are only collected when __nx_socket_stats is set to true.
+ * @param[in] fd Socket fd, or -1 for the totals over all sockets (including closed ones).
+ * @param[out] out Statistics.
+ * @return 0 on success, -1 with errno set on failure.
+ */
+int socketGetStats(int fd, SocketStats* out);
+
+/// Resets the statistics of all sockets.
+void socketResetStats(void);
+
+/// Prints the statistics of all sockets with activity, followed by the totals.
+void socketDumpStats(FILE* f);
+
+/**
+ * @brief Sends a large buffer over a stream socket, growing the socket send buffer towards tcp_tx_buf_max_size first.
+ * @param[in] sockfd Socket fd.
+ * @param[in] buf Data.
+ * @param[in] len Size of the data.
+ * @param[in] flags send() flags.
+ * @return Number of bytes sent, or -1 with errno set if nothing could be sent.
+ */
+ssize_t socketSendBuffer(int sockfd, const void* buf, size_t len, int flags);
+
+/**
+ * @brief Sends part of a file over a stream socket. The next chunk is read from the file while the previous one is being sent.
+ * @param[in] sockfd Socket fd.
+ * @param[in] file File to send.
+ * @param[in] offset File offset to start at.
+ * @param[in] count Maximum number of bytes to send. Sending stops early at the end of the file.
+ * @param[in] flags send() flags.
+ * @return Number of bytes sent, or -1 with errno set if nothing could be sent.
+ */
+ssize_t socketSendFile(int sockfd, FsFile* file, s64 offset, size_t count, int flags);
+
+/**
+ * @brief Resolves a socket fd to the bsd fd used by the socket service, for use with the socketBsd* functions.
+ * @note The bsd fd stays valid until every fd referring to the socket (including ones from dup()) is closed.
+ * @return bsd fd, or -1 with errno set if fd isn't a socket.
+ */
+int socketGetBsdFd(int fd);
+
+/// recv() on a bsd fd from \ref socketGetBsdFd, skipping the fd lookup (e.g. in per-packet loops). errno and statistics are handled like recv().
+ssize_t socketBsdRecv(int bsdfd, void* buf, size_t len, int flags);
+
+/// recvfrom() on a bsd fd from \ref socketGetBsdFd, see \ref socketBsdRecv.
+ssize_t socketBsdRecvFrom(int bsdfd, void* buf, size_t len, int flags, struct sockaddr* src_addr, socklen_t* addrlen);
+
+/// send() on a bsd fd from \ref socketGetBsdFd, see \ref socketBsdRecv.
+ssize_t socketBsdSend(int bsdfd, const void* buf, size_t len, int flags);
+
+/// sendto() on a bsd fd from \ref socketGetBsdFd, see \ref socketBsdRecv.
+ssize_t socketBsdSendTo(int bsdfd, const void* buf, size_t len, int flags, const struct sockaddr* dest_addr, socklen_t addrlen);
+
+/// Operations for \ref socketEpollCtl.
+typedef enum {
+    SocketEpollOp_Add = 1, ///< Adds a socket to the interest set.
+    SocketEpollOp_Del = 2, ///< Removes a socket from the interest set.
+    SocketEpollOp_Mod = 3, ///< Changes the events and user data of a socket in the interest set.
+} SocketEpollOp;
+
+/// Flag for \ref socketEpollCtl: stop watching the socket after its first reported event, until re-armed with \ref SocketEpollOp_Mod.
+#define SOCKET_EPOLL_ONESHOT BIT(30)
+
+/// Readiness event reported by \ref socketEpollWait.
+typedef struct {
+    u32 events;                                 ///< Ready events (POLLIN, POLLOUT, POLLERR, POLLHUP...).
+    u64 data;                                   ///< User data registered with the socket.
+} SocketEpollEvent;
+
+/// Socket interest set, keeping the translated bsd fd list between waits.
+typedef struct {
+    void* pollfds;                              ///< Cached bsd pollfd array (internal).
+    int* fds;                                   ///< Caller fds matching the pollfd array.
+    u64* data;                                  ///< User data for each entry.
+    u32* events;                                ///< Registered events (including \ref SOCKET_EPOLL_ONESHOT) for each entry.
+    u32 count;                                  ///< Number of sockets in the set.
+    u32 capacity;                               ///< Allocated number of entries.
+    u32 scan_start;                             ///< Entry where the next ready scan starts, so that all sockets get reported when the output array is small.
+} SocketEpoll;
+
+/**
+ * @brief Creates an (epoll-like) socket interest set.
+ * @param[out] ep Interest set.
+ * @param[in] capacity Number of entries to preallocate. The set grows as needed.
+ * @return 0 on success, -1 with errno set on failure.
+ */
+int socketEpollCreate(SocketEpoll* ep, u32 capacity);
+
+/// Destroys a socket interest set. The sockets themselves are not closed.
+void socketEpollClose(SocketEpoll* ep);
+
+/**
+ * @brief Adds, modifies or removes a socket in an interest set.
+ * @param[in] ep Interest set.
+ * @param[in] op \ref SocketEpollOp.
+ * @param[in] fd Socket fd.
+ * @param[in] events Events to watch (POLLIN, POLLOUT...), optionally with \ref SOCKET_EPOLL_ONESHOT. Ignored for \ref SocketEpollOp_Del.
+ * @param[in] data User data reported with the events. Ignored for \ref SocketEpollOp_Del.
+ * @return 0 on success, -1 with errno set on failure (EEXIST, ENOENT, EBADF, ENOTSOCK, ENOMEM).
+ * @note Sockets must be removed before being closed, since the bsd fd is only translated once.
+ * @note The set must not be modified while another thread is waiting on it.
+ */
+int socketEpollCtl(SocketEpoll* ep, SocketEpollOp op, int fd, u32 events, u64 data);
+
+/**
+ * @brief Waits for events on the sockets of an interest set.
+ * @param[in] ep Interest set.
+ * @param[out] out Ready events.
+ * @param[in] max_events Maximum number of events to report.
+ * @param[in] timeout Timeout in milliseconds, -1 to wait forever.
+ * @return Number of reported events (0 on timeout), -1 with errno set on failure.
+ */
+int socketEpollWait(SocketEpoll* ep, SocketEpollEvent* out, int max_events, int timeout);
+
+struct pollfd;
+
+/// Socket readiness waiter, letting socket readiness be waited on with \ref waitObjects alongside other events.
+typedef struct {
+    Thread thread;                              ///< Helper thread running the poll.
+    Handle session;                             ///< Dedicated bsd session used by the helper thread.
+    UEvent event;                               ///< Signalled when the poll has completed.
+    Mutex mutex;
+    CondVar cond;
+    int wake_fd;                                ///< Loopback UDP socket (bsd fd) used to interrupt the poll.
+    u8 wake_addr[16];                           ///< Address the wake socket is bound to.
+    void* pollfds;                              ///< Translated pollfd array (internal), the wake socket being the first entry.
+    u32 nfds;                                   ///< Number of caller sockets being polled.
+    u32 capacity;                               ///< Allocated number of entries in the pollfd array.
+    int result;                                 ///< Result of the last completed poll.
+    int error;                                  ///< errno of the last completed poll.
+    u8 state;                                   ///< Internal state.
+    bool cancel_requested;
+    bool should_exit;
+} SocketPollWaiter;
+
+/**
+ * @brief Creates a socket readiness waiter and its helper thread.
+ * @param[out] w Waiter.
+ * @param[in] prio Priority of the helper thread.
+ * @param[in] cpuid CPU core of the helper thread, -2 for the default core.
+ * @return Result code.
+ */
+Result socketPollWaiterCreate(SocketPollWaiter* w, int prio, int cpuid);
+
+/// Destroys a socket readiness waiter, cancelling any pending poll.
+void socketPollWaiterClose(SocketPollWaiter* w);
+
+/**
+ * @brief Starts waiting for events on a set of sockets, in the background. Any previous poll is cancelled.
+ * @param[in] w Waiter.
+ * @param[in] fds Sockets and events to watch, as for poll(). The array is copied.
+ * @param[in] nfds Number of entries.
+ * @return 0 on success, -1 with errno set on failure.
+ */
+int socketPollWaiterArm(SocketPollWaiter* w, const struct pollfd* fds, u32 nfds);
+
+/// Cancels the pending poll, if any, and waits for the helper thread to stop using the sockets.
+void socketPollWaiterCancel(SocketPollWaiter* w);
+
+/**
+ * @brief Retrieves the result of a completed poll. Call this after the waiter has been signalled.
+ * @param[in] w Waiter.
+ * @param[out] fds Array passed to \ref socketPollWaiterArm, whose revents fields are updated.
+ * @param[in] nfds Number of entries.
+ * @return Number of ready sockets, or -1 with errno set on failure (EAGAIN if the poll has not completed).
+ */
+int socketPollWaiterGetResult(SocketPollWaiter* w, struct pollfd* fds, u32 nfds);
+
+/// Creates a \ref Waiter for a socket readiness waiter, signalled when the armed poll completes.
+static inline Waiter waiterForSocketPollWaiter(SocketPollWaiter* w)
+{
+    return waiterForUEvent(&w->event);
+}
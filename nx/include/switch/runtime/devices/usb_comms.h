@@ -26,7 +26,10 @@ void usbCommsExit(void);
 /// Sets whether to throw a fatal error in usbComms{Read/Write}* on failure, or just return the transferred size. By default (false) the latter is used.
 void usbCommsSetErrorHandling(bool flag);
 
-/// Read data with the default interface.
+/**
+ * @brief Read data with the default interface.
+ * @note Page-aligned buffers are transferred directly. Otherwise only the head of the buffer, up to where it becomes page-aligned, goes through a one-page staging buffer, and the rest is transferred directly.
+ */
 size_t usbCommsRead(void* buffer, size_t size);
 
 /// Write data with the default interface.
@@ -37,3 +40,94 @@ size_t usbCommsReadEx(void* buffer, size_t size, u32 interface);
 
 /// Same as usbCommsWrite except with the specified interface.
 size_t usbCommsWriteEx(const void* buffer, size_t size, u32 interface);
+
+/// Maximum number of asynchronous transfers in flight per endpoint, limited by the ds report data.
+#define USB_COMMS_MAX_URBS 8
+
+/**
+ * @brief Callback called when an asynchronous transfer finished.
+ * @param userdata User data passed when posting the transfer.
+ * @param rc Result of the transfer.
+ * @param buffer Buffer of the transfer.
+ * @param transferred Number of bytes transferred.
+ */
+typedef void (*UsbCommsTransferCallback)(void* userdata, Result rc, void* buffer, size_t transferred);
+
+/**
+ * @brief Posts an asynchronous host->device transfer on the specified interface.
+ * @param[in] buffer Buffer, which must be 0x1000-byte aligned, and stay valid until the callback was called.
+ * @param[in] size Size of the transfer.
+ * @param[in] cb Callback called from \ref usbCommsProcessCompletions once the transfer finished, with the endpoint locked. It can post new transfers. Optional.
+ * @param[in] userdata User data passed to the callback.
+ * @return Result code.
+ * @note Up to \ref USB_COMMS_MAX_URBS transfers are kept in flight, so that the bus doesn't go idle between them. Once that many are, this processes the completions of the endpoint, waiting for the oldest one.
+ * @note \ref usbCommsReadEx waits for the pending asynchronous reads before starting.
+ */
+Result usbCommsPostReadAsync(u32 interface, void* buffer, size_t size, UsbCommsTransferCallback cb, void* userdata);
+
+/// Same as \ref usbCommsPostReadAsync, for a device->host transfer. \ref usbCommsWriteEx waits for the pending asynchronous writes before starting.
+Result usbCommsPostWriteAsync(u32 interface, const void* buffer, size_t size, UsbCommsTransferCallback cb, void* userdata);
+
+/**
+ * @brief Calls the callbacks of the finished asynchronous transfers of an endpoint of the specified interface, in the order they were posted.
+ * @param[in] write Whether to process the device->host endpoint, otherwise the host->device one.
+ * @param[in] timeout Timeout in nanoseconds to wait for at least one transfer to finish, 0 to not wait, UINT64_MAX to wait indefinitely.
+ * @param[out] out_count Number of transfers which finished. Optional.
+ * @return Result code. KERNELRESULT(TimedOut) if none finished within the timeout.
+ */
+Result usbCommsProcessCompletions(u32 interface, bool write, u64 timeout, u32* out_count);
+
+/// Returns the number of asynchronous transfers in flight on an endpoint of the specified interface.
+u32 usbCommsGetPendingCount(u32 interface, bool write);
+
+/// Waits for all the asynchronous transfers of an endpoint of the specified interface to finish, calling their callbacks.
+Result usbCommsFlush(u32 interface, bool write);
+
+/// Statistics of an endpoint, see \ref usbCommsGetStats.
+typedef struct {
+    u64 bytes;          ///< Bytes transferred.
+    u64 urb_count;      ///< Number of URBs which finished, synchronous and asynchronous ones.
+    u64 wait_ns;        ///< Time spent waiting on the CompletionEvent, in nanoseconds.
+    u64 bounce_count;   ///< Number of URBs which went through the staging buffer because the user buffer wasn't page-aligned.
+    u64 bounce_bytes;   ///< Bytes transferred through the staging buffer.
+} UsbCommsEndpointStats;
+
+/// Statistics of an interface, counted since it was initialized or since \ref usbCommsResetStats.
+typedef struct {
+    UsbCommsEndpointStats read;     ///< host->device endpoint.
+    UsbCommsEndpointStats write;    ///< device->host endpoint.
+} UsbCommsStats;
+
+/// Returns the average URB size of an endpoint.
+static inline u64 usbCommsGetAverageUrbSize(const UsbCommsEndpointStats *stats)
+{
+    return stats->urb_count ? stats->bytes / stats->urb_count : 0;
+}
+
+/// Retrieves the statistics of the specified interface.
+Result usbCommsGetStats(u32 interface, UsbCommsStats *out);
+
+/// Resets the statistics of the specified interface.
+Result usbCommsResetStats(u32 interface);
+
+/// Result of \ref usbCommsBenchmark for one transfer size.
+typedef struct {
+    size_t size;            ///< Transfer size.
+    u64 bytes_written;
+    u64 bytes_read;
+    u64 write_ns;           ///< Total time of the writes, in nanoseconds.
+    u64 read_ns;            ///< Total time of the reads, in nanoseconds.
+    UsbCommsStats stats;    ///< Statistics counted during the run of this size.
+} UsbCommsBenchmarkResult;
+
+/**
+ * @brief Runs a loopback benchmark on the specified interface: for each size, writes then reads back iterations transfers of that size.
+ * @note The host must send back each transfer it receives, with the same size.
+ * @param[in] sizes Transfer sizes.
+ * @param[in] num_sizes Number of sizes.
+ * @param[in] iterations Number of write+read round-trips for each size.
+ * @param[in] unaligned Whether to use a buffer which isn't page-aligned, to measure the staging buffer path.
+ * @param[out] out Output results, num_sizes entries.
+ * @return Result code.
+ */
+Result usbCommsBenchmark(u32 interface, const size_t *sizes, u32 num_sizes, u32 iterations, bool unaligned, UsbCommsBenchmarkResult *out);
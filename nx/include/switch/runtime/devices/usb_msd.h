@@ -0,0 +1,111 @@
+/**
+ * @file usb_msd.h
+ * @brief USB mass-storage (Bulk-Only Transport, SCSI) block device over usb:hs, with a sector cache, readahead and request merging.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "../../types.h"
+#include "../../kernel/mutex.h"
+#include "../../services/usbhs.h"
+
+#define USB_MSD_CACHE_BLOCK_SIZE 0x10000    ///< Size of the blocks of the sector cache.
+#define USB_MSD_MAX_XFER_SIZE 0x100000      ///< Maximum size of the data of a single SCSI command.
+
+/// Configuration of a \ref UsbMsdDevice. Zero fields use the defaults.
+typedef struct {
+    u32 cache_blocks;               ///< Number of cache blocks of \ref USB_MSD_CACHE_BLOCK_SIZE bytes. Default 32.
+    u32 readahead_blocks;           ///< Number of blocks read at once on sequential cache misses, at most USB_MSD_MAX_XFER_SIZE/USB_MSD_CACHE_BLOCK_SIZE and cache_blocks. Default 8.
+    u64 ready_timeout_ns;           ///< How long to wait for the unit to become ready. Default 5s.
+} UsbMsdConfig;
+
+/// Block of the sector cache.
+typedef struct {
+    u64 block;                      ///< Block number, UINT64_MAX if unused.
+    u64 last_use;
+} UsbMsdCacheBlock;
+
+/// Mass-storage device object.
+typedef struct {
+    Mutex mutex;
+    UsbHsClientIfSession if_session;
+    UsbHsClientEpSession ep_in, ep_out;
+    u8 lun;
+    u32 tag;
+
+    u32 sector_size;
+    u64 num_sectors;
+    bool read_only;
+
+    u8* cmd_buffer;                 ///< Page for the command and status blocks.
+    u8* xfer_buffer;                ///< USB_MSD_MAX_XFER_SIZE bytes for the unaligned and readahead transfers.
+
+    u32 cache_blocks;
+    u32 readahead_blocks;
+    UsbMsdCacheBlock* cache;
+    u8* cache_data;
+    u64 use_counter;
+    u64 next_block;                 ///< Block following the last miss, to detect sequential reads.
+} UsbMsdDevice;
+
+/// Sets up a filter matching the SCSI Bulk-Only mass-storage interfaces, for \ref usbHsQueryAvailableInterfaces and \ref usbHsCreateInterfaceAvailableEvent.
+static inline void usbMsdGetInterfaceFilter(UsbHsInterfaceFilter* filter)
+{
+    *filter = (UsbHsInterfaceFilter){
+        .Flags = UsbHsInterfaceFilterFlags_bInterfaceClass | UsbHsInterfaceFilterFlags_bInterfaceSubClass | UsbHsInterfaceFilterFlags_bInterfaceProtocol,
+        .bInterfaceClass = USB_CLASS_MASS_STORAGE,
+        .bInterfaceSubClass = 0x06,     // SCSI transparent command set
+        .bInterfaceProtocol = 0x50,     // Bulk-Only Transport
+    };
+}
+
+/**
+ * @brief Opens a mass-storage device: acquires the interface, waits for the unit to be ready and reads its capacity.
+ * @param[out] d UsbMsdDevice object.
+ * @param[in] interface Interface from \ref usbHsQueryAvailableInterfaces.
+ * @param[in] lun Logical unit number, usually 0.
+ * @param[in] config Configuration, NULL for the defaults.
+ * @return Result code.
+ * @note Only the Bulk-Only Transport is supported. UAS devices normally also expose a Bulk-Only alternate setting, which is the one matched by \ref usbMsdGetInterfaceFilter.
+ */
+Result usbMsdOpen(UsbMsdDevice* d, UsbHsInterface* interface, u8 lun, const UsbMsdConfig* config);
+
+/// Closes a mass-storage device.
+void usbMsdClose(UsbMsdDevice* d);
+
+/// Returns the size of the device in bytes.
+static inline u64 usbMsdGetSize(UsbMsdDevice* d)
+{
+    return d->num_sectors * d->sector_size;
+}
+
+/**
+ * @brief Reads data at any offset, through the sector cache.
+ * @note Misses on sequential reads are read ahead by readahead_blocks. Parts covering whole cache blocks bypass the cache, and are read with as few commands as possible, directly to the buffer when it's page-aligned.
+ */
+Result usbMsdRead(UsbMsdDevice* d, u64 offset, void* buffer, size_t size);
+
+/**
+ * @brief Writes data at any offset. The cache is write-through, so the data is on the device once this returns.
+ * @note Partial sectors are read-modify-written. Contiguous sectors are written with as few commands as possible.
+ */
+Result usbMsdWrite(UsbMsdDevice* d, u64 offset, const void* buffer, size_t size);
+
+/// Reads whole sectors, bypassing the cache.
+Result usbMsdReadSectors(UsbMsdDevice* d, u64 sector, u32 count, void* buffer);
+
+/// Writes whole sectors, updating the cached copies.
+Result usbMsdWriteSectors(UsbMsdDevice* d, u64 sector, u32 count, const void* buffer);
+
+/// Asks the device to commit its own write cache to the medium (SYNCHRONIZE CACHE).
+Result usbMsdFlush(UsbMsdDevice* d);
+
+/**
+ * @brief Mounts a device as a devoptab, so that "name:/" opens the raw device with the standard I/O functions, for file system libraries working on top of it.
+ * @param[in] d Device, which must stay open until \ref usbMsdUnmount.
+ * @param[in] name Device name, without the trailing ':'.
+ * @return Result code.
+ */
+Result usbMsdMount(UsbMsdDevice* d, const char* name);
+
+/// Unmounts a device mounted with \ref usbMsdMount.
+Result usbMsdUnmount(const char* name);
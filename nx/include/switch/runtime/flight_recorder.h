@@ -0,0 +1,96 @@
+/**
+ * @file flight_recorder.h
+ * @brief Always-on flight recorder: recent events, IPC requests and frame timings are kept in a fixed lock-free ring, which can be dumped to the SD card from the exception handler.
+ * @note IPC requests are only recorded when libnx (and any code using the inline service dispatch helpers or sf/service.hpp) is built with NX_FLIGHT_RECORDER defined, i.e. with -DNX_FLIGHT_RECORDER added to CFLAGS.
+ *       Trace zones (see runtime/trace.h) are recorded too when libnx is built with NX_FLIGHT_RECORDER, whether or not the trace exporter is running.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "../types.h"
+#include "../result.h"
+#include "../arm/thread_context.h"
+
+/// Number of events in the ring (power of two). Older events are overwritten.
+#define FLIGHT_RECORDER_EVENTS 1024
+
+/// Magic of the dump file, "NXFR".
+#define FLIGHT_RECORDER_MAGIC 0x5246584E
+
+/// Version of the dump file format.
+#define FLIGHT_RECORDER_VERSION 1
+
+/// Flight recorder event types.
+typedef enum {
+    FlightEventType_Mark  = 0, ///< Event from \ref flightRecorderMark: name, arg0 and arg1 are set by the caller.
+    FlightEventType_Ipc   = 1, ///< IPC request: arg0 is (session << 32) | command ID, arg1 is (domain object ID << 32) | Result.
+    FlightEventType_Frame = 2, ///< Frame from \ref flightRecorderFrame: arg0 is the number of ticks since the previous frame.
+    FlightEventType_Trace = 3, ///< Trace zone event from \ref traceRecord: name is the zone name (NULL for ends), arg0 is the \ref TraceEventType.
+} FlightEventType;
+
+/// Flight recorder event.
+typedef struct {
+    u64 seq;            ///< Sequence number of the event plus one, 0 while it's being written.
+    u64 tick;           ///< System tick of the event.
+    const char* name;   ///< Name of the event, a string with static storage duration, or NULL.
+    u32 type;           ///< \ref FlightEventType
+    Handle thread;      ///< Handle of the thread which recorded the event.
+    u64 arg0;
+    u64 arg1;
+} FlightEvent;
+
+/// Header of the dump file. It's followed by the \ref ThreadExceptionDump when has_exception is set, then by the ring of \ref FLIGHT_RECORDER_EVENTS events (in ring order, see FlightEvent::seq).
+typedef struct {
+    u32 magic;          ///< \ref FLIGHT_RECORDER_MAGIC
+    u32 version;        ///< \ref FLIGHT_RECORDER_VERSION
+    u64 module_base;    ///< Address of the start of the module, to resolve event names and addresses with the ELF.
+    u64 tick;           ///< System tick at which the dump was written.
+    u64 tick_freq;      ///< System tick frequency.
+    u64 num_events;     ///< Number of events recorded since startup.
+    u32 has_exception;  ///< Whether a \ref ThreadExceptionDump follows.
+    u32 num_slots;      ///< \ref FLIGHT_RECORDER_EVENTS
+} FlightRecorderHeader;
+
+/**
+ * @brief Records an event. This is a handful of stores and one atomic increment, and never blocks.
+ * @param[in] type \ref FlightEventType
+ * @param[in] name Name of the event, a string with static storage duration (e.g. a literal), or NULL.
+ * @param[in] arg0 First argument.
+ * @param[in] arg1 Second argument.
+ */
+void flightRecorderRecord(FlightEventType type, const char* name, u64 arg0, u64 arg1);
+
+/// Records a \ref FlightEventType_Mark event.
+static inline void flightRecorderMark(const char* name, u64 arg0, u64 arg1)
+{
+    flightRecorderRecord(FlightEventType_Mark, name, arg0, arg1);
+}
+
+/// Records an IPC request. Called by the dispatch hooks.
+static inline void flightRecorderRecordIpc(Handle session, u32 object_id, u32 request_id, Result rc)
+{
+    flightRecorderRecord(FlightEventType_Ipc, NULL, ((u64)session << 32) | request_id, ((u64)object_id << 32) | rc);
+}
+
+/// Records the end of a frame, with the time since the previous call. Call this once per frame, e.g. after presenting.
+void flightRecorderFrame(void);
+
+/// Returns the number of events recorded since startup.
+u64 flightRecorderGetCount(void);
+
+/**
+ * @brief Copies the most recent events, oldest first.
+ * @param[out] events Output array.
+ * @param[in] max_events Size of the output array.
+ * @return Number of events written.
+ */
+u32 flightRecorderGetEvents(FlightEvent* events, u32 max_events);
+
+/**
+ * @brief Writes the dump file (see \ref FlightRecorderHeader) to the SD card, with fs directly instead of stdio.
+ * @param[in] path Path on the SD card, e.g. "/crash.nxfr". An existing file is replaced.
+ * @param[in] ctx Exception context, or NULL.
+ * @return Result code.
+ * @note Meant to be called from __libnx_exception_handler with the context it received; fs must be initialized (which it is by default).
+ *       The fs commands need about 0x400 bytes of stack for the path, so __nx_exception_stack must be made larger than the default (e.g. 0x4000 bytes).
+ */
+Result flightRecorderDump(const char* path, const ThreadExceptionDump* ctx);
@@ -0,0 +1,88 @@
+/**
+ * @file fs_async.h
+ * @brief Asynchronous file read queue, serviced by a pool of worker threads.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "../types.h"
+#include "../kernel/mutex.h"
+#include "../kernel/condvar.h"
+#include "../kernel/thread.h"
+#include "../kernel/uevent.h"
+#include "../services/fs.h"
+
+/// Maximum number of worker threads in a \ref FsAsyncQueue.
+#define FS_ASYNC_MAX_THREADS 8
+
+/// Single read request.
+typedef struct {
+    FsFile* file;      ///< File to read from.
+    s64 offset;        ///< File offset.
+    void* buffer;      ///< Destination buffer. Unlike fs_dev there is no bounce fallback, so this must be memory FS can map.
+    u64 size;          ///< Number of bytes to read.
+    u64 bytes_read;    ///< [out] Number of bytes read.
+    Result result;     ///< [out] Result of the read.
+} FsAsyncReadRequest;
+
+/// Batch of read requests, completed as a whole.
+typedef struct FsAsyncBatch FsAsyncBatch;
+
+struct FsAsyncBatch {
+    FsAsyncReadRequest* reqs;   ///< Requests in this batch.
+    u32 num_reqs;               ///< Number of requests.
+    u32 next_req;               ///< Index of the next request to be picked up by a worker.
+    u32 num_pending;            ///< Number of requests not completed yet.
+    UEvent event;               ///< Signalled once all requests have completed.
+    FsAsyncBatch* next;         ///< Next batch in the queue.
+};
+
+/// Asynchronous read queue.
+typedef struct {
+    Mutex mutex;
+    CondVar cond;
+    FsAsyncBatch* head;
+    FsAsyncBatch* tail;
+    bool should_exit;
+    u32 num_threads;
+    Thread threads[FS_ASYNC_MAX_THREADS];
+} FsAsyncQueue;
+
+/**
+ * @brief Creates an asynchronous read queue and starts its worker threads.
+ * @param[out] q Queue object.
+ * @param[in] num_threads Number of worker threads (1..\ref FS_ASYNC_MAX_THREADS). Requests are only serviced in parallel up to the number of sessions in the fs session pool, see __nx_fs_num_sessions.
+ * @param[in] prio Priority of the worker threads.
+ * @param[in] cpuid Core of the worker threads, or -2 for the default core.
+ * @return Result code.
+ */
+Result fsasyncCreate(FsAsyncQueue* q, u32 num_threads, int prio, int cpuid);
+
+/**
+ * @brief Stops the worker threads and closes the queue.
+ * @note Batches still queued are not completed, wait for them before calling this.
+ * @param[in] q Queue object.
+ */
+void fsasyncClose(FsAsyncQueue* q);
+
+/**
+ * @brief Submits a batch of read requests.
+ * @param[in] q Queue object.
+ * @param[out] batch Batch object, must remain valid until completed.
+ * @param[in] reqs Requests, must remain valid until the batch has completed.
+ * @param[in] num_reqs Number of requests.
+ */
+void fsasyncSubmitRead(FsAsyncQueue* q, FsAsyncBatch* batch, FsAsyncReadRequest* reqs, u32 num_reqs);
+
+/**
+ * @brief Waits for a batch to complete.
+ * @param[in] batch Batch object.
+ * @param[in] timeout Timeout in nanoseconds.
+ * @return KERNELRESULT(TimedOut) if the batch hasn't completed yet, otherwise the result of the first failed request, or 0.
+ */
+Result fsasyncBatchWait(FsAsyncBatch* batch, u64 timeout);
+
+/// Creates a \ref Waiter for a batch, signalled when all of its requests have completed.
+static inline Waiter waiterForFsAsyncBatch(FsAsyncBatch* batch)
+{
+    return waiterForUEvent(&batch->event);
+}
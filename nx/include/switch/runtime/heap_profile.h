@@ -0,0 +1,70 @@
+/**
+ * @file heap_profile.h
+ * @brief Heap usage and allocation profiling.
+ * @note The profiler wraps the allocation functions at link time, add the following to the LDFLAGS of the application to enable it:
+ *       -Wl,--wrap=malloc,--wrap=free,--wrap=calloc,--wrap=realloc,--wrap=memalign,--wrap=aligned_alloc,--wrap=_malloc_r,--wrap=_free_r,--wrap=_calloc_r,--wrap=_realloc_r,--wrap=_memalign_r
+ *       This works on top of \ref MT_HEAP_OVERRIDE_MALLOC too.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include <stdio.h>
+#include "../types.h"
+
+/// Number of allocation size classes: class n holds allocations of [2^(n-1), 2^n) bytes, class 0 those of 0 bytes.
+#define HEAP_PROFILE_NUM_CLASSES 40
+
+/// Maximum number of distinct callsites recorded.
+#define HEAP_PROFILE_MAX_CALLSITES 512
+
+/// Heap statistics.
+typedef struct {
+    u64 bytes_in_use;                               ///< Bytes currently allocated (usable sizes).
+    u64 peak_bytes_in_use;                          ///< Highest value of bytes_in_use.
+    u64 num_allocs;                                 ///< Number of successful allocations.
+    u64 num_frees;                                  ///< Number of frees.
+    u64 num_failed;                                 ///< Number of failed allocations.
+    u64 allocs_by_class[HEAP_PROFILE_NUM_CLASSES];  ///< Number of allocations by size class.
+} HeapProfileStats;
+
+/// Sampled allocation callsite.
+typedef struct {
+    void* addr;                                     ///< Return address of the allocation call.
+    u64 num_allocs;                                 ///< Allocations sampled from this callsite.
+    u64 bytes;                                      ///< Bytes requested by the sampled allocations.
+} HeapProfileCallsite;
+
+/// Returns whether allocations are being profiled, i.e. whether the application was linked with the wrapping flags.
+bool heapProfileIsActive(void);
+
+/**
+ * @brief Gets the heap statistics.
+ * @param[out] out Statistics.
+ */
+void heapProfileGetStats(HeapProfileStats* out);
+
+/**
+ * @brief Gets the sampled callsites, sorted by sampled bytes.
+ * @param[out] out Callsites.
+ * @param[in] max_callsites Maximum number of callsites to write.
+ * @return Number of callsites written.
+ * @note One allocation out of __nx_heap_profile_sample_interval (weak symbol, 16 by default) is sampled.
+ */
+u32 heapProfileGetCallsites(HeapProfileCallsite* out, u32 max_callsites);
+
+/// Resets the counters and callsites. The peak is reset to the bytes currently in use.
+void heapProfileReset(void);
+
+/**
+ * @brief Writes a report of the heap statistics, the newlib heap (fake_heap) usage and the top callsites.
+ * @param f Output stream, e.g. stdout when redirected with \ref nxlinkStdio, or a file opened on a filesystem device.
+ * @param[in] max_callsites Maximum number of callsites listed, up to 32.
+ */
+void heapProfileDump(FILE* f, u32 max_callsites);
+
+/**
+ * @brief Writes a report like \ref heapProfileDump to a file.
+ * @param[in] path Path of the file, e.g. "sdmc:/heap.txt".
+ * @param[in] max_callsites Maximum number of callsites listed.
+ * @return Result code.
+ */
+Result heapProfileDumpToFile(const char* path, u32 max_callsites);
@@ -19,6 +19,12 @@
 /// Extracts the micro number from a HOS version value.
 #define HOSVER_MICRO(_version) ( (_version)        & 0xFF)
 
+/**
+ * @def LIBNX_MIN_HOS
+ * @brief Minimum HOS version targeted by the build, as a \ref MAKEHOSVERSION value. Defined by the build system (see the minhos target of the libnx Makefile), not by default.
+ * When it's defined, the version checks against versions up to it are constant, so that the code for older versions is removed.
+ */
+
 /// Returns the current HOS version that was previously set with \ref hosversionSet. If version initialization fails during startup (such as in the case set:sys is not available), this function returns zero.
 u32 hosversionGet(void);
 
@@ -27,6 +33,10 @@ void hosversionSet(u32 version);
 
 /// Returns true if the current HOS version is equal to or above the specified major/minor/micro version.
 static inline bool hosversionAtLeast(u8 major, u8 minor, u8 micro) {
+#ifdef LIBNX_MIN_HOS
+    if (MAKEHOSVERSION(major,minor,micro) <= (LIBNX_MIN_HOS))
+        return true;
+#endif
     return hosversionGet() >= MAKEHOSVERSION(major,minor,micro);
 }
 
@@ -37,6 +47,5 @@ static inline bool hosversionBefore(u8 major, u8 minor, u8 micro) {
 
 /// Returns true if the current HOS version is between the two specified major versions, i.e. [major1, major2).
 static inline bool hosversionBetween(u8 major1, u8 major2) {
-    u32 ver = hosversionGet();
-    return ver >= MAKEHOSVERSION(major1,0,0) && ver < MAKEHOSVERSION(major2,0,0);
+    return hosversionAtLeast(major1,0,0) && !hosversionAtLeast(major2,0,0);
 }
@@ -0,0 +1,109 @@
+/**
+ * @file http.h
+ * @brief Small HTTP/1.1 client with keep-alive connection pooling, built on the socket driver.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "../types.h"
+#include "../kernel/mutex.h"
+
+/// Size of the receive buffer of each pooled connection.
+#define HTTP_RECV_BUFFER_SIZE 0x4000
+
+/// Maximum number of requests kept in flight on a connection by \ref httpGetPipelined.
+#define HTTP_PIPELINE_DEPTH 8
+
+/// Maximum host name length.
+#define HTTP_MAX_HOST_LEN 255
+
+/// Pooled connection (internal).
+typedef struct HttpConnection {
+    struct HttpConnection* next;
+    char host[HTTP_MAX_HOST_LEN+1];
+    u16 port;
+    int fd;
+    u64 last_used;                              ///< System tick of the last completed response.
+    u32 rpos;
+    u32 rlen;
+    u8 rbuf[HTTP_RECV_BUFFER_SIZE];
+} HttpConnection;
+
+/// Cached DNS result (internal).
+typedef struct HttpDnsEntry {
+    struct HttpDnsEntry* next;
+    char host[HTTP_MAX_HOST_LEN+1];
+    u32 addr;                                   ///< IPv4 address, in network byte order.
+    u64 expires;                                ///< System tick after which the entry is stale.
+} HttpDnsEntry;
+
+/// HTTP client, holding the idle connection pool and the DNS cache. Thread-safe.
+typedef struct {
+    Mutex mutex;
+    HttpConnection* idle;                       ///< Idle keep-alive connections.
+    HttpDnsEntry* dns;                          ///< DNS cache.
+    u32 num_idle;
+    u32 max_idle;                               ///< Maximum number of idle connections kept open (default 8).
+    u64 idle_timeout_ns;                        ///< Idle connections older than this are closed instead of reused (default 30s).
+    u64 dns_ttl_ns;                             ///< Lifetime of DNS cache entries (default 60s).
+} HttpClient;
+
+/// Response information.
+typedef struct {
+    int status;                                 ///< HTTP status code, 0 if no response was received.
+    s64 content_length;                         ///< Content-Length, -1 if unknown.
+    bool chunked;                               ///< Whether the body used chunked transfer encoding.
+    bool keep_alive;                            ///< Whether the connection was returned to the pool.
+} HttpResponse;
+
+/**
+ * @brief Callback receiving response body data.
+ * @param[in] user User pointer.
+ * @param[in] index Index of the request (0 except for \ref httpGetPipelined).
+ * @param[in] data Body data.
+ * @param[in] size Size of the data.
+ * @return 0 to continue, anything else to abort the transfer.
+ */
+typedef int (*HttpBodyCallback)(void* user, size_t index, const void* data, size_t size);
+
+/// Initializes an HTTP client with the default settings.
+void httpClientCreate(HttpClient* c);
+
+/// Closes all pooled connections and frees the DNS cache.
+void httpClientClose(HttpClient* c);
+
+/**
+ * @brief Performs a request and streams the response body to a callback.
+ * @param[in] c Client.
+ * @param[in] method Method, for example "GET".
+ * @param[in] url URL, of the form http://host[:port]/path.
+ * @param[in] headers Extra request headers, each terminated by "\r\n". Can be NULL.
+ * @param[in] body Request body. Can be NULL.
+ * @param[in] body_size Size of the request body.
+ * @param[out] resp Response information.
+ * @param[in] cb Body callback. Can be NULL to discard the body.
+ * @param[in] user User pointer passed to the callback.
+ * @return 0 on success (any HTTP status), -1 with errno set on failure.
+ */
+int httpRequest(HttpClient* c, const char* method, const char* url, const char* headers, const void* body, size_t body_size, HttpResponse* resp, HttpBodyCallback cb, void* user);
+
+/**
+ * @brief Performs several GET requests on a single connection, keeping up to \ref HTTP_PIPELINE_DEPTH requests in flight.
+ * @param[in] c Client.
+ * @param[in] urls URLs, which must all use the same host and port.
+ * @param[in] num_urls Number of URLs.
+ * @param[out] resps Response information for each URL.
+ * @param[in] cb Body callback, receiving the index of the URL. Can be NULL.
+ * @param[in] user User pointer passed to the callback.
+ * @return 0 on success, -1 with errno set on failure. Responses that were not received have a status of 0.
+ */
+int httpGetPipelined(HttpClient* c, const char* const* urls, size_t num_urls, HttpResponse* resps, HttpBodyCallback cb, void* user);
+
+/**
+ * @brief Downloads a URL to a file, streaming the body as it arrives.
+ * @param[in] c Client.
+ * @param[in] url URL.
+ * @param[in] path Destination path, for example on an fs_dev device ("sdmc:/file.bin"). The file is created or truncated.
+ * @param[out] resp Response information.
+ * @return 0 on success, -1 with errno set on failure. Non-2xx responses fail with EIO and leave no file behind.
+ */
+int httpDownloadToFile(HttpClient* c, const char* url, const char* path, HttpResponse* resp);
@@ -0,0 +1,66 @@
+/**
+ * @file init.h
+ * @brief Application startup: default service initialization and its timing report.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include <stdio.h>
+#include "../types.h"
+
+/// Steps of the default __appInit.
+typedef enum {
+    AppInitStep_Sm = 0,         ///< sm initialization.
+    AppInitStep_HosVersion,     ///< Reading the system version with set:sys, when the loader didn't provide it.
+    AppInitStep_Applet,         ///< applet initialization.
+    AppInitStep_Hid,            ///< hid initialization, deferred in lazy mode.
+    AppInitStep_Time,           ///< time initialization and newlib time setup, deferred in lazy mode.
+    AppInitStep_Fs,             ///< fs initialization.
+    AppInitStep_Sdmc,           ///< Mounting the SD card and setting the working directory.
+    AppInitStep_User,           ///< __nx_win_init and userAppInit.
+    AppInitStep_Count,
+} AppInitStep;
+
+/// Startup timing report.
+typedef struct {
+    u64 ticks[AppInitStep_Count];   ///< System ticks spent in each step, 0 if it was skipped or deferred.
+    u32 deferred_mask;              ///< Bitmask of the steps deferred to first use (BIT(step)).
+    u64 total_ticks;                ///< System ticks spent in __appInit.
+} AppInitTimings;
+
+/**
+ * @brief Gets the startup timing report of the default __appInit.
+ * @param[out] out Report. Everything is 0 if __appInit was overridden.
+ * @note Set the weak symbol __nx_appinit_lazy to non-zero to defer hid and time initialization to their first use (\ref hidScanInput, the time service sessions, and newlib's time functions).
+ *       Until then, the TZ environment variable isn't set, and hid commands other than the ones listed in \ref hidInitializeLazy need \ref hidInitialize to be called first.
+ */
+void appInitGetTimings(AppInitTimings* out);
+
+/**
+ * @brief Writes the startup timing report, in microseconds.
+ * @param f Output stream.
+ */
+void appInitDumpTimings(FILE* f);
+
+/// Maximum number of tasks of \ref appInitRunParallel.
+#define APPINIT_MAX_TASKS 32
+
+/// Maximum number of threads of \ref appInitRunParallel.
+#define APPINIT_MAX_THREADS 8
+
+/// Initialization task for \ref appInitRunParallel.
+typedef struct {
+    const char* name;       ///< Name of the task, for diagnostics.
+    Result (*init)(void);   ///< Initializer, e.g. nifmInitialize wrapped to pass its arguments.
+    u32 deps;               ///< Bitmask of the tasks which must have succeeded before this one starts (BIT(index)), only earlier tasks can be used.
+} AppInitTask;
+
+/**
+ * @brief Runs independent initializers on worker threads, so that startup takes about as long as the longest chain of dependent initializers instead of their sum.
+ * @param[in] tasks Tasks, up to \ref APPINIT_MAX_TASKS.
+ * @param[in] num_tasks Number of tasks.
+ * @param[in] num_threads Number of threads including the calling thread, 1 to \ref APPINIT_MAX_THREADS. Worker threads are created with the priority of the calling thread; if they can't be created the calling thread runs everything.
+ * @param[out] out_results Result of each task. Tasks whose dependencies failed aren't run, and get the failure of the dependency.
+ * @return Result code, the first failure in task order.
+ * @note This can be used from userAppInit, e.g. for pl, nifm and account. Set the weak symbol __nx_appinit_parallel to non-zero for the default services to be initialized this way too: applet then hid, time, and fs then the SD card.
+ */
+Result appInitRunParallel(const AppInitTask* tasks, u32 num_tasks, u32 num_threads, Result* out_results);
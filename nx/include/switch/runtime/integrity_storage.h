@@ -0,0 +1,96 @@
+/**
+ * @file integrity_storage.h
+ * @brief Hash-tree (hierarchical SHA256 / IVFC) verifying storage, checking data at read time.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "../types.h"
+#include "../kernel/mutex.h"
+#include "../services/fs.h"
+#include "../crypto/sha256.h"
+#include "crypto_storage.h"
+
+/// Maximum number of levels (hash levels and the data level) of an \ref IntegrityStorage.
+#define INTEGRITY_STORAGE_MAX_LEVELS 7
+
+/// Maximum number of data blocks read and verified by a single source read.
+#define INTEGRITY_STORAGE_MAX_RUN_BLOCKS 32
+
+/// Hash tree format.
+typedef enum {
+    IntegrityStorageType_HierarchicalSha256 = 0,    ///< Partial last blocks are hashed as-is (NCA PFS0 sections).
+    IntegrityStorageType_Ivfc               = 1,    ///< Partial last blocks are zero-padded to the block size before hashing (NCA RomFS sections).
+} IntegrityStorageType;
+
+/// Backing source type.
+typedef enum {
+    IntegrityStorageSourceType_Storage       = 0,   ///< FsStorage.
+    IntegrityStorageSourceType_File          = 1,   ///< FsFile.
+    IntegrityStorageSourceType_CryptoStorage = 2,   ///< \ref CryptoStorage.
+} IntegrityStorageSourceType;
+
+/// Backing source of an \ref IntegrityStorage. It is not closed by \ref integrityStorageClose, and must remain valid until then.
+typedef struct {
+    IntegrityStorageSourceType type;    ///< \ref IntegrityStorageSourceType
+    FsStorage* storage;                 ///< Storage, when type is \ref IntegrityStorageSourceType_Storage.
+    FsFile* file;                       ///< File, when type is \ref IntegrityStorageSourceType_File.
+    CryptoStorage* crypto;              ///< CryptoStorage, when type is \ref IntegrityStorageSourceType_CryptoStorage.
+} IntegrityStorageSource;
+
+/// Hash tree level. Each block of a level is hashed by a \ref SHA256_HASH_SIZE entry of the level above it.
+typedef struct {
+    s64 offset;         ///< Offset of the level within the source.
+    s64 size;           ///< Size of the level.
+    u32 block_size;     ///< Block size of the level.
+} IntegrityStorageLevel;
+
+/// Verifying storage.
+typedef struct {
+    IntegrityStorageSource src;
+    IntegrityStorageType type;
+    IntegrityStorageLevel levels[INTEGRITY_STORAGE_MAX_LEVELS];
+    u32 num_levels;
+    u8 master_hash[SHA256_HASH_SIZE];
+
+    u8* tree;                                       ///< Upper hash levels, read and verified on creation.
+    size_t tree_offsets[INTEGRITY_STORAGE_MAX_LEVELS];
+    u32 num_cached_levels;
+
+    u8* hash_block;                                 ///< Last verified block of the lowest hash level, when it isn't cached.
+    s64 hash_block_index;
+    u8* data_block;                                 ///< Last verified data block read by a partial block read.
+    s64 data_block_index;
+
+    Mutex mutex;
+} IntegrityStorage;
+
+/**
+ * @brief Creates a verifying storage. The hash levels above the lowest one are read and verified immediately, the lowest hash level and data are verified as they are read.
+ * @param[out] out IntegrityStorage object.
+ * @param[in] type \ref IntegrityStorageType
+ * @param[in] src Backing source.
+ * @param[in] levels Levels, from the top hash level to the data level. The block sizes of hash levels must be multiples of \ref SHA256_HASH_SIZE.
+ * @param[in] num_levels Number of levels, 2 to \ref INTEGRITY_STORAGE_MAX_LEVELS.
+ * @param[in] master_hash SHA256 of the top level (zero-padded to its block size for \ref IntegrityStorageType_Ivfc).
+ * @return Result code. LibnxError_HashMismatch if the hash tree doesn't match the master hash.
+ */
+Result integrityStorageCreate(IntegrityStorage* out, IntegrityStorageType type, const IntegrityStorageSource* src, const IntegrityStorageLevel* levels, u32 num_levels, const void* master_hash);
+
+/// Frees the cached hash tree and buffers.
+void integrityStorageClose(IntegrityStorage* is);
+
+/**
+ * @brief Reads and verifies data.
+ * @param[in] is IntegrityStorage object.
+ * @param[in] offset Offset within the data level.
+ * @param[out] buffer Output buffer. Whole blocks are read directly into it and verified in place, its contents are undefined when this fails.
+ * @param[in] size Size to read, offset+size must not exceed the size of the data level.
+ * @return Result code. LibnxError_HashMismatch if any of the blocks covering the read failed verification.
+ */
+Result integrityStorageRead(IntegrityStorage* is, s64 offset, void* buffer, u64 size);
+
+/// Gets the size of the data level.
+static inline s64 integrityStorageGetSize(IntegrityStorage* is)
+{
+    return is->levels[is->num_levels - 1].size;
+}
@@ -0,0 +1,27 @@
+/**
+ * @file large_buffer.h
+ * @brief Allocator for large, page-aligned buffers (GPU, DMA, transfer memory), kept apart from the heap.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "../types.h"
+
+/// Granularity of large buffers, which allows the kernel to use large pages for them.
+#define LARGE_BUFFER_BLOCK_SIZE 0x200000
+
+/// Maximum number of blocks in the large buffer region.
+#define LARGE_BUFFER_MAX_BLOCKS 1024
+
+/**
+ * @brief Allocates a page-aligned buffer.
+ * @param[in] size Size in bytes.
+ * @return Pointer to the buffer, or NULL on failure.
+ * @note Buffers of at least \ref LARGE_BUFFER_BLOCK_SIZE bytes are made of 2 MiB-aligned blocks mapped with \ref svcMapPhysicalMemory in a dedicated area of the alias region (its size is set by the __nx_large_buffer_region_size weak symbol), when the process is allowed to use it [3.0.0+]. Other buffers, and all of them when this isn't possible, are allocated from the heap.
+ */
+void* largeBufferAlloc(size_t size);
+
+/**
+ * @brief Frees a buffer allocated with \ref largeBufferAlloc.
+ * @param ptr Buffer, or NULL.
+ */
+void largeBufferFree(void* ptr);
@@ -0,0 +1,71 @@
+/**
+ * @file mem_pressure.h
+ * @brief Central memory budget for caches: caches register a trim callback, and the lowest priority ones are trimmed first when the available memory runs low.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "../types.h"
+
+/**
+ * @brief Trim callback of a cache.
+ * @param[in] bytes Number of bytes the cache is asked to free.
+ * @param[in] userdata User data passed to \ref memPressureRegister.
+ * @return Number of bytes actually freed.
+ */
+typedef size_t (*MemPressureTrimFunc)(size_t bytes, void* userdata);
+
+/// Registered cache. The struct must stay valid until \ref memPressureUnregister.
+typedef struct MemPressureCache {
+    struct MemPressureCache* next;
+    const char* name;               ///< Name of the cache, for diagnostics.
+    s32 priority;                   ///< Lower priorities are trimmed first.
+    MemPressureTrimFunc trim;
+    void* userdata;
+    u64 trimmed;                    ///< Total size freed by the trim callback.
+} MemPressureCache;
+
+/// Memory usage of the process, see \ref memPressureGetUsage.
+typedef struct {
+    u64 total;                      ///< Memory available to the process (InfoType_TotalMemorySize).
+    u64 used;                       ///< Memory in use: the memory mapped by the process, minus the part of the heap newlib hasn't handed out.
+} MemPressureUsage;
+
+/**
+ * @brief Registers a cache to be trimmed under memory pressure.
+ * @param[out] c MemPressureCache object.
+ * @param[in] name Name of the cache.
+ * @param[in] priority Priority, caches which are cheap to refill should use low values.
+ * @param[in] trim Trim callback. It's called from the thread which calls \ref memPressureTrim or \ref memPressureCheck, and must not register or unregister caches.
+ * @param[in] userdata User data for the callback.
+ * @note The thread stack cache (\ref threadStackCacheFlush) and the transfer memory cache (\ref tmemCacheFlush) are always trimmed before the registered caches.
+ *       No other libnx cache registers itself: the romfs and fsdev block caches are sized at mount time, and objects like \ref PlGlyphCache keep fixed-size storage which evicting entries doesn't free.
+ */
+void memPressureRegister(MemPressureCache* c, const char* name, s32 priority, MemPressureTrimFunc trim, void* userdata);
+
+/// Unregisters a cache, before it's destroyed.
+void memPressureUnregister(MemPressureCache* c);
+
+/**
+ * @brief Gets the memory usage of the process.
+ * @param[out] out \ref MemPressureUsage
+ * @return Result code.
+ */
+Result memPressureGetUsage(MemPressureUsage* out);
+
+/**
+ * @brief Trims caches, lowest priority first, until at least the specified size was freed.
+ * @param[in] bytes Size to free.
+ * @return Size actually freed.
+ */
+size_t memPressureTrim(size_t bytes);
+
+/**
+ * @brief Trims caches if the available memory is below the threshold, bringing it back to it. Meant to be polled, e.g. once per frame or before large allocations.
+ * @param[out] out_freed Size freed, can be NULL.
+ * @return Result code.
+ * @note The threshold is set with the __nx_mem_pressure_threshold weak symbol (8 MiB by default), or \ref memPressureSetThreshold.
+ */
+Result memPressureCheck(size_t* out_freed);
+
+/// Sets the available memory threshold used by \ref memPressureCheck, overriding __nx_mem_pressure_threshold. SIZE_MAX reverts to __nx_mem_pressure_threshold.
+void memPressureSetThreshold(size_t bytes);
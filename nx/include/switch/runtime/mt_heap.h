@@ -0,0 +1,76 @@
+/**
+ * @file mt_heap.h
+ * @brief Scalable multi-threaded heap allocator, with per-thread caches, size-class slabs and per-core arenas.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "../types.h"
+
+/// Granularity at which the heap manages memory; slabs are one page, larger allocations take whole pages.
+#define MT_HEAP_PAGE_SIZE 0x10000
+
+/// Largest allocation served from size-class slabs.
+#define MT_HEAP_SMALL_MAX 0x2000
+
+/// Minimum amount of memory the heap takes from its sources at once.
+#define MT_HEAP_CHUNK_SIZE 0x400000
+
+/// Number of per-core arenas.
+#define MT_HEAP_NUM_ARENAS 4
+
+/**
+ * @brief Allocates memory.
+ * @param[in] size Size in bytes.
+ * @return Pointer to memory aligned to 16 bytes, or NULL on failure.
+ * @note Memory comes from the newlib heap (fake_heap_start..fake_heap_end) through sbrk. Once it's exhausted, memory is mapped in the alias region with \ref svcMapPhysicalMemory, when the process is allowed to.
+ */
+void* mtHeapAlloc(size_t size);
+
+/**
+ * @brief Allocates aligned memory.
+ * @param[in] alignment Alignment, a power of two.
+ * @param[in] size Size in bytes.
+ * @return Pointer to memory, or NULL on failure.
+ */
+void* mtHeapAlignedAlloc(size_t alignment, size_t size);
+
+/**
+ * @brief Allocates zero-initialized memory for an array.
+ * @param[in] count Number of elements.
+ * @param[in] size Size of an element.
+ * @return Pointer to memory, or NULL on failure.
+ */
+void* mtHeapCalloc(size_t count, size_t size);
+
+/**
+ * @brief Resizes an allocation, moving it if needed.
+ * @param[in] ptr Allocation, or NULL.
+ * @param[in] size New size in bytes.
+ * @return Pointer to memory, or NULL on failure (the original allocation is left intact).
+ */
+void* mtHeapRealloc(void* ptr, size_t size);
+
+/**
+ * @brief Frees memory allocated by the heap, from any thread.
+ * @param[in] ptr Allocation, or NULL.
+ */
+void mtHeapFree(void* ptr);
+
+/**
+ * @brief Gets the usable size of an allocation.
+ * @param[in] ptr Allocation.
+ */
+size_t mtHeapUsableSize(void* ptr);
+
+/// Returns the objects cached by the current thread to their arenas. This is done automatically when a thread created with \ref threadCreate exits.
+void mtHeapThreadFlush(void);
+
+/// Symbol pulling in the malloc/free/realloc/... replacements forwarding to this heap, see \ref MT_HEAP_OVERRIDE_MALLOC.
+extern const int __nx_mt_heap_malloc_override;
+
+/**
+ * @brief Replaces newlib's malloc with this heap. Use it once, at file scope, in one source file of the application.
+ * @note Code calling newlib's mallinfo/malloc_stats gets zeroed/empty results.
+ */
+#define MT_HEAP_OVERRIDE_MALLOC() \
+    __attribute__((used)) static const int* const __nx_mt_heap_malloc_override_ref = &__nx_mt_heap_malloc_override
@@ -5,6 +5,7 @@
  * @copyright libnx Authors
  */
 #pragma once
+#include "../types.h"
 
 struct in_addr;
 
@@ -20,3 +21,21 @@ extern struct in_addr __nxlink_host;
  * @note The socket should be closed with close() during application cleanup.
  */
 int nxlinkStdio(void);
+
+/**
+ * @brief Sets up buffered stdout/stderr redirection to the nxlink host: prints are appended to per-thread buffers without waiting, and sent in batches by a background thread.
+ * @param[in] prio Priority of the sender thread, for example 0x3B.
+ * @return Socket fd on success, negative number on failure.
+ * @note Prints that don't fit in the calling thread's buffer are dropped, see \ref nxlinkStdioAsyncGetDroppedCount. See \ref async_log.h.
+ * @note \ref nxlinkStdioAsyncExit should be called during application cleanup, instead of closing the socket.
+ */
+int nxlinkStdioAsync(int prio);
+
+/// Sends everything printed so far through \ref nxlinkStdioAsync, waiting for the socket.
+void nxlinkStdioAsyncFlush(void);
+
+/// Returns the number of bytes dropped so far by \ref nxlinkStdioAsync.
+u64 nxlinkStdioAsyncGetDroppedCount(void);
+
+/// Sends everything printed so far, restores stdout/stderr and closes the socket set up by \ref nxlinkStdioAsync.
+void nxlinkStdioAsyncExit(void);
@@ -0,0 +1,50 @@
+/**
+ * @file object_pool.h
+ * @brief Lock-free pool allocator for fixed-size objects, with optional per-thread magazines.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "../types.h"
+
+/// Approximate size of the slabs objects are carved from.
+#define OBJECT_POOL_SLAB_SIZE 0x4000
+
+/// Object pool.
+typedef struct {
+    u64 free_list;          ///< Tagged pointer to the first free object.
+    void* slabs;            ///< Slabs objects are carved from, freed on close.
+    void* magazines;        ///< Per-thread magazines, reused by new threads once their owner exits.
+    size_t obj_size;        ///< Object size, rounded up to 16 bytes.
+    u32 objs_per_slab;
+    u32 magazine_size;      ///< Maximum number of objects cached by each thread, 0 when magazines are disabled.
+    s32 tls_slot;           ///< TLS slot holding the magazine of the current thread.
+} ObjectPool;
+
+/**
+ * @brief Creates an object pool. Memory is only allocated once objects are.
+ * @param[out] p Object pool.
+ * @param[in] obj_size Size of the objects.
+ * @param[in] magazine_size Number of free objects each thread can keep for itself, avoiding atomic operations on the shared free list. 0 disables magazines, which otherwise use a TLS slot (see \ref threadTlsAlloc).
+ * @return Result code.
+ */
+Result objectPoolCreate(ObjectPool* p, size_t obj_size, u32 magazine_size);
+
+/**
+ * @brief Closes an object pool, freeing the memory of all of its objects.
+ * @param p Object pool, which must not be in use by any thread.
+ */
+void objectPoolClose(ObjectPool* p);
+
+/**
+ * @brief Allocates an object.
+ * @param p Object pool.
+ * @return Pointer to the object (aligned to 16 bytes), or NULL on failure.
+ */
+void* objectPoolAlloc(ObjectPool* p);
+
+/**
+ * @brief Frees an object, from any thread.
+ * @param p Object pool the object was allocated from.
+ * @param obj Object, or NULL.
+ */
+void objectPoolFree(ObjectPool* p, void* obj);
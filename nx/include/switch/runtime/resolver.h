@@ -1,5 +1,14 @@
 #pragma once
 #include "../types.h"
+#include "../kernel/mutex.h"
+#include "../kernel/condvar.h"
+#include "../kernel/thread.h"
+#include "../kernel/uevent.h"
+
+struct addrinfo;
+
+/// Maximum number of worker threads of a \ref ResolverAsync pool.
+#define RESOLVER_ASYNC_MAX_THREADS 8
 
 /// Fetches the last resolver Switch result code of the current thread.
 Result resolverGetLastResult(void);
@@ -10,15 +19,23 @@ u32 resolverGetCancelHandle(void);
 /// Retrieves whether service discovery is enabled for resolver commands on the current thread.
 bool resolverGetEnableServiceDiscovery(void);
 
-/// [5.0.0+] Retrieves whether the DNS cache is used to resolve queries on the current thread (not implemented).
+/// Retrieves whether the DNS cache is used to resolve queries on the current thread.
 bool resolverGetEnableDnsCache(void);
 
 /// Enables or disables service discovery for the current thread.
 void resolverSetEnableServiceDiscovery(bool enable);
 
-/// [5.0.0+] Enables or disables the usage of the DNS cache on the current thread (not implemented).
+/// Enables or disables the usage of the DNS cache on the current thread. This controls the local cache (see \ref resolverClearCache); the sfdnsres cache option is not implemented.
 void resolverSetEnableDnsCache(bool enable);
 
+/**
+ * @brief Clears the local resolver cache.
+ * @note getaddrinfo and gethostbyname results are cached in-process, so that repeated lookups skip the sfdnsres IPC.
+ *       Successful results live for __nx_resolver_cache_ttl_ms, and "not found" results for __nx_resolver_cache_negative_ttl_ms.
+ *       __nx_resolver_cache_entries sets the size of the cache (0 disables it).
+ */
+void resolverClearCache(void);
+
 /// Cancels a previous resolver command (handle obtained with \ref resolverGetCancelHandle prior to calling the command).
 Result resolverCancel(u32 handle);
 
@@ -27,3 +44,70 @@ Result resolverRemoveHostnameFromCache(const char* hostname);
 
 /// [5.0.0+] Removes an IP address from the DNS cache (not implemented).
 Result resolverRemoveIpAddressFromCache(u32 ip);
+
+/// Asynchronous getaddrinfo query, see \ref resolverAsyncStart.
+typedef struct {
+    const char* node;                           ///< [in] Host name, as for getaddrinfo.
+    const char* service;                        ///< [in] Service, as for getaddrinfo.
+    const struct addrinfo* hints;               ///< [in] Hints, as for getaddrinfo. Can be NULL. Must remain valid until the query completes.
+    struct addrinfo* result;                    ///< [out] Result list, to be released with freeaddrinfo.
+    int error;                                  ///< [out] getaddrinfo return value (0 on success).
+    int sys_errno;                              ///< [out] errno, when error is EAI_SYSTEM.
+    u32 cancel_handle;                          ///< Cancel handle of the query while it is running (internal).
+    u8 state;                                   ///< Internal state.
+} ResolverAsyncQuery;
+
+/// Worker pool resolving several host names concurrently.
+typedef struct {
+    Thread threads[RESOLVER_ASYNC_MAX_THREADS];
+    u32 num_threads;
+    Mutex mutex;
+    CondVar cond;
+    UEvent progress_event;                      ///< Signalled (auto-clear) each time a query completes.
+    UEvent done_event;                          ///< Signalled when all queries of the batch have completed.
+    ResolverAsyncQuery* queries;
+    u32 num_queries;
+    u32 next_query;
+    u32 num_done;
+    bool should_exit;
+} ResolverAsync;
+
+/**
+ * @brief Creates an asynchronous resolver pool. Each worker sends its requests on its own sfdnsres session.
+ * @param[out] r Pool.
+ * @param[in] num_threads Number of worker threads (at most \ref RESOLVER_ASYNC_MAX_THREADS).
+ * @param[in] prio Priority of the worker threads.
+ * @param[in] cpuid CPU core of the worker threads, -2 for the default core.
+ * @return Result code.
+ */
+Result resolverAsyncCreate(ResolverAsync* r, u32 num_threads, int prio, int cpuid);
+
+/// Cancels pending queries and destroys an asynchronous resolver pool.
+void resolverAsyncClose(ResolverAsync* r);
+
+/**
+ * @brief Starts resolving a batch of queries. The array must remain valid until the batch has completed.
+ * @param[in] r Pool.
+ * @param[in] queries Queries.
+ * @param[in] num_queries Number of queries.
+ * @return 0 on success, -1 with errno set to EBUSY if a batch is still running.
+ */
+int resolverAsyncStart(ResolverAsync* r, ResolverAsyncQuery* queries, u32 num_queries);
+
+/// Cancels the current batch: queries that have not started fail with EAI_SYSTEM/ECANCELED, running ones are cancelled through sfdnsres. The batch still completes normally.
+void resolverAsyncCancel(ResolverAsync* r);
+
+/// Returns whether the query has completed.
+bool resolverAsyncIsQueryDone(ResolverAsync* r, const ResolverAsyncQuery* q);
+
+/// Creates a \ref Waiter signalled each time a query of the current batch completes.
+static inline Waiter waiterForResolverAsyncProgress(ResolverAsync* r)
+{
+    return waiterForUEvent(&r->progress_event);
+}
+
+/// Creates a \ref Waiter signalled once all queries of the current batch have completed.
+static inline Waiter waiterForResolverAsync(ResolverAsync* r)
+{
+    return waiterForUEvent(&r->done_event);
+}
@@ -0,0 +1,106 @@
+/**
+ * @file trace.h
+ * @brief Scoped trace zones, recorded into per-thread ring buffers and exported in the Chrome trace event format (readable by chrome://tracing and Perfetto).
+ * @note The zone macros are only compiled in when NX_TRACE is defined, e.g. with -DNX_TRACE added to CFLAGS. Otherwise they cost nothing.
+ *       Build libnx with NX_TRACE too for the zones libnx emits itself (serviceDispatch, fsdev_read, hidScanInput, audrvUpdate and nwindowQueueBuffer).
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "../types.h"
+#include "../result.h"
+
+/// Number of events in each thread's ring buffer (power of two).
+#define TRACE_THREAD_BUFFER_EVENTS 4096
+
+/// Size of the staging buffer passed to the sink by the exporter.
+#define TRACE_EXPORT_BUFFER_SIZE 0x4000
+
+/// Trace event types.
+typedef enum {
+    TraceEventType_Begin   = 0, ///< Start of a zone.
+    TraceEventType_End     = 1, ///< End of the innermost zone.
+    TraceEventType_Instant = 2, ///< Instant event.
+} TraceEventType;
+
+/// Trace event.
+typedef struct {
+    u64 tick;            ///< System tick of the event.
+    const char* name;    ///< Name of the event, a string with static storage duration.
+    u32 type;            ///< \ref TraceEventType
+} TraceEvent;
+
+/// Per-thread ring buffer.
+typedef struct TraceBuffer TraceBuffer;
+
+struct TraceBuffer {
+    TraceBuffer* next;   ///< Next buffer.
+    u64 thread_id;       ///< ID of the owning thread.
+    u32 head;            ///< Write position, only advanced by the owning thread.
+    u32 tail;            ///< Read position, only advanced by the exporter.
+    u32 dropped;         ///< Number of events dropped because the buffer was full.
+    bool dead;           ///< Set once the owning thread has exited.
+    TraceEvent events[TRACE_THREAD_BUFFER_EVENTS];
+};
+
+/// Output function of the exporter, called from the exporter thread with a chunk of the JSON trace.
+typedef void (*TraceSinkFn)(void* userdata, const void* data, size_t size);
+
+/**
+ * @brief Records an event into the calling thread's ring buffer. Use the zone macros instead of calling this directly.
+ * @param[in] name Name of the event, a string with static storage duration (e.g. a literal).
+ * @param[in] type \ref TraceEventType
+ * @note This never blocks: events are dropped when the buffer is full. The buffer of a thread is allocated by its first event.
+ */
+void traceRecord(const char* name, TraceEventType type);
+
+/// Internal cleanup function of \ref traceScope.
+void _traceScopeEnd(u8* scope);
+
+#if defined(NX_TRACE)
+#define _TRACE_CONCAT2(a,b) a##b
+#define _TRACE_CONCAT(a,b) _TRACE_CONCAT2(a,b)
+
+/// Begins a zone.
+#define traceBegin(_name) traceRecord((_name), TraceEventType_Begin)
+/// Ends the innermost zone of the calling thread.
+#define traceEnd() traceRecord(NULL, TraceEventType_End)
+/// Records an instant event.
+#define traceInstant(_name) traceRecord((_name), TraceEventType_Instant)
+/// Begins a zone which ends when leaving the enclosing scope.
+#define traceScope(_name) \
+    __attribute__((cleanup(_traceScopeEnd), unused)) u8 _TRACE_CONCAT(_trace_scope_, __LINE__) = (traceBegin(_name), 0)
+#else
+#define traceBegin(_name) ((void)0)
+#define traceEnd() ((void)0)
+#define traceInstant(_name) ((void)0)
+#define traceScope(_name) do {} while (0)
+#endif
+
+/// Enables or disables recording at runtime. Recording is enabled by \ref traceExportStart.
+void traceSetEnabled(bool enabled);
+
+/// Returns whether recording is enabled.
+bool traceIsEnabled(void);
+
+/**
+ * @brief Enables recording and starts the exporter thread, which periodically drains the ring buffers into the sink.
+ * @param[in] sink Output function, e.g. \ref traceSinkSocket or \ref traceSinkUsbComms.
+ * @param[in] userdata User data passed to the sink.
+ * @param[in] prio Priority of the exporter thread.
+ * @param[in] cpuid Core of the exporter thread, or -2 for the default core.
+ * @return Result code.
+ * @note The sink receives a JSON array of trace events. It's only closed by \ref traceExportStop, which trace viewers don't require.
+ */
+Result traceExportStart(TraceSinkFn sink, void* userdata, int prio, int cpuid);
+
+/// Disables recording, exports everything recorded so far and stops the exporter thread.
+void traceExportStop(void);
+
+/// Returns the number of events dropped because a ring buffer was full.
+u64 traceGetDroppedCount(void);
+
+/// Sink sending the trace over a connected socket. userdata is the socket fd, cast with (void*)(intptr_t).
+void traceSinkSocket(void* userdata, const void* data, size_t size);
+
+/// Sink writing the trace with \ref usbCommsWrite. userdata is unused.
+void traceSinkUsbComms(void* userdata, const void* data, size_t size);
@@ -0,0 +1,43 @@
+/**
+ * @file acc_cache.h
+ * @brief Account profile cache: profile bases, user data and profile images are kept in memory, and only the users which were edited are loaded again.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "../types.h"
+#include "../result.h"
+#include "acc.h"
+
+/// Cached user.
+typedef struct {
+    AccountUid uid;             ///< \ref AccountUid
+    AccountProfileBase base;    ///< \ref AccountProfileBase
+    AccountUserData userdata;   ///< \ref AccountUserData
+    void* image;                ///< Profile image (JPEG), NULL if it couldn't be loaded. Valid until the next \ref accountCacheRefresh.
+    u32 image_size;             ///< Size of the profile image.
+    u32 image_capacity;
+} AccountCacheEntry;
+
+/// Account cache object.
+typedef struct {
+    AccountCacheEntry entries[ACC_USER_LIST_SIZE];  ///< Users, in the order of \ref accountListAllUsers.
+    s32 count;                  ///< Number of users.
+    u32 images_loaded;          ///< Number of profile images loaded by the refreshes, as opposed to kept.
+} AccountCache;
+
+/// Creates an empty cache. Use \ref accountCacheRefresh to fill it.
+void accountCacheCreate(AccountCache* c);
+
+/// Frees the profile images and closes the cache.
+void accountCacheClose(AccountCache* c);
+
+/**
+ * @brief Lists the users and refreshes the cache. acc must be initialized.
+ * The profile base of each user is read, and its profile image is only loaded again when the user is new or its lastEditTimestamp changed.
+ * @param[out] out_changed Whether any user was added, removed or edited. Optional, can be NULL.
+ * @return Result code. On failure, the cache keeps its previous contents.
+ */
+Result accountCacheRefresh(AccountCache* c, bool* out_changed);
+
+/// Finds a user in the cache, returns NULL if it's not there.
+const AccountCacheEntry* accountCacheFind(AccountCache* c, AccountUid uid);
@@ -46,6 +46,7 @@ typedef struct {
     int num_sinks;
     int num_mix_objs;
     int num_mix_buffers;
+    int num_perf_frames;    ///< Number of frames of performance metrics the renderer keeps between updates, 0 to disable them.
 } AudioRendererConfig;
 
 /*
@@ -276,6 +277,44 @@ typedef struct {
     u32 _padding1[3];
 } AudioRendererPerformanceBufferInfoOut;
 
+typedef enum {
+    AudioRendererPerformanceEntryType_Invalid,
+    AudioRendererPerformanceEntryType_Voice,
+    AudioRendererPerformanceEntryType_SubMix,
+    AudioRendererPerformanceEntryType_FinalMix,
+    AudioRendererPerformanceEntryType_Sink,
+} AudioRendererPerformanceEntryType;
+
+/// Header of a frame in the performance buffer, followed by its entries and then its details.
+typedef struct {
+    u32 magic;                   ///< "PERF"
+    u32 entry_count;
+    u32 detail_count;
+    u32 next_offset;             ///< Size of this frame (header, entries and details).
+    u32 total_processing_time;   ///< In microseconds.
+    u32 voice_drop_count;
+} AudioRendererPerformanceFrameHeader;
+
+typedef struct {
+    u32 node_id;
+    u32 start_time;              ///< In microseconds, from the start of the frame.
+    u32 processing_time;         ///< In microseconds.
+    AudioRendererPerformanceEntryType entry_type : 8;
+    u8 _padding1[3];
+} AudioRendererPerformanceEntry;
+
+/// Breakdown of the processing of the node set as detail target.
+typedef struct {
+    u32 node_id;
+    u32 start_time;
+    u32 processing_time;
+    u8 detail_type;
+    AudioRendererPerformanceEntryType entry_type : 8;
+    u8 _padding1[2];
+} AudioRendererPerformanceDetail;
+
+#define AUDREN_PERF_MAX_DETAILS 100
+
 static inline u32 audrenGetRevision(void)
 {
     extern u32 g_audrenRevision;
@@ -315,6 +354,22 @@ NX_CONSTEXPR size_t audrenGetOutputParamSize(const AudioRendererConfig* config)
     return size;
 }
 
+/// Size of a frame in the performance buffer.
+NX_CONSTEXPR size_t audrenGetPerformanceFrameSize(const AudioRendererConfig* config)
+{
+    size_t size = 0;
+    size += sizeof(AudioRendererPerformanceFrameHeader);
+    size += sizeof(AudioRendererPerformanceEntry) * (config->num_voices + config->num_effects + config->num_mix_objs + config->num_sinks);
+    size += sizeof(AudioRendererPerformanceDetail) * AUDREN_PERF_MAX_DETAILS;
+    return size;
+}
+
+/// Size of the performance buffer to pass to \ref audrenRequestUpdateAudioRenderer, to receive all the frames since the previous update.
+NX_CONSTEXPR size_t audrenGetPerformanceBufferSize(const AudioRendererConfig* config)
+{
+    return audrenGetPerformanceFrameSize(config) * config->num_perf_frames;
+}
+
 /// Initialize audren.
 Result audrenInitialize(const AudioRendererConfig* config);
 
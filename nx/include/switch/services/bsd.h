@@ -13,6 +13,15 @@
 #include "../types.h"
 #include "../kernel/tmem.h"
 #include "../sf/service.h"
+#include "../services/fs.h"
+
+/// Session slot statistics for a pool of bsd sessions, see \ref bsdGetSessionPoolStats.
+typedef struct {
+    u64 num_requests;           ///< Number of commands sent through the pool.
+    u64 num_waits;              ///< Number of commands that had to wait for a free session.
+    u64 total_wait_ns;          ///< Total time spent waiting for a free session, in nanoseconds.
+    u64 max_wait_ns;            ///< Longest wait for a free session, in nanoseconds.
+} BsdSessionPoolStats;
 
 /// Configuration structure for bsdInitalize
 typedef struct  {
@@ -44,6 +53,21 @@ void bsdExit(void);
 /// Gets the Service object for the actual BSD service session.
 Service* bsdGetServiceSession(void);
 
+/**
+ * @brief Retrieves slot statistics for the bsd session pools.
+ * @param[out] out_shared Statistics of the main pool, used by commands that do not block. Can be NULL.
+ * @param[out] out_blocking Statistics of the pool used by potentially blocking commands (accept, connect, recv, read, poll, select). Can be NULL.
+ * @note The blocking pool has __nx_bsd_num_blocking_sessions sessions, and is opt-in: by default that is 0, and all commands use the main pool. A blocking pool smaller than the main one limits the concurrency of the commands it serves, including ones on O_NONBLOCK sockets.
+ */
+void bsdGetSessionPoolStats(BsdSessionPoolStats* out_shared, BsdSessionPoolStats* out_blocking);
+/// Resets the statistics returned by \ref bsdGetSessionPoolStats.
+void bsdResetSessionPoolStats(void);
+
+/// Clones the bsd session into a new session that is not part of the pooled sessions, for calls that block for a long time.
+Result bsdCloneSession(Handle* out_session);
+/// Closes a session created by \ref bsdCloneSession.
+void bsdCloseSession(Handle session);
+
 /// Creates a socket.
 int bsdSocket(int domain, int type, int protocol);
 /// Like @ref bsdSocket but the newly created socket is immediately shut down.
@@ -51,6 +75,8 @@ int bsdSocketExempt(int domain, int type, int protocol);
 int bsdOpen(const char *pathname, int flags);
 int bsdSelect(int nfds, fd_set *readfds, fd_set *writefds, fd_set *exceptfds, struct timeval *timeout);
 int bsdPoll(struct pollfd *fds, nfds_t nfds, int timeout);
+/// Same as \ref bsdPoll, but sent on the specified session (see \ref bsdCloneSession) instead of a pooled one.
+int bsdPollOnSession(Handle session, struct pollfd *fds, nfds_t nfds, int timeout);
 int bsdSysctl(const int *name, unsigned int namelen, void *oldp, size_t *oldlenp, const void *newp, size_t newlen);
 ssize_t bsdRecv(int sockfd, void *buf, size_t len, int flags);
 ssize_t bsdRecvFrom(int sockfd, void *buf, size_t len, int flags, struct sockaddr *src_addr, socklen_t *addrlen);
@@ -76,4 +102,14 @@ int bsdClose(int fd);
 /// Duplicate a socket (bsd:s).
 int bsdDuplicateSocket(int sockfd);
 
-// TODO: Reverse-engineer GetResourceStatistics. Implement sendmmsg/recvmmsg (custom (un)serialization)
+/// Sends several messages. Datagrams are pipelined across the pooled sessions (the native SendMMsg serialization is not implemented). Control data is not supported.
+int bsdSendMMsg(int sockfd, struct mmsghdr *msgvec, unsigned int vlen, int flags);
+/// Receives several messages, sequentially so that datagram order is preserved. Control data is not supported.
+int bsdRecvMMsg(int sockfd, struct mmsghdr *msgvec, unsigned int vlen, int flags, struct timespec *timeout);
+
+/// Sends a large buffer in chunks sized to the socket send buffer, which is first grown towards tcp_tx_buf_max_size. Returns the number of bytes sent.
+ssize_t bsdSendLarge(int sockfd, const void *buf, size_t len, int flags);
+/// Sends up to count bytes of a file starting at offset, reading the next chunk while the previous one is being sent. Returns the number of bytes sent.
+ssize_t bsdSendFile(int sockfd, FsFile *file, s64 offset, size_t count, int flags);
+
+// TODO: Reverse-engineer GetResourceStatistics. Implement native sendmmsg/recvmmsg (custom (un)serialization)
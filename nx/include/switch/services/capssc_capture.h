@@ -0,0 +1,99 @@
+/**
+ * @file capssc_capture.h
+ * @brief Continuous raw screen capture with caps:sc: a thread captures into a ring of page-aligned buffers, optionally downscaled or converted, which consumers use in place.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "../types.h"
+#include "../result.h"
+#include "../kernel/mutex.h"
+#include "../kernel/condvar.h"
+#include "../kernel/thread.h"
+#include "capssc.h"
+
+#define CAPSSC_CAPTURE_MAX_BUFFERS 8                ///< Maximum number of buffers of a \ref CapsscCapture.
+#define CAPSSC_RAW_WIDTH 1280                       ///< Width of the raw captures.
+#define CAPSSC_RAW_HEIGHT 720                       ///< Height of the raw captures.
+#define CAPSSC_RAW_IMAGE_SIZE (CAPSSC_RAW_WIDTH*CAPSSC_RAW_HEIGHT*4)   ///< Size of a raw RGBA8 capture.
+
+/// Output format of a \ref CapsscCapture.
+typedef enum {
+    CapsscCaptureFormat_Rgba8  = 0,  ///< RGBA8, as captured.
+    CapsscCaptureFormat_Rgb565 = 1,  ///< RGB565, with red in the high bits.
+} CapsscCaptureFormat;
+
+/// Captured frame of a \ref CapsscCapture buffer.
+typedef struct {
+    u32 index;                  ///< Index of the buffer, owned by the consumer until \ref capsscCaptureRelease.
+    void* data;                 ///< Image, 0x1000-aligned: usable as-is for \ref usbCommsPostWriteAsync or socket sends.
+    u32 size;                   ///< Size of the image.
+    u32 width;                  ///< Image width.
+    u32 height;                 ///< Image height.
+    u32 stride;                 ///< Row size in bytes.
+    u64 frame_number;           ///< Number of the capture, counting the dropped ones.
+    u64 tick;                   ///< System tick when the capture completed.
+} CapsscCaptureFrame;
+
+/// Capture object.
+typedef struct {
+    CapsscCaptureFormat format;
+    u32 scale;
+    u64 timeout;
+    u8* pool;
+    u8* raw;                    ///< Raw capture buffer, when the output isn't the raw image.
+    u32 buffer_size;
+    u32 num_buffers;
+    CapsscCaptureFrame frames[CAPSSC_CAPTURE_MAX_BUFFERS];  ///< Captured data of each buffer.
+    u32 free_mask;              ///< Bitmask of the buffers available to the capture thread.
+    u32 ready[CAPSSC_CAPTURE_MAX_BUFFERS];  ///< Buffers captured and not acquired yet, oldest first.
+    u32 num_ready;
+    Mutex mutex;
+    CondVar cond;
+    Thread thread;
+    Result rc;                  ///< Failure of \ref capsscCaptureRawImageWithTimeout which stopped the capture thread.
+    bool should_exit;
+    u64 frame_counter;
+    u64 dropped;                ///< Number of captures which were replaced by a newer one before being acquired.
+    u64 stalls;                 ///< Number of times the capture thread waited for a buffer to be released.
+} CapsscCapture;
+
+/**
+ * @brief Creates a capture and starts its thread. caps:sc must be initialized.
+ * @param[out] c CapsscCapture object.
+ * @param[in] format \ref CapsscCaptureFormat
+ * @param[in] scale Downscale factor, 1 or 2 (2x2 box filter).
+ * @param[in] num_buffers Number of buffers, 2 to \ref CAPSSC_CAPTURE_MAX_BUFFERS.
+ * @param[in] timeout Timeout of each capture in nanoseconds, 100000000 can be used.
+ * @param[in] prio Priority of the capture thread.
+ * @param[in] cpuid Core of the capture thread, -2 for the default core.
+ * @return Result code.
+ * @note When the consumers fall behind, the oldest frame not acquired yet is replaced, so that the newest frames are mirrored.
+ * @note \ref capsscCaptureRawImageWithTimeout is stubbed on [5.0.0+].
+ */
+Result capsscCaptureCreate(CapsscCapture* c, CapsscCaptureFormat format, u32 scale, u32 num_buffers, u64 timeout, int prio, int cpuid);
+
+/// Stops the capture thread and frees the buffers. No buffer may be in use by the consumers anymore.
+void capsscCaptureClose(CapsscCapture* c);
+
+/**
+ * @brief Takes the oldest captured frame.
+ * @param[out] out Captured frame.
+ * @param[in] timeout Timeout in nanoseconds, UINT64_MAX to wait indefinitely.
+ * @return Result code. KERNELRESULT(TimedOut) when nothing was captured within the timeout, or the failure which stopped the capture thread.
+ */
+Result capsscCaptureAcquire(CapsscCapture* c, CapsscCaptureFrame* out, u64 timeout);
+
+/// Gives a buffer back to the capture thread, once the consumer is done with it. Buffers can be released in any order.
+void capsscCaptureRelease(CapsscCapture* c, u32 index);
+
+/// Returns the number of frames which were replaced before being acquired.
+static inline u64 capsscCaptureGetDroppedCount(CapsscCapture* c)
+{
+    return __atomic_load_n(&c->dropped, __ATOMIC_RELAXED);
+}
+
+/// Returns the number of times the capture thread had to wait for the consumers.
+static inline u64 capsscCaptureGetStallCount(CapsscCapture* c)
+{
+    return __atomic_load_n(&c->stalls, __ATOMIC_RELAXED);
+}
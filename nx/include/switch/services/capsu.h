@@ -123,6 +123,18 @@ Result capsuLoadAlbumScreenShotImage(s32 *width, s32 *height, CapsScreenShotAttr
  */
 Result capsuLoadAlbumScreenShotThumbnailImage(s32 *width, s32 *height, CapsScreenShotAttributeForApplication *attr, void* userdata, size_t userdata_maxsize, u32 *userdata_size, void* image, size_t image_size, void* workbuf, size_t workbuf_size, const CapsApplicationAlbumFileEntry *entry, const CapsScreenShotDecodeOption *option);
 
+/**
+ * @brief Opens an additional caps:u session, so that images can be loaded from several threads concurrently. Must be closed with \ref serviceClose.
+ * @param[out] srv_out Output Service.
+ */
+Result capsuOpenSession(Service* srv_out);
+
+/**
+ * @brief Same as \ref capsuLoadAlbumScreenShotThumbnailImage, using a session from \ref capsuOpenSession.
+ * @param[in] srv caps:u session.
+ */
+Result capsuLoadAlbumScreenShotThumbnailImageWithSession(Service* srv, s32 *width, s32 *height, CapsScreenShotAttributeForApplication *attr, void* userdata, size_t userdata_maxsize, u32 *userdata_size, void* image, size_t image_size, void* workbuf, size_t workbuf_size, const CapsApplicationAlbumFileEntry *entry, const CapsScreenShotDecodeOption *option);
+
 /**
  * @brief PrecheckToCreateContents. Official sw only uses this with ::CapsContentType_ExtraMovie.
  * @param[in] type \ref CapsContentType
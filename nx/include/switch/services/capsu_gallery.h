@@ -0,0 +1,104 @@
+/**
+ * @file capsu_gallery.h
+ * @brief Album gallery helper for caps:u: the file listing is kept in memory, and thumbnails are loaded in the background by a pool of workers.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "../types.h"
+#include "../result.h"
+#include "../kernel/mutex.h"
+#include "../kernel/condvar.h"
+#include "../kernel/thread.h"
+#include "capsu.h"
+
+#define CAPSU_GALLERY_MAX_WORKERS 4             ///< Maximum number of thumbnail workers.
+#define CAPSU_GALLERY_MAX_REQUESTS 64           ///< Maximum number of thumbnail requests not completed yet.
+#define CAPSU_THUMBNAIL_WIDTH 320               ///< Width of the thumbnails.
+#define CAPSU_THUMBNAIL_HEIGHT 180              ///< Height of the thumbnails.
+#define CAPSU_THUMBNAIL_IMAGE_SIZE (CAPSU_THUMBNAIL_WIDTH*CAPSU_THUMBNAIL_HEIGHT*4)   ///< Size of a RGBA8 thumbnail.
+#define CAPSU_GALLERY_WORKBUF_SIZE 0x80000      ///< Size of the work buffer of each worker, large enough for any screenshot JPEG.
+
+/// Thumbnail request, and its completion.
+typedef struct {
+    s32 index;                  ///< Index of the entry in the gallery.
+    void* image;                ///< RGBA8 output buffer of at least \ref CAPSU_THUMBNAIL_IMAGE_SIZE bytes.
+    u64 userdata;               ///< User data.
+    Result rc;                  ///< Result of the load, set on completion.
+    s32 width;                  ///< Image width, set on completion.
+    s32 height;                 ///< Image height, set on completion.
+} CapsuGalleryRequest;
+
+typedef struct CapsuGallery CapsuGallery;
+
+/// Thumbnail worker.
+typedef struct {
+    CapsuGallery* gallery;
+    Service* srv;
+    Service own_srv;            ///< Session of the worker, unless it uses the main caps:u session.
+    u8* workbuf;                ///< Work buffer, reused for all the thumbnails.
+    Thread thread;
+} CapsuGalleryWorker;
+
+/// Gallery object. Except for the requests and completions, it must only be used from one thread at a time.
+struct CapsuGallery {
+    CapsApplicationAlbumFileEntry* entries;    ///< Album files, contiguous.
+    s32 count;                                  ///< Number of album files.
+    CapsContentType type;
+
+    CapsuGalleryWorker workers[CAPSU_GALLERY_MAX_WORKERS];
+    u32 num_workers;
+    Mutex mutex;
+    CondVar cond;
+    CapsuGalleryRequest pending[CAPSU_GALLERY_MAX_REQUESTS];    ///< Requests not started yet, oldest first.
+    u32 num_pending;
+    CapsuGalleryRequest done[CAPSU_GALLERY_MAX_REQUESTS];       ///< Completions not fetched yet.
+    u32 num_done;
+    u32 num_active;             ///< Requests being loaded.
+    bool should_exit;
+};
+
+/**
+ * @brief Creates a gallery: lists the album files and starts the thumbnail workers. caps:u must be initialized.
+ * @param[out] g CapsuGallery object.
+ * @param[in] type \ref CapsContentType
+ * @param[in] num_workers Number of workers, 1 to \ref CAPSU_GALLERY_MAX_WORKERS. Each worker besides the first one uses its own caps:u session.
+ * @param[in] prio Priority of the workers, usually lower than the UI thread.
+ * @param[in] cpuid Core of the workers, -2 for the default core.
+ * @return Result code.
+ */
+Result capsuGalleryCreate(CapsuGallery* g, CapsContentType type, u32 num_workers, int prio, int cpuid);
+
+/// Closes a gallery. Requests not started yet are dropped.
+void capsuGalleryClose(CapsuGallery* g);
+
+/// Lists the album files again. Requests not started yet are dropped, since their indices may not be valid anymore.
+Result capsuGalleryRefresh(CapsuGallery* g);
+
+/**
+ * @brief Queues the loading of a thumbnail.
+ * @param[in] index Index of the entry.
+ * @param[out] image RGBA8 output buffer of at least \ref CAPSU_THUMBNAIL_IMAGE_SIZE bytes, which must stay valid until the completion is fetched.
+ * @param[in] userdata User data, returned with the completion.
+ * @return Result code. LibnxError_OutOfMemory when \ref CAPSU_GALLERY_MAX_REQUESTS requests are outstanding.
+ * @note The most recent requests are loaded first, which suits scrolling: use \ref capsuGalleryCancelPending for the entries which got out of view.
+ */
+Result capsuGalleryRequestThumbnail(CapsuGallery* g, s32 index, void* image, u64 userdata);
+
+/**
+ * @brief Drops the requests not started yet.
+ * @param[out] out Output dropped requests, so that their buffers can be reused. Optional, can be NULL.
+ * @param[in] max_out Maximum number of output requests.
+ * @return Number of requests dropped.
+ */
+u32 capsuGalleryCancelPending(CapsuGallery* g, CapsuGalleryRequest* out, u32 max_out);
+
+/**
+ * @brief Fetches completed requests, without waiting.
+ * @param[out] out Output completions.
+ * @param[in] max_out Maximum number of output completions.
+ * @return Number of completions.
+ */
+u32 capsuGalleryGetCompleted(CapsuGallery* g, CapsuGalleryRequest* out, u32 max_out);
+
+/// Waits until all the requests are completed.
+void capsuGalleryWaitIdle(CapsuGallery* g);
@@ -0,0 +1,104 @@
+/**
+ * @file clk_governor.h
+ * @brief CPU/GPU/EMC clock governor: raises the clocks during loading screens or heavy frames and drops them when idle, driven by hints and/or frame times.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "../types.h"
+#include "../result.h"
+#include "../kernel/mutex.h"
+#include "pcv.h"
+#include "clkrst.h"
+
+/// Clock domains handled by a \ref ClkGovernor.
+typedef enum {
+    ClkGovernorDomain_Cpu = 0,
+    ClkGovernorDomain_Gpu = 1,
+    ClkGovernorDomain_Emc = 2,
+    ClkGovernorDomain_Count,
+} ClkGovernorDomain;
+
+/// Clock levels, lowest first.
+typedef enum {
+    ClkGovernorLevel_Idle   = 0,  ///< Nothing much is going on: menus, paused game.
+    ClkGovernorLevel_Normal = 1,  ///< The clocks which were set when the governor was created.
+    ClkGovernorLevel_Boost  = 2,  ///< Loading screens and heavy phases.
+    ClkGovernorLevel_Count,
+} ClkGovernorLevel;
+
+/// Backend used to change the clocks.
+typedef enum {
+    ClkGovernorBackend_Clkrst = 0,  ///< clkrst sessions, [8.0.0+].
+    ClkGovernorBackend_Pcv    = 1,  ///< pcv, before [8.0.0].
+    ClkGovernorBackend_Apm    = 2,  ///< Neither service is accessible: only the CPU can be boosted, with \ref appletSetCpuBoostMode. Applications only.
+} ClkGovernorBackend;
+
+/// Configuration of a \ref ClkGovernor.
+typedef struct {
+    u32 rates[ClkGovernorLevel_Count][ClkGovernorDomain_Count];  ///< Clock rates in Hz. 0 for the Normal level, or for a domain of any level, uses the rate from when the governor was created.
+    u64 target_frame_ns;        ///< Frame time to sustain, for \ref clkGovernorFrame. 0 uses 1/60s.
+    u32 raise_frames;           ///< Number of consecutive frames slower than the target before raising the level.
+    u32 drop_frames;            ///< Number of consecutive frames well within the target before dropping the level. Larger than raise_frames, so that the level doesn't oscillate.
+    u32 drop_percent;           ///< A frame is well within the target when it takes less than this percentage of it.
+} ClkGovernorConfig;
+
+/// Governor object. It may be used from multiple threads.
+typedef struct {
+    ClkGovernorConfig config;
+    ClkGovernorBackend backend;
+    ClkrstSession sessions[ClkGovernorDomain_Count];
+    u32 saved_rates[ClkGovernorDomain_Count];    ///< Rates from when the governor was created, restored on close.
+    Mutex mutex;
+    ClkGovernorLevel level;     ///< Level currently applied.
+    ClkGovernorLevel hint;      ///< Level set with \ref clkGovernorSetHint.
+    ClkGovernorLevel frame_level;   ///< Level picked from the frame times.
+    u32 boosts;                 ///< Number of \ref clkGovernorBeginBoost not ended yet.
+    u32 slow_frames;
+    u32 fast_frames;
+    u64 last_frame_tick;
+    u32 level_changes;          ///< Number of times the clocks were changed.
+    bool initialized;
+} ClkGovernor;
+
+/// Fills a \ref ClkGovernorConfig with the defaults: boost to the maximum TX1 CPU rate, docked GPU rate and 1600MHz EMC, idle at the handheld GPU rate.
+void clkGovernorConfigDefault(ClkGovernorConfig* config);
+
+/**
+ * @brief Creates a governor: opens the clkrst sessions on [8.0.0+], pcv otherwise, and reads the current rates.
+ * @param[out] g ClkGovernor object.
+ * @param[in] config Configuration, NULL for \ref clkGovernorConfigDefault.
+ * @return Result code.
+ * @note Access to clkrst/pcv depends on the permissions of the process. When neither can be initialized, the apm backend is used.
+ */
+Result clkGovernorCreate(ClkGovernor* g, const ClkGovernorConfig* config);
+
+/// Restores the rates from when the governor was created, and closes it.
+void clkGovernorClose(ClkGovernor* g);
+
+/// Sets the hinted level, \ref ClkGovernorLevel_Normal by default. The applied level is the highest of the hint, the boosts and the frame times: set \ref ClkGovernorLevel_Idle to let fast frames drop the clocks.
+Result clkGovernorSetHint(ClkGovernor* g, ClkGovernorLevel level);
+
+/// Boosts the clocks until the matching \ref clkGovernorEndBoost, e.g. around a loading screen. Calls may be nested.
+Result clkGovernorBeginBoost(ClkGovernor* g);
+
+/// Ends a \ref clkGovernorBeginBoost.
+Result clkGovernorEndBoost(ClkGovernor* g);
+
+/**
+ * @brief Feeds a frame time to the governor. Call this once per frame.
+ * @param[in] frame_ns Time taken by the frame in nanoseconds, ideally the CPU/GPU work without the vsync wait. 0 uses the time since the previous call.
+ * @return Result code.
+ */
+Result clkGovernorFrame(ClkGovernor* g, u64 frame_ns);
+
+/// Gets the level currently applied.
+static inline ClkGovernorLevel clkGovernorGetLevel(ClkGovernor* g)
+{
+    return __atomic_load_n(&g->level, __ATOMIC_RELAXED);
+}
+
+/// Gets the backend used by the governor.
+static inline ClkGovernorBackend clkGovernorGetBackend(ClkGovernor* g)
+{
+    return g->backend;
+}
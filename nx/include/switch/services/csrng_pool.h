@@ -0,0 +1,24 @@
+/**
+ * @file csrng_pool.h
+ * @brief Buffered random pool over csrng/spl: each thread expands csrng seeds with ChaCha20, so that small requests (such as nonces) don't do IPC.
+ * @note Threads reseed after __nx_csrng_pool_reseed_bytes bytes or __nx_csrng_pool_reseed_ns nanoseconds. Seeds are fetched from the service in batches shared by all the threads.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "../types.h"
+#include "../result.h"
+
+/**
+ * @brief Fills a buffer with random data from the pool of the calling thread.
+ * @param[out] buf Output buffer.
+ * @param[in] len Size of the buffer.
+ * @return Result code. Seeds come from csrng when it's initialized, spl otherwise: LibnxError_NotInitialized if neither is.
+ * @note Seeding failures are only reported when the thread has no seed yet. Otherwise the pool keeps going from its current state, and retries on the next request.
+ */
+Result csrngPoolGet(void* buf, size_t len);
+
+/// Returns a random 64-bit value from the pool of the calling thread, 0 on failure.
+u64 csrngPoolGet64(void);
+
+/// Forces the calling thread to reseed on its next request, e.g. after resuming from sleep.
+void csrngPoolReseed(void);
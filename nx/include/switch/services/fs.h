@@ -12,6 +12,8 @@
 #include "../services/ncm_types.h"
 #include "../services/acc.h"
 #include "../sf/service.h"
+#include "../sf/sessionmgr.h"
+#include "../sf/async_dispatch.h"
 
 // We use wrapped handles for type safety.
 
@@ -297,6 +299,9 @@ void fsExit(void);
 /// Gets the Service object for the actual fsp-srv service session.
 Service* fsGetServiceSession(void);
 
+/// Gets the session manager used to distribute requests on child objects over multiple fsp-srv sessions (for use with \ref sfbatchCreate).
+SessionMgr* fsGetSessionMgr(void);
+
 /// [5.0.0+] Configures the \ref FsPriority of all filesystem commands issued within the current thread.
 void fsSetPriority(FsPriority prio);
 
@@ -391,6 +396,8 @@ Result fsFsIsValidSignedSystemPartitionOnSdCard(FsFileSystem* fs, bool *out);
 // IFile
 Result fsFileRead(FsFile* f, s64 off, void* buf, u64 read_size, u32 option, u64* bytes_read);
 Result fsFileWrite(FsFile* f, s64 off, const void* buf, u64 write_size, u32 option);
+Result fsFileReadAsync(FsFile* f, SfAsyncRequest* r, s64 off, void* buf, u64 read_size, u32 option, u64* bytes_read); ///< Asynchronous \ref fsFileRead, finish with \ref sfasyncEnd. buf and bytes_read must remain valid until then.
+Result fsFileWriteAsync(FsFile* f, SfAsyncRequest* r, s64 off, const void* buf, u64 write_size, u32 option); ///< Asynchronous \ref fsFileWrite, finish with \ref sfasyncEnd. buf must remain valid until then.
 Result fsFileFlush(FsFile* f);
 Result fsFileSetSize(FsFile* f, s64 sz);
 Result fsFileGetSize(FsFile* f, s64* out);
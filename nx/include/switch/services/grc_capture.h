@@ -0,0 +1,77 @@
+/**
+ * @file grc_capture.h
+ * @brief grc:d capture pipeline: a thread per \ref GrcStream transfers into a ring of page-aligned buffers, which consumers use in place.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "../types.h"
+#include "../result.h"
+#include "../kernel/mutex.h"
+#include "../kernel/condvar.h"
+#include "../kernel/thread.h"
+#include "grc.h"
+
+/// Maximum number of buffers of a \ref GrcdCapture.
+#define GRCD_CAPTURE_MAX_BUFFERS 32
+
+/// Captured data of a \ref GrcdCapture buffer.
+typedef struct {
+    u32 index;                  ///< Index of the buffer, owned by the consumer until \ref grcdCaptureRelease.
+    void* data;                 ///< Data, 0x1000-aligned: usable as-is for \ref usbCommsPostWriteAsync or socket sends.
+    u32 size;                   ///< Size of the data.
+    u32 num_frames;             ///< Number of frames, from \ref grcdTransfer.
+    u64 start_timestamp;        ///< Start timestamp, from \ref grcdTransfer.
+} GrcdCaptureFrame;
+
+/// Capture object for a \ref GrcStream.
+typedef struct {
+    GrcStream stream;
+    u8* pool;
+    u32 buffer_size;
+    u32 num_buffers;
+    GrcdCaptureFrame frames[GRCD_CAPTURE_MAX_BUFFERS];  ///< Captured data of each buffer.
+    u32 free_mask;              ///< Bitmask of the buffers available to the capture thread.
+    u32 ready[GRCD_CAPTURE_MAX_BUFFERS];    ///< Buffers captured and not acquired yet, oldest first.
+    u32 num_ready;
+    Mutex mutex;
+    CondVar cond;
+    Thread thread;
+    Result rc;                  ///< Failure of \ref grcdTransfer which stopped the capture thread.
+    bool should_exit;
+    u64 stalls;                 ///< Number of times the capture thread waited for a buffer to be released.
+} GrcdCapture;
+
+/**
+ * @brief Creates a capture and starts its thread. grc:d must be initialized, and \ref grcdBegin called.
+ * @param[out] c GrcdCapture object.
+ * @param[in] stream \ref GrcStream. Use one capture per stream.
+ * @param[in] buffer_size Size of each buffer, rounded up to 0x1000-bytes. Official sw uses 0x32000 for video and 0x1000 for audio.
+ * @param[in] num_buffers Number of buffers, 2 to \ref GRCD_CAPTURE_MAX_BUFFERS. This is how much data can be held by the consumers at once.
+ * @param[in] prio Priority of the capture thread, usually higher than the consumers.
+ * @param[in] cpuid Core of the capture thread, -2 for the default core.
+ * @return Result code.
+ */
+Result grcdCaptureCreate(GrcdCapture* c, GrcStream stream, u32 buffer_size, u32 num_buffers, int prio, int cpuid);
+
+/**
+ * @brief Stops the capture thread and frees the buffers.
+ * @note Since \ref grcdTransfer blocks until data is available, this waits for the next data of the stream. No buffer may be in use by the consumers anymore.
+ */
+void grcdCaptureClose(GrcdCapture* c);
+
+/**
+ * @brief Takes the oldest captured buffer.
+ * @param[out] out Captured data.
+ * @param[in] timeout Timeout in nanoseconds, UINT64_MAX to wait indefinitely.
+ * @return Result code. KERNELRESULT(TimedOut) when nothing was captured within the timeout, or the failure which stopped the capture thread.
+ */
+Result grcdCaptureAcquire(GrcdCapture* c, GrcdCaptureFrame* out, u64 timeout);
+
+/// Gives a buffer back to the capture thread, once the consumer is done with it (e.g. once its async transfer completed). Buffers can be released in any order.
+void grcdCaptureRelease(GrcdCapture* c, u32 index);
+
+/// Returns the number of times the capture thread had to wait for the consumers.
+static inline u64 grcdCaptureGetStallCount(GrcdCapture* c)
+{
+    return __atomic_load_n(&c->stalls, __ATOMIC_RELAXED);
+}
@@ -422,6 +422,40 @@ typedef struct SixAxisSensorValues {
     HidVector orientation[3];
 } SixAxisSensorValues;
 
+/// Per-controller part of \ref HidInputSnapshot.
+typedef struct HidControllerSnapshot {
+    u64 keysHeld;                                   ///< Same as \ref hidKeysHeld.
+    u64 keysDown;                                   ///< Same as \ref hidKeysDown.
+    u64 keysUp;                                     ///< Same as \ref hidKeysUp.
+    JoystickPosition joysticks[JOYSTICK_NUM_STICKS];
+    u32 type;                                       ///< \ref HidControllerType, same as \ref hidGetControllerType.
+    bool connected;                                 ///< Same as \ref hidIsControllerConnected.
+    bool sixaxisValid;                              ///< Whether sixaxis is set, which requires \ref hidStartSixAxisSensor.
+    SixAxisSensorValues sixaxis;                    ///< Latest sixaxis values, see \ref hidSixAxisSensorValuesRead for the previous ones.
+} HidControllerSnapshot;
+
+/// Input state as of the last \ref hidScanInput, see \ref hidGetInputSnapshot.
+typedef struct HidInputSnapshot {
+    u32 sequence;                                   ///< Changes with each \ref hidScanInput, to tell whether the snapshot is a new one.
+    HidControllerID p1AutoID;                       ///< Controller which CONTROLLER_P1_AUTO uses, index in controllers.
+    HidControllerSnapshot controllers[10];          ///< Indexed by \ref HidControllerID.
+
+    u32 touchCount;                                 ///< Same as \ref hidTouchCount, number of valid entries in touches.
+    touchPosition touches[16];
+
+    u64 mouseHeld;
+    u64 mouseDown;
+    u64 mouseUp;
+    MousePosition mouse;                            ///< Same as \ref hidMouseRead.
+
+    u64 keyboardModHeld;                            ///< Bitmask of \ref HidKeyboardModifier.
+    u64 keyboardModDown;
+    u64 keyboardModUp;
+    u32 keyboardHeld[8];                            ///< Bit (key % 32) of word (key / 32) is set for each \ref HidKeyboardScancode.
+    u32 keyboardDown[8];
+    u32 keyboardUp[8];
+} HidInputSnapshot;
+
 #define JOYSTICK_MAX (0x8000)
 #define JOYSTICK_MIN (-0x8000)
 
@@ -713,6 +747,9 @@ Result hidInitialize(void);
 /// Exit hid. Called automatically during app exit.
 void hidExit(void);
 
+/// Defers \ref hidInitialize to the first call to \ref hidScanInput, \ref hidGetSharedmemAddr or \ref hidGetServiceSession, unless it's already initialized. Used automatically during app startup when __nx_appinit_lazy is set.
+void hidInitializeLazy(void);
+
 void hidReset(void);
 
 /// Gets the Service object for the actual hid service session.
@@ -763,6 +800,13 @@ void hidTouchRead(touchPosition *pos, u32 point_id);
 void hidJoystickRead(JoystickPosition *pos, HidControllerID id, HidControllerJoystick stick);
 u32 hidSixAxisSensorValuesRead(SixAxisSensorValues *values, HidControllerID id, u32 num_entries);
 
+/**
+ * @brief Gets all the input state of the last \ref hidScanInput at once.
+ * @param[out] out Snapshot, consistent even when \ref hidScanInput runs concurrently on another thread.
+ * @note This is cheaper than the individual getters once more than a few values are needed, and the result can then be used without any further synchronization.
+ */
+void hidGetInputSnapshot(HidInputSnapshot *out);
+
 /// This can be used to check what CONTROLLER_P1_AUTO uses.
 /// Returns 0 when CONTROLLER_PLAYER_1 is connected, otherwise returns 1 for handheld-mode.
 bool hidGetHandheldMode(void);
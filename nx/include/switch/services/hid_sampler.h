@@ -0,0 +1,105 @@
+/**
+ * @file hid_sampler.h
+ * @brief Background thread streaming every sixaxis, touch and mouse sample from the HID shared memory, independently of \ref hidScanInput.
+ * @note The shared memory only keeps the last 17 samples of each source, which \ref hidSixAxisSensorValuesRead and \ref hidMouseMultiRead lose when scanning is slower than that.
+ *       The sampler thread polls much more often than that, and pushes the new samples to a queue per source.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "../types.h"
+#include "../result.h"
+#include "../kernel/thread.h"
+#include "../kernel/queue.h"
+#include "hid.h"
+
+/// Sources of a \ref HidSampler. The sixaxis sources are the \ref HidControllerID (CONTROLLER_PLAYER_1 to CONTROLLER_UNKNOWN).
+typedef enum {
+    HidSamplerSource_Touch = 10,    ///< Touch screen.
+    HidSamplerSource_Mouse = 11,    ///< Mouse.
+    HidSamplerSource_Count = 12,
+} HidSamplerSource;
+
+/// Sixaxis sample.
+typedef struct {
+    u64 sampling_number;            ///< Incremented by one for each sample.
+    SixAxisSensorValues values;
+} HidSamplerSixAxisEntry;
+
+/// Touch screen sample.
+typedef struct {
+    u64 sampling_number;            ///< Incremented by one for each sample.
+    u32 count;                      ///< Number of valid entries in touches.
+    touchPosition touches[16];
+} HidSamplerTouchEntry;
+
+/// Mouse sample.
+typedef struct {
+    u64 sampling_number;            ///< Incremented by one for each sample.
+    u64 buttons;                    ///< Bitmask of \ref HidMouseButton.
+    MousePosition position;
+} HidSamplerMouseEntry;
+
+/// Configuration of a \ref HidSampler.
+typedef struct {
+    u32 sixaxis_mask;               ///< Bitmask of the controllers to sample the sixaxis of (BIT(HidControllerID)). \ref hidStartSixAxisSensor must be used for them too.
+    bool touch;                     ///< Whether to sample the touch screen.
+    bool mouse;                     ///< Whether to sample the mouse.
+    u32 capacity;                   ///< Number of samples each queue holds, a power of two. 0 for the default (256).
+    u64 period_ns;                  ///< Polling period. 0 for the default (4ms, which is well below the time the shared memory keeps the samples for).
+    int prio;                       ///< Priority of the sampler thread, 0x00~0x3F.
+    int cpuid;                      ///< CPU core of the sampler thread, -2 for the default one.
+} HidSamplerConfig;
+
+/// Sampler object.
+typedef struct {
+    Thread thread;
+    u64 period_ns;
+    u32 sixaxis_mask;
+    bool touch;
+    bool mouse;
+    bool exit;
+
+    SpscQueue queues[HidSamplerSource_Count];
+    u64 last_sampling_number[HidSamplerSource_Count];
+    s8 sixaxis_layout[10];          ///< Sixaxis layout the samples come from, the sampling numbers restart when it changes.
+    u32 dropped[HidSamplerSource_Count];
+} HidSampler;
+
+/**
+ * @brief Creates a sampler, and starts its thread.
+ * @param[out] s HidSampler object.
+ * @param[in] config Configuration.
+ * @return Result code.
+ * @note Only samples taken after this are streamed.
+ */
+Result hidSamplerCreate(HidSampler* s, const HidSamplerConfig* config);
+
+/// Stops the thread of a sampler, and frees its queues.
+void hidSamplerClose(HidSampler* s);
+
+/**
+ * @brief Pops the queued sixaxis samples of a controller, oldest first.
+ * @param[in] id Controller, which must be in the sixaxis_mask. CONTROLLER_P1_AUTO isn't supported.
+ * @param[out] out Output samples.
+ * @param[in] max_entries Maximum number of samples to pop.
+ * @return Number of samples popped.
+ */
+u32 hidSamplerReadSixAxis(HidSampler* s, HidControllerID id, HidSamplerSixAxisEntry* out, u32 max_entries);
+
+/// Same as \ref hidSamplerReadSixAxis, for the touch screen.
+u32 hidSamplerReadTouch(HidSampler* s, HidSamplerTouchEntry* out, u32 max_entries);
+
+/// Same as \ref hidSamplerReadSixAxis, for the mouse.
+u32 hidSamplerReadMouse(HidSampler* s, HidSamplerMouseEntry* out, u32 max_entries);
+
+/// Returns the number of samples of a source (a \ref HidControllerID or \ref HidSamplerSource) lost so far, either because its queue was full or because the sampler thread couldn't keep up.
+static inline u32 hidSamplerGetDroppedCount(HidSampler* s, u32 source)
+{
+    return source < HidSamplerSource_Count ? __atomic_load_n(&s->dropped[source], __ATOMIC_RELAXED) : 0;
+}
+
+/// Creates a \ref Waiter signalled when samples of a source (a \ref HidControllerID or \ref HidSamplerSource) can be popped. Pop them until the read function returns 0 before waiting again.
+static inline Waiter waiterForHidSampler(HidSampler* s, u32 source)
+{
+    return waiterForSpscQueueNotEmpty(&s->queues[source]);
+}
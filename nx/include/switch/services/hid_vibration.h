@@ -0,0 +1,74 @@
+/**
+ * @file hid_vibration.h
+ * @brief Vibration scheduler: plays timed vibration patterns from a background thread, mixing the overlapping ones of each device.
+ * @note Each tick, the values of all the devices which changed are sent with a single \ref hidSendVibrationValues, instead of one command per effect and device.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "../types.h"
+#include "../result.h"
+#include "../kernel/thread.h"
+#include "../kernel/mutex.h"
+#include "hid.h"
+
+#define HID_VIBRATION_MAX_DEVICES 16    ///< Maximum number of devices of a \ref HidVibrationScheduler.
+#define HID_VIBRATION_MAX_EFFECTS 16    ///< Maximum number of effects playing at once on a \ref HidVibrationScheduler.
+
+/// Effect playing on a \ref HidVibrationScheduler.
+typedef struct {
+    const HidVibrationValue* values;    ///< One value per tick, NULL if the slot is free.
+    u32 num_values;
+    u32 device_mask;                    ///< Bitmask of the device indices the effect plays on.
+    u64 start_tick;
+    float gain;
+    bool loop;
+    u16 generation;
+} HidVibrationEffect;
+
+/// Vibration scheduler object.
+typedef struct {
+    Thread thread;
+    Mutex mutex;
+    u64 period_ns;
+    u64 tick;                                               ///< Number of ticks processed so far.
+    bool exit;
+
+    u32 num_devices;
+    u32 handles[HID_VIBRATION_MAX_DEVICES];
+    HidVibrationValue current[HID_VIBRATION_MAX_DEVICES];   ///< Values last sent to each device.
+    HidVibrationEffect effects[HID_VIBRATION_MAX_EFFECTS];
+} HidVibrationScheduler;
+
+/**
+ * @brief Creates a vibration scheduler, and starts its thread.
+ * @param[out] s HidVibrationScheduler object.
+ * @param[in] handles VibrationDeviceHandles, from \ref hidInitializeVibrationDevices. Their index is used in the device masks.
+ * @param[in] num_devices Number of handles, at most \ref HID_VIBRATION_MAX_DEVICES.
+ * @param[in] period_ns Tick period, which is the duration of each value of the patterns. 0 for the default (5ms).
+ * @param[in] prio Priority of the scheduler thread, 0x00~0x3F.
+ * @param[in] cpuid CPU core of the scheduler thread, -2 for the default one.
+ * @return Result code.
+ */
+Result hidVibrationSchedulerCreate(HidVibrationScheduler* s, const u32* handles, u32 num_devices, u64 period_ns, int prio, int cpuid);
+
+/// Stops the scheduler thread, after stopping the vibration of all the devices.
+void hidVibrationSchedulerClose(HidVibrationScheduler* s);
+
+/**
+ * @brief Starts playing a pattern, from the next tick on.
+ * @param[in] device_mask Bitmask of the device indices to play on.
+ * @param[in] values Pattern, one value per tick. It must stay valid until the effect finished, or was stopped.
+ * @param[in] num_values Number of values.
+ * @param[in] gain Factor applied to the amplitudes.
+ * @param[in] loop Whether to repeat the pattern until the effect is stopped.
+ * @param[out] out_id Output effect ID, for \ref hidVibrationSchedulerStop. Optional.
+ * @return Result code. LibnxError_OutOfMemory if \ref HID_VIBRATION_MAX_EFFECTS effects are already playing.
+ * @note Overlapping effects are mixed: amplitudes are added (up to 1.0f), and frequencies are averaged, weighted by amplitude.
+ */
+Result hidVibrationSchedulerPlay(HidVibrationScheduler* s, u32 device_mask, const HidVibrationValue* values, u32 num_values, float gain, bool loop, u32* out_id);
+
+/// Stops an effect. Does nothing if it already finished.
+void hidVibrationSchedulerStop(HidVibrationScheduler* s, u32 id);
+
+/// Stops all the effects.
+void hidVibrationSchedulerStopAll(HidVibrationScheduler* s);
@@ -0,0 +1,68 @@
+/**
+ * @file hid_watcher.h
+ * @brief Input-changed notification, so that idle apps can sleep in \ref waitObjects until there's input instead of calling \ref hidScanInput every frame.
+ * @note A background thread waits on the npad style set update events (controllers being connected, disconnected or changing type),
+ *       and checks the latest shared memory entries (buttons, sticks, touches, keyboard, mouse) for changes at a low rate in the meantime.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "../types.h"
+#include "../result.h"
+#include "../kernel/thread.h"
+#include "../kernel/event.h"
+#include "../kernel/uevent.h"
+#include "hid.h"
+
+/// Input state compared by a \ref HidInputWatcher.
+typedef struct {
+    u64 buttons[10];
+    JoystickPosition joysticks[10][JOYSTICK_NUM_STICKS];
+    u64 connection_state[10];
+    u64 touch_count;
+    u32 touch_pos[16][2];
+    u64 keyboard_modifier;
+    u32 keyboard_keys[8];
+    u64 mouse_buttons;
+    MousePosition mouse_pos;
+} HidInputWatcherState;
+
+/// Input watcher object.
+typedef struct {
+    Thread thread;
+    UEvent event;                                   ///< Signalled when the input changed.
+    Event style_events[9];                          ///< Npad style set update events of CONTROLLER_PLAYER_1 to CONTROLLER_HANDHELD.
+    u64 period_ns;
+    s32 stick_threshold;
+    bool exit;
+    HidInputWatcherState state;
+} HidInputWatcher;
+
+/**
+ * @brief Creates an input watcher, and starts its thread.
+ * @param[out] w HidInputWatcher object.
+ * @param[in] period_ns Interval at which the shared memory is checked. 0 for the default (16ms).
+ * @param[in] stick_threshold Minimum change of a stick axis to be reported, so that stick noise doesn't wake the app up. 0 for the default (0x800).
+ * @param[in] prio Priority of the watcher thread, 0x00~0x3F.
+ * @param[in] cpuid CPU core of the watcher thread, -2 for the default one.
+ * @return Result code.
+ */
+Result hidInputWatcherCreate(HidInputWatcher* w, u64 period_ns, s32 stick_threshold, int prio, int cpuid);
+
+/// Stops the thread of an input watcher, and closes its events.
+void hidInputWatcherClose(HidInputWatcher* w);
+
+/// Creates a \ref Waiter signalled (and cleared by the wait) when the input changed since the previous time it was. \ref hidScanInput should then be called.
+static inline Waiter waiterForHidInputWatcher(HidInputWatcher* w)
+{
+    return waiterForUEvent(&w->event);
+}
+
+/**
+ * @brief Waits for the input to change.
+ * @param[in] timeout Timeout in nanoseconds, UINT64_MAX to wait indefinitely.
+ * @return Result code. KERNELRESULT(TimedOut) on timeout.
+ */
+static inline Result hidInputWatcherWait(HidInputWatcher* w, u64 timeout)
+{
+    return waitSingle(waiterForHidInputWatcher(w), timeout);
+}
@@ -0,0 +1,81 @@
+/**
+ * @file hiddbg_injector.h
+ * @brief Batched and scheduled state injection for hiddbg virtual controllers: the states of all the devices are applied with one \ref hiddbgApplyHdlsStateList, at system tick deadlines.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "../types.h"
+#include "../result.h"
+#include "../kernel/mutex.h"
+#include "../kernel/condvar.h"
+#include "../kernel/thread.h"
+#include "hiddbg.h"
+
+/// Maximum number of devices of a \ref HiddbgHdlsInjector.
+#define HIDDBG_INJECTOR_MAX_DEVICES 8
+
+/// States of all the devices of a \ref HiddbgHdlsInjector, applied at a deadline.
+typedef struct {
+    u64 tick;                                           ///< System tick (\ref armGetSystemTick) to apply the states at.
+    HiddbgHdlsState states[HIDDBG_INJECTOR_MAX_DEVICES];  ///< States, in the order of the handles passed to \ref hiddbgHdlsInjectorCreate.
+} HiddbgHdlsInjectorFrame;
+
+/// Injector object.
+typedef struct {
+    u32 num_devices;
+    u64 handles[HIDDBG_INJECTOR_MAX_DEVICES];
+    HiddbgHdlsDeviceInfo devices[HIDDBG_INJECTOR_MAX_DEVICES];  ///< Device info of the handles, from \ref hiddbgDumpHdlsStates.
+    HiddbgHdlsInjectorFrame* queue;                     ///< Ring of scheduled frames.
+    u32 queue_size;
+    u32 head;
+    u32 count;
+    u64 last_tick;                                      ///< Deadline of the last scheduled frame.
+    Mutex mutex;
+    CondVar cond;
+    Thread thread;
+    Result rc;                                          ///< Failure of \ref hiddbgApplyHdlsStateList which stopped the injector thread.
+    bool should_exit;
+    u64 applied;                                        ///< Number of scheduled frames applied.
+    u64 late;                                           ///< Number of scheduled frames applied more than 1ms after their deadline.
+} HiddbgHdlsInjector;
+
+/**
+ * @brief Creates an injector for attached virtual devices and starts its thread. \ref hiddbgAttachHdlsWorkBuffer must have been used.
+ * @param[out] inj HiddbgHdlsInjector object.
+ * @param[in] handles HdlsHandles from \ref hiddbgAttachHdlsVirtualDevice.
+ * @param[in] num_devices Number of devices, 1 to \ref HIDDBG_INJECTOR_MAX_DEVICES.
+ * @param[in] queue_size Maximum number of frames scheduled ahead, at least 1.
+ * @param[in] prio Priority of the injector thread, a high priority (e.g. 0x20) keeps deadlines accurate.
+ * @param[in] cpuid Core of the injector thread, -2 for the default core.
+ * @return Result code. LibnxError_NotFound if a handle isn't attached.
+ * @note The Hdls work buffer is shared by the Hdls state commands, these must not be used from other threads while the injector is running.
+ */
+Result hiddbgHdlsInjectorCreate(HiddbgHdlsInjector* inj, const u64* handles, u32 num_devices, u32 queue_size, int prio, int cpuid);
+
+/// Stops the injector thread, dropping the frames not applied yet.
+void hiddbgHdlsInjectorClose(HiddbgHdlsInjector* inj);
+
+/**
+ * @brief Applies the states of all the devices now, with one IPC.
+ * @param[in] states States, in the order of the handles passed to \ref hiddbgHdlsInjectorCreate.
+ * @return Result code.
+ */
+Result hiddbgHdlsInjectorApply(HiddbgHdlsInjector* inj, const HiddbgHdlsState* states);
+
+/**
+ * @brief Schedules the states of all the devices, for the injector thread to apply at frame->tick.
+ * @param[in] frame \ref HiddbgHdlsInjectorFrame. Deadlines must not decrease, frames whose deadline already passed are applied right away.
+ * @param[in] timeout Timeout in nanoseconds to wait for room in the queue, UINT64_MAX to wait indefinitely.
+ * @return Result code. KERNELRESULT(TimedOut) when the queue stayed full, or the failure which stopped the injector thread.
+ * @note For 60Hz input, frames can be scheduled at armNsToTicks(1000000000/60) intervals from a base tick.
+ */
+Result hiddbgHdlsInjectorSchedule(HiddbgHdlsInjector* inj, const HiddbgHdlsInjectorFrame* frame, u64 timeout);
+
+/// Drops the scheduled frames not applied yet.
+void hiddbgHdlsInjectorClear(HiddbgHdlsInjector* inj);
+
+/// Returns the number of scheduled frames applied more than 1ms after their deadline.
+static inline u64 hiddbgHdlsInjectorGetLateCount(HiddbgHdlsInjector* inj)
+{
+    return __atomic_load_n(&inj->late, __ATOMIC_RELAXED);
+}
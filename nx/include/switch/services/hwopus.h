@@ -14,6 +14,8 @@ typedef struct {
     Service s;
     TransferMemory tmem;
     bool multistream;
+    s32 sample_rate;
+    s32 channel_count;
 } HwopusDecoder;
 
 /// This structure is the start of opusin for \ref hwopusDecodeInterleaved, with the actual opus packet following this.
@@ -42,3 +44,11 @@ Result hwopusDecoderMultistreamInitialize(HwopusDecoder* decoder, s32 SampleRate
 /// Decodes opus data.
 Result hwopusDecodeInterleaved(HwopusDecoder* decoder, s32 *DecodedDataSize, s32 *DecodedSampleCount, const void* opusin, size_t opusin_size, s16 *pcmbuf, size_t pcmbuf_size);
 
+/**
+ * @brief Decodes consecutive packets, each starting with a \ref HwopusHeader, as long as they are complete and their output fits.
+ * @note The service decodes one packet per request, this saves the caller from splitting the input and sizing the output of each packet.
+ * @param[out] DecodedDataSize Size of the input consumed, the remainder starts with the first packet which wasn't decoded.
+ * @param[out] DecodedSampleCount Number of samples per channel written to pcmbuf.
+ */
+Result hwopusDecodeInterleavedBatch(HwopusDecoder* decoder, s32 *DecodedDataSize, s32 *DecodedSampleCount, const void* opusin, size_t opusin_size, s16 *pcmbuf, size_t pcmbuf_size);
+
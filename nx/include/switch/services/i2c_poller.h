@@ -0,0 +1,86 @@
+/**
+ * @file i2c_poller.h
+ * @brief I2C register poller: the register reads of each device are compiled into one \ref i2csessionExecuteCommandList, run periodically by a thread, and the results are published without locks.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "../types.h"
+#include "../result.h"
+#include "../kernel/mutex.h"
+#include "../kernel/condvar.h"
+#include "../kernel/thread.h"
+#include "i2c.h"
+
+#define I2C_POLLER_MAX_DEVICES 8            ///< Maximum number of devices of a \ref I2cPoller.
+#define I2C_POLLER_MAX_READS 32             ///< Maximum number of register reads per device.
+#define I2C_POLLER_COMMAND_LIST_SIZE 0x100  ///< Maximum size of a command list, as accepted by i2c.
+#define I2C_POLLER_RESULT_SIZE 0x100        ///< Maximum total size of the register reads of a device.
+
+/// Register read.
+typedef struct {
+    u8 reg;                     ///< Register address, sent before reading.
+    u8 size;                    ///< Number of bytes to read.
+} I2cPollerRead;
+
+/// Device of a \ref I2cPoller.
+typedef struct {
+    I2cSession session;
+    u8 cmd_list[I2C_POLLER_COMMAND_LIST_SIZE];
+    u32 cmd_list_size;
+    u32 num_reads;
+    u16 offsets[I2C_POLLER_MAX_READS + 1];  ///< Offset of each read in the results, and total size.
+    u32 seq;                    ///< Incremented before and after each update: odd while the results are being written.
+    u8 results[I2C_POLLER_RESULT_SIZE];
+    Result rc;                  ///< Result of the last \ref i2csessionExecuteCommandList.
+    u64 tick;                   ///< System tick of the last update.
+} I2cPollerDevice;
+
+/// Poller object.
+typedef struct {
+    I2cPollerDevice devices[I2C_POLLER_MAX_DEVICES];
+    u32 num_devices;
+    u64 period_ns;
+    int prio;
+    int cpuid;
+    Mutex mutex;
+    CondVar cond;
+    Thread thread;
+    bool running;
+    bool should_exit;
+} I2cPoller;
+
+/**
+ * @brief Creates a poller. Devices are then added with \ref i2cPollerAddDevice, before \ref i2cPollerStart.
+ * @param[out] p I2cPoller object.
+ * @param[in] period_ns Polling period in nanoseconds.
+ * @param[in] prio Priority of the polling thread.
+ * @param[in] cpuid Core of the polling thread, -2 for the default core.
+ * @note i2c must be initialized.
+ */
+void i2cPollerCreate(I2cPoller* p, u64 period_ns, int prio, int cpuid);
+
+/**
+ * @brief Adds a device and its register reads: each read is a register address send followed by a repeated-start receive, all in a single command list.
+ * @param[in] dev \ref I2cDevice, a session is opened for it.
+ * @param[in] reads Register reads, 1 to \ref I2C_POLLER_MAX_READS.
+ * @param[in] num_reads Number of reads.
+ * @param[out] out_index Index of the device, for \ref i2cPollerGet. Optional, can be NULL.
+ * @return Result code. LibnxError_BadInput when the reads don't fit in a command list.
+ */
+Result i2cPollerAddDevice(I2cPoller* p, I2cDevice dev, const I2cPollerRead* reads, u32 num_reads, u32* out_index);
+
+/// Starts the polling thread. The first results are available once a period elapsed.
+Result i2cPollerStart(I2cPoller* p);
+
+/// Stops the polling thread and closes the sessions.
+void i2cPollerClose(I2cPoller* p);
+
+/**
+ * @brief Gets the last result of a register read. This doesn't lock, and may be called from any thread.
+ * @param[in] device Index of the device.
+ * @param[in] read Index of the read, in the order passed to \ref i2cPollerAddDevice.
+ * @param[out] out Output data, of the size of the read.
+ * @param[out] out_tick System tick of the update, 0 when the device wasn't polled yet. Optional, can be NULL.
+ * @return Result code: the result of the last poll of the device, LibnxError_NotFound when it wasn't polled yet.
+ */
+Result i2cPollerGet(I2cPoller* p, u32 device, u32 read, void* out, u64* out_tick);
@@ -0,0 +1,138 @@
+/**
+ * @file irs_stream.h
+ * @brief IR camera image streaming from a worker thread, and image processing helpers for IR tracking.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "../types.h"
+#include "../result.h"
+#include "../kernel/thread.h"
+#include "../kernel/queue.h"
+#include "irs.h"
+
+#define IRS_STREAM_MAX_BUFFERS 8    ///< Maximum number of buffers of an \ref IrsImageStream.
+
+/// Frame of an \ref IrsImageStream.
+typedef struct {
+    u8* data;                       ///< 8-bit grayscale image, width*height bytes. Owned by the stream until \ref irsImageStreamRelease.
+    u32 index;                      ///< Index of the buffer.
+    u64 sampling_number;            ///< Incremented by one for each image taken by the sensor.
+    u32 ambient_noise_level;
+} IrsImageFrame;
+
+/// IR image stream object.
+typedef struct {
+    Thread thread;
+    u32 handle;
+    bool exit;
+    u32 width, height;
+    u8* buffers[IRS_STREAM_MAX_BUFFERS];
+    SpscQueue free_queue;           ///< Indices of the buffers available to the worker.
+    SpscQueue frame_queue;          ///< Frames waiting for the app.
+    u64 last_sampling_number;
+    u32 missed;                     ///< Images taken by the sensor which weren't received.
+    Result last_result;             ///< Last error of irsGetImageTransferProcessorState.
+} IrsImageStream;
+
+/**
+ * @brief Gets the image dimensions of a sensor resolution.
+ * @param[in] sensor_res \ref IrsImageTransferProcessorConfig sensor_res value.
+ * @param[out] width Output width.
+ * @param[out] height Output height.
+ */
+static inline void irsGetImageTransferSize(u32 sensor_res, u32* width, u32* height)
+{
+    *width = 320 >> sensor_res;
+    *height = 240 >> sensor_res;
+}
+
+/**
+ * @brief Creates an image stream, and starts its worker thread, which continuously pulls new images into the free buffers.
+ * @param[out] s IrsImageStream object.
+ * @param[in] IrCameraHandle Camera handle, with the ImageTransferProcessor already running (see \ref irsRunImageTransferProcessor).
+ * @param[in] sensor_res Resolution the processor was started with.
+ * @param[in] buffers Buffers receiving the images, each at least width*height bytes (see \ref irsGetImageTransferSize). Page alignment is recommended.
+ * @param[in] num_buffers Number of buffers, 2 to \ref IRS_STREAM_MAX_BUFFERS. The app can process num_buffers-1 frames while the worker fills the remaining one.
+ * @param[in] prio Priority of the worker thread, 0x00~0x3F.
+ * @param[in] cpuid CPU core of the worker thread, -2 for the default one.
+ * @return Result code.
+ */
+Result irsImageStreamCreate(IrsImageStream* s, u32 IrCameraHandle, u32 sensor_res, void* const* buffers, u32 num_buffers, int prio, int cpuid);
+
+/// Stops the worker thread of an image stream. This doesn't stop the ImageTransferProcessor.
+void irsImageStreamClose(IrsImageStream* s);
+
+/**
+ * @brief Gets the oldest frame not acquired yet, waiting for one if needed.
+ * @param[out] out Output frame.
+ * @param[in] timeout Timeout in nanoseconds, UINT64_MAX to wait indefinitely.
+ * @return Result code. KERNELRESULT(TimedOut) on timeout.
+ * @note The frames are received in order, but when the app holds all the buffers the sensor's images are missed, see \ref irsImageStreamGetMissedCount.
+ */
+Result irsImageStreamAcquire(IrsImageStream* s, IrsImageFrame* out, u64 timeout);
+
+/// Gives the buffer of a frame acquired with \ref irsImageStreamAcquire back to the worker.
+void irsImageStreamRelease(IrsImageStream* s, const IrsImageFrame* frame);
+
+/// Returns the number of images taken by the sensor which weren't received so far.
+static inline u32 irsImageStreamGetMissedCount(IrsImageStream* s)
+{
+    return __atomic_load_n(&s->missed, __ATOMIC_RELAXED);
+}
+
+/// Creates a \ref Waiter signalled when frames can be acquired. Acquire them with a zero timeout until it fails before waiting again.
+static inline Waiter waiterForIrsImageStream(IrsImageStream* s)
+{
+    return waiterForSpscQueueNotEmpty(&s->frame_queue);
+}
+
+/// Blob found by \ref irsImageFindBlobs.
+typedef struct {
+    float x, y;                     ///< Centroid.
+    u32 area;                       ///< Number of pixels.
+    u16 min_x, min_y;               ///< Top-left of the bounding box.
+    u16 max_x, max_y;               ///< Bottom-right of the bounding box, inclusive.
+} IrsImageBlob;
+
+/// Horizontal run of pixels above the threshold, work item of \ref irsImageFindBlobs.
+typedef struct {
+    u16 y, x0, x1;                  ///< Row, and [x0, x1) span.
+    u16 pad;
+    s32 parent;
+    s32 acc;
+} IrsImageRun;
+
+/**
+ * @brief Thresholds an image: each pixel becomes 0xFF if it's >= threshold, 0 otherwise.
+ * @param[out] dst Output image, can be the same as src.
+ * @param[in] src Input image.
+ * @param[in] size Number of pixels.
+ * @param[in] threshold Threshold.
+ */
+void irsImageThreshold(u8* dst, const u8* src, size_t size, u8 threshold);
+
+/**
+ * @brief Computes the centroid of all the pixels >= threshold, for tracking a single bright spot.
+ * @param[in] src Input image.
+ * @param[in] width Width.
+ * @param[in] height Height.
+ * @param[in] threshold Threshold.
+ * @param[out] out Output blob covering all those pixels.
+ * @return Number of pixels >= threshold, 0 if there are none (out is then zeroed).
+ */
+u32 irsImageComputeCentroid(const u8* src, u32 width, u32 height, u8 threshold, IrsImageBlob* out);
+
+/**
+ * @brief Finds the 8-connected blobs of pixels >= threshold.
+ * @param[in] src Input image.
+ * @param[in] width Width.
+ * @param[in] height Height.
+ * @param[in] threshold Threshold.
+ * @param[in] min_area Minimum number of pixels of a blob, smaller ones are ignored.
+ * @param[in] work Work buffer.
+ * @param[in] max_runs Number of entries in the work buffer. Pixel runs past it are ignored, width*height/2 entries are enough for any image.
+ * @param[out] out Output blobs, in the order of their top-most row.
+ * @param[in] max_blobs Maximum number of output blobs.
+ * @return Number of blobs written.
+ */
+u32 irsImageFindBlobs(const u8* src, u32 width, u32 height, u8 threshold, u32 min_area, IrsImageRun* work, u32 max_runs, IrsImageBlob* out, u32 max_blobs);
@@ -0,0 +1,79 @@
+/**
+ * @file lr_cache.h
+ * @brief Location resolver path cache: paths are resolved once per process, in bulk across a pool of lr sessions.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "../types.h"
+#include "../result.h"
+#include "fs.h"
+#include "lr.h"
+
+/// Maximum number of sessions of a \ref LrPathCache.
+#define LR_CACHE_MAX_SESSIONS 8
+
+/// Path types resolved by a \ref LrPathCache.
+typedef enum {
+    LrPathType_Program                     = 0,  ///< \ref lrLrResolveProgramPath
+    LrPathType_ApplicationControl          = 1,  ///< \ref lrLrResolveApplicationControlPath
+    LrPathType_ApplicationHtmlDocument     = 2,  ///< \ref lrLrResolveApplicationHtmlDocumentPath
+    LrPathType_Data                        = 3,  ///< \ref lrLrResolveDataPath
+    LrPathType_ApplicationLegalInformation = 4,  ///< \ref lrLrResolveApplicationLegalInformationPath
+} LrPathType;
+
+/// Cached path.
+typedef struct {
+    u64 tid;
+    u32 type;                   ///< \ref LrPathType
+    char* path;                 ///< Resolved path, NULL for an empty slot.
+} LrPathCacheEntry;
+
+/// Path cache object. It must only be used from one thread at a time.
+typedef struct {
+    NcmStorageId storage;
+    LrLocationResolver sessions[LR_CACHE_MAX_SESSIONS];
+    u32 num_sessions;
+    LrPathCacheEntry* entries;  ///< Open-addressing table.
+    u32 capacity;
+    u32 count;
+    u64 hits;                   ///< Number of paths served from the cache.
+    u64 misses;                 ///< Number of paths resolved with IPC.
+} LrPathCache;
+
+/**
+ * @brief Creates a path cache. lr must be initialized.
+ * @param[out] c LrPathCache object.
+ * @param[in] storage \ref NcmStorageId of the location resolver.
+ * @param[in] num_sessions Number of location resolver sessions used by \ref lrPathCacheResolveBulk, 1 to \ref LR_CACHE_MAX_SESSIONS. Sessions besides the first one are best-effort.
+ * @return Result code.
+ */
+Result lrPathCacheCreate(LrPathCache* c, NcmStorageId storage, u32 num_sessions);
+
+/// Closes a path cache.
+void lrPathCacheClose(LrPathCache* c);
+
+/**
+ * @brief Resolves a path, from the cache when possible.
+ * @param[in] type \ref LrPathType
+ * @param[in] tid TitleId.
+ * @param[out] out Output path, of \ref FS_MAX_PATH bytes.
+ * @return Result code. Failures are not cached.
+ */
+Result lrPathCacheResolve(LrPathCache* c, LrPathType type, u64 tid, char* out);
+
+/**
+ * @brief Resolves the paths of several titles. The paths which aren't cached are resolved concurrently, one thread per session, and added to the cache.
+ * @param[in] type \ref LrPathType
+ * @param[in] tids TitleIds.
+ * @param[out] out Output paths, of \ref FS_MAX_PATH bytes each.
+ * @param[out] out_rcs Result of each path.
+ * @param[in] count Number of titles.
+ * @return Result code. The result of each path is in out_rcs.
+ */
+Result lrPathCacheResolveBulk(LrPathCache* c, LrPathType type, const u64* tids, char (*out)[FS_MAX_PATH], Result* out_rcs, u32 count);
+
+/// Calls \ref lrLrRefresh and empties the cache. Use this after the locations changed, e.g. after redirecting paths or installing titles.
+Result lrPathCacheRefresh(LrPathCache* c);
+
+/// Empties the cache, without \ref lrLrRefresh.
+void lrPathCacheInvalidate(LrPathCache* c);
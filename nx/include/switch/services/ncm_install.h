@@ -0,0 +1,94 @@
+/**
+ * @file ncm_install.h
+ * @brief Pipelined placeholder writes for installing content: the source is read (and decrypted or hashed) on one thread while the previous chunk is written on another.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "../types.h"
+#include "../result.h"
+#include "../kernel/mutex.h"
+#include "../kernel/condvar.h"
+#include "../kernel/thread.h"
+#include "ncm.h"
+
+/// Default size of the chunks passed to \ref ncmContentStorageWritePlaceHolder.
+#define NCM_INSTALL_DEFAULT_CHUNK_SIZE 0x400000
+
+/// Maximum number of chunk buffers of a \ref NcmInstallStream.
+#define NCM_INSTALL_MAX_BUFFERS 4
+
+/**
+ * @brief Reads source data, for example with \ref fsFileRead or \ref cryptoStorageRead.
+ * @param[in] userdata User data from \ref NcmInstallStreamConfig.
+ * @param[in] offset Offset of the data within the content.
+ * @param[out] buffer Output buffer, page-aligned.
+ * @param[in] size Size to read, size bytes must be read.
+ * @return Result code.
+ */
+typedef Result (*NcmInstallReadFn)(void* userdata, s64 offset, void* buffer, size_t size);
+
+/**
+ * @brief Processes a chunk after it's read, on the reader thread. For example decrypts it in place with \ref aes128CtrCrypt, or hashes it with \ref sha256ContextUpdate.
+ * @param[in] userdata User data from \ref NcmInstallStreamConfig.
+ * @param[in] offset Offset of the data within the content. Chunks are processed in order.
+ * @param[in,out] buffer Chunk data.
+ * @param[in] size Size of the chunk.
+ * @return Result code. A failure cancels the install.
+ */
+typedef Result (*NcmInstallProcessFn)(void* userdata, s64 offset, void* buffer, size_t size);
+
+/// Configuration of a \ref NcmInstallStream.
+typedef struct {
+    NcmContentStorage* cs;              ///< Content storage.
+    NcmPlaceHolderId placeholder_id;    ///< Placeholder, which must already be created with the content size.
+    s64 size;                           ///< Size of the content.
+    size_t chunk_size;                  ///< Size of the chunks, rounded up to 0x1000-bytes. 0 for \ref NCM_INSTALL_DEFAULT_CHUNK_SIZE.
+    u32 num_buffers;                    ///< Number of chunk buffers, 2 to \ref NCM_INSTALL_MAX_BUFFERS. 0 for 2.
+    NcmInstallReadFn read;              ///< Source reader.
+    NcmInstallProcessFn process;        ///< Chunk processing, optional.
+    void* userdata;                     ///< User data passed to the callbacks.
+    int prio;                           ///< Priority of the reader thread. -1 for the priority of the calling thread.
+    int cpuid;                          ///< Core of the reader thread, -2 for the default core.
+} NcmInstallStreamConfig;
+
+/// Install stream object.
+typedef struct {
+    NcmInstallStreamConfig config;
+    u8* buffers[NCM_INSTALL_MAX_BUFFERS];
+    size_t sizes[NCM_INSTALL_MAX_BUFFERS];   ///< Size of the data in each ready buffer.
+    u32 num_ready;                      ///< Buffers read and waiting to be written, starting at write_index.
+    u32 write_index;
+    Mutex mutex;
+    CondVar cond;
+    Thread reader;
+    Result reader_rc;
+    bool reader_done;
+    bool cancel;
+    u64 written;                        ///< Bytes written so far.
+} NcmInstallStream;
+
+/**
+ * @brief Creates an install stream, allocating its chunk buffers.
+ * @param[out] s NcmInstallStream object.
+ * @param[in] config Configuration.
+ * @return Result code.
+ */
+Result ncmInstallStreamCreate(NcmInstallStream* s, const NcmInstallStreamConfig* config);
+
+/// Frees an install stream.
+void ncmInstallStreamClose(NcmInstallStream* s);
+
+/**
+ * @brief Writes the whole content to the placeholder. The reader thread reads and processes the next chunks while the calling thread writes the current one.
+ * @return Result code. The first failure of the reader, the processing or the writes, LibnxError_Cancelled after \ref ncmInstallStreamCancel.
+ */
+Result ncmInstallStreamRun(NcmInstallStream* s);
+
+/// Makes \ref ncmInstallStreamRun stop after the current chunk. Can be called from any thread.
+void ncmInstallStreamCancel(NcmInstallStream* s);
+
+/// Gets the number of bytes written so far. Can be called from any thread.
+static inline u64 ncmInstallStreamGetProgress(NcmInstallStream* s)
+{
+    return __atomic_load_n(&s->written, __ATOMIC_RELAXED);
+}
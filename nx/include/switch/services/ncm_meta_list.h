@@ -0,0 +1,56 @@
+/**
+ * @file ncm_meta_list.h
+ * @brief Bulk content meta enumeration for ncm: keys are listed with large buffers, and the meta records are fetched concurrently into one contiguous allocation.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "../types.h"
+#include "../result.h"
+#include "ncm.h"
+
+/// Maximum number of sessions (and threads) used by \ref ncmContentMetaListCreate per storage.
+#define NCM_META_LIST_MAX_SESSIONS 8
+
+/// Maximum number of storages enumerated by \ref ncmContentMetaListCreate.
+#define NCM_META_LIST_MAX_STORAGES 8
+
+/// Content meta of a \ref NcmContentMetaList.
+typedef struct {
+    NcmContentMetaKey key;                  ///< \ref NcmContentMetaKey
+    NcmStorageId storage_id;                ///< Storage the content meta was listed from.
+    Result rc;                              ///< Result of fetching the record, the record is NULL on failure.
+    const NcmContentMetaHeader* record;     ///< Record from \ref ncmContentMetaDatabaseGet: \ref NcmContentMetaHeader, followed by the extended header, the \ref NcmContentInfo and the \ref NcmContentMetaInfo. NULL when records weren't fetched.
+    u32 record_size;                        ///< Size of the record.
+} NcmContentMetaListEntry;
+
+/// List of content meta.
+typedef struct {
+    NcmContentMetaListEntry* entries;       ///< Entries, grouped by storage in the order they were requested, each in the order of \ref ncmContentMetaDatabaseList.
+    u32 count;                              ///< Number of entries.
+    u8* data;                               ///< Contiguous storage of all the records.
+    size_t data_size;                       ///< Size of the records storage.
+} NcmContentMetaList;
+
+/**
+ * @brief Lists the content meta of storages. ncm must be initialized.
+ * @param[out] l NcmContentMetaList object.
+ * @param[in] storage_ids Storages to enumerate, up to \ref NCM_META_LIST_MAX_STORAGES. Storages which can't be opened (e.g. no gamecard inserted) are skipped.
+ * @param[in] num_storages Number of storages.
+ * @param[in] meta_type \ref NcmContentMetaType to list, NcmContentMetaType_Unknown for all of them.
+ * @param[in] num_sessions Number of database sessions (and threads) fetching the records concurrently, 1 to \ref NCM_META_LIST_MAX_SESSIONS. 0 to only list the keys.
+ * @return Result code.
+ */
+Result ncmContentMetaListCreate(NcmContentMetaList* l, const NcmStorageId* storage_ids, u32 num_storages, NcmContentMetaType meta_type, u32 num_sessions);
+
+/// Frees a content meta list.
+void ncmContentMetaListClose(NcmContentMetaList* l);
+
+/// Returns the extended header of the record of an entry, NULL if there's none.
+static inline const void* ncmContentMetaListGetExtendedHeader(const NcmContentMetaListEntry* e) {
+    return e->record && e->record->extended_header_size ? (const void*)(e->record + 1) : NULL;
+}
+
+/// Returns the \ref NcmContentInfo of the record of an entry, NULL if there's no record. There are record->content_count of them.
+static inline const NcmContentInfo* ncmContentMetaListGetContentInfos(const NcmContentMetaListEntry* e) {
+    return e->record ? (const NcmContentInfo*)((const u8*)(e->record + 1) + e->record->extended_header_size) : NULL;
+}
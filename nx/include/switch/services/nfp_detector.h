@@ -0,0 +1,67 @@
+/**
+ * @file nfp_detector.h
+ * @brief Event-driven tag detection for nfp: the activate/deactivate events of all the devices are waited on at once, and the info of recently seen tags is cached so that they're only mounted once.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "../types.h"
+#include "../result.h"
+#include "../kernel/event.h"
+#include "nfc.h"
+
+/// Maximum number of devices of a \ref NfpDetector.
+#define NFP_DETECTOR_MAX_DEVICES 8
+
+/// Number of tags remembered by a \ref NfpDetector.
+#define NFP_DETECTOR_CACHE_SIZE 8
+
+/// Info of a tag.
+typedef struct {
+    NfpTagInfo tag_info;            ///< \ref NfpTagInfo
+    NfpCommonInfo common_info;      ///< \ref NfpCommonInfo
+    NfpModelInfo model_info;        ///< \ref NfpModelInfo
+    NfpRegisterInfo register_info;  ///< \ref NfpRegisterInfo, only valid when has_register_info is set.
+    bool has_register_info;         ///< Whether the tag was registered in amiibo settings.
+    u64 last_used;                  ///< Detection counter when the tag was last seen.
+} NfpDetectorTag;
+
+/// Device of a \ref NfpDetector.
+typedef struct {
+    NfcDeviceHandle handle;         ///< \ref NfcDeviceHandle
+    Event activate_event;
+    Event deactivate_event;
+    bool active;                    ///< Whether a tag is in range.
+    Result rc;                      ///< Result of reading the tag in range, the tag is only valid on success.
+    NfpDetectorTag tag;             ///< Tag in range.
+} NfpDetectorDevice;
+
+/// Detector object. It must only be used from one thread at a time.
+typedef struct {
+    NfpDetectorDevice devices[NFP_DETECTOR_MAX_DEVICES];
+    s32 count;                      ///< Number of devices.
+    NfpDetectorTag cache[NFP_DETECTOR_CACHE_SIZE];
+    u32 cache_count;
+    u64 counter;
+} NfpDetector;
+
+/**
+ * @brief Creates a detector for the devices from \ref nfpListDevices, and starts detection on them. nfp must be initialized.
+ * @param[out] d NfpDetector object.
+ * @return Result code.
+ */
+Result nfpDetectorCreate(NfpDetector* d);
+
+/// Stops detection and closes the events.
+void nfpDetectorClose(NfpDetector* d);
+
+/**
+ * @brief Waits for a tag to come in or out of range of any device, with one \ref waitObjects.
+ * @param[out] out_device Index of the device whose state changed, see NfpDetectorDevice::active.
+ * @param[in] timeout Timeout in nanoseconds, 0 to only check (e.g. once per frame), UINT64_MAX to wait indefinitely.
+ * @return Result code. KERNELRESULT(TimedOut) when nothing changed.
+ * @note When a tag comes in range, its info is read (mounting it) unless it's in the cache. The tag is unmounted again, see NfpDetectorDevice::rc.
+ */
+Result nfpDetectorWait(NfpDetector* d, s32* out_device, u64 timeout);
+
+/// Forgets the cached tags, e.g. after writing to a tag through nfp, so that their info is read again.
+void nfpDetectorInvalidate(NfpDetector* d);
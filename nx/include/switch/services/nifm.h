@@ -8,6 +8,7 @@
 #pragma once
 #include "../types.h"
 #include "../sf/service.h"
+#include "../kernel/event.h"
 
 typedef enum {
     NifmServiceType_User           = 0, ///< Initializes nifm:u.
@@ -28,6 +29,13 @@ typedef enum {
     NifmInternetConnectionStatus_Connected              = 4, ///< Internet is connected.
 } NifmInternetConnectionStatus;
 
+/// Request object (IRequest).
+typedef struct {
+    Service s;                  ///< IRequest
+    Event event_state;          ///< Signaled when the state of the request changes.
+    Event event_other;          ///< Second event returned by GetSystemEventReadableHandles.
+} NifmRequest;
+
 /// Initialize nifm. This is used automatically by gethostid().
 Result nifmInitialize(NifmServiceType service_type);
 
@@ -59,3 +67,26 @@ Result nifmIsEthernetCommunicationEnabled(bool* out);
 Result nifmIsAnyForegroundRequestAccepted(bool* out);
 Result nifmPutToSleep(void);
 Result nifmWakeUp(void);
+
+/**
+ * @brief Creates a \ref NifmRequest.
+ * @param[out] r \ref NifmRequest
+ * @param[in] requirement_preset Requirement preset of the request.
+ * @param[in] autoclear Whether the events are auto-clear.
+ */
+Result nifmCreateRequest(NifmRequest* r, s32 requirement_preset, bool autoclear);
+
+/// Closes a \ref NifmRequest.
+void nifmRequestClose(NifmRequest* r);
+
+/// Gets the state of a \ref NifmRequest.
+Result nifmRequestGetRequestState(NifmRequest* r, s32* out);
+
+/// Gets the Result of a \ref NifmRequest.
+Result nifmRequestGetResult(NifmRequest* r);
+
+/// Cancels a \ref NifmRequest.
+Result nifmRequestCancel(NifmRequest* r);
+
+/// Submits a \ref NifmRequest.
+Result nifmRequestSubmit(NifmRequest* r);
@@ -0,0 +1,62 @@
+/**
+ * @file nifm_monitor.h
+ * @brief Network status monitor: a thread refreshes the nifm status when it changes, and queries are served from a snapshot without IPC or locks.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "../types.h"
+#include "../result.h"
+#include "../kernel/thread.h"
+#include "../kernel/uevent.h"
+#include "nifm.h"
+
+/// Network status, as last refreshed by a \ref NifmStatusMonitor.
+typedef struct {
+    Result rc;                  ///< Result of \ref nifmGetInternetConnectionStatus. It fails when there's no connection at all.
+    NifmInternetConnectionType type;                ///< Connection type, valid when rc succeeded.
+    u32 wifi_strength;          ///< Wi-Fi signal strength from 0 to 3 bars, valid when rc succeeded.
+    NifmInternetConnectionStatus status;            ///< Connection status, valid when rc succeeded.
+    u32 ip_address;             ///< IPv4 address from \ref nifmGetCurrentIpAddress, 0 when there's none.
+    u64 tick;                   ///< System tick of the refresh.
+    u32 changes;                ///< Number of refreshes which changed the status.
+} NifmStatus;
+
+/// Status monitor object.
+typedef struct {
+    NifmRequest request;
+    bool has_request;
+    u64 interval_ns;
+    Thread thread;
+    UEvent exit_event;
+    UEvent refresh_event;       ///< Signaled by \ref nifmStatusMonitorRefresh.
+    u32 seq;                    ///< Incremented before and after each update of the snapshot: odd while it's being written.
+    NifmStatus snapshot;
+} NifmStatusMonitor;
+
+/**
+ * @brief Creates a status monitor and starts its thread. nifm must be initialized.
+ * @param[out] m NifmStatusMonitor object.
+ * @param[in] requirement_preset When non-zero, a \ref NifmRequest with this preset is created and submitted, and the status is refreshed when its state changes. When zero, the status is only polled.
+ * @param[in] interval_ns Polling interval in nanoseconds, used on top of the request event: status changes which don't affect the request (such as the signal strength) are picked up at this rate. 0 disables polling.
+ * @param[in] prio Priority of the thread.
+ * @param[in] cpuid Core of the thread, -2 for the default core.
+ * @return Result code. The first snapshot is available once this returns.
+ */
+Result nifmStatusMonitorCreate(NifmStatusMonitor* m, s32 requirement_preset, u64 interval_ns, int prio, int cpuid);
+
+/// Stops the thread and closes the monitor.
+void nifmStatusMonitorClose(NifmStatusMonitor* m);
+
+/// Wakes up the thread to refresh the status now, e.g. before a reconnect attempt which doesn't trust the snapshot. This doesn't wait for the refresh.
+void nifmStatusMonitorRefresh(NifmStatusMonitor* m);
+
+/// Gets the last snapshot of the status. This doesn't lock nor do IPC, and may be called from any thread.
+void nifmStatusMonitorGet(NifmStatusMonitor* m, NifmStatus* out);
+
+/// Returns whether the last snapshot is \ref NifmInternetConnectionStatus_Connected.
+static inline bool nifmStatusMonitorIsConnected(NifmStatusMonitor* m)
+{
+    NifmStatus status;
+    nifmStatusMonitorGet(m, &status);
+    return R_SUCCEEDED(status.rc) && status.status == NifmInternetConnectionStatus_Connected;
+}
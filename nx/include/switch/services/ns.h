@@ -183,6 +183,30 @@ Result nsListApplicationContentMetaStatus(u64 application_id, s32 index, NsAppli
  */
 Result nsGetApplicationControlData(NsApplicationControlSource source, u64 application_id, NsApplicationControlData* buffer, size_t size, u64* actual_size);
 
+/**
+ * @brief Same as \ref nsGetApplicationControlData, using a session from \ref nsOpenApplicationManagerInterface.
+ * @param[in] srv IApplicationManagerInterface session.
+ * @param[in] source Source, official sw uses ::NsApplicationControlSource_Storage.
+ * @param[in] application_id ApplicationId.
+ * @param[out] buffer \ref NsApplicationControlData
+ * @param[in] size Size of the buffer.
+ * @param[out] actual_size Actual output size.
+ */
+Result nsGetApplicationControlDataWithSession(Service* srv, NsApplicationControlSource source, u64 application_id, NsApplicationControlData* buffer, size_t size, u64* actual_size);
+
+/**
+ * @brief Opens an additional IApplicationManagerInterface session, so that commands can be issued from several threads concurrently. Must be closed with \ref serviceClose.
+ * @param[out] srv_out Output Service.
+ */
+Result nsOpenApplicationManagerInterface(Service* srv_out);
+
+/**
+ * @brief Gets an Event which is signaled when the \ref NsApplicationRecord list changes.
+ * @note The Event must be closed by the user once finished with it.
+ * @param[out] out_event Output Event with autoclear=false.
+ */
+Result nsGetApplicationRecordUpdateSystemEvent(Event* out_event);
+
 /**
  * @brief Returns the total storage capacity (used + free) from content manager services.
  * @param[in] storage_id \ref NcmStorageId. Must be ::NcmStorageId_SdCard.
@@ -0,0 +1,65 @@
+/**
+ * @file ns_metadata.h
+ * @brief Application metadata (NACP and icon) cache for ns, fetched concurrently and persisted to a file.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "../types.h"
+#include "../result.h"
+#include "../nacp.h"
+#include "../kernel/event.h"
+#include "ns.h"
+
+/// Maximum number of sessions used by \ref NsMetadataCache to fetch control data concurrently.
+#define NS_METADATA_MAX_SESSIONS 8
+
+/// Metadata of an application.
+typedef struct {
+    NsApplicationRecord record;     ///< \ref NsApplicationRecord the metadata was fetched for.
+    NacpStruct* nacp;               ///< \ref NacpStruct, NULL if the control data couldn't be fetched.
+    u8* icon;                       ///< JPEG icon.
+    u32 icon_size;                  ///< Size of the icon.
+} NsMetadataEntry;
+
+/// Metadata cache object. It must only be used from one thread at a time.
+typedef struct {
+    NsMetadataEntry* entries;       ///< Entries, in the order of \ref nsListApplicationRecord (most recently used applications first).
+    s32 count;                      ///< Number of entries.
+    Event record_event;             ///< From \ref nsGetApplicationRecordUpdateSystemEvent.
+    u32 num_sessions;
+    char* path;                     ///< Path of the cache file, NULL if not persisted.
+    bool dirty;                     ///< Whether the entries changed since the cache file was written.
+} NsMetadataCache;
+
+/**
+ * @brief Creates a metadata cache. ns must be initialized.
+ * @param[out] c NsMetadataCache object.
+ * @param[in] path Path of the cache file (as used in stdio), for example "sdmc:/switch/launcher/metadata.bin". Its entries are used for the applications whose \ref NsApplicationRecord didn't change. NULL to not use a file.
+ * @param[in] num_sessions Number of ns sessions (and threads) fetching control data concurrently, 1 to \ref NS_METADATA_MAX_SESSIONS.
+ * @return Result code.
+ * @note This lists the application records, fetches the control data of the applications missing from the cache file, and writes the cache file when anything changed.
+ */
+Result nsMetadataCacheCreate(NsMetadataCache* c, const char* path, u32 num_sessions);
+
+/// Closes a metadata cache, writing the cache file first if it's out of date.
+void nsMetadataCacheClose(NsMetadataCache* c);
+
+/**
+ * @brief Lists the application records again, and fetches the control data of the new or changed ones.
+ * @param[out] out_changed Whether any entry changed. Optional, can be NULL.
+ * @return Result code.
+ */
+Result nsMetadataCacheRefresh(NsMetadataCache* c, bool* out_changed);
+
+/**
+ * @brief Refreshes the cache if the application records changed since the last refresh, without waiting.
+ * @param[out] out_changed Whether any entry changed. Optional, can be NULL.
+ * @return Result code.
+ */
+Result nsMetadataCacheUpdate(NsMetadataCache* c, bool* out_changed);
+
+/// Finds the entry of an application, NULL if there's none.
+const NsMetadataEntry* nsMetadataCacheFind(NsMetadataCache* c, u64 application_id);
+
+/// Writes the cache file.
+Result nsMetadataCacheSave(NsMetadataCache* c);
@@ -0,0 +1,59 @@
+/**
+ * @file pdm_index.h
+ * @brief Incremental play statistics index for pdm:qry: only the play events logged since the last update are read, and the per-application statistics are persisted to a file.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "../types.h"
+#include "../result.h"
+#include "pdm.h"
+
+/// Play statistics of an application, aggregated from ::PdmPlayEventType_Applet events.
+typedef struct {
+    u64 application_id;               ///< ApplicationId.
+    u64 playtime;                     ///< Total time in focus in seconds, from PdmPlayEvent::timestampSteady.
+    u32 launches;                     ///< Total times the application was launched.
+    u32 first_entry_index;            ///< Entry index of the first event of the application.
+    u32 last_entry_index;             ///< Entry index of the last event of the application.
+    u32 reserved;                     ///< Reserved.
+    u64 first_timestamp;              ///< PdmPlayEvent::timestampUser of the first event of the application.
+    u64 last_timestamp;               ///< PdmPlayEvent::timestampUser of the last event of the application.
+} PdmPlayIndexEntry;
+
+/// Play statistics index object. It must only be used from one thread at a time.
+typedef struct {
+    PdmPlayIndexEntry* entries;       ///< Entries, sorted by ApplicationId.
+    u32 count;                        ///< Number of entries.
+    u32 capacity;
+    s32 next_entry_index;             ///< Entry index of the first play event not read yet.
+    u64 focus_application_id;         ///< Application in focus at the last event read, 0 if none.
+    u64 focus_start;                  ///< PdmPlayEvent::timestampSteady when it got focus.
+    char* path;                       ///< Path of the index file, NULL if not persisted.
+    bool dirty;                       ///< Whether the index changed since the file was written.
+} PdmPlayIndex;
+
+/**
+ * @brief Creates a play statistics index. pdm:qry must be initialized.
+ * @param[out] idx PdmPlayIndex object.
+ * @param[in] path Path of the index file (as used in stdio), for example "sdmc:/switch/stats/playindex.bin". Reading continues from where the file left off. NULL to not use a file.
+ * @return Result code.
+ * @note This reads the play events logged since the index file was written, and writes it when anything changed.
+ */
+Result pdmPlayIndexCreate(PdmPlayIndex* idx, const char* path);
+
+/// Closes a play statistics index, writing the index file first if it's out of date.
+void pdmPlayIndexClose(PdmPlayIndex* idx);
+
+/**
+ * @brief Reads the play events logged since the last update, and aggregates them.
+ * @param[out] out_changed Whether any entry changed. Optional, can be NULL.
+ * @return Result code.
+ * @note Events which were dropped from the log before being read are missed. When the log was reset (e.g. by a system reset), the index is rebuilt from the start of the log.
+ */
+Result pdmPlayIndexUpdate(PdmPlayIndex* idx, bool* out_changed);
+
+/// Finds the entry of an application, NULL if there's none.
+const PdmPlayIndexEntry* pdmPlayIndexFind(PdmPlayIndex* idx, u64 application_id);
+
+/// Writes the index file.
+Result pdmPlayIndexSave(PdmPlayIndex* idx);
@@ -0,0 +1,155 @@
+/**
+ * @file pl_glyph_cache.h
+ * @brief Glyph atlas cache for the pl shared fonts: glyphs are rasterized once into a texture atlas, and looked up afterwards.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "../types.h"
+#include "../result.h"
+#include "pl.h"
+
+/// Maximum glyph size in pixels supported by \ref PlGlyphCache.
+#define PL_GLYPH_CACHE_MAX_SIZE 255
+
+/// Metrics of a rasterized glyph, in pixels.
+typedef struct {
+    u16 width;                  ///< Width of the bitmap.
+    u16 height;                 ///< Height of the bitmap.
+    s16 bearing_x;              ///< Horizontal offset from the pen position to the left of the bitmap.
+    s16 bearing_y;              ///< Vertical offset from the baseline up to the top of the bitmap.
+    s16 advance;                ///< Horizontal advance of the pen position.
+} PlGlyphMetrics;
+
+/**
+ * @brief Rasterizes a glyph of a shared font, for example with a TrueType rasterizer working on font->address.
+ * @param[in] userdata User data from \ref PlGlyphCacheConfig.
+ * @param[in] font Shared font.
+ * @param[in] codepoint Unicode codepoint.
+ * @param[in] size Font size in pixels.
+ * @param[out] dst Atlas cell to write the 8-bit coverage bitmap to, cleared to zero.
+ * @param[in] pitch Distance in bytes between the rows of dst.
+ * @param[in] max_width Width of the cell: wider bitmaps must be clipped.
+ * @param[in] max_height Height of the cell: taller bitmaps must be clipped.
+ * @param[out] metrics Glyph metrics. The width and height are the ones of the bitmap written to dst.
+ * @return Result code. LibnxError_NotFound when the font doesn't have the glyph.
+ */
+typedef Result (*PlGlyphRasterizeFn)(void* userdata, const PlFontData* font, u32 codepoint, u32 size, u8* dst, u32 pitch, u32 max_width, u32 max_height, PlGlyphMetrics* metrics);
+
+/// Configuration of a \ref PlGlyphCache.
+typedef struct {
+    PlGlyphRasterizeFn rasterize;   ///< Rasterizer.
+    void* userdata;                 ///< User data passed to the rasterizer.
+    u32 cell_width;                 ///< Width of the atlas cells, the maximum glyph width.
+    u32 cell_height;                ///< Height of the atlas cells, the maximum glyph height.
+    u32 columns;                    ///< Number of cells per atlas row.
+    u32 rows;                       ///< Number of cell rows of the atlas.
+    void* atlas;                    ///< Memory of the atlas, at least \ref plGlyphCacheGetAtlasSize bytes and 0x1000-aligned so that it can be mapped for the GPU. NULL to allocate it.
+} PlGlyphCacheConfig;
+
+/// Glyph in the atlas, returned by \ref plGlyphCacheLookup.
+typedef struct {
+    u32 key;                        ///< Codepoint, font type and size.
+    u32 hash_next;                  ///< Next entry of the hash bucket.
+    u32 lru_prev;                   ///< Entry used more recently.
+    u32 lru_next;                   ///< Entry used less recently.
+    u32 frame;                      ///< Frame of the last use.
+    u16 x;                          ///< Horizontal position of the bitmap in the atlas.
+    u16 y;                          ///< Vertical position of the bitmap in the atlas.
+    PlGlyphMetrics metrics;         ///< Glyph metrics.
+} PlGlyphCacheEntry;
+
+/// Glyph atlas cache object. It must only be used from one thread at a time.
+typedef struct {
+    PlGlyphRasterizeFn rasterize;
+    void* userdata;
+    PlFontData fonts[PlSharedFontType_Total];
+    u32 loaded_fonts;               ///< Bitmask of the loaded fonts.
+
+    u8* atlas;                      ///< 8-bit coverage atlas, linear.
+    bool atlas_allocated;
+    u32 atlas_width;
+    u32 atlas_height;
+    u32 pitch;                      ///< Distance in bytes between the rows of the atlas, a multiple of 64.
+    u32 cell_width;
+    u32 cell_height;
+    u32 columns;
+
+    PlGlyphCacheEntry* entries;     ///< One entry per cell.
+    u32 num_entries;
+    u32 num_used;                   ///< Entries used so far, the others are free.
+    u32* buckets;
+    u32 bucket_mask;
+    u32 lru_head;                   ///< Most recently used entry.
+    u32 lru_tail;                   ///< Least recently used entry.
+    u32 frame;
+
+    u32 dirty_y0;                   ///< First atlas row changed since \ref plGlyphCacheClearDirty.
+    u32 dirty_y1;                   ///< Atlas row following the last changed one.
+
+    u64 hits;
+    u64 misses;
+    u64 evictions;
+} PlGlyphCache;
+
+/// Returns the size in bytes of the atlas of a configuration.
+static inline size_t plGlyphCacheGetAtlasSize(const PlGlyphCacheConfig* config)
+{
+    u32 pitch = (config->cell_width * config->columns + 63) & ~63;
+    return ((size_t)pitch * config->cell_height * config->rows + 0xFFF) & ~0xFFF;
+}
+
+/**
+ * @brief Creates a glyph cache. pl must be initialized, the shared fonts are loaded on first use.
+ * @param[out] c PlGlyphCache object.
+ * @param[in] config Configuration.
+ * @return Result code.
+ */
+Result plGlyphCacheCreate(PlGlyphCache* c, const PlGlyphCacheConfig* config);
+
+/// Closes a glyph cache.
+void plGlyphCacheClose(PlGlyphCache* c);
+
+/**
+ * @brief Starts a new frame. Glyphs looked up during the current frame are never evicted, so that the atlas stays valid until the frame is drawn.
+ */
+static inline void plGlyphCacheBeginFrame(PlGlyphCache* c)
+{
+    c->frame++;
+}
+
+/**
+ * @brief Looks up a glyph, rasterizing it into the atlas if it isn't there yet. When the atlas is full, the least recently used glyph is evicted.
+ * @param[in] font Shared font type.
+ * @param[in] codepoint Unicode codepoint.
+ * @param[in] size Font size in pixels, at most \ref PL_GLYPH_CACHE_MAX_SIZE.
+ * @param[out] out Glyph entry, valid until the next lookup in another frame.
+ * @return Result code. LibnxError_NotFound when the font doesn't have the glyph, LibnxError_OutOfMemory when all the glyphs are used by the current frame.
+ */
+Result plGlyphCacheLookup(PlGlyphCache* c, PlSharedFontType font, u32 codepoint, u32 size, const PlGlyphCacheEntry** out);
+
+/**
+ * @brief Same as \ref plGlyphCacheLookup, trying each font of a list in order until one has the glyph.
+ * @param[in] fonts Shared font types, for example from \ref plGetSharedFont.
+ * @param[in] num_fonts Number of font types.
+ */
+Result plGlyphCacheLookupFallback(PlGlyphCache* c, const PlSharedFontType* fonts, u32 num_fonts, u32 codepoint, u32 size, const PlGlyphCacheEntry** out);
+
+/**
+ * @brief Gets the atlas rows changed since the last \ref plGlyphCacheClearDirty, to upload or flush only those.
+ * @param[out] y First changed row.
+ * @param[out] height Number of changed rows.
+ * @return Whether any row changed.
+ */
+static inline bool plGlyphCacheGetDirtyRows(PlGlyphCache* c, u32* y, u32* height)
+{
+    *y = c->dirty_y0;
+    *height = c->dirty_y1 > c->dirty_y0 ? c->dirty_y1 - c->dirty_y0 : 0;
+    return *height != 0;
+}
+
+/// Marks the whole atlas as up to date.
+static inline void plGlyphCacheClearDirty(PlGlyphCache* c)
+{
+    c->dirty_y0 = c->atlas_height;
+    c->dirty_y1 = 0;
+}
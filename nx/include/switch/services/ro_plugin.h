@@ -0,0 +1,44 @@
+/**
+ * @file ro_plugin.h
+ * @brief Batched NRO loading with ldr:ro: the NROs are read, hashed together, and registered with a single NRR built at runtime.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "../types.h"
+#include "../result.h"
+#include "ro.h"
+
+/// Maximum number of NROs of a \ref RoPluginSet.
+#define RO_PLUGIN_MAX_MODULES 64
+
+/// NRO loaded by a \ref RoPluginSet.
+typedef struct {
+    void* image;                ///< NRO image, 0x1000-aligned. Mapped as code by ro while loaded, so it must not be accessed.
+    size_t image_size;          ///< Size of the image, from the NRO header.
+    void* bss;                  ///< Bss memory, NULL if the NRO has none.
+    size_t bss_size;            ///< Size of the bss, rounded up to 0x1000-bytes.
+    u64 base;                   ///< Address where the NRO was loaded, 0 if it isn't.
+} RoPluginModule;
+
+/// Set of NROs, registered and loaded together.
+typedef struct {
+    void* nrr;                  ///< NRR listing the hashes of all the modules.
+    size_t nrr_size;
+    bool nrr_registered;
+    u32 count;                  ///< Number of modules.
+    RoPluginModule modules[RO_PLUGIN_MAX_MODULES];  ///< Modules, in the order of the paths.
+} RoPluginSet;
+
+/**
+ * @brief Loads NROs: reads them, computes their hashes with \ref sha256CalculateHashesBatch, registers one NRR for all of them and loads them.
+ * @param[out] s RoPluginSet object.
+ * @param[in] paths Paths of the NROs.
+ * @param[in] count Number of paths, 1 to \ref RO_PLUGIN_MAX_MODULES.
+ * @return Result code. Nothing stays loaded on failure.
+ * @note ldr:ro must be initialized. The NRR is not signed, so this requires ro to not enforce NRR signatures (as with Atmosphère's ro).
+ * @note The NRO base addresses are in s->modules[i].base: resolving symbols and running the module initializers is left to the caller, as with \ref ldrRoLoadNro.
+ */
+Result roPluginSetLoad(RoPluginSet* s, const char* const* paths, u32 count);
+
+/// Unloads the NROs of a \ref RoPluginSet, unregisters its NRR and frees its memory.
+void roPluginSetUnload(RoPluginSet* s);
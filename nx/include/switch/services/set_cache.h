@@ -0,0 +1,72 @@
+/**
+ * @file set_cache.h
+ * @brief Read cache for settings: values are fetched once, and fetched again when settings signal a change or after a TTL.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "../types.h"
+#include "../result.h"
+#include "../kernel/mutex.h"
+#include "../kernel/event.h"
+#include "set.h"
+
+#define SET_CACHE_MAX_ITEMS 32              ///< Maximum number of settings items cached, the oldest one is replaced past that.
+#define SET_CACHE_MAX_VALUE_SIZE 0x40       ///< Maximum size of a cached settings item value, larger ones are always read from setsys.
+#define SET_CACHE_POLL_INTERVAL 50000000    ///< Minimum interval in nanoseconds between checks of the change notification event.
+
+/// Cached value.
+typedef struct {
+    bool valid;
+    u64 tick;                               ///< System tick of the fetch.
+} SetCacheSlot;
+
+/// Cached settings item.
+typedef struct {
+    SetCacheSlot slot;
+    char name[SET_MAX_NAME_SIZE];
+    char item_key[SET_MAX_NAME_SIZE];
+    u64 size;
+    u8 value[SET_CACHE_MAX_VALUE_SIZE];
+} SetCacheItem;
+
+/// Settings cache.
+typedef struct {
+    Mutex mutex;
+    u64 ttl;                                ///< TTL in system ticks, 0 when entries only expire on changes.
+    Event dirty_event;                      ///< setsys change notification, when available.
+    bool has_event;
+    u64 poll_tick;                          ///< System tick of the last check of dirty_event.
+
+    SetCacheSlot language_slot;
+    u64 language_code;
+    SetCacheSlot region_slot;
+    SetRegion region;
+    SetCacheItem items[SET_CACHE_MAX_ITEMS];
+} SetCache;
+
+/**
+ * @brief Creates a settings cache. set must be initialized, setsys too for the settings items.
+ * @param[out] c SetCache object.
+ * @param[in] ttl TTL of the cached values in nanoseconds, 0 to keep them until a change is signaled or \ref setCacheInvalidate is used.
+ * @return Result code.
+ * @note When setsys is initialized, the cache binds \ref setsysBindFatalDirtyFlagEvent and drops every value whenever it's signaled. This only covers the settings the system flags as dirty, hence the TTL.
+ */
+Result setCacheCreate(SetCache* c, u64 ttl);
+
+/// Closes a settings cache.
+void setCacheClose(SetCache* c);
+
+/// Drops every cached value.
+void setCacheInvalidate(SetCache* c);
+
+/// Same as \ref setGetSystemLanguage, cached.
+Result setCacheGetSystemLanguage(SetCache* c, u64 *LanguageCode);
+
+/// Same as \ref setGetRegionCode, cached.
+Result setCacheGetRegionCode(SetCache* c, SetRegion *out);
+
+/// Same as \ref setsysGetSettingsItemValue, cached for values of up to \ref SET_CACHE_MAX_VALUE_SIZE bytes.
+Result setCacheGetSettingsItemValue(SetCache* c, const char *name, const char *item_key, void *value_out, size_t value_out_size, u64 *size_out);
+
+/// Reads a boolean (u8) settings item, cached.
+Result setCacheGetSettingsItemFlag(SetCache* c, const char *name, const char *item_key, bool *out);
@@ -136,3 +136,21 @@ Service *smGetServiceSession(void);
  * @param[in] handle IPC session handle.
  */
 void smAddOverrideHandle(SmServiceName name, Handle handle);
+
+/**
+ * @brief Enables the process-wide session cache for a service: \ref smGetServiceWrapper then keeps the session obtained from SM, and hands out clones of it instead of asking SM again.
+ * @param[in] name Name of the service.
+ * @return Result code. LibnxError_OutOfMemory when 32 services are cached already.
+ * @note Clones share the service-side object of the cached session, so only use this for services whose wrappers don't set up per-session state.
+ *       The cached session counts against the session limit of the service. It's kept across \ref smExit, until invalidated.
+ */
+Result smServiceCacheEnable(SmServiceName name);
+
+/// Disables the session cache for a service, closing its cached session.
+void smServiceCacheDisable(SmServiceName name);
+
+/// Closes the cached session of a service, so that the next \ref smGetServiceWrapper asks SM again.
+void smServiceCacheInvalidate(SmServiceName name);
+
+/// Closes all cached sessions, e.g. before an applet transition which restarts services.
+void smServiceCacheInvalidateAll(void);
@@ -7,9 +7,13 @@
 #pragma once
 #include "../types.h"
 #include "../kernel/event.h"
+#include "../sf/async_dispatch.h"
 
 #define SPL_RSA_BUFFER_SIZE (0x100)
 
+/// Maximum number of ExpMod requests kept in flight by \ref splUserRsa2048PssSha256VerifyBatch.
+#define SPL_RSA_BATCH_DEPTH (4)
+
 typedef enum {
     SplConfigItem_DisableProgramVerification = 1,
     SplConfigItem_DramId = 2,
@@ -91,6 +95,31 @@ Service* splManuGetServiceSession(void);
 
 Result splGetConfig(SplConfigItem config_item, u64 *out_config);
 Result splUserExpMod(const void *input, const void *modulus, const void *exp, size_t exp_size, void *dst);
+
+/**
+ * @brief Asynchronous version of \ref splUserExpMod, finished with \ref sfasyncEnd.
+ * @note All buffers must remain valid until the request is finished, dst is written when the reply is received.
+ */
+Result splUserExpModAsync(SfAsyncRequest *r, const void *input, const void *modulus, const void *exp, size_t exp_size, void *dst);
+
+/// RSA-2048-PSS-SHA256 signature verification request, see \ref splUserRsa2048PssSha256VerifyBatch.
+typedef struct {
+    const void *signature;  ///< Signature, \ref SPL_RSA_BUFFER_SIZE bytes.
+    const void *modulus;    ///< Public modulus, \ref SPL_RSA_BUFFER_SIZE bytes. The public exponent is 65537.
+    const void *msg_hash;   ///< SHA256 of the signed message.
+    bool valid;             ///< [out] Whether the signature is valid.
+} SplRsaPssVerifyRequest;
+
+/**
+ * @brief Verifies a batch of RSA-2048-PSS-SHA256 signatures (MGF1-SHA256, 0x20-byte salt).
+ * @param reqs Requests, the valid field of each is set on return.
+ * @param[in] count Number of requests.
+ * @param[in] local Verify locally with \ref rsa2048PssSha256Verify instead of using spl. This is much cheaper than the IPC for public-exponent verification.
+ * @note Through spl, up to \ref SPL_RSA_BATCH_DEPTH ExpMod requests are pipelined on a dedicated clone of the session, while the PSS encoding of completed ones is checked locally.
+ * @return Result code. On failure, requests which were not processed are marked invalid.
+ */
+Result splUserRsa2048PssSha256VerifyBatch(SplRsaPssVerifyRequest *reqs, size_t count, bool local);
+
 Result splSetConfig(SplConfigItem config_item, u64 value);
 Result splGetRandomBytes(void *out, size_t out_size);
 Result splIsDevelopment(bool *out_is_development);
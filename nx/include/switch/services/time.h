@@ -63,6 +63,9 @@ Result timeInitialize(void);
 /// Exit time. Used automatically during app startup.
 void timeExit(void);
 
+/// Defers \ref timeInitialize to the first use of the time service sessions, unless it's already initialized. Used automatically during app startup when __nx_appinit_lazy is set.
+void timeInitializeLazy(void);
+
 /// Gets the Service object for the actual time service session.
 Service* timeGetServiceSession(void);
 
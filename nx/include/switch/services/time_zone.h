@@ -0,0 +1,45 @@
+/**
+ * @file time_zone.h
+ * @brief In-process time-zone conversion: the \ref TimeZoneRule is loaded once, then timestamps are converted locally without IPC.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include <time.h>
+#include "../types.h"
+#include "../result.h"
+#include "time.h"
+
+/// Time-zone converter.
+typedef struct {
+    TimeZoneRule* rule;         ///< Rule loaded with \ref timeLoadTimeZoneRule.
+    TimeLocationName name;      ///< Location of the rule.
+    bool device;                ///< Whether the rule is the one of the device location.
+    bool local;                 ///< Whether the rule could be parsed. Otherwise, the conversions use \ref timeToCalendarTime with the cached rule.
+} TimeZoneConverter;
+
+/**
+ * @brief Creates a converter: loads the rule of a location with \ref timeLoadTimeZoneRule.
+ * @param[out] c TimeZoneConverter object.
+ * @param[in] name Location, NULL for the device location (the rule used by \ref timeToCalendarTimeWithMyRule).
+ * @return Result code.
+ * @note The rule is not updated when the device location changes afterwards: use \ref timeZoneConverterReload for that.
+ */
+Result timeZoneConverterCreate(TimeZoneConverter* c, const TimeLocationName* name);
+
+/// Loads the rule again, e.g. after the device location changed. The location which was passed to \ref timeZoneConverterCreate is kept, unless it was NULL.
+Result timeZoneConverterReload(TimeZoneConverter* c);
+
+/// Closes a converter.
+void timeZoneConverterClose(TimeZoneConverter* c);
+
+/**
+ * @brief Converts a POSIX UTC timestamp to local time, like \ref timeToCalendarTime.
+ * @param[in] timestamp POSIX UTC timestamp.
+ * @param[out] caltime \ref TimeCalendarTime, optional.
+ * @param[out] info \ref TimeCalendarAdditionalInfo, optional.
+ * @return Result code.
+ */
+Result timeZoneConverterToCalendarTime(TimeZoneConverter* c, u64 timestamp, TimeCalendarTime* caltime, TimeCalendarAdditionalInfo* info);
+
+/// Converts a time_t to local time, like localtime_r. Returns NULL on failure.
+struct tm* timeZoneConverterLocaltime(TimeZoneConverter* c, const time_t* timep, struct tm* result);
@@ -229,3 +229,22 @@ void usbHsEpClose(UsbHsClientEpSession* s);
 /// Uses a data transfer with the specified endpoint, this will block until the transfer finishes. The buffer address and size should be aligned to 0x1000-bytes, where the input size is the original size.
 Result usbHsEpPostBuffer(UsbHsClientEpSession* s, void* buffer, u32 size, u32* transferredSize);
 
+/**
+ * @brief Starts a data transfer with the specified endpoint, without waiting for it. [2.0.0+]
+ * @note eventXfer is signaled when it finishes, then use \ref usbHsEpGetXferReport. The buffer address and size should be aligned to 0x1000-bytes, where the input size is the original size.
+ * @param[in] s The endpoint object.
+ * @param[in] buffer Buffer, which must stay valid until the transfer finished.
+ * @param[in] size Size of the transfer.
+ * @param[in] unk Unknown, 0 is used by \ref usbHsEpPostBuffer.
+ * @param[out] xferId Output transfer ID, as in \ref UsbHsXferReport.
+ */
+Result usbHsEpPostBufferAsync(UsbHsClientEpSession* s, void* buffer, u32 size, u64 unk, u32* xferId);
+
+/**
+ * @brief Gets the reports of the finished transfers started with \ref usbHsEpPostBufferAsync, which aren't reported again afterwards. [2.0.0+]
+ * @param[in] s The endpoint object.
+ * @param[out] reports Output reports.
+ * @param[in] max_reports Maximum number of output reports.
+ * @param[out] count Number of output reports.
+ */
+Result usbHsEpGetXferReport(UsbHsClientEpSession* s, UsbHsXferReport* reports, u32 max_reports, u32* count);
@@ -0,0 +1,105 @@
+/**
+ * @file usbhs_stream.h
+ * @brief usb:hs endpoint streaming, keeping several transfers in flight with buffers recycled from a pool.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "../types.h"
+#include "../result.h"
+#include "usbhs.h"
+
+#define USBHS_STREAM_MAX_URBS 16       ///< Maximum number of transfers in flight, same as the maxUrbCount limit of \ref usbHsIfOpenUsbEp.
+#define USBHS_STREAM_MAX_BUFFERS 32    ///< Maximum number of buffers in the pool of a \ref UsbHsEpStream.
+
+/// Transfer posted on a \ref UsbHsEpStream.
+typedef struct {
+    u32 xferId;
+    u32 index;                          ///< Index of the buffer.
+} UsbHsEpStreamXfer;
+
+/// Finished transfer, returned by \ref usbHsEpStreamReap.
+typedef struct {
+    u32 index;                          ///< Index of the buffer, owned by the app until \ref usbHsEpStreamRelease.
+    void* buffer;                       ///< Buffer.
+    Result res;                         ///< Result of the transfer.
+    u32 requestedSize;
+    u32 transferredSize;
+} UsbHsEpStreamCompletion;
+
+/// Endpoint stream object. It must only be used from one thread at a time.
+typedef struct {
+    UsbHsClientEpSession* ep;
+    bool dir_in;                        ///< Whether this is a device->host endpoint.
+    u32 max_urbs;
+    u8* pool;
+    u32 buffer_size;
+    u32 num_buffers;
+    u32 free_mask;                      ///< Bitmask of the buffers in the pool.
+    u32 sizes[USBHS_STREAM_MAX_BUFFERS];     ///< Requested size of each posted buffer.
+    UsbHsEpStreamXfer pending[USBHS_STREAM_MAX_URBS];   ///< Transfers in flight, oldest first.
+    u32 num_pending;
+    UsbHsEpStreamCompletion done[USBHS_STREAM_MAX_BUFFERS]; ///< Finished transfers not reaped yet.
+    u32 num_done;
+} UsbHsEpStream;
+
+/**
+ * @brief Creates an endpoint stream, allocating its buffer pool. [2.0.0+]
+ * @param[out] s UsbHsEpStream object.
+ * @param[in] ep Endpoint, which must stay open while the stream is used.
+ * @param[in] max_urbs Maximum number of transfers in flight, at most the maxUrbCount the endpoint was opened with.
+ * @param[in] buffer_size Size of each buffer, rounded up to 0x1000-bytes. This should be at most the maxXferSize the endpoint was opened with.
+ * @param[in] num_buffers Number of buffers, max_urbs to \ref USBHS_STREAM_MAX_BUFFERS. Buffers beyond max_urbs let the app process data while the endpoint is kept busy.
+ * @return Result code.
+ */
+Result usbHsEpStreamCreate(UsbHsEpStream* s, UsbHsClientEpSession* ep, u32 max_urbs, u32 buffer_size, u32 num_buffers);
+
+/// Closes an endpoint stream, waiting for the transfers in flight to finish. Close the endpoint first to cancel them.
+void usbHsEpStreamClose(UsbHsEpStream* s);
+
+/// Gets the address of a buffer from its index.
+static inline void* usbHsEpStreamGetBuffer(UsbHsEpStream* s, u32 index)
+{
+    return s->pool + (size_t)index * s->buffer_size;
+}
+
+/**
+ * @brief Takes a buffer from the pool, for filling it with data for \ref usbHsEpStreamSubmit.
+ * @param[out] out_index Output buffer index.
+ * @return Result code. LibnxError_OutOfMemory if the pool is empty, reap and release buffers first.
+ */
+Result usbHsEpStreamAcquire(UsbHsEpStream* s, u32* out_index);
+
+/// Gives a buffer back to the pool.
+void usbHsEpStreamRelease(UsbHsEpStream* s, u32 index);
+
+/**
+ * @brief Posts a transfer with a buffer taken from the pool.
+ * @param[in] index Buffer index.
+ * @param[in] size Size of the transfer, at most the buffer size.
+ * @return Result code.
+ * @note When max_urbs transfers are already in flight, this waits for the oldest one. Its completion is then returned by the next \ref usbHsEpStreamReap.
+ */
+Result usbHsEpStreamSubmit(UsbHsEpStream* s, u32 index, u32 size);
+
+/**
+ * @brief Posts transfers of the whole buffer size with the buffers in the pool, until max_urbs transfers are in flight. Meant for device->host streams.
+ * @param[out] out_count Number of transfers posted. Optional.
+ * @return Result code.
+ */
+Result usbHsEpStreamFill(UsbHsEpStream* s, u32* out_count);
+
+/**
+ * @brief Gets the finished transfers, in the order they finished. The reports of all the finished transfers are fetched with a single GetXferReport.
+ * @param[out] out Output completions. Their buffers are owned by the app until \ref usbHsEpStreamRelease.
+ * @param[in] max_out Maximum number of output completions.
+ * @param[in] timeout Timeout in nanoseconds to wait for at least one transfer to finish, 0 to not wait, UINT64_MAX to wait indefinitely.
+ * @param[out] out_count Number of output completions.
+ * @return Result code. KERNELRESULT(TimedOut) if none finished within the timeout.
+ */
+Result usbHsEpStreamReap(UsbHsEpStream* s, UsbHsEpStreamCompletion* out, u32 max_out, u64 timeout, u32* out_count);
+
+/// Returns the number of transfers in flight.
+static inline u32 usbHsEpStreamGetPendingCount(UsbHsEpStream* s)
+{
+    return s->num_pending;
+}
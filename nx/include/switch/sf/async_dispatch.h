@@ -0,0 +1,75 @@
+/**
+ * @file async_dispatch.h
+ * @brief Asynchronous service dispatch with event-driven completion.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "service.h"
+#include "sessionmgr.h"
+#include "../kernel/wait.h"
+
+/// Size of the message buffer used by an asynchronous request.
+#define NX_SF_ASYNC_MSG_SIZE 0x1000
+
+/// Asynchronous request object.
+typedef struct SfAsyncRequest {
+    Service srv;                      ///< Copy of the target service object.
+    SessionMgr* mgr;                  ///< Session manager the session was taken from, or NULL.
+    int slot;                         ///< Session manager slot in use, or -1.
+    Handle event;                     ///< Event signalled by the kernel when the reply is available.
+    void* msg_buffer;                 ///< Page-aligned message buffer.
+    void* out_data;
+    u32 out_data_size;
+    u32 out_num_objects;
+    Service* out_objects;
+    SfOutHandleAttrs out_handle_attrs;
+    Handle* out_handles;
+} SfAsyncRequest;
+
+/**
+ * @brief Sends a request without waiting for the reply. Use the sfasyncBegin* macros instead of calling this directly.
+ * @param[out] r Asynchronous request object.
+ * @param[in] mgr Optional session manager. If the service uses the manager's root session, a pooled session is dedicated to the request until \ref sfasyncEnd, so that other requests are not queued behind it.
+ * @note Output pointers (out data, objects and handles) are written by \ref sfasyncEnd and must remain valid until then. Input data is copied immediately, but input buffers must remain valid until then too.
+ * @return Result code.
+ */
+Result sfasyncBeginImpl(
+    SfAsyncRequest* r, SessionMgr* mgr,
+    Service* s, u32 request_id,
+    const void* in_data, u32 in_data_size,
+    void* out_data, u32 out_data_size,
+    SfDispatchParams disp
+);
+
+/**
+ * @brief Waits for completion of an asynchronous request.
+ * @param[in] r Asynchronous request object.
+ * @param[in] timeout Timeout in nanoseconds.
+ * @return Result code. KERNELRESULT(TimedOut) if the request has not completed yet.
+ */
+Result sfasyncWait(SfAsyncRequest* r, u64 timeout);
+
+/**
+ * @brief Finishes an asynchronous request: waits for the reply if needed, parses it and releases all resources.
+ * @param[in] r Asynchronous request object.
+ * @return Result of the request.
+ */
+Result sfasyncEnd(SfAsyncRequest* r);
+
+/// Creates a \ref Waiter for an asynchronous request, signalled when the reply is available. Call \ref sfasyncEnd afterwards.
+static inline Waiter waiterForSfAsyncRequest(SfAsyncRequest* r)
+{
+    return waiterForHandle(r->event);
+}
+
+#define sfasyncBegin(_r,_mgr,_s,_rid,...) \
+    sfasyncBeginImpl((_r),(_mgr),(_s),(_rid),NULL,0,NULL,0,(SfDispatchParams){ __VA_ARGS__ })
+
+#define sfasyncBeginIn(_r,_mgr,_s,_rid,_in,...) \
+    sfasyncBeginImpl((_r),(_mgr),(_s),(_rid),&(_in),sizeof(_in),NULL,0,(SfDispatchParams){ __VA_ARGS__ })
+
+#define sfasyncBeginOut(_r,_mgr,_s,_rid,_out,...) \
+    sfasyncBeginImpl((_r),(_mgr),(_s),(_rid),NULL,0,&(_out),sizeof(_out),(SfDispatchParams){ __VA_ARGS__ })
+
+#define sfasyncBeginInOut(_r,_mgr,_s,_rid,_in,_out,...) \
+    sfasyncBeginImpl((_r),(_mgr),(_s),(_rid),&(_in),sizeof(_in),&(_out),sizeof(_out),(SfDispatchParams){ __VA_ARGS__ })
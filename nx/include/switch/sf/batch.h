@@ -0,0 +1,80 @@
+/**
+ * @file batch.h
+ * @brief Batched service dispatch: sends several independent requests at once and waits for all of them.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "service.h"
+#include "sessionmgr.h"
+
+/// Maximum number of requests that can be queued in a batch.
+#define NX_SF_BATCH_MAX_REQUESTS 8
+
+/// Size of the per-request message buffer used by a batch.
+#define NX_SF_BATCH_MSG_SIZE 0x1000
+
+/// Queued request within a batch.
+typedef struct SfBatchEntry {
+    Service srv;             ///< Copy of the target service object.
+    u32 request_id;          ///< Command ID.
+    const void* in_data;     ///< Input raw data.
+    u32 in_data_size;        ///< Input raw data size.
+    void* out_data;          ///< Output raw data.
+    u32 out_data_size;       ///< Output raw data size.
+    SfDispatchParams disp;   ///< Dispatch parameters.
+    Result* out_rc;          ///< Optional pointer receiving the result of this request.
+} SfBatchEntry;
+
+/// Batch object.
+typedef struct SfBatch {
+    SessionMgr* mgr;                                ///< Optional session manager used to spread requests over pooled sessions.
+    u8* msg_buffers;                                ///< Page-aligned message buffers, one per request.
+    u32 num_entries;                                ///< Number of queued requests.
+    SfBatchEntry entries[NX_SF_BATCH_MAX_REQUESTS]; ///< Queued requests.
+} SfBatch;
+
+/**
+ * @brief Creates a batch object.
+ * @param[out] b Batch object.
+ * @param[in] mgr Optional session manager. Requests targeting its root session are sent through separate pooled sessions, so that they can be processed in parallel by the server.
+ * @return Result code.
+ */
+Result sfbatchCreate(SfBatch* b, SessionMgr* mgr);
+
+/**
+ * @brief Closes a batch object.
+ * @param[in] b Batch object.
+ */
+void sfbatchClose(SfBatch* b);
+
+/**
+ * @brief Queues a request in a batch. Use the sfbatchAdd* macros instead of calling this directly.
+ * @note The input/output data buffers must remain valid until \ref sfbatchSubmit returns.
+ * @return Result code. Fails with LibnxError_OutOfMemory if the batch is full.
+ */
+Result sfbatchAddImpl(
+    SfBatch* b, Result* out_rc,
+    Service* s, u32 request_id,
+    const void* in_data, u32 in_data_size,
+    void* out_data, u32 out_data_size,
+    SfDispatchParams disp
+);
+
+/**
+ * @brief Sends all queued requests and waits until every one of them has completed, then empties the batch.
+ * @param[in] b Batch object.
+ * @return Result code of the first request that failed, or 0 if all of them succeeded. Individual results are written to the out_rc pointers passed when queueing.
+ */
+Result sfbatchSubmit(SfBatch* b);
+
+#define sfbatchAdd(_b,_rc,_s,_rid,...) \
+    sfbatchAddImpl((_b),(_rc),(_s),(_rid),NULL,0,NULL,0,(SfDispatchParams){ __VA_ARGS__ })
+
+#define sfbatchAddIn(_b,_rc,_s,_rid,_in,...) \
+    sfbatchAddImpl((_b),(_rc),(_s),(_rid),&(_in),sizeof(_in),NULL,0,(SfDispatchParams){ __VA_ARGS__ })
+
+#define sfbatchAddOut(_b,_rc,_s,_rid,_out,...) \
+    sfbatchAddImpl((_b),(_rc),(_s),(_rid),NULL,0,&(_out),sizeof(_out),(SfDispatchParams){ __VA_ARGS__ })
+
+#define sfbatchAddInOut(_b,_rc,_s,_rid,_in,_out,...) \
+    sfbatchAddImpl((_b),(_rc),(_s),(_rid),&(_in),sizeof(_in),&(_out),sizeof(_out),(SfDispatchParams){ __VA_ARGS__ })
@@ -0,0 +1,182 @@
+/**
+ * @file server.h
+ * @brief CMIF server framework: multi-session, multi-threaded request dispatch loop.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "hipc.h"
+#include "cmif.h"
+#include "../kernel/mutex.h"
+#include "../services/sm.h"
+
+/// Maximum number of ports and sessions a server manager can wait on (one kernel wait slot is left free).
+#define NX_SERVER_MAX_ENTRIES 63
+
+/// Maximum number of objects in a domain session.
+#define NX_SERVER_MAX_DOMAIN_OBJECTS 64
+
+/// Maximum number of output objects/handles per request.
+#define NX_SERVER_MAX_OUT_ITEMS 8
+
+/// Maximum size of the raw output data of a request.
+#define NX_SERVER_MAX_OUT_DATA_SIZE 0x100
+
+/// Size of the message buffer used by each worker.
+#define NX_SERVER_MSG_BUFFER_SIZE 0x1000
+
+typedef struct ServerManager ServerManager;
+typedef struct ServerRequest ServerRequest;
+
+/// Command handler. userdata is the userdata of the object the command was sent to.
+typedef Result (*ServerCommandHandler)(void* userdata, ServerRequest* req);
+
+/// Entry of a command table.
+typedef struct ServerCommand {
+    u32 cmd_id;                   ///< Command ID.
+    ServerCommandHandler handler; ///< Handler.
+} ServerCommand;
+
+/// Interface (command table) implemented by a server object.
+typedef struct ServerInterface {
+    const ServerCommand* cmds;    ///< Command table.
+    u32 num_cmds;                 ///< Number of entries in the command table.
+    void (*close)(void* userdata); ///< Optional callback invoked when a reference to an object using this interface is closed. Cloned sessions hold separate references.
+} ServerInterface;
+
+/// Server object: an interface plus its instance data.
+typedef struct ServerObject {
+    const ServerInterface* iface;
+    void* userdata;
+} ServerObject;
+
+/// Domain object table, shared by all sessions cloned from a domain session.
+typedef struct ServerDomain {
+    u32 refcount;
+    Mutex mutex;
+    ServerObject objects[NX_SERVER_MAX_DOMAIN_OBJECTS]; ///< Indexed by object ID minus one.
+} ServerDomain;
+
+/// Waitable entry (port or session) of a server manager.
+typedef struct ServerEntry {
+    Handle handle;
+    bool is_port;
+    bool is_busy;
+    ServerObject object;  ///< For ports: object given to accepted sessions. For non-domain sessions: the session object.
+    ServerDomain* domain; ///< For domain sessions: the domain object table.
+} ServerEntry;
+
+/// Server manager.
+struct ServerManager {
+    Mutex list_mutex;
+    Mutex wait_mutex;
+    Handle waiter_thread;
+    bool should_exit;
+    u16 pointer_buffer_size;
+    u32 num_entries;
+    ServerEntry entries[NX_SERVER_MAX_ENTRIES];
+};
+
+/// Request being processed by a command handler.
+struct ServerRequest {
+    ServerManager* mgr;
+    ServerEntry* entry;
+    u32 object_id;                 ///< Domain object ID the request targets, or 0 for non-domain sessions.
+    u32 cmd_id;                    ///< Command ID.
+    u64 pid;                       ///< Client process ID, if sent by the client.
+    HipcParsedRequest hipc;        ///< Parsed HIPC request (buffers, statics, handles).
+    const void* in_data;           ///< Raw input data.
+    u32 in_data_size;              ///< Size of the raw input data area (may include trailing padding).
+    u32 num_in_objects;            ///< Number of input domain objects.
+    const u32* in_object_ids;      ///< Input domain object IDs.
+
+    u32 out_data_size;             ///< Size of the raw output data.
+    u32 num_out_objects;
+    u32 num_out_copy_handles;
+    u32 num_out_move_handles;
+    ServerObject out_objects[NX_SERVER_MAX_OUT_ITEMS];
+    Handle out_copy_handles[NX_SERVER_MAX_OUT_ITEMS];
+    Handle out_move_handles[NX_SERVER_MAX_OUT_ITEMS];
+    u8 out_data[NX_SERVER_MAX_OUT_DATA_SIZE] __attribute__((aligned(8)));
+};
+
+/**
+ * @brief Creates a server manager.
+ * @param[out] mgr Server manager.
+ * @param[in] pointer_buffer_size Size of the per-worker pointer buffer used to receive type-X (in pointer) buffers, or 0.
+ * @return Result code.
+ */
+Result servermgrCreate(ServerManager* mgr, u16 pointer_buffer_size);
+
+/**
+ * @brief Closes a server manager, closing all of its ports and sessions.
+ * @note No worker may be running when this is called.
+ */
+void servermgrClose(ServerManager* mgr);
+
+/// Adds a server port. Every session accepted on it uses the specified object.
+Result servermgrAddPort(ServerManager* mgr, Handle port, const ServerInterface* iface, void* userdata);
+
+/// Registers a service with sm and adds its port to the manager.
+Result servermgrRegisterService(ServerManager* mgr, SmServiceName name, s32 max_sessions, const ServerInterface* iface, void* userdata);
+
+/// Adds an already established server session.
+Result servermgrAddSession(ServerManager* mgr, Handle session, const ServerInterface* iface, void* userdata);
+
+/**
+ * @brief Waits for and processes a single event (new connection or request).
+ * @param[in] mgr Server manager.
+ * @param[in] msg_buffer Page-aligned message buffer of \ref NX_SERVER_MSG_BUFFER_SIZE bytes, private to the calling thread.
+ * @param[in] pointer_buffer Pointer buffer of mgr->pointer_buffer_size bytes, private to the calling thread (may be NULL if the size is 0).
+ * @param[in] timeout Timeout in nanoseconds.
+ * @return Result code. KERNELRESULT(TimedOut) on timeout, KERNELRESULT(Cancelled) if the manager was woken up without an event (e.g. after \ref servermgrRequestExit).
+ * @note Can be called by several threads at once: only one of them waits for events at a time, and the others process requests in parallel.
+ */
+Result servermgrProcess(ServerManager* mgr, void* msg_buffer, void* pointer_buffer, u64 timeout);
+
+/**
+ * @brief Runs the request loop on the calling thread until \ref servermgrRequestExit is called.
+ * @note Run this from as many threads as the server should use.
+ */
+Result servermgrLoop(ServerManager* mgr);
+
+/// Makes all running \ref servermgrLoop calls return.
+void servermgrRequestExit(ServerManager* mgr);
+
+/// Gets an input domain object. Returns false if the index or object ID is invalid.
+bool serverreqGetInObject(ServerRequest* req, u32 idx, ServerObject* out);
+
+/// Reserves space for raw output data and returns a pointer to it, or NULL if too large.
+NX_INLINE void* serverreqAllocOutData(ServerRequest* req, u32 size)
+{
+    if (size > NX_SERVER_MAX_OUT_DATA_SIZE)
+        return NULL;
+    req->out_data_size = size;
+    return req->out_data;
+}
+
+/// Adds an output object. In domain sessions it becomes a new domain object, otherwise a new session.
+NX_INLINE Result serverreqAddOutObject(ServerRequest* req, const ServerInterface* iface, void* userdata)
+{
+    if (req->num_out_objects >= NX_SERVER_MAX_OUT_ITEMS)
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+    req->out_objects[req->num_out_objects++] = (ServerObject){ iface, userdata };
+    return 0;
+}
+
+/// Adds an output copy handle.
+NX_INLINE Result serverreqAddCopyHandle(ServerRequest* req, Handle h)
+{
+    if (req->num_out_copy_handles >= NX_SERVER_MAX_OUT_ITEMS)
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+    req->out_copy_handles[req->num_out_copy_handles++] = h;
+    return 0;
+}
+
+/// Adds an output move handle.
+NX_INLINE Result serverreqAddMoveHandle(ServerRequest* req, Handle h)
+{
+    if (req->num_out_move_handles + req->num_out_objects >= NX_SERVER_MAX_OUT_ITEMS)
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+    req->out_move_handles[req->num_out_move_handles++] = h;
+    return 0;
+}
@@ -8,6 +8,9 @@
 #pragma once
 #include "hipc.h"
 #include "cmif.h"
+#include "trace.h"
+#include "../runtime/trace.h"
+#include "../runtime/flight_recorder.h"
 
 /// Service object structure
 typedef struct Service {
@@ -322,23 +325,20 @@ NX_CONSTEXPR void _serviceRequestProcessBuffer(CmifRequest* req, const SfBuffer*
     }
 }
 
-NX_INLINE void* serviceMakeRequest(
-    Service* s, u32 request_id, u32 context, u32 data_size, bool send_pid,
-    const SfBufferAttrs buffer_attrs, const SfBuffer* buffers,
-    u32 num_objects, const Service* const* objects,
-    u32 num_handles, const Handle* handles
+/**
+ * @brief Computes the CMIF request format for a request.
+ * @note All inputs are usually compile-time constants (buffer attributes in particular), in which case the whole format folds into constants. In C++14 and above this can be evaluated in a constexpr context, for example to precompute the format of a fixed-shape command and pass it to \ref serviceMakeRequestWithFormat.
+ */
+NX_CONSTEXPR CmifRequestFormat serviceMakeRequestFormat(
+    u32 object_id, u16 pointer_buffer_size, u32 request_id, u32 context, u32 data_size, bool send_pid,
+    const SfBufferAttrs buffer_attrs, u32 num_objects, u32 num_handles
 ) {
-#if defined(NX_SERVICE_ASSUME_NON_DOMAIN)
-    if (s->object_id)
-        __builtin_unreachable();
-#endif
-
     CmifRequestFormat fmt = {};
-    fmt.object_id = s->object_id;
+    fmt.object_id = object_id;
     fmt.request_id = request_id;
     fmt.context = context;
     fmt.data_size = data_size;
-    fmt.server_pointer_size = s->pointer_buffer_size;
+    fmt.server_pointer_size = pointer_buffer_size;
     fmt.num_objects = num_objects;
     fmt.num_handles = num_handles;
     fmt.send_pid = send_pid;
@@ -352,7 +352,26 @@ NX_INLINE void* serviceMakeRequest(
     _serviceRequestFormatProcessBuffer(&fmt, buffer_attrs.attr6);
     _serviceRequestFormatProcessBuffer(&fmt, buffer_attrs.attr7);
 
-    CmifRequest req = cmifMakeRequest(armGetTls(), fmt);
+    return fmt;
+}
+
+/**
+ * @brief Writes a request with an already computed format.
+ * @note fmt must have been computed by \ref serviceMakeRequestFormat with the same buffer attributes, object count and handle count.
+ * @return Pointer to the raw input data area.
+ */
+NX_INLINE void* serviceMakeRequestWithFormat(
+    void* base, Service* s, const CmifRequestFormat fmt,
+    const SfBufferAttrs buffer_attrs, const SfBuffer* buffers,
+    u32 num_objects, const Service* const* objects,
+    u32 num_handles, const Handle* handles
+) {
+#if defined(NX_SERVICE_ASSUME_NON_DOMAIN)
+    if (s->object_id)
+        __builtin_unreachable();
+#endif
+
+    CmifRequest req = cmifMakeRequest(base, fmt);
 
     if (s->object_id) // TODO: Check behavior of input objects in non-domain sessions
         for (u32 i = 0; i < num_objects; i ++)
@@ -373,6 +392,34 @@ NX_INLINE void* serviceMakeRequest(
     return req.data;
 }
 
+NX_INLINE void* serviceMakeRequestEx(
+    void* base, Service* s, u32 request_id, u32 context, u32 data_size, bool send_pid,
+    const SfBufferAttrs buffer_attrs, const SfBuffer* buffers,
+    u32 num_objects, const Service* const* objects,
+    u32 num_handles, const Handle* handles
+) {
+#if defined(NX_SERVICE_ASSUME_NON_DOMAIN)
+    if (s->object_id)
+        __builtin_unreachable();
+#endif
+
+    const CmifRequestFormat fmt = serviceMakeRequestFormat(s->object_id, s->pointer_buffer_size,
+        request_id, context, data_size, send_pid, buffer_attrs, num_objects, num_handles);
+
+    return serviceMakeRequestWithFormat(base, s, fmt, buffer_attrs, buffers,
+        num_objects, objects, num_handles, handles);
+}
+
+NX_INLINE void* serviceMakeRequest(
+    Service* s, u32 request_id, u32 context, u32 data_size, bool send_pid,
+    const SfBufferAttrs buffer_attrs, const SfBuffer* buffers,
+    u32 num_objects, const Service* const* objects,
+    u32 num_handles, const Handle* handles
+) {
+    return serviceMakeRequestEx(armGetTls(), s, request_id, context, data_size, send_pid,
+        buffer_attrs, buffers, num_objects, objects, num_handles, handles);
+}
+
 NX_CONSTEXPR void _serviceResponseGetHandle(CmifResponse* res, SfOutHandleAttr type, Handle* out)
 {
     switch (type) {
@@ -388,8 +435,8 @@ NX_CONSTEXPR void _serviceResponseGetHandle(CmifResponse* res, SfOutHandleAttr t
     }
 }
 
-NX_INLINE Result serviceParseResponse(
-    Service* s, u32 out_size, void** out_data,
+NX_INLINE Result serviceParseResponseEx(
+    void* base, Service* s, u32 out_size, void** out_data,
     u32 num_out_objects, Service* out_objects,
     const SfOutHandleAttrs out_handle_attrs, Handle* out_handles
 ) {
@@ -400,7 +447,7 @@ NX_INLINE Result serviceParseResponse(
 
     CmifResponse res = {};
     bool is_domain = s->object_id != 0;
-    Result rc = cmifParseResponse(&res, armGetTls(), is_domain, out_size);
+    Result rc = cmifParseResponse(&res, base, is_domain, out_size);
     if (R_FAILED(rc))
         return rc;
 
@@ -426,7 +473,23 @@ NX_INLINE Result serviceParseResponse(
     return 0;
 }
 
-NX_INLINE Result serviceDispatchImpl(
+NX_INLINE Result serviceParseResponse(
+    Service* s, u32 out_size, void** out_data,
+    u32 num_out_objects, Service* out_objects,
+    const SfOutHandleAttrs out_handle_attrs, Handle* out_handles
+) {
+    return serviceParseResponseEx(armGetTls(), s, out_size, out_data,
+        num_out_objects, out_objects, out_handle_attrs, out_handles);
+}
+
+/**
+ * @brief Dispatches a request, marshalling the message in the specified buffer instead of TLS.
+ * @param[in] base Message buffer. When base_size is non-zero it must be page-aligned and base_size must be a multiple of the page size.
+ * @param[in] base_size Size of the message buffer, or 0 if base points to this thread's TLS.
+ * @note Use the serviceDispatchWithUserBuffer* macros instead of calling this directly.
+ */
+NX_INLINE Result serviceDispatchImplEx(
+    void* base, size_t base_size,
     Service* s, u32 request_id,
     const void* in_data, u32 in_data_size,
     void* out_data, u32 out_data_size,
@@ -436,7 +499,7 @@ NX_INLINE Result serviceDispatchImpl(
     // Make a copy of the service struct, so that the compiler can assume that it won't be modified by function calls.
     Service srv = *s;
 
-    void* in = serviceMakeRequest(&srv, request_id, disp.context,
+    void* in = serviceMakeRequestEx(base, &srv, request_id, disp.context,
         in_data_size, disp.in_send_pid,
         disp.buffer_attrs, disp.buffers,
         disp.in_num_objects, disp.in_objects,
@@ -445,10 +508,17 @@ NX_INLINE Result serviceDispatchImpl(
     if (in_data_size)
         __builtin_memcpy(in, in_data, in_data_size);
 
-    Result rc = svcSendSyncRequest(disp.target_session == INVALID_HANDLE ? s->session : disp.target_session);
+#if defined(NX_SF_TRACE)
+    u64 trace_start = sftraceIsEnabled() ? armGetSystemTick() : 0;
+#endif
+
+    traceBegin("serviceDispatch");
+
+    Handle session = disp.target_session == INVALID_HANDLE ? s->session : disp.target_session;
+    Result rc = base_size ? svcSendSyncRequestWithUserBuffer(base, base_size, session) : svcSendSyncRequest(session);
     if (R_SUCCEEDED(rc)) {
         void* out = NULL;
-        rc = serviceParseResponse(&srv,
+        rc = serviceParseResponseEx(base, &srv,
             out_data_size, &out,
             disp.out_num_objects, disp.out_objects,
             disp.out_handle_attrs, disp.out_handles);
@@ -457,9 +527,30 @@ NX_INLINE Result serviceDispatchImpl(
             __builtin_memcpy(out_data, out, out_data_size);
     }
 
+    traceEnd();
+
+#if defined(NX_SF_TRACE)
+    if (trace_start)
+        sftraceRecord(srv.session, srv.object_id, request_id, rc, trace_start, armGetSystemTick());
+#endif
+
+#if defined(NX_FLIGHT_RECORDER)
+    flightRecorderRecordIpc(srv.session, srv.object_id, request_id, rc);
+#endif
+
     return rc;
 }
 
+NX_INLINE Result serviceDispatchImpl(
+    Service* s, u32 request_id,
+    const void* in_data, u32 in_data_size,
+    void* out_data, u32 out_data_size,
+    SfDispatchParams disp
+)
+{
+    return serviceDispatchImplEx(armGetTls(), 0, s, request_id, in_data, in_data_size, out_data, out_data_size, disp);
+}
+
 #define serviceDispatch(_s,_rid,...) \
     serviceDispatchImpl((_s),(_rid),NULL,0,NULL,0,(SfDispatchParams){ __VA_ARGS__ })
 
@@ -471,3 +562,15 @@ NX_INLINE Result serviceDispatchImpl(
 
 #define serviceDispatchInOut(_s,_rid,_in,_out,...) \
     serviceDispatchImpl((_s),(_rid),&(_in),sizeof(_in),&(_out),sizeof(_out),(SfDispatchParams){ __VA_ARGS__ })
+
+#define serviceDispatchWithUserBuffer(_s,_buf,_bufsize,_rid,...) \
+    serviceDispatchImplEx((_buf),(_bufsize),(_s),(_rid),NULL,0,NULL,0,(SfDispatchParams){ __VA_ARGS__ })
+
+#define serviceDispatchWithUserBufferIn(_s,_buf,_bufsize,_rid,_in,...) \
+    serviceDispatchImplEx((_buf),(_bufsize),(_s),(_rid),&(_in),sizeof(_in),NULL,0,(SfDispatchParams){ __VA_ARGS__ })
+
+#define serviceDispatchWithUserBufferOut(_s,_buf,_bufsize,_rid,_out,...) \
+    serviceDispatchImplEx((_buf),(_bufsize),(_s),(_rid),NULL,0,&(_out),sizeof(_out),(SfDispatchParams){ __VA_ARGS__ })
+
+#define serviceDispatchWithUserBufferInOut(_s,_buf,_bufsize,_rid,_in,_out,...) \
+    serviceDispatchImplEx((_buf),(_bufsize),(_s),(_rid),&(_in),sizeof(_in),&(_out),sizeof(_out),(SfDispatchParams){ __VA_ARGS__ })
@@ -0,0 +1,481 @@
+/**
+ * @file service.hpp
+ * @brief Optional header-only C++17 layer: commands as typed signatures marshalled with a compile-time CMIF request format, and move-only RAII wrappers for Service, Event and fs objects.
+ * @note This isn't included by switch.h, include it after switch.h from C++ code.
+ * @copyright libnx Authors
+ */
+#pragma once
+#if !defined(__cplusplus) || __cplusplus < 201703L
+#error "sf/service.hpp requires C++17"
+#endif
+
+#include <type_traits>
+#include <utility>
+#include "../types.h"
+#include "../result.h"
+#include "../kernel/svc.h"
+#include "../kernel/event.h"
+#include "../services/sm.h"
+#include "../services/fs.h"
+#include "service.h"
+
+namespace nx {
+namespace sf {
+
+/// Buffer argument of a command, Attr being a combination of SfBufferAttr flags.
+template<u32 Attr>
+struct Buffer {
+    const void* ptr;
+    size_t size;
+
+    constexpr Buffer(const void* ptr, size_t size) : ptr(ptr), size(size) {}
+
+    /// Buffer covering an object.
+    template<typename T, typename = std::enable_if_t<!std::is_pointer_v<T>>>
+    constexpr Buffer(T& obj) : ptr(&obj), size(sizeof(T)) {}
+};
+
+using InMapAlias     = Buffer<SfBufferAttr_In  | SfBufferAttr_HipcMapAlias>;       ///< Input map-alias buffer.
+using OutMapAlias    = Buffer<SfBufferAttr_Out | SfBufferAttr_HipcMapAlias>;       ///< Output map-alias buffer.
+using InPointer      = Buffer<SfBufferAttr_In  | SfBufferAttr_HipcPointer>;        ///< Input pointer buffer.
+using OutPointer     = Buffer<SfBufferAttr_Out | SfBufferAttr_HipcPointer>;        ///< Output pointer buffer.
+using InAutoSelect   = Buffer<SfBufferAttr_In  | SfBufferAttr_HipcAutoSelect>;     ///< Input auto-select buffer.
+using OutAutoSelect  = Buffer<SfBufferAttr_Out | SfBufferAttr_HipcAutoSelect>;     ///< Output auto-select buffer.
+
+/// Output raw data argument of a command.
+template<typename T>
+struct Out {
+    static_assert(std::is_trivially_copyable_v<T>, "Out<T> requires a trivially copyable type");
+    T* ptr;
+
+    constexpr Out(T* ptr) : ptr(ptr) {}
+    constexpr Out(T& ref) : ptr(&ref) {}
+};
+
+/// Input copy handle argument of a command.
+struct InHandle {
+    Handle handle;
+    constexpr InHandle(Handle handle) : handle(handle) {}
+};
+
+/// Output handle argument of a command.
+template<SfOutHandleAttr Attr>
+struct OutHandle {
+    Handle* ptr;
+    constexpr OutHandle(Handle* ptr) : ptr(ptr) {}
+    constexpr OutHandle(Handle& ref) : ptr(&ref) {}
+};
+
+using OutCopyHandle = OutHandle<SfOutHandleAttr_HipcCopy>;  ///< Output copy handle.
+using OutMoveHandle = OutHandle<SfOutHandleAttr_HipcMove>;  ///< Output move handle.
+
+/// Input object argument of a command.
+struct InObject {
+    const ::Service* srv;
+    constexpr InObject(const ::Service* srv) : srv(srv) {}
+};
+
+/// Output object argument of a command.
+struct OutObject {
+    ::Service* srv;
+    constexpr OutObject(::Service* srv) : srv(srv) {}
+};
+
+/// Argument which sends the process id of the client.
+struct SendPid {};
+
+/// @cond INTERNAL
+namespace impl {
+
+enum class ArgKind { InData, OutData, Buffer, InHandle, OutHandle, InObject, OutObject, SendPid };
+
+template<typename T> struct ArgTraits {
+    static_assert(std::is_trivially_copyable_v<T>, "input data arguments must be trivially copyable");
+    static constexpr ArgKind kind = ArgKind::InData;
+    static constexpr size_t size = sizeof(T), align = alignof(T);
+    static constexpr u32 attr = 0;
+};
+template<typename T> struct ArgTraits<Out<T>> {
+    static constexpr ArgKind kind = ArgKind::OutData;
+    static constexpr size_t size = sizeof(T), align = alignof(T);
+    static constexpr u32 attr = 0;
+};
+template<u32 Attr> struct ArgTraits<Buffer<Attr>> {
+    static constexpr ArgKind kind = ArgKind::Buffer;
+    static constexpr size_t size = 0, align = 1;
+    static constexpr u32 attr = Attr;
+};
+template<SfOutHandleAttr Attr> struct ArgTraits<OutHandle<Attr>> {
+    static constexpr ArgKind kind = ArgKind::OutHandle;
+    static constexpr size_t size = 0, align = 1;
+    static constexpr u32 attr = Attr;
+};
+template<> struct ArgTraits<InHandle>  { static constexpr ArgKind kind = ArgKind::InHandle;  static constexpr size_t size = 0, align = 1; static constexpr u32 attr = 0; };
+template<> struct ArgTraits<InObject>  { static constexpr ArgKind kind = ArgKind::InObject;  static constexpr size_t size = 0, align = 1; static constexpr u32 attr = 0; };
+template<> struct ArgTraits<OutObject> { static constexpr ArgKind kind = ArgKind::OutObject; static constexpr size_t size = 0, align = 1; static constexpr u32 attr = 0; };
+template<> struct ArgTraits<SendPid>   { static constexpr ArgKind kind = ArgKind::SendPid;   static constexpr size_t size = 0, align = 1; static constexpr u32 attr = 0; };
+
+constexpr void SetBufferAttr(SfBufferAttrs& attrs, u32 i, u32 attr) {
+    u32* const slots[8] = { &attrs.attr0, &attrs.attr1, &attrs.attr2, &attrs.attr3, &attrs.attr4, &attrs.attr5, &attrs.attr6, &attrs.attr7 };
+    *slots[i] = attr;
+}
+
+constexpr void SetOutHandleAttr(SfOutHandleAttrs& attrs, u32 i, SfOutHandleAttr attr) {
+    SfOutHandleAttr* const slots[8] = { &attrs.attr0, &attrs.attr1, &attrs.attr2, &attrs.attr3, &attrs.attr4, &attrs.attr5, &attrs.attr6, &attrs.attr7 };
+    *slots[i] = attr;
+}
+
+/// Marshalling layout of a command signature, computed at compile time.
+template<typename... Args>
+struct Layout {
+    static constexpr size_t N = sizeof...(Args);
+
+    struct Info {
+        u32 offsets[N + 1] = {};    // Offset in the input/output data, or index within the argument kind.
+        u32 in_size = 0;
+        u32 out_size = 0;
+        SfBufferAttrs buffer_attrs = {};
+        SfOutHandleAttrs out_handle_attrs = {};
+        u32 num_buffers = 0;
+        u32 num_in_handles = 0;
+        u32 num_out_handles = 0;
+        u32 num_in_objects = 0;
+        u32 num_out_objects = 0;
+        bool send_pid = false;
+    };
+
+    static constexpr Info Compute() {
+        constexpr ArgKind kinds[N + 1] = { ArgTraits<Args>::kind..., ArgKind::SendPid };
+        constexpr size_t sizes[N + 1] = { ArgTraits<Args>::size..., 0 };
+        constexpr size_t aligns[N + 1] = { ArgTraits<Args>::align..., 1 };
+        constexpr u32 attrs[N + 1] = { ArgTraits<Args>::attr..., 0 };
+        Info info = {};
+
+        // Raw data is laid out like the structs used with serviceDispatchIn/Out: in order, naturally aligned.
+        for (size_t i = 0; i < N; i++) {
+            switch (kinds[i]) {
+                case ArgKind::InData:
+                    info.in_size = (info.in_size + aligns[i] - 1) & ~(aligns[i] - 1);
+                    info.offsets[i] = info.in_size;
+                    info.in_size += sizes[i];
+                    break;
+                case ArgKind::OutData:
+                    info.out_size = (info.out_size + aligns[i] - 1) & ~(aligns[i] - 1);
+                    info.offsets[i] = info.out_size;
+                    info.out_size += sizes[i];
+                    break;
+                case ArgKind::Buffer:
+                    SetBufferAttr(info.buffer_attrs, info.num_buffers, attrs[i]);
+                    info.offsets[i] = info.num_buffers++;
+                    break;
+                case ArgKind::OutHandle:
+                    SetOutHandleAttr(info.out_handle_attrs, info.num_out_handles, (SfOutHandleAttr)attrs[i]);
+                    info.offsets[i] = info.num_out_handles++;
+                    break;
+                case ArgKind::InHandle:
+                    info.offsets[i] = info.num_in_handles++;
+                    break;
+                case ArgKind::InObject:
+                    info.offsets[i] = info.num_in_objects++;
+                    break;
+                case ArgKind::OutObject:
+                    info.offsets[i] = info.num_out_objects++;
+                    break;
+                case ArgKind::SendPid:
+                    info.send_pid = true;
+                    break;
+            }
+        }
+
+        // Like sizeof of the equivalent struct, padded to the largest alignment.
+        size_t in_align = 1, out_align = 1;
+        for (size_t i = 0; i < N; i++) {
+            if (kinds[i] == ArgKind::InData && aligns[i] > in_align)
+                in_align = aligns[i];
+            if (kinds[i] == ArgKind::OutData && aligns[i] > out_align)
+                out_align = aligns[i];
+        }
+        info.in_size = (info.in_size + in_align - 1) & ~(in_align - 1);
+        info.out_size = (info.out_size + out_align - 1) & ~(out_align - 1);
+        return info;
+    }
+
+    static constexpr Info info = Compute();
+
+    static_assert(info.num_buffers <= 8 && info.num_in_handles <= 8 && info.num_out_handles <= 8 && info.num_in_objects <= 8 && info.num_out_objects <= 8,
+        "at most 8 arguments of each kind are supported");
+};
+
+struct Request {
+    u8* in;
+    SfBuffer buffers[8];
+    const ::Service* in_objects[8];
+    Handle in_handles[8];
+};
+
+template<size_t I, typename T, typename L, bool Data>
+NX_INLINE void Marshal(Request& req, const T& arg) {
+    constexpr u32 offset = L::info.offsets[I];
+    if constexpr (Data) {
+        if constexpr (ArgTraits<T>::kind == ArgKind::InData)
+            __builtin_memcpy(req.in + offset, &arg, sizeof(T));
+    }
+    else if constexpr (ArgTraits<T>::kind == ArgKind::Buffer)
+        req.buffers[offset] = SfBuffer{ arg.ptr, arg.size };
+    else if constexpr (ArgTraits<T>::kind == ArgKind::InHandle)
+        req.in_handles[offset] = arg.handle;
+    else if constexpr (ArgTraits<T>::kind == ArgKind::InObject)
+        req.in_objects[offset] = arg.srv;
+}
+
+template<size_t I, typename T, typename L>
+NX_INLINE void Unmarshal(const u8* out, const Handle* out_handles, const ::Service* out_objects, const T& arg) {
+    constexpr u32 offset = L::info.offsets[I];
+    if constexpr (ArgTraits<T>::kind == ArgKind::OutData)
+        __builtin_memcpy(arg.ptr, out + offset, sizeof(*arg.ptr));
+    else if constexpr (ArgTraits<T>::kind == ArgKind::OutHandle)
+        *arg.ptr = out_handles[offset];
+    else if constexpr (ArgTraits<T>::kind == ArgKind::OutObject)
+        *arg.srv = out_objects[offset];
+}
+
+template<u32 RequestId, typename L, typename... Args, size_t... I>
+NX_INLINE Result Invoke(::Service* s, std::index_sequence<I...>, const Args&... args) {
+    // Only the object id and pointer buffer size of the session are filled in at runtime.
+    constexpr CmifRequestFormat format = serviceMakeRequestFormat(0, 0, RequestId, 0, L::info.in_size, L::info.send_pid,
+        L::info.buffer_attrs, L::info.num_in_objects, L::info.num_in_handles);
+
+    ::Service srv = *s;
+    CmifRequestFormat fmt = format;
+    fmt.object_id = srv.object_id;
+    fmt.server_pointer_size = srv.pointer_buffer_size;
+
+    // Descriptors are written before the raw data: buffers, handles and objects are gathered first, then the data is copied in.
+    void* base = armGetTls();
+    Request req = {};
+    (Marshal<I, Args, L, false>(req, args), ...);
+    req.in = (u8*)serviceMakeRequestWithFormat(base, &srv, fmt, L::info.buffer_attrs, req.buffers,
+        L::info.num_in_objects, req.in_objects, L::info.num_in_handles, req.in_handles);
+    (Marshal<I, Args, L, true>(req, args), ...);
+
+#if defined(NX_SF_TRACE)
+    u64 trace_start = sftraceIsEnabled() ? armGetSystemTick() : 0;
+#endif
+
+    traceBegin("serviceDispatch");
+    Result rc = svcSendSyncRequest(srv.session);
+    if (R_SUCCEEDED(rc)) {
+        void* out = nullptr;
+        Handle out_handles[8] = {};
+        ::Service out_objects[L::info.num_out_objects ? L::info.num_out_objects : 1] = {};
+        rc = serviceParseResponseEx(base, &srv, L::info.out_size, &out, L::info.num_out_objects, out_objects,
+            L::info.out_handle_attrs, out_handles);
+        if (R_SUCCEEDED(rc))
+            (Unmarshal<I, Args, L>((const u8*)out, out_handles, out_objects, args), ...);
+    }
+    traceEnd();
+
+#if defined(NX_SF_TRACE)
+    if (trace_start)
+        sftraceRecord(srv.session, srv.object_id, RequestId, rc, trace_start, armGetSystemTick());
+#endif
+
+#if defined(NX_FLIGHT_RECORDER)
+    flightRecorderRecordIpc(srv.session, srv.object_id, RequestId, rc);
+#endif
+
+    return rc;
+}
+
+} // namespace impl
+/// @endcond
+
+/**
+ * @brief Command with a typed signature, marshalled with a CMIF request format computed at compile time.
+ * @note Arguments are raw input data (trivially copyable values), \ref Out, \ref Buffer, \ref InHandle, \ref OutHandle, \ref InObject, \ref OutObject or \ref SendPid. Raw data is laid out in argument order with natural alignment, like the structs passed to serviceDispatchIn/Out.
+ * @note For example `using GetFileTimeStampRaw = nx::sf::Command<14, nx::sf::InPointer, nx::sf::Out<FsTimeStampRaw>>;`, invoked with `GetFileTimeStampRaw::Invoke(&fs->s, nx::sf::InPointer(path, FS_MAX_PATH), ts)`.
+ */
+template<u32 RequestId, typename... Args>
+struct Command {
+    using Layout = impl::Layout<Args...>;
+
+    /// Dispatches the command on a session.
+    static Result Invoke(::Service* s, const Args&... args) {
+        return impl::Invoke<RequestId, Layout, Args...>(s, std::index_sequence_for<Args...>{}, args...);
+    }
+};
+
+/// Move-only owner of a \ref ::Service, closed on destruction.
+class Service {
+    ::Service m_srv = {};
+
+public:
+    Service() = default;
+    /// Takes ownership of a C service object.
+    explicit Service(const ::Service& srv) : m_srv(srv) {}
+    ~Service() { Close(); }
+
+    Service(const Service&) = delete;
+    Service& operator=(const Service&) = delete;
+    Service(Service&& other) noexcept : m_srv(other.m_srv) { other.m_srv = {}; }
+    Service& operator=(Service&& other) noexcept {
+        if (this != &other) {
+            Close();
+            m_srv = other.m_srv;
+            other.m_srv = {};
+        }
+        return *this;
+    }
+
+    /// Opens a named service with \ref smGetService.
+    Result Open(const char* name) {
+        Close();
+        return smGetService(&m_srv, name);
+    }
+
+    void Close() {
+        if (serviceIsActive(&m_srv))
+            serviceClose(&m_srv);
+        m_srv = {};
+    }
+
+    /// Gives up ownership of the C service object.
+    ::Service Release() {
+        ::Service srv = m_srv;
+        m_srv = {};
+        return srv;
+    }
+
+    bool IsActive() const { return serviceIsActive(const_cast<::Service*>(&m_srv)); }
+    ::Service* Get() { return &m_srv; }
+    const ::Service* Get() const { return &m_srv; }
+
+    /// Dispatches a \ref Command on this session.
+    template<typename Cmd, typename... A>
+    Result Invoke(A&&... args) { return Cmd::Invoke(&m_srv, std::forward<A>(args)...); }
+};
+
+} // namespace sf
+
+/// Move-only owner of an \ref ::Event, closed on destruction.
+class Event {
+    ::Event m_event = {};
+
+public:
+    Event() = default;
+    /// Takes ownership of a C event object.
+    explicit Event(const ::Event& event) : m_event(event) {}
+    ~Event() { eventClose(&m_event); }
+
+    Event(const Event&) = delete;
+    Event& operator=(const Event&) = delete;
+    Event(Event&& other) noexcept : m_event(other.m_event) { other.m_event = {}; }
+    Event& operator=(Event&& other) noexcept {
+        if (this != &other) {
+            eventClose(&m_event);
+            m_event = other.m_event;
+            other.m_event = {};
+        }
+        return *this;
+    }
+
+    /// Creates a new event, see \ref eventCreate.
+    Result Create(bool autoclear) {
+        eventClose(&m_event);
+        return eventCreate(&m_event, autoclear);
+    }
+
+    Result Wait(u64 timeout = UINT64_MAX) { return eventWait(&m_event, timeout); }
+    Result Signal() { return eventFire(&m_event); }
+    Result Clear() { return eventClear(&m_event); }
+    bool IsActive() const { return eventActive(const_cast<::Event*>(&m_event)); }
+    ::Event* Get() { return &m_event; }
+};
+
+namespace fs {
+
+/// Move-only owner of a \ref ::FsFile, closed on destruction.
+class File {
+    ::FsFile m_file = {};
+
+public:
+    File() = default;
+    /// Takes ownership of a C file object.
+    explicit File(const ::FsFile& file) : m_file(file) {}
+    ~File() { Close(); }
+
+    File(const File&) = delete;
+    File& operator=(const File&) = delete;
+    File(File&& other) noexcept : m_file(other.m_file) { other.m_file = {}; }
+    File& operator=(File&& other) noexcept {
+        if (this != &other) {
+            Close();
+            m_file = other.m_file;
+            other.m_file = {};
+        }
+        return *this;
+    }
+
+    void Close() {
+        if (serviceIsActive(&m_file.s))
+            fsFileClose(&m_file);
+        m_file = {};
+    }
+
+    Result Read(s64 off, void* buf, u64 size, u64* bytes_read, u32 option = FsReadOption_None) { return fsFileRead(&m_file, off, buf, size, option, bytes_read); }
+    Result Write(s64 off, const void* buf, u64 size, u32 option = FsWriteOption_None) { return fsFileWrite(&m_file, off, buf, size, option); }
+    Result Flush() { return fsFileFlush(&m_file); }
+    Result SetSize(s64 size) { return fsFileSetSize(&m_file, size); }
+    Result GetSize(s64* size) { return fsFileGetSize(&m_file, size); }
+    ::FsFile* Get() { return &m_file; }
+};
+
+/// Move-only owner of a \ref ::FsFileSystem, closed on destruction.
+class FileSystem {
+    ::FsFileSystem m_fs = {};
+
+public:
+    FileSystem() = default;
+    /// Takes ownership of a C filesystem object.
+    explicit FileSystem(const ::FsFileSystem& fs) : m_fs(fs) {}
+    ~FileSystem() { Close(); }
+
+    FileSystem(const FileSystem&) = delete;
+    FileSystem& operator=(const FileSystem&) = delete;
+    FileSystem(FileSystem&& other) noexcept : m_fs(other.m_fs) { other.m_fs = {}; }
+    FileSystem& operator=(FileSystem&& other) noexcept {
+        if (this != &other) {
+            Close();
+            m_fs = other.m_fs;
+            other.m_fs = {};
+        }
+        return *this;
+    }
+
+    /// Opens the SD card filesystem, see \ref fsOpenSdCardFileSystem.
+    Result OpenSdCard() {
+        Close();
+        return fsOpenSdCardFileSystem(&m_fs);
+    }
+
+    void Close() {
+        if (serviceIsActive(&m_fs.s))
+            fsFsClose(&m_fs);
+        m_fs = {};
+    }
+
+    /// Opens a file, see \ref fsFsOpenFile.
+    Result OpenFile(const char* path, u32 mode, File& out) {
+        ::FsFile file;
+        Result rc = fsFsOpenFile(&m_fs, path, mode, &file);
+        if (R_SUCCEEDED(rc))
+            out = File(file);
+        return rc;
+    }
+
+    Result Commit() { return fsFsCommit(&m_fs); }
+    ::FsFileSystem* Get() { return &m_fs; }
+};
+
+} // namespace fs
+} // namespace nx
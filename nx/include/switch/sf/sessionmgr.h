@@ -2,25 +2,109 @@
 #include "../types.h"
 #include "../kernel/mutex.h"
 #include "../kernel/condvar.h"
+#include "service.h"
 
-#define NX_SESSION_MGR_MAX_SESSIONS 16
+#define NX_SESSION_MGR_MAX_SESSIONS 32
 
 typedef struct SessionMgr
 {
     Handle sessions[NX_SESSION_MGR_MAX_SESSIONS];
     u32 num_sessions;
+    u32 max_sessions;
     u32 free_mask;
     Mutex mutex;
     CondVar condvar;
-    bool is_waiting;
+    u32 num_waiters;
+    u32 num_contended;
+    bool is_sticky;
+    Handle slot_owners[NX_SESSION_MGR_MAX_SESSIONS];
 } SessionMgr;
 
-Result sessionmgrCreate(SessionMgr* mgr, Handle root_session, u32 num_sessions);
+Result sessionmgrCreateEx(SessionMgr* mgr, Handle root_session, u32 num_sessions, u32 max_sessions);
 void sessionmgrClose(SessionMgr* mgr);
 int sessionmgrAttachClient(SessionMgr* mgr);
+int sessionmgrTryAttachClient(SessionMgr* mgr);
 void sessionmgrDetachClient(SessionMgr* mgr, int slot);
 
+/// Enables or disables per-thread session affinity: when enabled, each thread first tries to reuse the slot it used last.
+NX_INLINE void sessionmgrSetAffinityMode(SessionMgr* mgr, bool sticky)
+{
+    mgr->is_sticky = sticky;
+}
+
+/// Creates a session manager with all of its sessions cloned up front.
+NX_INLINE Result sessionmgrCreate(SessionMgr* mgr, Handle root_session, u32 num_sessions)
+{
+    return sessionmgrCreateEx(mgr, root_session, num_sessions, num_sessions);
+}
+
 NX_CONSTEXPR Handle sessionmgrGetClientSession(SessionMgr* mgr, int slot)
 {
     return mgr->sessions[slot];
 }
+
+/// Returns the number of times a client had to wait for a free session slot.
+NX_INLINE u32 sessionmgrGetContentionCount(SessionMgr* mgr)
+{
+    return __atomic_load_n(&mgr->num_contended, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Dispatches a request on a domain subservice through a pooled session.
+ * @note Requests on objects that belong to the domain rooted at the manager's root session are sent through any free pooled session (clones of a domain session share its objects), so that one thread making many object calls does not serialize every other user of the parent session. Other objects are dispatched normally.
+ * @note Use the sessionmgrDispatch* macros instead of calling this directly.
+ */
+NX_INLINE Result sessionmgrDispatchImpl(
+    SessionMgr* mgr, Service* s, u32 request_id,
+    const void* in_data, u32 in_data_size,
+    void* out_data, u32 out_data_size,
+    SfDispatchParams disp
+) {
+    int slot = -1;
+    if (s->session == mgr->sessions[0] && disp.target_session == INVALID_HANDLE) {
+        slot = sessionmgrAttachClient(mgr);
+        if (slot < 0) __builtin_unreachable();
+        disp.target_session = sessionmgrGetClientSession(mgr, slot);
+        serviceAssumeDomain(s);
+    }
+
+    Result rc = serviceDispatchImpl(s, request_id, in_data, in_data_size, out_data, out_data_size, disp);
+
+    if (slot >= 0)
+        sessionmgrDetachClient(mgr, slot);
+
+    return rc;
+}
+
+/**
+ * @brief Closes a service object, sending the domain close request through a pooled session if needed.
+ * @param[in] mgr Session manager.
+ * @param[in] s Service object.
+ */
+NX_INLINE void sessionmgrCloseObject(SessionMgr* mgr, Service* s)
+{
+    if (s->session != mgr->sessions[0]) {
+        serviceClose(s);
+        return;
+    }
+
+    int slot = sessionmgrAttachClient(mgr);
+    u32 object_id = serviceGetObjectId(s);
+    serviceAssumeDomain(s);
+    cmifMakeCloseRequest(armGetTls(), object_id);
+    svcSendSyncRequest(sessionmgrGetClientSession(mgr, slot));
+    sessionmgrDetachClient(mgr, slot);
+    *s = (Service){};
+}
+
+#define sessionmgrDispatch(_mgr,_s,_rid,...) \
+    sessionmgrDispatchImpl((_mgr),(_s),(_rid),NULL,0,NULL,0,(SfDispatchParams){ __VA_ARGS__ })
+
+#define sessionmgrDispatchIn(_mgr,_s,_rid,_in,...) \
+    sessionmgrDispatchImpl((_mgr),(_s),(_rid),&(_in),sizeof(_in),NULL,0,(SfDispatchParams){ __VA_ARGS__ })
+
+#define sessionmgrDispatchOut(_mgr,_s,_rid,_out,...) \
+    sessionmgrDispatchImpl((_mgr),(_s),(_rid),NULL,0,&(_out),sizeof(_out),(SfDispatchParams){ __VA_ARGS__ })
+
+#define sessionmgrDispatchInOut(_mgr,_s,_rid,_in,_out,...) \
+    sessionmgrDispatchImpl((_mgr),(_s),(_rid),&(_in),sizeof(_in),&(_out),sizeof(_out),(SfDispatchParams){ __VA_ARGS__ })
@@ -0,0 +1,80 @@
+/**
+ * @file trace.h
+ * @brief IPC tracing and latency statistics.
+ * @note Tracing hooks are only compiled in when libnx (and any code using the inline service dispatch helpers) is built with NX_SF_TRACE defined, i.e. with -DNX_SF_TRACE added to CFLAGS. Otherwise they cost nothing.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "../types.h"
+#include "../arm/counter.h"
+
+/// Number of entries in the raw event ring buffer (power of two).
+#define NX_SF_TRACE_RING_SIZE 1024
+
+/// Maximum number of distinct (session, object, command) keys tracked in the statistics table.
+#define NX_SF_TRACE_MAX_KEYS 256
+
+/// Number of latency histogram buckets. Bucket N holds durations in the [2^N, 2^(N+1)) tick range.
+#define NX_SF_TRACE_NUM_BUCKETS 32
+
+/// Raw trace event.
+typedef struct SfTraceEvent {
+    u64 start_tick;  ///< System tick at which the request was sent.
+    u64 end_tick;    ///< System tick at which the reply was parsed.
+    Handle session;  ///< Root session of the service.
+    u32 object_id;   ///< Domain object ID, or 0.
+    u32 request_id;  ///< Command ID.
+    Result rc;       ///< Result of the request.
+} SfTraceEvent;
+
+/// Aggregated statistics for a (session, object, command) key.
+typedef struct SfTraceStats {
+    char service_name[9]; ///< Name of the service as obtained from sm, or empty if unknown.
+    Handle session;       ///< Root session of the service.
+    u32 object_id;        ///< Domain object ID, or 0.
+    u32 request_id;       ///< Command ID.
+    u64 count;            ///< Number of requests.
+    u64 total_ticks;      ///< Sum of all request durations.
+    u64 max_ticks;        ///< Longest request duration.
+    u64 p50_ticks;        ///< Approximate median duration (upper bound of the histogram bucket).
+    u64 p99_ticks;        ///< Approximate 99th percentile duration (upper bound of the histogram bucket).
+} SfTraceStats;
+
+/// Enables or disables recording at runtime. Recording is disabled by default.
+void sftraceSetEnabled(bool enabled);
+
+/// Returns whether recording is enabled.
+bool sftraceIsEnabled(void);
+
+/// Associates a service name with a session handle, used when reporting statistics.
+void sftraceSetServiceName(Handle session, const char* name);
+
+/**
+ * @brief Records a completed request. Called by the dispatch hooks.
+ * @param[in] session Root session of the service.
+ * @param[in] object_id Domain object ID, or 0.
+ * @param[in] request_id Command ID.
+ * @param[in] rc Result of the request.
+ * @param[in] start_tick System tick at which the request was started.
+ * @param[in] end_tick System tick at which the request completed.
+ */
+void sftraceRecord(Handle session, u32 object_id, u32 request_id, Result rc, u64 start_tick, u64 end_tick);
+
+/**
+ * @brief Copies the most recent raw events, oldest first.
+ * @param[out] events Output array.
+ * @param[in] max_events Size of the output array.
+ * @return Number of events written.
+ */
+u32 sftraceGetEvents(SfTraceEvent* events, u32 max_events);
+
+/**
+ * @brief Gets aggregated per-(session, object, command) statistics.
+ * @param[out] stats Output array.
+ * @param[in] max_stats Size of the output array.
+ * @return Number of entries written.
+ */
+u32 sftraceGetStats(SfTraceStats* stats, u32 max_stats);
+
+/// Clears all recorded events and statistics. Must not be called while other threads are dispatching requests.
+void sftraceReset(void);
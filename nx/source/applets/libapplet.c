@@ -1,6 +1,8 @@
 #include <string.h>
+#include <stdlib.h>
 #include "libapplet_internal.h"
 #include "arm/counter.h"
+#include "runtime/large_buffer.h"
 
 static bool g_libappletJumpFlag;
 
@@ -49,6 +51,84 @@ Result libappletReadStorage(AppletStorage* s, void* buffer, size_t size, size_t
     return rc;
 }
 
+Result libappletStorageWriterCreate(LibAppletStorageWriter* w, size_t size, bool writable) {
+    memset(w, 0, sizeof(*w));
+
+    w->tmem = size >= LIBAPPLET_TMEM_STORAGE_THRESHOLD;
+    w->writable = writable;
+    w->size = w->tmem ? (size + 0xFFF) & ~0xFFF : size;
+    w->data = w->tmem ? (u8*)largeBufferAlloc(w->size) : (u8*)malloc(w->size ? w->size : 1);
+    if (w->data == NULL) return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+
+    // The padding of TransferMemory storages is part of what the other side sees.
+    if (w->tmem) memset(&w->data[size], 0, w->size - size);
+
+    return 0;
+}
+
+Result libappletStorageWriterFinish(LibAppletStorageWriter* w, AppletStorage* s) {
+    Result rc=0;
+
+    if (!w->tmem) {
+        rc = libappletCreateWriteStorage(s, w->data, w->size);
+        free(w->data);
+    }
+    else {
+        rc = appletCreateTransferMemoryStorage(s, w->data, w->size, w->writable);
+        // The memory is freed by appletStorageCloseTmem from now on.
+        if (R_SUCCEEDED(rc)) s->tmem.src_addr = w->data;
+        else largeBufferFree(w->data);
+    }
+
+    w->data = NULL;
+    return rc;
+}
+
+void libappletStorageWriterCancel(LibAppletStorageWriter* w) {
+    if (w->tmem) largeBufferFree(w->data);
+    else free(w->data);
+    w->data = NULL;
+}
+
+Result libappletStorageReaderOpen(LibAppletStorageReader* r, AppletStorage* s) {
+    Result rc=0;
+    s64 tmpsize=0;
+    void* addr=NULL;
+    size_t size=0;
+
+    memset(r, 0, sizeof(*r));
+    r->s = *s;
+
+    rc = appletStorageMap(&r->s, &addr, &size);
+    if (R_SUCCEEDED(rc)) {
+        r->data = (u8*)addr;
+        r->size = size;
+        r->mapped = true;
+        return rc;
+    }
+    memset(&r->s.tmem, 0, sizeof(r->s.tmem));
+
+    rc = appletStorageGetSize(&r->s, &tmpsize);
+    if (R_SUCCEEDED(rc)) {
+        r->data = (u8*)malloc(tmpsize ? tmpsize : 1);
+        if (r->data == NULL) rc = MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+    }
+    if (R_SUCCEEDED(rc)) {
+        r->size = tmpsize;
+        rc = appletStorageRead(&r->s, 0, r->data, r->size);
+    }
+
+    if (R_FAILED(rc)) libappletStorageReaderClose(r);
+    return rc;
+}
+
+void libappletStorageReaderClose(LibAppletStorageReader* r) {
+    if (r->mapped) appletStorageCloseTmem(&r->s);
+    else free(r->data);
+    appletStorageClose(&r->s);
+    memset(r, 0, sizeof(*r));
+}
+
 static Result _libappletPushInData(AppletHolder *h, const void* buffer, size_t size) {
     Result rc=0;
     AppletStorage storage;
@@ -141,26 +221,115 @@ Result libappletStart(AppletHolder *h) {
     return rc;
 }
 
+static Result _libappletCreate(AppletHolder* h, AppletId id, LibAppletArgs *commonargs, const void* arg, size_t arg_size) {
+    Result rc=0;
+
+    rc = appletCreateLibraryApplet(h, id, LibAppletMode_AllForeground);
+    if (R_FAILED(rc)) return rc;
+
+    rc = libappletArgsPush(commonargs, h);
+
+    if (R_SUCCEEDED(rc) && arg && arg_size) rc = libappletPushInData(h, arg, arg_size);
+
+    if (R_FAILED(rc)) appletHolderClose(h);
+
+    return rc;
+}
+
+static Result _libappletShow(AppletHolder* h, void* reply, size_t reply_size, size_t *out_reply_size) {
+    Result rc=0;
+
+    rc = libappletStart(h);
+
+    if (R_SUCCEEDED(rc) && reply && reply_size) rc = libappletPopOutData(h, reply, reply_size, out_reply_size);
+
+    appletHolderClose(h);
+
+    return rc;
+}
+
 Result libappletLaunch(AppletId id, LibAppletArgs *commonargs, const void* arg, size_t arg_size, void* reply, size_t reply_size, size_t *out_reply_size) {
     Result rc=0;
     AppletHolder holder;
 
-    rc = appletCreateLibraryApplet(&holder, id, LibAppletMode_AllForeground);
+    rc = _libappletCreate(&holder, id, commonargs, arg, arg_size);
     if (R_FAILED(rc)) return rc;
 
-    rc = libappletArgsPush(commonargs, &holder);
+    return _libappletShow(&holder, reply, reply_size, out_reply_size);
+}
+
+Result libappletPrepare(LibAppletPrepared* p, AppletId id, LibAppletArgs *commonargs, const void* arg, size_t arg_size) {
+    memset(p, 0, sizeof(*p));
+    p->id = id;
+    p->commonargs = *commonargs;
+
+    p->rc = _libappletCreate(&p->holder, id, &p->commonargs, arg, arg_size);
+    return p->rc;
+}
+
+static void _libappletPrepareThreadFunc(void* arg) {
+    LibAppletPrepared* p = (LibAppletPrepared*)arg;
+
+    p->rc = _libappletCreate(&p->holder, p->id, &p->commonargs, p->arg, p->arg_size);
+}
 
-    if (R_SUCCEEDED(rc) && arg && arg_size) rc = libappletPushInData(&holder, arg, arg_size);
+Result libappletPrepareAsync(LibAppletPrepared* p, AppletId id, LibAppletArgs *commonargs, const void* arg, size_t arg_size, int prio, int cpuid) {
+    Result rc=0;
 
-    if (R_SUCCEEDED(rc)) rc = libappletStart(&holder);
+    memset(p, 0, sizeof(*p));
+    p->id = id;
+    p->commonargs = *commonargs;
 
-    if (R_SUCCEEDED(rc) && reply && reply_size) rc = libappletPopOutData(&holder, reply, reply_size, out_reply_size);
+    if (arg && arg_size) {
+        p->arg = malloc(arg_size);
+        if (p->arg == NULL) return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+        memcpy(p->arg, arg, arg_size);
+        p->arg_size = arg_size;
+    }
+
+    rc = threadCreate(&p->thread, _libappletPrepareThreadFunc, p, NULL, 0x4000, prio, cpuid);
+    if (R_SUCCEEDED(rc)) {
+        rc = threadStart(&p->thread);
+        if (R_FAILED(rc)) threadClose(&p->thread);
+    }
 
-    appletHolderClose(&holder);
+    if (R_SUCCEEDED(rc)) p->async = true;
+    else {
+        free(p->arg);
+        p->arg = NULL;
+    }
 
     return rc;
 }
 
+Result libappletPreparedWait(LibAppletPrepared* p) {
+    if (p->async) {
+        threadWaitForExit(&p->thread);
+        threadClose(&p->thread);
+        p->async = false;
+
+        free(p->arg);
+        p->arg = NULL;
+    }
+
+    return p->rc;
+}
+
+Result libappletShow(LibAppletPrepared* p, void* reply, size_t reply_size, size_t *out_reply_size) {
+    Result rc = libappletPreparedWait(p);
+    if (R_FAILED(rc)) return rc;
+
+    rc = _libappletShow(&p->holder, reply, reply_size, out_reply_size);
+    // Mark the holder as closed, so that closing this afterwards does nothing.
+    p->rc = MAKERESULT(Module_Libnx, LibnxError_NotInitialized);
+    return rc;
+}
+
+void libappletPreparedClose(LibAppletPrepared* p) {
+    if (R_SUCCEEDED(libappletPreparedWait(p))) appletHolderClose(&p->holder);
+    p->rc = MAKERESULT(Module_Libnx, LibnxError_NotInitialized);
+}
+
 Result libappletRequestHomeMenu(void) {
     u8 storagedata[0x10] = {0x53, 0x41, 0x4d, 0x53, 0x01, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00};//RequestHomeMenu
     return _libappletQlaunchRequest(storagedata, sizeof(storagedata));
@@ -11,7 +11,7 @@
 	.cfi_endproc
 .endm
 
-CODE_BEGIN armDCacheFlush
+CODE_BEGIN _armDCacheFlushLines
 	add x1, x1, x0
 	mrs x8, CTR_EL0
 	lsr x8, x8, #16
@@ -22,17 +22,16 @@ CODE_BEGIN armDCacheFlush
 	bic x8, x0, x10
 	mov x10, x1
 
-armDCacheFlush_L0:
+_armDCacheFlushLines_L0:
 	dc  civac, x8
 	add x8, x8, x9
 	cmp x8, x10
-	bcc armDCacheFlush_L0
+	bcc _armDCacheFlushLines_L0
 
-	dsb sy
 	ret
 CODE_END
 
-CODE_BEGIN armDCacheClean
+CODE_BEGIN _armDCacheCleanLines
 	add x1, x1, x0
 	mrs x8, CTR_EL0
 	lsr x8, x8, #16
@@ -43,13 +42,12 @@ CODE_BEGIN armDCacheClean
 	bic x8, x0, x10
 	mov x10, x1
 
-armDCacheClean_L0:
+_armDCacheCleanLines_L0:
 	dc  cvac, x8
 	add x8, x8, x9
 	cmp x8, x10
-	bcc armDCacheClean_L0
+	bcc _armDCacheCleanLines_L0
 
-	dsb sy
 	ret
 CODE_END
 
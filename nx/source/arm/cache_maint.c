@@ -0,0 +1,77 @@
+#include "types.h"
+#include "arm/cache.h"
+#include "kernel/svc.h"
+#include "runtime/env.h"
+
+/// Flushes/cleans of at least this many bytes use \ref svcFlushEntireDataCache instead, when it's available. This defaults to the size of the L2 cache, past which walking the range touches more lines than the cache holds. 0 disables it.
+__attribute__((weak)) size_t __nx_dcache_entire_flush_threshold = 0x200000;
+
+void _armDCacheFlushLines(void* addr, size_t size);
+void _armDCacheCleanLines(void* addr, size_t size);
+
+static inline void _armDataSyncBarrier(void)
+{
+    __asm__ __volatile__ ("dsb sy" ::: "memory");
+}
+
+static inline bool _armDCacheUseEntire(size_t size)
+{
+    return __nx_dcache_entire_flush_threshold && size >= __nx_dcache_entire_flush_threshold && envIsSyscallHinted(0x2A);
+}
+
+void armDCacheFlush(void* addr, size_t size)
+{
+    if (_armDCacheUseEntire(size)) {
+        svcFlushEntireDataCache();
+        return;
+    }
+
+    _armDCacheFlushLines(addr, size);
+    _armDataSyncBarrier();
+}
+
+void armDCacheClean(void* addr, size_t size)
+{
+    // There is no entire clean, but a flush is a clean too.
+    if (_armDCacheUseEntire(size)) {
+        svcFlushEntireDataCache();
+        return;
+    }
+
+    _armDCacheCleanLines(addr, size);
+    _armDataSyncBarrier();
+}
+
+static size_t _armCacheRangesGetSize(const ArmCacheRange* ranges, size_t count)
+{
+    size_t total = 0;
+    for (size_t i = 0; i < count; i++)
+        total += ranges[i].size;
+    return total;
+}
+
+void armDCacheFlushRanges(const ArmCacheRange* ranges, size_t count)
+{
+    if (_armDCacheUseEntire(_armCacheRangesGetSize(ranges, count))) {
+        svcFlushEntireDataCache();
+        return;
+    }
+
+    for (size_t i = 0; i < count; i++)
+        if (ranges[i].size)
+            _armDCacheFlushLines(ranges[i].addr, ranges[i].size);
+    _armDataSyncBarrier();
+}
+
+void armDCacheCleanRanges(const ArmCacheRange* ranges, size_t count)
+{
+    if (_armDCacheUseEntire(_armCacheRangesGetSize(ranges, count))) {
+        svcFlushEntireDataCache();
+        return;
+    }
+
+    for (size_t i = 0; i < count; i++)
+        if (ranges[i].size)
+            _armDCacheCleanLines(ranges[i].addr, ranges[i].size);
+    _armDataSyncBarrier();
+}
@@ -0,0 +1,89 @@
+#include <malloc.h>
+#include <string.h>
+#include "types.h"
+#include "result.h"
+#include "arm/cache.h"
+#include "audio/audin_ring.h"
+
+Result audinRingCreate(AudioInRing* r, u32 buffer_frames, u32 num_buffers)
+{
+    if (!buffer_frames || num_buffers < 2 || num_buffers > AUDIN_RING_MAX_BUFFERS)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    memset(r, 0, sizeof(*r));
+    r->num_buffers = num_buffers;
+
+    size_t data_size = buffer_frames * audinGetChannelCount() * sizeof(s16);
+    size_t buffer_size = (data_size + 0xFFF) &~ 0xFFF;
+    r->mem = memalign(0x1000, num_buffers * buffer_size);
+    if (!r->mem)
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+
+    Result rc = 0;
+    for (u32 i = 0; R_SUCCEEDED(rc) && i < num_buffers; i ++) {
+        AudioInBuffer* buf = &r->buffers[i];
+        buf->buffer = (u8*)r->mem + i*buffer_size;
+        buf->buffer_size = buffer_size;
+        buf->data_size = data_size;
+        buf->data_offset = 0;
+        rc = audinAppendAudioInBuffer(buf);
+    }
+
+    // Start once everything is queued, so that capture never waits for a buffer.
+    if (R_SUCCEEDED(rc))
+        rc = audinStartAudioIn();
+
+    if (R_FAILED(rc)) {
+        audinStopAudioIn();
+        free(r->mem);
+        r->mem = NULL;
+    }
+
+    return rc;
+}
+
+void audinRingClose(AudioInRing* r)
+{
+    if (!r->mem)
+        return;
+
+    audinStopAudioIn();
+    free(r->mem);
+    r->mem = NULL;
+}
+
+size_t audinRingGetReadSpan(AudioInRing* r, const void** out_ptr, u64 timeout)
+{
+    if (!r->cur) {
+        AudioInBuffer* released = NULL;
+        u32 released_count = 0;
+
+        Result rc = audinGetReleasedAudioInBuffer(&released, &released_count);
+        if (R_SUCCEEDED(rc) && (!released_count || !released))
+            rc = audinWaitCaptureFinish(&released, &released_count, timeout);
+        if (R_FAILED(rc) || !released_count || !released)
+            return 0;
+
+        // The device wrote it behind the CPU caches.
+        armDCacheFlush(released->buffer, released->data_size);
+        r->cur = released;
+        r->cur_offset = 0;
+    }
+
+    *out_ptr = (const u8*)r->cur->buffer + r->cur_offset;
+    return r->cur->data_size - r->cur_offset;
+}
+
+Result audinRingCommitRead(AudioInRing* r, size_t size)
+{
+    if (!r->cur || size > r->cur->data_size - r->cur_offset)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    r->cur_offset += size;
+    if (r->cur_offset < r->cur->data_size)
+        return 0;
+
+    AudioInBuffer* buf = r->cur;
+    r->cur = NULL;
+    return audinAppendAudioInBuffer(buf);
+}
@@ -0,0 +1,142 @@
+#include <malloc.h>
+#include <string.h>
+#include "types.h"
+#include "result.h"
+#include "arm/counter.h"
+#include "arm/cache.h"
+#include "audio/audout_queue.h"
+
+Result audoutQueueCreate(AudioOutQueue* q, u32 buffer_frames, u32 min_depth, u32 max_depth)
+{
+    if (!buffer_frames || min_depth < 2 || max_depth < min_depth || max_depth > AUDOUT_QUEUE_MAX_BUFFERS)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    memset(q, 0, sizeof(*q));
+    q->buffer_frames = buffer_frames;
+    q->min_depth = min_depth;
+    q->max_depth = max_depth;
+    q->depth = min_depth;
+    q->buffer_ticks = (u64)buffer_frames * armGetSystemTickFreq() / audoutGetSampleRate();
+
+    size_t frame_size = audoutGetChannelCount() * sizeof(s16);
+    size_t buffer_size = (buffer_frames * frame_size + 0xFFF) &~ 0xFFF;
+    q->mem = memalign(0x1000, max_depth * buffer_size);
+    if (!q->mem)
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+
+    for (u32 i = 0; i < max_depth; i ++) {
+        AudioOutBuffer* buf = &q->buffers[i];
+        buf->buffer = (u8*)q->mem + i*buffer_size;
+        buf->buffer_size = buffer_size;
+        q->free_buffers[q->num_free++] = buf;
+    }
+
+    Result rc = audoutStartAudioOut();
+    if (R_FAILED(rc)) {
+        free(q->mem);
+        q->mem = NULL;
+    }
+
+    return rc;
+}
+
+void audoutQueueClose(AudioOutQueue* q)
+{
+    if (!q->mem)
+        return;
+
+    audoutStopAudioOut();
+    free(q->mem);
+    q->mem = NULL;
+}
+
+static void _audoutQueueOnRelease(AudioOutQueue* q, AudioOutBuffer* buf)
+{
+    u64 now = armGetSystemTick();
+    bool late = q->last_release_tick && now - q->last_release_tick > q->buffer_ticks*3/2;
+    q->last_release_tick = now;
+
+    q->free_buffers[q->num_free++] = buf;
+    q->num_queued--;
+
+    if (!q->num_queued) {
+        // Ran dry: the next buffer starts late, and an audible gap was already heard.
+        q->underrun_count++;
+        q->last_release_tick = 0;
+    }
+    else if (late)
+        q->late_count++;
+    else if (++q->stable_count >= AUDOUT_QUEUE_SHRINK_PERIOD) {
+        if (q->depth > q->min_depth)
+            q->depth--;
+        q->stable_count = 0;
+        return;
+    }
+    else
+        return;
+
+    if (q->depth < q->max_depth)
+        q->depth++;
+    q->stable_count = 0;
+}
+
+static bool _audoutQueueCollect(AudioOutQueue* q)
+{
+    bool any = false;
+
+    while (q->num_queued) {
+        AudioOutBuffer* released = NULL;
+        u32 released_count = 0;
+        if (R_FAILED(audoutGetReleasedAudioOutBuffer(&released, &released_count)) || !released_count || !released)
+            break;
+        _audoutQueueOnRelease(q, released);
+        any = true;
+    }
+
+    return any;
+}
+
+AudioOutBuffer* audoutQueueAcquire(AudioOutQueue* q, u64 timeout)
+{
+    u64 start = armGetSystemTick();
+
+    _audoutQueueCollect(q);
+
+    while (q->num_queued >= q->depth || !q->num_free) {
+        u64 remaining = UINT64_MAX;
+        if (timeout != UINT64_MAX) {
+            u64 elapsed = armTicksToNs(armGetSystemTick() - start);
+            if (elapsed >= timeout)
+                return NULL;
+            remaining = timeout - elapsed;
+        }
+
+        AudioOutBuffer* released = NULL;
+        u32 released_count = 0;
+        if (R_FAILED(audoutWaitPlayFinish(&released, &released_count, remaining)))
+            return NULL;
+        if (released_count && released)
+            _audoutQueueOnRelease(q, released);
+        _audoutQueueCollect(q);
+    }
+
+    return q->free_buffers[--q->num_free];
+}
+
+Result audoutQueueSubmit(AudioOutQueue* q, AudioOutBuffer* buf, u64 data_size)
+{
+    if (data_size > buf->buffer_size)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    buf->data_size = data_size;
+    buf->data_offset = 0;
+    armDCacheFlush(buf->buffer, data_size);
+
+    Result rc = audoutAppendAudioOutBuffer(buf);
+    if (R_SUCCEEDED(rc))
+        q->num_queued++;
+    else
+        q->free_buffers[q->num_free++] = buf;
+
+    return rc;
+}
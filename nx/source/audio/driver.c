@@ -1,4 +1,9 @@
 #include "driver_internal.h"
+#include "runtime/trace.h"
+
+#define AUDRV_PERF_MAGIC 0x46524550 // "PERF"
+
+static void _audrvPerfUpdate(AudioDriver* d, u32 written_sz);
 
 static inline void _audrvInitConfig(AudioDriver* d, int num_final_mix_channels)
 {
@@ -89,9 +94,18 @@ Result audrvCreate(AudioDriver* d, const AudioRendererConfig* config, int num_fi
     if (!d->etc->in_buf)
         goto _error2;
 
+    d->etc->perf_buf_size = audrenGetPerformanceBufferSize(config);
+    if (d->etc->perf_buf_size) {
+        d->etc->perf_buf = memalign(AUDREN_OUTPUT_PARAM_ALIGNMENT, d->etc->perf_buf_size);
+        if (!d->etc->perf_buf)
+            goto _error3;
+    }
+
     _audrvInitConfig(d, num_final_mix_channels);
     return 0;
 
+_error3:
+    free(d->etc->in_buf);
 _error2:
     free(d->etc->out_buf);
 _error1:
@@ -103,10 +117,17 @@ _error0:
 
 Result audrvUpdate(AudioDriver* d)
 {
-    for (int i = d->etc->first_used_voice, j = 0; i >= 0; i = d->etc->voices[i].next_used_voice, j++)
-        d->in_voices[i].sorting_order = j;
+    traceScope("audrvUpdate");
 
-    Result rc = audrenRequestUpdateAudioRenderer(d->etc->in_buf, d->etc->in_buf_size, d->etc->out_buf, d->etc->out_buf_size, NULL, 0);
+    // The input and output layouts are fixed, so the whole buffers are always exchanged,
+    // but the bookkeeping is only redone for what may have changed.
+    if (d->etc->voice_list_changed) {
+        for (int i = d->etc->first_used_voice, j = 0; i >= 0; i = d->etc->voices[i].next_used_voice, j++)
+            d->in_voices[i].sorting_order = j;
+        d->etc->voice_list_changed = false;
+    }
+
+    Result rc = audrenRequestUpdateAudioRenderer(d->etc->in_buf, d->etc->in_buf_size, d->etc->out_buf, d->etc->out_buf_size, d->etc->perf_buf, d->etc->perf_buf_size);
     if (R_FAILED(rc))
         return rc;
 
@@ -116,12 +137,18 @@ Result audrvUpdate(AudioDriver* d)
     if (out_hdr->mempools_sz != d->etc->mempool_count*sizeof(AudioRendererMemPoolInfoOut))
         return MAKERESULT(Module_Libnx, LibnxError_BadInput);
 
-    for (int i = 0; i < d->etc->mempool_count; i ++)
-    {
-        // todo: this is supposed to be more complex
-        AudioRendererMemPoolState new_state = out_mempools[i].new_state;
-        if (new_state != AudioRendererMemPoolState_Invalid)
-            d->in_mempools[i].state = new_state;
+    if (d->etc->mempools_pending) {
+        bool pending = false;
+        for (int i = 0; i < d->etc->mempool_count; i ++)
+        {
+            // todo: this is supposed to be more complex
+            AudioRendererMemPoolState new_state = out_mempools[i].new_state;
+            if (new_state != AudioRendererMemPoolState_Invalid)
+                d->in_mempools[i].state = new_state;
+            if (d->in_mempools[i].state == AudioRendererMemPoolState_RequestAttach || d->in_mempools[i].state == AudioRendererMemPoolState_RequestDetach)
+                pending = true;
+        }
+        d->etc->mempools_pending = pending;
     }
 
     AudioRendererVoiceInfoOut* out_voices = (AudioRendererVoiceInfoOut*)(out_mempools+d->etc->mempool_count);
@@ -131,11 +158,105 @@ Result audrvUpdate(AudioDriver* d)
     for (int i = d->etc->first_used_voice; i >= 0; i = d->etc->voices[i].next_used_voice)
         _audrvVoiceUpdate(d, i, &out_voices[i]);
 
+    if (d->etc->perf_buf) {
+        // The effects output comes between the voices and the sinks.
+        AudioRendererSinkInfoOut* out_sinks = (AudioRendererSinkInfoOut*)((u8*)(out_voices+d->config.num_voices) + out_hdr->effects_sz);
+        AudioRendererPerformanceBufferInfoOut* out_perf = (AudioRendererPerformanceBufferInfoOut*)((u8*)out_sinks + out_hdr->sinks_sz);
+        _audrvPerfUpdate(d, out_perf->written_sz);
+    }
+
+    return 0;
+}
+
+// The performance buffer holds the frames rendered since the previous update, oldest first.
+static void _audrvPerfUpdate(AudioDriver* d, u32 written_sz)
+{
+    if (written_sz > d->etc->perf_buf_size)
+        written_sz = d->etc->perf_buf_size;
+
+    d->etc->perf_last_frame = NULL;
+    d->etc->perf_num_frames = 0;
+    d->etc->perf_voice_drop_count = 0;
+
+    for (u32 pos = 0; pos + sizeof(AudioRendererPerformanceFrameHeader) <= written_sz;) {
+        const AudioRendererPerformanceFrameHeader* frame = (const AudioRendererPerformanceFrameHeader*)((u8*)d->etc->perf_buf + pos);
+        size_t entries_sz = frame->entry_count*sizeof(AudioRendererPerformanceEntry) + frame->detail_count*sizeof(AudioRendererPerformanceDetail);
+        if (frame->magic != AUDRV_PERF_MAGIC || frame->next_offset < sizeof(*frame) + entries_sz || frame->next_offset > written_sz - pos)
+            break;
+
+        d->etc->perf_last_frame = frame;
+        d->etc->perf_num_frames ++;
+        d->etc->perf_voice_drop_count += frame->voice_drop_count;
+        pos += frame->next_offset;
+    }
+}
+
+static inline const AudioRendererPerformanceEntry* _audrvPerfGetEntries(const AudioRendererPerformanceFrameHeader* frame)
+{
+    return (const AudioRendererPerformanceEntry*)(frame+1);
+}
+
+bool audrvGetPerformanceInfo(AudioDriver* d, AudioDriverPerformanceInfo* out)
+{
+    const AudioRendererPerformanceFrameHeader* frame = d->etc->perf_last_frame;
+    memset(out, 0, sizeof(*out));
+    if (!frame)
+        return false;
+
+    out->num_frames = d->etc->perf_num_frames;
+    out->total_processing_time = frame->total_processing_time;
+    out->voice_drop_count = d->etc->perf_voice_drop_count;
+
+    const AudioRendererPerformanceEntry* entries = _audrvPerfGetEntries(frame);
+    for (u32 i = 0; i < frame->entry_count; i ++) {
+        switch (entries[i].entry_type) {
+            case AudioRendererPerformanceEntryType_Voice:
+                out->voice_processing_time += entries[i].processing_time;
+                break;
+            case AudioRendererPerformanceEntryType_SubMix:
+            case AudioRendererPerformanceEntryType_FinalMix:
+                out->mix_processing_time += entries[i].processing_time;
+                break;
+            case AudioRendererPerformanceEntryType_Sink:
+                out->sink_processing_time += entries[i].processing_time;
+                break;
+            default:
+                break;
+        }
+    }
+
+    return true;
+}
+
+u32 audrvGetNodeProcessingTime(AudioDriver* d, u32 node_id)
+{
+    const AudioRendererPerformanceFrameHeader* frame = d->etc->perf_last_frame;
+    if (!frame)
+        return 0;
+
+    const AudioRendererPerformanceEntry* entries = _audrvPerfGetEntries(frame);
+    for (u32 i = 0; i < frame->entry_count; i ++)
+        if (entries[i].node_id == node_id)
+            return entries[i].processing_time;
+
     return 0;
 }
 
+void audrvSetPerformanceDetailTarget(AudioDriver* d, u32 node_id)
+{
+    d->etc->in_perfbuf->detail_target = node_id;
+}
+
+const AudioRendererPerformanceDetail* audrvGetPerformanceDetails(AudioDriver* d, u32* out_count)
+{
+    const AudioRendererPerformanceFrameHeader* frame = d->etc->perf_last_frame;
+    *out_count = frame ? frame->detail_count : 0;
+    return frame ? (const AudioRendererPerformanceDetail*)(_audrvPerfGetEntries(frame) + frame->entry_count) : NULL;
+}
+
 void audrvClose(AudioDriver* d)
 {
+    free(d->etc->perf_buf);
     free(d->etc->in_buf);
     free(d->etc->out_buf);
     free(d->etc);
@@ -44,6 +44,8 @@ struct AudioDriverEtc {
     int first_free_channel;
     int first_free_mix;
     int first_free_sink;
+    bool voice_list_changed;    // A voice was added/removed since the sorting orders were last assigned.
+    bool mempools_pending;      // Some mempools have an attach/detach request the renderer hasn't answered yet.
     AudioDriverEtcMemPool* mempools;
     AudioDriverEtcVoice* voices;
     AudioDriverEtcMix* mixes;
@@ -54,6 +56,11 @@ struct AudioDriverEtc {
     size_t in_buf_size;
     void* out_buf;
     size_t out_buf_size;
+    void* perf_buf;
+    size_t perf_buf_size;
+    const AudioRendererPerformanceFrameHeader* perf_last_frame;
+    u32 perf_num_frames;
+    u32 perf_voice_drop_count;
 };
 
 static inline size_t _audrvGetEtcSize(const AudioRendererConfig* config)
@@ -0,0 +1,87 @@
+#include "driver_internal.h"
+#include "kernel/thread.h"
+#include "kernel/queue.h"
+
+#define AUDIO_THREAD_STACK_SIZE 0x4000
+
+static void _audrvThreadRunCmd(AudioDriver* d, const AudioDriverCmd* cmd)
+{
+    switch (cmd->type) {
+        case AudioDriverCmdType_VoiceAddWaveBuf:
+            audrvVoiceAddWaveBuf(d, cmd->voice_id, cmd->wavebuf);
+            break;
+        case AudioDriverCmdType_VoiceSetVolume:
+            audrvVoiceSetVolume(d, cmd->voice_id, cmd->value);
+            break;
+        case AudioDriverCmdType_VoiceSetPitch:
+            audrvVoiceSetPitch(d, cmd->voice_id, cmd->value);
+            break;
+        case AudioDriverCmdType_VoiceSetPaused:
+            audrvVoiceSetPaused(d, cmd->voice_id, cmd->paused);
+            break;
+        case AudioDriverCmdType_VoiceStop:
+            audrvVoiceStop(d, cmd->voice_id);
+            break;
+        case AudioDriverCmdType_VoiceSetMixFactor:
+            audrvVoiceSetMixFactor(d, cmd->voice_id, cmd->mix_factor.factor, cmd->mix_factor.src_channel_id, cmd->mix_factor.dest_channel_id);
+            break;
+        case AudioDriverCmdType_Call:
+            cmd->call.func(d, cmd->call.arg);
+            break;
+    }
+}
+
+static void _audrvThreadFunc(void* arg)
+{
+    AudioDriverThread* t = (AudioDriverThread*)arg;
+    AudioDriverCmd cmd;
+
+    while (!__atomic_load_n(&t->exit, __ATOMIC_ACQUIRE)) {
+        while (mpmcQueueTryPop(&t->queue, &cmd))
+            _audrvThreadRunCmd(t->driver, &cmd);
+
+        if (t->frame_cb)
+            t->frame_cb(t->driver, t->frame_arg);
+
+        t->last_result = audrvUpdate(t->driver);
+        audrenWaitFrame();
+    }
+}
+
+Result audrvThreadCreate(AudioDriverThread* t, AudioDriver* d, u32 queue_capacity, int prio, int cpuid, void (*frame_cb)(AudioDriver* d, void* arg), void* frame_arg)
+{
+    memset(t, 0, sizeof(*t));
+    t->driver = d;
+    t->frame_cb = frame_cb;
+    t->frame_arg = frame_arg;
+
+    Result rc = mpmcQueueCreate(&t->queue, queue_capacity, sizeof(AudioDriverCmd));
+    if (R_FAILED(rc))
+        return rc;
+
+    rc = threadCreate(&t->thread, _audrvThreadFunc, t, NULL, AUDIO_THREAD_STACK_SIZE, prio, cpuid);
+    if (R_SUCCEEDED(rc)) {
+        rc = threadStart(&t->thread);
+        if (R_FAILED(rc))
+            threadClose(&t->thread);
+    }
+
+    if (R_FAILED(rc))
+        mpmcQueueClose(&t->queue);
+
+    return rc;
+}
+
+void audrvThreadClose(AudioDriverThread* t)
+{
+    if (!t->driver)
+        return;
+
+    // The thread notices at most one audio frame later.
+    __atomic_store_n(&t->exit, true, __ATOMIC_RELEASE);
+    threadWaitForExit(&t->thread);
+    threadClose(&t->thread);
+
+    mpmcQueueClose(&t->queue);
+    t->driver = NULL;
+}
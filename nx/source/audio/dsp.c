@@ -0,0 +1,396 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <arm_neon.h>
+#include "types.h"
+#include "result.h"
+#include "audio/dsp.h"
+
+//-----------------------------------------------------------------------------
+// Biquad filters
+
+void audioBiquadSetRaw(AudioBiquadCoefs* out, float a0, float a1, float a2, float b0, float b1, float b2)
+{
+    out->b0 = b0 / a0;
+    out->b1 = b1 / a0;
+    out->b2 = b2 / a0;
+    out->a1 = a1 / a0;
+    out->a2 = a2 / a0;
+}
+
+void audioBiquadDesign(AudioBiquadCoefs* out, AudioBiquadType type, float freq, float sample_rate, float q, float gain_db)
+{
+    float w0 = 2.0f * (float)M_PI * freq / sample_rate;
+    float cw = cosf(w0), sw = sinf(w0);
+    float alpha = sw / (2.0f * q);
+    float A = powf(10.0f, gain_db / 40.0f);
+    float sa = 2.0f * sqrtf(A) * alpha;
+
+    switch (type) {
+        case AudioBiquadType_LowPass:
+            audioBiquadSetRaw(out, 1+alpha, -2*cw, 1-alpha, (1-cw)/2, 1-cw, (1-cw)/2);
+            break;
+        case AudioBiquadType_HighPass:
+            audioBiquadSetRaw(out, 1+alpha, -2*cw, 1-alpha, (1+cw)/2, -(1+cw), (1+cw)/2);
+            break;
+        case AudioBiquadType_BandPass:
+            audioBiquadSetRaw(out, 1+alpha, -2*cw, 1-alpha, alpha, 0, -alpha);
+            break;
+        case AudioBiquadType_Notch:
+            audioBiquadSetRaw(out, 1+alpha, -2*cw, 1-alpha, 1, -2*cw, 1);
+            break;
+        case AudioBiquadType_Peaking:
+            audioBiquadSetRaw(out, 1+alpha/A, -2*cw, 1-alpha/A, 1+alpha*A, -2*cw, 1-alpha*A);
+            break;
+        case AudioBiquadType_LowShelf:
+            audioBiquadSetRaw(out,
+                (A+1) + (A-1)*cw + sa, -2*((A-1) + (A+1)*cw), (A+1) + (A-1)*cw - sa,
+                A*((A+1) - (A-1)*cw + sa), 2*A*((A-1) - (A+1)*cw), A*((A+1) - (A-1)*cw - sa));
+            break;
+        case AudioBiquadType_HighShelf:
+            audioBiquadSetRaw(out,
+                (A+1) - (A-1)*cw + sa, 2*((A-1) - (A+1)*cw), (A+1) - (A-1)*cw - sa,
+                A*((A+1) + (A-1)*cw + sa), -2*A*((A-1) + (A+1)*cw), A*((A+1) + (A-1)*cw - sa));
+            break;
+    }
+}
+
+void audioBiquadChainInit(AudioBiquadChain* c, u32 num_channels)
+{
+    memset(c, 0, sizeof(*c));
+    c->num_channels = num_channels < AUDIO_DSP_MAX_CHANNELS ? num_channels : AUDIO_DSP_MAX_CHANNELS;
+}
+
+bool audioBiquadChainAddStage(AudioBiquadChain* c, const AudioBiquadCoefs* coefs)
+{
+    if (c->num_stages == AUDIO_BIQUAD_MAX_STAGES)
+        return false;
+
+    c->coefs[c->num_stages++] = *coefs;
+    return true;
+}
+
+void audioBiquadChainReset(AudioBiquadChain* c)
+{
+    memset(c->z1, 0, sizeof(c->z1));
+    memset(c->z2, 0, sizeof(c->z2));
+}
+
+// Runs a frame through the chain (transposed direct form II), with the channels in the vector lanes.
+static inline float32x4_t _audioBiquadChainStep(const AudioBiquadCoefs* coefs, float32x4_t* z1, float32x4_t* z2, u32 num_stages, float32x4_t x)
+{
+    for (u32 s = 0; s < num_stages; s ++) {
+        float32x4_t y = vfmaq_n_f32(z1[s], x, coefs[s].b0);
+        z1[s] = vfmsq_n_f32(vfmaq_n_f32(z2[s], x, coefs[s].b1), y, coefs[s].a1);
+        z2[s] = vfmsq_n_f32(vmulq_n_f32(x, coefs[s].b2), y, coefs[s].a2);
+        x = y;
+    }
+    return x;
+}
+
+static void _audioBiquadChainLoadState(AudioBiquadChain* c, float32x4_t* z1, float32x4_t* z2)
+{
+    for (u32 s = 0; s < c->num_stages; s ++) {
+        z1[s] = vld1q_f32(c->z1[s]);
+        z2[s] = vld1q_f32(c->z2[s]);
+    }
+}
+
+static void _audioBiquadChainStoreState(AudioBiquadChain* c, const float32x4_t* z1, const float32x4_t* z2)
+{
+    for (u32 s = 0; s < c->num_stages; s ++) {
+        vst1q_f32(c->z1[s], z1[s]);
+        vst1q_f32(c->z2[s], z2[s]);
+    }
+}
+
+void audioBiquadChainProcessS16(AudioBiquadChain* c, s16* data, u32 num_frames)
+{
+    float32x4_t z1[AUDIO_BIQUAD_MAX_STAGES], z2[AUDIO_BIQUAD_MAX_STAGES];
+    u32 nch = c->num_channels;
+    _audioBiquadChainLoadState(c, z1, z2);
+
+    for (u32 i = 0; i < num_frames; i ++, data += nch) {
+        s16 frame[4] = {0};
+        memcpy(frame, data, nch*sizeof(s16));
+
+        float32x4_t x = vcvtq_f32_s32(vmovl_s16(vld1_s16(frame)));
+        float32x4_t y = _audioBiquadChainStep(c->coefs, z1, z2, c->num_stages, x);
+        vst1_s16(frame, vqmovn_s32(vcvtnq_s32_f32(y)));
+
+        memcpy(data, frame, nch*sizeof(s16));
+    }
+
+    _audioBiquadChainStoreState(c, z1, z2);
+}
+
+void audioBiquadChainProcessFloat(AudioBiquadChain* c, float* data, u32 num_frames)
+{
+    float32x4_t z1[AUDIO_BIQUAD_MAX_STAGES], z2[AUDIO_BIQUAD_MAX_STAGES];
+    u32 nch = c->num_channels;
+    _audioBiquadChainLoadState(c, z1, z2);
+
+    for (u32 i = 0; i < num_frames; i ++, data += nch) {
+        float frame[4] = {0};
+        memcpy(frame, data, nch*sizeof(float));
+
+        float32x4_t y = _audioBiquadChainStep(c->coefs, z1, z2, c->num_stages, vld1q_f32(frame));
+        vst1q_f32(frame, y);
+
+        memcpy(data, frame, nch*sizeof(float));
+    }
+
+    _audioBiquadChainStoreState(c, z1, z2);
+}
+
+//-----------------------------------------------------------------------------
+// Resampler
+
+void audioResamplerInit(AudioResampler* r, u32 num_channels, u32 in_rate, u32 out_rate)
+{
+    memset(r, 0, sizeof(*r));
+    r->num_channels = num_channels < AUDIO_DSP_MAX_CHANNELS ? num_channels : AUDIO_DSP_MAX_CHANNELS;
+    r->step = ((u64)in_rate << 32) / out_rate;
+    r->pos = UINT64_C(1) << 32; // The interpolation needs one frame before the current one.
+}
+
+// Frame j of the history followed by the input, with the channels in the vector lanes.
+static inline float32x4_t _audioResamplerLoad(AudioResampler* r, const s16* in, u32 j)
+{
+    if (j < 3)
+        return vld1q_f32(r->history[j]);
+
+    s16 frame[4] = {0};
+    memcpy(frame, in + (j-3)*r->num_channels, r->num_channels*sizeof(s16));
+    return vcvtq_f32_s32(vmovl_s16(vld1_s16(frame)));
+}
+
+u32 audioResamplerProcessS16(AudioResampler* r, const s16* in, u32 in_frames, s16* out, u32 out_frames, u32* in_consumed)
+{
+    u32 nch = r->num_channels;
+    u32 total = in_frames + 3;
+    u32 done = 0;
+
+    for (; done < out_frames; done ++, out += nch) {
+        u32 idx = r->pos >> 32;
+        if (idx + 2 >= total)
+            break;
+
+        float32x4_t xm1 = _audioResamplerLoad(r, in, idx-1);
+        float32x4_t x0  = _audioResamplerLoad(r, in, idx);
+        float32x4_t x1  = _audioResamplerLoad(r, in, idx+1);
+        float32x4_t x2  = _audioResamplerLoad(r, in, idx+2);
+        float f = (u32)r->pos * (1.0f/4294967296.0f);
+
+        // Catmull-Rom: ((c3*f + c2)*f + c1)*f + x0
+        float32x4_t c1 = vmulq_n_f32(vsubq_f32(x1, xm1), 0.5f);
+        float32x4_t c2 = vaddq_f32(vsubq_f32(vaddq_f32(xm1, vmulq_n_f32(x1, 2.0f)), vmulq_n_f32(x0, 2.5f)), vmulq_n_f32(x2, -0.5f));
+        float32x4_t c3 = vaddq_f32(vmulq_n_f32(vsubq_f32(x2, xm1), 0.5f), vmulq_n_f32(vsubq_f32(x0, x1), 1.5f));
+        float32x4_t y = vfmaq_n_f32(c2, c3, f);
+        y = vfmaq_n_f32(c1, y, f);
+        y = vfmaq_n_f32(x0, y, f);
+
+        s16 frame[4];
+        vst1_s16(frame, vqmovn_s32(vcvtnq_s32_f32(y)));
+        memcpy(out, frame, nch*sizeof(s16));
+
+        r->pos += r->step;
+    }
+
+    // Keep the frame before the current one and the next two as history.
+    u32 idx = r->pos >> 32;
+    u32 keep = idx - 1 < in_frames ? idx - 1 : in_frames;
+    float history[3][AUDIO_DSP_MAX_CHANNELS];
+    for (u32 j = 0; j < 3; j ++)
+        vst1q_f32(history[j], _audioResamplerLoad(r, in, keep + j));
+    memcpy(r->history, history, sizeof(history));
+    r->pos -= (u64)keep << 32;
+
+    if (in_consumed)
+        *in_consumed = keep;
+    return done;
+}
+
+//-----------------------------------------------------------------------------
+// DSP-ADPCM encoder
+
+#define ADPCM_NUM_PREDICTORS 8
+#define ADPCM_MAX_SCALE      12
+#define ADPCM_KMEANS_ITERS   16
+
+static inline s16 _audioClampS16(s32 x)
+{
+    return x > 0x7FFF ? 0x7FFF : x < -0x8000 ? -0x8000 : x;
+}
+
+// Order-2 linear predictor minimizing the error over a frame, returns false for frames without enough signal.
+static bool _audioAdpcmFramePredictor(const s16* pcm, u32 start, u32 count, float* c1, float* c2)
+{
+    double r11 = 0, r22 = 0, r12 = 0, r01 = 0, r02 = 0;
+    for (u32 i = start; i < start + count; i ++) {
+        double x = pcm[i];
+        double h1 = i >= 1 ? pcm[i-1] : 0;
+        double h2 = i >= 2 ? pcm[i-2] : 0;
+        r11 += h1*h1; r22 += h2*h2; r12 += h1*h2;
+        r01 += x*h1;  r02 += x*h2;
+    }
+
+    double det = r11*r22 - r12*r12;
+    if (fabs(det) < 1.0)
+        return false;
+
+    double a = (r01*r22 - r02*r12) / det;
+    double b = (r02*r11 - r01*r12) / det;
+
+    // Keep the predictor within what the 4.11 coefficients can represent and stable.
+    if (b > 0.999) b = 0.999;
+    if (b < -0.999) b = -0.999;
+    if (a > 1.999) a = 1.999;
+    if (a < -1.999) a = -1.999;
+
+    *c1 = a;
+    *c2 = b;
+    return true;
+}
+
+Result audioAdpcmEncoderInit(AudioAdpcmEncoder* e, const s16* pcm, u32 num_samples)
+{
+    memset(e, 0, sizeof(*e));
+
+    // Cluster the per-frame predictors into ADPCM_NUM_PREDICTORS (k-means). The first center stays at (0,0) for transients.
+    u32 num_frames = (num_samples + AUDIO_ADPCM_FRAME_SAMPLES-1) / AUDIO_ADPCM_FRAME_SAMPLES;
+    float* points = (float*)malloc((num_frames ? num_frames : 1) * 2 * sizeof(float));
+    if (!points)
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+
+    u32 num_points = 0;
+    for (u32 f = 0; f < num_frames; f ++) {
+        u32 start = f * AUDIO_ADPCM_FRAME_SAMPLES;
+        u32 count = num_samples - start < AUDIO_ADPCM_FRAME_SAMPLES ? num_samples - start : AUDIO_ADPCM_FRAME_SAMPLES;
+        if (_audioAdpcmFramePredictor(pcm, start, count, &points[2*num_points], &points[2*num_points+1]))
+            num_points ++;
+    }
+
+    float centers[ADPCM_NUM_PREDICTORS][2] = { { 0.0f, 0.0f }, { 1.0f, 0.0f }, { 2.0f, -1.0f } };
+    u32 first_free = 3;
+    if (num_points) {
+        for (u32 k = first_free; k < ADPCM_NUM_PREDICTORS; k ++) {
+            u32 p = (u64)(k - first_free) * num_points / (ADPCM_NUM_PREDICTORS - first_free);
+            centers[k][0] = points[2*p];
+            centers[k][1] = points[2*p+1];
+        }
+    }
+
+    for (u32 iter = 0; num_points && iter < ADPCM_KMEANS_ITERS; iter ++) {
+        float sums[ADPCM_NUM_PREDICTORS][2] = {{0}};
+        u32 counts[ADPCM_NUM_PREDICTORS] = {0};
+
+        for (u32 p = 0; p < num_points; p ++) {
+            u32 best = 0;
+            float best_dist = INFINITY;
+            for (u32 k = 0; k < ADPCM_NUM_PREDICTORS; k ++) {
+                float d0 = points[2*p] - centers[k][0], d1 = points[2*p+1] - centers[k][1];
+                float dist = d0*d0 + d1*d1;
+                if (dist < best_dist) {
+                    best_dist = dist;
+                    best = k;
+                }
+            }
+            sums[best][0] += points[2*p];
+            sums[best][1] += points[2*p+1];
+            counts[best] ++;
+        }
+
+        for (u32 k = 1; k < ADPCM_NUM_PREDICTORS; k ++) {
+            if (counts[k]) {
+                centers[k][0] = sums[k][0] / counts[k];
+                centers[k][1] = sums[k][1] / counts[k];
+            }
+        }
+    }
+
+    free(points);
+
+    for (u32 k = 0; k < ADPCM_NUM_PREDICTORS; k ++) {
+        e->params.coefficients[2*k+0] = (u16)_audioClampS16(lrintf(centers[k][0] * 2048.0f));
+        e->params.coefficients[2*k+1] = (u16)_audioClampS16(lrintf(centers[k][1] * 2048.0f));
+    }
+
+    return 0;
+}
+
+// Encodes a frame with the given predictor and scale, returns the squared error (stopping early past max_err).
+static u64 _audioAdpcmTryFrame(const AudioAdpcmEncoder* e, const s16* pcm, u32 count, u32 predictor, u32 scale, u8* nibbles, s16* history, u64 max_err)
+{
+    s32 c1 = (s16)e->params.coefficients[2*predictor+0];
+    s32 c2 = (s16)e->params.coefficients[2*predictor+1];
+    s32 h1 = history[0], h2 = history[1];
+    s32 step = 1 << scale;
+    u64 err = 0;
+
+    for (u32 i = 0; i < AUDIO_ADPCM_FRAME_SAMPLES; i ++) {
+        s32 x = i < count ? pcm[i] : 0;
+        s32 pred = (c1*h1 + c2*h2 + 1024) >> 11;
+
+        // Round to nearest.
+        s32 diff = x - pred;
+        s32 n = diff >= 0 ? (diff + step/2) >> scale : -((-diff + step/2) >> scale);
+        if (n > 7) n = 7;
+        if (n < -8) n = -8;
+
+        s32 decoded = _audioClampS16(pred + n*step);
+        nibbles[i] = n & 0xF;
+        if (i < count) {
+            err += (u64)((x - decoded) * (s64)(x - decoded));
+            if (err >= max_err)
+                return err;
+        }
+
+        h2 = h1;
+        h1 = decoded;
+    }
+
+    history[0] = h1;
+    history[1] = h2;
+    return err;
+}
+
+void audioAdpcmEncode(AudioAdpcmEncoder* e, const s16* pcm, u32 num_samples, u8* out, AudioRendererAdpcmContext* out_ctx)
+{
+    if (out_ctx) {
+        out_ctx->history0 = e->history[0];
+        out_ctx->history1 = e->history[1];
+    }
+
+    for (u32 start = 0; start < num_samples; start += AUDIO_ADPCM_FRAME_SAMPLES, out += AUDIO_ADPCM_FRAME_SIZE) {
+        u32 count = num_samples - start < AUDIO_ADPCM_FRAME_SAMPLES ? num_samples - start : AUDIO_ADPCM_FRAME_SAMPLES;
+        u8 best_nibbles[AUDIO_ADPCM_FRAME_SAMPLES];
+        s16 best_history[2] = { e->history[0], e->history[1] };
+        u64 best_err = UINT64_MAX;
+        u8 header = 0;
+
+        for (u32 p = 0; p < ADPCM_NUM_PREDICTORS && best_err; p ++) {
+            for (u32 scale = 0; scale <= ADPCM_MAX_SCALE && best_err; scale ++) {
+                u8 nibbles[AUDIO_ADPCM_FRAME_SAMPLES];
+                s16 history[2] = { e->history[0], e->history[1] };
+                u64 err = _audioAdpcmTryFrame(e, pcm + start, count, p, scale, nibbles, history, best_err);
+                if (err < best_err) {
+                    best_err = err;
+                    header = (p << 4) | scale;
+                    memcpy(best_nibbles, nibbles, sizeof(nibbles));
+                    best_history[0] = history[0];
+                    best_history[1] = history[1];
+                }
+            }
+        }
+
+        out[0] = header;
+        for (u32 i = 0; i < AUDIO_ADPCM_FRAME_SAMPLES/2; i ++)
+            out[1+i] = (best_nibbles[2*i] << 4) | best_nibbles[2*i+1];
+
+        e->history[0] = best_history[0];
+        e->history[1] = best_history[1];
+        if (out_ctx && !start)
+            out_ctx->index = header;
+    }
+}
@@ -45,6 +45,7 @@ bool audrvMemPoolAttach(AudioDriver* d, int id)
         case AudioRendererMemPoolState_RequestAttach:
         case AudioRendererMemPoolState_Detached:
             d->in_mempools[id].state = AudioRendererMemPoolState_RequestAttach;
+            d->etc->mempools_pending = true;
             return true;
         case AudioRendererMemPoolState_RequestDetach:
         case AudioRendererMemPoolState_Attached:
@@ -70,6 +71,7 @@ bool audrvMemPoolDetach(AudioDriver* d, int id)
         case AudioRendererMemPoolState_RequestDetach:
         case AudioRendererMemPoolState_Attached:
             d->in_mempools[id].state = AudioRendererMemPoolState_RequestDetach;
+            d->etc->mempools_pending = true;
             return true;
         default:
             return false;
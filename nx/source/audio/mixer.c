@@ -0,0 +1,327 @@
+#include <malloc.h>
+#include <string.h>
+#include <arm_neon.h>
+#include "types.h"
+#include "result.h"
+#include "arm/cache.h"
+#include "audio/mixer.h"
+
+#define FEEDER_STACK_SIZE 0x4000
+#define FEEDER_WAIT_TIMEOUT 100000000ULL // 100ms, to notice audmixFeederClose
+
+Result audmixCreate(AudioMixer* m, u32 num_sources, u32 output_rate, u32 max_frames)
+{
+    if (!num_sources || !output_rate || !max_frames)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    memset(m, 0, sizeof(*m));
+    mutexInit(&m->mutex);
+    m->output_rate = output_rate;
+    m->max_frames = max_frames;
+    m->num_sources = num_sources;
+
+    m->sources = (AudioMixerSource*)calloc(num_sources, sizeof(AudioMixerSource));
+    m->accum = (float*)memalign(0x10, max_frames * 2 * sizeof(float));
+    if (!m->sources || !m->accum) {
+        audmixClose(m);
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+    }
+
+    for (u32 i = 0; i < num_sources; i ++)
+        m->sources[i].gain = 1.0f;
+
+    return 0;
+}
+
+void audmixClose(AudioMixer* m)
+{
+    free(m->sources);
+    free(m->accum);
+    m->sources = NULL;
+    m->accum = NULL;
+}
+
+Result audmixSourcePlay(AudioMixer* m, u32 id, const void* data, u32 num_frames, u32 num_channels, bool is_float, u32 sample_rate, bool loop)
+{
+    if (id >= m->num_sources || !data || !num_frames || (num_channels != 1 && num_channels != 2) || !sample_rate)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    mutexLock(&m->mutex);
+    AudioMixerSource* s = &m->sources[id];
+    s->data = data;
+    s->num_frames = num_frames;
+    s->num_channels = num_channels;
+    s->is_float = is_float;
+    s->loop = loop;
+    s->step = ((u64)sample_rate << 32) / m->output_rate;
+    s->pos = 0;
+    s->active = true;
+    mutexUnlock(&m->mutex);
+    return 0;
+}
+
+void audmixSourceStop(AudioMixer* m, u32 id)
+{
+    if (id >= m->num_sources)
+        return;
+
+    mutexLock(&m->mutex);
+    m->sources[id].active = false;
+    mutexUnlock(&m->mutex);
+}
+
+bool audmixSourceIsPlaying(AudioMixer* m, u32 id)
+{
+    if (id >= m->num_sources)
+        return false;
+    return __atomic_load_n(&m->sources[id].active, __ATOMIC_RELAXED);
+}
+
+void audmixSourceSetGainPan(AudioMixer* m, u32 id, float gain, float pan)
+{
+    if (id >= m->num_sources)
+        return;
+
+    mutexLock(&m->mutex);
+    m->sources[id].gain = gain;
+    m->sources[id].pan = pan < -1.0f ? -1.0f : pan > 1.0f ? 1.0f : pan;
+    mutexUnlock(&m->mutex);
+}
+
+// Adds num_frames source frames, at the output rate, to the accumulator.
+static void _audmixAccumulate(const AudioMixerSource* s, u32 first, float* acc, u32 num_frames, float gl, float gr)
+{
+    u32 i = 0;
+
+    if (!s->is_float) {
+        const s16* src = (const s16*)s->data + first*s->num_channels;
+        gl *= 1.0f/32768;
+        gr *= 1.0f/32768;
+        if (s->num_channels == 2) {
+            for (; i + 4 <= num_frames; i += 4) {
+                int16x4x2_t v = vld2_s16(src + 2*i);
+                float32x4x2_t a = vld2q_f32(acc + 2*i);
+                a.val[0] = vfmaq_n_f32(a.val[0], vcvtq_f32_s32(vmovl_s16(v.val[0])), gl);
+                a.val[1] = vfmaq_n_f32(a.val[1], vcvtq_f32_s32(vmovl_s16(v.val[1])), gr);
+                vst2q_f32(acc + 2*i, a);
+            }
+            for (; i < num_frames; i ++) {
+                acc[2*i+0] += src[2*i+0] * gl;
+                acc[2*i+1] += src[2*i+1] * gr;
+            }
+        } else {
+            for (; i + 4 <= num_frames; i += 4) {
+                float32x4_t x = vcvtq_f32_s32(vmovl_s16(vld1_s16(src + i)));
+                float32x4x2_t a = vld2q_f32(acc + 2*i);
+                a.val[0] = vfmaq_n_f32(a.val[0], x, gl);
+                a.val[1] = vfmaq_n_f32(a.val[1], x, gr);
+                vst2q_f32(acc + 2*i, a);
+            }
+            for (; i < num_frames; i ++) {
+                acc[2*i+0] += src[i] * gl;
+                acc[2*i+1] += src[i] * gr;
+            }
+        }
+    } else {
+        const float* src = (const float*)s->data + first*s->num_channels;
+        if (s->num_channels == 2) {
+            for (; i + 4 <= num_frames; i += 4) {
+                float32x4x2_t v = vld2q_f32(src + 2*i);
+                float32x4x2_t a = vld2q_f32(acc + 2*i);
+                a.val[0] = vfmaq_n_f32(a.val[0], v.val[0], gl);
+                a.val[1] = vfmaq_n_f32(a.val[1], v.val[1], gr);
+                vst2q_f32(acc + 2*i, a);
+            }
+            for (; i < num_frames; i ++) {
+                acc[2*i+0] += src[2*i+0] * gl;
+                acc[2*i+1] += src[2*i+1] * gr;
+            }
+        } else {
+            for (; i + 4 <= num_frames; i += 4) {
+                float32x4_t x = vld1q_f32(src + i);
+                float32x4x2_t a = vld2q_f32(acc + 2*i);
+                a.val[0] = vfmaq_n_f32(a.val[0], x, gl);
+                a.val[1] = vfmaq_n_f32(a.val[1], x, gr);
+                vst2q_f32(acc + 2*i, a);
+            }
+            for (; i < num_frames; i ++) {
+                acc[2*i+0] += src[i] * gl;
+                acc[2*i+1] += src[i] * gr;
+            }
+        }
+    }
+}
+
+static inline float _audmixGetSample(const AudioMixerSource* s, u32 frame, u32 channel)
+{
+    u32 idx = frame*s->num_channels + (s->num_channels == 2 ? channel : 0);
+    return s->is_float ? ((const float*)s->data)[idx] : ((const s16*)s->data)[idx] * (1.0f/32768);
+}
+
+static void _audmixMixSource(AudioMixerSource* s, float* acc, u32 num_frames)
+{
+    float gl = s->gain * (s->pan > 0.0f ? 1.0f - s->pan : 1.0f);
+    float gr = s->gain * (s->pan < 0.0f ? 1.0f + s->pan : 1.0f);
+    u64 end = (u64)s->num_frames << 32;
+
+    if (s->step == (UINT64_C(1) << 32) && !(s->pos & 0xFFFFFFFF)) {
+        // Same rate as the output: straight copy of runs up to the end of the data.
+        while (num_frames) {
+            u32 first = s->pos >> 32;
+            u32 run = s->num_frames - first;
+            if (run > num_frames)
+                run = num_frames;
+
+            _audmixAccumulate(s, first, acc, run, gl, gr);
+            acc += 2*run;
+            num_frames -= run;
+            s->pos += (u64)run << 32;
+
+            if (s->pos >= end) {
+                s->pos = 0;
+                if (!s->loop) {
+                    __atomic_store_n(&s->active, false, __ATOMIC_RELAXED);
+                    break;
+                }
+            }
+        }
+        return;
+    }
+
+    for (u32 i = 0; i < num_frames; i ++) {
+        u32 frame = s->pos >> 32;
+        u32 next = frame + 1 < s->num_frames ? frame + 1 : s->loop ? 0 : frame;
+        float frac = (u32)s->pos * (1.0f/4294967296.0f);
+
+        for (u32 c = 0; c < 2; c ++) {
+            float a = _audmixGetSample(s, frame, c);
+            float b = _audmixGetSample(s, next, c);
+            acc[2*i+c] += (a + (b - a)*frac) * (c ? gr : gl);
+        }
+
+        s->pos += s->step;
+        if (s->pos >= end) {
+            if (!s->loop) {
+                s->pos = 0;
+                __atomic_store_n(&s->active, false, __ATOMIC_RELAXED);
+                break;
+            }
+            // The step can be larger than a very short source.
+            s->pos %= end;
+        }
+    }
+}
+
+void audmixMix(AudioMixer* m, s16* out, u32 num_frames)
+{
+    if (num_frames > m->max_frames)
+        num_frames = m->max_frames;
+
+    u32 num_samples = num_frames*2;
+    memset(m->accum, 0, num_samples*sizeof(float));
+
+    mutexLock(&m->mutex);
+    for (u32 i = 0; i < m->num_sources; i ++) {
+        if (m->sources[i].active)
+            _audmixMixSource(&m->sources[i], m->accum, num_frames);
+    }
+    mutexUnlock(&m->mutex);
+
+    // Convert with saturation: the conversion to s32 saturates, then the narrowing does too.
+    const float* acc = m->accum;
+    u32 i = 0;
+    for (; i + 8 <= num_samples; i += 8) {
+        int32x4_t lo = vcvtnq_s32_f32(vmulq_n_f32(vld1q_f32(acc + i), 32768.0f));
+        int32x4_t hi = vcvtnq_s32_f32(vmulq_n_f32(vld1q_f32(acc + i + 4), 32768.0f));
+        vst1q_s16(out + i, vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi)));
+    }
+    for (; i < num_samples; i ++) {
+        float x = acc[i] * 32768.0f;
+        out[i] = x >= 32767.0f ? 32767 : x <= -32768.0f ? -32768 : (s16)__builtin_lrintf(x);
+    }
+}
+
+static void _audmixFeederFill(AudioMixerFeeder* f, AudioOutBuffer* buf)
+{
+    audmixMix(f->mixer, (s16*)buf->buffer, f->buffer_frames);
+    armDCacheFlush(buf->buffer, buf->data_size);
+}
+
+static void _audmixFeederThreadFunc(void* arg)
+{
+    AudioMixerFeeder* f = (AudioMixerFeeder*)arg;
+
+    while (!__atomic_load_n(&f->exit, __ATOMIC_ACQUIRE)) {
+        AudioOutBuffer* released = NULL;
+        u32 released_count = 0;
+        if (R_FAILED(audoutWaitPlayFinish(&released, &released_count, FEEDER_WAIT_TIMEOUT)))
+            continue;
+
+        // Both buffers may have been released by the time the thread ran.
+        while (released_count && released) {
+            _audmixFeederFill(f, released);
+            audoutAppendAudioOutBuffer(released);
+            if (R_FAILED(audoutGetReleasedAudioOutBuffer(&released, &released_count)))
+                break;
+        }
+    }
+}
+
+Result audmixFeederCreate(AudioMixerFeeder* f, AudioMixer* m, u32 buffer_frames, int prio, int cpuid)
+{
+    if (!buffer_frames || buffer_frames > m->max_frames)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    memset(f, 0, sizeof(*f));
+    f->mixer = m;
+    f->buffer_frames = buffer_frames;
+
+    size_t data_size = buffer_frames * 2 * sizeof(s16);
+    size_t buffer_size = (data_size + 0xFFF) &~ 0xFFF;
+    f->mem = memalign(0x1000, 2*buffer_size);
+    if (!f->mem)
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+
+    Result rc = audoutStartAudioOut();
+
+    for (u32 i = 0; R_SUCCEEDED(rc) && i < 2; i ++) {
+        AudioOutBuffer* buf = &f->buffers[i];
+        buf->buffer = (u8*)f->mem + i*buffer_size;
+        buf->buffer_size = buffer_size;
+        buf->data_size = data_size;
+        buf->data_offset = 0;
+        _audmixFeederFill(f, buf);
+        rc = audoutAppendAudioOutBuffer(buf);
+    }
+
+    if (R_SUCCEEDED(rc))
+        rc = threadCreate(&f->thread, _audmixFeederThreadFunc, f, NULL, FEEDER_STACK_SIZE, prio, cpuid);
+
+    if (R_SUCCEEDED(rc)) {
+        rc = threadStart(&f->thread);
+        if (R_FAILED(rc))
+            threadClose(&f->thread);
+    }
+
+    if (R_FAILED(rc)) {
+        audoutStopAudioOut();
+        free(f->mem);
+        f->mem = NULL;
+    }
+
+    return rc;
+}
+
+void audmixFeederClose(AudioMixerFeeder* f)
+{
+    if (!f->mem)
+        return;
+
+    __atomic_store_n(&f->exit, true, __ATOMIC_RELEASE);
+    threadWaitForExit(&f->thread);
+    threadClose(&f->thread);
+
+    audoutStopAudioOut();
+    free(f->mem);
+    f->mem = NULL;
+}
@@ -0,0 +1,107 @@
+#include <malloc.h>
+#include <string.h>
+#include "types.h"
+#include "result.h"
+#include "kernel/svc.h"
+#include "audio/opus_stream.h"
+
+#define OPUS_STREAM_STACK_SIZE 0x4000
+#define OPUS_STREAM_IN_SIZE 0x4000
+#define OPUS_STREAM_PCM_FRAMES (2*5760) // Twice the longest packet (120ms at 48kHz)
+#define OPUS_STREAM_FULL_SLEEP_NS 5000000ULL // One audren frame
+
+static void _audrvOpusStreamThreadFunc(void* arg)
+{
+    AudioOpusStream* s = (AudioOpusStream*)arg;
+    u32 num_channels = s->decoder->channel_count;
+    bool eof = false;
+
+    while (!__atomic_load_n(&s->exit, __ATOMIC_ACQUIRE)) {
+        // Hand the decoded data over first, waiting for room in the ring.
+        if (s->pcm_frames) {
+            u32 written = audrvStreamWrite(s->stream, s->pcm_buf + s->pcm_offset*num_channels, s->pcm_frames);
+            s->pcm_offset += written;
+            s->pcm_frames -= written;
+            if (s->pcm_frames)
+                svcSleepThread(OPUS_STREAM_FULL_SLEEP_NS);
+            continue;
+        }
+
+        if (!eof && s->in_len < s->in_size) {
+            size_t len = s->read_cb(s->read_arg, s->in_buf + s->in_len, s->in_size - s->in_len);
+            s->in_len += len;
+            eof = !len;
+        }
+
+        s32 consumed=0, num_frames=0;
+        s->last_result = hwopusDecodeInterleavedBatch(s->decoder, &consumed, &num_frames, s->in_buf, s->in_len, s->pcm_buf, s->pcm_size);
+        memmove(s->in_buf, s->in_buf + consumed, s->in_len - consumed);
+        s->in_len -= consumed;
+        s->pcm_offset = 0;
+        s->pcm_frames = num_frames;
+
+        // A packet which doesn't fit in the input buffer can't ever be decoded.
+        if (R_SUCCEEDED(s->last_result) && !consumed && s->in_len == s->in_size)
+            s->last_result = MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+        // Stop on errors, and once the input ended and only an incomplete packet (if any) remains.
+        if (R_FAILED(s->last_result) || (eof && !consumed)) {
+            if (s->pcm_frames)
+                continue;
+            break;
+        }
+    }
+
+    __atomic_store_n(&s->finished, true, __ATOMIC_RELEASE);
+}
+
+Result audrvOpusStreamCreate(AudioOpusStream* s, HwopusDecoder* decoder, AudioDriverStream* stream, AudioOpusStreamReadFn read_cb, void* read_arg, int prio, int cpuid)
+{
+    if (stream->fill_cb || stream->num_channels != decoder->channel_count || !read_cb)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    memset(s, 0, sizeof(*s));
+    s->decoder = decoder;
+    s->stream = stream;
+    s->read_cb = read_cb;
+    s->read_arg = read_arg;
+    s->in_size = OPUS_STREAM_IN_SIZE;
+    s->pcm_size = OPUS_STREAM_PCM_FRAMES * decoder->channel_count * sizeof(s16);
+
+    s->in_buf = (u8*)malloc(s->in_size);
+    s->pcm_buf = (s16*)memalign(0x1000, s->pcm_size);
+    Result rc = s->in_buf && s->pcm_buf ? 0 : MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+
+    if (R_SUCCEEDED(rc))
+        rc = threadCreate(&s->thread, _audrvOpusStreamThreadFunc, s, NULL, OPUS_STREAM_STACK_SIZE, prio, cpuid);
+
+    if (R_SUCCEEDED(rc)) {
+        rc = threadStart(&s->thread);
+        if (R_FAILED(rc))
+            threadClose(&s->thread);
+    }
+
+    if (R_FAILED(rc)) {
+        free(s->in_buf);
+        free(s->pcm_buf);
+        s->in_buf = NULL;
+        s->pcm_buf = NULL;
+    }
+
+    return rc;
+}
+
+void audrvOpusStreamClose(AudioOpusStream* s)
+{
+    if (!s->in_buf)
+        return;
+
+    __atomic_store_n(&s->exit, true, __ATOMIC_RELEASE);
+    threadWaitForExit(&s->thread);
+    threadClose(&s->thread);
+
+    free(s->in_buf);
+    free(s->pcm_buf);
+    s->in_buf = NULL;
+    s->pcm_buf = NULL;
+}
@@ -0,0 +1,200 @@
+#include <stdlib.h>
+#include "driver_internal.h"
+#include "arm/cache.h"
+#include "audio/sample_bank.h"
+
+#define SAMPLE_BANK_ENTRIES_INITIAL 64
+
+static inline u32 _audrvSampleBankAlign(size_t size)
+{
+    return (size + AUDREN_BUFFER_ALIGNMENT-1) &~ (AUDREN_BUFFER_ALIGNMENT-1);
+}
+
+Result audrvSampleBankCreate(AudioSampleBank* b, AudioDriver* d, size_t pool_size, u32 max_pools)
+{
+    pool_size = (pool_size + AUDREN_MEMPOOL_ALIGNMENT-1) &~ (AUDREN_MEMPOOL_ALIGNMENT-1);
+    if (!pool_size || pool_size > UINT32_MAX || !max_pools || max_pools > AUDRV_SAMPLE_BANK_MAX_POOLS)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    memset(b, 0, sizeof(*b));
+    b->driver = d;
+    b->pool_size = pool_size;
+    b->max_pools = max_pools;
+    return 0;
+}
+
+void audrvSampleBankClose(AudioSampleBank* b)
+{
+    if (!b->num_pools) {
+        free(b->entries);
+        b->entries = NULL;
+        return;
+    }
+
+    for (u32 i = 0; i < b->num_pools; i ++)
+        audrvMemPoolDetach(b->driver, b->pools[i].mempool_id);
+    audrvUpdate(b->driver);
+
+    for (u32 i = 0; i < b->num_pools; i ++) {
+        audrvMemPoolRemove(b->driver, b->pools[i].mempool_id);
+        free(b->pools[i].mem);
+    }
+
+    free(b->entries);
+    b->entries = NULL;
+    b->num_pools = 0;
+}
+
+static AudioSampleBankPool* _audrvSampleBankAddPool(AudioSampleBank* b)
+{
+    if (b->num_pools == b->max_pools)
+        return NULL;
+
+    AudioSampleBankPool* pool = &b->pools[b->num_pools];
+    memset(pool, 0, sizeof(*pool));
+    pool->mem = (u8*)memalign(AUDREN_MEMPOOL_ALIGNMENT, b->pool_size);
+    if (!pool->mem)
+        return NULL;
+
+    pool->mempool_id = audrvMemPoolAdd(b->driver, pool->mem, b->pool_size);
+    if (pool->mempool_id < 0 || !audrvMemPoolAttach(b->driver, pool->mempool_id)) {
+        if (pool->mempool_id >= 0)
+            audrvMemPoolRemove(b->driver, pool->mempool_id);
+        free(pool->mem);
+        return NULL;
+    }
+
+    pool->dirty_start = b->pool_size;
+    b->num_pools ++;
+    return pool;
+}
+
+static int _audrvSampleBankNewEntry(AudioSampleBank* b)
+{
+    for (u32 i = 0; i < b->num_entries; i ++)
+        if (!b->entries[i].refcount)
+            return i;
+
+    u32 new_count = b->num_entries ? 2*b->num_entries : SAMPLE_BANK_ENTRIES_INITIAL;
+    AudioSampleBankEntry* entries = (AudioSampleBankEntry*)realloc(b->entries, new_count*sizeof(AudioSampleBankEntry));
+    if (!entries)
+        return -1;
+
+    memset(&entries[b->num_entries], 0, (new_count - b->num_entries)*sizeof(AudioSampleBankEntry));
+    b->entries = entries;
+
+    int id = b->num_entries;
+    b->num_entries = new_count;
+    return id;
+}
+
+int audrvSampleBankAdd(AudioSampleBank* b, const void* data, size_t size)
+{
+    if (!size || size > b->pool_size)
+        return -1;
+    u32 aligned_size = _audrvSampleBankAlign(size);
+
+    // Samples are only appended, the space of released ones is reclaimed by compaction.
+    AudioSampleBankPool* pool = NULL;
+    for (u32 i = 0; i < b->num_pools && !pool; i ++)
+        if (b->pool_size - b->pools[i].used >= aligned_size)
+            pool = &b->pools[i];
+    if (!pool)
+        pool = _audrvSampleBankAddPool(b);
+    if (!pool)
+        return -1;
+
+    int id = _audrvSampleBankNewEntry(b);
+    if (id < 0)
+        return -1;
+
+    AudioSampleBankEntry* e = &b->entries[id];
+    e->pool = pool - b->pools;
+    e->offset = pool->used;
+    e->size = size;
+    e->refcount = 1;
+
+    memcpy(pool->mem + e->offset, data, size);
+    if (pool->dirty_start > e->offset)
+        pool->dirty_start = e->offset;
+    if (pool->dirty_end < e->offset + size)
+        pool->dirty_end = e->offset + size;
+
+    pool->used += aligned_size;
+    pool->live += aligned_size;
+    return id;
+}
+
+void audrvSampleBankRetain(AudioSampleBank* b, int id)
+{
+    b->entries[id].refcount ++;
+}
+
+void audrvSampleBankRelease(AudioSampleBank* b, int id)
+{
+    AudioSampleBankEntry* e = &b->entries[id];
+    if (e->refcount && !--e->refcount)
+        b->pools[e->pool].live -= _audrvSampleBankAlign(e->size);
+}
+
+bool audrvSampleBankGetWaveBuf(AudioSampleBank* b, int id, AudioDriverWaveBuf* wavebuf)
+{
+    if (id < 0 || (u32)id >= b->num_entries || !b->entries[id].refcount)
+        return false;
+
+    AudioSampleBankEntry* e = &b->entries[id];
+    AudioSampleBankPool* pool = &b->pools[e->pool];
+    if (pool->dirty_start < pool->dirty_end) {
+        armDCacheFlush(pool->mem + pool->dirty_start, pool->dirty_end - pool->dirty_start);
+        pool->dirty_start = b->pool_size;
+        pool->dirty_end = 0;
+    }
+
+    wavebuf->data_raw = pool->mem + e->offset;
+    wavebuf->size = e->size;
+    return true;
+}
+
+static int _audrvSampleBankCompareOffset(const void* a, const void* b)
+{
+    const AudioSampleBankEntry* ea = *(AudioSampleBankEntry* const*)a;
+    const AudioSampleBankEntry* eb = *(AudioSampleBankEntry* const*)b;
+    return ea->offset < eb->offset ? -1 : ea->offset > eb->offset;
+}
+
+void audrvSampleBankCompact(AudioSampleBank* b)
+{
+    AudioSampleBankEntry** sorted = (AudioSampleBankEntry**)malloc(b->num_entries * sizeof(AudioSampleBankEntry*));
+    if (!sorted)
+        return;
+
+    for (u32 p = 0; p < b->num_pools; p ++) {
+        AudioSampleBankPool* pool = &b->pools[p];
+        if (pool->live == pool->used)
+            continue;
+
+        u32 count = 0;
+        for (u32 i = 0; i < b->num_entries; i ++)
+            if (b->entries[i].refcount && b->entries[i].pool == p)
+                sorted[count++] = &b->entries[i];
+        qsort(sorted, count, sizeof(AudioSampleBankEntry*), _audrvSampleBankCompareOffset);
+
+        // Slide every sample down to the end of the previous one.
+        u32 pos = 0;
+        for (u32 i = 0; i < count; i ++) {
+            AudioSampleBankEntry* e = sorted[i];
+            if (e->offset != pos) {
+                memmove(pool->mem + pos, pool->mem + e->offset, e->size);
+                e->offset = pos;
+            }
+            pos += _audrvSampleBankAlign(e->size);
+        }
+
+        pool->used = pos;
+        pool->dirty_start = 0;
+        if (pool->dirty_end < pos)
+            pool->dirty_end = pos;
+    }
+
+    free(sorted);
+}
@@ -0,0 +1,167 @@
+#include "driver_internal.h"
+#include "arm/cache.h"
+#include "audio/stream.h"
+
+static inline bool _audrvStreamChunkIsFree(AudioDriverWaveBuf* wavebuf)
+{
+    return wavebuf->state == AudioDriverWaveBufState_Free || wavebuf->state == AudioDriverWaveBufState_Done;
+}
+
+Result audrvStreamCreate(AudioDriverStream* s, AudioDriver* d, int voice_id, u32 num_channels, u32 sample_rate, u32 chunk_frames, u32 num_chunks, AudioDriverStreamFillFn fill_cb, void* fill_arg, u32 ring_frames)
+{
+    if (!num_channels || !chunk_frames || num_chunks < 2 || num_chunks > AUDRV_STREAM_MAX_CHUNKS)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+    if (!fill_cb && !ring_frames)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    memset(s, 0, sizeof(*s));
+    s->driver = d;
+    s->voice_id = voice_id;
+    s->mempool_id = -1;
+    s->num_channels = num_channels;
+    s->chunk_frames = chunk_frames;
+    s->chunk_stride = (chunk_frames * num_channels * sizeof(s16) + AUDREN_BUFFER_ALIGNMENT-1) &~ (AUDREN_BUFFER_ALIGNMENT-1);
+    s->num_chunks = num_chunks;
+    s->fill_cb = fill_cb;
+    s->fill_arg = fill_arg;
+
+    if (!fill_cb) {
+        s->ring_frames = ring_frames;
+        s->ring = (s16*)malloc((size_t)s->ring_frames * num_channels * sizeof(s16));
+        if (!s->ring)
+            return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+    }
+
+    s->mem_size = ((size_t)s->chunk_stride * num_chunks + AUDREN_MEMPOOL_ALIGNMENT-1) &~ (AUDREN_MEMPOOL_ALIGNMENT-1);
+    s->mem = (u8*)memalign(AUDREN_MEMPOOL_ALIGNMENT, s->mem_size);
+    if (!s->mem) {
+        free(s->ring);
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+    }
+
+    s->mempool_id = audrvMemPoolAdd(d, s->mem, s->mem_size);
+    if (s->mempool_id < 0 || !audrvMemPoolAttach(d, s->mempool_id) || !audrvVoiceInit(d, voice_id, num_channels, PcmFormat_Int16, sample_rate)) {
+        if (s->mempool_id >= 0)
+            audrvMemPoolRemove(d, s->mempool_id);
+        free(s->mem);
+        free(s->ring);
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+    }
+
+    for (u32 i = 0; i < num_chunks; i ++) {
+        s->wavebufs[i].data_raw = s->mem + i*s->chunk_stride;
+        s->wavebufs[i].state = AudioDriverWaveBufState_Free;
+    }
+
+    return 0;
+}
+
+void audrvStreamClose(AudioDriverStream* s)
+{
+    if (!s->mem)
+        return;
+
+    AudioDriver* d = s->driver;
+    audrvVoiceDrop(d, s->voice_id);
+    audrvMemPoolDetach(d, s->mempool_id);
+    audrvUpdate(d);
+    audrvMemPoolRemove(d, s->mempool_id);
+
+    free(s->mem);
+    free(s->ring);
+    s->mem = NULL;
+    s->ring = NULL;
+}
+
+static u32 _audrvStreamRingRead(AudioDriverStream* s, s16* out, u32 num_frames)
+{
+    u64 read_pos = s->ring_read_pos;
+    u64 avail = __atomic_load_n(&s->ring_write_pos, __ATOMIC_ACQUIRE) - read_pos;
+    if (num_frames > avail)
+        num_frames = avail;
+
+    u32 offset = read_pos % s->ring_frames;
+    u32 first = s->ring_frames - offset;
+    if (first > num_frames)
+        first = num_frames;
+
+    memcpy(out, &s->ring[offset*s->num_channels], first*s->num_channels*sizeof(s16));
+    memcpy(out + first*s->num_channels, s->ring, (num_frames-first)*s->num_channels*sizeof(s16));
+
+    __atomic_store_n(&s->ring_read_pos, read_pos + num_frames, __ATOMIC_RELEASE);
+    return num_frames;
+}
+
+u32 audrvStreamWrite(AudioDriverStream* s, const s16* data, u32 num_frames)
+{
+    u64 write_pos = s->ring_write_pos;
+    u64 space = s->ring_frames - (write_pos - __atomic_load_n(&s->ring_read_pos, __ATOMIC_ACQUIRE));
+    if (num_frames > space)
+        num_frames = space;
+
+    u32 offset = write_pos % s->ring_frames;
+    u32 first = s->ring_frames - offset;
+    if (first > num_frames)
+        first = num_frames;
+
+    memcpy(&s->ring[offset*s->num_channels], data, first*s->num_channels*sizeof(s16));
+    memcpy(s->ring, data + first*s->num_channels, (num_frames-first)*s->num_channels*sizeof(s16));
+
+    __atomic_store_n(&s->ring_write_pos, write_pos + num_frames, __ATOMIC_RELEASE);
+    return num_frames;
+}
+
+u32 audrvStreamGetQueuedFrames(AudioDriverStream* s)
+{
+    u64 played = s->driver->etc->voices[s->voice_id].played_sample_count;
+    return s->submitted_frames > played ? s->submitted_frames - played : 0;
+}
+
+void audrvStreamUpdate(AudioDriverStream* s)
+{
+    AudioDriver* d = s->driver;
+
+    // Once everything has played (or the voice was stopped, which resets its played sample count), start counting over.
+    bool in_flight = false;
+    for (u32 i = 0; i < s->num_chunks; i ++)
+        in_flight = in_flight || !_audrvStreamChunkIsFree(&s->wavebufs[i]);
+    if (!in_flight)
+        s->submitted_frames = d->etc->voices[s->voice_id].played_sample_count;
+
+    // Chunks are recycled in the order they were queued in.
+    AudioDriverWaveBuf* wavebuf;
+    while (wavebuf = &s->wavebufs[s->next_chunk], _audrvStreamChunkIsFree(wavebuf)) {
+        u32 queued = audrvStreamGetQueuedFrames(s);
+        if (in_flight && s->low_water_frames && queued >= s->low_water_frames)
+            break;
+
+        u32 num_frames;
+        s16* data = (s16*)wavebuf->data_pcm16;
+        if (s->fill_cb)
+            num_frames = s->fill_cb(s->fill_arg, data, s->chunk_frames);
+        else {
+            // Only queue partial chunks when about to run out, each one takes one of the few wavebuf slots.
+            u64 avail = __atomic_load_n(&s->ring_write_pos, __ATOMIC_ACQUIRE) - s->ring_read_pos;
+            if (avail < s->chunk_frames && queued >= s->chunk_frames)
+                break;
+            num_frames = _audrvStreamRingRead(s, data, s->chunk_frames);
+        }
+
+        if (!num_frames)
+            break;
+
+        wavebuf->size = num_frames * s->num_channels * sizeof(s16);
+        wavebuf->start_sample_offset = 0;
+        wavebuf->end_sample_offset = num_frames;
+        armDCacheFlush(data, wavebuf->size);
+        if (!audrvVoiceAddWaveBuf(d, s->voice_id, wavebuf))
+            break;
+
+        s->submitted_frames += num_frames;
+        s->next_chunk = (s->next_chunk + 1) % s->num_chunks;
+        in_flight = true;
+    }
+
+    if (in_flight)
+        audrvVoiceStart(d, s->voice_id);
+}
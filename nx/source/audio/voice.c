@@ -37,6 +37,7 @@ bool audrvVoiceInit(AudioDriver* d, int id, int num_channels, PcmFormat format,
     d->etc->first_used_voice = id;
     if (next_voice >= 0)
         d->etc->voices[next_voice].prev_next_voice = &d->etc->voices[id].next_used_voice;
+    d->etc->voice_list_changed = true;
 
     // Allocate the channels
     d->etc->free_channel_count -= num_channels;
@@ -83,6 +84,7 @@ void audrvVoiceDrop(AudioDriver* d, int id)
     *d->etc->voices[id].prev_next_voice = next_voice;
     if (next_voice >= 0)
         d->etc->voices[next_voice].prev_next_voice = d->etc->voices[id].prev_next_voice;
+    d->etc->voice_list_changed = true;
 
     // Clear out state
     memset(&d->in_voices[id], 0, sizeof(AudioRendererVoiceInfoIn));
@@ -200,6 +202,11 @@ void audrvVoiceSetBiquadFilter(AudioDriver* d, int id, int biquad_id, float a0,
 
 void _audrvVoiceUpdate(AudioDriver* d, int id, AudioRendererVoiceInfoOut* out_voice)
 {
+    // Nothing to do for a voice which was already sent and has no wavebufs: its single-frame flags are already
+    // cleared, and its played sample count can't have moved.
+    if (!d->in_voices[id].is_new && !d->etc->voices[id].first_wavebuf)
+        return;
+
     // Update single-frame flags
     d->in_voices[id].is_new = false;
     for (int i = 0; i < 4; i ++)
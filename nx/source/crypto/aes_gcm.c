@@ -0,0 +1,489 @@
+#include <string.h>
+#include <stdlib.h>
+#include <arm_neon.h>
+
+#include "result.h"
+#include "crypto/aes_gcm.h"
+
+/*
+ * GHASH is computed on bit-reflected blocks: after reversing the bits of every byte,
+ * a block read as a little-endian 128-bit integer is the field element with bit i
+ * holding the coefficient of x^i, which is what PMULL operates on.
+ */
+
+/* Function body macros. */
+#define GCM_CONTEXT_CREATE(cipher) \
+do { \
+    cipher##ContextCreate(&out->aes_ctx, key, true); \
+\
+    /* Derive the hash key and its powers. */ \
+    u8 block[AES_BLOCK_SIZE] = {0}; \
+    cipher##EncryptBlock(&out->aes_ctx, block, block); \
+    const uint8x16_t h1 = vrbitq_u8(vld1q_u8(block)); \
+    const uint8x16_t h2 = _ghashMultiply(h1, h1); \
+    const uint8x16_t h3 = _ghashMultiply(h2, h1); \
+    const uint8x16_t h4 = _ghashMultiply(h3, h1); \
+    vst1q_u8(out->h[0], h1); \
+    vst1q_u8(out->h[1], h2); \
+    vst1q_u8(out->h[2], h3); \
+    vst1q_u8(out->h[3], h4); \
+\
+    _gcmDeriveJ0(out->j0, out->h, iv, iv_size); \
+    memcpy(out->ctr, out->j0, sizeof(out->ctr)); \
+    _gcmIncrementCtr(out->ctr); \
+\
+    memset(out->ghash, 0, sizeof(out->ghash)); \
+    memset(out->buffer, 0, sizeof(out->buffer)); \
+    memset(out->enc_ctr_buffer, 0, sizeof(out->enc_ctr_buffer)); \
+    memset(out->mac, 0, sizeof(out->mac)); \
+    out->num_buffered = 0; \
+    out->aad_size = 0; \
+    out->msg_size = 0; \
+    out->aad_finalized = false; \
+    out->finalized = false; \
+} while (0)
+
+#define GCM_UPDATE_AAD() \
+do { \
+    if (ctx->aad_finalized) { \
+        break; \
+    } \
+    ctx->aad_size += size; \
+    _ghashUpdate(ctx->ghash, ctx->h, ctx->buffer, &ctx->num_buffered, src, size); \
+} while (0)
+
+#define GCM_CRYPT_FUNC_BODY(cipher, num_rounds, encrypt) \
+do { \
+    const u8 *cur_src = src; \
+    u8 *cur_dst = dst; \
+\
+    _gcmFinalizeAad(ctx->ghash, ctx->h, ctx->buffer, &ctx->num_buffered, &ctx->aad_finalized); \
+    ctx->msg_size += size; \
+\
+    /* Handle pre-buffered data. */ \
+    if (ctx->num_buffered > 0) { \
+        const size_t needed = AES_BLOCK_SIZE - ctx->num_buffered; \
+        const size_t copyable = (size > needed ? needed : size); \
+        for (size_t i = 0; i < copyable; i++) { \
+            const u8 in = cur_src[i]; \
+            const u8 res = in ^ ctx->enc_ctr_buffer[ctx->num_buffered + i]; \
+            ctx->buffer[ctx->num_buffered + i] = (encrypt) ? res : in; \
+            cur_dst[i] = res; \
+        } \
+        cur_dst += copyable; \
+        cur_src += copyable; \
+        ctx->num_buffered += copyable; \
+        size -= copyable; \
+\
+        if (ctx->num_buffered == AES_BLOCK_SIZE) { \
+            _ghashBlocks(ctx->ghash, ctx->h, ctx->buffer, 1); \
+            ctx->num_buffered = 0; \
+        } \
+    } \
+\
+    /* Handle complete blocks. */ \
+    if (size >= AES_BLOCK_SIZE) { \
+        const size_t num_blocks = size / AES_BLOCK_SIZE; \
+        _gcmCryptBlocks(ctx->ghash, ctx->h, ctx->ctr, ctx->aes_ctx.round_keys, num_rounds, cur_dst, cur_src, num_blocks, encrypt); \
+        size -= num_blocks * AES_BLOCK_SIZE; \
+        cur_src += num_blocks * AES_BLOCK_SIZE; \
+        cur_dst += num_blocks * AES_BLOCK_SIZE; \
+    } \
+\
+    /* Buffer remaining data. */ \
+    if (size > 0) { \
+        cipher##EncryptBlock(&ctx->aes_ctx, ctx->enc_ctr_buffer, ctx->ctr); \
+        _gcmIncrementCtr(ctx->ctr); \
+        memset(ctx->buffer, 0, sizeof(ctx->buffer)); \
+        for (size_t i = 0; i < size; i++) { \
+            const u8 in = cur_src[i]; \
+            const u8 res = in ^ ctx->enc_ctr_buffer[i]; \
+            ctx->buffer[i] = (encrypt) ? res : in; \
+            cur_dst[i] = res; \
+        } \
+        ctx->num_buffered = size; \
+    } \
+} while (0)
+
+#define GCM_GET_MAC(cipher) \
+do { \
+    if (!ctx->finalized) { \
+        _gcmFinalizeAad(ctx->ghash, ctx->h, ctx->buffer, &ctx->num_buffered, &ctx->aad_finalized); \
+\
+        /* Hash the zero-padded partial block, if any. */ \
+        if (ctx->num_buffered > 0) { \
+            memset(ctx->buffer + ctx->num_buffered, 0, AES_BLOCK_SIZE - ctx->num_buffered); \
+            _ghashBlocks(ctx->ghash, ctx->h, ctx->buffer, 1); \
+            ctx->num_buffered = 0; \
+        } \
+\
+        /* Hash the lengths, in bits. */ \
+        _gcmStoreBe64(ctx->buffer, ctx->aad_size * 8); \
+        _gcmStoreBe64(ctx->buffer + 8, ctx->msg_size * 8); \
+        _ghashBlocks(ctx->ghash, ctx->h, ctx->buffer, 1); \
+\
+        /* Mask with the encrypted initial counter. */ \
+        cipher##EncryptBlock(&ctx->aes_ctx, ctx->mac, ctx->j0); \
+        vst1q_u8(ctx->mac, veorq_u8(vld1q_u8(ctx->mac), vrbitq_u8(vld1q_u8(ctx->ghash)))); \
+        memset(ctx->buffer, 0, sizeof(ctx->buffer)); \
+        memset(ctx->enc_ctr_buffer, 0, sizeof(ctx->enc_ctr_buffer)); \
+        ctx->finalized = true; \
+    } \
+\
+    memcpy(dst, ctx->mac, sizeof(ctx->mac)); \
+} while (0)
+
+#define GCM_VERIFY_MAC(cipher) \
+do { \
+    u8 calc[AES_GCM_MAC_SIZE]; \
+    cipher##GcmGetMac(ctx, calc); \
+\
+    if (mac_size == 0 || mac_size > sizeof(calc)) { \
+        return false; \
+    } \
+\
+    /* Compare in constant time. */ \
+    const u8 *mac_u8 = mac; \
+    u8 diff = 0; \
+    for (size_t i = 0; i < mac_size; i++) { \
+        diff |= calc[i] ^ mac_u8[i]; \
+    } \
+    memset(calc, 0, sizeof(calc)); \
+    return diff == 0; \
+} while (0)
+
+static inline void _gcmStoreBe64(u8 *dst, u64 val) {
+    for (size_t i = 0; i < sizeof(val); i++) {
+        dst[i] = (u8)(val >> (56 - 8 * i));
+    }
+}
+
+/* Increments the low 32 bits of a counter block, as specified by GCM. */
+static inline void _gcmIncrementCtr(u8 *ctr) {
+    u32 val = ((u32)ctr[12] << 24) | ((u32)ctr[13] << 16) | ((u32)ctr[14] << 8) | ctr[15];
+    val++;
+    ctr[12] = (u8)(val >> 24);
+    ctr[13] = (u8)(val >> 16);
+    ctr[14] = (u8)(val >> 8);
+    ctr[15] = (u8)val;
+}
+
+static inline uint8x16_t _gcmMakeCtr(const uint8x16_t base, u32 val) {
+    return vreinterpretq_u8_u32(vsetq_lane_u32(__builtin_bswap32(val), vreinterpretq_u32_u8(base), 3));
+}
+
+/* Carry-less multiplies of 64-bit halves. */
+static inline uint8x16_t _pmullLow(const uint8x16_t a, const uint8x16_t b) {
+    return vreinterpretq_u8_p128(vmull_p64(vgetq_lane_p64(vreinterpretq_p64_u8(a), 0), vgetq_lane_p64(vreinterpretq_p64_u8(b), 0)));
+}
+
+static inline uint8x16_t _pmullHigh(const uint8x16_t a, const uint8x16_t b) {
+    return vreinterpretq_u8_p128(vmull_high_p64(vreinterpretq_p64_u8(a), vreinterpretq_p64_u8(b)));
+}
+
+/* Accumulates the unreduced 256-bit product of a and h into lo/mid/hi. */
+static inline void _ghashMultiplyAccumulate(uint8x16_t *lo, uint8x16_t *mid, uint8x16_t *hi, const uint8x16_t a, const uint8x16_t h) {
+    const uint8x16_t h_swapped = vextq_u8(h, h, 8);
+    *lo  = veorq_u8(*lo, _pmullLow(a, h));
+    *hi  = veorq_u8(*hi, _pmullHigh(a, h));
+    *mid = veorq_u8(*mid, veorq_u8(_pmullLow(a, h_swapped), _pmullHigh(a, h_swapped)));
+}
+
+/* Reduces an accumulated product modulo x^128 + x^7 + x^2 + x + 1. */
+static inline uint8x16_t _ghashReduce(uint8x16_t lo, const uint8x16_t mid, uint8x16_t hi) {
+    const uint8x16_t zero = vdupq_n_u8(0);
+    const uint8x16_t poly = vreinterpretq_u8_u64(vdupq_n_u64(0x87));
+
+    /* Fold the middle product into the low and high halves. */
+    lo = veorq_u8(lo, vextq_u8(zero, mid, 8));
+    hi = veorq_u8(hi, vextq_u8(mid, zero, 8));
+
+    /* Fold bits 192-255 into bits 64-191, then bits 128-191 into bits 0-127. */
+    const uint8x16_t t = _pmullHigh(hi, poly);
+    lo = veorq_u8(lo, vextq_u8(zero, t, 8));
+    hi = veorq_u8(hi, vextq_u8(t, zero, 8));
+    return veorq_u8(lo, _pmullLow(hi, poly));
+}
+
+static inline uint8x16_t _ghashMultiply(const uint8x16_t a, const uint8x16_t b) {
+    uint8x16_t lo = vdupq_n_u8(0), mid = vdupq_n_u8(0), hi = vdupq_n_u8(0);
+    _ghashMultiplyAccumulate(&lo, &mid, &hi, a, b);
+    return _ghashReduce(lo, mid, hi);
+}
+
+/* Hashes four reflected blocks at once, with a single reduction. */
+static inline uint8x16_t _ghashFourBlocks(const uint8x16_t x, const uint8x16_t h1, const uint8x16_t h2, const uint8x16_t h3, const uint8x16_t h4,
+                                          const uint8x16_t b0, const uint8x16_t b1, const uint8x16_t b2, const uint8x16_t b3) {
+    uint8x16_t lo = vdupq_n_u8(0), mid = vdupq_n_u8(0), hi = vdupq_n_u8(0);
+    _ghashMultiplyAccumulate(&lo, &mid, &hi, veorq_u8(x, b0), h4);
+    _ghashMultiplyAccumulate(&lo, &mid, &hi, b1, h3);
+    _ghashMultiplyAccumulate(&lo, &mid, &hi, b2, h2);
+    _ghashMultiplyAccumulate(&lo, &mid, &hi, b3, h1);
+    return _ghashReduce(lo, mid, hi);
+}
+
+static void _ghashBlocks(u8 *ghash, const u8 (*h)[AES_BLOCK_SIZE], const u8 *src_u8, size_t num_blocks) {
+    const uint8x16_t h1 = vld1q_u8(h[0]);
+    uint8x16_t x = vld1q_u8(ghash);
+
+    if (num_blocks >= 4) {
+        const uint8x16_t h2 = vld1q_u8(h[1]);
+        const uint8x16_t h3 = vld1q_u8(h[2]);
+        const uint8x16_t h4 = vld1q_u8(h[3]);
+
+        while (num_blocks >= 4) {
+            const uint8x16_t b0 = vrbitq_u8(vld1q_u8(src_u8 + 0 * AES_BLOCK_SIZE));
+            const uint8x16_t b1 = vrbitq_u8(vld1q_u8(src_u8 + 1 * AES_BLOCK_SIZE));
+            const uint8x16_t b2 = vrbitq_u8(vld1q_u8(src_u8 + 2 * AES_BLOCK_SIZE));
+            const uint8x16_t b3 = vrbitq_u8(vld1q_u8(src_u8 + 3 * AES_BLOCK_SIZE));
+            x = _ghashFourBlocks(x, h1, h2, h3, h4, b0, b1, b2, b3);
+            src_u8 += 4 * AES_BLOCK_SIZE;
+            num_blocks -= 4;
+        }
+    }
+
+    while (num_blocks >= 1) {
+        x = _ghashMultiply(veorq_u8(x, vrbitq_u8(vld1q_u8(src_u8))), h1);
+        src_u8 += AES_BLOCK_SIZE;
+        num_blocks--;
+    }
+
+    vst1q_u8(ghash, x);
+}
+
+/* Hashes arbitrary data, keeping any trailing partial block in buffer. */
+static void _ghashUpdate(u8 *ghash, const u8 (*h)[AES_BLOCK_SIZE], u8 *buffer, size_t *num_buffered, const void *src, size_t size) {
+    const u8 *cur_src = src;
+
+    if (*num_buffered > 0) {
+        const size_t needed = AES_BLOCK_SIZE - *num_buffered;
+        const size_t copyable = (size > needed ? needed : size);
+        memcpy(buffer + *num_buffered, cur_src, copyable);
+        cur_src += copyable;
+        *num_buffered += copyable;
+        size -= copyable;
+
+        if (*num_buffered == AES_BLOCK_SIZE) {
+            _ghashBlocks(ghash, h, buffer, 1);
+            *num_buffered = 0;
+        }
+    }
+
+    if (size >= AES_BLOCK_SIZE) {
+        const size_t num_blocks = size / AES_BLOCK_SIZE;
+        _ghashBlocks(ghash, h, cur_src, num_blocks);
+        size -= num_blocks * AES_BLOCK_SIZE;
+        cur_src += num_blocks * AES_BLOCK_SIZE;
+    }
+
+    if (size > 0) {
+        memcpy(buffer, cur_src, size);
+        *num_buffered = size;
+    }
+}
+
+/* Hashes the zero-padded trailing AAD block, once. */
+static void _gcmFinalizeAad(u8 *ghash, const u8 (*h)[AES_BLOCK_SIZE], u8 *buffer, size_t *num_buffered, bool *aad_finalized) {
+    if (*aad_finalized) {
+        return;
+    }
+
+    if (*num_buffered > 0) {
+        memset(buffer + *num_buffered, 0, AES_BLOCK_SIZE - *num_buffered);
+        _ghashBlocks(ghash, h, buffer, 1);
+        *num_buffered = 0;
+    }
+    *aad_finalized = true;
+}
+
+static void _gcmDeriveJ0(u8 *j0, const u8 (*h)[AES_BLOCK_SIZE], const void *iv, size_t iv_size) {
+    if (iv_size == AES_GCM_IV_SIZE) {
+        /* J0 = IV || 0^31 || 1 */
+        memcpy(j0, iv, AES_GCM_IV_SIZE);
+        memset(j0 + AES_GCM_IV_SIZE, 0, AES_BLOCK_SIZE - AES_GCM_IV_SIZE);
+        j0[AES_BLOCK_SIZE - 1] = 1;
+    } else {
+        /* J0 = GHASH(IV || 0-padding || 0^64 || bitlen(IV)) */
+        u8 ghash[AES_BLOCK_SIZE] = {0};
+        u8 buffer[AES_BLOCK_SIZE] = {0};
+        size_t num_buffered = 0;
+        bool aad_finalized = false;
+        _ghashUpdate(ghash, h, buffer, &num_buffered, iv, iv_size);
+        _gcmFinalizeAad(ghash, h, buffer, &num_buffered, &aad_finalized);
+
+        memset(buffer, 0, 8);
+        _gcmStoreBe64(buffer + 8, (u64)iv_size * 8);
+        _ghashBlocks(ghash, h, buffer, 1);
+
+        vst1q_u8(j0, vrbitq_u8(vld1q_u8(ghash)));
+    }
+}
+
+/*
+ * Encrypts or decrypts complete blocks, four at a time.
+ * GHASH is stitched into the CTR loop: when decrypting, the ciphertext of the current group is hashed while it is being decrypted;
+ * when encrypting, the ciphertext of the previous group is hashed while the current one is being encrypted.
+ * Neither depends on the AES rounds in flight, so PMULL and AESE/AESMC can issue in parallel.
+ */
+__attribute__((always_inline)) static inline void _gcmCryptBlocks(u8 *ghash, const u8 (*h)[AES_BLOCK_SIZE], u8 *ctr, const u8 (*round_key_u8)[AES_BLOCK_SIZE], const int num_rounds,
+                                                                  u8 *dst_u8, const u8 *src_u8, size_t num_blocks, const bool encrypt) {
+    /* Preload all round keys + hash keys into neon registers. */
+    uint8x16_t round_keys[AES_256_NUM_ROUNDS + 1];
+    #pragma GCC unroll 16
+    for (int r = 0; r <= num_rounds; r++) {
+        round_keys[r] = vld1q_u8(round_key_u8[r]);
+    }
+    const uint8x16_t h1 = vld1q_u8(h[0]);
+    const uint8x16_t h2 = vld1q_u8(h[1]);
+    const uint8x16_t h3 = vld1q_u8(h[2]);
+    const uint8x16_t h4 = vld1q_u8(h[3]);
+
+    const uint8x16_t ctr_base = vld1q_u8(ctr);
+    u32 ctr_val = __builtin_bswap32(vgetq_lane_u32(vreinterpretq_u32_u8(ctr_base), 3));
+    uint8x16_t x = vld1q_u8(ghash);
+
+    if (num_blocks >= 4) {
+        /* Ciphertext of the previous group, pending to be hashed (encryption only). */
+        uint8x16_t p0 = vdupq_n_u8(0), p1 = vdupq_n_u8(0), p2 = vdupq_n_u8(0), p3 = vdupq_n_u8(0);
+        bool pending = false;
+
+        while (num_blocks >= 4) {
+            const uint8x16_t block0 = vld1q_u8(src_u8 + 0 * AES_BLOCK_SIZE);
+            const uint8x16_t block1 = vld1q_u8(src_u8 + 1 * AES_BLOCK_SIZE);
+            const uint8x16_t block2 = vld1q_u8(src_u8 + 2 * AES_BLOCK_SIZE);
+            const uint8x16_t block3 = vld1q_u8(src_u8 + 3 * AES_BLOCK_SIZE);
+            src_u8 += 4 * AES_BLOCK_SIZE;
+
+            uint8x16_t tmp0 = _gcmMakeCtr(ctr_base, ctr_val + 0);
+            uint8x16_t tmp1 = _gcmMakeCtr(ctr_base, ctr_val + 1);
+            uint8x16_t tmp2 = _gcmMakeCtr(ctr_base, ctr_val + 2);
+            uint8x16_t tmp3 = _gcmMakeCtr(ctr_base, ctr_val + 3);
+            ctr_val += 4;
+
+            if (!encrypt) {
+                p0 = vrbitq_u8(block0);
+                p1 = vrbitq_u8(block1);
+                p2 = vrbitq_u8(block2);
+                p3 = vrbitq_u8(block3);
+                pending = true;
+            }
+
+            /* Hash, independently of the rounds below. */
+            if (pending) {
+                x = _ghashFourBlocks(x, h1, h2, h3, h4, p0, p1, p2, p3);
+            }
+
+            /* Encrypt the four counters. */
+            #pragma GCC unroll 16
+            for (int r = 0; r < num_rounds - 1; r++) {
+                tmp0 = vaesmcq_u8(vaeseq_u8(tmp0, round_keys[r]));
+                tmp1 = vaesmcq_u8(vaeseq_u8(tmp1, round_keys[r]));
+                tmp2 = vaesmcq_u8(vaeseq_u8(tmp2, round_keys[r]));
+                tmp3 = vaesmcq_u8(vaeseq_u8(tmp3, round_keys[r]));
+            }
+            tmp0 = veorq_u8(vaeseq_u8(tmp0, round_keys[num_rounds - 1]), round_keys[num_rounds]);
+            tmp1 = veorq_u8(vaeseq_u8(tmp1, round_keys[num_rounds - 1]), round_keys[num_rounds]);
+            tmp2 = veorq_u8(vaeseq_u8(tmp2, round_keys[num_rounds - 1]), round_keys[num_rounds]);
+            tmp3 = veorq_u8(vaeseq_u8(tmp3, round_keys[num_rounds - 1]), round_keys[num_rounds]);
+
+            /* XOR blocks. */
+            tmp0 = veorq_u8(block0, tmp0);
+            tmp1 = veorq_u8(block1, tmp1);
+            tmp2 = veorq_u8(block2, tmp2);
+            tmp3 = veorq_u8(block3, tmp3);
+
+            /* Store to output. */
+            vst1q_u8(dst_u8 + 0 * AES_BLOCK_SIZE, tmp0);
+            vst1q_u8(dst_u8 + 1 * AES_BLOCK_SIZE, tmp1);
+            vst1q_u8(dst_u8 + 2 * AES_BLOCK_SIZE, tmp2);
+            vst1q_u8(dst_u8 + 3 * AES_BLOCK_SIZE, tmp3);
+            dst_u8 += 4 * AES_BLOCK_SIZE;
+
+            if (encrypt) {
+                p0 = vrbitq_u8(tmp0);
+                p1 = vrbitq_u8(tmp1);
+                p2 = vrbitq_u8(tmp2);
+                p3 = vrbitq_u8(tmp3);
+                pending = true;
+            }
+
+            num_blocks -= 4;
+        }
+
+        /* Hash the last encrypted group. */
+        if (encrypt) {
+            x = _ghashFourBlocks(x, h1, h2, h3, h4, p0, p1, p2, p3);
+        }
+    }
+
+    while (num_blocks >= 1) {
+        const uint8x16_t block0 = vld1q_u8(src_u8);
+        src_u8 += AES_BLOCK_SIZE;
+
+        uint8x16_t tmp0 = _gcmMakeCtr(ctr_base, ctr_val++);
+        #pragma GCC unroll 16
+        for (int r = 0; r < num_rounds - 1; r++) {
+            tmp0 = vaesmcq_u8(vaeseq_u8(tmp0, round_keys[r]));
+        }
+        tmp0 = veorq_u8(vaeseq_u8(tmp0, round_keys[num_rounds - 1]), round_keys[num_rounds]);
+        tmp0 = veorq_u8(block0, tmp0);
+
+        vst1q_u8(dst_u8, tmp0);
+        dst_u8 += AES_BLOCK_SIZE;
+
+        x = _ghashMultiply(veorq_u8(x, vrbitq_u8(encrypt ? tmp0 : block0)), h1);
+
+        num_blocks--;
+    }
+
+    vst1q_u8(ghash, x);
+    vst1q_u8(ctr, _gcmMakeCtr(ctr_base, ctr_val));
+}
+
+void aes128GcmContextCreate(Aes128GcmContext *out, const void *key, const void *iv, size_t iv_size) {
+    GCM_CONTEXT_CREATE(aes128);
+}
+
+void aes128GcmUpdateAad(Aes128GcmContext *ctx, const void *src, size_t size) {
+    GCM_UPDATE_AAD();
+}
+
+void aes128GcmEncrypt(Aes128GcmContext *ctx, void *dst, const void *src, size_t size) {
+    GCM_CRYPT_FUNC_BODY(aes128, AES_128_NUM_ROUNDS, true);
+}
+
+void aes128GcmDecrypt(Aes128GcmContext *ctx, void *dst, const void *src, size_t size) {
+    GCM_CRYPT_FUNC_BODY(aes128, AES_128_NUM_ROUNDS, false);
+}
+
+void aes128GcmGetMac(Aes128GcmContext *ctx, void *dst) {
+    GCM_GET_MAC(aes128);
+}
+
+bool aes128GcmVerifyMac(Aes128GcmContext *ctx, const void *mac, size_t mac_size) {
+    GCM_VERIFY_MAC(aes128);
+}
+
+void aes256GcmContextCreate(Aes256GcmContext *out, const void *key, const void *iv, size_t iv_size) {
+    GCM_CONTEXT_CREATE(aes256);
+}
+
+void aes256GcmUpdateAad(Aes256GcmContext *ctx, const void *src, size_t size) {
+    GCM_UPDATE_AAD();
+}
+
+void aes256GcmEncrypt(Aes256GcmContext *ctx, void *dst, const void *src, size_t size) {
+    GCM_CRYPT_FUNC_BODY(aes256, AES_256_NUM_ROUNDS, true);
+}
+
+void aes256GcmDecrypt(Aes256GcmContext *ctx, void *dst, const void *src, size_t size) {
+    GCM_CRYPT_FUNC_BODY(aes256, AES_256_NUM_ROUNDS, false);
+}
+
+void aes256GcmGetMac(Aes256GcmContext *ctx, void *dst) {
+    GCM_GET_MAC(aes256);
+}
+
+bool aes256GcmVerifyMac(Aes256GcmContext *ctx, const void *mac, size_t mac_size) {
+    GCM_VERIFY_MAC(aes256);
+}
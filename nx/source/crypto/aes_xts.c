@@ -5,6 +5,8 @@
 #include "result.h"
 #include "crypto/aes.h"
 #include "crypto/aes_xts.h"
+#include "kernel/svc.h"
+#include "kernel/thread.h"
 
 /* Variable management macros. */
 #define DECLARE_ROUND_KEY_VAR(n) \
@@ -1205,3 +1207,121 @@ static inline void _aes256XtsDecryptBlocks(Aes256XtsContext *ctx, u8 *dst_u8, co
 size_t aes256XtsDecrypt(Aes256XtsContext *ctx, void *dst, const void *src, size_t size) {
     CRYPT_FUNC_BODY(_aes256XtsDecryptBlocks);
 }
+
+/* Parallel sector processing. */
+#define XTS_PARALLEL_MAX_THREADS 3
+#define XTS_PARALLEL_STACK_SIZE  0x4000
+
+typedef struct {
+    union {
+        Aes128XtsContext aes128;
+        Aes192XtsContext aes192;
+        Aes256XtsContext aes256;
+    } ctx;
+    u8 *dst;
+    const u8 *src;
+    size_t sector_size;
+    u64 first_sector;
+    size_t num_sectors;
+    bool is_nintendo;
+} XtsParallelJob;
+
+#define XTS_PARALLEL_WORKER(cipher, op) \
+static void _##cipher##Xts##op##SectorsWorker(void *arg) { \
+    XtsParallelJob *job = arg; \
+    for (size_t i = 0; i < job->num_sectors; i++) { \
+        cipher##XtsContextResetSector(&job->ctx.cipher, job->first_sector + i, job->is_nintendo); \
+        cipher##Xts##op(&job->ctx.cipher, job->dst + i * job->sector_size, job->src + i * job->sector_size, job->sector_size); \
+    } \
+}
+
+#define XTS_PARALLEL_FUNC_BODY(cipher, op) \
+do { \
+    if (sector_size == 0 || (sector_size % AES_BLOCK_SIZE) != 0 || (size % sector_size) != 0) { \
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput); \
+    } \
+\
+    const size_t num_sectors = size / sector_size; \
+    if (num_sectors == 0) { \
+        return 0; \
+    } \
+\
+    const size_t num_threads = (num_sectors < XTS_PARALLEL_MAX_THREADS ? num_sectors : XTS_PARALLEL_MAX_THREADS); \
+    const size_t sectors_per_thread = (num_sectors + num_threads - 1) / num_threads; \
+    XtsParallelJob jobs[XTS_PARALLEL_MAX_THREADS]; \
+    Thread threads[XTS_PARALLEL_MAX_THREADS]; \
+    bool started[XTS_PARALLEL_MAX_THREADS] = {0}; \
+\
+    u32 prio = 0x2C; \
+    svcGetThreadPriority(&prio, CUR_THREAD_HANDLE); \
+\
+    /* Split the range into contiguous runs of sectors, one per core, each with its own context copy. */ \
+    size_t sector = 0; \
+    for (size_t i = 0; i < num_threads; i++) { \
+        XtsParallelJob *job = &jobs[i]; \
+        memcpy(&job->ctx.cipher, ctx, sizeof(job->ctx.cipher)); \
+        job->dst = (u8 *)dst + sector * sector_size; \
+        job->src = (const u8 *)src + sector * sector_size; \
+        job->sector_size = sector_size; \
+        job->first_sector = first_sector + sector; \
+        job->num_sectors = (num_sectors - sector < sectors_per_thread ? num_sectors - sector : sectors_per_thread); \
+        job->is_nintendo = is_nintendo; \
+        sector += job->num_sectors; \
+\
+        if (R_SUCCEEDED(threadCreate(&threads[i], _##cipher##Xts##op##SectorsWorker, job, NULL, XTS_PARALLEL_STACK_SIZE, prio, (int)i))) { \
+            if (R_SUCCEEDED(threadStart(&threads[i]))) { \
+                started[i] = true; \
+            } else { \
+                threadClose(&threads[i]); \
+            } \
+        } \
+    } \
+\
+    /* Jobs whose thread could not be started run on the calling thread. */ \
+    for (size_t i = 0; i < num_threads; i++) { \
+        if (!started[i]) { \
+            _##cipher##Xts##op##SectorsWorker(&jobs[i]); \
+        } \
+    } \
+\
+    for (size_t i = 0; i < num_threads; i++) { \
+        if (started[i]) { \
+            threadWaitForExit(&threads[i]); \
+            threadClose(&threads[i]); \
+        } \
+    } \
+\
+    memset(jobs, 0, sizeof(jobs)); \
+    return 0; \
+} while (0)
+
+XTS_PARALLEL_WORKER(aes128, Encrypt)
+XTS_PARALLEL_WORKER(aes128, Decrypt)
+XTS_PARALLEL_WORKER(aes192, Encrypt)
+XTS_PARALLEL_WORKER(aes192, Decrypt)
+XTS_PARALLEL_WORKER(aes256, Encrypt)
+XTS_PARALLEL_WORKER(aes256, Decrypt)
+
+Result aes128XtsEncryptSectorsParallel(const Aes128XtsContext *ctx, void *dst, const void *src, size_t size, size_t sector_size, uint64_t first_sector, bool is_nintendo) {
+    XTS_PARALLEL_FUNC_BODY(aes128, Encrypt);
+}
+
+Result aes128XtsDecryptSectorsParallel(const Aes128XtsContext *ctx, void *dst, const void *src, size_t size, size_t sector_size, uint64_t first_sector, bool is_nintendo) {
+    XTS_PARALLEL_FUNC_BODY(aes128, Decrypt);
+}
+
+Result aes192XtsEncryptSectorsParallel(const Aes192XtsContext *ctx, void *dst, const void *src, size_t size, size_t sector_size, uint64_t first_sector, bool is_nintendo) {
+    XTS_PARALLEL_FUNC_BODY(aes192, Encrypt);
+}
+
+Result aes192XtsDecryptSectorsParallel(const Aes192XtsContext *ctx, void *dst, const void *src, size_t size, size_t sector_size, uint64_t first_sector, bool is_nintendo) {
+    XTS_PARALLEL_FUNC_BODY(aes192, Decrypt);
+}
+
+Result aes256XtsEncryptSectorsParallel(const Aes256XtsContext *ctx, void *dst, const void *src, size_t size, size_t sector_size, uint64_t first_sector, bool is_nintendo) {
+    XTS_PARALLEL_FUNC_BODY(aes256, Encrypt);
+}
+
+Result aes256XtsDecryptSectorsParallel(const Aes256XtsContext *ctx, void *dst, const void *src, size_t size, size_t sector_size, uint64_t first_sector, bool is_nintendo) {
+    XTS_PARALLEL_FUNC_BODY(aes256, Decrypt);
+}
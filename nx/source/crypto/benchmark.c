@@ -0,0 +1,273 @@
+#include <stdio.h>
+#include <string.h>
+#include <malloc.h>
+
+#include "result.h"
+#include "arm/counter.h"
+#include "crypto/benchmark.h"
+#include "crypto/aes.h"
+#include "crypto/aes_cbc.h"
+#include "crypto/aes_ctr.h"
+#include "crypto/aes_xts.h"
+#include "crypto/aes_gcm.h"
+#include "crypto/cmac.h"
+#include "crypto/chacha20.h"
+#include "crypto/sha1.h"
+#include "crypto/sha256.h"
+#include "crypto/hmac.h"
+#include "crypto/crc.h"
+
+#define BENCHMARK_MAX_SIZE  0x1000000
+#define BENCHMARK_MIN_TICKS 1920000 /* 100ms */
+
+static const char *const s_algorithmNames[CryptoBenchmarkAlgorithm_Count] = {
+    [CryptoBenchmarkAlgorithm_Aes128Ecb]        = "AES-128-ECB",
+    [CryptoBenchmarkAlgorithm_Aes256Ecb]        = "AES-256-ECB",
+    [CryptoBenchmarkAlgorithm_Aes128CbcEncrypt] = "AES-128-CBC enc",
+    [CryptoBenchmarkAlgorithm_Aes128CbcDecrypt] = "AES-128-CBC dec",
+    [CryptoBenchmarkAlgorithm_Aes256CbcDecrypt] = "AES-256-CBC dec",
+    [CryptoBenchmarkAlgorithm_Aes128Ctr]        = "AES-128-CTR",
+    [CryptoBenchmarkAlgorithm_Aes192Ctr]        = "AES-192-CTR",
+    [CryptoBenchmarkAlgorithm_Aes256Ctr]        = "AES-256-CTR",
+    [CryptoBenchmarkAlgorithm_Aes128XtsDecrypt] = "AES-128-XTS dec",
+    [CryptoBenchmarkAlgorithm_Aes256XtsDecrypt] = "AES-256-XTS dec",
+    [CryptoBenchmarkAlgorithm_Aes128Gcm]        = "AES-128-GCM",
+    [CryptoBenchmarkAlgorithm_Aes128Cmac]       = "AES-128-CMAC",
+    [CryptoBenchmarkAlgorithm_Aes256Cmac]       = "AES-256-CMAC",
+    [CryptoBenchmarkAlgorithm_Sha1]             = "SHA1",
+    [CryptoBenchmarkAlgorithm_Sha256]           = "SHA256",
+    [CryptoBenchmarkAlgorithm_HmacSha256]       = "HMAC-SHA256",
+    [CryptoBenchmarkAlgorithm_Chacha20]         = "ChaCha20",
+    [CryptoBenchmarkAlgorithm_Chacha20Poly1305] = "ChaCha20-Poly1305",
+    [CryptoBenchmarkAlgorithm_Crc32]            = "CRC32",
+    [CryptoBenchmarkAlgorithm_Crc32c]           = "CRC32C",
+};
+
+/* Contexts are set up once per benchmark, so that only the bulk processing is measured. */
+typedef union {
+    Aes128Context aes128;
+    Aes256Context aes256;
+    Aes128CbcContext cbc128;
+    Aes256CbcContext cbc256;
+    Aes128CtrContext ctr128;
+    Aes192CtrContext ctr192;
+    Aes256CtrContext ctr256;
+    Aes128XtsContext xts128;
+    Aes256XtsContext xts256;
+    Aes128GcmContext gcm128;
+    Aes128CmacContext cmac128;
+    Aes256CmacContext cmac256;
+    HmacSha256Key hmac;
+    Chacha20Context chacha;
+    Chacha20Poly1305Context chachapoly;
+} BenchmarkContext;
+
+static void _benchmarkSetup(CryptoBenchmarkAlgorithm algorithm, BenchmarkContext *ctx) {
+    static const u8 key[0x20] = {
+        0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f,
+        0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f,
+    };
+    static const u8 iv[AES_BLOCK_SIZE];
+
+    switch (algorithm) {
+        case CryptoBenchmarkAlgorithm_Aes128Ecb:
+            aes128ContextCreate(&ctx->aes128, key, true);
+            break;
+        case CryptoBenchmarkAlgorithm_Aes256Ecb:
+            aes256ContextCreate(&ctx->aes256, key, true);
+            break;
+        case CryptoBenchmarkAlgorithm_Aes128CbcEncrypt:
+            aes128CbcContextCreate(&ctx->cbc128, key, iv, true);
+            break;
+        case CryptoBenchmarkAlgorithm_Aes128CbcDecrypt:
+            aes128CbcContextCreate(&ctx->cbc128, key, iv, false);
+            break;
+        case CryptoBenchmarkAlgorithm_Aes256CbcDecrypt:
+            aes256CbcContextCreate(&ctx->cbc256, key, iv, false);
+            break;
+        case CryptoBenchmarkAlgorithm_Aes128Ctr:
+            aes128CtrContextCreate(&ctx->ctr128, key, iv);
+            break;
+        case CryptoBenchmarkAlgorithm_Aes192Ctr:
+            aes192CtrContextCreate(&ctx->ctr192, key, iv);
+            break;
+        case CryptoBenchmarkAlgorithm_Aes256Ctr:
+            aes256CtrContextCreate(&ctx->ctr256, key, iv);
+            break;
+        case CryptoBenchmarkAlgorithm_Aes128XtsDecrypt:
+            aes128XtsContextCreate(&ctx->xts128, key, key + 0x10, false);
+            break;
+        case CryptoBenchmarkAlgorithm_Aes256XtsDecrypt:
+            aes256XtsContextCreate(&ctx->xts256, key, key, false);
+            break;
+        case CryptoBenchmarkAlgorithm_Aes128Gcm:
+            aes128GcmContextCreate(&ctx->gcm128, key, iv, AES_GCM_IV_SIZE);
+            break;
+        case CryptoBenchmarkAlgorithm_Aes128Cmac:
+            cmacAes128ContextCreate(&ctx->cmac128, key);
+            break;
+        case CryptoBenchmarkAlgorithm_Aes256Cmac:
+            cmacAes256ContextCreate(&ctx->cmac256, key);
+            break;
+        case CryptoBenchmarkAlgorithm_HmacSha256:
+            hmacSha256KeyCreate(&ctx->hmac, key, sizeof(key));
+            break;
+        case CryptoBenchmarkAlgorithm_Chacha20:
+            chacha20ContextCreate(&ctx->chacha, key, iv, 0);
+            break;
+        case CryptoBenchmarkAlgorithm_Chacha20Poly1305:
+            chacha20Poly1305ContextCreate(&ctx->chachapoly, key, iv);
+            break;
+        default:
+            break;
+    }
+}
+
+static void _benchmarkIteration(CryptoBenchmarkAlgorithm algorithm, BenchmarkContext *ctx, u8 *buf, size_t size) {
+    u8 out[0x20];
+
+    switch (algorithm) {
+        case CryptoBenchmarkAlgorithm_Aes128Ecb:
+            for (size_t i = 0; i < size; i += AES_BLOCK_SIZE)
+                aes128EncryptBlock(&ctx->aes128, buf + i, buf + i);
+            break;
+        case CryptoBenchmarkAlgorithm_Aes256Ecb:
+            for (size_t i = 0; i < size; i += AES_BLOCK_SIZE)
+                aes256EncryptBlock(&ctx->aes256, buf + i, buf + i);
+            break;
+        case CryptoBenchmarkAlgorithm_Aes128CbcEncrypt:
+            aes128CbcEncrypt(&ctx->cbc128, buf, buf, size);
+            break;
+        case CryptoBenchmarkAlgorithm_Aes128CbcDecrypt:
+            aes128CbcDecrypt(&ctx->cbc128, buf, buf, size);
+            break;
+        case CryptoBenchmarkAlgorithm_Aes256CbcDecrypt:
+            aes256CbcDecrypt(&ctx->cbc256, buf, buf, size);
+            break;
+        case CryptoBenchmarkAlgorithm_Aes128Ctr:
+            aes128CtrCrypt(&ctx->ctr128, buf, buf, size);
+            break;
+        case CryptoBenchmarkAlgorithm_Aes192Ctr:
+            aes192CtrCrypt(&ctx->ctr192, buf, buf, size);
+            break;
+        case CryptoBenchmarkAlgorithm_Aes256Ctr:
+            aes256CtrCrypt(&ctx->ctr256, buf, buf, size);
+            break;
+        case CryptoBenchmarkAlgorithm_Aes128XtsDecrypt:
+            aes128XtsContextResetSector(&ctx->xts128, 0, true);
+            aes128XtsDecrypt(&ctx->xts128, buf, buf, size);
+            break;
+        case CryptoBenchmarkAlgorithm_Aes256XtsDecrypt:
+            aes256XtsContextResetSector(&ctx->xts256, 0, true);
+            aes256XtsDecrypt(&ctx->xts256, buf, buf, size);
+            break;
+        case CryptoBenchmarkAlgorithm_Aes128Gcm:
+            aes128GcmEncrypt(&ctx->gcm128, buf, buf, size);
+            break;
+        case CryptoBenchmarkAlgorithm_Aes128Cmac:
+            cmacAes128ContextUpdate(&ctx->cmac128, buf, size);
+            break;
+        case CryptoBenchmarkAlgorithm_Aes256Cmac:
+            cmacAes256ContextUpdate(&ctx->cmac256, buf, size);
+            break;
+        case CryptoBenchmarkAlgorithm_Sha1:
+            sha1CalculateHash(out, buf, size);
+            break;
+        case CryptoBenchmarkAlgorithm_Sha256:
+            sha256CalculateHash(out, buf, size);
+            break;
+        case CryptoBenchmarkAlgorithm_HmacSha256:
+            hmacSha256KeyCalculateMac(&ctx->hmac, out, buf, size);
+            break;
+        case CryptoBenchmarkAlgorithm_Chacha20:
+            chacha20Crypt(&ctx->chacha, buf, buf, size);
+            break;
+        case CryptoBenchmarkAlgorithm_Chacha20Poly1305:
+            chacha20Poly1305Encrypt(&ctx->chachapoly, buf, buf, size);
+            break;
+        case CryptoBenchmarkAlgorithm_Crc32:
+            buf[0] ^= (u8)crc32Calculate(buf, size);
+            break;
+        case CryptoBenchmarkAlgorithm_Crc32c:
+            buf[0] ^= (u8)crc32cCalculate(buf, size);
+            break;
+        default:
+            break;
+    }
+
+    /* Keep hash outputs live. */
+    __asm__ __volatile__("" :: "r"(out) : "memory");
+}
+
+const char *cryptoBenchmarkGetAlgorithmName(CryptoBenchmarkAlgorithm algorithm) {
+    if (algorithm >= CryptoBenchmarkAlgorithm_Count)
+        return "Unknown";
+    return s_algorithmNames[algorithm];
+}
+
+Result cryptoBenchmarkRun(CryptoBenchmarkAlgorithm algorithm, void *buf, size_t size, u64 min_ticks, CryptoBenchmarkResult *out) {
+    if (algorithm >= CryptoBenchmarkAlgorithm_Count || size == 0 || (size % AES_BLOCK_SIZE))
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    BenchmarkContext ctx;
+    _benchmarkSetup(algorithm, &ctx);
+
+    /* Warm up caches and branch predictors. */
+    _benchmarkIteration(algorithm, &ctx, (u8 *)buf, size);
+
+    u64 iterations = 0;
+    u64 start = armGetSystemTick();
+    u64 elapsed = 0;
+    do {
+        _benchmarkIteration(algorithm, &ctx, (u8 *)buf, size);
+        iterations++;
+        elapsed = armGetSystemTick() - start;
+    } while (elapsed < min_ticks);
+
+    memset(&ctx, 0, sizeof(ctx));
+
+    out->algorithm = algorithm;
+    out->size = size;
+    out->misalign = (uintptr_t)buf & 0x3F;
+    out->iterations = iterations;
+    out->ticks = elapsed;
+    return 0;
+}
+
+double cryptoBenchmarkGetCyclesPerByte(const CryptoBenchmarkResult *r, u64 cpu_hz) {
+    double bytes = (double)r->size * (double)r->iterations;
+    return (double)r->ticks * ((double)cpu_hz / (double)armGetSystemTickFreq()) / bytes;
+}
+
+double cryptoBenchmarkGetMibPerSecond(const CryptoBenchmarkResult *r) {
+    double bytes = (double)r->size * (double)r->iterations;
+    double seconds = (double)r->ticks / (double)armGetSystemTickFreq();
+    return bytes / seconds / (1024.0 * 1024.0);
+}
+
+Result cryptoBenchmarkPrintTable(u64 cpu_hz) {
+    u8 *buf = (u8 *)memalign(0x1000, BENCHMARK_MAX_SIZE + 0x40);
+    if (!buf)
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+    memset(buf, 0xA5, BENCHMARK_MAX_SIZE + 0x40);
+
+    printf("%-18s %10s %5s %10s %10s\n", "algorithm", "size", "align", "cycles/B", "MiB/s");
+
+    Result rc = 0;
+    for (u32 alg = 0; R_SUCCEEDED(rc) && alg < CryptoBenchmarkAlgorithm_Count; alg++) {
+        for (size_t size = 0x10; R_SUCCEEDED(rc) && size <= BENCHMARK_MAX_SIZE; size <<= 2) {
+            for (size_t misalign = 0; misalign <= 1; misalign++) {
+                CryptoBenchmarkResult r;
+                rc = cryptoBenchmarkRun((CryptoBenchmarkAlgorithm)alg, buf + misalign, size, BENCHMARK_MIN_TICKS, &r);
+                if (R_FAILED(rc))
+                    break;
+
+                printf("%-18s %10zu %5s %10.2f %10.1f\n", cryptoBenchmarkGetAlgorithmName(r.algorithm), r.size,
+                       misalign ? "no" : "yes", cryptoBenchmarkGetCyclesPerByte(&r, cpu_hz), cryptoBenchmarkGetMibPerSecond(&r));
+            }
+        }
+    }
+
+    free(buf);
+    return rc;
+}
@@ -0,0 +1,423 @@
+#include <string.h>
+#include <stdlib.h>
+#include <arm_neon.h>
+
+#include "result.h"
+#include "crypto/chacha20.h"
+
+#define POLY1305_MASK_44 0xFFFFFFFFFFFul
+#define POLY1305_MASK_42 0x3FFFFFFFFFFul
+
+/* Variable management macros. */
+#define ROTL32(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+
+#define CHACHA_QUARTER_ROUND(a, b, c, d) \
+do { \
+    a += b; d ^= a; d = ROTL32(d, 16); \
+    c += d; b ^= c; b = ROTL32(b, 12); \
+    a += b; d ^= a; d = ROTL32(d, 8);  \
+    c += d; b ^= c; b = ROTL32(b, 7);  \
+} while (0)
+
+#define ROTL32_X4(x, n) vorrq_u32(vshlq_n_u32(x, n), vshrq_n_u32(x, 32 - (n)))
+
+#define CHACHA_QUARTER_ROUND_X4(a, b, c, d) \
+do { \
+    a = vaddq_u32(a, b); d = veorq_u32(d, a); d = ROTL32_X4(d, 16); \
+    c = vaddq_u32(c, d); b = veorq_u32(b, c); b = ROTL32_X4(b, 12); \
+    a = vaddq_u32(a, b); d = veorq_u32(d, a); d = ROTL32_X4(d, 8);  \
+    c = vaddq_u32(c, d); b = veorq_u32(b, c); b = ROTL32_X4(b, 7);  \
+} while (0)
+
+static inline u32 _loadLe32(const u8 *src) {
+    return (u32)src[0] | ((u32)src[1] << 8) | ((u32)src[2] << 16) | ((u32)src[3] << 24);
+}
+
+static inline u64 _loadLe64(const u8 *src) {
+    return (u64)_loadLe32(src) | ((u64)_loadLe32(src + 4) << 32);
+}
+
+static inline void _storeLe64(u8 *dst, u64 val) {
+    for (size_t i = 0; i < sizeof(val); i++) {
+        dst[i] = (u8)(val >> (8 * i));
+    }
+}
+
+/* Generates one keystream block, and advances the counter. */
+static void _chacha20Block(u32 *state, u8 *out) {
+    u32 x[16];
+    memcpy(x, state, sizeof(x));
+
+    for (int i = 0; i < 10; i++) {
+        CHACHA_QUARTER_ROUND(x[0], x[4], x[ 8], x[12]);
+        CHACHA_QUARTER_ROUND(x[1], x[5], x[ 9], x[13]);
+        CHACHA_QUARTER_ROUND(x[2], x[6], x[10], x[14]);
+        CHACHA_QUARTER_ROUND(x[3], x[7], x[11], x[15]);
+        CHACHA_QUARTER_ROUND(x[0], x[5], x[10], x[15]);
+        CHACHA_QUARTER_ROUND(x[1], x[6], x[11], x[12]);
+        CHACHA_QUARTER_ROUND(x[2], x[7], x[ 8], x[13]);
+        CHACHA_QUARTER_ROUND(x[3], x[4], x[ 9], x[14]);
+    }
+
+    for (int i = 0; i < 16; i++) {
+        const u32 v = x[i] + state[i];
+        out[4 * i + 0] = (u8)(v >> 0);
+        out[4 * i + 1] = (u8)(v >> 8);
+        out[4 * i + 2] = (u8)(v >> 16);
+        out[4 * i + 3] = (u8)(v >> 24);
+    }
+
+    state[12]++;
+}
+
+/* Encrypts four blocks at a time, with each vector lane holding the same state word of a different block. */
+static void _chacha20CryptBlocks(u32 *state, u8 *dst_u8, const u8 *src_u8, size_t num_blocks) {
+    static const u32 lane_offsets[4] = {0, 1, 2, 3};
+    const uint32x4_t counter_inc = vld1q_u32(lane_offsets);
+
+    while (num_blocks >= 4) {
+        uint32x4_t in[16], x[16];
+        for (int i = 0; i < 16; i++) {
+            in[i] = vdupq_n_u32(state[i]);
+        }
+        in[12] = vaddq_u32(in[12], counter_inc);
+        memcpy(x, in, sizeof(x));
+
+        for (int i = 0; i < 10; i++) {
+            CHACHA_QUARTER_ROUND_X4(x[0], x[4], x[ 8], x[12]);
+            CHACHA_QUARTER_ROUND_X4(x[1], x[5], x[ 9], x[13]);
+            CHACHA_QUARTER_ROUND_X4(x[2], x[6], x[10], x[14]);
+            CHACHA_QUARTER_ROUND_X4(x[3], x[7], x[11], x[15]);
+            CHACHA_QUARTER_ROUND_X4(x[0], x[5], x[10], x[15]);
+            CHACHA_QUARTER_ROUND_X4(x[1], x[6], x[11], x[12]);
+            CHACHA_QUARTER_ROUND_X4(x[2], x[7], x[ 8], x[13]);
+            CHACHA_QUARTER_ROUND_X4(x[3], x[4], x[ 9], x[14]);
+        }
+
+        for (int i = 0; i < 16; i++) {
+            x[i] = vaddq_u32(x[i], in[i]);
+        }
+
+        /* Transpose each group of four words back into block order, XOR and store. */
+        for (int g = 0; g < 4; g++) {
+            const uint32x4x2_t t0 = vtrnq_u32(x[4 * g + 0], x[4 * g + 1]);
+            const uint32x4x2_t t1 = vtrnq_u32(x[4 * g + 2], x[4 * g + 3]);
+            const uint32x4_t words[4] = {
+                vcombine_u32(vget_low_u32(t0.val[0]),  vget_low_u32(t1.val[0])),
+                vcombine_u32(vget_low_u32(t0.val[1]),  vget_low_u32(t1.val[1])),
+                vcombine_u32(vget_high_u32(t0.val[0]), vget_high_u32(t1.val[0])),
+                vcombine_u32(vget_high_u32(t0.val[1]), vget_high_u32(t1.val[1])),
+            };
+
+            for (int b = 0; b < 4; b++) {
+                const size_t ofs = b * CHACHA20_BLOCK_SIZE + g * 0x10;
+                vst1q_u8(dst_u8 + ofs, veorq_u8(vld1q_u8(src_u8 + ofs), vreinterpretq_u8_u32(words[b])));
+            }
+        }
+
+        state[12] += 4;
+        src_u8 += 4 * CHACHA20_BLOCK_SIZE;
+        dst_u8 += 4 * CHACHA20_BLOCK_SIZE;
+        num_blocks -= 4;
+    }
+
+    while (num_blocks >= 1) {
+        u8 block[CHACHA20_BLOCK_SIZE];
+        _chacha20Block(state, block);
+        for (size_t i = 0; i < CHACHA20_BLOCK_SIZE; i += 0x10) {
+            vst1q_u8(dst_u8 + i, veorq_u8(vld1q_u8(src_u8 + i), vld1q_u8(block + i)));
+        }
+
+        src_u8 += CHACHA20_BLOCK_SIZE;
+        dst_u8 += CHACHA20_BLOCK_SIZE;
+        num_blocks--;
+    }
+}
+
+void chacha20ContextCreate(Chacha20Context *out, const void *key, const void *nonce, u32 counter) {
+    const u8 *key_u8 = key;
+    const u8 *nonce_u8 = nonce;
+
+    /* "expand 32-byte k" */
+    out->state[0] = 0x61707865;
+    out->state[1] = 0x3320646e;
+    out->state[2] = 0x79622d32;
+    out->state[3] = 0x6b206574;
+    for (int i = 0; i < 8; i++) {
+        out->state[4 + i] = _loadLe32(key_u8 + 4 * i);
+    }
+    out->state[12] = counter;
+    for (int i = 0; i < 3; i++) {
+        out->state[13 + i] = _loadLe32(nonce_u8 + 4 * i);
+    }
+
+    memset(out->enc_ctr_buffer, 0, sizeof(out->enc_ctr_buffer));
+    out->buffer_offset = 0;
+}
+
+void chacha20Crypt(Chacha20Context *ctx, void *dst, const void *src, size_t size) {
+    const u8 *cur_src = src;
+    u8 *cur_dst = dst;
+
+    /* Handle pre-buffered keystream. */
+    if (ctx->buffer_offset > 0) {
+        const size_t needed = CHACHA20_BLOCK_SIZE - ctx->buffer_offset;
+        const size_t copyable = (size > needed ? needed : size);
+        for (size_t i = 0; i < copyable; i++) {
+            cur_dst[i] = cur_src[i] ^ ctx->enc_ctr_buffer[ctx->buffer_offset + i];
+        }
+        cur_dst += copyable;
+        cur_src += copyable;
+        ctx->buffer_offset += copyable;
+        size -= copyable;
+
+        if (ctx->buffer_offset == CHACHA20_BLOCK_SIZE) {
+            ctx->buffer_offset = 0;
+        }
+    }
+
+    /* Handle complete blocks. */
+    if (size >= CHACHA20_BLOCK_SIZE) {
+        const size_t num_blocks = size / CHACHA20_BLOCK_SIZE;
+        _chacha20CryptBlocks(ctx->state, cur_dst, cur_src, num_blocks);
+        size -= num_blocks * CHACHA20_BLOCK_SIZE;
+        cur_src += num_blocks * CHACHA20_BLOCK_SIZE;
+        cur_dst += num_blocks * CHACHA20_BLOCK_SIZE;
+    }
+
+    /* Buffer remaining keystream. */
+    if (size > 0) {
+        _chacha20Block(ctx->state, ctx->enc_ctr_buffer);
+        for (size_t i = 0; i < size; i++) {
+            cur_dst[i] = cur_src[i] ^ ctx->enc_ctr_buffer[i];
+        }
+        ctx->buffer_offset = size;
+    }
+}
+
+/* Poly1305, using three 44/44/42-bit limbs. */
+static void _poly1305ProcessBlocks(Poly1305Context *ctx, const u8 *src_u8, size_t num_blocks, u64 hibit) {
+    const u64 r0 = ctx->r[0], r1 = ctx->r[1], r2 = ctx->r[2];
+    const u64 s1 = r1 * (5 << 2), s2 = r2 * (5 << 2);
+    u64 h0 = ctx->h[0], h1 = ctx->h[1], h2 = ctx->h[2];
+
+    while (num_blocks > 0) {
+        const u64 t0 = _loadLe64(src_u8 + 0);
+        const u64 t1 = _loadLe64(src_u8 + 8);
+
+        h0 += t0 & POLY1305_MASK_44;
+        h1 += ((t0 >> 44) | (t1 << 20)) & POLY1305_MASK_44;
+        h2 += ((t1 >> 24) & POLY1305_MASK_42) | hibit;
+
+        const unsigned __int128 d0 = (unsigned __int128)h0 * r0 + (unsigned __int128)h1 * s2 + (unsigned __int128)h2 * s1;
+        unsigned __int128 d1 = (unsigned __int128)h0 * r1 + (unsigned __int128)h1 * r0 + (unsigned __int128)h2 * s2;
+        unsigned __int128 d2 = (unsigned __int128)h0 * r2 + (unsigned __int128)h1 * r1 + (unsigned __int128)h2 * r0;
+
+        u64 c = (u64)(d0 >> 44);
+        h0 = (u64)d0 & POLY1305_MASK_44;
+        d1 += c;
+        c = (u64)(d1 >> 44);
+        h1 = (u64)d1 & POLY1305_MASK_44;
+        d2 += c;
+        c = (u64)(d2 >> 42);
+        h2 = (u64)d2 & POLY1305_MASK_42;
+        h0 += c * 5;
+        c = h0 >> 44;
+        h0 &= POLY1305_MASK_44;
+        h1 += c;
+
+        src_u8 += 0x10;
+        num_blocks--;
+    }
+
+    ctx->h[0] = h0;
+    ctx->h[1] = h1;
+    ctx->h[2] = h2;
+}
+
+void poly1305ContextCreate(Poly1305Context *out, const void *key) {
+    const u8 *key_u8 = key;
+    const u64 t0 = _loadLe64(key_u8 + 0);
+    const u64 t1 = _loadLe64(key_u8 + 8);
+
+    /* Clamp r. */
+    out->r[0] = t0 & 0xFFC0FFFFFFFul;
+    out->r[1] = ((t0 >> 44) | (t1 << 20)) & 0xFFFFFC0FFFFul;
+    out->r[2] = (t1 >> 24) & 0x00FFFFFFC0Ful;
+
+    out->h[0] = out->h[1] = out->h[2] = 0;
+    out->pad[0] = _loadLe64(key_u8 + 16);
+    out->pad[1] = _loadLe64(key_u8 + 24);
+
+    memset(out->buffer, 0, sizeof(out->buffer));
+    memset(out->mac, 0, sizeof(out->mac));
+    out->num_buffered = 0;
+    out->finalized = false;
+}
+
+void poly1305ContextUpdate(Poly1305Context *ctx, const void *src, size_t size) {
+    const u8 *cur_src = src;
+
+    /* Handle pre-buffered data. */
+    if (ctx->num_buffered > 0) {
+        const size_t needed = sizeof(ctx->buffer) - ctx->num_buffered;
+        const size_t copyable = (size > needed ? needed : size);
+        memcpy(ctx->buffer + ctx->num_buffered, cur_src, copyable);
+        cur_src += copyable;
+        ctx->num_buffered += copyable;
+        size -= copyable;
+
+        if (ctx->num_buffered == sizeof(ctx->buffer)) {
+            _poly1305ProcessBlocks(ctx, ctx->buffer, 1, 1ul << 40);
+            ctx->num_buffered = 0;
+        }
+    }
+
+    /* Handle complete blocks. */
+    if (size >= sizeof(ctx->buffer)) {
+        const size_t num_blocks = size / sizeof(ctx->buffer);
+        _poly1305ProcessBlocks(ctx, cur_src, num_blocks, 1ul << 40);
+        size -= num_blocks * sizeof(ctx->buffer);
+        cur_src += num_blocks * sizeof(ctx->buffer);
+    }
+
+    /* Buffer remaining data. */
+    if (size > 0) {
+        memcpy(ctx->buffer, cur_src, size);
+        ctx->num_buffered = size;
+    }
+}
+
+void poly1305ContextGetMac(Poly1305Context *ctx, void *dst) {
+    if (!ctx->finalized) {
+        /* Process the last partial block, terminated by a one bit instead of the high bit. */
+        if (ctx->num_buffered > 0) {
+            ctx->buffer[ctx->num_buffered] = 1;
+            memset(ctx->buffer + ctx->num_buffered + 1, 0, sizeof(ctx->buffer) - ctx->num_buffered - 1);
+            _poly1305ProcessBlocks(ctx, ctx->buffer, 1, 0);
+            ctx->num_buffered = 0;
+        }
+
+        /* Fully carry h. */
+        u64 h0 = ctx->h[0], h1 = ctx->h[1], h2 = ctx->h[2];
+        u64 c;
+        c = h1 >> 44; h1 &= POLY1305_MASK_44;
+        h2 += c;      c = h2 >> 42; h2 &= POLY1305_MASK_42;
+        h0 += c * 5;  c = h0 >> 44; h0 &= POLY1305_MASK_44;
+        h1 += c;      c = h1 >> 44; h1 &= POLY1305_MASK_44;
+        h2 += c;      c = h2 >> 42; h2 &= POLY1305_MASK_42;
+        h0 += c * 5;  c = h0 >> 44; h0 &= POLY1305_MASK_44;
+        h1 += c;
+
+        /* Compute h - p, and select it if it did not underflow. */
+        u64 g0 = h0 + 5; c = g0 >> 44; g0 &= POLY1305_MASK_44;
+        u64 g1 = h1 + c; c = g1 >> 44; g1 &= POLY1305_MASK_44;
+        u64 g2 = h2 + c - (1ul << 42);
+
+        c = (g2 >> 63) - 1;
+        g0 &= c; g1 &= c; g2 &= c;
+        c = ~c;
+        h0 = (h0 & c) | g0;
+        h1 = (h1 & c) | g1;
+        h2 = (h2 & c) | g2;
+
+        /* Add the pad. */
+        const u64 t0 = ctx->pad[0], t1 = ctx->pad[1];
+        h0 += t0 & POLY1305_MASK_44;                           c = h0 >> 44; h0 &= POLY1305_MASK_44;
+        h1 += (((t0 >> 44) | (t1 << 20)) & POLY1305_MASK_44) + c; c = h1 >> 44; h1 &= POLY1305_MASK_44;
+        h2 += ((t1 >> 24) & POLY1305_MASK_42) + c;                h2 &= POLY1305_MASK_42;
+
+        _storeLe64(ctx->mac + 0, h0 | (h1 << 44));
+        _storeLe64(ctx->mac + 8, (h1 >> 20) | (h2 << 24));
+
+        /* Clear key material. */
+        memset(ctx->r, 0, sizeof(ctx->r));
+        memset(ctx->h, 0, sizeof(ctx->h));
+        memset(ctx->pad, 0, sizeof(ctx->pad));
+        memset(ctx->buffer, 0, sizeof(ctx->buffer));
+        ctx->finalized = true;
+    }
+
+    memcpy(dst, ctx->mac, sizeof(ctx->mac));
+}
+
+static void _chacha20Poly1305Pad16(Poly1305Context *ctx, u64 size) {
+    static const u8 zeroes[0x10] = {0};
+    if (size % sizeof(zeroes)) {
+        poly1305ContextUpdate(ctx, zeroes, sizeof(zeroes) - (size % sizeof(zeroes)));
+    }
+}
+
+static void _chacha20Poly1305FinalizeAad(Chacha20Poly1305Context *ctx) {
+    if (!ctx->aad_finalized) {
+        _chacha20Poly1305Pad16(&ctx->poly_ctx, ctx->aad_size);
+        ctx->aad_finalized = true;
+    }
+}
+
+void chacha20Poly1305ContextCreate(Chacha20Poly1305Context *out, const void *key, const void *nonce) {
+    /* The one-time Poly1305 key is the first half of block 0, data starts at block 1. */
+    u8 block[CHACHA20_BLOCK_SIZE];
+    chacha20ContextCreate(&out->chacha_ctx, key, nonce, 0);
+    _chacha20Block(out->chacha_ctx.state, block);
+    poly1305ContextCreate(&out->poly_ctx, block);
+    memset(block, 0, sizeof(block));
+
+    out->aad_size = 0;
+    out->msg_size = 0;
+    out->aad_finalized = false;
+}
+
+void chacha20Poly1305UpdateAad(Chacha20Poly1305Context *ctx, const void *src, size_t size) {
+    if (ctx->aad_finalized) {
+        return;
+    }
+
+    poly1305ContextUpdate(&ctx->poly_ctx, src, size);
+    ctx->aad_size += size;
+}
+
+void chacha20Poly1305Encrypt(Chacha20Poly1305Context *ctx, void *dst, const void *src, size_t size) {
+    _chacha20Poly1305FinalizeAad(ctx);
+    chacha20Crypt(&ctx->chacha_ctx, dst, src, size);
+    poly1305ContextUpdate(&ctx->poly_ctx, dst, size);
+    ctx->msg_size += size;
+}
+
+void chacha20Poly1305Decrypt(Chacha20Poly1305Context *ctx, void *dst, const void *src, size_t size) {
+    /* Authenticate before decrypting, so that dst may alias src. */
+    _chacha20Poly1305FinalizeAad(ctx);
+    poly1305ContextUpdate(&ctx->poly_ctx, src, size);
+    chacha20Crypt(&ctx->chacha_ctx, dst, src, size);
+    ctx->msg_size += size;
+}
+
+void chacha20Poly1305GetMac(Chacha20Poly1305Context *ctx, void *dst) {
+    if (!ctx->poly_ctx.finalized) {
+        _chacha20Poly1305FinalizeAad(ctx);
+        _chacha20Poly1305Pad16(&ctx->poly_ctx, ctx->msg_size);
+
+        u8 lengths[0x10];
+        _storeLe64(lengths + 0, ctx->aad_size);
+        _storeLe64(lengths + 8, ctx->msg_size);
+        poly1305ContextUpdate(&ctx->poly_ctx, lengths, sizeof(lengths));
+
+        memset(&ctx->chacha_ctx, 0, sizeof(ctx->chacha_ctx));
+    }
+
+    poly1305ContextGetMac(&ctx->poly_ctx, dst);
+}
+
+bool chacha20Poly1305VerifyMac(Chacha20Poly1305Context *ctx, const void *mac) {
+    u8 calc[POLY1305_MAC_SIZE];
+    chacha20Poly1305GetMac(ctx, calc);
+
+    /* Compare in constant time. */
+    const u8 *mac_u8 = mac;
+    u8 diff = 0;
+    for (size_t i = 0; i < sizeof(calc); i++) {
+        diff |= calc[i] ^ mac_u8[i];
+    }
+    memset(calc, 0, sizeof(calc));
+    return diff == 0;
+}
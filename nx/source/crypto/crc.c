@@ -0,0 +1,102 @@
+#include <arm_acle.h>
+#include <arm_neon.h>
+
+#include "crypto/crc.h"
+
+/* Reflected polynomials. */
+#define CRC32_POLY  0xEDB88320
+#define CRC32C_POLY 0x82F63B78
+
+/* Size of each of the three interleaved streams. */
+#define CRC_LANE_SIZE (CRC_INTERLEAVE_MIN_SIZE / 3)
+
+/* x^(8 * n - 33) mod P (reflected), shifting a CRC state forward by n = CRC_LANE_SIZE and 2 * CRC_LANE_SIZE bytes. */
+#define CRC32_LANE_K1  0x0C30F51D
+#define CRC32_LANE_K2  0xBBF2F6D6
+#define CRC32C_LANE_K1 0xDD7E3B0C
+#define CRC32C_LANE_K2 0x170076FA
+
+static inline u64 _crcClmul(u32 a, u32 b) {
+    return vgetq_lane_u64(vreinterpretq_u64_p128(vmull_p64(a, b)), 0);
+}
+
+/* Function body macros. */
+#define CRC_CALCULATE_LARGE(sfx, k1, k2) \
+do { \
+    const u8 *src_u8 = (const u8 *)src; \
+    u32 crc = 0xFFFFFFFF; \
+    \
+    while (((uintptr_t)src_u8 & 7) && size) { \
+        crc = __crc32##sfx##b(crc, *src_u8++); \
+        size--; \
+    } \
+    \
+    /* Three independent streams hide the latency of the crc instruction, */ \
+    /* the first two are then shifted past the others and folded in with pmull. */ \
+    while (size >= 3 * CRC_LANE_SIZE) { \
+        const u64 *src_u64 = (const u64 *)src_u8; \
+        u32 crc0 = crc, crc1 = 0, crc2 = 0; \
+        for (size_t i = 0; i < CRC_LANE_SIZE / sizeof(u64); i++) { \
+            crc0 = __crc32##sfx##d(crc0, src_u64[i]); \
+            crc1 = __crc32##sfx##d(crc1, src_u64[i + CRC_LANE_SIZE / sizeof(u64)]); \
+            crc2 = __crc32##sfx##d(crc2, src_u64[i + 2 * CRC_LANE_SIZE / sizeof(u64)]); \
+        } \
+        crc = __crc32##sfx##d(0, _crcClmul(crc0, k2) ^ _crcClmul(crc1, k1)) ^ crc2; \
+        src_u8 += 3 * CRC_LANE_SIZE; \
+        size -= 3 * CRC_LANE_SIZE; \
+    } \
+    \
+    for (; size >= sizeof(u64); size -= sizeof(u64), src_u8 += sizeof(u64)) \
+        crc = __crc32##sfx##d(crc, *(const u64 *)src_u8); \
+    if (size & sizeof(u32)) { \
+        crc = __crc32##sfx##w(crc, *(const u32 *)src_u8); \
+        src_u8 += sizeof(u32); \
+    } \
+    if (size & sizeof(u16)) { \
+        crc = __crc32##sfx##h(crc, *(const u16 *)src_u8); \
+        src_u8 += sizeof(u16); \
+    } \
+    if (size & sizeof(u8)) \
+        crc = __crc32##sfx##b(crc, *src_u8); \
+    \
+    return crc ^ 0xFFFFFFFF; \
+} while (0)
+
+u32 crc32CalculateLarge(const void *src, size_t size) {
+    CRC_CALCULATE_LARGE(, CRC32_LANE_K1, CRC32_LANE_K2);
+}
+
+u32 crc32cCalculateLarge(const void *src, size_t size) {
+    CRC_CALCULATE_LARGE(c, CRC32C_LANE_K1, CRC32C_LANE_K2);
+}
+
+/* a * b mod P, for reflected polynomials. */
+static u32 _crcMultModP(u32 a, u32 b, u32 poly) {
+    u32 p = 0;
+    for (u32 m = 1u << 31; m; m >>= 1) {
+        if (a & m)
+            p ^= b;
+        b = (b & 1) ? (b >> 1) ^ poly : b >> 1;
+    }
+    return p;
+}
+
+/* x^(8 * n) mod P, for reflected polynomials. */
+static u32 _crcX8nModP(u64 n, u32 poly) {
+    u32 p = 1u << 31;
+    u32 sq = 1u << (31 - 8);
+    for (; n; n >>= 1) {
+        if (n & 1)
+            p = _crcMultModP(sq, p, poly);
+        sq = _crcMultModP(sq, sq, poly);
+    }
+    return p;
+}
+
+u32 crc32Combine(u32 crc_a, u32 crc_b, size_t size_b) {
+    return _crcMultModP(_crcX8nModP(size_b, CRC32_POLY), crc_a, CRC32_POLY) ^ crc_b;
+}
+
+u32 crc32cCombine(u32 crc_a, u32 crc_b, size_t size_b) {
+    return _crcMultModP(_crcX8nModP(size_b, CRC32C_POLY), crc_a, CRC32C_POLY) ^ crc_b;
+}
@@ -66,6 +66,44 @@
     hmac##cipher##ContextGetMac(&ctx, dst); \
     memset(&ctx, 0, sizeof(ctx))
 
+#define HMAC_KEY_CREATE(cipher, Cipher) \
+    u32 block[sizeof(((Hmac##Cipher##Context *)NULL)->key) / sizeof(u32)]; \
+    memset(block, 0, sizeof(block)); \
+\
+    /* Either hash the key into the block, or copy it directly if possible. */ \
+    if (key_size <= sizeof(block)) { \
+        memcpy(block, key, key_size); \
+    } else { \
+        cipher##CalculateHash(block, key, key_size); \
+    } \
+\
+    /* Absorb key ^ ipad and key ^ opad once, so that messages don't need re-keying. */ \
+    for (size_t i = 0; i < sizeof(block) / sizeof(u32); i++) { \
+        block[i] ^= HMAC_IPAD_VAL; \
+    } \
+    cipher##ContextCreate(&out->inner_ctx); \
+    cipher##ContextUpdate(&out->inner_ctx, block, sizeof(block)); \
+\
+    for (size_t i = 0; i < sizeof(block) / sizeof(u32); i++) { \
+        block[i] ^= HMAC_IPAD_XOR_OPAD_VAL; \
+    } \
+    cipher##ContextCreate(&out->outer_ctx); \
+    cipher##ContextUpdate(&out->outer_ctx, block, sizeof(block)); \
+\
+    memset(block, 0, sizeof(block))
+
+#define HMAC_KEY_CALCULATE_MAC(cipher, Cipher) \
+    Cipher##Context ctx = key->inner_ctx; \
+    u8 inner_hash[sizeof(((Hmac##Cipher##Context *)NULL)->mac)]; \
+\
+    /* Calculate H((key ^ opad) || H((key ^ ipad) || data)). */ \
+    cipher##ContextUpdate(&ctx, src, size); \
+    cipher##ContextGetHash(&ctx, inner_hash); \
+    ctx = key->outer_ctx; \
+    cipher##ContextUpdate(&ctx, inner_hash, sizeof(inner_hash)); \
+    cipher##ContextGetHash(&ctx, dst); \
+    memset(&ctx, 0, sizeof(ctx))
+
 void hmacSha256ContextCreate(HmacSha256Context *out, const void *key, size_t key_size) {
     HMAC_CONTEXT_CREATE(sha256);
 }
@@ -82,6 +120,39 @@ void hmacSha256CalculateMac(void *dst, const void *key, size_t key_size, const v
     HMAC_CALCULATE_MAC(Sha256);
 }
 
+void hmacSha256KeyCreate(HmacSha256Key *out, const void *key, size_t key_size) {
+    HMAC_KEY_CREATE(sha256, Sha256);
+}
+
+void hmacSha256KeyCalculateMac(const HmacSha256Key *key, void *dst, const void *src, size_t size) {
+    HMAC_KEY_CALCULATE_MAC(sha256, Sha256);
+}
+
+void hmacSha256KeyCalculateMacsBatch(const HmacSha256Key *key, void *const *dsts, const void *const *srcs, const size_t *sizes, size_t count) {
+    size_t i = 0;
+
+    /* Interleave the inner hashes of pairs of messages, which is where the data is. */
+    for (; i + 1 < count; i += 2) {
+        Sha256Context ctx_a = key->inner_ctx, ctx_b = key->inner_ctx;
+        u8 inner_hash_a[SHA256_HASH_SIZE], inner_hash_b[SHA256_HASH_SIZE];
+
+        sha256ContextUpdateX2(&ctx_a, srcs[i + 0], sizes[i + 0], &ctx_b, srcs[i + 1], sizes[i + 1]);
+        sha256ContextGetHash(&ctx_a, inner_hash_a);
+        sha256ContextGetHash(&ctx_b, inner_hash_b);
+
+        ctx_a = key->outer_ctx;
+        ctx_b = key->outer_ctx;
+        sha256ContextUpdate(&ctx_a, inner_hash_a, sizeof(inner_hash_a));
+        sha256ContextUpdate(&ctx_b, inner_hash_b, sizeof(inner_hash_b));
+        sha256ContextGetHash(&ctx_a, dsts[i + 0]);
+        sha256ContextGetHash(&ctx_b, dsts[i + 1]);
+    }
+
+    if (i < count) {
+        hmacSha256KeyCalculateMac(key, dsts[i], srcs[i], sizes[i]);
+    }
+}
+
 void hmacSha1ContextCreate(HmacSha1Context *out, const void *key, size_t key_size) {
     HMAC_CONTEXT_CREATE(sha1);
 }
@@ -97,3 +168,17 @@ void hmacSha1ContextGetMac(HmacSha1Context *ctx, void *dst) {
 void hmacSha1CalculateMac(void *dst, const void *key, size_t key_size, const void *src, size_t size) {
     HMAC_CALCULATE_MAC(Sha1);
 }
+
+void hmacSha1KeyCreate(HmacSha1Key *out, const void *key, size_t key_size) {
+    HMAC_KEY_CREATE(sha1, Sha1);
+}
+
+void hmacSha1KeyCalculateMac(const HmacSha1Key *key, void *dst, const void *src, size_t size) {
+    HMAC_KEY_CALCULATE_MAC(sha1, Sha1);
+}
+
+void hmacSha1KeyCalculateMacsBatch(const HmacSha1Key *key, void *const *dsts, const void *const *srcs, const size_t *sizes, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        hmacSha1KeyCalculateMac(key, dsts[i], srcs[i], sizes[i]);
+    }
+}
@@ -0,0 +1,170 @@
+#include <string.h>
+#include <stdlib.h>
+
+#include "crypto/rsa.h"
+#include "crypto/sha256.h"
+
+#define RSA_2048_LIMBS (RSA_2048_BYTES / sizeof(u64))
+
+/* PSS parameters: SHA256 hash and salt, emBits = 2047. */
+#define PSS_SALT_SIZE SHA256_HASH_SIZE
+#define PSS_DB_SIZE   (RSA_2048_BYTES - SHA256_HASH_SIZE - 1)
+
+/* Numbers are little-endian arrays of 64-bit limbs. The multiply-high instruction makes scalar */
+/* 64x64 Montgomery multiplication faster than NEON's 32x32 lanes on Cortex-A57. */
+static void _rsaLoad(u64 *out, const u8 *src) {
+    for (size_t i = 0; i < RSA_2048_LIMBS; i++) {
+        u64 tmp;
+        memcpy(&tmp, src + RSA_2048_BYTES - (i + 1) * sizeof(u64), sizeof(tmp));
+        out[i] = __builtin_bswap64(tmp);
+    }
+}
+
+static void _rsaStore(u8 *dst, const u64 *src) {
+    for (size_t i = 0; i < RSA_2048_LIMBS; i++) {
+        const u64 tmp = __builtin_bswap64(src[i]);
+        memcpy(dst + RSA_2048_BYTES - (i + 1) * sizeof(u64), &tmp, sizeof(tmp));
+    }
+}
+
+/* Returns a >= b. */
+static bool _rsaGreaterEqual(const u64 *a, const u64 *b) {
+    for (size_t i = RSA_2048_LIMBS; i-- > 0;) {
+        if (a[i] != b[i])
+            return a[i] > b[i];
+    }
+    return true;
+}
+
+/* a -= b, returns the borrow. */
+static u64 _rsaSub(u64 *a, const u64 *b) {
+    u64 borrow = 0;
+    for (size_t i = 0; i < RSA_2048_LIMBS; i++) {
+        const unsigned __int128 diff = (unsigned __int128)a[i] - b[i] - borrow;
+        a[i] = (u64)diff;
+        borrow = (u64)(diff >> 64) & 1;
+    }
+    return borrow;
+}
+
+/* out = a * b / R mod n, CIOS method. out may alias a or b. */
+static void _rsaMontMul(u64 *out, const u64 *a, const u64 *b, const u64 *n, u64 n0inv) {
+    u64 t[RSA_2048_LIMBS + 2] = {0};
+
+    for (size_t i = 0; i < RSA_2048_LIMBS; i++) {
+        unsigned __int128 acc = 0;
+        for (size_t j = 0; j < RSA_2048_LIMBS; j++) {
+            acc = (unsigned __int128)a[j] * b[i] + t[j] + (u64)(acc >> 64);
+            t[j] = (u64)acc;
+        }
+        acc = (unsigned __int128)t[RSA_2048_LIMBS] + (u64)(acc >> 64);
+        t[RSA_2048_LIMBS] = (u64)acc;
+        t[RSA_2048_LIMBS + 1] = (u64)(acc >> 64);
+
+        const u64 m = t[0] * n0inv;
+        acc = (unsigned __int128)m * n[0] + t[0];
+        for (size_t j = 1; j < RSA_2048_LIMBS; j++) {
+            acc = (unsigned __int128)m * n[j] + t[j] + (u64)(acc >> 64);
+            t[j - 1] = (u64)acc;
+        }
+        acc = (unsigned __int128)t[RSA_2048_LIMBS] + (u64)(acc >> 64);
+        t[RSA_2048_LIMBS - 1] = (u64)acc;
+        t[RSA_2048_LIMBS] = t[RSA_2048_LIMBS + 1] + (u64)(acc >> 64);
+    }
+
+    if (t[RSA_2048_LIMBS] || _rsaGreaterEqual(t, n))
+        _rsaSub(t, n);
+
+    memcpy(out, t, RSA_2048_BYTES);
+}
+
+bool rsa2048PublicExpMod(void *dst, const void *signature, const void *modulus) {
+    u64 n[RSA_2048_LIMBS], s[RSA_2048_LIMBS], x[RSA_2048_LIMBS], r2[RSA_2048_LIMBS];
+
+    _rsaLoad(n, (const u8 *)modulus);
+    _rsaLoad(s, (const u8 *)signature);
+    if (!(n[0] & 1) || _rsaGreaterEqual(s, n))
+        return false;
+
+    /* -n^-1 mod 2^64, by Newton iteration. */
+    u64 inv = n[0];
+    for (int i = 0; i < 5; i++)
+        inv *= 2 - n[0] * inv;
+    const u64 n0inv = -inv;
+
+    /* R^2 mod n, by doubling 1 modulo n 2 * 2048 times. */
+    memset(r2, 0, sizeof(r2));
+    r2[0] = 1;
+    for (size_t i = 0; i < 2 * 8 * RSA_2048_BYTES; i++) {
+        const u64 carry = r2[RSA_2048_LIMBS - 1] >> 63;
+        for (size_t j = RSA_2048_LIMBS - 1; j > 0; j--)
+            r2[j] = (r2[j] << 1) | (r2[j - 1] >> 63);
+        r2[0] <<= 1;
+        if (carry || _rsaGreaterEqual(r2, n))
+            _rsaSub(r2, n);
+    }
+
+    /* s^65537 = s^(2^16) * s, in Montgomery form. */
+    _rsaMontMul(s, s, r2, n, n0inv);
+    memcpy(x, s, sizeof(x));
+    for (int i = 0; i < 16; i++)
+        _rsaMontMul(x, x, x, n, n0inv);
+    _rsaMontMul(x, x, s, n, n0inv);
+
+    /* Convert back out of Montgomery form. */
+    memset(r2, 0, sizeof(r2));
+    r2[0] = 1;
+    _rsaMontMul(x, x, r2, n, n0inv);
+
+    _rsaStore((u8 *)dst, x);
+    return true;
+}
+
+bool rsa2048PssSha256VerifyEncoded(const void *encoded, const void *msg_hash) {
+    const u8 *em = (const u8 *)encoded;
+    const u8 *h  = em + PSS_DB_SIZE;
+
+    if (em[RSA_2048_BYTES - 1] != 0xBC || (em[0] & 0x80))
+        return false;
+
+    /* DB = maskedDB ^ MGF1(H). */
+    u8 db[PSS_DB_SIZE];
+    for (u32 counter = 0; counter * SHA256_HASH_SIZE < PSS_DB_SIZE; counter++) {
+        u8 seed[SHA256_HASH_SIZE + sizeof(u32)];
+        u8 mask[SHA256_HASH_SIZE];
+        const u32 counter_be = __builtin_bswap32(counter);
+        memcpy(seed, h, SHA256_HASH_SIZE);
+        memcpy(seed + SHA256_HASH_SIZE, &counter_be, sizeof(counter_be));
+        sha256CalculateHash(mask, seed, sizeof(seed));
+
+        const size_t ofs = counter * SHA256_HASH_SIZE;
+        for (size_t i = 0; i < SHA256_HASH_SIZE && ofs + i < PSS_DB_SIZE; i++)
+            db[ofs + i] = em[ofs + i] ^ mask[i];
+    }
+    db[0] &= 0x7F;
+
+    /* DB = zero padding || 0x01 || salt. */
+    for (size_t i = 0; i < PSS_DB_SIZE - PSS_SALT_SIZE - 1; i++) {
+        if (db[i] != 0)
+            return false;
+    }
+    if (db[PSS_DB_SIZE - PSS_SALT_SIZE - 1] != 0x01)
+        return false;
+
+    /* H = SHA256(8 zero bytes || mHash || salt). */
+    u8 m_prime[8 + SHA256_HASH_SIZE + PSS_SALT_SIZE];
+    memset(m_prime, 0, 8);
+    memcpy(m_prime + 8, msg_hash, SHA256_HASH_SIZE);
+    memcpy(m_prime + 8 + SHA256_HASH_SIZE, db + PSS_DB_SIZE - PSS_SALT_SIZE, PSS_SALT_SIZE);
+
+    u8 h_prime[SHA256_HASH_SIZE];
+    sha256CalculateHash(h_prime, m_prime, sizeof(m_prime));
+    return memcmp(h_prime, h, SHA256_HASH_SIZE) == 0;
+}
+
+bool rsa2048PssSha256Verify(const void *signature, const void *modulus, const void *msg_hash) {
+    u8 em[RSA_2048_BYTES];
+    if (!rsa2048PublicExpMod(em, signature, modulus))
+        return false;
+    return rsa2048PssSha256VerifyEncoded(em, msg_hash);
+}
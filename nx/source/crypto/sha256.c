@@ -177,6 +177,63 @@ static void _sha256ProcessBlocks(Sha256Context *ctx, const u8 *src_u8, size_t nu
     vst1q_u32(ctx->intermediate_hash + 4, cur_hash1);
 }
 
+/* Performs four rounds of the compression function, and advances the message schedule if needed. */
+#define SHA256_QUAD_ROUND(i, hash0, hash1, msg) \
+do { \
+    const uint32x4_t wk = vaddq_u32(msg[(i) % 4], vld1q_u32(s_roundConstants + 4 * (i))); \
+    const uint32x4_t save = hash0; \
+    hash0 = vsha256hq_u32(hash0, hash1, wk); \
+    hash1 = vsha256h2q_u32(hash1, save, wk); \
+    if ((i) < 12) { \
+        msg[(i) % 4] = vsha256su1q_u32(vsha256su0q_u32(msg[(i) % 4], msg[((i) + 1) % 4]), msg[((i) + 2) % 4], msg[((i) + 3) % 4]); \
+    } \
+} while (0)
+
+#define SHA256_LOAD_MESSAGE(msg, src_u8) \
+do { \
+    msg[0] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(src_u8 + 0x00))); \
+    msg[1] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(src_u8 + 0x10))); \
+    msg[2] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(src_u8 + 0x20))); \
+    msg[3] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(src_u8 + 0x30))); \
+} while (0)
+
+/* Processes blocks of two independent messages, interleaving the two dependency chains. */
+static void _sha256ProcessBlocksX2(Sha256Context *ctx_a, const u8 *src_a, Sha256Context *ctx_b, const u8 *src_b, size_t num_blocks) {
+    uint32x4_t state_a0 = vld1q_u32(ctx_a->intermediate_hash + 0);
+    uint32x4_t state_a1 = vld1q_u32(ctx_a->intermediate_hash + 4);
+    uint32x4_t state_b0 = vld1q_u32(ctx_b->intermediate_hash + 0);
+    uint32x4_t state_b1 = vld1q_u32(ctx_b->intermediate_hash + 4);
+
+    while (num_blocks > 0) {
+        uint32x4_t msg_a[4], msg_b[4];
+        SHA256_LOAD_MESSAGE(msg_a, src_a);
+        SHA256_LOAD_MESSAGE(msg_b, src_b);
+        src_a += SHA256_BLOCK_SIZE;
+        src_b += SHA256_BLOCK_SIZE;
+
+        uint32x4_t hash_a0 = state_a0, hash_a1 = state_a1;
+        uint32x4_t hash_b0 = state_b0, hash_b1 = state_b1;
+
+        #pragma GCC unroll 16
+        for (int i = 0; i < 16; i++) {
+            SHA256_QUAD_ROUND(i, hash_a0, hash_a1, msg_a);
+            SHA256_QUAD_ROUND(i, hash_b0, hash_b1, msg_b);
+        }
+
+        state_a0 = vaddq_u32(state_a0, hash_a0);
+        state_a1 = vaddq_u32(state_a1, hash_a1);
+        state_b0 = vaddq_u32(state_b0, hash_b0);
+        state_b1 = vaddq_u32(state_b1, hash_b1);
+
+        num_blocks--;
+    }
+
+    vst1q_u32(ctx_a->intermediate_hash + 0, state_a0);
+    vst1q_u32(ctx_a->intermediate_hash + 4, state_a1);
+    vst1q_u32(ctx_b->intermediate_hash + 0, state_b0);
+    vst1q_u32(ctx_b->intermediate_hash + 4, state_b1);
+}
+
 void sha256ContextUpdate(Sha256Context *ctx, const void *src, size_t size) {
     /* Convert src to u8* for utility. */
     const u8 *cur_src = (const u8 *)src;
@@ -256,3 +313,48 @@ void sha256CalculateHash(void *dst, const void *src, size_t size) {
     sha256ContextUpdate(&ctx, src, size);
     sha256ContextGetHash(&ctx, dst);
 }
+
+void sha256ContextUpdateX2(Sha256Context *ctx_a, const void *src_a, size_t size_a, Sha256Context *ctx_b, const void *src_b, size_t size_b) {
+    const u8 *cur_src_a = (const u8 *)src_a;
+    const u8 *cur_src_b = (const u8 *)src_b;
+
+    /* Interleave the complete blocks both messages have in common, when nothing is buffered. */
+    if (ctx_a->num_buffered == 0 && ctx_b->num_buffered == 0) {
+        const size_t blocks_a = size_a / SHA256_BLOCK_SIZE;
+        const size_t blocks_b = size_b / SHA256_BLOCK_SIZE;
+        const size_t num_blocks = (blocks_a < blocks_b ? blocks_a : blocks_b);
+        if (num_blocks > 0) {
+            _sha256ProcessBlocksX2(ctx_a, cur_src_a, ctx_b, cur_src_b, num_blocks);
+
+            const size_t processed = num_blocks * SHA256_BLOCK_SIZE;
+            ctx_a->bits_consumed += processed * 8;
+            ctx_b->bits_consumed += processed * 8;
+            cur_src_a += processed;
+            cur_src_b += processed;
+            size_a -= processed;
+            size_b -= processed;
+        }
+    }
+
+    /* The remainder of the longer message is hashed on its own. */
+    sha256ContextUpdate(ctx_a, cur_src_a, size_a);
+    sha256ContextUpdate(ctx_b, cur_src_b, size_b);
+}
+
+void sha256CalculateHashesBatch(void *const *dsts, const void *const *srcs, const size_t *sizes, size_t count) {
+    size_t i = 0;
+
+    /* Hash messages two at a time. */
+    for (; i + 1 < count; i += 2) {
+        Sha256Context ctx_a, ctx_b;
+        sha256ContextCreate(&ctx_a);
+        sha256ContextCreate(&ctx_b);
+        sha256ContextUpdateX2(&ctx_a, srcs[i + 0], sizes[i + 0], &ctx_b, srcs[i + 1], sizes[i + 1]);
+        sha256ContextGetHash(&ctx_a, dsts[i + 0]);
+        sha256ContextGetHash(&ctx_b, dsts[i + 1]);
+    }
+
+    if (i < count) {
+        sha256CalculateHash(dsts[i], srcs[i], sizes[i]);
+    }
+}
@@ -0,0 +1,240 @@
+#include <string.h>
+#include <stdlib.h>
+#include <arm_neon.h>
+
+#include "crypto/sha512.h"
+
+/* Cortex-A57 has no SHA512 instructions. The message schedule is computed two words at a time with NEON, */
+/* the rounds themselves are scalar, where the 64-bit rotates are single instructions. */
+static const u64 s_roundConstants[0x50] = {
+    0x428a2f98d728ae22, 0x7137449123ef65cd, 0xb5c0fbcfec4d3b2f, 0xe9b5dba58189dbbc,
+    0x3956c25bf348b538, 0x59f111f1b605d019, 0x923f82a4af194f9b, 0xab1c5ed5da6d8118,
+    0xd807aa98a3030242, 0x12835b0145706fbe, 0x243185be4ee4b28c, 0x550c7dc3d5ffb4e2,
+    0x72be5d74f27b896f, 0x80deb1fe3b1696b1, 0x9bdc06a725c71235, 0xc19bf174cf692694,
+    0xe49b69c19ef14ad2, 0xefbe4786384f25e3, 0x0fc19dc68b8cd5b5, 0x240ca1cc77ac9c65,
+    0x2de92c6f592b0275, 0x4a7484aa6ea6e483, 0x5cb0a9dcbd41fbd4, 0x76f988da831153b5,
+    0x983e5152ee66dfab, 0xa831c66d2db43210, 0xb00327c898fb213f, 0xbf597fc7beef0ee4,
+    0xc6e00bf33da88fc2, 0xd5a79147930aa725, 0x06ca6351e003826f, 0x142929670a0e6e70,
+    0x27b70a8546d22ffc, 0x2e1b21385c26c926, 0x4d2c6dfc5ac42aed, 0x53380d139d95b3df,
+    0x650a73548baf63de, 0x766a0abb3c77b2a8, 0x81c2c92e47edaee6, 0x92722c851482353b,
+    0xa2bfe8a14cf10364, 0xa81a664bbc423001, 0xc24b8b70d0f89791, 0xc76c51a30654be30,
+    0xd192e819d6ef5218, 0xd69906245565a910, 0xf40e35855771202a, 0x106aa07032bbd1b8,
+    0x19a4c116b8d2d0c8, 0x1e376c085141ab53, 0x2748774cdf8eeb99, 0x34b0bcb5e19b48a8,
+    0x391c0cb3c5c95a63, 0x4ed8aa4ae3418acb, 0x5b9cca4f7763e373, 0x682e6ff3d6b2b8a3,
+    0x748f82ee5defb2fc, 0x78a5636f43172f60, 0x84c87814a1f0ab72, 0x8cc702081a6439ec,
+    0x90befffa23631e28, 0xa4506cebde82bde9, 0xbef9a3f7b2c67915, 0xc67178f2e372532b,
+    0xca273eceea26619c, 0xd186b8c721c0c207, 0xeada7dd6cde0eb1e, 0xf57d4f7fee6ed178,
+    0x06f067aa72176fba, 0x0a637dc5a2c898a6, 0x113f9804bef90dae, 0x1b710b35131c471b,
+    0x28db77f523047d84, 0x32caab7b40c72493, 0x3c9ebe0a15c9bebc, 0x431d67c49c100d4c,
+    0x4cc5d4becb3e42b6, 0x597f299cfc657e2a, 0x5fcb6fab3ad6faec, 0x6c44198c4a475817
+};
+
+#define ROTR64(x, n) (((x) >> (n)) | ((x) << (64 - (n))))
+
+#define SHA512_CH(x, y, z)  (((x) & (y)) ^ (~(x) & (z)))
+#define SHA512_MAJ(x, y, z) (((x) & (y)) ^ ((x) & (z)) ^ ((y) & (z)))
+#define SHA512_SUM0(x)      (ROTR64(x, 28) ^ ROTR64(x, 34) ^ ROTR64(x, 39))
+#define SHA512_SUM1(x)      (ROTR64(x, 14) ^ ROTR64(x, 18) ^ ROTR64(x, 41))
+
+/* Vector rotate right, as shift right and insert. */
+#define VROTR64(x, n) vsriq_n_u64(vshlq_n_u64(x, 64 - (n)), x, n)
+
+#define SHA512_VSIGMA0(x) veorq_u64(veorq_u64(VROTR64(x, 1), VROTR64(x, 8)), vshrq_n_u64(x, 7))
+#define SHA512_VSIGMA1(x) veorq_u64(veorq_u64(VROTR64(x, 19), VROTR64(x, 61)), vshrq_n_u64(x, 6))
+
+/* One round, with the working variables renamed instead of shifted. */
+#define SHA512_ROUND(a, b, c, d, e, f, g, h, i) \
+do { \
+    const u64 t1 = h + SHA512_SUM1(e) + SHA512_CH(e, f, g) + w[i]; \
+    const u64 t2 = SHA512_SUM0(a) + SHA512_MAJ(a, b, c); \
+    d += t1; \
+    h = t1 + t2; \
+} while (0)
+
+#define SHA512_EIGHT_ROUNDS(i) \
+do { \
+    SHA512_ROUND(a, b, c, d, e, f, g, h, i + 0); \
+    SHA512_ROUND(h, a, b, c, d, e, f, g, i + 1); \
+    SHA512_ROUND(g, h, a, b, c, d, e, f, i + 2); \
+    SHA512_ROUND(f, g, h, a, b, c, d, e, i + 3); \
+    SHA512_ROUND(e, f, g, h, a, b, c, d, i + 4); \
+    SHA512_ROUND(d, e, f, g, h, a, b, c, i + 5); \
+    SHA512_ROUND(c, d, e, f, g, h, a, b, i + 6); \
+    SHA512_ROUND(b, c, d, e, f, g, h, a, i + 7); \
+} while (0)
+
+static void _sha512ProcessBlocks(Sha512Context *ctx, const u8 *src_u8, size_t num_blocks) {
+    u64 w[0x50];
+
+    while (num_blocks > 0) {
+        /* Load the block as big-endian words, and add the round constants as the schedule is expanded. */
+        uint64x2_t data[0x28];
+        for (size_t i = 0; i < 8; i++) {
+            data[i] = vreinterpretq_u64_u8(vrev64q_u8(vld1q_u8(src_u8 + 0x10 * i)));
+        }
+
+        /* W[t] = s1(W[t-2]) + W[t-7] + s0(W[t-15]) + W[t-16], two words at a time. */
+        for (size_t i = 8; i < 0x28; i++) {
+            const uint64x2_t w_7  = vextq_u64(data[i - 4], data[i - 3], 1);
+            const uint64x2_t w_15 = vextq_u64(data[i - 8], data[i - 7], 1);
+            data[i] = vaddq_u64(vaddq_u64(SHA512_VSIGMA1(data[i - 1]), w_7), vaddq_u64(SHA512_VSIGMA0(w_15), data[i - 8]));
+        }
+
+        for (size_t i = 0; i < 0x28; i++) {
+            vst1q_u64(w + 2 * i, vaddq_u64(data[i], vld1q_u64(s_roundConstants + 2 * i)));
+        }
+
+        u64 a = ctx->intermediate_hash[0];
+        u64 b = ctx->intermediate_hash[1];
+        u64 c = ctx->intermediate_hash[2];
+        u64 d = ctx->intermediate_hash[3];
+        u64 e = ctx->intermediate_hash[4];
+        u64 f = ctx->intermediate_hash[5];
+        u64 g = ctx->intermediate_hash[6];
+        u64 h = ctx->intermediate_hash[7];
+
+        for (size_t i = 0; i < 0x50; i += 8) {
+            SHA512_EIGHT_ROUNDS(i);
+        }
+
+        ctx->intermediate_hash[0] += a;
+        ctx->intermediate_hash[1] += b;
+        ctx->intermediate_hash[2] += c;
+        ctx->intermediate_hash[3] += d;
+        ctx->intermediate_hash[4] += e;
+        ctx->intermediate_hash[5] += f;
+        ctx->intermediate_hash[6] += g;
+        ctx->intermediate_hash[7] += h;
+
+        src_u8 += SHA512_BLOCK_SIZE;
+        num_blocks--;
+    }
+}
+
+static void _sha512ContextInit(Sha512Context *out, const u64 *h_0) {
+    memcpy(out->intermediate_hash, h_0, sizeof(out->intermediate_hash));
+    memset(out->buffer, 0, sizeof(out->buffer));
+    out->bits_consumed = 0;
+    out->num_buffered = 0;
+    out->finalized = false;
+}
+
+void sha512ContextCreate(Sha512Context *out) {
+    static const u64 H_0[SHA512_HASH_SIZE / sizeof(u64)] = {
+        0x6a09e667f3bcc908, 0xbb67ae8584caa73b, 0x3c6ef372fe94f82b, 0xa54ff53a5f1d36f1,
+        0x510e527fade682d1, 0x9b05688c2b3e6c1f, 0x1f83d9abfb41bd6b, 0x5be0cd19137e2179
+    };
+
+    _sha512ContextInit(out, H_0);
+}
+
+void sha384ContextCreate(Sha384Context *out) {
+    static const u64 H_0[SHA512_HASH_SIZE / sizeof(u64)] = {
+        0xcbbb9d5dc1059ed8, 0x629a292a367cd507, 0x9159015a3070dd17, 0x152fecd8f70e5939,
+        0x67332667ffc00b31, 0x8eb44a8768581511, 0xdb0c2e0d64f98fa7, 0x47b5481dbefa4fa4
+    };
+
+    _sha512ContextInit(out, H_0);
+}
+
+void sha512ContextUpdate(Sha512Context *ctx, const void *src, size_t size) {
+    /* Convert src to u8* for utility. */
+    const u8 *cur_src = (const u8 *)src;
+
+    /* Update bits consumed. */
+    ctx->bits_consumed += (((ctx->num_buffered + size) / SHA512_BLOCK_SIZE) * SHA512_BLOCK_SIZE) * 8;
+
+    /* Handle pre-buffered data. */
+    if (ctx->num_buffered > 0) {
+        const size_t needed = SHA512_BLOCK_SIZE - ctx->num_buffered;
+        const size_t copyable = (size > needed ? needed : size);
+        memcpy(&ctx->buffer[ctx->num_buffered], cur_src, copyable);
+        cur_src += copyable;
+        ctx->num_buffered += copyable;
+        size -= copyable;
+
+        if (ctx->num_buffered == SHA512_BLOCK_SIZE) {
+            _sha512ProcessBlocks(ctx, ctx->buffer, 1);
+            ctx->num_buffered = 0;
+        }
+    }
+
+    /* Handle complete blocks. */
+    if (size >= SHA512_BLOCK_SIZE) {
+        const size_t num_blocks = size / SHA512_BLOCK_SIZE;
+        _sha512ProcessBlocks(ctx, cur_src, num_blocks);
+        size -= SHA512_BLOCK_SIZE * num_blocks;
+        cur_src += SHA512_BLOCK_SIZE * num_blocks;
+    }
+
+    /* Buffer remaining data. */
+    if (size > 0) {
+        memcpy(ctx->buffer, cur_src, size);
+        ctx->num_buffered = size;
+    }
+}
+
+static void _sha512ContextFinalize(Sha512Context *ctx, void *dst, size_t hash_size) {
+    if (!ctx->finalized) {
+        /* Process last block, if necessary. */
+        {
+            ctx->bits_consumed += 8 * ctx->num_buffered;
+            ctx->buffer[ctx->num_buffered++] = 0x80;
+
+            /* The length field is 128 bits, its upper half is always zero here. */
+            const size_t last_block_max_size = SHA512_BLOCK_SIZE - sizeof(u64);
+            /* If we've got space for the bits consumed field, just set to zero. */
+            if (ctx->num_buffered <= last_block_max_size - sizeof(u64)) {
+                memset(ctx->buffer + ctx->num_buffered, 0, last_block_max_size - ctx->num_buffered);
+            } else {
+                /* Pad with zeroes, and process. */
+                memset(ctx->buffer + ctx->num_buffered, 0, SHA512_BLOCK_SIZE - ctx->num_buffered);
+                _sha512ProcessBlocks(ctx, ctx->buffer, 1);
+
+                /* Clear the rest of the buffer with zeroes. */
+                memset(ctx->buffer, 0, last_block_max_size);
+            }
+
+            /* Copy in bits consumed field, then process last block. */
+            u64 big_endian_bits_consumed = __builtin_bswap64(ctx->bits_consumed);
+            memcpy(ctx->buffer + last_block_max_size, &big_endian_bits_consumed, sizeof(big_endian_bits_consumed));
+            _sha512ProcessBlocks(ctx, ctx->buffer, 1);
+        }
+        ctx->finalized = true;
+    }
+
+    /* Copy endian-swapped intermediate hash out. */
+    u8 *dst_u8 = (u8 *)dst;
+    for (size_t i = 0; i < hash_size / sizeof(u64); i++) {
+        const u64 tmp = __builtin_bswap64(ctx->intermediate_hash[i]);
+        memcpy(dst_u8 + i * sizeof(u64), &tmp, sizeof(tmp));
+    }
+}
+
+void sha512ContextGetHash(Sha512Context *ctx, void *dst) {
+    _sha512ContextFinalize(ctx, dst, SHA512_HASH_SIZE);
+}
+
+void sha512CalculateHash(void *dst, const void *src, size_t size) {
+    /* Make a new context, calculate hash, store to output. */
+    Sha512Context ctx;
+    sha512ContextCreate(&ctx);
+    sha512ContextUpdate(&ctx, src, size);
+    sha512ContextGetHash(&ctx, dst);
+}
+
+void sha384ContextUpdate(Sha384Context *ctx, const void *src, size_t size) {
+    sha512ContextUpdate(ctx, src, size);
+}
+
+void sha384ContextGetHash(Sha384Context *ctx, void *dst) {
+    _sha512ContextFinalize(ctx, dst, SHA384_HASH_SIZE);
+}
+
+void sha384CalculateHash(void *dst, const void *src, size_t size) {
+    /* Make a new context, calculate hash, store to output. */
+    Sha384Context ctx;
+    sha384ContextCreate(&ctx);
+    sha384ContextUpdate(&ctx, src, size);
+    sha384ContextGetHash(&ctx, dst);
+}
@@ -28,7 +28,24 @@ enum {
     /* 0xE */ SET_PREALLOCATED_BUFFER, // Custom Switch-specific command
 };
 
-static const char g_bq_InterfaceDescriptor[] = "android.gui.IGraphicBufferProducer";
+#define BQ_INTERFACE_DESCRIPTOR "android.gui.IGraphicBufferProducer"
+
+// Interface token as written by parcelWriteInterfaceToken: strict mode policy, then the descriptor as a String16.
+// It's sent with every transaction (including the per-frame dequeue/queue ones), so it's serialized at build time.
+static const struct {
+    s32 strict_policy;
+    s32 len;
+    u16 str[sizeof(BQ_INTERFACE_DESCRIPTOR)];
+} g_bq_InterfaceToken = {
+    0x100,
+    sizeof(BQ_INTERFACE_DESCRIPTOR) - 1,
+    u"" BQ_INTERFACE_DESCRIPTOR,
+};
+
+static inline void _bqWriteInterfaceToken(Parcel *parcel)
+{
+    parcelWriteData(parcel, &g_bq_InterfaceToken, sizeof(g_bq_InterfaceToken));
+}
 
 Result bqRequestBuffer(Binder *b, s32 bufferIdx, BqGraphicBuffer *buf)
 {
@@ -38,7 +55,7 @@ Result bqRequestBuffer(Binder *b, s32 bufferIdx, BqGraphicBuffer *buf)
     parcelCreate(&parcel);
     parcelCreate(&parcel_reply);
 
-    parcelWriteInterfaceToken(&parcel, g_bq_InterfaceDescriptor);
+    _bqWriteInterfaceToken(&parcel);
     parcelWriteInt32(&parcel, bufferIdx);
 
     rc = parcelTransact(b, REQUEST_BUFFER, &parcel, &parcel_reply);
@@ -72,7 +89,7 @@ Result bqDequeueBuffer(Binder *b, bool async, u32 width, u32 height, s32 format,
     parcelCreate(&parcel);
     parcelCreate(&parcel_reply);
 
-    parcelWriteInterfaceToken(&parcel, g_bq_InterfaceDescriptor);
+    _bqWriteInterfaceToken(&parcel);
 
     parcelWriteInt32(&parcel, async);
     parcelWriteUInt32(&parcel, width);
@@ -111,7 +128,7 @@ Result bqDetachBuffer(Binder *b, s32 slot)
     parcelCreate(&parcel);
     parcelCreate(&parcel_reply);
 
-    parcelWriteInterfaceToken(&parcel, g_bq_InterfaceDescriptor);
+    _bqWriteInterfaceToken(&parcel);
     parcelWriteInt32(&parcel, slot);
 
     rc = parcelTransact(b, DETACH_BUFFER, &parcel, &parcel_reply);
@@ -131,7 +148,7 @@ Result bqQueueBuffer(Binder *b, s32 buf, const BqBufferInput *input, BqBufferOut
     parcelCreate(&parcel);
     parcelCreate(&parcel_reply);
 
-    parcelWriteInterfaceToken(&parcel, g_bq_InterfaceDescriptor);
+    _bqWriteInterfaceToken(&parcel);
     parcelWriteInt32(&parcel, buf);
     parcelWriteFlattenedObject(&parcel, input, sizeof(*input));
 
@@ -155,7 +172,7 @@ Result bqCancelBuffer(Binder *b, s32 buf, const NvMultiFence *fence)
     parcelCreate(&parcel);
     parcelCreate(&parcel_reply);
 
-    parcelWriteInterfaceToken(&parcel, g_bq_InterfaceDescriptor);
+    _bqWriteInterfaceToken(&parcel);
     parcelWriteInt32(&parcel, buf);
     parcelWriteFlattenedObject(&parcel, fence, sizeof(*fence));
 
@@ -173,7 +190,7 @@ Result bqQuery(Binder *b, s32 what, s32* value)
     parcelCreate(&parcel);
     parcelCreate(&parcel_reply);
 
-    parcelWriteInterfaceToken(&parcel, g_bq_InterfaceDescriptor);
+    _bqWriteInterfaceToken(&parcel);
     parcelWriteInt32(&parcel, what);
 
     rc = parcelTransact(b, QUERY, &parcel, &parcel_reply);
@@ -195,7 +212,7 @@ Result bqConnect(Binder *b, s32 api, bool producerControlledByApp, BqBufferOutpu
     parcelCreate(&parcel);
     parcelCreate(&parcel_reply);
 
-    parcelWriteInterfaceToken(&parcel, g_bq_InterfaceDescriptor);
+    _bqWriteInterfaceToken(&parcel);
 
     // Hard-code this as if listener==NULL, since that's not known to be used officially.
     parcelWriteInt32(&parcel, 0);
@@ -222,7 +239,7 @@ Result bqDisconnect(Binder *b, s32 api)
     parcelCreate(&parcel);
     parcelCreate(&parcel_reply);
 
-    parcelWriteInterfaceToken(&parcel, g_bq_InterfaceDescriptor);
+    _bqWriteInterfaceToken(&parcel);
     parcelWriteInt32(&parcel, api);
 
     rc = parcelTransact(b, DISCONNECT, &parcel, &parcel_reply);
@@ -249,7 +266,7 @@ Result bqSetPreallocatedBuffer(Binder *b, s32 buf, const BqGraphicBuffer *input)
     parcelCreate(&parcel);
     parcelCreate(&parcel_reply);
 
-    parcelWriteInterfaceToken(&parcel, g_bq_InterfaceDescriptor);
+    _bqWriteInterfaceToken(&parcel);
     parcelWriteInt32(&parcel, buf);
 
     parcelWriteInt32(&parcel, hasInput);
@@ -8,6 +8,12 @@
 #include "display/native_window.h"
 #include "nvidia/graphic_buffer.h"
 
+/// Presentation mode of the default window (\ref NWindowPresentMode).
+__attribute__((weak)) u32 __nx_win_present_mode = NWindowPresentMode_Fifo;
+
+/// Swap interval of the default window.
+__attribute__((weak)) u32 __nx_win_swap_interval = 1;
+
 static ViDisplay g_viDisplay;
 static ViLayer g_viLayer;
 static NWindow g_defaultWin;
@@ -29,8 +35,11 @@ void __nx_win_init(void)
                 rc = viSetLayerScalingMode(&g_viLayer, ViScalingMode_FitToLayer);
                 if (R_SUCCEEDED(rc)) {
                     rc = nwindowCreateFromLayer(&g_defaultWin, &g_viLayer);
-                    if (R_SUCCEEDED(rc))
+                    if (R_SUCCEEDED(rc)) {
                         nwindowSetDimensions(&g_defaultWin, 1280, 720);
+                        nwindowSetPresentMode(&g_defaultWin, (NWindowPresentMode)__nx_win_present_mode);
+                        nwindowSetSwapInterval(&g_defaultWin, __nx_win_swap_interval);
+                    }
                 }
                 if (R_FAILED(rc))
                     viCloseLayer(&g_viLayer);
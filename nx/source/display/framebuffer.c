@@ -1,11 +1,14 @@
 #include <stdlib.h>
 #include <string.h>
+#include <arm_neon.h>
 #include "types.h"
 #include "result.h"
 #include "arm/cache.h"
+#include "kernel/task_scheduler.h"
 #include "services/fatal.h"
 #include "services/nv.h"
 #include "services/vi.h"
+#include "runtime/large_buffer.h"
 #include "display/binder.h"
 #include "display/buffer_producer.h"
 #include "display/native_window.h"
@@ -47,6 +50,7 @@ Result framebufferCreate(Framebuffer* fb, NWindow *win, u32 width, u32 height, u
     fb->has_init = true;
     fb->win = win;
     fb->num_fbs = num_fbs;
+    fb->format = format;
 
     const NvColorFormat colorfmt = g_nvColorFmtTable[format-PIXEL_FORMAT_RGBA_8888];
     const u32 bytes_per_pixel = ((u64)colorfmt >> 3) & 0x1F;
@@ -76,7 +80,7 @@ Result framebufferCreate(Framebuffer* fb, NWindow *win, u32 width, u32 height, u
     const u32 fb_size = width_aligned_bytes*height_aligned;
     const u32 buf_size = (num_fbs*fb_size + 0xFFF) &~ 0xFFF; // needs to be page aligned
 
-    fb->buf = aligned_alloc(0x1000, buf_size);
+    fb->buf = largeBufferAlloc(buf_size);
     if (!fb->buf)
         rc = MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
 
@@ -134,10 +138,13 @@ void framebufferClose(Framebuffer* fb)
     if (fb->buf_linear)
         free(fb->buf_linear);
 
+    if (fb->dirty)
+        free(fb->dirty);
+
     if (fb->buf) {
         nwindowReleaseBuffers(fb->win);
         nvMapClose(&fb->map);
-        free(fb->buf);
+        largeBufferFree(fb->buf);
     }
 
     memset(fb, 0, sizeof(*fb));
@@ -146,23 +153,63 @@ void framebufferClose(Framebuffer* fb)
     nvExit();
 }
 
-void* framebufferBegin(Framebuffer* fb, u32* out_stride)
+Result framebufferSetPresentMode(Framebuffer* fb, FramebufferPresentMode mode)
+{
+    if (!fb || !fb->has_init)
+        return MAKERESULT(Module_Libnx, LibnxError_NotInitialized);
+    if (mode != FramebufferPresentMode_Fifo && mode != FramebufferPresentMode_Mailbox)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+    if (mode == FramebufferPresentMode_Mailbox && !fb->buf_linear)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+    if (fb->win->cur_slot >= 0)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    fb->present_mode = mode;
+    return 0;
+}
+
+static Result _framebufferBegin(Framebuffer* fb, void** out_buf, u32* out_stride, bool wait)
 {
     if (!fb->has_init)
-        return NULL;
+        return MAKERESULT(Module_Libnx, LibnxError_NotInitialized);
+
+    if (out_stride)
+        *out_stride = fb->stride;
+
+    // The buffer is only dequeued when presenting.
+    if (fb->present_mode == FramebufferPresentMode_Mailbox) {
+        *out_buf = fb->buf_linear;
+        return 0;
+    }
 
     s32 slot;
-    Result rc = nwindowDequeueBuffer(fb->win, &slot, NULL);
+    NvMultiFence fence;
+    Result rc = wait ? nwindowDequeueBuffer(fb->win, &slot, NULL) : nwindowTryDequeueBuffer(fb->win, &slot, &fence);
+    if (rc == MAKERESULT(Module_LibnxBinder, LibnxBinderError_WouldBlock))
+        return rc;
     if (R_FAILED(rc))
         fatalThrow(MAKERESULT(Module_Libnx, LibnxError_BadGfxDequeueBuffer));
 
-    if (out_stride)
-        *out_stride = fb->stride;
+    if (!wait && R_FAILED(nvMultiFenceWait(&fence, 0))) {
+        // The buffer is free but still being read: hand it back along with its fence.
+        nwindowCancelBuffer(fb->win, slot, &fence);
+        return MAKERESULT(Module_LibnxBinder, LibnxBinderError_WouldBlock);
+    }
 
-    if (fb->buf_linear)
-        return fb->buf_linear;
+    *out_buf = fb->buf_linear ? fb->buf_linear : (u8*)fb->buf + slot*fb->fb_size;
+    return 0;
+}
+
+void* framebufferBegin(Framebuffer* fb, u32* out_stride)
+{
+    void* buf = NULL;
+    _framebufferBegin(fb, &buf, out_stride, true);
+    return buf;
+}
 
-    return (u8*)fb->buf + slot*fb->fb_size;
+Result framebufferTryBegin(Framebuffer* fb, void** out_buf, u32* out_stride)
+{
+    return _framebufferBegin(fb, out_buf, out_stride, false);
 }
 
 static void _convertGobTo16Bx2(u8* outgob, const u8* ingob, u32 stride)
@@ -174,40 +221,184 @@ static void _convertGobTo16Bx2(u8* outgob, const u8* ingob, u32 stride)
     // This swizzling of the 'i' field can be expressed the following way:
     //   43210 -> 14302  to go from unswizzled to swizzled offset
     //   32041 <- 43210  to go from swizzled to unswizzled offset
-    // Here, we iterate through each of the 32 sequential swizzled positions and
-    // calculate the actual X and Y positions in the unswizzled source image.
-    // Since the 'o' bits aren't swizzled, we can copy the whole thing as a single 128-bit unit.
-
-    for (u32 i = 0; i < 32; i ++) {
-        const u32 y = ((i>>1)&0x06) | ( i    &0x01);
-        const u32 x = ((i<<3)&0x10) | ((i<<1)&0x20);
-        *(u128*)outgob = *(u128*)(ingob + y*stride + x);
-        outgob += sizeof(u128);
+    // In other words, the 32 sequential swizzled 128-bit units are ordered by x5 y2 y1 x4 y0,
+    // so each 64-byte run of output interleaves 32 bytes from two consecutive rows:
+    //   (y, x) (y+1, x) (y, x+16) (y+1, x+16)
+    // which is two pairs of loads and two pairs of stores.
+
+    for (u32 x = 0; x < 64; x += 32) {
+        for (u32 y = 0; y < 8; y += 2) {
+            const u8* row0 = ingob + y*stride + x;
+            const u8* row1 = row0 + stride;
+            const uint8x16_t a0 = vld1q_u8(row0), a1 = vld1q_u8(row0 + 16);
+            const uint8x16_t b0 = vld1q_u8(row1), b1 = vld1q_u8(row1 + 16);
+            vst1q_u8(outgob,      a0);
+            vst1q_u8(outgob + 16, b0);
+            vst1q_u8(outgob + 32, a1);
+            vst1q_u8(outgob + 48, b1);
+            outgob += 64;
+        }
     }
 }
 
-static void _convertToBlocklinear(void* outbuf, const void* inbuf, u32 stride, u32 height, u32 block_height_log2)
+typedef struct {
+    void* outbuf;
+    const void* inbuf;
+    u32 stride;
+    u32 height;
+    u32 block_height_log2;
+    u32 fb_size;
+    const u64* dirty;   ///< Bitmap of the GOBs to convert (indexed by GOB row of the shadow buffer, then column), NULL to convert everything.
+    u32 gob_row_offset; ///< Shadow buffer GOB row presented at the top.
+    u32 num_gob_rows;   ///< Number of GOB rows in the shadow buffer.
+} ConvertParams;
+
+// GOB row of the shadow buffer presented at the specified GOB row of the image.
+static inline u32 _convertSourceGobRow(const ConvertParams* p, u32 gob_row)
 {
-    const u32 block_height_gobs = 1U << block_height_log2;
-    const u32 block_height_px = 8U << block_height_log2;
+    u32 row = gob_row + p->gob_row_offset;
+    return row < p->num_gob_rows ? row : row - p->num_gob_rows;
+}
+
+// Converts (and flushes) the rows of blocks [block_y_begin, block_y_end).
+static void _convertToBlocklinear(void* arg, size_t block_y_begin, size_t block_y_end)
+{
+    const ConvertParams* p = (const ConvertParams*)arg;
+    const u32 stride = p->stride, height = p->height;
+    const u32 block_height_gobs = 1U << p->block_height_log2;
+    const u32 block_height_px = 8U << p->block_height_log2;
 
     const u32 width_blocks = stride >> 6;
-    const u32 height_blocks = (height + block_height_px - 1) >> (3 + block_height_log2);
-    u8* outgob = (u8*)outbuf;
+    const u32 block_row_size = width_blocks*block_height_gobs*512;
+    u8* outbuf = (u8*)p->outbuf;
+    u8* outgob = outbuf + block_y_begin*block_row_size;
+
+    if (!p->dirty) {
+        for (u32 block_y = block_y_begin; block_y < block_y_end; block_y ++) {
+            for (u32 block_x = 0; block_x < width_blocks; block_x ++) {
+                for (u32 gob_y = 0; gob_y < block_height_gobs; gob_y ++) {
+                    const u32 x = block_x*64;
+                    const u32 y = block_y*block_height_px + gob_y*8;
+                    if (y < height) {
+                        const u8* ingob = (const u8*)p->inbuf + _convertSourceGobRow(p, y / 8)*8*stride + x;
+
+                        // The same GOB of the next block is read once this block is done.
+                        if (block_x + 1 < width_blocks)
+                            for (u32 i = 0; i < 8; i ++)
+                                __builtin_prefetch(ingob + i*stride + 64);
+
+                        _convertGobTo16Bx2(outgob, ingob, stride);
+                    }
+                    outgob += 512;
+                }
+            }
+        }
 
-    for (u32 block_y = 0; block_y < height_blocks; block_y ++) {
+        u32 flush_start = block_y_begin*block_row_size;
+        u32 flush_end = block_y_end*block_row_size;
+        if (flush_end > p->fb_size)
+            flush_end = p->fb_size;
+        if (flush_start < flush_end)
+            armDCacheFlush(outbuf + flush_start, flush_end - flush_start);
+        return;
+    }
+
+    // Only dirty GOBs are converted, and runs of them contiguous in the output are flushed together, in batches sharing one barrier.
+    ArmCacheRange runs[16];
+    u32 num_runs = 0;
+    u8* run_start = NULL;
+    for (u32 block_y = block_y_begin; block_y < block_y_end; block_y ++) {
         for (u32 block_x = 0; block_x < width_blocks; block_x ++) {
-            for (u32 gob_y = 0; gob_y < block_height_gobs; gob_y ++) {
-                const u32 x = block_x*64;
-                const u32 y = block_y*block_height_px + gob_y*8;
-                if (y < height) {
-                    const u8* ingob = (u8*)inbuf + y*stride + x;
-                    _convertGobTo16Bx2(outgob, ingob, stride);
+            for (u32 gob_y = 0; gob_y < block_height_gobs; gob_y ++, outgob += 512) {
+                const u32 gob_row = block_y*block_height_gobs + gob_y;
+                const u32 src_gob_row = gob_row*8 < height ? _convertSourceGobRow(p, gob_row) : gob_row;
+                const u32 index = src_gob_row*width_blocks + block_x;
+                const u32 y = gob_row*8;
+
+                if (y >= height || !(p->dirty[index / 64] & (1ULL << (index % 64)))) {
+                    if (run_start) {
+                        runs[num_runs++] = (ArmCacheRange){ run_start, outgob - run_start };
+                        if (num_runs == sizeof(runs)/sizeof(runs[0])) {
+                            armDCacheFlushRanges(runs, num_runs);
+                            num_runs = 0;
+                        }
+                        run_start = NULL;
+                    }
+                    continue;
                 }
-                outgob += 512;
+
+                _convertGobTo16Bx2(outgob, (const u8*)p->inbuf + src_gob_row*8*stride + block_x*64, stride);
+                if (!run_start)
+                    run_start = outgob;
             }
         }
     }
+
+    if (run_start)
+        runs[num_runs++] = (ArmCacheRange){ run_start, outgob - run_start };
+    if (num_runs)
+        armDCacheFlushRanges(runs, num_runs);
+}
+
+Result framebufferSetRowOffset(Framebuffer* fb, u32 row_offset)
+{
+    if (!fb || !fb->has_init || !fb->buf_linear)
+        return MAKERESULT(Module_Libnx, LibnxError_NotInitialized);
+    if ((row_offset & 7) || row_offset >= ((fb->win->height + 7) &~ 7))
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+    if (row_offset == fb->row_offset)
+        return 0;
+
+    // Every row moved on screen, none of the buffers holds the image anymore.
+    fb->row_offset = row_offset;
+    if (fb->dirty)
+        memset(fb->dirty, 0xFF, fb->num_fbs * fb->dirty_words * sizeof(u64));
+    return 0;
+}
+
+Result framebufferEnableDirtyTracking(Framebuffer* fb)
+{
+    if (!fb || !fb->has_init || !fb->buf_linear)
+        return MAKERESULT(Module_Libnx, LibnxError_NotInitialized);
+    if (fb->dirty)
+        return 0;
+
+    fb->gobs_per_row = fb->stride / 64;
+    const u32 num_gobs = fb->gobs_per_row * (fb->height_aligned / 8);
+    fb->dirty_words = (num_gobs + 63) / 64;
+    fb->dirty = (u64*)malloc(fb->num_fbs * fb->dirty_words * sizeof(u64));
+    if (!fb->dirty)
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+
+    // No buffer holds the image yet.
+    memset(fb->dirty, 0xFF, fb->num_fbs * fb->dirty_words * sizeof(u64));
+    return 0;
+}
+
+void framebufferMarkDirty(Framebuffer* fb, u32 x, u32 y, u32 width, u32 height)
+{
+    if (!fb->dirty || !width || !height)
+        return;
+
+    const u32 bytes_per_pixel = fb->stride / fb->width_aligned;
+    const u32 num_rows = fb->height_aligned / 8;
+    if (x >= fb->width_aligned || y >= num_rows*8)
+        return;
+    if (width > fb->width_aligned - x)
+        width = fb->width_aligned - x;
+    if (height > num_rows*8 - y)
+        height = num_rows*8 - y;
+
+    const u32 col_first = x*bytes_per_pixel / 64, col_last = ((x + width)*bytes_per_pixel - 1) / 64;
+    const u32 row_first = y / 8, row_last = (y + height - 1) / 8;
+
+    for (u32 row = row_first; row <= row_last; row ++) {
+        for (u32 col = col_first; col <= col_last; col ++) {
+            const u32 index = row*fb->gobs_per_row + col;
+            for (u32 i = 0; i < fb->num_fbs; i ++)
+                fb->dirty[i*fb->dirty_words + index / 64] |= 1ULL << (index % 64);
+        }
+    }
 }
 
 void framebufferEnd(Framebuffer* fb)
@@ -215,11 +406,39 @@ void framebufferEnd(Framebuffer* fb)
     if (!fb->has_init)
         return;
 
-    void* buf = (u8*)fb->buf + fb->win->cur_slot*fb->fb_size;
-    if (fb->buf_linear)
-        _convertToBlocklinear(buf, fb->buf_linear, fb->stride, fb->win->height, 4);
+    if (fb->present_mode == FramebufferPresentMode_Mailbox) {
+        s32 slot;
+        NvMultiFence fence;
+        Result rc = nwindowTryDequeueBuffer(fb->win, &slot, &fence);
+        if (rc == MAKERESULT(Module_LibnxBinder, LibnxBinderError_WouldBlock)) {
+            // The shadow buffer (and dirty GOBs) carry over to the next frame.
+            fb->frames_dropped++;
+            return;
+        }
+        if (R_FAILED(rc))
+            fatalThrow(MAKERESULT(Module_Libnx, LibnxError_BadGfxDequeueBuffer));
 
-    armDCacheFlush(buf, fb->fb_size);
+        // A released buffer's fence is normally already signalled, or about to be.
+        nvMultiFenceWait(&fence, -1);
+    }
+
+    void* buf = (u8*)fb->buf + fb->win->cur_slot*fb->fb_size;
+    if (fb->buf_linear) {
+        const u32 block_height_log2 = 4;
+        u64* dirty = fb->dirty ? &fb->dirty[fb->win->cur_slot*fb->dirty_words] : NULL;
+        ConvertParams params = { buf, fb->buf_linear, fb->stride, fb->win->height, block_height_log2, fb->fb_size, dirty, fb->row_offset / 8, (fb->win->height + 7) / 8 };
+        const u32 height_blocks = fb->height_aligned >> (3 + block_height_log2);
+
+        if (fb->ts)
+            taskSchedulerParallelFor(fb->ts, _convertToBlocklinear, &params, 0, height_blocks, 1);
+        else
+            _convertToBlocklinear(&params, 0, height_blocks);
+
+        if (dirty)
+            memset(dirty, 0, fb->dirty_words * sizeof(u64));
+    }
+    else
+        armDCacheFlush(buf, fb->fb_size);
 
     Result rc = nwindowQueueBuffer(fb->win, fb->win->cur_slot, NULL);
     if (R_FAILED(rc))
@@ -0,0 +1,279 @@
+#include <string.h>
+#include "types.h"
+#include "result.h"
+#include "services/fatal.h"
+#include "display/types.h"
+#include "display/native_window.h"
+#include "display/framebuffer.h"
+#include "display/framebuffer_2d.h"
+#include "nvidia/address_space.h"
+#include "nvidia/fence.h"
+#include "nvidia/gpu_channel.h"
+#include "nvidia/cmd_ring.h"
+
+// Fermi 2D engine (class 0x902D), bound to subchannel 3 like nvn does.
+#define NV2D_CLASS      0x902D
+#define NV2D_SUBCHANNEL 3
+
+#define NV2D_SET_OBJECT                         0x0000
+#define NV2D_SET_DST_FORMAT                     0x0200  // FORMAT, MEMORY_LAYOUT, BLOCK_SIZE, DEPTH, LAYER, PITCH, WIDTH, HEIGHT, OFFSET_UPPER, OFFSET_LOWER
+#define NV2D_SET_SRC_FORMAT                     0x0230  // FORMAT, MEMORY_LAYOUT, BLOCK_SIZE, DEPTH, (invalidate), PITCH, WIDTH, HEIGHT, OFFSET_UPPER, OFFSET_LOWER
+#define NV2D_SET_CLIP_ENABLE                    0x0290
+#define NV2D_SET_OPERATION                      0x02AC
+#define NV2D_RENDER_SOLID_PRIM_MODE             0x0580  // MODE, COLOR_FORMAT, COLOR
+#define NV2D_RENDER_SOLID_PRIM_POINT_SET_X(j)   (0x0600 + (j)*8)
+#define NV2D_SET_PIXELS_FROM_MEMORY_SAMPLE_MODE 0x0888
+#define NV2D_SET_PIXELS_FROM_MEMORY_DST_X0      0x08B0  // DST_X0, DST_Y0, DST_WIDTH, DST_HEIGHT, DU_DX_FRAC/INT, DV_DY_FRAC/INT, SRC_X0_FRAC/INT, SRC_Y0_FRAC/INT (launch)
+
+#define NV2D_OPERATION_SRCCOPY     3
+#define NV2D_SOLID_PRIM_MODE_RECTS 4
+#define NV2D_LAYOUT_BLOCKLINEAR    0
+#define NV2D_LAYOUT_PITCH          1
+
+#define NV2D_FORMAT_A8R8G8B8 0xCF
+#define NV2D_FORMAT_A8B8G8R8 0xD5
+#define NV2D_FORMAT_R5G6B5   0xE8
+
+// Incrementing method header.
+#define NV2D_MTHD(mthd, count) (0x20000000 | ((count) << 16) | (NV2D_SUBCHANNEL << 13) | ((mthd) >> 2))
+
+#define CMD_RING_SEGMENT_SIZE 0x4000
+#define CMD_RING_NUM_SEGMENTS 4
+
+static u32 _framebuffer2dFormat(u32 format)
+{
+    switch (format) {
+        case PIXEL_FORMAT_RGBA_8888:
+        case PIXEL_FORMAT_RGBX_8888: // The compositor ignores the alpha channel.
+            return NV2D_FORMAT_A8B8G8R8;
+        case PIXEL_FORMAT_BGRA_8888:
+            return NV2D_FORMAT_A8R8G8B8;
+        case PIXEL_FORMAT_RGB_565:
+            return NV2D_FORMAT_R5G6B5;
+        default:
+            return 0;
+    }
+}
+
+static Result _framebuffer2dCheckSlot(Framebuffer2D* g, s32* out_slot)
+{
+    s32 slot = g->fb->win->cur_slot;
+    if (slot < 0)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+    *out_slot = slot;
+    return 0;
+}
+
+static inline bool _framebuffer2dRectFits(u32 x, u32 y, u32 width, u32 height, u32 surf_width, u32 surf_height)
+{
+    return width && height && x <= surf_width && width <= surf_width - x && y <= surf_height && height <= surf_height - y;
+}
+
+#define NV2D_SURFACE_SETUP_WORDS 11
+
+static u32* _framebuffer2dSetDestination(Framebuffer2D* g, u32* cmd, s32 slot)
+{
+    iova_t iova = g->fb_iova + (iova_t)slot * g->fb->fb_size;
+    if (g->dst_iova == iova)
+        return cmd;
+
+    *cmd++ = NV2D_MTHD(NV2D_SET_DST_FORMAT, 10);
+    *cmd++ = g->fb_format;
+    *cmd++ = NV2D_LAYOUT_BLOCKLINEAR;
+    *cmd++ = 4 << 4; // 16 GOBs high blocks, as set up by framebufferCreate.
+    *cmd++ = 1;
+    *cmd++ = 0;
+    *cmd++ = g->fb->stride;
+    *cmd++ = g->fb->width_aligned;
+    *cmd++ = g->fb->height_aligned;
+    *cmd++ = iova >> 32;
+    *cmd++ = iova;
+    g->dst_iova = iova;
+    return cmd;
+}
+
+static u32* _framebuffer2dSetSource(Framebuffer2D* g, u32* cmd, iova_t iova, u32 format, u32 layout, u32 pitch, u32 width, u32 height)
+{
+    // The same memory can be used as another image, e.g. a reused staging buffer.
+    if (g->src_iova == iova && g->src_format == format && g->src_layout == layout &&
+        g->src_pitch == pitch && g->src_width == width && g->src_height == height)
+        return cmd;
+
+    *cmd++ = NV2D_MTHD(NV2D_SET_SRC_FORMAT, 4);
+    *cmd++ = format;
+    *cmd++ = layout;
+    *cmd++ = layout == NV2D_LAYOUT_BLOCKLINEAR ? 4 << 4 : 0;
+    *cmd++ = 1;
+    *cmd++ = NV2D_MTHD(NV2D_SET_SRC_FORMAT + 0x14, 5);
+    *cmd++ = pitch;
+    *cmd++ = width;
+    *cmd++ = height;
+    *cmd++ = iova >> 32;
+    *cmd++ = iova;
+    g->src_iova = iova;
+    g->src_format = format;
+    g->src_layout = layout;
+    g->src_pitch = pitch;
+    g->src_width = width;
+    g->src_height = height;
+    return cmd;
+}
+
+static u32* _framebuffer2dPixelsFromMemory(u32* cmd, u32 dst_x, u32 dst_y, u32 src_x, u32 src_y, u32 width, u32 height)
+{
+    // 1:1 scale, integer source coordinates.
+    *cmd++ = NV2D_MTHD(NV2D_SET_PIXELS_FROM_MEMORY_DST_X0, 12);
+    *cmd++ = dst_x;
+    *cmd++ = dst_y;
+    *cmd++ = width;
+    *cmd++ = height;
+    *cmd++ = 0;
+    *cmd++ = 1;
+    *cmd++ = 0;
+    *cmd++ = 1;
+    *cmd++ = 0;
+    *cmd++ = src_x;
+    *cmd++ = 0;
+    *cmd++ = src_y;
+    return cmd;
+}
+
+Result framebuffer2dCreate(Framebuffer2D* g, Framebuffer* fb, NvGpuChannel* c, NvAddressSpace* as)
+{
+    if (!fb || !fb->has_init || fb->buf_linear)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    u32 format = _framebuffer2dFormat(fb->format);
+    if (!format)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    memset(g, 0, sizeof(*g));
+    g->fb = fb;
+    g->channel = c;
+    g->as = as;
+    g->fb_format = format;
+
+    // The CPU side swizzles into 16Bx2 sectors, the GPU gets the same layout from the kind.
+    Result rc = nvAddressSpaceMap(as, nvMapGetHandle(&fb->map), true, NvKind_Generic_16BX2, &g->fb_iova);
+    if (R_FAILED(rc))
+        return rc;
+
+    rc = nvCmdRingCreate(&g->ring, c, as, CMD_RING_SEGMENT_SIZE, CMD_RING_NUM_SEGMENTS);
+    if (R_SUCCEEDED(rc)) {
+        u32* cmd = nvCmdRingReserve(&g->ring, 6);
+        cmd[0] = NV2D_MTHD(NV2D_SET_OBJECT, 1);
+        cmd[1] = NV2D_CLASS;
+        cmd[2] = NV2D_MTHD(NV2D_SET_CLIP_ENABLE, 1);
+        cmd[3] = 0;
+        cmd[4] = NV2D_MTHD(NV2D_SET_OPERATION, 1);
+        cmd[5] = NV2D_OPERATION_SRCCOPY;
+        nvCmdRingCommit(&g->ring, 6);
+    }
+    else
+        nvAddressSpaceUnmap(as, g->fb_iova);
+
+    return rc;
+}
+
+void framebuffer2dClose(Framebuffer2D* g)
+{
+    if (!g->fb)
+        return;
+
+    nvCmdRingClose(&g->ring);
+    nvAddressSpaceUnmap(g->as, g->fb_iova);
+    g->fb = NULL;
+}
+
+Result framebuffer2dFill(Framebuffer2D* g, u32 x, u32 y, u32 width, u32 height, u32 color)
+{
+    s32 slot;
+    Result rc = _framebuffer2dCheckSlot(g, &slot);
+    if (R_FAILED(rc))
+        return rc;
+    if (!_framebuffer2dRectFits(x, y, width, height, g->fb->win->width, g->fb->win->height))
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    u32* base = nvCmdRingReserve(&g->ring, NV2D_SURFACE_SETUP_WORDS + 9);
+    if (!base)
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+
+    u32* cmd = _framebuffer2dSetDestination(g, base, slot);
+    *cmd++ = NV2D_MTHD(NV2D_RENDER_SOLID_PRIM_MODE, 3);
+    *cmd++ = NV2D_SOLID_PRIM_MODE_RECTS;
+    *cmd++ = g->fb_format;
+    *cmd++ = color;
+    // The second corner (exclusive) launches the rectangle.
+    *cmd++ = NV2D_MTHD(NV2D_RENDER_SOLID_PRIM_POINT_SET_X(0), 4);
+    *cmd++ = x;
+    *cmd++ = y;
+    *cmd++ = x + width;
+    *cmd++ = y + height;
+    nvCmdRingCommit(&g->ring, cmd - base);
+    return 0;
+}
+
+Result framebuffer2dCopy(Framebuffer2D* g, u32 dst_x, u32 dst_y, u32 src_x, u32 src_y, u32 width, u32 height)
+{
+    s32 slot;
+    Result rc = _framebuffer2dCheckSlot(g, &slot);
+    if (R_FAILED(rc))
+        return rc;
+    if (!_framebuffer2dRectFits(dst_x, dst_y, width, height, g->fb->win->width, g->fb->win->height) ||
+        !_framebuffer2dRectFits(src_x, src_y, width, height, g->fb->win->width, g->fb->win->height))
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    u32* base = nvCmdRingReserve(&g->ring, 2*NV2D_SURFACE_SETUP_WORDS + 13);
+    if (!base)
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+
+    iova_t iova = g->fb_iova + (iova_t)slot * g->fb->fb_size;
+    u32* cmd = _framebuffer2dSetDestination(g, base, slot);
+    cmd = _framebuffer2dSetSource(g, cmd, iova, g->fb_format, NV2D_LAYOUT_BLOCKLINEAR, g->fb->stride, g->fb->width_aligned, g->fb->height_aligned);
+    cmd = _framebuffer2dPixelsFromMemory(cmd, dst_x, dst_y, src_x, src_y, width, height);
+    nvCmdRingCommit(&g->ring, cmd - base);
+    return 0;
+}
+
+Result framebuffer2dBlit(Framebuffer2D* g, u32 dst_x, u32 dst_y, const Framebuffer2DImage* src, u32 src_x, u32 src_y, u32 width, u32 height)
+{
+    s32 slot;
+    Result rc = _framebuffer2dCheckSlot(g, &slot);
+    if (R_FAILED(rc))
+        return rc;
+
+    u32 src_format = _framebuffer2dFormat(src->format);
+    if (!src_format || !src->iova || (src->pitch & 31))
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+    if (!_framebuffer2dRectFits(dst_x, dst_y, width, height, g->fb->win->width, g->fb->win->height) ||
+        !_framebuffer2dRectFits(src_x, src_y, width, height, src->width, src->height))
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    u32* base = nvCmdRingReserve(&g->ring, 2*NV2D_SURFACE_SETUP_WORDS + 13);
+    if (!base)
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+
+    u32* cmd = _framebuffer2dSetDestination(g, base, slot);
+    cmd = _framebuffer2dSetSource(g, cmd, src->iova, src_format, NV2D_LAYOUT_PITCH, src->pitch, src->width, src->height);
+    cmd = _framebuffer2dPixelsFromMemory(cmd, dst_x, dst_y, src_x, src_y, width, height);
+    nvCmdRingCommit(&g->ring, cmd - base);
+    return 0;
+}
+
+void framebuffer2dEnd(Framebuffer2D* g)
+{
+    s32 slot = g->fb->win->cur_slot;
+
+    Result rc = nvCmdRingSubmit(&g->ring);
+    if (R_FAILED(rc))
+        fatalThrow(rc);
+
+    NvFence fence;
+    NvMultiFence mf;
+    nvGpuChannelGetFence(g->channel, &fence);
+    nvMultiFenceCreate(&mf, &fence);
+
+    rc = nwindowQueueBuffer(g->fb->win, slot, &mf);
+    if (R_FAILED(rc))
+        fatalThrow(MAKERESULT(Module_Libnx, LibnxError_BadGfxQueueBuffer));
+}
@@ -1,10 +1,13 @@
+#include <stdlib.h>
 #include <string.h>
 #include "types.h"
 #include "result.h"
+#include "arm/counter.h"
 #include "services/vi.h"
 #include "display/binder.h"
 #include "display/buffer_producer.h"
 #include "display/native_window.h"
+#include "runtime/trace.h"
 #include "nvidia/graphic_buffer.h"
 
 #define NWINDOW_MAGIC 0x6E69574E // NWin
@@ -16,6 +19,34 @@ static void _nwindowUpdate(NWindow* nw, const BqBufferOutput* out)
     nw->consumer_running_behind = out->numPendingBuffers > 1;
 }
 
+#define NWINDOW_REFRESH_TICKS (19200000 / 60)
+
+static void _nwindowRecordFrame(NWindow* nw, const BqBufferOutput* out)
+{
+    NWindowFrameStats* st = nw->stats;
+    u64 now = armGetSystemTick();
+    u64 interval = st->last_queue_tick ? now - st->last_queue_tick : 0;
+
+    if (st->last_queue_tick) {
+        // Refreshes elapsed since the last queue, rounded to nearest, beyond the swap interval.
+        u64 refreshes = (interval + NWINDOW_REFRESH_TICKS/2) / NWINDOW_REFRESH_TICKS;
+        u32 swap_interval = nw->swap_interval ? nw->swap_interval : 1;
+        if (refreshes > swap_interval)
+            st->missed_vsyncs += refreshes - swap_interval;
+
+        u64 us = armTicksToNs(interval) / 1000;
+        st->frame_us[st->history_pos] = us < UINT32_MAX ? us : UINT32_MAX;
+        st->pending[st->history_pos] = out->numPendingBuffers < 0xFF ? out->numPendingBuffers : 0xFF;
+        st->history_pos = (st->history_pos + 1) % NWINDOW_FRAME_HISTORY;
+    }
+
+    if (out->numPendingBuffers > st->max_pending)
+        st->max_pending = out->numPendingBuffers;
+
+    st->last_queue_tick = now;
+    st->num_frames++;
+}
+
 static Result _nwindowConnect(NWindow* nw)
 {
     BqBufferOutput bqoutput;
@@ -89,6 +120,7 @@ void nwindowClose(NWindow* nw)
 
     eventClose(&nw->event);
     binderClose(&nw->bq);
+    free(nw->stats);
 
     memset(nw, 0, sizeof(*nw));
 }
@@ -154,6 +186,32 @@ Result nwindowSetSwapInterval(NWindow* nw, u32 swap_interval)
     return 0;
 }
 
+Result nwindowSetPresentMode(NWindow* nw, NWindowPresentMode mode)
+{
+    if (!nwindowIsValid(nw))
+        return MAKERESULT(Module_Libnx, LibnxError_NotInitialized);
+    if (mode != NWindowPresentMode_Fifo && mode != NWindowPresentMode_Mailbox)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    nw->present_mode = mode;
+    return 0;
+}
+
+Result nwindowGetMinUndequeuedBuffers(NWindow* nw, u32* out)
+{
+    if (!nwindowIsValid(nw))
+        return MAKERESULT(Module_Libnx, LibnxError_NotInitialized);
+
+    s32 value = 0;
+    mutexLock(&nw->mutex);
+    Result rc = bqQuery(&nw->bq, NATIVE_WINDOW_MIN_UNDEQUEUED_BUFFERS, &value);
+    mutexUnlock(&nw->mutex);
+
+    if (R_SUCCEEDED(rc))
+        *out = value;
+    return rc;
+}
+
 Result nwindowConfigureBuffer(NWindow* nw, s32 slot, NvGraphicBuffer* buf)
 {
     if (!nw || !buf || slot < 0 || slot >= 64)
@@ -202,7 +260,7 @@ Result nwindowConfigureBuffer(NWindow* nw, s32 slot, NvGraphicBuffer* buf)
     return rc;
 }
 
-Result nwindowDequeueBuffer(NWindow* nw, s32* out_slot, NvMultiFence* out_fence)
+static Result _nwindowDequeueBuffer(NWindow* nw, bool wait, s32* out_slot, NvMultiFence* out_fence)
 {
     if (!nw)
         return MAKERESULT(Module_Libnx, LibnxError_BadInput);
@@ -220,7 +278,11 @@ Result nwindowDequeueBuffer(NWindow* nw, s32* out_slot, NvMultiFence* out_fence)
     s32 slot;
     Result rc;
 
-    if (eventActive(&nw->event)) {
+    u64 wait_start = nw->stats ? armGetSystemTick() : 0;
+
+    if (eventActive(&nw->event) && !wait)
+        rc = bqDequeueBuffer(&nw->bq, true, nw->width, nw->height, nw->format, nw->usage, &slot, &fence);
+    else if (eventActive(&nw->event)) {
         do {
             eventWait(&nw->event, U64_MAX);
             rc = bqDequeueBuffer(&nw->bq, true, nw->width, nw->height, nw->format, nw->usage, &slot, &fence);
@@ -239,6 +301,13 @@ Result nwindowDequeueBuffer(NWindow* nw, s32* out_slot, NvMultiFence* out_fence)
         }
     }
 
+    if (R_SUCCEEDED(rc) && nw->stats) {
+        u64 wait_ticks = armGetSystemTick() - wait_start;
+        nw->stats->total_dequeue_wait += wait_ticks;
+        if (wait_ticks > nw->stats->max_dequeue_wait)
+            nw->stats->max_dequeue_wait = wait_ticks;
+    }
+
     if (R_SUCCEEDED(rc)) {
         nw->cur_slot = slot;
         if (out_slot)
@@ -253,6 +322,19 @@ Result nwindowDequeueBuffer(NWindow* nw, s32* out_slot, NvMultiFence* out_fence)
     return rc;
 }
 
+Result nwindowDequeueBuffer(NWindow* nw, s32* out_slot, NvMultiFence* out_fence)
+{
+    return _nwindowDequeueBuffer(nw, true, out_slot, out_fence);
+}
+
+Result nwindowTryDequeueBuffer(NWindow* nw, s32* out_slot, NvMultiFence* out_fence)
+{
+    if (!out_fence)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    return _nwindowDequeueBuffer(nw, false, out_slot, out_fence);
+}
+
 Result nwindowCancelBuffer(NWindow* nw, s32 slot, const NvMultiFence* fence)
 {
     if (!nw || slot < 0 || slot >= 64)
@@ -281,6 +363,8 @@ Result nwindowCancelBuffer(NWindow* nw, s32 slot, const NvMultiFence* fence)
 
 Result nwindowQueueBuffer(NWindow* nw, s32 slot, const NvMultiFence* fence)
 {
+    traceScope("nwindowQueueBuffer");
+
     if (!nw || slot < 0 || slot >= 64)
         return MAKERESULT(Module_Libnx, LibnxError_BadInput);
     if (!nwindowIsValid(nw))
@@ -299,6 +383,7 @@ Result nwindowQueueBuffer(NWindow* nw, s32 slot, const NvMultiFence* fence)
     bqinput.scalingMode = nw->scaling_mode;
     bqinput.transform = nw->transform;
     bqinput.stickyTransform = nw->sticky_transform;
+    bqinput.async = nw->present_mode == NWindowPresentMode_Mailbox;
     bqinput.swapInterval = nw->swap_interval;
     if (fence)
         bqinput.fence = *fence;
@@ -308,6 +393,8 @@ Result nwindowQueueBuffer(NWindow* nw, s32 slot, const NvMultiFence* fence)
     if (R_SUCCEEDED(rc)) {
         nw->cur_slot = -1;
         _nwindowUpdate(nw, &bqoutput);
+        if (nw->stats)
+            _nwindowRecordFrame(nw, &bqoutput);
     }
 
     mutexUnlock(&nw->mutex);
@@ -335,3 +422,74 @@ Result nwindowReleaseBuffers(NWindow* nw)
     mutexUnlock(&nw->mutex);
     return rc;
 }
+
+Result nwindowEnableFrameStats(NWindow* nw)
+{
+    if (!nwindowIsValid(nw))
+        return MAKERESULT(Module_Libnx, LibnxError_NotInitialized);
+
+    Result rc = 0;
+    mutexLock(&nw->mutex);
+
+    if (!nw->stats) {
+        nw->stats = (NWindowFrameStats*)calloc(1, sizeof(NWindowFrameStats));
+        if (!nw->stats)
+            rc = MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+    }
+
+    mutexUnlock(&nw->mutex);
+    return rc;
+}
+
+Result nwindowGetFrameStats(NWindow* nw, NWindowFrameStats* out)
+{
+    if (!nwindowIsValid(nw))
+        return MAKERESULT(Module_Libnx, LibnxError_NotInitialized);
+
+    Result rc = 0;
+    mutexLock(&nw->mutex);
+
+    if (nw->stats)
+        *out = *nw->stats;
+    else
+        rc = MAKERESULT(Module_Libnx, LibnxError_NotInitialized);
+
+    mutexUnlock(&nw->mutex);
+    return rc;
+}
+
+void nwindowResetFrameStats(NWindow* nw)
+{
+    if (!nwindowIsValid(nw))
+        return;
+
+    mutexLock(&nw->mutex);
+    if (nw->stats)
+        memset(nw->stats, 0, sizeof(NWindowFrameStats));
+    mutexUnlock(&nw->mutex);
+}
+
+u32 nwindowGetFrameTimeHistogram(NWindow* nw, u32* buckets, u32 num_buckets, u32 bucket_us)
+{
+    if (!nwindowIsValid(nw) || !num_buckets || !bucket_us)
+        return 0;
+
+    memset(buckets, 0, num_buckets * sizeof(u32));
+    u32 count = 0;
+
+    mutexLock(&nw->mutex);
+    if (nw->stats) {
+        for (u32 i = 0; i < NWINDOW_FRAME_HISTORY; i ++) {
+            u32 us = nw->stats->frame_us[i];
+            if (!us)
+                continue;
+
+            u32 bucket = us / bucket_us;
+            buckets[bucket < num_buckets ? bucket : num_buckets - 1]++;
+            count++;
+        }
+    }
+    mutexUnlock(&nw->mutex);
+
+    return count;
+}
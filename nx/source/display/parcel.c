@@ -6,19 +6,21 @@
 
 void parcelCreate(Parcel *ctx)
 {
-    memset(ctx, 0, sizeof(Parcel));
+    // The payload is only read up to payload_size, no need to clear it.
+    ctx->payload_size = 0;
+    ctx->objects = NULL;
+    ctx->objects_size = 0;
     ctx->capacity = sizeof(ctx->payload);
+    ctx->pos = 0;
 }
 
 Result parcelTransact(Binder *session, u32 code, Parcel *in_parcel, Parcel *out_parcel)
 {
     Result rc;
+    // Both buffers are only used up to the sizes in their header, which are validated.
     char in[PARCEL_MAX_PAYLOAD];
     char out[PARCEL_MAX_PAYLOAD];
 
-    memset(in,  0, sizeof(in));
-    memset(out, 0, sizeof(out));
-
     if (in_parcel->payload_size > sizeof(in))
         return MAKERESULT(Module_Libnx, LibnxError_BadInput);
     if (in_parcel->objects_size > sizeof(in))
@@ -78,18 +80,21 @@ void* parcelWriteData(Parcel *ctx, const void* data, size_t data_size)
 {
     void* ptr = &ctx->payload[ctx->payload_size];
 
+    size_t aligned_data_size;
+
     if (data_size & BIT(31))
         return NULL;
 
-    data_size = (data_size+3) & ~3;
+    aligned_data_size = (data_size+3) & ~3;
 
-    if (ctx->payload_size + data_size >= ctx->capacity)
+    if (ctx->payload_size + aligned_data_size >= ctx->capacity)
         return NULL;
 
     if (data)
         memcpy(ptr, data, data_size);
+    memset((u8*)ptr + data_size, 0, aligned_data_size - data_size);
 
-    ctx->payload_size += data_size;
+    ctx->payload_size += aligned_data_size;
     return ptr;
 }
 
@@ -1,22 +1,43 @@
 #include "kernel/barrier.h"
+#include "kernel/futex.h"
+#include "runtime/hosversion.h"
 
 void barrierInit(Barrier *b, u64 total) {
     b->count = 0;
     b->total = total - 1;
+    b->generation = 0;
     mutexInit(&b->mutex);
     condvarInit(&b->condvar);
 }
 
 void barrierWait(Barrier *b) {
-    mutexLock(&b->mutex);
+    if (hosversionBefore(4,0,0)) {
+        mutexLock(&b->mutex);
 
-    if (b->count++ == b->total) {
-        b->count = 0;
-        condvarWake(&b->condvar, b->total);
+        if (b->count++ == b->total) {
+            b->count = 0;
+            condvarWake(&b->condvar, b->total);
+        }
+        else {
+            condvarWait(&b->condvar, &b->mutex);
+        }
+
+        mutexUnlock(&b->mutex);
+        return;
+    }
+
+    // The generation can't change before this thread arrives, so it's safe to read it first
+    u32 generation = __atomic_load_n(&b->generation, __ATOMIC_ACQUIRE);
+
+    if (__atomic_fetch_add(&b->count, 1, __ATOMIC_ACQ_REL) == b->total) {
+        // Last thread: reset for the next round, then release the others
+        __atomic_store_n(&b->count, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&b->generation, generation + 1, __ATOMIC_RELEASE);
+        if (b->total)
+            futexWake(&b->generation, -1);
     }
     else {
-        condvarWait(&b->condvar, &b->mutex);
+        while (__atomic_load_n(&b->generation, __ATOMIC_ACQUIRE) == generation)
+            futexWait(&b->generation, generation, UINT64_MAX);
     }
-
-    mutexUnlock(&b->mutex);
 }
@@ -0,0 +1,177 @@
+#include <malloc.h>
+#include <stddef.h>
+#include <string.h>
+#include "types.h"
+#include "result.h"
+#include "kernel/mutex.h"
+#include "kernel/fiber.h"
+#include "../internal.h"
+
+extern const u8 __tdata_lma[];
+extern const u8 __tdata_lma_end[];
+extern u8 __tls_start[];
+extern u8 __tls_end[];
+
+// Offsets used by fiber_switch.s
+_Static_assert(offsetof(FiberContext, sp) == 0x60, "FiberContext layout");
+_Static_assert(offsetof(FiberContext, d) == 0x80, "FiberContext layout");
+
+void __libnx_fiber_switch(FiberContext* from, const FiberContext* to);
+void __libnx_fiber_start(void);
+
+// Memory of closed fibers, reused by fiberCreate
+typedef struct FiberPoolEntry FiberPoolEntry;
+
+struct FiberPoolEntry {
+    FiberPoolEntry* next;
+    size_t size;
+};
+
+static Mutex g_fiberPoolMutex;
+static FiberPoolEntry* g_fiberPool;
+static size_t g_fiberPoolBytes;
+
+/// Maximum total size of the memory of closed fibers kept for reuse, 0 to disable.
+__attribute__((weak)) size_t __nx_fiber_pool_size = 0x100000;
+
+// Each fiber has its own thread-local segment, so this always points to the fiber which runs.
+static __thread Fiber* g_fiberCurrent;
+
+static void* _fiberPoolTake(size_t size) {
+    void* mem = NULL;
+
+    mutexLock(&g_fiberPoolMutex);
+    for (FiberPoolEntry** pp = &g_fiberPool; *pp; pp = &(*pp)->next) {
+        if ((*pp)->size == size) {
+            mem = *pp;
+            *pp = (*pp)->next;
+            g_fiberPoolBytes -= size;
+            break;
+        }
+    }
+    mutexUnlock(&g_fiberPoolMutex);
+
+    return mem;
+}
+
+static bool _fiberPoolPut(void* mem, size_t size) {
+    bool stored = false;
+
+    mutexLock(&g_fiberPoolMutex);
+    if (g_fiberPoolBytes + size <= __nx_fiber_pool_size) {
+        FiberPoolEntry* entry = (FiberPoolEntry*)mem;
+        entry->next = g_fiberPool;
+        entry->size = size;
+        g_fiberPool = entry;
+        g_fiberPoolBytes += size;
+        stored = true;
+    }
+    mutexUnlock(&g_fiberPoolMutex);
+
+    return stored;
+}
+
+static void NORETURN _fiberEntry(Fiber* f) {
+    g_fiberCurrent = f;
+    f->entry(f->arg);
+
+    // Finished fibers are never switched back to.
+    f->finished = true;
+    __libnx_fiber_switch(&f->ctx, &f->caller);
+    __builtin_unreachable();
+}
+
+Result fiberCreate(Fiber* f, FiberFunc entry, void* arg, size_t stack_sz) {
+    const size_t tls_sz = (__tls_end-__tls_start+0xF) &~ 0xF;
+    const size_t reent_sz = (sizeof(struct _reent)+0xF) &~ 0xF;
+
+    if (!stack_sz)
+        stack_sz = FIBER_DEFAULT_STACK_SIZE;
+    stack_sz = (stack_sz + 0xF) & ~0xF;
+
+    // Stack then reent then tls, like threads.
+    const size_t mem_sz = stack_sz + reent_sz + tls_sz;
+    void* mem = _fiberPoolTake(mem_sz);
+    if (!mem)
+        mem = memalign(0x10, mem_sz);
+    if (!mem)
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+
+    struct _reent* reent = (struct _reent*)((u8*)mem + stack_sz);
+    u8* tls = (u8*)reent + reent_sz;
+
+    // Set up the fiber's reent struct, inheriting standard file handles
+    _REENT_INIT_PTR(reent);
+    struct _reent* cur = getThreadVars()->reent;
+    reent->_stdin  = cur->_stdin;
+    reent->_stdout = cur->_stdout;
+    reent->_stderr = cur->_stderr;
+
+    // Set up the fiber's TLS segment
+    size_t tls_load_sz = __tdata_lma_end - __tdata_lma;
+    size_t tls_bss_sz = tls_sz - tls_load_sz;
+    if (tls_load_sz)
+        memcpy(tls, __tdata_lma, tls_load_sz);
+    if (tls_bss_sz)
+        memset(tls+tls_load_sz, 0, tls_bss_sz);
+
+    memset(f, 0, sizeof(*f));
+    f->entry = entry;
+    f->arg = arg;
+    f->mem = mem;
+    f->mem_sz = mem_sz;
+
+    // The first switch "returns" to __libnx_fiber_start, which calls _fiberEntry(f).
+    f->ctx.x[0]  = (u64)f;
+    f->ctx.x[1]  = (u64)&_fiberEntry;
+    f->ctx.x[11] = (u64)&__libnx_fiber_start;
+    f->ctx.sp = (u64)mem + stack_sz;
+    f->ctx.reent = reent;
+    f->ctx.tls_tp = tls-2*sizeof(void*); // subtract size of Thread Control Block (TCB)
+
+    return 0;
+}
+
+void fiberClose(Fiber* f) {
+    if (!f->mem || f->running)
+        return;
+
+    if (!_fiberPoolPut(f->mem, f->mem_sz))
+        free(f->mem);
+    f->mem = NULL;
+}
+
+void fiberResume(Fiber* f) {
+    if (f->running || f->finished)
+        return;
+
+    f->running = true;
+    __libnx_fiber_switch(&f->caller, &f->ctx);
+
+    // The fiber's context is saved now, so it can be resumed again (possibly from another thread).
+    __atomic_store_n(&f->running, false, __ATOMIC_RELEASE);
+}
+
+void fiberYield(void) {
+    Fiber* f = g_fiberCurrent;
+    if (f)
+        __libnx_fiber_switch(&f->ctx, &f->caller);
+}
+
+Fiber* fiberGetCurrent(void) {
+    return g_fiberCurrent;
+}
+
+void fiberPoolFlush(void) {
+    mutexLock(&g_fiberPoolMutex);
+    FiberPoolEntry* entry = g_fiberPool;
+    g_fiberPool = NULL;
+    g_fiberPoolBytes = 0;
+    mutexUnlock(&g_fiberPoolMutex);
+
+    while (entry) {
+        FiberPoolEntry* next = entry->next;
+        free(entry);
+        entry = next;
+    }
+}
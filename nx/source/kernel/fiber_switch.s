@@ -0,0 +1,54 @@
+.macro CODE_BEGIN name
+	.section .text.\name, "ax", %progbits
+	.global \name
+	.type \name, %function
+	.align 2
+	.cfi_startproc
+\name:
+.endm
+
+.macro CODE_END
+	.cfi_endproc
+.endm
+
+// void __libnx_fiber_switch(FiberContext* from, const FiberContext* to)
+// Only callee-saved registers need saving, plus the reent and tls_tp fields of the thread vars (TLS+0x1F0).
+CODE_BEGIN __libnx_fiber_switch
+	stp x19, x20, [x0, #0x00]
+	stp x21, x22, [x0, #0x10]
+	stp x23, x24, [x0, #0x20]
+	stp x25, x26, [x0, #0x30]
+	stp x27, x28, [x0, #0x40]
+	stp x29, x30, [x0, #0x50]
+	mov x9, sp
+	str x9, [x0, #0x60]
+	mrs x10, tpidrro_el0
+	ldp x11, x12, [x10, #0x1F0]
+	stp x11, x12, [x0, #0x68]
+	stp d8,  d9,  [x0, #0x80]
+	stp d10, d11, [x0, #0x90]
+	stp d12, d13, [x0, #0xA0]
+	stp d14, d15, [x0, #0xB0]
+
+	ldp x19, x20, [x1, #0x00]
+	ldp x21, x22, [x1, #0x10]
+	ldp x23, x24, [x1, #0x20]
+	ldp x25, x26, [x1, #0x30]
+	ldp x27, x28, [x1, #0x40]
+	ldp x29, x30, [x1, #0x50]
+	ldr x9, [x1, #0x60]
+	mov sp, x9
+	ldp x11, x12, [x1, #0x68]
+	stp x11, x12, [x10, #0x1F0]
+	ldp d8,  d9,  [x1, #0x80]
+	ldp d10, d11, [x1, #0x90]
+	ldp d12, d13, [x1, #0xA0]
+	ldp d14, d15, [x1, #0xB0]
+	ret
+CODE_END
+
+// Initial return address of a fiber: x19 holds the Fiber, x20 the C entrypoint, which never returns.
+CODE_BEGIN __libnx_fiber_start
+	mov x0, x19
+	br  x20
+CODE_END
@@ -0,0 +1,13 @@
+#include "types.h"
+#include "kernel/svc.h"
+#include "kernel/futex.h"
+
+Result futexWait(u32* addr, u32 expected, u64 timeout) {
+    // svcWaitForAddress treats negative timeouts as infinite
+    s64 ns = timeout > INT64_MAX ? -1 : (s64)timeout;
+    return svcWaitForAddress(addr, ArbitrationType_WaitIfEqual, (s32)expected, ns);
+}
+
+Result futexWake(u32* addr, s32 count) {
+    return svcSignalToAddress(addr, SignalType_Signal, 0, count);
+}
@@ -0,0 +1,274 @@
+#include <stdlib.h>
+#include <string.h>
+#include "types.h"
+#include "result.h"
+#include "runtime/env.h"
+#include "arm/cache.h"
+#include "kernel/svc.h"
+#include "kernel/jit_cache.h"
+
+#define PAGE_SIZE 0x1000
+#define CODE_ALIGN 0x10
+
+static inline bool _jitCacheIsExec(JitCacheRegion* r, u32 page) {
+    return r->exec_pages[page / 64] & (UINT64_C(1) << (page % 64));
+}
+
+static inline void _jitCacheSetExec(JitCacheRegion* r, u32 page, bool exec) {
+    if (exec)
+        r->exec_pages[page / 64] |= UINT64_C(1) << (page % 64);
+    else
+        r->exec_pages[page / 64] &= ~(UINT64_C(1) << (page % 64));
+}
+
+// Unmaps the code alias of the pages touching [start, end), so that they can be written to.
+static Result _jitCacheMakeWritable(JitCacheRegion* r, u32 start, u32 end) {
+    if (r->jit.type != JitType_CodeMemory)
+        return 0;
+
+    u32 first = start / PAGE_SIZE, last = (end + PAGE_SIZE - 1) / PAGE_SIZE;
+    for (u32 p = first; p < last;) {
+        if (!_jitCacheIsExec(r, p)) {
+            p++;
+            continue;
+        }
+
+        u32 run_end = p;
+        while (run_end < last && _jitCacheIsExec(r, run_end))
+            run_end++;
+
+        u64 off = (u64)p * PAGE_SIZE, len = (u64)(run_end - p) * PAGE_SIZE;
+        Result rc = svcUnmapProcessCodeMemory(envGetOwnProcessHandle(), (u64)r->jit.rx_addr + off, (u64)r->jit.src_addr + off, len);
+        if (R_FAILED(rc))
+            return rc;
+
+        for (; p < run_end; p++)
+            _jitCacheSetExec(r, p, false);
+    }
+
+    return 0;
+}
+
+// Maps the code alias of the pages touching [start, end) which aren't already.
+static Result _jitCacheMakeExecutable(JitCacheRegion* r, u32 start, u32 end) {
+    u32 first = start / PAGE_SIZE, last = (end + PAGE_SIZE - 1) / PAGE_SIZE;
+    for (u32 p = first; p < last;) {
+        if (_jitCacheIsExec(r, p)) {
+            p++;
+            continue;
+        }
+
+        u32 run_end = p;
+        while (run_end < last && !_jitCacheIsExec(r, run_end))
+            run_end++;
+
+        u64 off = (u64)p * PAGE_SIZE, len = (u64)(run_end - p) * PAGE_SIZE;
+        Handle proc = envGetOwnProcessHandle();
+        Result rc = svcMapProcessCodeMemory(proc, (u64)r->jit.rx_addr + off, (u64)r->jit.src_addr + off, len);
+        if (R_SUCCEEDED(rc)) {
+            rc = svcSetProcessMemoryPermission(proc, (u64)r->jit.rx_addr + off, len, Perm_Rx);
+            if (R_FAILED(rc))
+                svcUnmapProcessCodeMemory(proc, (u64)r->jit.rx_addr + off, (u64)r->jit.src_addr + off, len);
+        }
+        if (R_FAILED(rc))
+            return rc;
+
+        for (; p < run_end; p++)
+            _jitCacheSetExec(r, p, true);
+    }
+
+    return 0;
+}
+
+static void _jitCacheAddDirty(JitCacheRegion* r, u32 start, u32 end) {
+    // Insert sorted by start.
+    u32 pos = 0;
+    while (pos < r->num_dirty && r->dirty[pos].start < start)
+        pos++;
+
+    if (r->num_dirty == JIT_CACHE_MAX_DIRTY_RANGES) {
+        // Full: widen the closest range instead.
+        u32 best = pos < r->num_dirty ? pos : pos - 1;
+        if (pos > 0 && pos < r->num_dirty && start - r->dirty[pos-1].end < r->dirty[pos].start - end)
+            best = pos - 1;
+        if (r->dirty[best].start > start)
+            r->dirty[best].start = start;
+        if (r->dirty[best].end < end)
+            r->dirty[best].end = end;
+        pos = best;
+    }
+    else {
+        memmove(&r->dirty[pos+1], &r->dirty[pos], (r->num_dirty - pos) * sizeof(JitCacheRange));
+        r->dirty[pos].start = start;
+        r->dirty[pos].end = end;
+        r->num_dirty++;
+    }
+
+    // Coalesce the ranges overlapping or touching the updated one.
+    u32 i = pos > 0 ? pos - 1 : 0;
+    while (i + 1 < r->num_dirty) {
+        if (r->dirty[i].end >= r->dirty[i+1].start) {
+            if (r->dirty[i].end < r->dirty[i+1].end)
+                r->dirty[i].end = r->dirty[i+1].end;
+            memmove(&r->dirty[i+1], &r->dirty[i+2], (r->num_dirty - i - 2) * sizeof(JitCacheRange));
+            r->num_dirty--;
+        }
+        else if (i > pos)
+            break;
+        else
+            i++;
+    }
+}
+
+static Result _jitCacheTouch(JitCacheRegion* r, u32 start, u32 end) {
+    Result rc = _jitCacheMakeWritable(r, start, end);
+    if (R_SUCCEEDED(rc))
+        _jitCacheAddDirty(r, start, end);
+    return rc;
+}
+
+static JitCacheRegion* _jitCacheFindRegion(JitCache* c, const void* rw) {
+    for (u32 i = 0; i < c->num_regions; i++) {
+        JitCacheRegion* r = &c->regions[i];
+        u8* base = (u8*)r->jit.rw_addr;
+        if ((const u8*)rw >= base && (const u8*)rw < base + c->region_size)
+            return r;
+    }
+    return NULL;
+}
+
+static Result _jitCacheAddRegion(JitCache* c) {
+    if (c->num_regions >= c->max_regions)
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+
+    JitCacheRegion* r = &c->regions[c->num_regions];
+    memset(r, 0, sizeof(*r));
+
+    Result rc = jitCreate(&r->jit, c->region_size);
+    if (R_FAILED(rc))
+        return rc;
+
+    if (r->jit.type == JitType_CodeMemory) {
+        u32 num_pages = c->region_size / PAGE_SIZE;
+        r->exec_pages = (u64*)calloc((num_pages + 63) / 64, sizeof(u64));
+        if (!r->exec_pages) {
+            jitClose(&r->jit);
+            return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+        }
+    }
+
+    c->num_regions++;
+    return 0;
+}
+
+Result jitCacheCreate(JitCache* c, size_t region_size, u32 max_regions) {
+    region_size = (region_size + PAGE_SIZE - 1) &~ (PAGE_SIZE - 1);
+    if (!region_size || region_size > UINT32_MAX || !max_regions || max_regions > JIT_CACHE_MAX_REGIONS)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    memset(c, 0, sizeof(*c));
+    c->region_size = region_size;
+    c->max_regions = max_regions;
+
+    // Create the first buffer upfront, so JIT being unavailable is reported here.
+    return _jitCacheAddRegion(c);
+}
+
+Result jitCacheClose(JitCache* c) {
+    Result rc = 0;
+
+    while (c->num_regions) {
+        JitCacheRegion* r = &c->regions[c->num_regions - 1];
+
+        if (r->exec_pages) {
+            rc = _jitCacheMakeWritable(r, 0, c->region_size);
+            if (R_FAILED(rc))
+                break;
+        }
+
+        rc = jitClose(&r->jit);
+        if (R_FAILED(rc))
+            break;
+
+        free(r->exec_pages);
+        r->exec_pages = NULL;
+        c->num_regions--;
+    }
+
+    return rc;
+}
+
+Result jitCacheAlloc(JitCache* c, size_t size, void** out_rw, void** out_rx) {
+    size = (size + CODE_ALIGN - 1) &~ (CODE_ALIGN - 1);
+    if (!size || size > c->region_size)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    // Move on to the next buffer once the current one is full, creating it if needed.
+    while (c->regions[c->cur_region].used + size > c->region_size) {
+        if (c->cur_region + 1 == c->num_regions) {
+            Result rc = _jitCacheAddRegion(c);
+            if (R_FAILED(rc))
+                return rc;
+        }
+        c->cur_region++;
+    }
+
+    JitCacheRegion* r = &c->regions[c->cur_region];
+    u32 start = r->used;
+
+    Result rc = _jitCacheTouch(r, start, start + size);
+    if (R_FAILED(rc))
+        return rc;
+
+    r->used += size;
+    *out_rw = (u8*)r->jit.rw_addr + start;
+    *out_rx = (u8*)r->jit.rx_addr + start;
+    return 0;
+}
+
+Result jitCacheMarkDirty(JitCache* c, void* rw, size_t size) {
+    JitCacheRegion* r = _jitCacheFindRegion(c, rw);
+    if (!r)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    u32 start = (u8*)rw - (u8*)r->jit.rw_addr;
+    if (size > c->region_size - start)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    return _jitCacheTouch(r, start, start + size);
+}
+
+Result jitCacheFlush(JitCache* c) {
+    for (u32 i = 0; i < c->num_regions; i++) {
+        JitCacheRegion* r = &c->regions[i];
+
+        while (r->num_dirty) {
+            JitCacheRange* d = &r->dirty[r->num_dirty - 1];
+
+            if (r->jit.type == JitType_CodeMemory) {
+                Result rc = _jitCacheMakeExecutable(r, d->start, d->end);
+                if (R_FAILED(rc))
+                    return rc;
+            }
+            else {
+                armDCacheFlush((u8*)r->jit.rw_addr + d->start, d->end - d->start);
+                armICacheInvalidate((u8*)r->jit.rx_addr + d->start, d->end - d->start);
+            }
+
+            r->num_dirty--;
+        }
+    }
+
+    return 0;
+}
+
+void jitCacheReset(JitCache* c) {
+    for (u32 i = 0; i < c->num_regions; i++)
+        c->regions[i].used = 0;
+    c->cur_region = 0;
+}
+
+void* jitCacheGetRxAddr(JitCache* c, void* rw) {
+    JitCacheRegion* r = _jitCacheFindRegion(c, rw);
+    return r ? (u8*)r->jit.rx_addr + ((u8*)rw - (u8*)r->jit.rw_addr) : NULL;
+}
@@ -0,0 +1,20 @@
+#include "kernel/latch.h"
+#include "kernel/futex.h"
+#include "kernel/svc.h"
+#include "runtime/hosversion.h"
+
+void latchCountDown(Latch *l, u32 n) {
+    if (__atomic_sub_fetch(&l->count, n, __ATOMIC_ACQ_REL) == 0 && !hosversionBefore(4,0,0))
+        futexWake(&l->count, -1);
+}
+
+void latchWait(Latch *l) {
+    u32 count;
+    while ((count = __atomic_load_n(&l->count, __ATOMIC_ACQUIRE)) != 0) {
+        // The count only wakes waiters when it reaches zero, so wait on its current value.
+        if (hosversionBefore(4,0,0))
+            svcSleepThread(100000);
+        else
+            futexWait(&l->count, count, UINT64_MAX);
+    }
+}
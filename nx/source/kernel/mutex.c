@@ -9,38 +9,45 @@ static u32 _GetTag(void) {
     return getThreadVars()->handle;
 }
 
-void mutexLock(Mutex* m) {
-    u32 self = _GetTag();
+// Returns the number of waits in the kernel.
+static u32 _mutexLockSlow(u32* m, u32 self) {
+    u32 waits = 0;
 
     while (1) {
-        u32 cur = __sync_val_compare_and_swap((u32*)m, 0, self);
+        u32 cur = __sync_val_compare_and_swap(m, 0, self);
 
         if (cur == 0) {
             // We won the race!
-            return;
+            return waits;
         }
 
         if ((cur &~ HAS_LISTENERS) == self) {
             // Kernel assigned it to us!
-            return;
+            return waits;
         }
 
         if (cur & HAS_LISTENERS) {
             // The flag is already set, we can use the syscall.
-            svcArbitrateLock(cur &~ HAS_LISTENERS, (u32*)m, self);
+            svcArbitrateLock(cur &~ HAS_LISTENERS, m, self);
+            waits++;
         }
         else {
             // The flag is not set, we need to set it.
-            u32 old = __sync_val_compare_and_swap((u32*)m, cur, cur | HAS_LISTENERS);
+            u32 old = __sync_val_compare_and_swap(m, cur, cur | HAS_LISTENERS);
 
             if (old == cur) {
                 // Flag was set successfully.
-                svcArbitrateLock(cur, (u32*)m, self);
+                svcArbitrateLock(cur, m, self);
+                waits++;
             }
         }
     }
 }
 
+void mutexLock(Mutex* m) {
+    _mutexLockSlow((u32*)m, _GetTag());
+}
+
 bool mutexTryLock(Mutex* m) {
     u32 self = _GetTag();
     u32 cur = __sync_val_compare_and_swap((u32*)m, 0, self);
@@ -93,3 +100,70 @@ void rmutexUnlock(RMutex* m) {
         mutexUnlock(&m->lock);
     }
 }
+
+void adaptiveMutexLock(AdaptiveMutex* m) {
+    u32* lock = (u32*)&m->lock;
+    u32 self = _GetTag();
+    u32 cur = __sync_val_compare_and_swap(lock, 0, self);
+
+    if (cur == 0) {
+        m->stats.acquisitions++;
+        return;
+    }
+
+    // Spin while the owner is running and nobody waits in the kernel yet.
+    // The estimate is only written while the mutex is held, a stale read just changes the bound.
+    u32 estimate = __atomic_load_n(&m->spin_estimate, __ATOMIC_RELAXED);
+    u32 limit = 2 * estimate + 10;
+    if (limit > m->max_spin)
+        limit = m->max_spin;
+
+    u32 spins = 0;
+    bool acquired = false;
+    while (spins < limit && !(cur & HAS_LISTENERS)) {
+        spins++;
+        __asm__ __volatile__("yield" ::: "memory");
+
+        cur = __atomic_load_n(lock, __ATOMIC_RELAXED);
+        if (cur == 0) {
+            cur = __sync_val_compare_and_swap(lock, 0, self);
+            if (cur == 0) {
+                acquired = true;
+                break;
+            }
+        }
+    }
+
+    u32 waits = acquired ? 0 : _mutexLockSlow(lock, self);
+
+    m->stats.acquisitions++;
+    m->stats.contended++;
+    m->stats.kernel_waits += waits;
+    if (acquired)
+        m->stats.spin_acquired++;
+
+    if (limit)
+        __atomic_store_n(&m->spin_estimate, estimate + ((s32)spins - (s32)estimate) / 8, __ATOMIC_RELAXED);
+}
+
+bool adaptiveMutexTryLock(AdaptiveMutex* m) {
+    if (!mutexTryLock(&m->lock))
+        return false;
+
+    m->stats.acquisitions++;
+    return true;
+}
+
+void adaptiveMutexUnlock(AdaptiveMutex* m) {
+    mutexUnlock(&m->lock);
+}
+
+void adaptiveMutexGetStats(AdaptiveMutex* m, AdaptiveMutexStats* out, bool reset) {
+    // The stats are only updated with the mutex held, so holding it gives a consistent snapshot.
+    // The plain lock is used, so that sampling doesn't count as an acquisition or move the spin estimate.
+    mutexLock(&m->lock);
+    *out = m->stats;
+    if (reset)
+        m->stats = (AdaptiveMutexStats){0};
+    mutexUnlock(&m->lock);
+}
@@ -0,0 +1,224 @@
+#include <malloc.h>
+#include <string.h>
+#include "result.h"
+#include "arm/counter.h"
+#include "kernel/wait.h"
+#include "kernel/queue.h"
+
+// Queue operation which doesn't wait. On success, transition is set if the queue was empty (push) or full (pop)
+// before the operation, and more is set if it can still be pushed to (push) or popped from (pop).
+typedef bool (*QueueOp)(void* q, void* elem, bool* transition, bool* more);
+
+// Every operation ends with a full barrier between publishing its own index and reading the other side's one,
+// so that either the waiting side sees the new element/space, or the other side sees the transition.
+
+static bool _spscQueuePush(void* p, void* elem, bool* transition, bool* more) {
+    SpscQueue* q = (SpscQueue*)p;
+    u32 tail = q->tail;
+
+    if (tail - __atomic_load_n(&q->head, __ATOMIC_ACQUIRE) > q->mask)
+        return false;
+
+    memcpy(q->buffer + (tail & q->mask) * q->elem_size, elem, q->elem_size);
+    __atomic_store_n(&q->tail, tail + 1, __ATOMIC_RELEASE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    u32 head = __atomic_load_n(&q->head, __ATOMIC_ACQUIRE);
+    *transition = head == tail;
+    *more = tail + 1 - head <= q->mask;
+    return true;
+}
+
+static bool _spscQueuePop(void* p, void* out, bool* transition, bool* more) {
+    SpscQueue* q = (SpscQueue*)p;
+    u32 head = q->head;
+
+    if (__atomic_load_n(&q->tail, __ATOMIC_ACQUIRE) == head)
+        return false;
+
+    memcpy(out, q->buffer + (head & q->mask) * q->elem_size, q->elem_size);
+    __atomic_store_n(&q->head, head + 1, __ATOMIC_RELEASE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    u32 tail = __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE);
+    *transition = tail - head > q->mask;
+    *more = tail != head + 1;
+    return true;
+}
+
+static bool _mpmcQueuePush(void* p, void* elem, bool* transition, bool* more) {
+    MpmcQueue* q = (MpmcQueue*)p;
+    u32 pos = __atomic_load_n(&q->enqueue_pos, __ATOMIC_RELAXED);
+    u32* seq;
+
+    while (1) {
+        seq = (u32*)(q->cells + (pos & q->mask) * q->cell_size);
+        s32 diff = (s32)(__atomic_load_n(seq, __ATOMIC_ACQUIRE) - pos);
+
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&q->enqueue_pos, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;
+        }
+        else if (diff < 0)
+            return false; // Full
+        else
+            pos = __atomic_load_n(&q->enqueue_pos, __ATOMIC_RELAXED);
+    }
+
+    memcpy(seq + 1, elem, q->elem_size);
+    __atomic_store_n(seq, pos + 1, __ATOMIC_RELEASE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    u32 dequeue_pos = __atomic_load_n(&q->dequeue_pos, __ATOMIC_RELAXED);
+    *transition = dequeue_pos == pos;
+    *more = __atomic_load_n(&q->enqueue_pos, __ATOMIC_RELAXED) - dequeue_pos <= q->mask;
+    return true;
+}
+
+static bool _mpmcQueuePop(void* p, void* out, bool* transition, bool* more) {
+    MpmcQueue* q = (MpmcQueue*)p;
+    u32 pos = __atomic_load_n(&q->dequeue_pos, __ATOMIC_RELAXED);
+    u32* seq;
+
+    while (1) {
+        seq = (u32*)(q->cells + (pos & q->mask) * q->cell_size);
+        s32 diff = (s32)(__atomic_load_n(seq, __ATOMIC_ACQUIRE) - (pos + 1));
+
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&q->dequeue_pos, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;
+        }
+        else if (diff < 0)
+            return false; // Empty
+        else
+            pos = __atomic_load_n(&q->dequeue_pos, __ATOMIC_RELAXED);
+    }
+
+    memcpy(out, seq + 1, q->elem_size);
+    __atomic_store_n(seq, pos + q->mask + 1, __ATOMIC_RELEASE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    u32 enqueue_pos = __atomic_load_n(&q->enqueue_pos, __ATOMIC_RELAXED);
+    *transition = enqueue_pos - pos > q->mask;
+    *more = enqueue_pos != __atomic_load_n(&q->dequeue_pos, __ATOMIC_RELAXED);
+    return true;
+}
+
+static bool _queueTryOp(QueueOp op, void* q, void* elem, UEvent* signal_event) {
+    bool transition, more;
+    if (!op(q, elem, &transition, &more))
+        return false;
+
+    if (transition)
+        ueventSignal(signal_event);
+    return true;
+}
+
+static Result _queueBlockingOp(QueueOp op, void* q, void* elem, UEvent* wait_event, UEvent* signal_event, u64 timeout) {
+    u64 start = armGetSystemTick();
+    bool waited = false;
+
+    while (1) {
+        bool transition, more;
+        if (op(q, elem, &transition, &more)) {
+            if (transition)
+                ueventSignal(signal_event);
+            // The event only wakes one waiter per transition, pass it on while there's more to do
+            if (waited && more)
+                ueventSignal(wait_event);
+            return 0;
+        }
+
+        u64 remaining = UINT64_MAX;
+        if (timeout != UINT64_MAX) {
+            u64 elapsed = armTicksToNs(armGetSystemTick() - start);
+            if (elapsed >= timeout)
+                return KERNELRESULT(TimedOut);
+            remaining = timeout - elapsed;
+        }
+
+        Result rc = waitSingle(waiterForUEvent(wait_event), remaining);
+        if (R_FAILED(rc))
+            return rc;
+
+        waited = true;
+    }
+}
+
+Result spscQueueCreate(SpscQueue* q, u32 capacity, u32 elem_size) {
+    if (!capacity || (capacity & (capacity - 1)) || !elem_size)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    memset(q, 0, sizeof(*q));
+    q->buffer = (u8*)malloc((size_t)capacity * elem_size);
+    if (!q->buffer)
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+
+    q->elem_size = elem_size;
+    q->mask = capacity - 1;
+    ueventCreate(&q->not_empty, true);
+    ueventCreate(&q->not_full, true);
+    return 0;
+}
+
+void spscQueueClose(SpscQueue* q) {
+    free(q->buffer);
+    q->buffer = NULL;
+}
+
+bool spscQueueTryPush(SpscQueue* q, const void* elem) {
+    return _queueTryOp(_spscQueuePush, q, (void*)elem, &q->not_empty);
+}
+
+bool spscQueueTryPop(SpscQueue* q, void* out) {
+    return _queueTryOp(_spscQueuePop, q, out, &q->not_full);
+}
+
+Result spscQueuePush(SpscQueue* q, const void* elem, u64 timeout) {
+    return _queueBlockingOp(_spscQueuePush, q, (void*)elem, &q->not_full, &q->not_empty, timeout);
+}
+
+Result spscQueuePop(SpscQueue* q, void* out, u64 timeout) {
+    return _queueBlockingOp(_spscQueuePop, q, out, &q->not_empty, &q->not_full, timeout);
+}
+
+Result mpmcQueueCreate(MpmcQueue* q, u32 capacity, u32 elem_size) {
+    if (!capacity || (capacity & (capacity - 1)) || !elem_size)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    memset(q, 0, sizeof(*q));
+    q->cell_size = (sizeof(u32) + elem_size + 7) &~ 7;
+    q->cells = (u8*)malloc((size_t)capacity * q->cell_size);
+    if (!q->cells)
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+
+    for (u32 i = 0; i < capacity; i++)
+        *(u32*)(q->cells + i * q->cell_size) = i;
+
+    q->elem_size = elem_size;
+    q->mask = capacity - 1;
+    ueventCreate(&q->not_empty, true);
+    ueventCreate(&q->not_full, true);
+    return 0;
+}
+
+void mpmcQueueClose(MpmcQueue* q) {
+    free(q->cells);
+    q->cells = NULL;
+}
+
+bool mpmcQueueTryPush(MpmcQueue* q, const void* elem) {
+    return _queueTryOp(_mpmcQueuePush, q, (void*)elem, &q->not_empty);
+}
+
+bool mpmcQueueTryPop(MpmcQueue* q, void* out) {
+    return _queueTryOp(_mpmcQueuePop, q, out, &q->not_full);
+}
+
+Result mpmcQueuePush(MpmcQueue* q, const void* elem, u64 timeout) {
+    return _queueBlockingOp(_mpmcQueuePush, q, (void*)elem, &q->not_full, &q->not_empty, timeout);
+}
+
+Result mpmcQueuePop(MpmcQueue* q, void* out, u64 timeout) {
+    return _queueBlockingOp(_mpmcQueuePop, q, out, &q->not_empty, &q->not_full, timeout);
+}
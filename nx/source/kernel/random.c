@@ -1,129 +1,40 @@
-/*
-  chacha-ref.c version 20080118
-  D. J. Bernstein
-  Public domain.
-
-  Modified by plutoo.
-*/
-
 #include <string.h>
 #include "types.h"
 #include "result.h"
 #include "services/fatal.h"
 #include "kernel/mutex.h"
 #include "kernel/svc.h"
+#include "kernel/thread.h"
 #include "kernel/random.h"
 #include "runtime/env.h"
+#include "crypto/chacha20.h"
 
-#define ROTL32(x, n) (((x) << (n)) | ((x) >> (32-(n))))
-
-#define U32TO8_LITTLE(p, v) \
-    (*(u32*)(p) = (v))
-
-#define U8TO32_LITTLE(p) \
-    (*(const u32*)(p))
-
-#define ROTATE(v,c) (ROTL32(v,c))
-#define XOR(v,w) ((v) ^ (w))
-#define PLUS(v,w) ((v) + (w))
-#define PLUSONE(v) (PLUS((v),1))
-
-#define QUARTERROUND(a,b,c,d) \
-    x[a] = PLUS(x[a],x[b]); x[d] = ROTATE(XOR(x[d],x[a]),16); \
-    x[c] = PLUS(x[c],x[d]); x[b] = ROTATE(XOR(x[b],x[c]),12); \
-    x[a] = PLUS(x[a],x[b]); x[d] = ROTATE(XOR(x[d],x[a]), 8); \
-    x[c] = PLUS(x[c],x[d]); x[b] = ROTATE(XOR(x[b],x[c]), 7);
+// Each thread draws from its own ChaCha20 generator, keyed from the global one.
+// The global generator (and its mutex) is only used when a thread (re)seeds.
+#define RANDOM_THREAD_BUFFER_SIZE  (4 * CHACHA20_BLOCK_SIZE)
+#define RANDOM_THREAD_RESEED_BYTES 0x100000
 
 typedef struct {
-    u32 input[16];
-} ChaCha;
-
-static void _Round(u8 output[64], const u32 input[16])
-{
-    u32 x[16];
-    int i;
-
-    for (i = 0;i < 16;++i)
-        x[i] = input[i];
-
-    for (i = 8;i > 0;i -= 2) {
-        QUARTERROUND( 0, 4, 8,12);
-        QUARTERROUND( 1, 5, 9,13);
-        QUARTERROUND( 2, 6,10,14);
-        QUARTERROUND( 3, 7,11,15);
-        QUARTERROUND( 0, 5,10,15);
-        QUARTERROUND( 1, 6,11,12);
-        QUARTERROUND( 2, 7, 8,13);
-        QUARTERROUND( 3, 4, 9,14);
-    }
-
-    for (i = 0;i < 16;++i)
-        x[i] = PLUS(x[i],input[i]);
-
-    for (i = 0;i < 16;++i)
-        U32TO8_LITTLE(output + 4 * i,x[i]);
-}
+    Chacha20Context ctx;
+    u8     buffer[RANDOM_THREAD_BUFFER_SIZE];
+    size_t pos;
+    size_t generated;
+    bool   initialized;
+} RandomThreadState;
+
+static Chacha20Context g_chacha;
+static bool   g_randInit = false;
+static Mutex  g_randMutex;
+static s32    g_randTlsSlot = -1;
 
-static const char sigma[16] = "expand 32-byte k";
+static __thread RandomThreadState g_randThread;
 
-static void chachaInit(ChaCha* x, const u8* key, const u8* iv)
+static void _randomThreadRelease(void* arg)
 {
-    // Setup key.
-    x->input[0]  = U8TO32_LITTLE(sigma + 0);
-    x->input[1]  = U8TO32_LITTLE(sigma + 4);
-    x->input[2]  = U8TO32_LITTLE(sigma + 8);
-    x->input[3]  = U8TO32_LITTLE(sigma + 12);
-    x->input[4]  = U8TO32_LITTLE(key + 0);
-    x->input[5]  = U8TO32_LITTLE(key + 4);
-    x->input[6]  = U8TO32_LITTLE(key + 8);
-    x->input[7]  = U8TO32_LITTLE(key + 12);
-    x->input[8]  = U8TO32_LITTLE(key + 16);
-    x->input[9]  = U8TO32_LITTLE(key + 20);
-    x->input[10] = U8TO32_LITTLE(key + 24);
-    x->input[11] = U8TO32_LITTLE(key + 28);
-
-    // Setup iv.
-    x->input[12] = 0;
-    x->input[13] = 0;
-    x->input[14] = U8TO32_LITTLE(iv + 0);
-    x->input[15] = U8TO32_LITTLE(iv + 4);
-}
-
-static void chachaEncrypt(ChaCha* x, const u8* m, u8* c, size_t bytes)
-{
-    u8 output[64];
-    int i;
-
-    while (bytes > 0)
-    {
-        _Round(output, x->input);
-
-        x->input[12] = PLUSONE(x->input[12]);
-
-        if (!x->input[12]) {
-            x->input[13] = PLUSONE(x->input[13]);
-            /* stopping at 2^70 bytes per nonce is user's responsibility */
-        }
-
-        if (bytes <= 64) {
-            for (i = 0;i < bytes;++i)
-                c[i] = m[i] ^ output[i];
-            return;
-        }
-
-        for (i = 0;i < 64;++i)
-            c[i] = m[i] ^ output[i];
-
-        bytes -= 64;
-        c += 64;
-        m += 64;
-    }
+    // Wipe the generator of an exiting thread, so that its past and future output can't be recovered from memory.
+    memset(arg, 0, sizeof(RandomThreadState));
 }
 
-static ChaCha g_chacha;
-static bool   g_randInit = false;
-static Mutex  g_randMutex;
-
 static void _randomInit(void)
 {
     // Has already initialized?
@@ -150,23 +61,89 @@ static void _randomInit(void)
         seed[3] ^= seed[2];
     }
 
-    u8 iv[8];
-    memset(iv, 0, sizeof iv);
+    u8 nonce[CHACHA20_NONCE_SIZE];
+    memset(nonce, 0, sizeof nonce);
 
-    chachaInit(&g_chacha, (const u8*) seed, iv);
+    chacha20ContextCreate(&g_chacha, seed, nonce, 0);
+    memset(seed, 0, sizeof seed);
     g_randInit = true;
 }
 
-void randomGet(void* buf, size_t len)
+static void _randomSeedThread(RandomThreadState* st)
 {
-    mutexLock(&g_randMutex);
+    u8 seed[CHACHA20_KEY_SIZE + CHACHA20_NONCE_SIZE];
+    memset(seed, 0, sizeof seed);
 
+    mutexLock(&g_randMutex);
     _randomInit();
+    chacha20Crypt(&g_chacha, seed, seed, sizeof seed);
+
+    // The slot is only used for its destructor. Without one, the state is just left behind.
+    if (!st->initialized) {
+        if (g_randTlsSlot < 0)
+            g_randTlsSlot = threadTlsAlloc(_randomThreadRelease);
+        if (g_randTlsSlot >= 0)
+            threadTlsSet(g_randTlsSlot, st);
+    }
+    mutexUnlock(&g_randMutex);
 
-    memset(buf, 0, len);
-    chachaEncrypt(&g_chacha, (const u8*)buf, (u8*)buf, len);
+    chacha20ContextCreate(&st->ctx, seed, seed + CHACHA20_KEY_SIZE, 0);
+    memset(seed, 0, sizeof seed);
 
-    mutexUnlock(&g_randMutex);
+    st->pos = sizeof(st->buffer);
+    st->generated = 0;
+    st->initialized = true;
+}
+
+static void _randomGenerate(RandomThreadState* st, u8* out, size_t len)
+{
+    if (st->generated >= RANDOM_THREAD_RESEED_BYTES)
+        _randomSeedThread(st);
+
+    memset(out, 0, len);
+    chacha20Crypt(&st->ctx, out, out, len);
+    st->generated += len;
+}
+
+void randomGet(void* buf, size_t len)
+{
+    RandomThreadState* st = &g_randThread;
+    u8* out = (u8*)buf;
+
+    if (!st->initialized)
+        _randomSeedThread(st);
+
+    while (len > 0)
+    {
+        if (st->pos == sizeof(st->buffer))
+        {
+            // Large requests are generated in place, split at the reseed budget so that they're reseeded along the way.
+            if (len >= sizeof(st->buffer))
+            {
+                size_t direct = len - (len % CHACHA20_BLOCK_SIZE);
+                if (st->generated < RANDOM_THREAD_RESEED_BYTES && direct > RANDOM_THREAD_RESEED_BYTES - st->generated)
+                    direct = (RANDOM_THREAD_RESEED_BYTES - st->generated) & ~(size_t)(CHACHA20_BLOCK_SIZE-1);
+                _randomGenerate(st, out, direct);
+                out += direct;
+                len -= direct;
+                continue;
+            }
+
+            _randomGenerate(st, st->buffer, sizeof(st->buffer));
+            st->pos = 0;
+        }
+
+        size_t copyable = sizeof(st->buffer) - st->pos;
+        if (copyable > len)
+            copyable = len;
+
+        // Consumed output is erased, so that it can't be recovered later.
+        memcpy(out, st->buffer + st->pos, copyable);
+        memset(st->buffer + st->pos, 0, copyable);
+        st->pos += copyable;
+        out += copyable;
+        len -= copyable;
+    }
 }
 
 u64 randomGet64(void)
@@ -0,0 +1,197 @@
+#include <string.h>
+#include "types.h"
+#include "result.h"
+#include "arm/counter.h"
+#include "kernel/svc.h"
+#include "kernel/wait.h"
+#include "kernel/ring_channel.h"
+
+#define RING_CHANNEL_MAGIC 0x474E4952 // "RING"
+
+// Like the SpscQueue, each side publishes its position, then issues a full barrier before reading the other side's one,
+// so that either the waiting side sees the new data/space, or the other side sees the empty/full transition and rings the doorbell.
+
+// The positions come from another process, never trust them further than the capacity.
+static inline u64 _ringChannelUsed(RingChannel* c, u64 write_pos, u64 read_pos) {
+    u64 used = write_pos - read_pos;
+    return used <= c->capacity ? used : 0;
+}
+
+Result ringChannelCreate(RingChannel* c, SharedMemory* s, RingChannelRole role, bool format) {
+    if (!s->map_addr || s->size <= sizeof(RingChannelHeader) || s->size - sizeof(RingChannelHeader) > UINT32_MAX)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    memset(c, 0, sizeof(*c));
+    c->hdr = (RingChannelHeader*)s->map_addr;
+    c->data = (u8*)s->map_addr + sizeof(RingChannelHeader);
+    c->capacity = s->size - sizeof(RingChannelHeader);
+    c->role = role;
+    c->peer.revent = INVALID_HANDLE;
+    c->peer.wevent = INVALID_HANDLE;
+
+    if (format) {
+        memset(c->hdr, 0, sizeof(RingChannelHeader));
+        c->hdr->capacity = c->capacity;
+        __atomic_store_n(&c->hdr->magic, RING_CHANNEL_MAGIC, __ATOMIC_RELEASE);
+    }
+    else if (__atomic_load_n(&c->hdr->magic, __ATOMIC_ACQUIRE) != RING_CHANNEL_MAGIC || c->hdr->capacity != c->capacity)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    return eventCreate(&c->local, false);
+}
+
+void ringChannelSetPeerEvent(RingChannel* c, Handle handle) {
+    eventClose(&c->peer);
+    eventLoadRemote(&c->peer, handle, true);
+}
+
+void ringChannelClose(RingChannel* c) {
+    if (!c->hdr)
+        return;
+
+    u32* closed = c->role == RingChannelRole_Producer ? &c->hdr->producer_closed : &c->hdr->consumer_closed;
+    __atomic_store_n(closed, 1, __ATOMIC_RELEASE);
+    eventFire(&c->local);
+
+    eventClose(&c->local);
+    eventClose(&c->peer);
+    c->hdr = NULL;
+}
+
+size_t ringChannelGetWriteSpan(RingChannel* c, void** out_ptr) {
+    u64 write_pos = c->hdr->write_pos;
+    u64 read_pos = __atomic_load_n(&c->hdr->read_pos, __ATOMIC_ACQUIRE);
+
+    u32 offset = write_pos % c->capacity;
+    u64 free_size = c->capacity - _ringChannelUsed(c, write_pos, read_pos);
+    u32 contiguous = c->capacity - offset;
+
+    *out_ptr = c->data + offset;
+    return free_size < contiguous ? free_size : contiguous;
+}
+
+void ringChannelCommitWrite(RingChannel* c, size_t size) {
+    if (!size)
+        return;
+
+    u64 write_pos = c->hdr->write_pos;
+    __atomic_store_n(&c->hdr->write_pos, write_pos + size, __ATOMIC_RELEASE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    // Ring the doorbell if the consumer had read everything, it may be waiting.
+    if (__atomic_load_n(&c->hdr->read_pos, __ATOMIC_ACQUIRE) == write_pos)
+        eventFire(&c->local);
+}
+
+size_t ringChannelGetReadSpan(RingChannel* c, const void** out_ptr) {
+    u64 read_pos = c->hdr->read_pos;
+    u64 write_pos = __atomic_load_n(&c->hdr->write_pos, __ATOMIC_ACQUIRE);
+
+    u32 offset = read_pos % c->capacity;
+    u64 used = _ringChannelUsed(c, write_pos, read_pos);
+    u32 contiguous = c->capacity - offset;
+
+    *out_ptr = c->data + offset;
+    return used < contiguous ? used : contiguous;
+}
+
+void ringChannelCommitRead(RingChannel* c, size_t size) {
+    if (!size)
+        return;
+
+    u64 read_pos = c->hdr->read_pos;
+    __atomic_store_n(&c->hdr->read_pos, read_pos + size, __ATOMIC_RELEASE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    // Ring the doorbell if the ring was full, the producer may be waiting.
+    if (__atomic_load_n(&c->hdr->write_pos, __ATOMIC_ACQUIRE) - read_pos == c->capacity)
+        eventFire(&c->local);
+}
+
+size_t ringChannelTryWrite(RingChannel* c, const void* data, size_t size) {
+    size_t done = 0;
+
+    while (done < size) {
+        void* ptr;
+        size_t len = ringChannelGetWriteSpan(c, &ptr);
+        if (!len)
+            break;
+        if (len > size - done)
+            len = size - done;
+
+        memcpy(ptr, (const u8*)data + done, len);
+        done += len;
+        ringChannelCommitWrite(c, len);
+    }
+
+    return done;
+}
+
+size_t ringChannelTryRead(RingChannel* c, void* buf, size_t size) {
+    size_t done = 0;
+
+    while (done < size) {
+        const void* ptr;
+        size_t len = ringChannelGetReadSpan(c, &ptr);
+        if (!len)
+            break;
+        if (len > size - done)
+            len = size - done;
+
+        memcpy((u8*)buf + done, ptr, len);
+        done += len;
+        ringChannelCommitRead(c, len);
+    }
+
+    return done;
+}
+
+static Result _ringChannelWaitPeer(RingChannel* c, u64 start, u64 timeout) {
+    u64 remaining = UINT64_MAX;
+    if (timeout != UINT64_MAX) {
+        u64 elapsed = armTicksToNs(armGetSystemTick() - start);
+        if (elapsed >= timeout)
+            return KERNELRESULT(TimedOut);
+        remaining = timeout - elapsed;
+    }
+
+    return waitSingle(waiterForEvent(&c->peer), remaining);
+}
+
+Result ringChannelWrite(RingChannel* c, const void* data, size_t size, u64 timeout) {
+    u64 start = armGetSystemTick();
+    size_t done = 0;
+
+    while (1) {
+        if (__atomic_load_n(&c->hdr->consumer_closed, __ATOMIC_ACQUIRE))
+            return KERNELRESULT(ConnectionClosed);
+
+        done += ringChannelTryWrite(c, (const u8*)data + done, size - done);
+        if (done == size)
+            return 0;
+
+        Result rc = _ringChannelWaitPeer(c, start, timeout);
+        if (R_FAILED(rc))
+            return rc;
+    }
+}
+
+Result ringChannelRead(RingChannel* c, void* buf, size_t size, u64 timeout) {
+    u64 start = armGetSystemTick();
+    size_t done = 0;
+
+    while (1) {
+        // Check before reading, so that everything written before closing is read.
+        bool closed = __atomic_load_n(&c->hdr->producer_closed, __ATOMIC_ACQUIRE);
+
+        done += ringChannelTryRead(c, (u8*)buf + done, size - done);
+        if (done == size)
+            return 0;
+        if (closed)
+            return KERNELRESULT(ConnectionClosed);
+
+        Result rc = _ringChannelWaitPeer(c, start, timeout);
+        if (R_FAILED(rc))
+            return rc;
+    }
+}
@@ -1,6 +1,9 @@
 // Copyright 2018 plutoo
 #include "kernel/mutex.h"
 #include "kernel/rwlock.h"
+#include "kernel/futex.h"
+#include "kernel/svc.h"
+#include "runtime/hosversion.h"
 #include "../internal.h"
 
 NX_INLINE u32 _GetCurrentThreadTag(void) {
@@ -168,3 +171,78 @@ bool rwlockIsWriteLockHeldByCurrentThread(RwLock* r) {
 bool rwlockIsOwnedByCurrentThread(RwLock* r) {
     return r->write_owner_tag == _GetCurrentThreadTag();
 }
+
+NX_INLINE u32* _srwlockGetSlot(SRwLock* r) {
+    const u32 tag = _GetCurrentThreadTag();
+    return &r->slots[(tag ^ (tag >> 15)) % SRWLOCK_NUM_SLOTS].readers;
+}
+
+static void _srwlockWait(u32* addr, u32 value) {
+    if (hosversionAtLeast(4,0,0))
+        futexWait(addr, value, UINT64_MAX);
+    else
+        svcSleepThread(100000);
+}
+
+static void _srwlockWake(u32* addr, s32 count) {
+    if (hosversionAtLeast(4,0,0))
+        futexWake(addr, count);
+}
+
+// Returns false if a writer holds or waits for the lock, after backing off.
+static bool _srwlockTryEnter(SRwLock* r, u32* slot) {
+    __atomic_add_fetch(slot, 1, __ATOMIC_RELAXED);
+    // Pairs with the fence in srwlockWriteLock: either we see the writer, or it sees our count
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    // Acquire: synchronizes with the release of the last writer's unlock
+    if (__atomic_load_n(&r->writer, __ATOMIC_ACQUIRE) == 0)
+        return true;
+
+    srwlockReadUnlock(r);
+    return false;
+}
+
+void srwlockReadLock(SRwLock* r) {
+    u32* slot = _srwlockGetSlot(r);
+
+    while (!_srwlockTryEnter(r, slot)) {
+        u32 cur = __atomic_load_n(&r->writer, __ATOMIC_RELAXED);
+        if (cur == 1 && !__atomic_compare_exchange_n(&r->writer, &cur, 2, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            continue;
+        if (cur != 0)
+            _srwlockWait(&r->writer, 2);
+    }
+}
+
+bool srwlockTryReadLock(SRwLock* r) {
+    return _srwlockTryEnter(r, _srwlockGetSlot(r));
+}
+
+void srwlockReadUnlock(SRwLock* r) {
+    u32* slot = _srwlockGetSlot(r);
+
+    if (__atomic_sub_fetch(slot, 1, __ATOMIC_SEQ_CST) == 0 && __atomic_load_n(&r->writer, __ATOMIC_RELAXED))
+        _srwlockWake(slot, 1);
+}
+
+void srwlockWriteLock(SRwLock* r) {
+    mutexLock(&r->writer_mutex);
+
+    __atomic_store_n(&r->writer, 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    for (u32 i = 0; i < SRWLOCK_NUM_SLOTS; i++) {
+        u32* slot = &r->slots[i].readers;
+        u32 cur;
+        while ((cur = __atomic_load_n(slot, __ATOMIC_ACQUIRE)) != 0)
+            _srwlockWait(slot, cur);
+    }
+}
+
+void srwlockWriteUnlock(SRwLock* r) {
+    if (__atomic_exchange_n(&r->writer, 0, __ATOMIC_RELEASE) == 2)
+        _srwlockWake(&r->writer, -1);
+
+    mutexUnlock(&r->writer_mutex);
+}
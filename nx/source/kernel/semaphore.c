@@ -1,31 +1,64 @@
 // Copyright 2018 Kevoot
 #include "kernel/semaphore.h"
+#include "kernel/futex.h"
 #include "kernel/svc.h"
+#include "runtime/hosversion.h"
 
 void semaphoreInit(Semaphore *s, u64 initial_count) {
-    s->count = initial_count;
+    s->count = initial_count > UINT32_MAX ? UINT32_MAX : initial_count;
+    s->num_waiters = 0;
     mutexInit(&s->mutex);
     condvarInit(&s->condvar);
 }
 
+static bool _semaphoreTryDecrement(Semaphore *s) {
+    u32 count = __atomic_load_n(&s->count, __ATOMIC_RELAXED);
+    while (count) {
+        if (__atomic_compare_exchange_n(&s->count, &count, count - 1, true, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+            return true;
+    }
+    return false;
+}
+
 void semaphoreSignal(Semaphore *s) {
-    mutexLock(&s->mutex);
-    s->count++;
-    condvarWakeOne(&s->condvar);
-    mutexUnlock(&s->mutex);
+    if (hosversionBefore(4,0,0)) {
+        mutexLock(&s->mutex);
+        s->count++;
+        condvarWakeOne(&s->condvar);
+        mutexUnlock(&s->mutex);
+        return;
+    }
+
+    // Either the waiter sees the new count before parking, or we see the waiter and wake it.
+    __atomic_add_fetch(&s->count, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&s->num_waiters, __ATOMIC_SEQ_CST))
+        futexWake(&s->count, 1);
 }
 
 void semaphoreWait(Semaphore *s) {
-    mutexLock(&s->mutex);
-    // Wait until signalled.
-    while (!s->count) {
-        condvarWait(&s->condvar, &s->mutex);
+    if (hosversionBefore(4,0,0)) {
+        mutexLock(&s->mutex);
+        // Wait until signalled.
+        while (!s->count) {
+            condvarWait(&s->condvar, &s->mutex);
+        }
+        s->count--;
+        mutexUnlock(&s->mutex);
+        return;
+    }
+
+    while (!_semaphoreTryDecrement(s)) {
+        // Park for as long as the counter is zero.
+        __atomic_add_fetch(&s->num_waiters, 1, __ATOMIC_SEQ_CST);
+        futexWait(&s->count, 0, UINT64_MAX);
+        __atomic_sub_fetch(&s->num_waiters, 1, __ATOMIC_RELAXED);
     }
-    s->count--;
-    mutexUnlock(&s->mutex);
 }
 
 bool semaphoreTryWait(Semaphore *s) {
+    if (!hosversionBefore(4,0,0))
+        return _semaphoreTryDecrement(s);
+
     mutexLock(&s->mutex);
     bool success = false;
     // Check and immediately return success.
@@ -248,6 +248,16 @@ SVC_BEGIN svcGetInfo
 	ret
 SVC_END
 
+SVC_BEGIN svcFlushEntireDataCache
+	svc 0x2A
+	ret
+SVC_END
+
+SVC_BEGIN svcFlushDataCache
+	svc 0x2B
+	ret
+SVC_END
+
 SVC_BEGIN svcMapPhysicalMemory
 	svc 0x2C
 	ret
@@ -284,6 +294,16 @@ SVC_BEGIN svcGetThreadContext3
 	ret
 SVC_END
 
+SVC_BEGIN svcWaitForAddress
+	svc 0x34
+	ret
+SVC_END
+
+SVC_BEGIN svcSignalToAddress
+	svc 0x35
+	ret
+SVC_END
+
 SVC_BEGIN svcCreateSession
 	stp x0, x1, [sp, #-16]!
 	svc 0x40
@@ -0,0 +1,334 @@
+#include "types.h"
+#include "result.h"
+#include "kernel/svc.h"
+#include "kernel/task_scheduler.h"
+#include "runtime/hosversion.h"
+
+#define TASK_DEQUE_MASK (TASK_DEQUE_SIZE - 1)
+
+// Number of failed searches for work before a worker parks.
+#define TASK_SCHEDULER_SPIN_COUNT 64
+
+typedef struct {
+    TaskRangeFunc func;
+    void* arg;
+    size_t begin;
+    size_t end;
+} TaskRange;
+
+static bool _taskDequePush(TaskDeque* d, Task* t) {
+    s64 b = __atomic_load_n(&d->bottom, __ATOMIC_RELAXED);
+    s64 top = __atomic_load_n(&d->top, __ATOMIC_ACQUIRE);
+
+    if (b - top >= TASK_DEQUE_SIZE)
+        return false;
+
+    __atomic_store_n(&d->tasks[b & TASK_DEQUE_MASK], t, __ATOMIC_RELAXED);
+    __atomic_store_n(&d->bottom, b + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+static Task* _taskDequePop(TaskDeque* d) {
+    s64 b = __atomic_load_n(&d->bottom, __ATOMIC_RELAXED) - 1;
+    __atomic_store_n(&d->bottom, b, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    s64 top = __atomic_load_n(&d->top, __ATOMIC_RELAXED);
+
+    if (top > b) {
+        // Empty
+        __atomic_store_n(&d->bottom, b + 1, __ATOMIC_RELAXED);
+        return NULL;
+    }
+
+    Task* t = __atomic_load_n(&d->tasks[b & TASK_DEQUE_MASK], __ATOMIC_RELAXED);
+    if (top == b) {
+        // Last task, race against thieves for it
+        if (!__atomic_compare_exchange_n(&d->top, &top, top + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+            t = NULL;
+        __atomic_store_n(&d->bottom, b + 1, __ATOMIC_RELAXED);
+    }
+
+    return t;
+}
+
+static Task* _taskDequeSteal(TaskDeque* d) {
+    s64 top = __atomic_load_n(&d->top, __ATOMIC_ACQUIRE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    s64 b = __atomic_load_n(&d->bottom, __ATOMIC_ACQUIRE);
+
+    if (top >= b)
+        return NULL;
+
+    Task* t = __atomic_load_n(&d->tasks[top & TASK_DEQUE_MASK], __ATOMIC_RELAXED);
+    if (!__atomic_compare_exchange_n(&d->top, &top, top + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+        return NULL;
+
+    return t;
+}
+
+static bool _taskDequeIsEmpty(TaskDeque* d) {
+    return __atomic_load_n(&d->top, __ATOMIC_RELAXED) >= __atomic_load_n(&d->bottom, __ATOMIC_RELAXED);
+}
+
+static Task* _taskQueuePop(TaskScheduler* ts) {
+    if (!__atomic_load_n(&ts->queue_size, __ATOMIC_RELAXED))
+        return NULL;
+
+    mutexLock(&ts->queue_mutex);
+    Task* t = ts->queue_head;
+    if (t) {
+        ts->queue_head = t->next;
+        if (!ts->queue_head)
+            ts->queue_tail = NULL;
+        __atomic_store_n(&ts->queue_size, ts->queue_size - 1, __ATOMIC_RELAXED);
+    }
+    mutexUnlock(&ts->queue_mutex);
+
+    return t;
+}
+
+static void _taskQueuePush(TaskScheduler* ts, Task* t) {
+    t->next = NULL;
+
+    mutexLock(&ts->queue_mutex);
+    if (ts->queue_tail)
+        ts->queue_tail->next = t;
+    else
+        ts->queue_head = t;
+    ts->queue_tail = t;
+    __atomic_store_n(&ts->queue_size, ts->queue_size + 1, __ATOMIC_RELAXED);
+    mutexUnlock(&ts->queue_mutex);
+}
+
+static bool _taskHasWork(TaskScheduler* ts) {
+    if (__atomic_load_n(&ts->queue_size, __ATOMIC_RELAXED))
+        return true;
+
+    for (u32 i = 0; i < ts->num_workers; i++) {
+        if (!_taskDequeIsEmpty(&ts->workers[i].deque))
+            return true;
+    }
+
+    return false;
+}
+
+static TaskWorker* _taskGetCurrentWorker(TaskScheduler* ts) {
+    Handle self = threadGetCurHandle();
+
+    for (u32 i = 0; i < ts->num_workers; i++) {
+        if (ts->workers[i].thread.handle == self)
+            return &ts->workers[i];
+    }
+
+    return NULL;
+}
+
+static Task* _taskFind(TaskScheduler* ts, TaskWorker* w) {
+    Task* t = _taskDequePop(&w->deque);
+    if (t)
+        return t;
+
+    t = _taskQueuePop(ts);
+    if (t)
+        return t;
+
+    // Steal from the other workers, starting at a pseudo-random one
+    w->steal_seed ^= w->steal_seed << 13;
+    w->steal_seed ^= w->steal_seed >> 17;
+    w->steal_seed ^= w->steal_seed << 5;
+
+    u32 start = w->steal_seed % ts->num_workers;
+    for (u32 i = 0; i < ts->num_workers; i++) {
+        TaskWorker* victim = &ts->workers[(start + i) % ts->num_workers];
+        if (victim != w && (t = _taskDequeSteal(&victim->deque)))
+            return t;
+    }
+
+    return NULL;
+}
+
+static void _taskRun(Task* t) {
+    // The task may be freed by its entrypoint
+    TaskGroup* g = t->group;
+
+    t->func(t->arg);
+
+    if (g && __atomic_sub_fetch(&g->pending, 1, __ATOMIC_ACQ_REL) == 0)
+        svcSignalToAddress(&g->pending, SignalType_Signal, 0, -1);
+}
+
+static void _taskWake(TaskScheduler* ts, s32 count) {
+    // Pairs with the fence in _taskWorkerMain: either the worker sees the new task, or we see it parked
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    if (__atomic_load_n(&ts->num_parked, __ATOMIC_RELAXED)) {
+        __atomic_add_fetch(&ts->epoch, 1, __ATOMIC_RELEASE);
+        svcSignalToAddress(&ts->epoch, SignalType_Signal, 0, count);
+    }
+}
+
+static void _taskWorkerMain(void* arg) {
+    TaskWorker* w = (TaskWorker*)arg;
+    TaskScheduler* ts = w->ts;
+    u32 misses = 0;
+
+    while (1) {
+        Task* t = _taskFind(ts, w);
+        if (t) {
+            _taskRun(t);
+            misses = 0;
+            continue;
+        }
+
+        if (++misses < TASK_SCHEDULER_SPIN_COUNT) {
+            __asm__ __volatile__("yield" ::: "memory");
+            continue;
+        }
+
+        // Park until a task is submitted. The epoch is read first, so that a wakeup between the
+        // check for work and the wait makes svcWaitForAddress return immediately.
+        u32 epoch = __atomic_load_n(&ts->epoch, __ATOMIC_ACQUIRE);
+        __atomic_add_fetch(&ts->num_parked, 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+        bool has_work = _taskHasWork(ts);
+        if (!has_work && __atomic_load_n(&ts->exiting, __ATOMIC_ACQUIRE)) {
+            __atomic_sub_fetch(&ts->num_parked, 1, __ATOMIC_RELAXED);
+            break;
+        }
+
+        if (!has_work)
+            svcWaitForAddress(&ts->epoch, ArbitrationType_WaitIfEqual, epoch, -1);
+
+        __atomic_sub_fetch(&ts->num_parked, 1, __ATOMIC_RELAXED);
+        misses = 0;
+    }
+}
+
+Result taskSchedulerCreate(TaskScheduler* ts, u32 num_workers, int prio, size_t stack_sz) {
+    if (hosversionBefore(4,0,0))
+        return MAKERESULT(Module_Libnx, LibnxError_IncompatSysVer);
+
+    u64 core_mask = 0;
+    Result rc = svcGetInfo(&core_mask, InfoType_CoreMask, CUR_PROCESS_HANDLE, 0);
+    if (R_FAILED(rc))
+        return rc;
+
+    *ts = (TaskScheduler){0};
+    mutexInit(&ts->queue_mutex);
+
+    if (!num_workers || num_workers > TASK_SCHEDULER_MAX_WORKERS)
+        num_workers = TASK_SCHEDULER_MAX_WORKERS;
+
+    // One worker per core of the process's core mask
+    for (int core = 0; core < 64 && ts->num_workers < num_workers; core++) {
+        if (!(core_mask & (1ULL << core)))
+            continue;
+
+        TaskWorker* w = &ts->workers[ts->num_workers];
+        w->ts = ts;
+        w->index = ts->num_workers;
+        w->steal_seed = 0x9E3779B9 * (w->index + 1);
+
+        rc = threadCreate(&w->thread, _taskWorkerMain, w, NULL, stack_sz, prio, core);
+        if (R_FAILED(rc))
+            break;
+
+        ts->num_workers++;
+    }
+
+    if (R_SUCCEEDED(rc) && !ts->num_workers)
+        rc = MAKERESULT(Module_Libnx, LibnxError_NotFound);
+
+    for (u32 i = 0; R_SUCCEEDED(rc) && i < ts->num_workers; i++)
+        rc = threadStart(&ts->workers[i].thread);
+
+    if (R_FAILED(rc))
+        taskSchedulerClose(ts);
+
+    return rc;
+}
+
+void taskSchedulerClose(TaskScheduler* ts) {
+    __atomic_store_n(&ts->exiting, true, __ATOMIC_RELEASE);
+    __atomic_add_fetch(&ts->epoch, 1, __ATOMIC_SEQ_CST);
+    svcSignalToAddress(&ts->epoch, SignalType_Signal, 0, -1);
+
+    for (u32 i = 0; i < ts->num_workers; i++) {
+        threadWaitForExit(&ts->workers[i].thread);
+        threadClose(&ts->workers[i].thread);
+    }
+
+    ts->num_workers = 0;
+}
+
+void taskSchedulerSubmit(TaskScheduler* ts, Task* t) {
+    if (t->group)
+        __atomic_add_fetch(&t->group->pending, 1, __ATOMIC_RELAXED);
+
+    TaskWorker* w = _taskGetCurrentWorker(ts);
+    if (!w || !_taskDequePush(&w->deque, t))
+        _taskQueuePush(ts, t);
+
+    _taskWake(ts, 1);
+}
+
+void taskGroupWait(TaskScheduler* ts, TaskGroup* g) {
+    TaskWorker* w = _taskGetCurrentWorker(ts);
+    u32 pending;
+
+    while ((pending = __atomic_load_n(&g->pending, __ATOMIC_ACQUIRE)) != 0) {
+        if (w) {
+            Task* t = _taskFind(ts, w);
+            if (t) {
+                _taskRun(t);
+                continue;
+            }
+        }
+
+        // The remaining tasks are running elsewhere, the last one to complete signals the group
+        svcWaitForAddress(&g->pending, ArbitrationType_WaitIfEqual, pending, -1);
+    }
+}
+
+static void _taskRangeEntry(void* arg) {
+    TaskRange* r = (TaskRange*)arg;
+    r->func(r->arg, r->begin, r->end);
+}
+
+void taskSchedulerParallelFor(TaskScheduler* ts, TaskRangeFunc func, void* arg, size_t begin, size_t end, size_t grain) {
+    if (end <= begin)
+        return;
+
+    size_t count = end - begin;
+    if (!grain)
+        grain = 1;
+
+    size_t num_chunks = (count + grain - 1) / grain;
+    if (num_chunks > TASK_PARALLEL_FOR_MAX_CHUNKS)
+        num_chunks = TASK_PARALLEL_FOR_MAX_CHUNKS;
+
+    if (num_chunks <= 1) {
+        func(arg, begin, end);
+        return;
+    }
+
+    TaskRange ranges[TASK_PARALLEL_FOR_MAX_CHUNKS];
+    Task tasks[TASK_PARALLEL_FOR_MAX_CHUNKS];
+    TaskGroup g = {0};
+
+    size_t pos = begin;
+    for (size_t i = 0; i < num_chunks; i++) {
+        size_t len = count / num_chunks + (i < count % num_chunks);
+        ranges[i] = (TaskRange){ func, arg, pos, pos + len };
+        tasks[i] = (Task){ .func = _taskRangeEntry, .arg = &ranges[i], .group = &g };
+        pos += len;
+    }
+
+    // The first chunk runs on the calling thread
+    for (size_t i = 1; i < num_chunks; i++)
+        taskSchedulerSubmit(ts, &tasks[i]);
+
+    _taskRangeEntry(&ranges[0]);
+    taskGroupWait(ts, &g);
+}
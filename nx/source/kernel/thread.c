@@ -11,9 +11,12 @@
 #include "services/fatal.h"
 #include "../internal.h"
 
-#define USER_TLS_BEGIN 0x108
+#define USER_TLS_BEGIN THREAD_TLS_SLOTS_OFFSET
 #define USER_TLS_END   (0x200 - sizeof(ThreadVars))
-#define NUM_TLS_SLOTS ((USER_TLS_END - USER_TLS_BEGIN) / sizeof(void*))
+#define NUM_TLS_SLOTS  THREAD_TLS_NUM_SLOTS
+#define NUM_TLS_EXTRA_SLOTS (THREAD_TLS_NUM_SLOTS - THREAD_TLS_INLINE_SLOTS)
+
+_Static_assert(USER_TLS_BEGIN + (THREAD_TLS_INLINE_SLOTS + 1) * sizeof(void*) <= USER_TLS_END, "TLS slots overlap the thread vars");
 
 extern const u8 __tdata_lma[];
 extern const u8 __tdata_lma_end[];
@@ -23,7 +26,28 @@ extern u8 __tls_end[];
 static Mutex g_threadMutex;
 static Thread* g_threadList;
 
+// Mapped stacks of closed threads, reused by threadCreate
+#define THREAD_STACK_CACHE_MAX_ENTRIES 8
+
+typedef struct {
+    void*  stack_mem;
+    void*  stack_mirror;
+    size_t size;
+} ThreadStackCacheEntry;
+
+static ThreadStackCacheEntry g_threadStackCache[THREAD_STACK_CACHE_MAX_ENTRIES];
+static u32 g_threadStackCacheCount;
+static size_t g_threadStackCacheBytes;
+
+/// Maximum total size of the stacks kept mapped for reuse after threadClose, 0 to disable.
+__attribute__((weak)) size_t __nx_thread_stack_cache_size = 0;
+
+// Live threads created on each core, for THREAD_CORE_LEAST_LOADED
+#define THREAD_NUM_CORES 4
+static u32 g_threadCoreLoad[THREAD_NUM_CORES];
+
 static u64 g_tlsUsageMask;
+static u64 g_tlsDestructorMask;
 static void (* g_tlsDestructors[NUM_TLS_SLOTS])(void*);
 
 // Thread creation args; keep this struct's size 16-byte aligned
@@ -34,6 +58,7 @@ typedef struct {
     struct _reent* reent;
     void*          tls;
     void*          padding;
+    void*          tls_slots[NUM_TLS_EXTRA_SLOTS]; // TLS slots which don't fit in the TLS region
 } ThreadEntryArgs;
 
 static void _EntryWrap(ThreadEntryArgs* args) {
@@ -48,6 +73,7 @@ static void _EntryWrap(ThreadEntryArgs* args) {
     // Initialize thread info
     mutexLock(&g_threadMutex);
     args->t->tls_array = (void**)((u8*)armGetTls() + USER_TLS_BEGIN);
+    args->t->tls_array[THREAD_TLS_INLINE_SLOTS] = args->tls_slots;
     args->t->prev_next = &g_threadList;
     args->t->next = g_threadList;
     if (g_threadList)
@@ -60,6 +86,39 @@ static void _EntryWrap(ThreadEntryArgs* args) {
     threadExit();
 }
 
+static bool _threadStackCacheTake(size_t size, void** stack_mem, void** stack_mirror) {
+    bool found = false;
+
+    mutexLock(&g_threadMutex);
+    for (u32 i = 0; i < g_threadStackCacheCount; i++) {
+        if (g_threadStackCache[i].size == size) {
+            *stack_mem = g_threadStackCache[i].stack_mem;
+            *stack_mirror = g_threadStackCache[i].stack_mirror;
+            g_threadStackCache[i] = g_threadStackCache[--g_threadStackCacheCount];
+            g_threadStackCacheBytes -= size;
+            found = true;
+            break;
+        }
+    }
+    mutexUnlock(&g_threadMutex);
+
+    return found;
+}
+
+static bool _threadStackCachePut(size_t size, void* stack_mem, void* stack_mirror) {
+    bool stored = false;
+
+    mutexLock(&g_threadMutex);
+    if (g_threadStackCacheCount < THREAD_STACK_CACHE_MAX_ENTRIES && g_threadStackCacheBytes + size <= __nx_thread_stack_cache_size) {
+        g_threadStackCache[g_threadStackCacheCount++] = (ThreadStackCacheEntry){ stack_mem, stack_mirror, size };
+        g_threadStackCacheBytes += size;
+        stored = true;
+    }
+    mutexUnlock(&g_threadMutex);
+
+    return stored;
+}
+
 Result threadCreate(
     Thread* t, ThreadFunc entry, void* arg, void* stack_mem, size_t stack_sz,
     int prio, int cpuid)
@@ -69,9 +128,12 @@ Result threadCreate(
     const size_t reent_sz = (sizeof(struct _reent)+0xF) &~ 0xF;
 
     bool owns_stack_mem;
+    void* stack_mirror = NULL;
     if (stack_mem == NULL) {
-        // Allocate new memory, stack then reent then tls.
-        stack_mem = memalign(0x1000, ((stack_sz + reent_sz + tls_sz) + 0xFFF) & ~0xFFF);
+        // Reuse a mapped stack of a closed thread, or allocate new memory, stack then reent then tls.
+        const size_t alloc_sz = ((stack_sz + reent_sz + tls_sz) + 0xFFF) & ~0xFFF;
+        if (!_threadStackCacheTake(alloc_sz, &stack_mem, &stack_mirror))
+            stack_mem = memalign(0x1000, alloc_sz);
 
         owns_stack_mem = true;
     } else {
@@ -95,8 +157,11 @@ Result threadCreate(
 
     // Stack size may be unaligned in either case.
     const size_t aligned_stack_sz = (stack_sz + tls_sz + reent_sz +0xFFF) & ~0xFFF;
-    void* stack_mirror = virtmemReserveStack(aligned_stack_sz);
-    Result rc = svcMapMemory(stack_mirror, stack_mem, aligned_stack_sz);
+    Result rc = 0;
+    if (stack_mirror == NULL) {
+        stack_mirror = virtmemReserveStack(aligned_stack_sz);
+        rc = svcMapMemory(stack_mirror, stack_mem, aligned_stack_sz);
+    }
 
     if (R_SUCCEEDED(rc))
     {
@@ -120,12 +185,17 @@ Result threadCreate(
             t->tls_array = NULL;
             t->next = NULL;
             t->prev_next = NULL;
+            t->core_id = cpuid >= 0 && cpuid < THREAD_NUM_CORES ? cpuid : -1;
+
+            if (t->core_id >= 0)
+                __atomic_add_fetch(&g_threadCoreLoad[t->core_id], 1, __ATOMIC_RELAXED);
 
             args->t = t;
             args->entry = entry;
             args->arg = arg;
             args->reent = reent;
             args->tls = tls;
+            memset(args->tls_slots, 0, sizeof(args->tls_slots));
 
             // Set up child thread's reent struct, inheriting standard file handles
             _REENT_INIT_PTR(args->reent);
@@ -143,6 +213,10 @@ Result threadCreate(
                 memset(args->tls+tls_load_sz, 0, tls_bss_sz);
         }
 
+        if (R_FAILED(rc) && owns_stack_mem && _threadStackCachePut(aligned_stack_sz, stack_mem, stack_mirror)) {
+            return rc;
+        }
+
         if (R_FAILED(rc)) {
             svcUnmapMemory(stack_mirror, stack_mem, aligned_stack_sz);
         }
@@ -163,15 +237,16 @@ void threadExit(void) {
     if (!t)
         fatalThrow(MAKERESULT(Module_Libnx, LibnxError_NotInitialized));
 
-    u64 tls_mask = __atomic_load_n(&g_tlsUsageMask, __ATOMIC_SEQ_CST);
-    for (s32 i = 0; i < NUM_TLS_SLOTS; i ++) {
-        if (!(tls_mask & ((UINT64_C(1) << i))))
-            continue;
-        if (t->tls_array[i]) {
-            void* old_value = t->tls_array[i];
-            t->tls_array[i] = NULL;
-            if (g_tlsDestructors[i])
-                g_tlsDestructors[i](old_value);
+    // Only slots in use with a destructor need visiting, the others are cleared by threadTlsAlloc.
+    u64 tls_mask = __atomic_load_n(&g_tlsUsageMask, __ATOMIC_SEQ_CST) & __atomic_load_n(&g_tlsDestructorMask, __ATOMIC_SEQ_CST);
+    for (; tls_mask; tls_mask &= tls_mask - 1) {
+        s32 i = __builtin_ctzll(tls_mask);
+        void** slot = _threadTlsSlot(t->tls_array, i);
+        void (* destructor)(void*) = g_tlsDestructors[i];
+        void* old_value = *slot;
+        if (old_value && destructor) {
+            *slot = NULL;
+            destructor(old_value);
         }
     }
 
@@ -187,6 +262,103 @@ void threadExit(void) {
     svcExitThread();
 }
 
+int threadGetPriorityForClass(ThreadPriorityClass prio_class) {
+    static const int prios[] = { 0x1C, 0x28, 0x2C, 0x30, 0x3B };
+    int prio = prios[(u32)prio_class < sizeof(prios)/sizeof(prios[0]) ? prio_class : ThreadPriorityClass_Normal];
+
+    u64 mask = 0;
+    if (R_FAILED(svcGetInfo(&mask, InfoType_PriorityMask, CUR_PROCESS_HANDLE, 0)) || !mask || (mask & (UINT64_C(1) << prio)))
+        return prio;
+
+    // Nearest allowed priority, preferring the lower one on ties
+    for (int dist = 1; dist < 0x40; dist++) {
+        if (prio + dist < 0x40 && (mask & (UINT64_C(1) << (prio + dist))))
+            return prio + dist;
+        if (prio - dist >= 0 && (mask & (UINT64_C(1) << (prio - dist))))
+            return prio - dist;
+    }
+
+    return prio;
+}
+
+static int _threadPickLeastLoadedCore(u64 mask) {
+    int best = -1;
+    u32 best_load = UINT32_MAX;
+
+    for (int core = 0; core < THREAD_NUM_CORES; core++) {
+        u32 load = __atomic_load_n(&g_threadCoreLoad[core], __ATOMIC_RELAXED);
+        if ((mask & BIT(core)) && load < best_load) {
+            best = core;
+            best_load = load;
+        }
+    }
+
+    return best;
+}
+
+static Result _threadResolveAffinity(int* cpuid, u64* affinity_mask) {
+    u64 process_mask = 0;
+    Result rc = svcGetInfo(&process_mask, InfoType_CoreMask, CUR_PROCESS_HANDLE, 0);
+    if (R_FAILED(rc))
+        return rc;
+
+    u64 mask = *affinity_mask ? *affinity_mask & process_mask : process_mask;
+    if (*cpuid == THREAD_CORE_LEAST_LOADED)
+        *cpuid = _threadPickLeastLoadedCore(mask);
+
+    if (!mask || *cpuid == -1 || (*cpuid >= 0 && !(mask & BIT(*cpuid))))
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    *affinity_mask = mask;
+    return 0;
+}
+
+Result threadCreateWithPolicy(
+    Thread* t, ThreadFunc entry, void* arg, void *stack_mem, size_t stack_sz,
+    ThreadPriorityClass prio_class, int cpuid, u64 affinity_mask)
+{
+    bool restricted = affinity_mask != 0;
+    Result rc = _threadResolveAffinity(&cpuid, &affinity_mask);
+    if (R_FAILED(rc))
+        return rc;
+
+    rc = threadCreate(t, entry, arg, stack_mem, stack_sz, threadGetPriorityForClass(prio_class), cpuid);
+
+    // Threads created on a core are restricted to it, widen that to the requested mask
+    if (R_SUCCEEDED(rc) && cpuid >= 0 && affinity_mask != BIT(cpuid)) {
+        rc = svcSetThreadCoreMask(t->handle, cpuid, (u32)affinity_mask);
+        if (R_FAILED(rc))
+            threadClose(t);
+    }
+
+    // Threads created on the default core can run on the whole process mask, narrow that to the requested one without a preferred core
+    if (R_SUCCEEDED(rc) && cpuid < 0 && restricted) {
+        rc = svcSetThreadCoreMask(t->handle, -1, (u32)affinity_mask);
+        if (R_FAILED(rc))
+            threadClose(t);
+    }
+
+    return rc;
+}
+
+Result threadSetAffinity(Thread* t, int preferred_core, u64 affinity_mask) {
+    Result rc = _threadResolveAffinity(&preferred_core, &affinity_mask);
+    if (R_SUCCEEDED(rc) && preferred_core < 0)
+        rc = MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    if (R_SUCCEEDED(rc))
+        rc = svcSetThreadCoreMask(t->handle, preferred_core, (u32)affinity_mask);
+
+    if (R_SUCCEEDED(rc) && preferred_core != t->core_id) {
+        if (t->core_id >= 0)
+            __atomic_sub_fetch(&g_threadCoreLoad[t->core_id], 1, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&g_threadCoreLoad[preferred_core], 1, __ATOMIC_RELAXED);
+        t->core_id = preferred_core;
+    }
+
+    return rc;
+}
+
 Result threadStart(Thread* t) {
     return svcStartThread(t->handle);
 }
@@ -205,7 +377,17 @@ Result threadClose(Thread* t) {
     const size_t reent_sz = (sizeof(struct _reent)+0xF) &~ 0xF;
     const size_t aligned_stack_sz = (t->stack_sz + sizeof(ThreadEntryArgs) + tls_sz + reent_sz + 0xFFF) & ~0xFFF;
 
-    rc = svcUnmapMemory(t->stack_mirror, t->stack_mem, aligned_stack_sz);
+    // Keep the stack mapped for the next threadCreate, if there's room in the cache
+    bool cached = t->owns_stack_mem && _threadStackCachePut(aligned_stack_sz, t->stack_mem, t->stack_mirror);
+    rc = cached ? 0 : svcUnmapMemory(t->stack_mirror, t->stack_mem, aligned_stack_sz);
+
+    if (R_SUCCEEDED(rc) && t->core_id >= 0)
+        __atomic_sub_fetch(&g_threadCoreLoad[t->core_id], 1, __ATOMIC_RELAXED);
+
+    if (cached) {
+        svcCloseHandle(t->handle);
+        return 0;
+    }
 
     if (R_SUCCEEDED(rc)) {
         virtmemFreeStack(t->stack_mirror, aligned_stack_sz);
@@ -218,6 +400,20 @@ Result threadClose(Thread* t) {
     return rc;
 }
 
+void threadStackCacheFlush(void) {
+    mutexLock(&g_threadMutex);
+    for (u32 i = 0; i < g_threadStackCacheCount; i++) {
+        ThreadStackCacheEntry* e = &g_threadStackCache[i];
+        if (R_SUCCEEDED(svcUnmapMemory(e->stack_mirror, e->stack_mem, e->size))) {
+            virtmemFreeStack(e->stack_mirror, e->size);
+            free(e->stack_mem);
+        }
+    }
+    g_threadStackCacheCount = 0;
+    g_threadStackCacheBytes = 0;
+    mutexUnlock(&g_threadMutex);
+}
+
 Result threadPause(Thread* t) {
     return svcSetThreadActivity(t->handle, 1);
 }
@@ -239,7 +435,7 @@ s32 threadTlsAlloc(void (* destructor)(void*)) {
     u64 new_mask;
     u64 cur_mask = __atomic_load_n(&g_tlsUsageMask, __ATOMIC_SEQ_CST);
     do {
-        slot_id = __builtin_ffs(~cur_mask)-1;
+        slot_id = __builtin_ffsll(~cur_mask)-1;
         if (slot_id < 0 || slot_id >= NUM_TLS_SLOTS) return -1;
         new_mask = cur_mask | (UINT64_C(1) << slot_id);
     } while (!__atomic_compare_exchange_n(&g_tlsUsageMask, &cur_mask, new_mask, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST));
@@ -247,24 +443,17 @@ s32 threadTlsAlloc(void (* destructor)(void*)) {
     threadTlsSet(slot_id, NULL);
     mutexLock(&g_threadMutex);
     for (Thread *t = g_threadList; t; t = t->next)
-        t->tls_array[slot_id] = NULL;
+        *_threadTlsSlot(t->tls_array, slot_id) = NULL;
     mutexUnlock(&g_threadMutex);
 
     g_tlsDestructors[slot_id] = destructor;
+    if (destructor)
+        __atomic_or_fetch(&g_tlsDestructorMask, UINT64_C(1) << slot_id, __ATOMIC_SEQ_CST);
     return slot_id;
 }
 
-void* threadTlsGet(s32 slot_id) {
-    void** tls_array = (void**)((u8*)armGetTls() + USER_TLS_BEGIN);
-    return tls_array[slot_id];
-}
-
-void threadTlsSet(s32 slot_id, void* value) {
-    void** tls_array = (void**)((u8*)armGetTls() + USER_TLS_BEGIN);
-    tls_array[slot_id] = value;
-}
-
 void threadTlsFree(s32 slot_id) {
+    __atomic_and_fetch(&g_tlsDestructorMask, ~(UINT64_C(1) << slot_id), __ATOMIC_SEQ_CST);
     g_tlsDestructors[slot_id] = NULL;
 
     u64 new_mask;
@@ -0,0 +1,241 @@
+#include "result.h"
+#include "arm/counter.h"
+#include "kernel/svc.h"
+#include "kernel/timer_wheel.h"
+#include "wait.h"
+
+#define TIMER_WHEEL_SLOT_MASK (TIMER_WHEEL_SLOTS - 1)
+#define TIMER_WHEEL_LEVEL_READY 0xFF
+
+static bool _timerWheelBeginWait(Waitable* ww, WaiterNode* w, u64 cur_tick, u64* next_tick);
+static Result _timerWheelOnTimeout(Waitable* ww, u64 old_tick);
+static Result _timerWheelOnSignal(Waitable* ww);
+
+static const WaitableMethods g_timerWheelVt = {
+    .beginWait = _timerWheelBeginWait,
+    .onTimeout = _timerWheelOnTimeout,
+    .onSignal = _timerWheelOnSignal,
+};
+
+static inline u64 _timerWheelLevelShift(u32 level)
+{
+    return level * TIMER_WHEEL_SLOT_BITS;
+}
+
+static void _timerWheelLink(TimerWheelEntry** head, TimerWheelEntry* e)
+{
+    e->next = *head;
+    if (e->next)
+        e->next->pprev = &e->next;
+    *head = e;
+    e->pprev = head;
+}
+
+static void _timerWheelUnlink(TimerWheel* w, TimerWheelEntry* e)
+{
+    *e->pprev = e->next;
+    if (e->next)
+        e->next->pprev = e->pprev;
+    e->pprev = NULL;
+
+    if (e->level != TIMER_WHEEL_LEVEL_READY && !w->slots[e->level][e->slot])
+        w->occupied[e->level] &= ~(UINT64_C(1) << e->slot);
+}
+
+static void _timerWheelInsert(TimerWheel* w, TimerWheelEntry* e)
+{
+    u64 expiry = e->expiry < w->now ? w->now : e->expiry;
+    u64 delta = expiry - w->now;
+    u32 level = 0;
+
+    while (level + 1 < TIMER_WHEEL_LEVELS && delta >> _timerWheelLevelShift(level + 1))
+        level++;
+
+    // Timers beyond the range of the top level are re-cascaded until they're in range
+    if (delta >> _timerWheelLevelShift(TIMER_WHEEL_LEVELS))
+        expiry = w->now + (UINT64_C(1) << _timerWheelLevelShift(TIMER_WHEEL_LEVELS)) - 1;
+
+    u32 slot = (expiry >> _timerWheelLevelShift(level)) & TIMER_WHEEL_SLOT_MASK;
+    e->level = level;
+    e->slot = slot;
+    _timerWheelLink(&w->slots[level][slot], e);
+    w->occupied[level] |= UINT64_C(1) << slot;
+}
+
+// Gets the next wheel tick at which a slot needs to be expired or cascaded, UINT64_MAX if none.
+static u64 _timerWheelNextEvent(TimerWheel* w)
+{
+    u64 next = UINT64_MAX;
+
+    for (u32 level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        u64 mask = w->occupied[level];
+        if (!mask)
+            continue;
+
+        // First slot boundary at or after now, then the first occupied slot from there
+        u64 shift = _timerWheelLevelShift(level);
+        u64 pos = (w->now + (UINT64_C(1) << shift) - 1) >> shift;
+        u32 rot = pos & TIMER_WHEEL_SLOT_MASK;
+        u64 rotated = rot ? (mask >> rot) | (mask << (TIMER_WHEEL_SLOTS - rot)) : mask;
+        u64 tick = (pos + __builtin_ctzll(rotated)) << shift;
+
+        if (tick < next)
+            next = tick;
+    }
+
+    return next;
+}
+
+// Processes wheel ticks up to and including target, moving expired timers to the ready list.
+static void _timerWheelAdvance(TimerWheel* w, u64 target)
+{
+    while (w->now <= target) {
+        u64 t = w->now;
+
+        // Cascade the higher level slots starting at this tick
+        for (u32 level = 1; level < TIMER_WHEEL_LEVELS && !(t & ((UINT64_C(1) << _timerWheelLevelShift(level)) - 1)); level++) {
+            u32 slot = (t >> _timerWheelLevelShift(level)) & TIMER_WHEEL_SLOT_MASK;
+            TimerWheelEntry* e = w->slots[level][slot];
+            w->slots[level][slot] = NULL;
+            w->occupied[level] &= ~(UINT64_C(1) << slot);
+
+            while (e) {
+                TimerWheelEntry* next = e->next;
+                _timerWheelInsert(w, e);
+                e = next;
+            }
+        }
+
+        // Expire this tick's slot
+        TimerWheelEntry** head = &w->slots[0][t & TIMER_WHEEL_SLOT_MASK];
+        while (*head) {
+            TimerWheelEntry* e = *head;
+            _timerWheelUnlink(w, e);
+            e->level = TIMER_WHEEL_LEVEL_READY;
+            _timerWheelLink(&w->ready, e);
+        }
+
+        // Skip the ticks with nothing to do
+        u64 next = t + 1;
+        u64 event = _timerWheelNextEvent(w);
+        if (event > next)
+            next = event > target ? target + 1 : event;
+        w->now = next;
+    }
+}
+
+static u64 _timerWheelTickFromSystem(TimerWheel* w, u64 tick)
+{
+    return tick < w->base_tick ? 0 : (tick - w->base_tick) / w->resolution;
+}
+
+void timerWheelCreate(TimerWheel* w, u64 resolution)
+{
+    *w = (TimerWheel){0};
+    _waitableInitialize(&w->waitable, &g_timerWheelVt);
+
+    w->base_tick = armGetSystemTick();
+    w->resolution = armNsToTicks(resolution);
+    if (!w->resolution)
+        w->resolution = 1;
+    w->armed = UINT64_MAX;
+}
+
+void timerWheelAdd(TimerWheel* w, TimerWheelEntry* e, u64 timeout, TimerWheelFunc func, void* arg)
+{
+    mutexLock(&w->waitable.mutex);
+
+    if (e->pprev)
+        _timerWheelUnlink(w, e);
+
+    // Round up, so that timers never fire early
+    u64 expiry_tick = armGetSystemTick() + armNsToTicks(timeout);
+    e->expiry = (expiry_tick - w->base_tick + w->resolution - 1) / w->resolution;
+    e->func = func;
+    e->arg = arg;
+    _timerWheelInsert(w, e);
+
+    // Waiters need to recompute their timeout if this timer fires before the one they wait for
+    if (e->expiry < w->armed) {
+        w->armed = UINT64_MAX;
+        _waitableSignalAllListeners(&w->waitable);
+    }
+
+    mutexUnlock(&w->waitable.mutex);
+}
+
+bool timerWheelCancel(TimerWheel* w, TimerWheelEntry* e)
+{
+    mutexLock(&w->waitable.mutex);
+
+    bool pending = e->pprev != NULL;
+    if (pending)
+        _timerWheelUnlink(w, e);
+
+    mutexUnlock(&w->waitable.mutex);
+    return pending;
+}
+
+u32 timerWheelProcess(TimerWheel* w)
+{
+    u32 count = 0;
+
+    mutexLock(&w->waitable.mutex);
+    _timerWheelAdvance(w, _timerWheelTickFromSystem(w, armGetSystemTick()));
+
+    while (w->ready) {
+        TimerWheelEntry* e = w->ready;
+        _timerWheelUnlink(w, e);
+
+        mutexUnlock(&w->waitable.mutex);
+        e->func(e, e->arg);
+        count++;
+        mutexLock(&w->waitable.mutex);
+    }
+
+    mutexUnlock(&w->waitable.mutex);
+    return count;
+}
+
+static bool _timerWheelBeginWait(Waitable* ww, WaiterNode* w, u64 cur_tick, u64* next_tick)
+{
+    TimerWheel* tw = (TimerWheel*)ww;
+    mutexLock(&tw->waitable.mutex);
+
+    _timerWheelAdvance(tw, _timerWheelTickFromSystem(tw, cur_tick));
+
+    // Already signalled if timers have expired
+    bool do_wait = !tw->ready;
+    if (do_wait) {
+        u64 event = _timerWheelNextEvent(tw);
+        if (event != UINT64_MAX)
+            *next_tick = tw->base_tick + event * tw->resolution - cur_tick;
+
+        tw->armed = event;
+        _waiterNodeAdd(w);
+    }
+
+    mutexUnlock(&tw->waitable.mutex);
+    return do_wait;
+}
+
+static Result _timerWheelOnTimeout(Waitable* ww, u64 old_tick)
+{
+    TimerWheel* tw = (TimerWheel*)ww;
+    mutexLock(&tw->waitable.mutex);
+
+    _timerWheelAdvance(tw, _timerWheelTickFromSystem(tw, old_tick));
+    tw->armed = UINT64_MAX;
+
+    // A wakeup for cascading only isn't a signal, retry the wait
+    Result rc = tw->ready ? 0 : KERNELRESULT(Cancelled);
+
+    mutexUnlock(&tw->waitable.mutex);
+    return rc;
+}
+
+static Result _timerWheelOnSignal(Waitable* ww)
+{
+    // An earlier timer was added, so we need to retry the wait.
+    return KERNELRESULT(Cancelled);
+}
@@ -6,8 +6,95 @@
 #include "kernel/svc.h"
 #include "kernel/tmem.h"
 #include "kernel/virtmem.h"
+#include "runtime/large_buffer.h"
+#include "kernel/mutex.h"
 #include "services/fatal.h"
 
+// Backing memory of closed transfer memory objects, reused by tmemCreate
+#define TMEM_CACHE_MAX_ENTRIES 8
+
+typedef struct {
+    void*  addr;
+    size_t size;
+} TmemCacheEntry;
+
+static Mutex g_tmemCacheMutex;
+static TmemCacheEntry g_tmemCache[TMEM_CACHE_MAX_ENTRIES];
+static u32 g_tmemCacheCount;
+static size_t g_tmemCacheBytes;
+
+/// Maximum total size of the backing memory kept for reuse after tmemClose, 0 to disable.
+__attribute__((weak)) size_t __nx_tmem_cache_size = 0x200000;
+
+// The kernel only gives the memory back once the transfer memory object is destroyed, i.e. the service closed its handle too.
+static bool _tmemIsReleased(void* addr)
+{
+    MemoryInfo info;
+    u32 pageinfo;
+
+    if (R_FAILED(svcQueryMemory(&info, &pageinfo, (u64)addr)))
+        return false;
+    return !(info.attr & MemAttr_IsBorrowed) && info.perm == Perm_Rw;
+}
+
+// Takes the smallest cached block which fits, wasting at most a quarter of it.
+static void* _tmemCacheTake(size_t size, size_t* out_size)
+{
+    void* addr = NULL;
+    s32 best = -1;
+
+    mutexLock(&g_tmemCacheMutex);
+    for (u32 i = 0; i < g_tmemCacheCount; i++) {
+        size_t cur = g_tmemCache[i].size;
+        if (cur >= size && cur - size <= cur / 4 && (best < 0 || cur < g_tmemCache[best].size) &&
+            _tmemIsReleased(g_tmemCache[i].addr))
+            best = i;
+    }
+    if (best >= 0) {
+        addr = g_tmemCache[best].addr;
+        *out_size = g_tmemCache[best].size;
+        g_tmemCacheBytes -= g_tmemCache[best].size;
+        g_tmemCache[best] = g_tmemCache[--g_tmemCacheCount];
+    }
+    mutexUnlock(&g_tmemCacheMutex);
+
+    return addr;
+}
+
+static bool _tmemCachePut(size_t size, void* addr)
+{
+    bool stored = false;
+
+    mutexLock(&g_tmemCacheMutex);
+    if (g_tmemCacheCount < TMEM_CACHE_MAX_ENTRIES && g_tmemCacheBytes + size <= __nx_tmem_cache_size) {
+        g_tmemCache[g_tmemCacheCount++] = (TmemCacheEntry){ addr, size };
+        g_tmemCacheBytes += size;
+        stored = true;
+    }
+    mutexUnlock(&g_tmemCacheMutex);
+
+    return stored;
+}
+
+void tmemCacheFlush(void)
+{
+    mutexLock(&g_tmemCacheMutex);
+
+    // Memory still borrowed by a service can't be freed yet, it's kept until a later flush.
+    u32 count = 0;
+    for (u32 i = 0; i < g_tmemCacheCount; i++) {
+        if (_tmemIsReleased(g_tmemCache[i].addr)) {
+            largeBufferFree(g_tmemCache[i].addr);
+            g_tmemCacheBytes -= g_tmemCache[i].size;
+        }
+        else
+            g_tmemCache[count++] = g_tmemCache[i];
+    }
+    g_tmemCacheCount = count;
+
+    mutexUnlock(&g_tmemCacheMutex);
+}
+
 Result tmemCreate(TransferMemory* t, size_t size, Permission perm)
 {
     Result rc = 0;
@@ -16,7 +103,12 @@ Result tmemCreate(TransferMemory* t, size_t size, Permission perm)
     t->size = size;
     t->perm = perm;
     t->map_addr = NULL;
-    t->src_addr = memalign(0x1000, size);
+    t->alloc_size = size;
+    t->src_addr = __nx_tmem_cache_size ? _tmemCacheTake(size, &t->alloc_size) : NULL;
+    if (t->src_addr == NULL) {
+        t->alloc_size = size;
+        t->src_addr = largeBufferAlloc(size);
+    }
 
     if (t->src_addr == NULL) {
         rc = MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
@@ -30,8 +122,9 @@ Result tmemCreate(TransferMemory* t, size_t size, Permission perm)
     }
 
     if (R_FAILED(rc)) {
-        free(t->src_addr);
+        largeBufferFree(t->src_addr);
         t->src_addr = NULL;
+        t->alloc_size = 0;
     }
 
     return rc;
@@ -50,6 +143,7 @@ Result tmemCreateFromMemory(TransferMemory* t, void* buf, size_t size, Permissio
     t->perm = perm;
     t->map_addr = NULL;
     t->src_addr = NULL;
+    t->alloc_size = 0;
 
     rc = svcCreateTransferMemory(&t->handle, buf, size, perm);
 
@@ -63,6 +157,7 @@ void tmemLoadRemote(TransferMemory* t, Handle handle, size_t size, Permission pe
     t->perm = perm;
     t->map_addr = NULL;
     t->src_addr = NULL;
+    t->alloc_size = 0;
 }
 
 Result tmemMap(TransferMemory* t)
@@ -116,11 +211,13 @@ Result tmemClose(TransferMemory* t)
             rc = svcCloseHandle(t->handle);
         }
 
-        if (t->src_addr != NULL) {
-            free(t->src_addr);
+        // Only memory allocated by tmemCreate is reused, src_addr may also be set by the caller.
+        if (t->src_addr != NULL && (t->alloc_size == 0 || !_tmemCachePut(t->alloc_size, t->src_addr))) {
+            largeBufferFree(t->src_addr);
         }
 
         t->src_addr = NULL;
+        t->alloc_size = 0;
         t->handle = INVALID_HANDLE;
     }
 
@@ -5,6 +5,9 @@
 #include "kernel/svc.h"
 #include "kernel/virtmem.h"
 
+// Maximum number of ranges tracked by the reservation trees.
+#define VIRTMEM_MAX_NODES 512
+
 typedef struct {
     u64  start;
     u64  end;
@@ -17,10 +20,48 @@ enum {
     REGION_MAX
 };
 
+enum {
+    NODE_RESERVED,  // Handed out by virtmemReserve*, removed by virtmemFree*.
+    NODE_KERNEL,    // Seen mapped by svcQueryMemory, only a cache: it may have been unmapped since.
+    NODE_REGION,    // Region which general purpose reservations must stay out of.
+};
+
+typedef struct VirtmemNode VirtmemNode;
+
+// AVL tree node of a range of address space known to be in use. Ranges in a tree never overlap.
+struct VirtmemNode {
+    u64 start;
+    u64 end;
+    VirtmemNode* left;
+    VirtmemNode* right;
+    u8 height;
+    u8 type;
+};
+
+// Address space reservations are searched in.
+typedef struct {
+    VirtualRegion* region;
+    u64 cursor;
+    VirtmemNode* root;
+} VirtmemSpace;
+
+enum {
+    SPACE_GENERAL=0,
+    SPACE_STACK=1,
+    SPACE_ALIAS=2,
+    SPACE_MAX
+};
+
 static VirtualRegion g_AddressSpace;
 static VirtualRegion g_Region[REGION_MAX];
-static u64 g_CurrentAddr;
-static u64 g_CurrentMapAddr;
+static VirtmemSpace g_Space[SPACE_MAX] = {
+    [SPACE_GENERAL] = { .region = &g_AddressSpace },
+    [SPACE_STACK]   = { .region = &g_Region[REGION_STACK] },
+    [SPACE_ALIAS]   = { .region = &g_Region[REGION_LEGACY_ALIAS] },
+};
+static VirtmemNode g_Nodes[VIRTMEM_MAX_NODES];
+static VirtmemNode* g_FreeNodes;
+static u32 g_NumNodesUsed;
 static Mutex g_VirtMemMutex;
 
 static Result _GetRegionFromInfo(VirtualRegion* r, u64 id0_addr, u32 id0_sz) {
@@ -40,9 +81,7 @@ static Result _GetRegionFromInfo(VirtualRegion* r, u64 id0_addr, u32 id0_sz) {
     return rc;
 }
 
-static inline bool _InRegion(VirtualRegion* r, u64 addr) {
-    return (addr >= r->start) && (addr < r->end);
-}
+static bool _InsertRange(VirtmemSpace* sp, u64 start, u64 end, u8 type);
 
 void virtmemSetup(void) {
     if (R_FAILED(_GetRegionFromInfo(&g_AddressSpace, InfoType_AslrRegionAddress, InfoType_AslrRegionSize))) {
@@ -84,128 +123,294 @@ void virtmemSetup(void) {
     }
 
     _GetRegionFromInfo(&g_Region[REGION_LEGACY_ALIAS], InfoType_AliasRegionAddress, InfoType_AliasRegionSize);
+
+    // General purpose reservations stay out of the special regions.
+    for (u32 i=0; i<REGION_MAX; i++) {
+        u64 start = g_Region[i].start > g_AddressSpace.start ? g_Region[i].start : g_AddressSpace.start;
+        u64 end   = g_Region[i].end   < g_AddressSpace.end   ? g_Region[i].end   : g_AddressSpace.end;
+
+        if (start < end)
+            _InsertRange(&g_Space[SPACE_GENERAL], start, end, NODE_REGION);
+    }
 }
 
-void* virtmemReserve(size_t size) {
-    Result rc;
-    MemoryInfo meminfo;
-    u32 pageinfo;
-    size_t i;
+static inline u8 _NodeHeight(VirtmemNode* n) {
+    return n ? n->height : 0;
+}
 
-    size = (size + 0xFFF) &~ 0xFFF;
+static void _NodeUpdate(VirtmemNode* n) {
+    u8 l = _NodeHeight(n->left), r = _NodeHeight(n->right);
+    n->height = (l > r ? l : r) + 1;
+}
 
-    mutexLock(&g_VirtMemMutex);
-    u64 addr = g_CurrentAddr;
+static VirtmemNode* _NodeRotateRight(VirtmemNode* n) {
+    VirtmemNode* l = n->left;
+    n->left = l->right;
+    l->right = n;
+    _NodeUpdate(n);
+    _NodeUpdate(l);
+    return l;
+}
 
-    while (1)
-    {
-        // Add a guard page.
-        addr += 0x1000;
+static VirtmemNode* _NodeRotateLeft(VirtmemNode* n) {
+    VirtmemNode* r = n->right;
+    n->right = r->left;
+    r->left = n;
+    _NodeUpdate(n);
+    _NodeUpdate(r);
+    return r;
+}
 
-        // If we go outside address space, let's go back to start.
-        if (!_InRegion(&g_AddressSpace, addr)) {
-            addr = g_AddressSpace.start;
-        }
-        // Query information about address.
-        rc = svcQueryMemory(&meminfo, &pageinfo, addr);
+static VirtmemNode* _NodeBalance(VirtmemNode* n) {
+    _NodeUpdate(n);
+    int bal = (int)_NodeHeight(n->left) - (int)_NodeHeight(n->right);
 
-        if (R_FAILED(rc)) {
-            fatalThrow(MAKERESULT(Module_Libnx, LibnxError_BadQueryMemory));
-        }
+    if (bal > 1) {
+        if (_NodeHeight(n->left->left) < _NodeHeight(n->left->right))
+            n->left = _NodeRotateLeft(n->left);
+        return _NodeRotateRight(n);
+    }
+    if (bal < -1) {
+        if (_NodeHeight(n->right->right) < _NodeHeight(n->right->left))
+            n->right = _NodeRotateRight(n->right);
+        return _NodeRotateLeft(n);
+    }
+    return n;
+}
 
-        if (meminfo.type != 0) {
-            // Address is already taken, let's move past it.
-            addr = meminfo.addr + meminfo.size;
-            continue;
-        }
+static VirtmemNode* _NodeInsert(VirtmemNode* root, VirtmemNode* n) {
+    if (!root)
+        return n;
 
-        if (addr + size > meminfo.addr + meminfo.size) {
-            // We can't fit in this region, let's move past it.
-            addr = meminfo.addr + meminfo.size;
-            continue;
-        }
+    if (n->start < root->start)
+        root->left = _NodeInsert(root->left, n);
+    else
+        root->right = _NodeInsert(root->right, n);
+    return _NodeBalance(root);
+}
 
-        // Check if we end up in a reserved region.
-        for(i=0; i<REGION_MAX; i++)
-        {
-            u64 end = addr + size - 1;
+static VirtmemNode* _NodeRemoveMin(VirtmemNode* root, VirtmemNode** out_min) {
+    if (!root->left) {
+        *out_min = root;
+        return root->right;
+    }
 
-            if (_InRegion(&g_Region[i], addr) || _InRegion(&g_Region[i], end)) {
-                break;
-            }
-        }
+    root->left = _NodeRemoveMin(root->left, out_min);
+    return _NodeBalance(root);
+}
 
-        // Did we?
-        if (i != REGION_MAX) {
-            addr = g_Region[i].end;
-            continue;
+static VirtmemNode* _NodeRemove(VirtmemNode* root, u64 start, u8 type, VirtmemNode** out_removed) {
+    if (!root)
+        return NULL;
+
+    if (start < root->start)
+        root->left = _NodeRemove(root->left, start, type, out_removed);
+    else if (start > root->start)
+        root->right = _NodeRemove(root->right, start, type, out_removed);
+    else if (root->type == type) {
+        *out_removed = root;
+        if (!root->right)
+            return root->left;
+
+        VirtmemNode* min;
+        VirtmemNode* right = _NodeRemoveMin(root->right, &min);
+        min->left = root->left;
+        min->right = right;
+        return _NodeBalance(min);
+    }
+    else
+        return root;
+
+    return _NodeBalance(root);
+}
+
+// Finds the lowest range ending past addr.
+static VirtmemNode* _NodeFindEndingAfter(VirtmemNode* n, u64 addr) {
+    VirtmemNode* found = NULL;
+
+    while (n) {
+        if (n->end > addr) {
+            found = n;
+            n = n->left;
         }
+        else
+            n = n->right;
+    }
 
-        // Not in a reserved region, we're good to go!
-        break;
+    return found;
+}
+
+static void _NodeFree(VirtmemNode* n) {
+    n->left = g_FreeNodes;
+    g_FreeNodes = n;
+}
+
+static void _DropKernelNodesFrom(VirtmemSpace* sp, VirtmemNode* n) {
+    if (!n)
+        return;
+
+    _DropKernelNodesFrom(sp, n->left);
+    _DropKernelNodesFrom(sp, n->right);
+
+    if (n->type == NODE_KERNEL)
+        _NodeFree(n);
+    else {
+        n->left = n->right = NULL;
+        n->height = 1;
+        sp->root = _NodeInsert(sp->root, n);
     }
+}
 
-    g_CurrentAddr = addr + size;
+// Forgets the mappings seen by svcQueryMemory, which may be stale.
+static void _DropKernelNodes(VirtmemSpace* sp) {
+    VirtmemNode* root = sp->root;
+    sp->root = NULL;
+    _DropKernelNodesFrom(sp, root);
+}
 
-    mutexUnlock(&g_VirtMemMutex);
-    return (void*) addr;
+static VirtmemNode* _NodeAlloc(void) {
+    VirtmemNode* n = g_FreeNodes;
+    if (n)
+        g_FreeNodes = n->left;
+    else if (g_NumNodesUsed < VIRTMEM_MAX_NODES)
+        n = &g_Nodes[g_NumNodesUsed++];
+    return n;
 }
 
-void  virtmemFree(void* addr, size_t size) {
-    IGNORE_ARG(addr);
-    IGNORE_ARG(size);
+// Tracks a range not overlapping any tracked range, returning false if out of nodes.
+static bool _InsertRange(VirtmemSpace* sp, u64 start, u64 end, u8 type) {
+    VirtmemNode* n = _NodeAlloc();
+
+    if (!n && type != NODE_KERNEL) {
+        // Make room by dropping cached kernel mappings.
+        for (u32 i=0; i<SPACE_MAX; i++)
+            _DropKernelNodes(&g_Space[i]);
+        n = _NodeAlloc();
+    }
+
+    if (!n)
+        return false;
+
+    n->start = start;
+    n->end = end;
+    n->left = n->right = NULL;
+    n->height = 1;
+    n->type = type;
+    sp->root = _NodeInsert(sp->root, n);
+    return true;
 }
 
-void* virtmemReserveStack(size_t size)
-{
-    Result rc;
+static void* _Reserve(VirtmemSpace* sp, size_t size) {
+    VirtualRegion* r = sp->region;
     MemoryInfo meminfo;
     u32 pageinfo;
+    Result rc;
 
     size = (size + 0xFFF) &~ 0xFFF;
 
+    if (!size || size > r->end - r->start)
+        return NULL;
+
     mutexLock(&g_VirtMemMutex);
-    u64 addr = g_CurrentMapAddr;
+    u64 addr = sp->cursor;
+    u32 passes = 0;
 
     while (1)
     {
         // Add a guard page.
         addr += 0x1000;
 
-        // Make sure we stay inside the reserved map region.
-        if (!_InRegion(&g_Region[REGION_STACK], addr)) {
-            addr = g_Region[REGION_STACK].start;
+        // If we go outside the space, let's go back to start. After a full pass, retry without the
+        // cached kernel mappings, then give up.
+        if (addr < r->start || addr >= r->end || size > r->end - addr) {
+            if (passes++ == 2) {
+                addr = 0;
+                break;
+            }
+            if (passes == 2)
+                _DropKernelNodes(sp);
+            addr = r->start;
+        }
+
+        // Skip past the tracked ranges in the way.
+        VirtmemNode* n = _NodeFindEndingAfter(sp->root, addr);
+        if (n && n->start < addr + size) {
+            addr = n->end;
+            continue;
         }
 
-        // Query information about address.
+        u64 gap_end = n ? n->start : r->end;
+
+        // The gap may have been mapped without going through virtmem, ask the kernel.
         rc = svcQueryMemory(&meminfo, &pageinfo, addr);
 
         if (R_FAILED(rc)) {
             fatalThrow(MAKERESULT(Module_Libnx, LibnxError_BadQueryMemory));
         }
 
+        u64 block_end = meminfo.addr + meminfo.size;
+
         if (meminfo.type != 0) {
-            // Address is already taken, let's move past it.
-            addr = meminfo.addr + meminfo.size;
+            // Address is already taken, remember it and move past it.
+            u64 end = block_end < gap_end ? block_end : gap_end;
+            _InsertRange(sp, addr, end, NODE_KERNEL);
+            addr = end;
             continue;
         }
 
-        if (addr + size > meminfo.addr + meminfo.size) {
-            // We can't fit in this region, let's move past it.
-            addr = meminfo.addr + meminfo.size;
+        if (addr + size > block_end) {
+            // We can't fit in this block, let's move past it.
+            addr = block_end;
             continue;
         }
 
+        // We're good to go!
         break;
     }
 
-    g_CurrentMapAddr = addr + size;
+    if (addr) {
+        // Out of nodes, the reservation is only protected by the cursor moving past it.
+        _InsertRange(sp, addr, addr + size, NODE_RESERVED);
+        sp->cursor = addr + size;
+    }
 
     mutexUnlock(&g_VirtMemMutex);
     return (void*) addr;
 }
 
+static void _Free(VirtmemSpace* sp, void* addr) {
+    VirtmemNode* removed = NULL;
+
+    mutexLock(&g_VirtMemMutex);
+    sp->root = _NodeRemove(sp->root, (u64)addr, NODE_RESERVED, &removed);
+    if (removed)
+        _NodeFree(removed);
+    mutexUnlock(&g_VirtMemMutex);
+}
+
+void* virtmemReserve(size_t size) {
+    return _Reserve(&g_Space[SPACE_GENERAL], size);
+}
+
+void virtmemFree(void* addr, size_t size) {
+    IGNORE_ARG(size);
+    _Free(&g_Space[SPACE_GENERAL], addr);
+}
+
+void* virtmemReserveStack(size_t size) {
+    return _Reserve(&g_Space[SPACE_STACK], size);
+}
+
 void virtmemFreeStack(void* addr, size_t size) {
-    IGNORE_ARG(addr);
     IGNORE_ARG(size);
+    _Free(&g_Space[SPACE_STACK], addr);
+}
+
+void* virtmemReserveAlias(size_t size) {
+    return _Reserve(&g_Space[SPACE_ALIAS], size);
+}
+
+void virtmemFreeAlias(void* addr, size_t size) {
+    IGNORE_ARG(size);
+    _Free(&g_Space[SPACE_ALIAS], addr);
 }
@@ -0,0 +1,288 @@
+#include <malloc.h>
+#include <string.h>
+#include "result.h"
+#include "arm/counter.h"
+#include "kernel/svc.h"
+#include "kernel/wait.h"
+#include "kernel/wait_set.h"
+
+static void _waitSetHelper(void* arg)
+{
+    WaitSetGroup* g = (WaitSetGroup*)arg;
+    WaitSet* ws = g->ws;
+    Waiter objects[MAX_WAIT_OBJECTS];
+    void* userdata[WAITSET_GROUP_SIZE];
+
+    for (;;) {
+        mutexLock(&ws->mutex);
+        if (ws->exiting) {
+            mutexUnlock(&ws->mutex);
+            break;
+        }
+
+        // While a report is pending, only wait to be resumed: the caller hasn't handled the object yet.
+        u32 count = g->reported ? 0 : g->count;
+        memcpy(objects, g->objects, count * sizeof(Waiter));
+        memcpy(userdata, g->userdata, count * sizeof(void*));
+        u32 generation = g->generation;
+        g->ack_generation = generation;
+        condvarWakeAll(&ws->ack_cv);
+        mutexUnlock(&ws->mutex);
+
+        s32 idx = -1;
+        objects[count] = waiterForUEvent(&g->control);
+        Result rc = waitObjects(&idx, objects, count + 1, UINT64_MAX);
+        if (R_SUCCEEDED(rc) && idx == count)
+            continue;
+
+        // Errors are reported too, so that the helper doesn't spin on e.g. a closed handle.
+        // The report is kept even if the objects changed meanwhile, as waiting may have cleared the object's signal.
+        mutexLock(&ws->mutex);
+        g->reported = true;
+        g->report_userdata = R_SUCCEEDED(rc) ? userdata[idx] : NULL;
+        g->report_generation = generation;
+        g->report_rc = rc;
+        ueventSignal(&ws->report);
+        mutexUnlock(&ws->mutex);
+    }
+}
+
+static bool _waitSetGroupContains(WaitSetGroup* g, void* userdata)
+{
+    for (u32 i = 0; i < g->count; i++)
+        if (g->userdata[i] == userdata)
+            return true;
+    return false;
+}
+
+static WaitSetGroup* _waitSetAddGroup(WaitSet* ws)
+{
+    WaitSetGroup** groups = (WaitSetGroup**)realloc(ws->groups, (ws->num_groups + 1) * sizeof(WaitSetGroup*));
+    if (!groups)
+        return NULL;
+    ws->groups = groups;
+
+    WaitSetGroup* g = (WaitSetGroup*)malloc(sizeof(WaitSetGroup));
+    if (!g)
+        return NULL;
+
+    memset(g, 0, sizeof(*g));
+    g->ws = ws;
+    ueventCreate(&g->control, true);
+
+    // The first group is waited on by the caller.
+    if (ws->num_groups) {
+        u32 prio = 0x2C;
+        svcGetThreadPriority(&prio, CUR_THREAD_HANDLE);
+
+        Result rc = threadCreate(&g->thread, _waitSetHelper, g, NULL, WAITSET_HELPER_STACK_SIZE, prio, -2);
+        if (R_SUCCEEDED(rc)) {
+            rc = threadStart(&g->thread);
+            if (R_FAILED(rc))
+                threadClose(&g->thread);
+        }
+
+        if (R_FAILED(rc)) {
+            free(g);
+            return NULL;
+        }
+    }
+
+    ws->groups[ws->num_groups++] = g;
+    return g;
+}
+
+void waitSetCreate(WaitSet* ws)
+{
+    memset(ws, 0, sizeof(*ws));
+    mutexInit(&ws->mutex);
+    condvarInit(&ws->ack_cv);
+    ueventCreate(&ws->report, true);
+}
+
+void waitSetClose(WaitSet* ws)
+{
+    mutexLock(&ws->mutex);
+    ws->exiting = true;
+    mutexUnlock(&ws->mutex);
+
+    for (u32 i = 0; i < ws->num_groups; i++) {
+        WaitSetGroup* g = ws->groups[i];
+        if (i) {
+            ueventSignal(&g->control);
+            threadWaitForExit(&g->thread);
+            threadClose(&g->thread);
+        }
+        free(g);
+    }
+
+    free(ws->groups);
+    ws->groups = NULL;
+    ws->num_groups = 0;
+    ws->num_objects = 0;
+}
+
+Result waitSetAdd(WaitSet* ws, Waiter w, void* userdata)
+{
+    Result rc = 0;
+    mutexLock(&ws->mutex);
+
+    WaitSetGroup* g = NULL;
+    for (u32 i = 0; i < ws->num_groups; i++) {
+        if (ws->groups[i]->count < WAITSET_GROUP_SIZE) {
+            g = ws->groups[i];
+            break;
+        }
+    }
+
+    if (!g)
+        g = _waitSetAddGroup(ws);
+
+    if (g) {
+        g->objects[g->count] = w;
+        g->userdata[g->count] = userdata;
+        g->count++;
+        g->generation++;
+        ws->num_objects++;
+
+        if (g != ws->groups[0])
+            ueventSignal(&g->control);
+    }
+    else
+        rc = MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+
+    mutexUnlock(&ws->mutex);
+    return rc;
+}
+
+bool waitSetRemove(WaitSet* ws, void* userdata)
+{
+    bool found = false;
+    mutexLock(&ws->mutex);
+
+    for (u32 i = 0; !found && i < ws->num_groups; i++) {
+        WaitSetGroup* g = ws->groups[i];
+
+        for (u32 j = 0; j < g->count; j++) {
+            if (g->userdata[j] != userdata)
+                continue;
+
+            g->count--;
+            g->objects[j] = g->objects[g->count];
+            g->userdata[j] = g->userdata[g->count];
+            g->generation++;
+            ws->num_objects--;
+            found = true;
+
+            // Wait for the helper to stop waiting on the removed object.
+            if (i) {
+                ueventSignal(&g->control);
+                while (g->ack_generation != g->generation)
+                    condvarWait(&ws->ack_cv, &ws->mutex);
+            }
+            break;
+        }
+    }
+
+    mutexUnlock(&ws->mutex);
+    return found;
+}
+
+Result waitSetWait(WaitSet* ws, void** userdata_out, u64 timeout)
+{
+    Waiter objects[MAX_WAIT_OBJECTS];
+    void* userdata[WAITSET_GROUP_SIZE];
+    bool has_timeout = timeout != UINT64_MAX;
+    u64 deadline = 0;
+    Result rc;
+
+    if (has_timeout)
+        deadline = armGetSystemTick() + armNsToTicks(timeout);
+
+    mutexLock(&ws->mutex);
+
+    // Objects reported by the previous call have been handled by now, so these helpers can wait on them again.
+    for (u32 i = 1; i < ws->num_groups; i++) {
+        WaitSetGroup* g = ws->groups[i];
+        if (g->resume) {
+            g->resume = false;
+            g->reported = false;
+            ueventSignal(&g->control);
+        }
+    }
+
+    for (;;) {
+        u32 num_pending = 0;
+        for (u32 i = 1; i < ws->num_groups; i++)
+            if (ws->groups[i]->reported && !ws->groups[i]->resume)
+                num_pending++;
+
+        // Take a pending report, starting from a different group each time so that no group starves another.
+        // The first group is only polled when it comes up in the rotation.
+        for (u32 k = 0; num_pending && k < ws->num_groups; k++) {
+            u32 i = (ws->next_report + k) % ws->num_groups;
+            WaitSetGroup* g = ws->groups[i];
+
+            if (i == 0) {
+                s32 idx;
+                memcpy(objects, g->objects, g->count * sizeof(Waiter));
+                if (g->count && R_SUCCEEDED(waitObjects(&idx, objects, g->count, 0))) {
+                    *userdata_out = g->userdata[idx];
+                    ws->next_report = 1;
+                    mutexUnlock(&ws->mutex);
+                    return 0;
+                }
+                continue;
+            }
+
+            if (!g->reported || g->resume)
+                continue;
+
+            // The objects changed since the report, so it may refer to a removed object.
+            if (g->report_generation != g->generation && !_waitSetGroupContains(g, g->report_userdata)) {
+                g->reported = false;
+                ueventSignal(&g->control);
+                continue;
+            }
+
+            rc = g->report_rc;
+            if (R_SUCCEEDED(rc))
+                *userdata_out = g->report_userdata;
+            g->resume = true;
+            ws->next_report = i + 1;
+            mutexUnlock(&ws->mutex);
+            return rc;
+        }
+
+        // Wait on the first group, and for helpers to report.
+        // The userdata is captured with the objects, as the group can change while the lock is released.
+        u32 count = ws->num_groups ? ws->groups[0]->count : 0;
+        if (count) {
+            memcpy(objects, ws->groups[0]->objects, count * sizeof(Waiter));
+            memcpy(userdata, ws->groups[0]->userdata, count * sizeof(void*));
+        }
+        objects[count] = waiterForUEvent(&ws->report);
+        mutexUnlock(&ws->mutex);
+
+        u64 this_timeout = UINT64_MAX;
+        if (has_timeout) {
+            s64 remaining = deadline - armGetSystemTick();
+            this_timeout = remaining > 0 ? armTicksToNs(remaining) : 0;
+        }
+
+        s32 idx;
+        rc = waitObjects(&idx, objects, count + 1, this_timeout);
+
+        mutexLock(&ws->mutex);
+        if (R_FAILED(rc))
+            break;
+
+        if (idx != count) {
+            *userdata_out = userdata[idx];
+            break;
+        }
+    }
+
+    mutexUnlock(&ws->mutex);
+    return rc;
+}
@@ -0,0 +1,167 @@
+#include <malloc.h>
+#include <string.h>
+#include "types.h"
+#include "result.h"
+#include "services/nv.h"
+#include "nvidia/ioctl.h"
+#include "nvidia/map.h"
+#include "nvidia/address_space.h"
+#include "nvidia/fence.h"
+#include "nvidia/gpu_channel.h"
+#include "nvidia/cmd_ring.h"
+
+// Largest length of a GPFIFO entry, in words (bits 10..30 of the second word).
+#define GPFIFO_ENTRY_MAX_CMDS ((1u << 21) - 1)
+
+Result nvCmdRingCreate(NvCmdRing* r, NvGpuChannel* c, NvAddressSpace* as, u32 segment_size, u32 num_segments)
+{
+    Result rc;
+
+    segment_size = (segment_size + 0xFFF) &~ 0xFFF;
+    if (!segment_size || segment_size / 4 > GPFIFO_ENTRY_MAX_CMDS)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+    if (!num_segments || num_segments > NV_CMD_RING_MAX_SEGMENTS)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    memset(r, 0, sizeof(*r));
+    r->channel = c;
+    r->as = as;
+    r->segment_words = segment_size / 4;
+    r->num_segments = num_segments;
+
+    u32 size = segment_size * num_segments;
+    r->cpu_addr = (u32*)memalign(0x1000, size);
+    if (!r->cpu_addr)
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+
+    // Uncached on the CPU side, so that commands don't need to be flushed before kickoff.
+    rc = nvMapCreate(&r->map, r->cpu_addr, size, 0x1000, NvKind_Pitch, false);
+
+    if (R_SUCCEEDED(rc))
+        rc = nvAddressSpaceMap(as, nvMapGetHandle(&r->map), true, NvKind_Pitch, &r->gpu_addr);
+
+    if (R_FAILED(rc)) {
+        nvMapClose(&r->map);
+        free(r->cpu_addr);
+        r->cpu_addr = NULL;
+    }
+
+    return rc;
+}
+
+void nvCmdRingClose(NvCmdRing* r)
+{
+    if (!r->cpu_addr)
+        return;
+
+    nvCmdRingWaitIdle(r, -1);
+
+    if (r->gpu_addr)
+        nvAddressSpaceUnmap(r->as, r->gpu_addr);
+    nvMapClose(&r->map);
+    free(r->cpu_addr);
+    r->cpu_addr = NULL;
+}
+
+static inline u32* _nvCmdRingSegmentAddr(NvCmdRing* r, u32 segment)
+{
+    return r->cpu_addr + segment * r->segment_words;
+}
+
+static Result _nvCmdRingKickoff(NvCmdRing* r)
+{
+    NvCmdRingSegment* seg = &r->segments[r->cur_segment];
+
+    // Nothing appended since the last kickoff.
+    if (!r->channel->num_entries)
+        return 0;
+
+    // One syncpoint increment per kickoff tells when the GPU is done with the segment.
+    nvGpuChannelIncrFence(r->channel);
+    nvGpuChannelGetFence(r->channel, &seg->fence);
+
+    Result rc = nvGpuChannelKickoff(r->channel);
+    if (R_SUCCEEDED(rc))
+        seg->in_flight = true;
+    return rc;
+}
+
+static Result _nvCmdRingNextSegment(NvCmdRing* r)
+{
+    Result rc = nvCmdRingSubmit(r);
+    if (R_FAILED(rc))
+        return rc;
+
+    u32 next = (r->cur_segment + 1) % r->num_segments;
+    NvCmdRingSegment* seg = &r->segments[next];
+    if (seg->in_flight) {
+        rc = nvFenceWait(&seg->fence, -1);
+        if (R_FAILED(rc))
+            return rc;
+        seg->in_flight = false;
+    }
+
+    r->cur_segment = next;
+    r->cur_word = 0;
+    r->entry_word = 0;
+    return 0;
+}
+
+u32* nvCmdRingReserve(NvCmdRing* r, u32 num_words)
+{
+    if (!num_words || num_words > r->segment_words)
+        return NULL;
+
+    if (r->cur_word + num_words > r->segment_words) {
+        if (R_FAILED(_nvCmdRingNextSegment(r)))
+            return NULL;
+    }
+
+    r->reserved = num_words;
+    return _nvCmdRingSegmentAddr(r, r->cur_segment) + r->cur_word;
+}
+
+void nvCmdRingCommit(NvCmdRing* r, u32 num_words)
+{
+    if (num_words > r->reserved)
+        num_words = r->reserved;
+
+    r->cur_word += num_words;
+    r->reserved = 0;
+}
+
+Result nvCmdRingFlush(NvCmdRing* r)
+{
+    if (r->entry_word == r->cur_word)
+        return 0;
+
+    iova_t start = r->gpu_addr + ((iova_t)r->cur_segment * r->segment_words + r->entry_word) * 4;
+    Result rc = nvGpuChannelAppendEntry(r->channel, start, r->cur_word - r->entry_word, 0, 0);
+    if (R_SUCCEEDED(rc))
+        r->entry_word = r->cur_word;
+    return rc;
+}
+
+Result nvCmdRingSubmit(NvCmdRing* r)
+{
+    Result rc = nvCmdRingFlush(r);
+    if (R_SUCCEEDED(rc))
+        rc = _nvCmdRingKickoff(r);
+    return rc;
+}
+
+Result nvCmdRingWaitIdle(NvCmdRing* r, s32 timeout_us)
+{
+    for (u32 i = 0; i < r->num_segments; i++) {
+        NvCmdRingSegment* seg = &r->segments[i];
+        if (!seg->in_flight)
+            continue;
+
+        Result rc = nvFenceWait(&seg->fence, timeout_us);
+        if (R_FAILED(rc))
+            return rc;
+        seg->in_flight = false;
+    }
+
+    return 0;
+}
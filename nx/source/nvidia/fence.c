@@ -3,6 +3,9 @@
 #include "arm/atomics.h"
 #include "kernel/svc.h"
 #include "kernel/event.h"
+#include "kernel/mutex.h"
+#include "kernel/condvar.h"
+#include "kernel/wait.h"
 #include "runtime/hosversion.h"
 #include "services/nv.h"
 #include "nvidia/fence.h"
@@ -10,8 +13,15 @@
 static u32 g_ctrl_fd = -1;
 static u64 g_refCnt;
 
+// Events stay registered once used, so slots are reused without any registration ioctl.
 static u64 g_NvEventUsedMask;
 static Event g_NvEvents[64];
+static Event g_NvSignalledEvent;
+
+// Waiters for a slot when all of them are in use.
+static Mutex g_NvEventSlotMutex;
+static CondVar g_NvEventSlotCondVar;
+static u32 g_NvEventSlotWaiters;
 
 static int _nvGetEventSlot(void)
 {
@@ -27,6 +37,22 @@ static int _nvGetEventSlot(void)
     return slot;
 }
 
+static int _nvAcquireEventSlot(void)
+{
+    int slot = _nvGetEventSlot();
+    if (slot >= 0)
+        return slot;
+
+    mutexLock(&g_NvEventSlotMutex);
+    __atomic_add_fetch(&g_NvEventSlotWaiters, 1, __ATOMIC_SEQ_CST);
+    while ((slot = _nvGetEventSlot()) < 0)
+        condvarWait(&g_NvEventSlotCondVar, &g_NvEventSlotMutex);
+    __atomic_sub_fetch(&g_NvEventSlotWaiters, 1, __ATOMIC_SEQ_CST);
+    mutexUnlock(&g_NvEventSlotMutex);
+
+    return slot;
+}
+
 static void _nvFreeEventSlot(int slot)
 {
     u64 new_mask;
@@ -34,14 +60,23 @@ static void _nvFreeEventSlot(int slot)
     do
         new_mask = cur_mask &~ ((u64)1 << slot);
     while (!__atomic_compare_exchange_n(&g_NvEventUsedMask, &cur_mask, new_mask, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST));
+
+    if (__atomic_load_n(&g_NvEventSlotWaiters, __ATOMIC_SEQ_CST)) {
+        mutexLock(&g_NvEventSlotMutex);
+        condvarWakeOne(&g_NvEventSlotCondVar);
+        mutexUnlock(&g_NvEventSlotMutex);
+    }
 }
 
 static Event* _nvGetEvent(int event_id)
 {
     Result rc;
     Event* event = &g_NvEvents[event_id];
-    if (eventActive(event))
+    if (eventActive(event)) {
+        // A cancelled wait may have left it signalled.
+        eventClear(event);
         return event;
+    }
 
     rc = nvioctlNvhostCtrl_EventRegister(g_ctrl_fd, event_id);
     if (R_FAILED(rc))
@@ -75,6 +110,14 @@ Result nvFenceInit(void)
 
     rc = nvOpen(&g_ctrl_fd, "/dev/nvhost-ctrl");
 
+    if (R_SUCCEEDED(rc)) {
+        rc = eventCreate(&g_NvSignalledEvent, false);
+        if (R_SUCCEEDED(rc))
+            eventFire(&g_NvSignalledEvent);
+        else
+            nvClose(g_ctrl_fd);
+    }
+
     if (R_FAILED(rc))
         g_ctrl_fd = -1;
 
@@ -86,6 +129,7 @@ void nvFenceExit(void)
     if (atomicDecrement64(&g_refCnt) == 0) {
         for (int i = 0; i < 64; i ++)
             _nvFreeEvent(i);
+        eventClose(&g_NvSignalledEvent);
         if (g_ctrl_fd != -1)
             nvClose(g_ctrl_fd);
         g_ctrl_fd = -1;
@@ -108,16 +152,14 @@ static Result _nvFenceEventWaitCommon(Event* event, u32 event_id, s32 timeout_us
 static Result _nvFenceWait_200(NvFence* f, s32 timeout_us)
 {
     Result rc = MAKERESULT(Module_LibnxNvidia, LibnxNvidiaError_InsufficientMemory);
-    int event_id = _nvGetEventSlot();
-    if (event_id >= 0) {
-        Event* event = _nvGetEvent(event_id);
-        if (event) {
-            rc = nvioctlNvhostCtrl_EventWaitAsync(g_ctrl_fd, f->id, f->value, timeout_us, event_id);
-            if (rc == MAKERESULT(Module_LibnxNvidia, LibnxNvidiaError_Timeout))
-                rc = _nvFenceEventWaitCommon(event, 0x10000000 | event_id, timeout_us);
-        }
-        _nvFreeEventSlot(event_id);
+    int event_id = _nvAcquireEventSlot();
+    Event* event = _nvGetEvent(event_id);
+    if (event) {
+        rc = nvioctlNvhostCtrl_EventWaitAsync(g_ctrl_fd, f->id, f->value, timeout_us, event_id);
+        if (rc == MAKERESULT(Module_LibnxNvidia, LibnxNvidiaError_Timeout))
+            rc = _nvFenceEventWaitCommon(event, 0x10000000 | event_id, timeout_us);
     }
+    _nvFreeEventSlot(event_id);
     return rc;
 }
 
@@ -155,3 +197,82 @@ Result nvMultiFenceWait(NvMultiFence* mf, s32 timeout_us)
     }
     return rc;
 }
+
+Result nvFenceEventCreate(NvFenceEvent* e, const NvFence* f)
+{
+    e->fence = *f;
+    e->event_id = -1;
+
+    if (!hosversionAtLeast(2,0,0))
+        return MAKERESULT(Module_Libnx, LibnxError_IncompatSysVer);
+
+    // Not waiting for a slot here, as the caller may already be holding others.
+    int event_id = _nvGetEventSlot();
+    if (event_id < 0)
+        return MAKERESULT(Module_LibnxNvidia, LibnxNvidiaError_InsufficientMemory);
+
+    Result rc = MAKERESULT(Module_LibnxNvidia, LibnxNvidiaError_InsufficientMemory);
+    if (_nvGetEvent(event_id))
+        rc = nvioctlNvhostCtrl_EventWaitAsync(g_ctrl_fd, f->id, f->value, -1, event_id);
+
+    // Timeout means the wait is pending, success that the fence was already reached.
+    if (rc == MAKERESULT(Module_LibnxNvidia, LibnxNvidiaError_Timeout)) {
+        e->event_id = event_id;
+        return 0;
+    }
+
+    _nvFreeEventSlot(event_id);
+    return rc;
+}
+
+void nvFenceEventClose(NvFenceEvent* e)
+{
+    if (e->event_id < 0)
+        return;
+
+    nvioctlNvhostCtrl_EventSignal(g_ctrl_fd, 0x10000000 | e->event_id);
+    _nvFreeEventSlot(e->event_id);
+    e->event_id = -1;
+}
+
+Waiter waiterForNvFenceEvent(NvFenceEvent* e)
+{
+    return waiterForEvent(e->event_id >= 0 ? &g_NvEvents[e->event_id] : &g_NvSignalledEvent);
+}
+
+Result nvFenceWaitAny(const NvFence* fences, s32 num_fences, s32 timeout_us, s32* idx_out)
+{
+    NvFenceEvent events[MAX_WAIT_OBJECTS];
+    Waiter waiters[MAX_WAIT_OBJECTS];
+    Result rc = 0;
+    s32 i;
+
+    if (num_fences <= 0 || num_fences > MAX_WAIT_OBJECTS)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    for (i = 0; i < num_fences; i ++) {
+        rc = nvFenceEventCreate(&events[i], &fences[i]);
+        if (R_FAILED(rc))
+            break;
+        if (events[i].event_id < 0) {
+            // Already reached, no need to wait.
+            *idx_out = i++;
+            break;
+        }
+        waiters[i] = waiterForNvFenceEvent(&events[i]);
+    }
+
+    if (R_SUCCEEDED(rc) && i == num_fences && events[num_fences-1].event_id >= 0) {
+        u64 timeout_ns = U64_MAX;
+        if (timeout_us >= 0)
+            timeout_ns = (u64)1000*timeout_us;
+        rc = waitObjects(idx_out, waiters, num_fences, timeout_ns);
+        if ((rc & 0x3FFFFF) == 0xEA01) // timeout
+            rc = MAKERESULT(Module_LibnxNvidia, LibnxNvidiaError_Timeout);
+    }
+
+    while (i--)
+        nvFenceEventClose(&events[i]);
+
+    return rc;
+}
@@ -3,6 +3,7 @@
 #include "result.h"
 #include "arm/atomics.h"
 #include "kernel/svc.h"
+#include "kernel/mutex.h"
 #include "services/nv.h"
 #include "nvidia/ioctl.h"
 #include "nvidia/gpu.h"
@@ -18,6 +19,18 @@ static u32 g_zcull_ctx_size;
 static nvioctl_zcull_info g_zcull_info;
 static u32 g_tpc_masks[NUM_TPC_MASKS];
 
+// The ZBC table has 16 color and 16 depth entries shared by the whole GPU, the first ones being
+// loaded by the driver with transparent black, opaque black, opaque white, and depths 1.0 and 0.0.
+#define ZBC_TABLE_SIZE          16
+#define ZBC_COLOR_FMT_A8B8G8R8  0x28
+#define ZBC_DEPTH_FMT_FP32      1
+
+static Mutex g_zbc_mutex;
+static u32 g_zbc_colors[ZBC_TABLE_SIZE];
+static u32 g_zbc_num_colors;
+static float g_zbc_depths[ZBC_TABLE_SIZE];
+static u32 g_zbc_num_depths;
+
 Result nvGpuInit(void)
 {
     Result rc;
@@ -55,6 +68,8 @@ void nvGpuExit(void)
             nvClose(g_ctrlgpu_fd);
 
         g_ctrlgpu_fd = -1;
+        g_zbc_num_colors = 0;
+        g_zbc_num_depths = 0;
     }
 }
 
@@ -101,3 +116,78 @@ Result nvGpuZbcAddDepth(float depth)
     memcpy(&depth_int, &depth, sizeof(float));
     return nvioctlNvhostCtrlGpu_ZbcSetTable(g_ctrlgpu_fd, NULL, NULL, depth_int, 1, NVGPU_ZBC_TYPE_DEPTH);
 }
+
+static Result _nvGpuZbcCheckFree(void)
+{
+    u32 mask = 0;
+    Result rc = nvGpuZbcGetActiveSlotMask(NULL, &mask);
+    if (R_SUCCEEDED(rc) && __builtin_popcount(mask) >= ZBC_TABLE_SIZE)
+        rc = MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+    return rc;
+}
+
+Result nvGpuZbcRegisterClearColor(u32 rgba8)
+{
+    if (rgba8 == 0 || rgba8 == 0xFF000000 || rgba8 == 0xFFFFFFFF)
+        return 0;
+
+    Result rc = 0;
+    mutexLock(&g_zbc_mutex);
+
+    for (u32 i = 0; i < g_zbc_num_colors; i ++)
+        if (g_zbc_colors[i] == rgba8)
+            goto _done;
+
+    if (g_zbc_num_colors == ZBC_TABLE_SIZE) {
+        rc = MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+        goto _done;
+    }
+
+    rc = _nvGpuZbcCheckFree();
+    if (R_SUCCEEDED(rc)) {
+        // The DS value is the clear color as floats, the L2 one the packed pixel.
+        u32 color_ds[4], color_l2[4] = { rgba8, 0, 0, 0 };
+        for (u32 i = 0; i < 4; i ++) {
+            float comp = ((rgba8 >> (8*i)) & 0xFF) / 255.0f;
+            memcpy(&color_ds[i], &comp, sizeof(float));
+        }
+
+        rc = nvGpuZbcAddColor(color_l2, color_ds, ZBC_COLOR_FMT_A8B8G8R8);
+    }
+
+    if (R_SUCCEEDED(rc))
+        g_zbc_colors[g_zbc_num_colors++] = rgba8;
+
+_done:
+    mutexUnlock(&g_zbc_mutex);
+    return rc;
+}
+
+Result nvGpuZbcRegisterClearDepth(float depth)
+{
+    if (depth == 0.0f || depth == 1.0f)
+        return 0;
+
+    Result rc = 0;
+    mutexLock(&g_zbc_mutex);
+
+    for (u32 i = 0; i < g_zbc_num_depths; i ++)
+        if (g_zbc_depths[i] == depth)
+            goto _done;
+
+    if (g_zbc_num_depths == ZBC_TABLE_SIZE) {
+        rc = MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+        goto _done;
+    }
+
+    rc = _nvGpuZbcCheckFree();
+    if (R_SUCCEEDED(rc))
+        rc = nvGpuZbcAddDepth(depth);
+
+    if (R_SUCCEEDED(rc))
+        g_zbc_depths[g_zbc_num_depths++] = depth;
+
+_done:
+    mutexUnlock(&g_zbc_mutex);
+    return rc;
+}
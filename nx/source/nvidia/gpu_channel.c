@@ -11,6 +11,9 @@
 #include "nvidia/fence.h"
 #include "nvidia/gpu_channel.h"
 
+#define GPFIFO_BUSY_BACKOFF_MIN_US 100
+#define GPFIFO_BUSY_BACKOFF_MAX_US 6400
+
 Result nvGpuChannelCreate(NvGpuChannel* c, struct NvAddressSpace* as)
 {
     Result res;
@@ -103,13 +106,28 @@ Result nvGpuChannelKickoff(NvGpuChannel* c)
     if (c->fence_incr)
         flags |= BIT(8);
 
+    // The GPFIFO being full is transient: wait for the GPU to get through the work already submitted,
+    // up to an exponentially growing delay, then retry.
     Result res;
+    s32 backoff_us = GPFIFO_BUSY_BACKOFF_MIN_US;
+    bool fence_reached = false;
     for (;;)
     {
         res = _nvGpuChannelKickoffRaw(c, flags);
         if (res != MAKERESULT(Module_LibnxNvidia, LibnxNvidiaError_Busy))
             break;
-        svcSleepThread(100000000);
+
+        Result wait_res = MAKERESULT(Module_Libnx, LibnxError_NotInitialized);
+        if (!fence_reached)
+            wait_res = nvFenceWait(&c->fence, backoff_us);
+
+        if (R_SUCCEEDED(wait_res))
+            fence_reached = true;
+        else if (wait_res != MAKERESULT(Module_LibnxNvidia, LibnxNvidiaError_Timeout))
+            svcSleepThread((u64)backoff_us * 1000); // Nothing left to wait for, or fences unavailable.
+
+        if (backoff_us < GPFIFO_BUSY_BACKOFF_MAX_US)
+            backoff_us *= 2;
     }
 
     if (R_SUCCEEDED(res)) {
@@ -0,0 +1,243 @@
+#include <stdlib.h>
+#include <string.h>
+#include "types.h"
+#include "result.h"
+#include "kernel/mutex.h"
+#include "runtime/large_buffer.h"
+#include "nvidia/map.h"
+#include "nvidia/address_space.h"
+#include "nvidia/heap.h"
+
+static void _nvHeapBlockDestroy(NvHeap* h, NvHeapBlock* b)
+{
+    if (b->iova)
+        nvAddressSpaceUnmap(h->as, b->iova);
+    nvMapClose(&b->map);
+    largeBufferFree(b->cpu_addr);
+    free(b->free);
+    free(b);
+}
+
+static NvHeapBlock* _nvHeapBlockCreate(NvHeap* h, u32 size, NvKind kind, bool is_cpu_cacheable, Result* rc_out)
+{
+    Result rc = MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+    NvHeapBlock* b = (NvHeapBlock*)calloc(1, sizeof(NvHeapBlock));
+    if (!b)
+        goto _fail;
+
+    b->size = size;
+    b->kind = kind;
+    b->is_cpu_cacheable = is_cpu_cacheable;
+    b->max_free = 8;
+    b->free = (NvHeapRange*)malloc(b->max_free * sizeof(NvHeapRange));
+    b->cpu_addr = largeBufferAlloc(size);
+    if (!b->free || !b->cpu_addr)
+        goto _fail;
+
+    b->num_free = 1;
+    b->free[0].offset = 0;
+    b->free[0].size = size;
+
+    rc = nvMapCreate(&b->map, b->cpu_addr, size, 0x1000, kind, is_cpu_cacheable);
+    if (R_SUCCEEDED(rc))
+        rc = nvAddressSpaceMap(h->as, nvMapGetHandle(&b->map), true, kind, &b->iova);
+    if (R_FAILED(rc))
+        goto _fail;
+
+    return b;
+
+_fail:
+    if (b)
+        _nvHeapBlockDestroy(h, b);
+    *rc_out = rc;
+    return NULL;
+}
+
+// First fit, returns the offset or -1.
+static s64 _nvHeapBlockAlloc(NvHeapBlock* b, u32 size, u32 align)
+{
+    for (u32 i = 0; i < b->num_free; i++) {
+        NvHeapRange* r = &b->free[i];
+        u32 start = (r->offset + align - 1) &~ (align - 1);
+        if (start - r->offset + (u64)size > r->size)
+            continue;
+
+        u32 end = start + size;
+        u32 range_end = r->offset + r->size;
+
+        if (start == r->offset) {
+            r->offset = end;
+            r->size = range_end - end;
+            if (!r->size) {
+                memmove(r, r + 1, (b->num_free - i - 1) * sizeof(NvHeapRange));
+                b->num_free--;
+            }
+        }
+        else if (end == range_end)
+            r->size = start - r->offset;
+        else {
+            // Split the range in two around the allocation.
+            if (b->num_free == b->max_free) {
+                NvHeapRange* ranges = (NvHeapRange*)realloc(b->free, 2 * b->max_free * sizeof(NvHeapRange));
+                if (!ranges)
+                    return -1;
+                b->free = ranges;
+                b->max_free *= 2;
+                r = &b->free[i];
+            }
+            memmove(r + 2, r + 1, (b->num_free - i - 1) * sizeof(NvHeapRange));
+            b->num_free++;
+            r[1].offset = end;
+            r[1].size = range_end - end;
+            r->size = start - r->offset;
+        }
+
+        b->used += size;
+        return start;
+    }
+
+    return -1;
+}
+
+static bool _nvHeapBlockFree(NvHeapBlock* b, u32 offset, u32 size)
+{
+    u32 pos = 0;
+    while (pos < b->num_free && b->free[pos].offset < offset)
+        pos++;
+
+    bool merge_prev = pos > 0 && b->free[pos-1].offset + b->free[pos-1].size == offset;
+    bool merge_next = pos < b->num_free && offset + size == b->free[pos].offset;
+
+    if (merge_prev && merge_next) {
+        b->free[pos-1].size += size + b->free[pos].size;
+        memmove(&b->free[pos], &b->free[pos+1], (b->num_free - pos - 1) * sizeof(NvHeapRange));
+        b->num_free--;
+    }
+    else if (merge_prev)
+        b->free[pos-1].size += size;
+    else if (merge_next) {
+        b->free[pos].offset = offset;
+        b->free[pos].size += size;
+    }
+    else {
+        if (b->num_free == b->max_free) {
+            NvHeapRange* ranges = (NvHeapRange*)realloc(b->free, 2 * b->max_free * sizeof(NvHeapRange));
+            if (!ranges)
+                return false; // Leaked until the heap is closed.
+            b->free = ranges;
+            b->max_free *= 2;
+        }
+        memmove(&b->free[pos+1], &b->free[pos], (b->num_free - pos) * sizeof(NvHeapRange));
+        b->free[pos].offset = offset;
+        b->free[pos].size = size;
+        b->num_free++;
+    }
+
+    b->used -= size;
+    return true;
+}
+
+void nvHeapCreate(NvHeap* h, NvAddressSpace* as)
+{
+    h->as = as;
+    h->blocks = NULL;
+    mutexInit(&h->mutex);
+}
+
+void nvHeapClose(NvHeap* h)
+{
+    while (h->blocks) {
+        NvHeapBlock* b = h->blocks;
+        h->blocks = b->next;
+        _nvHeapBlockDestroy(h, b);
+    }
+}
+
+Result nvHeapAlloc(NvHeap* h, u32 size, u32 align, NvKind kind, bool is_cpu_cacheable, NvHeapAlloc* out)
+{
+    Result rc = 0;
+
+    if (align < NV_HEAP_MIN_ALIGN)
+        align = NV_HEAP_MIN_ALIGN;
+    if (!size || size > UINT32_MAX - NV_HEAP_BLOCK_SIZE || (align & (align - 1)) || align > (h->as->page_size > 0x1000 ? h->as->page_size : 0x1000))
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    size = (size + NV_HEAP_MIN_ALIGN - 1) &~ (NV_HEAP_MIN_ALIGN - 1);
+
+    bool is_dedicated = size > NV_HEAP_BLOCK_SIZE / 2;
+    NvHeapBlock* b = NULL;
+    s64 offset = -1;
+
+    mutexLock(&h->mutex);
+
+    // Large buffers get their own block, rather than fragmenting the shared ones.
+    if (!is_dedicated) {
+        for (b = h->blocks; b; b = b->next) {
+            if (b->is_dedicated || b->kind != kind || b->is_cpu_cacheable != is_cpu_cacheable)
+                continue;
+            offset = _nvHeapBlockAlloc(b, size, align);
+            if (offset >= 0)
+                break;
+        }
+    }
+
+    if (!b) {
+        u32 block_size = (size + NV_HEAP_BLOCK_SIZE - 1) &~ (NV_HEAP_BLOCK_SIZE - 1);
+        b = _nvHeapBlockCreate(h, block_size, kind, is_cpu_cacheable, &rc);
+        if (b) {
+            // Can't fail at the start of an empty block.
+            b->is_dedicated = is_dedicated;
+            offset = _nvHeapBlockAlloc(b, size, align);
+            b->next = h->blocks;
+            h->blocks = b;
+        }
+    }
+
+    if (b) {
+        out->block = b;
+        out->offset = offset;
+        out->size = size;
+        out->cpu_addr = (u8*)b->cpu_addr + offset;
+        out->iova = b->iova + offset;
+    }
+
+    mutexUnlock(&h->mutex);
+    return rc;
+}
+
+void nvHeapFree(NvHeap* h, NvHeapAlloc* a)
+{
+    NvHeapBlock* b = a->block;
+    if (!b)
+        return;
+
+    mutexLock(&h->mutex);
+    _nvHeapBlockFree(b, a->offset, a->size);
+
+    if (b->is_dedicated && !b->used) {
+        NvHeapBlock** link = &h->blocks;
+        while (*link != b)
+            link = &(*link)->next;
+        *link = b->next;
+        _nvHeapBlockDestroy(h, b);
+    }
+    mutexUnlock(&h->mutex);
+
+    a->block = NULL;
+}
+
+void nvHeapTrim(NvHeap* h)
+{
+    mutexLock(&h->mutex);
+    NvHeapBlock** link = &h->blocks;
+    while (*link) {
+        NvHeapBlock* b = *link;
+        if (!b->used) {
+            *link = b->next;
+            _nvHeapBlockDestroy(h, b);
+        }
+        else
+            link = &b->next;
+    }
+    mutexUnlock(&h->mutex);
+}
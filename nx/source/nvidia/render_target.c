@@ -0,0 +1,96 @@
+#include <string.h>
+#include "types.h"
+#include "result.h"
+#include "runtime/large_buffer.h"
+#include "nvidia/ioctl.h"
+#include "nvidia/map.h"
+#include "nvidia/address_space.h"
+#include "nvidia/gpu.h"
+#include "nvidia/render_target.h"
+
+typedef struct {
+    u8 bytes_per_pixel;
+    NvKind compressed_kind;
+    NvKind kind;
+} RenderTargetFormatInfo;
+
+static const RenderTargetFormatInfo g_rtFormatInfo[] = {
+    [NvRenderTargetFormat_Color32]  = { 4,  NvKind_C32_2CRA,  NvKind_Generic_16BX2 },
+    [NvRenderTargetFormat_Color64]  = { 8,  NvKind_C64_2CRA,  NvKind_Generic_16BX2 },
+    [NvRenderTargetFormat_Color128] = { 16, NvKind_C128_2CR,  NvKind_Generic_16BX2 },
+    [NvRenderTargetFormat_Z16]      = { 2,  NvKind_Z16_2C,    NvKind_Z16 },
+    [NvRenderTargetFormat_Z24S8]    = { 4,  NvKind_Z24S8_2CZ, NvKind_Z24S8 },
+    [NvRenderTargetFormat_ZF32]     = { 4,  NvKind_ZF32_2CZ,  NvKind_ZF32 },
+};
+
+static Result _nvRenderTargetMap(NvRenderTarget* rt, NvKind kind, u32 align)
+{
+    Result rc = nvMapCreate(&rt->map, rt->mem, rt->size, align, kind, false);
+    if (R_SUCCEEDED(rc)) {
+        rc = nvAddressSpaceMap(rt->as, nvMapGetHandle(&rt->map), true, kind, &rt->iova);
+        if (R_FAILED(rc))
+            nvMapClose(&rt->map);
+    }
+    if (R_SUCCEEDED(rc))
+        rt->kind = kind;
+    return rc;
+}
+
+Result nvRenderTargetCreate(NvRenderTarget* rt, NvAddressSpace* as, u32 width, u32 height, NvRenderTargetFormat format)
+{
+    if (!width || !height || (u32)format >= sizeof(g_rtFormatInfo)/sizeof(g_rtFormatInfo[0]))
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    const RenderTargetFormatInfo* info = &g_rtFormatInfo[format];
+
+    memset(rt, 0, sizeof(*rt));
+    rt->as = as;
+
+    // 16 GOBs high blocks like framebuffers, less for small surfaces.
+    u32 block_height_log2 = 4;
+    while (block_height_log2 && (8U << (block_height_log2 - 1)) >= height)
+        block_height_log2--;
+    const u32 block_height = 8U << block_height_log2;
+
+    // Compression tags cover whole compression pages, so allocations are rounded to them.
+    u32 align = nvGpuGetCharacteristics()->compression_page_size;
+    if (align < 0x1000)
+        align = 0x20000;
+
+    rt->pitch = (width * info->bytes_per_pixel + 63) &~ 63;
+    rt->height_aligned = (height + block_height - 1) &~ (block_height - 1);
+    rt->block_height_log2 = block_height_log2;
+
+    u64 size = ((u64)rt->pitch * rt->height_aligned + align - 1) &~ (u64)(align - 1);
+    if (size > UINT32_MAX)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+    rt->size = size;
+
+    rt->mem = largeBufferAlloc(rt->size);
+    if (!rt->mem)
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+
+    Result rc = _nvRenderTargetMap(rt, info->compressed_kind, align);
+    if (R_SUCCEEDED(rc))
+        rt->is_compressed = true;
+    else
+        rc = _nvRenderTargetMap(rt, info->kind, align);
+
+    if (R_FAILED(rc)) {
+        largeBufferFree(rt->mem);
+        rt->mem = NULL;
+    }
+
+    return rc;
+}
+
+void nvRenderTargetClose(NvRenderTarget* rt)
+{
+    if (!rt->mem)
+        return;
+
+    nvAddressSpaceUnmap(rt->as, rt->iova);
+    nvMapClose(&rt->map);
+    largeBufferFree(rt->mem);
+    rt->mem = NULL;
+}
@@ -0,0 +1,75 @@
+#include <malloc.h>
+#include <string.h>
+#include "types.h"
+#include "result.h"
+#include "kernel/svc.h"
+#include "kernel/detect.h"
+#include "kernel/virtmem.h"
+#include "runtime/env.h"
+#include "runtime/arena.h"
+
+Result arenaAllocatorCreate(ArenaAllocator* a, size_t size) {
+    size = (size + 0xFFF) &~ 0xFFF;
+    if (!size)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    memset(a, 0, sizeof(*a));
+    a->size = size;
+
+    if (kernelAbove300() && envIsSyscallHinted(0x2C) && envIsSyscallHinted(0x2D)) {
+        a->base = (u8*)virtmemReserveAlias(size);
+        a->on_demand = a->base != NULL;
+    }
+
+    if (!a->base) {
+        a->base = (u8*)memalign(0x1000, size);
+        if (!a->base)
+            return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+        a->committed = size;
+    }
+
+    return 0;
+}
+
+void arenaAllocatorClose(ArenaAllocator* a) {
+    if (!a->base)
+        return;
+
+    if (a->on_demand) {
+        if (a->committed)
+            svcUnmapPhysicalMemory(a->base, a->committed);
+        virtmemFreeAlias(a->base, a->size);
+    }
+    else
+        free(a->base);
+
+    a->base = NULL;
+}
+
+bool _arenaAllocatorCommit(ArenaAllocator* a, size_t end) {
+    if (!a->on_demand)
+        return false;
+
+    size_t new_committed = (end + ARENA_ALLOCATOR_COMMIT_SIZE - 1) &~ (ARENA_ALLOCATOR_COMMIT_SIZE - 1);
+    if (new_committed > a->size)
+        new_committed = a->size;
+
+    if (R_FAILED(svcMapPhysicalMemory(a->base + a->committed, new_committed - a->committed))) {
+        // Retry with only what's needed, in case physical memory is running low.
+        new_committed = (end + 0xFFF) &~ 0xFFF;
+        if (R_FAILED(svcMapPhysicalMemory(a->base + a->committed, new_committed - a->committed)))
+            return false;
+    }
+
+    a->committed = new_committed;
+    return true;
+}
+
+void arenaAllocatorTrim(ArenaAllocator* a) {
+    if (!a->on_demand)
+        return;
+
+    size_t keep = (a->offset + 0xFFF) &~ 0xFFF;
+    if (keep < a->committed && R_SUCCEEDED(svcUnmapPhysicalMemory(a->base + keep, a->committed - keep)))
+        a->committed = keep;
+}
@@ -0,0 +1,200 @@
+#include <malloc.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+
+#include "result.h"
+#include "kernel/svc.h"
+#include "kernel/wait.h"
+#include "runtime/async_log.h"
+
+// Interval at which the sender drains buffers when it isn't woken earlier
+#define ASYNCLOG_SEND_INTERVAL_NS 10000000ull
+
+static void _asyncLogBufferRelease(void* arg)
+{
+    AsyncLogBuffer* buf = (AsyncLogBuffer*)arg;
+    __atomic_store_n(&buf->dead, true, __ATOMIC_RELEASE);
+}
+
+static void _asyncLogDrain(AsyncLog* log)
+{
+    size_t used = 0;
+
+    mutexLock(&log->drain_mutex);
+
+    // Threads only push buffers at the head, and only this function unlinks them.
+    mutexLock(&log->list_mutex);
+    AsyncLogBuffer* buf = log->buffers;
+    mutexUnlock(&log->list_mutex);
+
+    while (buf) {
+        AsyncLogBuffer* next = buf->next;
+        bool dead = __atomic_load_n(&buf->dead, __ATOMIC_ACQUIRE);
+        u32 head = __atomic_load_n(&buf->head, __ATOMIC_ACQUIRE);
+        u32 tail = buf->tail;
+
+        while (tail != head) {
+            u32 pos = tail % ASYNCLOG_THREAD_BUFFER_SIZE;
+            size_t size = MIN(head - tail, ASYNCLOG_THREAD_BUFFER_SIZE - pos);
+            size = MIN(size, ASYNCLOG_BATCH_SIZE - used);
+
+            memcpy(log->batch + used, buf->data + pos, size);
+            used += size;
+            tail += size;
+            __atomic_store_n(&buf->tail, tail, __ATOMIC_RELEASE);
+
+            if (used == ASYNCLOG_BATCH_SIZE) {
+                log->sink(log->userdata, log->batch, used);
+                used = 0;
+            }
+        }
+
+        // Buffers of exited threads are freed once drained
+        if (dead && tail == head) {
+            // Re-walk from the head, which may have changed since it was read.
+            mutexLock(&log->list_mutex);
+            AsyncLogBuffer** link = &log->buffers;
+            while (*link != buf)
+                link = &(*link)->next;
+            *link = next;
+            mutexUnlock(&log->list_mutex);
+            free(buf);
+        }
+
+        buf = next;
+    }
+
+    if (used)
+        log->sink(log->userdata, log->batch, used);
+
+    mutexUnlock(&log->drain_mutex);
+}
+
+static void _asyncLogThreadFunc(void* arg)
+{
+    AsyncLog* log = (AsyncLog*)arg;
+
+    while (!__atomic_load_n(&log->should_exit, __ATOMIC_ACQUIRE)) {
+        waitSingle(waiterForUEvent(&log->wake_event), ASYNCLOG_SEND_INTERVAL_NS);
+        _asyncLogDrain(log);
+    }
+}
+
+Result asyncLogCreate(AsyncLog* log, AsyncLogSinkFn sink, void* userdata, int prio, int cpuid)
+{
+    Result rc = 0;
+
+    *log = (AsyncLog){0};
+    log->sink = sink;
+    log->userdata = userdata;
+    mutexInit(&log->list_mutex);
+    mutexInit(&log->drain_mutex);
+    ueventCreate(&log->wake_event, true);
+
+    if (!sink)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    log->batch = (u8*)malloc(ASYNCLOG_BATCH_SIZE);
+    if (!log->batch)
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+
+    log->tls_slot = threadTlsAlloc(_asyncLogBufferRelease);
+    if (log->tls_slot < 0)
+        rc = MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+
+    if (R_SUCCEEDED(rc)) {
+        rc = threadCreate(&log->thread, _asyncLogThreadFunc, log, NULL, 0x4000, prio, cpuid);
+        if (R_SUCCEEDED(rc)) {
+            rc = threadStart(&log->thread);
+            if (R_FAILED(rc))
+                threadClose(&log->thread);
+        }
+        if (R_FAILED(rc))
+            threadTlsFree(log->tls_slot);
+    }
+
+    if (R_FAILED(rc))
+        free(log->batch);
+
+    return rc;
+}
+
+void asyncLogClose(AsyncLog* log)
+{
+    __atomic_store_n(&log->should_exit, true, __ATOMIC_RELEASE);
+    ueventSignal(&log->wake_event);
+    threadWaitForExit(&log->thread);
+    threadClose(&log->thread);
+
+    // Stops destructors from touching the buffers freed below
+    threadTlsFree(log->tls_slot);
+    _asyncLogDrain(log);
+
+    while (log->buffers) {
+        AsyncLogBuffer* buf = log->buffers;
+        log->buffers = buf->next;
+        free(buf);
+    }
+
+    free(log->batch);
+}
+
+static AsyncLogBuffer* _asyncLogGetBuffer(AsyncLog* log)
+{
+    AsyncLogBuffer* buf = (AsyncLogBuffer*)threadTlsGet(log->tls_slot);
+    if (buf)
+        return buf;
+
+    buf = (AsyncLogBuffer*)calloc(1, sizeof(AsyncLogBuffer));
+    if (!buf)
+        return NULL;
+
+    mutexLock(&log->list_mutex);
+    buf->next = log->buffers;
+    log->buffers = buf;
+    mutexUnlock(&log->list_mutex);
+
+    threadTlsSet(log->tls_slot, buf);
+    return buf;
+}
+
+size_t asyncLogWrite(AsyncLog* log, const void* data, size_t len)
+{
+    AsyncLogBuffer* buf = _asyncLogGetBuffer(log);
+    if (!buf) {
+        __atomic_add_fetch(&log->dropped, len, __ATOMIC_RELAXED);
+        return 0;
+    }
+
+    u32 head = buf->head;
+    u32 avail = ASYNCLOG_THREAD_BUFFER_SIZE - (head - __atomic_load_n(&buf->tail, __ATOMIC_ACQUIRE));
+
+    // Messages that fit are kept whole, longer ones keep as much as the buffer has room for
+    size_t size = len;
+    if (len > avail)
+        size = len <= ASYNCLOG_THREAD_BUFFER_SIZE ? 0 : avail;
+
+    if (size) {
+        u32 pos = head % ASYNCLOG_THREAD_BUFFER_SIZE;
+        size_t first = MIN(size, ASYNCLOG_THREAD_BUFFER_SIZE - pos);
+        memcpy(buf->data + pos, data, first);
+        memcpy(buf->data, (const u8*)data + first, size - first);
+        __atomic_store_n(&buf->head, head + size, __ATOMIC_RELEASE);
+    }
+
+    if (size < len) {
+        __atomic_add_fetch(&log->dropped, len - size, __ATOMIC_RELAXED);
+        ueventSignal(&log->wake_event);
+    }
+    // Get the sender going before the buffer fills up
+    else if (buf->head - __atomic_load_n(&buf->tail, __ATOMIC_RELAXED) >= ASYNCLOG_THREAD_BUFFER_SIZE/2)
+        ueventSignal(&log->wake_event);
+
+    return size;
+}
+
+void asyncLogFlush(AsyncLog* log)
+{
+    _asyncLogDrain(log);
+}
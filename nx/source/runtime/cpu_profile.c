@@ -0,0 +1,303 @@
+#include <malloc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "types.h"
+#include "result.h"
+#include "kernel/svc.h"
+#include "kernel/mutex.h"
+#include "kernel/thread.h"
+#include "runtime/cpu_profile.h"
+
+typedef struct {
+    u64 count;
+    u32 hash;
+    u32 depth;
+    u64 addrs[CPU_PROFILE_MAX_DEPTH];   // Leaf first.
+} CpuProfileStack;
+
+extern char __start__[];
+extern char __end__[];
+
+static CpuProfileConfig g_cpuProfileConfig;
+static Thread g_cpuProfileThread;
+static bool g_cpuProfileRunning;
+static bool g_cpuProfileShouldExit;
+
+static Mutex g_cpuProfileThreadsMutex;
+static Handle g_cpuProfileThreads[CPU_PROFILE_MAX_THREADS];
+static u32 g_cpuProfileNumThreads;
+
+static Mutex g_cpuProfileMutex;
+static CpuProfileStack* g_cpuProfileStacks;
+static CpuProfileStats g_cpuProfileStats;
+
+static u32 _cpuProfileWalk(Handle handle, u64* addrs, u32 max_depth) {
+    ThreadContext ctx;
+    MemoryInfo meminfo;
+    u32 pageinfo;
+    u32 depth = 0;
+
+    if (R_FAILED(svcSetThreadActivity(handle, true)))
+        return 0;
+
+    // Nothing in here may take a lock or allocate: the paused thread could be holding it.
+    if (R_SUCCEEDED(svcGetThreadContext3(&ctx, handle))) {
+        addrs[depth++] = ctx.pc.x;
+
+        // Only follow frame records within the stack mapping the thread is running on.
+        u64 fp = ctx.fp, stack_end = 0;
+        if (R_SUCCEEDED(svcQueryMemory(&meminfo, &pageinfo, ctx.sp)) && (meminfo.perm & Perm_R))
+            stack_end = meminfo.addr + meminfo.size;
+
+        // In a leaf function without a frame record, lr holds the caller which the walk would skip.
+        // Past a call in a function with a frame record, lr is a return address within that function, which then shows up twice.
+        bool check_lr = true;
+        while (depth < max_depth && fp >= ctx.sp && fp + 16 <= stack_end && !(fp & 0xF)) {
+            u64 next_fp = ((u64*)fp)[0];
+            u64 ret = ((u64*)fp)[1];
+            if (check_lr && ret != ctx.lr && ctx.lr && depth < max_depth - 1)
+                addrs[depth++] = ctx.lr;
+            check_lr = false;
+            if (!ret)
+                break;
+            addrs[depth++] = ret;
+            if (next_fp <= fp)
+                break;
+            fp = next_fp;
+        }
+        if (check_lr && ctx.lr && depth < max_depth)
+            addrs[depth++] = ctx.lr;
+    }
+
+    svcSetThreadActivity(handle, false);
+    return depth;
+}
+
+static void _cpuProfileRecord(const u64* addrs, u32 depth) {
+    u32 hash = 2166136261u;
+    for (u32 i = 0; i < depth; i++)
+        hash = (hash ^ (u32)(addrs[i] >> 2)) * 16777619u;
+
+    mutexLock(&g_cpuProfileMutex);
+    u32 i = hash % CPU_PROFILE_MAX_STACKS;
+    bool recorded = false;
+    for (u32 probe = 0; probe < CPU_PROFILE_MAX_STACKS; probe++, i = (i + 1) % CPU_PROFILE_MAX_STACKS) {
+        CpuProfileStack* s = &g_cpuProfileStacks[i];
+        if (!s->count) {
+            s->hash = hash;
+            s->depth = depth;
+            memcpy(s->addrs, addrs, depth * sizeof(u64));
+            g_cpuProfileStats.num_stacks++;
+        }
+        else if (s->hash != hash || s->depth != depth || memcmp(s->addrs, addrs, depth * sizeof(u64)) != 0)
+            continue;
+        s->count++;
+        recorded = true;
+        break;
+    }
+
+    if (recorded)
+        g_cpuProfileStats.num_samples++;
+    else
+        g_cpuProfileStats.num_dropped++;
+    mutexUnlock(&g_cpuProfileMutex);
+}
+
+static void _cpuProfileThreadFunc(void* arg) {
+    u64 addrs[CPU_PROFILE_MAX_DEPTH];
+    Handle threads[CPU_PROFILE_MAX_THREADS];
+
+    while (!__atomic_load_n(&g_cpuProfileShouldExit, __ATOMIC_ACQUIRE)) {
+        svcSleepThread(g_cpuProfileConfig.interval);
+
+        mutexLock(&g_cpuProfileThreadsMutex);
+        u32 num_threads = g_cpuProfileNumThreads;
+        memcpy(threads, g_cpuProfileThreads, num_threads * sizeof(Handle));
+        mutexUnlock(&g_cpuProfileThreadsMutex);
+
+        // Threads are paused one at a time, and only for the duration of the walk.
+        for (u32 i = 0; i < num_threads; i++) {
+            u32 depth = _cpuProfileWalk(threads[i], addrs, g_cpuProfileConfig.max_depth);
+            if (depth)
+                _cpuProfileRecord(addrs, depth);
+            else {
+                mutexLock(&g_cpuProfileMutex);
+                g_cpuProfileStats.num_failed++;
+                mutexUnlock(&g_cpuProfileMutex);
+            }
+        }
+    }
+}
+
+Result cpuProfileStart(const CpuProfileConfig* config) {
+    if (g_cpuProfileRunning)
+        return MAKERESULT(Module_Libnx, LibnxError_AlreadyInitialized);
+
+    CpuProfileConfig* c = &g_cpuProfileConfig;
+    *c = *config;
+    if (!c->interval) c->interval = 1000000;
+    if (!c->max_depth || c->max_depth > CPU_PROFILE_MAX_DEPTH) c->max_depth = CPU_PROFILE_MAX_DEPTH;
+
+    mutexLock(&g_cpuProfileMutex);
+    if (!g_cpuProfileStacks)
+        g_cpuProfileStacks = (CpuProfileStack*)calloc(CPU_PROFILE_MAX_STACKS, sizeof(CpuProfileStack));
+    bool ok = g_cpuProfileStacks != NULL;
+    mutexUnlock(&g_cpuProfileMutex);
+    if (!ok)
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+
+    g_cpuProfileShouldExit = false;
+    Result rc = threadCreate(&g_cpuProfileThread, _cpuProfileThreadFunc, NULL, NULL, 0x4000, c->prio, c->cpuid);
+    if (R_SUCCEEDED(rc)) {
+        rc = threadStart(&g_cpuProfileThread);
+        if (R_FAILED(rc))
+            threadClose(&g_cpuProfileThread);
+    }
+
+    if (R_SUCCEEDED(rc))
+        g_cpuProfileRunning = true;
+    return rc;
+}
+
+void cpuProfileStop(void) {
+    if (!g_cpuProfileRunning)
+        return;
+
+    __atomic_store_n(&g_cpuProfileShouldExit, true, __ATOMIC_RELEASE);
+    threadWaitForExit(&g_cpuProfileThread);
+    threadClose(&g_cpuProfileThread);
+    g_cpuProfileRunning = false;
+}
+
+Result cpuProfileAddThread(Handle handle) {
+    Result rc = 0;
+
+    // The sampler can't pause itself.
+    if (g_cpuProfileRunning && handle == g_cpuProfileThread.handle)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    mutexLock(&g_cpuProfileThreadsMutex);
+    if (g_cpuProfileNumThreads >= CPU_PROFILE_MAX_THREADS)
+        rc = MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+    else
+        g_cpuProfileThreads[g_cpuProfileNumThreads++] = handle;
+    mutexUnlock(&g_cpuProfileThreadsMutex);
+
+    return rc;
+}
+
+void cpuProfileRemoveThread(Handle handle) {
+    mutexLock(&g_cpuProfileThreadsMutex);
+    for (u32 i = 0; i < g_cpuProfileNumThreads; i++) {
+        if (g_cpuProfileThreads[i] == handle) {
+            g_cpuProfileThreads[i] = g_cpuProfileThreads[--g_cpuProfileNumThreads];
+            break;
+        }
+    }
+    mutexUnlock(&g_cpuProfileThreadsMutex);
+}
+
+void cpuProfileGetStats(CpuProfileStats* out) {
+    mutexLock(&g_cpuProfileMutex);
+    *out = g_cpuProfileStats;
+    mutexUnlock(&g_cpuProfileMutex);
+}
+
+void cpuProfileReset(void) {
+    mutexLock(&g_cpuProfileMutex);
+    if (g_cpuProfileStacks)
+        memset(g_cpuProfileStacks, 0, CPU_PROFILE_MAX_STACKS * sizeof(CpuProfileStack));
+    memset(&g_cpuProfileStats, 0, sizeof(g_cpuProfileStats));
+    mutexUnlock(&g_cpuProfileMutex);
+}
+
+static void _cpuProfilePrintAddr(FILE* f, u64 addr) {
+    if (addr >= (uintptr_t)__start__ && addr < (uintptr_t)__end__)
+        fprintf(f, "0x%lx", (unsigned long)(addr - (uintptr_t)__start__));
+    else
+        fprintf(f, "abs:0x%lx", (unsigned long)addr);
+}
+
+void cpuProfileDumpFolded(FILE* f) {
+    mutexLock(&g_cpuProfileMutex);
+    for (u32 i = 0; g_cpuProfileStacks && i < CPU_PROFILE_MAX_STACKS; i++) {
+        CpuProfileStack* s = &g_cpuProfileStacks[i];
+        if (!s->count)
+            continue;
+
+        for (u32 j = s->depth; j > 0; j--) {
+            _cpuProfilePrintAddr(f, s->addrs[j-1]);
+            fputc(j > 1 ? ';' : ' ', f);
+        }
+        fprintf(f, "%llu\n", (unsigned long long)s->count);
+    }
+    mutexUnlock(&g_cpuProfileMutex);
+}
+
+typedef struct {
+    u64 addr;
+    u64 count;
+} CpuProfileFlatEntry;
+
+static int _cpuProfileCompareAddr(const void* a, const void* b) {
+    u64 x = ((const CpuProfileFlatEntry*)a)->addr, y = ((const CpuProfileFlatEntry*)b)->addr;
+    return x < y ? -1 : x > y;
+}
+
+static int _cpuProfileCompareCount(const void* a, const void* b) {
+    u64 x = ((const CpuProfileFlatEntry*)a)->count, y = ((const CpuProfileFlatEntry*)b)->count;
+    return x > y ? -1 : x < y;
+}
+
+void cpuProfileDumpFlat(FILE* f, u32 max_entries) {
+    CpuProfileFlatEntry* entries = NULL;
+    u32 num_entries = 0;
+
+    if (max_entries > 64)
+        max_entries = 64;
+
+    mutexLock(&g_cpuProfileMutex);
+    CpuProfileStats stats = g_cpuProfileStats;
+    if (g_cpuProfileStacks && stats.num_stacks)
+        entries = (CpuProfileFlatEntry*)malloc(stats.num_stacks * sizeof(CpuProfileFlatEntry));
+    for (u32 i = 0; entries && i < CPU_PROFILE_MAX_STACKS; i++) {
+        CpuProfileStack* s = &g_cpuProfileStacks[i];
+        if (s->count)
+            entries[num_entries++] = (CpuProfileFlatEntry){ .addr = s->addrs[0], .count = s->count };
+    }
+    mutexUnlock(&g_cpuProfileMutex);
+
+    // Sum up the stacks sharing the same PC, then sort by samples.
+    u32 num_pcs = 0;
+    if (num_entries) {
+        qsort(entries, num_entries, sizeof(CpuProfileFlatEntry), _cpuProfileCompareAddr);
+        for (u32 i = 0; i < num_entries; i++) {
+            if (num_pcs && entries[num_pcs-1].addr == entries[i].addr)
+                entries[num_pcs-1].count += entries[i].count;
+            else
+                entries[num_pcs++] = entries[i];
+        }
+        qsort(entries, num_pcs, sizeof(CpuProfileFlatEntry), _cpuProfileCompareCount);
+    }
+
+    fprintf(f, "CPU profile: %llu samples, %llu failed, %llu dropped, %u stacks\n",
+        (unsigned long long)stats.num_samples, (unsigned long long)stats.num_failed,
+        (unsigned long long)stats.num_dropped, stats.num_stacks);
+    for (u32 i = 0; i < num_pcs && i < max_entries; i++) {
+        fprintf(f, "  %5.1f%%  ", stats.num_samples ? 100.0 * entries[i].count / stats.num_samples : 0.0);
+        _cpuProfilePrintAddr(f, entries[i].addr);
+        fprintf(f, "  %llu\n", (unsigned long long)entries[i].count);
+    }
+
+    free(entries);
+}
+
+Result cpuProfileDumpToFile(const char* path) {
+    FILE* f = fopen(path, "w");
+    if (!f)
+        return MAKERESULT(Module_Libnx, LibnxError_IoError);
+
+    cpuProfileDumpFolded(f);
+    return fclose(f) == 0 ? 0 : MAKERESULT(Module_Libnx, LibnxError_IoError);
+}
@@ -0,0 +1,271 @@
+#include <malloc.h>
+#include <stdlib.h>
+#include <string.h>
+#include "result.h"
+#include "kernel/svc.h"
+#include "runtime/crypto_storage.h"
+
+static Result _cryptoStorageReadRaw(CryptoStorage* cs, s64 offset, void* buffer, u64 size)
+{
+    s64 pos = cs->src.offset + offset;
+
+    if (cs->src.type == CryptoStorageSourceType_File) {
+        u64 bytes_read = 0;
+        Result rc = fsFileRead(&cs->src.file, pos, buffer, size, FsReadOption_None, &bytes_read);
+        if (R_SUCCEEDED(rc) && bytes_read != size)
+            rc = MAKERESULT(Module_Libnx, LibnxError_IoError);
+        return rc;
+    }
+
+    return fsStorageRead(&cs->src.storage, pos, buffer, size);
+}
+
+static void _cryptoStorageDecrypt(CryptoStorage* cs, s64 offset, u8* data, u64 size)
+{
+    if (cs->mode == CryptoStorageMode_AesCtr) {
+        // ctr + offset / 0x10, as a 128-bit big-endian integer
+        u8 ctr[AES_BLOCK_SIZE];
+        u64 carry = (u64)offset / AES_BLOCK_SIZE;
+        for (int i = AES_BLOCK_SIZE - 1; i >= 0; i--) {
+            carry += cs->ctr[i];
+            ctr[i] = (u8)carry;
+            carry >>= 8;
+        }
+
+        aes128CtrContextResetCtr(&cs->ctr_ctx, ctr);
+        aes128CtrCrypt(&cs->ctr_ctx, data, data, size);
+    }
+    else {
+        u64 sector = (u64)offset / cs->sector_size;
+        for (u64 pos = 0; pos < size; pos += cs->sector_size, sector++) {
+            aes128XtsContextResetSector(&cs->xts_ctx, sector, cs->is_nintendo);
+            aes128XtsDecrypt(&cs->xts_ctx, data + pos, data + pos, cs->sector_size);
+        }
+    }
+}
+
+static void _cryptoStorageReader(void* arg)
+{
+    CryptoStorage* cs = (CryptoStorage*)arg;
+
+    mutexLock(&cs->req_mutex);
+
+    for (;;) {
+        while (!cs->should_exit && !cs->req_pending)
+            condvarWait(&cs->req_cond, &cs->req_mutex);
+
+        if (cs->should_exit)
+            break;
+
+        mutexUnlock(&cs->req_mutex);
+        Result rc = _cryptoStorageReadRaw(cs, cs->req_offset, cs->req_buffer, cs->req_size);
+        mutexLock(&cs->req_mutex);
+
+        cs->req_result = rc;
+        cs->req_pending = false;
+        cs->req_done = true;
+        condvarWakeAll(&cs->req_cond);
+    }
+
+    mutexUnlock(&cs->req_mutex);
+}
+
+static void _cryptoStorageSubmit(CryptoStorage* cs, s64 offset, void* buffer, u64 size)
+{
+    mutexLock(&cs->req_mutex);
+    cs->req_offset = offset;
+    cs->req_buffer = buffer;
+    cs->req_size = size;
+    cs->req_pending = true;
+    cs->req_done = false;
+    condvarWakeAll(&cs->req_cond);
+    mutexUnlock(&cs->req_mutex);
+}
+
+static Result _cryptoStorageWait(CryptoStorage* cs)
+{
+    mutexLock(&cs->req_mutex);
+    while (!cs->req_done)
+        condvarWait(&cs->req_cond, &cs->req_mutex);
+    cs->req_done = false;
+    Result rc = cs->req_result;
+    mutexUnlock(&cs->req_mutex);
+    return rc;
+}
+
+static Result _cryptoStorageCreate(CryptoStorage* out, const CryptoStorageSource* src)
+{
+    // CTR data doesn't need to end on a block boundary, XTS data must be whole sectors
+    if (src->offset < 0 || src->size < 0 || (out->mode == CryptoStorageMode_AesXts && (u64)src->size % out->align))
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    out->src = *src;
+    mutexInit(&out->mutex);
+    mutexInit(&out->req_mutex);
+    condvarInit(&out->req_cond);
+
+    out->buffer_size = CRYPTO_STORAGE_BUFFER_SIZE + out->align - 1;
+    out->buffer_size -= out->buffer_size % out->align;
+    out->buffer = (u8*)memalign(0x1000, out->buffer_size);
+    if (!out->buffer)
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+
+    u32 prio = 0x2C;
+    svcGetThreadPriority(&prio, CUR_THREAD_HANDLE);
+
+    Result rc = threadCreate(&out->reader, _cryptoStorageReader, out, NULL, 0x4000, prio, -2);
+    if (R_SUCCEEDED(rc)) {
+        rc = threadStart(&out->reader);
+        if (R_FAILED(rc))
+            threadClose(&out->reader);
+    }
+
+    if (R_FAILED(rc)) {
+        free(out->buffer);
+        out->buffer = NULL;
+    }
+
+    return rc;
+}
+
+Result cryptoStorageCreateAesCtr(CryptoStorage* out, const CryptoStorageSource* src, const void* key, const void* ctr)
+{
+    memset(out, 0, sizeof(*out));
+    out->mode = CryptoStorageMode_AesCtr;
+    out->align = AES_BLOCK_SIZE;
+    memcpy(out->ctr, ctr, sizeof(out->ctr));
+    aes128CtrContextCreate(&out->ctr_ctx, key, out->ctr);
+
+    return _cryptoStorageCreate(out, src);
+}
+
+Result cryptoStorageCreateAesXts(CryptoStorage* out, const CryptoStorageSource* src, const void* key0, const void* key1, size_t sector_size, bool is_nintendo)
+{
+    if (!sector_size || sector_size % AES_BLOCK_SIZE)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    memset(out, 0, sizeof(*out));
+    out->mode = CryptoStorageMode_AesXts;
+    out->align = sector_size;
+    out->sector_size = sector_size;
+    out->is_nintendo = is_nintendo;
+    aes128XtsContextCreate(&out->xts_ctx, key0, key1, false);
+
+    return _cryptoStorageCreate(out, src);
+}
+
+void cryptoStorageClose(CryptoStorage* cs)
+{
+    if (!cs->buffer)
+        return;
+
+    mutexLock(&cs->req_mutex);
+    cs->should_exit = true;
+    condvarWakeAll(&cs->req_cond);
+    mutexUnlock(&cs->req_mutex);
+
+    threadWaitForExit(&cs->reader);
+    threadClose(&cs->reader);
+
+    if (cs->src.type == CryptoStorageSourceType_File)
+        fsFileClose(&cs->src.file);
+    else
+        fsStorageClose(&cs->src.storage);
+
+    free(cs->buffer);
+    memset(cs, 0, sizeof(*cs));
+}
+
+static Result _cryptoStorageReadBuffered(CryptoStorage* cs, s64 offset, u8* dst, u64 size)
+{
+    while (size) {
+        if (!cs->buffer_valid || offset < cs->buffer_offset || offset >= cs->buffer_offset + (s64)cs->buffer_valid) {
+            s64 fill_offset = offset - offset % cs->align;
+            u64 fill_size = cs->src.size - fill_offset;
+            if (fill_size > cs->buffer_size)
+                fill_size = cs->buffer_size;
+
+            cs->buffer_valid = 0;
+            Result rc = _cryptoStorageReadRaw(cs, fill_offset, cs->buffer, fill_size);
+            if (R_FAILED(rc))
+                return rc;
+
+            _cryptoStorageDecrypt(cs, fill_offset, cs->buffer, fill_size);
+            cs->buffer_offset = fill_offset;
+            cs->buffer_valid = fill_size;
+        }
+
+        u64 pos = offset - cs->buffer_offset;
+        u64 copy = cs->buffer_valid - pos;
+        if (copy > size)
+            copy = size;
+
+        memcpy(dst, cs->buffer + pos, copy);
+        offset += copy;
+        dst += copy;
+        size -= copy;
+    }
+
+    return 0;
+}
+
+static Result _cryptoStorageReadDirect(CryptoStorage* cs, s64 offset, u8* dst, u64 size)
+{
+    u64 chunk_size = CRYPTO_STORAGE_CHUNK_SIZE - CRYPTO_STORAGE_CHUNK_SIZE % cs->align;
+    if (chunk_size < cs->align)
+        chunk_size = cs->align;
+
+    // Chunk N+1 is read straight into the output while chunk N is decrypted in place
+    Result rc = 0;
+    u64 cur = size < chunk_size ? size : chunk_size;
+    _cryptoStorageSubmit(cs, offset, dst, cur);
+
+    for (u64 pos = 0; pos < size;) {
+        rc = _cryptoStorageWait(cs);
+        if (R_FAILED(rc))
+            break;
+
+        u64 next = pos + cur;
+        u64 next_size = size - next < chunk_size ? size - next : chunk_size;
+        if (next_size)
+            _cryptoStorageSubmit(cs, offset + next, dst + next, next_size);
+
+        _cryptoStorageDecrypt(cs, offset + pos, dst + pos, cur);
+        pos = next;
+        cur = next_size;
+    }
+
+    return rc;
+}
+
+Result cryptoStorageRead(CryptoStorage* cs, s64 offset, void* buffer, u64 size)
+{
+    if (offset < 0 || offset > cs->src.size || size > (u64)(cs->src.size - offset))
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+    if (!size)
+        return 0;
+
+    u8* dst = (u8*)buffer;
+    s64 end = offset + size;
+
+    // Aligned middle part, read directly into the output. Small reads go through the buffer entirely.
+    s64 mid_start = offset + (cs->align - offset % cs->align) % cs->align;
+    s64 mid_end = end - end % cs->align;
+    if (end == cs->src.size)
+        mid_end = end;
+    if (mid_end <= mid_start || (u64)(mid_end - mid_start) < cs->buffer_size)
+        mid_start = mid_end = end;
+
+    mutexLock(&cs->mutex);
+
+    Result rc = _cryptoStorageReadBuffered(cs, offset, dst, mid_start - offset);
+
+    if (R_SUCCEEDED(rc) && mid_end > mid_start)
+        rc = _cryptoStorageReadDirect(cs, mid_start, dst + (mid_start - offset), mid_end - mid_start);
+
+    if (R_SUCCEEDED(rc) && end > mid_end)
+        rc = _cryptoStorageReadBuffered(cs, mid_end, dst + (mid_end - offset), end - mid_end);
+
+    mutexUnlock(&cs->mutex);
+    return rc;
+}
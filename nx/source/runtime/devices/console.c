@@ -3,6 +3,7 @@
 #include <sys/iosupport.h>
 #include "runtime/devices/console.h"
 #include "kernel/svc.h"
+#include "runtime/async_log.h"
 
 #include "default_font_bin.h"
 
@@ -478,6 +479,31 @@ static const devoptab_t dotab_svc = {
 	NULL
 };
 
+static AsyncLog debugAsyncLog;
+
+//---------------------------------------------------------------------------------
+static void debug_async_sink(void *userdata, const void *data, size_t size) {
+//---------------------------------------------------------------------------------
+	svcOutputDebugString(data,size);
+}
+
+//---------------------------------------------------------------------------------
+static ssize_t debug_async_write(struct _reent *r, void *fd, const char *ptr, size_t len) {
+//---------------------------------------------------------------------------------
+	asyncLogWrite(&debugAsyncLog,ptr,len);
+	return len;
+}
+
+static const devoptab_t dotab_svc_async = {
+	"svc",
+	0,
+	NULL,
+	NULL,
+	debug_async_write,
+	NULL,
+	NULL,
+	NULL
+};
 
 static const devoptab_t dotab_null = {
 	"null",
@@ -563,6 +589,15 @@ void consoleDebugInit(debugDevice device) {
 		devoptab_list[STD_ERR] = &dotab_svc;
 		buffertype = _IOLBF;
 		break;
+	case debugDevice_SVC_ASYNC:
+		{
+			static bool asyncLogCreated = false;
+			if (!asyncLogCreated)
+				asyncLogCreated = R_SUCCEEDED(asyncLogCreate(&debugAsyncLog, debug_async_sink, NULL, 0x3B, -2));
+			devoptab_list[STD_ERR] = asyncLogCreated ? &dotab_svc_async : &dotab_svc;
+		}
+		buffertype = _IOLBF;
+		break;
 	case debugDevice_CONSOLE:
 		devoptab_list[STD_ERR] = &dotab_stdout;
 		break;
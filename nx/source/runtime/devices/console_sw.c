@@ -1,5 +1,7 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <arm_neon.h>
 #include <sys/iosupport.h>
 #include "result.h"
 #include "runtime/devices/console.h"
@@ -36,12 +38,22 @@ static const u16 colorTable[] = {
     RGB565_FROM_RGB8( 96, 96, 96),	// faint white
 };
 
+// A character cell: glyph, color indices and line decorations, packed so that cells can be compared at once.
+#define CELL_GLYPH(c)       ((c) & 0xFFFF)
+#define CELL_FG(c)          (((c) >> 16) & 0x1F)
+#define CELL_BG(c)          (((c) >> 21) & 0x1F)
+#define CELL_UNDERLINE      BIT(26)
+#define CELL_CROSSED_OUT    BIT(27)
+
 struct ConsoleSwRenderer
 {
     ConsoleRenderer base;
     Framebuffer fb;          ///< Framebuffer object
     u16 *frameBuffer;        ///< Framebuffer address
     u32 frameBufferStride;   ///< Framebuffer stride (in pixels)
+    u32 *cells;              ///< Characters to display, drawn at flushAndSwap
+    u32 *drawnCells;         ///< Characters currently in the framebuffer
+    int rowOffset;           ///< Row of the cells (and framebuffer) displayed at the top
     bool initialized;
 };
 
@@ -84,8 +96,29 @@ static bool ConsoleSwRenderer_init(PrintConsole* con)
         return false;
     }
 
+    // Only the characters drawn since a buffer was last presented need to be converted.
+    // Without it (out of memory), the whole image is converted every frame.
+    framebufferEnableDirtyTracking(&sw->fb);
+
+    // Characters are only recorded until the next flushAndSwap, which draws the cells that changed, once.
+    size_t numCells = con->consoleWidth * con->consoleHeight;
+    sw->cells = (u32*)calloc(numCells, sizeof(u32));
+    sw->drawnCells = (u32*)malloc(numCells * sizeof(u32));
+    if (!sw->cells || !sw->drawnCells) {
+        free(sw->cells);
+        free(sw->drawnCells);
+        sw->cells = NULL;
+        sw->drawnCells = NULL;
+        framebufferClose(&sw->fb);
+        return false;
+    }
+
+    // Nothing was drawn yet, so the first flush draws every cell.
+    memset(sw->drawnCells, 0xFF, numCells * sizeof(u32));
+
     sw->frameBuffer = NULL;
     sw->frameBufferStride = 0;
+    sw->rowOffset = 0;
     sw->initialized = true;
 
     return true;
@@ -102,12 +135,18 @@ static u16* _getFrameBuffer(struct ConsoleSwRenderer* sw, u32* out_stride)
     return sw->frameBuffer;
 }
 
+// The rows of cells are a ring rotated by rowOffset, in sync with the framebuffer's row offset, so that scrolling the whole console moves nothing.
+static u32* _cellRow(struct ConsoleSwRenderer* sw, PrintConsole* con, int y)
+{
+    y += sw->rowOffset;
+    if (y >= con->consoleHeight)
+        y -= con->consoleHeight;
+    return &sw->cells[con->consoleWidth*y];
+}
+
 static void ConsoleSwRenderer_drawChar(PrintConsole* con, int x, int y, int c)
 {
     struct ConsoleSwRenderer* sw = ConsoleSwRenderer(con);
-    u32 stride;
-    u16* frameBuffer = _getFrameBuffer(sw, &stride);
-    const u16 *fontdata = (const u16*)con->font.gfx + (16 * c);
 
     int writingColor = con->fg;
     int screenColor = con->bg;
@@ -124,67 +163,85 @@ static void ConsoleSwRenderer_drawChar(PrintConsole* con, int x, int y, int c)
         screenColor = tmp;
     }
 
-    u16 bg = colorTable[screenColor];
-    u16 fg = colorTable[writingColor];
-
-    u128 *tmp = (u128*)fontdata;
-
-    u128 bvaltop = tmp[0];
-    u128 bvalbtm = tmp[1];
+    u32 cell = CELL_GLYPH(c) | ((u32)writingColor << 16) | ((u32)screenColor << 21);
+    if (con->flags & CONSOLE_UNDERLINE)   cell |= CELL_UNDERLINE;
+    if (con->flags & CONSOLE_CROSSED_OUT) cell |= CELL_CROSSED_OUT;
 
-    if (con->flags & CONSOLE_UNDERLINE)  bvalbtm |= (u128)0xffffULL << 7*16;
-
-    if (con->flags & CONSOLE_CROSSED_OUT) bvaltop |= (u128)0xffffULL << 7*16;
-
-    u16 mask = 0x8000;
+    _cellRow(sw, con, y)[x] = cell;
+}
 
-    int i, j;
+static void _renderCell(PrintConsole* con, u16* frameBuffer, u32 stride, int x, int y, u32 cell)
+{
+    static const u16 leftBits[8]  = { 0x8000, 0x4000, 0x2000, 0x1000, 0x0800, 0x0400, 0x0200, 0x0100 };
+    static const u16 rightBits[8] = { 0x0080, 0x0040, 0x0020, 0x0010, 0x0008, 0x0004, 0x0002, 0x0001 };
+    const u16 *fontdata = (const u16*)con->font.gfx + (16 * CELL_GLYPH(cell));
 
-    x *= 16;
-    y *= 16;
+    uint16x8_t fg = vdupq_n_u16(colorTable[CELL_FG(cell)]);
+    uint16x8_t bg = vdupq_n_u16(colorTable[CELL_BG(cell)]);
+    uint16x8_t left = vld1q_u16(leftBits);
+    uint16x8_t right = vld1q_u16(rightBits);
 
-    u16 *screen;
+    u16 *screen = &frameBuffer[x*16 + stride*y*16];
 
-    for (i=0;i<16;i++) {
-        for (j=0;j<8;j++) {
-            uint32_t screenOffset = (x + i) + stride*(y + j);
-            screen = &frameBuffer[screenOffset];
-            if (bvaltop >> (16*j) & mask) { *screen = fg; }else{ *screen = bg; }
+    // Each row of the glyph is a 16-bit mask, leftmost pixel in the top bit: expand it into 16 pixels, stored at once.
+    for (int j=0; j<16; j++, screen += stride) {
+        u16 row = fontdata[j];
+        if ((j == 7 && (cell & CELL_CROSSED_OUT)) || (j == 15 && (cell & CELL_UNDERLINE))) row = 0xffff;
 
-            screenOffset = (x + i) + stride*(y + j + 8);
-            screen = &frameBuffer[screenOffset];
-            if (bvalbtm >> (16*j) & mask) { *screen = fg; }else{ *screen = bg; }
-        }
-        mask >>= 1;
+        uint16x8_t bits = vdupq_n_u16(row);
+        vst1q_u16(screen,     vbslq_u16(vtstq_u16(bits, left),  fg, bg));
+        vst1q_u16(screen + 8, vbslq_u16(vtstq_u16(bits, right), fg, bg));
     }
 }
 
 static void ConsoleSwRenderer_scrollWindow(PrintConsole* con)
 {
     struct ConsoleSwRenderer* sw = ConsoleSwRenderer(con);
-    u32 stride;
-    u16* frameBuffer = _getFrameBuffer(sw, &stride);
-    int i,j;
-    u32 x, y;
-
-    x = con->windowX * 16;
-    y = con->windowY * 16;
-
-    for (i=0; i<con->windowWidth*16; i+=sizeof(u128)/sizeof(u16)) {
-        u128 *from;
-        u128 *to;
-        for (j=0;j<(con->windowHeight-1)*16;j++) {
-            to = (u128*)&frameBuffer[(x + i) + stride*(y + j)];
-            from = (u128*)&frameBuffer[(x + i) + stride*(y + 16 + j)];
-            *to = *from;
+    int y;
+
+    // When the window is the whole console, the top row becomes the bottom one, to be cleared by the caller.
+    if (con->windowX == 0 && con->windowY == 0 && con->windowWidth == con->consoleWidth && con->windowHeight == con->consoleHeight) {
+        int rowOffset = sw->rowOffset + 1 < con->consoleHeight ? sw->rowOffset + 1 : 0;
+        if (R_SUCCEEDED(framebufferSetRowOffset(&sw->fb, rowOffset*16))) {
+            sw->rowOffset = rowOffset;
+            return;
         }
     }
+
+    // Otherwise only the cells move, the rows are redrawn by the next flushAndSwap where they changed.
+    for (y=0; y<con->windowHeight-1; y++) {
+        u32 *to = _cellRow(sw, con, con->windowY + y) + con->windowX;
+        u32 *from = _cellRow(sw, con, con->windowY + y + 1) + con->windowX;
+        memmove(to, from, con->windowWidth * sizeof(u32));
+    }
 }
 
 static void ConsoleSwRenderer_flushAndSwap(PrintConsole* con)
 {
     struct ConsoleSwRenderer* sw = ConsoleSwRenderer(con);
-    _getFrameBuffer(sw, NULL); // Make sure we dequeued
+    u32 stride;
+    u16* frameBuffer = _getFrameBuffer(sw, &stride); // Make sure we dequeued
+    int x, y;
+
+    // Cells are drawn where they're stored, the framebuffer presents the rows rotated.
+    for (y=0; y<con->consoleHeight; y++) {
+        u32 *cells = &sw->cells[con->consoleWidth*y];
+        u32 *drawnCells = &sw->drawnCells[con->consoleWidth*y];
+        int first = -1, last = -1;
+
+        for (x=0; x<con->consoleWidth; x++) {
+            if (cells[x] == drawnCells[x])
+                continue;
+
+            _renderCell(con, frameBuffer, stride, x, y, cells[x]);
+            drawnCells[x] = cells[x];
+            if (first < 0) first = x;
+            last = x;
+        }
+
+        if (first >= 0)
+            framebufferMarkDirty(&sw->fb, first*16, y*16, (last - first + 1)*16, 16);
+    }
 
     framebufferEnd(&sw->fb);
     sw->frameBuffer = NULL;
@@ -201,6 +258,10 @@ static void ConsoleSwRenderer_deinit(PrintConsole* con)
             ConsoleSwRenderer_flushAndSwap(con);
 
         framebufferClose(&sw->fb);
+        free(sw->cells);
+        free(sw->drawnCells);
+        sw->cells = NULL;
+        sw->drawnCells = NULL;
         sw->initialized = false;
     }
 }
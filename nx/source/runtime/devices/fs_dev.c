@@ -1,6 +1,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <limits.h>
+#include <malloc.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/dirent.h>
@@ -13,6 +14,12 @@
 #include "runtime/util/utf.h"
 #include "runtime/env.h"
 #include "services/time.h"
+#include "kernel/thread.h"
+#include "kernel/mutex.h"
+#include "kernel/condvar.h"
+#include "kernel/svc.h"
+#include "arm/counter.h"
+#include "runtime/trace.h"
 
 #include "path_buf.h"
 
@@ -31,6 +38,8 @@ static ssize_t   fsdev_write(struct _reent *r, void *fd, const char *ptr, size_t
 static ssize_t   fsdev_write_safe(struct _reent *r, void *fd, const char *ptr, size_t len);
 static ssize_t   fsdev_read(struct _reent *r, void *fd, char *ptr, size_t len);
 static ssize_t   fsdev_read_safe(struct _reent *r, void *fd, char *ptr, size_t len);
+static ssize_t   fsdev_pwrite_safe(struct _reent *r, void *fd, const char *ptr, size_t len, s64 offset);
+static ssize_t   fsdev_pread_safe(struct _reent *r, void *fd, char *ptr, size_t len, s64 offset);
 static off_t     fsdev_seek(struct _reent *r, void *fd, off_t pos, int dir);
 static int       fsdev_fstat(struct _reent *r, void *fd, struct stat *st);
 static int       fsdev_stat(struct _reent *r, const char *file, struct stat *st);
@@ -59,8 +68,40 @@ typedef struct
   int    flags;  /*! Flags used in open(2) */
   s64    offset; /*! Current file offset */
   FsTimeStampRaw timestamps;
+  u8    *cache;        /*! Block cache, NULL when disabled */
+  s64    cache_offset; /*! File offset of the cached block */
+  size_t cache_len;    /*! Valid bytes in the cached block */
+  size_t cache_ra;     /*! Current read-ahead window */
+  bool   cache_dirty;  /*! The cached block holds data not yet written to the file */
+  FsdevAdvice advice;  /*! Access pattern from fsdevFadvise */
+  struct fsdev_fsdevice *device; /*! Device the file was opened on */
+  u32    path_hash;    /*! Hash of the file's FS path, for stat cache invalidation */
+  bool   written;      /*! The file was modified since it was opened */
+  bool   prealloc;     /*! The file is grown ahead of writes, see __nx_fsdev_preallocate_size */
+  s64    size;         /*! Size of the data written, when prealloc is set */
+  s64    allocated;    /*! Size of the file in FS, when prealloc is set */
 } fsdev_file_t;
 
+/*! Largest single read used to fill a mapped file */
+#define FSDEV_MAP_CHUNK_SIZE 0x400000
+
+/*! Smallest read-ahead window, used for non-sequential reads */
+#define FSDEV_CACHE_MIN_READAHEAD 0x1000
+
+/*! One chunk of a bounced transfer */
+typedef struct
+{
+  SfAsyncRequest req;
+  bool           async; /*! req is in flight */
+  Result         rc;
+  u64            bytes;
+  char          *buf;
+  size_t         size;
+  bool           write;
+  u64            tick;  /*! System tick the request was sent at */
+  struct fsdev_fsdevice *device;
+} fsdev_bounce_op_t;
+
 /*! fsdev devoptab */
 static const devoptab_t
 fsdev_devoptab =
@@ -92,20 +133,76 @@ fsdev_devoptab =
   .rmdir_r      = fsdev_rmdir,
 };
 
-typedef struct
+typedef struct fsdev_fsdevice
 {
   bool setup;
   s32 id;
+  u32 name_hash;
   devoptab_t device;
   FsFileSystem fs;
   char *cwd;
   char name[32];
+  FsdevDeviceStats stats;
+  u64 commit_interval; /*! Ticks between automatic commits, 0 when disabled */
+  u64 commit_tick;     /*! System tick of the last commit */
+  bool dirty;          /*! Modified since the last commit */
+  bool committing;     /*! A commit is in progress, see fsdev_commit_locked */
 } fsdev_fsdevice;
 
+/*! Resolved path, see fsdev_fixpath */
+typedef struct
+{
+  u32             hash;       /*! Hash of path */
+  u32             generation; /*! fsdev_path_generation the entry was resolved in */
+  u32             last_used;
+  fsdev_fsdevice *hint;       /*! Device passed in by the caller */
+  fsdev_fsdevice *device;     /*! Resolved device */
+  char            path[FS_MAX_PATH];
+  char            fs_path[FS_MAX_PATH];
+} fsdev_path_cache_entry_t;
+
+/*! Per-thread LRU of resolved paths */
+typedef struct
+{
+  u32                      clock;
+  fsdev_path_cache_entry_t entries[];
+} fsdev_path_cache_t;
+
+/*! Cached result of fsdev_stat */
+typedef struct
+{
+  fsdev_fsdevice *device; /*! NULL for unused entries */
+  u32             hash;   /*! Hash of path */
+  u32             last_used;
+  struct stat     st;
+  char            path[FS_MAX_PATH];
+} fsdev_stat_cache_entry_t;
+
+/*! Number of buckets of the device lookup table, larger than the number of devices */
+#define FSDEV_DEVICE_TABLE_SIZE 64
+
 static bool fsdev_initialised = false;
 static s32 fsdev_fsdevice_cwd;
+static size_t fsdev_file_cache_size;
+static size_t fsdev_preallocate_size;
+static size_t fsdev_bounce_size;
+static s32 fsdev_bounce_slot = -1;
 static __thread Result fsdev_last_result = 0;
 static fsdev_fsdevice fsdev_fsdevices[32];
+static s8 fsdev_device_table[FSDEV_DEVICE_TABLE_SIZE];
+static size_t fsdev_path_cache_size;
+static s32 fsdev_path_cache_slot = -1;
+static u32 fsdev_path_generation = 1;
+static Mutex fsdev_stat_cache_mutex;
+static fsdev_stat_cache_entry_t *fsdev_stat_cache;
+static size_t fsdev_stat_cache_size;
+static u32 fsdev_stat_cache_clock;
+static u32 fsdev_stat_cache_generation;
+static Mutex fsdev_commit_mutex;
+static CondVar fsdev_commit_cond;
+static Thread fsdev_commit_thread;
+static bool fsdev_commit_thread_running;
+static bool fsdev_commit_thread_exit;
 
 /*! @endcond */
 
@@ -113,6 +210,51 @@ _Static_assert((PATH_MAX+1) >= FS_MAX_PATH, "PATH_MAX is too small");
 
 __attribute__((weak)) u32 __nx_fsdev_direntry_cache_size = 32;
 __attribute__((weak)) bool __nx_fsdev_support_cwd = true;
+/// Size of the per-file read-ahead/write-back cache, 0 disables it. Applied when the first device is mounted.
+__attribute__((weak)) u32 __nx_fsdev_file_cache_size = 0;
+/// Size of the per-thread bounce buffer used for memory FS can't access directly, 0 uses a small stack buffer instead.
+__attribute__((weak)) u32 __nx_fsdev_bounce_buffer_size = 0x40000;
+/// Number of resolved paths remembered per thread, 0 disables the path cache. Applied when the first device is mounted.
+__attribute__((weak)) u32 __nx_fsdev_path_cache_size = 0;
+/// Granularity in which files opened for writing are grown ahead of sequential writes, 0 disables preallocation.
+/// Files are trimmed to the size of the data written on fsync/close. Applied when the first device is mounted.
+__attribute__((weak)) u32 __nx_fsdev_preallocate_size = 0;
+/// Number of stat() results remembered, 0 disables the stat cache. Applied when the first device is mounted.
+/// Entries are invalidated by changes made through fs_dev, but not by changes made directly through FS.
+__attribute__((weak)) u32 __nx_fsdev_stat_cache_size = 0;
+
+static u32 fsdevHashName(const char *name)
+{
+  u32 hash = 2166136261u;
+
+  // FNV-1a over the device name, which ends at the colon if there is one
+  for(; *name != '\0' && *name != ':'; name++)
+    hash = (hash ^ (u8)*name) * 16777619u;
+
+  return hash;
+}
+
+static void fsdevUpdateDeviceTable(void)
+{
+  u32 i;
+  u32 total = sizeof(fsdev_fsdevices) / sizeof(fsdev_fsdevice);
+
+  memset(fsdev_device_table, -1, sizeof(fsdev_device_table));
+
+  for(i=0; i<total; i++)
+  {
+    if(!fsdev_fsdevices[i].setup)
+      continue;
+
+    u32 slot = fsdev_fsdevices[i].name_hash % FSDEV_DEVICE_TABLE_SIZE;
+    while(fsdev_device_table[slot] != -1)
+      slot = (slot+1) % FSDEV_DEVICE_TABLE_SIZE;
+    fsdev_device_table[slot] = i;
+  }
+
+  // Resolved paths may refer to a different device or cwd now
+  __atomic_add_fetch(&fsdev_path_generation, 1, __ATOMIC_RELEASE);
+}
 
 static fsdev_fsdevice *fsdevFindDevice(const char *name)
 {
@@ -123,26 +265,382 @@ static fsdev_fsdevice *fsdevFindDevice(const char *name)
   if(!fsdev_initialised)
     return NULL;
 
-  for(i=0; i<total; i++)
+  if(name==NULL) //Find an unused device entry.
   {
-    device = &fsdev_fsdevices[i];
-
-    if(name==NULL) //Find an unused device entry.
+    for(i=0; i<total; i++)
     {
+      device = &fsdev_fsdevices[i];
       if(!device->setup)
         return device;
     }
-    else if(device->setup) //Find the device with the input name.
+
+    return NULL;
+  }
+
+  //Find the device with the input name.
+  u32 hash = fsdevHashName(name);
+  for(i = hash % FSDEV_DEVICE_TABLE_SIZE; fsdev_device_table[i] != -1; i = (i+1) % FSDEV_DEVICE_TABLE_SIZE)
+  {
+    device = &fsdev_fsdevices[fsdev_device_table[i]];
+    if(device->name_hash != hash)
+      continue;
+
+    size_t devnamelen = strlen(device->name);
+    if(strncmp(device->name, name, devnamelen)==0 && (name[devnamelen]=='\0' || name[devnamelen]==':'))
+      return device;
+  }
+
+  return NULL;
+}
+
+/*! Note that a device has changes not committed yet
+ *
+ *  @param[in] device Device which was modified
+ */
+static void
+fsdev_mark_dirty(fsdev_fsdevice *device)
+{
+  // Only the first change since the last commit needs to wake the commit thread
+  if(!__atomic_exchange_n(&device->dirty, true, __ATOMIC_RELAXED)
+  && __atomic_load_n(&device->commit_interval, __ATOMIC_RELAXED) != 0)
+  {
+    mutexLock(&fsdev_commit_mutex);
+    condvarWakeAll(&fsdev_commit_cond);
+    mutexUnlock(&fsdev_commit_mutex);
+  }
+}
+
+/*! Commit a device, fsdev_commit_mutex must be held
+ *
+ *  The mutex is released during the commit itself, so that writers marking
+ *  devices dirty aren't blocked behind the IPC. Commits of the same device
+ *  are serialized with device->committing.
+ *
+ *  @param[in] device Device to commit
+ */
+static Result
+fsdev_commit_locked(fsdev_fsdevice *device)
+{
+  while(device->committing)
+    condvarWait(&fsdev_commit_cond, &fsdev_commit_mutex);
+
+  // Changes made while the commit is in progress leave the device dirty again
+  device->committing = true;
+  __atomic_store_n(&device->dirty, false, __ATOMIC_RELAXED);
+  mutexUnlock(&fsdev_commit_mutex);
+
+  Result rc = fsFsCommit(&device->fs);
+
+  mutexLock(&fsdev_commit_mutex);
+  if(R_FAILED(rc))
+    __atomic_store_n(&device->dirty, true, __ATOMIC_RELAXED);
+  device->commit_tick = armGetSystemTick();
+  device->committing = false;
+  condvarWakeAll(&fsdev_commit_cond);
+  return rc;
+}
+
+/*! Commit thread, commits dirty devices at most once per commit interval */
+static void
+fsdev_commit_thread_func(void *arg)
+{
+  u32 i;
+  u32 total = sizeof(fsdev_fsdevices) / sizeof(fsdev_fsdevice);
+
+  mutexLock(&fsdev_commit_mutex);
+  while(!fsdev_commit_thread_exit)
+  {
+    u64 wait = UINT64_MAX;
+    for(i=0; i<total; i++)
+    {
+      fsdev_fsdevice *device = &fsdev_fsdevices[i];
+      if(!device->setup || device->commit_interval == 0 || !__atomic_load_n(&device->dirty, __ATOMIC_RELAXED))
+        continue;
+
+      // Failed commits (e.g. a file is still open for writing) are retried on the next interval
+      u64 elapsed = armGetSystemTick() - device->commit_tick;
+      if(elapsed >= device->commit_interval)
+      {
+        fsdev_commit_locked(device);
+        elapsed = 0;
+
+        // The mutex was released during the commit, automatic commits may have been disabled meanwhile
+        if(device->commit_interval == 0)
+          continue;
+      }
+      wait = MIN(wait, device->commit_interval - elapsed);
+    }
+
+    condvarWaitTimeout(&fsdev_commit_cond, &fsdev_commit_mutex, wait == UINT64_MAX ? UINT64_MAX : armTicksToNs(wait));
+  }
+  mutexUnlock(&fsdev_commit_mutex);
+}
+
+/*! Account for a read sent to FS
+ *
+ *  @param[in] device Device the file is on
+ *  @param[in] tick   System tick the read was sent at
+ *  @param[in] bytes  Bytes read
+ */
+static void
+fsdev_stats_read(fsdev_fsdevice *device, u64 tick, u64 bytes)
+{
+  u64 ns = armTicksToNs(armGetSystemTick() - tick);
+  __atomic_add_fetch(&device->stats.read_ipc_count, 1, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&device->stats.bytes_read, bytes, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&device->stats.read_ns, ns, __ATOMIC_RELAXED);
+}
+
+/*! Account for a write sent to FS
+ *
+ *  @param[in] device Device the file is on
+ *  @param[in] tick   System tick the write was sent at
+ *  @param[in] bytes  Bytes written
+ */
+static void
+fsdev_stats_write(fsdev_fsdevice *device, u64 tick, u64 bytes)
+{
+  u64 ns = armTicksToNs(armGetSystemTick() - tick);
+  __atomic_add_fetch(&device->stats.write_ipc_count, 1, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&device->stats.bytes_written, bytes, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&device->stats.write_ns, ns, __ATOMIC_RELAXED);
+  if(bytes != 0)
+    fsdev_mark_dirty(device);
+}
+
+/*! fsFileRead on an open file, with device statistics */
+static Result
+fsdev_file_read(fsdev_file_t *file, s64 offset, void *buf, u64 size, u64 *bytes)
+{
+  u64 tick = armGetSystemTick();
+  Result rc = fsFileRead(&file->fd, offset, buf, size, FsReadOption_None, bytes);
+  fsdev_stats_read(file->device, tick, R_SUCCEEDED(rc) ? *bytes : 0);
+  return rc;
+}
+
+/*! fsFileWrite on an open file, with device statistics */
+static Result
+fsdev_file_write(fsdev_file_t *file, s64 offset, const void *buf, u64 size)
+{
+  u64 tick = armGetSystemTick();
+  Result rc = fsFileWrite(&file->fd, offset, buf, size, FsWriteOption_None);
+  fsdev_stats_write(file->device, tick, R_SUCCEEDED(rc) ? size : 0);
+  return rc;
+}
+
+static fsdev_path_cache_t *fsdev_get_path_cache(void)
+{
+  if(fsdev_path_cache_slot < 0)
+    return NULL;
+
+  fsdev_path_cache_t *cache = threadTlsGet(fsdev_path_cache_slot);
+  if(cache == NULL)
+  {
+    cache = calloc(1, sizeof(fsdev_path_cache_t) + fsdev_path_cache_size*sizeof(fsdev_path_cache_entry_t));
+    if(cache == NULL)
+      return NULL;
+    threadTlsSet(fsdev_path_cache_slot, cache);
+  }
+
+  return cache;
+}
+
+static u32 fsdev_hash_path(const char *path, size_t *len)
+{
+  u32 hash = 2166136261u;
+  const char *p;
+
+  for(p = path; *p != '\0'; p++)
+    hash = (hash ^ (u8)*p) * 16777619u;
+
+  *len = p - path;
+  return hash;
+}
+
+static fsdev_path_cache_entry_t*
+fsdev_path_cache_find(fsdev_path_cache_t *cache, const char *path, u32 hash, fsdev_fsdevice *hint)
+{
+  u32 generation = __atomic_load_n(&fsdev_path_generation, __ATOMIC_ACQUIRE);
+
+  for(size_t i=0; i<fsdev_path_cache_size; i++)
+  {
+    fsdev_path_cache_entry_t *entry = &cache->entries[i];
+    if(entry->generation == generation && entry->hash == hash && entry->hint == hint && strcmp(entry->path, path) == 0)
     {
-      size_t devnamelen = strlen(device->name);
-      if(strncmp(device->name, name, devnamelen)==0 && (name[devnamelen]=='\0' || name[devnamelen]==':'))
-        return device;
+      entry->last_used = ++cache->clock;
+      return entry;
     }
   }
 
   return NULL;
 }
 
+static void
+fsdev_path_cache_insert(fsdev_path_cache_t *cache, const char *path, u32 hash, fsdev_fsdevice *hint, fsdev_fsdevice *device, const char *fs_path)
+{
+  u32 generation = __atomic_load_n(&fsdev_path_generation, __ATOMIC_ACQUIRE);
+  fsdev_path_cache_entry_t *victim = &cache->entries[0];
+
+  size_t len = strlen(fs_path);
+  if(len >= FS_MAX_PATH)
+    return;
+
+  /* replace a stale entry, or else the least recently used one */
+  for(size_t i=0; i<fsdev_path_cache_size; i++)
+  {
+    fsdev_path_cache_entry_t *entry = &cache->entries[i];
+    if(entry->generation != generation)
+    {
+      victim = entry;
+      break;
+    }
+    if(entry->last_used < victim->last_used)
+      victim = entry;
+  }
+
+  victim->hash       = hash;
+  victim->generation = generation;
+  victim->last_used  = ++cache->clock;
+  victim->hint       = hint;
+  victim->device     = device;
+  strcpy(victim->path, path);
+  memcpy(victim->fs_path, fs_path, len+1);
+}
+
+/*! Look up a cached stat result
+ *
+ *  @param[in]  device     Device
+ *  @param[in]  fs_path    FS path
+ *  @param[out] st         Stat result
+ *  @param[out] generation Invalidation count to pass to fsdev_stat_cache_insert on a miss
+ *
+ *  @returns whether the path was found
+ */
+static bool
+fsdev_stat_cache_find(fsdev_fsdevice *device, const char *fs_path, struct stat *st, u32 *generation)
+{
+  size_t len;
+  bool found = false;
+  u32 hash = fsdev_hash_path(fs_path, &len);
+
+  mutexLock(&fsdev_stat_cache_mutex);
+  *generation = fsdev_stat_cache_generation;
+  for(size_t i=0; i<fsdev_stat_cache_size; i++)
+  {
+    fsdev_stat_cache_entry_t *entry = &fsdev_stat_cache[i];
+    if(entry->device == device && entry->hash == hash && strcmp(entry->path, fs_path) == 0)
+    {
+      entry->last_used = ++fsdev_stat_cache_clock;
+      *st = entry->st;
+      found = true;
+      break;
+    }
+  }
+  mutexUnlock(&fsdev_stat_cache_mutex);
+
+  return found;
+}
+
+static void
+fsdev_stat_cache_insert(fsdev_fsdevice *device, const char *fs_path, const struct stat *st, u32 generation)
+{
+  size_t len;
+  u32 hash = fsdev_hash_path(fs_path, &len);
+
+  if(len >= FS_MAX_PATH)
+    return;
+
+  mutexLock(&fsdev_stat_cache_mutex);
+
+  /* something was modified while the result was being queried, it may be stale */
+  if(generation != fsdev_stat_cache_generation)
+  {
+    mutexUnlock(&fsdev_stat_cache_mutex);
+    return;
+  }
+
+  /* replace an unused entry, or else the least recently used one */
+  fsdev_stat_cache_entry_t *victim = &fsdev_stat_cache[0];
+  for(size_t i=0; i<fsdev_stat_cache_size; i++)
+  {
+    fsdev_stat_cache_entry_t *entry = &fsdev_stat_cache[i];
+    if(entry->device == NULL)
+    {
+      victim = entry;
+      break;
+    }
+    if(entry->last_used < victim->last_used)
+      victim = entry;
+  }
+
+  victim->device    = device;
+  victim->hash      = hash;
+  victim->last_used = ++fsdev_stat_cache_clock;
+  victim->st        = *st;
+  memcpy(victim->path, fs_path, len+1);
+
+  mutexUnlock(&fsdev_stat_cache_mutex);
+}
+
+/*! Drop cached stat results
+ *
+ *  @param[in] device Device whose entries to drop
+ *  @param[in] all    Drop every entry of the device, otherwise only those matching hash
+ *  @param[in] hash   Hash of the path to drop
+ */
+static void
+fsdev_stat_cache_drop(fsdev_fsdevice *device, bool all, u32 hash)
+{
+  if(fsdev_stat_cache_size == 0)
+    return;
+
+  mutexLock(&fsdev_stat_cache_mutex);
+  fsdev_stat_cache_generation++;
+  for(size_t i=0; i<fsdev_stat_cache_size; i++)
+  {
+    fsdev_stat_cache_entry_t *entry = &fsdev_stat_cache[i];
+    if(entry->device == device && (all || entry->hash == hash))
+      entry->device = NULL;
+  }
+  mutexUnlock(&fsdev_stat_cache_mutex);
+}
+
+static void
+fsdev_stat_cache_invalidate(fsdev_fsdevice *device, const char *fs_path)
+{
+  size_t len;
+
+  fsdev_mark_dirty(device);
+  if(fsdev_stat_cache_size != 0)
+    fsdev_stat_cache_drop(device, fs_path == NULL, fs_path ? fsdev_hash_path(fs_path, &len) : 0);
+}
+
+/*! Invalidate every device backed by fs, after it was written to directly (see fs_dev_copy.c) */
+void
+fsdev_stat_cache_invalidate_fs(FsFileSystem *fs)
+{
+  u32 i;
+  u32 total = sizeof(fsdev_fsdevices) / sizeof(fsdev_fsdevice);
+
+  for(i=0; i<total; i++)
+  {
+    if(fsdev_fsdevices[i].setup && &fsdev_fsdevices[i].fs == fs)
+      fsdev_stat_cache_invalidate(&fsdev_fsdevices[i], NULL);
+  }
+}
+
+/*! Note that a file is being modified, so that stat() doesn't return stale results */
+static void
+fsdev_file_modified(fsdev_file_t *file)
+{
+  file->written = true;
+  if(file->device != NULL)
+  {
+    fsdev_mark_dirty(file->device);
+    fsdev_stat_cache_drop(file->device, false, file->path_hash);
+  }
+}
+
 static const char*
 fsdev_fixpath(struct _reent *r,
              const char    *path,
@@ -152,6 +650,29 @@ fsdev_fixpath(struct _reent *r,
   uint32_t      code;
   const uint8_t *p = (const uint8_t*)path;
   const char *device_path = path;
+  fsdev_fsdevice *hint = device ? *device : NULL;
+  fsdev_path_cache_t *cache = fsdev_get_path_cache();
+  u32 hash = 0;
+
+  // Paths that were resolved since the last mount/unmount/chdir need no revalidation
+  if(cache)
+  {
+    size_t len;
+    hash = fsdev_hash_path(path, &len);
+    if(len >= FS_MAX_PATH)
+      cache = NULL;
+    else
+    {
+      fsdev_path_cache_entry_t *entry = fsdev_path_cache_find(cache, path, hash, hint);
+      if(entry)
+      {
+        strcpy(__nx_dev_path_buf, entry->fs_path);
+        if(device)
+          *device = entry->device;
+        return __nx_dev_path_buf;
+      }
+    }
+  }
 
   // Move the path pointer to the start of the actual path
   do
@@ -224,6 +745,9 @@ fsdev_fixpath(struct _reent *r,
   if(device)
     *device = dev;
 
+  if(cache)
+    fsdev_path_cache_insert(cache, device_path, hash, hint, dev, __nx_dev_path_buf);
+
   return __nx_dev_path_buf;
 }
 
@@ -285,16 +809,40 @@ static void _fsdevInit(void)
   if(!fsdev_initialised)
   {
     memset(fsdev_fsdevices, 0, sizeof(fsdev_fsdevices));
+    fsdev_file_cache_size = __nx_fsdev_file_cache_size;
+    fsdev_preallocate_size = __nx_fsdev_preallocate_size;
+
+    /* bounce buffers are allocated on first use and freed on thread exit */
+    if(fsdev_bounce_slot < 0 && __nx_fsdev_bounce_buffer_size != 0)
+    {
+      fsdev_bounce_slot = threadTlsAlloc(free);
+      fsdev_bounce_size = __nx_fsdev_bounce_buffer_size & ~0xFFF;
+    }
 
     for(i=0; i<total; i++)
     {
       memcpy(&fsdev_fsdevices[i].device, &fsdev_devoptab, sizeof(fsdev_devoptab));
       fsdev_fsdevices[i].device.name = fsdev_fsdevices[i].name;
+      fsdev_fsdevices[i].device.structSize += fsdev_file_cache_size;
       fsdev_fsdevices[i].device.dirStateSize += sizeof(FsDirectoryEntry)*__nx_fsdev_direntry_cache_size;
       fsdev_fsdevices[i].device.deviceData = &fsdev_fsdevices[i];
       fsdev_fsdevices[i].id = i;
     }
 
+    if(fsdev_path_cache_slot < 0 && __nx_fsdev_path_cache_size != 0)
+    {
+      fsdev_path_cache_slot = threadTlsAlloc(free);
+      fsdev_path_cache_size = __nx_fsdev_path_cache_size;
+    }
+
+    if(fsdev_stat_cache == NULL && __nx_fsdev_stat_cache_size != 0)
+    {
+      fsdev_stat_cache = calloc(__nx_fsdev_stat_cache_size, sizeof(fsdev_stat_cache_entry_t));
+      if(fsdev_stat_cache != NULL)
+        fsdev_stat_cache_size = __nx_fsdev_stat_cache_size;
+    }
+
+    memset(fsdev_device_table, -1, sizeof(fsdev_device_table));
     fsdev_fsdevice_cwd = -1;
     fsdev_initialised = true;
   }
@@ -316,12 +864,14 @@ static int _fsdevMountDevice(const char *name, FsFileSystem fs, fsdev_fsdevice *
   device->fs = fs;
   memset(device->name, 0, sizeof(device->name));
   strncpy(device->name, name, sizeof(device->name)-1);
+  device->name_hash = fsdevHashName(device->name);
 
   int dev = AddDevice(&device->device);
   if(dev==-1)
     goto _fail;
 
   device->setup = 1;
+  memset(&device->stats, 0, sizeof(device->stats));
   device->cwd = __nx_fsdev_support_cwd ? malloc(FS_MAX_PATH) : NULL;
   if(device->cwd!=NULL)
   {
@@ -332,6 +882,8 @@ static int _fsdevMountDevice(const char *name, FsFileSystem fs, fsdev_fsdevice *
   if(fsdev_fsdevice_cwd==-1)
     fsdev_fsdevice_cwd = device->id;
 
+  fsdevUpdateDeviceTable();
+
   const devoptab_t *default_dev = GetDeviceOpTab("");
   if(default_dev==NULL || strcmp(default_dev->name, "stdnull")==0)
     setDefaultDevice(dev);
@@ -363,6 +915,18 @@ static int _fsdevUnmountDeviceStruct(fsdev_fsdevice *device)
   strncat(name, ":", sizeof(name)-strlen(name)-1);
 
   RemoveDevice(name);
+
+  // Flush what automatic commits didn't get to yet, and keep the commit thread away from the device
+  mutexLock(&fsdev_commit_mutex);
+  if(device->commit_interval != 0 && __atomic_load_n(&device->dirty, __ATOMIC_RELAXED))
+    fsdev_commit_locked(device);
+  __atomic_store_n(&device->commit_interval, 0, __ATOMIC_RELAXED);
+  while(device->committing)
+    condvarWait(&fsdev_commit_cond, &fsdev_commit_mutex);
+  mutexUnlock(&fsdev_commit_mutex);
+
+  fsdev_stat_cache_invalidate(device, NULL);
+  device->dirty = false;
   free(device->cwd);
   fsFsClose(&device->fs);
 
@@ -371,6 +935,7 @@ static int _fsdevUnmountDeviceStruct(fsdev_fsdevice *device)
 
   device->setup = 0;
   memset(device->name, 0, sizeof(device->name));
+  fsdevUpdateDeviceTable();
 
   return 0;
 }
@@ -394,7 +959,72 @@ Result fsdevCommitDevice(const char *name)
   if(device==NULL)
     return MAKERESULT(Module_Libnx, LibnxError_NotFound);
 
-  return fsFsCommit(&device->fs);
+  mutexLock(&fsdev_commit_mutex);
+  Result rc = fsdev_commit_locked(device);
+  mutexUnlock(&fsdev_commit_mutex);
+
+  return rc;
+}
+
+Result fsdevCommitBarrier(const char *name)
+{
+  fsdev_fsdevice *device;
+  Result rc = 0;
+
+  device = fsdevFindDevice(name);
+  if(device==NULL)
+    return MAKERESULT(Module_Libnx, LibnxError_NotFound);
+
+  mutexLock(&fsdev_commit_mutex);
+  if(__atomic_load_n(&device->dirty, __ATOMIC_RELAXED))
+    rc = fsdev_commit_locked(device);
+  mutexUnlock(&fsdev_commit_mutex);
+
+  return rc;
+}
+
+Result fsdevSetAutoCommit(const char *name, u64 interval_ns)
+{
+  fsdev_fsdevice *device;
+  Result rc = 0;
+
+  device = fsdevFindDevice(name);
+  if(device==NULL)
+    return MAKERESULT(Module_Libnx, LibnxError_NotFound);
+
+  mutexLock(&fsdev_commit_mutex);
+
+  if(interval_ns != 0 && !fsdev_commit_thread_running)
+  {
+    u32 prio = 0x2C;
+    svcGetThreadPriority(&prio, CUR_THREAD_HANDLE);
+
+    fsdev_commit_thread_exit = false;
+    rc = threadCreate(&fsdev_commit_thread, fsdev_commit_thread_func, NULL, NULL, 0x4000, prio, -2);
+    if(R_SUCCEEDED(rc))
+    {
+      rc = threadStart(&fsdev_commit_thread);
+      if(R_FAILED(rc))
+        threadClose(&fsdev_commit_thread);
+    }
+    fsdev_commit_thread_running = R_SUCCEEDED(rc);
+  }
+
+  if(R_SUCCEEDED(rc))
+  {
+    // Pending changes are flushed when automatic commits are disabled
+    if(interval_ns == 0 && device->commit_interval != 0 && __atomic_load_n(&device->dirty, __ATOMIC_RELAXED))
+      rc = fsdev_commit_locked(device);
+
+    if(device->commit_interval == 0)
+      device->commit_tick = armGetSystemTick();
+    __atomic_store_n(&device->commit_interval, interval_ns ? MAX(armNsToTicks(interval_ns), 1) : 0, __ATOMIC_RELAXED);
+    condvarWakeAll(&fsdev_commit_cond);
+  }
+
+  mutexUnlock(&fsdev_commit_mutex);
+
+  return rc;
 }
 
 Result fsdevSetConcatenationFileAttribute(const char *path) {
@@ -424,33 +1054,101 @@ Result fsdevCreateFile(const char* path, size_t size, u32 flags) {
   if(fsdev_getfspath(_REENT, path, &device, fs_path)==-1)
     return MAKERESULT(Module_Libnx, LibnxError_NotFound);
 
-  return fsFsCreateFile(&device->fs, fs_path, size, flags);
+  Result rc = fsFsCreateFile(&device->fs, fs_path, size, flags);
+  fsdev_stat_cache_invalidate(device, fs_path);
+  return rc;
 }
 
-Result fsdevDeleteDirectoryRecursively(const char *path) {
+Result fsdevMapFile(const char *path, const void **out_ptr, size_t *out_size) {
   char           *fs_path = __nx_dev_path_buf;
   fsdev_fsdevice *device = NULL;
+  FsFile          fd;
+  s64             size = 0;
+  u64             bytes = 0;
 
   if(fsdev_getfspath(_REENT, path, &device, fs_path)==-1)
     return MAKERESULT(Module_Libnx, LibnxError_NotFound);
 
-  return fsFsDeleteDirectoryRecursively(&device->fs, fs_path);
-}
+  Result rc = fsFsOpenFile(&device->fs, fs_path, FsOpenMode_Read, &fd);
+  if(R_FAILED(rc))
+    return rc;
 
-/*! Initialize SDMC device */
-Result fsdevMountSdmc(void)
-{
-  FsFileSystem fs;
-  Result rc = fsOpenSdCardFileSystem(&fs);
+  rc = fsFileGetSize(&fd, &size);
+
+  size_t alloc_size = ((size_t)size + 0xFFF) & ~0xFFF;
+  u8 *buf = NULL;
   if(R_SUCCEEDED(rc))
   {
-    int ret = fsdevMountDevice("sdmc", fs);
-    if(ret==-1)
+    buf = memalign(0x1000, alloc_size ? alloc_size : 0x1000);
+    if(buf == NULL)
       rc = MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
   }
 
-  return rc;
-}
+  /* fill everything up front, in large chunks */
+  for(s64 offset = 0; R_SUCCEEDED(rc) && offset < size; offset += bytes)
+  {
+    u64 toRead = MIN(size - offset, FSDEV_MAP_CHUNK_SIZE);
+    u64 tick = armGetSystemTick();
+    rc = fsFileRead(&fd, offset, buf + offset, toRead, FsReadOption_None, &bytes);
+    fsdev_stats_read(device, tick, R_SUCCEEDED(rc) ? bytes : 0);
+    if(R_SUCCEEDED(rc) && bytes != toRead)
+      rc = MAKERESULT(Module_Libnx, LibnxError_IoError);
+  }
+
+  fsFileClose(&fd);
+
+  /* the mapping is read-only, so catch stray writes */
+  if(R_SUCCEEDED(rc) && alloc_size)
+    rc = svcSetMemoryPermission(buf, alloc_size, Perm_R);
+
+  if(R_FAILED(rc))
+  {
+    free(buf);
+    return rc;
+  }
+
+  *out_ptr  = buf;
+  *out_size = size;
+  return 0;
+}
+
+void fsdevUnmapFile(const void *ptr, size_t size) {
+  size_t alloc_size = (size + 0xFFF) & ~0xFFF;
+
+  if(ptr == NULL)
+    return;
+
+  if(alloc_size)
+    svcSetMemoryPermission((void*)ptr, alloc_size, Perm_Rw);
+  free((void*)ptr);
+}
+
+Result fsdevDeleteDirectoryRecursively(const char *path) {
+  char           *fs_path = __nx_dev_path_buf;
+  fsdev_fsdevice *device = NULL;
+
+  if(fsdev_getfspath(_REENT, path, &device, fs_path)==-1)
+    return MAKERESULT(Module_Libnx, LibnxError_NotFound);
+
+  Result rc = fsFsDeleteDirectoryRecursively(&device->fs, fs_path);
+  fsdev_stat_cache_invalidate(device, NULL);
+  return rc;
+}
+
+/*! Initialize SDMC device */
+Result fsdevMountSdmc(void)
+{
+  FsFileSystem fs;
+  Result rc = fsOpenSdCardFileSystem(&fs);
+  if(R_SUCCEEDED(rc))
+  {
+    int ret = fsdevMountDevice("sdmc", fs);
+    if(ret==-1)
+      rc = MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+  }
+
+  return rc;
+}
 
 Result fsdevMountSaveData(const char *name, u64 application_id, AccountUid uid)
 {
@@ -465,89 +1163,878 @@ Result fsdevMountSaveData(const char *name, u64 application_id, AccountUid uid)
   return rc;
 }
 
-Result fsdevMountSystemSaveData(const char *name, FsSaveDataSpaceId save_data_space_id, u64 system_save_data_id, AccountUid uid)
+Result fsdevMountSystemSaveData(const char *name, FsSaveDataSpaceId save_data_space_id, u64 system_save_data_id, AccountUid uid)
+{
+  FsFileSystem fs;
+  Result rc = fsOpen_SystemSaveData(&fs, save_data_space_id, system_save_data_id, uid);
+  if(R_SUCCEEDED(rc))
+  {
+    int ret = fsdevMountDevice(name, fs);
+    if(ret==-1)
+      rc = MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+  }
+  return rc;
+}
+
+void __libnx_init_cwd(void)
+{
+  if(envIsNso() || __system_argc==0 || __system_argv[0] == NULL)
+    return;
+
+  char *last_slash = NULL;
+  char *p = __system_argv[0];
+  uint32_t code;
+  do
+  {
+    ssize_t units = decode_utf8(&code, (const uint8_t*)p);
+    if(units < 0)
+    {
+      last_slash = NULL;
+      break;
+    }
+
+    if(code == '/')
+      last_slash = p;
+
+    p += units;
+  } while(code != 0);
+
+  if(last_slash != NULL)
+  {
+    last_slash[0] = 0;
+    chdir(__system_argv[0]);
+    last_slash[0] = '/';
+  }
+}
+
+/*! Clean up fsdev devices */
+Result fsdevUnmountAll(void)
+{
+  u32 i;
+  u32 total = sizeof(fsdev_fsdevices) / sizeof(fsdev_fsdevice);
+  Result rc=0;
+
+  if(!fsdev_initialised) return rc;
+
+  for(i=0; i<total; i++)
+  {
+    _fsdevUnmountDeviceStruct(&fsdev_fsdevices[i]);
+  }
+
+  if(fsdev_commit_thread_running)
+  {
+    mutexLock(&fsdev_commit_mutex);
+    fsdev_commit_thread_exit = true;
+    condvarWakeAll(&fsdev_commit_cond);
+    mutexUnlock(&fsdev_commit_mutex);
+
+    threadWaitForExit(&fsdev_commit_thread);
+    threadClose(&fsdev_commit_thread);
+    fsdev_commit_thread_running = false;
+  }
+
+  fsdev_initialised = false;
+
+  return 0;
+}
+
+Result fsdevGetDeviceStats(const char *name, FsdevDeviceStats *out)
+{
+  fsdev_fsdevice *device = fsdevFindDevice(name);
+  if(device==NULL)
+    return MAKERESULT(Module_Libnx, LibnxError_NotFound);
+
+  out->read_ipc_count  = __atomic_load_n(&device->stats.read_ipc_count, __ATOMIC_RELAXED);
+  out->write_ipc_count = __atomic_load_n(&device->stats.write_ipc_count, __ATOMIC_RELAXED);
+  out->bytes_read      = __atomic_load_n(&device->stats.bytes_read, __ATOMIC_RELAXED);
+  out->bytes_written   = __atomic_load_n(&device->stats.bytes_written, __ATOMIC_RELAXED);
+  out->read_ns         = __atomic_load_n(&device->stats.read_ns, __ATOMIC_RELAXED);
+  out->write_ns        = __atomic_load_n(&device->stats.write_ns, __ATOMIC_RELAXED);
+  out->bounce_count    = __atomic_load_n(&device->stats.bounce_count, __ATOMIC_RELAXED);
+  return 0;
+}
+
+Result fsdevResetDeviceStats(const char *name)
+{
+  fsdev_fsdevice *device = fsdevFindDevice(name);
+  if(device==NULL)
+    return MAKERESULT(Module_Libnx, LibnxError_NotFound);
+
+  __atomic_store_n(&device->stats.read_ipc_count, 0, __ATOMIC_RELAXED);
+  __atomic_store_n(&device->stats.write_ipc_count, 0, __ATOMIC_RELAXED);
+  __atomic_store_n(&device->stats.bytes_read, 0, __ATOMIC_RELAXED);
+  __atomic_store_n(&device->stats.bytes_written, 0, __ATOMIC_RELAXED);
+  __atomic_store_n(&device->stats.read_ns, 0, __ATOMIC_RELAXED);
+  __atomic_store_n(&device->stats.write_ns, 0, __ATOMIC_RELAXED);
+  __atomic_store_n(&device->stats.bounce_count, 0, __ATOMIC_RELAXED);
+  return 0;
+}
+
+FsFileSystem* fsdevGetDeviceFileSystem(const char *name)
+{
+  fsdev_fsdevice *device;
+
+  device = fsdevFindDevice(name);
+  if(device==NULL)
+    return NULL;
+
+  return &device->fs;
+}
+
+int fsdevTranslatePath(const char *path, FsFileSystem** device, char *outpath)
+{
+  fsdev_fsdevice *tmpdev = NULL;
+
+  int ret = fsdev_getfspath(_REENT, path, &tmpdev, outpath);
+  if(ret==-1)return ret;
+
+  if(device)*device = &tmpdev->fs;
+  return ret;
+}
+
+/*! Look up the fsdev directory behind a DIR
+ *
+ *  @param[in] dirp Directory stream
+ *
+ *  @returns directory, or NULL with errno set
+ */
+static fsdev_dir_t*
+fsdev_get_dir(DIR *dirp)
+{
+  if(dirp == NULL || dirp->dirData == NULL)
+  {
+    errno = EBADF;
+    return NULL;
+  }
+
+  fsdev_dir_t *dir = (fsdev_dir_t*)dirp->dirData->dirStruct;
+  if(dir->magic != FSDEV_DIRITER_MAGIC)
+  {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  return dir;
+}
+
+/*! Take entries that fsdev_dirnext already fetched but hasn't returned yet
+ *
+ *  @param[in,out] dir         Directory
+ *  @param[out]    entries     Output entries
+ *  @param[in]     max_entries Maximum number of entries to take
+ *
+ *  @returns number of entries taken
+ */
+static size_t
+fsdev_dir_take_cached(fsdev_dir_t *dir, FsDirectoryEntry *entries, size_t max_entries)
+{
+  if(dir->index + 1 >= (ssize_t)dir->size)
+    return 0;
+
+  size_t count = MIN(max_entries, dir->size - (dir->index + 1));
+  memcpy(entries, &fsdevDirGetEntries(dir)[dir->index + 1], count*sizeof(FsDirectoryEntry));
+  dir->index += count;
+
+  return count;
+}
+
+ssize_t fsdevReadDirEntries(DIR *dirp, FsDirectoryEntry *entries, size_t max_entries)
+{
+  Result rc;
+  s64 count = 0;
+  fsdev_dir_t *dir = fsdev_get_dir(dirp);
+
+  if(dir == NULL)
+    return -1;
+
+  size_t total = fsdev_dir_take_cached(dir, entries, max_entries);
+  if(total < max_entries)
+  {
+    rc = fsDirRead(&dir->fd, &count, max_entries - total, &entries[total]);
+    if(R_FAILED(rc))
+    {
+      if(total > 0)
+        return total;
+
+      errno = fsdev_translate_error(rc);
+      return -1;
+    }
+    total += count;
+  }
+
+  return total;
+}
+
+ssize_t fsdevReadAllDirEntries(DIR *dirp, FsDirectoryEntry **out_entries)
+{
+  Result rc;
+  s64 count = 0;
+  size_t total = 0, capacity;
+  fsdev_dir_t *dir = fsdev_get_dir(dirp);
+
+  *out_entries = NULL;
+  if(dir == NULL)
+    return -1;
+
+  /* size the buffer from the directory's entry count, growing it if entries were added since */
+  rc = fsDirGetEntryCount(&dir->fd, &count);
+  capacity = R_SUCCEEDED(rc) && count > 0 ? count : __nx_fsdev_direntry_cache_size;
+  capacity = MAX(capacity, dir->size) + 1;
+
+  FsDirectoryEntry *entries = malloc(capacity*sizeof(FsDirectoryEntry));
+  if(entries == NULL)
+  {
+    errno = ENOMEM;
+    return -1;
+  }
+
+  total = fsdev_dir_take_cached(dir, entries, capacity);
+  while(true)
+  {
+    if(total == capacity)
+    {
+      FsDirectoryEntry *tmp = realloc(entries, 2*capacity*sizeof(FsDirectoryEntry));
+      if(tmp == NULL)
+      {
+        free(entries);
+        errno = ENOMEM;
+        return -1;
+      }
+      entries = tmp;
+      capacity *= 2;
+    }
+
+    rc = fsDirRead(&dir->fd, &count, capacity - total, &entries[total]);
+    if(R_FAILED(rc))
+    {
+      free(entries);
+      errno = fsdev_translate_error(rc);
+      return -1;
+    }
+
+    if(count == 0)
+      break;
+    total += count;
+  }
+
+  *out_entries = entries;
+  return total;
+}
+
+/*! Get the calling thread's bounce buffer
+ *
+ *  @param[out] size Size of the buffer
+ *
+ *  @returns buffer, or NULL when unavailable
+ */
+static char*
+fsdev_get_bounce_buffer(size_t *size)
+{
+  if(fsdev_bounce_slot < 0 || fsdev_bounce_size == 0)
+    return NULL;
+
+  char *buf = threadTlsGet(fsdev_bounce_slot);
+  if(buf == NULL)
+  {
+    buf = memalign(0x1000, fsdev_bounce_size);
+    if(buf == NULL)
+      return NULL;
+    threadTlsSet(fsdev_bounce_slot, buf);
+  }
+
+  *size = fsdev_bounce_size;
+  return buf;
+}
+
+/*! Start reading one chunk of a bounced transfer
+ *
+ *  @param[in,out] file   Pointer to fsdev_file_t
+ *  @param[out]    op     Chunk state
+ *  @param[in]     offset File offset
+ *  @param[out]    buf    Bounce buffer to read into
+ *  @param[in]     size   Length of data to read
+ *  @param[in]     async  Whether to send the request without waiting for it
+ */
+static void
+fsdev_bounce_read_begin(fsdev_file_t *file, fsdev_bounce_op_t *op, s64 offset, char *buf, size_t size, bool async)
+{
+  op->buf    = buf;
+  op->size   = size;
+  op->bytes  = 0;
+  op->write  = false;
+  op->tick   = armGetSystemTick();
+  op->device = file->device;
+  op->async  = async && R_SUCCEEDED(fsFileReadAsync(&file->fd, &op->req, offset, buf, size, FsReadOption_None, &op->bytes));
+  if(!op->async)
+    op->rc = fsFileRead(&file->fd, offset, buf, size, FsReadOption_None, &op->bytes);
+}
+
+/*! Start writing one chunk of a bounced transfer
+ *
+ *  @param[in,out] file   Pointer to fsdev_file_t
+ *  @param[out]    op     Chunk state
+ *  @param[in]     offset File offset
+ *  @param[in]     buf    Bounce buffer to write from
+ *  @param[in]     size   Length of data to write
+ *  @param[in]     async  Whether to send the request without waiting for it
+ */
+static void
+fsdev_bounce_write_begin(fsdev_file_t *file, fsdev_bounce_op_t *op, s64 offset, char *buf, size_t size, bool async)
+{
+  op->buf    = buf;
+  op->size   = size;
+  op->bytes  = size;
+  op->write  = true;
+  op->tick   = armGetSystemTick();
+  op->device = file->device;
+  op->async  = async && R_SUCCEEDED(fsFileWriteAsync(&file->fd, &op->req, offset, buf, size, FsWriteOption_None));
+  if(!op->async)
+    op->rc = fsFileWrite(&file->fd, offset, buf, size, FsWriteOption_None);
+}
+
+/*! Finish one chunk of a bounced transfer
+ *
+ *  @param[in,out] op Chunk state
+ *
+ *  @returns result
+ */
+static Result
+fsdev_bounce_end(fsdev_bounce_op_t *op)
+{
+  if(op->async)
+  {
+    op->rc    = sfasyncEnd(&op->req);
+    op->async = false;
+  }
+
+  u64 bytes = R_SUCCEEDED(op->rc) ? op->bytes : 0;
+  if(op->write)
+    fsdev_stats_write(op->device, op->tick, bytes);
+  else
+    fsdev_stats_read(op->device, op->tick, bytes);
+
+  return op->rc;
+}
+
+/*! Look up the fsdev file behind a file descriptor
+ *
+ *  @param[in] fd File descriptor
+ *
+ *  @returns file, or NULL with errno set
+ */
+static fsdev_file_t*
+fsdev_get_file(int fd)
+{
+  __handle *handle = __get_handle(fd);
+  if(handle == NULL)
+  {
+    errno = EBADF;
+    return NULL;
+  }
+
+  if(devoptab_list[handle->device]->open_r != fsdev_open)
+  {
+    errno = ESPIPE;
+    return NULL;
+  }
+
+  return (fsdev_file_t*)handle->fileStruct;
+}
+
+/*! Make room for a write that ends at the specified offset
+ *
+ *  @param[in,out] file Pointer to fsdev_file_t
+ *  @param[in]     end  End offset of the write
+ *
+ *  @returns result
+ */
+static Result
+fsdev_preallocate(fsdev_file_t *file, s64 end)
+{
+  Result rc = 0;
+
+  if(end > file->allocated)
+  {
+    /* grow by at least one granule so that sequential writes overwrite preallocated space */
+    s64 new_size = MAX(end, file->allocated + (s64)fsdev_preallocate_size);
+    new_size = (new_size + fsdev_preallocate_size - 1) / fsdev_preallocate_size * fsdev_preallocate_size;
+
+    rc = fsFileSetSize(&file->fd, new_size);
+    if(R_SUCCEEDED(rc))
+      file->allocated = new_size;
+  }
+
+  return rc;
+}
+
+/*! Shrink a preallocated file back to the size of the data written
+ *
+ *  @param[in,out] file Pointer to fsdev_file_t
+ *
+ *  @returns result
+ */
+static Result
+fsdev_preallocate_trim(fsdev_file_t *file)
+{
+  Result rc = 0;
+
+  if(file->prealloc && file->allocated > file->size)
+  {
+    rc = fsFileSetSize(&file->fd, file->size);
+    if(R_SUCCEEDED(rc))
+      file->allocated = file->size;
+  }
+
+  return rc;
+}
+
+/*! Write back the pending block of a file's cache
+ *
+ *  The cached data stays valid for reading afterwards.
+ *
+ *  @param[in,out] file Pointer to fsdev_file_t
+ *
+ *  @returns result
+ */
+static Result
+fsdev_cache_flush(fsdev_file_t *file)
+{
+  Result rc = 0;
+
+  if(file->cache_dirty)
+  {
+    rc = fsdev_file_write(file, file->cache_offset, file->cache, file->cache_len);
+    if(R_SUCCEEDED(rc))
+      file->cache_dirty = false;
+  }
+
+  return rc;
+}
+
+/*! Write back and drop a file's cache
+ *
+ *  @param[in,out] file Pointer to fsdev_file_t
+ *
+ *  @returns result
+ */
+static Result
+fsdev_cache_invalidate(fsdev_file_t *file)
+{
+  Result rc = fsdev_cache_flush(file);
+  if(R_SUCCEEDED(rc))
+    file->cache_len = 0;
+
+  return rc;
+}
+
+/*! Read from an open file through its cache
+ *
+ *  @param[in,out] r    newlib reentrancy struct
+ *  @param[in,out] file Pointer to fsdev_file_t
+ *  @param[out]    ptr  Pointer to buffer to read into
+ *  @param[in]     len  Length of data to read
+ *
+ *  @returns number of bytes read
+ *  @returns -1 for error
+ */
+static ssize_t
+fsdev_read_cached(struct _reent *r,
+                 fsdev_file_t  *file,
+                 char          *ptr,
+                 size_t        len)
+{
+  Result      rc;
+  u64         bytes;
+  size_t      bytesRead = 0;
+  bool        eof = false;
+  const size_t cap = fsdev_file_cache_size;
+
+  /* pending writes must land before they can be read back */
+  rc = fsdev_cache_flush(file);
+  if(R_FAILED(rc))
+  {
+    r->_errno = fsdev_translate_error(rc);
+    return -1;
+  }
+
+  while(len > 0)
+  {
+    s64 cache_end = file->cache_offset + (s64)file->cache_len;
+
+    /* serve what we can from the cached block */
+    if(file->offset >= file->cache_offset && file->offset < cache_end)
+    {
+      size_t pos = file->offset - file->cache_offset;
+      size_t toCopy = MIN(len, file->cache_len - pos);
+
+      memcpy(ptr, file->cache + pos, toCopy);
+      file->offset += toCopy;
+      bytesRead    += toCopy;
+      ptr          += toCopy;
+      len          -= toCopy;
+      continue;
+    }
+
+    if(eof)
+      break;
+
+    /* big reads go straight to the caller's buffer, unless FS can't use it */
+    if(len >= cap)
+    {
+      rc = fsdev_file_read(file, file->offset, ptr, len, &bytes);
+      if(R_SUCCEEDED(rc))
+      {
+        if(bytes > len)
+          bytes = len;
+        file->offset += bytes;
+        bytesRead    += bytes;
+        break;
+      }
+      if(rc != 0xD401)
+        goto _fail;
+    }
+
+    /* grow the read-ahead window while the file is read sequentially */
+    size_t toRead = FSDEV_CACHE_MIN_READAHEAD;
+    if(file->advice == FsdevAdvice_Sequential)
+      toRead = cap;
+    else if(file->advice != FsdevAdvice_Random && file->cache_len != 0 && file->offset == cache_end)
+      toRead = file->cache_ra * 2;
+    toRead = MIN(MAX(toRead, len), cap);
+
+    file->cache_len = 0;
+    rc = fsdev_file_read(file, file->offset, file->cache, toRead, &bytes);
+    if(R_FAILED(rc))
+      goto _fail;
+
+    if(bytes > toRead)
+      bytes = toRead;
+
+    file->cache_offset = file->offset;
+    file->cache_len    = bytes;
+    file->cache_ra     = toRead;
+    eof = bytes < toRead;
+  }
+
+  return bytesRead;
+
+_fail:
+  /* return partial transfer */
+  if(bytesRead > 0)
+    return bytesRead;
+
+  r->_errno = fsdev_translate_error(rc);
+  return -1;
+}
+
+/*! Write to an open file through its cache
+ *
+ *  Consecutive writes are coalesced into one block which is written back when
+ *  it is full, when the file is accessed elsewhere, or on fsync/close.
+ *
+ *  @param[in,out] r    newlib reentrancy struct
+ *  @param[in,out] file Pointer to fsdev_file_t
+ *  @param[in]     ptr  Pointer to data to write
+ *  @param[in]     len  Length of data to write
+ *
+ *  @returns number of bytes written
+ *  @returns -1 for error
+ */
+static ssize_t
+fsdev_write_cached(struct _reent *r,
+                  fsdev_file_t  *file,
+                  const char    *ptr,
+                  size_t        len)
+{
+  Result      rc;
+  size_t      bytesWritten = 0;
+  bool        bounce = false;
+  const size_t cap = fsdev_file_cache_size;
+
+  while(len > 0)
+  {
+    /* start a new block unless this write continues the pending one */
+    if(!file->cache_dirty || file->cache_len == cap ||
+       file->offset != file->cache_offset + (s64)file->cache_len)
+    {
+      rc = fsdev_cache_invalidate(file);
+      if(R_FAILED(rc))
+        goto _fail;
+
+      file->cache_offset = file->offset;
+
+      /* big writes go straight from the caller's buffer, unless FS can't use it */
+      if(len >= cap && !bounce)
+      {
+        rc = fsdev_file_write(file, file->offset, ptr, len);
+        if(R_SUCCEEDED(rc))
+        {
+          file->offset += len;
+          bytesWritten += len;
+          break;
+        }
+        if(rc != 0xD401)
+          goto _fail;
+        bounce = true;
+      }
+    }
+
+    size_t toCopy = MIN(len, cap - file->cache_len);
+
+    memcpy(file->cache + file->cache_len, ptr, toCopy);
+    file->cache_len  += toCopy;
+    file->cache_dirty = true;
+    file->offset     += toCopy;
+    bytesWritten     += toCopy;
+    ptr              += toCopy;
+    len              -= toCopy;
+  }
+
+  return bytesWritten;
+
+_fail:
+  /* return partial transfer */
+  if(bytesWritten > 0)
+    return bytesWritten;
+
+  r->_errno = fsdev_translate_error(rc);
+  return -1;
+}
+
+/*! Record the end of a positional write in a preallocated file's size
+ *
+ *  @param[in,out] file Pointer to fsdev_file_t
+ *  @param[in]     end  End offset of the write
+ */
+static void
+fsdev_pwrite_extend(fsdev_file_t *file, s64 end)
+{
+  if(!file->prealloc)
+    return;
+
+  /* positional writes may run concurrently, so only ever raise the size */
+  s64 size = __atomic_load_n(&file->size, __ATOMIC_RELAXED);
+  while(size < end && !__atomic_compare_exchange_n(&file->size, &size, end, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+ssize_t fsdevPread(int fd, void *buf, size_t len, off_t offset)
+{
+  Result rc;
+  u64 bytes;
+  fsdev_file_t *file = fsdev_get_file(fd);
+
+  if(file == NULL)
+    return -1;
+
+  if((file->flags & O_ACCMODE) == O_WRONLY || offset < 0)
+  {
+    errno = offset < 0 ? EINVAL : EBADF;
+    return -1;
+  }
+
+  /* don't read into preallocated space */
+  if(file->prealloc)
+  {
+    s64 size = __atomic_load_n(&file->size, __ATOMIC_RELAXED);
+    if(offset >= size)
+      return 0;
+    len = MIN(len, (u64)(size - offset));
+  }
+
+  rc = fsdev_file_read(file, offset, buf, len, &bytes);
+  if(rc == 0xD401)
+    return fsdev_pread_safe(_REENT, file, buf, len, offset);
+  if(R_SUCCEEDED(rc))
+    return (ssize_t)MIN(bytes, len);
+
+  errno = fsdev_translate_error(rc);
+  return -1;
+}
+
+ssize_t fsdevPwrite(int fd, const void *buf, size_t len, off_t offset)
+{
+  Result rc;
+  fsdev_file_t *file = fsdev_get_file(fd);
+
+  if(file == NULL)
+    return -1;
+
+  if((file->flags & O_ACCMODE) == O_RDONLY || offset < 0)
+  {
+    errno = offset < 0 ? EINVAL : EBADF;
+    return -1;
+  }
+
+  fsdev_file_modified(file);
+
+  rc = fsdev_file_write(file, offset, buf, len);
+  if(rc == 0xD401)
+  {
+    ssize_t ret = fsdev_pwrite_safe(_REENT, file, buf, len, offset);
+    if(ret > 0)
+      fsdev_pwrite_extend(file, offset + ret);
+    return ret;
+  }
+  if(R_FAILED(rc))
+  {
+    errno = fsdev_translate_error(rc);
+    return -1;
+  }
+
+  if(file->flags & O_SYNC)
+    fsFileFlush(&file->fd);
+
+  fsdev_pwrite_extend(file, offset + len);
+  return len;
+}
+
+ssize_t fsdevPreadv(int fd, const struct iovec *iov, int iovcnt, off_t offset)
 {
-  FsFileSystem fs;
-  Result rc = fsOpen_SystemSaveData(&fs, save_data_space_id, system_save_data_id, uid);
-  if(R_SUCCEEDED(rc))
+  ssize_t total = 0;
+
+  for(int i=0; i<iovcnt; i++)
   {
-    int ret = fsdevMountDevice(name, fs);
-    if(ret==-1)
-      rc = MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+    ssize_t ret = fsdevPread(fd, iov[i].iov_base, iov[i].iov_len, offset + total);
+    if(ret < 0)
+      return total > 0 ? total : -1;
+
+    total += ret;
+    if((size_t)ret < iov[i].iov_len)
+      break;
   }
-  return rc;
+
+  return total;
 }
 
-void __libnx_init_cwd(void)
+int fsdevFallocate(int fd, off_t offset, off_t len)
 {
-  if(envIsNso() || __system_argc==0 || __system_argv[0] == NULL)
-    return;
+  Result rc;
+  s64 size;
+  fsdev_file_t *file = fsdev_get_file(fd);
 
-  char *last_slash = NULL;
-  char *p = __system_argv[0];
-  uint32_t code;
-  do
-  {
-    ssize_t units = decode_utf8(&code, (const uint8_t*)p);
-    if(units < 0)
-    {
-      last_slash = NULL;
-      break;
-    }
+  if(file == NULL)
+    return errno;
 
-    if(code == '/')
-      last_slash = p;
+  if(offset < 0 || len <= 0)
+    return EINVAL;
 
-    p += units;
-  } while(code != 0);
+  if((file->flags & O_ACCMODE) == O_RDONLY)
+    return EBADF;
 
-  if(last_slash != NULL)
+  if(file->prealloc)
   {
-    last_slash[0] = 0;
-    chdir(__system_argv[0]);
-    last_slash[0] = '/';
+    rc = fsdev_preallocate(file, offset + len);
+
+    /* posix_fallocate() extends the visible size too */
+    if(R_SUCCEEDED(rc) && file->size < offset + len)
+    {
+      file->size = offset + len;
+      fsdev_file_modified(file);
+    }
   }
+  else
+  {
+    rc = fsFileGetSize(&file->fd, &size);
+    if(R_SUCCEEDED(rc) && size < offset + len)
+    {
+      rc = fsFileSetSize(&file->fd, offset + len);
+      fsdev_file_modified(file);
+    }
+  }
+
+  return R_SUCCEEDED(rc) ? 0 : fsdev_translate_error(rc);
 }
 
-/*! Clean up fsdev devices */
-Result fsdevUnmountAll(void)
+int fsdevFadvise(int fd, off_t offset, off_t len, FsdevAdvice advice)
 {
-  u32 i;
-  u32 total = sizeof(fsdev_fsdevices) / sizeof(fsdev_fsdevice);
-  Result rc=0;
+  Result rc = 0;
+  s64 size;
+  u64 bytes;
+  FsRangeInfo info;
+  fsdev_file_t *file = fsdev_get_file(fd);
 
-  if(!fsdev_initialised) return rc;
+  if(file == NULL)
+    return errno;
 
-  for(i=0; i<total; i++)
+  if(offset < 0 || len < 0)
+    return EINVAL;
+
+  switch(advice)
   {
-    _fsdevUnmountDeviceStruct(&fsdev_fsdevices[i]);
-  }
+    case FsdevAdvice_Normal:
+    case FsdevAdvice_Random:
+    case FsdevAdvice_Sequential:
+      file->advice = advice;
+      break;
 
-  fsdev_initialised = false;
+    case FsdevAdvice_WillNeed:
+    {
+      if(file->cache == NULL || (file->flags & O_ACCMODE) == O_WRONLY)
+        break;
 
-  return 0;
-}
+      size_t toRead = fsdev_file_cache_size;
+      if(len != 0)
+        toRead = MIN(toRead, (u64)len);
+      if(file->prealloc)
+        toRead = offset < file->size ? MIN(toRead, (u64)(file->size - offset)) : 0;
 
-FsFileSystem* fsdevGetDeviceFileSystem(const char *name)
-{
-  fsdev_fsdevice *device;
+      /* nothing to do when the start of the range is already cached */
+      if(toRead == 0 || (offset >= file->cache_offset &&
+         offset + (s64)toRead <= file->cache_offset + (s64)file->cache_len))
+        break;
 
-  device = fsdevFindDevice(name);
-  if(device==NULL)
-    return NULL;
+      rc = fsdev_cache_invalidate(file);
+      if(R_SUCCEEDED(rc))
+        rc = fsdev_file_read(file, offset, file->cache, toRead, &bytes);
+      if(R_SUCCEEDED(rc))
+      {
+        file->cache_offset = offset;
+        file->cache_len    = MIN(bytes, toRead);
+        file->cache_ra     = toRead;
+      }
+      break;
+    }
 
-  return &device->fs;
+    case FsdevAdvice_DontNeed:
+      if(len == 0)
+      {
+        rc = fsFileGetSize(&file->fd, &size);
+        if(R_FAILED(rc))
+          break;
+        len = size > offset ? size - offset : 0;
+      }
+
+      /* the cached block is written back first, so dropping it loses nothing */
+      if(file->cache != NULL && file->cache_len != 0 &&
+         offset < file->cache_offset + (s64)file->cache_len && offset + len > file->cache_offset)
+        rc = fsdev_cache_invalidate(file);
+
+      /* only a hint: filesystems without a cache of their own don't support this */
+      if(R_SUCCEEDED(rc) && len != 0)
+        fsFileOperateRange(&file->fd, FsOperationId_InvalidateCache, offset, len, &info);
+      break;
+
+    default:
+      return EINVAL;
+  }
+
+  return R_SUCCEEDED(rc) ? 0 : fsdev_translate_error(rc);
 }
 
-int fsdevTranslatePath(const char *path, FsFileSystem** device, char *outpath)
+ssize_t fsdevPwritev(int fd, const struct iovec *iov, int iovcnt, off_t offset)
 {
-  fsdev_fsdevice *tmpdev = NULL;
+  ssize_t total = 0;
 
-  int ret = fsdev_getfspath(_REENT, path, &tmpdev, outpath);
-  if(ret==-1)return ret;
+  for(int i=0; i<iovcnt; i++)
+  {
+    ssize_t ret = fsdevPwrite(fd, iov[i].iov_base, iov[i].iov_len, offset + total);
+    if(ret < 0)
+      return total > 0 ? total : -1;
 
-  if(device)*device = &tmpdev->fs;
-  return ret;
+    total += ret;
+  }
+
+  return total;
 }
 
 /*! Open a file
@@ -647,6 +2134,35 @@ fsdev_open(struct _reent *r,
     file->flags  = (flags & (O_ACCMODE|O_APPEND|O_SYNC));
     file->offset = 0;
 
+    /* the cache lives right after the file struct, see _fsdevInit */
+    file->cache        = fsdev_file_cache_size ? (u8*)(file+1) : NULL;
+    file->cache_offset = 0;
+    file->cache_len    = 0;
+    file->cache_ra     = 0;
+    file->cache_dirty  = false;
+    file->advice       = FsdevAdvice_Normal;
+    file->device       = device;
+    file->written      = false;
+    file->prealloc     = false;
+
+    /* appending writes always land at the end FS reports, so they can't be preallocated */
+    if(fsdev_preallocate_size != 0 && (flags & O_ACCMODE) != O_RDONLY && !(flags & O_APPEND) &&
+       R_SUCCEEDED(fsFileGetSize(&fd, &file->size)))
+    {
+      file->prealloc  = true;
+      file->allocated = file->size;
+    }
+
+    /* creating or truncating changes what stat() returns */
+    if(flags & (O_CREAT|O_TRUNC))
+      fsdev_stat_cache_invalidate(device, fs_path);
+
+    if(fsdev_stat_cache_size != 0)
+    {
+      size_t len;
+      file->path_hash = fsdev_hash_path(fs_path, &len);
+    }
+
     memset(&file->timestamps, 0, sizeof(file->timestamps));
     rc = fsFsGetFileTimeStampRaw(&device->fs, fs_path, &file->timestamps);//Result can be ignored since output is only set on success, etc.
 
@@ -674,6 +2190,16 @@ fsdev_close(struct _reent *r,
   /* get pointer to our data */
   fsdev_file_t *file = (fsdev_file_t*)fd;
 
+  if(file->cache != NULL)
+    rc = fsdev_cache_flush(file);
+
+  if(R_SUCCEEDED(rc))
+    rc = fsdev_preallocate_trim(file);
+
+  /* entries cached while the file was being written may be stale */
+  if(file->written)
+    fsdev_file_modified(file);
+
   fsFileClose(&file->fd);
   if(R_SUCCEEDED(rc))
     return 0;
@@ -682,32 +2208,31 @@ fsdev_close(struct _reent *r,
   return -1;
 }
 
-/*! Write to an open file
+/*! Write to an open file, through its cache when enabled
  *
- *  @param[in,out] r   newlib reentrancy struct
- *  @param[in,out] fd  Pointer to fsdev_file_t
- *  @param[in]     ptr Pointer to data to write
- *  @param[in]     len Length of data to write
+ *  @param[in,out] r    newlib reentrancy struct
+ *  @param[in,out] file Pointer to fsdev_file_t
+ *  @param[in]     ptr  Pointer to data to write
+ *  @param[in]     len  Length of data to write
  *
  *  @returns number of bytes written
  *  @returns -1 for error
  */
 static ssize_t
-fsdev_write(struct _reent *r,
-           void          *fd,
-           const char    *ptr,
-           size_t        len)
+fsdev_write_data(struct _reent *r,
+                fsdev_file_t  *file,
+                const char    *ptr,
+                size_t        len)
 {
   Result      rc;
 
-  /* get pointer to our data */
-  fsdev_file_t *file = (fsdev_file_t*)fd;
-
-  /* check that the file was opened with write access */
-  if((file->flags & O_ACCMODE) == O_RDONLY)
+  if(file->cache != NULL)
   {
-    r->_errno = EBADF;
-    return -1;
+    if(!(file->flags & (O_APPEND|O_SYNC)))
+      return fsdev_write_cached(r, file, ptr, len);
+
+    /* appending or synchronous writes bypass the cache, drop stale data */
+    file->cache_len = 0;
   }
 
   if(file->flags & O_APPEND)
@@ -721,9 +2246,9 @@ fsdev_write(struct _reent *r,
     }
   }
 
-  rc = fsFileWrite(&file->fd, file->offset, ptr, len, FsWriteOption_None);
+  rc = fsdev_file_write(file, file->offset, ptr, len);
   if(rc == 0xD401)
-    return fsdev_write_safe(r, fd, ptr, len);
+    return fsdev_write_safe(r, file, ptr, len);
   if(R_FAILED(rc))
   {
     r->_errno = fsdev_translate_error(rc);
@@ -739,6 +2264,54 @@ fsdev_write(struct _reent *r,
   return len;
 }
 
+/*! Write to an open file
+ *
+ *  @param[in,out] r   newlib reentrancy struct
+ *  @param[in,out] fd  Pointer to fsdev_file_t
+ *  @param[in]     ptr Pointer to data to write
+ *  @param[in]     len Length of data to write
+ *
+ *  @returns number of bytes written
+ *  @returns -1 for error
+ */
+static ssize_t
+fsdev_write(struct _reent *r,
+           void          *fd,
+           const char    *ptr,
+           size_t        len)
+{
+  Result      rc;
+
+  /* get pointer to our data */
+  fsdev_file_t *file = (fsdev_file_t*)fd;
+
+  /* check that the file was opened with write access */
+  if((file->flags & O_ACCMODE) == O_RDONLY)
+  {
+    r->_errno = EBADF;
+    return -1;
+  }
+
+  fsdev_file_modified(file);
+
+  if(file->prealloc)
+  {
+    rc = fsdev_preallocate(file, file->offset + len);
+    if(R_FAILED(rc))
+    {
+      r->_errno = fsdev_translate_error(rc);
+      return -1;
+    }
+  }
+
+  /* only the bytes actually written count towards the size of a preallocated file */
+  ssize_t ret = fsdev_write_data(r, file, ptr, len);
+  if(ret > 0)
+    fsdev_pwrite_extend(file, file->offset);
+
+  return ret;
+}
+
 /*! Write to an open file
  *
  *  @param[in,out] r   newlib reentrancy struct
@@ -755,46 +2328,101 @@ fsdev_write_safe(struct _reent *r,
                 const char    *ptr,
                 size_t        len)
 {
-  Result      rc;
+  /* get pointer to our data */
+  fsdev_file_t *file = (fsdev_file_t*)fd;
+
+  ssize_t ret = fsdev_pwrite_safe(r, fd, ptr, len, file->offset);
+  if(ret > 0)
+    file->offset += ret;
+
+  return ret;
+}
+
+/*! Write to an open file at the specified offset
+ *
+ *  @param[in,out] r      newlib reentrancy struct
+ *  @param[in]     fd     Pointer to fsdev_file_t
+ *  @param[in]     ptr    Pointer to data to write
+ *  @param[in]     len    Length of data to write
+ *  @param[in]     offset File offset to write to
+ *
+ *  @returns number of bytes written
+ *  @returns -1 for error
+ */
+static ssize_t
+fsdev_pwrite_safe(struct _reent *r,
+                 void          *fd,
+                 const char    *ptr,
+                 size_t        len,
+                 s64           offset)
+{
+  Result      rc = 0;
   size_t      bytesWritten = 0;
+  size_t      chunk;
+  char       *bufs[2];
+  int         cur = 0;
+  fsdev_bounce_op_t ops[2];
 
   /* get pointer to our data */
   fsdev_file_t *file = (fsdev_file_t*)fd;
+  __atomic_add_fetch(&file->device->stats.bounce_count, 1, __ATOMIC_RELAXED);
 
   /* Copy to internal buffer and transfer in chunks.
    * You cannot use FS read/write with certain memory.
+   * The next chunk is copied into one half of the buffer while the
+   * other half is being written.
    */
-  char tmp_buffer[0x1000];
-  while(len > 0)
+  char stack_buffer[0x1000];
+  char *tmp_buffer = fsdev_get_bounce_buffer(&chunk);
+  if(tmp_buffer == NULL)
   {
-    size_t toWrite = len;
-    if(toWrite > sizeof(tmp_buffer))
-      toWrite = sizeof(tmp_buffer);
+    tmp_buffer = stack_buffer;
+    chunk = sizeof(stack_buffer);
+  }
+  chunk /= 2;
+  bufs[0] = tmp_buffer;
+  bufs[1] = tmp_buffer + chunk;
 
-    /* copy to internal buffer */
-    memcpy(tmp_buffer, ptr, toWrite);
+  size_t toWrite = MIN(len, chunk);
+  memcpy(bufs[0], ptr, toWrite);
+  ptr += toWrite;
+  len -= toWrite;
+  fsdev_bounce_write_begin(file, &ops[0], offset, bufs[0], toWrite, len > 0);
 
-    /* write the data */
-    rc = fsFileWrite(&file->fd, file->offset, tmp_buffer, toWrite, FsWriteOption_None);
+  while(true)
+  {
+    /* copy the next chunk while the current one is in flight */
+    size_t next = MIN(len, chunk);
+    memcpy(bufs[cur^1], ptr, next);
 
+    rc = fsdev_bounce_end(&ops[cur]);
     if(R_FAILED(rc))
-    {
-      /* return partial transfer */
-      if(bytesWritten > 0)
-        return bytesWritten;
-
-      r->_errno = fsdev_translate_error(rc);
-      return -1;
-    }
+      break;
 
     /* check if this is synchronous or not */
     if(file->flags & O_SYNC)
       fsFileFlush(&file->fd);
 
-    file->offset += toWrite;
-    bytesWritten += toWrite;
-    ptr          += toWrite;
-    len          -= toWrite;
+    offset       += ops[cur].size;
+    bytesWritten += ops[cur].size;
+
+    if(next == 0)
+      break;
+
+    ptr += next;
+    len -= next;
+    cur ^= 1;
+    fsdev_bounce_write_begin(file, &ops[cur], offset, bufs[cur], next, len > 0);
+  }
+
+  if(R_FAILED(rc))
+  {
+    /* return partial transfer */
+    if(bytesWritten > 0)
+      return bytesWritten;
+
+    r->_errno = fsdev_translate_error(rc);
+    return -1;
   }
 
   return bytesWritten;
@@ -819,6 +2447,8 @@ fsdev_read(struct _reent *r,
   Result      rc;
   u64         bytes;
 
+  traceScope("fsdev_read");
+
   /* get pointer to our data */
   fsdev_file_t *file = (fsdev_file_t*)fd;
 
@@ -829,8 +2459,19 @@ fsdev_read(struct _reent *r,
     return -1;
   }
 
+  /* don't read into preallocated space */
+  if(file->prealloc)
+  {
+    if(file->offset >= file->size)
+      return 0;
+    len = MIN(len, (u64)(file->size - file->offset));
+  }
+
+  if(file->cache != NULL)
+    return fsdev_read_cached(r, file, ptr, len);
+
   /* read the data */
-  rc = fsFileRead(&file->fd, file->offset, ptr, len, FsReadOption_None, &bytes);
+  rc = fsdev_file_read(file, file->offset, ptr, len, &bytes);
   if(rc == 0xD401)
     return fsdev_read_safe(r, fd, ptr, len);
   if(R_SUCCEEDED(rc))
@@ -860,45 +2501,105 @@ fsdev_read_safe(struct _reent *r,
                 char          *ptr,
                 size_t        len)
 {
-  Result      rc;
-  u64         bytesRead = 0, bytes = 0;
+  /* get pointer to our data */
+  fsdev_file_t *file = (fsdev_file_t*)fd;
+
+  ssize_t ret = fsdev_pread_safe(r, fd, ptr, len, file->offset);
+  if(ret > 0)
+    file->offset += ret;
+
+  return ret;
+}
+
+/*! Read from an open file at the specified offset
+ *
+ *  @param[in,out] r      newlib reentrancy struct
+ *  @param[in]     fd     Pointer to fsdev_file_t
+ *  @param[out]    ptr    Pointer to buffer to read into
+ *  @param[in]     len    Length of data to read
+ *  @param[in]     offset File offset to read from
+ *
+ *  @returns number of bytes read
+ *  @returns -1 for error
+ */
+static ssize_t
+fsdev_pread_safe(struct _reent *r,
+                void          *fd,
+                char          *ptr,
+                size_t        len,
+                s64           offset)
+{
+  Result      rc = 0;
+  u64         bytesRead = 0;
+  size_t      chunk;
+  size_t      requested;
+  char       *bufs[2];
+  int         cur = 0;
+  fsdev_bounce_op_t ops[2];
 
   /* get pointer to our data */
   fsdev_file_t *file = (fsdev_file_t*)fd;
+  __atomic_add_fetch(&file->device->stats.bounce_count, 1, __ATOMIC_RELAXED);
 
   /* Transfer in chunks with internal buffer.
    * You cannot use FS read/write with certain memory.
+   * The next chunk is read into one half of the buffer while the
+   * other half is being copied out.
    */
-  char tmp_buffer[0x1000];
-  while(len > 0)
+  char stack_buffer[0x1000];
+  char *tmp_buffer = fsdev_get_bounce_buffer(&chunk);
+  if(tmp_buffer == NULL)
   {
-    u64 toRead = len;
-    if(toRead > sizeof(tmp_buffer))
-      toRead = sizeof(tmp_buffer);
+    tmp_buffer = stack_buffer;
+    chunk = sizeof(stack_buffer);
+  }
+  chunk /= 2;
+  bufs[0] = tmp_buffer;
+  bufs[1] = tmp_buffer + chunk;
 
-    /* read the data */
-    rc = fsFileRead(&file->fd, file->offset, tmp_buffer, toRead, FsReadOption_None, &bytes);
+  requested = MIN(len, chunk);
+  fsdev_bounce_read_begin(file, &ops[0], offset, bufs[0], requested, false);
 
-    if(bytes > toRead)
-      bytes = toRead;
+  while(true)
+  {
+    rc = fsdev_bounce_end(&ops[cur]);
+
+    u64 bytes = ops[cur].bytes;
+    if(bytes > ops[cur].size)
+      bytes = ops[cur].size;
+
+    /* only continue past a full chunk */
+    bool more = R_SUCCEEDED(rc) && bytes == ops[cur].size && requested < len;
+    if(more)
+    {
+      size_t toRead = MIN(len - requested, chunk);
+      fsdev_bounce_read_begin(file, &ops[cur^1], offset + requested, bufs[cur^1], toRead, true);
+      requested += toRead;
+    }
 
     /* copy from internal buffer */
-    memcpy(ptr, tmp_buffer, bytes);
+    memcpy(ptr, ops[cur].buf, bytes);
 
     if(R_FAILED(rc))
-    {
-      /* return partial transfer */
-      if(bytesRead > 0)
-        return bytesRead;
+      break;
 
-      r->_errno = fsdev_translate_error(rc);
-      return -1;
-    }
+    bytesRead += bytes;
+    ptr       += bytes;
 
-    file->offset += bytes;
-    bytesRead    += bytes;
-    ptr          += bytes;
-    len          -= bytes;
+    if(!more)
+      break;
+
+    cur ^= 1;
+  }
+
+  if(R_FAILED(rc))
+  {
+    /* return partial transfer */
+    if(bytesRead > 0)
+      return bytesRead;
+
+    r->_errno = fsdev_translate_error(rc);
+    return -1;
   }
 
   return bytesRead;
@@ -941,7 +2642,11 @@ fsdev_seek(struct _reent *r,
 
     /* set position relative to the end of the file */
     case SEEK_END:
-      rc = fsFileGetSize(&file->fd, &offset);
+      rc = file->cache != NULL ? fsdev_cache_flush(file) : 0;
+      if(file->prealloc)
+        offset = file->size;
+      else if(R_SUCCEEDED(rc))
+        rc = fsFileGetSize(&file->fd, &offset);
       if(R_FAILED(rc))
       {
         r->_errno = fsdev_translate_error(rc);
@@ -986,11 +2691,13 @@ fsdev_fstat(struct _reent *r,
   s64         size;
   fsdev_file_t *file = (fsdev_file_t*)fd;
 
-  rc = fsFileGetSize(&file->fd, &size);
+  rc = file->cache != NULL ? fsdev_cache_flush(file) : 0;
+  if(R_SUCCEEDED(rc))
+    rc = fsFileGetSize(&file->fd, &size);
   if(R_SUCCEEDED(rc))
   {
     memset(st, 0, sizeof(struct stat));
-    st->st_size = (off_t)size;
+    st->st_size = (off_t)(file->prealloc ? file->size : size);
     st->st_nlink = 1;
     st->st_mode = S_IFREG | S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH;
 
@@ -1034,6 +2741,10 @@ fsdev_stat(struct _reent *r,
   if(fsdev_getfspath(r, file, &device, fs_path)==-1)
     return -1;
 
+  u32 generation = 0;
+  if(fsdev_stat_cache_size != 0 && fsdev_stat_cache_find(device, fs_path, st, &generation))
+    return 0;
+
   rc = fsFsGetEntryType(&device->fs, fs_path, &type);
   if(R_SUCCEEDED(rc))
   {
@@ -1045,6 +2756,8 @@ fsdev_stat(struct _reent *r,
         st->st_nlink = 1;
         st->st_mode = S_IFDIR | S_IRWXU | S_IRWXG | S_IRWXO;
         fsDirClose(&fdir);
+        if(fsdev_stat_cache_size != 0)
+          fsdev_stat_cache_insert(device, fs_path, st, generation);
         return 0;
       }
     }
@@ -1065,6 +2778,9 @@ fsdev_stat(struct _reent *r,
             st->st_mtime = fsdev_converttimetoutc(timestamps.modified);
             st->st_atime = fsdev_converttimetoutc(timestamps.accessed);
           }
+
+          if(fsdev_stat_cache_size != 0)
+            fsdev_stat_cache_insert(device, fs_path, st, generation);
         }
 
         return ret;
@@ -1119,6 +2835,7 @@ fsdev_unlink(struct _reent *r,
     return -1;
 
   rc = fsFsDeleteFile(&device->fs, fs_path);
+  fsdev_stat_cache_invalidate(device, fs_path);
   if(R_SUCCEEDED(rc))
     return 0;
 
@@ -1166,6 +2883,7 @@ fsdev_chdir(struct _reent *r,
     }
 
     fsdev_fsdevice_cwd = device->id;
+    __atomic_add_fetch(&fsdev_path_generation, 1, __ATOMIC_RELEASE);
     return 0;
   }
 
@@ -1205,12 +2923,16 @@ fsdev_rename(struct _reent *r,
     if(type == FsDirEntryType_Dir)
     {
       rc = fsFsRenameDirectory(&device->fs, fs_path_old, fs_path_new);
+      /* everything below the directory moved with it */
+      fsdev_stat_cache_invalidate(device, NULL);
       if(R_SUCCEEDED(rc))
       return 0;
     }
     else if(type == FsDirEntryType_File)
     {
       rc = fsFsRenameFile(&device->fs, fs_path_old, fs_path_new);
+      fsdev_stat_cache_invalidate(device, fs_path_old);
+      fsdev_stat_cache_invalidate(device, fs_path_new);
       if(R_SUCCEEDED(rc))
       return 0;
     }
@@ -1247,6 +2969,7 @@ fsdev_mkdir(struct _reent *r,
     return -1;
 
   rc = fsFsCreateDirectory(&device->fs, fs_path);
+  fsdev_stat_cache_invalidate(device, fs_path);
   if(R_SUCCEEDED(rc))
     return 0;
 
@@ -1287,7 +3010,6 @@ fsdev_diropen(struct _reent *r,
     dir->fd    = fd;
     dir->index = -1;
     dir->size  = 0;
-    memset(fsdevDirGetEntries(dir), 0, sizeof(FsDirectoryEntry)*__nx_fsdev_direntry_cache_size);
     return dirState;
   }
 
@@ -1349,8 +3071,7 @@ fsdev_dirnext(struct _reent *r,
     dir->index = -1;
     dir->size  = 0;
 
-    /* fetch the next batch */
-    memset(entry_data, 0, sizeof(FsDirectoryEntry)*max_entries);
+    /* fetch the next batch, FS fills every entry it returns */
     rc = fsDirRead(&dir->fd, &entries, max_entries, entry_data);
     if(R_SUCCEEDED(rc))
     {
@@ -1507,8 +3228,16 @@ fsdev_ftruncate(struct _reent *r,
     return -1;
   }
 
+  fsdev_file_modified(file);
+
+  /* write back anything pending so it can't extend the file again */
+  rc = file->cache != NULL ? fsdev_cache_invalidate(file) : 0;
+
   /* set the new file size */
-  rc = fsFileSetSize(&file->fd, len);
+  if(R_SUCCEEDED(rc))
+    rc = fsFileSetSize(&file->fd, len);
+  if(R_SUCCEEDED(rc) && file->prealloc)
+    file->size = file->allocated = len;
   if(R_SUCCEEDED(rc))
     return 0;
 
@@ -1533,7 +3262,13 @@ fsdev_fsync(struct _reent *r,
   /* get pointer to our data */
   fsdev_file_t *file = (fsdev_file_t*)fd;
 
-  rc = fsFileFlush(&file->fd);
+  rc = file->cache != NULL ? fsdev_cache_flush(file) : 0;
+  if(R_SUCCEEDED(rc))
+    rc = fsdev_preallocate_trim(file);
+  if(file->written)
+    fsdev_file_modified(file);
+  if(R_SUCCEEDED(rc))
+    rc = fsFileFlush(&file->fd);
   if(R_SUCCEEDED(rc))
     return 0;
 
@@ -1597,6 +3332,7 @@ fsdev_rmdir(struct _reent *r,
     return -1;
 
   rc = fsFsDeleteDirectory(&device->fs, fs_path);
+  fsdev_stat_cache_invalidate(device, fs_path);
   if(R_SUCCEEDED(rc))
     return 0;
 
@@ -0,0 +1,432 @@
+#include <malloc.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+
+#include "result.h"
+#include "arm/counter.h"
+#include "kernel/svc.h"
+#include "kernel/mutex.h"
+#include "kernel/condvar.h"
+#include "kernel/thread.h"
+#include "runtime/devices/fs_dev.h"
+
+/*! @internal
+ *
+ *  @file fs_dev_copy.c
+ *
+ *  Parallel tree copy for fsdev devices
+ */
+
+/*! @cond INTERNAL */
+
+/*! Size of each worker's transfer buffer */
+#define FSDEV_COPY_BUFFER_SIZE 0x100000
+
+/*! Number of directory entries fetched per fsDirRead */
+#define FSDEV_COPY_DIR_BATCH 64
+
+/*! Maximum number of files queued ahead of the workers, the walker waits when the queue is full */
+#define FSDEV_COPY_MAX_QUEUED 256
+
+/*! Interval between progress reports, in nanoseconds */
+#define FSDEV_COPY_REPORT_INTERVAL 100000000ull
+
+/*! Files at least this large are created as concatenation files where supported */
+#define FSDEV_COPY_BIGFILE_SIZE 0xFFFFFFFFll
+
+/*! File waiting to be copied */
+typedef struct fsdev_copy_job_t
+{
+  struct fsdev_copy_job_t *next;
+  s64  size;
+  char src[FS_MAX_PATH];
+  char dst[FS_MAX_PATH];
+} fsdev_copy_job_t;
+
+/*! State shared by the walker and the workers */
+typedef struct
+{
+  FsFileSystem     *src_fs;
+  FsFileSystem     *dst_fs;
+  Mutex             mutex;
+  CondVar           job_cond;  /*! Signalled when a job is queued or the walk ends */
+  CondVar           done_cond; /*! Signalled when a job is dequeued or completes */
+  fsdev_copy_job_t *head;
+  fsdev_copy_job_t *tail;
+  u32               num_queued;
+  bool              walk_done;
+  u32               num_busy;
+  Result            rc;        /*! First error, stops the copy */
+  FsdevCopyProgress progress;
+  u64               start_tick;
+  u64               report_tick; /*! Tick of the last progress report */
+} fsdev_copy_t;
+
+/*! Directory waiting to be walked */
+typedef struct fsdev_copy_dir_t
+{
+  struct fsdev_copy_dir_t *next;
+  char src[FS_MAX_PATH];
+  char dst[FS_MAX_PATH];
+} fsdev_copy_dir_t;
+
+/*! @endcond */
+
+void fsdev_stat_cache_invalidate_fs(FsFileSystem *fs);
+
+static void fsdev_copy_fail(fsdev_copy_t *copy, Result rc)
+{
+  mutexLock(&copy->mutex);
+  if(R_SUCCEEDED(copy->rc))
+    copy->rc = rc;
+  condvarWakeAll(&copy->job_cond);
+  condvarWakeAll(&copy->done_cond);
+  mutexUnlock(&copy->mutex);
+}
+
+static bool fsdev_copy_join(char *out, const char *dir, const char *name)
+{
+  size_t dirlen = strlen(dir);
+  size_t namelen = strlen(name);
+  bool slash = dirlen == 0 || dir[dirlen-1] != '/';
+
+  if(dirlen + slash + namelen >= FS_MAX_PATH)
+    return false;
+
+  memcpy(out, dir, dirlen);
+  if(slash)
+    out[dirlen++] = '/';
+  memcpy(out + dirlen, name, namelen+1);
+  return true;
+}
+
+static Result fsdev_copy_file(fsdev_copy_t *copy, fsdev_copy_job_t *job, u8 *buf)
+{
+  FsFile src, dst;
+  u64 bytes = 0;
+
+  /* create the destination at its final size, so the data is written into preallocated space */
+  Result rc = MAKERESULT(Module_Libnx, LibnxError_BadInput);
+  if(job->size >= FSDEV_COPY_BIGFILE_SIZE)
+    rc = fsFsCreateFile(copy->dst_fs, job->dst, job->size, FsCreateOption_BigFile);
+  if(R_FAILED(rc))
+    rc = fsFsCreateFile(copy->dst_fs, job->dst, job->size, 0);
+  if(R_VALUE(rc) == 0x402) /* already exists, overwrite it */
+    rc = 0;
+  if(R_FAILED(rc))
+    return rc;
+
+  rc = fsFsOpenFile(copy->src_fs, job->src, FsOpenMode_Read, &src);
+  if(R_FAILED(rc))
+    return rc;
+
+  rc = fsFsOpenFile(copy->dst_fs, job->dst, FsOpenMode_Write, &dst);
+  if(R_SUCCEEDED(rc))
+  {
+    rc = fsFileSetSize(&dst, job->size);
+
+    for(s64 offset = 0; R_SUCCEEDED(rc) && offset < job->size; offset += bytes)
+    {
+      rc = fsFileRead(&src, offset, buf, MIN(job->size - offset, FSDEV_COPY_BUFFER_SIZE), FsReadOption_None, &bytes);
+      if(R_SUCCEEDED(rc) && bytes == 0)
+        rc = MAKERESULT(Module_Libnx, LibnxError_IoError);
+      if(R_SUCCEEDED(rc))
+        rc = fsFileWrite(&dst, offset, buf, bytes, FsWriteOption_None);
+
+      if(R_SUCCEEDED(rc))
+      {
+        mutexLock(&copy->mutex);
+        copy->progress.copied_bytes += bytes;
+        if(R_FAILED(copy->rc))
+          rc = copy->rc;
+        mutexUnlock(&copy->mutex);
+      }
+    }
+
+    if(R_SUCCEEDED(rc))
+      rc = fsFileFlush(&dst);
+    fsFileClose(&dst);
+  }
+
+  fsFileClose(&src);
+  return rc;
+}
+
+static void fsdev_copy_worker(void *arg)
+{
+  fsdev_copy_t *copy = (fsdev_copy_t*)arg;
+
+  u8 *buf = memalign(0x1000, FSDEV_COPY_BUFFER_SIZE);
+  if(buf == NULL)
+  {
+    fsdev_copy_fail(copy, MAKERESULT(Module_Libnx, LibnxError_OutOfMemory));
+    return;
+  }
+
+  mutexLock(&copy->mutex);
+  for(;;)
+  {
+    while(copy->head == NULL && !copy->walk_done && R_SUCCEEDED(copy->rc))
+      condvarWait(&copy->job_cond, &copy->mutex);
+
+    if(copy->head == NULL || R_FAILED(copy->rc))
+      break;
+
+    fsdev_copy_job_t *job = copy->head;
+    copy->head = job->next;
+    if(copy->head == NULL)
+      copy->tail = NULL;
+    copy->num_queued--;
+    copy->num_busy++;
+    condvarWakeAll(&copy->done_cond);
+    mutexUnlock(&copy->mutex);
+
+    Result rc = fsdev_copy_file(copy, job, buf);
+    free(job);
+
+    if(R_FAILED(rc))
+      fsdev_copy_fail(copy, rc);
+
+    mutexLock(&copy->mutex);
+    copy->num_busy--;
+    if(R_SUCCEEDED(rc))
+      copy->progress.copied_files++;
+    condvarWakeAll(&copy->done_cond);
+  }
+  mutexUnlock(&copy->mutex);
+
+  free(buf);
+}
+
+/*! Report progress, at most once per FSDEV_COPY_REPORT_INTERVAL unless forced. Called from the calling thread only, without copy->mutex held */
+static bool fsdev_copy_report(fsdev_copy_t *copy, FsdevCopyProgressFunc callback, void *userdata, bool force)
+{
+  if(callback == NULL)
+    return true;
+
+  u64 now = armGetSystemTick();
+  if(!force && armTicksToNs(now - copy->report_tick) < FSDEV_COPY_REPORT_INTERVAL)
+    return true;
+  copy->report_tick = now;
+
+  mutexLock(&copy->mutex);
+  FsdevCopyProgress progress = copy->progress;
+  mutexUnlock(&copy->mutex);
+
+  progress.elapsed_ns = armTicksToNs(now - copy->start_tick);
+  return callback(&progress, userdata);
+}
+
+static Result fsdev_copy_walk(fsdev_copy_t *copy, const char *src, const char *dst, FsdevCopyProgressFunc callback, void *userdata)
+{
+  Result rc = 0;
+  FsDirectoryEntry *entries = malloc(FSDEV_COPY_DIR_BATCH*sizeof(FsDirectoryEntry));
+  fsdev_copy_dir_t *pending = calloc(1, sizeof(fsdev_copy_dir_t));
+
+  if(entries == NULL || pending == NULL)
+  {
+    free(entries);
+    free(pending);
+    return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+  }
+
+  strcpy(pending->src, src);
+  strcpy(pending->dst, dst);
+
+  while(pending != NULL)
+  {
+    fsdev_copy_dir_t *cur = pending;
+    pending = cur->next;
+
+    /* after an error, only free what is left */
+    if(R_FAILED(rc))
+    {
+      free(cur);
+      continue;
+    }
+
+    FsDir dir;
+    rc = fsFsCreateDirectory(copy->dst_fs, cur->dst);
+    if(R_VALUE(rc) == 0x402) /* already exists, copy into it */
+      rc = 0;
+    if(R_SUCCEEDED(rc))
+      rc = fsFsOpenDirectory(copy->src_fs, cur->src, FsDirOpenMode_ReadDirs | FsDirOpenMode_ReadFiles, &dir);
+    if(R_FAILED(rc))
+    {
+      free(cur);
+      continue;
+    }
+
+    while(R_SUCCEEDED(rc))
+    {
+      s64 count = 0;
+      rc = fsDirRead(&dir, &count, FSDEV_COPY_DIR_BATCH, entries);
+      if(R_FAILED(rc) || count == 0)
+        break;
+
+      for(s64 i = 0; R_SUCCEEDED(rc) && i < count; i++)
+      {
+        if(entries[i].type == FsDirEntryType_Dir)
+        {
+          fsdev_copy_dir_t *sub = malloc(sizeof(fsdev_copy_dir_t));
+          if(sub == NULL)
+            rc = MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+          else if(!fsdev_copy_join(sub->src, cur->src, entries[i].name) || !fsdev_copy_join(sub->dst, cur->dst, entries[i].name))
+          {
+            free(sub);
+            rc = MAKERESULT(Module_Libnx, LibnxError_BadInput);
+          }
+          else
+          {
+            sub->next = pending;
+            pending = sub;
+          }
+          continue;
+        }
+
+        fsdev_copy_job_t *job = malloc(sizeof(fsdev_copy_job_t));
+        if(job == NULL)
+        {
+          rc = MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+          break;
+        }
+        if(!fsdev_copy_join(job->src, cur->src, entries[i].name) || !fsdev_copy_join(job->dst, cur->dst, entries[i].name))
+        {
+          free(job);
+          rc = MAKERESULT(Module_Libnx, LibnxError_BadInput);
+          break;
+        }
+        job->size = entries[i].file_size;
+        job->next = NULL;
+
+        /* wait for room in the queue, still reporting progress */
+        mutexLock(&copy->mutex);
+        while(copy->num_queued >= FSDEV_COPY_MAX_QUEUED && R_SUCCEEDED(copy->rc))
+        {
+          condvarWaitTimeout(&copy->done_cond, &copy->mutex, FSDEV_COPY_REPORT_INTERVAL);
+          mutexUnlock(&copy->mutex);
+          bool keep_going = fsdev_copy_report(copy, callback, userdata, false);
+          mutexLock(&copy->mutex);
+          if(!keep_going && R_SUCCEEDED(copy->rc))
+          {
+            copy->rc = MAKERESULT(Module_Libnx, LibnxError_Cancelled);
+            condvarWakeAll(&copy->job_cond);
+          }
+        }
+
+        if(R_SUCCEEDED(copy->rc))
+        {
+          if(copy->tail)
+            copy->tail->next = job;
+          else
+            copy->head = job;
+          copy->tail = job;
+          copy->num_queued++;
+          copy->progress.total_files++;
+          copy->progress.total_bytes += job->size;
+          condvarWakeOne(&copy->job_cond);
+        }
+        else
+        {
+          free(job);
+          rc = copy->rc;
+        }
+        mutexUnlock(&copy->mutex);
+
+        if(R_SUCCEEDED(rc) && !fsdev_copy_report(copy, callback, userdata, false))
+          rc = MAKERESULT(Module_Libnx, LibnxError_Cancelled);
+      }
+    }
+
+    fsDirClose(&dir);
+    free(cur);
+  }
+
+  free(entries);
+  return rc;
+}
+
+Result fsdevCopyTree(const char *src, const char *dst, u32 num_threads, FsdevCopyProgressFunc callback, void *userdata)
+{
+  char src_path[FS_MAX_PATH], dst_path[FS_MAX_PATH];
+  Thread threads[FSDEV_COPY_MAX_THREADS];
+  u32 num_started = 0;
+  u32 prio = 0x2C;
+  fsdev_copy_t copy = {0};
+
+  if(num_threads < 1 || num_threads > FSDEV_COPY_MAX_THREADS)
+    return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+  if(fsdevTranslatePath(src, &copy.src_fs, src_path)==-1 || fsdevTranslatePath(dst, &copy.dst_fs, dst_path)==-1)
+    return MAKERESULT(Module_Libnx, LibnxError_NotFound);
+
+  mutexInit(&copy.mutex);
+  condvarInit(&copy.job_cond);
+  condvarInit(&copy.done_cond);
+  copy.start_tick = armGetSystemTick();
+  copy.report_tick = copy.start_tick;
+
+  /* workers copy files while this thread walks the tree */
+  svcGetThreadPriority(&prio, CUR_THREAD_HANDLE);
+  Result rc = 0;
+  for(u32 i=0; i<num_threads; i++)
+  {
+    rc = threadCreate(&threads[num_started], fsdev_copy_worker, &copy, NULL, 0x4000, prio, -2);
+    if(R_SUCCEEDED(rc))
+    {
+      rc = threadStart(&threads[num_started]);
+      if(R_FAILED(rc))
+        threadClose(&threads[num_started]);
+    }
+    if(R_FAILED(rc))
+      break;
+    num_started++;
+  }
+
+  if(num_started > 0)
+    rc = fsdev_copy_walk(&copy, src_path, dst_path, callback, userdata);
+
+  if(R_FAILED(rc))
+    fsdev_copy_fail(&copy, rc);
+
+  /* wait for the queue to drain, reporting progress along the way */
+  mutexLock(&copy.mutex);
+  copy.walk_done = true;
+  condvarWakeAll(&copy.job_cond);
+  while(R_SUCCEEDED(copy.rc) && (copy.head != NULL || copy.num_busy != 0))
+  {
+    condvarWaitTimeout(&copy.done_cond, &copy.mutex, FSDEV_COPY_REPORT_INTERVAL);
+    mutexUnlock(&copy.mutex);
+    bool keep_going = fsdev_copy_report(&copy, callback, userdata, false);
+    mutexLock(&copy.mutex);
+    if(!keep_going && R_SUCCEEDED(copy.rc))
+    {
+      copy.rc = MAKERESULT(Module_Libnx, LibnxError_Cancelled);
+      condvarWakeAll(&copy.job_cond);
+    }
+  }
+  mutexUnlock(&copy.mutex);
+
+  for(u32 i=0; i<num_started; i++)
+  {
+    threadWaitForExit(&threads[i]);
+    threadClose(&threads[i]);
+  }
+
+  /* free jobs left behind by an error */
+  while(copy.head != NULL)
+  {
+    fsdev_copy_job_t *job = copy.head;
+    copy.head = job->next;
+    free(job);
+  }
+
+  /* the files were written with fs directly, drop what the destination device has cached about them */
+  fsdev_stat_cache_invalidate_fs(copy.dst_fs);
+
+  if(R_SUCCEEDED(copy.rc))
+    fsdev_copy_report(&copy, callback, userdata, true);
+
+  return R_FAILED(rc) ? rc : copy.rc;
+}
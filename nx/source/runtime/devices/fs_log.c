@@ -0,0 +1,264 @@
+#include <malloc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+
+#include "result.h"
+#include "kernel/svc.h"
+#include "kernel/wait.h"
+#include "runtime/devices/fs_dev.h"
+#include "runtime/devices/fs_log.h"
+
+// Interval at which the flusher drains buffers when it isn't woken earlier
+#define FSLOG_FLUSH_INTERVAL_NS 100000000ull
+
+static void _fslogBufferRelease(void* arg)
+{
+    FsLogBuffer* buf = (FsLogBuffer*)arg;
+    __atomic_store_n(&buf->dead, true, __ATOMIC_RELEASE);
+}
+
+static Result _fslogWriteStaging(FsLog* log, size_t size)
+{
+    Result rc = fsFileWrite(&log->file, log->offset, log->staging, size, FsWriteOption_None);
+    if (R_SUCCEEDED(rc))
+        log->offset += size;
+    return rc;
+}
+
+static Result _fslogDrain(FsLog* log)
+{
+    Result rc = 0;
+    size_t used = 0;
+
+    mutexLock(&log->drain_mutex);
+
+    // Threads only push buffers at the head, and only this function unlinks them.
+    mutexLock(&log->list_mutex);
+    FsLogBuffer* buf = log->buffers;
+    mutexUnlock(&log->list_mutex);
+
+    while (buf) {
+        FsLogBuffer* next = buf->next;
+        bool dead = __atomic_load_n(&buf->dead, __ATOMIC_ACQUIRE);
+        u32 head = __atomic_load_n(&buf->head, __ATOMIC_ACQUIRE);
+        u32 tail = buf->tail;
+
+        while (tail != head && R_SUCCEEDED(rc)) {
+            u32 pos = tail % FSLOG_THREAD_BUFFER_SIZE;
+            size_t size = MIN(head - tail, FSLOG_THREAD_BUFFER_SIZE - pos);
+            size = MIN(size, FSLOG_WRITE_SIZE - used);
+
+            memcpy(log->staging + used, buf->data + pos, size);
+            used += size;
+            tail += size;
+            __atomic_store_n(&buf->tail, tail, __ATOMIC_RELEASE);
+
+            if (used == FSLOG_WRITE_SIZE) {
+                rc = _fslogWriteStaging(log, used);
+                used = 0;
+            }
+        }
+
+        // Buffers of exited threads are freed once drained
+        if (dead && tail == head) {
+            // Re-walk from the head, which may have changed since it was read.
+            mutexLock(&log->list_mutex);
+            FsLogBuffer** link = &log->buffers;
+            while (*link != buf)
+                link = &(*link)->next;
+            *link = next;
+            mutexUnlock(&log->list_mutex);
+            free(buf);
+        }
+
+        buf = next;
+    }
+
+    if (used && R_SUCCEEDED(rc))
+        rc = _fslogWriteStaging(log, used);
+
+    mutexUnlock(&log->drain_mutex);
+    return rc;
+}
+
+static void _fslogThreadFunc(void* arg)
+{
+    FsLog* log = (FsLog*)arg;
+
+    while (!__atomic_load_n(&log->should_exit, __ATOMIC_ACQUIRE)) {
+        waitSingle(waiterForUEvent(&log->wake_event), FSLOG_FLUSH_INTERVAL_NS);
+        _fslogDrain(log);
+    }
+}
+
+Result fslogCreate(FsLog* log, const char* path, int prio, int cpuid)
+{
+    FsFileSystem* fs;
+    char fs_path[FS_MAX_PATH];
+    s64 size = 0;
+
+    *log = (FsLog){0};
+    mutexInit(&log->list_mutex);
+    mutexInit(&log->drain_mutex);
+    ueventCreate(&log->wake_event, true);
+
+    if (fsdevTranslatePath(path, &fs, fs_path) == -1)
+        return MAKERESULT(Module_Libnx, LibnxError_NotFound);
+
+    fsFsCreateFile(fs, fs_path, 0, 0); // Fails if the file already exists, which is fine
+    Result rc = fsFsOpenFile(fs, fs_path, FsOpenMode_Write | FsOpenMode_Append, &log->file);
+    if (R_FAILED(rc))
+        return rc;
+
+    rc = fsFileGetSize(&log->file, &size);
+    log->offset = size;
+
+    if (R_SUCCEEDED(rc)) {
+        log->staging = memalign(0x1000, FSLOG_WRITE_SIZE);
+        if (!log->staging)
+            rc = MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+    }
+
+    if (R_SUCCEEDED(rc)) {
+        log->tls_slot = threadTlsAlloc(_fslogBufferRelease);
+        if (log->tls_slot < 0)
+            rc = MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+    }
+
+    if (R_SUCCEEDED(rc)) {
+        rc = threadCreate(&log->thread, _fslogThreadFunc, log, NULL, 0x4000, prio, cpuid);
+        if (R_SUCCEEDED(rc)) {
+            rc = threadStart(&log->thread);
+            if (R_FAILED(rc))
+                threadClose(&log->thread);
+        }
+        if (R_FAILED(rc))
+            threadTlsFree(log->tls_slot);
+    }
+
+    if (R_FAILED(rc)) {
+        free(log->staging);
+        fsFileClose(&log->file);
+    }
+
+    return rc;
+}
+
+void fslogClose(FsLog* log)
+{
+    __atomic_store_n(&log->should_exit, true, __ATOMIC_RELEASE);
+    ueventSignal(&log->wake_event);
+    threadWaitForExit(&log->thread);
+    threadClose(&log->thread);
+
+    // Stops destructors from touching the buffers freed below
+    threadTlsFree(log->tls_slot);
+    _fslogDrain(log);
+
+    while (log->buffers) {
+        FsLogBuffer* buf = log->buffers;
+        log->buffers = buf->next;
+        free(buf);
+    }
+
+    fsFileFlush(&log->file);
+    fsFileClose(&log->file);
+    free(log->staging);
+}
+
+static FsLogBuffer* _fslogGetBuffer(FsLog* log)
+{
+    FsLogBuffer* buf = (FsLogBuffer*)threadTlsGet(log->tls_slot);
+    if (buf)
+        return buf;
+
+    buf = (FsLogBuffer*)calloc(1, sizeof(FsLogBuffer));
+    if (!buf)
+        return NULL;
+
+    mutexLock(&log->list_mutex);
+    buf->next = log->buffers;
+    log->buffers = buf;
+    mutexUnlock(&log->list_mutex);
+
+    threadTlsSet(log->tls_slot, buf);
+    return buf;
+}
+
+void fslogWrite(FsLog* log, const void* data, size_t len)
+{
+    const u8* ptr = (const u8*)data;
+    FsLogBuffer* buf = _fslogGetBuffer(log);
+    if (!buf)
+        return;
+
+    while (len > 0) {
+        u32 head = buf->head;
+        u32 avail = FSLOG_THREAD_BUFFER_SIZE - (head - __atomic_load_n(&buf->tail, __ATOMIC_ACQUIRE));
+
+        // Wait for the flusher when the buffer is full, or when a message that fits can't be kept whole
+        if (avail == 0 || (len <= FSLOG_THREAD_BUFFER_SIZE && avail < len)) {
+            ueventSignal(&log->wake_event);
+            svcSleepThread(100000);
+            continue;
+        }
+
+        size_t size = MIN(len, avail);
+        u32 pos = head % FSLOG_THREAD_BUFFER_SIZE;
+        size_t first = MIN(size, FSLOG_THREAD_BUFFER_SIZE - pos);
+        memcpy(buf->data + pos, ptr, first);
+        memcpy(buf->data, ptr + first, size - first);
+        __atomic_store_n(&buf->head, head + size, __ATOMIC_RELEASE);
+
+        ptr += size;
+        len -= size;
+    }
+
+    // Get the flusher going before the buffer fills up
+    if (buf->head - __atomic_load_n(&buf->tail, __ATOMIC_RELAXED) >= FSLOG_THREAD_BUFFER_SIZE/2)
+        ueventSignal(&log->wake_event);
+}
+
+void fslogVPrintf(FsLog* log, const char* fmt, va_list args)
+{
+    char stack_buf[0x200];
+    va_list args_copy;
+
+    va_copy(args_copy, args);
+    int len = vsnprintf(stack_buf, sizeof(stack_buf), fmt, args_copy);
+    va_end(args_copy);
+
+    if (len < 0)
+        return;
+
+    if ((size_t)len < sizeof(stack_buf)) {
+        fslogWrite(log, stack_buf, len);
+        return;
+    }
+
+    char* heap_buf = (char*)malloc(len + 1);
+    if (!heap_buf)
+        return;
+
+    vsnprintf(heap_buf, len + 1, fmt, args);
+    fslogWrite(log, heap_buf, len);
+    free(heap_buf);
+}
+
+void fslogPrintf(FsLog* log, const char* fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    fslogVPrintf(log, fmt, args);
+    va_end(args);
+}
+
+Result fslogFlush(FsLog* log)
+{
+    Result rc = _fslogDrain(log);
+    if (R_SUCCEEDED(rc))
+        rc = fsFileFlush(&log->file);
+    return rc;
+}
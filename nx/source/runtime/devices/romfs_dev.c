@@ -1,6 +1,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <limits.h>
+#include <malloc.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/dirent.h>
@@ -10,8 +11,14 @@
 
 #include "runtime/devices/romfs_dev.h"
 #include "runtime/devices/fs_dev.h"
+#include "runtime/crypto_storage.h"
+#include "runtime/integrity_storage.h"
 #include "runtime/util/utf.h"
 #include "runtime/env.h"
+#include "kernel/svc.h"
+#include "kernel/mutex.h"
+#include "kernel/condvar.h"
+#include "kernel/thread.h"
 #include "nro.h"
 
 #include "path_buf.h"
@@ -19,8 +26,76 @@
 typedef enum {
     RomfsSource_FsFile,
     RomfsSource_FsStorage,
+    RomfsSource_Overlay,
+    RomfsSource_CryptoStorage,
+    RomfsSource_IntegrityStorage,
 } RomfsSource;
 
+/// Entry of the full path index, see __nx_romfs_path_index
+typedef struct
+{
+    u32 hash;   ///< Hash of the absolute path
+    u32 off;    ///< Offset of the entry in its table, romFS_none for unused slots
+    bool isDir; ///< Whether off is in the directory table
+} romfs_index_entry;
+
+/// Size of a block cache block, see __nx_romfs_cache_size
+#define ROMFS_CACHE_BLOCK_SIZE    0x8000
+/// Largest number of blocks filled at once for sequential reads
+#define ROMFS_CACHE_MAX_READAHEAD 8
+
+typedef enum {
+    RomfsCacheBlock_Empty,
+    RomfsCacheBlock_Loading,
+    RomfsCacheBlock_Valid,
+} RomfsCacheBlockState;
+
+/// Block cache block
+typedef struct
+{
+    u64 block;    ///< Index of the cached block in the image
+    u32 lastUsed; ///< Cache clock at the last access, for LRU eviction
+    u32 len;      ///< Valid bytes, less than the block size at the end of the image
+    u16 refs;     ///< Readers currently copying out of the block
+    u8  state;    ///< \ref RomfsCacheBlockState
+} romfs_cache_block;
+
+/// File loaded into memory with \ref romfsPreloadFile
+typedef struct romfs_resident
+{
+    struct romfs_resident *next;
+    romfs_file            *file;
+    u8                    *data;
+} romfs_resident;
+
+/// Largest number of threads decompressing for a single read, the calling thread included
+#define ROMFS_DECOMPRESS_MAX_THREADS 4
+
+/// Range of a compressed file being decompressed, possibly by several threads
+typedef struct
+{
+    const romfs_ctable_file *cfile;
+    u8                      *dst;
+    u64                     pos, len;   ///< Uncompressed range
+    u32                     nextBlock;  ///< Next block to decompress, taken atomically
+    u32                     endBlock;
+    u32                     active;     ///< Pool threads working on the job
+    bool                    failed;
+} romfs_cz_job;
+
+/// Entry of an overlay's merged tree, see romfsMountOverlay
+typedef struct
+{
+    u32  hash;       ///< Hash of the absolute path, see pathHashStep
+    u32  parent;     ///< Parent node
+    u32  firstChild; ///< First child node, for directories
+    u32  sibling;    ///< Next node in the parent's child list
+    u32  layer;      ///< Layer the entry comes from
+    bool isDir;
+    bool dead;       ///< Replaced by a file of a higher layer, together with its parent directory
+    void *entry;     ///< romfs_dir or romfs_file in the layer's tables
+} romfs_overlay_node;
+
 typedef struct romfs_mount
 {
     devoptab_t         device;
@@ -29,12 +104,49 @@ typedef struct romfs_mount
     s32                id;
     FsFile             fd;
     FsStorage          fd_storage;
+    CryptoStorage      *fd_crypto;
+    IntegrityStorage   *fd_integrity;
     time_t             mtime;
     u64                offset;
     romfs_header       header;
     romfs_dir          *cwd;
     u32                *dirHashTable, *fileHashTable;
     void               *dirTable, *fileTable;
+    romfs_index_entry  *pathIndex;
+    u32                pathIndexMask;
+    Mutex              cacheMutex;
+    CondVar            cacheCond;
+    romfs_cache_block  *cacheBlocks;
+    u8                 *cacheData;
+    u32                cacheNumBlocks;
+    u32                cacheClock;
+    u64                imageSize;
+    u8                 *image;     ///< Whole image, see __nx_romfs_load_image
+    Mutex              residentMutex;
+    romfs_resident     *resident;
+    u32                dirHashMask;       ///< Size-1 of the rebuilt directory hash table, 0 when using the image's
+    u32                fileHashMask;      ///< Size-1 of the rebuilt file hash table, 0 when using the image's
+    void               *ctable;           ///< Compression table, see ROMFS_CTABLE_NAME
+    romfs_ctable_file  *ctableFiles;
+    romfs_ctable_block *ctableBlocks;
+    u32                ctableNumFiles;
+    u32                ctableBlockSize;
+    u32                ctableMaxBlock;    ///< Largest compressed block
+    Mutex              czJobMutex;        ///< Held while the pool works on a job
+    Mutex              czMutex;
+    CondVar            czCond, czDoneCond;
+    romfs_cz_job       *czJob;
+    u32                czGeneration;
+    bool               czExit;
+    u32                czNumThreads;
+    Thread             czThreads[ROMFS_DECOMPRESS_MAX_THREADS-1];
+    struct romfs_mount **ovLayers;        ///< Layers of an overlay, lowest priority first
+    u32                ovNumLayers;
+    romfs_overlay_node *ovNodes;          ///< Merged tree, node 0 is the root
+    u32                ovNumNodes, ovCapNodes;
+    u32                *ovIndex;          ///< Open-addressed table of node indices, keyed by path hash
+    u32                ovIndexMask;
+    u32                ovCwd;
     char               name[32];
 } romfs_mount;
 
@@ -76,6 +188,16 @@ static ssize_t _romfs_read(romfs_mount *mount, u64 offset, void* buffer, u64 siz
         rc = fsStorageRead(&mount->fd_storage, pos, buffer, size);
         read = size;
     }
+    else if(mount->fd_type == RomfsSource_CryptoStorage)
+    {
+        rc = cryptoStorageRead(mount->fd_crypto, pos, buffer, size);
+        read = size;
+    }
+    else if(mount->fd_type == RomfsSource_IntegrityStorage)
+    {
+        rc = integrityStorageRead(mount->fd_integrity, pos, buffer, size);
+        read = size;
+    }
     if (R_FAILED(rc)) return -1;
     return read;
 }
@@ -85,6 +207,138 @@ static bool _romfs_read_chk(romfs_mount *mount, u64 offset, void* buffer, u64 si
     return _romfs_read(mount, offset, buffer, size) == size;
 }
 
+static romfs_cache_block* _romfs_cache_find(romfs_mount *mount, u64 block)
+{
+    for (u32 i = 0; i < mount->cacheNumBlocks; i ++)
+    {
+        romfs_cache_block* b = &mount->cacheBlocks[i];
+        if (b->state != RomfsCacheBlock_Empty && b->block == block)
+            return b;
+    }
+    return NULL;
+}
+
+static bool _romfs_cache_evictable(romfs_cache_block *b)
+{
+    return b->refs == 0 && b->state != RomfsCacheBlock_Loading;
+}
+
+/// Reads through the block cache, filling up to readahead consecutive blocks with a single request on a miss.
+static ssize_t _romfs_cache_read(romfs_mount *mount, u64 offset, void* buffer, u64 size, u32 readahead)
+{
+    u8* ptr = (u8*)buffer;
+    ssize_t total = 0;
+
+    mutexLock(&mount->cacheMutex);
+
+    while (size > 0)
+    {
+        u64 block = offset / ROMFS_CACHE_BLOCK_SIZE;
+        u32 blockOff = offset % ROMFS_CACHE_BLOCK_SIZE;
+        romfs_cache_block* b = _romfs_cache_find(mount, block);
+
+        if (b && b->state == RomfsCacheBlock_Loading)
+        {
+            condvarWait(&mount->cacheCond, &mount->cacheMutex);
+            continue;
+        }
+
+        if (b)
+        {
+            b->lastUsed = ++mount->cacheClock;
+            if (blockOff >= b->len)
+                break; // end of the image
+
+            u32 chunk = MIN(size, b->len - blockOff);
+            u8* data = mount->cacheData + (b - mount->cacheBlocks) * ROMFS_CACHE_BLOCK_SIZE;
+
+            // Copy without the lock, the reference keeps the block from being evicted
+            b->refs ++;
+            mutexUnlock(&mount->cacheMutex);
+            memcpy(ptr, data + blockOff, chunk);
+            mutexLock(&mount->cacheMutex);
+            b->refs --;
+
+            ptr    += chunk;
+            offset += chunk;
+            size   -= chunk;
+            total  += chunk;
+            if (b->len < ROMFS_CACHE_BLOCK_SIZE && blockOff + chunk == b->len)
+                break;
+            continue;
+        }
+
+        // Pick the least recently used block, then extend the fill over the following slots
+        romfs_cache_block* victim = NULL;
+        for (u32 i = 0; i < mount->cacheNumBlocks; i ++)
+        {
+            romfs_cache_block* cur = &mount->cacheBlocks[i];
+            if (_romfs_cache_evictable(cur) && (!victim || cur->state == RomfsCacheBlock_Empty || (victim->state != RomfsCacheBlock_Empty && cur->lastUsed < victim->lastUsed)))
+                victim = cur;
+        }
+
+        if (!victim)
+        {
+            // Every block is busy, so read this piece directly
+            mutexUnlock(&mount->cacheMutex);
+            u64 chunk = MIN(size, ROMFS_CACHE_BLOCK_SIZE - blockOff);
+            ssize_t adv = _romfs_read(mount, offset, ptr, chunk);
+            mutexLock(&mount->cacheMutex);
+            if (adv <= 0)
+            {
+                if (adv < 0 && total == 0) total = -1;
+                break;
+            }
+            ptr    += adv;
+            offset += adv;
+            size   -= adv;
+            total  += adv;
+            if ((u64)adv < chunk)
+                break;
+            continue;
+        }
+
+        u32 first = victim - mount->cacheBlocks;
+        u32 count = 1;
+        while (count < readahead && first + count < mount->cacheNumBlocks
+               && _romfs_cache_evictable(&mount->cacheBlocks[first + count])
+               && !_romfs_cache_find(mount, block + count))
+            count ++;
+
+        for (u32 i = 0; i < count; i ++)
+        {
+            mount->cacheBlocks[first + i].block = block + i;
+            mount->cacheBlocks[first + i].state = RomfsCacheBlock_Loading;
+            mount->cacheBlocks[first + i].lastUsed = ++mount->cacheClock;
+        }
+
+        u64 fillOff = block * ROMFS_CACHE_BLOCK_SIZE;
+        u64 fillLen = fillOff < mount->imageSize ? MIN(count * ROMFS_CACHE_BLOCK_SIZE, mount->imageSize - fillOff) : 0;
+
+        mutexUnlock(&mount->cacheMutex);
+        ssize_t got = fillLen ? _romfs_read(mount, fillOff, mount->cacheData + first * ROMFS_CACHE_BLOCK_SIZE, fillLen) : 0;
+        mutexLock(&mount->cacheMutex);
+
+        for (u32 i = 0; i < count; i ++)
+        {
+            romfs_cache_block* cur = &mount->cacheBlocks[first + i];
+            s64 len = got - (s64)i * ROMFS_CACHE_BLOCK_SIZE;
+            cur->len   = len > 0 ? MIN(len, ROMFS_CACHE_BLOCK_SIZE) : 0;
+            cur->state = (got >= 0 && (i == 0 || len > 0)) ? RomfsCacheBlock_Valid : RomfsCacheBlock_Empty;
+        }
+        condvarWakeAll(&mount->cacheCond);
+
+        if (got < 0)
+        {
+            if (total == 0) total = -1;
+            break;
+        }
+    }
+
+    mutexUnlock(&mount->cacheMutex);
+    return total;
+}
+
 //-----------------------------------------------------------------------------
 
 static int       romfs_open(struct _reent *r, void *fileStruct, const char *path, int flags, int mode);
@@ -99,11 +353,29 @@ static int       romfs_dirreset(struct _reent *r, DIR_ITER *dirState);
 static int       romfs_dirnext(struct _reent *r, DIR_ITER *dirState, char *filename, struct stat *filestat);
 static int       romfs_dirclose(struct _reent *r, DIR_ITER *dirState);
 
+static const u8* romfsGetResidentData(struct romfs_mount *mount, romfs_file *file);
+
+static int       romfs_overlay_open(struct _reent *r, void *fileStruct, const char *path, int flags, int mode);
+static int       romfs_overlay_stat(struct _reent *r, const char *path, struct stat *st);
+static int       romfs_overlay_chdir(struct _reent *r, const char *path);
+static DIR_ITER* romfs_overlay_diropen(struct _reent *r, DIR_ITER *dirState, const char *path);
+static int       romfs_overlay_dirreset(struct _reent *r, DIR_ITER *dirState);
+static int       romfs_overlay_dirnext(struct _reent *r, DIR_ITER *dirState, char *filename, struct stat *filestat);
+static Result    romfsOverlayLookupFile(struct romfs_mount *ov, const char *path, struct romfs_mount **out_mount, romfs_file **out_file);
+static int searchForFile(struct romfs_mount *mount, romfs_dir* parent, const uint8_t* name, u32 namelen, romfs_file** out);
+
 typedef struct
 {
     romfs_mount *mount;
     romfs_file  *file;
     u64         offset, pos;
+    u64         nextPos;   ///< Position right after the previous read, to detect sequential reads
+    u32         readahead; ///< Blocks to fill on a cache miss
+    const u8    *data;     ///< File contents when they are in memory, or NULL
+    u64         size;      ///< Size of the file contents, uncompressed
+    const romfs_ctable_file *cfile; ///< Compression table entry, or NULL
+    u8          *czBuf;    ///< Decompression buffers, allocated on first use
+    u32         czBlock;   ///< Block held in czBuf, romFS_none when none
 } romfs_fileobj;
 
 typedef struct
@@ -132,6 +404,31 @@ static const devoptab_t romFS_devoptab =
     .dirclose_r   = romfs_dirclose,
 };
 
+typedef struct
+{
+    romfs_mount *mount;
+    u32         node;
+    u32         state;
+    u32         child;
+} romfs_overlay_diriter;
+
+static const devoptab_t romFS_overlay_devoptab =
+{
+    .structSize   = sizeof(romfs_fileobj),
+    .open_r       = romfs_overlay_open,
+    .close_r      = romfs_close,
+    .read_r       = romfs_read,
+    .seek_r       = romfs_seek,
+    .fstat_r      = romfs_fstat,
+    .stat_r       = romfs_overlay_stat,
+    .chdir_r      = romfs_overlay_chdir,
+    .dirStateSize = sizeof(romfs_overlay_diriter),
+    .diropen_r    = romfs_overlay_diropen,
+    .dirreset_r   = romfs_overlay_dirreset,
+    .dirnext_r    = romfs_overlay_dirnext,
+    .dirclose_r   = romfs_dirclose,
+};
+
 static bool romfs_initialised = false;
 static romfs_mount romfs_mounts[32];
 
@@ -139,6 +436,10 @@ static romfs_mount romfs_mounts[32];
 
 static Result romfsMountCommon(const char *name, romfs_mount *mount);
 static void romfsInitMtime(romfs_mount *mount);
+static void romfsBuildPathIndex(romfs_mount *mount);
+static int romfsLoadCompressionTable(romfs_mount *mount);
+static void romfsRehash(romfs_mount *mount, bool isDir);
+static void romfsStartDecompressPool(romfs_mount *mount);
 
 static void _romfsResetMount(romfs_mount *mount, s32 id) {
     memset(mount, 0, sizeof(*mount));
@@ -193,13 +494,43 @@ static romfs_mount *romfsFindMount(const char *name)
 
 __attribute__((weak)) const char* __romfs_path = NULL;
 
+/// Size of the block cache shared by all open files of a mount, in bytes. 0 disables it.
+__attribute__((weak)) u32 __nx_romfs_cache_size = 0;
+
+/// Threads decompressing in parallel for large reads of compressed files, the calling thread included. 1 decompresses on the calling thread only.
+__attribute__((weak)) u32 __nx_romfs_decompress_threads = 2;
+
+/// When set, each mount reads its whole image into memory, so file contents can be accessed in place with \ref romfsGetFilePointer.
+__attribute__((weak)) bool __nx_romfs_load_image = false;
+
+/// When set, each mount rebuilds its directory and file hash tables with a stronger hash and power-of-two sizing, keeping whichever of the old and new tables gives shorter probes.
+__attribute__((weak)) bool __nx_romfs_rehash = false;
+
+/// When set, each mount builds an index of all absolute paths, so lookups take a single probe instead of one hash chain walk per path component.
+__attribute__((weak)) bool __nx_romfs_path_index = false;
+
 static romfs_mount* romfs_alloc(void)
 {
     return romfsFindMount(NULL);
 }
 
+static void romfsStopDecompressPool(romfs_mount *mount);
+
 static void romfs_free(romfs_mount *mount)
 {
+    romfsStopDecompressPool(mount);
+    free(mount->ctable);
+    while (mount->resident)
+    {
+        romfs_resident* res = mount->resident;
+        mount->resident = res->next;
+        free(res->data);
+        free(res);
+    }
+    free(mount->image);
+    free(mount->pathIndex);
+    free(mount->cacheBlocks);
+    free(mount->cacheData);
     free(mount->fileTable);
     free(mount->fileHashTable);
     free(mount->dirTable);
@@ -209,6 +540,9 @@ static void romfs_free(romfs_mount *mount)
 
 static void romfs_mountclose(romfs_mount *mount)
 {
+    free(mount->ovLayers);
+    free(mount->ovNodes);
+    free(mount->ovIndex);
     if(mount->fd_type == RomfsSource_FsFile)fsFileClose(&mount->fd);
     if(mount->fd_type == RomfsSource_FsStorage)fsStorageClose(&mount->fd_storage);
     romfs_free(mount);
@@ -292,6 +626,32 @@ Result romfsMountFromStorage(FsStorage storage, u64 offset, const char *name)
     return romfsMountCommon(name, mount);
 }
 
+Result romfsMountFromCryptoStorage(CryptoStorage *storage, u64 offset, const char *name)
+{
+    romfs_mount *mount = romfs_alloc();
+    if(mount == NULL)
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+
+    mount->fd_type = RomfsSource_CryptoStorage;
+    mount->fd_crypto = storage;
+    mount->offset = offset;
+
+    return romfsMountCommon(name, mount);
+}
+
+Result romfsMountFromIntegrityStorage(IntegrityStorage *storage, u64 offset, const char *name)
+{
+    romfs_mount *mount = romfs_alloc();
+    if(mount == NULL)
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+
+    mount->fd_type = RomfsSource_IntegrityStorage;
+    mount->fd_integrity = storage;
+    mount->offset = offset;
+
+    return romfsMountCommon(name, mount);
+}
+
 Result romfsMountFromCurrentProcess(const char *name) {
     FsStorage storage;
 
@@ -371,6 +731,71 @@ Result romfsMountCommon(const char *name, romfs_mount *mount)
 
     mount->cwd = romFS_root(mount);
 
+    int ret = romfsLoadCompressionTable(mount);
+    if (ret == ENOMEM)
+        goto fail_oom;
+    if (ret != 0)
+        goto fail_io;
+
+    if (__nx_romfs_rehash)
+    {
+        romfsRehash(mount, true);
+        romfsRehash(mount, false);
+    }
+
+    if (__nx_romfs_path_index)
+        romfsBuildPathIndex(mount);
+
+    mutexInit(&mount->residentMutex);
+    mount->cacheNumBlocks = __nx_romfs_cache_size / ROMFS_CACHE_BLOCK_SIZE;
+
+    if (mount->cacheNumBlocks || __nx_romfs_load_image)
+    {
+        // Reads are clipped to the end of the image, which backing storages don't read past
+        s64 size = 0;
+        Result rc = 0;
+        if (mount->fd_type == RomfsSource_FsFile)
+            rc = fsFileGetSize(&mount->fd, &size);
+        else if (mount->fd_type == RomfsSource_CryptoStorage)
+            size = cryptoStorageGetSize(mount->fd_crypto);
+        else if (mount->fd_type == RomfsSource_IntegrityStorage)
+            size = integrityStorageGetSize(mount->fd_integrity);
+        else
+            rc = fsStorageGetSize(&mount->fd_storage, &size);
+        if (R_FAILED(rc) || (u64)size < mount->offset)
+            goto fail_io;
+        mount->imageSize = size - mount->offset;
+    }
+
+    if (__nx_romfs_load_image)
+    {
+        mount->image = (u8*)memalign(0x1000, mount->imageSize ? mount->imageSize : 1);
+        if (!mount->image)
+            goto fail_oom;
+        for (u64 pos = 0; pos < mount->imageSize; pos += 0x400000)
+        {
+            if (!_romfs_read_chk(mount, pos, mount->image + pos, MIN(mount->imageSize - pos, 0x400000)))
+                goto fail_io;
+        }
+
+        // Everything is in memory already
+        mount->cacheNumBlocks = 0;
+    }
+
+    if (mount->cacheNumBlocks)
+    {
+        mutexInit(&mount->cacheMutex);
+        condvarInit(&mount->cacheCond);
+
+        mount->cacheBlocks = (romfs_cache_block*)calloc(mount->cacheNumBlocks, sizeof(romfs_cache_block));
+        mount->cacheData = (u8*)memalign(0x1000, mount->cacheNumBlocks * ROMFS_CACHE_BLOCK_SIZE);
+        if (!mount->cacheBlocks || !mount->cacheData)
+            goto fail_oom;
+    }
+
+    if (mount->ctable)
+        romfsStartDecompressPool(mount);
+
     if(AddDevice(&mount->device) < 0)
         goto fail_oom;
 
@@ -426,10 +851,162 @@ static u32 calcHash(u32 parent, const uint8_t* name, u32 namelen, u32 total)
     return hash % total;
 }
 
+static u32 betterHash(u32 parent, const uint8_t* name, u32 namelen)
+{
+    // FNV-1a over the parent offset and the name, then a final mix so the low bits used for indexing depend on every input byte
+    u32 hash = 2166136261u;
+    for (u32 i = 0; i < 4; i ++)
+        hash = (hash ^ ((parent >> (8*i)) & 0xFF)) * 16777619u;
+    for (u32 i = 0; i < namelen; i ++)
+        hash = (hash ^ name[i]) * 16777619u;
+    hash ^= hash >> 16;
+    hash *= 0x85EBCA6B;
+    hash ^= hash >> 13;
+    return hash;
+}
+
+/// Hash table entry fields shared by directories and files
+static bool romfsHashEntry(romfs_mount *mount, bool isDir, u32 off, u32 *parent, const uint8_t **name, u32 *namelen, u32 **nextHash)
+{
+    if (isDir)
+    {
+        romfs_dir* dir = romFS_dir(mount, off);
+        if (!dir) return false;
+        *parent = dir->parent; *name = dir->name; *namelen = dir->nameLen; *nextHash = &dir->nextHash;
+    }
+    else
+    {
+        romfs_file* file = romFS_file(mount, off);
+        if (!file) return false;
+        *parent = file->parent; *name = file->name; *namelen = file->nameLen; *nextHash = &file->nextHash;
+    }
+    return true;
+}
+
+static void romfsChainStatsAdd(RomfsHashTableStats *stats, u32 length)
+{
+    if (!length)
+        return;
+    stats->num_entries += length;
+    stats->used_buckets ++;
+    stats->max_chain = MAX(stats->max_chain, length);
+    stats->total_probes += (u64)length * (length + 1) / 2;
+}
+
+static void romfsGetTableStats(romfs_mount *mount, bool isDir, RomfsHashTableStats *stats)
+{
+    u32* table = isDir ? mount->dirHashTable : mount->fileHashTable;
+    u32 mask = isDir ? mount->dirHashMask : mount->fileHashMask;
+    u32 numBuckets = mask ? mask + 1 : (isDir ? mount->header.dirHashTableSize : mount->header.fileHashTableSize) / 4;
+    u64 maxEntries = isDir ? mount->header.dirTableSize / sizeof(romfs_dir) : mount->header.fileTableSize / sizeof(romfs_file);
+
+    memset(stats, 0, sizeof(*stats));
+    stats->num_buckets = numBuckets;
+    stats->rebuilt = mask != 0;
+
+    for (u32 i = 0; i < numBuckets; i ++)
+    {
+        u32 length = 0;
+        for (u32 off = table[i]; off != romFS_none && length <= maxEntries; length ++)
+        {
+            u32 parent, namelen, *nextHash;
+            const uint8_t* name;
+            if (!romfsHashEntry(mount, isDir, off, &parent, &name, &namelen, &nextHash))
+                break;
+            off = *nextHash;
+        }
+        romfsChainStatsAdd(stats, length);
+    }
+}
+
+static void romfsRehash(romfs_mount *mount, bool isDir)
+{
+    RomfsHashTableStats oldStats, newStats = {0};
+    romfsGetTableStats(mount, isDir, &oldStats);
+    if (!oldStats.num_entries)
+        return;
+
+    u32 size = 4;
+    while (size < oldStats.num_entries)
+        size *= 2;
+
+    // Collect the entries from the old chains, then count the new chain lengths
+    u32* offs = (u32*)malloc(oldStats.num_entries * sizeof(u32));
+    u32* counts = (u32*)calloc(size, sizeof(u32));
+    u32* table = (u32*)malloc(size * sizeof(u32));
+    if (!offs || !counts || !table)
+        goto _done;
+
+    u32* oldTable = isDir ? mount->dirHashTable : mount->fileHashTable;
+    u32 n = 0;
+    for (u32 i = 0; i < oldStats.num_buckets && n < oldStats.num_entries; i ++)
+    {
+        for (u32 off = oldTable[i]; off != romFS_none && n < oldStats.num_entries;)
+        {
+            u32 parent, namelen, *nextHash;
+            const uint8_t* name;
+            if (!romfsHashEntry(mount, isDir, off, &parent, &name, &namelen, &nextHash))
+                break;
+            offs[n++] = off;
+            counts[betterHash(parent, name, namelen) & (size - 1)] ++;
+            off = *nextHash;
+        }
+    }
+
+    newStats.num_buckets = size;
+    for (u32 i = 0; i < size; i ++)
+        romfsChainStatsAdd(&newStats, counts[i]);
+
+    if (n != oldStats.num_entries || newStats.total_probes >= oldStats.total_probes)
+        goto _done;
+
+    // Relink the entries in the in-memory copy of the table
+    for (u32 i = 0; i < size; i ++)
+        table[i] = romFS_none;
+    for (u32 i = 0; i < n; i ++)
+    {
+        u32 parent, namelen, *nextHash;
+        const uint8_t* name;
+        romfsHashEntry(mount, isDir, offs[i], &parent, &name, &namelen, &nextHash);
+        u32 bucket = betterHash(parent, name, namelen) & (size - 1);
+        *nextHash = table[bucket];
+        table[bucket] = offs[i];
+    }
+
+    free(oldTable);
+    if (isDir)
+    {
+        mount->dirHashTable = table;
+        mount->dirHashMask = size - 1;
+    }
+    else
+    {
+        mount->fileHashTable = table;
+        mount->fileHashMask = size - 1;
+    }
+    table = NULL;
+
+_done:
+    free(offs);
+    free(counts);
+    free(table);
+}
+
+Result romfsGetHashStats(const char *name, RomfsHashStats *out)
+{
+    romfs_mount* mount = romfsFindMount(name);
+    if (mount == NULL)
+        return MAKERESULT(Module_Libnx, LibnxError_NotFound);
+
+    romfsGetTableStats(mount, true, &out->dirs);
+    romfsGetTableStats(mount, false, &out->files);
+    return 0;
+}
+
 static int searchForDir(romfs_mount *mount, romfs_dir* parent, const uint8_t* name, u32 namelen, romfs_dir** out)
 {
     u64 parentOff = (uintptr_t)parent - (uintptr_t)mount->dirTable;
-    u32 hash = calcHash(parentOff, name, namelen, mount->header.dirHashTableSize/4);
+    u32 hash = mount->dirHashMask ? betterHash(parentOff, name, namelen) & mount->dirHashMask : calcHash(parentOff, name, namelen, mount->header.dirHashTableSize/4);
     romfs_dir* curDir = NULL;
     u32 curOff;
     *out = NULL;
@@ -449,7 +1026,7 @@ static int searchForDir(romfs_mount *mount, romfs_dir* parent, const uint8_t* na
 static int searchForFile(romfs_mount *mount, romfs_dir* parent, const uint8_t* name, u32 namelen, romfs_file** out)
 {
     u64 parentOff = (uintptr_t)parent - (uintptr_t)mount->dirTable;
-    u32 hash = calcHash(parentOff, name, namelen, mount->header.fileHashTableSize/4);
+    u32 hash = mount->fileHashMask ? betterHash(parentOff, name, namelen) & mount->fileHashMask : calcHash(parentOff, name, namelen, mount->header.fileHashTableSize/4);
     romfs_file* curFile = NULL;
     u32 curOff;
     *out = NULL;
@@ -526,111 +1103,737 @@ static int navigateToDir(romfs_mount *mount, romfs_dir** ppDir, const char** pPa
     return 0;
 }
 
-static ino_t dir_inode(romfs_mount *mount, romfs_dir *dir)
+//-----------------------------------------------------------------------------
+
+#define ROMFS_PATH_HASH_INIT 2166136261u
+
+static u32 pathHashStep(u32 hash, const uint8_t* name, u32 namelen)
 {
-    return (uint32_t*)dir - (uint32_t*)mount->dirTable;
+    // FNV-1a over "/name", so hashes of nested paths can be built from their parent's
+    hash = (hash ^ '/') * 16777619u;
+    for (u32 i = 0; i < namelen; i ++)
+        hash = (hash ^ name[i]) * 16777619u;
+    return hash;
 }
 
-static off_t dir_size(romfs_dir *dir)
+static void romfsIndexInsert(romfs_mount *mount, u32 hash, u32 off, bool isDir)
 {
-    return sizeof(romfs_dir) + (dir->nameLen+3)/4;
+    u32 i;
+    for (i = hash & mount->pathIndexMask; mount->pathIndex[i].off != romFS_none; i = (i + 1) & mount->pathIndexMask);
+    mount->pathIndex[i].hash  = hash;
+    mount->pathIndex[i].off   = off;
+    mount->pathIndex[i].isDir = isDir;
 }
 
-static nlink_t dir_nlink(romfs_mount *mount, romfs_dir *dir)
+static void romfsBuildPathIndex(romfs_mount *mount)
 {
-    nlink_t count = 2; // one for self, one for parent
-    u32     offset = dir->childDir;
-
-    while(offset != romFS_none)
+    typedef struct { u32 off, hash; bool isDir; } node;
+
+    // Every entry takes at least its header, which bounds the walk on corrupted images
+    size_t maxNodes = mount->header.dirTableSize/sizeof(romfs_dir) + mount->header.fileTableSize/sizeof(romfs_file);
+    size_t numNodes = 0, capNodes = 256;
+    node* nodes = (node*)malloc(capNodes * sizeof(node));
+    if (!nodes)
+        return;
+
+    // Walk the tree breadth-first: nodes[] doubles as the queue of directories to visit
+    nodes[numNodes++] = (node){ 0, ROMFS_PATH_HASH_INIT, true };
+    for (size_t i = 0; i < numNodes; i ++)
     {
-        romfs_dir *tmp = romFS_dir(mount, offset);
-        if (!tmp) break;
-        ++count;
-        offset = tmp->sibling;
-    }
+        if (!nodes[i].isDir)
+            continue;
 
-    offset = dir->childFile;
-    while(offset != romFS_none)
-    {
-        romfs_file *tmp = romFS_file(mount, offset);
-        if (!tmp) break;
-        ++count;
-        offset = tmp->sibling;
+        romfs_dir* dir = romFS_dir(mount, nodes[i].off);
+        if (!dir)
+            goto _fail;
+
+        for (int pass = 0; pass < 2; pass ++)
+        {
+            u32 off = pass == 0 ? dir->childDir : dir->childFile;
+            while (off != romFS_none)
+            {
+                const uint8_t* name;
+                u32 namelen, sibling;
+                if (pass == 0)
+                {
+                    romfs_dir* child = romFS_dir(mount, off);
+                    if (!child) goto _fail;
+                    name = child->name; namelen = child->nameLen; sibling = child->sibling;
+                }
+                else
+                {
+                    romfs_file* child = romFS_file(mount, off);
+                    if (!child) goto _fail;
+                    name = child->name; namelen = child->nameLen; sibling = child->sibling;
+                }
+
+                if (numNodes >= maxNodes)
+                    goto _fail;
+                if (numNodes == capNodes)
+                {
+                    node* tmp = (node*)realloc(nodes, 2 * capNodes * sizeof(node));
+                    if (!tmp) goto _fail;
+                    nodes = tmp;
+                    capNodes *= 2;
+                }
+
+                nodes[numNodes++] = (node){ off, pathHashStep(nodes[i].hash, name, namelen), pass == 0 };
+                off = sibling;
+            }
+        }
     }
 
-    return count;
-}
+    // Keep the table at most half full
+    u32 size = 16;
+    while (size < 2 * numNodes)
+        size *= 2;
 
-static ino_t file_inode(romfs_mount *mount, romfs_file *file)
-{
-    return ((uint32_t*)file - (uint32_t*)mount->fileTable) + mount->header.dirTableSize/4;
-}
+    mount->pathIndex = (romfs_index_entry*)malloc(size * sizeof(romfs_index_entry));
+    if (!mount->pathIndex)
+        goto _fail;
 
-//-----------------------------------------------------------------------------
+    mount->pathIndexMask = size - 1;
+    for (u32 i = 0; i < size; i ++)
+        mount->pathIndex[i].off = romFS_none;
 
-int romfs_open(struct _reent *r, void *fileStruct, const char *path, int flags, int mode)
-{
-    romfs_fileobj* fileobj = (romfs_fileobj*)fileStruct;
+    for (size_t i = 0; i < numNodes; i ++)
+        romfsIndexInsert(mount, nodes[i].hash, nodes[i].off, nodes[i].isDir);
 
-    fileobj->mount = (romfs_mount*)r->deviceData;
+_fail:
+    free(nodes);
+}
 
-    if ((flags & O_ACCMODE) != O_RDONLY)
+static bool romfsIndexMatch(romfs_mount *mount, const romfs_index_entry *entry, const char* start, const char* end)
+{
+    // Compare components from the last one up, following the parent links
+    u32 dirOff = entry->off;
+    bool isFile = !entry->isDir;
+
+    while (end > start)
     {
-        r->_errno = EROFS;
-        return -1;
+        const char* component = end;
+        while (component > start && component[-1] != '/') component --;
+
+        const uint8_t* name;
+        u32 namelen;
+        if (isFile)
+        {
+            romfs_file* file = romFS_file(mount, dirOff);
+            if (!file) return false;
+            name = file->name; namelen = file->nameLen; dirOff = file->parent;
+            isFile = false;
+        }
+        else
+        {
+            romfs_dir* dir = romFS_dir(mount, dirOff);
+            if (!dir || dirOff == 0) return false;
+            name = dir->name; namelen = dir->nameLen; dirOff = dir->parent;
+        }
+
+        if (namelen != end - component || memcmp(name, component, namelen) != 0)
+            return false;
+        end = component == start ? start : component - 1;
     }
 
-    romfs_dir* curDir = NULL;
-    r->_errno = navigateToDir(fileobj->mount, &curDir, &path, false);
-    if (r->_errno != 0)
+    return dirOff == 0 && !isFile;
+}
+
+/// Looks up a path in the path index. Returns -1 when the index can't answer, in which case the path has to be walked.
+static int romfsIndexFind(romfs_mount *mount, const char* path, bool isDir, void** out)
+{
+    if (!mount->pathIndex)
         return -1;
 
-    romfs_file* file = NULL;
-    int ret = searchForFile(fileobj->mount, curDir, (uint8_t*)path, strlen(path), &file);
-    if (ret != 0)
-    {
-        if(ret == ENOENT && (flags & O_CREAT))
-            r->_errno = EROFS;
-        else
-            r->_errno = ret;
+    const char* colonPos = strchr(path, ':');
+    if (colonPos) path = colonPos+1;
+
+    // Only absolute paths (or relative to the root) without "." and ".." components are indexed
+    bool absolute = *path == '/';
+    if (!absolute && mount->cwd != romFS_root(mount))
         return -1;
-    }
-    else if((flags & O_CREAT) && (flags & O_EXCL))
+
+    u32 hash = ROMFS_PATH_HASH_INIT;
+    const char* p = absolute ? path + 1 : path;
+    const char* start = p;
+    if (!*p)
     {
-        r->_errno = EEXIST;
-        return -1;
+        if (!absolute || !isDir)
+            return -1;
+        *out = romFS_root(mount);
+        return 0;
     }
 
-    fileobj->file   = file;
-    fileobj->offset = fileobj->mount->header.fileDataOff + file->dataOff;
-    fileobj->pos    = 0;
+    for (;;)
+    {
+        const char* slashPos = p;
+        while (*slashPos && *slashPos != '/') slashPos ++;
+        u32 len = slashPos - p;
+        if (!len || (p[0] == '.' && (len == 1 || (len == 2 && p[1] == '.'))))
+            return -1;
 
+        hash = pathHashStep(hash, (const uint8_t*)p, len);
+        if (!*slashPos)
+        {
+            p = slashPos;
+            break;
+        }
+        p = slashPos + 1;
+    }
+
+    for (u32 i = hash & mount->pathIndexMask; mount->pathIndex[i].off != romFS_none; i = (i + 1) & mount->pathIndexMask)
+    {
+        const romfs_index_entry* entry = &mount->pathIndex[i];
+        if (entry->hash != hash || entry->isDir != isDir)
+            continue;
+        if (!romfsIndexMatch(mount, entry, start, p))
+            continue;
+
+        *out = isDir ? (void*)romFS_dir(mount, entry->off) : (void*)romFS_file(mount, entry->off);
+        return 0;
+    }
+
+    return ENOENT;
+}
+
+//-----------------------------------------------------------------------------
+
+static int romfsLoadCompressionTable(romfs_mount *mount)
+{
+    static const char name[] = ROMFS_CTABLE_NAME;
+    romfs_file* file = NULL;
+    int ret = searchForFile(mount, romFS_root(mount), (const uint8_t*)name, sizeof(name)-1, &file);
+    if (ret == ENOENT)
+        return 0;
+    if (ret != 0)
+        return ret;
+
+    if (file->dataSize < sizeof(romfs_ctable_header) || file->dataSize > UINT32_MAX)
+        return EIO;
+
+    mount->ctable = malloc(file->dataSize);
+    if (!mount->ctable)
+        return ENOMEM;
+    if (!_romfs_read_chk(mount, mount->header.fileDataOff + file->dataOff, mount->ctable, file->dataSize))
+        return EIO;
+
+    const romfs_ctable_header* hdr = (const romfs_ctable_header*)mount->ctable;
+    if (hdr->magic != ROMFS_CTABLE_MAGIC || hdr->version != ROMFS_CTABLE_VERSION)
+        return EIO;
+    if (hdr->blockSize < 0x1000 || hdr->blockSize > 0x100000 || (hdr->blockSize & (hdr->blockSize - 1)))
+        return EIO;
+    if (sizeof(*hdr) + (u64)hdr->numFiles * sizeof(romfs_ctable_file) + (u64)hdr->numBlocks * sizeof(romfs_ctable_block) > file->dataSize)
+        return EIO;
+
+    mount->ctableFiles     = (romfs_ctable_file*)(hdr + 1);
+    mount->ctableBlocks    = (romfs_ctable_block*)(mount->ctableFiles + hdr->numFiles);
+    mount->ctableNumFiles  = hdr->numFiles;
+    mount->ctableBlockSize = hdr->blockSize;
+
+    for (u32 i = 0; i < hdr->numFiles; i ++)
+    {
+        const romfs_ctable_file* cfile = &mount->ctableFiles[i];
+        if (i > 0 && cfile->dataOff <= cfile[-1].dataOff)
+            return EIO;
+        if ((u64)cfile->firstBlock + cfile->numBlocks > hdr->numBlocks)
+            return EIO;
+        if (cfile->numBlocks != (cfile->size + hdr->blockSize - 1) / hdr->blockSize)
+            return EIO;
+    }
+
+    // LZ4 never grows a block by more than this
+    u32 maxBlock = hdr->blockSize + hdr->blockSize/255 + 16;
+    for (u32 i = 0; i < hdr->numBlocks; i ++)
+    {
+        if (mount->ctableBlocks[i].size > maxBlock)
+            return EIO;
+        mount->ctableMaxBlock = MAX(mount->ctableMaxBlock, mount->ctableBlocks[i].size);
+    }
+
+    return 0;
+}
+
+static const romfs_ctable_file* romfsFindCompressed(romfs_mount *mount, romfs_file *file)
+{
+    u32 lo = 0, hi = mount->ctableNumFiles;
+    while (lo < hi)
+    {
+        u32 mid = lo + (hi - lo) / 2;
+        const romfs_ctable_file* cfile = &mount->ctableFiles[mid];
+        if (cfile->dataOff == file->dataOff)
+            return cfile;
+        if (cfile->dataOff < file->dataOff)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return NULL;
+}
+
+/// Size of a file's contents, uncompressed
+static u64 romfsFileSize(romfs_mount *mount, romfs_file *file)
+{
+    const romfs_ctable_file* cfile = mount->ctable ? romfsFindCompressed(mount, file) : NULL;
+    return cfile ? cfile->size : file->dataSize;
+}
+
+static ssize_t romfsLz4Decompress(const u8 *src, size_t srcLen, u8 *dst, size_t dstLen)
+{
+    const u8* ip = src;
+    const u8* iend = src + srcLen;
+    u8* op = dst;
+    u8* oend = dst + dstLen;
+
+    while (ip < iend)
+    {
+        u32 token = *ip++;
+
+        size_t lit = token >> 4;
+        if (lit == 15)
+        {
+            u8 b;
+            do {
+                if (ip >= iend) return -1;
+                b = *ip++;
+                lit += b;
+            } while (b == 255);
+        }
+        if (lit > (size_t)(iend - ip) || lit > (size_t)(oend - op))
+            return -1;
+        memcpy(op, ip, lit);
+        op += lit;
+        ip += lit;
+
+        // The last sequence only has literals
+        if (ip == iend)
+            break;
+
+        if (iend - ip < 2)
+            return -1;
+        size_t off = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if (off == 0 || off > (size_t)(op - dst))
+            return -1;
+
+        size_t match = token & 15;
+        if (match == 15)
+        {
+            u8 b;
+            do {
+                if (ip >= iend) return -1;
+                b = *ip++;
+                match += b;
+            } while (b == 255);
+        }
+        match += 4;
+        if (match > (size_t)(oend - op))
+            return -1;
+
+        // Matches may overlap the bytes they produce
+        const u8* m = op - off;
+        if (off >= match)
+            memcpy(op, m, match);
+        else
+            for (size_t i = 0; i < match; i ++)
+                op[i] = m[i];
+        op += match;
+    }
+
+    return op - dst;
+}
+
+/// Decompresses one block of a file into out, which holds len bytes: the whole uncompressed block. scratch holds ctableMaxBlock bytes.
+static bool romfsDecompressBlock(romfs_mount *mount, const romfs_ctable_file *cfile, u32 block, u8 *out, u32 len, u8 *scratch)
+{
+    const romfs_ctable_block* blk = &mount->ctableBlocks[cfile->firstBlock + block];
+    u64 offset = mount->header.fileDataOff + cfile->dataOff + blk->offset;
+    const u8* src;
+
+    if (mount->image)
+    {
+        if (offset + blk->size > mount->imageSize)
+            return false;
+        src = mount->image + offset;
+    }
+    else
+    {
+        ssize_t got = mount->cacheNumBlocks ? _romfs_cache_read(mount, offset, scratch, blk->size, 1) : _romfs_read(mount, offset, scratch, blk->size);
+        if (got != blk->size)
+            return false;
+        src = scratch;
+    }
+
+    switch (blk->codec)
+    {
+        case RomfsCodec_None:
+            if (blk->size != len)
+                return false;
+            memcpy(out, src, len);
+            return true;
+
+        case RomfsCodec_Lz4:
+            return romfsLz4Decompress(src, blk->size, out, len) == len;
+
+        default:
+            return false;
+    }
+}
+
+/// Decompresses the blocks of a job until none is left. buf holds blockSize + ctableMaxBlock bytes.
+static void romfsDecompressWork(romfs_mount *mount, romfs_cz_job *job, u8 *buf)
+{
+    u32 blockSize = mount->ctableBlockSize;
+    u8* scratch = buf + blockSize;
+
+    for (;;)
+    {
+        u32 block = __atomic_fetch_add(&job->nextBlock, 1, __ATOMIC_RELAXED);
+        if (block >= job->endBlock || __atomic_load_n(&job->failed, __ATOMIC_RELAXED))
+            break;
+
+        u64 blockPos = (u64)block * blockSize;
+        u32 blockLen = MIN(blockSize, job->cfile->size - blockPos);
+        u64 start = MAX(blockPos, job->pos);
+        u64 end = MIN(blockPos + blockLen, job->pos + job->len);
+
+        // Whole blocks go straight to the destination
+        bool ok;
+        if (start == blockPos && end == blockPos + blockLen)
+            ok = romfsDecompressBlock(mount, job->cfile, block, job->dst + (blockPos - job->pos), blockLen, scratch);
+        else
+        {
+            ok = romfsDecompressBlock(mount, job->cfile, block, buf, blockLen, scratch);
+            if (ok)
+                memcpy(job->dst + (start - job->pos), buf + (start - blockPos), end - start);
+        }
+
+        if (!ok)
+            __atomic_store_n(&job->failed, true, __ATOMIC_RELAXED);
+    }
+}
+
+static void romfsDecompressThread(void *arg)
+{
+    romfs_mount* mount = (romfs_mount*)arg;
+    u32 seen = 0;
+
+    u8* buf = (u8*)malloc(mount->ctableBlockSize + mount->ctableMaxBlock);
+
+    mutexLock(&mount->czMutex);
+    for (;;)
+    {
+        while (!mount->czExit && (!mount->czJob || mount->czGeneration == seen))
+            condvarWait(&mount->czCond, &mount->czMutex);
+        if (mount->czExit)
+            break;
+
+        seen = mount->czGeneration;
+        if (!buf)
+            continue;
+
+        romfs_cz_job* job = mount->czJob;
+        job->active ++;
+        mutexUnlock(&mount->czMutex);
+
+        romfsDecompressWork(mount, job, buf);
+
+        mutexLock(&mount->czMutex);
+        if (--job->active == 0)
+            condvarWakeAll(&mount->czDoneCond);
+    }
+    mutexUnlock(&mount->czMutex);
+
+    free(buf);
+}
+
+static void romfsStartDecompressPool(romfs_mount *mount)
+{
+    mutexInit(&mount->czJobMutex);
+    mutexInit(&mount->czMutex);
+    condvarInit(&mount->czCond);
+    condvarInit(&mount->czDoneCond);
+
+    u32 prio = 0x2C;
+    svcGetThreadPriority(&prio, CUR_THREAD_HANDLE);
+
+    u32 num = MIN(MAX(__nx_romfs_decompress_threads, 1), ROMFS_DECOMPRESS_MAX_THREADS) - 1;
+    for (u32 i = 0; i < num; i ++)
+    {
+        Thread* t = &mount->czThreads[mount->czNumThreads];
+        if (R_FAILED(threadCreate(t, romfsDecompressThread, mount, NULL, 0x4000, prio, -2)))
+            break;
+        if (R_FAILED(threadStart(t)))
+        {
+            threadClose(t);
+            break;
+        }
+        mount->czNumThreads ++;
+    }
+}
+
+static void romfsStopDecompressPool(romfs_mount *mount)
+{
+    if (!mount->czNumThreads)
+        return;
+
+    mutexLock(&mount->czMutex);
+    mount->czExit = true;
+    condvarWakeAll(&mount->czCond);
+    mutexUnlock(&mount->czMutex);
+
+    for (u32 i = 0; i < mount->czNumThreads; i ++)
+    {
+        threadWaitForExit(&mount->czThreads[i]);
+        threadClose(&mount->czThreads[i]);
+    }
+    mount->czNumThreads = 0;
+}
+
+/// Reads part of a compressed file. buf holds blockSize + ctableMaxBlock bytes.
+static bool romfsDecompressRange(romfs_mount *mount, const romfs_ctable_file *cfile, u64 pos, u8 *dst, u64 len, u8 *buf)
+{
+    if (!len)
+        return true;
+
+    romfs_cz_job job = {
+        .cfile     = cfile,
+        .dst       = dst,
+        .pos       = pos,
+        .len       = len,
+        .nextBlock = pos / mount->ctableBlockSize,
+        .endBlock  = (pos + len - 1) / mount->ctableBlockSize + 1,
+    };
+
+    // Hand the job to the pool when it spans several blocks and the pool is free, otherwise decompress here
+    bool parallel = mount->czNumThreads && job.endBlock - job.nextBlock > 1 && mutexTryLock(&mount->czJobMutex);
+    if (parallel)
+    {
+        mutexLock(&mount->czMutex);
+        mount->czJob = &job;
+        mount->czGeneration ++;
+        condvarWakeAll(&mount->czCond);
+        mutexUnlock(&mount->czMutex);
+    }
+
+    romfsDecompressWork(mount, &job, buf);
+
+    if (parallel)
+    {
+        mutexLock(&mount->czMutex);
+        mount->czJob = NULL;
+        while (job.active)
+            condvarWait(&mount->czDoneCond, &mount->czMutex);
+        mutexUnlock(&mount->czMutex);
+        mutexUnlock(&mount->czJobMutex);
+    }
+
+    return !job.failed;
+}
+
+/// Reads a file's whole contents, decompressing them if needed
+static bool romfsReadFileContents(romfs_mount *mount, romfs_file *file, u8 *dst)
+{
+    const romfs_ctable_file* cfile = mount->ctable ? romfsFindCompressed(mount, file) : NULL;
+    if (cfile)
+    {
+        u8* buf = (u8*)malloc(mount->ctableBlockSize + mount->ctableMaxBlock);
+        if (!buf)
+            return false;
+        bool ok = romfsDecompressRange(mount, cfile, 0, dst, cfile->size, buf);
+        free(buf);
+        return ok;
+    }
+
+    // Fill everything in large chunks
+    u64 offset = mount->header.fileDataOff + file->dataOff;
+    for (u64 pos = 0; pos < file->dataSize; pos += 0x400000)
+    {
+        if (!_romfs_read_chk(mount, offset + pos, dst + pos, MIN(file->dataSize - pos, 0x400000)))
+            return false;
+    }
+    return true;
+}
+
+static ino_t dir_inode(romfs_mount *mount, romfs_dir *dir)
+{
+    return (uint32_t*)dir - (uint32_t*)mount->dirTable;
+}
+
+static off_t dir_size(romfs_dir *dir)
+{
+    return sizeof(romfs_dir) + (dir->nameLen+3)/4;
+}
+
+static nlink_t dir_nlink(romfs_mount *mount, romfs_dir *dir)
+{
+    nlink_t count = 2; // one for self, one for parent
+    u32     offset = dir->childDir;
+
+    while(offset != romFS_none)
+    {
+        romfs_dir *tmp = romFS_dir(mount, offset);
+        if (!tmp) break;
+        ++count;
+        offset = tmp->sibling;
+    }
+
+    offset = dir->childFile;
+    while(offset != romFS_none)
+    {
+        romfs_file *tmp = romFS_file(mount, offset);
+        if (!tmp) break;
+        ++count;
+        offset = tmp->sibling;
+    }
+
+    return count;
+}
+
+static ino_t file_inode(romfs_mount *mount, romfs_file *file)
+{
+    return ((uint32_t*)file - (uint32_t*)mount->fileTable) + mount->header.dirTableSize/4;
+}
+
+//-----------------------------------------------------------------------------
+
+static void romfsInitFileObj(romfs_fileobj *fileobj, romfs_mount *mount, romfs_file *file)
+{
+    fileobj->mount     = mount;
+    fileobj->file      = file;
+    fileobj->offset    = mount->header.fileDataOff + file->dataOff;
+    fileobj->pos       = 0;
+    fileobj->nextPos   = 0;
+    fileobj->readahead = 1;
+    fileobj->data      = romfsGetResidentData(mount, file);
+    fileobj->cfile     = mount->ctable ? romfsFindCompressed(mount, file) : NULL;
+    fileobj->size      = fileobj->cfile ? fileobj->cfile->size : file->dataSize;
+    fileobj->czBuf     = NULL;
+    fileobj->czBlock   = romFS_none;
+}
+
+int romfs_open(struct _reent *r, void *fileStruct, const char *path, int flags, int mode)
+{
+    romfs_fileobj* fileobj = (romfs_fileobj*)fileStruct;
+
+    fileobj->mount = (romfs_mount*)r->deviceData;
+
+    if ((flags & O_ACCMODE) != O_RDONLY)
+    {
+        r->_errno = EROFS;
+        return -1;
+    }
+
+    romfs_file* file = NULL;
+    int ret = romfsIndexFind(fileobj->mount, path, false, (void**)&file);
+    if (ret < 0)
+    {
+        romfs_dir* curDir = NULL;
+        r->_errno = navigateToDir(fileobj->mount, &curDir, &path, false);
+        if (r->_errno != 0)
+            return -1;
+
+        ret = searchForFile(fileobj->mount, curDir, (uint8_t*)path, strlen(path), &file);
+    }
+    if (ret != 0)
+    {
+        if(ret == ENOENT && (flags & O_CREAT))
+            r->_errno = EROFS;
+        else
+            r->_errno = ret;
+        return -1;
+    }
+    else if((flags & O_CREAT) && (flags & O_EXCL))
+    {
+        r->_errno = EEXIST;
+        return -1;
+    }
+
+    romfsInitFileObj(fileobj, fileobj->mount, file);
     return 0;
 }
 
 int romfs_close(struct _reent *r, void *fd)
 {
+    romfs_fileobj* file = (romfs_fileobj*)fd;
+    free(file->czBuf);
     return 0;
 }
 
+static ssize_t romfs_read_compressed(romfs_fileobj *file, char *ptr, size_t len)
+{
+    romfs_mount* mount = file->mount;
+    u32 blockSize = mount->ctableBlockSize;
+
+    if(!file->czBuf)
+    {
+        file->czBuf = (u8*)malloc(blockSize + mount->ctableMaxBlock);
+        if(!file->czBuf)
+            return -1;
+    }
+
+    /* small reads decompress the whole block once and are served from it */
+    u32 block = file->pos / blockSize;
+    u64 blockPos = (u64)block * blockSize;
+    if(file->pos + len <= blockPos + blockSize)
+    {
+        if(file->czBlock != block)
+        {
+            file->czBlock = romFS_none;
+            u32 blockLen = MIN(blockSize, file->size - blockPos);
+            if(!romfsDecompressBlock(mount, file->cfile, block, file->czBuf, blockLen, file->czBuf + blockSize))
+                return -1;
+            file->czBlock = block;
+        }
+
+        memcpy(ptr, file->czBuf + (file->pos - blockPos), len);
+        return len;
+    }
+
+    file->czBlock = romFS_none;
+    if(!romfsDecompressRange(mount, file->cfile, file->pos, (u8*)ptr, len, file->czBuf))
+        return -1;
+    return len;
+}
+
 ssize_t romfs_read(struct _reent *r, void *fd, char *ptr, size_t len)
 {
     romfs_fileobj* file = (romfs_fileobj*)fd;
     u64 endPos = file->pos + len;
 
     /* check if past end-of-file */
-    if(file->pos >= file->file->dataSize)
+    if(file->pos >= file->size)
         return 0;
 
     /* truncate the read to end-of-file */
-    if(endPos > file->file->dataSize)
-        endPos = file->file->dataSize;
+    if(endPos > file->size)
+        endPos = file->size;
     len = endPos - file->pos;
 
-    ssize_t adv = _romfs_read(file->mount, file->offset + file->pos, ptr, len);
+    ssize_t adv;
+    romfs_mount* mount = file->mount;
+    if(file->data)
+    {
+        memcpy(ptr, file->data + file->pos, len);
+        adv = len;
+    }
+    else if(file->cfile)
+        adv = romfs_read_compressed(file, ptr, len);
+    else if(mount->cacheNumBlocks && len < ROMFS_CACHE_BLOCK_SIZE)
+    {
+        /* grow the read-ahead while the file is read sequentially */
+        if(file->pos == file->nextPos)
+            file->readahead = MIN(file->readahead * 2, MIN(ROMFS_CACHE_MAX_READAHEAD, MAX(mount->cacheNumBlocks / 4, 1)));
+        else
+            file->readahead = 1;
+
+        adv = _romfs_cache_read(mount, file->offset + file->pos, ptr, len, file->readahead);
+    }
+    else
+        adv = _romfs_read(mount, file->offset + file->pos, ptr, len);
+
     if(adv >= 0)
     {
         file->pos += adv;
+        file->nextPos = file->pos;
         return adv;
     }
 
@@ -653,7 +1856,7 @@ off_t romfs_seek(struct _reent *r, void *fd, off_t pos, int dir)
             break;
 
         case SEEK_END:
-            start = file->file->dataSize;
+            start = file->size;
             break;
 
         default:
@@ -681,81 +1884,544 @@ off_t romfs_seek(struct _reent *r, void *fd, off_t pos, int dir)
     return file->pos;
 }
 
-int romfs_fstat(struct _reent *r, void *fd, struct stat *st)
-{
-    romfs_fileobj* file = (romfs_fileobj*)fd;
-    memset(st, 0, sizeof(struct stat));
-    st->st_ino   = file_inode(file->mount, file->file);
-    st->st_mode  = romFS_file_mode;
-    st->st_nlink = 1;
-    st->st_size  = (off_t)file->file->dataSize;
-    st->st_blksize = 512;
-    st->st_blocks  = (st->st_blksize + 511) / 512;
-    st->st_atime = st->st_mtime = st->st_ctime = file->mount->mtime;
+int romfs_fstat(struct _reent *r, void *fd, struct stat *st)
+{
+    romfs_fileobj* file = (romfs_fileobj*)fd;
+    memset(st, 0, sizeof(struct stat));
+    st->st_ino   = file_inode(file->mount, file->file);
+    st->st_mode  = romFS_file_mode;
+    st->st_nlink = 1;
+    st->st_size  = (off_t)file->size;
+    st->st_blksize = 512;
+    st->st_blocks  = (st->st_blksize + 511) / 512;
+    st->st_atime = st->st_mtime = st->st_ctime = file->mount->mtime;
+
+    return 0;
+}
+
+int romfs_stat(struct _reent *r, const char *path, struct stat *st)
+{
+    romfs_mount* mount = (romfs_mount*)r->deviceData;
+    romfs_dir* curDir = NULL;
+    romfs_dir* dir = NULL;
+    romfs_file* file = NULL;
+    int ret=0;
+
+    bool indexed = romfsIndexFind(mount, path, true, (void**)&dir) >= 0;
+    if (indexed)
+    {
+        ret = dir ? 0 : ENOENT;
+    }
+    else
+    {
+        r->_errno = navigateToDir(mount, &curDir, &path, false);
+        if(r->_errno != 0)
+            return -1;
+
+        ret = searchForDir(mount, curDir, (uint8_t*)path, strlen(path), &dir);
+    }
+    if (ret != 0 && ret != ENOENT)
+    {
+        r->_errno = ret;
+        return -1;
+    }
+    if(ret == 0)
+    {
+        memset(st, 0, sizeof(*st));
+        st->st_ino     = dir_inode(mount, dir);
+        st->st_mode    = romFS_dir_mode;
+        st->st_nlink   = dir_nlink(mount, dir);
+        st->st_size    = dir_size(dir);
+        st->st_blksize = 512;
+        st->st_blocks  = (st->st_blksize + 511) / 512;
+        st->st_atime = st->st_mtime = st->st_ctime = mount->mtime;
+
+        return 0;
+    }
+
+    if (indexed)
+        ret = romfsIndexFind(mount, path, false, (void**)&file);
+    else
+        ret = searchForFile(mount, curDir, (uint8_t*)path, strlen(path), &file);
+    if (ret != 0 && ret != ENOENT)
+    {
+        r->_errno = ret;
+        return -1;
+    }
+    if(ret == 0)
+    {
+        memset(st, 0, sizeof(*st));
+        st->st_ino   = file_inode(mount, file);
+        st->st_mode  = romFS_file_mode;
+        st->st_nlink = 1;
+        st->st_size  = romfsFileSize(mount, file);
+        st->st_blksize = 512;
+        st->st_blocks  = (st->st_blksize + 511) / 512;
+        st->st_atime = st->st_mtime = st->st_ctime = mount->mtime;
+
+        return 0;
+    }
+
+    r->_errno = ENOENT;
+    return 1;
+}
+
+static Result romfsLookupFile(const char *path, romfs_mount **out_mount, romfs_file **out_file)
+{
+    int dev = FindDevice(path);
+    if (dev >= 0 && devoptab_list[dev]->open_r == romfs_overlay_open)
+        return romfsOverlayLookupFile((romfs_mount*)devoptab_list[dev]->deviceData, path, out_mount, out_file);
+    if (dev < 0 || devoptab_list[dev]->open_r != romfs_open)
+        return MAKERESULT(Module_Libnx, LibnxError_NotFound);
+
+    romfs_mount* mount = (romfs_mount*)devoptab_list[dev]->deviceData;
+    romfs_file* file = NULL;
+    int ret = romfsIndexFind(mount, path, false, (void**)&file);
+    if (ret < 0)
+    {
+        romfs_dir* curDir = NULL;
+        if (navigateToDir(mount, &curDir, &path, false) != 0)
+            return MAKERESULT(Module_Libnx, LibnxError_NotFound);
+
+        ret = searchForFile(mount, curDir, (uint8_t*)path, strlen(path), &file);
+    }
+    if (ret != 0)
+        return MAKERESULT(Module_Libnx, LibnxError_NotFound);
+
+    *out_mount = mount;
+    *out_file  = file;
+    return 0;
+}
+
+Result romfsDirIterOpen(RomfsDirIter *iter, const char *path)
+{
+    int dev = FindDevice(path);
+    if (dev < 0 || devoptab_list[dev]->open_r != romfs_open)
+        return MAKERESULT(Module_Libnx, LibnxError_NotFound);
+
+    romfs_mount* mount = (romfs_mount*)devoptab_list[dev]->deviceData;
+    romfs_dir* dir = NULL;
+    int ret = romfsIndexFind(mount, path, true, (void**)&dir);
+    if (ret < 0)
+        ret = navigateToDir(mount, &dir, &path, true);
+    if (ret != 0)
+        return MAKERESULT(Module_Libnx, LibnxError_NotFound);
+
+    iter->mount     = mount;
+    iter->childDir  = dir->childDir;
+    iter->childFile = dir->childFile;
+    return 0;
+}
+
+size_t romfsDirIterRead(RomfsDirIter *iter, RomfsDirEntry *entries, size_t max_entries)
+{
+    romfs_mount* mount = (romfs_mount*)iter->mount;
+    size_t count = 0;
+
+    // Directories come first, like in romfs_dirnext
+    while (count < max_entries && iter->childDir != romFS_none)
+    {
+        romfs_dir* dir = romFS_dir(mount, iter->childDir);
+        if (!dir)
+        {
+            iter->childDir = iter->childFile = romFS_none;
+            break;
+        }
+
+        iter->childDir = dir->sibling;
+        entries[count++] = (RomfsDirEntry){ (const char*)dir->name, dir->nameLen, true, 0, 0 };
+    }
+
+    while (count < max_entries && iter->childFile != romFS_none)
+    {
+        romfs_file* file = romFS_file(mount, iter->childFile);
+        if (!file)
+        {
+            iter->childFile = romFS_none;
+            break;
+        }
+
+        iter->childFile = file->sibling;
+        entries[count++] = (RomfsDirEntry){ (const char*)file->name, file->nameLen, false,
+            romfsFileSize(mount, file), mount->header.fileDataOff + file->dataOff };
+    }
+
+    return count;
+}
+
+static const u8* romfsGetResidentData(romfs_mount *mount, romfs_file *file)
+{
+    // Compressed files are only in memory once preloaded
+    u64 offset = mount->header.fileDataOff + file->dataOff;
+    if (mount->image && !(mount->ctable && romfsFindCompressed(mount, file)))
+        return offset + file->dataSize <= mount->imageSize ? mount->image + offset : NULL;
+
+    const u8* data = NULL;
+    mutexLock(&mount->residentMutex);
+    for (romfs_resident* res = mount->resident; res; res = res->next)
+    {
+        if (res->file == file)
+        {
+            data = res->data;
+            break;
+        }
+    }
+    mutexUnlock(&mount->residentMutex);
+    return data;
+}
+
+Result romfsPreloadFile(const char *path)
+{
+    romfs_mount* mount;
+    romfs_file* file;
+    Result rc = romfsLookupFile(path, &mount, &file);
+    if (R_FAILED(rc))
+        return rc;
+
+    if (romfsGetResidentData(mount, file))
+        return 0;
+
+    u64 size = romfsFileSize(mount, file);
+    romfs_resident* res = (romfs_resident*)malloc(sizeof(romfs_resident));
+    u8* data = (u8*)memalign(0x1000, size ? size : 1);
+    if (!res || !data)
+    {
+        free(res);
+        free(data);
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+    }
+
+    if (!romfsReadFileContents(mount, file, data))
+    {
+        free(res);
+        free(data);
+        return MAKERESULT(Module_Libnx, LibnxError_IoError);
+    }
+
+    res->file = file;
+    res->data = data;
+
+    mutexLock(&mount->residentMutex);
+    // Another thread may have loaded the same file in the meantime
+    romfs_resident* cur;
+    for (cur = mount->resident; cur && cur->file != file; cur = cur->next);
+    if (!cur)
+    {
+        res->next = mount->resident;
+        mount->resident = res;
+    }
+    mutexUnlock(&mount->residentMutex);
+
+    if (cur)
+    {
+        free(data);
+        free(res);
+    }
+    return 0;
+}
+
+Result romfsGetFilePointer(const char *path, const void **out_ptr, size_t *out_size)
+{
+    romfs_mount* mount;
+    romfs_file* file;
+    Result rc = romfsLookupFile(path, &mount, &file);
+    if (R_FAILED(rc))
+        return rc;
+
+    const u8* data = romfsGetResidentData(mount, file);
+    if (!data)
+        return MAKERESULT(Module_Libnx, LibnxError_NotInitialized);
+
+    *out_ptr  = data;
+    *out_size = romfsFileSize(mount, file);
+    return 0;
+}
+
+typedef struct
+{
+    u64 offset, size;
+} romfs_prefetch_item;
+
+typedef struct
+{
+    romfs_mount         *mount;
+    romfs_prefetch_item *items;
+    size_t              numItems, capItems;
+    size_t              nextItem;
+    Result              rc;
+} romfs_prefetch;
+
+static bool romfsPrefetchAdd(romfs_prefetch *pf, romfs_file *file)
+{
+    if (pf->numItems == pf->capItems)
+    {
+        size_t cap = pf->capItems ? 2 * pf->capItems : 64;
+        romfs_prefetch_item* tmp = (romfs_prefetch_item*)realloc(pf->items, cap * sizeof(romfs_prefetch_item));
+        if (!tmp)
+            return false;
+        pf->items = tmp;
+        pf->capItems = cap;
+    }
+
+    pf->items[pf->numItems++] = (romfs_prefetch_item){ pf->mount->header.fileDataOff + file->dataOff, file->dataSize };
+    return true;
+}
+
+/// Matches a path against a pattern where '*' matches any run of characters (slashes included) and '?' any single one.
+static bool romfsPatternMatch(const char *pattern, const char *str)
+{
+    const char *star = NULL, *retry = NULL;
+    while (*str)
+    {
+        if (*pattern == '*')
+        {
+            star = ++pattern;
+            retry = str;
+        }
+        else if (*pattern == '?' || *pattern == *str)
+        {
+            pattern ++;
+            str ++;
+        }
+        else if (star)
+        {
+            pattern = star;
+            str = ++retry;
+        }
+        else
+            return false;
+    }
+
+    while (*pattern == '*')
+        pattern ++;
+    return !*pattern;
+}
+
+/// Adds the files of a directory tree, those matching pattern when it isn't NULL. path holds the directory's path and has room for PATH_MAX+1 characters.
+static bool romfsPrefetchAddDir(romfs_prefetch *pf, romfs_dir *dir, char *path, size_t len, const char *pattern, u32 depth)
+{
+    romfs_mount* mount = pf->mount;
+    if (depth > PATH_MAX / 2)
+        return true; // only reachable on corrupted images
+
+    for (u32 off = dir->childFile; off != romFS_none;)
+    {
+        romfs_file* file = romFS_file(mount, off);
+        if (!file)
+            break;
+        off = file->sibling;
+
+        if (pattern)
+        {
+            if (len + 1 + file->nameLen > PATH_MAX)
+                continue;
+            path[len] = '/';
+            memcpy(path + len + 1, file->name, file->nameLen);
+            path[len + 1 + file->nameLen] = 0;
+            if (!romfsPatternMatch(pattern, path))
+                continue;
+        }
+
+        if (!romfsPrefetchAdd(pf, file))
+            return false;
+    }
+
+    for (u32 off = dir->childDir; off != romFS_none;)
+    {
+        romfs_dir* child = romFS_dir(mount, off);
+        if (!child)
+            break;
+        off = child->sibling;
+
+        size_t childLen = len;
+        if (pattern)
+        {
+            if (len + 1 + child->nameLen > PATH_MAX)
+                continue;
+            path[len] = '/';
+            memcpy(path + len + 1, child->name, child->nameLen);
+            childLen = len + 1 + child->nameLen;
+        }
+
+        if (!romfsPrefetchAddDir(pf, child, path, childLen, pattern, depth + 1))
+            return false;
+    }
+
+    return true;
+}
+
+static void romfsPrefetchWorker(void *arg)
+{
+    romfs_prefetch* pf = (romfs_prefetch*)arg;
+    romfs_mount* mount = pf->mount;
+    size_t chunkSize = ROMFS_CACHE_MAX_READAHEAD * ROMFS_CACHE_BLOCK_SIZE;
+
+    u8* buf = (u8*)malloc(chunkSize);
+    if (!buf)
+    {
+        pf->rc = MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+        return;
+    }
+
+    for (;;)
+    {
+        size_t i = __atomic_fetch_add(&pf->nextItem, 1, __ATOMIC_RELAXED);
+        if (i >= pf->numItems)
+            break;
+
+        romfs_prefetch_item* item = &pf->items[i];
+        for (u64 pos = 0; pos < item->size;)
+        {
+            u64 chunk = MIN(item->size - pos, chunkSize);
+            ssize_t adv = _romfs_cache_read(mount, item->offset + pos, buf, chunk, ROMFS_CACHE_MAX_READAHEAD);
+            if (adv <= 0)
+            {
+                pf->rc = MAKERESULT(Module_Libnx, LibnxError_IoError);
+                break;
+            }
+            pos += adv;
+        }
+    }
+
+    free(buf);
+}
+
+Result romfsPrefetch(const char *name, const char *const *paths, size_t num_paths, u32 num_threads)
+{
+    romfs_mount* mount = romfsFindMount(name);
+    if (mount == NULL)
+        return MAKERESULT(Module_Libnx, LibnxError_NotFound);
+
+    // Everything is in memory already
+    if (mount->image)
+        return 0;
+    if (!mount->cacheNumBlocks)
+        return MAKERESULT(Module_Libnx, LibnxError_NotInitialized);
+
+    romfs_prefetch pf = { .mount = mount };
+    char* path = (char*)malloc(PATH_MAX+1);
+    if (!path)
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+
+    Result rc = 0;
+    for (size_t i = 0; i < num_paths && R_SUCCEEDED(rc); i ++)
+    {
+        const char* cur = paths[i];
+        if (strpbrk(cur, "*?"))
+        {
+            path[0] = 0;
+            if (!romfsPrefetchAddDir(&pf, romFS_root(mount), path, 0, cur, 0))
+                rc = MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+            continue;
+        }
+
+        romfs_file* file = NULL;
+        romfs_dir* dir = NULL;
+        int ret = romfsIndexFind(mount, cur, false, (void**)&file);
+        if (ret != 0)
+            ret = romfsIndexFind(mount, cur, true, (void**)&dir);
+        if (ret < 0)
+        {
+            const char* p = cur;
+            ret = navigateToDir(mount, &dir, &p, true);
+            if (ret != 0)
+            {
+                p = cur;
+                romfs_dir* parent = NULL;
+                ret = navigateToDir(mount, &parent, &p, false);
+                if (ret == 0)
+                    ret = searchForFile(mount, parent, (uint8_t*)p, strlen(p), &file);
+            }
+        }
+
+        if (ret != 0)
+            rc = MAKERESULT(Module_Libnx, LibnxError_NotFound);
+        else if (file ? !romfsPrefetchAdd(&pf, file) : !romfsPrefetchAddDir(&pf, dir, path, 0, NULL, 0))
+            rc = MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+    }
+    free(path);
+
+    if (R_SUCCEEDED(rc) && pf.numItems)
+    {
+        // Reads from several threads go out on separate FS sessions
+        Thread threads[ROMFS_PREFETCH_MAX_THREADS];
+        u32 numStarted = 0;
+        u32 prio = 0x2C;
+
+        num_threads = MAX(MIN(num_threads, ROMFS_PREFETCH_MAX_THREADS), 1);
+        svcGetThreadPriority(&prio, CUR_THREAD_HANDLE);
+        for (u32 i = 1; i < num_threads; i ++)
+        {
+            if (R_FAILED(threadCreate(&threads[numStarted], romfsPrefetchWorker, &pf, NULL, 0x4000, prio, -2)))
+                break;
+            if (R_FAILED(threadStart(&threads[numStarted])))
+            {
+                threadClose(&threads[numStarted]);
+                break;
+            }
+            numStarted ++;
+        }
+
+        // Help out, which also covers the case where no thread could be started
+        romfsPrefetchWorker(&pf);
+
+        for (u32 i = 0; i < numStarted; i ++)
+        {
+            threadWaitForExit(&threads[i]);
+            threadClose(&threads[i]);
+        }
+
+        rc = pf.rc;
+    }
 
-    return 0;
+    free(pf.items);
+    return rc;
 }
 
-int romfs_stat(struct _reent *r, const char *path, struct stat *st)
+Result romfsMapFile(const char *path, const void **out_ptr, size_t *out_size)
 {
-    romfs_mount* mount = (romfs_mount*)r->deviceData;
-    romfs_dir* curDir = NULL;
-    r->_errno = navigateToDir(mount, &curDir, &path, false);
-    if(r->_errno != 0)
-        return -1;
-
-    romfs_dir* dir = NULL;
-    int ret=0;
-    ret = searchForDir(mount, curDir, (uint8_t*)path, strlen(path), &dir);
-    if (ret != 0 && ret != ENOENT)
-    {
-        r->_errno = ret;
-        return -1;
-    }
-    if(ret == 0)
-    {
-        memset(st, 0, sizeof(*st));
-        st->st_ino     = dir_inode(mount, dir);
-        st->st_mode    = romFS_dir_mode;
-        st->st_nlink   = dir_nlink(mount, dir);
-        st->st_size    = dir_size(dir);
-        st->st_blksize = 512;
-        st->st_blocks  = (st->st_blksize + 511) / 512;
-        st->st_atime = st->st_mtime = st->st_ctime = mount->mtime;
+    romfs_mount* mount;
+    romfs_file* file;
+    Result rc = romfsLookupFile(path, &mount, &file);
+    if (R_FAILED(rc))
+        return rc;
 
-        return 0;
-    }
+    u64 size = romfsFileSize(mount, file);
+    size_t alloc_size = (size + 0xFFF) & ~0xFFF;
+    u8* buf = memalign(0x1000, alloc_size ? alloc_size : 0x1000);
+    if (buf == NULL)
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
 
-    romfs_file* file = NULL;
-    ret = searchForFile(mount, curDir, (uint8_t*)path, strlen(path), &file);
-    if (ret != 0 && ret != ENOENT)
+    // Fill everything up front
+    if (!romfsReadFileContents(mount, file, buf))
     {
-        r->_errno = ret;
-        return -1;
+        free(buf);
+        return MAKERESULT(Module_Libnx, LibnxError_IoError);
     }
-    if(ret == 0)
-    {
-        memset(st, 0, sizeof(*st));
-        st->st_ino   = file_inode(mount, file);
-        st->st_mode  = romFS_file_mode;
-        st->st_nlink = 1;
-        st->st_size  = file->dataSize;
-        st->st_blksize = 512;
-        st->st_blocks  = (st->st_blksize + 511) / 512;
-        st->st_atime = st->st_mtime = st->st_ctime = mount->mtime;
 
-        return 0;
+    // The mapping is read-only, so catch stray writes
+    if (alloc_size)
+    {
+        Result rc = svcSetMemoryPermission(buf, alloc_size, Perm_R);
+        if (R_FAILED(rc))
+        {
+            free(buf);
+            return rc;
+        }
     }
 
-    r->_errno = ENOENT;
-    return 1;
+    *out_ptr  = buf;
+    *out_size = size;
+    return 0;
 }
 
 int romfs_chdir(struct _reent *r, const char *path)
 {
     romfs_mount* mount = (romfs_mount*)r->deviceData;
     romfs_dir* curDir = NULL;
-    r->_errno = navigateToDir(mount, &curDir, &path, true);
+    r->_errno = romfsIndexFind(mount, path, true, (void**)&curDir);
+    if (r->_errno < 0)
+        r->_errno = navigateToDir(mount, &curDir, &path, true);
     if (r->_errno != 0)
         return -1;
 
@@ -769,7 +2435,9 @@ DIR_ITER* romfs_diropen(struct _reent *r, DIR_ITER *dirState, const char *path)
     romfs_dir* curDir = NULL;
     iter->mount = (romfs_mount*)r->deviceData;
 
-    r->_errno = navigateToDir(iter->mount, &curDir, &path, true);
+    r->_errno = romfsIndexFind(iter->mount, path, true, (void**)&curDir);
+    if(r->_errno < 0)
+        r->_errno = navigateToDir(iter->mount, &curDir, &path, true);
     if(r->_errno != 0)
         return NULL;
 
@@ -890,3 +2558,464 @@ int romfs_dirclose(struct _reent *r, DIR_ITER *dirState)
     return 0;
 }
 
+
+//-----------------------------------------------------------------------------
+
+static void romfsOverlayEntryName(romfs_overlay_node *node, const uint8_t **name, u32 *namelen)
+{
+    if (node->isDir)
+    {
+        romfs_dir* dir = (romfs_dir*)node->entry;
+        *name = dir->name; *namelen = dir->nameLen;
+    }
+    else
+    {
+        romfs_file* file = (romfs_file*)node->entry;
+        *name = file->name; *namelen = file->nameLen;
+    }
+}
+
+/// Finds the child of a node by name, with a single probe of the merged index
+static u32 romfsOverlayFindChild(romfs_mount *ov, u32 parent, const uint8_t *name, u32 namelen)
+{
+    u32 hash = pathHashStep(ov->ovNodes[parent].hash, name, namelen);
+    for (u32 i = hash & ov->ovIndexMask; ov->ovIndex[i] != romFS_none; i = (i + 1) & ov->ovIndexMask)
+    {
+        romfs_overlay_node* node = &ov->ovNodes[ov->ovIndex[i]];
+        if (node->hash != hash || node->parent != parent || node->dead)
+            continue;
+
+        const uint8_t* nodeName;
+        u32 nodeNameLen;
+        romfsOverlayEntryName(node, &nodeName, &nodeNameLen);
+        if (nodeNameLen == namelen && memcmp(nodeName, name, namelen) == 0)
+            return ov->ovIndex[i];
+    }
+    return romFS_none;
+}
+
+static void romfsOverlayIndexInsert(romfs_mount *ov, u32 idx)
+{
+    u32 i;
+    for (i = ov->ovNodes[idx].hash & ov->ovIndexMask; ov->ovIndex[i] != romFS_none; i = (i + 1) & ov->ovIndexMask);
+    ov->ovIndex[i] = idx;
+}
+
+static bool romfsOverlayAddNode(romfs_mount *ov, u32 parent, u32 layer, bool isDir, void *entry, const uint8_t *name, u32 namelen, u32 *out)
+{
+    if (ov->ovNumNodes == ov->ovCapNodes)
+    {
+        u32 cap = ov->ovCapNodes ? 2 * ov->ovCapNodes : 256;
+        romfs_overlay_node* tmp = (romfs_overlay_node*)realloc(ov->ovNodes, cap * sizeof(romfs_overlay_node));
+        if (!tmp)
+            return false;
+        ov->ovNodes = tmp;
+        ov->ovCapNodes = cap;
+    }
+
+    // Keep the index at most half full
+    if (2 * (ov->ovNumNodes + 1) > ov->ovIndexMask + 1)
+    {
+        u32 size = 2 * (ov->ovIndexMask + 1);
+        u32* index = (u32*)malloc(size * sizeof(u32));
+        if (!index)
+            return false;
+        free(ov->ovIndex);
+        ov->ovIndex = index;
+        ov->ovIndexMask = size - 1;
+        for (u32 i = 0; i < size; i ++)
+            index[i] = romFS_none;
+        for (u32 i = 0; i < ov->ovNumNodes; i ++)
+            romfsOverlayIndexInsert(ov, i);
+    }
+
+    u32 idx = ov->ovNumNodes++;
+    romfs_overlay_node* node = &ov->ovNodes[idx];
+    node->hash       = idx ? pathHashStep(ov->ovNodes[parent].hash, name, namelen) : ROMFS_PATH_HASH_INIT;
+    node->parent     = parent;
+    node->firstChild = romFS_none;
+    node->sibling    = romFS_none;
+    node->layer      = layer;
+    node->isDir      = isDir;
+    node->dead       = false;
+    node->entry      = entry;
+    if (idx)
+    {
+        node->sibling = ov->ovNodes[parent].firstChild;
+        ov->ovNodes[parent].firstChild = idx;
+    }
+    romfsOverlayIndexInsert(ov, idx);
+
+    *out = idx;
+    return true;
+}
+
+static void romfsOverlayKill(romfs_mount *ov, u32 idx)
+{
+    // Iterative, following the child lists, as the tree may be deep
+    u32 cur = ov->ovNodes[idx].firstChild;
+    ov->ovNodes[idx].firstChild = romFS_none;
+    while (cur != romFS_none)
+    {
+        romfs_overlay_node* node = &ov->ovNodes[cur];
+        node->dead = true;
+        if (node->firstChild != romFS_none)
+        {
+            u32 child = node->firstChild;
+            node->firstChild = romFS_none;
+            cur = child;
+            continue;
+        }
+        while (cur != idx && ov->ovNodes[cur].sibling == romFS_none)
+            cur = ov->ovNodes[cur].parent;
+        if (cur == idx)
+            break;
+        cur = ov->ovNodes[cur].sibling;
+    }
+}
+
+/// Merges the tree of one layer, under node, from the layer's directory dir
+static bool romfsOverlayMergeLayer(romfs_mount *ov, u32 layer)
+{
+    romfs_mount* mount = ov->ovLayers[layer];
+    typedef struct { u32 node; romfs_dir* dir; } pending;
+    size_t maxDirs = mount->header.dirTableSize / sizeof(romfs_dir);
+    size_t num = 0, cap = 64;
+    pending* queue = (pending*)malloc(cap * sizeof(pending));
+    if (!queue)
+        return false;
+
+    queue[num++] = (pending){ 0, romFS_root(mount) };
+    for (size_t i = 0; i < num; i ++)
+    {
+        u32 parent = queue[i].node;
+        romfs_dir* dir = queue[i].dir;
+
+        for (u32 off = dir->childFile; off != romFS_none;)
+        {
+            romfs_file* file = romFS_file(mount, off);
+            if (!file)
+                break;
+            off = file->sibling;
+
+            // Files of higher layers replace entries of lower ones
+            u32 idx = romfsOverlayFindChild(ov, parent, file->name, file->nameLen);
+            if (idx != romFS_none)
+            {
+                if (ov->ovNodes[idx].isDir)
+                    romfsOverlayKill(ov, idx);
+                ov->ovNodes[idx].isDir = false;
+                ov->ovNodes[idx].layer = layer;
+                ov->ovNodes[idx].entry = file;
+            }
+            else if (!romfsOverlayAddNode(ov, parent, layer, false, file, file->name, file->nameLen, &idx))
+                goto _fail;
+        }
+
+        for (u32 off = dir->childDir; off != romFS_none;)
+        {
+            romfs_dir* child = romFS_dir(mount, off);
+            if (!child)
+                break;
+            off = child->sibling;
+
+            // Directories are merged
+            u32 idx = romfsOverlayFindChild(ov, parent, child->name, child->nameLen);
+            if (idx != romFS_none)
+            {
+                ov->ovNodes[idx].isDir = true;
+                ov->ovNodes[idx].layer = layer;
+                ov->ovNodes[idx].entry = child;
+            }
+            else if (!romfsOverlayAddNode(ov, parent, layer, true, child, child->name, child->nameLen, &idx))
+                goto _fail;
+
+            if (num >= maxDirs)
+                goto _fail; // only reachable on corrupted images
+            if (num == cap)
+            {
+                pending* tmp = (pending*)realloc(queue, 2 * cap * sizeof(pending));
+                if (!tmp)
+                    goto _fail;
+                queue = tmp;
+                cap *= 2;
+            }
+            queue[num++] = (pending){ idx, child };
+        }
+    }
+
+    free(queue);
+    return true;
+
+_fail:
+    free(queue);
+    return false;
+}
+
+Result romfsMountOverlay(const char *name, const char *const *layers, u32 num_layers)
+{
+    if (!num_layers)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    romfs_mount *ov = romfs_alloc();
+    if (ov == NULL)
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+
+    memcpy(&ov->device, &romFS_overlay_devoptab, sizeof(romFS_overlay_devoptab));
+    ov->device.name       = ov->name;
+    ov->device.deviceData = ov;
+    ov->fd_type = RomfsSource_Overlay;
+    memset(ov->name, 0, sizeof(ov->name));
+    strncpy(ov->name, name, sizeof(ov->name)-1);
+    romfsInitMtime(ov);
+
+    Result rc = 0;
+    ov->ovLayers = (romfs_mount**)malloc(num_layers * sizeof(romfs_mount*));
+    if (!ov->ovLayers)
+        rc = MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+
+    for (u32 i = 0; R_SUCCEEDED(rc) && i < num_layers; i ++)
+    {
+        romfs_mount* layer = romfsFindMount(layers[i]);
+        if (!layer || layer->fd_type == RomfsSource_Overlay)
+            rc = MAKERESULT(Module_Libnx, LibnxError_NotFound);
+        else
+            ov->ovLayers[ov->ovNumLayers++] = layer;
+    }
+
+    u32 root;
+    if (R_SUCCEEDED(rc) && !romfsOverlayAddNode(ov, 0, 0, true, romFS_root(ov->ovLayers[0]), NULL, 0, &root))
+        rc = MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+
+    for (u32 i = 0; R_SUCCEEDED(rc) && i < ov->ovNumLayers; i ++)
+    {
+        if (!romfsOverlayMergeLayer(ov, i))
+            rc = MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+    }
+
+    if (R_SUCCEEDED(rc))
+    {
+        ov->ovCwd = 0;
+        if (AddDevice(&ov->device) < 0)
+            rc = MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+    }
+
+    if (R_FAILED(rc))
+    {
+        romfs_mountclose(ov);
+        return rc;
+    }
+
+    ov->setup = true;
+    return 0;
+}
+
+/// Resolves a path in an overlay, one index probe per component
+static int romfsOverlayResolve(romfs_mount *ov, const char *path, u32 *out)
+{
+    const char* colonPos = strchr(path, ':');
+    if (colonPos) path = colonPos+1;
+    if (!*path)
+        return EILSEQ;
+
+    u32 cur = ov->ovCwd;
+    if (*path == '/')
+    {
+        cur = 0;
+        path ++;
+    }
+
+    while (*path)
+    {
+        const char* end = path;
+        while (*end && *end != '/') end ++;
+        u32 len = end - path;
+
+        if (len == 0 || (len == 1 && path[0] == '.'))
+            ; // skip
+        else if (len == 2 && path[0] == '.' && path[1] == '.')
+            cur = ov->ovNodes[cur].parent;
+        else
+        {
+            if (!ov->ovNodes[cur].isDir)
+                return ENOTDIR;
+            cur = romfsOverlayFindChild(ov, cur, (const uint8_t*)path, len);
+            if (cur == romFS_none)
+                return ENOENT;
+        }
+
+        path = *end ? end + 1 : end;
+    }
+
+    *out = cur;
+    return 0;
+}
+
+static Result romfsOverlayLookupFile(romfs_mount *ov, const char *path, romfs_mount **out_mount, romfs_file **out_file)
+{
+    u32 idx;
+    if (romfsOverlayResolve(ov, path, &idx) != 0 || ov->ovNodes[idx].isDir)
+        return MAKERESULT(Module_Libnx, LibnxError_NotFound);
+
+    *out_mount = ov->ovLayers[ov->ovNodes[idx].layer];
+    *out_file  = (romfs_file*)ov->ovNodes[idx].entry;
+    return 0;
+}
+
+static nlink_t romfs_overlay_nlink(romfs_mount *ov, u32 idx)
+{
+    nlink_t count = 2; // one for self, one for parent
+    for (u32 cur = ov->ovNodes[idx].firstChild; cur != romFS_none; cur = ov->ovNodes[cur].sibling)
+        ++count;
+    return count;
+}
+
+static void romfs_overlay_fill_stat(romfs_mount *ov, u32 idx, struct stat *st)
+{
+    romfs_overlay_node* node = &ov->ovNodes[idx];
+    memset(st, 0, sizeof(*st));
+    st->st_ino     = idx;
+    st->st_blksize = 512;
+    st->st_blocks  = (st->st_blksize + 511) / 512;
+    st->st_atime = st->st_mtime = st->st_ctime = ov->mtime;
+    if (node->isDir)
+    {
+        st->st_mode  = romFS_dir_mode;
+        st->st_nlink = romfs_overlay_nlink(ov, idx);
+        st->st_size  = dir_size((romfs_dir*)node->entry);
+    }
+    else
+    {
+        st->st_mode  = romFS_file_mode;
+        st->st_nlink = 1;
+        st->st_size  = romfsFileSize(ov->ovLayers[node->layer], (romfs_file*)node->entry);
+    }
+}
+
+int romfs_overlay_open(struct _reent *r, void *fileStruct, const char *path, int flags, int mode)
+{
+    romfs_fileobj* fileobj = (romfs_fileobj*)fileStruct;
+    romfs_mount* ov = (romfs_mount*)r->deviceData;
+
+    if ((flags & O_ACCMODE) != O_RDONLY)
+    {
+        r->_errno = EROFS;
+        return -1;
+    }
+
+    u32 idx;
+    int ret = romfsOverlayResolve(ov, path, &idx);
+    if (ret == 0 && ov->ovNodes[idx].isDir)
+        ret = EISDIR;
+    if (ret != 0)
+    {
+        r->_errno = (ret == ENOENT && (flags & O_CREAT)) ? EROFS : ret;
+        return -1;
+    }
+    else if((flags & O_CREAT) && (flags & O_EXCL))
+    {
+        r->_errno = EEXIST;
+        return -1;
+    }
+
+    // Reads go straight to the layer the file comes from
+    romfsInitFileObj(fileobj, ov->ovLayers[ov->ovNodes[idx].layer], (romfs_file*)ov->ovNodes[idx].entry);
+    return 0;
+}
+
+int romfs_overlay_stat(struct _reent *r, const char *path, struct stat *st)
+{
+    romfs_mount* ov = (romfs_mount*)r->deviceData;
+    u32 idx;
+    r->_errno = romfsOverlayResolve(ov, path, &idx);
+    if (r->_errno != 0)
+        return -1;
+
+    romfs_overlay_fill_stat(ov, idx, st);
+    return 0;
+}
+
+int romfs_overlay_chdir(struct _reent *r, const char *path)
+{
+    romfs_mount* ov = (romfs_mount*)r->deviceData;
+    u32 idx;
+    r->_errno = romfsOverlayResolve(ov, path, &idx);
+    if (r->_errno == 0 && !ov->ovNodes[idx].isDir)
+        r->_errno = ENOTDIR;
+    if (r->_errno != 0)
+        return -1;
+
+    ov->ovCwd = idx;
+    return 0;
+}
+
+DIR_ITER* romfs_overlay_diropen(struct _reent *r, DIR_ITER *dirState, const char *path)
+{
+    romfs_overlay_diriter* iter = (romfs_overlay_diriter*)(dirState->dirStruct);
+    iter->mount = (romfs_mount*)r->deviceData;
+
+    u32 idx;
+    r->_errno = romfsOverlayResolve(iter->mount, path, &idx);
+    if (r->_errno == 0 && !iter->mount->ovNodes[idx].isDir)
+        r->_errno = ENOTDIR;
+    if (r->_errno != 0)
+        return NULL;
+
+    iter->node  = idx;
+    iter->state = 0;
+    iter->child = iter->mount->ovNodes[idx].firstChild;
+    return dirState;
+}
+
+int romfs_overlay_dirreset(struct _reent *r, DIR_ITER *dirState)
+{
+    romfs_overlay_diriter* iter = (romfs_overlay_diriter*)(dirState->dirStruct);
+    iter->state = 0;
+    iter->child = iter->mount->ovNodes[iter->node].firstChild;
+    return 0;
+}
+
+int romfs_overlay_dirnext(struct _reent *r, DIR_ITER *dirState, char *filename, struct stat *filestat)
+{
+    romfs_overlay_diriter* iter = (romfs_overlay_diriter*)(dirState->dirStruct);
+    romfs_mount* ov = iter->mount;
+
+    if(iter->state < 2)
+    {
+        /* '.' and '..' entries */
+        memset(filestat, 0, sizeof(*filestat));
+        filestat->st_ino  = iter->state == 0 ? iter->node : ov->ovNodes[iter->node].parent;
+        filestat->st_mode = romFS_dir_mode;
+
+        strcpy(filename, iter->state == 0 ? "." : "..");
+        iter->state ++;
+        return 0;
+    }
+
+    if(iter->child == romFS_none)
+    {
+        r->_errno = ENOENT;
+        return -1;
+    }
+
+    romfs_overlay_node* node = &ov->ovNodes[iter->child];
+    const uint8_t* name;
+    u32 namelen;
+    romfsOverlayEntryName(node, &name, &namelen);
+
+    memset(filestat, 0, sizeof(*filestat));
+    filestat->st_ino  = iter->child;
+    filestat->st_mode = node->isDir ? romFS_dir_mode : romFS_file_mode;
+    iter->child = node->sibling;
+
+    memset(filename, 0, NAME_MAX);
+
+    if(namelen >= NAME_MAX)
+    {
+        r->_errno = ENAMETOOLONG;
+        return -1;
+    }
+
+    strncpy(filename, (const char*)name, namelen);
+    return 0;
+}
@@ -1,8 +1,10 @@
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
 #include <errno.h>
 #include <alloca.h>
+#include <malloc.h>
 #include <sys/iosupport.h>
 
 #include <fcntl.h>
@@ -12,12 +14,25 @@
 #include <sys/select.h>
 #include <sys/socket.h>
 #include <sys/sysctl.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
 
 #include "result.h"
+#include "kernel/svc.h"
+#include "arm/counter.h"
 #include "services/bsd.h"
 #include "runtime/devices/socket.h"
 
 __attribute__((weak)) size_t __nx_pollfd_sb_max_fds = 64;
+// Enables the per-socket statistics returned by socketGetStats.
+__attribute__((weak)) bool __nx_socket_stats = false;
+
+static int g_socketDevice = -1; // devoptab index of "soc:"
+
+static Mutex g_socketStatsMutex;
+static SocketStats *g_socketStats; // Indexed by bsd fd
+static u32 g_socketStatsCount;
+static SocketStats g_socketStatsTotal;
 
 int _convert_errno(int bsdErrno);
 
@@ -72,10 +87,112 @@ static const SocketInitConfig g_defaultSocketInitConfig = {
     .bsd_service_type = BsdServiceType_User,
 };
 
+static const SocketInitConfig g_lowMemorySocketInitConfig = {
+    .bsdsockets_version = 1,
+
+    .tcp_tx_buf_size        = 0x4000,
+    .tcp_rx_buf_size        = 0x8000,
+    .tcp_tx_buf_max_size    = 0,
+    .tcp_rx_buf_max_size    = 0,
+
+    .udp_tx_buf_size = 0x2400,
+    .udp_rx_buf_size = 0xA500,
+
+    .sb_efficiency = 2,
+
+    .num_bsd_sessions = 2,
+    .bsd_service_type = BsdServiceType_User,
+};
+
+static const SocketInitConfig g_highThroughputSocketInitConfig = {
+    .bsdsockets_version = 1,
+
+    .tcp_tx_buf_size        = 0x20000,
+    .tcp_rx_buf_size        = 0x40000,
+    .tcp_tx_buf_max_size    = 0x100000,
+    .tcp_rx_buf_max_size    = 0x100000,
+
+    .udp_tx_buf_size = 0x2400,
+    .udp_rx_buf_size = 0xA500,
+
+    .sb_efficiency = 4,
+
+    .num_bsd_sessions = 3,
+    .bsd_service_type = BsdServiceType_User,
+};
+
+static const SocketInitConfig g_serverSocketInitConfig = {
+    .bsdsockets_version = 1,
+
+    .tcp_tx_buf_size        = 0x4000,
+    .tcp_rx_buf_size        = 0x4000,
+    .tcp_tx_buf_max_size    = 0x20000,
+    .tcp_rx_buf_max_size    = 0x20000,
+
+    .udp_tx_buf_size = 0x2400,
+    .udp_rx_buf_size = 0xA500,
+
+    .sb_efficiency = 8,
+
+    .num_bsd_sessions = 8,
+    .bsd_service_type = BsdServiceType_User,
+};
+
 const SocketInitConfig *socketGetDefaultInitConfig(void) {
     return &g_defaultSocketInitConfig;
 }
 
+// Same computation as the transfer memory sizing in bsd.c.
+static size_t _socketGetTransferMemSize(const SocketInitConfig *config) {
+    u32 tcp_tx_buf_max_size = config->tcp_tx_buf_max_size != 0 ? config->tcp_tx_buf_max_size : config->tcp_tx_buf_size;
+    u32 tcp_rx_buf_max_size = config->tcp_rx_buf_max_size != 0 ? config->tcp_rx_buf_max_size : config->tcp_rx_buf_size;
+    u32 sum = tcp_tx_buf_max_size + tcp_rx_buf_max_size + config->udp_tx_buf_size + config->udp_rx_buf_size;
+
+    sum = (sum + 0xFFF) &~ 0xFFF;
+    return (size_t)config->sb_efficiency * sum;
+}
+
+static size_t _socketGetAvailableMemory(void) {
+    // The heap normally takes up most of the memory pool, so count what newlib has not handed out yet.
+    extern char* fake_heap_start;
+    extern char* fake_heap_end;
+
+    size_t avail = 0;
+    size_t heap_size = fake_heap_end - fake_heap_start;
+    struct mallinfo mi = mallinfo();
+    if (heap_size > (size_t)mi.uordblks)
+        avail = heap_size - mi.uordblks;
+
+    u64 mem_total = 0, mem_used = 0;
+    if (R_SUCCEEDED(svcGetInfo(&mem_total, InfoType_TotalMemorySize, CUR_PROCESS_HANDLE, 0)) &&
+        R_SUCCEEDED(svcGetInfo(&mem_used, InfoType_UsedMemorySize, CUR_PROCESS_HANDLE, 0)) &&
+        mem_total > mem_used)
+        avail += mem_total - mem_used;
+
+    return avail;
+}
+
+const SocketInitConfig *socketGetProfileInitConfig(SocketInitProfile profile) {
+    switch (profile) {
+        case SocketInitProfile_LowMemory:
+            return &g_lowMemorySocketInitConfig;
+        case SocketInitProfile_HighThroughput:
+            return &g_highThroughputSocketInitConfig;
+        case SocketInitProfile_Server:
+            return &g_serverSocketInitConfig;
+        case SocketInitProfile_Auto: {
+            size_t budget = _socketGetAvailableMemory() / 8;
+            if (_socketGetTransferMemSize(&g_highThroughputSocketInitConfig) <= budget)
+                return &g_highThroughputSocketInitConfig;
+            if (_socketGetTransferMemSize(&g_defaultSocketInitConfig) <= budget)
+                return &g_defaultSocketInitConfig;
+            return &g_lowMemorySocketInitConfig;
+        }
+        default:
+            return &g_defaultSocketInitConfig;
+    }
+}
+
 Result socketInitialize(const SocketInitConfig *config) {
     Result ret = 0;
     if (!config)
@@ -120,6 +237,7 @@ Result socketInitialize(const SocketInitConfig *config) {
         return MAKERESULT(Module_Libnx, LibnxError_TooManyDevOpTabs);
     }
     else {
+        g_socketDevice = dev;
         g_bsdResult = 0;
         g_bsdErrno = 0;
     }
@@ -128,6 +246,7 @@ Result socketInitialize(const SocketInitConfig *config) {
 }
 
 void socketExit(void) {
+    g_socketDevice = -1;
     RemoveDevice("soc:");
     bsdExit();
 }
@@ -138,13 +257,14 @@ Result socketGetLastResult(void) {
 
 /***********************************************************************************************************************/
 
-static int _socketGetFd(int fd) {
+// Called for every socket operation: the device index is compared instead of the devoptab name.
+NX_INLINE int _socketGetFd(int fd) {
     __handle *handle = __get_handle(fd);
     if(handle == NULL) {
         errno = EBADF;
         return -1;
     }
-    if(strcmp(devoptab_list[handle->device]->name, "soc") != 0) {
+    if(handle->device != g_socketDevice) {
         errno = ENOTSOCK;
         return -1;
     }
@@ -187,6 +307,117 @@ static int _socketParseBsdResult(struct _reent *r, int ret) {
     return -1;
 }
 
+NX_INLINE u64 _socketStatsBegin(void) {
+    return __nx_socket_stats ? armGetSystemTick() : 0;
+}
+
+static void _socketStatsAdd(SocketStats *stats, bool is_send, u64 ns, ssize_t ret, bool eagain) {
+    if(is_send) {
+        stats->num_send++;
+        stats->send_ns += ns;
+        if(ret > 0)
+            stats->bytes_out += ret;
+    } else {
+        stats->num_recv++;
+        stats->recv_ns += ns;
+        if(ret > 0)
+            stats->bytes_in += ret;
+    }
+    if(ret < 0) {
+        if(eagain)
+            stats->num_eagain++;
+        else
+            stats->num_errors++;
+    }
+}
+
+static void _socketStatsRecord(int bsdfd, bool is_send, u64 start, ssize_t ret, bool eagain) {
+    if(!start || bsdfd < 0)
+        return;
+
+    u64 ns = armTicksToNs(armGetSystemTick() - start);
+
+    mutexLock(&g_socketStatsMutex);
+    if((u32)bsdfd >= g_socketStatsCount) {
+        u32 count = g_socketStatsCount ? g_socketStatsCount : 64;
+        while(count <= (u32)bsdfd)
+            count *= 2;
+        SocketStats *stats = (SocketStats *)realloc(g_socketStats, count * sizeof(SocketStats));
+        if(stats) {
+            memset(stats + g_socketStatsCount, 0, (count - g_socketStatsCount) * sizeof(SocketStats));
+            g_socketStats = stats;
+            g_socketStatsCount = count;
+        }
+    }
+    if((u32)bsdfd < g_socketStatsCount)
+        _socketStatsAdd(&g_socketStats[bsdfd], is_send, ns, ret, eagain);
+    _socketStatsAdd(&g_socketStatsTotal, is_send, ns, ret, eagain);
+    mutexUnlock(&g_socketStatsMutex);
+}
+
+// Called when a bsd fd is allocated or released, as fds are reused.
+static void _socketStatsClear(int bsdfd) {
+    if(!__nx_socket_stats || bsdfd < 0)
+        return;
+
+    mutexLock(&g_socketStatsMutex);
+    if((u32)bsdfd < g_socketStatsCount)
+        memset(&g_socketStats[bsdfd], 0, sizeof(SocketStats));
+    mutexUnlock(&g_socketStatsMutex);
+}
+
+int socketGetStats(int fd, SocketStats *out) {
+    if(fd == -1) {
+        mutexLock(&g_socketStatsMutex);
+        *out = g_socketStatsTotal;
+        mutexUnlock(&g_socketStatsMutex);
+        return 0;
+    }
+
+    int bsdfd = _socketGetFd(fd);
+    if(bsdfd == -1)
+        return -1;
+
+    mutexLock(&g_socketStatsMutex);
+    if((u32)bsdfd < g_socketStatsCount)
+        *out = g_socketStats[bsdfd];
+    else
+        memset(out, 0, sizeof(*out));
+    mutexUnlock(&g_socketStatsMutex);
+    return 0;
+}
+
+void socketResetStats(void) {
+    mutexLock(&g_socketStatsMutex);
+    if(g_socketStats)
+        memset(g_socketStats, 0, g_socketStatsCount * sizeof(SocketStats));
+    memset(&g_socketStatsTotal, 0, sizeof(g_socketStatsTotal));
+    mutexUnlock(&g_socketStatsMutex);
+}
+
+static void _socketDumpStatsLine(FILE *f, const char *name, const SocketStats *st) {
+    fprintf(f, "%-8s in %10llu B / %8llu calls / %8llu us, out %10llu B / %8llu calls / %8llu us, EAGAIN %llu, errors %llu\n",
+        name,
+        (unsigned long long)st->bytes_in, (unsigned long long)st->num_recv, (unsigned long long)(st->recv_ns / 1000),
+        (unsigned long long)st->bytes_out, (unsigned long long)st->num_send, (unsigned long long)(st->send_ns / 1000),
+        (unsigned long long)st->num_eagain, (unsigned long long)st->num_errors);
+}
+
+void socketDumpStats(FILE *f) {
+    char name[16];
+
+    mutexLock(&g_socketStatsMutex);
+    for(u32 i = 0; i < g_socketStatsCount; i++) {
+        const SocketStats *st = &g_socketStats[i];
+        if(st->num_recv || st->num_send) {
+            snprintf(name, sizeof(name), "bsd %u", i);
+            _socketDumpStatsLine(f, name, st);
+        }
+    }
+    _socketDumpStatsLine(f, "total", &g_socketStatsTotal);
+    mutexUnlock(&g_socketStatsMutex);
+}
+
 static int _socketOpen(struct _reent *r, void *fdptr, const char *path, int flags, int mode) {
     (void)mode;
     if(strncmp(path, "soc:", 4)==0) path+= 4;
@@ -200,22 +431,27 @@ static int _socketOpen(struct _reent *r, void *fdptr, const char *path, int flag
 
 static int _socketClose(struct _reent *r, void *fdptr) {
     int fd = *(int *)fdptr;
+    _socketStatsClear(fd);
     return _socketParseBsdResult(r, bsdClose(fd));
 }
 
 static ssize_t _socketWrite(struct _reent *r, void *fdptr, const char *buf, size_t count) {
     int fd = *(int *)fdptr;
+    u64 start = _socketStatsBegin();
     ssize_t ret = bsdWrite(fd, buf, count);
 
     _socketParseBsdResult(r, (int)ret);
+    _socketStatsRecord(fd, true, start, ret, ret == -1 && r->_errno == EAGAIN);
     return ret;
 }
 
 static ssize_t _socketRead(struct _reent *r, void *fdptr, char *buf, size_t count) {
     int fd = *(int *)fdptr;
+    u64 start = _socketStatsBegin();
     ssize_t ret = bsdRead(fd, buf, count);
 
     _socketParseBsdResult(r, (int)ret);
+    _socketStatsRecord(fd, false, start, ret, ret == -1 && r->_errno == EAGAIN);
     return ret;
 }
 
@@ -368,6 +604,408 @@ int poll(struct pollfd *fds, nfds_t nfds, int timeout) {
     return ret;
 }
 
+static int _socketEpollFind(SocketEpoll *ep, int fd) {
+    for(u32 i = 0; i < ep->count; i++) {
+        if(ep->fds[i] == fd)
+            return i;
+    }
+    return -1;
+}
+
+static int _socketEpollGrow(SocketEpoll *ep, u32 capacity) {
+    struct pollfd *pollfds = (struct pollfd *)realloc(ep->pollfds, capacity * sizeof(struct pollfd));
+    if(pollfds == NULL)
+        return -1;
+    ep->pollfds = pollfds;
+
+    int *fds = (int *)realloc(ep->fds, capacity * sizeof(int));
+    if(fds == NULL)
+        return -1;
+    ep->fds = fds;
+
+    u64 *data = (u64 *)realloc(ep->data, capacity * sizeof(u64));
+    if(data == NULL)
+        return -1;
+    ep->data = data;
+
+    u32 *events = (u32 *)realloc(ep->events, capacity * sizeof(u32));
+    if(events == NULL)
+        return -1;
+    ep->events = events;
+
+    ep->capacity = capacity;
+    return 0;
+}
+
+int socketEpollCreate(SocketEpoll *ep, u32 capacity) {
+    if(ep == NULL) {
+        errno = EFAULT;
+        return -1;
+    }
+
+    memset(ep, 0, sizeof(*ep));
+    if(capacity != 0 && _socketEpollGrow(ep, capacity) == -1) {
+        socketEpollClose(ep);
+        errno = ENOMEM;
+        return -1;
+    }
+    return 0;
+}
+
+void socketEpollClose(SocketEpoll *ep) {
+    free(ep->pollfds);
+    free(ep->fds);
+    free(ep->data);
+    free(ep->events);
+    memset(ep, 0, sizeof(*ep));
+}
+
+int socketEpollCtl(SocketEpoll *ep, SocketEpollOp op, int fd, u32 events, u64 data) {
+    struct pollfd *pollfds = (struct pollfd *)ep->pollfds;
+    int idx = _socketEpollFind(ep, fd);
+
+    switch(op) {
+        case SocketEpollOp_Add: {
+            if(idx != -1) {
+                errno = EEXIST;
+                return -1;
+            }
+            int bsdfd = _socketGetFd(fd);
+            if(bsdfd == -1)
+                return -1;
+            if(ep->count == ep->capacity && _socketEpollGrow(ep, ep->capacity ? 2 * ep->capacity : 16) == -1) {
+                errno = ENOMEM;
+                return -1;
+            }
+            pollfds = (struct pollfd *)ep->pollfds;
+            idx = ep->count++;
+            ep->fds[idx] = fd;
+            pollfds[idx].fd = bsdfd;
+            break;
+        }
+
+        case SocketEpollOp_Mod:
+            if(idx == -1) {
+                errno = ENOENT;
+                return -1;
+            }
+            // Re-arm an entry disarmed by SOCKET_EPOLL_ONESHOT.
+            if(pollfds[idx].fd < 0)
+                pollfds[idx].fd = ~pollfds[idx].fd;
+            break;
+
+        case SocketEpollOp_Del:
+            if(idx == -1) {
+                errno = ENOENT;
+                return -1;
+            }
+            // Swap with the last entry so the cached array stays dense.
+            ep->count--;
+            pollfds[idx] = pollfds[ep->count];
+            ep->fds[idx] = ep->fds[ep->count];
+            ep->data[idx] = ep->data[ep->count];
+            ep->events[idx] = ep->events[ep->count];
+            return 0;
+
+        default:
+            errno = EINVAL;
+            return -1;
+    }
+
+    ep->events[idx] = events;
+    ep->data[idx] = data;
+    pollfds[idx].events = events & 0xFFFF;
+    pollfds[idx].revents = 0;
+    return 0;
+}
+
+int socketEpollWait(SocketEpoll *ep, SocketEpollEvent *out, int max_events, int timeout) {
+    struct pollfd *pollfds = (struct pollfd *)ep->pollfds;
+
+    if(out == NULL || max_events <= 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    // The cached array already holds bsd fds, so it is passed as-is without any per-call rebuild.
+    int ret = _socketParseBsdResult(NULL, bsdPoll(pollfds, ep->count, timeout));
+    if(ret <= 0)
+        return ret;
+
+    int num_events = 0;
+    u32 start = ep->scan_start < ep->count ? ep->scan_start : 0;
+    u32 i = start;
+    for(u32 n = 0; n < ep->count && num_events < ret && num_events < max_events; n++, i = i + 1 < ep->count ? i + 1 : 0) {
+        if(pollfds[i].revents == 0)
+            continue;
+
+        out[num_events].events = (u16)pollfds[i].revents;
+        out[num_events].data = ep->data[i];
+        num_events++;
+
+        pollfds[i].revents = 0;
+        // A cleared events mask would still report POLLERR/POLLHUP, a negative fd is ignored by poll altogether.
+        if(ep->events[i] & SOCKET_EPOLL_ONESHOT)
+            pollfds[i].fd = ~pollfds[i].fd;
+        ep->scan_start = i + 1;
+    }
+
+    return num_events;
+}
+
+typedef enum {
+    SocketPollWaiterState_Idle,
+    SocketPollWaiterState_Armed,
+    SocketPollWaiterState_Polling,
+    SocketPollWaiterState_Done,
+} SocketPollWaiterState;
+
+static Result _socketPollWaiterGrow(SocketPollWaiter *w, u32 capacity) {
+    struct pollfd *pollfds = (struct pollfd *)realloc(w->pollfds, capacity * sizeof(struct pollfd));
+    if(pollfds == NULL)
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+    if(w->pollfds == NULL)
+        memset(pollfds, 0, sizeof(*pollfds));
+    w->pollfds = pollfds;
+    w->capacity = capacity;
+    return 0;
+}
+
+static void _socketPollWaiterDrain(SocketPollWaiter *w) {
+    u8 tmp[16];
+    while(bsdRecv(w->wake_fd, tmp, sizeof(tmp), MSG_DONTWAIT) > 0);
+}
+
+static void _socketPollWaiterThreadFunc(void *arg) {
+    SocketPollWaiter *w = (SocketPollWaiter *)arg;
+    struct pollfd *pollfds;
+
+    mutexLock(&w->mutex);
+    for(;;) {
+        while(w->state != SocketPollWaiterState_Armed && !w->should_exit)
+            condvarWait(&w->cond, &w->mutex);
+        if(w->should_exit)
+            break;
+
+        w->state = SocketPollWaiterState_Polling;
+        pollfds = (struct pollfd *)w->pollfds;
+        u32 nfds = w->nfds;
+        mutexUnlock(&w->mutex);
+
+        int ret, error = 0;
+        for(;;) {
+            // The poll blocks on the dedicated session, so the pooled sessions stay available to other threads.
+            ret = _socketParseBsdResult(NULL, bsdPollOnSession(w->session, pollfds, nfds + 1, -1));
+            if(ret == -1) {
+                error = errno;
+                break;
+            }
+
+            bool woken = pollfds[0].revents != 0;
+            if(woken) {
+                _socketPollWaiterDrain(w);
+                pollfds[0].revents = 0;
+                ret--;
+            }
+            if(ret > 0 || __atomic_load_n(&w->cancel_requested, __ATOMIC_ACQUIRE))
+                break;
+        }
+
+        mutexLock(&w->mutex);
+        if(w->cancel_requested) {
+            w->cancel_requested = false;
+            w->state = SocketPollWaiterState_Idle;
+        }
+        else {
+            w->result = ret;
+            w->error = error;
+            w->state = SocketPollWaiterState_Done;
+            ueventSignal(&w->event);
+        }
+        condvarWakeAll(&w->cond);
+    }
+    mutexUnlock(&w->mutex);
+}
+
+Result socketPollWaiterCreate(SocketPollWaiter *w, int prio, int cpuid) {
+    memset(w, 0, sizeof(*w));
+    w->wake_fd = -1;
+    w->session = INVALID_HANDLE;
+    mutexInit(&w->mutex);
+    condvarInit(&w->cond);
+    ueventCreate(&w->event, false);
+
+    Result rc = _socketPollWaiterGrow(w, 16);
+    if(R_SUCCEEDED(rc))
+        rc = bsdCloneSession(&w->session);
+
+    if(R_SUCCEEDED(rc)) {
+        struct sockaddr_in addr = {
+            .sin_family = AF_INET,
+            .sin_port = 0,
+            .sin_addr = { .s_addr = htonl(INADDR_LOOPBACK) },
+        };
+        socklen_t addrlen = sizeof(addr);
+
+        w->wake_fd = bsdSocket(AF_INET, SOCK_DGRAM, 0);
+        if(w->wake_fd == -1
+            || bsdBind(w->wake_fd, (struct sockaddr *)&addr, sizeof(addr)) == -1
+            || bsdGetSockName(w->wake_fd, (struct sockaddr *)&addr, &addrlen) == -1)
+            rc = R_FAILED(g_bsdResult) ? g_bsdResult : MAKERESULT(Module_Libnx, LibnxError_IoError);
+        else
+            memcpy(w->wake_addr, &addr, sizeof(addr));
+    }
+
+    if(R_SUCCEEDED(rc)) {
+        struct pollfd *pollfds = (struct pollfd *)w->pollfds;
+        pollfds[0].fd = w->wake_fd;
+        pollfds[0].events = POLLIN;
+        rc = threadCreate(&w->thread, _socketPollWaiterThreadFunc, w, NULL, 0x4000, prio, cpuid);
+    }
+
+    if(R_SUCCEEDED(rc)) {
+        rc = threadStart(&w->thread);
+        if(R_FAILED(rc))
+            threadClose(&w->thread);
+    }
+
+    if(R_FAILED(rc)) {
+        if(w->wake_fd != -1)
+            bsdClose(w->wake_fd);
+        bsdCloseSession(w->session);
+        free(w->pollfds);
+        memset(w, 0, sizeof(*w));
+    }
+    return rc;
+}
+
+void socketPollWaiterClose(SocketPollWaiter *w) {
+    if(w->pollfds == NULL)
+        return;
+
+    socketPollWaiterCancel(w);
+
+    mutexLock(&w->mutex);
+    w->should_exit = true;
+    condvarWakeAll(&w->cond);
+    mutexUnlock(&w->mutex);
+
+    threadWaitForExit(&w->thread);
+    threadClose(&w->thread);
+
+    bsdClose(w->wake_fd);
+    bsdCloseSession(w->session);
+    free(w->pollfds);
+    memset(w, 0, sizeof(*w));
+}
+
+void socketPollWaiterCancel(SocketPollWaiter *w) {
+    mutexLock(&w->mutex);
+    if(w->state == SocketPollWaiterState_Polling) {
+        __atomic_store_n(&w->cancel_requested, true, __ATOMIC_RELEASE);
+        mutexUnlock(&w->mutex);
+
+        u8 byte = 0;
+        bsdSendTo(w->wake_fd, &byte, sizeof(byte), 0, (const struct sockaddr *)w->wake_addr, sizeof(struct sockaddr_in));
+
+        mutexLock(&w->mutex);
+        while(w->state == SocketPollWaiterState_Polling)
+            condvarWait(&w->cond, &w->mutex);
+    }
+    w->state = SocketPollWaiterState_Idle;
+    ueventClear(&w->event);
+    mutexUnlock(&w->mutex);
+}
+
+int socketPollWaiterArm(SocketPollWaiter *w, const struct pollfd *fds, u32 nfds) {
+    if(fds == NULL && nfds != 0) {
+        errno = EFAULT;
+        return -1;
+    }
+
+    socketPollWaiterCancel(w);
+
+    mutexLock(&w->mutex);
+    if(nfds + 1 > w->capacity && R_FAILED(_socketPollWaiterGrow(w, nfds + 1))) {
+        mutexUnlock(&w->mutex);
+        errno = ENOMEM;
+        return -1;
+    }
+
+    struct pollfd *pollfds = (struct pollfd *)w->pollfds;
+    for(u32 i = 0; i < nfds; i++) {
+        pollfds[i + 1].events = fds[i].events;
+        pollfds[i + 1].revents = 0;
+        if(fds[i].fd < 0)
+            pollfds[i + 1].fd = -1;
+        else if((pollfds[i + 1].fd = _socketGetFd(fds[i].fd)) == -1) {
+            mutexUnlock(&w->mutex);
+            return -1;
+        }
+    }
+
+    w->nfds = nfds;
+    w->state = SocketPollWaiterState_Armed;
+    condvarWakeAll(&w->cond);
+    mutexUnlock(&w->mutex);
+    return 0;
+}
+
+int socketPollWaiterGetResult(SocketPollWaiter *w, struct pollfd *fds, u32 nfds) {
+    int ret;
+
+    mutexLock(&w->mutex);
+    if(w->state != SocketPollWaiterState_Done) {
+        mutexUnlock(&w->mutex);
+        errno = EAGAIN;
+        return -1;
+    }
+
+    struct pollfd *pollfds = (struct pollfd *)w->pollfds;
+    for(u32 i = 0; i < nfds && i < w->nfds; i++)
+        fds[i].revents = pollfds[i + 1].revents;
+
+    ret = w->result;
+    if(ret == -1)
+        errno = w->error;
+
+    w->state = SocketPollWaiterState_Idle;
+    ueventClear(&w->event);
+    mutexUnlock(&w->mutex);
+    return ret;
+}
+
+ssize_t socketSendBuffer(int sockfd, const void *buf, size_t len, int flags) {
+    ssize_t ret;
+    sockfd = _socketGetFd(sockfd);
+    if(sockfd == -1)
+        return -1;
+    u64 start = _socketStatsBegin();
+    // The count can exceed INT_MAX, only the error is passed through _socketParseBsdResult.
+    ret = bsdSendLarge(sockfd, buf, len, flags);
+    if(ret == -1)
+        _socketParseBsdResult(NULL, -1);
+    _socketStatsRecord(sockfd, true, start, ret, ret == -1 && errno == EAGAIN);
+    return ret;
+}
+
+ssize_t socketSendFile(int sockfd, FsFile *file, s64 offset, size_t count, int flags) {
+    ssize_t ret;
+    if(file == NULL) {
+        errno = EFAULT;
+        return -1;
+    }
+    sockfd = _socketGetFd(sockfd);
+    if(sockfd == -1)
+        return -1;
+    u64 start = _socketStatsBegin();
+    ret = bsdSendFile(sockfd, file, offset, count, flags);
+    if(ret == -1)
+        _socketParseBsdResult(NULL, -1);
+    _socketStatsRecord(sockfd, true, start, ret, ret == -1 && errno == EAGAIN);
+    return ret;
+}
+
 int sysctl(const int *name, unsigned int namelen, void *oldp, size_t *oldlenp, const void *newp, size_t newlen) {
     return _socketParseBsdResult(NULL, bsdSysctl(name, namelen, oldp, oldlenp, newp, newlen));
 }
@@ -416,45 +1054,70 @@ int socket(int domain, int type, int protocol) {
         return -1;
     }
     else {
+        _socketStatsClear(ret);
         *(int *)__get_handle(fd)->fileStruct = ret;
         return fd;
     }
 }
 
+int socketGetBsdFd(int fd) {
+    return _socketGetFd(fd);
+}
+
+ssize_t socketBsdRecv(int bsdfd, void *buf, size_t len, int flags) {
+    u64 start = _socketStatsBegin();
+    ssize_t ret = _socketParseBsdResult(NULL, (int)bsdRecv(bsdfd, buf, len, flags));
+    _socketStatsRecord(bsdfd, false, start, ret, ret == -1 && errno == EAGAIN);
+    return ret;
+}
+
+ssize_t socketBsdRecvFrom(int bsdfd, void *buf, size_t len, int flags, struct sockaddr *src_addr, socklen_t *addrlen) {
+    u64 start = _socketStatsBegin();
+    ssize_t ret = _socketParseBsdResult(NULL, (int)bsdRecvFrom(bsdfd, buf, len, flags, src_addr, addrlen));
+    _socketStatsRecord(bsdfd, false, start, ret, ret == -1 && errno == EAGAIN);
+    return ret;
+}
+
+ssize_t socketBsdSend(int bsdfd, const void *buf, size_t len, int flags) {
+    u64 start = _socketStatsBegin();
+    ssize_t ret = _socketParseBsdResult(NULL, (int)bsdSend(bsdfd, buf, len, flags));
+    _socketStatsRecord(bsdfd, true, start, ret, ret == -1 && errno == EAGAIN);
+    return ret;
+}
+
+ssize_t socketBsdSendTo(int bsdfd, const void *buf, size_t len, int flags, const struct sockaddr *dest_addr, socklen_t addrlen) {
+    u64 start = _socketStatsBegin();
+    ssize_t ret = _socketParseBsdResult(NULL, (int)bsdSendTo(bsdfd, buf, len, flags, dest_addr, addrlen));
+    _socketStatsRecord(bsdfd, true, start, ret, ret == -1 && errno == EAGAIN);
+    return ret;
+}
+
 ssize_t recv(int sockfd, void *buf, size_t len, int flags) {
-    ssize_t ret;
     sockfd = _socketGetFd(sockfd);
     if(sockfd == -1)
         return -1;
-    ret = bsdRecv(sockfd, buf, len, flags);
-    return _socketParseBsdResult(NULL, (int)ret);
+    return socketBsdRecv(sockfd, buf, len, flags);
 }
 
 ssize_t recvfrom(int sockfd, void *buf, size_t len, int flags, struct sockaddr *src_addr, socklen_t *addrlen) {
-    ssize_t ret;
     sockfd = _socketGetFd(sockfd);
     if(sockfd == -1)
         return -1;
-    ret = bsdRecvFrom(sockfd, buf, len, flags, src_addr, addrlen);
-    return _socketParseBsdResult(NULL, (int)ret);
+    return socketBsdRecvFrom(sockfd, buf, len, flags, src_addr, addrlen);
 }
 
 ssize_t send(int sockfd, const void* buf, size_t len, int flags) {
-    ssize_t ret;
     sockfd = _socketGetFd(sockfd);
     if(sockfd == -1)
         return -1;
-    ret = bsdSend(sockfd, buf, len, flags);
-    return _socketParseBsdResult(NULL, (int)ret);
+    return socketBsdSend(sockfd, buf, len, flags);
 }
 
 ssize_t sendto(int sockfd, const void *buf, size_t len, int flags, const struct sockaddr *dest_addr, socklen_t addrlen) {
-    ssize_t ret;
     sockfd = _socketGetFd(sockfd);
     if(sockfd == -1)
         return -1;
-    ret = bsdSendTo(sockfd, buf, len, flags, dest_addr, addrlen);
-    return _socketParseBsdResult(NULL, (int)ret);
+    return socketBsdSendTo(sockfd, buf, len, flags, dest_addr, addrlen);
 }
 
 int accept(int sockfd, struct sockaddr *address, socklen_t *addrlen) {
@@ -477,6 +1140,7 @@ int accept(int sockfd, struct sockaddr *address, socklen_t *addrlen) {
         return -1;
     }
     else {
+        _socketStatsClear(ret);
         *(int *)__get_handle(fd)->fileStruct = ret;
         return fd;
     }
@@ -675,10 +1339,14 @@ ssize_t recvmsg(int sockfd, struct msghdr *msg, int flags) {
 
     struct mmsghdr msgvec = {
         .msg_hdr = *msg,
-        .msg_len = 1,
+        .msg_len = 0,
     };
 
-    return recvmmsg(sockfd, &msgvec, 1, flags, NULL);
+    if(recvmmsg(sockfd, &msgvec, 1, flags, NULL) == -1)
+        return -1;
+
+    *msg = msgvec.msg_hdr;
+    return msgvec.msg_len;
 }
 
 ssize_t sendmsg(int sockfd, const struct msghdr *msg, int flags) {
@@ -689,19 +1357,57 @@ ssize_t sendmsg(int sockfd, const struct msghdr *msg, int flags) {
 
     struct mmsghdr msgvec = {
         .msg_hdr = *msg,
-        .msg_len = 1,
+        .msg_len = 0,
     };
 
-    return sendmmsg(sockfd, &msgvec, 1, flags);
+    if(sendmmsg(sockfd, &msgvec, 1, flags) == -1)
+        return -1;
+
+    return msgvec.msg_len;
 }
 
 int sendmmsg(int sockfd, struct mmsghdr *msgvec, unsigned int vlen, int flags) {
-    //TODO: do the necessary RE & implement it
-    errno = ENOSYS;
-    return -1;
+    int ret;
+    if(msgvec == NULL && vlen != 0) {
+        errno = EFAULT;
+        return -1;
+    }
+    sockfd = _socketGetFd(sockfd);
+    if(sockfd == -1)
+        return -1;
+    u64 start = _socketStatsBegin();
+    ret = _socketParseBsdResult(NULL, bsdSendMMsg(sockfd, msgvec, vlen, flags));
+    if(start) {
+        ssize_t bytes = ret;
+        if(ret > 0) {
+            bytes = 0;
+            for(int i = 0; i < ret; i++)
+                bytes += msgvec[i].msg_len;
+        }
+        _socketStatsRecord(sockfd, true, start, bytes, ret == -1 && errno == EAGAIN);
+    }
+    return ret;
 }
+
 int recvmmsg(int sockfd, struct mmsghdr *msgvec, unsigned int vlen, int flags, struct timespec *timeout) {
-    //TODO: do the necessary RE & implement it
-    errno = ENOSYS;
-    return -1;
+    int ret;
+    if(msgvec == NULL && vlen != 0) {
+        errno = EFAULT;
+        return -1;
+    }
+    sockfd = _socketGetFd(sockfd);
+    if(sockfd == -1)
+        return -1;
+    u64 start = _socketStatsBegin();
+    ret = _socketParseBsdResult(NULL, bsdRecvMMsg(sockfd, msgvec, vlen, flags, timeout));
+    if(start) {
+        ssize_t bytes = ret;
+        if(ret > 0) {
+            bytes = 0;
+            for(int i = 0; i < ret; i++)
+                bytes += msgvec[i].msg_len;
+        }
+        _socketStatsRecord(sockfd, false, start, bytes, ret == -1 && errno == EAGAIN);
+    }
+    return ret;
 }
@@ -2,6 +2,7 @@
 #include <malloc.h>
 #include "types.h"
 #include "result.h"
+#include "arm/counter.h"
 #include "kernel/rwlock.h"
 #include "services/fatal.h"
 #include "services/usbds.h"
@@ -10,6 +11,21 @@
 
 #define TOTAL_INTERFACES 4
 
+typedef struct {
+    u32 urbId;
+    void* buffer;
+    u32 size;
+    UsbCommsTransferCallback cb;
+    void* userdata;
+} usbCommsUrb;
+
+// Per-endpoint state: the asynchronous transfers in flight, oldest first, and the statistics.
+typedef struct {
+    usbCommsUrb urbs[USB_COMMS_MAX_URBS];
+    u32 head, count;
+    UsbCommsEndpointStats stats;
+} usbCommsUrbQueue;
+
 typedef struct {
     RwLock lock, lock_in, lock_out;
     bool initialized;
@@ -18,6 +34,8 @@ typedef struct {
     UsbDsEndpoint *endpoint_in, *endpoint_out;
 
     u8 *endpoint_in_buffer, *endpoint_out_buffer;
+
+    usbCommsUrbQueue queue_in, queue_out;
 } usbCommsInterface;
 
 static bool g_usbCommsInitialized = false;
@@ -34,6 +52,17 @@ static Result _usbCommsInterfaceInit(u32 intf_ind, const UsbCommsInterfaceInfo *
 
 static Result _usbCommsWrite(usbCommsInterface *interface, const void* buffer, size_t size, size_t *transferredSize);
 
+static Result _usbCommsAllocBuffers(usbCommsInterface *interface) {
+    //The buffer for PostBufferAsync commands must be 0x1000-byte aligned. Only the unaligned head of a transfer is staged, so one page is enough.
+    interface->endpoint_in_buffer = memalign(0x1000, 0x1000);
+    if (interface->endpoint_in_buffer==NULL) return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+
+    interface->endpoint_out_buffer = memalign(0x1000, 0x1000);
+    if (interface->endpoint_out_buffer==NULL) return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+
+    return 0;
+}
+
 static void _usbCommsUpdateInterfaceDescriptor(struct usb_interface_descriptor *desc, const UsbCommsInterfaceInfo *info) {
     if (info != NULL) {
         desc->bInterfaceClass = info->bInterfaceClass;
@@ -177,6 +206,10 @@ static void _usbCommsInterfaceFree(usbCommsInterface *interface)
     interface->endpoint_out = NULL;
     interface->interface = NULL;
 
+    interface->queue_in.count = interface->queue_out.count = 0;
+    memset(&interface->queue_in.stats, 0, sizeof(UsbCommsEndpointStats));
+    memset(&interface->queue_out.stats, 0, sizeof(UsbCommsEndpointStats));
+
     free(interface->endpoint_in_buffer);
     free(interface->endpoint_out_buffer);
     interface->endpoint_in_buffer = NULL;
@@ -257,20 +290,7 @@ static Result _usbCommsInterfaceInit5x(u32 intf_ind, const UsbCommsInterfaceInfo
 
     interface->initialized = 1;
 
-    //The buffer for PostBufferAsync commands must be 0x1000-byte aligned.
-    interface->endpoint_in_buffer = memalign(0x1000, 0x1000);
-    if (interface->endpoint_in_buffer==NULL) rc = MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
-
-    if (R_SUCCEEDED(rc)) {
-        interface->endpoint_out_buffer = memalign(0x1000, 0x1000);
-        if (interface->endpoint_out_buffer==NULL) rc = MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
-    }
-
-    if (R_SUCCEEDED(rc)) {
-        memset(interface->endpoint_in_buffer, 0, 0x1000);
-        memset(interface->endpoint_out_buffer, 0, 0x1000);
-    }
-
+    rc = _usbCommsAllocBuffers(interface);
     if (R_FAILED(rc)) return rc;
 
     rc = usbDsRegisterInterface(&interface->interface);
@@ -359,20 +379,7 @@ static Result _usbCommsInterfaceInit1x(u32 intf_ind, const UsbCommsInterfaceInfo
 
     interface->initialized = 1;
 
-    //The buffer for PostBufferAsync commands must be 0x1000-byte aligned.
-    interface->endpoint_in_buffer = memalign(0x1000, 0x1000);
-    if (interface->endpoint_in_buffer==NULL) rc = MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
-
-    if (R_SUCCEEDED(rc)) {
-        interface->endpoint_out_buffer = memalign(0x1000, 0x1000);
-        if (interface->endpoint_out_buffer==NULL) rc = MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
-    }
-
-    if (R_SUCCEEDED(rc)) {
-        memset(interface->endpoint_in_buffer, 0, 0x1000);
-        memset(interface->endpoint_out_buffer, 0, 0x1000);
-    }
-
+    rc = _usbCommsAllocBuffers(interface);
     if (R_FAILED(rc)) return rc;
 
     //Setup interface.
@@ -396,6 +403,122 @@ void usbCommsSetErrorHandling(bool flag) {
     g_usbCommsErrorHandling = flag;
 }
 
+static void _usbCommsStatsUrb(UsbCommsEndpointStats *stats, u32 bytes, bool bounce)
+{
+    __atomic_add_fetch(&stats->urb_count, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&stats->bytes, bytes, __ATOMIC_RELAXED);
+    if (bounce) {
+        __atomic_add_fetch(&stats->bounce_count, 1, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&stats->bounce_bytes, bytes, __ATOMIC_RELAXED);
+    }
+}
+
+static Result _usbCommsWaitCompletion(UsbDsEndpoint *endpoint, UsbCommsEndpointStats *stats, u64 timeout)
+{
+    u64 tick = armGetSystemTick();
+    Result rc = eventWait(&endpoint->CompletionEvent, timeout);
+    __atomic_add_fetch(&stats->wait_ns, armTicksToNs(armGetSystemTick() - tick), __ATOMIC_RELAXED);
+    return rc;
+}
+
+// Calls the callbacks of the finished transfers in the queue, waiting for one if none did. The endpoint lock must be held.
+static Result _usbCommsReap(UsbDsEndpoint *endpoint, usbCommsUrbQueue *queue, u64 timeout, u32 *out_count)
+{
+    Result rc=0;
+    u32 done=0;
+    UsbDsReportData reportdata;
+
+    while (queue->count)
+    {
+        rc = usbDsEndpoint_GetReportData(endpoint, &reportdata);
+        if (R_FAILED(rc)) break;
+
+        u32 report_count = reportdata.report_count < 8 ? reportdata.report_count : 8;
+        while (queue->count)
+        {
+            usbCommsUrb urb = queue->urbs[queue->head];
+            u32 pos;
+
+            // Bulk transfers finish in order, stop at the first one which is still in flight.
+            for (pos=0; pos<report_count; pos++) {
+                if (reportdata.report[pos].id == urb.urbId) break;
+            }
+            if (pos == report_count) break;
+            u32 urb_status = reportdata.report[pos].urb_status;
+            if (urb_status < 0x3 || urb_status > 0x5) break;
+
+            u32 tmp_transferredSize = 0;
+            Result urb_rc = usbDsParseReportData(&reportdata, urb.urbId, NULL, &tmp_transferredSize);
+            if (tmp_transferredSize > urb.size) tmp_transferredSize = urb.size;
+
+            queue->head = (queue->head + 1) % USB_COMMS_MAX_URBS;
+            queue->count--;
+            done++;
+            _usbCommsStatsUrb(&queue->stats, tmp_transferredSize, false);
+
+            if (urb.cb) urb.cb(urb.userdata, urb_rc, urb.buffer, tmp_transferredSize);
+        }
+
+        if (done || !timeout) break;
+
+        rc = _usbCommsWaitCompletion(endpoint, &queue->stats, timeout);
+        if (R_FAILED(rc)) break;
+        eventClear(&endpoint->CompletionEvent);
+    }
+
+    if (out_count) *out_count = done;
+
+    if (R_SUCCEEDED(rc) && !done && queue->count) rc = KERNELRESULT(TimedOut);
+    return rc;
+}
+
+static Result _usbCommsFlush(UsbDsEndpoint *endpoint, usbCommsUrbQueue *queue)
+{
+    Result rc=0;
+
+    while (queue->count && R_SUCCEEDED(rc))
+        rc = _usbCommsReap(endpoint, queue, U64_MAX, NULL);
+
+    return rc;
+}
+
+static Result _usbCommsPostAsync(UsbDsEndpoint *endpoint, usbCommsUrbQueue *queue, void* buffer, size_t size, UsbCommsTransferCallback cb, void* userdata)
+{
+    Result rc=0;
+
+    if (((u64)buffer) & 0xfff || size > UINT32_MAX) return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    if (!queue->count) {
+        //Makes sure endpoints are ready for data-transfer / wait for init if needed.
+        rc = usbDsWaitReady(U64_MAX);
+        if (R_FAILED(rc)) return rc;
+    }
+
+    while (queue->count == USB_COMMS_MAX_URBS) {
+        rc = _usbCommsReap(endpoint, queue, U64_MAX, NULL);
+        if (R_FAILED(rc)) return rc;
+    }
+
+    usbCommsUrb *urb = &queue->urbs[(queue->head + queue->count) % USB_COMMS_MAX_URBS];
+    rc = usbDsEndpoint_PostBufferAsync(endpoint, buffer, size, &urb->urbId);
+    if (R_FAILED(rc)) return rc;
+
+    urb->buffer = buffer;
+    urb->size = size;
+    urb->cb = cb;
+    urb->userdata = userdata;
+    queue->count++;
+
+    return rc;
+}
+
+// Size of the transfer through the staging buffer for an unaligned bufptr: only the head up to the next page boundary, so that the aligned rest is transferred directly.
+static u32 _usbCommsStagingChunkSize(const u8 *bufptr, size_t size)
+{
+    size_t head = 0x1000 - (((u64)bufptr) & 0xfff);
+    return size < head ? size : head;
+}
+
 static Result _usbCommsRead(usbCommsInterface *interface, void* buffer, size_t size, size_t *transferredSize)
 {
     Result rc=0;
@@ -408,20 +531,20 @@ static Result _usbCommsRead(usbCommsInterface *interface, void* buffer, size_t s
     size_t total_transferredSize=0;
     UsbDsReportData reportdata;
 
+    //The completion event and report data are shared with the asynchronous transfers.
+    rc = _usbCommsFlush(interface->endpoint_out, &interface->queue_out);
+    if (R_FAILED(rc)) return rc;
+
     //Makes sure endpoints are ready for data-transfer / wait for init if needed.
     rc = usbDsWaitReady(U64_MAX);
     if (R_FAILED(rc)) return rc;
 
     while(size)
     {
-        if(((u64)bufptr) & 0xfff)//When bufptr isn't page-aligned copy the data into g_usbComms_endpoint_in_buffer and transfer that, otherwise use the bufptr directly.
+        if(((u64)bufptr) & 0xfff)//When bufptr isn't page-aligned transfer into endpoint_out_buffer and copy the data from there, otherwise use the bufptr directly.
         {
             transfer_buffer = interface->endpoint_out_buffer;
-            memset(interface->endpoint_out_buffer, 0, 0x1000);
-
-            chunksize = 0x1000;
-            chunksize-= ((u64)bufptr) & 0xfff;//After this transfer, bufptr will be page-aligned(if size is large enough for another transfer).
-            if (size<chunksize) chunksize = size;
+            chunksize = _usbCommsStagingChunkSize(bufptr, size);
 
             transfer_type = 0;
         }
@@ -438,7 +561,7 @@ static Result _usbCommsRead(usbCommsInterface *interface, void* buffer, size_t s
         if (R_FAILED(rc)) return rc;
 
         //Wait for the transfer to finish.
-        eventWait(&interface->endpoint_out->CompletionEvent, U64_MAX);
+        _usbCommsWaitCompletion(interface->endpoint_out, &interface->queue_out.stats, U64_MAX);
         eventClear(&interface->endpoint_out->CompletionEvent);
 
         rc = usbDsEndpoint_GetReportData(interface->endpoint_out, &reportdata);
@@ -449,6 +572,7 @@ static Result _usbCommsRead(usbCommsInterface *interface, void* buffer, size_t s
 
         if (tmp_transferredSize > chunksize) tmp_transferredSize = chunksize;
         total_transferredSize+= (size_t)tmp_transferredSize;
+        _usbCommsStatsUrb(&interface->queue_out.stats, tmp_transferredSize, transfer_type==0);
 
         if (transfer_type==0) memcpy(bufptr, transfer_buffer, tmp_transferredSize);
         bufptr+= tmp_transferredSize;
@@ -473,20 +597,20 @@ static Result _usbCommsWrite(usbCommsInterface *interface, const void* buffer, s
     size_t total_transferredSize=0;
     UsbDsReportData reportdata;
 
+    //The completion event and report data are shared with the asynchronous transfers.
+    rc = _usbCommsFlush(interface->endpoint_in, &interface->queue_in);
+    if (R_FAILED(rc)) return rc;
+
     //Makes sure endpoints are ready for data-transfer / wait for init if needed.
     rc = usbDsWaitReady(U64_MAX);
     if (R_FAILED(rc)) return rc;
 
     while(size)
     {
-        if(((u64)bufptr) & 0xfff)//When bufptr isn't page-aligned copy the data into g_usbComms_endpoint_in_buffer and transfer that, otherwise use the bufptr directly.
+        if(((u64)bufptr) & 0xfff)//When bufptr isn't page-aligned copy the data into endpoint_in_buffer and transfer that, otherwise use the bufptr directly.
         {
             transfer_buffer = interface->endpoint_in_buffer;
-            memset(interface->endpoint_in_buffer, 0, 0x1000);
-
-            chunksize = 0x1000;
-            chunksize-= ((u64)bufptr) & 0xfff;//After this transfer, bufptr will be page-aligned(if size is large enough for another transfer).
-            if (size<chunksize) chunksize = size;
+            chunksize = _usbCommsStagingChunkSize(bufptr, size);
 
             memcpy(interface->endpoint_in_buffer, bufptr, chunksize);
         }
@@ -501,7 +625,7 @@ static Result _usbCommsWrite(usbCommsInterface *interface, const void* buffer, s
         if(R_FAILED(rc))return rc;
 
         //Wait for the transfer to finish.
-        eventWait(&interface->endpoint_in->CompletionEvent, U64_MAX);
+        _usbCommsWaitCompletion(interface->endpoint_in, &interface->queue_in.stats, U64_MAX);
         eventClear(&interface->endpoint_in->CompletionEvent);
 
         rc = usbDsEndpoint_GetReportData(interface->endpoint_in, &reportdata);
@@ -513,6 +637,7 @@ static Result _usbCommsWrite(usbCommsInterface *interface, const void* buffer, s
         if (tmp_transferredSize > chunksize) tmp_transferredSize = chunksize;
 
         total_transferredSize+= (size_t)tmp_transferredSize;
+        _usbCommsStatsUrb(&interface->queue_in.stats, tmp_transferredSize, transfer_buffer!=bufptr);
 
         bufptr+= tmp_transferredSize;
         size-= tmp_transferredSize;
@@ -599,3 +724,209 @@ size_t usbCommsWrite(const void* buffer, size_t size)
     return usbCommsWriteEx(buffer, size, 0);
 }
 
+// Locks the endpoint of an initialized interface, returns NULL otherwise.
+static usbCommsInterface* _usbCommsLockEndpoint(u32 interface, bool write)
+{
+    if (interface>=TOTAL_INTERFACES) return NULL;
+
+    usbCommsInterface *inter = &g_usbCommsInterfaces[interface];
+    RwLock *lock = write ? &inter->lock_in : &inter->lock_out;
+
+    rwlockReadLock(&inter->lock);
+    rwlockWriteLock(lock);
+    if (!inter->initialized) {
+        rwlockWriteUnlock(lock);
+        rwlockReadUnlock(&inter->lock);
+        return NULL;
+    }
+    return inter;
+}
+
+static void _usbCommsUnlockEndpoint(usbCommsInterface *inter, bool write)
+{
+    rwlockWriteUnlock(write ? &inter->lock_in : &inter->lock_out);
+    rwlockReadUnlock(&inter->lock);
+}
+
+Result usbCommsPostReadAsync(u32 interface, void* buffer, size_t size, UsbCommsTransferCallback cb, void* userdata)
+{
+    usbCommsInterface *inter = _usbCommsLockEndpoint(interface, false);
+    if (!inter) return MAKERESULT(Module_Libnx, LibnxError_NotInitialized);
+
+    Result rc = _usbCommsPostAsync(inter->endpoint_out, &inter->queue_out, buffer, size, cb, userdata);
+    _usbCommsUnlockEndpoint(inter, false);
+    return rc;
+}
+
+Result usbCommsPostWriteAsync(u32 interface, const void* buffer, size_t size, UsbCommsTransferCallback cb, void* userdata)
+{
+    usbCommsInterface *inter = _usbCommsLockEndpoint(interface, true);
+    if (!inter) return MAKERESULT(Module_Libnx, LibnxError_NotInitialized);
+
+    Result rc = _usbCommsPostAsync(inter->endpoint_in, &inter->queue_in, (void*)buffer, size, cb, userdata);
+    _usbCommsUnlockEndpoint(inter, true);
+    return rc;
+}
+
+Result usbCommsProcessCompletions(u32 interface, bool write, u64 timeout, u32* out_count)
+{
+    if (out_count) *out_count = 0;
+
+    usbCommsInterface *inter = _usbCommsLockEndpoint(interface, write);
+    if (!inter) return MAKERESULT(Module_Libnx, LibnxError_NotInitialized);
+
+    Result rc;
+    if (write)
+        rc = _usbCommsReap(inter->endpoint_in, &inter->queue_in, timeout, out_count);
+    else
+        rc = _usbCommsReap(inter->endpoint_out, &inter->queue_out, timeout, out_count);
+    _usbCommsUnlockEndpoint(inter, write);
+    return rc;
+}
+
+u32 usbCommsGetPendingCount(u32 interface, bool write)
+{
+    usbCommsInterface *inter = _usbCommsLockEndpoint(interface, write);
+    if (!inter) return 0;
+
+    u32 count = write ? inter->queue_in.count : inter->queue_out.count;
+    _usbCommsUnlockEndpoint(inter, write);
+    return count;
+}
+
+Result usbCommsFlush(u32 interface, bool write)
+{
+    usbCommsInterface *inter = _usbCommsLockEndpoint(interface, write);
+    if (!inter) return MAKERESULT(Module_Libnx, LibnxError_NotInitialized);
+
+    Result rc;
+    if (write)
+        rc = _usbCommsFlush(inter->endpoint_in, &inter->queue_in);
+    else
+        rc = _usbCommsFlush(inter->endpoint_out, &inter->queue_out);
+    _usbCommsUnlockEndpoint(inter, write);
+    return rc;
+}
+
+static void _usbCommsCopyStats(UsbCommsEndpointStats *out, UsbCommsEndpointStats *stats)
+{
+    out->bytes        = __atomic_load_n(&stats->bytes, __ATOMIC_RELAXED);
+    out->urb_count    = __atomic_load_n(&stats->urb_count, __ATOMIC_RELAXED);
+    out->wait_ns      = __atomic_load_n(&stats->wait_ns, __ATOMIC_RELAXED);
+    out->bounce_count = __atomic_load_n(&stats->bounce_count, __ATOMIC_RELAXED);
+    out->bounce_bytes = __atomic_load_n(&stats->bounce_bytes, __ATOMIC_RELAXED);
+}
+
+static void _usbCommsClearStats(UsbCommsEndpointStats *stats)
+{
+    __atomic_store_n(&stats->bytes, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&stats->urb_count, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&stats->wait_ns, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&stats->bounce_count, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&stats->bounce_bytes, 0, __ATOMIC_RELAXED);
+}
+
+static void _usbCommsSubStats(UsbCommsEndpointStats *stats, const UsbCommsEndpointStats *start)
+{
+    stats->bytes        -= start->bytes;
+    stats->urb_count    -= start->urb_count;
+    stats->wait_ns      -= start->wait_ns;
+    stats->bounce_count -= start->bounce_count;
+    stats->bounce_bytes -= start->bounce_bytes;
+}
+
+Result usbCommsGetStats(u32 interface, UsbCommsStats *out)
+{
+    if (interface>=TOTAL_INTERFACES) return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    usbCommsInterface *inter = &g_usbCommsInterfaces[interface];
+    Result rc = 0;
+
+    rwlockReadLock(&inter->lock);
+    if (inter->initialized) {
+        _usbCommsCopyStats(&out->read, &inter->queue_out.stats);
+        _usbCommsCopyStats(&out->write, &inter->queue_in.stats);
+    }
+    else
+        rc = MAKERESULT(Module_Libnx, LibnxError_NotInitialized);
+    rwlockReadUnlock(&inter->lock);
+
+    return rc;
+}
+
+Result usbCommsResetStats(u32 interface)
+{
+    if (interface>=TOTAL_INTERFACES) return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    usbCommsInterface *inter = &g_usbCommsInterfaces[interface];
+    Result rc = 0;
+
+    rwlockReadLock(&inter->lock);
+    if (inter->initialized) {
+        _usbCommsClearStats(&inter->queue_out.stats);
+        _usbCommsClearStats(&inter->queue_in.stats);
+    }
+    else
+        rc = MAKERESULT(Module_Libnx, LibnxError_NotInitialized);
+    rwlockReadUnlock(&inter->lock);
+
+    return rc;
+}
+
+Result usbCommsBenchmark(u32 interface, const size_t *sizes, u32 num_sizes, u32 iterations, bool unaligned, UsbCommsBenchmarkResult *out)
+{
+    size_t max_size = 0;
+    Result rc = 0;
+
+    for (u32 i=0; i<num_sizes; i++) {
+        if (sizes[i] > max_size) max_size = sizes[i];
+    }
+    if (!max_size || !iterations) return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    u8 *buffer = (u8*)memalign(0x1000, max_size + 0x1000);
+    if (buffer==NULL) return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+    u8 *bufptr = buffer + (unaligned ? 0x10 : 0);
+
+    for (u32 i=0; i<num_sizes && R_SUCCEEDED(rc); i++) {
+        UsbCommsBenchmarkResult *res = &out[i];
+        UsbCommsStats start;
+
+        memset(res, 0, sizeof(*res));
+        res->size = sizes[i];
+        for (size_t pos=0; pos<sizes[i]; pos++) bufptr[pos] = pos + i;
+
+        rc = usbCommsGetStats(interface, &start);
+        if (R_FAILED(rc)) break;
+
+        for (u32 it=0; it<iterations; it++) {
+            size_t transferred;
+            u64 tick = armGetSystemTick();
+
+            //The host is expected to send back everything it receives.
+            transferred = usbCommsWriteEx(bufptr, sizes[i], interface);
+            res->write_ns += armTicksToNs(armGetSystemTick() - tick);
+            res->bytes_written += transferred;
+            if (transferred != sizes[i]) {
+                rc = MAKERESULT(Module_Libnx, LibnxError_BadUsbCommsWrite);
+                break;
+            }
+
+            tick = armGetSystemTick();
+            transferred = usbCommsReadEx(bufptr, sizes[i], interface);
+            res->read_ns += armTicksToNs(armGetSystemTick() - tick);
+            res->bytes_read += transferred;
+            if (transferred != sizes[i]) {
+                rc = MAKERESULT(Module_Libnx, LibnxError_BadUsbCommsRead);
+                break;
+            }
+        }
+
+        if (R_SUCCEEDED(usbCommsGetStats(interface, &res->stats))) {
+            _usbCommsSubStats(&res->stats.read, &start.read);
+            _usbCommsSubStats(&res->stats.write, &start.write);
+        }
+    }
+
+    free(buffer);
+    return rc;
+}
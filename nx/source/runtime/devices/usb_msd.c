@@ -0,0 +1,731 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <malloc.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/iosupport.h>
+#include <sys/param.h>
+#include "types.h"
+#include "result.h"
+#include "arm/counter.h"
+#include "kernel/svc.h"
+#include "runtime/devices/usb_msd.h"
+
+#define USB_MSD_DEFAULT_CACHE_BLOCKS 32
+#define USB_MSD_DEFAULT_READAHEAD_BLOCKS 8
+#define USB_MSD_DEFAULT_READY_TIMEOUT_NS 5000000000ULL
+#define USB_MSD_MAX_MOUNTS 4
+
+#define USB_MSD_CBW_SIGNATURE 0x43425355
+#define USB_MSD_CSW_SIGNATURE 0x53425355
+
+#define SCSI_TEST_UNIT_READY 0x00
+#define SCSI_REQUEST_SENSE 0x03
+#define SCSI_MODE_SENSE_6 0x1A
+#define SCSI_READ_CAPACITY_10 0x25
+#define SCSI_READ_10 0x28
+#define SCSI_WRITE_10 0x2A
+#define SCSI_SYNCHRONIZE_CACHE_10 0x35
+#define SCSI_READ_16 0x88
+#define SCSI_WRITE_16 0x8A
+#define SCSI_SERVICE_ACTION_IN_16 0x9E
+
+typedef struct {
+    u32 signature;
+    u32 tag;
+    u32 data_length;
+    u8 flags;
+    u8 lun;
+    u8 cb_length;
+    u8 cb[16];
+} PACKED UsbMsdCbw;
+
+typedef struct {
+    u32 signature;
+    u32 tag;
+    u32 residue;
+    u8 status;
+} PACKED UsbMsdCsw;
+
+static inline void _usbMsdPutBe32(u8* p, u32 v) {
+    p[0] = v >> 24; p[1] = v >> 16; p[2] = v >> 8; p[3] = v;
+}
+
+static inline u32 _usbMsdGetBe32(const u8* p) {
+    return ((u32)p[0] << 24) | ((u32)p[1] << 16) | ((u32)p[2] << 8) | p[3];
+}
+
+static Result _usbMsdClearHalt(UsbMsdDevice* d, UsbHsClientEpSession* ep) {
+    u32 transferred;
+    // Host-to-device, standard, endpoint recipient. The feature selector is ENDPOINT_HALT (0).
+    return usbHsIfCtrlXfer(&d->if_session, 0x02, USB_REQUEST_CLEAR_FEATURE, 0, ep->desc.bEndpointAddress, 0, d->cmd_buffer + 0x1000, &transferred);
+}
+
+// Bulk-Only Mass Storage Reset, followed by clearing the halts of both endpoints.
+static void _usbMsdResetRecovery(UsbMsdDevice* d) {
+    u32 transferred;
+    // Host-to-device, class, interface recipient.
+    usbHsIfCtrlXfer(&d->if_session, 0x21, 0xFF, 0, d->if_session.inf.inf.interface_desc.bInterfaceNumber, 0, d->cmd_buffer + 0x1000, &transferred);
+    _usbMsdClearHalt(d, &d->ep_in);
+    _usbMsdClearHalt(d, &d->ep_out);
+}
+
+// Runs a SCSI command. The data buffer must be 0x1000-byte aligned. The command fails when the device reports that less than min_size bytes of data were transferred.
+static Result _usbMsdCommand(UsbMsdDevice* d, const u8* cb, u8 cb_length, void* data, u32 size, u32 min_size, bool dir_in) {
+    UsbMsdCbw* cbw = (UsbMsdCbw*)d->cmd_buffer;
+    UsbMsdCsw* csw = (UsbMsdCsw*)d->cmd_buffer;
+    u32 tag = ++d->tag;
+    u32 transferred = 0;
+
+    memset(cbw, 0, sizeof(*cbw));
+    cbw->signature = USB_MSD_CBW_SIGNATURE;
+    cbw->tag = tag;
+    cbw->data_length = size;
+    cbw->flags = dir_in ? 0x80 : 0x00;
+    cbw->lun = d->lun;
+    cbw->cb_length = cb_length;
+    memcpy(cbw->cb, cb, cb_length);
+
+    Result rc = usbHsEpPostBuffer(&d->ep_out, cbw, sizeof(*cbw), &transferred);
+    if (R_FAILED(rc) || transferred != sizeof(*cbw)) {
+        _usbMsdResetRecovery(d);
+        return R_FAILED(rc) ? rc : MAKERESULT(Module_Libnx, LibnxError_IoError);
+    }
+
+    if (size) {
+        UsbHsClientEpSession* ep = dir_in ? &d->ep_in : &d->ep_out;
+        // A stalled data phase is still followed by the status.
+        if (R_FAILED(usbHsEpPostBuffer(ep, data, size, &transferred)))
+            _usbMsdClearHalt(d, ep);
+    }
+
+    memset(csw, 0, sizeof(*csw));
+    rc = usbHsEpPostBuffer(&d->ep_in, csw, sizeof(*csw), &transferred);
+    if (R_FAILED(rc)) {
+        _usbMsdClearHalt(d, &d->ep_in);
+        rc = usbHsEpPostBuffer(&d->ep_in, csw, sizeof(*csw), &transferred);
+    }
+
+    if (R_FAILED(rc) || transferred != sizeof(*csw) || csw->signature != USB_MSD_CSW_SIGNATURE || csw->tag != tag || csw->status >= 2) {
+        _usbMsdResetRecovery(d);
+        return R_FAILED(rc) ? rc : MAKERESULT(Module_Libnx, LibnxError_IoError);
+    }
+
+    if (csw->status != 0)
+        return MAKERESULT(Module_Libnx, LibnxError_IoError);
+
+    // The residue is the part of the data the device didn't read or write, e.g. a short read at the end of the medium.
+    if (csw->residue > size - min_size)
+        return MAKERESULT(Module_Libnx, LibnxError_IoError);
+
+    return 0;
+}
+
+static Result _usbMsdRequestSense(UsbMsdDevice* d) {
+    const u8 cb[6] = { SCSI_REQUEST_SENSE, 0, 0, 0, 18, 0 };
+    return _usbMsdCommand(d, cb, sizeof(cb), d->cmd_buffer + 0x1000, 18, 0, true);
+}
+
+static Result _usbMsdWaitReady(UsbMsdDevice* d, u64 timeout) {
+    const u8 cb[6] = { SCSI_TEST_UNIT_READY };
+    u64 start = armGetSystemTick();
+    Result rc;
+
+    // The unit reports "not ready" or "medium changed" conditions until it spun up, which the sense data clears.
+    while (R_FAILED(rc = _usbMsdCommand(d, cb, sizeof(cb), NULL, 0, 0, false))) {
+        _usbMsdRequestSense(d);
+        if (armTicksToNs(armGetSystemTick() - start) >= timeout)
+            break;
+        svcSleepThread(100000000ULL);
+    }
+
+    return rc;
+}
+
+static Result _usbMsdReadCapacity(UsbMsdDevice* d) {
+    u8* buf = d->cmd_buffer + 0x1000;
+    u8 cb[16] = { SCSI_READ_CAPACITY_10 };
+
+    Result rc = _usbMsdCommand(d, cb, 10, buf, 8, 8, true);
+    if (R_FAILED(rc))
+        return rc;
+
+    u64 last_lba = _usbMsdGetBe32(buf);
+    d->sector_size = _usbMsdGetBe32(buf + 4);
+
+    if (last_lba == 0xFFFFFFFF) {
+        // Over 2TiB, use READ CAPACITY(16).
+        memset(cb, 0, sizeof(cb));
+        cb[0] = SCSI_SERVICE_ACTION_IN_16;
+        cb[1] = 0x10;
+        cb[13] = 32;
+        rc = _usbMsdCommand(d, cb, 16, buf, 32, 12, true);
+        if (R_FAILED(rc))
+            return rc;
+
+        last_lba = ((u64)_usbMsdGetBe32(buf) << 32) | _usbMsdGetBe32(buf + 4);
+        d->sector_size = _usbMsdGetBe32(buf + 8);
+    }
+
+    d->num_sectors = last_lba + 1;
+
+    // The cache blocks must hold whole sectors.
+    if (!d->sector_size || (d->sector_size & (d->sector_size - 1)) || d->sector_size > USB_MSD_CACHE_BLOCK_SIZE)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    // Write protect bit of the mode parameter header, this command is optional.
+    const u8 mode_cb[6] = { SCSI_MODE_SENSE_6, 0, 0x3F, 0, 192, 0 };
+    memset(buf, 0, 192);
+    if (R_SUCCEEDED(_usbMsdCommand(d, mode_cb, sizeof(mode_cb), buf, 192, 4, true)))
+        d->read_only = (buf[2] & 0x80) != 0;
+
+    return 0;
+}
+
+static Result _usbMsdRwCommand(UsbMsdDevice* d, bool write, u64 sector, u32 count, void* buffer) {
+    u8 cb[16] = {0};
+    u8 cb_length;
+
+    if (sector + count > 0x100000000ULL || count > 0xFFFF) {
+        cb[0] = write ? SCSI_WRITE_16 : SCSI_READ_16;
+        _usbMsdPutBe32(cb + 2, sector >> 32);
+        _usbMsdPutBe32(cb + 6, sector);
+        _usbMsdPutBe32(cb + 10, count);
+        cb_length = 16;
+    }
+    else {
+        cb[0] = write ? SCSI_WRITE_10 : SCSI_READ_10;
+        _usbMsdPutBe32(cb + 2, sector);
+        cb[7] = count >> 8;
+        cb[8] = count;
+        cb_length = 10;
+    }
+
+    return _usbMsdCommand(d, cb, cb_length, buffer, count * d->sector_size, count * d->sector_size, !write);
+}
+
+// Transfers sectors with as few commands as possible, directly from/to the buffer when it's page-aligned. The mutex must be held.
+static Result _usbMsdTransferSectors(UsbMsdDevice* d, bool write, u64 sector, u64 count, u8* buffer) {
+    if (sector >= d->num_sectors || count > d->num_sectors - sector)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+    if (write && d->read_only)
+        return MAKERESULT(Module_Libnx, LibnxError_IoError);
+
+    bool direct = !((uintptr_t)buffer & 0xFFF);
+    u32 max_count = USB_MSD_MAX_XFER_SIZE / d->sector_size;
+
+    while (count) {
+        u32 chunk = count < max_count ? count : max_count;
+        size_t size = (size_t)chunk * d->sector_size;
+        u8* xfer = direct ? buffer : d->xfer_buffer;
+
+        if (write && !direct)
+            memcpy(xfer, buffer, size);
+
+        Result rc = _usbMsdRwCommand(d, write, sector, chunk, xfer);
+        if (R_FAILED(rc))
+            return rc;
+
+        if (!write && !direct)
+            memcpy(buffer, xfer, size);
+
+        sector += chunk;
+        count -= chunk;
+        buffer += size;
+    }
+
+    return 0;
+}
+
+static inline u8* _usbMsdCacheData(UsbMsdDevice* d, UsbMsdCacheBlock* c) {
+    return d->cache_data + (size_t)(c - d->cache) * USB_MSD_CACHE_BLOCK_SIZE;
+}
+
+static UsbMsdCacheBlock* _usbMsdCacheFind(UsbMsdDevice* d, u64 block) {
+    for (u32 i = 0; i < d->cache_blocks; i++) {
+        if (d->cache[i].block == block)
+            return &d->cache[i];
+    }
+    return NULL;
+}
+
+static UsbMsdCacheBlock* _usbMsdCacheEvict(UsbMsdDevice* d) {
+    UsbMsdCacheBlock* lru = &d->cache[0];
+    for (u32 i = 1; i < d->cache_blocks; i++) {
+        if (d->cache[i].last_use < lru->last_use)
+            lru = &d->cache[i];
+    }
+    lru->block = UINT64_MAX;
+    return lru;
+}
+
+static inline u64 _usbMsdNumBlocks(UsbMsdDevice* d) {
+    return (usbMsdGetSize(d) + USB_MSD_CACHE_BLOCK_SIZE - 1) / USB_MSD_CACHE_BLOCK_SIZE;
+}
+
+// Loads a block into the cache, reading ahead the following ones on sequential misses.
+static Result _usbMsdCacheLoad(UsbMsdDevice* d, u64 block, UsbMsdCacheBlock** out) {
+    u32 sectors_per_block = USB_MSD_CACHE_BLOCK_SIZE / d->sector_size;
+    u64 num_blocks = _usbMsdNumBlocks(d);
+    u32 count = 1;
+
+    if (block == d->next_block) {
+        while (count < d->readahead_blocks && block + count < num_blocks && !_usbMsdCacheFind(d, block + count))
+            count++;
+    }
+
+    // The last block can be partial.
+    u64 sector = block * sectors_per_block;
+    u64 num_sectors = (u64)count * sectors_per_block;
+    if (num_sectors > d->num_sectors - sector)
+        num_sectors = d->num_sectors - sector;
+
+    Result rc = _usbMsdTransferSectors(d, false, sector, num_sectors, d->xfer_buffer);
+    if (R_FAILED(rc))
+        return rc;
+
+    d->next_block = block + count;
+
+    u64 base = d->use_counter;
+    d->use_counter += count;
+    for (u32 i = 0; i < count; i++) {
+        UsbMsdCacheBlock* c = _usbMsdCacheEvict(d);
+        size_t size = MIN((size_t)USB_MSD_CACHE_BLOCK_SIZE, (size_t)(num_sectors * d->sector_size) - (size_t)i * USB_MSD_CACHE_BLOCK_SIZE);
+        memcpy(_usbMsdCacheData(d, c), d->xfer_buffer + (size_t)i * USB_MSD_CACHE_BLOCK_SIZE, size);
+        c->block = block + i;
+        // The readahead blocks are older than the one requested, so that a wrong guess is evicted first.
+        c->last_use = i ? base + i : base + count;
+        if (!i) *out = c;
+    }
+
+    return 0;
+}
+
+static Result _usbMsdCacheGet(UsbMsdDevice* d, u64 block, UsbMsdCacheBlock** out) {
+    UsbMsdCacheBlock* c = _usbMsdCacheFind(d, block);
+    if (!c)
+        return _usbMsdCacheLoad(d, block, out);
+
+    c->last_use = ++d->use_counter;
+    *out = c;
+    return 0;
+}
+
+// Updates the cached copies of the blocks overlapping the written bytes.
+static void _usbMsdCacheUpdate(UsbMsdDevice* d, u64 offset, const u8* data, size_t size) {
+    for (u32 i = 0; i < d->cache_blocks; i++) {
+        UsbMsdCacheBlock* c = &d->cache[i];
+        if (c->block == UINT64_MAX)
+            continue;
+
+        u64 start = c->block * USB_MSD_CACHE_BLOCK_SIZE;
+        u64 end = start + USB_MSD_CACHE_BLOCK_SIZE;
+        u64 lo = MAX(start, offset), hi = MIN(end, offset + size);
+        if (lo < hi)
+            memcpy(_usbMsdCacheData(d, c) + (lo - start), data + (lo - offset), hi - lo);
+    }
+}
+
+void usbMsdClose(UsbMsdDevice* d) {
+    if (serviceIsActive(&d->ep_in.s))
+        usbHsEpClose(&d->ep_in);
+    if (serviceIsActive(&d->ep_out.s))
+        usbHsEpClose(&d->ep_out);
+    if (serviceIsActive(&d->if_session.s))
+        usbHsIfClose(&d->if_session);
+
+    free(d->cmd_buffer);
+    free(d->xfer_buffer);
+    free(d->cache);
+    free(d->cache_data);
+    memset(d, 0, sizeof(*d));
+}
+
+Result usbMsdOpen(UsbMsdDevice* d, UsbHsInterface* interface, u8 lun, const UsbMsdConfig* config) {
+    memset(d, 0, sizeof(*d));
+    mutexInit(&d->mutex);
+    d->lun = lun;
+    d->cache_blocks = config && config->cache_blocks ? config->cache_blocks : USB_MSD_DEFAULT_CACHE_BLOCKS;
+    d->readahead_blocks = config && config->readahead_blocks ? config->readahead_blocks : USB_MSD_DEFAULT_READAHEAD_BLOCKS;
+    d->readahead_blocks = MIN(d->readahead_blocks, MIN(d->cache_blocks, USB_MSD_MAX_XFER_SIZE / USB_MSD_CACHE_BLOCK_SIZE));
+    u64 ready_timeout = config && config->ready_timeout_ns ? config->ready_timeout_ns : USB_MSD_DEFAULT_READY_TIMEOUT_NS;
+    d->next_block = UINT64_MAX;
+
+    Result rc = usbHsAcquireUsbIf(&d->if_session, interface);
+    if (R_FAILED(rc))
+        return rc;
+
+    // Find the bulk endpoints, the descriptor arrays are checked by direction since their order depends on the system version.
+    UsbHsInterfaceInfo* inf = &d->if_session.inf.inf;
+    struct usb_endpoint_descriptor *desc_in = NULL, *desc_out = NULL;
+    for (u32 i = 0; i < 30; i++) {
+        struct usb_endpoint_descriptor* desc = i < 15 ? &inf->input_endpoint_descs[i] : &inf->output_endpoint_descs[i - 15];
+        if (desc->bLength == 0 || (desc->bmAttributes & USB_TRANSFER_TYPE_MASK) != USB_TRANSFER_TYPE_BULK)
+            continue;
+        if (desc->bEndpointAddress & USB_ENDPOINT_IN) {
+            if (!desc_in) desc_in = desc;
+        }
+        else if (!desc_out)
+            desc_out = desc;
+    }
+
+    if (!desc_in || !desc_out)
+        rc = MAKERESULT(Module_Libnx, LibnxError_NotFound);
+
+    if (R_SUCCEEDED(rc))
+        rc = usbHsIfOpenUsbEp(&d->if_session, &d->ep_in, 1, USB_MSD_MAX_XFER_SIZE, desc_in);
+    if (R_SUCCEEDED(rc))
+        rc = usbHsIfOpenUsbEp(&d->if_session, &d->ep_out, 1, USB_MSD_MAX_XFER_SIZE, desc_out);
+
+    if (R_SUCCEEDED(rc)) {
+        d->cmd_buffer = (u8*)memalign(0x1000, 0x2000);
+        d->xfer_buffer = (u8*)memalign(0x1000, USB_MSD_MAX_XFER_SIZE);
+        d->cache = (UsbMsdCacheBlock*)malloc(d->cache_blocks * sizeof(UsbMsdCacheBlock));
+        d->cache_data = (u8*)memalign(0x1000, (size_t)d->cache_blocks * USB_MSD_CACHE_BLOCK_SIZE);
+        if (!d->cmd_buffer || !d->xfer_buffer || !d->cache || !d->cache_data)
+            rc = MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+    }
+
+    if (R_SUCCEEDED(rc)) {
+        for (u32 i = 0; i < d->cache_blocks; i++) {
+            d->cache[i].block = UINT64_MAX;
+            d->cache[i].last_use = 0;
+        }
+
+        rc = _usbMsdWaitReady(d, ready_timeout);
+    }
+
+    if (R_SUCCEEDED(rc))
+        rc = _usbMsdReadCapacity(d);
+
+    if (R_FAILED(rc))
+        usbMsdClose(d);
+
+    return rc;
+}
+
+Result usbMsdReadSectors(UsbMsdDevice* d, u64 sector, u32 count, void* buffer) {
+    mutexLock(&d->mutex);
+    Result rc = _usbMsdTransferSectors(d, false, sector, count, (u8*)buffer);
+    mutexUnlock(&d->mutex);
+    return rc;
+}
+
+Result usbMsdWriteSectors(UsbMsdDevice* d, u64 sector, u32 count, const void* buffer) {
+    mutexLock(&d->mutex);
+    Result rc = _usbMsdTransferSectors(d, true, sector, count, (u8*)buffer);
+    if (R_SUCCEEDED(rc))
+        _usbMsdCacheUpdate(d, sector * d->sector_size, (const u8*)buffer, (size_t)count * d->sector_size);
+    mutexUnlock(&d->mutex);
+    return rc;
+}
+
+Result usbMsdRead(UsbMsdDevice* d, u64 offset, void* buffer, size_t size) {
+    u8* out = (u8*)buffer;
+    Result rc = 0;
+
+    if (offset > usbMsdGetSize(d) || size > usbMsdGetSize(d) - offset)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    mutexLock(&d->mutex);
+
+    while (size && R_SUCCEEDED(rc)) {
+        u64 block = offset / USB_MSD_CACHE_BLOCK_SIZE;
+        u32 pos = offset % USB_MSD_CACHE_BLOCK_SIZE;
+
+        // Whole blocks which aren't cached are merged into one direct read, stopping at the first cached one.
+        if (!pos && size >= USB_MSD_CACHE_BLOCK_SIZE && !_usbMsdCacheFind(d, block)) {
+            u64 count = 1;
+            while ((count + 1) * USB_MSD_CACHE_BLOCK_SIZE <= size && !_usbMsdCacheFind(d, block + count))
+                count++;
+
+            size_t len = count * USB_MSD_CACHE_BLOCK_SIZE;
+            rc = _usbMsdTransferSectors(d, false, offset / d->sector_size, len / d->sector_size, out);
+            d->next_block = block + count;
+            offset += len;
+            out += len;
+            size -= len;
+            continue;
+        }
+
+        UsbMsdCacheBlock* c;
+        rc = _usbMsdCacheGet(d, block, &c);
+        if (R_FAILED(rc))
+            break;
+
+        size_t len = MIN(size, (size_t)(USB_MSD_CACHE_BLOCK_SIZE - pos));
+        memcpy(out, _usbMsdCacheData(d, c) + pos, len);
+        offset += len;
+        out += len;
+        size -= len;
+    }
+
+    mutexUnlock(&d->mutex);
+    return rc;
+}
+
+Result usbMsdWrite(UsbMsdDevice* d, u64 offset, const void* buffer, size_t size) {
+    const u8* in = (const u8*)buffer;
+    u32 sector_size = d->sector_size;
+    Result rc = 0;
+
+    if (offset > usbMsdGetSize(d) || size > usbMsdGetSize(d) - offset)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+    if (d->read_only)
+        return MAKERESULT(Module_Libnx, LibnxError_IoError);
+
+    mutexLock(&d->mutex);
+
+    while (size && R_SUCCEEDED(rc)) {
+        u32 pos = offset % sector_size;
+
+        // The whole sectors are written at once.
+        if (!pos && size >= sector_size) {
+            size_t len = size - size % sector_size;
+            rc = _usbMsdTransferSectors(d, true, offset / sector_size, len / sector_size, (u8*)in);
+            if (R_SUCCEEDED(rc))
+                _usbMsdCacheUpdate(d, offset, in, len);
+            offset += len;
+            in += len;
+            size -= len;
+            continue;
+        }
+
+        // Partial sector: read-modify-write through the cache.
+        UsbMsdCacheBlock* c;
+        rc = _usbMsdCacheGet(d, offset / USB_MSD_CACHE_BLOCK_SIZE, &c);
+        if (R_FAILED(rc))
+            break;
+
+        size_t len = MIN(size, (size_t)(sector_size - pos));
+        u64 sector_offset = offset - pos;
+        u8* data = _usbMsdCacheData(d, c) + (sector_offset % USB_MSD_CACHE_BLOCK_SIZE);
+
+        memcpy(d->xfer_buffer, data, sector_size);
+        memcpy(d->xfer_buffer + pos, in, len);
+        rc = _usbMsdRwCommand(d, true, sector_offset / sector_size, 1, d->xfer_buffer);
+        if (R_SUCCEEDED(rc))
+            memcpy(data + pos, in, len);
+
+        offset += len;
+        in += len;
+        size -= len;
+    }
+
+    mutexUnlock(&d->mutex);
+    return rc;
+}
+
+Result usbMsdFlush(UsbMsdDevice* d) {
+    const u8 cb[10] = { SCSI_SYNCHRONIZE_CACHE_10 };
+
+    mutexLock(&d->mutex);
+    Result rc = _usbMsdCommand(d, cb, sizeof(cb), NULL, 0, 0, false);
+    mutexUnlock(&d->mutex);
+    return rc;
+}
+
+//-----------------------------------------------------------------------------
+// devoptab
+//-----------------------------------------------------------------------------
+
+typedef struct {
+    UsbMsdDevice* d;
+    u64 pos;
+    int flags;
+} usbmsd_file;
+
+typedef struct {
+    devoptab_t device;
+    UsbMsdDevice* d;
+    char name[32];
+} usbmsd_mount;
+
+static usbmsd_mount g_usbMsdMounts[USB_MSD_MAX_MOUNTS];
+static Mutex g_usbMsdMountsMutex;
+
+static int usbmsd_open(struct _reent *r, void *fileStruct, const char *path, int flags, int mode) {
+    usbmsd_file* file = (usbmsd_file*)fileStruct;
+    file->d = (UsbMsdDevice*)r->deviceData;
+
+    if ((flags & O_ACCMODE) != O_RDONLY && file->d->read_only) {
+        r->_errno = EROFS;
+        return -1;
+    }
+
+    file->pos = 0;
+    file->flags = flags;
+    return 0;
+}
+
+static int usbmsd_close(struct _reent *r, void *fd) {
+    return 0;
+}
+
+static ssize_t usbmsd_read(struct _reent *r, void *fd, char *ptr, size_t len) {
+    usbmsd_file* file = (usbmsd_file*)fd;
+    u64 size = usbMsdGetSize(file->d);
+
+    if ((file->flags & O_ACCMODE) == O_WRONLY) {
+        r->_errno = EBADF;
+        return -1;
+    }
+
+    if (file->pos >= size)
+        return 0;
+    len = MIN(len, size - file->pos);
+
+    if (R_FAILED(usbMsdRead(file->d, file->pos, ptr, len))) {
+        r->_errno = EIO;
+        return -1;
+    }
+
+    file->pos += len;
+    return len;
+}
+
+static ssize_t usbmsd_write(struct _reent *r, void *fd, const char *ptr, size_t len) {
+    usbmsd_file* file = (usbmsd_file*)fd;
+    u64 size = usbMsdGetSize(file->d);
+
+    if ((file->flags & O_ACCMODE) == O_RDONLY) {
+        r->_errno = EBADF;
+        return -1;
+    }
+
+    if (file->pos >= size) {
+        r->_errno = ENOSPC;
+        return -1;
+    }
+    len = MIN(len, size - file->pos);
+
+    if (R_FAILED(usbMsdWrite(file->d, file->pos, ptr, len))) {
+        r->_errno = EIO;
+        return -1;
+    }
+
+    file->pos += len;
+    return len;
+}
+
+static off_t usbmsd_seek(struct _reent *r, void *fd, off_t pos, int dir) {
+    usbmsd_file* file = (usbmsd_file*)fd;
+    off_t start;
+
+    switch (dir) {
+        case SEEK_SET:
+            start = 0;
+            break;
+
+        case SEEK_CUR:
+            start = file->pos;
+            break;
+
+        case SEEK_END:
+            start = usbMsdGetSize(file->d);
+            break;
+
+        default:
+            r->_errno = EINVAL;
+            return -1;
+    }
+
+    if (pos < 0 ? start + pos < 0 : INT64_MAX - pos < start) {
+        r->_errno = pos < 0 ? EINVAL : EOVERFLOW;
+        return -1;
+    }
+
+    file->pos = start + pos;
+    return file->pos;
+}
+
+static void usbmsd_fill_stat(UsbMsdDevice* d, struct stat *st) {
+    memset(st, 0, sizeof(*st));
+    st->st_mode = S_IFBLK | (d->read_only ? 0444 : 0666);
+    st->st_nlink = 1;
+    st->st_size = usbMsdGetSize(d);
+    st->st_blksize = d->sector_size;
+    st->st_blocks = d->num_sectors * d->sector_size / 512;
+}
+
+static int usbmsd_fstat(struct _reent *r, void *fd, struct stat *st) {
+    usbmsd_fill_stat(((usbmsd_file*)fd)->d, st);
+    return 0;
+}
+
+static int usbmsd_stat(struct _reent *r, const char *path, struct stat *st) {
+    usbmsd_fill_stat((UsbMsdDevice*)r->deviceData, st);
+    return 0;
+}
+
+static int usbmsd_fsync(struct _reent *r, void *fd) {
+    if (R_FAILED(usbMsdFlush(((usbmsd_file*)fd)->d))) {
+        r->_errno = EIO;
+        return -1;
+    }
+    return 0;
+}
+
+static const devoptab_t usbMsd_devoptab = {
+    .structSize = sizeof(usbmsd_file),
+    .open_r     = usbmsd_open,
+    .close_r    = usbmsd_close,
+    .read_r     = usbmsd_read,
+    .write_r    = usbmsd_write,
+    .seek_r     = usbmsd_seek,
+    .fstat_r    = usbmsd_fstat,
+    .stat_r     = usbmsd_stat,
+    .fsync_r    = usbmsd_fsync,
+};
+
+Result usbMsdMount(UsbMsdDevice* d, const char* name) {
+    Result rc = MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+
+    if (strlen(name) >= sizeof(g_usbMsdMounts[0].name))
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    mutexLock(&g_usbMsdMountsMutex);
+    for (u32 i = 0; i < USB_MSD_MAX_MOUNTS; i++) {
+        usbmsd_mount* mount = &g_usbMsdMounts[i];
+        if (mount->d)
+            continue;
+
+        strcpy(mount->name, name);
+        mount->device = usbMsd_devoptab;
+        mount->device.name = mount->name;
+        mount->device.deviceData = d;
+        if (AddDevice(&mount->device) >= 0) {
+            mount->d = d;
+            rc = 0;
+        }
+        break;
+    }
+    mutexUnlock(&g_usbMsdMountsMutex);
+
+    return rc;
+}
+
+Result usbMsdUnmount(const char* name) {
+    Result rc = MAKERESULT(Module_Libnx, LibnxError_NotFound);
+    char tmpname[34];
+
+    mutexLock(&g_usbMsdMountsMutex);
+    for (u32 i = 0; i < USB_MSD_MAX_MOUNTS; i++) {
+        usbmsd_mount* mount = &g_usbMsdMounts[i];
+        if (!mount->d || strcmp(mount->name, name))
+            continue;
+
+        // Remove device
+        memset(tmpname, 0, sizeof(tmpname));
+        strncpy(tmpname, mount->name, sizeof(tmpname)-2);
+        strncat(tmpname, ":", sizeof(tmpname)-strlen(tmpname)-1);
+        RemoveDevice(tmpname);
+
+        mount->d = NULL;
+        rc = 0;
+        break;
+    }
+    mutexUnlock(&g_usbMsdMountsMutex);
+
+    return rc;
+}
@@ -2,10 +2,69 @@
 #include "services/fatal.h"
 #include <elf.h>
 
+#ifndef DT_RELACOUNT
+#define DT_RELACOUNT 0x6ffffff9
+#endif
+
+#ifndef DT_RELR
+#define DT_RELRSZ 35
+#define DT_RELR   36
+#endif
+
+// Relative relocations come first in the table (-z combreloc), and DT_RELACOUNT says how many there are.
+// They don't need their type checked, and are applied in batches of four.
+static void __nx_apply_relative(uintptr_t base, const Elf64_Rela* rela, u64 count)
+{
+	for (; count >= 4; count -= 4, rela += 4)
+	{
+		u64 off0 = rela[0].r_offset, off1 = rela[1].r_offset, off2 = rela[2].r_offset, off3 = rela[3].r_offset;
+		u64 add0 = rela[0].r_addend, add1 = rela[1].r_addend, add2 = rela[2].r_addend, add3 = rela[3].r_addend;
+		*(u64*)(base + off0) = base + add0;
+		*(u64*)(base + off1) = base + add1;
+		*(u64*)(base + off2) = base + add2;
+		*(u64*)(base + off3) = base + add3;
+	}
+
+	for (; count--; rela++)
+		*(u64*)(base + rela->r_offset) = base + rela->r_addend;
+}
+
+// RELR (-z pack-relative-relocs): an even entry is the address of a relocation, and starts a bitmap run.
+// An odd entry is a bitmap of the 63 words following the previous run, bit n set meaning word n is relocated.
+// The addends are in place.
+static void __nx_apply_relr(uintptr_t base, const u64* relr, u64 count)
+{
+	u64* where = NULL;
+
+	for (; count--; relr++)
+	{
+		u64 entry = *relr;
+
+		if ((entry & 1) == 0)
+		{
+			where = (u64*)(base + entry);
+			*where++ += base;
+		}
+		else
+		{
+			u64* ptr = where;
+			for (entry >>= 1; entry; entry >>= 1, ptr++)
+			{
+				if (entry & 1)
+					*ptr += base;
+			}
+			where += 63;
+		}
+	}
+}
+
 void __nx_dynamic(uintptr_t base, const Elf64_Dyn* dyn)
 {
 	const Elf64_Rela* rela = NULL;
 	u64 relasz = 0;
+	u64 relacount = 0;
+	const u64* relr = NULL;
+	u64 relrsz = 0;
 
 	for (; dyn->d_tag != DT_NULL; dyn++)
 	{
@@ -17,12 +76,34 @@ void __nx_dynamic(uintptr_t base, const Elf64_Dyn* dyn)
 			case DT_RELASZ:
 				relasz = dyn->d_un.d_val / sizeof(Elf64_Rela);
 				break;
+			case DT_RELACOUNT:
+				relacount = dyn->d_un.d_val;
+				break;
+			case DT_RELR:
+				relr = (const u64*)(base + dyn->d_un.d_ptr);
+				break;
+			case DT_RELRSZ:
+				relrsz = dyn->d_un.d_val / sizeof(u64);
+				break;
 		}
 	}
 
-	if (rela == NULL)
+	if (rela == NULL && relr == NULL)
 		fatalThrow(MAKERESULT(Module_Libnx, LibnxError_BadReloc));
 
+	if (relr != NULL)
+		__nx_apply_relr(base, relr, relrsz);
+
+	if (rela == NULL)
+		return;
+
+	if (relacount > relasz)
+		relacount = relasz;
+
+	__nx_apply_relative(base, rela, relacount);
+	rela += relacount;
+	relasz -= relacount;
+
 	for (; relasz--; rela++)
 	{
 		switch (ELF64_R_TYPE(rela->r_info))
@@ -0,0 +1,110 @@
+#include "types.h"
+#include "result.h"
+#include "arm/counter.h"
+#include "kernel/thread.h"
+#include "services/fs.h"
+#include "runtime/flight_recorder.h"
+
+extern char _start[];
+
+static FlightEvent g_flightRing[FLIGHT_RECORDER_EVENTS];
+static u64 g_flightPos;
+static u64 g_flightLastFrame;
+
+void flightRecorderRecord(FlightEventType type, const char* name, u64 arg0, u64 arg1) {
+    u64 tick = armGetSystemTick();
+    u64 pos = __atomic_fetch_add(&g_flightPos, 1, __ATOMIC_RELAXED);
+    FlightEvent* e = &g_flightRing[pos % FLIGHT_RECORDER_EVENTS];
+
+    __atomic_store_n(&e->seq, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    e->tick = tick;
+    e->name = name;
+    e->type = type;
+    e->thread = threadGetCurHandle();
+    e->arg0 = arg0;
+    e->arg1 = arg1;
+    __atomic_store_n(&e->seq, pos+1, __ATOMIC_RELEASE);
+}
+
+void flightRecorderFrame(void) {
+    u64 now = armGetSystemTick();
+    u64 prev = __atomic_exchange_n(&g_flightLastFrame, now, __ATOMIC_RELAXED);
+    flightRecorderRecord(FlightEventType_Frame, NULL, prev ? now - prev : 0, 0);
+}
+
+u64 flightRecorderGetCount(void) {
+    return __atomic_load_n(&g_flightPos, __ATOMIC_RELAXED);
+}
+
+u32 flightRecorderGetEvents(FlightEvent* events, u32 max_events) {
+    u64 end = __atomic_load_n(&g_flightPos, __ATOMIC_ACQUIRE);
+    u64 count = end < FLIGHT_RECORDER_EVENTS ? end : FLIGHT_RECORDER_EVENTS;
+    if (count > max_events)
+        count = max_events;
+
+    u32 written = 0;
+    for (u64 pos = end - count; pos < end; pos ++) {
+        FlightEvent* e = &g_flightRing[pos % FLIGHT_RECORDER_EVENTS];
+
+        // Skip events which are being written or were overwritten while copying.
+        if (__atomic_load_n(&e->seq, __ATOMIC_ACQUIRE) != pos+1)
+            continue;
+        events[written] = *e;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&e->seq, __ATOMIC_RELAXED) != pos+1)
+            continue;
+        events[written].seq = pos+1;
+        written ++;
+    }
+
+    return written;
+}
+
+Result flightRecorderDump(const char* path, const ThreadExceptionDump* ctx) {
+    // This runs on the small exception stack: nothing is formatted, the header and the ring are written as is.
+    static FsFileSystem fs;
+    static FsFile file;
+    static FlightRecorderHeader hdr;
+
+    hdr = (FlightRecorderHeader){
+        .magic         = FLIGHT_RECORDER_MAGIC,
+        .version       = FLIGHT_RECORDER_VERSION,
+        .module_base   = (u64)_start,
+        .tick          = armGetSystemTick(),
+        .tick_freq     = armGetSystemTickFreq(),
+        .num_events    = flightRecorderGetCount(),
+        .has_exception = ctx != NULL,
+        .num_slots     = FLIGHT_RECORDER_EVENTS,
+    };
+
+    s64 size = sizeof(hdr) + (ctx ? sizeof(*ctx) : 0) + sizeof(g_flightRing);
+    s64 offset = 0;
+
+    Result rc = fsOpenSdCardFileSystem(&fs);
+    if (R_FAILED(rc))
+        return rc;
+
+    fsFsDeleteFile(&fs, path);
+    rc = fsFsCreateFile(&fs, path, size, 0);
+    if (R_SUCCEEDED(rc))
+        rc = fsFsOpenFile(&fs, path, FsOpenMode_Write, &file);
+
+    if (R_SUCCEEDED(rc)) {
+        rc = fsFileWrite(&file, offset, &hdr, sizeof(hdr), FsWriteOption_None);
+        offset += sizeof(hdr);
+
+        if (R_SUCCEEDED(rc) && ctx) {
+            rc = fsFileWrite(&file, offset, ctx, sizeof(*ctx), FsWriteOption_None);
+            offset += sizeof(*ctx);
+        }
+
+        if (R_SUCCEEDED(rc))
+            rc = fsFileWrite(&file, offset, g_flightRing, sizeof(g_flightRing), FsWriteOption_Flush);
+
+        fsFileClose(&file);
+    }
+
+    fsFsClose(&fs);
+    return rc;
+}
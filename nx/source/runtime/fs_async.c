@@ -0,0 +1,130 @@
+#include "result.h"
+#include "kernel/wait.h"
+#include "runtime/fs_async.h"
+
+static void _fsasyncComplete(FsAsyncBatch* batch)
+{
+    if (__atomic_sub_fetch(&batch->num_pending, 1, __ATOMIC_ACQ_REL) == 0)
+        ueventSignal(&batch->event);
+}
+
+static void _fsasyncWorker(void* arg)
+{
+    FsAsyncQueue* q = (FsAsyncQueue*)arg;
+
+    mutexLock(&q->mutex);
+
+    for (;;) {
+        while (!q->should_exit && q->head == NULL)
+            condvarWait(&q->cond, &q->mutex);
+
+        if (q->should_exit)
+            break;
+
+        // Claim the next request, and retire the batch once all of its requests are claimed
+        FsAsyncBatch* batch = q->head;
+        FsAsyncReadRequest* req = &batch->reqs[batch->next_req++];
+        if (batch->next_req == batch->num_reqs) {
+            q->head = batch->next;
+            if (q->head == NULL)
+                q->tail = NULL;
+        }
+
+        mutexUnlock(&q->mutex);
+
+        req->bytes_read = 0;
+        req->result = fsFileRead(req->file, req->offset, req->buffer, req->size, FsReadOption_None, &req->bytes_read);
+        _fsasyncComplete(batch);
+
+        mutexLock(&q->mutex);
+    }
+
+    mutexUnlock(&q->mutex);
+}
+
+Result fsasyncCreate(FsAsyncQueue* q, u32 num_threads, int prio, int cpuid)
+{
+    if (num_threads < 1 || num_threads > FS_ASYNC_MAX_THREADS)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    *q = (FsAsyncQueue){0};
+    mutexInit(&q->mutex);
+    condvarInit(&q->cond);
+
+    Result rc = 0;
+    for (u32 i = 0; i < num_threads; i++) {
+        rc = threadCreate(&q->threads[i], _fsasyncWorker, q, NULL, 0x4000, prio, cpuid);
+        if (R_SUCCEEDED(rc)) {
+            rc = threadStart(&q->threads[i]);
+            if (R_FAILED(rc))
+                threadClose(&q->threads[i]);
+        }
+
+        if (R_FAILED(rc))
+            break;
+
+        q->num_threads++;
+    }
+
+    if (R_FAILED(rc))
+        fsasyncClose(q);
+
+    return rc;
+}
+
+void fsasyncClose(FsAsyncQueue* q)
+{
+    mutexLock(&q->mutex);
+    q->should_exit = true;
+    condvarWakeAll(&q->cond);
+    mutexUnlock(&q->mutex);
+
+    for (u32 i = 0; i < q->num_threads; i++) {
+        threadWaitForExit(&q->threads[i]);
+        threadClose(&q->threads[i]);
+    }
+
+    q->num_threads = 0;
+}
+
+void fsasyncSubmitRead(FsAsyncQueue* q, FsAsyncBatch* batch, FsAsyncReadRequest* reqs, u32 num_reqs)
+{
+    batch->reqs = reqs;
+    batch->num_reqs = num_reqs;
+    batch->next_req = 0;
+    batch->num_pending = num_reqs;
+    batch->next = NULL;
+    ueventCreate(&batch->event, false);
+
+    if (num_reqs == 0) {
+        ueventSignal(&batch->event);
+        return;
+    }
+
+    mutexLock(&q->mutex);
+
+    if (q->tail)
+        q->tail->next = batch;
+    else
+        q->head = batch;
+    q->tail = batch;
+
+    // Workers beyond the number of requests would only find the queue empty again.
+    condvarWake(&q->cond, num_reqs < q->num_threads ? num_reqs : q->num_threads);
+
+    mutexUnlock(&q->mutex);
+}
+
+Result fsasyncBatchWait(FsAsyncBatch* batch, u64 timeout)
+{
+    Result rc = waitSingle(waiterForFsAsyncBatch(batch), timeout);
+    if (R_FAILED(rc))
+        return rc;
+
+    for (u32 i = 0; i < batch->num_reqs; i++) {
+        if (R_FAILED(batch->reqs[i].result))
+            return batch->reqs[i].result;
+    }
+
+    return 0;
+}
@@ -0,0 +1,172 @@
+#include <malloc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "types.h"
+#include "result.h"
+#include "kernel/mutex.h"
+#include "runtime/heap_profile.h"
+
+/// One allocation out of this many has its callsite recorded.
+__attribute__((weak)) u32 __nx_heap_profile_sample_interval = 16;
+
+extern char* fake_heap_start;
+extern char* fake_heap_end;
+extern char __start__[];
+
+static HeapProfileStats g_heapProfileStats;
+static bool g_heapProfileActive;
+static u32 g_heapProfileSampleCounter;
+
+static Mutex g_heapProfileMutex;
+static HeapProfileCallsite g_heapProfileCallsites[HEAP_PROFILE_MAX_CALLSITES];
+
+static inline u32 _heapProfileSizeClass(size_t size) {
+    u32 c = size ? 64 - __builtin_clzll(size) : 0;
+    return c < HEAP_PROFILE_NUM_CLASSES ? c : HEAP_PROFILE_NUM_CLASSES - 1;
+}
+
+static void _heapProfileSample(void* caller, size_t size) {
+    u32 i = ((uintptr_t)caller >> 2) * 0x9E3779B1u % HEAP_PROFILE_MAX_CALLSITES;
+
+    mutexLock(&g_heapProfileMutex);
+    for (u32 probe = 0; probe < HEAP_PROFILE_MAX_CALLSITES; probe++, i = (i + 1) % HEAP_PROFILE_MAX_CALLSITES) {
+        HeapProfileCallsite* c = &g_heapProfileCallsites[i];
+        if (c->addr == caller || !c->addr) {
+            c->addr = caller;
+            c->num_allocs++;
+            c->bytes += size;
+            break;
+        }
+    }
+    mutexUnlock(&g_heapProfileMutex);
+}
+
+// Called by the allocation wrappers.
+void _heapProfileOnAlloc(void* ptr, size_t size, size_t usable, void* caller) {
+    HeapProfileStats* s = &g_heapProfileStats;
+    __atomic_store_n(&g_heapProfileActive, true, __ATOMIC_RELAXED);
+
+    if (!ptr) {
+        __atomic_add_fetch(&s->num_failed, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    __atomic_add_fetch(&s->num_allocs, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&s->allocs_by_class[_heapProfileSizeClass(size)], 1, __ATOMIC_RELAXED);
+
+    u64 in_use = __atomic_add_fetch(&s->bytes_in_use, usable, __ATOMIC_RELAXED);
+    u64 peak = __atomic_load_n(&s->peak_bytes_in_use, __ATOMIC_RELAXED);
+    while (in_use > peak && !__atomic_compare_exchange_n(&s->peak_bytes_in_use, &peak, in_use, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+    u32 interval = __nx_heap_profile_sample_interval;
+    if (interval && __atomic_add_fetch(&g_heapProfileSampleCounter, 1, __ATOMIC_RELAXED) % interval == 0)
+        _heapProfileSample(caller, size);
+}
+
+void _heapProfileOnFree(size_t usable) {
+    __atomic_add_fetch(&g_heapProfileStats.num_frees, 1, __ATOMIC_RELAXED);
+    __atomic_sub_fetch(&g_heapProfileStats.bytes_in_use, usable, __ATOMIC_RELAXED);
+}
+
+bool heapProfileIsActive(void) {
+    return __atomic_load_n(&g_heapProfileActive, __ATOMIC_RELAXED);
+}
+
+void heapProfileGetStats(HeapProfileStats* out) {
+    HeapProfileStats* s = &g_heapProfileStats;
+
+    out->bytes_in_use      = __atomic_load_n(&s->bytes_in_use, __ATOMIC_RELAXED);
+    out->peak_bytes_in_use = __atomic_load_n(&s->peak_bytes_in_use, __ATOMIC_RELAXED);
+    out->num_allocs        = __atomic_load_n(&s->num_allocs, __ATOMIC_RELAXED);
+    out->num_frees         = __atomic_load_n(&s->num_frees, __ATOMIC_RELAXED);
+    out->num_failed        = __atomic_load_n(&s->num_failed, __ATOMIC_RELAXED);
+    for (u32 i = 0; i < HEAP_PROFILE_NUM_CLASSES; i++)
+        out->allocs_by_class[i] = __atomic_load_n(&s->allocs_by_class[i], __ATOMIC_RELAXED);
+}
+
+u32 heapProfileGetCallsites(HeapProfileCallsite* out, u32 max_callsites) {
+    u32 count = 0;
+
+    mutexLock(&g_heapProfileMutex);
+    for (u32 i = 0; i < HEAP_PROFILE_MAX_CALLSITES; i++) {
+        HeapProfileCallsite* c = &g_heapProfileCallsites[i];
+        if (!c->addr)
+            continue;
+
+        // Insertion sort, keeping the top max_callsites.
+        u32 pos = count < max_callsites ? count++ : max_callsites;
+        while (pos > 0 && out[pos-1].bytes < c->bytes) {
+            if (pos < max_callsites)
+                out[pos] = out[pos-1];
+            pos--;
+        }
+        if (pos < max_callsites)
+            out[pos] = *c;
+    }
+    mutexUnlock(&g_heapProfileMutex);
+
+    return count;
+}
+
+void heapProfileReset(void) {
+    HeapProfileStats* s = &g_heapProfileStats;
+
+    __atomic_store_n(&s->peak_bytes_in_use, __atomic_load_n(&s->bytes_in_use, __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+    __atomic_store_n(&s->num_allocs, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&s->num_frees, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&s->num_failed, 0, __ATOMIC_RELAXED);
+    for (u32 i = 0; i < HEAP_PROFILE_NUM_CLASSES; i++)
+        __atomic_store_n(&s->allocs_by_class[i], 0, __ATOMIC_RELAXED);
+
+    mutexLock(&g_heapProfileMutex);
+    memset(g_heapProfileCallsites, 0, sizeof(g_heapProfileCallsites));
+    mutexUnlock(&g_heapProfileMutex);
+}
+
+void heapProfileDump(FILE* f, u32 max_callsites) {
+    HeapProfileStats s;
+    heapProfileGetStats(&s);
+
+    struct mallinfo mi = mallinfo();
+    uintptr_t brk = (uintptr_t)sbrk(0);
+
+    fprintf(f, "heap profile%s\n", heapProfileIsActive() ? "" : " (inactive, link with the wrapping flags)");
+    fprintf(f, "  in use: %llu bytes, peak: %llu bytes\n", (unsigned long long)s.bytes_in_use, (unsigned long long)s.peak_bytes_in_use);
+    fprintf(f, "  allocs: %llu, frees: %llu, failed: %llu\n", (unsigned long long)s.num_allocs, (unsigned long long)s.num_frees, (unsigned long long)s.num_failed);
+    fprintf(f, "  fake heap: %zu bytes, %zu taken by sbrk, malloc arena %zu (in use %zu, free %zu)\n",
+        (size_t)(fake_heap_end - fake_heap_start), (size_t)(brk - (uintptr_t)fake_heap_start),
+        (size_t)mi.arena, (size_t)mi.uordblks, (size_t)mi.fordblks);
+
+    fprintf(f, "  allocations by size:\n");
+    for (u32 i = 0; i < HEAP_PROFILE_NUM_CLASSES; i++) {
+        if (!s.allocs_by_class[i])
+            continue;
+        if (i == 0)
+            fprintf(f, "    0: %llu\n", (unsigned long long)s.allocs_by_class[i]);
+        else
+            fprintf(f, "    %llu-%llu: %llu\n", 1ULL << (i-1), (1ULL << i) - 1, (unsigned long long)s.allocs_by_class[i]);
+    }
+
+    HeapProfileCallsite sites[32];
+    if (max_callsites > 32)
+        max_callsites = 32;
+
+    u32 num_sites = heapProfileGetCallsites(sites, max_callsites);
+    if (num_sites) {
+        fprintf(f, "  top callsites (sampled 1/%u, offsets from the image base):\n", __nx_heap_profile_sample_interval);
+        for (u32 i = 0; i < num_sites; i++)
+            fprintf(f, "    0x%lx: %llu allocs, %llu bytes\n", (unsigned long)((uintptr_t)sites[i].addr - (uintptr_t)__start__),
+                (unsigned long long)sites[i].num_allocs, (unsigned long long)sites[i].bytes);
+    }
+}
+
+Result heapProfileDumpToFile(const char* path, u32 max_callsites) {
+    FILE* f = fopen(path, "w");
+    if (!f)
+        return MAKERESULT(Module_Libnx, LibnxError_IoError);
+
+    heapProfileDump(f, max_callsites);
+    return fclose(f) == 0 ? 0 : MAKERESULT(Module_Libnx, LibnxError_IoError);
+}
@@ -0,0 +1,103 @@
+// Allocation function wrappers used by heap_profile.c, only linked in with the -Wl,--wrap flags listed in heap_profile.h.
+// The public functions forward straight to the reentrant ones, so that each allocation is only accounted once.
+#include <malloc.h>
+#include <reent.h>
+#include "types.h"
+
+void _heapProfileOnAlloc(void* ptr, size_t size, size_t usable, void* caller);
+void _heapProfileOnFree(size_t usable);
+
+void* __real__malloc_r(struct _reent* r, size_t size);
+void  __real__free_r(struct _reent* r, void* ptr);
+void* __real__calloc_r(struct _reent* r, size_t count, size_t size);
+void* __real__realloc_r(struct _reent* r, void* ptr, size_t size);
+void* __real__memalign_r(struct _reent* r, size_t alignment, size_t size);
+
+static inline size_t _usable(struct _reent* r, void* ptr) {
+    return ptr ? _malloc_usable_size_r(r, ptr) : 0;
+}
+
+static inline void* _profiledMalloc(struct _reent* r, size_t size, void* caller) {
+    void* ptr = __real__malloc_r(r, size);
+    _heapProfileOnAlloc(ptr, size, _usable(r, ptr), caller);
+    return ptr;
+}
+
+static inline void _profiledFree(struct _reent* r, void* ptr) {
+    if (ptr)
+        _heapProfileOnFree(_usable(r, ptr));
+    __real__free_r(r, ptr);
+}
+
+static inline void* _profiledCalloc(struct _reent* r, size_t count, size_t size, void* caller) {
+    void* ptr = __real__calloc_r(r, count, size);
+    _heapProfileOnAlloc(ptr, count * size, _usable(r, ptr), caller);
+    return ptr;
+}
+
+static inline void* _profiledRealloc(struct _reent* r, void* ptr, size_t size, void* caller) {
+    size_t old_usable = _usable(r, ptr);
+    void* new_ptr = __real__realloc_r(r, ptr, size);
+
+    // Failure leaves the old allocation alone, and realloc(ptr, 0) frees it.
+    if (new_ptr || !size) {
+        if (ptr)
+            _heapProfileOnFree(old_usable);
+        if (new_ptr)
+            _heapProfileOnAlloc(new_ptr, size, _usable(r, new_ptr), caller);
+    }
+    else
+        _heapProfileOnAlloc(NULL, size, 0, caller);
+
+    return new_ptr;
+}
+
+static inline void* _profiledMemalign(struct _reent* r, size_t alignment, size_t size, void* caller) {
+    void* ptr = __real__memalign_r(r, alignment, size);
+    _heapProfileOnAlloc(ptr, size, _usable(r, ptr), caller);
+    return ptr;
+}
+
+void* __wrap__malloc_r(struct _reent* r, size_t size) {
+    return _profiledMalloc(r, size, __builtin_return_address(0));
+}
+
+void __wrap__free_r(struct _reent* r, void* ptr) {
+    _profiledFree(r, ptr);
+}
+
+void* __wrap__calloc_r(struct _reent* r, size_t count, size_t size) {
+    return _profiledCalloc(r, count, size, __builtin_return_address(0));
+}
+
+void* __wrap__realloc_r(struct _reent* r, void* ptr, size_t size) {
+    return _profiledRealloc(r, ptr, size, __builtin_return_address(0));
+}
+
+void* __wrap__memalign_r(struct _reent* r, size_t alignment, size_t size) {
+    return _profiledMemalign(r, alignment, size, __builtin_return_address(0));
+}
+
+void* __wrap_malloc(size_t size) {
+    return _profiledMalloc(_REENT, size, __builtin_return_address(0));
+}
+
+void __wrap_free(void* ptr) {
+    _profiledFree(_REENT, ptr);
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+    return _profiledCalloc(_REENT, count, size, __builtin_return_address(0));
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+    return _profiledRealloc(_REENT, ptr, size, __builtin_return_address(0));
+}
+
+void* __wrap_memalign(size_t alignment, size_t size) {
+    return _profiledMemalign(_REENT, alignment, size, __builtin_return_address(0));
+}
+
+void* __wrap_aligned_alloc(size_t alignment, size_t size) {
+    return _profiledMemalign(_REENT, alignment, size, __builtin_return_address(0));
+}
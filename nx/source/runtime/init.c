@@ -1,6 +1,13 @@
 #include "types.h"
+#include "result.h"
+#include "arm/counter.h"
+#include "kernel/svc.h"
+#include "kernel/mutex.h"
+#include "kernel/condvar.h"
+#include "kernel/thread.h"
 #include "runtime/env.h"
 #include "runtime/hosversion.h"
+#include "runtime/init.h"
 #include "services/sm.h"
 #include "services/fatal.h"
 #include "services/fs.h"
@@ -17,6 +24,7 @@ void virtmemSetup(void);
 void newlibSetup(void);
 void argvSetup(void);
 void __libnx_init_time(void);
+void __libnx_init_time_lazy(void);
 void __libnx_init_cwd(void);
 
 extern u32 __nx_applet_type;
@@ -24,6 +32,12 @@ extern u32 __nx_applet_type;
 // Must be a multiple of 0x200000.
 __attribute__((weak)) size_t __nx_heap_size = 0;
 
+/// Set this to non-zero to defer the initialization of hid and time to their first use, see \ref appInitGetTimings.
+__attribute__((weak)) u32 __nx_appinit_lazy = 0;
+
+/// Set this to non-zero to initialize the independent default services on worker threads, see \ref appInitRunParallel.
+__attribute__((weak)) u32 __nx_appinit_parallel = 0;
+
 /// Override these with your own if you're using \ref__libnx_exception_handler. __nx_exception_stack is the stack-bottom. Update \ref __nx_exception_stack_size if you change this.
 __attribute__((weak)) alignas(16) u8 __nx_exception_stack[0x400];
 __attribute__((weak)) u64 __nx_exception_stack_size = sizeof(__nx_exception_stack);
@@ -101,15 +115,233 @@ void __attribute__((weak)) __libnx_initheap(void)
 void __attribute__((weak)) __nx_win_init(void);
 void __attribute__((weak)) userAppInit(void);
 
+static AppInitTimings g_appInitTimings;
+
+static inline u64 _appInitStepDone(AppInitStep step, u64 start)
+{
+    u64 now = armGetSystemTick();
+    g_appInitTimings.ticks[step] = now - start;
+    return now;
+}
+
+typedef struct {
+    const AppInitTask* tasks;
+    u32 num_tasks;
+    Result* results;
+    u32 started;
+    u32 done;
+    u32 failed;
+    Mutex mutex;
+    CondVar cond;
+} AppInitParallelState;
+
+static void _appInitParallelWorker(void* arg)
+{
+    AppInitParallelState* st = (AppInitParallelState*)arg;
+    u32 all = st->num_tasks == 32 ? UINT32_MAX : BIT(st->num_tasks) - 1;
+
+    mutexLock(&st->mutex);
+
+    while (st->done != all) {
+        s32 next = -1;
+        for (u32 i = 0; i < st->num_tasks; i++) {
+            const AppInitTask* task = &st->tasks[i];
+            if (st->started & BIT(i))
+                continue;
+
+            // Tasks whose dependencies failed are skipped, with the first failure as their result.
+            if (task->deps & st->failed) {
+                st->results[i] = st->results[__builtin_ctz(task->deps & st->failed)];
+                st->started |= BIT(i);
+                st->done |= BIT(i);
+                st->failed |= BIT(i);
+                condvarWakeAll(&st->cond);
+                continue;
+            }
+            if ((task->deps & st->done) == task->deps) {
+                next = i;
+                break;
+            }
+        }
+
+        if (next < 0) {
+            if (st->done != all)
+                condvarWait(&st->cond, &st->mutex);
+            continue;
+        }
+
+        st->started |= BIT(next);
+        mutexUnlock(&st->mutex);
+
+        Result rc = st->tasks[next].init();
+
+        mutexLock(&st->mutex);
+        st->results[next] = rc;
+        st->done |= BIT(next);
+        if (R_FAILED(rc))
+            st->failed |= BIT(next);
+        condvarWakeAll(&st->cond);
+    }
+
+    mutexUnlock(&st->mutex);
+}
+
+Result appInitRunParallel(const AppInitTask* tasks, u32 num_tasks, u32 num_threads, Result* out_results)
+{
+    Thread threads[APPINIT_MAX_THREADS];
+    u32 num_started = 0;
+    u32 prio = 0x2C;
+
+    if (num_tasks > APPINIT_MAX_TASKS || !num_threads || num_threads > APPINIT_MAX_THREADS)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    // Dependencies must refer to earlier tasks, which also rules out cycles.
+    for (u32 i = 0; i < num_tasks; i++) {
+        if (tasks[i].deps & ~(BIT(i) - 1))
+            return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+    }
+
+    if (!num_tasks)
+        return 0;
+
+    AppInitParallelState st = {
+        .tasks = tasks,
+        .num_tasks = num_tasks,
+        .results = out_results,
+    };
+    mutexInit(&st.mutex);
+    condvarInit(&st.cond);
+
+    // The calling thread is worker 0, extra workers are best-effort.
+    svcGetThreadPriority(&prio, CUR_THREAD_HANDLE);
+    for (u32 i = 1; i < num_threads && i < num_tasks; i++) {
+        Result rc = threadCreate(&threads[num_started], _appInitParallelWorker, &st, NULL, 0x8000, prio, -2);
+        if (R_FAILED(rc))
+            break;
+        rc = threadStart(&threads[num_started]);
+        if (R_FAILED(rc)) {
+            threadClose(&threads[num_started]);
+            break;
+        }
+        num_started++;
+    }
+
+    _appInitParallelWorker(&st);
+
+    for (u32 i = 0; i < num_started; i++) {
+        threadWaitForExit(&threads[i]);
+        threadClose(&threads[i]);
+    }
+
+    for (u32 i = 0; i < num_tasks; i++) {
+        if (R_FAILED(out_results[i]))
+            return out_results[i];
+    }
+    return 0;
+}
+
+static Result _appInitTaskApplet(void)
+{
+    u64 t = armGetSystemTick();
+    Result rc = appletInitialize();
+    _appInitStepDone(AppInitStep_Applet, t);
+    return rc;
+}
+
+static Result _appInitTaskHid(void)
+{
+    if (__nx_applet_type == AppletType_None)
+        return 0;
+
+    if (__nx_appinit_lazy) {
+        hidInitializeLazy();
+        __atomic_or_fetch(&g_appInitTimings.deferred_mask, BIT(AppInitStep_Hid), __ATOMIC_RELAXED);
+        return 0;
+    }
+
+    u64 t = armGetSystemTick();
+    Result rc = hidInitialize();
+    _appInitStepDone(AppInitStep_Hid, t);
+    return rc;
+}
+
+static Result _appInitTaskTime(void)
+{
+    if (__nx_appinit_lazy) {
+        timeInitializeLazy();
+        __libnx_init_time_lazy();
+        __atomic_or_fetch(&g_appInitTimings.deferred_mask, BIT(AppInitStep_Time), __ATOMIC_RELAXED);
+        return 0;
+    }
+
+    u64 t = armGetSystemTick();
+    Result rc = timeInitialize();
+    if (R_SUCCEEDED(rc))
+        __libnx_init_time();
+    _appInitStepDone(AppInitStep_Time, t);
+    return rc;
+}
+
+static Result _appInitTaskFs(void)
+{
+    u64 t = armGetSystemTick();
+    Result rc = fsInitialize();
+    _appInitStepDone(AppInitStep_Fs, t);
+    return rc;
+}
+
+static Result _appInitTaskSdmc(void)
+{
+    u64 t = armGetSystemTick();
+    fsdevMountSdmc();
+    __libnx_init_cwd();
+    _appInitStepDone(AppInitStep_Sdmc, t);
+    return 0;
+}
+
+// applet, hid (which needs the applet resource user id), time, fs, sdmc (which needs fs).
+static const AppInitTask g_appInitDefaultTasks[] = {
+    { "applet", _appInitTaskApplet, 0 },
+    { "hid",    _appInitTaskHid,    BIT(0) },
+    { "time",   _appInitTaskTime,   0 },
+    { "fs",     _appInitTaskFs,     0 },
+    { "sdmc",   _appInitTaskSdmc,   BIT(3) },
+};
+
+static const u32 g_appInitDefaultErrors[] = {
+    LibnxError_InitFail_AM,
+    LibnxError_InitFail_HID,
+    LibnxError_InitFail_Time,
+    LibnxError_InitFail_FS,
+    0,
+};
+
+static void _appInitParallel(void)
+{
+    Result results[sizeof(g_appInitDefaultTasks)/sizeof(g_appInitDefaultTasks[0])];
+    u32 num_tasks = sizeof(g_appInitDefaultTasks)/sizeof(g_appInitDefaultTasks[0]);
+
+    appInitRunParallel(g_appInitDefaultTasks, num_tasks, 3, results);
+
+    for (u32 i = 0; i < num_tasks; i++) {
+        if (R_FAILED(results[i]))
+            fatalThrow(MAKERESULT(Module_Libnx, g_appInitDefaultErrors[i]));
+    }
+}
+
 void __attribute__((weak)) __appInit(void)
 {
     Result rc;
+    u64 init_start = armGetSystemTick();
+    u64 t = init_start;
 
     // Initialize default services.
     rc = smInitialize();
     if (R_FAILED(rc))
         fatalThrow(MAKERESULT(Module_Libnx, LibnxError_InitFail_SM));
 
+    t = _appInitStepDone(AppInitStep_Sm, t);
+
     if (hosversionGet() == 0) {
         rc = setsysInitialize();
         if (R_SUCCEEDED(rc)) {
@@ -119,33 +351,100 @@ void __attribute__((weak)) __appInit(void)
                 hosversionSet(MAKEHOSVERSION(fw.major, fw.minor, fw.micro));
             setsysExit();
         }
+
+        t = _appInitStepDone(AppInitStep_HosVersion, t);
+    }
+
+#ifdef LIBNX_MIN_HOS
+    // The library was built without the code for older versions.
+    if (hosversionGet() && hosversionGet() < (LIBNX_MIN_HOS))
+        fatalThrow(MAKERESULT(Module_Libnx, LibnxError_IncompatSysVer));
+#endif
+
+    if (__nx_appinit_parallel) {
+        _appInitParallel();
+        t = armGetSystemTick();
+        goto user_init;
     }
 
     rc = appletInitialize();
     if (R_FAILED(rc))
         fatalThrow(MAKERESULT(Module_Libnx, LibnxError_InitFail_AM));
 
+    t = _appInitStepDone(AppInitStep_Applet, t);
+
     if (__nx_applet_type != AppletType_None) {
-        rc = hidInitialize();
-        if (R_FAILED(rc))
-            fatalThrow(MAKERESULT(Module_Libnx, LibnxError_InitFail_HID));
+        if (__nx_appinit_lazy) {
+            hidInitializeLazy();
+            g_appInitTimings.deferred_mask |= BIT(AppInitStep_Hid);
+        }
+        else {
+            rc = hidInitialize();
+            if (R_FAILED(rc))
+                fatalThrow(MAKERESULT(Module_Libnx, LibnxError_InitFail_HID));
+
+            t = _appInitStepDone(AppInitStep_Hid, t);
+        }
     }
 
-    rc = timeInitialize();
-    if (R_FAILED(rc))
-        fatalThrow(MAKERESULT(Module_Libnx, LibnxError_InitFail_Time));
+    if (__nx_appinit_lazy) {
+        timeInitializeLazy();
+        __libnx_init_time_lazy();
+        g_appInitTimings.deferred_mask |= BIT(AppInitStep_Time);
+    }
+    else {
+        rc = timeInitialize();
+        if (R_FAILED(rc))
+            fatalThrow(MAKERESULT(Module_Libnx, LibnxError_InitFail_Time));
 
-    __libnx_init_time();
+        __libnx_init_time();
+        t = _appInitStepDone(AppInitStep_Time, t);
+    }
 
     rc = fsInitialize();
     if (R_FAILED(rc))
         fatalThrow(MAKERESULT(Module_Libnx, LibnxError_InitFail_FS));
 
+    t = _appInitStepDone(AppInitStep_Fs, t);
+
     fsdevMountSdmc();
     __libnx_init_cwd();
 
+    t = _appInitStepDone(AppInitStep_Sdmc, t);
+
+user_init:
     if (&__nx_win_init) __nx_win_init();
     if (&userAppInit) userAppInit();
+
+    t = _appInitStepDone(AppInitStep_User, t);
+    g_appInitTimings.total_ticks = t - init_start;
+}
+
+void appInitGetTimings(AppInitTimings* out)
+{
+    *out = g_appInitTimings;
+}
+
+void appInitDumpTimings(FILE* f)
+{
+    static const char* const names[AppInitStep_Count] = {
+        [AppInitStep_Sm]         = "sm",
+        [AppInitStep_HosVersion] = "hosversion",
+        [AppInitStep_Applet]     = "applet",
+        [AppInitStep_Hid]        = "hid",
+        [AppInitStep_Time]       = "time",
+        [AppInitStep_Fs]         = "fs",
+        [AppInitStep_Sdmc]       = "sdmc",
+        [AppInitStep_User]       = "user",
+    };
+
+    fprintf(f, "startup: %llu us\n", (unsigned long long)(armTicksToNs(g_appInitTimings.total_ticks) / 1000));
+    for (u32 i = 0; i < AppInitStep_Count; i++) {
+        if (g_appInitTimings.deferred_mask & BIT(i))
+            fprintf(f, "  %-10s deferred\n", names[i]);
+        else if (g_appInitTimings.ticks[i])
+            fprintf(f, "  %-10s %llu us\n", names[i], (unsigned long long)(armTicksToNs(g_appInitTimings.ticks[i]) / 1000));
+    }
 }
 
 void __attribute__((weak)) userAppExit(void);
@@ -0,0 +1,262 @@
+#include <malloc.h>
+#include <stdlib.h>
+#include <string.h>
+#include "result.h"
+#include "runtime/integrity_storage.h"
+
+static Result _integrityStorageReadRaw(IntegrityStorage* is, s64 offset, void* buffer, u64 size)
+{
+    switch (is->src.type) {
+        case IntegrityStorageSourceType_Storage:
+            return fsStorageRead(is->src.storage, offset, buffer, size);
+
+        case IntegrityStorageSourceType_File: {
+            u64 bytes_read = 0;
+            Result rc = fsFileRead(is->src.file, offset, buffer, size, FsReadOption_None, &bytes_read);
+            if (R_SUCCEEDED(rc) && bytes_read != size)
+                rc = MAKERESULT(Module_Libnx, LibnxError_IoError);
+            return rc;
+        }
+
+        case IntegrityStorageSourceType_CryptoStorage:
+            return cryptoStorageRead(is->src.crypto, offset, buffer, size);
+    }
+
+    return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+}
+
+static void _integrityStorageHashPadded(IntegrityStorage* is, void* dst, const void* src, size_t size, u32 block_size)
+{
+    static const u8 zeroes[0x200];
+
+    if (is->type != IntegrityStorageType_Ivfc || size >= block_size) {
+        sha256CalculateHash(dst, src, size);
+        return;
+    }
+
+    Sha256Context ctx;
+    sha256ContextCreate(&ctx);
+    sha256ContextUpdate(&ctx, src, size);
+    for (size_t pad = block_size - size; pad > 0;) {
+        size_t cur = pad < sizeof(zeroes) ? pad : sizeof(zeroes);
+        sha256ContextUpdate(&ctx, zeroes, cur);
+        pad -= cur;
+    }
+    sha256ContextGetHash(&ctx, dst);
+}
+
+static Result _integrityStorageVerifyRun(IntegrityStorage* is, u32 level, s64 first_block, const u8* data, u64 size);
+
+// Gets the expected hash of a block of the specified level, from the level above it.
+static Result _integrityStorageGetHash(IntegrityStorage* is, u32 level, s64 block, u8* out)
+{
+    u32 parent = level - 1;
+
+    if (parent < is->num_cached_levels) {
+        memcpy(out, is->tree + is->tree_offsets[parent] + block * SHA256_HASH_SIZE, SHA256_HASH_SIZE);
+        return 0;
+    }
+
+    // The lowest hash level isn't cached, its blocks are verified on demand
+    const IntegrityStorageLevel* lv = &is->levels[parent];
+    s64 entries_per_block = lv->block_size / SHA256_HASH_SIZE;
+    s64 hash_block = block / entries_per_block;
+
+    if (is->hash_block_index != hash_block) {
+        s64 pos = hash_block * lv->block_size;
+        u64 size = lv->size - pos < lv->block_size ? lv->size - pos : lv->block_size;
+
+        is->hash_block_index = -1;
+        Result rc = _integrityStorageReadRaw(is, lv->offset + pos, is->hash_block, size);
+        if (R_SUCCEEDED(rc))
+            rc = _integrityStorageVerifyRun(is, parent, hash_block, is->hash_block, size);
+        if (R_FAILED(rc))
+            return rc;
+
+        is->hash_block_index = hash_block;
+    }
+
+    memcpy(out, is->hash_block + (block % entries_per_block) * SHA256_HASH_SIZE, SHA256_HASH_SIZE);
+    return 0;
+}
+
+// Verifies consecutive blocks of a level, at most INTEGRITY_STORAGE_MAX_RUN_BLOCKS at a time. Only the last block may be partial.
+static Result _integrityStorageVerifyRun(IntegrityStorage* is, u32 level, s64 first_block, const u8* data, u64 size)
+{
+    u32 block_size = is->levels[level].block_size;
+    u8 hashes[INTEGRITY_STORAGE_MAX_RUN_BLOCKS][SHA256_HASH_SIZE];
+    void* dsts[INTEGRITY_STORAGE_MAX_RUN_BLOCKS];
+    const void* srcs[INTEGRITY_STORAGE_MAX_RUN_BLOCKS];
+    size_t sizes[INTEGRITY_STORAGE_MAX_RUN_BLOCKS];
+
+    while (size > 0) {
+        size_t count = 0;
+        while (size > 0 && count < INTEGRITY_STORAGE_MAX_RUN_BLOCKS) {
+            dsts[count] = hashes[count];
+            srcs[count] = data;
+            sizes[count] = size < block_size ? size : block_size;
+            data += sizes[count];
+            size -= sizes[count];
+            count++;
+        }
+
+        // Full blocks are hashed in pairs, a partial last block may need padding
+        size_t num_full = sizes[count - 1] < block_size ? count - 1 : count;
+        sha256CalculateHashesBatch(dsts, srcs, sizes, num_full);
+        if (num_full < count)
+            _integrityStorageHashPadded(is, hashes[num_full], srcs[num_full], sizes[num_full], block_size);
+
+        for (size_t i = 0; i < count; i++) {
+            u8 expected[SHA256_HASH_SIZE];
+            Result rc = _integrityStorageGetHash(is, level, first_block + i, expected);
+            if (R_FAILED(rc))
+                return rc;
+            if (memcmp(hashes[i], expected, SHA256_HASH_SIZE) != 0)
+                return MAKERESULT(Module_Libnx, LibnxError_HashMismatch);
+        }
+
+        first_block += count;
+    }
+
+    return 0;
+}
+
+Result integrityStorageCreate(IntegrityStorage* out, IntegrityStorageType type, const IntegrityStorageSource* src, const IntegrityStorageLevel* levels, u32 num_levels, const void* master_hash)
+{
+    if (num_levels < 2 || num_levels > INTEGRITY_STORAGE_MAX_LEVELS)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    for (u32 i = 0; i < num_levels; i++) {
+        const IntegrityStorageLevel* lv = &levels[i];
+        if (lv->offset < 0 || lv->size < 0 || !lv->block_size)
+            return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+        if (i + 1 < num_levels && lv->block_size % SHA256_HASH_SIZE)
+            return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+        // The level above must have an entry for every block of this one
+        if (i > 0) {
+            u64 num_blocks = (lv->size + lv->block_size - 1) / lv->block_size;
+            if (num_blocks * SHA256_HASH_SIZE > (u64)levels[i - 1].size)
+                return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+        }
+    }
+
+    memset(out, 0, sizeof(*out));
+    out->src = *src;
+    out->type = type;
+    out->num_levels = num_levels;
+    memcpy(out->levels, levels, num_levels * sizeof(IntegrityStorageLevel));
+    memcpy(out->master_hash, master_hash, SHA256_HASH_SIZE);
+    out->hash_block_index = -1;
+    out->data_block_index = -1;
+    mutexInit(&out->mutex);
+
+    // Every hash level but the lowest one is cached, a lone hash level is verified as a whole by the master hash
+    out->num_cached_levels = num_levels == 2 ? 1 : num_levels - 2;
+
+    size_t tree_size = 0;
+    for (u32 i = 0; i < out->num_cached_levels; i++) {
+        out->tree_offsets[i] = tree_size;
+        tree_size += levels[i].size;
+    }
+
+    Result rc = 0;
+    out->tree = (u8*)malloc(tree_size ? tree_size : 1);
+    out->data_block = (u8*)memalign(0x1000, levels[num_levels - 1].block_size);
+    if (out->num_cached_levels < num_levels - 1)
+        out->hash_block = (u8*)malloc(levels[num_levels - 2].block_size);
+
+    if (!out->tree || !out->data_block || (out->num_cached_levels < num_levels - 1 && !out->hash_block))
+        rc = MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+
+    for (u32 i = 0; R_SUCCEEDED(rc) && i < out->num_cached_levels; i++)
+        rc = _integrityStorageReadRaw(out, levels[i].offset, out->tree + out->tree_offsets[i], levels[i].size);
+
+    if (R_SUCCEEDED(rc)) {
+        // For IVFC the top level is padded up to whole blocks
+        u8 hash[SHA256_HASH_SIZE];
+        u32 top_size = levels[0].size;
+        if (type == IntegrityStorageType_Ivfc && top_size % levels[0].block_size)
+            top_size += levels[0].block_size - top_size % levels[0].block_size;
+
+        _integrityStorageHashPadded(out, hash, out->tree, levels[0].size, top_size);
+        if (memcmp(hash, out->master_hash, SHA256_HASH_SIZE) != 0)
+            rc = MAKERESULT(Module_Libnx, LibnxError_HashMismatch);
+    }
+
+    for (u32 i = 1; R_SUCCEEDED(rc) && i < out->num_cached_levels; i++)
+        rc = _integrityStorageVerifyRun(out, i, 0, out->tree + out->tree_offsets[i], levels[i].size);
+
+    if (R_FAILED(rc))
+        integrityStorageClose(out);
+
+    return rc;
+}
+
+void integrityStorageClose(IntegrityStorage* is)
+{
+    free(is->tree);
+    free(is->hash_block);
+    free(is->data_block);
+    memset(is, 0, sizeof(*is));
+}
+
+Result integrityStorageRead(IntegrityStorage* is, s64 offset, void* buffer, u64 size)
+{
+    u32 level = is->num_levels - 1;
+    const IntegrityStorageLevel* lv = &is->levels[level];
+    u8* dst = (u8*)buffer;
+
+    if (offset < 0 || offset > lv->size || size > (u64)(lv->size - offset))
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    Result rc = 0;
+    mutexLock(&is->mutex);
+
+    while (R_SUCCEEDED(rc) && size > 0) {
+        s64 block = offset / lv->block_size;
+        s64 block_offset = block * lv->block_size;
+        s64 end = offset + size;
+
+        // Whole blocks (including a partial block at the end of the level) are read in place
+        s64 run_end = end == lv->size ? end : end - end % lv->block_size;
+        if (run_end - offset > (s64)INTEGRITY_STORAGE_MAX_RUN_BLOCKS * lv->block_size)
+            run_end = offset + (s64)INTEGRITY_STORAGE_MAX_RUN_BLOCKS * lv->block_size;
+
+        if (offset == block_offset && run_end > offset) {
+            u64 run_size = run_end - offset;
+            rc = _integrityStorageReadRaw(is, lv->offset + offset, dst, run_size);
+            if (R_SUCCEEDED(rc))
+                rc = _integrityStorageVerifyRun(is, level, block, dst, run_size);
+            if (R_FAILED(rc))
+                break;
+
+            offset += run_size;
+            dst += run_size;
+            size -= run_size;
+            continue;
+        }
+
+        u64 block_size = lv->size - block_offset < lv->block_size ? lv->size - block_offset : lv->block_size;
+        if (is->data_block_index != block) {
+            is->data_block_index = -1;
+            rc = _integrityStorageReadRaw(is, lv->offset + block_offset, is->data_block, block_size);
+            if (R_SUCCEEDED(rc))
+                rc = _integrityStorageVerifyRun(is, level, block, is->data_block, block_size);
+            if (R_FAILED(rc))
+                break;
+
+            is->data_block_index = block;
+        }
+
+        u64 pos = offset - block_offset;
+        u64 copy = block_size - pos < size ? block_size - pos : size;
+        memcpy(dst, is->data_block + pos, copy);
+        offset += copy;
+        dst += copy;
+        size -= copy;
+    }
+
+    mutexUnlock(&is->mutex);
+    return rc;
+}
@@ -0,0 +1,121 @@
+#include <malloc.h>
+#include "types.h"
+#include "result.h"
+#include "kernel/svc.h"
+#include "kernel/mutex.h"
+#include "kernel/detect.h"
+#include "kernel/virtmem.h"
+#include "runtime/env.h"
+#include "runtime/large_buffer.h"
+
+/// Size of the area of the alias region reserved for large buffers, at most \ref LARGE_BUFFER_MAX_BLOCKS blocks.
+__attribute__((weak)) size_t __nx_large_buffer_region_size = 0x40000000;
+
+static Mutex g_largeBufferMutex;
+static bool g_largeBufferInit;
+static u8* g_largeBufferBase;
+static u32 g_largeBufferNumBlocks;
+static u64 g_largeBufferUsed[LARGE_BUFFER_MAX_BLOCKS / 64];
+static u16 g_largeBufferRunLength[LARGE_BUFFER_MAX_BLOCKS];   // Number of blocks of the buffer starting at each block.
+
+static void _largeBufferSetup(void) {
+    g_largeBufferInit = true;
+
+    if (!kernelAbove300() || !envIsSyscallHinted(0x2C) || !envIsSyscallHinted(0x2D))
+        return;
+
+    u32 num_blocks = __nx_large_buffer_region_size / LARGE_BUFFER_BLOCK_SIZE;
+    if (num_blocks > LARGE_BUFFER_MAX_BLOCKS)
+        num_blocks = LARGE_BUFFER_MAX_BLOCKS;
+    if (!num_blocks)
+        return;
+
+    // Over-reserve so the blocks can be aligned.
+    u8* addr = (u8*)virtmemReserveAlias((size_t)(num_blocks + 1) * LARGE_BUFFER_BLOCK_SIZE);
+    if (!addr)
+        return;
+
+    g_largeBufferBase = (u8*)(((uintptr_t)addr + LARGE_BUFFER_BLOCK_SIZE - 1) &~ (uintptr_t)(LARGE_BUFFER_BLOCK_SIZE - 1));
+    g_largeBufferNumBlocks = num_blocks;
+}
+
+static inline bool _largeBufferIsUsed(u32 block) {
+    return g_largeBufferUsed[block / 64] & (UINT64_C(1) << (block % 64));
+}
+
+static void _largeBufferMark(u32 first, u32 count, bool used) {
+    for (u32 i = first; i < first + count; i++) {
+        if (used)
+            g_largeBufferUsed[i / 64] |= UINT64_C(1) << (i % 64);
+        else
+            g_largeBufferUsed[i / 64] &= ~(UINT64_C(1) << (i % 64));
+    }
+}
+
+static void* _largeBufferAllocBlocks(u32 count) {
+    void* ptr = NULL;
+
+    mutexLock(&g_largeBufferMutex);
+    if (!g_largeBufferInit)
+        _largeBufferSetup();
+
+    // First fit.
+    u32 run = 0;
+    for (u32 i = 0; i < g_largeBufferNumBlocks && !ptr; i++) {
+        if (_largeBufferIsUsed(i)) {
+            run = 0;
+            continue;
+        }
+
+        if (++run < count)
+            continue;
+
+        u32 first = i + 1 - count;
+        u8* addr = g_largeBufferBase + (size_t)first * LARGE_BUFFER_BLOCK_SIZE;
+        if (R_FAILED(svcMapPhysicalMemory(addr, (size_t)count * LARGE_BUFFER_BLOCK_SIZE)))
+            break;
+
+        _largeBufferMark(first, count, true);
+        g_largeBufferRunLength[first] = count;
+        ptr = addr;
+    }
+    mutexUnlock(&g_largeBufferMutex);
+
+    return ptr;
+}
+
+void* largeBufferAlloc(size_t size) {
+    size = (size + 0xFFF) &~ 0xFFF;
+    if (!size)
+        size = 0x1000;
+
+    if (size >= LARGE_BUFFER_BLOCK_SIZE) {
+        size_t count = (size + LARGE_BUFFER_BLOCK_SIZE - 1) / LARGE_BUFFER_BLOCK_SIZE;
+        void* ptr = count <= LARGE_BUFFER_MAX_BLOCKS ? _largeBufferAllocBlocks(count) : NULL;
+        if (ptr)
+            return ptr;
+    }
+
+    return memalign(0x1000, size);
+}
+
+void largeBufferFree(void* ptr) {
+    if (!ptr)
+        return;
+
+    u8* p = (u8*)ptr;
+    if (!g_largeBufferBase || p < g_largeBufferBase || p >= g_largeBufferBase + (size_t)g_largeBufferNumBlocks * LARGE_BUFFER_BLOCK_SIZE) {
+        free(ptr);
+        return;
+    }
+
+    u32 first = (p - g_largeBufferBase) / LARGE_BUFFER_BLOCK_SIZE;
+
+    mutexLock(&g_largeBufferMutex);
+    u32 count = g_largeBufferRunLength[first];
+    if (count && R_SUCCEEDED(svcUnmapPhysicalMemory(p, (size_t)count * LARGE_BUFFER_BLOCK_SIZE))) {
+        _largeBufferMark(first, count, false);
+        g_largeBufferRunLength[first] = 0;
+    }
+    mutexUnlock(&g_largeBufferMutex);
+}
@@ -0,0 +1,123 @@
+#include <malloc.h>
+#include "types.h"
+#include "result.h"
+#include "kernel/svc.h"
+#include "kernel/mutex.h"
+#include "kernel/thread.h"
+#include "kernel/tmem.h"
+#include "runtime/mem_pressure.h"
+
+/// Available memory below which \ref memPressureCheck trims caches, 0 to disable.
+__attribute__((weak)) size_t __nx_mem_pressure_threshold = 0x800000;
+
+static Mutex g_memPressureMutex;
+static MemPressureCache* g_memPressureCaches; // Sorted by priority
+static size_t g_memPressureThreshold = SIZE_MAX; // SIZE_MAX until memPressureSetThreshold is called
+
+static size_t _memPressureGetThreshold(void) {
+    size_t threshold = __atomic_load_n(&g_memPressureThreshold, __ATOMIC_RELAXED);
+    return threshold != SIZE_MAX ? threshold : __nx_mem_pressure_threshold;
+}
+
+void memPressureRegister(MemPressureCache* c, const char* name, s32 priority, MemPressureTrimFunc trim, void* userdata) {
+    c->name = name;
+    c->priority = priority;
+    c->trim = trim;
+    c->userdata = userdata;
+    c->trimmed = 0;
+
+    mutexLock(&g_memPressureMutex);
+    MemPressureCache** pos = &g_memPressureCaches;
+    while (*pos && (*pos)->priority <= priority)
+        pos = &(*pos)->next;
+    c->next = *pos;
+    *pos = c;
+    mutexUnlock(&g_memPressureMutex);
+}
+
+void memPressureUnregister(MemPressureCache* c) {
+    mutexLock(&g_memPressureMutex);
+    for (MemPressureCache** pos = &g_memPressureCaches; *pos; pos = &(*pos)->next) {
+        if (*pos == c) {
+            *pos = c->next;
+            break;
+        }
+    }
+    c->next = NULL;
+    mutexUnlock(&g_memPressureMutex);
+}
+
+Result memPressureGetUsage(MemPressureUsage* out) {
+    // The heap is mapped as a whole at startup, so what newlib hasn't handed out yet is free memory too.
+    extern char* fake_heap_start;
+    extern char* fake_heap_end;
+
+    u64 mem_total = 0, mem_used = 0;
+    Result rc = svcGetInfo(&mem_total, InfoType_TotalMemorySize, CUR_PROCESS_HANDLE, 0);
+    if (R_SUCCEEDED(rc))
+        rc = svcGetInfo(&mem_used, InfoType_UsedMemorySize, CUR_PROCESS_HANDLE, 0);
+    if (R_FAILED(rc))
+        return rc;
+
+    size_t heap_size = fake_heap_end - fake_heap_start;
+    struct mallinfo mi = mallinfo();
+    if (heap_size > (size_t)mi.uordblks) {
+        u64 heap_free = heap_size - mi.uordblks;
+        mem_used = mem_used > heap_free ? mem_used - heap_free : 0;
+    }
+
+    out->total = mem_total;
+    out->used = mem_used;
+    return 0;
+}
+
+static u64 _memPressureGetAvailable(void) {
+    MemPressureUsage usage;
+    if (R_FAILED(memPressureGetUsage(&usage)))
+        return 0;
+    return usage.total > usage.used ? usage.total - usage.used : 0;
+}
+
+size_t memPressureTrim(size_t bytes) {
+    size_t freed = 0;
+
+    mutexLock(&g_memPressureMutex);
+
+    // The built-in caches don't report what they free, it's measured instead.
+    u64 avail = _memPressureGetAvailable();
+    threadStackCacheFlush();
+    tmemCacheFlush();
+    u64 new_avail = _memPressureGetAvailable();
+    if (new_avail > avail)
+        freed = new_avail - avail;
+
+    for (MemPressureCache* c = g_memPressureCaches; c && freed < bytes; c = c->next) {
+        size_t cur = c->trim(bytes - freed, c->userdata);
+        c->trimmed += cur;
+        freed += cur;
+    }
+
+    mutexUnlock(&g_memPressureMutex);
+    return freed;
+}
+
+Result memPressureCheck(size_t* out_freed) {
+    MemPressureUsage usage;
+    size_t freed = 0;
+
+    Result rc = memPressureGetUsage(&usage);
+    if (R_SUCCEEDED(rc)) {
+        u64 avail = usage.total > usage.used ? usage.total - usage.used : 0;
+        size_t threshold = _memPressureGetThreshold();
+        if (avail < threshold)
+            freed = memPressureTrim(threshold - avail);
+    }
+
+    if (out_freed)
+        *out_freed = freed;
+    return rc;
+}
+
+void memPressureSetThreshold(size_t bytes) {
+    __atomic_store_n(&g_memPressureThreshold, bytes, __ATOMIC_RELAXED);
+}
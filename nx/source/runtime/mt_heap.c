@@ -0,0 +1,551 @@
+#include <string.h>
+#include <reent.h>
+#include "types.h"
+#include "result.h"
+#include "kernel/svc.h"
+#include "kernel/mutex.h"
+#include "kernel/thread.h"
+#include "kernel/detect.h"
+#include "kernel/virtmem.h"
+#include "runtime/env.h"
+#include "runtime/mt_heap.h"
+
+#define PAGE_SHIFT      16
+#define SPAN_HDR_SIZE   0x40
+#define NUM_CLASSES     32
+
+// Two-level page map from 64KiB pages of the 39-bit address space to their span
+#define PAGEMAP_LEAF_BITS  13
+#define PAGEMAP_ROOT_BITS  (39 - PAGE_SHIFT - PAGEMAP_LEAF_BITS)
+
+enum {
+    SpanType_Free,
+    SpanType_Small,
+    SpanType_Large,
+};
+
+typedef struct MtSpan MtSpan;
+
+// Header at the start of every span. Free spans are runs of pages owned by the page heap, small spans are
+// one-page slabs of a size class owned by an arena, large spans hold one allocation.
+struct MtSpan {
+    u32 num_pages;
+    u8  type;
+    u8  size_class;
+    u8  arena;
+    bool in_partial;
+    MtSpan* next;
+    MtSpan* prev;
+    void* free_list;
+    u32 num_used;
+    u32 bump;           // Offset of the first never allocated object.
+};
+
+_Static_assert(sizeof(MtSpan) <= SPAN_HDR_SIZE, "MtSpan must fit in the span header");
+
+typedef struct {
+    alignas(0x40) Mutex mutex;
+    MtSpan* partial[NUM_CLASSES];   // Slabs with free objects.
+} MtArena;
+
+typedef struct {
+    void* head[NUM_CLASSES];
+    u32 count[NUM_CLASSES];
+} MtThreadCache;
+
+static const u16 g_classSize[NUM_CLASSES] = {
+    16, 32, 48, 64, 80, 96, 112, 128,
+    160, 192, 224, 256, 320, 384, 448, 512,
+    640, 768, 896, 1024, 1280, 1536, 1792, 2048,
+    2560, 3072, 3584, 4096, 5120, 6144, 7168, 8192,
+};
+
+static MtArena g_arenas[MT_HEAP_NUM_ARENAS];
+
+static Mutex g_pageMutex;
+static MtSpan* g_freeSpans;
+static MtSpan** g_pageMap[1 << PAGEMAP_ROOT_BITS];
+
+static Mutex g_cacheMutex;
+static s32 g_cacheSlot = -1;
+static bool g_cacheSlotInit;
+
+static bool g_physUnavailable;
+
+static inline u32 _mtHeapSizeClass(size_t size) {
+    if (size <= 128)
+        return size ? (size - 1) >> 4 : 0;
+
+    // 4 classes per power of two above 128
+    u32 lg = 63 - __builtin_clzll(size - 1);
+    return 8 + (lg - 7) * 4 + ((size - 1) >> (lg - 2)) - 4;
+}
+
+static inline u32 _mtHeapCacheLimit(u32 c) {
+    u32 limit = 0x8000 / g_classSize[c];
+    return limit < 4 ? 4 : limit > 128 ? 128 : limit;
+}
+
+static inline MtSpan** _mtHeapPageMapEntry(uintptr_t addr) {
+    uintptr_t page = addr >> PAGE_SHIFT;
+    if (page >> (PAGEMAP_ROOT_BITS + PAGEMAP_LEAF_BITS))
+        return NULL;
+
+    MtSpan** leaf = __atomic_load_n(&g_pageMap[page >> PAGEMAP_LEAF_BITS], __ATOMIC_ACQUIRE);
+    return leaf ? &leaf[page & ((1 << PAGEMAP_LEAF_BITS) - 1)] : NULL;
+}
+
+static inline MtSpan* _mtHeapSpanOf(const void* ptr) {
+    MtSpan** entry = _mtHeapPageMapEntry((uintptr_t)ptr);
+    return entry ? *entry : NULL;
+}
+
+static void _mtHeapSetPages(MtSpan* s, u32 first, u32 count) {
+    for (u32 i = first; i < first + count; i++)
+        *_mtHeapPageMapEntry((uintptr_t)s + ((uintptr_t)i << PAGE_SHIFT)) = s;
+}
+
+// Gets memory from the newlib heap, aligned to a page.
+static void* _mtHeapSbrk(size_t size) {
+    struct _reent* r = _REENT;
+    uintptr_t cur = (uintptr_t)_sbrk_r(r, 0);
+    if (cur == (uintptr_t)-1)
+        return NULL;
+
+    size_t pad = -cur & (MT_HEAP_PAGE_SIZE - 1);
+    uintptr_t p = (uintptr_t)_sbrk_r(r, pad + size);
+    if (p == (uintptr_t)-1)
+        return NULL;
+
+    return (void*)(p + pad);
+}
+
+// Maps physical memory in the alias region, once the newlib heap is exhausted.
+static void* _mtHeapMapPhysical(size_t size) {
+    if (g_physUnavailable)
+        return NULL;
+
+    void* addr = NULL;
+    if (kernelAbove300() && envIsSyscallHinted(0x2C))
+        addr = virtmemReserveAlias(size);
+
+    if (addr && R_FAILED(svcMapPhysicalMemory(addr, size))) {
+        // Either not permitted, or out of physical memory.
+        virtmemFreeAlias(addr, size);
+        addr = NULL;
+    }
+
+    if (!addr)
+        g_physUnavailable = true;
+    return addr;
+}
+
+static void _mtHeapListInsert(MtSpan** head, MtSpan* s) {
+    s->prev = NULL;
+    s->next = *head;
+    if (*head)
+        (*head)->prev = s;
+    *head = s;
+}
+
+static void _mtHeapListRemove(MtSpan** head, MtSpan* s) {
+    if (s->prev)
+        s->prev->next = s->next;
+    else
+        *head = s->next;
+    if (s->next)
+        s->next->prev = s->prev;
+}
+
+// Page heap, called with g_pageMutex held. The first and last pages of free runs map to their header,
+// all pages of other spans do.
+static void _mtHeapPageFree(MtSpan* s) {
+    s->type = SpanType_Free;
+
+    // Coalesce with the neighbouring free runs.
+    MtSpan** entry = _mtHeapPageMapEntry((uintptr_t)s - 1);
+    MtSpan* prev = entry ? *entry : NULL;
+    if (prev && prev->type == SpanType_Free) {
+        _mtHeapListRemove(&g_freeSpans, prev);
+        prev->num_pages += s->num_pages;
+        s = prev;
+    }
+
+    entry = _mtHeapPageMapEntry((uintptr_t)s + ((uintptr_t)s->num_pages << PAGE_SHIFT));
+    MtSpan* next = entry ? *entry : NULL;
+    if (next && next->type == SpanType_Free) {
+        _mtHeapListRemove(&g_freeSpans, next);
+        s->num_pages += next->num_pages;
+    }
+
+    _mtHeapSetPages(s, 0, 1);
+    _mtHeapSetPages(s, s->num_pages - 1, 1);
+    _mtHeapListInsert(&g_freeSpans, s);
+}
+
+static bool _mtHeapGrow(u32 num_pages) {
+    size_t size = ((size_t)num_pages + 2) << PAGE_SHIFT;
+    if (size < MT_HEAP_CHUNK_SIZE)
+        size = MT_HEAP_CHUNK_SIZE;
+
+    uintptr_t mem = (uintptr_t)_mtHeapSbrk(size);
+    if (!mem)
+        mem = (uintptr_t)_mtHeapMapPhysical(size);
+    if (!mem)
+        return false;
+
+    // Page map leaves are taken from the start of the new memory.
+    u32 root_first = mem >> (PAGE_SHIFT + PAGEMAP_LEAF_BITS);
+    u32 root_last = (mem + size - 1) >> (PAGE_SHIFT + PAGEMAP_LEAF_BITS);
+    if (root_last >= (1 << PAGEMAP_ROOT_BITS))
+        return false;
+
+    for (u32 root = root_first; root <= root_last; root++) {
+        if (g_pageMap[root])
+            continue;
+        memset((void*)mem, 0, MT_HEAP_PAGE_SIZE);
+        __atomic_store_n(&g_pageMap[root], (MtSpan**)mem, __ATOMIC_RELEASE);
+        mem += MT_HEAP_PAGE_SIZE;
+        size -= MT_HEAP_PAGE_SIZE;
+    }
+
+    MtSpan* s = (MtSpan*)mem;
+    s->num_pages = size >> PAGE_SHIFT;
+    s->type = SpanType_Large;
+    _mtHeapPageFree(s);
+    return true;
+}
+
+static MtSpan* _mtHeapPageAlloc(u32 num_pages) {
+    MtSpan* best;
+
+    for (;;) {
+        best = NULL;
+        for (MtSpan* s = g_freeSpans; s; s = s->next)
+            if (s->num_pages >= num_pages && (!best || s->num_pages < best->num_pages))
+                best = s;
+
+        if (best)
+            break;
+        if (!_mtHeapGrow(num_pages))
+            return NULL;
+    }
+
+    _mtHeapListRemove(&g_freeSpans, best);
+    if (best->num_pages > num_pages) {
+        MtSpan* rest = (MtSpan*)((uintptr_t)best + ((uintptr_t)num_pages << PAGE_SHIFT));
+        rest->type = SpanType_Free;
+        rest->num_pages = best->num_pages - num_pages;
+        _mtHeapSetPages(rest, 0, 1);
+        _mtHeapSetPages(rest, rest->num_pages - 1, 1);
+        _mtHeapListInsert(&g_freeSpans, rest);
+        best->num_pages = num_pages;
+    }
+
+    _mtHeapSetPages(best, 0, num_pages);
+    return best;
+}
+
+static inline u32 _mtHeapCurArena(void) {
+    return svcGetCurrentProcessorNumber() % MT_HEAP_NUM_ARENAS;
+}
+
+// Takes up to max objects of a size class from an arena, as a linked list.
+static u32 _mtHeapArenaTake(u32 arena, u32 c, u32 max, void** out) {
+    MtArena* a = &g_arenas[arena];
+    u32 size = g_classSize[c];
+    void* list = NULL;
+    u32 n = 0;
+
+    mutexLock(&a->mutex);
+    while (n < max) {
+        MtSpan* s = a->partial[c];
+        if (!s) {
+            mutexLock(&g_pageMutex);
+            s = _mtHeapPageAlloc(1);
+            mutexUnlock(&g_pageMutex);
+            if (!s)
+                break;
+
+            s->type = SpanType_Small;
+            s->size_class = c;
+            s->arena = arena;
+            s->free_list = NULL;
+            s->num_used = 0;
+            s->bump = SPAN_HDR_SIZE;
+            s->in_partial = true;
+            _mtHeapListInsert(&a->partial[c], s);
+        }
+
+        while (n < max) {
+            void* obj;
+            if (s->free_list) {
+                obj = s->free_list;
+                s->free_list = *(void**)obj;
+            }
+            else if (s->bump + size <= MT_HEAP_PAGE_SIZE) {
+                obj = (u8*)s + s->bump;
+                s->bump += size;
+            }
+            else
+                break;
+
+            *(void**)obj = list;
+            list = obj;
+            s->num_used++;
+            n++;
+        }
+
+        if (!s->free_list && s->bump + size > MT_HEAP_PAGE_SIZE) {
+            _mtHeapListRemove(&a->partial[c], s);
+            s->in_partial = false;
+        }
+    }
+    mutexUnlock(&a->mutex);
+
+    *out = list;
+    return n;
+}
+
+// Returns an object to its slab, called with the slab's arena locked.
+static void _mtHeapSpanPut(MtArena* a, MtSpan* s, void* obj) {
+    u32 c = s->size_class;
+
+    *(void**)obj = s->free_list;
+    s->free_list = obj;
+    s->num_used--;
+
+    if (!s->in_partial) {
+        _mtHeapListInsert(&a->partial[c], s);
+        s->in_partial = true;
+    }
+
+    // Release empty slabs, but keep the last partial one of the class to avoid thrashing.
+    if (!s->num_used && (a->partial[c] != s || s->next)) {
+        _mtHeapListRemove(&a->partial[c], s);
+        mutexLock(&g_pageMutex);
+        _mtHeapPageFree(s);
+        mutexUnlock(&g_pageMutex);
+    }
+}
+
+static void _mtHeapReleaseList(void* list) {
+    MtArena* locked = NULL;
+
+    while (list) {
+        void* obj = list;
+        list = *(void**)obj;
+
+        MtSpan* s = _mtHeapSpanOf(obj);
+        MtArena* a = &g_arenas[s->arena];
+        if (a != locked) {
+            if (locked)
+                mutexUnlock(&locked->mutex);
+            mutexLock(&a->mutex);
+            locked = a;
+        }
+        _mtHeapSpanPut(a, s, obj);
+    }
+
+    if (locked)
+        mutexUnlock(&locked->mutex);
+}
+
+static void _mtHeapCacheFlush(MtThreadCache* tc) {
+    for (u32 c = 0; c < NUM_CLASSES; c++) {
+        _mtHeapReleaseList(tc->head[c]);
+        tc->head[c] = NULL;
+        tc->count[c] = 0;
+    }
+}
+
+static void _mtHeapCacheDestroy(void* p) {
+    MtThreadCache* tc = (MtThreadCache*)p;
+    _mtHeapCacheFlush(tc);
+
+    *(void**)tc = NULL;
+    _mtHeapReleaseList(tc);
+}
+
+static MtThreadCache* _mtHeapGetCache(void) {
+    if (!__atomic_load_n(&g_cacheSlotInit, __ATOMIC_ACQUIRE)) {
+        mutexLock(&g_cacheMutex);
+        if (!g_cacheSlotInit) {
+            g_cacheSlot = threadTlsAlloc(_mtHeapCacheDestroy);
+            __atomic_store_n(&g_cacheSlotInit, true, __ATOMIC_RELEASE);
+        }
+        mutexUnlock(&g_cacheMutex);
+    }
+
+    if (g_cacheSlot < 0)
+        return NULL;
+
+    MtThreadCache* tc = (MtThreadCache*)threadTlsGet(g_cacheSlot);
+    if (!tc) {
+        void* obj;
+        if (!_mtHeapArenaTake(_mtHeapCurArena(), _mtHeapSizeClass(sizeof(MtThreadCache)), 1, &obj))
+            return NULL;
+
+        tc = (MtThreadCache*)obj;
+        memset(tc, 0, sizeof(*tc));
+        threadTlsSet(g_cacheSlot, tc);
+    }
+
+    return tc;
+}
+
+static void* _mtHeapSmallAlloc(u32 c) {
+    MtThreadCache* tc = _mtHeapGetCache();
+    void* obj;
+
+    if (!tc)
+        return _mtHeapArenaTake(_mtHeapCurArena(), c, 1, &obj) ? obj : NULL;
+
+    if (!tc->head[c]) {
+        tc->count[c] = _mtHeapArenaTake(_mtHeapCurArena(), c, _mtHeapCacheLimit(c) / 2, &tc->head[c]);
+        if (!tc->head[c])
+            return NULL;
+    }
+
+    obj = tc->head[c];
+    tc->head[c] = *(void**)obj;
+    tc->count[c]--;
+    return obj;
+}
+
+static void* _mtHeapLargeAlloc(size_t size, size_t alignment) {
+    // Pages are aligned to MT_HEAP_PAGE_SIZE, so an aligned pointer is at most alignment bytes into the span.
+    // Zero-sized allocations still take a byte, for the pointer to stay inside the span.
+    size_t offset = alignment > SPAN_HDR_SIZE ? alignment : SPAN_HDR_SIZE;
+    if (size > ((size_t)1 << 38))
+        return NULL;
+    if (!size)
+        size = 1;
+
+    u32 num_pages = (size + offset + MT_HEAP_PAGE_SIZE - 1) >> PAGE_SHIFT;
+    mutexLock(&g_pageMutex);
+    MtSpan* s = _mtHeapPageAlloc(num_pages);
+    if (s)
+        s->type = SpanType_Large;
+    mutexUnlock(&g_pageMutex);
+
+    if (!s)
+        return NULL;
+    return (void*)(((uintptr_t)s + SPAN_HDR_SIZE + alignment - 1) & ~(uintptr_t)(alignment - 1));
+}
+
+void* mtHeapAlloc(size_t size) {
+    if (size > MT_HEAP_SMALL_MAX)
+        return _mtHeapLargeAlloc(size, 16);
+    return _mtHeapSmallAlloc(_mtHeapSizeClass(size));
+}
+
+void* mtHeapAlignedAlloc(size_t alignment, size_t size) {
+    if (alignment & (alignment - 1))
+        return NULL;
+    if (alignment <= 16)
+        return mtHeapAlloc(size);
+
+    // Slab objects start at a multiple of their size past the header.
+    if (alignment <= SPAN_HDR_SIZE && size <= MT_HEAP_SMALL_MAX) {
+        for (u32 c = _mtHeapSizeClass(size); c < NUM_CLASSES; c++)
+            if (!(g_classSize[c] & (alignment - 1)))
+                return _mtHeapSmallAlloc(c);
+    }
+
+    return _mtHeapLargeAlloc(size, alignment);
+}
+
+void* mtHeapCalloc(size_t count, size_t size) {
+    size_t total;
+    if (__builtin_mul_overflow(count, size, &total))
+        return NULL;
+
+    void* ptr = mtHeapAlloc(total);
+    if (ptr)
+        memset(ptr, 0, total);
+    return ptr;
+}
+
+size_t mtHeapUsableSize(void* ptr) {
+    MtSpan* s = _mtHeapSpanOf(ptr);
+    if (!s)
+        return 0;
+    if (s->type == SpanType_Small)
+        return g_classSize[s->size_class];
+    return (uintptr_t)s + ((uintptr_t)s->num_pages << PAGE_SHIFT) - (uintptr_t)ptr;
+}
+
+void* mtHeapRealloc(void* ptr, size_t size) {
+    if (!ptr)
+        return mtHeapAlloc(size);
+
+    if (!size) {
+        mtHeapFree(ptr);
+        return NULL;
+    }
+
+    // Keep the allocation if it fits and wouldn't waste more than half of it.
+    size_t usable = mtHeapUsableSize(ptr);
+    if (size <= usable && size >= usable / 2)
+        return ptr;
+
+    void* new_ptr = mtHeapAlloc(size);
+    if (new_ptr) {
+        memcpy(new_ptr, ptr, size < usable ? size : usable);
+        mtHeapFree(ptr);
+    }
+    return new_ptr;
+}
+
+void mtHeapFree(void* ptr) {
+    if (!ptr)
+        return;
+
+    MtSpan* s = _mtHeapSpanOf(ptr);
+    if (!s)
+        return;
+
+    if (s->type == SpanType_Large) {
+        mutexLock(&g_pageMutex);
+        _mtHeapPageFree(s);
+        mutexUnlock(&g_pageMutex);
+        return;
+    }
+
+    if (s->type != SpanType_Small)
+        return;
+
+    u32 c = s->size_class;
+    MtThreadCache* tc = _mtHeapGetCache();
+    if (!tc) {
+        *(void**)ptr = NULL;
+        _mtHeapReleaseList(ptr);
+        return;
+    }
+
+    *(void**)ptr = tc->head[c];
+    tc->head[c] = ptr;
+
+    u32 limit = _mtHeapCacheLimit(c);
+    if (++tc->count[c] > limit) {
+        // Keep half of the objects, return the others to their slabs.
+        void** link = &tc->head[c];
+        for (u32 i = 0; i < limit / 2; i++)
+            link = (void**)*link;
+
+        void* rest = *link;
+        *link = NULL;
+        tc->count[c] = limit / 2;
+        _mtHeapReleaseList(rest);
+    }
+}
+
+void mtHeapThreadFlush(void) {
+    if (!__atomic_load_n(&g_cacheSlotInit, __ATOMIC_ACQUIRE) || g_cacheSlot < 0)
+        return;
+
+    MtThreadCache* tc = (MtThreadCache*)threadTlsGet(g_cacheSlot);
+    if (tc)
+        _mtHeapCacheFlush(tc);
+}
@@ -0,0 +1,65 @@
+#include <errno.h>
+#include <malloc.h>
+#include <reent.h>
+#include <string.h>
+#include "runtime/mt_heap.h"
+
+// Referenced by MT_HEAP_OVERRIDE_MALLOC, which pulls this object in before newlib's allocator would be.
+const int __nx_mt_heap_malloc_override = 1;
+
+static inline void* _setErrno(struct _reent* r, void* ptr) {
+    if (!ptr)
+        r->_errno = ENOMEM;
+    return ptr;
+}
+
+void* _malloc_r(struct _reent* r, size_t size) {
+    return _setErrno(r, mtHeapAlloc(size));
+}
+
+void _free_r(struct _reent* r, void* ptr) {
+    mtHeapFree(ptr);
+}
+
+void* _realloc_r(struct _reent* r, void* ptr, size_t size) {
+    void* new_ptr = mtHeapRealloc(ptr, size);
+    return size ? _setErrno(r, new_ptr) : new_ptr;
+}
+
+void* _calloc_r(struct _reent* r, size_t count, size_t size) {
+    return _setErrno(r, mtHeapCalloc(count, size));
+}
+
+void* _memalign_r(struct _reent* r, size_t alignment, size_t size) {
+    return _setErrno(r, mtHeapAlignedAlloc(alignment, size));
+}
+
+void* _valloc_r(struct _reent* r, size_t size) {
+    return _setErrno(r, mtHeapAlignedAlloc(0x1000, size));
+}
+
+void* _pvalloc_r(struct _reent* r, size_t size) {
+    return _setErrno(r, mtHeapAlignedAlloc(0x1000, (size + 0xFFF) &~ 0xFFF));
+}
+
+size_t _malloc_usable_size_r(struct _reent* r, void* ptr) {
+    return mtHeapUsableSize(ptr);
+}
+
+// The rest of newlib's malloc interface, so that none of its allocator gets linked in.
+int _malloc_trim_r(struct _reent* r, size_t pad) {
+    return 0;
+}
+
+struct mallinfo _mallinfo_r(struct _reent* r) {
+    struct mallinfo info;
+    memset(&info, 0, sizeof(info));
+    return info;
+}
+
+void _malloc_stats_r(struct _reent* r) {
+}
+
+int _mallopt_r(struct _reent* r, int param, int value) {
+    return 0;
+}
@@ -10,6 +10,7 @@
 #include "../internal.h"
 #include "types.h"
 #include "runtime/env.h"
+#include "runtime/object_pool.h"
 #include "arm/counter.h"
 #include "kernel/mutex.h"
 #include "kernel/condvar.h"
@@ -27,6 +28,9 @@ struct __pthread_t
     void *rc;
 };
 
+// Thread objects are churned by thread pools, recycle them.
+static ObjectPool g_pthreadPool;
+
 void __attribute__((weak)) NORETURN __libnx_exit(int rc);
 
 extern const u8 __tdata_lma[];
@@ -36,6 +40,9 @@ extern u8 __tls_start[];
 /// TimeType passed to timeGetCurrentTime() during time initialization. If that fails and __nx_time_type isn't TimeType_Default, timeGetCurrentTime() will be called again with TimeType_Default.
 __attribute__((weak)) TimeType __nx_time_type = TimeType_Default;
 
+/// Interval in seconds at which CLOCK_REALTIME is checked against the time service (on the next query), to correct the drift of the system tick. 0 disables the checks.
+__attribute__((weak)) u32 __nx_time_resync_interval = 60;
+
 static inline int errno_from_result(Result res)
 {
     switch (R_VALUE(res)) {
@@ -183,7 +190,7 @@ int __syscall_thread_create(struct __pthread_t **thread, void* (*func)(void*), v
     if (R_FAILED(rc))
         return EPERM;
 
-    struct __pthread_t* t = (struct __pthread_t*)malloc(sizeof(struct __pthread_t));
+    struct __pthread_t* t = (struct __pthread_t*)objectPoolAlloc(&g_pthreadPool);
     if (!t)
         return ENOMEM;
 
@@ -217,7 +224,7 @@ int __syscall_thread_create(struct __pthread_t **thread, void* (*func)(void*), v
 _error2:
     threadClose(&t->thr);
 _error1:
-    free(t);
+    objectPoolFree(&g_pthreadPool, t);
     return ENOMEM;
 }
 
@@ -232,7 +239,7 @@ void* __syscall_thread_join(struct __pthread_t *thread)
 
     void* ret = thread->rc;
     threadClose(&thread->thr);
-    free(thread);
+    objectPoolFree(&g_pthreadPool, thread);
 
     return ret;
 }
@@ -283,7 +290,10 @@ int sched_getcpu(void)
 }
 
 static u64 __boottime;
-static u64 __bootticks;
+static bool __realtime_valid;
+static u64 __realtime_base;     // CLOCK_REALTIME at system tick 0, in nanoseconds
+static u64 __realtime_sync_tick;
+static Mutex __realtime_sync_mutex;
 
 // setup boot time variables
 void __libnx_init_time(void)
@@ -296,10 +306,11 @@ void __libnx_init_time(void)
 
     Result rc =  timeGetCurrentTime(__nx_time_type, &__boottime);
     if (R_FAILED(rc) && __nx_time_type != TimeType_Default) rc =  timeGetCurrentTime(TimeType_Default, &__boottime);
-    if (R_FAILED(rc)) {
-        __boottime = UINT64_MAX;
-    } else {
-        __bootticks = armGetSystemTick();
+    if (R_SUCCEEDED(rc)) {
+        u64 tick = armGetSystemTick();
+        __realtime_sync_tick = tick;
+        __atomic_store_n(&__realtime_base, __boottime * 1000000000ULL - armTicksToNs(tick), __ATOMIC_RELAXED);
+        __atomic_store_n(&__realtime_valid, true, __ATOMIC_RELEASE);
     }
 
     if (R_SUCCEEDED(rc)) rc = timeToCalendarTimeWithMyRule(__boottime, NULL, &info);
@@ -340,11 +351,83 @@ void __libnx_init_time(void)
     }
 }
 
+static bool __time_lazy;
+static Mutex __time_lazy_mutex;
+
+// defer the boot time setup to the first clock query, see __nx_appinit_lazy
+void __libnx_init_time_lazy(void)
+{
+    __atomic_store_n(&__time_lazy, true, __ATOMIC_RELEASE);
+}
+
+static inline void __libnx_ensure_time(void)
+{
+    if (!__atomic_load_n(&__time_lazy, __ATOMIC_ACQUIRE))
+        return;
+
+    mutexLock(&__time_lazy_mutex);
+    if (__time_lazy) {
+        __libnx_init_time();
+        __atomic_store_n(&__time_lazy, false, __ATOMIC_RELEASE);
+    }
+    mutexUnlock(&__time_lazy_mutex);
+}
+
 static const u64 nsec_clockres =  1000000000ULL / 19200000ULL;
 
+// The time service only has a resolution of one second: the base is only moved when it's off by more than that.
+static void __libnx_resync_time(u64 now)
+{
+    u64 interval = armNsToTicks(__nx_time_resync_interval * 1000000000ULL);
+    if (!interval || now - __atomic_load_n(&__realtime_sync_tick, __ATOMIC_RELAXED) < interval)
+        return;
+
+    // Other threads keep using the current base rather than waiting on the IPC.
+    if (!mutexTryLock(&__realtime_sync_mutex))
+        return;
+
+    if (now - __realtime_sync_tick >= interval) {
+        u64 secs;
+        Result rc = timeGetCurrentTime(__nx_time_type, &secs);
+        if (R_FAILED(rc) && __nx_time_type != TimeType_Default) rc = timeGetCurrentTime(TimeType_Default, &secs);
+
+        u64 tick = armGetSystemTick();
+        __atomic_store_n(&__realtime_sync_tick, tick, __ATOMIC_RELAXED);
+        if (R_SUCCEEDED(rc)) {
+            u64 expected = __realtime_base + armTicksToNs(tick);
+            u64 actual = secs * 1000000000ULL;
+            if (expected < actual || expected >= actual + 1000000000ULL)
+                __atomic_store_n(&__realtime_base, actual + 500000000ULL - armTicksToNs(tick), __ATOMIC_RELAXED);
+        }
+    }
+
+    mutexUnlock(&__realtime_sync_mutex);
+}
+
+static inline bool __libnx_get_realtime(u64 *out_ns)
+{
+    __libnx_ensure_time();
+    if (!__atomic_load_n(&__realtime_valid, __ATOMIC_ACQUIRE))
+        return false;
+
+    u64 now = armGetSystemTick();
+    __libnx_resync_time(now);
+    *out_ns = __atomic_load_n(&__realtime_base, __ATOMIC_RELAXED) + armTicksToNs(now);
+    return true;
+}
+
+static inline bool __libnx_is_monotonic_clock(clockid_t clock_id)
+{
+#ifdef CLOCK_MONOTONIC_RAW
+    if (clock_id == CLOCK_MONOTONIC_RAW)
+        return true;
+#endif
+    return clock_id == CLOCK_MONOTONIC;
+}
+
 int __syscall_clock_getres(clockid_t clock_id, struct timespec *tp)
 {
-    if(clock_id != CLOCK_MONOTONIC && clock_id != CLOCK_REALTIME) {
+    if(!__libnx_is_monotonic_clock(clock_id) && clock_id != CLOCK_REALTIME) {
         errno = EINVAL;
         return -1;
     }
@@ -360,24 +443,25 @@ int __syscall_clock_getres(clockid_t clock_id, struct timespec *tp)
 
 int __syscall_clock_gettime(clockid_t clock_id, struct timespec *tp)
 {
-    if(clock_id != CLOCK_MONOTONIC && clock_id != CLOCK_REALTIME) {
+    u64 ns;
+
+    if(!__libnx_is_monotonic_clock(clock_id) && clock_id != CLOCK_REALTIME) {
         errno = EINVAL;
         return -1;
     }
     if(tp) {
 
-        if(__boottime == UINT64_MAX) {
+        // The monotonic clocks are the system tick itself, they don't depend on the time service.
+        if(clock_id != CLOCK_REALTIME)
+            ns = armTicksToNs(armGetSystemTick());
+        else if(!__libnx_get_realtime(&ns)) {
             errno = EIO;
             return -1;
         }
 
-        u64 now=armGetSystemTick() - __bootticks;
-
-        u64 __bootsecs = now / 19200000ULL;
-
-        tp->tv_sec =  __bootsecs + __boottime;
-        u64 nsecs = (now -  __bootsecs * 19200000ULL) * 10000ULL / 192ULL;
-        tp->tv_nsec = nsecs - nsecs % nsec_clockres;
+        u64 secs = ns / 1000000000ULL;
+        tp->tv_sec =  secs;
+        tp->tv_nsec = ns - secs * 1000000000ULL;
         return 0;
     } else {
         errno = EFAULT;
@@ -389,17 +473,16 @@ int __syscall_gettod_r(struct _reent *ptr, struct timeval *tp, struct timezone *
 {
     if (tp != NULL) {
 
-        if(__boottime == UINT64_MAX) {
+        u64 ns;
+        if(!__libnx_get_realtime(&ns)) {
             ptr->_errno = EIO;
             return -1;
         }
 
-        u64 now=armGetSystemTick() - __bootticks;
-
-        u64 __bootsecs = now / 19200000ULL;
-
-        tp->tv_sec =  __bootsecs + __boottime;
-        tp->tv_usec = (now -  __bootsecs * 19200000ULL) * 10ULL / 192ULL;
+        u64 usecs = ns / 1000ULL;
+        u64 secs = usecs / 1000000ULL;
+        tp->tv_sec =  secs;
+        tp->tv_usec = usecs - secs * 1000000ULL;
     }
 
     if (tz != NULL) {
@@ -435,7 +518,13 @@ void newlibSetup(void)
     tv->tls_tp     = __tls_start-2*sizeof(void*); // subtract size of Thread Control Block (TCB)
     tv->handle     = envGetMainThreadHandle();
 
+    // TLS slots which don't fit in the TLS region
+    static void* main_tls_slots[THREAD_TLS_NUM_SLOTS - THREAD_TLS_INLINE_SLOTS];
+    ((void**)((u8*)armGetTls() + THREAD_TLS_SLOTS_OFFSET))[THREAD_TLS_INLINE_SLOTS] = main_tls_slots;
+
     u32 tls_size = __tdata_lma_end - __tdata_lma;
     if (tls_size)
         memcpy(__tls_start, __tdata_lma, tls_size);
+
+    objectPoolCreate(&g_pthreadPool, sizeof(struct __pthread_t), 0);
 }
@@ -1,4 +1,5 @@
 #include "runtime/nxlink.h"
+#include "runtime/async_log.h"
 
 #include <string.h>
 #include <stdio.h>
@@ -6,10 +7,11 @@
 #include <sys/errno.h>
 #include <arpa/inet.h>
 #include <unistd.h>
+#include <sys/iosupport.h>
 
 static int sock = -1;
 
-int nxlinkStdio(void)
+static int _nxlinkConnect(void)
 {
     int ret = -1;
     struct sockaddr_in srv_addr;
@@ -30,6 +32,14 @@ int nxlinkStdio(void)
         return -1;
     }
 
+    return sock;
+}
+
+int nxlinkStdio(void)
+{
+    if (_nxlinkConnect() < 0)
+        return -1;
+
     // redirect stdout
     fflush(stdout);
     dup2(sock, STDOUT_FILENO);
@@ -39,3 +49,75 @@ int nxlinkStdio(void)
 
     return sock;
 }
+
+static AsyncLog async_log;
+static const devoptab_t* async_prev[2];
+
+static void _nxlinkAsyncSink(void* userdata, const void* data, size_t size)
+{
+    const char* ptr = (const char*)data;
+    while (size) {
+        ssize_t ret = send(sock, ptr, size, 0);
+        if (ret <= 0)
+            break;
+        ptr += ret;
+        size -= ret;
+    }
+}
+
+static ssize_t _nxlinkAsyncWrite(struct _reent *r, void *fd, const char *ptr, size_t len)
+{
+    asyncLogWrite(&async_log, ptr, len);
+    return len;
+}
+
+static const devoptab_t dotab_nxlink_async = {
+    .name = "nxlink",
+    .write_r = _nxlinkAsyncWrite,
+};
+
+int nxlinkStdioAsync(int prio)
+{
+    int ret = _nxlinkConnect();
+    if (ret < 0)
+        return ret;
+
+    if (R_FAILED(asyncLogCreate(&async_log, _nxlinkAsyncSink, NULL, prio, -2))) {
+        close(sock);
+        sock = -1;
+        return -1;
+    }
+
+    fflush(stdout);
+    fflush(stderr);
+    async_prev[0] = devoptab_list[STD_OUT];
+    async_prev[1] = devoptab_list[STD_ERR];
+    devoptab_list[STD_OUT] = &dotab_nxlink_async;
+    devoptab_list[STD_ERR] = &dotab_nxlink_async;
+
+    return sock;
+}
+
+void nxlinkStdioAsyncFlush(void)
+{
+    fflush(stdout);
+    fflush(stderr);
+    asyncLogFlush(&async_log);
+}
+
+u64 nxlinkStdioAsyncGetDroppedCount(void)
+{
+    return asyncLogGetDroppedCount(&async_log);
+}
+
+void nxlinkStdioAsyncExit(void)
+{
+    fflush(stdout);
+    fflush(stderr);
+    devoptab_list[STD_OUT] = async_prev[0];
+    devoptab_list[STD_ERR] = async_prev[1];
+
+    asyncLogClose(&async_log);
+    close(sock);
+    sock = -1;
+}
@@ -0,0 +1,243 @@
+#include <malloc.h>
+#include <string.h>
+#include "types.h"
+#include "result.h"
+#include "kernel/thread.h"
+#include "runtime/object_pool.h"
+
+// The free list head packs a pointer with a tag bumped on every update, so that a pop racing against
+// another pop and push of the same object fails its CAS (ABA). User pointers fit in 40 bits.
+#define PTR_BITS   40
+#define PTR_MASK   ((UINT64_C(1) << PTR_BITS) - 1)
+#define SLAB_HDR_SIZE 0x10
+
+typedef struct ObjectPoolMagazine ObjectPoolMagazine;
+
+struct ObjectPoolMagazine {
+    ObjectPoolMagazine* next;
+    ObjectPool* pool;
+    void* head;
+    u32 count;
+    bool in_use;
+};
+
+static inline void* _objectPoolTaggedPtr(u64 v) {
+    return (void*)(uintptr_t)(v & PTR_MASK);
+}
+
+static inline u64 _objectPoolTagged(void* ptr, u64 old) {
+    return (uintptr_t)ptr | ((old + (UINT64_C(1) << PTR_BITS)) & ~PTR_MASK);
+}
+
+// Push a chain of objects linked through their first word.
+static void _objectPoolPush(ObjectPool* p, void* first, void* last) {
+    u64 old = __atomic_load_n(&p->free_list, __ATOMIC_RELAXED);
+    do {
+        *(void**)last = _objectPoolTaggedPtr(old);
+    } while (!__atomic_compare_exchange_n(&p->free_list, &old, _objectPoolTagged(first, old), true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+static void* _objectPoolPop(ObjectPool* p) {
+    u64 old = __atomic_load_n(&p->free_list, __ATOMIC_ACQUIRE);
+    void* obj;
+    do {
+        obj = _objectPoolTaggedPtr(old);
+        if (!obj)
+            return NULL;
+        // Slabs are only freed on close, so this read is safe even if another thread took the object meanwhile.
+    } while (!__atomic_compare_exchange_n(&p->free_list, &old, _objectPoolTagged(*(void* volatile*)obj, old), true, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE));
+    return obj;
+}
+
+// Carves a new slab, returning its objects as a chain.
+static void* _objectPoolGrow(ObjectPool* p, void** out_last) {
+    u8* slab = (u8*)memalign(0x10, SLAB_HDR_SIZE + p->objs_per_slab * p->obj_size);
+    if (!slab)
+        return NULL;
+
+    void* head = __atomic_load_n(&p->slabs, __ATOMIC_RELAXED);
+    do {
+        *(void**)slab = head;
+    } while (!__atomic_compare_exchange_n(&p->slabs, &head, slab, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+    u8* obj = slab + SLAB_HDR_SIZE;
+    for (u32 i = 0; i < p->objs_per_slab - 1; i++, obj += p->obj_size)
+        *(void**)obj = obj + p->obj_size;
+    *(void**)obj = NULL;
+
+    *out_last = obj;
+    return slab + SLAB_HDR_SIZE;
+}
+
+static void _objectPoolMagazineRelease(void* arg) {
+    ObjectPoolMagazine* m = (ObjectPoolMagazine*)arg;
+
+    if (m->head) {
+        void* last = m->head;
+        while (*(void**)last)
+            last = *(void**)last;
+        _objectPoolPush(m->pool, m->head, last);
+    }
+
+    m->head = NULL;
+    m->count = 0;
+    __atomic_store_n(&m->in_use, false, __ATOMIC_RELEASE);
+}
+
+static ObjectPoolMagazine* _objectPoolGetMagazine(ObjectPool* p) {
+    ObjectPoolMagazine* m = (ObjectPoolMagazine*)threadTlsGet(p->tls_slot);
+    if (m)
+        return m;
+
+    // Reuse the magazine of a thread which exited.
+    for (m = __atomic_load_n((ObjectPoolMagazine**)&p->magazines, __ATOMIC_ACQUIRE); m; m = m->next) {
+        bool expected = false;
+        if (!__atomic_load_n(&m->in_use, __ATOMIC_RELAXED) &&
+            __atomic_compare_exchange_n(&m->in_use, &expected, true, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+            break;
+    }
+
+    if (!m) {
+        m = (ObjectPoolMagazine*)calloc(1, sizeof(ObjectPoolMagazine));
+        if (!m)
+            return NULL;
+
+        m->pool = p;
+        m->in_use = true;
+        ObjectPoolMagazine* head = __atomic_load_n((ObjectPoolMagazine**)&p->magazines, __ATOMIC_RELAXED);
+        do {
+            m->next = head;
+        } while (!__atomic_compare_exchange_n((ObjectPoolMagazine**)&p->magazines, &head, m, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+    }
+
+    threadTlsSet(p->tls_slot, m);
+    return m;
+}
+
+Result objectPoolCreate(ObjectPool* p, size_t obj_size, u32 magazine_size) {
+    memset(p, 0, sizeof(*p));
+    p->obj_size = obj_size < sizeof(void*) ? sizeof(void*) : obj_size;
+    p->obj_size = (p->obj_size + 0xF) &~ 0xF;
+    p->objs_per_slab = (OBJECT_POOL_SLAB_SIZE - SLAB_HDR_SIZE) / p->obj_size;
+    if (p->objs_per_slab < 16)
+        p->objs_per_slab = 16;
+    p->magazine_size = magazine_size;
+    p->tls_slot = -1;
+
+    if (magazine_size) {
+        p->tls_slot = threadTlsAlloc(_objectPoolMagazineRelease);
+        if (p->tls_slot < 0)
+            return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+    }
+
+    return 0;
+}
+
+void objectPoolClose(ObjectPool* p) {
+    if (p->tls_slot >= 0)
+        threadTlsFree(p->tls_slot);
+    p->tls_slot = -1;
+
+    ObjectPoolMagazine* m = (ObjectPoolMagazine*)p->magazines;
+    while (m) {
+        ObjectPoolMagazine* next = m->next;
+        free(m);
+        m = next;
+    }
+
+    void* slab = p->slabs;
+    while (slab) {
+        void* next = *(void**)slab;
+        free(slab);
+        slab = next;
+    }
+
+    p->magazines = NULL;
+    p->slabs = NULL;
+    p->free_list = 0;
+}
+
+void* objectPoolAlloc(ObjectPool* p) {
+    ObjectPoolMagazine* m = p->magazine_size ? _objectPoolGetMagazine(p) : NULL;
+    void* obj;
+
+    if (m && m->head) {
+        obj = m->head;
+        m->head = *(void**)obj;
+        m->count--;
+        return obj;
+    }
+
+    obj = _objectPoolPop(p);
+    if (m && obj) {
+        // Refill half of the magazine.
+        for (u32 i = 1; i < (p->magazine_size + 1) / 2; i++) {
+            void* extra = _objectPoolPop(p);
+            if (!extra)
+                break;
+            *(void**)extra = m->head;
+            m->head = extra;
+            m->count++;
+        }
+    }
+
+    if (!obj) {
+        void* last;
+        obj = _objectPoolGrow(p, &last);
+        if (!obj)
+            return NULL;
+
+        // Keep the rest of the slab for this thread, within the magazine limit.
+        void* rest = *(void**)obj;
+        if (m) {
+            u32 n = 0;
+            void* keep_last = NULL;
+            for (void* cur = rest; cur && n < p->magazine_size; cur = *(void**)cur, n++)
+                keep_last = cur;
+
+            if (keep_last) {
+                void* remaining = *(void**)keep_last;
+                *(void**)keep_last = m->head;
+                m->head = rest;
+                m->count += n;
+                rest = remaining;
+            }
+        }
+
+        if (rest)
+            _objectPoolPush(p, rest, last);
+    }
+
+    return obj;
+}
+
+void objectPoolFree(ObjectPool* p, void* obj) {
+    if (!obj)
+        return;
+
+    ObjectPoolMagazine* m = p->magazine_size ? _objectPoolGetMagazine(p) : NULL;
+    if (!m) {
+        _objectPoolPush(p, obj, obj);
+        return;
+    }
+
+    *(void**)obj = m->head;
+    m->head = obj;
+
+    if (++m->count > p->magazine_size) {
+        // Keep half of the objects, give the others back to the shared list.
+        u32 keep = p->magazine_size / 2;
+        void** link = &m->head;
+        for (u32 i = 0; i < keep; i++)
+            link = (void**)*link;
+
+        void* first = *link;
+        void* last = first;
+        while (*(void**)last)
+            last = *(void**)last;
+
+        *link = NULL;
+        m->count = keep;
+        _objectPoolPush(p, first, last);
+    }
+}
@@ -9,6 +9,11 @@
 #include <sys/socket.h>
 
 #include "result.h"
+#include "kernel/mutex.h"
+#include "kernel/condvar.h"
+#include "kernel/thread.h"
+#include "kernel/uevent.h"
+#include "arm/counter.h"
 //#include "kernel/random.h"
 #include "services/sfdnsres.h"
 #include "services/nifm.h"
@@ -27,6 +32,23 @@ static size_t g_resolverHostByAddrBufferSize    = 0x200;  // ResolverOptionLocal
 static size_t g_resolverAddrInfoBufferSize      = 0x1000; // ResolverOptionLocalKey::GetAddrInfoBufferSizeUnsigned64
 static size_t g_resolverAddrInfoHintsBufferSize = 0x400;  // ResolverOptionLocalKey::GetAddrInfoHintsBufferSizeUnsigned64
 
+// Local resolver cache in front of sfdnsres. sfdnsres does not report record TTLs, so entries expire after a fixed time.
+__attribute__((weak)) u32 __nx_resolver_cache_entries = 32;
+__attribute__((weak)) u32 __nx_resolver_cache_ttl_ms = 30000;
+__attribute__((weak)) u32 __nx_resolver_cache_negative_ttl_ms = 5000;
+
+typedef struct {
+    char *key;
+    void *data;         // Serialized sfdnsres output, NULL for negative entries
+    size_t size;
+    int error;          // EAI_* (getaddrinfo) or h_errno (gethostbyname) of negative entries
+    u64 expires;
+    u64 last_used;
+} ResolverCacheEntry;
+
+static Mutex g_resolverCacheMutex;
+static ResolverCacheEntry *g_resolverCache;
+
 Result resolverGetLastResult(void) {
     return g_resolverResult;
 }
@@ -77,6 +99,103 @@ Result resolverRemoveIpAddressFromCache(u32 ip) {
     return MAKERESULT(Module_Libnx, LibnxError_NotInitialized); // not implemented
 }
 
+static bool _resolverCacheEnabled(void) {
+    return __nx_resolver_cache_entries != 0 && !g_resolverDisableDnsCache;
+}
+
+static bool _resolverCacheMakeKey(char *key, size_t size, const char *node, const char *service, const struct addrinfo *hints) {
+    int len;
+    if (hints)
+        len = snprintf(key, size, "a%d,%d,%d,%d,%d|%s|%s", !g_resolverDisableServiceDiscovery,
+            hints->ai_flags, hints->ai_family, hints->ai_socktype, hints->ai_protocol, node ? node : "", service ? service : "");
+    else
+        len = snprintf(key, size, "a%d|%s|%s", !g_resolverDisableServiceDiscovery, node ? node : "", service ? service : "");
+    return len > 0 && (size_t)len < size;
+}
+
+// Must be called with the cache mutex held.
+static ResolverCacheEntry *_resolverCacheFind(const char *key) {
+    if (!g_resolverCache)
+        return NULL;
+
+    u64 now = armGetSystemTick();
+    for (u32 i = 0; i < __nx_resolver_cache_entries; i++) {
+        ResolverCacheEntry *e = &g_resolverCache[i];
+        if (e->key && strcmp(e->key, key) == 0) {
+            if (now >= e->expires)
+                return NULL;
+            e->last_used = now;
+            return e;
+        }
+    }
+    return NULL;
+}
+
+static void _resolverCacheInsert(const char *key, const void *data, size_t size, int error) {
+    u32 ttl_ms = data ? __nx_resolver_cache_ttl_ms : __nx_resolver_cache_negative_ttl_ms;
+    if (!ttl_ms)
+        return;
+
+    char *key_copy = strdup(key);
+    void *data_copy = data ? malloc(size) : NULL;
+    if (!key_copy || (data && !data_copy)) {
+        free(key_copy);
+        free(data_copy);
+        return;
+    }
+    if (data)
+        memcpy(data_copy, data, size);
+
+    mutexLock(&g_resolverCacheMutex);
+    if (!g_resolverCache)
+        g_resolverCache = (ResolverCacheEntry *)calloc(__nx_resolver_cache_entries, sizeof(ResolverCacheEntry));
+
+    ResolverCacheEntry *e = NULL;
+    if (g_resolverCache) {
+        // Reuse the entry for the same key, else an empty one, else the least recently used one.
+        for (u32 i = 0; i < __nx_resolver_cache_entries; i++) {
+            ResolverCacheEntry *cur = &g_resolverCache[i];
+            if (cur->key && strcmp(cur->key, key) == 0) {
+                e = cur;
+                break;
+            }
+            if (!e || (e->key && (!cur->key || cur->last_used < e->last_used)))
+                e = cur;
+        }
+    }
+
+    if (e) {
+        free(e->key);
+        free(e->data);
+        u64 now = armGetSystemTick();
+        e->key = key_copy;
+        e->data = data_copy;
+        e->size = size;
+        e->error = error;
+        e->last_used = now;
+        e->expires = now + armNsToTicks(ttl_ms * 1000000ULL);
+        key_copy = NULL;
+        data_copy = NULL;
+    }
+    mutexUnlock(&g_resolverCacheMutex);
+
+    free(key_copy);
+    free(data_copy);
+}
+
+void resolverClearCache(void) {
+    mutexLock(&g_resolverCacheMutex);
+    if (g_resolverCache) {
+        for (u32 i = 0; i < __nx_resolver_cache_entries; i++) {
+            free(g_resolverCache[i].key);
+            free(g_resolverCache[i].data);
+        }
+        free(g_resolverCache);
+        g_resolverCache = NULL;
+    }
+    mutexUnlock(&g_resolverCacheMutex);
+}
+
 static struct hostent *_resolverDeserializeHostent(const void *out_he_serialized) {
     const char *buf = (const char *)out_he_serialized;
     const char *pos, *pos_aliases, *pos_addresses;
@@ -259,20 +378,24 @@ static struct addrinfo_serialized_hdr *_resolverSerializeAddrInfoList(size_t *ou
     return out;
 }
 
-static struct addrinfo *_resolverDeserializeAddrInfo(size_t *out_len, const struct addrinfo_serialized_hdr *hdr) {
-    struct addrinfo_node {
-        struct addrinfo info;
-        struct sockaddr_storage addr;
-        char canonname[];
-    };
+struct addrinfo_node {
+    struct addrinfo info;
+    struct sockaddr_storage addr;
+};
 
+// Returns the serialized size of a node, and the size of its canonical name including the terminator.
+static size_t _resolverSerializedAddrInfoSize(const struct addrinfo_serialized_hdr *hdr, size_t *out_name_size) {
     size_t subsize1 = hdr->ai_addrlen ? ntohl(hdr->ai_addrlen) : 4;
     size_t subsize2 = strlen((const char *)hdr + sizeof(struct addrinfo_serialized_hdr) + subsize1) + 1;
-    struct addrinfo_node *node = malloc(sizeof(struct addrinfo_node) + subsize2);
+    *out_name_size = subsize2;
+    return sizeof(struct addrinfo_serialized_hdr) + subsize1 + subsize2;
+}
 
-    *out_len = sizeof(struct addrinfo_serialized_hdr) + subsize1 + subsize2;
-    if (!node)
-        return NULL;
+// Deserializes a node into preallocated storage. The canonical name, if any, is copied to *names, which is advanced past it.
+static size_t _resolverDeserializeAddrInfo(struct addrinfo_node *node, char **names, const struct addrinfo_serialized_hdr *hdr) {
+    size_t subsize2;
+    size_t len = _resolverSerializedAddrInfoSize(hdr, &subsize2);
+    size_t subsize1 = len - sizeof(struct addrinfo_serialized_hdr) - subsize2;
 
     node->info.ai_flags = ntohl(hdr->ai_flags);
     node->info.ai_family = ntohl(hdr->ai_family);
@@ -313,38 +436,63 @@ static struct addrinfo *_resolverDeserializeAddrInfo(size_t *out_len, const stru
     if (subsize2 == 1)
         node->info.ai_canonname = NULL;
     else {
-        node->info.ai_canonname = node->canonname;
+        node->info.ai_canonname = *names;
         memcpy(node->info.ai_canonname, (const u8 *)hdr + sizeof(struct addrinfo_serialized_hdr) + subsize1, subsize2);
+        *names += subsize2;
     }
 
     node->info.ai_next = NULL;
 
-    return &node->info;
+    return len;
+}
+
+// Size of a serialized addrinfo list, including the sentinel.
+static size_t _resolverSerializedAddrInfoListSize(const struct addrinfo_serialized_hdr *hdr, size_t max_size) {
+    const u8 *start = (const u8 *)hdr;
+    size_t pos = 0;
+
+    while (pos + sizeof(struct addrinfo_serialized_hdr) <= max_size) {
+        const struct addrinfo_serialized_hdr *cur = (const struct addrinfo_serialized_hdr *)(start + pos);
+        if (cur->magic != htonl(0xBEEFCAFE))
+            break;
+
+        size_t subsize1 = cur->ai_addrlen ? ntohl(cur->ai_addrlen) : 4;
+        size_t name_pos = pos + sizeof(struct addrinfo_serialized_hdr) + subsize1;
+        if (name_pos >= max_size)
+            return max_size;
+        pos = name_pos + strnlen((const char *)start + name_pos, max_size - name_pos) + 1;
+    }
+
+    pos += 4;
+    return pos < max_size ? pos : max_size;
 }
 
 static struct addrinfo *_resolverDeserializeAddrInfoList(struct addrinfo_serialized_hdr *hdr) {
-    struct addrinfo *first = NULL, *prev = NULL;
-
-    while (hdr->magic == htonl(0xBEEFCAFE)) {
-        size_t len;
-        struct addrinfo *node = _resolverDeserializeAddrInfo(&len, hdr);
-        if (!node) {
-            if (first)
-                freeaddrinfo(first);
-            return NULL;
-        }
+    // First pass: size the whole list, so that it is returned as a single allocation (released by freeaddrinfo with one free).
+    size_t n = 0, names_size = 0;
+    for (const u8 *pos = (const u8 *)hdr; ((const struct addrinfo_serialized_hdr *)pos)->magic == htonl(0xBEEFCAFE); n++) {
+        size_t name_size;
+        pos += _resolverSerializedAddrInfoSize((const struct addrinfo_serialized_hdr *)pos, &name_size);
+        if (name_size > 1)
+            names_size += name_size;
+    }
 
-        if (!first)
-            first = node;
+    if (!n)
+        return NULL;
 
-        if (prev)
-            prev->ai_next = node;
+    struct addrinfo_node *nodes = malloc(n * sizeof(struct addrinfo_node) + names_size);
+    if (!nodes)
+        return NULL;
 
-        prev = node;
-        hdr = (struct addrinfo_serialized_hdr *)((u8 *)hdr + len);
+    char *names = (char *)(nodes + n);
+    const u8 *pos = (const u8 *)hdr;
+    for (size_t i = 0; i < n; i++) {
+        pos += _resolverDeserializeAddrInfo(&nodes[i], &names, (const struct addrinfo_serialized_hdr *)pos);
+        if (i)
+            nodes[i-1].info.ai_next = &nodes[i].info;
     }
 
-    return first;
+    return &nodes[0].info;
 }
 
 void freehostent(struct hostent *he) {
@@ -352,10 +500,8 @@ void freehostent(struct hostent *he) {
 }
 
 void freeaddrinfo(struct addrinfo *ai) {
-    for (struct addrinfo *node = ai, *next; node; node = next) {
-        next = node->ai_next;
-        free(node);
-    }
+    // The whole list is a single allocation, see _resolverDeserializeAddrInfoList.
+    free(ai);
 }
 
 struct hostent *gethostbyname(const char *name) {
@@ -371,6 +517,27 @@ struct hostent *gethostbyname(const char *name) {
         return NULL;
     }
 
+    char key[0x120];
+    bool use_cache = _resolverCacheEnabled();
+    if (use_cache && snprintf(key, sizeof(key), "h%d|%s", !g_resolverDisableServiceDiscovery, name) >= (int)sizeof(key))
+        use_cache = false;
+
+    if (use_cache) {
+        mutexLock(&g_resolverCacheMutex);
+        ResolverCacheEntry *e = _resolverCacheFind(key);
+        if (e) {
+            struct hostent *ret = NULL;
+            h_errno = e->error;
+            if (e->data)
+                ret = _resolverDeserializeHostent(e->data);
+            mutexUnlock(&g_resolverCacheMutex);
+            g_resolverCancelHandle = 0;
+            g_resolverResult = 0;
+            return ret;
+        }
+        mutexUnlock(&g_resolverCacheMutex);
+    }
+
     void *out_serialized = malloc(g_resolverHostByNameBufferSize);
     if (!out_serialized) {
         h_errno = NETDB_INTERNAL;
@@ -403,6 +570,14 @@ struct hostent *gethostbyname(const char *name) {
     if (h_errno == NETDB_SUCCESS)
         ret = _resolverDeserializeHostent(out_serialized);
 
+    // Only definitive answers are cached: transient failures (TRY_AGAIN, IPC errors) are retried next time.
+    if (use_cache) {
+        if (ret)
+            _resolverCacheInsert(key, out_serialized, g_resolverHostByNameBufferSize, NETDB_SUCCESS);
+        else if (h_errno == HOST_NOT_FOUND || h_errno == NO_DATA)
+            _resolverCacheInsert(key, NULL, 0, h_errno);
+    }
+
     free(out_serialized);
     return ret;
 }
@@ -498,6 +673,29 @@ int getaddrinfo(const char *node, const char *service, const struct addrinfo *hi
         return EAI_SYSTEM;
     }
 
+    char key[0x200];
+    bool use_cache = _resolverCacheEnabled() && _resolverCacheMakeKey(key, sizeof(key), node, service, hints);
+
+    if (use_cache) {
+        mutexLock(&g_resolverCacheMutex);
+        ResolverCacheEntry *e = _resolverCacheFind(key);
+        if (e) {
+            s32 ret = e->error;
+            if (e->data) {
+                *res = _resolverDeserializeAddrInfoList((struct addrinfo_serialized_hdr *)e->data);
+                if (!*res) {
+                    errno = ENOMEM;
+                    ret = EAI_MEMORY;
+                }
+            }
+            mutexUnlock(&g_resolverCacheMutex);
+            g_resolverCancelHandle = 0;
+            g_resolverResult = 0;
+            return ret;
+        }
+        mutexUnlock(&g_resolverCacheMutex);
+    }
+
     size_t hints_sz = 0;
     struct addrinfo_serialized_hdr *hints_serialized = NULL;
     if (hints) {
@@ -548,6 +746,13 @@ int getaddrinfo(const char *node, const char *service, const struct addrinfo *hi
         }
     }
 
+    if (use_cache) {
+        if (ret == 0)
+            _resolverCacheInsert(key, out_serialized, _resolverSerializedAddrInfoListSize(out_serialized, g_resolverAddrInfoBufferSize), 0);
+        else if (ret == EAI_NONAME || ret == EAI_NODATA)
+            _resolverCacheInsert(key, NULL, 0, ret);
+    }
+
     free(out_serialized);
     return ret;
 }
@@ -616,3 +821,149 @@ struct servent *getservent(void) { h_errno = NO_RECOVERY; errno = ENOSYS; return
 void sethostent(int a) { (void)a;}
 void setnetent(int a) { (void)a;}
 void setprotoent(int a) { (void)a; }
+
+typedef enum {
+    ResolverAsyncState_Pending,
+    ResolverAsyncState_Running,
+    ResolverAsyncState_Done,
+} ResolverAsyncState;
+
+// Must be called with the pool mutex held.
+static void _resolverAsyncComplete(ResolverAsync *r, ResolverAsyncQuery *q) {
+    q->state = ResolverAsyncState_Done;
+    ueventSignal(&r->progress_event);
+    if (++r->num_done == r->num_queries)
+        ueventSignal(&r->done_event);
+}
+
+static void _resolverAsyncThreadFunc(void *arg) {
+    ResolverAsync *r = (ResolverAsync *)arg;
+
+    // The cancel handle applies to the next resolver command of this thread. Getting it may need IPC, so it's done without the mutex held.
+    u32 cancel_handle = resolverGetCancelHandle();
+
+    mutexLock(&r->mutex);
+    for (;;) {
+        while (!r->should_exit && r->next_query >= r->num_queries)
+            condvarWait(&r->cond, &r->mutex);
+        if (r->should_exit)
+            break;
+
+        ResolverAsyncQuery *q = &r->queries[r->next_query++];
+        if (q->state != ResolverAsyncState_Pending)
+            continue; // Cancelled before it started
+
+        q->cancel_handle = cancel_handle;
+        q->state = ResolverAsyncState_Running;
+        mutexUnlock(&r->mutex);
+
+        // sfdnsres requests open their own session, so workers never share one.
+        struct addrinfo *result = NULL;
+        int error = getaddrinfo(q->node, q->service, q->hints, &result);
+        int sys_errno = errno;
+
+        if (cancel_handle == 0)
+            cancel_handle = resolverGetCancelHandle();
+
+        mutexLock(&r->mutex);
+        q->result = error == 0 ? result : NULL;
+        q->error = error;
+        q->sys_errno = error == EAI_SYSTEM ? sys_errno : 0;
+        q->cancel_handle = 0;
+        _resolverAsyncComplete(r, q);
+    }
+    mutexUnlock(&r->mutex);
+}
+
+Result resolverAsyncCreate(ResolverAsync *r, u32 num_threads, int prio, int cpuid) {
+    if (num_threads == 0 || num_threads > RESOLVER_ASYNC_MAX_THREADS)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    memset(r, 0, sizeof(*r));
+    mutexInit(&r->mutex);
+    condvarInit(&r->cond);
+    ueventCreate(&r->progress_event, true);
+    ueventCreate(&r->done_event, false);
+
+    Result rc = 0;
+    for (u32 i = 0; R_SUCCEEDED(rc) && i < num_threads; i++) {
+        rc = threadCreate(&r->threads[i], _resolverAsyncThreadFunc, r, NULL, 0x4000, prio, cpuid);
+        if (R_SUCCEEDED(rc)) {
+            rc = threadStart(&r->threads[i]);
+            if (R_FAILED(rc))
+                threadClose(&r->threads[i]);
+            else
+                r->num_threads++;
+        }
+    }
+
+    if (R_FAILED(rc))
+        resolverAsyncClose(r);
+    return rc;
+}
+
+void resolverAsyncClose(ResolverAsync *r) {
+    resolverAsyncCancel(r);
+
+    mutexLock(&r->mutex);
+    r->should_exit = true;
+    condvarWakeAll(&r->cond);
+    mutexUnlock(&r->mutex);
+
+    for (u32 i = 0; i < r->num_threads; i++) {
+        threadWaitForExit(&r->threads[i]);
+        threadClose(&r->threads[i]);
+    }
+    r->num_threads = 0;
+}
+
+int resolverAsyncStart(ResolverAsync *r, ResolverAsyncQuery *queries, u32 num_queries) {
+    mutexLock(&r->mutex);
+    if (r->num_done != r->num_queries) {
+        mutexUnlock(&r->mutex);
+        errno = EBUSY;
+        return -1;
+    }
+
+    for (u32 i = 0; i < num_queries; i++) {
+        queries[i].result = NULL;
+        queries[i].error = 0;
+        queries[i].sys_errno = 0;
+        queries[i].cancel_handle = 0;
+        queries[i].state = ResolverAsyncState_Pending;
+    }
+
+    r->queries = queries;
+    r->num_queries = num_queries;
+    r->next_query = 0;
+    r->num_done = 0;
+    ueventClear(&r->progress_event);
+    ueventClear(&r->done_event);
+    if (num_queries == 0)
+        ueventSignal(&r->done_event);
+    condvarWakeAll(&r->cond);
+    mutexUnlock(&r->mutex);
+    return 0;
+}
+
+void resolverAsyncCancel(ResolverAsync *r) {
+    mutexLock(&r->mutex);
+    for (u32 i = 0; i < r->num_queries; i++) {
+        ResolverAsyncQuery *q = &r->queries[i];
+        if (q->state == ResolverAsyncState_Pending) {
+            q->error = EAI_SYSTEM;
+            q->sys_errno = ECANCELED;
+            _resolverAsyncComplete(r, q);
+        }
+        else if (q->state == ResolverAsyncState_Running && q->cancel_handle)
+            resolverCancel(q->cancel_handle);
+    }
+    mutexUnlock(&r->mutex);
+}
+
+bool resolverAsyncIsQueryDone(ResolverAsync *r, const ResolverAsyncQuery *q) {
+    mutexLock(&r->mutex);
+    bool done = q->state == ResolverAsyncState_Done;
+    mutexUnlock(&r->mutex);
+    return done;
+}
@@ -0,0 +1,31 @@
+#include <sys/socket.h>
+#include "types.h"
+#include "runtime/trace.h"
+#include "runtime/devices/usb_comms.h"
+
+// Kept apart from trace.c, so that tracing doesn't pull in the socket and usb:ds code.
+
+void traceSinkSocket(void* userdata, const void* data, size_t size) {
+    int fd = (int)(intptr_t)userdata;
+    const char* p = (const char*)data;
+
+    while (size) {
+        ssize_t ret = send(fd, p, size, 0);
+        if (ret <= 0)
+            break;
+        p += ret;
+        size -= ret;
+    }
+}
+
+void traceSinkUsbComms(void* userdata, const void* data, size_t size) {
+    const u8* p = (const u8*)data;
+
+    while (size) {
+        size_t ret = usbCommsWrite(p, size);
+        if (!ret)
+            break;
+        p += ret;
+        size -= ret;
+    }
+}
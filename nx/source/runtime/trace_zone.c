@@ -0,0 +1,248 @@
+#include <malloc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "types.h"
+#include "result.h"
+#include "arm/counter.h"
+#include "kernel/svc.h"
+#include "kernel/mutex.h"
+#include "kernel/thread.h"
+#include "runtime/trace.h"
+#include "runtime/flight_recorder.h"
+
+// Interval at which the exporter drains the buffers
+#define TRACE_EXPORT_INTERVAL_NS 10000000ull
+
+static bool g_traceEnabled;
+static s32 g_traceTlsSlot = -1;
+
+static Mutex g_traceListMutex;
+static TraceBuffer* g_traceBuffers;
+static u64 g_traceDroppedDead;
+
+static Mutex g_traceDrainMutex;
+static Thread g_traceThread;
+static bool g_traceRunning;
+static bool g_traceShouldExit;
+static TraceSinkFn g_traceSink;
+static void* g_traceSinkUserdata;
+static char* g_traceStaging;
+static size_t g_traceStagingUsed;
+static bool g_traceFirstEvent;
+
+static void _traceBufferRelease(void* arg) {
+    TraceBuffer* buf = (TraceBuffer*)arg;
+    __atomic_store_n(&buf->dead, true, __ATOMIC_RELEASE);
+}
+
+static TraceBuffer* _traceGetBuffer(void) {
+    s32 slot = __atomic_load_n(&g_traceTlsSlot, __ATOMIC_ACQUIRE);
+    if (slot < 0)
+        return NULL;
+
+    TraceBuffer* buf = (TraceBuffer*)threadTlsGet(slot);
+    if (buf)
+        return buf;
+
+    // Events caused by exporting (e.g. the socket IPC) would feed themselves.
+    if (g_traceRunning && threadGetCurHandle() == g_traceThread.handle)
+        return NULL;
+
+    buf = (TraceBuffer*)calloc(1, sizeof(TraceBuffer));
+    if (!buf)
+        return NULL;
+
+    svcGetThreadId(&buf->thread_id, CUR_THREAD_HANDLE);
+    threadTlsSet(slot, buf);
+
+    mutexLock(&g_traceListMutex);
+    buf->next = g_traceBuffers;
+    g_traceBuffers = buf;
+    mutexUnlock(&g_traceListMutex);
+    return buf;
+}
+
+void traceRecord(const char* name, TraceEventType type) {
+#if defined(NX_FLIGHT_RECORDER)
+    flightRecorderRecord(FlightEventType_Trace, name, type, 0);
+#endif
+
+    if (!__atomic_load_n(&g_traceEnabled, __ATOMIC_RELAXED))
+        return;
+
+    u64 tick = armGetSystemTick();
+    TraceBuffer* buf = _traceGetBuffer();
+    if (!buf)
+        return;
+
+    u32 head = buf->head;
+    if (head - __atomic_load_n(&buf->tail, __ATOMIC_ACQUIRE) >= TRACE_THREAD_BUFFER_EVENTS) {
+        __atomic_add_fetch(&buf->dropped, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    TraceEvent* e = &buf->events[head % TRACE_THREAD_BUFFER_EVENTS];
+    e->tick = tick;
+    e->name = name;
+    e->type = type;
+    __atomic_store_n(&buf->head, head + 1, __ATOMIC_RELEASE);
+}
+
+void _traceScopeEnd(u8* scope) {
+    (void)scope;
+    traceRecord(NULL, TraceEventType_End);
+}
+
+void traceSetEnabled(bool enabled) {
+    // Without a TLS slot, nothing gets recorded anyway.
+    __atomic_store_n(&g_traceEnabled, enabled, __ATOMIC_RELAXED);
+}
+
+bool traceIsEnabled(void) {
+    return __atomic_load_n(&g_traceEnabled, __ATOMIC_RELAXED);
+}
+
+u64 traceGetDroppedCount(void) {
+    mutexLock(&g_traceListMutex);
+    u64 count = g_traceDroppedDead;
+    for (TraceBuffer* buf = g_traceBuffers; buf; buf = buf->next)
+        count += __atomic_load_n(&buf->dropped, __ATOMIC_RELAXED);
+    mutexUnlock(&g_traceListMutex);
+    return count;
+}
+
+static void _traceFlushStaging(void) {
+    if (g_traceStagingUsed)
+        g_traceSink(g_traceSinkUserdata, g_traceStaging, g_traceStagingUsed);
+    g_traceStagingUsed = 0;
+}
+
+static void _traceWriteEvent(u64 thread_id, const TraceEvent* e) {
+    static const char phases[] = { 'B', 'E', 'i' };
+
+    // Large enough for any event with a name truncated to 64 characters.
+    if (TRACE_EXPORT_BUFFER_SIZE - g_traceStagingUsed < 256)
+        _traceFlushStaging();
+
+    char* out = g_traceStaging + g_traceStagingUsed;
+    size_t len = 0;
+    if (!g_traceFirstEvent)
+        out[len++] = ',';
+    g_traceFirstEvent = false;
+
+    len += sprintf(out + len, "\n{\"ph\":\"%c\"", e->type <= TraceEventType_Instant ? phases[e->type] : 'i');
+    if (e->name) {
+        len += sprintf(out + len, ",\"name\":\"");
+        for (const char* p = e->name; *p && p - e->name < 64; p++) {
+            if (*p != '"' && *p != '\\' && (u8)*p >= 0x20)
+                out[len++] = *p;
+        }
+        out[len++] = '"';
+    }
+    if (e->type == TraceEventType_Instant)
+        len += sprintf(out + len, ",\"s\":\"t\"");
+
+    u64 ns = armTicksToNs(e->tick);
+    len += sprintf(out + len, ",\"ts\":%llu.%03u,\"pid\":1,\"tid\":%llu}",
+        (unsigned long long)(ns / 1000), (unsigned)(ns % 1000), (unsigned long long)thread_id);
+    g_traceStagingUsed += len;
+}
+
+static void _traceDrain(void) {
+    mutexLock(&g_traceDrainMutex);
+
+    mutexLock(&g_traceListMutex);
+    TraceBuffer** link = &g_traceBuffers;
+    mutexUnlock(&g_traceListMutex);
+
+    for (TraceBuffer* buf = *link; buf; buf = *link) {
+        bool dead = __atomic_load_n(&buf->dead, __ATOMIC_ACQUIRE);
+        u32 head = __atomic_load_n(&buf->head, __ATOMIC_ACQUIRE);
+        u32 tail = buf->tail;
+
+        for (; tail != head; tail++) {
+            _traceWriteEvent(buf->thread_id, &buf->events[tail % TRACE_THREAD_BUFFER_EVENTS]);
+            __atomic_store_n(&buf->tail, tail + 1, __ATOMIC_RELEASE);
+        }
+
+        // Buffers of exited threads are freed once drained
+        if (dead && tail == head) {
+            mutexLock(&g_traceListMutex);
+            *link = buf->next;
+            g_traceDroppedDead += buf->dropped;
+            mutexUnlock(&g_traceListMutex);
+            free(buf);
+        }
+        else
+            link = &buf->next;
+    }
+
+    _traceFlushStaging();
+    mutexUnlock(&g_traceDrainMutex);
+}
+
+static void _traceThreadFunc(void* arg) {
+    while (!__atomic_load_n(&g_traceShouldExit, __ATOMIC_ACQUIRE)) {
+        svcSleepThread(TRACE_EXPORT_INTERVAL_NS);
+        _traceDrain();
+    }
+}
+
+Result traceExportStart(TraceSinkFn sink, void* userdata, int prio, int cpuid) {
+    if (g_traceRunning)
+        return MAKERESULT(Module_Libnx, LibnxError_AlreadyInitialized);
+
+    // The slot is kept for the lifetime of the process, as threads may still hold buffers.
+    if (g_traceTlsSlot < 0) {
+        s32 slot = threadTlsAlloc(_traceBufferRelease);
+        if (slot < 0)
+            return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+        __atomic_store_n(&g_traceTlsSlot, slot, __ATOMIC_RELEASE);
+    }
+
+    g_traceStaging = (char*)malloc(TRACE_EXPORT_BUFFER_SIZE);
+    if (!g_traceStaging)
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+
+    g_traceSink = sink;
+    g_traceSinkUserdata = userdata;
+    g_traceStagingUsed = 0;
+    g_traceFirstEvent = true;
+    g_traceShouldExit = false;
+    sink(userdata, "[", 1);
+
+    Result rc = threadCreate(&g_traceThread, _traceThreadFunc, NULL, NULL, 0x4000, prio, cpuid);
+    if (R_SUCCEEDED(rc)) {
+        rc = threadStart(&g_traceThread);
+        if (R_FAILED(rc))
+            threadClose(&g_traceThread);
+    }
+
+    if (R_FAILED(rc)) {
+        free(g_traceStaging);
+        g_traceStaging = NULL;
+        return rc;
+    }
+
+    g_traceRunning = true;
+    traceSetEnabled(true);
+    return 0;
+}
+
+void traceExportStop(void) {
+    if (!g_traceRunning)
+        return;
+
+    traceSetEnabled(false);
+    __atomic_store_n(&g_traceShouldExit, true, __ATOMIC_RELEASE);
+    threadWaitForExit(&g_traceThread);
+    threadClose(&g_traceThread);
+
+    _traceDrain();
+    g_traceSink(g_traceSinkUserdata, "\n]\n", 3);
+
+    free(g_traceStaging);
+    g_traceStaging = NULL;
+    g_traceRunning = false;
+}
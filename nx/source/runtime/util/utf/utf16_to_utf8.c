@@ -1,3 +1,4 @@
+#include <arm_neon.h>
 #include "runtime/util/utf.h"
 
 ssize_t
@@ -12,6 +13,26 @@ utf16_to_utf8(uint8_t        *out,
 
   do
   {
+    /* ASCII fast path: 8 code points (16 bytes) at a time, as long as the load
+     * doesn't cross a page (the terminator may be right before it) and everything fits */
+    while(((uintptr_t)in & 0xFFF) <= 0x1000 - 16
+       && (out == NULL || rc + 8 <= len)
+       && SSIZE_MAX - 8 >= rc)
+    {
+      uint16x8_t v = vld1q_u16(in);
+      if(vmaxvq_u16(v) >= 0x80 || vminvq_u16(v) == 0)
+        break;
+
+      if(out != NULL)
+      {
+        vst1_u8(out, vmovn_u16(v));
+        out += 8;
+      }
+
+      in += 8;
+      rc += 8;
+    }
+
     units = decode_utf16(&code, in);
     if(units == -1)
       return -1;
@@ -1,3 +1,4 @@
+#include <arm_neon.h>
 #include "runtime/util/utf.h"
 
 ssize_t
@@ -12,6 +13,27 @@ utf8_to_utf16(uint16_t      *out,
 
   do
   {
+    /* ASCII fast path: 16 code points at a time, as long as the load doesn't
+     * cross a page (the terminator may be right before it) and everything fits */
+    while(((uintptr_t)in & 0xFFF) <= 0x1000 - 16
+       && (out == NULL || rc + 16 <= len)
+       && SSIZE_MAX - 16 >= rc)
+    {
+      uint8x16_t v = vld1q_u8(in);
+      if(vmaxvq_u8(v) >= 0x80 || vminvq_u8(v) == 0)
+        break;
+
+      if(out != NULL)
+      {
+        vst1q_u16(out, vmovl_u8(vget_low_u8(v)));
+        vst1q_u16(out + 8, vmovl_high_u8(v));
+        out += 16;
+      }
+
+      in += 16;
+      rc += 16;
+    }
+
     units = decode_utf8(&code, in);
     if(units == -1)
       return -1;
@@ -0,0 +1,134 @@
+#include <stdlib.h>
+#include <string.h>
+#include "types.h"
+#include "result.h"
+#include "services/acc_cache.h"
+
+void accountCacheCreate(AccountCache* c) {
+    memset(c, 0, sizeof(*c));
+}
+
+void accountCacheClose(AccountCache* c) {
+    for (s32 i = 0; i < c->count; i++)
+        free(c->entries[i].image);
+    memset(c, 0, sizeof(*c));
+}
+
+static bool _accountCacheUidEqual(const AccountUid* a, const AccountUid* b) {
+    return a->uid[0] == b->uid[0] && a->uid[1] == b->uid[1];
+}
+
+static s32 _accountCacheIndexOf(AccountCache* c, const AccountUid* uid) {
+    for (s32 i = 0; i < c->count; i++) {
+        if (_accountCacheUidEqual(&c->entries[i].uid, uid))
+            return i;
+    }
+    return -1;
+}
+
+static Result _accountCacheLoadImage(AccountProfile* profile, AccountCacheEntry* e) {
+    u32 size = 0;
+    Result rc = accountProfileGetImageSize(profile, &size);
+    if (R_FAILED(rc))
+        return rc;
+
+    e->image = malloc(size);
+    if (!e->image)
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+    e->image_capacity = size;
+
+    rc = accountProfileLoadImage(profile, e->image, e->image_capacity, &e->image_size);
+    if (R_SUCCEEDED(rc) && e->image_size > e->image_capacity)
+        rc = MAKERESULT(Module_Libnx, LibnxError_BadInput);
+    return rc;
+}
+
+Result accountCacheRefresh(AccountCache* c, bool* out_changed) {
+    AccountUid uids[ACC_USER_LIST_SIZE];
+    AccountCacheEntry entries[ACC_USER_LIST_SIZE];
+    bool kept[ACC_USER_LIST_SIZE] = {0};
+    s32 total = 0;
+    bool changed = false;
+    u32 loaded = 0;
+
+    Result rc = accountListAllUsers(uids, ACC_USER_LIST_SIZE, &total);
+    if (R_FAILED(rc))
+        return rc;
+    if (total > ACC_USER_LIST_SIZE)
+        total = ACC_USER_LIST_SIZE;
+
+    memset(entries, 0, sizeof(entries));
+    s32 count = 0;
+    for (s32 i = 0; R_SUCCEEDED(rc) && i < total; i++) {
+        if (!accountUidIsValid(&uids[i]))
+            continue;
+
+        AccountCacheEntry* e = &entries[count];
+        AccountProfile profile;
+        rc = accountGetProfile(&profile, uids[i]);
+        if (R_FAILED(rc))
+            break;
+
+        e->uid = uids[i];
+        rc = accountProfileGet(&profile, &e->userdata, &e->base);
+
+        if (R_SUCCEEDED(rc)) {
+            s32 old = _accountCacheIndexOf(c, &uids[i]);
+            if (old >= 0 && c->entries[old].base.lastEditTimestamp == e->base.lastEditTimestamp && c->entries[old].image) {
+                // Unchanged: take over the image of the cached entry.
+                e->image = c->entries[old].image;
+                e->image_size = c->entries[old].image_size;
+                e->image_capacity = c->entries[old].image_capacity;
+                kept[old] = true;
+            }
+            else {
+                // Loaded into a new buffer, so that the cache stays intact if the refresh fails. The profile is still usable without its image.
+                changed = true;
+                if (R_SUCCEEDED(_accountCacheLoadImage(&profile, e)))
+                    loaded++;
+                else {
+                    free(e->image);
+                    e->image = NULL;
+                    e->image_size = e->image_capacity = 0;
+                }
+            }
+            if (old != count)
+                changed = true;
+        }
+
+        accountProfileClose(&profile);
+        count++;
+    }
+
+    if (R_FAILED(rc)) {
+        // Only free what isn't owned by the cache.
+        for (s32 i = 0; i < count; i++) {
+            bool shared = false;
+            for (s32 j = 0; j < c->count; j++)
+                shared = shared || (entries[i].image && entries[i].image == c->entries[j].image);
+            if (!shared)
+                free(entries[i].image);
+        }
+        return rc;
+    }
+
+    if (count != c->count)
+        changed = true;
+    for (s32 i = 0; i < c->count; i++) {
+        if (!kept[i])
+            free(c->entries[i].image);
+    }
+
+    memcpy(c->entries, entries, sizeof(entries));
+    c->count = count;
+    c->images_loaded += loaded;
+
+    if (out_changed)
+        *out_changed = changed;
+    return 0;
+}
+
+const AccountCacheEntry* accountCacheFind(AccountCache* c, AccountUid uid) {
+    s32 i = _accountCacheIndexOf(c, &uid);
+    return i >= 0 ? &c->entries[i] : NULL;
+}
@@ -1,6 +1,7 @@
 #define NX_SERVICE_ASSUME_NON_DOMAIN
 #include <errno.h>
 #include <string.h>
+#include <stdlib.h>
 
 // Complete definition of struct timeout:
 #include <sys/time.h>
@@ -16,6 +17,8 @@
 #include "kernel/shmem.h"
 #include "kernel/rwlock.h"
 #include "sf/sessionmgr.h"
+#include "sf/async_dispatch.h"
+#include "arm/counter.h"
 #include "services/bsd.h"
 
 typedef struct BsdSelectTimeval {
@@ -29,9 +32,16 @@ __thread int g_bsdErrno;
 static Service g_bsdSrv;
 static Service g_bsdMonitor;
 static SessionMgr g_bsdSessionMgr;
+static SessionMgr g_bsdBlockingSessionMgr;
+static Handle g_bsdBlockingRoot;
+static BsdSessionPoolStats g_bsdPoolStats[2];
+
+// Number of sessions reserved for potentially blocking commands (accept, connect, recv, read, poll, select). 0 (the default) disables the separate pool.
+__attribute__((weak)) u32 __nx_bsd_num_blocking_sessions = 0;
 static u64 g_bsdClientPid = -1;
 
 static TransferMemory g_bsdTmem;
+static BsdInitConfig g_bsdConfig;
 
 static const BsdInitConfig g_defaultBsdInitConfig = {
     .version = 1,
@@ -95,6 +105,56 @@ static Result _bsdStartMonitoring(u64 pid) {
     return rc;
 }
 
+// Only commands that can wait for the network indefinitely are considered blocking.
+// Non-blocking sockets (O_NONBLOCK) cannot be detected here and still use the blocking pool, which is why it is opt-in.
+NX_INLINE bool _bsdIsBlockingRequest(u32 request_id, const void* in_data)
+{
+    switch (request_id) {
+        case 5: { // Select
+            const struct {
+                int nfds;
+                BsdSelectTimeval timeout;
+            } *in = in_data;
+            return in->timeout.is_null || in->timeout.tv.tv_sec != 0 || in->timeout.tv.tv_usec != 0;
+        }
+        case 6: { // Poll
+            const struct {
+                nfds_t nfds;
+                int timeout;
+            } *in = in_data;
+            return in->timeout != 0;
+        }
+        case 8: // Recv
+        case 9: { // RecvFrom
+            const struct {
+                int sockfd;
+                int flags;
+            } *in = in_data;
+            return !(in->flags & MSG_DONTWAIT);
+        }
+        case 12: // Accept
+        case 14: // Connect
+        case 25: // Read
+            return true;
+        default:
+            return false;
+    }
+}
+
+static void _bsdPoolStatsRecord(BsdSessionPoolStats* stats, u64 wait_ticks)
+{
+    __atomic_add_fetch(&stats->num_requests, 1, __ATOMIC_RELAXED);
+    if (!wait_ticks)
+        return;
+
+    u64 wait_ns = armTicksToNs(wait_ticks);
+    __atomic_add_fetch(&stats->num_waits, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&stats->total_wait_ns, wait_ns, __ATOMIC_RELAXED);
+
+    u64 max = __atomic_load_n(&stats->max_wait_ns, __ATOMIC_RELAXED);
+    while (wait_ns > max && !__atomic_compare_exchange_n(&stats->max_wait_ns, &max, wait_ns, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
 NX_INLINE int _bsdDispatchImpl(
     u32 request_id,
     const void* in_data, u32 in_data_size,
@@ -114,9 +174,30 @@ NX_INLINE int _bsdDispatchImpl(
     if (in_data_size)
         __builtin_memcpy(in, in_data, in_data_size);
 
-    int slot = sessionmgrAttachClient(&g_bsdSessionMgr);
-    Result rc = svcSendSyncRequest(sessionmgrGetClientSession(&g_bsdSessionMgr, slot));
-    sessionmgrDetachClient(&g_bsdSessionMgr, slot);
+#if defined(NX_SF_TRACE)
+    u64 trace_start = sftraceIsEnabled() ? armGetSystemTick() : 0;
+#endif
+
+    Result rc;
+    if (disp.target_session != INVALID_HANDLE)
+        rc = svcSendSyncRequest(disp.target_session);
+    else {
+        // Blocking commands use their own pool, so that they cannot starve fast commands of sessions.
+        bool blocking = g_bsdBlockingRoot != INVALID_HANDLE && _bsdIsBlockingRequest(request_id, in_data);
+        SessionMgr* mgr = blocking ? &g_bsdBlockingSessionMgr : &g_bsdSessionMgr;
+
+        u64 wait_ticks = 0;
+        int slot = sessionmgrTryAttachClient(mgr);
+        if (slot < 0) {
+            u64 wait_start = armGetSystemTick();
+            slot = sessionmgrAttachClient(mgr);
+            wait_ticks = armGetSystemTick() - wait_start;
+        }
+        _bsdPoolStatsRecord(&g_bsdPoolStats[blocking], wait_ticks);
+
+        rc = svcSendSyncRequest(sessionmgrGetClientSession(mgr, slot));
+        sessionmgrDetachClient(mgr, slot);
+    }
 
     int ret = -1;
     int errno_ = -1;
@@ -145,6 +226,15 @@ NX_INLINE int _bsdDispatchImpl(
     if (out_ptr && out_data && out_data_size)
         __builtin_memcpy(out_data, out_ptr, out_data_size);
 
+#if defined(NX_SF_TRACE)
+    if (trace_start)
+        sftraceRecord(srv.session, srv.object_id, request_id, rc, trace_start, armGetSystemTick());
+#endif
+
+#if defined(NX_FLIGHT_RECORDER)
+    flightRecorderRecordIpc(srv.session, srv.object_id, request_id, rc);
+#endif
+
     g_bsdResult = rc;
     g_bsdErrno = errno_;
     return ret;
@@ -195,6 +285,7 @@ const BsdInitConfig *bsdGetDefaultInitConfig(void) {
 Result _bsdInitialize(const BsdInitConfig *config, u32 num_sessions, u32 service_type) {
     if (!config)
         config = &g_defaultBsdInitConfig;
+    g_bsdConfig = *config;
 
     SmServiceName bsd_srv = {0};
     Result rc = MAKERESULT(Module_Libnx, LibnxError_BadInput);
@@ -224,11 +315,31 @@ Result _bsdInitialize(const BsdInitConfig *config, u32 num_sessions, u32 service
     if (R_SUCCEEDED(rc))
         rc = sessionmgrCreate(&g_bsdSessionMgr, g_bsdSrv.session, num_sessions);
 
+    // The blocking pool is optional: without it, all commands share the main pool.
+    memset(g_bsdPoolStats, 0, sizeof(g_bsdPoolStats));
+    if (R_SUCCEEDED(rc) && __nx_bsd_num_blocking_sessions != 0) {
+        Handle root = INVALID_HANDLE;
+        Result rc2 = bsdCloneSession(&root);
+        if (R_SUCCEEDED(rc2))
+            rc2 = sessionmgrCreate(&g_bsdBlockingSessionMgr, root, __nx_bsd_num_blocking_sessions);
+        if (R_SUCCEEDED(rc2))
+            g_bsdBlockingRoot = root;
+        else {
+            sessionmgrClose(&g_bsdBlockingSessionMgr);
+            bsdCloseSession(root);
+        }
+    }
+
     return rc;
 }
 
 void _bsdCleanup(void) {
     g_bsdClientPid = 0;
+    if (g_bsdBlockingRoot != INVALID_HANDLE) {
+        sessionmgrClose(&g_bsdBlockingSessionMgr);
+        bsdCloseSession(g_bsdBlockingRoot);
+        g_bsdBlockingRoot = INVALID_HANDLE;
+    }
     sessionmgrClose(&g_bsdSessionMgr);
     serviceClose(&g_bsdMonitor);
     serviceClose(&g_bsdSrv);
@@ -239,6 +350,40 @@ Service* bsdGetServiceSession(void) {
     return &g_bsdSrv;
 }
 
+void bsdGetSessionPoolStats(BsdSessionPoolStats* out_shared, BsdSessionPoolStats* out_blocking) {
+    BsdSessionPoolStats* out[2] = { out_shared, out_blocking };
+    for (int i = 0; i < 2; i ++) {
+        if (!out[i])
+            continue;
+        out[i]->num_requests  = __atomic_load_n(&g_bsdPoolStats[i].num_requests,  __ATOMIC_RELAXED);
+        out[i]->num_waits     = __atomic_load_n(&g_bsdPoolStats[i].num_waits,     __ATOMIC_RELAXED);
+        out[i]->total_wait_ns = __atomic_load_n(&g_bsdPoolStats[i].total_wait_ns, __ATOMIC_RELAXED);
+        out[i]->max_wait_ns   = __atomic_load_n(&g_bsdPoolStats[i].max_wait_ns,   __ATOMIC_RELAXED);
+    }
+}
+
+void bsdResetSessionPoolStats(void) {
+    for (int i = 0; i < 2; i ++) {
+        __atomic_store_n(&g_bsdPoolStats[i].num_requests,  0, __ATOMIC_RELAXED);
+        __atomic_store_n(&g_bsdPoolStats[i].num_waits,     0, __ATOMIC_RELAXED);
+        __atomic_store_n(&g_bsdPoolStats[i].total_wait_ns, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&g_bsdPoolStats[i].max_wait_ns,   0, __ATOMIC_RELAXED);
+    }
+}
+
+Result bsdCloneSession(Handle* out_session) {
+    return cmifCloneCurrentObject(g_bsdSrv.session, out_session);
+}
+
+void bsdCloseSession(Handle session) {
+    if (session == INVALID_HANDLE)
+        return;
+
+    cmifMakeCloseRequest(armGetTls(), 0);
+    svcSendSyncRequest(session);
+    svcCloseHandle(session);
+}
+
 int bsdSocket(int domain, int type, int protocol) {
     return _bsdCmdInDomainTypeProtocol(domain, type, protocol, 2);
 }
@@ -284,7 +429,7 @@ int bsdSelect(int nfds, fd_set *readfds, fd_set *writefds, fd_set *exceptfds, st
     );
 }
 
-int bsdPoll(struct pollfd *fds, nfds_t nfds, int timeout) {
+static int _bsdPoll(Handle session, struct pollfd *fds, nfds_t nfds, int timeout) {
     size_t fds_size = nfds * sizeof(struct pollfd);
 
     const struct {
@@ -293,6 +438,7 @@ int bsdPoll(struct pollfd *fds, nfds_t nfds, int timeout) {
     } in = { nfds, timeout };
 
     return _bsdDispatchIn(6, in,
+        .target_session = session,
         .buffer_attrs = {
             SfBufferAttr_HipcAutoSelect | SfBufferAttr_In,
             SfBufferAttr_HipcAutoSelect | SfBufferAttr_Out,
@@ -304,6 +450,14 @@ int bsdPoll(struct pollfd *fds, nfds_t nfds, int timeout) {
     );
 }
 
+int bsdPoll(struct pollfd *fds, nfds_t nfds, int timeout) {
+    return _bsdPoll(INVALID_HANDLE, fds, nfds, timeout);
+}
+
+int bsdPollOnSession(Handle session, struct pollfd *fds, nfds_t nfds, int timeout) {
+    return _bsdPoll(session, fds, nfds, timeout);
+}
+
 int bsdSysctl(const int *name, unsigned int namelen, void *oldp, size_t *oldlenp, const void *newp, size_t newlen) {
     size_t inlen = oldlenp ? *oldlenp : 0;
 
@@ -321,12 +475,31 @@ int bsdSysctl(const int *name, unsigned int namelen, void *oldp, size_t *oldlenp
     );
 }
 
+// Small messages: payloads that fit in the server pointer buffer are passed as X/C pointer descriptors, with the
+// empty A/B descriptor that the AutoSelect command signature still requires. The descriptor layout is therefore
+// fixed at compile time instead of being chosen per buffer in cmifRequestIn/OutAutoBuffer.
+NX_INLINE bool _bsdIsSmallMessage(size_t len) {
+    return len <= g_bsdSrv.pointer_buffer_size;
+}
+
 ssize_t bsdRecv(int sockfd, void *buf, size_t len, int flags) {
     const struct {
         int sockfd;
         int flags;
     } in = { sockfd, flags };
 
+    if (_bsdIsSmallMessage(len))
+        return _bsdDispatchIn(8, in,
+            .buffer_attrs = {
+                SfBufferAttr_HipcPointer  | SfBufferAttr_Out,
+                SfBufferAttr_HipcMapAlias | SfBufferAttr_Out,
+            },
+            .buffers = {
+                { buf,  len },
+                { NULL, 0   },
+            },
+        );
+
     return _bsdDispatchIn(8, in,
         .buffer_attrs = { SfBufferAttr_HipcAutoSelect | SfBufferAttr_Out },
         .buffers = { { buf, len } },
@@ -359,6 +532,18 @@ ssize_t bsdSend(int sockfd, const void* buf, size_t len, int flags) {
         int flags;
     } in = { sockfd, flags };
 
+    if (_bsdIsSmallMessage(len))
+        return _bsdDispatchIn(10, in,
+            .buffer_attrs = {
+                SfBufferAttr_HipcPointer  | SfBufferAttr_In,
+                SfBufferAttr_HipcMapAlias | SfBufferAttr_In,
+            },
+            .buffers = {
+                { buf,  len },
+                { NULL, 0   },
+            },
+        );
+
     return _bsdDispatchIn(10, in,
         .buffer_attrs = { SfBufferAttr_HipcAutoSelect | SfBufferAttr_In },
         .buffers = { { buf, len } },
@@ -575,3 +760,417 @@ int bsdDuplicateSocket(int sockfd) {
 
     return _bsdDispatchIn(27, in);
 }
+
+// Maximum number of SendTo requests kept in flight by bsdSendMMsg.
+#define BSD_MMSG_MAX_IN_FLIGHT 8
+
+typedef struct {
+    SfAsyncRequest req;
+    void* tmp;
+    size_t len;
+    struct {
+        int ret;
+        int errno_;
+    } out;
+} BsdMMsgRequest;
+
+// Returns a single contiguous buffer for the message payload, allocating a gather buffer if it spans several iovecs.
+static bool _bsdMsgGather(const struct msghdr *msg, void **buf, size_t *len, void **tmp) {
+    *tmp = NULL;
+    if (msg->msg_iovlen == 1) {
+        *buf = msg->msg_iov[0].iov_base;
+        *len = msg->msg_iov[0].iov_len;
+        return true;
+    }
+
+    size_t total = 0;
+    for (size_t i = 0; i < (size_t)msg->msg_iovlen; i++)
+        total += msg->msg_iov[i].iov_len;
+
+    *buf = NULL;
+    *len = total;
+    if (total == 0)
+        return true;
+
+    u8 *data = (u8*)malloc(total);
+    if (!data)
+        return false;
+
+    size_t off = 0;
+    for (size_t i = 0; i < (size_t)msg->msg_iovlen; i++) {
+        memcpy(data + off, msg->msg_iov[i].iov_base, msg->msg_iov[i].iov_len);
+        off += msg->msg_iov[i].iov_len;
+    }
+
+    *buf = data;
+    *tmp = data;
+    return true;
+}
+
+static void _bsdMsgScatter(const struct msghdr *msg, const void *buf, size_t len) {
+    const u8 *data = (const u8*)buf;
+    for (size_t i = 0; i < (size_t)msg->msg_iovlen && len; i++) {
+        size_t chunk = msg->msg_iov[i].iov_len < len ? msg->msg_iov[i].iov_len : len;
+        memcpy(msg->msg_iov[i].iov_base, data, chunk);
+        data += chunk;
+        len -= chunk;
+    }
+}
+
+static int _bsdMMsgValidate(const struct msghdr *msg) {
+    if (msg->msg_controllen != 0) {
+        g_bsdResult = 0;
+        g_bsdErrno = EOPNOTSUPP;
+        return -1;
+    }
+    if (msg->msg_iovlen != 0 && msg->msg_iov == NULL) {
+        g_bsdResult = 0;
+        g_bsdErrno = EFAULT;
+        return -1;
+    }
+    return 0;
+}
+
+static int _bsdMMsgBeginSend(BsdMMsgRequest *r, int sockfd, const struct msghdr *msg, int flags) {
+    void *buf;
+    if (!_bsdMsgGather(msg, &buf, &r->len, &r->tmp)) {
+        g_bsdResult = MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+        g_bsdErrno = ENOMEM;
+        return -1;
+    }
+
+    const struct {
+        int sockfd;
+        int flags;
+    } in = { sockfd, flags };
+
+    Result rc = sfasyncBeginInOut(&r->req, &g_bsdSessionMgr, &g_bsdSrv, 11, in, r->out,
+        .buffer_attrs = {
+            SfBufferAttr_HipcAutoSelect | SfBufferAttr_In,
+            SfBufferAttr_HipcAutoSelect | SfBufferAttr_In,
+        },
+        .buffers = {
+            { buf,           r->len          },
+            { msg->msg_name, msg->msg_namelen },
+        },
+    );
+
+    if (R_FAILED(rc)) {
+        free(r->tmp);
+        g_bsdResult = rc;
+        g_bsdErrno = -1;
+        return -1;
+    }
+    return 0;
+}
+
+static int _bsdMMsgEndSend(BsdMMsgRequest *r) {
+    Result rc = sfasyncEnd(&r->req);
+    free(r->tmp);
+
+    g_bsdResult = rc;
+    if (R_FAILED(rc)) {
+        g_bsdErrno = -1;
+        return -1;
+    }
+
+    g_bsdErrno = r->out.ret < 0 ? r->out.errno_ : 0;
+    return r->out.ret;
+}
+
+int bsdSendMMsg(int sockfd, struct mmsghdr *msgvec, unsigned int vlen, int flags) {
+    if (vlen == 0)
+        return 0;
+
+    // Requests running on different sessions may be serviced out of order, which is only acceptable for datagrams.
+    // Never hold more pooled sessions than exist, otherwise beginning a request would block forever.
+    int type = 0;
+    socklen_t typelen = sizeof(type);
+    u32 window = 1;
+    if (bsdGetSockOpt(sockfd, SOL_SOCKET, SO_TYPE, &type, &typelen) != -1 && type == SOCK_DGRAM) {
+        window = g_bsdSessionMgr.num_sessions;
+        if (window > BSD_MMSG_MAX_IN_FLIGHT)
+            window = BSD_MMSG_MAX_IN_FLIGHT;
+        if (window == 0)
+            window = 1;
+    }
+
+    BsdMMsgRequest reqs[BSD_MMSG_MAX_IN_FLIGHT];
+    unsigned int head = 0, tail = 0; // messages [tail, head) are in flight
+    unsigned int num_sent = 0;
+    unsigned int fail_index = vlen; // first message which failed
+    bool failed = false;
+    Result fail_rc = 0;
+    int fail_errno = 0;
+
+    while (tail < head || (!failed && head < vlen)) {
+        if (!failed && head < vlen && head - tail < window) {
+            struct msghdr *msg = &msgvec[head].msg_hdr;
+            if (_bsdMMsgValidate(msg) == 0 && _bsdMMsgBeginSend(&reqs[head % window], sockfd, msg, flags) == 0) {
+                head++;
+                continue;
+            }
+            failed = true;
+            fail_index = head;
+            fail_rc = g_bsdResult;
+            fail_errno = g_bsdErrno;
+            continue;
+        }
+
+        // Complete the oldest request, in submission order. The messages before the first failure still count as sent,
+        // including the ones which were in flight when it happened.
+        BsdMMsgRequest *r = &reqs[tail % window];
+        int ret = _bsdMMsgEndSend(r);
+        if (ret >= 0 && tail < fail_index && num_sent == tail) {
+            msgvec[tail].msg_len = ret;
+            num_sent++;
+        }
+        else if (ret < 0 && tail < fail_index) {
+            failed = true;
+            fail_index = tail;
+            fail_rc = g_bsdResult;
+            fail_errno = g_bsdErrno;
+        }
+        tail++;
+    }
+
+    if (num_sent == 0 && failed) {
+        g_bsdResult = fail_rc;
+        g_bsdErrno = fail_errno;
+        return -1;
+    }
+
+    g_bsdResult = 0;
+    g_bsdErrno = 0;
+    return num_sent;
+}
+
+int bsdRecvMMsg(int sockfd, struct mmsghdr *msgvec, unsigned int vlen, int flags, struct timespec *timeout) {
+    // Datagrams are received sequentially: pipelining RecvFrom would not preserve their order.
+    u64 deadline = 0;
+    if (timeout)
+        deadline = armGetSystemTick() + armNsToTicks((u64)timeout->tv_sec * 1000000000ULL + timeout->tv_nsec);
+
+    int cur_flags = flags & ~MSG_WAITFORONE;
+    unsigned int num_recv = 0;
+
+    while (num_recv < vlen) {
+        struct msghdr *msg = &msgvec[num_recv].msg_hdr;
+        if (_bsdMMsgValidate(msg) != 0)
+            goto _fail;
+
+        void *buf = NULL;
+        void *tmp = NULL;
+        size_t len = 0;
+        if (msg->msg_iovlen == 1) {
+            buf = msg->msg_iov[0].iov_base;
+            len = msg->msg_iov[0].iov_len;
+        }
+        else {
+            for (size_t i = 0; i < (size_t)msg->msg_iovlen; i++)
+                len += msg->msg_iov[i].iov_len;
+            if (len) {
+                buf = tmp = malloc(len);
+                if (!tmp) {
+                    g_bsdResult = MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+                    g_bsdErrno = ENOMEM;
+                    goto _fail;
+                }
+            }
+        }
+
+        socklen_t namelen = msg->msg_name ? msg->msg_namelen : 0;
+        ssize_t ret = bsdRecvFrom(sockfd, buf, len, cur_flags, (struct sockaddr*)msg->msg_name, &namelen);
+        if (ret >= 0 && tmp)
+            _bsdMsgScatter(msg, tmp, ret);
+        free(tmp);
+
+        if (ret < 0)
+            goto _fail;
+
+        msg->msg_namelen = msg->msg_name ? namelen : 0;
+        msg->msg_flags = 0;
+        msgvec[num_recv].msg_len = ret;
+        num_recv++;
+
+        if (flags & MSG_WAITFORONE)
+            cur_flags |= MSG_DONTWAIT;
+        if (timeout && armGetSystemTick() >= deadline)
+            break;
+    }
+
+    g_bsdResult = 0;
+    g_bsdErrno = 0;
+    return num_recv;
+
+_fail:
+    // Errors after the first datagram are reported by the next call, as on Linux.
+    if (num_recv == 0)
+        return -1;
+
+    g_bsdResult = 0;
+    g_bsdErrno = 0;
+    return num_recv;
+}
+
+// Chunk size bounds used by bsdSendLarge/bsdSendFile.
+#define BSD_SEND_MIN_CHUNK 0x4000
+#define BSD_SEND_MAX_CHUNK 0x40000
+
+// Grows the socket send buffer towards the configured maximum for large transfers, and returns the chunk size to use.
+static size_t _bsdTuneSendBuffer(int sockfd, size_t count) {
+    u32 max_size = g_bsdConfig.tcp_tx_buf_max_size ? g_bsdConfig.tcp_tx_buf_max_size : g_bsdConfig.tcp_tx_buf_size;
+    size_t want = count < max_size ? count : max_size;
+
+    int cur = 0;
+    socklen_t curlen = sizeof(cur);
+    if (bsdGetSockOpt(sockfd, SOL_SOCKET, SO_SNDBUF, &cur, &curlen) != -1 && cur >= 0 && (size_t)cur < want) {
+        int size = want;
+        if (bsdSetSockOpt(sockfd, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size)) != -1)
+            cur = size;
+    }
+
+    size_t chunk = cur > 0 ? (size_t)cur : want;
+    if (chunk < BSD_SEND_MIN_CHUNK)
+        chunk = BSD_SEND_MIN_CHUNK;
+    if (chunk > BSD_SEND_MAX_CHUNK)
+        chunk = BSD_SEND_MAX_CHUNK;
+    return chunk;
+}
+
+static int _bsdSendAsyncBegin(BsdMMsgRequest *r, int sockfd, const void *buf, size_t len, int flags) {
+    const struct {
+        int sockfd;
+        int flags;
+    } in = { sockfd, flags };
+
+    r->tmp = NULL;
+    r->len = len;
+
+    Result rc = sfasyncBeginInOut(&r->req, &g_bsdSessionMgr, &g_bsdSrv, 10, in, r->out,
+        .buffer_attrs = { SfBufferAttr_HipcAutoSelect | SfBufferAttr_In },
+        .buffers = { { buf, len } },
+    );
+
+    if (R_FAILED(rc)) {
+        g_bsdResult = rc;
+        g_bsdErrno = -1;
+        return -1;
+    }
+    return 0;
+}
+
+// Sends the whole buffer, retrying after partial sends.
+static ssize_t _bsdSendAll(int sockfd, const void *buf, size_t len, int flags) {
+    size_t sent = 0;
+    while (sent < len) {
+        ssize_t ret = bsdSend(sockfd, (const u8*)buf + sent, len - sent, flags);
+        if (ret < 0)
+            return sent ? (ssize_t)sent : -1;
+        if (ret == 0)
+            break;
+        sent += ret;
+    }
+    return sent;
+}
+
+ssize_t bsdSendLarge(int sockfd, const void *buf, size_t len, int flags) {
+    size_t chunk = _bsdTuneSendBuffer(sockfd, len);
+    size_t sent = 0;
+
+    while (sent < len) {
+        size_t size = len - sent < chunk ? len - sent : chunk;
+        ssize_t ret = _bsdSendAll(sockfd, (const u8*)buf + sent, size, flags);
+        if (ret < 0 && sent == 0)
+            return -1;
+        if (ret <= 0)
+            break;
+        sent += ret;
+        if ((size_t)ret < size)
+            break;
+    }
+
+    if (sent) {
+        g_bsdResult = 0;
+        g_bsdErrno = 0;
+    }
+    return sent;
+}
+
+ssize_t bsdSendFile(int sockfd, FsFile *file, s64 offset, size_t count, int flags) {
+    size_t chunk = _bsdTuneSendBuffer(sockfd, count);
+    u8 *bufs = (u8*)malloc(2 * chunk);
+    if (!bufs) {
+        g_bsdResult = MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+        g_bsdErrno = ENOMEM;
+        return -1;
+    }
+
+    // Double buffering: the next chunk is read from the file while the previous one is being sent.
+    BsdMMsgRequest req;
+    bool pending = false;
+    size_t pending_len = 0;
+    u8 *pending_buf = NULL;
+    size_t sent = 0, read = 0;
+    int cur = 0;
+    Result fail_rc = 0;
+    int fail_errno = 0;
+
+    for (;;) {
+        u64 bytes = 0;
+        u8 *buf = bufs + cur * chunk;
+        if (read < count) {
+            size_t size = count - read < chunk ? count - read : chunk;
+            Result rc = fsFileRead(file, offset + read, buf, size, FsReadOption_None, &bytes);
+            if (R_FAILED(rc)) {
+                fail_rc = rc;
+                fail_errno = EIO;
+                bytes = 0;
+            }
+            read += bytes;
+        }
+
+        if (pending) {
+            pending = false;
+            ssize_t ret = _bsdMMsgEndSend(&req);
+            // Blocking stream sockets rarely send partially, but finish the chunk if they do.
+            if (ret >= 0 && (size_t)ret < pending_len) {
+                ssize_t ret2 = _bsdSendAll(sockfd, pending_buf + ret, pending_len - ret, flags);
+                ret = ret2 < 0 ? ret : ret + ret2;
+            }
+            if (ret < 0) {
+                fail_rc = g_bsdResult;
+                fail_errno = g_bsdErrno;
+                break;
+            }
+            sent += ret;
+            if ((size_t)ret < pending_len)
+                break;
+        }
+
+        if (bytes == 0 || fail_rc != 0)
+            break;
+
+        if (_bsdSendAsyncBegin(&req, sockfd, buf, bytes, flags) != 0) {
+            fail_rc = g_bsdResult;
+            fail_errno = g_bsdErrno;
+            break;
+        }
+        pending = true;
+        pending_len = bytes;
+        pending_buf = buf;
+        cur ^= 1;
+    }
+
+    free(bufs);
+
+    if (sent == 0 && fail_rc != 0) {
+        g_bsdResult = fail_rc;
+        g_bsdErrno = fail_errno;
+        return -1;
+    }
+
+    g_bsdResult = 0;
+    g_bsdErrno = 0;
+    return sent;
+}
@@ -0,0 +1,217 @@
+#include <arm_neon.h>
+#include <malloc.h>
+#include <string.h>
+#include "types.h"
+#include "result.h"
+#include "arm/counter.h"
+#include "services/capssc_capture.h"
+
+// 2x2 box filter of a pair of RGBA8 rows, 16 input pixels at a time.
+static void _capsscDownscaleRow(u8* dst, const u8* row0, const u8* row1, u32 width) {
+    for (u32 x = 0; x < width; x += 16) {
+        uint8x16x4_t a = vld4q_u8(row0 + x*4);
+        uint8x16x4_t b = vld4q_u8(row1 + x*4);
+        uint8x8x4_t o;
+        o.val[0] = vrshrn_n_u16(vaddq_u16(vpaddlq_u8(a.val[0]), vpaddlq_u8(b.val[0])), 2);
+        o.val[1] = vrshrn_n_u16(vaddq_u16(vpaddlq_u8(a.val[1]), vpaddlq_u8(b.val[1])), 2);
+        o.val[2] = vrshrn_n_u16(vaddq_u16(vpaddlq_u8(a.val[2]), vpaddlq_u8(b.val[2])), 2);
+        o.val[3] = vrshrn_n_u16(vaddq_u16(vpaddlq_u8(a.val[3]), vpaddlq_u8(b.val[3])), 2);
+        vst4_u8(dst + x*2, o);
+    }
+}
+
+// RGBA8 to RGB565 of a row, 16 pixels at a time.
+static void _capsscConvertRow565(u16* dst, const u8* src, u32 width) {
+    for (u32 x = 0; x < width; x += 16) {
+        uint8x16x4_t p = vld4q_u8(src + x*4);
+
+        uint16x8_t lo = vshll_n_u8(vget_low_u8(p.val[0]), 8);
+        lo = vsriq_n_u16(lo, vshll_n_u8(vget_low_u8(p.val[1]), 8), 5);
+        lo = vsriq_n_u16(lo, vshll_n_u8(vget_low_u8(p.val[2]), 8), 11);
+
+        uint16x8_t hi = vshll_n_u8(vget_high_u8(p.val[0]), 8);
+        hi = vsriq_n_u16(hi, vshll_n_u8(vget_high_u8(p.val[1]), 8), 5);
+        hi = vsriq_n_u16(hi, vshll_n_u8(vget_high_u8(p.val[2]), 8), 11);
+
+        vst1q_u16(dst + x, lo);
+        vst1q_u16(dst + x + 8, hi);
+    }
+}
+
+static void _capsscConvert(CapsscCapture* c, CapsscCaptureFrame* f) {
+    u8 tmp[CAPSSC_RAW_WIDTH / 2 * 4] __attribute__((aligned(16)));
+    u32 src_stride = CAPSSC_RAW_WIDTH * 4;
+
+    for (u32 y = 0; y < f->height; y++) {
+        u8* dst = (u8*)f->data + y * f->stride;
+        const u8* row = c->raw + y * c->scale * src_stride;
+
+        if (c->scale == 2) {
+            u8* out = c->format == CapsscCaptureFormat_Rgba8 ? dst : tmp;
+            _capsscDownscaleRow(out, row, row + src_stride, CAPSSC_RAW_WIDTH);
+            row = out;
+        }
+
+        if (c->format == CapsscCaptureFormat_Rgb565)
+            _capsscConvertRow565((u16*)dst, row, f->width);
+    }
+}
+
+static void _capsscCaptureThreadFunc(void* arg) {
+    CapsscCapture* c = (CapsscCapture*)arg;
+    Result rc = 0;
+
+    mutexLock(&c->mutex);
+
+    for (;;) {
+        // Replace the oldest frame nobody acquired yet rather than wait, the newest frames matter most.
+        if (!c->should_exit && !c->free_mask && c->num_ready) {
+            c->free_mask |= BIT(c->ready[0]);
+            c->num_ready--;
+            memmove(&c->ready[0], &c->ready[1], c->num_ready * sizeof(u32));
+            __atomic_add_fetch(&c->dropped, 1, __ATOMIC_RELAXED);
+        }
+        if (!c->should_exit && !c->free_mask) {
+            __atomic_add_fetch(&c->stalls, 1, __ATOMIC_RELAXED);
+            while (!c->should_exit && !c->free_mask)
+                condvarWait(&c->cond, &c->mutex);
+        }
+        if (c->should_exit)
+            break;
+
+        u32 index = __builtin_ctz(c->free_mask);
+        c->free_mask &= ~BIT(index);
+        mutexUnlock(&c->mutex);
+
+        // Without conversion, caps:sc writes straight into the buffer which is handed to the consumers.
+        CapsscCaptureFrame* f = &c->frames[index];
+        void* dst = c->raw ? c->raw : f->data;
+        rc = capsscCaptureRawImageWithTimeout(dst, CAPSSC_RAW_IMAGE_SIZE, 0, CAPSSC_RAW_WIDTH, CAPSSC_RAW_HEIGHT, 1, 0, c->timeout);
+        if (R_SUCCEEDED(rc) && c->raw)
+            _capsscConvert(c, f);
+
+        mutexLock(&c->mutex);
+        if (R_FAILED(rc)) {
+            c->free_mask |= BIT(index);
+            c->rc = rc;
+            condvarWakeAll(&c->cond);
+            break;
+        }
+
+        f->frame_number = c->frame_counter++;
+        f->tick = armGetSystemTick();
+        c->ready[c->num_ready++] = index;
+        condvarWakeAll(&c->cond);
+    }
+
+    mutexUnlock(&c->mutex);
+}
+
+Result capsscCaptureCreate(CapsscCapture* c, CapsscCaptureFormat format, u32 scale, u32 num_buffers, u64 timeout, int prio, int cpuid) {
+    if (num_buffers < 2 || num_buffers > CAPSSC_CAPTURE_MAX_BUFFERS || (scale != 1 && scale != 2) || format > CapsscCaptureFormat_Rgb565)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    memset(c, 0, sizeof(*c));
+    c->format = format;
+    c->scale = scale;
+    c->timeout = timeout;
+    c->num_buffers = num_buffers;
+    c->free_mask = BIT(num_buffers) - 1;
+    mutexInit(&c->mutex);
+    condvarInit(&c->cond);
+
+    u32 width = CAPSSC_RAW_WIDTH / scale, height = CAPSSC_RAW_HEIGHT / scale;
+    u32 stride = width * (format == CapsscCaptureFormat_Rgb565 ? 2 : 4);
+    u32 size = stride * height;
+    c->buffer_size = (size + 0xFFF) & ~0xFFF;
+
+    c->pool = (u8*)memalign(0x1000, (size_t)c->buffer_size * num_buffers);
+    if (format != CapsscCaptureFormat_Rgba8 || scale != 1)
+        c->raw = (u8*)memalign(0x1000, CAPSSC_RAW_IMAGE_SIZE);
+    if (!c->pool || ((format != CapsscCaptureFormat_Rgba8 || scale != 1) && !c->raw)) {
+        free(c->pool);
+        free(c->raw);
+        c->pool = c->raw = NULL;
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+    }
+
+    for (u32 i = 0; i < num_buffers; i++) {
+        CapsscCaptureFrame* f = &c->frames[i];
+        f->index = i;
+        f->data = c->pool + (size_t)i * c->buffer_size;
+        f->size = size;
+        f->width = width;
+        f->height = height;
+        f->stride = stride;
+    }
+
+    Result rc = threadCreate(&c->thread, _capsscCaptureThreadFunc, c, NULL, 0x4000, prio, cpuid);
+    if (R_SUCCEEDED(rc)) {
+        rc = threadStart(&c->thread);
+        if (R_FAILED(rc))
+            threadClose(&c->thread);
+    }
+
+    if (R_FAILED(rc)) {
+        free(c->pool);
+        free(c->raw);
+        c->pool = c->raw = NULL;
+    }
+
+    return rc;
+}
+
+void capsscCaptureClose(CapsscCapture* c) {
+    if (!c->pool)
+        return;
+
+    mutexLock(&c->mutex);
+    c->should_exit = true;
+    condvarWakeAll(&c->cond);
+    mutexUnlock(&c->mutex);
+
+    threadWaitForExit(&c->thread);
+    threadClose(&c->thread);
+
+    free(c->pool);
+    free(c->raw);
+    memset(c, 0, sizeof(*c));
+}
+
+Result capsscCaptureAcquire(CapsscCapture* c, CapsscCaptureFrame* out, u64 timeout) {
+    Result rc = 0;
+    u64 start = armGetSystemTick();
+
+    mutexLock(&c->mutex);
+
+    while (!c->num_ready && R_SUCCEEDED(c->rc)) {
+        u64 elapsed = armTicksToNs(armGetSystemTick() - start);
+        if (timeout != UINT64_MAX && elapsed >= timeout) {
+            rc = KERNELRESULT(TimedOut);
+            break;
+        }
+        condvarWaitTimeout(&c->cond, &c->mutex, timeout == UINT64_MAX ? UINT64_MAX : timeout - elapsed);
+    }
+
+    if (c->num_ready) {
+        rc = 0;
+        *out = c->frames[c->ready[0]];
+        c->num_ready--;
+        memmove(&c->ready[0], &c->ready[1], c->num_ready * sizeof(u32));
+    }
+    else if (R_SUCCEEDED(rc))
+        rc = c->rc;
+
+    mutexUnlock(&c->mutex);
+    return rc;
+}
+
+void capsscCaptureRelease(CapsscCapture* c, u32 index) {
+    if (index >= c->num_buffers)
+        return;
+
+    mutexLock(&c->mutex);
+    c->free_mask |= BIT(index);
+    condvarWakeAll(&c->cond);
+    mutexUnlock(&c->mutex);
+}
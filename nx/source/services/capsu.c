@@ -9,7 +9,7 @@
 static Service g_capsuSrv;
 static Service g_capsuAccessor;
 
-static Result _capsuSetShimLibraryVersion(u64 version);
+static Result _capsuSetShimLibraryVersion(Service* srv, u64 version);
 
 NX_GENERATE_SERVICE_GUARD(capsu);
 
@@ -21,7 +21,7 @@ Result _capsuInitialize(void) {
 
     if (R_SUCCEEDED(rc)) rc = smGetService(&g_capsuSrv, "caps:u");
 
-    if (R_SUCCEEDED(rc) && hosversionAtLeast(7,0,0)) rc = _capsuSetShimLibraryVersion(capsGetShimLibraryVersion());
+    if (R_SUCCEEDED(rc) && hosversionAtLeast(7,0,0)) rc = _capsuSetShimLibraryVersion(&g_capsuSrv, capsGetShimLibraryVersion());
 
     return rc;
 }
@@ -43,7 +43,7 @@ static Result _capsuCmdInU64NoOut(Service* srv, u64 inval, u32 cmd_id) {
     return serviceDispatchIn(srv, cmd_id, inval);
 }
 
-static Result _capsuSetShimLibraryVersion(u64 version) {
+static Result _capsuSetShimLibraryVersion(Service* srv, u64 version) {
     if (hosversionBefore(7,0,0))
         return MAKERESULT(Module_Libnx, LibnxError_IncompatSysVer);
 
@@ -55,7 +55,7 @@ static Result _capsuSetShimLibraryVersion(u64 version) {
         u64 AppletResourceUserId;
     } in = { version, AppletResourceUserId };
 
-    return serviceDispatchIn(&g_capsuSrv, 32, in,
+    return serviceDispatchIn(srv, 32, in,
         .in_send_pid = true,
     );
 }
@@ -128,7 +128,7 @@ static Result _capsuPrecheckToCreateContentsByAruid(u8 type, u64 unk) {
     );
 }
 
-static Result _capsuLoadAlbumScreenShotImageByAruid(u32 cmd_id, CapsLoadAlbumScreenShotImageOutputForApplication *out, void* image, size_t image_size, void* workbuf, size_t workbuf_size, const CapsApplicationAlbumFileEntry *entry, const CapsScreenShotDecodeOption *option) {
+static Result _capsuLoadAlbumScreenShotImageByAruid(Service* srv, u32 cmd_id, CapsLoadAlbumScreenShotImageOutputForApplication *out, void* image, size_t image_size, void* workbuf, size_t workbuf_size, const CapsApplicationAlbumFileEntry *entry, const CapsScreenShotDecodeOption *option) {
     u64 AppletResourceUserId = 0;
     appletGetAppletResourceUserId(&AppletResourceUserId);
 
@@ -138,7 +138,7 @@ static Result _capsuLoadAlbumScreenShotImageByAruid(u32 cmd_id, CapsLoadAlbumScr
         u64 AppletResourceUserId;
     } in = { *entry, *option, AppletResourceUserId };
 
-    return serviceDispatchIn(&g_capsuSrv, cmd_id, in,
+    return serviceDispatchIn(srv, cmd_id, in,
         .buffer_attrs = {
             SfBufferAttr_HipcMapAlias | SfBufferAttr_Out,
             SfBufferAttr_HipcMapTransferAllowsNonSecure | SfBufferAttr_HipcMapAlias | SfBufferAttr_Out,
@@ -327,7 +327,7 @@ Result capsuLoadAlbumScreenShotImage(s32 *width, s32 *height, CapsScreenShotAttr
     Result rc=0;
     CapsLoadAlbumScreenShotImageOutputForApplication out={0};
 
-    rc = _capsuLoadAlbumScreenShotImageByAruid(110, &out, image, image_size, workbuf, workbuf_size, entry, option);
+    rc = _capsuLoadAlbumScreenShotImageByAruid(&g_capsuSrv, 110, &out, image, image_size, workbuf, workbuf_size, entry, option);
     if (R_SUCCEEDED(rc)) _capsuProcessImageOutput(&out, width, height, attr, userdata, userdata_maxsize, userdata_size);
     return rc;
 }
@@ -336,7 +336,27 @@ Result capsuLoadAlbumScreenShotThumbnailImage(s32 *width, s32 *height, CapsScree
     Result rc=0;
     CapsLoadAlbumScreenShotImageOutputForApplication out={0};
 
-    rc = _capsuLoadAlbumScreenShotImageByAruid(120, &out, image, image_size, workbuf, workbuf_size, entry, option);
+    rc = _capsuLoadAlbumScreenShotImageByAruid(&g_capsuSrv, 120, &out, image, image_size, workbuf, workbuf_size, entry, option);
+    if (R_SUCCEEDED(rc)) _capsuProcessImageOutput(&out, width, height, attr, userdata, userdata_maxsize, userdata_size);
+    return rc;
+}
+
+Result capsuOpenSession(Service* srv_out) {
+    Result rc = smGetService(srv_out, "caps:u");
+
+    if (R_SUCCEEDED(rc) && hosversionAtLeast(7,0,0)) {
+        rc = _capsuSetShimLibraryVersion(srv_out, capsGetShimLibraryVersion());
+        if (R_FAILED(rc)) serviceClose(srv_out);
+    }
+
+    return rc;
+}
+
+Result capsuLoadAlbumScreenShotThumbnailImageWithSession(Service* srv, s32 *width, s32 *height, CapsScreenShotAttributeForApplication *attr, void* userdata, size_t userdata_maxsize, u32 *userdata_size, void* image, size_t image_size, void* workbuf, size_t workbuf_size, const CapsApplicationAlbumFileEntry *entry, const CapsScreenShotDecodeOption *option) {
+    Result rc=0;
+    CapsLoadAlbumScreenShotImageOutputForApplication out={0};
+
+    rc = _capsuLoadAlbumScreenShotImageByAruid(srv, 120, &out, image, image_size, workbuf, workbuf_size, entry, option);
     if (R_SUCCEEDED(rc)) _capsuProcessImageOutput(&out, width, height, attr, userdata, userdata_maxsize, userdata_size);
     return rc;
 }
@@ -0,0 +1,216 @@
+#include <malloc.h>
+#include <stdlib.h>
+#include <string.h>
+#include "types.h"
+#include "result.h"
+#include "services/capsu_gallery.h"
+
+static Result _capsuGalleryList(CapsContentType type, CapsApplicationAlbumFileEntry** out_entries, s32* out_count) {
+    CapsApplicationAlbumFileEntry* entries = NULL;
+    s32 capacity = 256;
+    Result rc = 0;
+
+    // There's no offset to page with, grow the buffer until the whole listing fits.
+    for (;;) {
+        CapsApplicationAlbumFileEntry* tmp = (CapsApplicationAlbumFileEntry*)realloc(entries, capacity * sizeof(CapsApplicationAlbumFileEntry));
+        if (!tmp) {
+            rc = MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+            break;
+        }
+        entries = tmp;
+
+        s32 total = 0;
+        rc = capsuGetAlbumFileListDeprecated1(entries, capacity, type, NULL, NULL, &total);
+        if (R_FAILED(rc))
+            break;
+
+        if (total < capacity) {
+            *out_entries = entries;
+            *out_count = total;
+            return 0;
+        }
+        capacity *= 2;
+    }
+
+    free(entries);
+    return rc;
+}
+
+static void _capsuGalleryWorkerFunc(void* arg) {
+    CapsuGalleryWorker* w = (CapsuGalleryWorker*)arg;
+    CapsuGallery* g = w->gallery;
+    CapsScreenShotDecodeOption option = {0};
+
+    mutexLock(&g->mutex);
+
+    for (;;) {
+        while (!g->should_exit && !g->num_pending)
+            condvarWait(&g->cond, &g->mutex);
+        if (g->should_exit)
+            break;
+
+        // Newest first: the most recently requested thumbnails are the ones in view.
+        CapsuGalleryRequest req = g->pending[--g->num_pending];
+        g->num_active++;
+
+        CapsApplicationAlbumFileEntry entry = {0};
+        bool valid = req.index >= 0 && req.index < g->count;
+        if (valid)
+            entry = g->entries[req.index];
+        mutexUnlock(&g->mutex);
+
+        req.width = req.height = 0;
+        if (valid)
+            req.rc = capsuLoadAlbumScreenShotThumbnailImageWithSession(w->srv, &req.width, &req.height, NULL, NULL, 0, NULL,
+                req.image, CAPSU_THUMBNAIL_IMAGE_SIZE, w->workbuf, CAPSU_GALLERY_WORKBUF_SIZE, &entry, &option);
+        else
+            req.rc = MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+        mutexLock(&g->mutex);
+        g->done[g->num_done++] = req;
+        g->num_active--;
+        condvarWakeAll(&g->cond);
+    }
+
+    mutexUnlock(&g->mutex);
+}
+
+Result capsuGalleryCreate(CapsuGallery* g, CapsContentType type, u32 num_workers, int prio, int cpuid) {
+    Result rc = 0;
+
+    if (!num_workers || num_workers > CAPSU_GALLERY_MAX_WORKERS)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    memset(g, 0, sizeof(*g));
+    g->type = type;
+    mutexInit(&g->mutex);
+    condvarInit(&g->cond);
+
+    rc = _capsuGalleryList(type, &g->entries, &g->count);
+    if (R_FAILED(rc))
+        return rc;
+
+    for (u32 i = 0; i < num_workers; i++) {
+        CapsuGalleryWorker* w = &g->workers[i];
+        w->gallery = g;
+        w->workbuf = (u8*)memalign(0x1000, CAPSU_GALLERY_WORKBUF_SIZE);
+        if (!w->workbuf) {
+            rc = MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+            break;
+        }
+
+        if (i == 0)
+            w->srv = capsuGetServiceSession();
+        else {
+            rc = capsuOpenSession(&w->own_srv);
+            if (R_FAILED(rc))
+                break;
+            w->srv = &w->own_srv;
+        }
+
+        rc = threadCreate(&w->thread, _capsuGalleryWorkerFunc, w, NULL, 0x4000, prio, cpuid);
+        if (R_SUCCEEDED(rc)) {
+            rc = threadStart(&w->thread);
+            if (R_FAILED(rc))
+                threadClose(&w->thread);
+        }
+        if (R_FAILED(rc)) {
+            serviceClose(&w->own_srv);
+            break;
+        }
+        g->num_workers++;
+    }
+
+    // Extra sessions are best-effort: the gallery works as long as one worker started.
+    if (g->num_workers)
+        rc = 0;
+
+    if (R_FAILED(rc))
+        capsuGalleryClose(g);
+    return rc;
+}
+
+void capsuGalleryClose(CapsuGallery* g) {
+    mutexLock(&g->mutex);
+    g->num_pending = 0;
+    g->should_exit = true;
+    condvarWakeAll(&g->cond);
+    mutexUnlock(&g->mutex);
+
+    for (u32 i = 0; i < CAPSU_GALLERY_MAX_WORKERS; i++) {
+        CapsuGalleryWorker* w = &g->workers[i];
+        if (i < g->num_workers) {
+            threadWaitForExit(&w->thread);
+            threadClose(&w->thread);
+            serviceClose(&w->own_srv);
+        }
+        free(w->workbuf);
+    }
+
+    free(g->entries);
+    memset(g, 0, sizeof(*g));
+}
+
+Result capsuGalleryRefresh(CapsuGallery* g) {
+    CapsApplicationAlbumFileEntry* entries = NULL;
+    s32 count = 0;
+
+    Result rc = _capsuGalleryList(g->type, &entries, &count);
+    if (R_FAILED(rc))
+        return rc;
+
+    // The workers copy the entry they load, so the old listing can be freed right away.
+    mutexLock(&g->mutex);
+    CapsApplicationAlbumFileEntry* old = g->entries;
+    g->entries = entries;
+    g->count = count;
+    g->num_pending = 0;
+    mutexUnlock(&g->mutex);
+
+    free(old);
+    return 0;
+}
+
+Result capsuGalleryRequestThumbnail(CapsuGallery* g, s32 index, void* image, u64 userdata) {
+    Result rc = 0;
+
+    mutexLock(&g->mutex);
+    if (g->num_pending + g->num_active + g->num_done >= CAPSU_GALLERY_MAX_REQUESTS)
+        rc = MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+    else {
+        g->pending[g->num_pending++] = (CapsuGalleryRequest){ .index = index, .image = image, .userdata = userdata };
+        condvarWakeOne(&g->cond);
+    }
+    mutexUnlock(&g->mutex);
+
+    return rc;
+}
+
+u32 capsuGalleryCancelPending(CapsuGallery* g, CapsuGalleryRequest* out, u32 max_out) {
+    mutexLock(&g->mutex);
+    u32 count = g->num_pending;
+    if (out)
+        memcpy(out, g->pending, (count < max_out ? count : max_out) * sizeof(CapsuGalleryRequest));
+    g->num_pending = 0;
+    mutexUnlock(&g->mutex);
+
+    return count;
+}
+
+u32 capsuGalleryGetCompleted(CapsuGallery* g, CapsuGalleryRequest* out, u32 max_out) {
+    mutexLock(&g->mutex);
+    u32 count = g->num_done < max_out ? g->num_done : max_out;
+    memcpy(out, g->done, count * sizeof(CapsuGalleryRequest));
+    g->num_done -= count;
+    memmove(&g->done[0], &g->done[count], g->num_done * sizeof(CapsuGalleryRequest));
+    mutexUnlock(&g->mutex);
+
+    return count;
+}
+
+void capsuGalleryWaitIdle(CapsuGallery* g) {
+    mutexLock(&g->mutex);
+    while (g->num_pending || g->num_active)
+        condvarWait(&g->cond, &g->mutex);
+    mutexUnlock(&g->mutex);
+}
@@ -0,0 +1,232 @@
+#include <string.h>
+#include "types.h"
+#include "result.h"
+#include "arm/counter.h"
+#include "runtime/hosversion.h"
+#include "services/applet.h"
+#include "services/clk_governor.h"
+
+static const PcvModule g_clkGovernorPcvModules[ClkGovernorDomain_Count] = {
+    PcvModule_CpuBus, PcvModule_GPU, PcvModule_EMC,
+};
+
+static const PcvModuleId g_clkGovernorModuleIds[ClkGovernorDomain_Count] = {
+    PcvModuleId_CpuBus, PcvModuleId_GPU, PcvModuleId_EMC,
+};
+
+void clkGovernorConfigDefault(ClkGovernorConfig* config) {
+    memset(config, 0, sizeof(*config));
+    config->rates[ClkGovernorLevel_Idle][ClkGovernorDomain_Cpu] = 1020000000;
+    config->rates[ClkGovernorLevel_Idle][ClkGovernorDomain_Gpu] = 307200000;
+    config->rates[ClkGovernorLevel_Boost][ClkGovernorDomain_Cpu] = 1785000000;
+    config->rates[ClkGovernorLevel_Boost][ClkGovernorDomain_Gpu] = 768000000;
+    config->rates[ClkGovernorLevel_Boost][ClkGovernorDomain_Emc] = 1600000000;
+    config->target_frame_ns = 16666667;
+    config->raise_frames = 3;
+    config->drop_frames = 60;
+    config->drop_percent = 50;
+}
+
+static Result _clkGovernorGetRate(ClkGovernor* g, ClkGovernorDomain d, u32* out_hz) {
+    if (g->backend == ClkGovernorBackend_Clkrst)
+        return clkrstGetClockRate(&g->sessions[d], out_hz);
+    return pcvGetClockRate(g_clkGovernorPcvModules[d], out_hz);
+}
+
+static Result _clkGovernorSetRate(ClkGovernor* g, ClkGovernorDomain d, u32 hz) {
+    if (g->backend == ClkGovernorBackend_Clkrst)
+        return clkrstSetClockRate(&g->sessions[d], hz);
+    return pcvSetClockRate(g_clkGovernorPcvModules[d], hz);
+}
+
+static Result _clkGovernorApply(ClkGovernor* g, ClkGovernorLevel level) {
+    Result rc = 0;
+
+    if (g->backend == ClkGovernorBackend_Apm)
+        return appletSetCpuBoostMode(level == ClkGovernorLevel_Boost ? ApmCpuBoostMode_Type1 : ApmCpuBoostMode_Disabled);
+
+    for (u32 d = 0; d < ClkGovernorDomain_Count; d++) {
+        u32 hz = g->config.rates[level][d];
+        if (!hz || level == ClkGovernorLevel_Normal)
+            hz = g->saved_rates[d];
+
+        // Keep going on failure, so that a domain which can't be changed doesn't hold back the others.
+        Result rc2 = _clkGovernorSetRate(g, d, hz);
+        if (R_FAILED(rc2) && R_SUCCEEDED(rc))
+            rc = rc2;
+    }
+
+    return rc;
+}
+
+// Must be called with the mutex held.
+static Result _clkGovernorUpdate(ClkGovernor* g) {
+    ClkGovernorLevel level = g->hint > g->frame_level ? g->hint : g->frame_level;
+    if (g->boosts)
+        level = ClkGovernorLevel_Boost;
+
+    if (level == g->level)
+        return 0;
+
+    Result rc = _clkGovernorApply(g, level);
+    if (R_SUCCEEDED(rc)) {
+        __atomic_store_n(&g->level, level, __ATOMIC_RELAXED);
+        g->level_changes++;
+    }
+
+    return rc;
+}
+
+Result clkGovernorCreate(ClkGovernor* g, const ClkGovernorConfig* config) {
+    Result rc = 0;
+
+    memset(g, 0, sizeof(*g));
+    if (config)
+        g->config = *config;
+    else
+        clkGovernorConfigDefault(&g->config);
+
+    ClkGovernorConfig* c = &g->config;
+    if (!c->target_frame_ns) c->target_frame_ns = 16666667;
+    if (!c->raise_frames) c->raise_frames = 1;
+    if (!c->drop_frames) c->drop_frames = 1;
+    if (!c->drop_percent || c->drop_percent > 100) c->drop_percent = 50;
+
+    mutexInit(&g->mutex);
+    g->level = ClkGovernorLevel_Normal;
+    g->hint = ClkGovernorLevel_Normal;
+    g->frame_level = ClkGovernorLevel_Idle;
+
+    if (hosversionAtLeast(8,0,0)) {
+        g->backend = ClkGovernorBackend_Clkrst;
+        rc = clkrstInitialize();
+        for (u32 d = 0; R_SUCCEEDED(rc) && d < ClkGovernorDomain_Count; d++) {
+            rc = clkrstOpenSession(&g->sessions[d], g_clkGovernorModuleIds[d], 3);
+            if (R_FAILED(rc)) {
+                while (d--)
+                    clkrstCloseSession(&g->sessions[d]);
+                clkrstExit();
+            }
+        }
+    }
+    else {
+        g->backend = ClkGovernorBackend_Pcv;
+        rc = pcvInitialize();
+    }
+
+    if (R_SUCCEEDED(rc)) {
+        for (u32 d = 0; R_SUCCEEDED(rc) && d < ClkGovernorDomain_Count; d++)
+            rc = _clkGovernorGetRate(g, d, &g->saved_rates[d]);
+
+        if (R_FAILED(rc)) {
+            g->initialized = true;
+            clkGovernorClose(g);
+            return rc;
+        }
+    }
+    else
+        g->backend = ClkGovernorBackend_Apm;
+
+    g->initialized = true;
+    return 0;
+}
+
+void clkGovernorClose(ClkGovernor* g) {
+    if (!g->initialized)
+        return;
+
+    mutexLock(&g->mutex);
+    if (g->level != ClkGovernorLevel_Normal)
+        _clkGovernorApply(g, ClkGovernorLevel_Normal);
+    mutexUnlock(&g->mutex);
+
+    if (g->backend == ClkGovernorBackend_Clkrst) {
+        for (u32 d = 0; d < ClkGovernorDomain_Count; d++)
+            clkrstCloseSession(&g->sessions[d]);
+        clkrstExit();
+    }
+    else if (g->backend == ClkGovernorBackend_Pcv)
+        pcvExit();
+
+    memset(g, 0, sizeof(*g));
+}
+
+Result clkGovernorSetHint(ClkGovernor* g, ClkGovernorLevel level) {
+    if (level >= ClkGovernorLevel_Count)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    mutexLock(&g->mutex);
+    g->hint = level;
+    Result rc = _clkGovernorUpdate(g);
+    mutexUnlock(&g->mutex);
+
+    return rc;
+}
+
+Result clkGovernorBeginBoost(ClkGovernor* g) {
+    mutexLock(&g->mutex);
+    g->boosts++;
+    Result rc = _clkGovernorUpdate(g);
+    mutexUnlock(&g->mutex);
+
+    return rc;
+}
+
+Result clkGovernorEndBoost(ClkGovernor* g) {
+    Result rc = 0;
+
+    mutexLock(&g->mutex);
+    if (!g->boosts)
+        rc = MAKERESULT(Module_Libnx, LibnxError_BadInput);
+    else {
+        // The frame after a loading screen is usually slow, don't let it count.
+        if (!--g->boosts) {
+            g->slow_frames = g->fast_frames = 0;
+            g->last_frame_tick = 0;
+        }
+        rc = _clkGovernorUpdate(g);
+    }
+    mutexUnlock(&g->mutex);
+
+    return rc;
+}
+
+Result clkGovernorFrame(ClkGovernor* g, u64 frame_ns) {
+    ClkGovernorConfig* c = &g->config;
+    Result rc = 0;
+
+    mutexLock(&g->mutex);
+
+    u64 tick = armGetSystemTick();
+    if (!frame_ns) {
+        frame_ns = g->last_frame_tick ? armTicksToNs(tick - g->last_frame_tick) : 0;
+        g->last_frame_tick = tick;
+    }
+
+    if (frame_ns && !g->boosts) {
+        if (frame_ns > c->target_frame_ns) {
+            g->fast_frames = 0;
+            if (++g->slow_frames >= c->raise_frames) {
+                g->slow_frames = 0;
+                // Raise from the applied level: the frame level may be below a hinted one.
+                if (g->level < ClkGovernorLevel_Boost)
+                    g->frame_level = g->level + 1;
+            }
+        }
+        else if (frame_ns < c->target_frame_ns * c->drop_percent / 100) {
+            g->slow_frames = 0;
+            if (++g->fast_frames >= c->drop_frames) {
+                g->fast_frames = 0;
+                if (g->frame_level > ClkGovernorLevel_Idle)
+                    g->frame_level--;
+            }
+        }
+        else
+            g->slow_frames = g->fast_frames = 0;
+
+        rc = _clkGovernorUpdate(g);
+    }
+
+    mutexUnlock(&g->mutex);
+    return rc;
+}
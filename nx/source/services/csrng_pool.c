@@ -0,0 +1,164 @@
+#include <string.h>
+#include "types.h"
+#include "result.h"
+#include "arm/counter.h"
+#include "kernel/mutex.h"
+#include "crypto/chacha20.h"
+#include "services/csrng.h"
+#include "services/spl.h"
+#include "services/csrng_pool.h"
+
+#define CSRNG_POOL_SEED_SIZE      (CHACHA20_KEY_SIZE + CHACHA20_NONCE_SIZE)
+#define CSRNG_POOL_BATCH_SEEDS    16
+#define CSRNG_POOL_BUFFER_SIZE    (4 * CHACHA20_BLOCK_SIZE)
+
+__attribute__((weak)) u64 __nx_csrng_pool_reseed_bytes = 0x100000;
+__attribute__((weak)) u64 __nx_csrng_pool_reseed_ns = 60000000000ULL;
+
+typedef struct {
+    Chacha20Context ctx;
+    u8     buffer[CSRNG_POOL_BUFFER_SIZE];
+    size_t pos;
+    size_t generated;
+    u64    seed_tick;
+    bool   initialized;
+} CsrngPoolThreadState;
+
+// Seeds fetched from the service and not handed out yet, shared by the threads.
+static Mutex g_csrngPoolMutex;
+static u8 g_csrngPoolSeeds[CSRNG_POOL_BATCH_SEEDS * CSRNG_POOL_SEED_SIZE];
+static u32 g_csrngPoolNumSeeds;
+
+static __thread CsrngPoolThreadState g_csrngPoolThread;
+
+static Result _csrngPoolFetchSeed(u8* seed) {
+    Result rc = 0;
+
+    mutexLock(&g_csrngPoolMutex);
+
+    if (!g_csrngPoolNumSeeds) {
+        if (serviceIsActive(csrngGetServiceSession()))
+            rc = csrngGetRandomBytes(g_csrngPoolSeeds, sizeof(g_csrngPoolSeeds));
+        else if (serviceIsActive(splGetServiceSession()))
+            rc = splGetRandomBytes(g_csrngPoolSeeds, sizeof(g_csrngPoolSeeds));
+        else
+            rc = MAKERESULT(Module_Libnx, LibnxError_NotInitialized);
+
+        if (R_SUCCEEDED(rc))
+            g_csrngPoolNumSeeds = CSRNG_POOL_BATCH_SEEDS;
+    }
+
+    if (R_SUCCEEDED(rc)) {
+        // Seeds are erased once handed out, so that they can't be recovered later.
+        u8* src = &g_csrngPoolSeeds[--g_csrngPoolNumSeeds * CSRNG_POOL_SEED_SIZE];
+        memcpy(seed, src, CSRNG_POOL_SEED_SIZE);
+        memset(src, 0, CSRNG_POOL_SEED_SIZE);
+    }
+
+    mutexUnlock(&g_csrngPoolMutex);
+    return rc;
+}
+
+static Result _csrngPoolSeedThread(CsrngPoolThreadState* st) {
+    u8 seed[CSRNG_POOL_SEED_SIZE];
+    u8 mix[CSRNG_POOL_SEED_SIZE];
+
+    Result rc = _csrngPoolFetchSeed(seed);
+    if (R_FAILED(rc))
+        return rc;
+
+    // Mix the new seed with the current state: the pool stays as strong as the best seed it got.
+    if (st->initialized) {
+        memset(mix, 0, sizeof(mix));
+        chacha20Crypt(&st->ctx, mix, mix, sizeof(mix));
+        for (u32 i = 0; i < sizeof(seed); i++)
+            seed[i] ^= mix[i];
+        memset(mix, 0, sizeof(mix));
+    }
+
+    chacha20ContextCreate(&st->ctx, seed, seed + CHACHA20_KEY_SIZE, 0);
+    memset(seed, 0, sizeof(seed));
+    memset(st->buffer, 0, sizeof(st->buffer));
+
+    st->pos = sizeof(st->buffer);
+    st->generated = 0;
+    st->seed_tick = armGetSystemTick();
+    st->initialized = true;
+    return 0;
+}
+
+// Reseeds once the budget is used up. After a failure, the pool keeps going from its current state for the rest of the request, and retries on the next one.
+static void _csrngPoolCheckReseed(CsrngPoolThreadState* st, bool* failed) {
+    if (*failed)
+        return;
+
+    if (st->generated >= __nx_csrng_pool_reseed_bytes || armTicksToNs(armGetSystemTick() - st->seed_tick) >= __nx_csrng_pool_reseed_ns)
+        *failed = R_FAILED(_csrngPoolSeedThread(st));
+}
+
+static void _csrngPoolGenerate(CsrngPoolThreadState* st, u8* out, size_t len) {
+    memset(out, 0, len);
+    chacha20Crypt(&st->ctx, out, out, len);
+    st->generated += len;
+}
+
+Result csrngPoolGet(void* buf, size_t len) {
+    CsrngPoolThreadState* st = &g_csrngPoolThread;
+    u8* out = (u8*)buf;
+    bool reseed_failed = false;
+
+    if (!st->initialized) {
+        Result rc = _csrngPoolSeedThread(st);
+        if (R_FAILED(rc))
+            return rc;
+    }
+
+    while (len > 0) {
+        if (st->pos == sizeof(st->buffer)) {
+            _csrngPoolCheckReseed(st, &reseed_failed);
+
+            // Large requests are generated in place, split at the reseed budget so that they're reseeded along the way.
+            if (len >= sizeof(st->buffer)) {
+                size_t direct = len - (len % CHACHA20_BLOCK_SIZE);
+                if (st->generated < __nx_csrng_pool_reseed_bytes) {
+                    size_t budget = (__nx_csrng_pool_reseed_bytes - st->generated) & ~(size_t)(CHACHA20_BLOCK_SIZE-1);
+                    if (budget < CHACHA20_BLOCK_SIZE)
+                        budget = CHACHA20_BLOCK_SIZE;
+                    if (direct > budget)
+                        direct = budget;
+                }
+                _csrngPoolGenerate(st, out, direct);
+                out += direct;
+                len -= direct;
+                continue;
+            }
+
+            _csrngPoolGenerate(st, st->buffer, sizeof(st->buffer));
+            st->pos = 0;
+        }
+
+        size_t copyable = sizeof(st->buffer) - st->pos;
+        if (copyable > len)
+            copyable = len;
+
+        // Consumed output is erased, so that it can't be recovered later.
+        memcpy(out, st->buffer + st->pos, copyable);
+        memset(st->buffer + st->pos, 0, copyable);
+        st->pos += copyable;
+        out += copyable;
+        len -= copyable;
+    }
+
+    return 0;
+}
+
+u64 csrngPoolGet64(void) {
+    u64 tmp = 0;
+    if (R_FAILED(csrngPoolGet(&tmp, sizeof(tmp))))
+        return 0;
+    return tmp;
+}
+
+void csrngPoolReseed(void) {
+    g_csrngPoolThread.generated = __nx_csrng_pool_reseed_bytes;
+}
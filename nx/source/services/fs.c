@@ -6,30 +6,17 @@
 #include "services/fs.h"
 
 __attribute__((weak)) u32 __nx_fs_num_sessions = 3;
+__attribute__((weak)) u32 __nx_fs_initial_sessions = 1;
+__attribute__((weak)) bool __nx_fs_session_affinity = false;
 
 static Service g_fsSrv;
 static SessionMgr g_fsSessionMgr;
 
 static __thread u32 g_fsPriority = FsPriority_Normal;
 
-NX_INLINE bool _fsObjectIsChild(Service* s)
-{
-    return s->session == g_fsSrv.session;
-}
-
 static void _fsObjectClose(Service* s)
 {
-    if (!_fsObjectIsChild(s)) {
-        serviceClose(s);
-    }
-    else {
-        int slot = sessionmgrAttachClient(&g_fsSessionMgr);
-        uint32_t object_id = serviceGetObjectId(s);
-        serviceAssumeDomain(s);
-        cmifMakeCloseRequest(armGetTls(), object_id);
-        svcSendSyncRequest(sessionmgrGetClientSession(&g_fsSessionMgr, slot));
-        sessionmgrDetachClient(&g_fsSessionMgr, slot);
-    }
+    sessionmgrCloseObject(&g_fsSessionMgr, s);
 }
 
 NX_INLINE Result _fsObjectDispatchImpl(
@@ -38,22 +25,8 @@ NX_INLINE Result _fsObjectDispatchImpl(
     void* out_data, u32 out_data_size,
     SfDispatchParams disp
 ) {
-    int slot = -1;
-    if (_fsObjectIsChild(s)) {
-        slot = sessionmgrAttachClient(&g_fsSessionMgr);
-        if (slot < 0) __builtin_unreachable();
-        disp.target_session = sessionmgrGetClientSession(&g_fsSessionMgr, slot);
-        serviceAssumeDomain(s);
-    }
-
     disp.context = g_fsPriority;
-    Result rc = serviceDispatchImpl(s, request_id, in_data, in_data_size, out_data, out_data_size, disp);
-
-    if (slot >= 0) {
-        sessionmgrDetachClient(&g_fsSessionMgr, slot);
-    }
-
-    return rc;
+    return sessionmgrDispatchImpl(&g_fsSessionMgr, s, request_id, in_data, in_data_size, out_data, out_data_size, disp);
 }
 
 #define _fsObjectDispatch(_s,_rid,...) \
@@ -83,8 +56,16 @@ Result _fsInitialize(void) {
         rc = serviceDispatchIn(&g_fsSrv, 1, pid_placeholder, .in_send_pid = true);
     }
 
+    if (R_SUCCEEDED(rc)) {
+        // Additional sessions are cloned on demand when concurrent operations need them
+        u32 initial_sessions = __nx_fs_initial_sessions;
+        if (initial_sessions < 1) initial_sessions = 1;
+        if (initial_sessions > __nx_fs_num_sessions) initial_sessions = __nx_fs_num_sessions;
+        rc = sessionmgrCreateEx(&g_fsSessionMgr, g_fsSrv.session, initial_sessions, __nx_fs_num_sessions);
+    }
+
     if (R_SUCCEEDED(rc))
-        rc = sessionmgrCreate(&g_fsSessionMgr, g_fsSrv.session, __nx_fs_num_sessions);
+        sessionmgrSetAffinityMode(&g_fsSessionMgr, __nx_fs_session_affinity);
 
     return rc;
 }
@@ -101,6 +82,10 @@ Service* fsGetServiceSession(void) {
     return &g_fsSrv;
 }
 
+SessionMgr* fsGetSessionMgr(void) {
+    return &g_fsSessionMgr;
+}
+
 void fsSetPriority(FsPriority prio) {
     if (hosversionAtLeast(5,0,0))
         g_fsPriority = prio;
@@ -681,6 +666,36 @@ Result fsFileWrite(FsFile* f, s64 off, const void* buf, u64 write_size, u32 opti
     );
 }
 
+Result fsFileReadAsync(FsFile* f, SfAsyncRequest* r, s64 off, void* buf, u64 read_size, u32 option, u64* bytes_read) {
+    const struct {
+        u32 option;
+        u32 pad;
+        s64 offset;
+        u64 read_size;
+    } in = { option, 0, off, read_size };
+
+    return sfasyncBeginInOut(r, &g_fsSessionMgr, &f->s, 0, in, *bytes_read,
+        .context = g_fsPriority,
+        .buffer_attrs = { SfBufferAttr_HipcMapAlias | SfBufferAttr_Out | SfBufferAttr_HipcMapTransferAllowsNonSecure },
+        .buffers = { { buf, read_size } },
+    );
+}
+
+Result fsFileWriteAsync(FsFile* f, SfAsyncRequest* r, s64 off, const void* buf, u64 write_size, u32 option) {
+    const struct {
+        u32 option;
+        u32 pad;
+        s64 offset;
+        u64 write_size;
+    } in = { option, 0, off, write_size };
+
+    return sfasyncBeginIn(r, &g_fsSessionMgr, &f->s, 1, in,
+        .context = g_fsPriority,
+        .buffer_attrs = { SfBufferAttr_HipcMapAlias | SfBufferAttr_In | SfBufferAttr_HipcMapTransferAllowsNonSecure },
+        .buffers = { { buf, write_size } },
+    );
+}
+
 Result fsFileFlush(FsFile* f) {
     return _fsCmdNoIO(&f->s, 2);
 }
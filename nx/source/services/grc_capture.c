@@ -0,0 +1,139 @@
+#include <malloc.h>
+#include <string.h>
+#include "types.h"
+#include "result.h"
+#include "arm/counter.h"
+#include "services/grc_capture.h"
+
+static void _grcdCaptureThreadFunc(void* arg) {
+    GrcdCapture* c = (GrcdCapture*)arg;
+    Result rc = 0;
+
+    mutexLock(&c->mutex);
+
+    for (;;) {
+        if (!c->should_exit && !c->free_mask) {
+            __atomic_add_fetch(&c->stalls, 1, __ATOMIC_RELAXED);
+            while (!c->should_exit && !c->free_mask)
+                condvarWait(&c->cond, &c->mutex);
+        }
+        if (c->should_exit)
+            break;
+
+        u32 index = __builtin_ctz(c->free_mask);
+        c->free_mask &= ~BIT(index);
+        mutexUnlock(&c->mutex);
+
+        // grc:d writes straight into the buffer, which is then handed to the consumers as-is.
+        GrcdCaptureFrame* f = &c->frames[index];
+        u32 num_frames = 0, data_size = 0;
+        u64 start_timestamp = 0;
+        rc = grcdTransfer(c->stream, f->data, c->buffer_size, &num_frames, &data_size, &start_timestamp);
+
+        mutexLock(&c->mutex);
+        if (R_FAILED(rc)) {
+            c->free_mask |= BIT(index);
+            c->rc = rc;
+            condvarWakeAll(&c->cond);
+            break;
+        }
+
+        f->size = data_size < c->buffer_size ? data_size : c->buffer_size;
+        f->num_frames = num_frames;
+        f->start_timestamp = start_timestamp;
+        c->ready[c->num_ready++] = index;
+        condvarWakeAll(&c->cond);
+    }
+
+    mutexUnlock(&c->mutex);
+}
+
+Result grcdCaptureCreate(GrcdCapture* c, GrcStream stream, u32 buffer_size, u32 num_buffers, int prio, int cpuid) {
+    if (num_buffers < 2 || num_buffers > GRCD_CAPTURE_MAX_BUFFERS || !buffer_size)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    memset(c, 0, sizeof(*c));
+    c->stream = stream;
+    c->buffer_size = (buffer_size + 0xFFF) & ~0xFFF;
+    c->num_buffers = num_buffers;
+    c->free_mask = num_buffers < 32 ? BIT(num_buffers) - 1 : ~0U;
+    mutexInit(&c->mutex);
+    condvarInit(&c->cond);
+
+    c->pool = (u8*)memalign(0x1000, (size_t)c->buffer_size * num_buffers);
+    if (!c->pool)
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+
+    for (u32 i = 0; i < num_buffers; i++) {
+        c->frames[i].index = i;
+        c->frames[i].data = c->pool + (size_t)i * c->buffer_size;
+    }
+
+    Result rc = threadCreate(&c->thread, _grcdCaptureThreadFunc, c, NULL, 0x4000, prio, cpuid);
+    if (R_SUCCEEDED(rc)) {
+        rc = threadStart(&c->thread);
+        if (R_FAILED(rc))
+            threadClose(&c->thread);
+    }
+
+    if (R_FAILED(rc)) {
+        free(c->pool);
+        c->pool = NULL;
+    }
+
+    return rc;
+}
+
+void grcdCaptureClose(GrcdCapture* c) {
+    if (!c->pool)
+        return;
+
+    mutexLock(&c->mutex);
+    c->should_exit = true;
+    condvarWakeAll(&c->cond);
+    mutexUnlock(&c->mutex);
+
+    threadWaitForExit(&c->thread);
+    threadClose(&c->thread);
+
+    free(c->pool);
+    memset(c, 0, sizeof(*c));
+}
+
+Result grcdCaptureAcquire(GrcdCapture* c, GrcdCaptureFrame* out, u64 timeout) {
+    Result rc = 0;
+    u64 start = armGetSystemTick();
+
+    mutexLock(&c->mutex);
+
+    while (!c->num_ready && R_SUCCEEDED(c->rc)) {
+        u64 elapsed = armTicksToNs(armGetSystemTick() - start);
+        if (timeout != UINT64_MAX && elapsed >= timeout) {
+            rc = KERNELRESULT(TimedOut);
+            break;
+        }
+        condvarWaitTimeout(&c->cond, &c->mutex, timeout == UINT64_MAX ? UINT64_MAX : timeout - elapsed);
+    }
+
+    if (c->num_ready) {
+        rc = 0;
+        *out = c->frames[c->ready[0]];
+        c->num_ready--;
+        memmove(&c->ready[0], &c->ready[1], c->num_ready * sizeof(u32));
+    }
+    else if (R_SUCCEEDED(rc))
+        rc = c->rc;
+
+    mutexUnlock(&c->mutex);
+    return rc;
+}
+
+void grcdCaptureRelease(GrcdCapture* c, u32 index) {
+    if (index >= c->num_buffers)
+        return;
+
+    mutexLock(&c->mutex);
+    c->free_mask |= BIT(index);
+    condvarWakeAll(&c->cond);
+    mutexUnlock(&c->mutex);
+}
@@ -4,41 +4,57 @@
 #include <stdlib.h>
 #include <malloc.h>
 #include "kernel/shmem.h"
-#include "kernel/rwlock.h"
+#include "kernel/mutex.h"
+#include "kernel/thread.h"
 #include "services/applet.h"
 #include "services/hid.h"
+#include "hid_internal.h"
 #include "runtime/hosversion.h"
+#include "runtime/trace.h"
 
 static Service g_hidSrv;
 static Service g_hidIAppletResource;
 static Service g_hidIActiveVibrationDeviceList;
 static SharedMemory g_hidSharedmem;
 
-static HidTouchScreenEntry g_touchEntry;
-static HidMouseEntry *g_mouseEntry;
-static HidMouse g_mouse;
-static HidKeyboardEntry g_keyboardEntry;
-static HidControllerHeader g_controllerHeaders[10];
-static HidControllerInputEntry g_controllerEntries[10];
-static HidControllerSixAxisLayout g_sixaxisLayouts[10];
-static HidControllerMisc g_controllerMisc[10];
-
-static u64 g_mouseOld, g_mouseHeld, g_mouseDown, g_mouseUp;
-static u64 g_keyboardModOld, g_keyboardModHeld, g_keyboardModDown, g_keyboardModUp;
-static u32 g_keyboardOld[8], g_keyboardHeld[8], g_keyboardDown[8], g_keyboardUp[8];
-static u64 g_controllerOld[10], g_controllerHeld[10], g_controllerDown[10], g_controllerUp[10];
-static bool g_sixaxisEnabled[10];
+// Input state cached by hidScanInput. There are two copies: readers use the front one, selected by the sequence number,
+// while the next scan writes to the back one then publishes it by incrementing the sequence number.
+typedef struct {
+    HidTouchScreenEntry touchEntry;
+    HidMouse mouse;
+    u32 mouseEntry;
+    HidKeyboardEntry keyboardEntry;
+    HidControllerHeader controllerHeaders[10];
+    HidControllerInputEntry controllerEntries[10];
+    HidControllerSixAxisLayout sixaxisLayouts[10];
+    HidControllerMisc controllerMisc[10];
+
+    u64 mouseHeld, mouseDown, mouseUp;
+    u64 keyboardModHeld, keyboardModDown, keyboardModUp;
+    u32 keyboardHeld[8], keyboardDown[8], keyboardUp[8];
+    u64 controllerHeld[10], controllerDown[10], controllerUp[10];
+
+    // Timestamp of the latest accepted entry, and whether the copy above is that entry (as opposed to zeroed).
+    u64 touchTimestamp, mouseTimestamp, keyboardTimestamp, controllerTimestamps[10];
+    bool touchValid, keyboardValid, controllerValid[10];
+    HidControllerLayoutType controllerEntryLayout[10];
+    s8 sixaxisIndex[10];    ///< Sixaxis layout copied to sixaxisLayouts, -1 if zeroed.
+
+    HidControllerID controllerP1AutoID;
+} HidState;
+
+static HidState g_hidState[2];
+static u32 g_hidSeq;
 
+static bool g_sixaxisEnabled[10];
 static HidControllerLayoutType g_controllerLayout[10];
-static u64 g_touchTimestamp, g_mouseTimestamp, g_keyboardTimestamp, g_controllerTimestamps[10];
-
-static HidControllerID g_controllerP1AutoID;
 
 static u8* g_sevenSixAxisSensorBuffer;
 static TransferMemory g_sevenSixAxisSensorTmem0;
 static TransferMemory g_sevenSixAxisSensorTmem1;
 
-static RwLock g_hidLock;
+static Mutex g_hidScanMutex;
+static Mutex g_hidVibrationMutex;
 
 static Result _hidCreateAppletResource(Service* srv, Service* srv_out, u64 AppletResourceUserId);
 static Result _hidGetSharedMemoryHandle(Service* srv, Handle* handle_out);
@@ -49,6 +65,17 @@ static Result _hidDeactivateNpad(void);
 static Result _hidSetDualModeAll(void);
 
 NX_GENERATE_SERVICE_GUARD(hid);
+NX_GENERATE_SERVICE_GUARD_LAZY(hid);
+
+// Thread running _hidInitialize or _hidCleanup, which send commands while holding the service guard.
+static Handle g_hidGuardOwner = INVALID_HANDLE;
+
+// Session to send commands on, performing a deferred initialization first (see hidInitializeLazy).
+static Service* _hidGetSrv(void) {
+    if (__atomic_load_n(&g_hidGuardOwner, __ATOMIC_RELAXED) != threadGetCurHandle())
+        _hidLazyInit();
+    return &g_hidSrv;
+}
 
 Result _hidInitialize(void) {
     HidControllerID idbuf[9] = {
@@ -73,6 +100,8 @@ Result _hidInitialize(void) {
     if (R_FAILED(rc))
         return rc;
 
+    __atomic_store_n(&g_hidGuardOwner, threadGetCurHandle(), __ATOMIC_RELAXED);
+
     rc = _hidCreateAppletResource(&g_hidSrv, &g_hidIAppletResource, AppletResourceUserId);
 
     if (R_SUCCEEDED(rc))
@@ -100,10 +129,13 @@ Result _hidInitialize(void) {
         rc = hidSetNpadJoyHoldType(HidJoyHoldType_Default);
 
     hidReset();
+    __atomic_store_n(&g_hidGuardOwner, INVALID_HANDLE, __ATOMIC_RELAXED);
     return rc;
 }
 
 void _hidCleanup(void) {
+    __atomic_store_n(&g_hidGuardOwner, threadGetCurHandle(), __ATOMIC_RELAXED);
+
     serviceClose(&g_hidIActiveVibrationDeviceList);
 
     hidFinalizeSevenSixAxisSensor();
@@ -117,509 +149,675 @@ void _hidCleanup(void) {
     serviceClose(&g_hidIAppletResource);
     serviceClose(&g_hidSrv);
     shmemClose(&g_hidSharedmem);
+
+    __atomic_store_n(&g_hidGuardOwner, INVALID_HANDLE, __ATOMIC_RELAXED);
 }
 
-void hidReset(void) {
-    rwlockWriteLock(&g_hidLock);
+// Readers never lock: they read the front copy, then retry if a scan was published meanwhile.
+// The writer only writes to a copy once the other one is published, so a read which saw no sequence change wasn't torn.
+static inline const HidState* _hidStateReadBegin(u32* seq) {
+    *seq = __atomic_load_n(&g_hidSeq, __ATOMIC_ACQUIRE);
+    return &g_hidState[*seq & 1];
+}
 
-    // Reset internal state
-    memset(&g_touchEntry, 0, sizeof(HidTouchScreenEntry));
-    memset(&g_mouse, 0, sizeof(HidMouse));
-    memset(&g_keyboardEntry, 0, sizeof(HidKeyboardEntry));
-    memset(g_controllerHeaders, 0, sizeof(g_controllerHeaders));
-    memset(g_controllerEntries, 0, sizeof(g_controllerEntries));
-    memset(g_controllerMisc, 0, sizeof(g_controllerMisc));
-    memset(g_sixaxisLayouts, 0, sizeof(g_sixaxisLayouts));
-    memset(g_sixaxisEnabled, 0, sizeof(g_sixaxisEnabled));
+static inline bool _hidStateReadRetry(u32 seq) {
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&g_hidSeq, __ATOMIC_RELAXED) != seq;
+}
 
-    g_mouseEntry = &g_mouse.entries[0];
-    g_mouseOld = g_mouseHeld = g_mouseDown = g_mouseUp = 0;
-    g_keyboardModOld = g_keyboardModHeld = g_keyboardModDown = g_keyboardModUp = 0;
-    for (int i = 0; i < 8; i++)
-        g_keyboardOld[i] = g_keyboardHeld[i] = g_keyboardDown[i] = g_keyboardUp[i] = 0;
-    for (int i = 0; i < 10; i++)
-        g_controllerOld[i] = g_controllerHeld[i] = g_controllerDown[i] = g_controllerUp[i] = 0;
+// Returns the index to use for id, or -1 if it's invalid.
+static inline int _hidStateController(const HidState* s, HidControllerID id) {
+    if (id == CONTROLLER_P1_AUTO) return s->controllerP1AutoID;
+    if (id < 0 || id > 9) return -1;
+    return id;
+}
 
-    for (int i = 0; i < 10; i++)
-        g_controllerLayout[i] = LAYOUT_DEFAULT;
+void hidReset(void) {
+    mutexLock(&g_hidScanMutex);
 
-    g_touchTimestamp = g_mouseTimestamp = g_keyboardTimestamp = 0;
-    for (int i = 0; i < 10; i++)
-        g_controllerTimestamps[i] = 0;
+    // Reset internal state, one copy at a time like a scan would, so that readers never see it half-cleared.
+    for (int i = 0; i < 2; i++) {
+        u32 seq = g_hidSeq;
+        HidState* cur = &g_hidState[(seq + 1) & 1];
+        __atomic_thread_fence(__ATOMIC_RELEASE);
 
-    g_controllerP1AutoID = CONTROLLER_HANDHELD;
+        memset(cur, 0, sizeof(HidState));
+        cur->controllerP1AutoID = CONTROLLER_HANDHELD;
+        for (int j = 0; j < 10; j++)
+            cur->sixaxisIndex[j] = -1;
 
-    rwlockWriteUnlock(&g_hidLock);
+        __atomic_store_n(&g_hidSeq, seq + 1, __ATOMIC_RELEASE);
+    }
+
+    for (int i = 0; i < 10; i++) {
+        __atomic_store_n(&g_sixaxisEnabled[i], false, __ATOMIC_RELAXED);
+        __atomic_store_n(&g_controllerLayout[i], LAYOUT_DEFAULT, __ATOMIC_RELAXED);
+    }
+
+    mutexUnlock(&g_hidScanMutex);
 }
 
 Service* hidGetServiceSession(void) {
-    return &g_hidSrv;
+    return _hidGetSrv();
 }
 
 void* hidGetSharedmemAddr(void) {
+    _hidLazyInit();
     return shmemGetAddr(&g_hidSharedmem);
 }
 
 void hidSetControllerLayout(HidControllerID id, HidControllerLayoutType layoutType) {
     if (id < 0 || id > 9) return;
 
-    rwlockWriteLock(&g_hidLock);
-    g_controllerLayout[id] = layoutType;
-    rwlockWriteUnlock(&g_hidLock);
+    __atomic_store_n(&g_controllerLayout[id], layoutType, __ATOMIC_RELAXED);
 }
 
 HidControllerLayoutType hidGetControllerLayout(HidControllerID id) {
     if (id < 0 || id > 9) return LAYOUT_DEFAULT;
 
-    rwlockReadLock(&g_hidLock);
-    HidControllerLayoutType tmp = g_controllerLayout[id];
-    rwlockReadUnlock(&g_hidLock);
-
-    return tmp;
+    return __atomic_load_n(&g_controllerLayout[id], __ATOMIC_RELAXED);
 }
 
 void hidScanInput(void) {
-    rwlockWriteLock(&g_hidLock);
-
+    traceScope("hidScanInput");
     HidSharedMemory *sharedMem = (HidSharedMemory*)hidGetSharedmemAddr();
 
-    g_mouseOld = g_mouseHeld;
-    g_keyboardModOld = g_keyboardModHeld;
-    memcpy(g_keyboardOld, g_keyboardHeld, sizeof(g_keyboardOld));
-    memcpy(g_controllerOld, g_controllerHeld, sizeof(g_controllerOld));
-
-    g_mouseHeld = 0;
-    g_keyboardModHeld = 0;
-    memset(g_keyboardHeld, 0, sizeof(g_keyboardHeld));
-    memset(g_controllerHeld, 0, sizeof(g_controllerHeld));
-    memset(&g_touchEntry, 0, sizeof(HidTouchScreenEntry));
-    memset(&g_mouse, 0, sizeof(HidMouse));
-    memset(&g_keyboardEntry, 0, sizeof(HidKeyboardEntry));
-    memset(g_controllerEntries, 0, sizeof(g_controllerEntries));
-    memset(g_controllerMisc, 0, sizeof(g_controllerMisc));
-    memset(g_sixaxisLayouts, 0, sizeof(g_sixaxisLayouts));
+    mutexLock(&g_hidScanMutex);
+
+    u32 seq = g_hidSeq;
+    const HidState* prev = &g_hidState[seq & 1];
+    HidState* cur = &g_hidState[(seq + 1) & 1];
+
+    // The back copy was last published two scans ago, and is only updated where the shared memory changed since then.
+    // Order the previous publish before writing to it, since readers of that scan may still be reading it.
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    cur->controllerHeld[CONTROLLER_HANDHELD] = 0;
 
     u64 latestTouchEntry = sharedMem->touchscreen.header.latestEntry;
     HidTouchScreenEntry *newTouchEntry = &sharedMem->touchscreen.entries[latestTouchEntry];
-    if ((s64)(newTouchEntry->header.timestamp - g_touchTimestamp) >= 0) {
-        memcpy(&g_touchEntry, newTouchEntry, sizeof(HidTouchScreenEntry));
-        g_touchTimestamp = newTouchEntry->header.timestamp;
-
-        if (hidTouchCount())
-            g_controllerHeld[CONTROLLER_HANDHELD] |= KEY_TOUCH;
+    u64 touchTimestamp = newTouchEntry->header.timestamp;
+    if ((s64)(touchTimestamp - prev->touchTimestamp) >= 0) {
+        if (!cur->touchValid || cur->touchTimestamp != touchTimestamp)
+            memcpy(&cur->touchEntry, newTouchEntry, sizeof(HidTouchScreenEntry));
+        cur->touchTimestamp = touchTimestamp;
+        cur->touchValid = true;
+
+        if (cur->touchEntry.header.numTouches)
+            cur->controllerHeld[CONTROLLER_HANDHELD] |= KEY_TOUCH;
+    }
+    else {
+        if (cur->touchValid)
+            memset(&cur->touchEntry, 0, sizeof(HidTouchScreenEntry));
+        cur->touchTimestamp = prev->touchTimestamp;
+        cur->touchValid = false;
     }
 
     u64 latestMouseEntry = sharedMem->mouse.header.latestEntry;
     HidMouseEntry *newMouseEntry = &sharedMem->mouse.entries[latestMouseEntry];
-    memcpy(&g_mouse, &sharedMem->mouse, sizeof(HidMouse));
-    if ((s64)(newMouseEntry->timestamp - g_mouseTimestamp) >= 0) {
-        g_mouseEntry = &g_mouse.entries[latestMouseEntry];
-        g_mouseTimestamp = newMouseEntry->timestamp;
-
-        g_mouseHeld = g_mouseEntry->buttons;
+    u64 mouseTimestamp = newMouseEntry->timestamp;
+    if (cur->mouse.header.latestEntry != latestMouseEntry || cur->mouse.entries[latestMouseEntry].timestamp != mouseTimestamp)
+        memcpy(&cur->mouse, &sharedMem->mouse, sizeof(HidMouse));
+    cur->mouseHeld = 0;
+    if ((s64)(mouseTimestamp - prev->mouseTimestamp) >= 0) {
+        cur->mouseEntry = latestMouseEntry;
+        cur->mouseTimestamp = mouseTimestamp;
+
+        cur->mouseHeld = cur->mouse.entries[latestMouseEntry].buttons;
+    }
+    else {
+        cur->mouseEntry = prev->mouseEntry;
+        cur->mouseTimestamp = prev->mouseTimestamp;
     }
-    g_mouseDown = (~g_mouseOld) & g_mouseHeld;
-    g_mouseUp = g_mouseOld & (~g_mouseHeld);
+    cur->mouseDown = (~prev->mouseHeld) & cur->mouseHeld;
+    cur->mouseUp = prev->mouseHeld & (~cur->mouseHeld);
 
     u64 latestKeyboardEntry = sharedMem->keyboard.header.latestEntry;
     HidKeyboardEntry *newKeyboardEntry = &sharedMem->keyboard.entries[latestKeyboardEntry];
-    if ((s64)(newKeyboardEntry->timestamp - g_keyboardTimestamp) >= 0) {
-        memcpy(&g_keyboardEntry, newKeyboardEntry, sizeof(HidKeyboardEntry));
-        g_keyboardTimestamp = newKeyboardEntry->timestamp;
-
-        g_keyboardModHeld = g_keyboardEntry.modifier;
-        for (int i = 0; i < 8; i++) {
-            g_keyboardHeld[i] = g_keyboardEntry.keys[i];
-        }
+    u64 keyboardTimestamp = newKeyboardEntry->timestamp;
+    if ((s64)(keyboardTimestamp - prev->keyboardTimestamp) >= 0) {
+        if (!cur->keyboardValid || cur->keyboardTimestamp != keyboardTimestamp)
+            memcpy(&cur->keyboardEntry, newKeyboardEntry, sizeof(HidKeyboardEntry));
+        cur->keyboardTimestamp = keyboardTimestamp;
+        cur->keyboardValid = true;
+    }
+    else {
+        if (cur->keyboardValid)
+            memset(&cur->keyboardEntry, 0, sizeof(HidKeyboardEntry));
+        cur->keyboardTimestamp = prev->keyboardTimestamp;
+        cur->keyboardValid = false;
     }
-    g_keyboardModDown = (~g_keyboardModOld) & g_keyboardModHeld;
-    g_keyboardModUp = g_keyboardModOld & (~g_keyboardModHeld);
+    cur->keyboardModHeld = cur->keyboardEntry.modifier;
+    cur->keyboardModDown = (~prev->keyboardModHeld) & cur->keyboardModHeld;
+    cur->keyboardModUp = prev->keyboardModHeld & (~cur->keyboardModHeld);
     for (int i = 0; i < 8; i++) {
-        g_keyboardDown[i] = (~g_keyboardOld[i]) & g_keyboardHeld[i];
-        g_keyboardUp[i] = g_keyboardOld[i] & (~g_keyboardHeld[i]);
+        cur->keyboardHeld[i] = cur->keyboardEntry.keys[i];
+        cur->keyboardDown[i] = (~prev->keyboardHeld[i]) & cur->keyboardHeld[i];
+        cur->keyboardUp[i] = prev->keyboardHeld[i] & (~cur->keyboardHeld[i]);
     }
 
     for (int i = 0; i < 10; i++) {
-        HidControllerLayout *currentLayout = &sharedMem->controllers[i].layouts[g_controllerLayout[i]];
-        memcpy(&g_controllerHeaders[i], &sharedMem->controllers[i].header, sizeof(HidControllerHeader));
+        HidControllerLayoutType layout = __atomic_load_n(&g_controllerLayout[i], __ATOMIC_RELAXED);
+        HidControllerLayout *currentLayout = &sharedMem->controllers[i].layouts[layout];
+        memcpy(&cur->controllerHeaders[i], &sharedMem->controllers[i].header, sizeof(HidControllerHeader));
         u64 latestControllerEntry = currentLayout->header.latestEntry;
         HidControllerInputEntry *newInputEntry = &currentLayout->entries[latestControllerEntry];
-        if ((s64)(newInputEntry->timestamp - g_controllerTimestamps[i]) >= 0) {
-            memcpy(&g_controllerEntries[i], newInputEntry, sizeof(HidControllerInputEntry));
-            g_controllerTimestamps[i] = newInputEntry->timestamp;
+        u64 controllerTimestamp = newInputEntry->timestamp;
 
-            g_controllerHeld[i] |= g_controllerEntries[i].buttons;
+        if (i != CONTROLLER_HANDHELD)
+            cur->controllerHeld[i] = 0;
+
+        if ((s64)(controllerTimestamp - prev->controllerTimestamps[i]) >= 0) {
+            if (!cur->controllerValid[i] || cur->controllerTimestamps[i] != controllerTimestamp || cur->controllerEntryLayout[i] != layout)
+                memcpy(&cur->controllerEntries[i], newInputEntry, sizeof(HidControllerInputEntry));
+            cur->controllerTimestamps[i] = controllerTimestamp;
+            cur->controllerEntryLayout[i] = layout;
+            cur->controllerValid[i] = true;
+
+            cur->controllerHeld[i] |= cur->controllerEntries[i].buttons;
+        }
+        else {
+            if (cur->controllerValid[i])
+                memset(&cur->controllerEntries[i], 0, sizeof(HidControllerInputEntry));
+            cur->controllerTimestamps[i] = prev->controllerTimestamps[i];
+            cur->controllerValid[i] = false;
         }
 
-        g_controllerDown[i] = (~g_controllerOld[i]) & g_controllerHeld[i];
-        g_controllerUp[i] = g_controllerOld[i] & (~g_controllerHeld[i]);
+        cur->controllerDown[i] = (~prev->controllerHeld[i]) & cur->controllerHeld[i];
+        cur->controllerUp[i] = prev->controllerHeld[i] & (~cur->controllerHeld[i]);
 
-        memcpy(&g_controllerMisc[i], &sharedMem->controllers[i].misc, sizeof(HidControllerMisc));
+        memcpy(&cur->controllerMisc[i], &sharedMem->controllers[i].misc, sizeof(HidControllerMisc));
 
-        if (g_sixaxisEnabled[i]) {
-            u32 type = g_controllerHeaders[i].type;
-            HidControllerSixAxisLayout *sixaxis = NULL;
-            if (type & TYPE_PROCONTROLLER) {
-                sixaxis = &sharedMem->controllers[i].sixaxis[0];
-            }
-            else if (type & TYPE_HANDHELD) {
-                sixaxis = &sharedMem->controllers[i].sixaxis[1];
-            }
-            else if (type & TYPE_JOYCON_PAIR) {
-                if (type & TYPE_JOYCON_LEFT) {
-                    sixaxis = &sharedMem->controllers[i].sixaxis[2];
-                }
-                else {
-                    sixaxis = &sharedMem->controllers[i].sixaxis[3];
-                }
-            }
-            else if (type & TYPE_JOYCON_LEFT) {
-                sixaxis = &sharedMem->controllers[i].sixaxis[4];
-            }
-            else if (type & TYPE_JOYCON_RIGHT) {
-                sixaxis = &sharedMem->controllers[i].sixaxis[5];
-            }
-            if (sixaxis) {
-                memcpy(&g_sixaxisLayouts[i], sixaxis, sizeof(*sixaxis));
-            }
+        int sixaxisIndex = -1;
+        if (__atomic_load_n(&g_sixaxisEnabled[i], __ATOMIC_RELAXED))
+            sixaxisIndex = _hidGetSixAxisIndex(cur->controllerHeaders[i].type);
+
+        if (sixaxisIndex >= 0) {
+            HidControllerSixAxisLayout *sixaxis = &sharedMem->controllers[i].sixaxis[sixaxisIndex];
+            HidControllerSixAxisLayout *copy = &cur->sixaxisLayouts[i];
+            u64 latestSixaxisEntry = sixaxis->header.latestEntry;
+            if (cur->sixaxisIndex[i] != sixaxisIndex || copy->header.latestEntry != latestSixaxisEntry ||
+                copy->entries[latestSixaxisEntry].timestamp != sixaxis->entries[latestSixaxisEntry].timestamp)
+                memcpy(copy, sixaxis, sizeof(*sixaxis));
         }
+        else if (cur->sixaxisIndex[i] >= 0)
+            memset(&cur->sixaxisLayouts[i], 0, sizeof(HidControllerSixAxisLayout));
+        cur->sixaxisIndex[i] = sixaxisIndex;
     }
 
-    g_controllerP1AutoID = CONTROLLER_HANDHELD;
-    if (g_controllerEntries[CONTROLLER_PLAYER_1].connectionState & CONTROLLER_STATE_CONNECTED)
-       g_controllerP1AutoID = CONTROLLER_PLAYER_1;
+    cur->controllerP1AutoID = CONTROLLER_HANDHELD;
+    if (cur->controllerEntries[CONTROLLER_PLAYER_1].connectionState & CONTROLLER_STATE_CONNECTED)
+       cur->controllerP1AutoID = CONTROLLER_PLAYER_1;
 
-    rwlockWriteUnlock(&g_hidLock);
+    __atomic_store_n(&g_hidSeq, seq + 1, __ATOMIC_RELEASE);
+
+    mutexUnlock(&g_hidScanMutex);
 }
 
 HidControllerType hidGetControllerType(HidControllerID id) {
-    if (id==CONTROLLER_P1_AUTO) return hidGetControllerType(g_controllerP1AutoID);
-    if (id < 0 || id > 9) return 0;
+    u32 seq;
+    u32 tmp;
 
-    rwlockReadLock(&g_hidLock);
-    u32 tmp = g_controllerHeaders[id].type;
-    rwlockReadUnlock(&g_hidLock);
+    do {
+        const HidState* s = _hidStateReadBegin(&seq);
+        int i = _hidStateController(s, id);
+        tmp = i >= 0 ? s->controllerHeaders[i].type : 0;
+    } while (_hidStateReadRetry(seq));
 
     return tmp;
 }
 
 void hidGetControllerColors(HidControllerID id, HidControllerColors *colors) {
-    if (id==CONTROLLER_P1_AUTO) {
-        hidGetControllerColors(g_controllerP1AutoID, colors);
-        return;
-    }
-    if (id < 0 || id > 9) return;
     if (colors == NULL) return;
 
-    HidControllerHeader *hdr = &g_controllerHeaders[id];
+    u32 seq;
+    HidControllerHeader hdr;
 
-    memset(colors, 0, sizeof(HidControllerColors));
+    do {
+        const HidState* s = _hidStateReadBegin(&seq);
+        int i = _hidStateController(s, id);
+        if (i < 0) return;
+        hdr = s->controllerHeaders[i];
+    } while (_hidStateReadRetry(seq));
 
-    rwlockReadLock(&g_hidLock);
+    memset(colors, 0, sizeof(HidControllerColors));
 
-    colors->singleSet = (hdr->singleColorsDescriptor & BIT(1)) == 0;
-    colors->splitSet = (hdr->splitColorsDescriptor & BIT(1)) == 0;
+    colors->singleSet = (hdr.singleColorsDescriptor & BIT(1)) == 0;
+    colors->splitSet = (hdr.splitColorsDescriptor & BIT(1)) == 0;
 
     if (colors->singleSet) {
-        colors->singleColorBody = hdr->singleColorBody;
-        colors->singleColorButtons = hdr->singleColorButtons;
+        colors->singleColorBody = hdr.singleColorBody;
+        colors->singleColorButtons = hdr.singleColorButtons;
     }
 
     if (colors->splitSet) {
-        colors->leftColorBody = hdr->leftColorBody;
-        colors->leftColorButtons = hdr->leftColorButtons;
-        colors->rightColorBody = hdr->rightColorBody;
-        colors->rightColorButtons = hdr->rightColorButtons;
+        colors->leftColorBody = hdr.leftColorBody;
+        colors->leftColorButtons = hdr.leftColorButtons;
+        colors->rightColorBody = hdr.rightColorBody;
+        colors->rightColorButtons = hdr.rightColorButtons;
     }
-
-    rwlockReadUnlock(&g_hidLock);
 }
 
 bool hidIsControllerConnected(HidControllerID id) {
-    if (id==CONTROLLER_P1_AUTO)
-        return hidIsControllerConnected(g_controllerP1AutoID);
-    if (id < 0 || id > 9) return 0;
+    u32 seq;
+    bool flag;
+
+    do {
+        const HidState* s = _hidStateReadBegin(&seq);
+        int i = _hidStateController(s, id);
+        flag = i >= 0 && (s->controllerEntries[i].connectionState & CONTROLLER_STATE_CONNECTED) != 0;
+    } while (_hidStateReadRetry(seq));
 
-    rwlockReadLock(&g_hidLock);
-    bool flag = (g_controllerEntries[id].connectionState & CONTROLLER_STATE_CONNECTED) != 0;
-    rwlockReadUnlock(&g_hidLock);
     return flag;
 }
 
 u32 hidGetControllerDeviceType(HidControllerID id) {
-    if (id==CONTROLLER_P1_AUTO)
-        return hidGetControllerDeviceType(g_controllerP1AutoID);
-    if (id < 0 || id > 9) return 0;
+    u32 seq;
+    u32 type;
+
+    do {
+        const HidState* s = _hidStateReadBegin(&seq);
+        int i = _hidStateController(s, id);
+        type = i >= 0 ? s->controllerMisc[i].deviceType : 0;
+    } while (_hidStateReadRetry(seq));
 
-    rwlockReadLock(&g_hidLock);
-    u32 type = g_controllerMisc[id].deviceType;
-    rwlockReadUnlock(&g_hidLock);
     return type;
 }
 
 void hidGetControllerFlags(HidControllerID id, HidFlags *flags) {
-    if (id==CONTROLLER_P1_AUTO) {
-        hidGetControllerFlags(g_controllerP1AutoID, flags);
-        return;
-    }
-    if (id < 0 || id > 9) return;
+    u32 seq;
+    HidFlags tmp;
 
-    rwlockReadLock(&g_hidLock);
-    *flags = g_controllerMisc[id].flags;
-    rwlockReadUnlock(&g_hidLock);
+    do {
+        const HidState* s = _hidStateReadBegin(&seq);
+        int i = _hidStateController(s, id);
+        if (i < 0) return;
+        tmp = s->controllerMisc[i].flags;
+    } while (_hidStateReadRetry(seq));
+
+    *flags = tmp;
 }
 
 void hidGetControllerPowerInfo(HidControllerID id, HidPowerInfo *info, size_t total_info) {
     size_t i;
     size_t indexbase;
     HidFlags flags;
-
-    if (id==CONTROLLER_P1_AUTO) {
-        hidGetControllerPowerInfo(g_controllerP1AutoID, info, total_info);
-        return;
-    }
-    if (id < 0 || id > 9) return;
+    u32 batteryCharge[2];
+    u32 seq;
 
     if (total_info == 0) return;
     if (total_info > 2) total_info = 2;
     indexbase = total_info-1;
 
-    hidGetControllerFlags(id, &flags);
+    do {
+        const HidState* s = _hidStateReadBegin(&seq);
+        int ctrl = _hidStateController(s, id);
+        if (ctrl < 0) return;
+        flags = s->controllerMisc[ctrl].flags;
+        for (i=0; i<total_info; i++)
+            batteryCharge[i] = s->controllerMisc[ctrl].batteryCharge[indexbase+i];
+    } while (_hidStateReadRetry(seq));
 
     for (i=0; i<total_info; i++) {
         info[i].isCharging = (flags.powerInfo & BIT(indexbase+i)) != 0;
         info[i].powerConnected = (flags.powerInfo & BIT(indexbase+i+3)) != 0;
-
-        rwlockReadLock(&g_hidLock);
-        info[i].batteryCharge = g_controllerMisc[id].batteryCharge[indexbase+i];
-        rwlockReadUnlock(&g_hidLock);
+        info[i].batteryCharge = batteryCharge[i];
         if (info[i].batteryCharge > 4) info->batteryCharge = 4;
     }
 }
 
 u64 hidKeysHeld(HidControllerID id) {
-    if (id==CONTROLLER_P1_AUTO) return hidKeysHeld(g_controllerP1AutoID);
-    if (id < 0 || id > 9) return 0;
+    u32 seq;
+    u64 tmp;
 
-    rwlockReadLock(&g_hidLock);
-    u64 tmp = g_controllerHeld[id];
-    rwlockReadUnlock(&g_hidLock);
+    do {
+        const HidState* s = _hidStateReadBegin(&seq);
+        int i = _hidStateController(s, id);
+        tmp = i >= 0 ? s->controllerHeld[i] : 0;
+    } while (_hidStateReadRetry(seq));
 
     return tmp;
 }
 
 u64 hidKeysDown(HidControllerID id) {
-    if (id==CONTROLLER_P1_AUTO) return hidKeysDown(g_controllerP1AutoID);
-    if (id < 0 || id > 9) return 0;
+    u32 seq;
+    u64 tmp;
 
-    rwlockReadLock(&g_hidLock);
-    u64 tmp = g_controllerDown[id];
-    rwlockReadUnlock(&g_hidLock);
+    do {
+        const HidState* s = _hidStateReadBegin(&seq);
+        int i = _hidStateController(s, id);
+        tmp = i >= 0 ? s->controllerDown[i] : 0;
+    } while (_hidStateReadRetry(seq));
 
     return tmp;
 }
 
 u64 hidKeysUp(HidControllerID id) {
-    if (id==CONTROLLER_P1_AUTO) return hidKeysUp(g_controllerP1AutoID);
-    if (id < 0 || id > 9) return 0;
+    u32 seq;
+    u64 tmp;
 
-    rwlockReadLock(&g_hidLock);
-    u64 tmp = g_controllerUp[id];
-    rwlockReadUnlock(&g_hidLock);
+    do {
+        const HidState* s = _hidStateReadBegin(&seq);
+        int i = _hidStateController(s, id);
+        tmp = i >= 0 ? s->controllerUp[i] : 0;
+    } while (_hidStateReadRetry(seq));
 
     return tmp;
 }
 
 u64 hidMouseButtonsHeld(void) {
-    rwlockReadLock(&g_hidLock);
-    u64 tmp = g_mouseHeld;
-    rwlockReadUnlock(&g_hidLock);
+    u32 seq;
+    u64 tmp;
+
+    do {
+        tmp = _hidStateReadBegin(&seq)->mouseHeld;
+    } while (_hidStateReadRetry(seq));
 
     return tmp;
 }
 
 u64 hidMouseButtonsDown(void) {
-    rwlockReadLock(&g_hidLock);
-    u64 tmp = g_mouseDown;
-    rwlockReadUnlock(&g_hidLock);
+    u32 seq;
+    u64 tmp;
+
+    do {
+        tmp = _hidStateReadBegin(&seq)->mouseDown;
+    } while (_hidStateReadRetry(seq));
 
     return tmp;
 }
 
 u64 hidMouseButtonsUp(void) {
-    rwlockReadLock(&g_hidLock);
-    u64 tmp = g_mouseUp;
-    rwlockReadUnlock(&g_hidLock);
+    u32 seq;
+    u64 tmp;
+
+    do {
+        tmp = _hidStateReadBegin(&seq)->mouseUp;
+    } while (_hidStateReadRetry(seq));
 
     return tmp;
 }
 
 void hidMouseRead(MousePosition *pos) {
-    rwlockReadLock(&g_hidLock);
-    *pos = g_mouseEntry->position;
-    rwlockReadUnlock(&g_hidLock);
+    u32 seq;
+    MousePosition tmp;
+
+    do {
+        const HidState* s = _hidStateReadBegin(&seq);
+        tmp = s->mouse.entries[s->mouseEntry].position;
+    } while (_hidStateReadRetry(seq));
+
+    *pos = tmp;
 }
 
 u32 hidMouseMultiRead(MousePosition *entries, u32 num_entries) {
     int entry;
     int i;
+    u32 seq;
 
     if (!entries || !num_entries) return 0;
 
     memset(entries, 0, sizeof(MousePosition) * num_entries);
 
-    rwlockReadLock(&g_hidLock);
+    do {
+        const HidState* s = _hidStateReadBegin(&seq);
+        const HidMouse* mouse = &s->mouse;
+        u32 count = num_entries;
 
-    if (num_entries > g_mouse.header.maxEntryIndex + 1)
-        num_entries = g_mouse.header.maxEntryIndex + 1;
+        if (count > mouse->header.maxEntryIndex + 1)
+            count = mouse->header.maxEntryIndex + 1;
 
-    entry = g_mouse.header.latestEntry + 1 - num_entries;
-    if (entry < 0)
-        entry += g_mouse.header.maxEntryIndex + 1;
+        entry = mouse->header.latestEntry + 1 - count;
+        if (entry < 0)
+            entry += mouse->header.maxEntryIndex + 1;
 
-    u64 timestamp = 0;
-    for (i = 0; i < num_entries; i++) {
-        if (timestamp && g_mouse.entries[entry].timestamp - timestamp != 1)
-            break;
-        memcpy(&entries[i], &g_mouse.entries[entry].position, sizeof(MousePosition));
-        timestamp = g_mouse.entries[entry].timestamp;
+        u64 timestamp = 0;
+        for (i = 0; i < count; i++) {
+            if (timestamp && mouse->entries[entry].timestamp - timestamp != 1)
+                break;
+            memcpy(&entries[i], &mouse->entries[entry].position, sizeof(MousePosition));
+            timestamp = mouse->entries[entry].timestamp;
 
-        entry++;
-        if (entry > g_mouse.header.maxEntryIndex)
-            entry = 0;
-    }
-
-    rwlockReadUnlock(&g_hidLock);
+            entry++;
+            if (entry > mouse->header.maxEntryIndex)
+                entry = 0;
+        }
+    } while (_hidStateReadRetry(seq));
 
     return i;
 }
 
 bool hidKeyboardModifierHeld(HidKeyboardModifier modifier) {
-    rwlockReadLock(&g_hidLock);
-    bool tmp = g_keyboardModHeld & modifier;
-    rwlockReadUnlock(&g_hidLock);
+    u32 seq;
+    bool tmp;
+
+    do {
+        tmp = _hidStateReadBegin(&seq)->keyboardModHeld & modifier;
+    } while (_hidStateReadRetry(seq));
 
     return tmp;
 }
 
 bool hidKeyboardModifierDown(HidKeyboardModifier modifier) {
-    rwlockReadLock(&g_hidLock);
-    bool tmp = g_keyboardModDown & modifier;
-    rwlockReadUnlock(&g_hidLock);
+    u32 seq;
+    bool tmp;
+
+    do {
+        tmp = _hidStateReadBegin(&seq)->keyboardModDown & modifier;
+    } while (_hidStateReadRetry(seq));
 
     return tmp;
 }
 
 bool hidKeyboardModifierUp(HidKeyboardModifier modifier) {
-    rwlockReadLock(&g_hidLock);
-    bool tmp = g_keyboardModUp & modifier;
-    rwlockReadUnlock(&g_hidLock);
+    u32 seq;
+    bool tmp;
+
+    do {
+        tmp = _hidStateReadBegin(&seq)->keyboardModUp & modifier;
+    } while (_hidStateReadRetry(seq));
 
     return tmp;
 }
 
 bool hidKeyboardHeld(HidKeyboardScancode key) {
-    rwlockReadLock(&g_hidLock);
-    u32 tmp = g_keyboardHeld[key / 32] & (1 << (key % 32));
-    rwlockReadUnlock(&g_hidLock);
+    u32 seq;
+    u32 tmp;
+
+    do {
+        tmp = _hidStateReadBegin(&seq)->keyboardHeld[key / 32] & (1 << (key % 32));
+    } while (_hidStateReadRetry(seq));
 
     return !!tmp;
 }
 
 bool hidKeyboardDown(HidKeyboardScancode key) {
-    rwlockReadLock(&g_hidLock);
-    u32 tmp = g_keyboardDown[key / 32] & (1 << (key % 32));
-    rwlockReadUnlock(&g_hidLock);
+    u32 seq;
+    u32 tmp;
+
+    do {
+        tmp = _hidStateReadBegin(&seq)->keyboardDown[key / 32] & (1 << (key % 32));
+    } while (_hidStateReadRetry(seq));
 
     return !!tmp;
 }
 
 bool hidKeyboardUp(HidKeyboardScancode key) {
-    rwlockReadLock(&g_hidLock);
-    u32 tmp = g_keyboardUp[key / 32] & (1 << (key % 32));
-    rwlockReadUnlock(&g_hidLock);
+    u32 seq;
+    u32 tmp;
+
+    do {
+        tmp = _hidStateReadBegin(&seq)->keyboardUp[key / 32] & (1 << (key % 32));
+    } while (_hidStateReadRetry(seq));
 
     return !!tmp;
 }
 
 u32 hidTouchCount(void) {
-    return g_touchEntry.header.numTouches;
+    u32 seq;
+    u32 tmp;
+
+    do {
+        tmp = _hidStateReadBegin(&seq)->touchEntry.header.numTouches;
+    } while (_hidStateReadRetry(seq));
+
+    return tmp;
 }
 
 void hidTouchRead(touchPosition *pos, u32 point_id) {
     if (pos) {
-        if (point_id >= g_touchEntry.header.numTouches) {
-            memset(pos, 0, sizeof(touchPosition));
-            return;
-        }
+        u32 seq;
 
-        pos->id = g_touchEntry.touches[point_id].touchIndex;
-        pos->px = g_touchEntry.touches[point_id].x;
-        pos->py = g_touchEntry.touches[point_id].y;
-        pos->dx = g_touchEntry.touches[point_id].diameterX;
-        pos->dy = g_touchEntry.touches[point_id].diameterY;
-        pos->angle = g_touchEntry.touches[point_id].angle;
+        do {
+            const HidState* s = _hidStateReadBegin(&seq);
+            const HidTouchScreenEntry* touchEntry = &s->touchEntry;
+
+            if (point_id >= touchEntry->header.numTouches || point_id >= 16) {
+                memset(pos, 0, sizeof(touchPosition));
+                continue;
+            }
+
+            pos->id = touchEntry->touches[point_id].touchIndex;
+            pos->px = touchEntry->touches[point_id].x;
+            pos->py = touchEntry->touches[point_id].y;
+            pos->dx = touchEntry->touches[point_id].diameterX;
+            pos->dy = touchEntry->touches[point_id].diameterY;
+            pos->angle = touchEntry->touches[point_id].angle;
+        } while (_hidStateReadRetry(seq));
     }
 }
 
 void hidJoystickRead(JoystickPosition *pos, HidControllerID id, HidControllerJoystick stick) {
-    if (id == CONTROLLER_P1_AUTO) return hidJoystickRead(pos, g_controllerP1AutoID, stick);
-
     if (pos) {
-        if (id < 0 || id > 9 || stick >= JOYSTICK_NUM_STICKS) {
-            memset(pos, 0, sizeof(touchPosition));
-            return;
-        }
+        u32 seq;
 
-        rwlockReadLock(&g_hidLock);
-        pos->dx = g_controllerEntries[id].joysticks[stick].dx;
-        pos->dy = g_controllerEntries[id].joysticks[stick].dy;
-        rwlockReadUnlock(&g_hidLock);
+        do {
+            const HidState* s = _hidStateReadBegin(&seq);
+            int i = _hidStateController(s, id);
+
+            if (i < 0 || stick >= JOYSTICK_NUM_STICKS) {
+                memset(pos, 0, sizeof(JoystickPosition));
+                continue;
+            }
+
+            pos->dx = s->controllerEntries[i].joysticks[stick].dx;
+            pos->dy = s->controllerEntries[i].joysticks[stick].dy;
+        } while (_hidStateReadRetry(seq));
     }
 }
 
 u32 hidSixAxisSensorValuesRead(SixAxisSensorValues *values, HidControllerID id, u32 num_entries) {
     int entry;
     int i;
+    u32 seq;
 
     if (!values || !num_entries) return 0;
 
-    if (id == CONTROLLER_P1_AUTO) return hidSixAxisSensorValuesRead(values, g_controllerP1AutoID, num_entries);
-
     memset(values, 0, sizeof(SixAxisSensorValues) * num_entries);
-    if (id < 0 || id > 9) return 0;
 
-    rwlockReadLock(&g_hidLock);
-    if (!g_sixaxisEnabled[id]) {
-        rwlockReadUnlock(&g_hidLock);
-        return 0;
-    }
+    do {
+        const HidState* s = _hidStateReadBegin(&seq);
+        int ctrl = _hidStateController(s, id);
+        i = 0;
 
-    if (num_entries > g_sixaxisLayouts[id].header.maxEntryIndex + 1)
-        num_entries = g_sixaxisLayouts[id].header.maxEntryIndex + 1;
+        if (ctrl < 0 || s->sixaxisIndex[ctrl] < 0)
+            continue;
 
-    entry = g_sixaxisLayouts[id].header.latestEntry + 1 - num_entries;
-    if (entry < 0)
-        entry += g_sixaxisLayouts[id].header.maxEntryIndex + 1;
+        const HidControllerSixAxisLayout* sixaxis = &s->sixaxisLayouts[ctrl];
+        u32 count = num_entries;
 
-    u64 timestamp = 0;
-    for (i = 0; i < num_entries; i++) {
-        if (timestamp && g_sixaxisLayouts[id].entries[entry].timestamp - timestamp != 1)
-            break;
-        memcpy(&values[i], &g_sixaxisLayouts[id].entries[entry].values, sizeof(SixAxisSensorValues));
-        timestamp = g_sixaxisLayouts[id].entries[entry].timestamp;
+        if (count > sixaxis->header.maxEntryIndex + 1)
+            count = sixaxis->header.maxEntryIndex + 1;
 
-        entry++;
-        if (entry > g_sixaxisLayouts[id].header.maxEntryIndex)
-            entry = 0;
-    }
-    rwlockReadUnlock(&g_hidLock);
+        entry = sixaxis->header.latestEntry + 1 - count;
+        if (entry < 0)
+            entry += sixaxis->header.maxEntryIndex + 1;
+
+        u64 timestamp = 0;
+        for (; i < count; i++) {
+            if (timestamp && sixaxis->entries[entry].timestamp - timestamp != 1)
+                break;
+            memcpy(&values[i], &sixaxis->entries[entry].values, sizeof(SixAxisSensorValues));
+            timestamp = sixaxis->entries[entry].timestamp;
+
+            entry++;
+            if (entry > sixaxis->header.maxEntryIndex)
+                entry = 0;
+        }
+    } while (_hidStateReadRetry(seq));
 
     return i;
 }
 
 bool hidGetHandheldMode(void) {
-    return g_controllerP1AutoID == CONTROLLER_HANDHELD;
+    u32 seq;
+    HidControllerID tmp;
+
+    do {
+        tmp = _hidStateReadBegin(&seq)->controllerP1AutoID;
+    } while (_hidStateReadRetry(seq));
+
+    return tmp == CONTROLLER_HANDHELD;
+}
+
+void hidGetInputSnapshot(HidInputSnapshot *out) {
+    u32 seq;
+
+    do {
+        const HidState* s = _hidStateReadBegin(&seq);
+
+        out->sequence = seq;
+        out->p1AutoID = s->controllerP1AutoID;
+
+        for (int i = 0; i < 10; i++) {
+            HidControllerSnapshot* ctrl = &out->controllers[i];
+            const HidControllerInputEntry* entry = &s->controllerEntries[i];
+
+            ctrl->keysHeld = s->controllerHeld[i];
+            ctrl->keysDown = s->controllerDown[i];
+            ctrl->keysUp = s->controllerUp[i];
+            for (int j = 0; j < JOYSTICK_NUM_STICKS; j++) {
+                ctrl->joysticks[j].dx = entry->joysticks[j].dx;
+                ctrl->joysticks[j].dy = entry->joysticks[j].dy;
+            }
+            ctrl->type = s->controllerHeaders[i].type;
+            ctrl->connected = (entry->connectionState & CONTROLLER_STATE_CONNECTED) != 0;
+
+            ctrl->sixaxisValid = s->sixaxisIndex[i] >= 0;
+            if (ctrl->sixaxisValid) {
+                const HidControllerSixAxisLayout* sixaxis = &s->sixaxisLayouts[i];
+                ctrl->sixaxis = sixaxis->entries[sixaxis->header.latestEntry % 17].values;
+            }
+            else
+                memset(&ctrl->sixaxis, 0, sizeof(SixAxisSensorValues));
+        }
+
+        u32 touchCount = s->touchEntry.header.numTouches;
+        if (touchCount > 16) touchCount = 16;
+        out->touchCount = touchCount;
+        for (u32 i = 0; i < touchCount; i++) {
+            const HidTouchScreenEntryTouch* touch = &s->touchEntry.touches[i];
+            out->touches[i].id = touch->touchIndex;
+            out->touches[i].px = touch->x;
+            out->touches[i].py = touch->y;
+            out->touches[i].dx = touch->diameterX;
+            out->touches[i].dy = touch->diameterY;
+            out->touches[i].angle = touch->angle;
+        }
+        memset(&out->touches[touchCount], 0, (16 - touchCount) * sizeof(touchPosition));
+
+        out->mouseHeld = s->mouseHeld;
+        out->mouseDown = s->mouseDown;
+        out->mouseUp = s->mouseUp;
+        out->mouse = s->mouse.entries[s->mouseEntry].position;
+
+        out->keyboardModHeld = s->keyboardModHeld;
+        out->keyboardModDown = s->keyboardModDown;
+        out->keyboardModUp = s->keyboardModUp;
+        memcpy(out->keyboardHeld, s->keyboardHeld, sizeof(out->keyboardHeld));
+        memcpy(out->keyboardDown, s->keyboardDown, sizeof(out->keyboardDown));
+        memcpy(out->keyboardUp, s->keyboardUp, sizeof(out->keyboardUp));
+    } while (_hidStateReadRetry(seq));
 }
 
 static Result _hidSetDualModeAll(void) {
@@ -642,7 +840,7 @@ static Result _hidCmdGetHandle(Service* srv, Handle* handle_out, u32 cmd_id) {
 }
 
 static Result _hidCmdGetSession(Service* srv_out, u32 cmd_id) {
-    return serviceDispatch(&g_hidSrv, cmd_id,
+    return serviceDispatch(_hidGetSrv(), cmd_id,
         .out_num_objects = 1,
         .out_objects = srv_out,
     );
@@ -656,13 +854,13 @@ static Result _hidCmdWithNoInput(u32 cmd_id) {
     if (R_FAILED(rc))
         AppletResourceUserId = 0;
 
-    return serviceDispatchIn(&g_hidSrv, cmd_id, AppletResourceUserId,
+    return serviceDispatchIn(_hidGetSrv(), cmd_id, AppletResourceUserId,
         .in_send_pid = true,
     );
 }
 
 static Result _hidCmdInU8NoOut(u8 inval, u32 cmd_id) {
-    return serviceDispatchIn(&g_hidSrv, cmd_id, inval);
+    return serviceDispatchIn(_hidGetSrv(), cmd_id, inval);
 }
 
 static Result _hidCmdInBoolNoOut(bool inval, u32 cmd_id) {
@@ -686,7 +884,7 @@ static Result _hidCmdWithInputU32(u32 inval, u32 cmd_id) {
         u64 AppletResourceUserId;
     } in = { inval, AppletResourceUserId };
 
-    return serviceDispatchIn(&g_hidSrv, cmd_id, in,
+    return serviceDispatchIn(_hidGetSrv(), cmd_id, in,
         .in_send_pid = true,
     );
 }
@@ -704,7 +902,7 @@ static Result _hidCmdWithInputU64(u64 inval, u32 cmd_id) {
         u64 inval;
     } in = { AppletResourceUserId, inval };
 
-    return serviceDispatchIn(&g_hidSrv, cmd_id, in,
+    return serviceDispatchIn(_hidGetSrv(), cmd_id, in,
         .in_send_pid = true,
     );
 }
@@ -717,7 +915,7 @@ static Result _hidCmdOutU32(u32 *out, u32 cmd_id) {
     if (R_FAILED(rc))
         AppletResourceUserId = 0;
 
-    return serviceDispatchInOut(&g_hidSrv, cmd_id, AppletResourceUserId, *out,
+    return serviceDispatchInOut(_hidGetSrv(), cmd_id, AppletResourceUserId, *out,
         .in_send_pid = true,
     );
 }
@@ -730,13 +928,13 @@ static Result _hidCmdOutU64(u64 *out, u32 cmd_id) {
     if (R_FAILED(rc))
         AppletResourceUserId = 0;
 
-    return serviceDispatchInOut(&g_hidSrv, cmd_id, AppletResourceUserId, *out,
+    return serviceDispatchInOut(_hidGetSrv(), cmd_id, AppletResourceUserId, *out,
         .in_send_pid = true,
     );
 }
 
 static Result _hidCmdNoInOutU8(u8 *out, u32 cmd_id) {
-    return serviceDispatchOut(&g_hidSrv, cmd_id, *out);
+    return serviceDispatchOut(_hidGetSrv(), cmd_id, *out);
 }
 
 static Result _hidCmdNoInOutBool(bool *out, u32 cmd_id) {
@@ -777,7 +975,7 @@ Result hidSetSixAxisSensorFusionParameters(u32 SixAxisSensorHandle, float unk0,
         u64 AppletResourceUserId;
     } in = { SixAxisSensorHandle, unk0, unk1, 0, AppletResourceUserId };
 
-    return serviceDispatchIn(&g_hidSrv, 70, in,
+    return serviceDispatchIn(_hidGetSrv(), 70, in,
         .in_send_pid = true,
     );
 }
@@ -801,7 +999,7 @@ Result hidGetSixAxisSensorFusionParameters(u32 SixAxisSensorHandle, float *unk0,
         float unk1;
     } out;
 
-    rc = serviceDispatchInOut(&g_hidSrv, 71, in, out,
+    rc = serviceDispatchInOut(_hidGetSrv(), 71, in, out,
         .in_send_pid = true,
     );
     if (R_SUCCEEDED(rc) && unk0) *unk0 = out.unk0;
@@ -827,7 +1025,7 @@ Result hidSetGyroscopeZeroDriftMode(u32 SixAxisSensorHandle, HidGyroscopeZeroDri
         u64 AppletResourceUserId;
     } in = { SixAxisSensorHandle, mode, AppletResourceUserId };
 
-    return serviceDispatchIn(&g_hidSrv, 79, in,
+    return serviceDispatchIn(_hidGetSrv(), 79, in,
         .in_send_pid = true,
     );
 }
@@ -847,7 +1045,7 @@ Result hidGetGyroscopeZeroDriftMode(u32 SixAxisSensorHandle, HidGyroscopeZeroDri
     } in = { SixAxisSensorHandle, 0, AppletResourceUserId };
 
     u32 tmp=0;
-    rc = serviceDispatchInOut(&g_hidSrv, 80, in, tmp,
+    rc = serviceDispatchInOut(_hidGetSrv(), 80, in, tmp,
         .in_send_pid = true,
     );
     if (R_SUCCEEDED(rc) && mode) *mode = tmp;
@@ -896,7 +1094,7 @@ Result hidSetSupportedNpadIdType(HidControllerID *buf, size_t count) {
         tmpbuf[i] = tmpval;
     }
 
-    return serviceDispatchIn(&g_hidSrv, 102, AppletResourceUserId,
+    return serviceDispatchIn(_hidGetSrv(), 102, AppletResourceUserId,
         .buffer_attrs = { SfBufferAttr_HipcPointer | SfBufferAttr_In },
         .buffers = { { tmpbuf, count*sizeof(u32) } },
         .in_send_pid = true,
@@ -938,7 +1136,7 @@ Result hidAcquireNpadStyleSetUpdateEventHandle(HidControllerID id, Event* out_ev
         u64 event_ptr; // Official sw sets this to a ptr, which the sysmodule doesn't seem to use.
     } in = { hidControllerIDToOfficial(id), 0, AppletResourceUserId, 0 };
 
-    rc = serviceDispatchIn(&g_hidSrv, 106, in,
+    rc = serviceDispatchIn(_hidGetSrv(), 106, in,
         .in_send_pid = true,
         .out_handle_attrs = { SfOutHandleAttr_HipcCopy },
         .out_handles = &tmp_handle,
@@ -979,7 +1177,7 @@ Result hidMergeSingleJoyAsDualJoy(HidControllerID id0, HidControllerID id1) {
         u64 AppletResourceUserId;
     } in = { hidControllerIDToOfficial(id0), hidControllerIDToOfficial(id1), AppletResourceUserId };
 
-    return serviceDispatchIn(&g_hidSrv, 125, in,
+    return serviceDispatchIn(_hidGetSrv(), 125, in,
         .in_send_pid = true,
     );
 }
@@ -993,7 +1191,7 @@ static Result _hidActivateVibrationDevice(Service* srv, u32 VibrationDeviceHandl
 }
 
 Result hidGetVibrationDeviceInfo(const u32 *VibrationDeviceHandle, HidVibrationDeviceInfo *VibrationDeviceInfo) {
-    return serviceDispatchInOut(&g_hidSrv, 200, *VibrationDeviceHandle, *VibrationDeviceInfo);
+    return serviceDispatchInOut(_hidGetSrv(), 200, *VibrationDeviceHandle, *VibrationDeviceInfo);
 }
 
 Result hidSendVibrationValue(const u32 *VibrationDeviceHandle, HidVibrationValue *VibrationValue) {
@@ -1011,7 +1209,7 @@ Result hidSendVibrationValue(const u32 *VibrationDeviceHandle, HidVibrationValue
         u64 AppletResourceUserId;
     } in = { *VibrationDeviceHandle, *VibrationValue, 0, AppletResourceUserId };
 
-    return serviceDispatchIn(&g_hidSrv, 201, in,
+    return serviceDispatchIn(_hidGetSrv(), 201, in,
         .in_send_pid = true,
     );
 }
@@ -1029,7 +1227,7 @@ Result hidGetActualVibrationValue(const u32 *VibrationDeviceHandle, HidVibration
         u64 AppletResourceUserId;
     } in = { *VibrationDeviceHandle, AppletResourceUserId };
 
-    return serviceDispatchInOut(&g_hidSrv, 202, in, *VibrationValue,
+    return serviceDispatchInOut(_hidGetSrv(), 202, in, *VibrationValue,
         .in_send_pid = true,
     );
 }
@@ -1050,7 +1248,7 @@ Result hidSendVibrationValues(const u32 *VibrationDeviceHandles, HidVibrationVal
     if (R_FAILED(rc))
         AppletResourceUserId = 0;
 
-    return serviceDispatchIn(&g_hidSrv, 206, AppletResourceUserId,
+    return serviceDispatchIn(_hidGetSrv(), 206, AppletResourceUserId,
         .buffer_attrs = {
             SfBufferAttr_HipcPointer | SfBufferAttr_In,
             SfBufferAttr_HipcPointer | SfBufferAttr_In,
@@ -1079,7 +1277,7 @@ Result hidIsVibrationDeviceMounted(const u32 *VibrationDeviceHandle, bool *flag)
     } in = { *VibrationDeviceHandle, AppletResourceUserId };
 
     u8 tmp=0;
-    rc = serviceDispatchInOut(&g_hidSrv, 211, in, tmp,
+    rc = serviceDispatchInOut(_hidGetSrv(), 211, in, tmp,
         .in_send_pid = true,
     );
     if (R_SUCCEEDED(rc) && flag) *flag = tmp & 1;
@@ -1151,12 +1349,11 @@ Result hidInitializeVibrationDevices(u32 *VibrationDeviceHandles, s32 total_hand
     rc = _hidGetDeviceHandles(0, VibrationDeviceHandles, total_handles, id, type);
     if (R_FAILED(rc)) return rc;
 
-    rwlockWriteLock(&g_hidLock);
-    if (!serviceIsActive(&g_hidIActiveVibrationDeviceList)) {
+    mutexLock(&g_hidVibrationMutex);
+    if (!serviceIsActive(&g_hidIActiveVibrationDeviceList))
         rc = _hidCreateActiveVibrationDeviceList(&g_hidIActiveVibrationDeviceList);
-        if (R_FAILED(rc)) return rc;
-    }
-    rwlockWriteUnlock(&g_hidLock);
+    mutexUnlock(&g_hidVibrationMutex);
+    if (R_FAILED(rc)) return rc;
 
     for (i=0; i<total_handles; i++) {
         rc = _hidActivateVibrationDevice(&g_hidIActiveVibrationDeviceList, VibrationDeviceHandles[i]);
@@ -1179,9 +1376,7 @@ Result hidStartSixAxisSensor(u32 SixAxisSensorHandle) {
         if (controller == 0x20)
             controller = CONTROLLER_HANDHELD;
         if (controller < 10) {
-            rwlockWriteLock(&g_hidLock);
-            g_sixaxisEnabled[controller] = true;
-            rwlockWriteUnlock(&g_hidLock);
+            __atomic_store_n(&g_sixaxisEnabled[controller], true, __ATOMIC_RELAXED);
         }
     }
     return rc;
@@ -1194,9 +1389,7 @@ Result hidStopSixAxisSensor(u32 SixAxisSensorHandle) {
         if (controller == 0x20)
             controller = CONTROLLER_HANDHELD;
         if (controller < 10) {
-            rwlockWriteLock(&g_hidLock);
-            g_sixaxisEnabled[controller] = false;
-            rwlockWriteUnlock(&g_hidLock);
+            __atomic_store_n(&g_sixaxisEnabled[controller], false, __ATOMIC_RELAXED);
         }
     }
     return rc;
@@ -1237,7 +1430,7 @@ static Result _hidInitializeSevenSixAxisSensor(TransferMemory *tmem0, TransferMe
         u64 size1;
     } in = { AppletResourceUserId, tmem0->size, tmem1->size };
 
-    return serviceDispatchIn(&g_hidSrv, 306, in,
+    return serviceDispatchIn(_hidGetSrv(), 306, in,
         .in_send_pid = true,
         .in_num_handles = 2,
         .in_handles = { tmem0->handle, tmem1->handle },
@@ -1312,7 +1505,7 @@ Result hidSetSevenSixAxisSensorFusionStrength(float strength) {
         u64 AppletResourceUserId;
     } in = { strength, AppletResourceUserId };
 
-    return serviceDispatchIn(&g_hidSrv, 308, in,
+    return serviceDispatchIn(_hidGetSrv(), 308, in,
         .in_send_pid = true,
     );
 }
@@ -1328,7 +1521,7 @@ Result hidGetSevenSixAxisSensorFusionStrength(float *strength) {
     if (R_FAILED(rc))
         AppletResourceUserId = 0;
 
-    return serviceDispatchInOut(&g_hidSrv, 309, AppletResourceUserId, *strength,
+    return serviceDispatchInOut(_hidGetSrv(), 309, AppletResourceUserId, *strength,
         .in_send_pid = true,
     );
 }
@@ -1345,6 +1538,6 @@ Result hidGetNpadInterfaceType(HidControllerID id, u8 *out) {
         return MAKERESULT(Module_Libnx, LibnxError_IncompatSysVer);
 
     u32 tmp = hidControllerIDToOfficial(id);
-    return serviceDispatchInOut(&g_hidSrv, 405, tmp, *out);
+    return serviceDispatchInOut(_hidGetSrv(), 405, tmp, *out);
 }
 
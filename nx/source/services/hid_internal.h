@@ -0,0 +1,19 @@
+#pragma once
+#include "types.h"
+#include "services/hid.h"
+
+// Index in HidController.sixaxis of the layout used by a controller type, -1 if it has none.
+NX_INLINE int _hidGetSixAxisIndex(u32 type)
+{
+    if (type & TYPE_PROCONTROLLER)
+        return 0;
+    if (type & TYPE_HANDHELD)
+        return 1;
+    if (type & TYPE_JOYCON_PAIR)
+        return (type & TYPE_JOYCON_LEFT) ? 2 : 3;
+    if (type & TYPE_JOYCON_LEFT)
+        return 4;
+    if (type & TYPE_JOYCON_RIGHT)
+        return 5;
+    return -1;
+}
@@ -0,0 +1,231 @@
+#include <string.h>
+#include "types.h"
+#include "result.h"
+#include "kernel/svc.h"
+#include "services/hid_sampler.h"
+#include "hid_internal.h"
+
+#define HID_SAMPLER_STACK_SIZE 0x2000
+#define HID_SAMPLER_DEFAULT_CAPACITY 256
+#define HID_SAMPLER_DEFAULT_PERIOD_NS 4000000ULL
+
+typedef void (*HidSamplerConvertFn)(void* out, const void* entry);
+
+// All the shared memory entries start with their sampling number.
+static inline u64 _hidSamplerGetNumber(const void* entry) {
+    return __atomic_load_n((const u64*)entry, __ATOMIC_ACQUIRE);
+}
+
+static void _hidSamplerConvertSixAxis(void* out, const void* entry) {
+    HidSamplerSixAxisEntry* sample = (HidSamplerSixAxisEntry*)out;
+    sample->values = ((const HidControllerSixAxisEntry*)entry)->values;
+}
+
+static void _hidSamplerConvertTouch(void* out, const void* entry) {
+    HidSamplerTouchEntry* sample = (HidSamplerTouchEntry*)out;
+    const HidTouchScreenEntry* touch = (const HidTouchScreenEntry*)entry;
+
+    u32 count = touch->header.numTouches;
+    if (count > 16) count = 16;
+    sample->count = count;
+
+    for (u32 i = 0; i < count; i++) {
+        sample->touches[i].id = touch->touches[i].touchIndex;
+        sample->touches[i].px = touch->touches[i].x;
+        sample->touches[i].py = touch->touches[i].y;
+        sample->touches[i].dx = touch->touches[i].diameterX;
+        sample->touches[i].dy = touch->touches[i].diameterY;
+        sample->touches[i].angle = touch->touches[i].angle;
+    }
+    memset(&sample->touches[count], 0, (16 - count) * sizeof(touchPosition));
+}
+
+static void _hidSamplerConvertMouse(void* out, const void* entry) {
+    HidSamplerMouseEntry* sample = (HidSamplerMouseEntry*)out;
+    const HidMouseEntry* mouse = (const HidMouseEntry*)entry;
+    sample->buttons = mouse->buttons;
+    sample->position = mouse->position;
+}
+
+// Returns the sampling number of the latest entry of a shared memory ring, 0 if it isn't set up yet.
+static u64 _hidSamplerGetLatestNumber(const void* entries, size_t stride, u64 latest, u64 max_index) {
+    if (max_index >= 17 || latest > max_index)
+        return 0;
+    return _hidSamplerGetNumber((const u8*)entries + latest*stride);
+}
+
+// Pushes the entries of a shared memory ring newer than the last one pushed, oldest first.
+static void _hidSamplerPoll(HidSampler* s, u32 source, const void* entries, size_t stride, u64 latest, u64 max_index, HidSamplerConvertFn convert) {
+    if (max_index >= 17 || latest > max_index)
+        return;
+
+    u64 count = max_index + 1;
+    u64 last = s->last_sampling_number[source];
+
+    u32 num_new = 0;
+    while (num_new < count) {
+        u64 idx = (latest + count - num_new) % count;
+        if ((s64)(_hidSamplerGetNumber((const u8*)entries + idx*stride) - last) <= 0)
+            break;
+        num_new++;
+    }
+
+    union {
+        u64 sampling_number;
+        HidSamplerSixAxisEntry sixaxis;
+        HidSamplerTouchEntry touch;
+        HidSamplerMouseEntry mouse;
+    } sample;
+
+    u32 dropped = 0;
+    while (num_new--) {
+        const void* entry = (const u8*)entries + ((latest + count - num_new) % count)*stride;
+        u64 sampling_number = _hidSamplerGetNumber(entry);
+        convert(&sample, entry);
+
+        // The entry may have been overwritten while it was copied, it will then be counted as lost by the next one.
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (_hidSamplerGetNumber(entry) != sampling_number || (s64)(sampling_number - last) <= 0)
+            continue;
+
+        if (last)
+            dropped += sampling_number - last - 1;
+        last = sampling_number;
+
+        sample.sampling_number = sampling_number;
+        if (!spscQueueTryPush(&s->queues[source], &sample))
+            dropped++;
+    }
+
+    s->last_sampling_number[source] = last;
+    if (dropped)
+        __atomic_fetch_add(&s->dropped[source], dropped, __ATOMIC_RELAXED);
+}
+
+// Starts each sixaxis source from its latest sample, after a change of layout (which has its own sampling numbers).
+static void _hidSamplerSyncSixAxis(HidSampler* s, HidSharedMemory* mem, bool force) {
+    for (u32 i = 0; i < 10; i++) {
+        if (!(s->sixaxis_mask & BIT(i)))
+            continue;
+
+        int layout = _hidGetSixAxisIndex(mem->controllers[i].header.type);
+        if (!force && layout == s->sixaxis_layout[i])
+            continue;
+
+        s->sixaxis_layout[i] = layout;
+        if (layout >= 0) {
+            HidControllerSixAxisLayout* sixaxis = &mem->controllers[i].sixaxis[layout];
+            s->last_sampling_number[i] = _hidSamplerGetLatestNumber(sixaxis->entries, sizeof(HidControllerSixAxisEntry), sixaxis->header.latestEntry, sixaxis->header.maxEntryIndex);
+        }
+    }
+}
+
+static void _hidSamplerThreadFunc(void* arg) {
+    HidSampler* s = (HidSampler*)arg;
+    HidSharedMemory* mem = (HidSharedMemory*)hidGetSharedmemAddr();
+
+    while (!__atomic_load_n(&s->exit, __ATOMIC_ACQUIRE)) {
+        _hidSamplerSyncSixAxis(s, mem, false);
+
+        for (u32 i = 0; i < 10; i++) {
+            if (!(s->sixaxis_mask & BIT(i)) || s->sixaxis_layout[i] < 0)
+                continue;
+
+            HidControllerSixAxisLayout* sixaxis = &mem->controllers[i].sixaxis[(int)s->sixaxis_layout[i]];
+            _hidSamplerPoll(s, i, sixaxis->entries, sizeof(HidControllerSixAxisEntry), sixaxis->header.latestEntry, sixaxis->header.maxEntryIndex, _hidSamplerConvertSixAxis);
+        }
+
+        if (s->touch)
+            _hidSamplerPoll(s, HidSamplerSource_Touch, mem->touchscreen.entries, sizeof(HidTouchScreenEntry),
+                mem->touchscreen.header.latestEntry, mem->touchscreen.header.maxEntryIndex, _hidSamplerConvertTouch);
+
+        if (s->mouse)
+            _hidSamplerPoll(s, HidSamplerSource_Mouse, mem->mouse.entries, sizeof(HidMouseEntry),
+                mem->mouse.header.latestEntry, mem->mouse.header.maxEntryIndex, _hidSamplerConvertMouse);
+
+        svcSleepThread(s->period_ns);
+    }
+}
+
+static void _hidSamplerFreeQueues(HidSampler* s) {
+    for (u32 i = 0; i < HidSamplerSource_Count; i++)
+        spscQueueClose(&s->queues[i]);
+}
+
+Result hidSamplerCreate(HidSampler* s, const HidSamplerConfig* config) {
+    if (config->sixaxis_mask >> 10)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    HidSharedMemory* mem = (HidSharedMemory*)hidGetSharedmemAddr();
+    if (!mem)
+        return MAKERESULT(Module_Libnx, LibnxError_NotInitialized);
+
+    u32 capacity = config->capacity ? config->capacity : HID_SAMPLER_DEFAULT_CAPACITY;
+
+    memset(s, 0, sizeof(*s));
+    s->period_ns = config->period_ns ? config->period_ns : HID_SAMPLER_DEFAULT_PERIOD_NS;
+    s->sixaxis_mask = config->sixaxis_mask;
+    s->touch = config->touch;
+    s->mouse = config->mouse;
+
+    Result rc = 0;
+    for (u32 i = 0; i < 10 && R_SUCCEEDED(rc); i++) {
+        if (s->sixaxis_mask & BIT(i))
+            rc = spscQueueCreate(&s->queues[i], capacity, sizeof(HidSamplerSixAxisEntry));
+    }
+    if (R_SUCCEEDED(rc) && s->touch)
+        rc = spscQueueCreate(&s->queues[HidSamplerSource_Touch], capacity, sizeof(HidSamplerTouchEntry));
+    if (R_SUCCEEDED(rc) && s->mouse)
+        rc = spscQueueCreate(&s->queues[HidSamplerSource_Mouse], capacity, sizeof(HidSamplerMouseEntry));
+
+    if (R_SUCCEEDED(rc)) {
+        _hidSamplerSyncSixAxis(s, mem, true);
+        s->last_sampling_number[HidSamplerSource_Touch] = _hidSamplerGetLatestNumber(mem->touchscreen.entries, sizeof(HidTouchScreenEntry),
+            mem->touchscreen.header.latestEntry, mem->touchscreen.header.maxEntryIndex);
+        s->last_sampling_number[HidSamplerSource_Mouse] = _hidSamplerGetLatestNumber(mem->mouse.entries, sizeof(HidMouseEntry),
+            mem->mouse.header.latestEntry, mem->mouse.header.maxEntryIndex);
+
+        rc = threadCreate(&s->thread, _hidSamplerThreadFunc, s, NULL, HID_SAMPLER_STACK_SIZE, config->prio, config->cpuid);
+    }
+
+    if (R_SUCCEEDED(rc)) {
+        rc = threadStart(&s->thread);
+        if (R_FAILED(rc))
+            threadClose(&s->thread);
+    }
+
+    if (R_FAILED(rc))
+        _hidSamplerFreeQueues(s);
+
+    return rc;
+}
+
+void hidSamplerClose(HidSampler* s) {
+    __atomic_store_n(&s->exit, true, __ATOMIC_RELEASE);
+    threadWaitForExit(&s->thread);
+    threadClose(&s->thread);
+
+    _hidSamplerFreeQueues(s);
+}
+
+static u32 _hidSamplerRead(HidSampler* s, u32 source, void* out, size_t elem_size, u32 max_entries) {
+    u32 i;
+    for (i = 0; i < max_entries; i++) {
+        if (!spscQueueTryPop(&s->queues[source], (u8*)out + i*elem_size))
+            break;
+    }
+    return i;
+}
+
+u32 hidSamplerReadSixAxis(HidSampler* s, HidControllerID id, HidSamplerSixAxisEntry* out, u32 max_entries) {
+    if (id < 0 || id > 9) return 0;
+    return _hidSamplerRead(s, id, out, sizeof(HidSamplerSixAxisEntry), max_entries);
+}
+
+u32 hidSamplerReadTouch(HidSampler* s, HidSamplerTouchEntry* out, u32 max_entries) {
+    return _hidSamplerRead(s, HidSamplerSource_Touch, out, sizeof(HidSamplerTouchEntry), max_entries);
+}
+
+u32 hidSamplerReadMouse(HidSampler* s, HidSamplerMouseEntry* out, u32 max_entries) {
+    return _hidSamplerRead(s, HidSamplerSource_Mouse, out, sizeof(HidSamplerMouseEntry), max_entries);
+}
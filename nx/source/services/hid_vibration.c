@@ -0,0 +1,181 @@
+#include <string.h>
+#include "types.h"
+#include "result.h"
+#include "arm/counter.h"
+#include "kernel/svc.h"
+#include "services/hid_vibration.h"
+
+#define HID_VIBRATION_STACK_SIZE 0x2000
+#define HID_VIBRATION_DEFAULT_PERIOD_NS 5000000ULL
+
+// Frequencies sent along with a zero amplitude, same as the official default.
+#define HID_VIBRATION_FREQ_LOW 160.0f
+#define HID_VIBRATION_FREQ_HIGH 320.0f
+
+static inline u32 _hidVibrationMakeId(HidVibrationScheduler* s, u32 slot) {
+    return ((u32)s->effects[slot].generation << 8) | slot;
+}
+
+// Mixes the effects for the current tick, and frees the finished ones. The mutex must be held.
+static void _hidVibrationMix(HidVibrationScheduler* s, HidVibrationValue* out) {
+    float amp_low[HID_VIBRATION_MAX_DEVICES] = {0}, amp_high[HID_VIBRATION_MAX_DEVICES] = {0};
+    float freq_low[HID_VIBRATION_MAX_DEVICES] = {0}, freq_high[HID_VIBRATION_MAX_DEVICES] = {0};
+
+    for (u32 i = 0; i < HID_VIBRATION_MAX_EFFECTS; i++) {
+        HidVibrationEffect* e = &s->effects[i];
+        if (!e->values || e->start_tick > s->tick)
+            continue;
+
+        u64 pos = s->tick - e->start_tick;
+        if (pos >= e->num_values) {
+            if (!e->loop) {
+                e->values = NULL;
+                continue;
+            }
+            pos %= e->num_values;
+        }
+
+        const HidVibrationValue* v = &e->values[pos];
+        float low = v->amp_low * e->gain, high = v->amp_high * e->gain;
+        for (u32 d = 0; d < s->num_devices; d++) {
+            if (!(e->device_mask & BIT(d)))
+                continue;
+            amp_low[d] += low;
+            freq_low[d] += low * v->freq_low;
+            amp_high[d] += high;
+            freq_high[d] += high * v->freq_high;
+        }
+    }
+
+    for (u32 d = 0; d < s->num_devices; d++) {
+        out[d].amp_low = amp_low[d] < 1.0f ? amp_low[d] : 1.0f;
+        out[d].freq_low = amp_low[d] > 0.0f ? freq_low[d] / amp_low[d] : HID_VIBRATION_FREQ_LOW;
+        out[d].amp_high = amp_high[d] < 1.0f ? amp_high[d] : 1.0f;
+        out[d].freq_high = amp_high[d] > 0.0f ? freq_high[d] / amp_high[d] : HID_VIBRATION_FREQ_HIGH;
+    }
+}
+
+// Sends the values of the devices which changed, all at once.
+static void _hidVibrationSubmit(HidVibrationScheduler* s, const HidVibrationValue* values) {
+    u32 handles[HID_VIBRATION_MAX_DEVICES];
+    HidVibrationValue changed[HID_VIBRATION_MAX_DEVICES];
+    s32 count = 0;
+
+    for (u32 d = 0; d < s->num_devices; d++) {
+        if (!memcmp(&values[d], &s->current[d], sizeof(HidVibrationValue)))
+            continue;
+        handles[count] = s->handles[d];
+        changed[count] = values[d];
+        count++;
+    }
+
+    if (count && R_SUCCEEDED(hidSendVibrationValues(handles, changed, count)))
+        memcpy(s->current, values, s->num_devices * sizeof(HidVibrationValue));
+}
+
+static void _hidVibrationThreadFunc(void* arg) {
+    HidVibrationScheduler* s = (HidVibrationScheduler*)arg;
+    HidVibrationValue values[HID_VIBRATION_MAX_DEVICES];
+    u64 period = armNsToTicks(s->period_ns);
+    u64 next = armGetSystemTick();
+
+    while (!__atomic_load_n(&s->exit, __ATOMIC_ACQUIRE)) {
+        mutexLock(&s->mutex);
+        _hidVibrationMix(s, values);
+        s->tick++;
+        mutexUnlock(&s->mutex);
+
+        _hidVibrationSubmit(s, values);
+
+        // Sleep until the next tick, without accumulating the processing time. Skip the missed ones if very late.
+        next += period;
+        u64 now = armGetSystemTick();
+        if ((s64)(next - now) > 0)
+            svcSleepThread(armTicksToNs(next - now));
+        else
+            next = now;
+    }
+
+    // Stop all vibration.
+    for (u32 d = 0; d < s->num_devices; d++) {
+        values[d].amp_low = values[d].amp_high = 0.0f;
+        values[d].freq_low = HID_VIBRATION_FREQ_LOW;
+        values[d].freq_high = HID_VIBRATION_FREQ_HIGH;
+    }
+    _hidVibrationSubmit(s, values);
+}
+
+Result hidVibrationSchedulerCreate(HidVibrationScheduler* s, const u32* handles, u32 num_devices, u64 period_ns, int prio, int cpuid) {
+    if (!num_devices || num_devices > HID_VIBRATION_MAX_DEVICES)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    memset(s, 0, sizeof(*s));
+    s->period_ns = period_ns ? period_ns : HID_VIBRATION_DEFAULT_PERIOD_NS;
+    s->num_devices = num_devices;
+    memcpy(s->handles, handles, num_devices * sizeof(u32));
+
+    // Unknown state, so that the first tick sends all the devices.
+    for (u32 d = 0; d < num_devices; d++)
+        s->current[d].amp_low = -1.0f;
+
+    Result rc = threadCreate(&s->thread, _hidVibrationThreadFunc, s, NULL, HID_VIBRATION_STACK_SIZE, prio, cpuid);
+    if (R_SUCCEEDED(rc)) {
+        rc = threadStart(&s->thread);
+        if (R_FAILED(rc))
+            threadClose(&s->thread);
+    }
+
+    return rc;
+}
+
+void hidVibrationSchedulerClose(HidVibrationScheduler* s) {
+    __atomic_store_n(&s->exit, true, __ATOMIC_RELEASE);
+    threadWaitForExit(&s->thread);
+    threadClose(&s->thread);
+}
+
+Result hidVibrationSchedulerPlay(HidVibrationScheduler* s, u32 device_mask, const HidVibrationValue* values, u32 num_values, float gain, bool loop, u32* out_id) {
+    if (!values || !num_values || (device_mask >> s->num_devices))
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    Result rc = MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+    mutexLock(&s->mutex);
+
+    for (u32 i = 0; i < HID_VIBRATION_MAX_EFFECTS; i++) {
+        HidVibrationEffect* e = &s->effects[i];
+        if (e->values)
+            continue;
+
+        e->values = values;
+        e->num_values = num_values;
+        e->device_mask = device_mask;
+        e->start_tick = s->tick;
+        e->gain = gain;
+        e->loop = loop;
+        e->generation++;
+        if (out_id) *out_id = _hidVibrationMakeId(s, i);
+        rc = 0;
+        break;
+    }
+
+    mutexUnlock(&s->mutex);
+    return rc;
+}
+
+void hidVibrationSchedulerStop(HidVibrationScheduler* s, u32 id) {
+    u32 slot = id & 0xFF;
+    if (slot >= HID_VIBRATION_MAX_EFFECTS)
+        return;
+
+    mutexLock(&s->mutex);
+    if (_hidVibrationMakeId(s, slot) == id)
+        s->effects[slot].values = NULL;
+    mutexUnlock(&s->mutex);
+}
+
+void hidVibrationSchedulerStopAll(HidVibrationScheduler* s) {
+    mutexLock(&s->mutex);
+    for (u32 i = 0; i < HID_VIBRATION_MAX_EFFECTS; i++)
+        s->effects[i].values = NULL;
+    mutexUnlock(&s->mutex);
+}
@@ -0,0 +1,143 @@
+#include <string.h>
+#include <stdlib.h>
+#include "types.h"
+#include "result.h"
+#include "kernel/wait.h"
+#include "services/hid_watcher.h"
+
+#define HID_WATCHER_STACK_SIZE 0x2000
+#define HID_WATCHER_DEFAULT_PERIOD_NS 16000000ULL
+#define HID_WATCHER_DEFAULT_STICK_THRESHOLD 0x800
+
+static void _hidInputWatcherGetState(HidInputWatcherState* out, HidSharedMemory* mem) {
+    memset(out, 0, sizeof(*out));
+
+    for (int i = 0; i < 10; i++) {
+        HidControllerLayout *layout = &mem->controllers[i].layouts[hidGetControllerLayout(i)];
+        u64 latest = layout->header.latestEntry;
+        if (latest >= 17)
+            continue;
+
+        HidControllerInputEntry *entry = &layout->entries[latest];
+        out->buttons[i] = entry->buttons;
+        out->connection_state[i] = entry->connectionState;
+        for (int j = 0; j < JOYSTICK_NUM_STICKS; j++) {
+            out->joysticks[i][j].dx = entry->joysticks[j].dx;
+            out->joysticks[i][j].dy = entry->joysticks[j].dy;
+        }
+    }
+
+    u64 latest = mem->touchscreen.header.latestEntry;
+    if (latest < 17) {
+        HidTouchScreenEntry *entry = &mem->touchscreen.entries[latest];
+        out->touch_count = entry->header.numTouches;
+        for (u64 i = 0; i < out->touch_count && i < 16; i++) {
+            out->touch_pos[i][0] = entry->touches[i].x;
+            out->touch_pos[i][1] = entry->touches[i].y;
+        }
+    }
+
+    latest = mem->keyboard.header.latestEntry;
+    if (latest < 17) {
+        HidKeyboardEntry *entry = &mem->keyboard.entries[latest];
+        out->keyboard_modifier = entry->modifier;
+        memcpy(out->keyboard_keys, entry->keys, sizeof(out->keyboard_keys));
+    }
+
+    latest = mem->mouse.header.latestEntry;
+    if (latest < 17) {
+        HidMouseEntry *entry = &mem->mouse.entries[latest];
+        out->mouse_buttons = entry->buttons;
+        out->mouse_pos = entry->position;
+    }
+}
+
+static bool _hidInputWatcherChanged(const HidInputWatcherState* a, const HidInputWatcherState* b, s32 stick_threshold) {
+    for (int i = 0; i < 10; i++) {
+        if (a->buttons[i] != b->buttons[i] || a->connection_state[i] != b->connection_state[i])
+            return true;
+        for (int j = 0; j < JOYSTICK_NUM_STICKS; j++) {
+            if (abs(a->joysticks[i][j].dx - b->joysticks[i][j].dx) >= stick_threshold ||
+                abs(a->joysticks[i][j].dy - b->joysticks[i][j].dy) >= stick_threshold)
+                return true;
+        }
+    }
+
+    // Scrolling doesn't move the mouse, but has a non-zero velocity while it lasts.
+    if (b->mouse_pos.scrollVelocityX || b->mouse_pos.scrollVelocityY)
+        return true;
+
+    return a->touch_count != b->touch_count || memcmp(a->touch_pos, b->touch_pos, sizeof(a->touch_pos)) ||
+        a->keyboard_modifier != b->keyboard_modifier || memcmp(a->keyboard_keys, b->keyboard_keys, sizeof(a->keyboard_keys)) ||
+        a->mouse_buttons != b->mouse_buttons || a->mouse_pos.x != b->mouse_pos.x || a->mouse_pos.y != b->mouse_pos.y;
+}
+
+static void _hidInputWatcherThreadFunc(void* arg) {
+    HidInputWatcher* w = (HidInputWatcher*)arg;
+    HidSharedMemory* mem = (HidSharedMemory*)hidGetSharedmemAddr();
+    Waiter waiters[9];
+    HidInputWatcherState state;
+
+    for (int i = 0; i < 9; i++)
+        waiters[i] = waiterForEvent(&w->style_events[i]);
+
+    while (!__atomic_load_n(&w->exit, __ATOMIC_ACQUIRE)) {
+        s32 idx;
+        bool changed = R_SUCCEEDED(waitObjects(&idx, waiters, 9, w->period_ns));
+
+        _hidInputWatcherGetState(&state, mem);
+        if (_hidInputWatcherChanged(&w->state, &state, w->stick_threshold)) {
+            // The state is only updated when a change is reported, so that slow stick motion still adds up to one.
+            w->state = state;
+            changed = true;
+        }
+
+        if (changed)
+            ueventSignal(&w->event);
+    }
+}
+
+static void _hidInputWatcherCloseEvents(HidInputWatcher* w) {
+    for (int i = 0; i < 9; i++)
+        eventClose(&w->style_events[i]);
+}
+
+Result hidInputWatcherCreate(HidInputWatcher* w, u64 period_ns, s32 stick_threshold, int prio, int cpuid) {
+    HidSharedMemory* mem = (HidSharedMemory*)hidGetSharedmemAddr();
+    if (!mem)
+        return MAKERESULT(Module_Libnx, LibnxError_NotInitialized);
+
+    memset(w, 0, sizeof(*w));
+    for (int i = 0; i < 9; i++)
+        w->style_events[i].revent = w->style_events[i].wevent = INVALID_HANDLE;
+    w->period_ns = period_ns ? period_ns : HID_WATCHER_DEFAULT_PERIOD_NS;
+    w->stick_threshold = stick_threshold ? stick_threshold : HID_WATCHER_DEFAULT_STICK_THRESHOLD;
+    ueventCreate(&w->event, true);
+    _hidInputWatcherGetState(&w->state, mem);
+
+    Result rc = 0;
+    for (int i = 0; i < 9 && R_SUCCEEDED(rc); i++)
+        rc = hidAcquireNpadStyleSetUpdateEventHandle(CONTROLLER_PLAYER_1 + i, &w->style_events[i], true);
+
+    if (R_SUCCEEDED(rc))
+        rc = threadCreate(&w->thread, _hidInputWatcherThreadFunc, w, NULL, HID_WATCHER_STACK_SIZE, prio, cpuid);
+
+    if (R_SUCCEEDED(rc)) {
+        rc = threadStart(&w->thread);
+        if (R_FAILED(rc))
+            threadClose(&w->thread);
+    }
+
+    if (R_FAILED(rc))
+        _hidInputWatcherCloseEvents(w);
+
+    return rc;
+}
+
+void hidInputWatcherClose(HidInputWatcher* w) {
+    __atomic_store_n(&w->exit, true, __ATOMIC_RELEASE);
+    threadWaitForExit(&w->thread);
+    threadClose(&w->thread);
+
+    _hidInputWatcherCloseEvents(w);
+}
@@ -0,0 +1,177 @@
+#include <malloc.h>
+#include <string.h>
+#include "types.h"
+#include "result.h"
+#include "arm/counter.h"
+#include "services/hiddbg_injector.h"
+
+static void _hiddbgHdlsInjectorBuildList(HiddbgHdlsInjector* inj, HiddbgHdlsStateList* list, const HiddbgHdlsState* states) {
+    memset(list, 0, sizeof(*list));
+    list->total_entries = inj->num_devices;
+    for (u32 i = 0; i < inj->num_devices; i++) {
+        HiddbgHdlsStateListEntry* e = &list->entries[i];
+        e->HdlsHandle = inj->handles[i];
+        e->device = inj->devices[i];
+        e->state = states[i];
+    }
+}
+
+static void _hiddbgHdlsInjectorThreadFunc(void* arg) {
+    HiddbgHdlsInjector* inj = (HiddbgHdlsInjector*)arg;
+    HiddbgHdlsStateList list;
+    u64 late_ticks = armNsToTicks(1000000);
+
+    mutexLock(&inj->mutex);
+
+    for (;;) {
+        while (!inj->should_exit && !inj->count)
+            condvarWait(&inj->cond, &inj->mutex);
+        if (inj->should_exit)
+            break;
+
+        // Wait for the deadline of the next frame. Schedule/Clear wake this up to look at the queue again.
+        HiddbgHdlsInjectorFrame* frame = &inj->queue[inj->head];
+        u64 now = armGetSystemTick();
+        if (frame->tick > now) {
+            condvarWaitTimeout(&inj->cond, &inj->mutex, armTicksToNs(frame->tick - now));
+            continue;
+        }
+
+        u64 tick = frame->tick;
+        _hiddbgHdlsInjectorBuildList(inj, &list, frame->states);
+        inj->head = (inj->head + 1) % inj->queue_size;
+        inj->count--;
+        condvarWakeAll(&inj->cond);
+        mutexUnlock(&inj->mutex);
+
+        Result rc = hiddbgApplyHdlsStateList(&list);
+        now = armGetSystemTick();
+
+        mutexLock(&inj->mutex);
+        if (R_FAILED(rc)) {
+            inj->rc = rc;
+            condvarWakeAll(&inj->cond);
+            break;
+        }
+
+        __atomic_add_fetch(&inj->applied, 1, __ATOMIC_RELAXED);
+        if (now - tick > late_ticks)
+            __atomic_add_fetch(&inj->late, 1, __ATOMIC_RELAXED);
+    }
+
+    mutexUnlock(&inj->mutex);
+}
+
+Result hiddbgHdlsInjectorCreate(HiddbgHdlsInjector* inj, const u64* handles, u32 num_devices, u32 queue_size, int prio, int cpuid) {
+    HiddbgHdlsStateList list;
+
+    if (!num_devices || num_devices > HIDDBG_INJECTOR_MAX_DEVICES || !queue_size)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    memset(inj, 0, sizeof(*inj));
+
+    // hiddbgApplyHdlsStateList attaches a new device for handles which aren't found, with the device info of their entry.
+    Result rc = hiddbgDumpHdlsStates(&list);
+    if (R_FAILED(rc))
+        return rc;
+
+    for (u32 i = 0; i < num_devices; i++) {
+        s32 j;
+        for (j = 0; j < list.total_entries && j < 0x10; j++) {
+            if (list.entries[j].HdlsHandle == handles[i])
+                break;
+        }
+        if (j == list.total_entries || j == 0x10) {
+            memset(inj, 0, sizeof(*inj));
+            return MAKERESULT(Module_Libnx, LibnxError_NotFound);
+        }
+
+        inj->handles[i] = handles[i];
+        inj->devices[i] = list.entries[j].device;
+    }
+
+    inj->num_devices = num_devices;
+    inj->queue_size = queue_size;
+    mutexInit(&inj->mutex);
+    condvarInit(&inj->cond);
+
+    inj->queue = (HiddbgHdlsInjectorFrame*)malloc(queue_size * sizeof(HiddbgHdlsInjectorFrame));
+    if (!inj->queue)
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+
+    rc = threadCreate(&inj->thread, _hiddbgHdlsInjectorThreadFunc, inj, NULL, 0x4000, prio, cpuid);
+    if (R_SUCCEEDED(rc)) {
+        rc = threadStart(&inj->thread);
+        if (R_FAILED(rc))
+            threadClose(&inj->thread);
+    }
+
+    if (R_FAILED(rc)) {
+        free(inj->queue);
+        inj->queue = NULL;
+    }
+
+    return rc;
+}
+
+void hiddbgHdlsInjectorClose(HiddbgHdlsInjector* inj) {
+    if (!inj->queue)
+        return;
+
+    mutexLock(&inj->mutex);
+    inj->should_exit = true;
+    condvarWakeAll(&inj->cond);
+    mutexUnlock(&inj->mutex);
+
+    threadWaitForExit(&inj->thread);
+    threadClose(&inj->thread);
+
+    free(inj->queue);
+    memset(inj, 0, sizeof(*inj));
+}
+
+Result hiddbgHdlsInjectorApply(HiddbgHdlsInjector* inj, const HiddbgHdlsState* states) {
+    HiddbgHdlsStateList list;
+    _hiddbgHdlsInjectorBuildList(inj, &list, states);
+    return hiddbgApplyHdlsStateList(&list);
+}
+
+Result hiddbgHdlsInjectorSchedule(HiddbgHdlsInjector* inj, const HiddbgHdlsInjectorFrame* frame, u64 timeout) {
+    Result rc = 0;
+    u64 start = armGetSystemTick();
+
+    mutexLock(&inj->mutex);
+
+    if (frame->tick < inj->last_tick)
+        rc = MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    while (R_SUCCEEDED(rc) && R_SUCCEEDED(inj->rc) && inj->count == inj->queue_size) {
+        u64 elapsed = armTicksToNs(armGetSystemTick() - start);
+        if (timeout != UINT64_MAX && elapsed >= timeout) {
+            rc = KERNELRESULT(TimedOut);
+            break;
+        }
+        condvarWaitTimeout(&inj->cond, &inj->mutex, timeout == UINT64_MAX ? UINT64_MAX : timeout - elapsed);
+    }
+
+    if (R_SUCCEEDED(rc))
+        rc = inj->rc;
+
+    if (R_SUCCEEDED(rc)) {
+        inj->queue[(inj->head + inj->count) % inj->queue_size] = *frame;
+        inj->count++;
+        inj->last_tick = frame->tick;
+        condvarWakeAll(&inj->cond);
+    }
+
+    mutexUnlock(&inj->mutex);
+    return rc;
+}
+
+void hiddbgHdlsInjectorClear(HiddbgHdlsInjector* inj) {
+    mutexLock(&inj->mutex);
+    inj->count = 0;
+    inj->last_tick = 0;
+    condvarWakeAll(&inj->cond);
+    mutexUnlock(&inj->mutex);
+}
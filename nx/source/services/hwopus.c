@@ -20,6 +20,8 @@ Result hwopusDecoderInitialize(HwopusDecoder* decoder, s32 SampleRate, s32 Chann
         return 0;
 
     decoder->multistream = false;
+    decoder->sample_rate = SampleRate;
+    decoder->channel_count = ChannelCount;
 
     Service hwopusMgrSrv;
     rc = smGetService(&hwopusMgrSrv, "hwopus");
@@ -55,6 +57,8 @@ Result hwopusDecoderMultistreamInitialize(HwopusDecoder* decoder, s32 SampleRate
         return MAKERESULT(Module_Libnx, LibnxError_BadInput);
 
     decoder->multistream = true;
+    decoder->sample_rate = SampleRate;
+    decoder->channel_count = ChannelCount;
 
     memset(&state, 0, sizeof(HwopusMultistreamState));
     state.SampleRate = SampleRate;
@@ -196,3 +200,65 @@ static Result _hwopusDecodeInterleaved(HwopusDecoder* decoder, s32 *DecodedDataS
     if (R_SUCCEEDED(rc) && perf) *perf = out.perf;
     return rc;
 }
+
+// Number of samples per channel in a packet, from its TOC byte (RFC 6716 section 3.1), or 0 if it's malformed.
+static u32 _hwopusGetPacketSampleCount(const u8 *packet, u32 size, s32 SampleRate) {
+    if (!size)
+        return 0;
+
+    u8 toc = packet[0];
+    u32 config = toc >> 3;
+    u32 frame_size_48k; // In samples at 48kHz.
+    if (config < 12)      // SILK: 10/20/40/60ms
+        frame_size_48k = (config & 3) == 3 ? 2880 : 480 << (config & 3);
+    else if (config < 16) // Hybrid: 10/20ms
+        frame_size_48k = 480 << (config & 1);
+    else                  // CELT: 2.5/5/10/20ms
+        frame_size_48k = 120 << (config & 3);
+
+    u32 num_frames;
+    switch (toc & 3) {
+        case 0: num_frames = 1; break;
+        case 1:
+        case 2: num_frames = 2; break;
+        default:
+            if (size < 2)
+                return 0;
+            num_frames = packet[1] & 0x3f;
+            break;
+    }
+
+    return (u64)num_frames * frame_size_48k * SampleRate / 48000;
+}
+
+Result hwopusDecodeInterleavedBatch(HwopusDecoder* decoder, s32 *DecodedDataSize, s32 *DecodedSampleCount, const void* opusin, size_t opusin_size, s16 *pcmbuf, size_t pcmbuf_size) {
+    Result rc=0;
+    size_t in_pos=0, out_pos=0;
+    s32 total_samples=0;
+    size_t frame_size = decoder->channel_count * sizeof(s16);
+
+    while (in_pos + sizeof(HwopusHeader) <= opusin_size) {
+        const u8 *packet = (const u8*)opusin + in_pos;
+        u32 packet_size = __builtin_bswap32(((const HwopusHeader*)packet)->size);
+        if (packet_size > opusin_size - in_pos - sizeof(HwopusHeader))
+            break;
+
+        u32 num_samples = _hwopusGetPacketSampleCount(packet + sizeof(HwopusHeader), packet_size, decoder->sample_rate);
+        if (num_samples * frame_size > pcmbuf_size - out_pos)
+            break;
+
+        s32 decoded_size=0, decoded_samples=0;
+        rc = hwopusDecodeInterleaved(decoder, &decoded_size, &decoded_samples, packet, sizeof(HwopusHeader) + packet_size, (s16*)((u8*)pcmbuf + out_pos), pcmbuf_size - out_pos);
+        if (R_FAILED(rc))
+            break;
+
+        in_pos += sizeof(HwopusHeader) + packet_size;
+        out_pos += decoded_samples * frame_size;
+        total_samples += decoded_samples;
+    }
+
+    // Report what was decoded before a failure, so the caller can skip the bad packet.
+    if (DecodedDataSize) *DecodedDataSize = in_pos;
+    if (DecodedSampleCount) *DecodedSampleCount = total_samples;
+    return rc;
+}
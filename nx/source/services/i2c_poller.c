@@ -0,0 +1,167 @@
+#include <string.h>
+#include "types.h"
+#include "result.h"
+#include "arm/counter.h"
+#include "services/i2c_poller.h"
+
+// Command list encoding: command in bits 0-1, start/stop conditions in bits 6/7, followed by the size and, for sends, the data.
+#define I2C_CMD_SEND       0
+#define I2C_CMD_RECEIVE    1
+#define I2C_CMD_START      BIT(6)
+#define I2C_CMD_STOP       BIT(7)
+
+void i2cPollerCreate(I2cPoller* p, u64 period_ns, int prio, int cpuid) {
+    memset(p, 0, sizeof(*p));
+    p->period_ns = period_ns;
+    p->prio = prio;
+    p->cpuid = cpuid;
+    mutexInit(&p->mutex);
+    condvarInit(&p->cond);
+}
+
+Result i2cPollerAddDevice(I2cPoller* p, I2cDevice dev, const I2cPollerRead* reads, u32 num_reads, u32* out_index) {
+    if (p->running || p->num_devices >= I2C_POLLER_MAX_DEVICES || !num_reads || num_reads > I2C_POLLER_MAX_READS)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    I2cPollerDevice* d = &p->devices[p->num_devices];
+    memset(d, 0, sizeof(*d));
+
+    u32 pos = 0, offset = 0;
+    for (u32 i = 0; i < num_reads; i++) {
+        if (!reads[i].size || pos + 5 > sizeof(d->cmd_list) || offset + reads[i].size > sizeof(d->results))
+            return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+        d->cmd_list[pos++] = I2C_CMD_SEND | I2C_CMD_START;
+        d->cmd_list[pos++] = 1;
+        d->cmd_list[pos++] = reads[i].reg;
+        d->cmd_list[pos++] = I2C_CMD_RECEIVE | I2C_CMD_START | I2C_CMD_STOP;
+        d->cmd_list[pos++] = reads[i].size;
+
+        d->offsets[i] = offset;
+        offset += reads[i].size;
+    }
+    d->offsets[num_reads] = offset;
+    d->cmd_list_size = pos;
+    d->num_reads = num_reads;
+    d->rc = MAKERESULT(Module_Libnx, LibnxError_NotFound);
+
+    Result rc = i2cOpenSession(&d->session, dev);
+    if (R_FAILED(rc))
+        return rc;
+
+    if (out_index)
+        *out_index = p->num_devices;
+    p->num_devices++;
+    return 0;
+}
+
+static void _i2cPollerPublish(I2cPollerDevice* d, const void* results, Result rc) {
+    u32 seq = d->seq;
+
+    __atomic_store_n(&d->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    if (R_SUCCEEDED(rc))
+        memcpy(d->results, results, d->offsets[d->num_reads]);
+    d->rc = rc;
+    d->tick = armGetSystemTick();
+
+    __atomic_store_n(&d->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+static void _i2cPollerThreadFunc(void* arg) {
+    I2cPoller* p = (I2cPoller*)arg;
+    u8 results[I2C_POLLER_RESULT_SIZE];
+    u64 next = armGetSystemTick();
+
+    mutexLock(&p->mutex);
+
+    while (!p->should_exit) {
+        mutexUnlock(&p->mutex);
+
+        for (u32 i = 0; i < p->num_devices; i++) {
+            I2cPollerDevice* d = &p->devices[i];
+            Result rc = i2csessionExecuteCommandList(&d->session, results, d->offsets[d->num_reads], d->cmd_list, d->cmd_list_size);
+            _i2cPollerPublish(d, results, rc);
+        }
+
+        // Keep to the period, but don't try to catch up after a stall.
+        u64 now = armGetSystemTick();
+        next += armNsToTicks(p->period_ns);
+        if (next <= now)
+            next = now + armNsToTicks(p->period_ns);
+
+        mutexLock(&p->mutex);
+        while (!p->should_exit) {
+            now = armGetSystemTick();
+            if (now >= next)
+                break;
+            condvarWaitTimeout(&p->cond, &p->mutex, armTicksToNs(next - now));
+        }
+    }
+
+    mutexUnlock(&p->mutex);
+}
+
+Result i2cPollerStart(I2cPoller* p) {
+    if (p->running || !p->num_devices)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    p->should_exit = false;
+    Result rc = threadCreate(&p->thread, _i2cPollerThreadFunc, p, NULL, 0x4000, p->prio, p->cpuid);
+    if (R_SUCCEEDED(rc)) {
+        rc = threadStart(&p->thread);
+        if (R_FAILED(rc))
+            threadClose(&p->thread);
+    }
+
+    if (R_SUCCEEDED(rc))
+        p->running = true;
+    return rc;
+}
+
+void i2cPollerClose(I2cPoller* p) {
+    if (p->running) {
+        mutexLock(&p->mutex);
+        p->should_exit = true;
+        condvarWakeAll(&p->cond);
+        mutexUnlock(&p->mutex);
+
+        threadWaitForExit(&p->thread);
+        threadClose(&p->thread);
+    }
+
+    for (u32 i = 0; i < p->num_devices; i++)
+        i2csessionClose(&p->devices[i].session);
+
+    memset(p, 0, sizeof(*p));
+}
+
+Result i2cPollerGet(I2cPoller* p, u32 device, u32 read, void* out, u64* out_tick) {
+    if (device >= p->num_devices || read >= p->devices[device].num_reads)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    I2cPollerDevice* d = &p->devices[device];
+    u32 offset = d->offsets[read], size = d->offsets[read + 1] - offset;
+    u32 seq;
+    Result rc;
+    u64 tick;
+
+    for (;;) {
+        seq = __atomic_load_n(&d->seq, __ATOMIC_ACQUIRE);
+        if (seq & 1)
+            continue;
+
+        memcpy(out, &d->results[offset], size);
+        rc = d->rc;
+        tick = d->tick;
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&d->seq, __ATOMIC_RELAXED) == seq)
+            break;
+    }
+
+    if (out_tick)
+        *out_tick = seq ? tick : 0;
+    return rc;
+}
@@ -0,0 +1,306 @@
+#include <string.h>
+#include <arm_neon.h>
+#include "types.h"
+#include "result.h"
+#include "kernel/svc.h"
+#include "services/irs_stream.h"
+
+#define IRS_STREAM_STACK_SIZE 0x2000
+#define IRS_STREAM_WAIT_NS 10000000ULL  // How long the worker waits for a free buffer before checking for exit
+#define IRS_STREAM_POLL_NS 2000000ULL   // Interval at which the worker polls for a new image
+
+static void _irsImageStreamThreadFunc(void* arg) {
+    IrsImageStream* s = (IrsImageStream*)arg;
+    size_t size = s->width * s->height;
+
+    while (!__atomic_load_n(&s->exit, __ATOMIC_ACQUIRE)) {
+        u32 index;
+        if (R_FAILED(spscQueuePop(&s->free_queue, &index, IRS_STREAM_WAIT_NS)))
+            continue;
+
+        IrsImageFrame frame = {0};
+        frame.data = s->buffers[index];
+        frame.index = index;
+
+        // Poll until the processor has a new image.
+        bool received = false;
+        while (!received && !__atomic_load_n(&s->exit, __ATOMIC_ACQUIRE)) {
+            IrsImageTransferProcessorState state;
+            Result rc = irsGetImageTransferProcessorState(s->handle, frame.data, size, &state);
+            if (R_FAILED(rc)) {
+                s->last_result = rc;
+                svcSleepThread(IRS_STREAM_POLL_NS);
+                continue;
+            }
+
+            // The state starts with the sampling number, followed by the ambient noise level.
+            memcpy(&frame.sampling_number, &state.unk_x0[0], sizeof(u64));
+            memcpy(&frame.ambient_noise_level, &state.unk_x0[8], sizeof(u32));
+            if (frame.sampling_number == s->last_sampling_number) {
+                svcSleepThread(IRS_STREAM_POLL_NS);
+                continue;
+            }
+
+            if (s->last_sampling_number && frame.sampling_number - s->last_sampling_number > 1)
+                __atomic_fetch_add(&s->missed, frame.sampling_number - s->last_sampling_number - 1, __ATOMIC_RELAXED);
+            s->last_sampling_number = frame.sampling_number;
+            received = true;
+        }
+
+        // There's room for every buffer in both queues.
+        if (received)
+            spscQueueTryPush(&s->frame_queue, &frame);
+        else
+            spscQueueTryPush(&s->free_queue, &index);
+    }
+}
+
+Result irsImageStreamCreate(IrsImageStream* s, u32 IrCameraHandle, u32 sensor_res, void* const* buffers, u32 num_buffers, int prio, int cpuid) {
+    if (sensor_res > 2 || num_buffers < 2 || num_buffers > IRS_STREAM_MAX_BUFFERS)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    memset(s, 0, sizeof(*s));
+    s->handle = IrCameraHandle;
+    irsGetImageTransferSize(sensor_res, &s->width, &s->height);
+    for (u32 i = 0; i < num_buffers; i++)
+        s->buffers[i] = (u8*)buffers[i];
+
+    Result rc = spscQueueCreate(&s->free_queue, IRS_STREAM_MAX_BUFFERS, sizeof(u32));
+    if (R_SUCCEEDED(rc))
+        rc = spscQueueCreate(&s->frame_queue, IRS_STREAM_MAX_BUFFERS, sizeof(IrsImageFrame));
+
+    for (u32 i = 0; R_SUCCEEDED(rc) && i < num_buffers; i++)
+        spscQueueTryPush(&s->free_queue, &i);
+
+    if (R_SUCCEEDED(rc))
+        rc = threadCreate(&s->thread, _irsImageStreamThreadFunc, s, NULL, IRS_STREAM_STACK_SIZE, prio, cpuid);
+
+    if (R_SUCCEEDED(rc)) {
+        rc = threadStart(&s->thread);
+        if (R_FAILED(rc))
+            threadClose(&s->thread);
+    }
+
+    if (R_FAILED(rc)) {
+        spscQueueClose(&s->free_queue);
+        spscQueueClose(&s->frame_queue);
+    }
+
+    return rc;
+}
+
+void irsImageStreamClose(IrsImageStream* s) {
+    __atomic_store_n(&s->exit, true, __ATOMIC_RELEASE);
+    threadWaitForExit(&s->thread);
+    threadClose(&s->thread);
+
+    spscQueueClose(&s->free_queue);
+    spscQueueClose(&s->frame_queue);
+}
+
+Result irsImageStreamAcquire(IrsImageStream* s, IrsImageFrame* out, u64 timeout) {
+    return spscQueuePop(&s->frame_queue, out, timeout);
+}
+
+void irsImageStreamRelease(IrsImageStream* s, const IrsImageFrame* frame) {
+    spscQueueTryPush(&s->free_queue, &frame->index);
+}
+
+void irsImageThreshold(u8* dst, const u8* src, size_t size, u8 threshold) {
+    uint8x16_t t = vdupq_n_u8(threshold);
+    size_t i = 0;
+
+    for (; i + 16 <= size; i += 16)
+        vst1q_u8(dst + i, vcgeq_u8(vld1q_u8(src + i), t));
+
+    for (; i < size; i++)
+        dst[i] = src[i] >= threshold ? 0xFF : 0;
+}
+
+u32 irsImageComputeCentroid(const u8* src, u32 width, u32 height, u8 threshold, IrsImageBlob* out) {
+    static const u8 lane_x[16] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 };
+    uint8x16_t t = vdupq_n_u8(threshold), one = vdupq_n_u8(1), lanes = vld1q_u8(lane_x);
+    u64 sum_x = 0, sum_y = 0;
+    u32 area = 0;
+    u32 min_x = width, min_y = height, max_x = 0, max_y = 0;
+
+    for (u32 y = 0; y < height; y++) {
+        const u8* row = src + (size_t)y * width;
+        u32 row_area = 0;
+        u64 row_sum_x = 0;
+        u32 row_min = width, row_max = 0;
+        u32 x = 0;
+
+        for (; x + 16 <= width; x += 16) {
+            uint8x16_t mask = vcgeq_u8(vld1q_u8(row + x), t);
+            if (!vmaxvq_u8(mask))
+                continue;
+
+            u32 count = vaddlvq_u8(vandq_u8(mask, one));
+            row_area += count;
+            row_sum_x += (u64)x * count + vaddlvq_u8(vandq_u8(mask, lanes));
+
+            if (row_min == width) {
+                for (u32 i = 0; i < 16; i++) {
+                    if (row[x + i] >= threshold) {
+                        row_min = x + i;
+                        break;
+                    }
+                }
+            }
+            for (u32 i = 16; i--;) {
+                if (row[x + i] >= threshold) {
+                    row_max = x + i;
+                    break;
+                }
+            }
+        }
+
+        for (; x < width; x++) {
+            if (row[x] < threshold)
+                continue;
+            row_area++;
+            row_sum_x += x;
+            if (row_min == width)
+                row_min = x;
+            row_max = x;
+        }
+
+        if (!row_area)
+            continue;
+
+        area += row_area;
+        sum_x += row_sum_x;
+        sum_y += (u64)y * row_area;
+        if (row_min < min_x) min_x = row_min;
+        if (row_max > max_x) max_x = row_max;
+        if (y < min_y) min_y = y;
+        max_y = y;
+    }
+
+    memset(out, 0, sizeof(*out));
+    if (!area)
+        return 0;
+
+    out->x = (float)sum_x / area;
+    out->y = (float)sum_y / area;
+    out->area = area;
+    out->min_x = min_x;
+    out->min_y = min_y;
+    out->max_x = max_x;
+    out->max_y = max_y;
+    return area;
+}
+
+static s32 _irsImageFindRoot(IrsImageRun* runs, s32 i) {
+    s32 root = i;
+    while (runs[root].parent != root)
+        root = runs[root].parent;
+
+    while (runs[i].parent != root) {
+        s32 next = runs[i].parent;
+        runs[i].parent = root;
+        i = next;
+    }
+    return root;
+}
+
+static void _irsImageUnion(IrsImageRun* runs, s32 a, s32 b) {
+    a = _irsImageFindRoot(runs, a);
+    b = _irsImageFindRoot(runs, b);
+    if (a < b)
+        runs[b].parent = a;
+    else if (b < a)
+        runs[a].parent = b;
+}
+
+u32 irsImageFindBlobs(const u8* src, u32 width, u32 height, u8 threshold, u32 min_area, IrsImageRun* work, u32 max_runs, IrsImageBlob* out, u32 max_blobs) {
+    uint8x16_t t = vdupq_n_u8(threshold);
+    u32 num_runs = 0;
+    u32 prev_start = 0, prev_end = 0;
+
+    if (!min_area)
+        min_area = 1;
+
+    // Extract the runs row by row, merging them with the overlapping (or diagonally touching) runs of the previous row.
+    for (u32 y = 0; y < height && num_runs < max_runs; y++) {
+        const u8* row = src + (size_t)y * width;
+        u32 row_start = num_runs;
+        u32 p = prev_start;
+        u32 x = 0;
+
+        while (x < width && num_runs < max_runs) {
+            // Skip the dark areas 16 pixels at a time.
+            while (x + 16 <= width && !vmaxvq_u8(vcgeq_u8(vld1q_u8(row + x), t)))
+                x += 16;
+            while (x < width && row[x] < threshold)
+                x++;
+            if (x >= width)
+                break;
+
+            u32 x0 = x;
+            while (x < width && row[x] >= threshold)
+                x++;
+
+            IrsImageRun* r = &work[num_runs];
+            r->y = y;
+            r->x0 = x0;
+            r->x1 = x;
+            r->pad = 0;
+            r->parent = num_runs;
+            r->acc = 0;
+
+            while (p < prev_end && work[p].x1 < x0)
+                p++;
+            for (u32 q = p; q < prev_end && work[q].x0 <= x; q++)
+                _irsImageUnion(work, q, num_runs);
+
+            num_runs++;
+        }
+
+        prev_start = row_start;
+        prev_end = num_runs;
+    }
+
+    // Accumulate the area of each blob in its root.
+    for (u32 i = 0; i < num_runs; i++)
+        work[_irsImageFindRoot(work, i)].acc += work[i].x1 - work[i].x0;
+
+    // Assign the output blobs to the roots large enough, acc becoming -(blob index + 1), or 0 for the ignored ones.
+    u32 num_blobs = 0;
+    for (u32 i = 0; i < num_runs; i++) {
+        IrsImageRun* r = &work[i];
+        IrsImageRun* root = &work[_irsImageFindRoot(work, i)];
+
+        if (root->acc > 0) {
+            if ((u32)root->acc >= min_area && num_blobs < max_blobs) {
+                IrsImageBlob* b = &out[num_blobs];
+                memset(b, 0, sizeof(*b));
+                b->min_x = r->x0;
+                b->min_y = r->y;
+                root->acc = -(s32)(++num_blobs);
+            }
+            else
+                root->acc = 0;
+        }
+
+        if (root->acc == 0)
+            continue;
+
+        IrsImageBlob* b = &out[-root->acc - 1];
+        u32 len = r->x1 - r->x0;
+        b->x += (float)(r->x0 + r->x1 - 1) * len / 2;
+        b->y += (float)r->y * len;
+        b->area += len;
+        if (r->x0 < b->min_x) b->min_x = r->x0;
+        if (r->x1 - 1 > b->max_x) b->max_x = r->x1 - 1;
+        b->max_y = r->y;
+    }
+
+    for (u32 i = 0; i < num_blobs; i++) {
+        out[i].x /= out[i].area;
+        out[i].y /= out[i].area;
+    }
+
+    return num_blobs;
+}
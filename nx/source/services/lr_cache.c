@@ -0,0 +1,228 @@
+#include <stdlib.h>
+#include <string.h>
+#include "types.h"
+#include "result.h"
+#include "kernel/svc.h"
+#include "kernel/thread.h"
+#include "services/lr_cache.h"
+
+// Path resolutions shared by the workers.
+typedef struct {
+    LrPathType type;
+    const u64* tids;
+    char (*out)[FS_MAX_PATH];
+    Result* out_rcs;
+    u32* jobs;
+    u32 num_jobs;
+    u32 next;
+} LrPathCacheFetch;
+
+typedef struct {
+    LrPathCacheFetch* fetch;
+    LrLocationResolver* lr;
+    Thread thread;
+} LrPathCacheWorker;
+
+static Result _lrPathCacheResolveIpc(LrLocationResolver* lr, LrPathType type, u64 tid, char* out) {
+    switch (type) {
+        case LrPathType_Program:
+            return lrLrResolveProgramPath(lr, tid, out);
+        case LrPathType_ApplicationControl:
+            return lrLrResolveApplicationControlPath(lr, tid, out);
+        case LrPathType_ApplicationHtmlDocument:
+            return lrLrResolveApplicationHtmlDocumentPath(lr, tid, out);
+        case LrPathType_Data:
+            return lrLrResolveDataPath(lr, tid, out);
+        case LrPathType_ApplicationLegalInformation:
+            return lrLrResolveApplicationLegalInformationPath(lr, tid, out);
+    }
+    return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+}
+
+static u32 _lrPathCacheHash(LrPathType type, u64 tid) {
+    u64 h = (tid ^ ((u64)type << 56)) * 0x9E3779B97F4A7C15ULL;
+    return h >> 32;
+}
+
+static LrPathCacheEntry* _lrPathCacheFind(LrPathCache* c, LrPathType type, u64 tid) {
+    if (!c->capacity)
+        return NULL;
+
+    for (u32 i = _lrPathCacheHash(type, tid) & (c->capacity - 1);; i = (i + 1) & (c->capacity - 1)) {
+        LrPathCacheEntry* e = &c->entries[i];
+        if (!e->path)
+            return NULL;
+        if (e->tid == tid && e->type == type)
+            return e;
+    }
+}
+
+static void _lrPathCacheInsertEntry(LrPathCacheEntry* entries, u32 capacity, const LrPathCacheEntry* entry) {
+    u32 i = _lrPathCacheHash(entry->type, entry->tid) & (capacity - 1);
+    while (entries[i].path)
+        i = (i + 1) & (capacity - 1);
+    entries[i] = *entry;
+}
+
+static void _lrPathCacheInsert(LrPathCache* c, LrPathType type, u64 tid, const char* path) {
+    if (_lrPathCacheFind(c, type, tid))
+        return;
+
+    // Keep the load factor at most 1/2.
+    if ((c->count + 1) * 2 > c->capacity) {
+        u32 capacity = c->capacity ? c->capacity * 2 : 64;
+        LrPathCacheEntry* entries = (LrPathCacheEntry*)calloc(capacity, sizeof(LrPathCacheEntry));
+        if (!entries)
+            return;
+
+        for (u32 i = 0; i < c->capacity; i++) {
+            if (c->entries[i].path)
+                _lrPathCacheInsertEntry(entries, capacity, &c->entries[i]);
+        }
+        free(c->entries);
+        c->entries = entries;
+        c->capacity = capacity;
+    }
+
+    // Paths are usually much shorter than FS_MAX_PATH.
+    LrPathCacheEntry entry = { tid, type, strdup(path) };
+    if (!entry.path)
+        return;
+    _lrPathCacheInsertEntry(c->entries, c->capacity, &entry);
+    c->count++;
+}
+
+Result lrPathCacheCreate(LrPathCache* c, NcmStorageId storage, u32 num_sessions) {
+    if (!num_sessions || num_sessions > LR_CACHE_MAX_SESSIONS)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    memset(c, 0, sizeof(*c));
+    c->storage = storage;
+
+    Result rc = lrOpenLocationResolver(storage, &c->sessions[0]);
+    if (R_FAILED(rc))
+        return rc;
+    c->num_sessions = 1;
+
+    for (u32 i = 1; i < num_sessions; i++) {
+        if (R_FAILED(lrOpenLocationResolver(storage, &c->sessions[i])))
+            break;
+        c->num_sessions++;
+    }
+
+    return 0;
+}
+
+void lrPathCacheClose(LrPathCache* c) {
+    lrPathCacheInvalidate(c);
+    for (u32 i = 0; i < c->num_sessions; i++)
+        serviceClose(&c->sessions[i].s);
+    memset(c, 0, sizeof(*c));
+}
+
+void lrPathCacheInvalidate(LrPathCache* c) {
+    for (u32 i = 0; i < c->capacity; i++)
+        free(c->entries[i].path);
+    free(c->entries);
+    c->entries = NULL;
+    c->capacity = 0;
+    c->count = 0;
+}
+
+Result lrPathCacheRefresh(LrPathCache* c) {
+    lrPathCacheInvalidate(c);
+    return lrLrRefresh(&c->sessions[0]);
+}
+
+Result lrPathCacheResolve(LrPathCache* c, LrPathType type, u64 tid, char* out) {
+    LrPathCacheEntry* e = _lrPathCacheFind(c, type, tid);
+    if (e) {
+        c->hits++;
+        strncpy(out, e->path, FS_MAX_PATH);
+        out[FS_MAX_PATH-1] = 0;
+        return 0;
+    }
+
+    c->misses++;
+    Result rc = _lrPathCacheResolveIpc(&c->sessions[0], type, tid, out);
+    if (R_SUCCEEDED(rc))
+        _lrPathCacheInsert(c, type, tid, out);
+    return rc;
+}
+
+static void _lrPathCacheWorkerFunc(void* arg) {
+    LrPathCacheWorker* w = (LrPathCacheWorker*)arg;
+    LrPathCacheFetch* f = w->fetch;
+    u32 i;
+
+    while ((i = __atomic_fetch_add(&f->next, 1, __ATOMIC_RELAXED)) < f->num_jobs) {
+        u32 job = f->jobs[i];
+        f->out_rcs[job] = _lrPathCacheResolveIpc(w->lr, f->type, f->tids[job], f->out[job]);
+    }
+}
+
+Result lrPathCacheResolveBulk(LrPathCache* c, LrPathType type, const u64* tids, char (*out)[FS_MAX_PATH], Result* out_rcs, u32 count) {
+    u32* jobs = (u32*)malloc(count * sizeof(u32));
+    if (!jobs && count)
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+
+    u32 num_jobs = 0;
+    for (u32 i = 0; i < count; i++) {
+        LrPathCacheEntry* e = _lrPathCacheFind(c, type, tids[i]);
+        if (e) {
+            c->hits++;
+            strncpy(out[i], e->path, FS_MAX_PATH);
+            out[i][FS_MAX_PATH-1] = 0;
+            out_rcs[i] = 0;
+        }
+        else
+            jobs[num_jobs++] = i;
+    }
+
+    LrPathCacheFetch fetch = { type, tids, out, out_rcs, jobs, num_jobs, 0 };
+    LrPathCacheWorker workers[LR_CACHE_MAX_SESSIONS];
+    u32 num_workers = c->num_sessions < num_jobs ? c->num_sessions : num_jobs;
+    u32 num_started = 1;
+    u32 prio = 0x2C;
+
+    if (num_workers) {
+        svcGetThreadPriority(&prio, CUR_THREAD_HANDLE);
+        memset(workers, 0, sizeof(workers));
+
+        // The calling thread is the first worker. Workers which fail to start leave their share to the others.
+        for (u32 i = 0; i < num_workers; i++) {
+            LrPathCacheWorker* w = &workers[i];
+            w->fetch = &fetch;
+            w->lr = &c->sessions[i];
+            if (i == 0)
+                continue;
+
+            Result rc = threadCreate(&w->thread, _lrPathCacheWorkerFunc, w, NULL, 0x4000, prio, -2);
+            if (R_SUCCEEDED(rc)) {
+                rc = threadStart(&w->thread);
+                if (R_FAILED(rc))
+                    threadClose(&w->thread);
+            }
+            if (R_FAILED(rc))
+                break;
+            num_started++;
+        }
+
+        _lrPathCacheWorkerFunc(&workers[0]);
+
+        for (u32 i = 1; i < num_started; i++) {
+            threadWaitForExit(&workers[i].thread);
+            threadClose(&workers[i].thread);
+        }
+    }
+
+    for (u32 i = 0; i < num_jobs; i++) {
+        u32 job = jobs[i];
+        c->misses++;
+        if (R_SUCCEEDED(out_rcs[job]))
+            _lrPathCacheInsert(c, type, tids[job], out[job]);
+    }
+
+    free(jobs);
+    return 0;
+}
@@ -0,0 +1,152 @@
+#include <malloc.h>
+#include <string.h>
+#include "types.h"
+#include "result.h"
+#include "kernel/svc.h"
+#include "services/ncm_install.h"
+
+Result ncmInstallStreamCreate(NcmInstallStream* s, const NcmInstallStreamConfig* config) {
+    memset(s, 0, sizeof(*s));
+    s->config = *config;
+
+    NcmInstallStreamConfig* c = &s->config;
+    if (!c->chunk_size) c->chunk_size = NCM_INSTALL_DEFAULT_CHUNK_SIZE;
+    if (!c->num_buffers) c->num_buffers = 2;
+    c->chunk_size = (c->chunk_size + 0xFFF) & ~0xFFF;
+
+    if (!c->cs || !c->read || c->size < 0 || c->num_buffers < 2 || c->num_buffers > NCM_INSTALL_MAX_BUFFERS)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    for (u32 i = 0; i < c->num_buffers; i++) {
+        s->buffers[i] = (u8*)memalign(0x1000, c->chunk_size);
+        if (!s->buffers[i]) {
+            ncmInstallStreamClose(s);
+            return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+        }
+    }
+
+    mutexInit(&s->mutex);
+    condvarInit(&s->cond);
+    return 0;
+}
+
+void ncmInstallStreamClose(NcmInstallStream* s) {
+    for (u32 i = 0; i < NCM_INSTALL_MAX_BUFFERS; i++)
+        free(s->buffers[i]);
+    memset(s, 0, sizeof(*s));
+}
+
+static void _ncmInstallStreamReader(void* arg) {
+    NcmInstallStream* s = (NcmInstallStream*)arg;
+    NcmInstallStreamConfig* c = &s->config;
+    Result rc = 0;
+    u32 index = 0;
+
+    for (s64 offset = 0; offset < c->size; offset += c->chunk_size) {
+        mutexLock(&s->mutex);
+        while (!s->cancel && s->num_ready == c->num_buffers)
+            condvarWait(&s->cond, &s->mutex);
+        bool cancel = s->cancel;
+        mutexUnlock(&s->mutex);
+        if (cancel)
+            break;
+
+        // The buffer at index is free: the writer only owns the num_ready ones before it.
+        size_t size = c->size - offset < (s64)c->chunk_size ? c->size - offset : c->chunk_size;
+        rc = c->read(c->userdata, offset, s->buffers[index], size);
+        if (R_SUCCEEDED(rc) && c->process)
+            rc = c->process(c->userdata, offset, s->buffers[index], size);
+        if (R_FAILED(rc))
+            break;
+
+        mutexLock(&s->mutex);
+        s->sizes[index] = size;
+        s->num_ready++;
+        condvarWakeAll(&s->cond);
+        mutexUnlock(&s->mutex);
+
+        index = (index + 1) % c->num_buffers;
+    }
+
+    mutexLock(&s->mutex);
+    s->reader_rc = rc;
+    s->reader_done = true;
+    condvarWakeAll(&s->cond);
+    mutexUnlock(&s->mutex);
+}
+
+Result ncmInstallStreamRun(NcmInstallStream* s) {
+    NcmInstallStreamConfig* c = &s->config;
+    Result rc = 0;
+    s64 offset = 0;
+
+    s->num_ready = 0;
+    s->write_index = 0;
+    s->reader_rc = 0;
+    s->reader_done = false;
+    s->written = 0;
+
+    u32 prio = c->prio;
+    if (c->prio < 0) {
+        prio = 0x2C;
+        svcGetThreadPriority(&prio, CUR_THREAD_HANDLE);
+    }
+
+    rc = threadCreate(&s->reader, _ncmInstallStreamReader, s, NULL, 0x4000, prio, c->cpuid);
+    if (R_SUCCEEDED(rc)) {
+        rc = threadStart(&s->reader);
+        if (R_FAILED(rc))
+            threadClose(&s->reader);
+    }
+    if (R_FAILED(rc))
+        return rc;
+
+    for (;;) {
+        mutexLock(&s->mutex);
+        while (!s->num_ready && !s->reader_done && !s->cancel)
+            condvarWait(&s->cond, &s->mutex);
+        bool ready = s->num_ready != 0 && !s->cancel;
+        if (!ready) {
+            rc = s->cancel ? MAKERESULT(Module_Libnx, LibnxError_Cancelled) : s->reader_rc;
+            s->cancel = true;
+            condvarWakeAll(&s->cond);
+        }
+        mutexUnlock(&s->mutex);
+        if (!ready)
+            break;
+
+        u32 index = s->write_index;
+        size_t size = s->sizes[index];
+        rc = ncmContentStorageWritePlaceHolder(c->cs, &c->placeholder_id, offset, s->buffers[index], size);
+        if (R_FAILED(rc)) {
+            ncmInstallStreamCancel(s);
+            break;
+        }
+
+        offset += size;
+        __atomic_store_n(&s->written, offset, __ATOMIC_RELAXED);
+
+        mutexLock(&s->mutex);
+        s->write_index = (index + 1) % c->num_buffers;
+        s->num_ready--;
+        condvarWakeAll(&s->cond);
+        mutexUnlock(&s->mutex);
+    }
+
+    threadWaitForExit(&s->reader);
+    threadClose(&s->reader);
+
+    // The reader may have stopped early on a failure while chunks were still pending, so check the total.
+    if (R_SUCCEEDED(rc) && offset != c->size)
+        rc = MAKERESULT(Module_Libnx, LibnxError_IoError);
+
+    s->cancel = false;
+    return rc;
+}
+
+void ncmInstallStreamCancel(NcmInstallStream* s) {
+    mutexLock(&s->mutex);
+    s->cancel = true;
+    condvarWakeAll(&s->cond);
+    mutexUnlock(&s->mutex);
+}
@@ -0,0 +1,267 @@
+#include <stdlib.h>
+#include <string.h>
+#include "types.h"
+#include "result.h"
+#include "kernel/svc.h"
+#include "kernel/thread.h"
+#include "services/ncm_meta_list.h"
+
+#define NCM_META_LIST_INITIAL_KEYS   0x800
+#define NCM_META_LIST_RECORD_SPACE   0x4000
+
+// Record fetches shared by the workers.
+typedef struct {
+    NcmContentMetaListEntry* entries;
+    u32* storage_indices;           // Index in storage_ids of each entry.
+    u8* owners;                     // Worker holding the record of each entry.
+    u32* offsets;                   // Offset of the record of each entry in the arena of its worker.
+    u32 count;
+    u32 next;
+} NcmContentMetaListFetch;
+
+typedef struct {
+    NcmContentMetaListFetch* fetch;
+    u32 id;
+    NcmContentMetaDatabase* dbs;    // Per storage, opened on first use.
+    NcmContentMetaDatabase own_dbs[NCM_META_LIST_MAX_STORAGES];
+    u8* arena;
+    size_t arena_size;
+    size_t arena_capacity;
+    Thread thread;
+} NcmContentMetaListWorker;
+
+static Result _ncmContentMetaListReserve(NcmContentMetaListWorker* w, size_t size) {
+    if (w->arena_capacity - w->arena_size >= size)
+        return 0;
+
+    size_t capacity = w->arena_capacity ? w->arena_capacity : 0x10000;
+    while (capacity - w->arena_size < size)
+        capacity *= 2;
+
+    u8* tmp = (u8*)realloc(w->arena, capacity);
+    if (!tmp)
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+    w->arena = tmp;
+    w->arena_capacity = capacity;
+    return 0;
+}
+
+static Result _ncmContentMetaListGetRecord(NcmContentMetaListWorker* w, NcmContentMetaDatabase* db, NcmContentMetaListEntry* e, u32 index) {
+    NcmContentMetaListFetch* f = w->fetch;
+    u64 size = 0;
+
+    // Records usually fit in the free space of the arena, so the size is only queried when they don't.
+    Result rc = _ncmContentMetaListReserve(w, NCM_META_LIST_RECORD_SPACE);
+    if (R_SUCCEEDED(rc))
+        rc = ncmContentMetaDatabaseGet(db, &e->key, &size, w->arena + w->arena_size, w->arena_capacity - w->arena_size);
+    if (R_FAILED(rc)) {
+        if (R_FAILED(ncmContentMetaDatabaseGetSize(db, &size, &e->key)))
+            return rc;
+        rc = _ncmContentMetaListReserve(w, size);
+        if (R_SUCCEEDED(rc))
+            rc = ncmContentMetaDatabaseGet(db, &e->key, &size, w->arena + w->arena_size, w->arena_capacity - w->arena_size);
+        if (R_FAILED(rc))
+            return rc;
+    }
+    if (size < sizeof(NcmContentMetaHeader))
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    f->owners[index] = w->id;
+    f->offsets[index] = w->arena_size;
+    e->record_size = size;
+    w->arena_size += (size + 7) & ~7;
+    return 0;
+}
+
+static void _ncmContentMetaListWorkerFunc(void* arg) {
+    NcmContentMetaListWorker* w = (NcmContentMetaListWorker*)arg;
+    NcmContentMetaListFetch* f = w->fetch;
+    u32 i;
+
+    while ((i = __atomic_fetch_add(&f->next, 1, __ATOMIC_RELAXED)) < f->count) {
+        NcmContentMetaListEntry* e = &f->entries[i];
+        NcmContentMetaDatabase* db = &w->dbs[f->storage_indices[i]];
+
+        if (!serviceIsActive(&db->s)) {
+            e->rc = ncmOpenContentMetaDatabase(db, e->storage_id);
+            if (R_FAILED(e->rc))
+                continue;
+        }
+        e->rc = _ncmContentMetaListGetRecord(w, db, e, i);
+    }
+}
+
+static Result _ncmContentMetaListKeys(NcmContentMetaDatabase* db, NcmContentMetaType meta_type, NcmContentMetaKey** keys, u32* capacity, s32* out_count) {
+    s32 total = 0, written = 0;
+
+    // A large buffer gets everything in one request. Otherwise the total is known and the second one does.
+    for (;;) {
+        Result rc = ncmContentMetaDatabaseList(db, &total, &written, *keys, *capacity, meta_type, 0, 0, UINT64_MAX, NcmContentInstallType_Unknown);
+        if (R_FAILED(rc))
+            return rc;
+        if (total <= (s32)*capacity)
+            break;
+
+        NcmContentMetaKey* tmp = (NcmContentMetaKey*)realloc(*keys, total * sizeof(NcmContentMetaKey));
+        if (!tmp)
+            return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+        *keys = tmp;
+        *capacity = total;
+    }
+
+    *out_count = written;
+    return 0;
+}
+
+static Result _ncmContentMetaListFetch(NcmContentMetaList* l, NcmContentMetaListFetch* fetch, NcmContentMetaDatabase* dbs, u32 num_sessions) {
+    NcmContentMetaListWorker workers[NCM_META_LIST_MAX_SESSIONS];
+    u32 num_workers = num_sessions < fetch->count ? num_sessions : fetch->count;
+    u32 num_started = 1;
+    u32 prio = 0x2C;
+    Result rc = 0;
+
+    if (!num_workers)
+        return 0;
+
+    svcGetThreadPriority(&prio, CUR_THREAD_HANDLE);
+    memset(workers, 0, sizeof(workers));
+
+    // The calling thread is the first worker, with the sessions used for listing. Workers which fail to start leave their share to the others.
+    for (u32 i = 0; i < num_workers; i++) {
+        NcmContentMetaListWorker* w = &workers[i];
+        w->fetch = fetch;
+        w->id = i;
+        w->dbs = i == 0 ? dbs : w->own_dbs;
+        if (i == 0)
+            continue;
+
+        rc = threadCreate(&w->thread, _ncmContentMetaListWorkerFunc, w, NULL, 0x4000, prio, -2);
+        if (R_SUCCEEDED(rc)) {
+            rc = threadStart(&w->thread);
+            if (R_FAILED(rc))
+                threadClose(&w->thread);
+        }
+        if (R_FAILED(rc))
+            break;
+        num_started++;
+    }
+
+    _ncmContentMetaListWorkerFunc(&workers[0]);
+
+    for (u32 i = 1; i < num_started; i++) {
+        threadWaitForExit(&workers[i].thread);
+        threadClose(&workers[i].thread);
+        for (u32 j = 0; j < NCM_META_LIST_MAX_STORAGES; j++)
+            ncmContentMetaDatabaseClose(&workers[i].own_dbs[j]);
+    }
+
+    // Move the records of all the workers into one allocation.
+    size_t bases[NCM_META_LIST_MAX_SESSIONS];
+    size_t total = 0;
+    for (u32 i = 0; i < num_started; i++) {
+        bases[i] = total;
+        total += workers[i].arena_size;
+    }
+
+    rc = 0;
+    if (total) {
+        l->data = (u8*)malloc(total);
+        if (!l->data)
+            rc = MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+    }
+
+    if (R_SUCCEEDED(rc)) {
+        l->data_size = total;
+        for (u32 i = 0; i < num_started; i++)
+            memcpy(l->data + bases[i], workers[i].arena, workers[i].arena_size);
+
+        for (u32 i = 0; i < fetch->count; i++) {
+            NcmContentMetaListEntry* e = &fetch->entries[i];
+            if (R_SUCCEEDED(e->rc))
+                e->record = (const NcmContentMetaHeader*)(l->data + bases[fetch->owners[i]] + fetch->offsets[i]);
+        }
+    }
+
+    for (u32 i = 0; i < num_started; i++)
+        free(workers[i].arena);
+
+    return rc;
+}
+
+Result ncmContentMetaListCreate(NcmContentMetaList* l, const NcmStorageId* storage_ids, u32 num_storages, NcmContentMetaType meta_type, u32 num_sessions) {
+    NcmContentMetaDatabase dbs[NCM_META_LIST_MAX_STORAGES];
+    NcmContentMetaKey* keys = NULL;
+    u32* storage_indices = NULL;
+    u32 capacity = NCM_META_LIST_INITIAL_KEYS;
+    u32 count = 0;
+    Result rc = 0;
+
+    if (num_storages > NCM_META_LIST_MAX_STORAGES || num_sessions > NCM_META_LIST_MAX_SESSIONS)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    memset(l, 0, sizeof(*l));
+    memset(dbs, 0, sizeof(dbs));
+
+    keys = (NcmContentMetaKey*)malloc(capacity * sizeof(NcmContentMetaKey));
+    if (!keys)
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+
+    for (u32 i = 0; i < num_storages && R_SUCCEEDED(rc); i++) {
+        if (R_FAILED(ncmOpenContentMetaDatabase(&dbs[i], storage_ids[i])))
+            continue;
+
+        s32 written = 0;
+        rc = _ncmContentMetaListKeys(&dbs[i], meta_type, &keys, &capacity, &written);
+        if (R_SUCCEEDED(rc) && written) {
+            NcmContentMetaListEntry* entries = (NcmContentMetaListEntry*)realloc(l->entries, (count + written) * sizeof(NcmContentMetaListEntry));
+            u32* indices = (u32*)realloc(storage_indices, (count + written) * sizeof(u32));
+            if (entries)
+                l->entries = entries;
+            if (indices)
+                storage_indices = indices;
+
+            if (!entries || !indices)
+                rc = MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+            else {
+                memset(&l->entries[count], 0, written * sizeof(NcmContentMetaListEntry));
+                for (s32 j = 0; j < written; j++) {
+                    l->entries[count + j].key = keys[j];
+                    l->entries[count + j].storage_id = storage_ids[i];
+                    storage_indices[count + j] = i;
+                }
+                count += written;
+            }
+        }
+    }
+
+    free(keys);
+    l->count = count;
+
+    if (R_SUCCEEDED(rc) && num_sessions) {
+        NcmContentMetaListFetch fetch = { l->entries, storage_indices, NULL, NULL, count, 0 };
+        fetch.owners = (u8*)malloc(count);
+        fetch.offsets = (u32*)malloc(count * sizeof(u32));
+
+        if ((!fetch.owners || !fetch.offsets) && count)
+            rc = MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+        else
+            rc = _ncmContentMetaListFetch(l, &fetch, dbs, num_sessions);
+
+        free(fetch.owners);
+        free(fetch.offsets);
+    }
+
+    for (u32 i = 0; i < NCM_META_LIST_MAX_STORAGES; i++)
+        ncmContentMetaDatabaseClose(&dbs[i]);
+    free(storage_indices);
+
+    if (R_FAILED(rc))
+        ncmContentMetaListClose(l);
+    return rc;
+}
+
+void ncmContentMetaListClose(NcmContentMetaList* l) {
+    free(l->entries);
+    free(l->data);
+    memset(l, 0, sizeof(*l));
+}
@@ -0,0 +1,148 @@
+#include <string.h>
+#include "types.h"
+#include "result.h"
+#include "kernel/wait.h"
+#include "services/nfp_detector.h"
+
+static NfpDetectorTag* _nfpDetectorFindTag(NfpDetector* d, const NfpTagInfo* info) {
+    for (u32 i = 0; i < d->cache_count; i++) {
+        NfpDetectorTag* t = &d->cache[i];
+        if (t->tag_info.uuid_length == info->uuid_length && memcmp(t->tag_info.uuid, info->uuid, info->uuid_length) == 0)
+            return t;
+    }
+    return NULL;
+}
+
+static void _nfpDetectorCacheTag(NfpDetector* d, const NfpDetectorTag* tag) {
+    NfpDetectorTag* t = _nfpDetectorFindTag(d, &tag->tag_info);
+
+    // Replace the least recently seen tag once the cache is full.
+    if (!t && d->cache_count < NFP_DETECTOR_CACHE_SIZE)
+        t = &d->cache[d->cache_count++];
+    if (!t) {
+        t = &d->cache[0];
+        for (u32 i = 1; i < d->cache_count; i++) {
+            if (d->cache[i].last_used < t->last_used)
+                t = &d->cache[i];
+        }
+    }
+    *t = *tag;
+}
+
+static Result _nfpDetectorReadTag(NfpDetector* d, NfpDetectorDevice* dev) {
+    NfpTagInfo info;
+
+    // The tag info doesn't need a mount, and identifies the tag for the cache.
+    Result rc = nfpGetTagInfo(&dev->handle, &info);
+    if (R_FAILED(rc))
+        return rc;
+
+    NfpDetectorTag* cached = _nfpDetectorFindTag(d, &info);
+    if (cached) {
+        cached->last_used = ++d->counter;
+        dev->tag = *cached;
+        return 0;
+    }
+
+    memset(&dev->tag, 0, sizeof(dev->tag));
+    dev->tag.tag_info = info;
+
+    rc = nfpMount(&dev->handle, NfpDeviceType_Amiibo, NfpMountTarget_All);
+    if (R_FAILED(rc))
+        return rc;
+
+    rc = nfpGetCommonInfo(&dev->handle, &dev->tag.common_info);
+    if (R_SUCCEEDED(rc))
+        rc = nfpGetModelInfo(&dev->handle, &dev->tag.model_info);
+    if (R_SUCCEEDED(rc))
+        dev->tag.has_register_info = R_SUCCEEDED(nfpGetRegisterInfo(&dev->handle, &dev->tag.register_info));
+
+    nfpUnmount(&dev->handle);
+
+    if (R_SUCCEEDED(rc)) {
+        dev->tag.last_used = ++d->counter;
+        _nfpDetectorCacheTag(d, &dev->tag);
+    }
+    return rc;
+}
+
+Result nfpDetectorCreate(NfpDetector* d) {
+    NfcDeviceHandle handles[NFP_DETECTOR_MAX_DEVICES];
+    s32 total = 0;
+
+    memset(d, 0, sizeof(*d));
+
+    Result rc = nfpListDevices(&total, handles, NFP_DETECTOR_MAX_DEVICES);
+    if (R_FAILED(rc))
+        return rc;
+
+    for (s32 i = 0; i < total && i < NFP_DETECTOR_MAX_DEVICES; i++) {
+        NfpDetectorDevice* dev = &d->devices[i];
+        dev->handle = handles[i];
+
+        rc = nfpAttachActivateEvent(&dev->handle, &dev->activate_event);
+        if (R_SUCCEEDED(rc))
+            rc = nfpAttachDeactivateEvent(&dev->handle, &dev->deactivate_event);
+        if (R_SUCCEEDED(rc))
+            rc = nfpStartDetection(&dev->handle);
+        if (R_FAILED(rc)) {
+            eventClose(&dev->activate_event);
+            eventClose(&dev->deactivate_event);
+            break;
+        }
+        d->count++;
+    }
+
+    if (R_FAILED(rc))
+        nfpDetectorClose(d);
+    return rc;
+}
+
+void nfpDetectorClose(NfpDetector* d) {
+    for (s32 i = 0; i < d->count; i++) {
+        NfpDetectorDevice* dev = &d->devices[i];
+        nfpStopDetection(&dev->handle);
+        eventClose(&dev->activate_event);
+        eventClose(&dev->deactivate_event);
+    }
+    memset(d, 0, sizeof(*d));
+}
+
+Result nfpDetectorWait(NfpDetector* d, s32* out_device, u64 timeout) {
+    Waiter waiters[NFP_DETECTOR_MAX_DEVICES * 2];
+    s32 idx = -1;
+
+    for (s32 i = 0; i < d->count; i++) {
+        waiters[i*2]   = waiterForEvent(&d->devices[i].activate_event);
+        waiters[i*2+1] = waiterForEvent(&d->devices[i].deactivate_event);
+    }
+
+    Result rc = waitObjects(&idx, waiters, d->count * 2, timeout);
+    if (R_FAILED(rc))
+        return rc;
+
+    NfpDetectorDevice* dev = &d->devices[idx / 2];
+    *out_device = idx / 2;
+
+    if (idx % 2 == 0) {
+        eventClear(&dev->activate_event);
+        dev->active = true;
+        dev->rc = _nfpDetectorReadTag(d, dev);
+    }
+    else {
+        eventClear(&dev->deactivate_event);
+        dev->active = false;
+
+        // Detection stops when the device is lost (e.g. the controller was disconnected and reconnected).
+        NfpDeviceState state;
+        if (R_SUCCEEDED(nfpGetDeviceState(&dev->handle, &state)) && state == NfpDeviceState_Initialized)
+            nfpStartDetection(&dev->handle);
+    }
+
+    return 0;
+}
+
+void nfpDetectorInvalidate(NfpDetector* d) {
+    memset(d->cache, 0, sizeof(d->cache));
+    d->cache_count = 0;
+}
@@ -1,3 +1,4 @@
+#include <string.h>
 #include "service_guard.h"
 #include "services/nifm.h"
 #include "runtime/hosversion.h"
@@ -70,6 +71,11 @@ static Result _nifmCmdNoInOutU32(Service* srv, u32 *out, u32 cmd_id) {
     return serviceDispatchOut(srv, cmd_id, *out);
 }
 
+static Result _nifmCmdNoInOutS32(Service* srv, s32 *out, u32 cmd_id) {
+    serviceAssumeDomain(srv);
+    return serviceDispatchOut(srv, cmd_id, *out);
+}
+
 static Result _nifmCmdNoInOutU8(Service* srv, u8 *out, u32 cmd_id) {
     serviceAssumeDomain(srv);
     return serviceDispatchOut(srv, cmd_id, *out);
@@ -152,3 +158,54 @@ Result nifmPutToSleep(void) {
 Result nifmWakeUp(void) {
     return _nifmCmdNoIO(&g_nifmIGS, 24);
 }
+
+Result nifmCreateRequest(NifmRequest* r, s32 requirement_preset, bool autoclear) {
+    Handle handles[2] = {INVALID_HANDLE, INVALID_HANDLE};
+
+    memset(r, 0, sizeof(*r));
+
+    serviceAssumeDomain(&g_nifmIGS);
+    Result rc = serviceDispatchIn(&g_nifmIGS, 4, requirement_preset,
+        .out_num_objects = 1,
+        .out_objects = &r->s,
+    );
+
+    if (R_SUCCEEDED(rc)) {
+        serviceAssumeDomain(&r->s);
+        rc = serviceDispatch(&r->s, 2,
+            .out_handle_attrs = { SfOutHandleAttr_HipcCopy, SfOutHandleAttr_HipcCopy },
+            .out_handles = handles,
+        );
+
+        if (R_SUCCEEDED(rc)) {
+            eventLoadRemote(&r->event_state, handles[0], autoclear);
+            eventLoadRemote(&r->event_other, handles[1], autoclear);
+        }
+        else
+            serviceClose(&r->s);
+    }
+
+    return rc;
+}
+
+void nifmRequestClose(NifmRequest* r) {
+    eventClose(&r->event_state);
+    eventClose(&r->event_other);
+    serviceClose(&r->s);
+}
+
+Result nifmRequestGetRequestState(NifmRequest* r, s32* out) {
+    return _nifmCmdNoInOutS32(&r->s, out, 0);
+}
+
+Result nifmRequestGetResult(NifmRequest* r) {
+    return _nifmCmdNoIO(&r->s, 1);
+}
+
+Result nifmRequestCancel(NifmRequest* r) {
+    return _nifmCmdNoIO(&r->s, 3);
+}
+
+Result nifmRequestSubmit(NifmRequest* r) {
+    return _nifmCmdNoIO(&r->s, 4);
+}
@@ -0,0 +1,107 @@
+#include <string.h>
+#include "types.h"
+#include "result.h"
+#include "arm/counter.h"
+#include "kernel/wait.h"
+#include "services/nifm_monitor.h"
+
+static void _nifmStatusMonitorUpdate(NifmStatusMonitor* m) {
+    NifmStatus status = {0};
+
+    status.rc = nifmGetInternetConnectionStatus(&status.type, &status.wifi_strength, &status.status);
+    if (R_FAILED(nifmGetCurrentIpAddress(&status.ip_address)))
+        status.ip_address = 0;
+    status.tick = armGetSystemTick();
+
+    // Only the monitor thread (or Create, before it starts) writes the snapshot.
+    NifmStatus* cur = &m->snapshot;
+    bool changed = status.rc != cur->rc || status.ip_address != cur->ip_address;
+    if (R_SUCCEEDED(status.rc))
+        changed = changed || status.type != cur->type || status.wifi_strength != cur->wifi_strength || status.status != cur->status;
+    status.changes = cur->changes + (changed ? 1 : 0);
+
+    u32 seq = m->seq;
+    __atomic_store_n(&m->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    m->snapshot = status;
+    __atomic_store_n(&m->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+static void _nifmStatusMonitorThreadFunc(void* arg) {
+    NifmStatusMonitor* m = (NifmStatusMonitor*)arg;
+
+    for (;;) {
+        s32 idx = -1;
+        Result rc;
+        if (m->has_request)
+            rc = waitMulti(&idx, m->interval_ns, waiterForUEvent(&m->exit_event), waiterForUEvent(&m->refresh_event), waiterForEvent(&m->request.event_state));
+        else
+            rc = waitMulti(&idx, m->interval_ns, waiterForUEvent(&m->exit_event), waiterForUEvent(&m->refresh_event));
+
+        if (R_SUCCEEDED(rc) && idx == 0)
+            break;
+
+        _nifmStatusMonitorUpdate(m);
+    }
+}
+
+Result nifmStatusMonitorCreate(NifmStatusMonitor* m, s32 requirement_preset, u64 interval_ns, int prio, int cpuid) {
+    Result rc = 0;
+
+    memset(m, 0, sizeof(*m));
+    // 0 disables polling, the thread then only wakes up for the request event and refreshes.
+    m->interval_ns = interval_ns ? interval_ns : UINT64_MAX;
+    ueventCreate(&m->exit_event, false);
+    ueventCreate(&m->refresh_event, true);
+
+    if (requirement_preset) {
+        rc = nifmCreateRequest(&m->request, requirement_preset, true);
+        if (R_SUCCEEDED(rc)) {
+            m->has_request = true;
+            rc = nifmRequestSubmit(&m->request);
+        }
+    }
+
+    if (R_SUCCEEDED(rc)) {
+        _nifmStatusMonitorUpdate(m);
+
+        rc = threadCreate(&m->thread, _nifmStatusMonitorThreadFunc, m, NULL, 0x4000, prio, cpuid);
+        if (R_SUCCEEDED(rc)) {
+            rc = threadStart(&m->thread);
+            if (R_FAILED(rc))
+                threadClose(&m->thread);
+        }
+    }
+
+    if (R_FAILED(rc) && m->has_request)
+        nifmRequestClose(&m->request);
+    return rc;
+}
+
+void nifmStatusMonitorClose(NifmStatusMonitor* m) {
+    ueventSignal(&m->exit_event);
+    threadWaitForExit(&m->thread);
+    threadClose(&m->thread);
+
+    if (m->has_request)
+        nifmRequestClose(&m->request);
+    memset(m, 0, sizeof(*m));
+}
+
+void nifmStatusMonitorRefresh(NifmStatusMonitor* m) {
+    ueventSignal(&m->refresh_event);
+}
+
+void nifmStatusMonitorGet(NifmStatusMonitor* m, NifmStatus* out) {
+    for (;;) {
+        u32 seq = __atomic_load_n(&m->seq, __ATOMIC_ACQUIRE);
+        if (seq & 1)
+            continue;
+
+        *out = m->snapshot;
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&m->seq, __ATOMIC_RELAXED) == seq)
+            break;
+    }
+}
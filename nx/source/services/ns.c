@@ -187,7 +187,7 @@ Result nsListApplicationContentMetaStatus(u64 application_id, s32 index, NsAppli
     );
 }
 
-Result nsGetApplicationControlData(NsApplicationControlSource source, u64 application_id, NsApplicationControlData* buffer, size_t size, u64* actual_size) {
+static Result _nsGetApplicationControlData(Service* srv, NsApplicationControlSource source, u64 application_id, NsApplicationControlData* buffer, size_t size, u64* actual_size) {
     const struct {
         u8 source;
         u64 application_id;
@@ -195,7 +195,7 @@ Result nsGetApplicationControlData(NsApplicationControlSource source, u64 applic
 
     u32 tmp=0;
 
-    Result rc = serviceDispatchInOut(&g_nsAppManSrv, 400, in, tmp,
+    Result rc = serviceDispatchInOut(srv, 400, in, tmp,
         .buffer_attrs = { SfBufferAttr_HipcMapAlias | SfBufferAttr_Out },
         .buffers = { { buffer, size } },
     );
@@ -203,6 +203,25 @@ Result nsGetApplicationControlData(NsApplicationControlSource source, u64 applic
     return rc;
 }
 
+Result nsGetApplicationControlData(NsApplicationControlSource source, u64 application_id, NsApplicationControlData* buffer, size_t size, u64* actual_size) {
+    return _nsGetApplicationControlData(&g_nsAppManSrv, source, application_id, buffer, size, actual_size);
+}
+
+Result nsGetApplicationControlDataWithSession(Service* srv, NsApplicationControlSource source, u64 application_id, NsApplicationControlData* buffer, size_t size, u64* actual_size) {
+    return _nsGetApplicationControlData(srv, source, application_id, buffer, size, actual_size);
+}
+
+Result nsOpenApplicationManagerInterface(Service* srv_out) {
+    if(hosversionBefore(3,0,0))
+        return smGetService(srv_out, "ns:am");
+
+    return _nsGetSession(&g_nsGetterSrv, srv_out, 7996);
+}
+
+Result nsGetApplicationRecordUpdateSystemEvent(Event* out_event) {
+    return _nsCmdGetEvent(&g_nsAppManSrv, out_event, false, 2);
+}
+
 Result nsGetTotalSpaceSize(NcmStorageId storage_id, u64 *size) {
     return _nsCmdInU64OutU64(&g_nsAppManSrv, storage_id, size, 47);
 }
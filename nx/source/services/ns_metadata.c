@@ -0,0 +1,396 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "types.h"
+#include "result.h"
+#include "kernel/svc.h"
+#include "kernel/thread.h"
+#include "services/ns_metadata.h"
+
+#define NS_METADATA_MAGIC 0x434D534E // "NSMC"
+#define NS_METADATA_VERSION 1
+
+typedef struct {
+    u32 magic;
+    u32 version;
+    s32 count;
+    u32 reserved;
+} NsMetadataFileHeader;
+
+typedef struct {
+    NsApplicationRecord record;
+    u32 icon_size;
+    u32 reserved;
+} NsMetadataFileEntry;
+
+// Control data fetches shared by the workers.
+typedef struct {
+    NsMetadataEntry* entries;
+    u32* jobs;
+    u32 num_jobs;
+    u32 next;
+} NsMetadataFetch;
+
+typedef struct {
+    NsMetadataFetch* fetch;
+    Service* srv;
+    Service own_srv;
+    NsApplicationControlData* buffer;
+    Thread thread;
+} NsMetadataWorker;
+
+static void _nsMetadataFreeEntry(NsMetadataEntry* e) {
+    free(e->nacp);
+    e->nacp = NULL;
+    e->icon = NULL;
+    e->icon_size = 0;
+}
+
+static Result _nsMetadataSetData(NsMetadataEntry* e, const NacpStruct* nacp, const void* icon, u32 icon_size) {
+    u8* data = (u8*)malloc(sizeof(NacpStruct) + icon_size);
+    if (!data)
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+
+    memcpy(data, nacp, sizeof(NacpStruct));
+    memcpy(data + sizeof(NacpStruct), icon, icon_size);
+    e->nacp = (NacpStruct*)data;
+    e->icon = data + sizeof(NacpStruct);
+    e->icon_size = icon_size;
+    return 0;
+}
+
+static void _nsMetadataWorkerFunc(void* arg) {
+    NsMetadataWorker* w = (NsMetadataWorker*)arg;
+    NsMetadataFetch* f = w->fetch;
+    u32 i;
+
+    while ((i = __atomic_fetch_add(&f->next, 1, __ATOMIC_RELAXED)) < f->num_jobs) {
+        NsMetadataEntry* e = &f->entries[f->jobs[i]];
+        u64 size = 0;
+
+        Result rc = nsGetApplicationControlDataWithSession(w->srv, NsApplicationControlSource_Storage, e->record.application_id, w->buffer, sizeof(NsApplicationControlData), &size);
+        if (R_SUCCEEDED(rc) && size < sizeof(NacpStruct))
+            rc = MAKERESULT(Module_Libnx, LibnxError_BadInput);
+        if (R_SUCCEEDED(rc))
+            _nsMetadataSetData(e, &w->buffer->nacp, w->buffer->icon, size - sizeof(NacpStruct));
+    }
+}
+
+// Fetches the control data of the listed entries, with one worker per session. The calling thread is the first worker.
+static void _nsMetadataFetch(NsMetadataCache* c, NsMetadataEntry* entries, u32* jobs, u32 num_jobs) {
+    NsMetadataFetch fetch = { entries, jobs, num_jobs, 0 };
+    NsMetadataWorker workers[NS_METADATA_MAX_SESSIONS];
+    u32 num_workers = c->num_sessions < num_jobs ? c->num_sessions : num_jobs;
+    u32 num_started = 1;
+    u32 prio = 0x2C;
+
+    if (!num_workers)
+        return;
+
+    svcGetThreadPriority(&prio, CUR_THREAD_HANDLE);
+    memset(workers, 0, sizeof(workers));
+
+    for (u32 i = 0; i < num_workers; i++) {
+        NsMetadataWorker* w = &workers[i];
+        w->fetch = &fetch;
+        w->buffer = (NsApplicationControlData*)malloc(sizeof(NsApplicationControlData));
+        if (!w->buffer)
+            break;
+
+        if (i == 0) {
+            w->srv = nsGetServiceSession_ApplicationManagerInterface();
+            continue;
+        }
+
+        // Extra sessions are best-effort, the workers that did start take over the remaining jobs.
+        if (R_FAILED(nsOpenApplicationManagerInterface(&w->own_srv))) {
+            free(w->buffer);
+            w->buffer = NULL;
+            break;
+        }
+        w->srv = &w->own_srv;
+
+        Result rc = threadCreate(&w->thread, _nsMetadataWorkerFunc, w, NULL, 0x4000, prio, -2);
+        if (R_SUCCEEDED(rc)) {
+            rc = threadStart(&w->thread);
+            if (R_FAILED(rc))
+                threadClose(&w->thread);
+        }
+        if (R_FAILED(rc)) {
+            serviceClose(&w->own_srv);
+            free(w->buffer);
+            w->buffer = NULL;
+            break;
+        }
+        num_started++;
+    }
+
+    if (workers[0].buffer)
+        _nsMetadataWorkerFunc(&workers[0]);
+
+    for (u32 i = 1; i < num_started; i++) {
+        threadWaitForExit(&workers[i].thread);
+        threadClose(&workers[i].thread);
+        serviceClose(&workers[i].own_srv);
+    }
+
+    for (u32 i = 0; i < num_workers; i++)
+        free(workers[i].buffer);
+}
+
+static int _nsMetadataCompareId(const void* a, const void* b) {
+    u64 id_a = (*(const NsMetadataEntry* const*)a)->record.application_id;
+    u64 id_b = (*(const NsMetadataEntry* const*)b)->record.application_id;
+    return id_a < id_b ? -1 : id_a > id_b;
+}
+
+static NsMetadataEntry* _nsMetadataSearch(NsMetadataEntry** sorted, s32 count, u64 application_id) {
+    s32 lo = 0, hi = count;
+
+    while (lo < hi) {
+        s32 mid = (lo + hi) / 2;
+        u64 id = sorted[mid]->record.application_id;
+        if (id == application_id)
+            return sorted[mid];
+        if (id < application_id)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return NULL;
+}
+
+static Result _nsMetadataListRecords(NsApplicationRecord** out_records, s32* out_count) {
+    NsApplicationRecord* records = NULL;
+    s32 count = 0, capacity = 0;
+    Result rc = 0;
+
+    for (;;) {
+        if (count == capacity) {
+            capacity = capacity ? capacity*2 : 256;
+            NsApplicationRecord* tmp = (NsApplicationRecord*)realloc(records, capacity * sizeof(NsApplicationRecord));
+            if (!tmp) {
+                rc = MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+                break;
+            }
+            records = tmp;
+        }
+
+        s32 requested = capacity - count, total = 0;
+        rc = nsListApplicationRecord(&records[count], requested, count, &total);
+        if (R_FAILED(rc))
+            break;
+
+        count += total;
+        if (total < requested)
+            break;
+    }
+
+    if (R_FAILED(rc)) {
+        free(records);
+        return rc;
+    }
+
+    *out_records = records;
+    *out_count = count;
+    return 0;
+}
+
+Result nsMetadataCacheRefresh(NsMetadataCache* c, bool* out_changed) {
+    NsApplicationRecord* records = NULL;
+    s32 count = 0;
+    bool changed = false;
+
+    Result rc = _nsMetadataListRecords(&records, &count);
+    if (R_FAILED(rc))
+        return rc;
+
+    NsMetadataEntry* entries = (NsMetadataEntry*)calloc(count ? count : 1, sizeof(NsMetadataEntry));
+    NsMetadataEntry** sorted = (NsMetadataEntry**)malloc((c->count ? c->count : 1) * sizeof(NsMetadataEntry*));
+    u32* jobs = (u32*)malloc((count ? count : 1) * sizeof(u32));
+    if (!entries || !sorted || !jobs) {
+        free(records);
+        free(entries);
+        free(sorted);
+        free(jobs);
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+    }
+
+    for (s32 i = 0; i < c->count; i++)
+        sorted[i] = &c->entries[i];
+    qsort(sorted, c->count, sizeof(NsMetadataEntry*), _nsMetadataCompareId);
+
+    // Keep the metadata of the unchanged records, fetch the others.
+    u32 num_jobs = 0;
+    for (s32 i = 0; i < count; i++) {
+        NsMetadataEntry* e = &entries[i];
+        NsMetadataEntry* old = _nsMetadataSearch(sorted, c->count, records[i].application_id);
+
+        e->record = records[i];
+        if (old && old->nacp && memcmp(&old->record, &records[i], sizeof(NsApplicationRecord)) == 0) {
+            *e = *old;
+            old->nacp = NULL;
+            if (old != &c->entries[i])
+                changed = true;
+        }
+        else
+            jobs[num_jobs++] = i;
+    }
+
+    if (num_jobs) {
+        changed = true;
+        _nsMetadataFetch(c, entries, jobs, num_jobs);
+    }
+
+    for (s32 i = 0; i < c->count; i++) {
+        if (c->entries[i].nacp)
+            changed = true;
+        _nsMetadataFreeEntry(&c->entries[i]);
+    }
+    if (count != c->count)
+        changed = true;
+
+    free(c->entries);
+    c->entries = entries;
+    c->count = count;
+    c->dirty |= changed;
+
+    free(records);
+    free(sorted);
+    free(jobs);
+
+    if (out_changed) *out_changed = changed;
+    return 0;
+}
+
+Result nsMetadataCacheUpdate(NsMetadataCache* c, bool* out_changed) {
+    if (out_changed) *out_changed = false;
+
+    if (R_FAILED(eventWait(&c->record_event, 0)))
+        return 0;
+
+    eventClear(&c->record_event);
+    return nsMetadataCacheRefresh(c, out_changed);
+}
+
+const NsMetadataEntry* nsMetadataCacheFind(NsMetadataCache* c, u64 application_id) {
+    for (s32 i = 0; i < c->count; i++) {
+        if (c->entries[i].record.application_id == application_id)
+            return &c->entries[i];
+    }
+    return NULL;
+}
+
+static void _nsMetadataLoad(NsMetadataCache* c) {
+    NsMetadataFileHeader header;
+    FILE* f = fopen(c->path, "rb");
+    if (!f)
+        return;
+
+    if (fread(&header, sizeof(header), 1, f) != 1 || header.magic != NS_METADATA_MAGIC || header.version != NS_METADATA_VERSION || header.count < 0) {
+        fclose(f);
+        return;
+    }
+
+    NacpStruct* nacp = (NacpStruct*)malloc(sizeof(NacpStruct));
+    u8* icon = (u8*)malloc(sizeof(((NsApplicationControlData*)0)->icon));
+    c->entries = (NsMetadataEntry*)calloc(header.count ? header.count : 1, sizeof(NsMetadataEntry));
+
+    // Entries are read until the first invalid one, the others are fetched again.
+    s32 count = 0;
+    while (nacp && icon && c->entries && count < header.count) {
+        NsMetadataFileEntry fe;
+        if (fread(&fe, sizeof(fe), 1, f) != 1 || fe.icon_size > sizeof(((NsApplicationControlData*)0)->icon))
+            break;
+        if (fread(nacp, sizeof(NacpStruct), 1, f) != 1 || fread(icon, 1, fe.icon_size, f) != fe.icon_size)
+            break;
+
+        NsMetadataEntry* e = &c->entries[count];
+        e->record = fe.record;
+        if (R_FAILED(_nsMetadataSetData(e, nacp, icon, fe.icon_size)))
+            break;
+        count++;
+    }
+    c->count = count;
+
+    free(nacp);
+    free(icon);
+    fclose(f);
+}
+
+Result nsMetadataCacheSave(NsMetadataCache* c) {
+    if (!c->path)
+        return 0;
+
+    FILE* f = fopen(c->path, "wb");
+    if (!f)
+        return MAKERESULT(Module_Libnx, LibnxError_IoError);
+
+    NsMetadataFileHeader header = { NS_METADATA_MAGIC, NS_METADATA_VERSION, 0, 0 };
+    for (s32 i = 0; i < c->count; i++) {
+        if (c->entries[i].nacp)
+            header.count++;
+    }
+
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+    for (s32 i = 0; ok && i < c->count; i++) {
+        NsMetadataEntry* e = &c->entries[i];
+        if (!e->nacp)
+            continue;
+
+        NsMetadataFileEntry fe = { e->record, e->icon_size, 0 };
+        ok = fwrite(&fe, sizeof(fe), 1, f) == 1 && fwrite(e->nacp, sizeof(NacpStruct), 1, f) == 1 && fwrite(e->icon, 1, e->icon_size, f) == e->icon_size;
+    }
+
+    if (fclose(f) != 0)
+        ok = false;
+    if (!ok)
+        return MAKERESULT(Module_Libnx, LibnxError_IoError);
+
+    c->dirty = false;
+    return 0;
+}
+
+Result nsMetadataCacheCreate(NsMetadataCache* c, const char* path, u32 num_sessions) {
+    if (!num_sessions || num_sessions > NS_METADATA_MAX_SESSIONS)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    memset(c, 0, sizeof(*c));
+    c->num_sessions = num_sessions;
+
+    if (path) {
+        c->path = strdup(path);
+        if (!c->path)
+            return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+        _nsMetadataLoad(c);
+    }
+
+    Result rc = nsGetApplicationRecordUpdateSystemEvent(&c->record_event);
+
+    if (R_SUCCEEDED(rc))
+        rc = nsMetadataCacheRefresh(c, NULL);
+
+    // Failing to write the cache file only costs the next startup.
+    if (R_SUCCEEDED(rc) && c->dirty)
+        nsMetadataCacheSave(c);
+
+    if (R_FAILED(rc)) {
+        free(c->path);
+        c->path = NULL;
+        nsMetadataCacheClose(c);
+    }
+
+    return rc;
+}
+
+void nsMetadataCacheClose(NsMetadataCache* c) {
+    if (c->dirty)
+        nsMetadataCacheSave(c);
+
+    for (s32 i = 0; i < c->count; i++)
+        _nsMetadataFreeEntry(&c->entries[i]);
+    free(c->entries);
+    free(c->path);
+    eventClose(&c->record_event);
+    memset(c, 0, sizeof(*c));
+}
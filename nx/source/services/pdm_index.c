@@ -0,0 +1,245 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "types.h"
+#include "result.h"
+#include "services/applet.h"
+#include "services/pdm_index.h"
+
+#define PDM_INDEX_MAGIC 0x58495050 // "PPIX"
+#define PDM_INDEX_VERSION 1
+#define PDM_INDEX_PAGE_EVENTS 0x800
+
+typedef struct {
+    u32 magic;
+    u32 version;
+    u32 count;
+    s32 next_entry_index;
+    u64 focus_application_id;
+    u64 focus_start;
+} PdmPlayIndexFileHeader;
+
+static void _pdmPlayIndexReset(PdmPlayIndex* idx) {
+    idx->count = 0;
+    idx->next_entry_index = 0;
+    idx->focus_application_id = 0;
+    idx->focus_start = 0;
+}
+
+static u32 _pdmPlayIndexSearch(PdmPlayIndex* idx, u64 application_id) {
+    u32 lo = 0, hi = idx->count;
+
+    while (lo < hi) {
+        u32 mid = (lo + hi) / 2;
+        if (idx->entries[mid].application_id < application_id)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+static PdmPlayIndexEntry* _pdmPlayIndexGet(PdmPlayIndex* idx, u64 application_id) {
+    u32 pos = _pdmPlayIndexSearch(idx, application_id);
+    if (pos < idx->count && idx->entries[pos].application_id == application_id)
+        return &idx->entries[pos];
+
+    if (idx->count == idx->capacity) {
+        u32 capacity = idx->capacity ? idx->capacity * 2 : 64;
+        PdmPlayIndexEntry* tmp = (PdmPlayIndexEntry*)realloc(idx->entries, capacity * sizeof(PdmPlayIndexEntry));
+        if (!tmp)
+            return NULL;
+        idx->entries = tmp;
+        idx->capacity = capacity;
+    }
+
+    memmove(&idx->entries[pos + 1], &idx->entries[pos], (idx->count - pos) * sizeof(PdmPlayIndexEntry));
+    idx->count++;
+
+    PdmPlayIndexEntry* e = &idx->entries[pos];
+    memset(e, 0, sizeof(*e));
+    e->application_id = application_id;
+    return e;
+}
+
+static void _pdmPlayIndexEndFocus(PdmPlayIndex* idx, u64 timestamp) {
+    if (!idx->focus_application_id)
+        return;
+
+    PdmPlayIndexEntry* e = _pdmPlayIndexGet(idx, idx->focus_application_id);
+    if (e && timestamp > idx->focus_start)
+        e->playtime += timestamp - idx->focus_start;
+    idx->focus_application_id = 0;
+}
+
+static void _pdmPlayIndexAddEvent(PdmPlayIndex* idx, const PdmPlayEvent* ev, s32 entry_index) {
+    // Sleep and boots also end the focus of the application, without an applet event.
+    if (ev->playEventType == PdmPlayEventType_PowerStateChange || ev->playEventType == PdmPlayEventType_Initialize) {
+        _pdmPlayIndexEndFocus(idx, ev->timestampSteady);
+        return;
+    }
+
+    if (ev->playEventType != PdmPlayEventType_Applet || ev->eventData.applet.appletId != AppletId_application || ev->eventData.applet.logPolicy != PdmPlayLogPolicy_All)
+        return;
+
+    u64 application_id = ((u64)ev->eventData.applet.program_id[0] << 32) | ev->eventData.applet.program_id[1];
+    PdmPlayIndexEntry* e = _pdmPlayIndexGet(idx, application_id);
+    if (!e)
+        return;
+
+    // Entry 0 is the ::PdmPlayEventType_Initialize event, so this is only 0 for applications not seen yet.
+    if (!e->last_entry_index) {
+        e->first_entry_index = entry_index;
+        e->first_timestamp = ev->timestampUser;
+    }
+    e->last_entry_index = entry_index;
+    e->last_timestamp = ev->timestampUser;
+
+    switch (ev->eventData.applet.eventType) {
+        case PdmAppletEventType_Launch:
+            e->launches++;
+            break;
+
+        case PdmAppletEventType_InFocus:
+            _pdmPlayIndexEndFocus(idx, ev->timestampSteady);
+            idx->focus_application_id = application_id;
+            idx->focus_start = ev->timestampSteady;
+            break;
+
+        default:
+            if (idx->focus_application_id == application_id)
+                _pdmPlayIndexEndFocus(idx, ev->timestampSteady);
+            break;
+    }
+}
+
+Result pdmPlayIndexUpdate(PdmPlayIndex* idx, bool* out_changed) {
+    s32 total = 0, start = 0, end = 0;
+    bool changed = false;
+
+    Result rc = pdmqryGetAvailablePlayEventRange(&total, &start, &end);
+    if (R_FAILED(rc))
+        return rc;
+
+    // Entry indices only grow, unless the log was reset.
+    if (idx->next_entry_index > end + 1) {
+        _pdmPlayIndexReset(idx);
+        changed = true;
+    }
+    if (idx->next_entry_index < start)
+        idx->next_entry_index = start;
+
+    if (total > 0 && idx->next_entry_index <= end) {
+        PdmPlayEvent* events = (PdmPlayEvent*)malloc(PDM_INDEX_PAGE_EVENTS * sizeof(PdmPlayEvent));
+        if (!events)
+            return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+
+        while (idx->next_entry_index <= end) {
+            s32 count = 0;
+            rc = pdmqryQueryPlayEvent(idx->next_entry_index, events, PDM_INDEX_PAGE_EVENTS, &count);
+            if (R_FAILED(rc) || count <= 0)
+                break;
+
+            for (s32 i = 0; i < count; i++)
+                _pdmPlayIndexAddEvent(idx, &events[i], idx->next_entry_index + i);
+            idx->next_entry_index += count;
+            changed = true;
+        }
+
+        free(events);
+    }
+
+    if (changed)
+        idx->dirty = true;
+    if (out_changed)
+        *out_changed = changed;
+    return rc;
+}
+
+const PdmPlayIndexEntry* pdmPlayIndexFind(PdmPlayIndex* idx, u64 application_id) {
+    u32 pos = _pdmPlayIndexSearch(idx, application_id);
+    if (pos < idx->count && idx->entries[pos].application_id == application_id)
+        return &idx->entries[pos];
+    return NULL;
+}
+
+static void _pdmPlayIndexLoad(PdmPlayIndex* idx) {
+    PdmPlayIndexFileHeader header;
+    FILE* f = fopen(idx->path, "rb");
+    if (!f)
+        return;
+
+    if (fread(&header, sizeof(header), 1, f) != 1 || header.magic != PDM_INDEX_MAGIC || header.version != PDM_INDEX_VERSION || header.next_entry_index < 0) {
+        fclose(f);
+        return;
+    }
+
+    idx->entries = (PdmPlayIndexEntry*)malloc((header.count ? header.count : 1) * sizeof(PdmPlayIndexEntry));
+    if (idx->entries) {
+        idx->capacity = header.count ? header.count : 1;
+
+        // A truncated file is dropped as a whole: the events it was built from would be missed otherwise.
+        if (fread(idx->entries, sizeof(PdmPlayIndexEntry), header.count, f) == header.count) {
+            idx->count = header.count;
+            idx->next_entry_index = header.next_entry_index;
+            idx->focus_application_id = header.focus_application_id;
+            idx->focus_start = header.focus_start;
+        }
+    }
+
+    fclose(f);
+}
+
+Result pdmPlayIndexSave(PdmPlayIndex* idx) {
+    if (!idx->path)
+        return 0;
+
+    FILE* f = fopen(idx->path, "wb");
+    if (!f)
+        return MAKERESULT(Module_Libnx, LibnxError_IoError);
+
+    PdmPlayIndexFileHeader header = { PDM_INDEX_MAGIC, PDM_INDEX_VERSION, idx->count, idx->next_entry_index, idx->focus_application_id, idx->focus_start };
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1 && fwrite(idx->entries, sizeof(PdmPlayIndexEntry), idx->count, f) == idx->count;
+
+    if (fclose(f) != 0)
+        ok = false;
+    if (!ok)
+        return MAKERESULT(Module_Libnx, LibnxError_IoError);
+
+    idx->dirty = false;
+    return 0;
+}
+
+Result pdmPlayIndexCreate(PdmPlayIndex* idx, const char* path) {
+    memset(idx, 0, sizeof(*idx));
+
+    if (path) {
+        idx->path = strdup(path);
+        if (!idx->path)
+            return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+        _pdmPlayIndexLoad(idx);
+    }
+
+    Result rc = pdmPlayIndexUpdate(idx, NULL);
+
+    // Failing to write the index file only costs the next startup.
+    if (R_SUCCEEDED(rc) && idx->dirty)
+        pdmPlayIndexSave(idx);
+
+    if (R_FAILED(rc)) {
+        free(idx->path);
+        idx->path = NULL;
+        pdmPlayIndexClose(idx);
+    }
+
+    return rc;
+}
+
+void pdmPlayIndexClose(PdmPlayIndex* idx) {
+    if (idx->dirty)
+        pdmPlayIndexSave(idx);
+
+    free(idx->entries);
+    free(idx->path);
+    memset(idx, 0, sizeof(*idx));
+}
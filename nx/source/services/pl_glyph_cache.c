@@ -0,0 +1,227 @@
+#include <string.h>
+#include <malloc.h>
+#include "types.h"
+#include "result.h"
+#include "services/pl_glyph_cache.h"
+
+#define PL_GLYPH_CACHE_INVALID UINT32_MAX
+
+static inline u32 _plGlyphCacheKey(PlSharedFontType font, u32 codepoint, u32 size) {
+    return (codepoint & 0x1FFFFF) | ((u32)font << 21) | (size << 24);
+}
+
+static inline u32 _plGlyphCacheHash(PlGlyphCache* c, u32 key) {
+    key ^= key >> 15;
+    key *= 0x2C1B3C6D;
+    key ^= key >> 12;
+    return key & c->bucket_mask;
+}
+
+Result plGlyphCacheCreate(PlGlyphCache* c, const PlGlyphCacheConfig* config) {
+    if (!config->rasterize || !config->cell_width || !config->cell_height || !config->columns || !config->rows)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+    if (config->cell_width * config->columns > 0x10000 || config->cell_height * config->rows > 0x10000 || ((uintptr_t)config->atlas & 0xFFF))
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    memset(c, 0, sizeof(*c));
+    c->rasterize = config->rasterize;
+    c->userdata = config->userdata;
+    c->cell_width = config->cell_width;
+    c->cell_height = config->cell_height;
+    c->columns = config->columns;
+    c->atlas_width = config->cell_width * config->columns;
+    c->atlas_height = config->cell_height * config->rows;
+    c->pitch = (c->atlas_width + 63) & ~63;
+    c->num_entries = config->columns * config->rows;
+    c->lru_head = c->lru_tail = PL_GLYPH_CACHE_INVALID;
+    c->frame = 1;
+
+    u32 num_buckets = 1;
+    while (num_buckets < 2*c->num_entries)
+        num_buckets <<= 1;
+    c->bucket_mask = num_buckets - 1;
+
+    size_t atlas_size = plGlyphCacheGetAtlasSize(config);
+    c->atlas = (u8*)config->atlas;
+    if (!c->atlas) {
+        c->atlas = (u8*)memalign(0x1000, atlas_size);
+        c->atlas_allocated = true;
+    }
+    c->entries = (PlGlyphCacheEntry*)malloc(c->num_entries * sizeof(PlGlyphCacheEntry));
+    c->buckets = (u32*)malloc(num_buckets * sizeof(u32));
+
+    if (!c->atlas || !c->entries || !c->buckets) {
+        plGlyphCacheClose(c);
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+    }
+
+    memset(c->atlas, 0, atlas_size);
+    memset(c->buckets, 0xFF, num_buckets * sizeof(u32));
+    for (u32 i = 0; i < c->num_entries; i++) {
+        PlGlyphCacheEntry* e = &c->entries[i];
+        e->key = PL_GLYPH_CACHE_INVALID;
+        e->x = (i % c->columns) * c->cell_width;
+        e->y = (i / c->columns) * c->cell_height;
+    }
+
+    c->dirty_y0 = 0;
+    c->dirty_y1 = c->atlas_height;
+    return 0;
+}
+
+void plGlyphCacheClose(PlGlyphCache* c) {
+    if (c->atlas_allocated)
+        free(c->atlas);
+    free(c->entries);
+    free(c->buckets);
+    memset(c, 0, sizeof(*c));
+}
+
+static void _plGlyphCacheLruUnlink(PlGlyphCache* c, u32 index) {
+    PlGlyphCacheEntry* e = &c->entries[index];
+
+    if (e->lru_prev != PL_GLYPH_CACHE_INVALID) c->entries[e->lru_prev].lru_next = e->lru_next;
+    else c->lru_head = e->lru_next;
+    if (e->lru_next != PL_GLYPH_CACHE_INVALID) c->entries[e->lru_next].lru_prev = e->lru_prev;
+    else c->lru_tail = e->lru_prev;
+}
+
+static void _plGlyphCacheLruPushFront(PlGlyphCache* c, u32 index) {
+    PlGlyphCacheEntry* e = &c->entries[index];
+
+    e->lru_prev = PL_GLYPH_CACHE_INVALID;
+    e->lru_next = c->lru_head;
+    if (c->lru_head != PL_GLYPH_CACHE_INVALID) c->entries[c->lru_head].lru_prev = index;
+    else c->lru_tail = index;
+    c->lru_head = index;
+}
+
+static void _plGlyphCacheLruPushBack(PlGlyphCache* c, u32 index) {
+    PlGlyphCacheEntry* e = &c->entries[index];
+
+    e->lru_next = PL_GLYPH_CACHE_INVALID;
+    e->lru_prev = c->lru_tail;
+    if (c->lru_tail != PL_GLYPH_CACHE_INVALID) c->entries[c->lru_tail].lru_next = index;
+    else c->lru_head = index;
+    c->lru_tail = index;
+}
+
+static void _plGlyphCacheHashRemove(PlGlyphCache* c, u32 index) {
+    u32* link = &c->buckets[_plGlyphCacheHash(c, c->entries[index].key)];
+
+    while (*link != index)
+        link = &c->entries[*link].hash_next;
+    *link = c->entries[index].hash_next;
+}
+
+// Takes a free entry, or evicts the least recently used one.
+static Result _plGlyphCacheAllocEntry(PlGlyphCache* c, u32* out_index) {
+    if (c->num_used < c->num_entries) {
+        *out_index = c->num_used;
+        return 0;
+    }
+
+    u32 index = c->lru_tail;
+    PlGlyphCacheEntry* e = &c->entries[index];
+    if (e->frame == c->frame)
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+
+    _plGlyphCacheLruUnlink(c, index);
+    if (e->key != PL_GLYPH_CACHE_INVALID) {
+        _plGlyphCacheHashRemove(c, index);
+        e->key = PL_GLYPH_CACHE_INVALID;
+        c->evictions++;
+    }
+
+    *out_index = index;
+    return 0;
+}
+
+static Result _plGlyphCacheLoadFont(PlGlyphCache* c, PlSharedFontType font) {
+    if (c->loaded_fonts & BIT(font))
+        return 0;
+
+    Result rc = plGetSharedFontByType(&c->fonts[font], font);
+    if (R_SUCCEEDED(rc))
+        c->loaded_fonts |= BIT(font);
+    return rc;
+}
+
+Result plGlyphCacheLookup(PlGlyphCache* c, PlSharedFontType font, u32 codepoint, u32 size, const PlGlyphCacheEntry** out) {
+    if ((u32)font >= PlSharedFontType_Total || codepoint > 0x10FFFF || !size || size > PL_GLYPH_CACHE_MAX_SIZE)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    u32 key = _plGlyphCacheKey(font, codepoint, size);
+    u32* bucket = &c->buckets[_plGlyphCacheHash(c, key)];
+
+    for (u32 index = *bucket; index != PL_GLYPH_CACHE_INVALID; index = c->entries[index].hash_next) {
+        PlGlyphCacheEntry* e = &c->entries[index];
+        if (e->key != key)
+            continue;
+
+        c->hits++;
+        e->frame = c->frame;
+        if (c->lru_head != index) {
+            _plGlyphCacheLruUnlink(c, index);
+            _plGlyphCacheLruPushFront(c, index);
+        }
+        *out = e;
+        return 0;
+    }
+
+    c->misses++;
+
+    Result rc = _plGlyphCacheLoadFont(c, font);
+    if (R_FAILED(rc))
+        return rc;
+
+    u32 index;
+    rc = _plGlyphCacheAllocEntry(c, &index);
+    if (R_FAILED(rc))
+        return rc;
+
+    PlGlyphCacheEntry* e = &c->entries[index];
+    u8* dst = &c->atlas[(size_t)e->y * c->pitch + e->x];
+    for (u32 y = 0; y < c->cell_height; y++)
+        memset(&dst[(size_t)y * c->pitch], 0, c->cell_width);
+
+    memset(&e->metrics, 0, sizeof(e->metrics));
+    rc = c->rasterize(c->userdata, &c->fonts[font], codepoint, size, dst, c->pitch, c->cell_width, c->cell_height, &e->metrics);
+
+    if (e->y < c->dirty_y0) c->dirty_y0 = e->y;
+    if (e->y + c->cell_height > c->dirty_y1) c->dirty_y1 = e->y + c->cell_height;
+
+    if (R_FAILED(rc)) {
+        // Entries taken from the LRU list go back to its end, to be reused first.
+        if (index < c->num_used)
+            _plGlyphCacheLruPushBack(c, index);
+        return rc;
+    }
+
+    if (e->metrics.width > c->cell_width) e->metrics.width = c->cell_width;
+    if (e->metrics.height > c->cell_height) e->metrics.height = c->cell_height;
+
+    if (index == c->num_used)
+        c->num_used++;
+
+    e->key = key;
+    e->frame = c->frame;
+    e->hash_next = *bucket;
+    *bucket = index;
+    _plGlyphCacheLruPushFront(c, index);
+
+    *out = e;
+    return 0;
+}
+
+Result plGlyphCacheLookupFallback(PlGlyphCache* c, const PlSharedFontType* fonts, u32 num_fonts, u32 codepoint, u32 size, const PlGlyphCacheEntry** out) {
+    Result rc = MAKERESULT(Module_Libnx, LibnxError_NotFound);
+
+    for (u32 i = 0; i < num_fonts; i++) {
+        rc = plGlyphCacheLookup(c, fonts[i], codepoint, size, out);
+        if (R_SUCCEEDED(rc) || rc != MAKERESULT(Module_Libnx, LibnxError_NotFound))
+            break;
+    }
+
+    return rc;
+}
@@ -0,0 +1,137 @@
+#include <malloc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "types.h"
+#include "result.h"
+#include "nro.h"
+#include "kernel/svc.h"
+#include "crypto/sha256.h"
+#include "services/ro_plugin.h"
+
+static Result _roPluginRead(RoPluginModule* m, const char* path) {
+    Result rc = 0;
+    struct {
+        NroStart start;
+        NroHeader header;
+    } hdr;
+
+    FILE* f = fopen(path, "rb");
+    if (!f)
+        return MAKERESULT(Module_Libnx, LibnxError_NotFound);
+
+    // Unbuffered: the image is read straight into its final page-aligned buffer with one read.
+    setvbuf(f, NULL, _IONBF, 0);
+
+    if (fread(&hdr, sizeof(hdr), 1, f) != 1)
+        rc = MAKERESULT(Module_Libnx, LibnxError_IoError);
+    else if (hdr.header.magic != NROHEADER_MAGIC || hdr.header.size < sizeof(hdr) || (hdr.header.size & 0xFFF))
+        rc = MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    if (R_SUCCEEDED(rc)) {
+        m->image_size = hdr.header.size;
+        m->image = memalign(0x1000, m->image_size);
+        m->bss_size = (hdr.header.bss_size + 0xFFF) & ~0xFFF;
+        if (m->bss_size)
+            m->bss = memalign(0x1000, m->bss_size);
+
+        if (!m->image || (m->bss_size && !m->bss))
+            rc = MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+    }
+
+    if (R_SUCCEEDED(rc)) {
+        if (fseek(f, 0, SEEK_SET) != 0 || fread(m->image, 1, m->image_size, f) != m->image_size)
+            rc = MAKERESULT(Module_Libnx, LibnxError_IoError);
+    }
+
+    fclose(f);
+    return rc;
+}
+
+static int _roPluginHashCompare(const void* a, const void* b) {
+    return memcmp(a, b, SHA256_HASH_SIZE);
+}
+
+static Result _roPluginBuildNrr(RoPluginSet* s) {
+    void* dsts[RO_PLUGIN_MAX_MODULES];
+    const void* srcs[RO_PLUGIN_MAX_MODULES];
+    size_t sizes[RO_PLUGIN_MAX_MODULES];
+
+    u64 program_id = 0;
+    Result rc = svcGetInfo(&program_id, InfoType_ProgramId, CUR_PROCESS_HANDLE, 0);
+    if (R_FAILED(rc))
+        return rc;
+
+    s->nrr_size = (sizeof(NrrHeader) + s->count * SHA256_HASH_SIZE + 0xFFF) & ~0xFFF;
+    s->nrr = memalign(0x1000, s->nrr_size);
+    if (!s->nrr)
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+    memset(s->nrr, 0, s->nrr_size);
+
+    NrrHeader* header = (NrrHeader*)s->nrr;
+    header->magic = NRRHEADER_MAGIC;
+    header->program_id = program_id;
+    header->size = s->nrr_size;
+    header->hashes_offset = sizeof(NrrHeader);
+    header->num_hashes = s->count;
+
+    u8* hashes = (u8*)s->nrr + header->hashes_offset;
+    for (u32 i = 0; i < s->count; i++) {
+        dsts[i] = hashes + i * SHA256_HASH_SIZE;
+        srcs[i] = s->modules[i].image;
+        sizes[i] = s->modules[i].image_size;
+    }
+    sha256CalculateHashesBatch(dsts, srcs, sizes, s->count);
+
+    // ro binary-searches the hashes.
+    qsort(hashes, s->count, SHA256_HASH_SIZE, _roPluginHashCompare);
+    return 0;
+}
+
+Result roPluginSetLoad(RoPluginSet* s, const char* const* paths, u32 count) {
+    Result rc = 0;
+
+    if (!count || count > RO_PLUGIN_MAX_MODULES)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    memset(s, 0, sizeof(*s));
+    s->count = count;
+
+    for (u32 i = 0; R_SUCCEEDED(rc) && i < count; i++)
+        rc = _roPluginRead(&s->modules[i], paths[i]);
+
+    if (R_SUCCEEDED(rc))
+        rc = _roPluginBuildNrr(s);
+
+    if (R_SUCCEEDED(rc)) {
+        rc = ldrRoLoadNrr((u64)s->nrr, s->nrr_size);
+        s->nrr_registered = R_SUCCEEDED(rc);
+    }
+
+    for (u32 i = 0; R_SUCCEEDED(rc) && i < count; i++) {
+        RoPluginModule* m = &s->modules[i];
+        rc = ldrRoLoadNro(&m->base, (u64)m->image, m->image_size, (u64)m->bss, m->bss_size);
+        if (R_FAILED(rc))
+            m->base = 0;
+    }
+
+    if (R_FAILED(rc))
+        roPluginSetUnload(s);
+    return rc;
+}
+
+void roPluginSetUnload(RoPluginSet* s) {
+    for (u32 i = s->count; i--;) {
+        RoPluginModule* m = &s->modules[i];
+        if (m->base)
+            ldrRoUnloadNro(m->base);
+        free(m->image);
+        free(m->bss);
+    }
+
+    if (s->nrr_registered)
+        ldrRoUnloadNrr((u64)s->nrr);
+    free(s->nrr);
+
+    memset(s, 0, sizeof(*s));
+}
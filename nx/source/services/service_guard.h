@@ -8,6 +8,7 @@
 typedef struct ServiceGuard {
     Mutex mutex;
     u32 refCount;
+    bool lazy;
 } ServiceGuard;
 
 NX_INLINE bool serviceGuardBeginInit(ServiceGuard* g)
@@ -31,9 +32,41 @@ NX_INLINE void serviceGuardExit(ServiceGuard* g, void (*cleanupFunc)(void))
     mutexLock(&g->mutex);
     if (g->refCount && (--g->refCount) == 0)
         cleanupFunc();
+    g->lazy = false;
     mutexUnlock(&g->mutex);
 }
 
+NX_INLINE void serviceGuardSetLazy(ServiceGuard* g)
+{
+    mutexLock(&g->mutex);
+    if (!g->refCount)
+        __atomic_store_n(&g->lazy, true, __ATOMIC_RELEASE);
+    mutexUnlock(&g->mutex);
+}
+
+// Performs an initialization deferred with serviceGuardSetLazy, taking the reference the deferred Initialize call would have taken.
+// initFunc must not call back into the functions performing the lazy initialization.
+NX_INLINE Result serviceGuardLazyInit(ServiceGuard* g, Result (*initFunc)(void), void (*cleanupFunc)(void))
+{
+    if (!__atomic_load_n(&g->lazy, __ATOMIC_ACQUIRE))
+        return 0;
+
+    Result rc = 0;
+    mutexLock(&g->mutex);
+    if (g->lazy) {
+        if ((g->refCount++) == 0)
+            rc = initFunc();
+        if (R_FAILED(rc)) {
+            cleanupFunc();
+            --g->refCount;
+        }
+        // Cleared last, so that other threads wait on the mutex until initialization is done.
+        __atomic_store_n(&g->lazy, false, __ATOMIC_RELEASE);
+    }
+    mutexUnlock(&g->mutex);
+    return rc;
+}
+
 #define NX_GENERATE_SERVICE_GUARD_PARAMS(name, _paramdecl, _parampass) \
 \
 static ServiceGuard g_##name##Guard; \
@@ -54,3 +87,15 @@ void name##Exit(void) \
 }
 
 #define NX_GENERATE_SERVICE_GUARD(name) NX_GENERATE_SERVICE_GUARD_PARAMS(name, (void), ())
+
+#define NX_GENERATE_SERVICE_GUARD_LAZY(name) \
+\
+void name##InitializeLazy(void) \
+{ \
+    serviceGuardSetLazy(&g_##name##Guard); \
+} \
+\
+NX_INLINE Result _##name##LazyInit(void) \
+{ \
+    return serviceGuardLazyInit(&g_##name##Guard, _##name##Initialize, _##name##Cleanup); \
+}
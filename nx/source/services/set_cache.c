@@ -0,0 +1,143 @@
+#include <string.h>
+#include "types.h"
+#include "result.h"
+#include "arm/counter.h"
+#include "services/set_cache.h"
+
+Result setCacheCreate(SetCache* c, u64 ttl) {
+    memset(c, 0, sizeof(*c));
+    mutexInit(&c->mutex);
+    c->ttl = armNsToTicks(ttl);
+
+    // Without setsys, only the TTL and explicit invalidation apply.
+    if (serviceIsActive(setsysGetServiceSession()))
+        c->has_event = R_SUCCEEDED(setsysBindFatalDirtyFlagEvent(&c->dirty_event));
+
+    return 0;
+}
+
+void setCacheClose(SetCache* c) {
+    if (c->has_event)
+        eventClose(&c->dirty_event);
+    memset(c, 0, sizeof(*c));
+}
+
+static void _setCacheInvalidate(SetCache* c) {
+    c->language_slot.valid = false;
+    c->region_slot.valid = false;
+    for (u32 i = 0; i < SET_CACHE_MAX_ITEMS; i++)
+        c->items[i].slot.valid = false;
+}
+
+void setCacheInvalidate(SetCache* c) {
+    mutexLock(&c->mutex);
+    _setCacheInvalidate(c);
+    mutexUnlock(&c->mutex);
+}
+
+// Drops everything when a change was signaled. The event is only checked every SET_CACHE_POLL_INTERVAL, since the point is to avoid syscalls.
+static void _setCachePoll(SetCache* c, u64 now) {
+    if (!c->has_event || now - c->poll_tick < armNsToTicks(SET_CACHE_POLL_INTERVAL))
+        return;
+
+    c->poll_tick = now;
+    if (R_SUCCEEDED(eventWait(&c->dirty_event, 0))) {
+        u64 flags_0, flags_1;
+        eventClear(&c->dirty_event);
+        setsysGetFatalDirtyFlags(&flags_0, &flags_1);
+        _setCacheInvalidate(c);
+    }
+}
+
+static bool _setCacheSlotIsValid(SetCache* c, SetCacheSlot* slot, u64 now) {
+    return slot->valid && (!c->ttl || now - slot->tick < c->ttl);
+}
+
+Result setCacheGetSystemLanguage(SetCache* c, u64 *LanguageCode) {
+    Result rc = 0;
+    u64 now = armGetSystemTick();
+
+    mutexLock(&c->mutex);
+    _setCachePoll(c, now);
+    if (!_setCacheSlotIsValid(c, &c->language_slot, now)) {
+        rc = setGetSystemLanguage(&c->language_code);
+        c->language_slot = (SetCacheSlot){ .valid = R_SUCCEEDED(rc), .tick = now };
+    }
+    if (R_SUCCEEDED(rc))
+        *LanguageCode = c->language_code;
+    mutexUnlock(&c->mutex);
+
+    return rc;
+}
+
+Result setCacheGetRegionCode(SetCache* c, SetRegion *out) {
+    Result rc = 0;
+    u64 now = armGetSystemTick();
+
+    mutexLock(&c->mutex);
+    _setCachePoll(c, now);
+    if (!_setCacheSlotIsValid(c, &c->region_slot, now)) {
+        rc = setGetRegionCode(&c->region);
+        c->region_slot = (SetCacheSlot){ .valid = R_SUCCEEDED(rc), .tick = now };
+    }
+    if (R_SUCCEEDED(rc))
+        *out = c->region;
+    mutexUnlock(&c->mutex);
+
+    return rc;
+}
+
+Result setCacheGetSettingsItemValue(SetCache* c, const char *name, const char *item_key, void *value_out, size_t value_out_size, u64 *size_out) {
+    if (value_out_size > SET_CACHE_MAX_VALUE_SIZE || strlen(name) >= SET_MAX_NAME_SIZE || strlen(item_key) >= SET_MAX_NAME_SIZE)
+        return setsysGetSettingsItemValue(name, item_key, value_out, value_out_size, size_out);
+
+    Result rc = 0;
+    u64 now = armGetSystemTick();
+
+    mutexLock(&c->mutex);
+    _setCachePoll(c, now);
+
+    SetCacheItem* item = NULL;
+    SetCacheItem* oldest = &c->items[0];
+    for (u32 i = 0; i < SET_CACHE_MAX_ITEMS; i++) {
+        SetCacheItem* it = &c->items[i];
+        if (it->slot.valid && strcmp(it->name, name) == 0 && strcmp(it->item_key, item_key) == 0) {
+            item = it;
+            break;
+        }
+        if (!it->slot.valid || (oldest->slot.valid && it->slot.tick < oldest->slot.tick))
+            oldest = it;
+    }
+
+    // Values are always fetched with the largest buffer, so a cached one can serve any value_out_size.
+    if (!item || !_setCacheSlotIsValid(c, &item->slot, now)) {
+        if (!item) {
+            item = oldest;
+            strcpy(item->name, name);
+            strcpy(item->item_key, item_key);
+        }
+        item->size = 0;
+        rc = setsysGetSettingsItemValue(name, item_key, item->value, SET_CACHE_MAX_VALUE_SIZE, &item->size);
+        item->slot = (SetCacheSlot){ .valid = R_SUCCEEDED(rc), .tick = now };
+    }
+
+    if (R_SUCCEEDED(rc)) {
+        u64 size = item->size < value_out_size ? item->size : value_out_size;
+        memcpy(value_out, item->value, size);
+        if (size_out)
+            *size_out = size;
+    }
+    mutexUnlock(&c->mutex);
+
+    return rc;
+}
+
+Result setCacheGetSettingsItemFlag(SetCache* c, const char *name, const char *item_key, bool *out) {
+    u8 value = 0;
+    u64 size = 0;
+
+    Result rc = setCacheGetSettingsItemValue(c, name, item_key, &value, sizeof(value), &size);
+    if (R_SUCCEEDED(rc))
+        *out = value != 0;
+    return rc;
+}
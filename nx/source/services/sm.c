@@ -1,6 +1,7 @@
 #define NX_SERVICE_ASSUME_NON_DOMAIN
 #include "service_guard.h"
 #include "services/fatal.h"
+#include "kernel/mutex.h"
 
 static Service g_smSrv;
 
@@ -33,6 +34,112 @@ Handle smGetServiceOverride(SmServiceName name) {
     return INVALID_HANDLE;
 }
 
+#define MAX_CACHED 32
+
+static Mutex g_smCacheMutex;
+
+static struct {
+    SmServiceName name;
+    Handle handle;      // INVALID_HANDLE until fetched from sm
+} g_smCache[MAX_CACHED];
+
+static size_t g_smCacheNum = 0;
+
+static int _smCacheFind(SmServiceName name) {
+    for (size_t i = 0; i < g_smCacheNum; i++)
+        if (smServiceNamesAreEqual(g_smCache[i].name, name))
+            return i;
+
+    return -1;
+}
+
+Result smServiceCacheEnable(SmServiceName name) {
+    Result rc = 0;
+
+    mutexLock(&g_smCacheMutex);
+    if (_smCacheFind(name) < 0) {
+        if (g_smCacheNum == MAX_CACHED)
+            rc = MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+        else {
+            g_smCache[g_smCacheNum].name   = name;
+            g_smCache[g_smCacheNum].handle = INVALID_HANDLE;
+            g_smCacheNum++;
+        }
+    }
+    mutexUnlock(&g_smCacheMutex);
+
+    return rc;
+}
+
+void smServiceCacheDisable(SmServiceName name) {
+    mutexLock(&g_smCacheMutex);
+    int i = _smCacheFind(name);
+    if (i >= 0) {
+        if (g_smCache[i].handle != INVALID_HANDLE)
+            svcCloseHandle(g_smCache[i].handle);
+        g_smCache[i] = g_smCache[--g_smCacheNum];
+    }
+    mutexUnlock(&g_smCacheMutex);
+}
+
+void smServiceCacheInvalidate(SmServiceName name) {
+    mutexLock(&g_smCacheMutex);
+    int i = _smCacheFind(name);
+    if (i >= 0 && g_smCache[i].handle != INVALID_HANDLE) {
+        svcCloseHandle(g_smCache[i].handle);
+        g_smCache[i].handle = INVALID_HANDLE;
+    }
+    mutexUnlock(&g_smCacheMutex);
+}
+
+void smServiceCacheInvalidateAll(void) {
+    mutexLock(&g_smCacheMutex);
+    for (size_t i = 0; i < g_smCacheNum; i++) {
+        if (g_smCache[i].handle != INVALID_HANDLE) {
+            svcCloseHandle(g_smCache[i].handle);
+            g_smCache[i].handle = INVALID_HANDLE;
+        }
+    }
+    mutexUnlock(&g_smCacheMutex);
+}
+
+// Returns false when the name isn't cached, in which case the caller goes through sm.
+static bool _smCacheGet(Handle* handle_out, SmServiceName name, Result* rc_out) {
+    mutexLock(&g_smCacheMutex);
+    int i = _smCacheFind(name);
+    bool cached = i >= 0;
+
+    if (cached) {
+        Result rc = 0;
+        Handle* cached_handle = &g_smCache[i].handle;
+
+        if (*cached_handle != INVALID_HANDLE) {
+            rc = cmifCloneCurrentObject(*cached_handle, handle_out);
+            // A failed clone means the session died (e.g. the service restarted): drop it and fetch a new one.
+            if (R_FAILED(rc)) {
+                svcCloseHandle(*cached_handle);
+                *cached_handle = INVALID_HANDLE;
+            }
+        }
+
+        // The caller gets a clone, while the handle from sm stays in the cache.
+        if (*cached_handle == INVALID_HANDLE) {
+            Handle handle;
+            rc = smGetServiceOriginal(&handle, name);
+            if (R_SUCCEEDED(rc)) {
+                if (R_SUCCEEDED(cmifCloneCurrentObject(handle, handle_out)))
+                    *cached_handle = handle;
+                else
+                    *handle_out = handle; // Not clonable, hand out the original instead of caching it.
+            }
+        }
+        *rc_out = rc;
+    }
+
+    mutexUnlock(&g_smCacheMutex);
+    return cached;
+}
+
 NX_GENERATE_SERVICE_GUARD(sm);
 
 Result _smInitialize(void) {
@@ -71,12 +178,18 @@ Result smGetServiceWrapper(Service* service_out, SmServiceName name) {
 
     if (handle == INVALID_HANDLE) {
         own_handle = true;
-        rc = smGetServiceOriginal(&handle, name);
+        if (!__atomic_load_n(&g_smCacheNum, __ATOMIC_RELAXED) || !_smCacheGet(&handle, name, &rc))
+            rc = smGetServiceOriginal(&handle, name);
     }
 
     if (R_SUCCEEDED(rc)) {
         serviceCreate(service_out, handle);
         service_out->own_handle = own_handle;
+#if defined(NX_SF_TRACE)
+        char trace_name[sizeof(name.name)+1] = {};
+        __builtin_memcpy(trace_name, name.name, sizeof(name.name));
+        sftraceSetServiceName(handle, trace_name);
+#endif
     }
 
     return rc;
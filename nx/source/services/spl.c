@@ -5,6 +5,7 @@
 #include "runtime/hosversion.h"
 #include "services/spl.h"
 #include "crypto/sha256.h"
+#include "crypto/rsa.h"
 
 /* Structs used in service implementations. */
 typedef struct SplKey {
@@ -164,6 +165,87 @@ Result splUserExpMod(const void *input, const void *modulus, const void *exp, si
     );
 }
 
+Result splUserExpModAsync(SfAsyncRequest *r, const void *input, const void *modulus, const void *exp, size_t exp_size, void *dst) {
+    return sfasyncBegin(r, NULL, _splGetGeneralSrv(), 1,
+        .buffer_attrs = {
+            SfBufferAttr_HipcPointer | SfBufferAttr_Out,
+            SfBufferAttr_HipcPointer | SfBufferAttr_In,
+            SfBufferAttr_HipcPointer | SfBufferAttr_In,
+            SfBufferAttr_HipcPointer | SfBufferAttr_In,
+        },
+        .buffers = {
+            { dst,     SPL_RSA_BUFFER_SIZE },
+            { input,   SPL_RSA_BUFFER_SIZE },
+            { exp,     exp_size },
+            { modulus, SPL_RSA_BUFFER_SIZE },
+        },
+    );
+}
+
+Result splUserRsa2048PssSha256VerifyBatch(SplRsaPssVerifyRequest *reqs, size_t count, bool local) {
+    static const u8 exp[] = { 0x01, 0x00, 0x01 };
+
+    if (local) {
+        for (size_t i = 0; i < count; i++)
+            reqs[i].valid = rsa2048PssSha256Verify(reqs[i].signature, reqs[i].modulus, reqs[i].msg_hash);
+        return 0;
+    }
+
+    /* Requests are queued on a dedicated session, so that other users of the shared one aren't stuck behind the batch. */
+    /* If cloning fails, they're queued on the shared session instead. */
+    Service srv;
+    Service *shared = _splGetGeneralSrv();
+    bool cloned = R_SUCCEEDED(serviceClone(shared, &srv));
+    if (!cloned)
+        srv = *shared;
+
+    SfAsyncRequest r[SPL_RSA_BATCH_DEPTH];
+    u8 em[SPL_RSA_BATCH_DEPTH][SPL_RSA_BUFFER_SIZE];
+    size_t sent = 0, done = 0;
+    Result rc = 0;
+
+    while (done < count) {
+        /* Keep up to SPL_RSA_BATCH_DEPTH requests in flight, and check the encoded messages of completed ones meanwhile. */
+        while (R_SUCCEEDED(rc) && sent < count && sent - done < SPL_RSA_BATCH_DEPTH) {
+            const size_t slot = sent % SPL_RSA_BATCH_DEPTH;
+            rc = sfasyncBegin(&r[slot], NULL, &srv, 1,
+                .buffer_attrs = {
+                    SfBufferAttr_HipcPointer | SfBufferAttr_Out,
+                    SfBufferAttr_HipcPointer | SfBufferAttr_In,
+                    SfBufferAttr_HipcPointer | SfBufferAttr_In,
+                    SfBufferAttr_HipcPointer | SfBufferAttr_In,
+                },
+                .buffers = {
+                    { em[slot],             SPL_RSA_BUFFER_SIZE },
+                    { reqs[sent].signature, SPL_RSA_BUFFER_SIZE },
+                    { exp,                  sizeof(exp) },
+                    { reqs[sent].modulus,   SPL_RSA_BUFFER_SIZE },
+                },
+            );
+            if (R_SUCCEEDED(rc))
+                sent++;
+        }
+
+        if (done == sent)
+            break;
+
+        const size_t slot = done % SPL_RSA_BATCH_DEPTH;
+        Result rc2 = sfasyncEnd(&r[slot]);
+        reqs[done].valid = R_SUCCEEDED(rc2) && rsa2048PssSha256VerifyEncoded(em[slot], reqs[done].msg_hash);
+        if (R_SUCCEEDED(rc))
+            rc = rc2;
+        done++;
+    }
+
+    for (size_t i = done; i < count; i++)
+        reqs[i].valid = false;
+
+    if (cloned)
+        serviceClose(&srv);
+
+    return rc;
+}
+
 Result splSetConfig(SplConfigItem config_item, u64 value) {
     const struct {
         u32 config_item;
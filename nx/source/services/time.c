@@ -14,6 +14,7 @@ static Service g_timeLocalSystemClock;
 static Result _timeCmdGetSession(Service* srv, Service* srv_out, u32 cmd_id);
 
 NX_GENERATE_SERVICE_GUARD(time);
+NX_GENERATE_SERVICE_GUARD_LAZY(time);
 
 Result _timeInitialize(void) {
     Result rc = MAKERESULT(Module_Libnx, LibnxError_BadInput);
@@ -67,10 +68,12 @@ void _timeCleanup(void) {
 }
 
 Service* timeGetServiceSession(void) {
+    _timeLazyInit();
     return &g_timeSrv;
 }
 
 Service* timeGetServiceSession_SystemClock(TimeType type) {
+    _timeLazyInit();
     if (type==TimeType_UserSystemClock) {
         return &g_timeUserSystemClock;
     }
@@ -86,6 +89,7 @@ Service* timeGetServiceSession_SystemClock(TimeType type) {
 }
 
 Service* timeGetServiceSession_TimeZoneService(void) {
+    _timeLazyInit();
     return &g_timeTimeZoneService;
 }
 
@@ -127,28 +131,28 @@ Result timeSetCurrentTime(TimeType type, u64 timestamp) {
 }
 
 Result timeGetDeviceLocationName(TimeLocationName *name) {
-    if (!serviceIsActive(&g_timeTimeZoneService))
+    if (!serviceIsActive(timeGetServiceSession_TimeZoneService()))
         return MAKERESULT(Module_Libnx, LibnxError_NotInitialized);
 
     return serviceDispatchOut(&g_timeTimeZoneService, 0, *name);
 }
 
 Result timeSetDeviceLocationName(const TimeLocationName *name) {
-    if (!serviceIsActive(&g_timeTimeZoneService))
+    if (!serviceIsActive(timeGetServiceSession_TimeZoneService()))
         return MAKERESULT(Module_Libnx, LibnxError_NotInitialized);
 
     return serviceDispatchIn(&g_timeTimeZoneService, 1, *name);
 }
 
 Result timeGetTotalLocationNameCount(s32 *total_location_name_count) {
-    if (!serviceIsActive(&g_timeTimeZoneService))
+    if (!serviceIsActive(timeGetServiceSession_TimeZoneService()))
         return MAKERESULT(Module_Libnx, LibnxError_NotInitialized);
 
     return _appletCmdNoInOutU32(&g_timeTimeZoneService, (u32*)total_location_name_count, 2);
 }
 
 Result timeLoadLocationNameList(s32 index, TimeLocationName *location_name_array, s32 location_name_max, s32 *location_name_count) {
-    if (!serviceIsActive(&g_timeTimeZoneService))
+    if (!serviceIsActive(timeGetServiceSession_TimeZoneService()))
         return MAKERESULT(Module_Libnx, LibnxError_NotInitialized);
 
     return serviceDispatchInOut(&g_timeTimeZoneService, 3, index, *location_name_count,
@@ -158,7 +162,7 @@ Result timeLoadLocationNameList(s32 index, TimeLocationName *location_name_array
 }
 
 Result timeLoadTimeZoneRule(const TimeLocationName *name, TimeZoneRule *rule) {
-    if (!serviceIsActive(&g_timeTimeZoneService))
+    if (!serviceIsActive(timeGetServiceSession_TimeZoneService()))
         return MAKERESULT(Module_Libnx, LibnxError_NotInitialized);
 
     return serviceDispatchIn(&g_timeTimeZoneService, 4, *name,
@@ -168,7 +172,7 @@ Result timeLoadTimeZoneRule(const TimeLocationName *name, TimeZoneRule *rule) {
 }
 
 Result timeToCalendarTime(const TimeZoneRule *rule, u64 timestamp, TimeCalendarTime *caltime, TimeCalendarAdditionalInfo *info) {
-    if (!serviceIsActive(&g_timeTimeZoneService))
+    if (!serviceIsActive(timeGetServiceSession_TimeZoneService()))
         return MAKERESULT(Module_Libnx, LibnxError_NotInitialized);
 
     struct {
@@ -186,7 +190,7 @@ Result timeToCalendarTime(const TimeZoneRule *rule, u64 timestamp, TimeCalendarT
 }
 
 Result timeToCalendarTimeWithMyRule(u64 timestamp, TimeCalendarTime *caltime, TimeCalendarAdditionalInfo *info) {
-    if (!serviceIsActive(&g_timeTimeZoneService))
+    if (!serviceIsActive(timeGetServiceSession_TimeZoneService()))
         return MAKERESULT(Module_Libnx, LibnxError_NotInitialized);
 
     struct {
@@ -201,7 +205,7 @@ Result timeToCalendarTimeWithMyRule(u64 timestamp, TimeCalendarTime *caltime, Ti
 }
 
 Result timeToPosixTime(const TimeZoneRule *rule, const TimeCalendarTime *caltime, u64 *timestamp_list, s32 timestamp_list_count, s32 *timestamp_count) {
-    if (!serviceIsActive(&g_timeTimeZoneService))
+    if (!serviceIsActive(timeGetServiceSession_TimeZoneService()))
         return MAKERESULT(Module_Libnx, LibnxError_NotInitialized);
 
     return serviceDispatchInOut(&g_timeTimeZoneService, 201, *caltime, *timestamp_count,
@@ -217,7 +221,7 @@ Result timeToPosixTime(const TimeZoneRule *rule, const TimeCalendarTime *caltime
 }
 
 Result timeToPosixTimeWithMyRule(const TimeCalendarTime *caltime, u64 *timestamp_list, s32 timestamp_list_count, s32 *timestamp_count) {
-    if (!serviceIsActive(&g_timeTimeZoneService))
+    if (!serviceIsActive(timeGetServiceSession_TimeZoneService()))
         return MAKERESULT(Module_Libnx, LibnxError_NotInitialized);
 
     return serviceDispatchInOut(&g_timeTimeZoneService, 202, *caltime, *timestamp_count,
@@ -0,0 +1,250 @@
+#include <malloc.h>
+#include <stddef.h>
+#include <string.h>
+#include "types.h"
+#include "result.h"
+#include "services/time_zone.h"
+
+// Layout of TimeZoneRule: the tzcode state, with TZ_MAX_TIMES=1000 and TZ_MAX_TYPES=128.
+#define TZ_MAX_TIMES 1000
+#define TZ_MAX_TYPES 128
+#define TZ_CHARS_OFFSET 0x2B38
+#define TZ_MAX_CHARS 0x200
+
+typedef struct {
+    s32 utoff;
+    u8 isdst;
+    u8 pad[3];
+    s32 desigidx;
+    u8 ttisstd;
+    u8 ttisut;
+    u8 pad2[2];
+} TzTypeInfo;
+
+typedef struct {
+    s32 timecnt;
+    s32 typecnt;
+    s32 charcnt;
+    u8 goback;
+    u8 goahead;
+    u8 pad[2];
+    s64 ats[TZ_MAX_TIMES];
+    u8 types[TZ_MAX_TIMES];
+    TzTypeInfo ttis[TZ_MAX_TYPES];
+    char chars[TZ_MAX_CHARS];
+} TzState;
+
+_Static_assert(offsetof(TzState, ttis) + sizeof(((TzState*)0)->ttis) == TZ_CHARS_OFFSET, "Bad TzState layout");
+_Static_assert(sizeof(TzState) <= sizeof(TimeZoneRule), "Bad TzState size");
+
+#define SECS_PER_DAY 86400
+#define YEARS_PER_REPEAT 400
+#define SECS_PER_REPEAT (146097LL * SECS_PER_DAY)
+
+// Only use the rule locally once it's consistent, since the conversions index it.
+static bool _timeZoneValidate(const TzState* s) {
+    if (s->timecnt < 0 || s->timecnt > TZ_MAX_TIMES || s->typecnt < 1 || s->typecnt > TZ_MAX_TYPES || s->charcnt < 0 || s->charcnt > TZ_MAX_CHARS)
+        return false;
+
+    for (s32 i = 0; i < s->timecnt; i++) {
+        if (s->types[i] >= s->typecnt)
+            return false;
+        if (i && s->ats[i] <= s->ats[i - 1])
+            return false;
+    }
+
+    for (s32 i = 0; i < s->typecnt; i++) {
+        if (s->ttis[i].desigidx < 0 || s->ttis[i].desigidx >= s->charcnt)
+            return false;
+    }
+
+    return true;
+}
+
+static Result _timeZoneLoad(TimeZoneConverter* c) {
+    Result rc = timeLoadTimeZoneRule(&c->name, c->rule);
+    if (R_SUCCEEDED(rc))
+        c->local = _timeZoneValidate((const TzState*)c->rule);
+    return rc;
+}
+
+Result timeZoneConverterCreate(TimeZoneConverter* c, const TimeLocationName* name) {
+    Result rc = 0;
+
+    memset(c, 0, sizeof(*c));
+    c->device = !name;
+    if (name)
+        c->name = *name;
+    else
+        rc = timeGetDeviceLocationName(&c->name);
+
+    if (R_SUCCEEDED(rc)) {
+        c->rule = (TimeZoneRule*)malloc(sizeof(TimeZoneRule));
+        if (!c->rule)
+            rc = MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+    }
+
+    if (R_SUCCEEDED(rc))
+        rc = _timeZoneLoad(c);
+
+    if (R_FAILED(rc))
+        timeZoneConverterClose(c);
+    return rc;
+}
+
+Result timeZoneConverterReload(TimeZoneConverter* c) {
+    if (!c->rule)
+        return MAKERESULT(Module_Libnx, LibnxError_NotInitialized);
+
+    if (c->device) {
+        Result rc = timeGetDeviceLocationName(&c->name);
+        if (R_FAILED(rc))
+            return rc;
+    }
+
+    c->local = false;
+    return _timeZoneLoad(c);
+}
+
+void timeZoneConverterClose(TimeZoneConverter* c) {
+    free(c->rule);
+    memset(c, 0, sizeof(*c));
+}
+
+static u32 _timeZoneFindType(const TzState* s, s64 t) {
+    if (!s->timecnt || t < s->ats[0]) {
+        // Before the first transition: the first standard time type, as tzcode does without a default type.
+        for (s32 i = 0; i < s->typecnt; i++) {
+            if (!s->ttis[i].isdst)
+                return i;
+        }
+        return 0;
+    }
+
+    // The last transition at or before t.
+    s32 lo = 0, hi = s->timecnt;
+    while (hi - lo > 1) {
+        s32 mid = lo + (hi - lo) / 2;
+        if (t < s->ats[mid])
+            hi = mid;
+        else
+            lo = mid;
+    }
+    return s->types[lo];
+}
+
+// Days since 1970-01-01 to civil date.
+static void _timeZoneCivilFromDays(s64 days, s64* year, u32* month, u32* day) {
+    days += 719468;
+    s64 era = (days >= 0 ? days : days - 146096) / 146097;
+    u32 doe = days - era * 146097;
+    u32 yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    u32 doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    u32 mp = (5 * doy + 2) / 153;
+    *day = doy - (153 * mp + 2) / 5 + 1;
+    *month = mp < 10 ? mp + 3 : mp - 9;
+    *year = (s64)yoe + era * 400 + (*month <= 2);
+}
+
+static bool _timeZoneIsLeap(s64 year) {
+    return (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+}
+
+static Result _timeZoneConvertLocal(const TzState* s, s64 t, struct tm* tm, TimeCalendarAdditionalInfo* info) {
+    // Past the transitions, the rule repeats every 400 years (goahead/goback): the calendar is the same, offset by whole cycles.
+    s64 cycles = 0;
+    if (s->timecnt && s->goahead && t > s->ats[s->timecnt - 1]) {
+        cycles = (t - s->ats[s->timecnt - 1]) / SECS_PER_REPEAT + 1;
+        t -= cycles * SECS_PER_REPEAT;
+    }
+    else if (s->timecnt && s->goback && t < s->ats[0]) {
+        cycles = -((s->ats[0] - t) / SECS_PER_REPEAT + 1);
+        t -= cycles * SECS_PER_REPEAT;
+    }
+
+    const TzTypeInfo* tti = &s->ttis[_timeZoneFindType(s, t)];
+    s64 local = t + tti->utoff;
+    s64 days = local / SECS_PER_DAY;
+    s64 secs = local % SECS_PER_DAY;
+    if (secs < 0) {
+        secs += SECS_PER_DAY;
+        days--;
+    }
+
+    static const u16 cumdays[12] = { 0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334 };
+    s64 year;
+    u32 month, day;
+    _timeZoneCivilFromDays(days, &year, &month, &day);
+
+    memset(tm, 0, sizeof(*tm));
+    tm->tm_year = year + cycles * YEARS_PER_REPEAT - 1900;
+    tm->tm_mon = month - 1;
+    tm->tm_mday = day;
+    tm->tm_hour = secs / 3600;
+    tm->tm_min = (secs / 60) % 60;
+    tm->tm_sec = secs % 60;
+    tm->tm_wday = (days % 7 + 11) % 7;  // 1970-01-01 was a Thursday.
+    tm->tm_yday = cumdays[month - 1] + day - 1 + (month > 2 && _timeZoneIsLeap(year));
+    tm->tm_isdst = tti->isdst;
+
+    if (info) {
+        memset(info, 0, sizeof(*info));
+        info->wday = tm->tm_wday;
+        info->yday = tm->tm_yday;
+        strncpy(info->timezoneName, &s->chars[tti->desigidx], sizeof(info->timezoneName) - 1);
+        info->DST = tti->isdst;
+        info->offset = tti->utoff;
+    }
+
+    return 0;
+}
+
+static Result _timeZoneConvert(TimeZoneConverter* c, s64 t, struct tm* tm, TimeCalendarAdditionalInfo* info) {
+    if (c->local)
+        return _timeZoneConvertLocal((const TzState*)c->rule, t, tm, info);
+
+    TimeCalendarTime caltime;
+    TimeCalendarAdditionalInfo tmpinfo;
+    if (!info)
+        info = &tmpinfo;
+
+    Result rc = timeToCalendarTime(c->rule, t, &caltime, info);
+    if (R_SUCCEEDED(rc)) {
+        memset(tm, 0, sizeof(*tm));
+        tm->tm_year = caltime.year - 1900;
+        tm->tm_mon = caltime.month - 1;
+        tm->tm_mday = caltime.day;
+        tm->tm_hour = caltime.hour;
+        tm->tm_min = caltime.minute;
+        tm->tm_sec = caltime.second;
+        tm->tm_wday = info->wday;
+        tm->tm_yday = info->yday;
+        tm->tm_isdst = info->DST;
+    }
+    return rc;
+}
+
+Result timeZoneConverterToCalendarTime(TimeZoneConverter* c, u64 timestamp, TimeCalendarTime* caltime, TimeCalendarAdditionalInfo* info) {
+    struct tm tm;
+
+    if (!c->rule)
+        return MAKERESULT(Module_Libnx, LibnxError_NotInitialized);
+
+    Result rc = _timeZoneConvert(c, (s64)timestamp, &tm, info);
+    if (R_SUCCEEDED(rc) && caltime) {
+        memset(caltime, 0, sizeof(*caltime));
+        caltime->year = tm.tm_year + 1900;
+        caltime->month = tm.tm_mon + 1;
+        caltime->day = tm.tm_mday;
+        caltime->hour = tm.tm_hour;
+        caltime->minute = tm.tm_min;
+        caltime->second = tm.tm_sec;
+    }
+    return rc;
+}
+
+struct tm* timeZoneConverterLocaltime(TimeZoneConverter* c, const time_t* timep, struct tm* result) {
+    if (!c->rule || R_FAILED(_timeZoneConvert(c, (s64)*timep, result, NULL)))
+        return NULL;
+    return result;
+}
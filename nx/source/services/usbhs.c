@@ -398,7 +398,7 @@ static Result _usbHsEpSubmitRequest(UsbHsClientEpSession* s, void* buffer, u32 s
     return rc;
 }
 
-static Result _usbHsEpPostBufferAsync(UsbHsClientEpSession* s, void* buffer, u32 size, u64 unk, u32* xferId) {
+Result usbHsEpPostBufferAsync(UsbHsClientEpSession* s, void* buffer, u32 size, u64 unk, u32* xferId) {
     const struct {
         u32 size;
         u32 pad;
@@ -410,7 +410,7 @@ static Result _usbHsEpPostBufferAsync(UsbHsClientEpSession* s, void* buffer, u32
     return serviceDispatchInOut(&s->s, 4, in, *xferId);
 }
 
-static Result _usbHsEpGetXferReport(UsbHsClientEpSession* s, UsbHsXferReport* reports, u32 max_reports, u32* count) {
+Result usbHsEpGetXferReport(UsbHsClientEpSession* s, UsbHsXferReport* reports, u32 max_reports, u32* count) {
     serviceAssumeDomain(&s->s);
     return serviceDispatchInOut(&s->s, 5, max_reports, *count,
         .buffer_attrs = { (hosversionBefore(3,0,0) ? SfBufferAttr_HipcMapAlias : SfBufferAttr_HipcAutoSelect) | SfBufferAttr_Out },
@@ -426,7 +426,7 @@ Result usbHsEpPostBuffer(UsbHsClientEpSession* s, void* buffer, u32 size, u32* t
 
     if (hosversionBefore(2,0,0)) return _usbHsEpSubmitRequest(s, buffer, size, 0, transferredSize);
 
-    rc = _usbHsEpPostBufferAsync(s, buffer, size, 0, &xferId);
+    rc = usbHsEpPostBufferAsync(s, buffer, size, 0, &xferId);
     if (R_FAILED(rc)) return rc;
 
     rc = eventWait(&s->eventXfer, U64_MAX);
@@ -434,7 +434,7 @@ Result usbHsEpPostBuffer(UsbHsClientEpSession* s, void* buffer, u32 size, u32* t
     eventClear(&s->eventXfer);
 
     memset(&report, 0, sizeof(report));
-    rc = _usbHsEpGetXferReport(s, &report, 1, &count);
+    rc = usbHsEpGetXferReport(s, &report, 1, &count);
     if (R_FAILED(rc)) return rc;
 
     if (count<1) return MAKERESULT(Module_Libnx, LibnxError_BadInput);
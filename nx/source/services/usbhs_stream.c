@@ -0,0 +1,171 @@
+#include <string.h>
+#include <malloc.h>
+#include "types.h"
+#include "result.h"
+#include "arm/cache.h"
+#include "arm/counter.h"
+#include "runtime/hosversion.h"
+#include "services/usbhs_stream.h"
+
+Result usbHsEpStreamCreate(UsbHsEpStream* s, UsbHsClientEpSession* ep, u32 max_urbs, u32 buffer_size, u32 num_buffers) {
+    if (hosversionBefore(2,0,0))
+        return MAKERESULT(Module_Libnx, LibnxError_IncompatSysVer);
+
+    if (!max_urbs || max_urbs > USBHS_STREAM_MAX_URBS || num_buffers < max_urbs || num_buffers > USBHS_STREAM_MAX_BUFFERS || !buffer_size || buffer_size > 0xFF0000)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    memset(s, 0, sizeof(*s));
+    s->ep = ep;
+    s->dir_in = (ep->desc.bEndpointAddress & USB_ENDPOINT_IN) != 0;
+    s->max_urbs = max_urbs;
+    s->buffer_size = (buffer_size + 0xFFF) & ~0xFFF;
+    s->num_buffers = num_buffers;
+    s->free_mask = num_buffers < 32 ? BIT(num_buffers) - 1 : ~0U;
+
+    s->pool = (u8*)memalign(0x1000, (size_t)s->buffer_size * num_buffers);
+    if (!s->pool)
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+
+    return 0;
+}
+
+// Fetches the reports of the finished transfers, waiting for at least one within the timeout.
+static Result _usbHsEpStreamCollect(UsbHsEpStream* s, u64 timeout) {
+    UsbHsXferReport reports[USBHS_STREAM_MAX_URBS];
+    u64 start = armGetSystemTick();
+
+    while (s->num_pending) {
+        // eventXfer isn't autoclear, clear it before fetching so that transfers finishing meanwhile signal it again.
+        eventClear(&s->ep->eventXfer);
+
+        u32 count = 0;
+        memset(reports, 0, sizeof(reports));
+        Result rc = usbHsEpGetXferReport(s->ep, reports, s->num_pending, &count);
+        if (R_FAILED(rc))
+            return rc;
+
+        for (u32 i = 0; i < count; i++) {
+            u32 pos;
+            for (pos = 0; pos < s->num_pending && s->pending[pos].xferId != reports[i].xferId; pos++);
+            if (pos == s->num_pending)
+                continue;
+
+            u32 index = s->pending[pos].index;
+            u32 transferred = reports[i].transferredSize < s->sizes[index] ? reports[i].transferredSize : s->sizes[index];
+            void* buffer = usbHsEpStreamGetBuffer(s, index);
+            if (s->dir_in)
+                armDCacheFlush(buffer, transferred);
+
+            UsbHsEpStreamCompletion* c = &s->done[s->num_done++];
+            c->index = index;
+            c->buffer = buffer;
+            c->res = reports[i].res;
+            c->requestedSize = s->sizes[index];
+            c->transferredSize = transferred;
+
+            s->num_pending--;
+            memmove(&s->pending[pos], &s->pending[pos + 1], (s->num_pending - pos) * sizeof(UsbHsEpStreamXfer));
+        }
+
+        if (count || !timeout)
+            break;
+
+        u64 elapsed = armTicksToNs(armGetSystemTick() - start);
+        if (timeout != UINT64_MAX && elapsed >= timeout)
+            break;
+
+        rc = eventWait(&s->ep->eventXfer, timeout == UINT64_MAX ? UINT64_MAX : timeout - elapsed);
+        if (R_FAILED(rc))
+            return rc;
+    }
+
+    return 0;
+}
+
+void usbHsEpStreamClose(UsbHsEpStream* s) {
+    while (s->num_pending) {
+        s->num_done = 0;
+        if (R_FAILED(_usbHsEpStreamCollect(s, UINT64_MAX)))
+            break;
+    }
+
+    free(s->pool);
+    memset(s, 0, sizeof(*s));
+}
+
+Result usbHsEpStreamAcquire(UsbHsEpStream* s, u32* out_index) {
+    if (!s->free_mask)
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+
+    u32 index = __builtin_ctz(s->free_mask);
+    s->free_mask &= ~BIT(index);
+    *out_index = index;
+    return 0;
+}
+
+void usbHsEpStreamRelease(UsbHsEpStream* s, u32 index) {
+    if (index < s->num_buffers)
+        s->free_mask |= BIT(index);
+}
+
+Result usbHsEpStreamSubmit(UsbHsEpStream* s, u32 index, u32 size) {
+    if (index >= s->num_buffers || (s->free_mask & BIT(index)) || !size || size > s->buffer_size)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    while (s->num_pending == s->max_urbs) {
+        Result rc = _usbHsEpStreamCollect(s, UINT64_MAX);
+        if (R_FAILED(rc))
+            return rc;
+    }
+
+    void* buffer = usbHsEpStreamGetBuffer(s, index);
+    armDCacheFlush(buffer, size);
+
+    UsbHsEpStreamXfer* x = &s->pending[s->num_pending];
+    Result rc = usbHsEpPostBufferAsync(s->ep, buffer, size, 0, &x->xferId);
+    if (R_FAILED(rc))
+        return rc;
+
+    x->index = index;
+    s->sizes[index] = size;
+    s->num_pending++;
+    return 0;
+}
+
+Result usbHsEpStreamFill(UsbHsEpStream* s, u32* out_count) {
+    Result rc = 0;
+    u32 count = 0;
+
+    while (s->num_pending < s->max_urbs && s->free_mask) {
+        u32 index;
+        usbHsEpStreamAcquire(s, &index);
+        rc = usbHsEpStreamSubmit(s, index, s->buffer_size);
+        if (R_FAILED(rc)) {
+            usbHsEpStreamRelease(s, index);
+            break;
+        }
+        count++;
+    }
+
+    if (out_count) *out_count = count;
+    return rc;
+}
+
+Result usbHsEpStreamReap(UsbHsEpStream* s, UsbHsEpStreamCompletion* out, u32 max_out, u64 timeout, u32* out_count) {
+    Result rc = 0;
+    *out_count = 0;
+
+    // Fetch the reports without waiting when there are already completions to return.
+    if (s->num_pending)
+        rc = _usbHsEpStreamCollect(s, s->num_done ? 0 : timeout);
+
+    u32 count = s->num_done < max_out ? s->num_done : max_out;
+    memcpy(out, s->done, count * sizeof(UsbHsEpStreamCompletion));
+    s->num_done -= count;
+    memmove(&s->done[0], &s->done[count], s->num_done * sizeof(UsbHsEpStreamCompletion));
+    *out_count = count;
+
+    if (R_SUCCEEDED(rc) && !count && max_out)
+        rc = KERNELRESULT(TimedOut);
+    return count ? 0 : rc;
+}
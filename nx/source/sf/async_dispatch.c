@@ -0,0 +1,85 @@
+#include <malloc.h>
+#include "kernel/svc.h"
+#include "sf/async_dispatch.h"
+
+Result sfasyncBeginImpl(
+    SfAsyncRequest* r, SessionMgr* mgr,
+    Service* s, u32 request_id,
+    const void* in_data, u32 in_data_size,
+    void* out_data, u32 out_data_size,
+    SfDispatchParams disp
+) {
+    *r = (SfAsyncRequest){
+        .srv              = *s,
+        .mgr              = mgr,
+        .slot             = -1,
+        .out_data         = out_data,
+        .out_data_size    = out_data_size,
+        .out_num_objects  = disp.out_num_objects,
+        .out_objects      = disp.out_objects,
+        .out_handle_attrs = disp.out_handle_attrs,
+        .out_handles      = disp.out_handles,
+    };
+
+    r->msg_buffer = memalign(0x1000, NX_SF_ASYNC_MSG_SIZE);
+    if (!r->msg_buffer)
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+
+    Handle session = disp.target_session != INVALID_HANDLE ? disp.target_session : s->session;
+    if (mgr && disp.target_session == INVALID_HANDLE && s->session == mgr->sessions[0]) {
+        r->slot = sessionmgrAttachClient(mgr);
+        session = sessionmgrGetClientSession(mgr, r->slot);
+    }
+
+    void* in = serviceMakeRequestEx(r->msg_buffer, &r->srv, request_id, disp.context,
+        in_data_size, disp.in_send_pid,
+        disp.buffer_attrs, disp.buffers,
+        disp.in_num_objects, disp.in_objects,
+        disp.in_num_handles, disp.in_handles);
+
+    if (in_data_size)
+        __builtin_memcpy(in, in_data, in_data_size);
+
+    Result rc = svcSendAsyncRequestWithUserBuffer(&r->event, r->msg_buffer, NX_SF_ASYNC_MSG_SIZE, session);
+    if (R_FAILED(rc)) {
+        if (r->slot >= 0)
+            sessionmgrDetachClient(mgr, r->slot);
+        free(r->msg_buffer);
+        *r = (SfAsyncRequest){ .slot = -1 };
+    }
+
+    return rc;
+}
+
+Result sfasyncWait(SfAsyncRequest* r, u64 timeout) {
+    return svcWaitSynchronizationSingle(r->event, timeout);
+}
+
+Result sfasyncEnd(SfAsyncRequest* r) {
+    if (r->event == INVALID_HANDLE)
+        return MAKERESULT(Module_Libnx, LibnxError_NotInitialized);
+
+    Result rc;
+    do {
+        rc = svcWaitSynchronizationSingle(r->event, UINT64_MAX);
+    } while (R_VALUE(rc) == KERNELRESULT(Cancelled));
+
+    svcCloseHandle(r->event);
+    if (r->slot >= 0)
+        sessionmgrDetachClient(r->mgr, r->slot);
+
+    if (R_SUCCEEDED(rc)) {
+        void* out = NULL;
+        rc = serviceParseResponseEx(r->msg_buffer, &r->srv,
+            r->out_data_size, &out,
+            r->out_num_objects, r->out_objects,
+            r->out_handle_attrs, r->out_handles);
+
+        if (R_SUCCEEDED(rc) && r->out_data && r->out_data_size)
+            __builtin_memcpy(r->out_data, out, r->out_data_size);
+    }
+
+    free(r->msg_buffer);
+    *r = (SfAsyncRequest){ .slot = -1 };
+    return rc;
+}
@@ -0,0 +1,143 @@
+#include <malloc.h>
+#include "kernel/svc.h"
+#include "sf/batch.h"
+
+Result sfbatchCreate(SfBatch* b, SessionMgr* mgr) {
+    __builtin_memset(b, 0, sizeof(*b));
+    b->mgr = mgr;
+    b->msg_buffers = (u8*)memalign(0x1000, NX_SF_BATCH_MAX_REQUESTS*NX_SF_BATCH_MSG_SIZE);
+    if (!b->msg_buffers)
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+    return 0;
+}
+
+void sfbatchClose(SfBatch* b) {
+    free(b->msg_buffers);
+    __builtin_memset(b, 0, sizeof(*b));
+}
+
+Result sfbatchAddImpl(
+    SfBatch* b, Result* out_rc,
+    Service* s, u32 request_id,
+    const void* in_data, u32 in_data_size,
+    void* out_data, u32 out_data_size,
+    SfDispatchParams disp
+) {
+    if (b->num_entries >= NX_SF_BATCH_MAX_REQUESTS)
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+
+    SfBatchEntry* e = &b->entries[b->num_entries++];
+    e->srv = *s;
+    e->request_id = request_id;
+    e->in_data = in_data;
+    e->in_data_size = in_data_size;
+    e->out_data = out_data;
+    e->out_data_size = out_data_size;
+    e->disp = disp;
+    e->out_rc = out_rc;
+    return 0;
+}
+
+static void _sfbatchComplete(SfBatchEntry* e, Result rc, Result* first_rc) {
+    if (e->out_rc)
+        *e->out_rc = rc;
+    if (R_FAILED(rc) && R_SUCCEEDED(*first_rc))
+        *first_rc = rc;
+}
+
+static void _sfbatchFinish(SfBatch* b, u32 idx, int slot, Result* first_rc) {
+    SfBatchEntry* e = &b->entries[idx];
+    void* base = b->msg_buffers + idx*NX_SF_BATCH_MSG_SIZE;
+
+    if (slot >= 0)
+        sessionmgrDetachClient(b->mgr, slot);
+
+    void* out = NULL;
+    Result rc = serviceParseResponseEx(base, &e->srv,
+        e->out_data_size, &out,
+        e->disp.out_num_objects, e->disp.out_objects,
+        e->disp.out_handle_attrs, e->disp.out_handles);
+
+    if (R_SUCCEEDED(rc) && e->out_data && e->out_data_size)
+        __builtin_memcpy(e->out_data, out, e->out_data_size);
+
+    _sfbatchComplete(e, rc, first_rc);
+}
+
+Result sfbatchSubmit(SfBatch* b) {
+    Result first_rc = 0;
+    u32 pending_mask = (1U << b->num_entries) - 1U;
+
+    // Requests are sent in waves: each wave claims as many pooled sessions as are
+    // currently available (blocking only for the first one, so that we never wait
+    // for a session while holding others), sends everything asynchronously, and
+    // then waits for all replies at once.
+    while (pending_mask) {
+        Handle events[NX_SF_BATCH_MAX_REQUESTS];
+        u32 indices[NX_SF_BATCH_MAX_REQUESTS];
+        int slots[NX_SF_BATCH_MAX_REQUESTS];
+        s32 num_inflight = 0;
+
+        for (u32 i = 0; i < b->num_entries; i ++) {
+            if (!(pending_mask & (1U << i)))
+                continue;
+
+            SfBatchEntry* e = &b->entries[i];
+            Handle session = e->disp.target_session != INVALID_HANDLE ? e->disp.target_session : e->srv.session;
+            int slot = -1;
+            if (b->mgr && e->disp.target_session == INVALID_HANDLE && e->srv.session == b->mgr->sessions[0]) {
+                slot = num_inflight ? sessionmgrTryAttachClient(b->mgr) : sessionmgrAttachClient(b->mgr);
+                if (slot < 0)
+                    continue; // Retry in the next wave
+                session = sessionmgrGetClientSession(b->mgr, slot);
+            }
+
+            void* base = b->msg_buffers + i*NX_SF_BATCH_MSG_SIZE;
+            void* in = serviceMakeRequestEx(base, &e->srv, e->request_id, e->disp.context,
+                e->in_data_size, e->disp.in_send_pid,
+                e->disp.buffer_attrs, e->disp.buffers,
+                e->disp.in_num_objects, e->disp.in_objects,
+                e->disp.in_num_handles, e->disp.in_handles);
+
+            if (e->in_data_size)
+                __builtin_memcpy(in, e->in_data, e->in_data_size);
+
+            pending_mask &= ~(1U << i);
+
+            Handle event = INVALID_HANDLE;
+            Result rc = svcSendAsyncRequestWithUserBuffer(&event, base, NX_SF_BATCH_MSG_SIZE, session);
+            if (R_FAILED(rc)) {
+                if (slot >= 0)
+                    sessionmgrDetachClient(b->mgr, slot);
+                _sfbatchComplete(e, rc, &first_rc);
+                continue;
+            }
+
+            events[num_inflight] = event;
+            indices[num_inflight] = i;
+            slots[num_inflight] = slot;
+            num_inflight ++;
+        }
+
+        while (num_inflight > 0) {
+            s32 idx = 0;
+            Result rc = svcWaitSynchronization(&idx, events, num_inflight, UINT64_MAX);
+            if (R_FAILED(rc)) {
+                // Shouldn't happen, but make sure we never leave a request in flight
+                idx = num_inflight-1;
+                svcWaitSynchronizationSingle(events[idx], UINT64_MAX);
+            }
+
+            svcCloseHandle(events[idx]);
+            _sfbatchFinish(b, indices[idx], slots[idx], &first_rc);
+
+            num_inflight --;
+            events[idx]  = events[num_inflight];
+            indices[idx] = indices[num_inflight];
+            slots[idx]   = slots[num_inflight];
+        }
+    }
+
+    b->num_entries = 0;
+    return first_rc;
+}
@@ -0,0 +1,510 @@
+#include <string.h>
+#include <malloc.h>
+#include "result.h"
+#include "kernel/svc.h"
+#include "sf/server.h"
+#include "../internal.h"
+
+static ServerEntry* _servermgrAddEntry(ServerManager* mgr, Handle handle, bool is_port, const ServerInterface* iface, void* userdata) {
+    ServerEntry* e = NULL;
+
+    mutexLock(&mgr->list_mutex);
+    for (u32 i = 0; i < NX_SERVER_MAX_ENTRIES; i ++) {
+        if (mgr->entries[i].handle == INVALID_HANDLE) {
+            e = &mgr->entries[i];
+            if (i >= mgr->num_entries)
+                mgr->num_entries = i+1;
+            break;
+        }
+    }
+
+    if (e) {
+        *e = (ServerEntry){
+            .handle  = handle,
+            .is_port = is_port,
+            .object  = { iface, userdata },
+        };
+
+        // Make the waiting thread pick up the new entry
+        if (mgr->waiter_thread != INVALID_HANDLE)
+            svcCancelSynchronization(mgr->waiter_thread);
+    }
+    mutexUnlock(&mgr->list_mutex);
+
+    return e;
+}
+
+static void _servermgrReleaseEntry(ServerManager* mgr, ServerEntry* e) {
+    mutexLock(&mgr->list_mutex);
+    e->is_busy = false;
+    if (mgr->waiter_thread != INVALID_HANDLE)
+        svcCancelSynchronization(mgr->waiter_thread);
+    mutexUnlock(&mgr->list_mutex);
+}
+
+static void _servermgrCloseObject(ServerObject* o) {
+    if (o->iface && o->iface->close)
+        o->iface->close(o->userdata);
+    o->iface = NULL;
+    o->userdata = NULL;
+}
+
+static ServerDomain* _servermgrDomainCreate(void) {
+    ServerDomain* d = (ServerDomain*)calloc(1, sizeof(ServerDomain));
+    if (d) {
+        d->refcount = 1;
+        mutexInit(&d->mutex);
+    }
+    return d;
+}
+
+static bool _servermgrDomainGet(ServerDomain* d, u32 id, ServerObject* out) {
+    if (id < 1 || id > NX_SERVER_MAX_DOMAIN_OBJECTS)
+        return false;
+    mutexLock(&d->mutex);
+    *out = d->objects[id-1];
+    mutexUnlock(&d->mutex);
+    return out->iface != NULL;
+}
+
+static u32 _servermgrDomainAdd(ServerDomain* d, const ServerObject* o) {
+    u32 id = 0;
+    mutexLock(&d->mutex);
+    for (u32 i = 0; i < NX_SERVER_MAX_DOMAIN_OBJECTS; i ++) {
+        if (!d->objects[i].iface) {
+            d->objects[i] = *o;
+            id = i+1;
+            break;
+        }
+    }
+    mutexUnlock(&d->mutex);
+    return id;
+}
+
+static bool _servermgrDomainClose(ServerDomain* d, u32 id) {
+    ServerObject o = {};
+    if (id >= 1 && id <= NX_SERVER_MAX_DOMAIN_OBJECTS) {
+        mutexLock(&d->mutex);
+        o = d->objects[id-1];
+        d->objects[id-1] = (ServerObject){};
+        mutexUnlock(&d->mutex);
+    }
+    if (!o.iface)
+        return false;
+    _servermgrCloseObject(&o);
+    return true;
+}
+
+static void _servermgrDomainRelease(ServerDomain* d) {
+    if (__atomic_sub_fetch(&d->refcount, 1, __ATOMIC_ACQ_REL) != 0)
+        return;
+    for (u32 i = 0; i < NX_SERVER_MAX_DOMAIN_OBJECTS; i ++)
+        _servermgrCloseObject(&d->objects[i]);
+    free(d);
+}
+
+static void _servermgrRemoveEntry(ServerManager* mgr, ServerEntry* e) {
+    if (e->domain)
+        _servermgrDomainRelease(e->domain);
+    else if (!e->is_port)
+        _servermgrCloseObject(&e->object);
+
+    svcCloseHandle(e->handle);
+
+    mutexLock(&mgr->list_mutex);
+    *e = (ServerEntry){};
+    mutexUnlock(&mgr->list_mutex);
+}
+
+Result servermgrCreate(ServerManager* mgr, u16 pointer_buffer_size) {
+    memset(mgr, 0, sizeof(*mgr));
+    mutexInit(&mgr->list_mutex);
+    mutexInit(&mgr->wait_mutex);
+    mgr->pointer_buffer_size = pointer_buffer_size;
+    return 0;
+}
+
+void servermgrClose(ServerManager* mgr) {
+    for (u32 i = 0; i < mgr->num_entries; i ++)
+        if (mgr->entries[i].handle != INVALID_HANDLE)
+            _servermgrRemoveEntry(mgr, &mgr->entries[i]);
+    mgr->num_entries = 0;
+}
+
+Result servermgrAddPort(ServerManager* mgr, Handle port, const ServerInterface* iface, void* userdata) {
+    if (!_servermgrAddEntry(mgr, port, true, iface, userdata))
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+    return 0;
+}
+
+Result servermgrRegisterService(ServerManager* mgr, SmServiceName name, s32 max_sessions, const ServerInterface* iface, void* userdata) {
+    Handle port;
+    Result rc = smRegisterService(&port, name, false, max_sessions);
+    if (R_SUCCEEDED(rc)) {
+        rc = servermgrAddPort(mgr, port, iface, userdata);
+        if (R_FAILED(rc)) {
+            svcCloseHandle(port);
+            smUnregisterService(name);
+        }
+    }
+    return rc;
+}
+
+Result servermgrAddSession(ServerManager* mgr, Handle session, const ServerInterface* iface, void* userdata) {
+    if (!_servermgrAddEntry(mgr, session, false, iface, userdata))
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+    return 0;
+}
+
+void servermgrRequestExit(ServerManager* mgr) {
+    mutexLock(&mgr->list_mutex);
+    mgr->should_exit = true;
+    if (mgr->waiter_thread != INVALID_HANDLE)
+        svcCancelSynchronization(mgr->waiter_thread);
+    mutexUnlock(&mgr->list_mutex);
+}
+
+bool serverreqGetInObject(ServerRequest* req, u32 idx, ServerObject* out) {
+    if (idx >= req->num_in_objects || !req->entry->domain)
+        return false;
+    return _servermgrDomainGet(req->entry->domain, req->in_object_ids[idx], out);
+}
+
+static Result _servermgrWait(ServerManager* mgr, ServerEntry** out, u64 timeout) {
+    Handle handles[NX_SERVER_MAX_ENTRIES];
+    ServerEntry* entries[NX_SERVER_MAX_ENTRIES];
+    s32 num_handles = 0;
+    Result rc;
+
+    // Only one thread waits for events at a time; the others are busy processing requests
+    // or waiting here for their turn.
+    mutexLock(&mgr->wait_mutex);
+
+    mutexLock(&mgr->list_mutex);
+    if (mgr->should_exit) {
+        mutexUnlock(&mgr->list_mutex);
+        mutexUnlock(&mgr->wait_mutex);
+        return KERNELRESULT(Cancelled);
+    }
+    for (u32 i = 0; i < mgr->num_entries; i ++) {
+        ServerEntry* e = &mgr->entries[i];
+        if (e->handle != INVALID_HANDLE && !e->is_busy) {
+            handles[num_handles] = e->handle;
+            entries[num_handles] = e;
+            num_handles ++;
+        }
+    }
+    mgr->waiter_thread = getThreadVars()->handle;
+    mutexUnlock(&mgr->list_mutex);
+
+    s32 idx = -1;
+    if (num_handles)
+        rc = svcWaitSynchronization(&idx, handles, num_handles, timeout);
+    else
+        rc = svcWaitSynchronization(&idx, &mgr->waiter_thread, 0, timeout);
+
+    mutexLock(&mgr->list_mutex);
+    mgr->waiter_thread = INVALID_HANDLE;
+    if (R_SUCCEEDED(rc)) {
+        entries[idx]->is_busy = true;
+        *out = entries[idx];
+    }
+    mutexUnlock(&mgr->list_mutex);
+
+    mutexUnlock(&mgr->wait_mutex);
+    return rc;
+}
+
+static Result _servermgrReceive(ServerManager* mgr, ServerEntry* e, void* msg_buffer, void* pointer_buffer) {
+    Result rc;
+    do {
+        if (mgr->pointer_buffer_size) {
+            HipcRequest hipc = hipcMakeRequestInline(msg_buffer,
+                .num_recv_statics = HIPC_AUTO_RECV_STATIC,
+            );
+            *hipc.recv_list = hipcMakeRecvStatic(pointer_buffer, mgr->pointer_buffer_size);
+        } else
+            hipcMakeRequestInline(msg_buffer);
+
+        s32 idx;
+        rc = svcReplyAndReceiveWithUserBuffer(&idx, msg_buffer, NX_SERVER_MSG_BUFFER_SIZE, &e->handle, 1, INVALID_HANDLE, 0);
+        // A stale wakeup from another thread may cancel the receive; just retry it
+    } while (R_VALUE(rc) == KERNELRESULT(Cancelled));
+    return rc;
+}
+
+static void _servermgrReply(ServerEntry* e, void* msg_buffer) {
+    Result rc;
+    do {
+        s32 idx;
+        rc = svcReplyAndReceiveWithUserBuffer(&idx, msg_buffer, NX_SERVER_MSG_BUFFER_SIZE, NULL, 0, e->handle, 0);
+    } while (R_VALUE(rc) == KERNELRESULT(Cancelled));
+}
+
+static void _servermgrMakeResponse(ServerManager* mgr, ServerRequest* req, void* base, bool is_domain, Result result) {
+    if (R_FAILED(result)) {
+        req->out_data_size = 0;
+        req->num_out_objects = 0;
+        req->num_out_copy_handles = 0;
+        req->num_out_move_handles = 0;
+    }
+
+    // Non-domain output objects are sent as new sessions, at the start of the move handle list
+    Handle object_handles[NX_SERVER_MAX_OUT_ITEMS];
+    u32 object_ids[NX_SERVER_MAX_OUT_ITEMS];
+    u32 num_object_handles = 0;
+    for (u32 i = 0; i < req->num_out_objects; i ++) {
+        ServerObject* o = &req->out_objects[i];
+        if (is_domain) {
+            object_ids[i] = _servermgrDomainAdd(req->entry->domain, o);
+            if (!object_ids[i]) {
+                _servermgrCloseObject(o);
+                result = MAKERESULT(Module_Libnx, LibnxError_DomainMessageTooManyObjectIds);
+            }
+        } else {
+            Handle server_h, client_h;
+            Result rc = svcCreateSession(&server_h, &client_h, 0, 0);
+            if (R_SUCCEEDED(rc) && !_servermgrAddEntry(mgr, server_h, false, o->iface, o->userdata)) {
+                svcCloseHandle(server_h);
+                svcCloseHandle(client_h);
+                rc = MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+            }
+            if (R_FAILED(rc)) {
+                _servermgrCloseObject(o);
+                result = rc;
+            } else
+                object_handles[num_object_handles++] = client_h;
+        }
+    }
+
+    u32 num_out_objects = is_domain ? req->num_out_objects : 0;
+    u32 data_size = 16 + sizeof(CmifOutHeader) + req->out_data_size;
+    if (is_domain)
+        data_size += sizeof(CmifDomainOutHeader) + num_out_objects*sizeof(u32);
+
+    HipcRequest hipc = hipcMakeRequestInline(base,
+        .num_data_words   = (data_size + 3) / 4,
+        .num_copy_handles = req->num_out_copy_handles,
+        .num_move_handles = num_object_handles + req->num_out_move_handles,
+    );
+
+    for (u32 i = 0; i < req->num_out_copy_handles; i ++)
+        hipc.copy_handles[i] = req->out_copy_handles[i];
+    for (u32 i = 0; i < num_object_handles; i ++)
+        hipc.move_handles[i] = object_handles[i];
+    for (u32 i = 0; i < req->num_out_move_handles; i ++)
+        hipc.move_handles[num_object_handles+i] = req->out_move_handles[i];
+
+    CmifOutHeader* hdr = NULL;
+    void* start = cmifGetAlignedDataStart(hipc.data_words, base);
+    if (is_domain) {
+        CmifDomainOutHeader* domain_hdr = (CmifDomainOutHeader*)start;
+        *domain_hdr = (CmifDomainOutHeader){ .num_out_objects = num_out_objects };
+        hdr = (CmifOutHeader*)(domain_hdr+1);
+    } else
+        hdr = (CmifOutHeader*)start;
+
+    *hdr = (CmifOutHeader){
+        .magic   = CMIF_OUT_HEADER_MAGIC,
+        .version = 0,
+        .result  = result,
+        .token   = 0,
+    };
+
+    memcpy(hdr+1, req->out_data, req->out_data_size);
+    if (num_out_objects)
+        memcpy((u8*)(hdr+1) + req->out_data_size, object_ids, num_out_objects*sizeof(u32));
+}
+
+static Result _servermgrDispatch(ServerObject* o, ServerRequest* req) {
+    if (!o->iface)
+        return MAKERESULT(Module_Libnx, LibnxError_NotFound);
+
+    for (u32 i = 0; i < o->iface->num_cmds; i ++)
+        if (o->iface->cmds[i].cmd_id == req->cmd_id)
+            return o->iface->cmds[i].handler(o->userdata, req);
+
+    return MAKERESULT(Module_Libnx, LibnxError_ServerUnknownCommand);
+}
+
+static Result _servermgrCloneSession(ServerManager* mgr, ServerRequest* req) {
+    ServerEntry* e = req->entry;
+    if (req->num_out_move_handles >= NX_SERVER_MAX_OUT_ITEMS)
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+
+    Handle server_h, client_h;
+    Result rc = svcCreateSession(&server_h, &client_h, 0, 0);
+    if (R_FAILED(rc))
+        return rc;
+
+    // Clones of a domain session share its domain object table
+    ServerEntry* clone = _servermgrAddEntry(mgr, server_h, false, e->object.iface, e->object.userdata);
+    if (!clone) {
+        svcCloseHandle(server_h);
+        svcCloseHandle(client_h);
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+    }
+
+    if (e->domain) {
+        __atomic_add_fetch(&e->domain->refcount, 1, __ATOMIC_RELAXED);
+        clone->domain = e->domain;
+    }
+
+    return serverreqAddMoveHandle(req, client_h);
+}
+
+static Result _servermgrHandleControl(ServerManager* mgr, ServerRequest* req) {
+    ServerEntry* e = req->entry;
+    switch (req->cmd_id) {
+        case 0: // ConvertCurrentObjectToDomain
+            if (e->domain)
+                return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+            e->domain = _servermgrDomainCreate();
+            if (!e->domain)
+                return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+            e->domain->objects[0] = e->object;
+            e->object = (ServerObject){};
+            *(u32*)serverreqAllocOutData(req, sizeof(u32)) = 1;
+            return 0;
+
+        case 1: { // CopyFromCurrentDomain
+            ServerObject o;
+            if (!e->domain || req->in_data_size < sizeof(u32))
+                return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+            if (!_servermgrDomainGet(e->domain, *(const u32*)req->in_data, &o))
+                return MAKERESULT(Module_Libnx, LibnxError_NotFound);
+            // Control requests are never domain messages, so this creates a new session
+            return serverreqAddOutObject(req, o.iface, o.userdata);
+        }
+
+        case 2: // CloneCurrentObject
+        case 4: // CloneCurrentObjectEx
+            return _servermgrCloneSession(mgr, req);
+
+        case 3: // QueryPointerBufferSize
+            *(u16*)serverreqAllocOutData(req, sizeof(u16)) = mgr->pointer_buffer_size;
+            return 0;
+
+        default:
+            return MAKERESULT(Module_Libnx, LibnxError_ServerUnknownCommand);
+    }
+}
+
+// Returns false if the session must be closed.
+static bool _servermgrHandleRequest(ServerManager* mgr, ServerEntry* e, void* base) {
+    ServerRequest req = {};
+    req.mgr = mgr;
+    req.entry = e;
+    req.hipc = hipcParseRequest(base);
+    req.pid = req.hipc.pid;
+
+    u32 type = req.hipc.meta.type;
+    if (type == CmifCommandType_Close)
+        return false;
+
+    bool is_request = type == CmifCommandType_Request || type == CmifCommandType_RequestWithContext;
+    bool is_control = type == CmifCommandType_Control || type == CmifCommandType_ControlWithContext;
+    if (!is_request && !is_control)
+        return false;
+
+    u8* data_end = (u8*)req.hipc.data.data_words + req.hipc.meta.num_data_words*sizeof(u32);
+    void* start = cmifGetAlignedDataStart(req.hipc.data.data_words, base);
+    bool is_domain = is_request && e->domain;
+
+    Result rc = 0;
+    ServerObject target = e->object;
+    const CmifInHeader* hdr = (const CmifInHeader*)start;
+
+    if (is_domain) {
+        const CmifDomainInHeader* domain_hdr = (const CmifDomainInHeader*)start;
+        hdr = (const CmifInHeader*)(domain_hdr+1);
+        req.object_id = domain_hdr->object_id;
+        req.num_in_objects = domain_hdr->num_in_objects;
+        req.in_object_ids = (const u32*)((const u8*)hdr + domain_hdr->data_size);
+
+        if (domain_hdr->type == CmifDomainRequestType_Close) {
+            if (!_servermgrDomainClose(e->domain, req.object_id))
+                rc = MAKERESULT(Module_Libnx, LibnxError_NotFound);
+            _servermgrMakeResponse(mgr, &req, base, true, rc);
+            return true;
+        }
+
+        _servermgrDomainGet(e->domain, req.object_id, &target);
+        if (domain_hdr->type != CmifDomainRequestType_SendMessage) {
+            _servermgrMakeResponse(mgr, &req, base, true, MAKERESULT(Module_Libnx, LibnxError_DomainMessageUnknownType));
+            return true;
+        }
+    }
+
+    if ((const u8*)(hdr+1) > data_end || hdr->magic != CMIF_IN_HEADER_MAGIC) {
+        _servermgrMakeResponse(mgr, &req, base, is_domain, MAKERESULT(Module_Libnx, LibnxError_BadInput));
+        return true;
+    }
+
+    req.cmd_id = hdr->command_id;
+    req.in_data = hdr+1;
+    req.in_data_size = data_end - (const u8*)req.in_data;
+
+    if (is_control)
+        rc = _servermgrHandleControl(mgr, &req);
+    else
+        rc = _servermgrDispatch(&target, &req);
+
+    _servermgrMakeResponse(mgr, &req, base, is_domain, rc);
+    return true;
+}
+
+Result servermgrProcess(ServerManager* mgr, void* msg_buffer, void* pointer_buffer, u64 timeout) {
+    ServerEntry* e = NULL;
+    Result rc = _servermgrWait(mgr, &e, timeout);
+    if (R_FAILED(rc))
+        return rc;
+
+    if (e->is_port) {
+        Handle session;
+        rc = svcAcceptSession(&session, e->handle);
+        ServerObject object = e->object;
+        _servermgrReleaseEntry(mgr, e);
+        if (R_SUCCEEDED(rc) && !_servermgrAddEntry(mgr, session, false, object.iface, object.userdata)) {
+            svcCloseHandle(session);
+            rc = MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+        }
+        return rc;
+    }
+
+    rc = _servermgrReceive(mgr, e, msg_buffer, pointer_buffer);
+    if (R_FAILED(rc)) {
+        _servermgrRemoveEntry(mgr, e);
+        return R_VALUE(rc) == KERNELRESULT(ConnectionClosed) ? 0 : rc;
+    }
+
+    if (!_servermgrHandleRequest(mgr, e, msg_buffer)) {
+        _servermgrRemoveEntry(mgr, e);
+        return 0;
+    }
+
+    _servermgrReply(e, msg_buffer);
+    _servermgrReleaseEntry(mgr, e);
+    return 0;
+}
+
+Result servermgrLoop(ServerManager* mgr) {
+    void* msg_buffer = memalign(0x1000, NX_SERVER_MSG_BUFFER_SIZE);
+    void* pointer_buffer = mgr->pointer_buffer_size ? malloc(mgr->pointer_buffer_size) : NULL;
+    if (!msg_buffer || (mgr->pointer_buffer_size && !pointer_buffer)) {
+        free(msg_buffer);
+        free(pointer_buffer);
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+    }
+
+    Result rc = 0;
+    while (!__atomic_load_n(&mgr->should_exit, __ATOMIC_RELAXED)) {
+        rc = servermgrProcess(mgr, msg_buffer, pointer_buffer, UINT64_MAX);
+        if (R_VALUE(rc) == KERNELRESULT(Cancelled))
+            rc = 0;
+    }
+
+    free(pointer_buffer);
+    free(msg_buffer);
+    return rc;
+}
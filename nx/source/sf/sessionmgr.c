@@ -1,11 +1,12 @@
 #include "kernel/svc.h"
 #include "sf/cmif.h"
 #include "sf/sessionmgr.h"
+#include "../internal.h"
 
-Result sessionmgrCreate(SessionMgr* mgr, Handle root_session, u32 num_sessions) {
+Result sessionmgrCreateEx(SessionMgr* mgr, Handle root_session, u32 num_sessions, u32 max_sessions) {
     if (root_session == INVALID_HANDLE)
         return MAKERESULT(Module_Libnx, LibnxError_BadInput);
-    if (num_sessions < 1 || num_sessions > NX_SESSION_MGR_MAX_SESSIONS)
+    if (num_sessions < 1 || num_sessions > max_sessions || max_sessions > NX_SESSION_MGR_MAX_SESSIONS)
         return MAKERESULT(Module_Libnx, LibnxError_BadInput);
     if (mgr->sessions[0] != INVALID_HANDLE)
         return MAKERESULT(Module_Libnx, LibnxError_AlreadyInitialized);
@@ -13,7 +14,8 @@ Result sessionmgrCreate(SessionMgr* mgr, Handle root_session, u32 num_sessions)
     __builtin_memset(mgr, 0, sizeof(*mgr));
     mgr->sessions[0] = root_session;
     mgr->num_sessions = num_sessions;
-    mgr->free_mask = (1U << num_sessions) - 1U;
+    mgr->max_sessions = max_sessions;
+    mgr->free_mask = num_sessions < 32 ? (1U << num_sessions) - 1U : ~0U;
 
     Result rc = 0;
     for (u32 i = 1; R_SUCCEEDED(rc) && i < num_sessions; i ++)
@@ -37,26 +39,99 @@ void sessionmgrClose(SessionMgr* mgr) {
     }
 }
 
+static int _sessionmgrTryClaimSlotInMask(SessionMgr* mgr, u32 allowed_mask) {
+    u32 mask = __atomic_load_n(&mgr->free_mask, __ATOMIC_RELAXED);
+    while (mask & allowed_mask) {
+        int slot = __builtin_ctz(mask & allowed_mask);
+        if (__atomic_compare_exchange_n(&mgr->free_mask, &mask, mask & ~(1U << slot), true, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+            return slot;
+    }
+    return -1;
+}
+
+static int _sessionmgrTryClaimSlot(SessionMgr* mgr) {
+    if (!mgr->is_sticky)
+        return _sessionmgrTryClaimSlotInMask(mgr, ~0U);
+
+    // Prefer the slot this thread used last, then slots nobody has used yet,
+    // and only then steal a slot last used by another thread
+    Handle self = getThreadVars()->handle;
+    u32 own_mask = 0, unowned_mask = 0;
+    u32 num_sessions = __atomic_load_n(&mgr->num_sessions, __ATOMIC_ACQUIRE);
+    for (u32 i = 0; i < num_sessions; i ++) {
+        Handle owner = __atomic_load_n(&mgr->slot_owners[i], __ATOMIC_RELAXED);
+        if (owner == self)
+            own_mask |= 1U << i;
+        else if (owner == INVALID_HANDLE)
+            unowned_mask |= 1U << i;
+    }
+
+    int slot = _sessionmgrTryClaimSlotInMask(mgr, own_mask);
+    if (slot < 0)
+        slot = _sessionmgrTryClaimSlotInMask(mgr, unowned_mask);
+    if (slot < 0)
+        slot = _sessionmgrTryClaimSlotInMask(mgr, ~0U);
+    if (slot >= 0 && !(own_mask & (1U << slot)))
+        __atomic_store_n(&mgr->slot_owners[slot], self, __ATOMIC_RELAXED);
+    return slot;
+}
+
+// Must be called with the mutex held. The new slot is returned already claimed.
+static int _sessionmgrGrow(SessionMgr* mgr) {
+    u32 slot = mgr->num_sessions;
+    if (slot >= mgr->max_sessions)
+        return -1;
+
+    Handle session;
+    Result rc = cmifCloneCurrentObject(mgr->sessions[0], &session);
+    if (R_FAILED(rc)) {
+        // Don't keep retrying if the server refuses to give us more sessions
+        mgr->max_sessions = slot;
+        return -1;
+    }
+
+    mgr->sessions[slot] = session;
+    if (mgr->is_sticky)
+        __atomic_store_n(&mgr->slot_owners[slot], getThreadVars()->handle, __ATOMIC_RELAXED);
+    __atomic_store_n(&mgr->num_sessions, slot+1, __ATOMIC_RELEASE);
+    return slot;
+}
+
 int sessionmgrAttachClient(SessionMgr* mgr) {
+    // Fast path: claim a free slot without taking the lock
+    int slot = _sessionmgrTryClaimSlot(mgr);
+    if (slot >= 0)
+        return slot;
+
+    // Slow path: register as a waiter before re-checking the mask, so that
+    // a concurrent detach either sees us waiting or we see its freed slot
+    __atomic_add_fetch(&mgr->num_contended, 1, __ATOMIC_RELAXED);
     mutexLock(&mgr->mutex);
-    int slot;
+    __atomic_add_fetch(&mgr->num_waiters, 1, __ATOMIC_SEQ_CST);
+    // The re-check below loads free_mask relaxed: without this fence they could
+    // both miss each other, and we'd sleep with a slot free
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
     for (;;) {
-        slot = __builtin_ffs(mgr->free_mask)-1;
+        slot = _sessionmgrTryClaimSlot(mgr);
+        if (slot >= 0) break;
+        slot = _sessionmgrGrow(mgr);
         if (slot >= 0) break;
-        mgr->is_waiting = true;
         condvarWait(&mgr->condvar, &mgr->mutex);
     }
-    mgr->free_mask &= ~(1U << slot);
+    __atomic_sub_fetch(&mgr->num_waiters, 1, __ATOMIC_SEQ_CST);
     mutexUnlock(&mgr->mutex);
     return slot;
 }
 
+int sessionmgrTryAttachClient(SessionMgr* mgr) {
+    return _sessionmgrTryClaimSlot(mgr);
+}
+
 void sessionmgrDetachClient(SessionMgr* mgr, int slot) {
-    mutexLock(&mgr->mutex);
-    mgr->free_mask |= 1U << slot;
-    if (mgr->is_waiting) {
-        mgr->is_waiting = false;
+    __atomic_or_fetch(&mgr->free_mask, 1U << slot, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&mgr->num_waiters, __ATOMIC_SEQ_CST)) {
+        mutexLock(&mgr->mutex);
         condvarWakeOne(&mgr->condvar);
+        mutexUnlock(&mgr->mutex);
     }
-    mutexUnlock(&mgr->mutex);
 }
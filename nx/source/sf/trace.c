@@ -0,0 +1,205 @@
+#include <string.h>
+#include "kernel/mutex.h"
+#include "sf/trace.h"
+
+#define MAX_NAMES 64
+
+typedef struct {
+    u32 seq;
+    SfTraceEvent event;
+} TraceRingEntry;
+
+typedef struct {
+    u32 state; // 0 = free, 1 = being claimed, 2 = ready
+    Handle session;
+    u32 object_id;
+    u32 request_id;
+    u64 count;
+    u64 total_ticks;
+    u64 max_ticks;
+    u32 buckets[NX_SF_TRACE_NUM_BUCKETS];
+} TraceKeyEntry;
+
+static bool g_sftraceEnabled;
+
+static TraceRingEntry g_sftraceRing[NX_SF_TRACE_RING_SIZE];
+static u32 g_sftraceRingPos;
+
+static TraceKeyEntry g_sftraceKeys[NX_SF_TRACE_MAX_KEYS];
+
+static Mutex g_sftraceNameMutex;
+static struct {
+    Handle session;
+    char name[9];
+} g_sftraceNames[MAX_NAMES];
+
+void sftraceSetEnabled(bool enabled) {
+    __atomic_store_n(&g_sftraceEnabled, enabled, __ATOMIC_RELAXED);
+}
+
+bool sftraceIsEnabled(void) {
+    return __atomic_load_n(&g_sftraceEnabled, __ATOMIC_RELAXED);
+}
+
+void sftraceSetServiceName(Handle session, const char* name) {
+    mutexLock(&g_sftraceNameMutex);
+
+    int slot = -1;
+    for (u32 i = 0; i < MAX_NAMES; i ++) {
+        if (g_sftraceNames[i].session == session) {
+            slot = i;
+            break;
+        }
+        if (slot < 0 && g_sftraceNames[i].session == INVALID_HANDLE)
+            slot = i;
+    }
+
+    if (slot >= 0) {
+        g_sftraceNames[slot].session = session;
+        strncpy(g_sftraceNames[slot].name, name, sizeof(g_sftraceNames[slot].name)-1);
+        g_sftraceNames[slot].name[sizeof(g_sftraceNames[slot].name)-1] = 0;
+    }
+
+    mutexUnlock(&g_sftraceNameMutex);
+}
+
+static void _sftraceGetServiceName(Handle session, char* out) {
+    out[0] = 0;
+    mutexLock(&g_sftraceNameMutex);
+    for (u32 i = 0; i < MAX_NAMES; i ++) {
+        if (g_sftraceNames[i].session == session) {
+            memcpy(out, g_sftraceNames[i].name, sizeof(g_sftraceNames[i].name));
+            break;
+        }
+    }
+    mutexUnlock(&g_sftraceNameMutex);
+}
+
+static TraceKeyEntry* _sftraceFindKey(Handle session, u32 object_id, u32 request_id) {
+    u32 hash = (session * 0x9E3779B1U) ^ (object_id * 0x85EBCA77U) ^ (request_id * 0xC2B2AE3DU);
+    for (u32 i = 0; i < NX_SF_TRACE_MAX_KEYS; i ++) {
+        TraceKeyEntry* e = &g_sftraceKeys[(hash + i) % NX_SF_TRACE_MAX_KEYS];
+        u32 state = __atomic_load_n(&e->state, __ATOMIC_ACQUIRE);
+
+        if (state == 0) {
+            if (__atomic_compare_exchange_n(&e->state, &state, 1, false, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) {
+                e->session = session;
+                e->object_id = object_id;
+                e->request_id = request_id;
+                __atomic_store_n(&e->state, 2, __ATOMIC_RELEASE);
+                return e;
+            }
+        }
+
+        // Another thread is filling in this entry; wait for it to become readable
+        while (state == 1)
+            state = __atomic_load_n(&e->state, __ATOMIC_ACQUIRE);
+
+        if (e->session == session && e->object_id == object_id && e->request_id == request_id)
+            return e;
+    }
+
+    return NULL;
+}
+
+void sftraceRecord(Handle session, u32 object_id, u32 request_id, Result rc, u64 start_tick, u64 end_tick) {
+    u64 duration = end_tick - start_tick;
+
+    u32 pos = __atomic_fetch_add(&g_sftraceRingPos, 1, __ATOMIC_RELAXED);
+    TraceRingEntry* r = &g_sftraceRing[pos % NX_SF_TRACE_RING_SIZE];
+    __atomic_store_n(&r->seq, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    r->event = (SfTraceEvent){
+        .start_tick = start_tick,
+        .end_tick   = end_tick,
+        .session    = session,
+        .object_id  = object_id,
+        .request_id = request_id,
+        .rc         = rc,
+    };
+    __atomic_store_n(&r->seq, pos+1, __ATOMIC_RELEASE);
+
+    TraceKeyEntry* e = _sftraceFindKey(session, object_id, request_id);
+    if (!e)
+        return;
+
+    u32 bucket = duration ? 63 - __builtin_clzll(duration) : 0;
+    if (bucket >= NX_SF_TRACE_NUM_BUCKETS)
+        bucket = NX_SF_TRACE_NUM_BUCKETS-1;
+
+    __atomic_add_fetch(&e->count, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&e->total_ticks, duration, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&e->buckets[bucket], 1, __ATOMIC_RELAXED);
+
+    u64 cur_max = __atomic_load_n(&e->max_ticks, __ATOMIC_RELAXED);
+    while (duration > cur_max && !__atomic_compare_exchange_n(&e->max_ticks, &cur_max, duration, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+u32 sftraceGetEvents(SfTraceEvent* events, u32 max_events) {
+    u32 end = __atomic_load_n(&g_sftraceRingPos, __ATOMIC_ACQUIRE);
+    u32 count = end < NX_SF_TRACE_RING_SIZE ? end : NX_SF_TRACE_RING_SIZE;
+    if (count > max_events)
+        count = max_events;
+
+    u32 num_out = 0;
+    for (u32 pos = end - count; pos != end; pos ++) {
+        TraceRingEntry* r = &g_sftraceRing[pos % NX_SF_TRACE_RING_SIZE];
+        if (__atomic_load_n(&r->seq, __ATOMIC_ACQUIRE) != pos+1)
+            continue; // Being overwritten
+        SfTraceEvent tmp = r->event;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&r->seq, __ATOMIC_RELAXED) != pos+1)
+            continue;
+        events[num_out++] = tmp;
+    }
+
+    return num_out;
+}
+
+static u64 _sftraceGetPercentile(const u32* buckets, u64 count, u32 percent) {
+    u64 threshold = (count * percent + 99) / 100;
+    u64 acc = 0;
+    for (u32 i = 0; i < NX_SF_TRACE_NUM_BUCKETS; i ++) {
+        acc += buckets[i];
+        if (acc >= threshold)
+            return (2ULL << i) - 1;
+    }
+    return UINT64_MAX;
+}
+
+u32 sftraceGetStats(SfTraceStats* stats, u32 max_stats) {
+    u32 num_out = 0;
+    for (u32 i = 0; i < NX_SF_TRACE_MAX_KEYS && num_out < max_stats; i ++) {
+        TraceKeyEntry* e = &g_sftraceKeys[i];
+        if (__atomic_load_n(&e->state, __ATOMIC_ACQUIRE) != 2)
+            continue;
+
+        u32 buckets[NX_SF_TRACE_NUM_BUCKETS];
+        u64 count = 0;
+        for (u32 j = 0; j < NX_SF_TRACE_NUM_BUCKETS; j ++) {
+            buckets[j] = __atomic_load_n(&e->buckets[j], __ATOMIC_RELAXED);
+            count += buckets[j];
+        }
+        if (!count)
+            continue;
+
+        SfTraceStats* out = &stats[num_out++];
+        _sftraceGetServiceName(e->session, out->service_name);
+        out->session     = e->session;
+        out->object_id   = e->object_id;
+        out->request_id  = e->request_id;
+        out->count       = count;
+        out->total_ticks = __atomic_load_n(&e->total_ticks, __ATOMIC_RELAXED);
+        out->max_ticks   = __atomic_load_n(&e->max_ticks, __ATOMIC_RELAXED);
+        out->p50_ticks   = _sftraceGetPercentile(buckets, count, 50);
+        out->p99_ticks   = _sftraceGetPercentile(buckets, count, 99);
+    }
+
+    return num_out;
+}
+
+void sftraceReset(void) {
+    memset(g_sftraceKeys, 0, sizeof(g_sftraceKeys));
+    memset(g_sftraceRing, 0, sizeof(g_sftraceRing));
+    __atomic_store_n(&g_sftraceRingPos, 0, __ATOMIC_RELEASE);
+}